@@ -199,6 +199,14 @@ double topocentric_zenith_angle(double e);
 double topocentric_azimuth_angle_astro(double h_prime, double latitude, double delta_prime);
 double topocentric_azimuth_angle(double azimuth_astro);
 
+//-------------- Used by the batch positions of SunCalculatorNREL --------------
+double julian_day(int year, int month, int day, int hour, int minute, double second, double dut1, double tz);
+double julian_century(double jd);
+double greenwich_mean_sidereal_time(double jd, double jc);
+double greenwich_sidereal_time(double nu0, double delta_psi, double epsilon);
+double sun_equatorial_horizontal_parallax(double r);
+void   calculate_geocentric_sun_right_ascension_and_declination(spa_data *spa);
+
 
 //Calculate SPA output values (in structure) based on input values passed in structure
 int spa_calculate(spa_data *spa);
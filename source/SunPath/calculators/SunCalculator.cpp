@@ -68,6 +68,24 @@ Horizontal SunCalculator::findHorizontalV(const QDateTime& /*t*/) const
     return Horizontal(0., 0.);
 }
 
+QVector<Horizontal> SunCalculator::findHorizontalsV(const QVector<QDateTime>& ts) const
+{
+    QVector<Horizontal> ans;
+    ans.reserve(ts.size());
+    for (const QDateTime& t : ts)
+        ans << findHorizontalV(t);
+    return ans;
+}
+
+QVector<vec3d> SunCalculator::findVectors(const QVector<QDateTime>& ts) const
+{
+    QVector<vec3d> ans;
+    ans.reserve(ts.size());
+    for (const Horizontal& hc : findHorizontalsV(ts))
+        ans << findVector(hc);
+    return ans;
+}
+
 Equatorial SunCalculator::findEquatorial(const vec3d& v) const
 {
     double omega = atan2(-v.x, -v.y*m_sinPhi + v.z*m_cosPhi);
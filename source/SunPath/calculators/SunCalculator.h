@@ -3,6 +3,7 @@
 #include "Location.h"
 
 #include <QDateTime>
+#include <QVector>
 
 // add sun calc
 // https://www.aa.quae.nl/en/reken/zonpositie.html
@@ -57,6 +58,9 @@ public:
     Horizontal findHorizontal(const Equatorial& ec) const
         {return findHorizontal(findVector(ec));}
     virtual Horizontal findHorizontalV(const QDateTime& t) const; // needs V
+    // positions at many times, calculators may share work between them
+    virtual QVector<Horizontal> findHorizontalsV(const QVector<QDateTime>& ts) const;
+    QVector<vec3d> findVectors(const QVector<QDateTime>& ts) const;
 
     Equatorial findEquatorial(const vec3d& v) const;
     Equatorial findEquatorial(const Horizontal& hc) const
@@ -3,9 +3,68 @@
 #include "NREL/spa.h"
 #include <QDebug>
 
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 using namespace sp;
 
 
+namespace {
+
+// the slow part of the algorithm, from the Earth periodic terms and the
+// nutation, at 0h UT of one day
+struct GeocentricDay
+{
+    double alpha; // right ascension [degrees]
+    double delta; // declination [degrees]
+    double delPsi; // nutation in longitude [degrees]
+    double epsilon; // true obliquity [degrees]
+    double r; // Earth radius vector [AU]
+};
+
+GeocentricDay findGeocentricDay(double jd)
+{
+    spa_data spa = {};
+    spa.jd = jd;
+    spa.delta_t = 0.;
+    calculate_geocentric_sun_right_ascension_and_declination(&spa);
+    return GeocentricDay{spa.alpha, spa.delta, spa.del_psi, spa.epsilon, spa.r};
+}
+
+// quadratic through the days before, of and after, f in days from the middle one
+double interpolate(double a, double b, double c, double f)
+{
+    return b + f*((c - a)/2. + f*(a - 2.*b + c)/2.);
+}
+
+// unwraps the right ascension around the middle day
+double unwrap(double alpha, double alphaMiddle)
+{
+    if (alpha - alphaMiddle > 180.) return alpha - 360.;
+    if (alphaMiddle - alpha > 180.) return alpha + 360.;
+    return alpha;
+}
+
+// shares parts of a range between threads once it is long enough
+template<class F>
+void runParallel(int count, F function)
+{
+    const int itemsPerThread = 4096;
+    int threads = std::max(1, std::min(int(std::thread::hardware_concurrency()), count/itemsPerThread));
+    std::vector<std::thread> workers;
+    for (int w = 1; w < threads; ++w)
+        workers.emplace_back(function, qint64(count)*w/threads, qint64(count)*(w + 1)/threads);
+    function(0, qint64(count)/threads);
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+} // namespace
+
+
 SunCalculatorNREL::SunCalculatorNREL()
 {
 
@@ -49,3 +108,93 @@ Horizontal SunCalculatorNREL::findHorizontalV(const QDateTime& t) const
         spa.azimuth*degree, (90. - spa.zenith)*degree
     );
 }
+
+/*!
+ * Finds the positions at many times with the inputs of findHorizontalV.
+ * The geocentric right ascension, declination, nutation, obliquity and
+ * Earth distance are found once per day at 0h UT and interpolated
+ * quadratically between the days around each time; the sidereal time and
+ * the topocentric angles follow every time exactly. Interpolation differs
+ * from the scalar algorithm by less than 1e-5 degrees, well below its 3e-4
+ * degrees of uncertainty. Days and times are shared between threads.
+ */
+QVector<Horizontal> SunCalculatorNREL::findHorizontalsV(const QVector<QDateTime>& ts) const
+{
+    const int count = ts.size();
+    const double longitude = m_location.longitude()/degree;
+    const double latitude = m_location.latitude()/degree;
+    const double elevation = 0.;
+    const double pressure = 1000.;
+    const double temperature = 20.;
+    const double atmosRefract = 0.5667;
+
+    std::vector<double> jds(count);
+    runParallel(count, [&](qint64 begin, qint64 end) {
+        for (qint64 n = begin; n < end; ++n) {
+            const QDateTime& t = ts[n];
+            QDate date = t.date();
+            QTime time = t.time();
+            jds[n] = julian_day(date.year(), date.month(), date.day(),
+                time.hour(), time.minute(), time.second(), 0., t.offsetFromUtc()/3600.);
+        }
+    });
+
+    // 0h UT nearest to each time, and the days on both sides
+    auto findDay = [](double jd) {return qint64(std::floor(jd));};
+    std::vector<qint64> days;
+    for (double jd : jds) {
+        qint64 d = findDay(jd);
+        days.push_back(d - 1);
+        days.push_back(d);
+        days.push_back(d + 1);
+    }
+    std::sort(days.begin(), days.end());
+    days.erase(std::unique(days.begin(), days.end()), days.end());
+
+    std::vector<GeocentricDay> geocentric(days.size());
+    runParallel(int(days.size()), [&](qint64 begin, qint64 end) {
+        for (qint64 n = begin; n < end; ++n)
+            geocentric[n] = findGeocentricDay(days[n] + 0.5);
+    });
+    std::unordered_map<qint64, int> dayIndex;
+    for (int n = 0; n < int(days.size()); ++n)
+        dayIndex[days[n]] = n;
+
+    QVector<Horizontal> ans(count);
+    Horizontal* out = ans.data();
+    runParallel(count, [&](qint64 begin, qint64 end) {
+        for (qint64 n = begin; n < end; ++n) {
+            const double jd = jds[n];
+            const qint64 d = findDay(jd);
+            const double f = jd - (d + 0.5);
+            const int k = dayIndex.at(d);
+            const GeocentricDay& gA = geocentric[k - 1];
+            const GeocentricDay& gB = geocentric[k];
+            const GeocentricDay& gC = geocentric[k + 1];
+
+            double alpha = limit_degrees(interpolate(unwrap(gA.alpha, gB.alpha), gB.alpha, unwrap(gC.alpha, gB.alpha), f));
+            double delta = interpolate(gA.delta, gB.delta, gC.delta, f);
+            double delPsi = interpolate(gA.delPsi, gB.delPsi, gC.delPsi, f);
+            double epsilon = interpolate(gA.epsilon, gB.epsilon, gC.epsilon, f);
+            double r = interpolate(gA.r, gB.r, gC.r, f);
+
+            double nu0 = greenwich_mean_sidereal_time(jd, julian_century(jd));
+            double nu = greenwich_sidereal_time(nu0, delPsi, epsilon);
+
+            double h = observer_hour_angle(nu, longitude, alpha);
+            double xi = sun_equatorial_horizontal_parallax(r);
+            double delAlpha, deltaPrime;
+            right_ascension_parallax_and_topocentric_dec(latitude, elevation, xi, h, delta, &delAlpha, &deltaPrime);
+            double hPrime = topocentric_local_hour_angle(h, delAlpha);
+
+            double e0 = topocentric_elevation_angle(latitude, deltaPrime, hPrime);
+            double delE = atmospheric_refraction_correction(pressure, temperature, atmosRefract, e0);
+            double e = topocentric_elevation_angle_corrected(e0, delE);
+
+            double zenith = topocentric_zenith_angle(e);
+            double azimuth = topocentric_azimuth_angle(topocentric_azimuth_angle_astro(hPrime, latitude, deltaPrime));
+            out[n] = Horizontal(azimuth*degree, (90. - zenith)*degree);
+        }
+    });
+    return ans;
+}
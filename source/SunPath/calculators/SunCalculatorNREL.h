@@ -11,6 +11,7 @@ public:
     SunCalculatorNREL* copy() const;
 
     Horizontal findHorizontalV(const QDateTime& t) const;
+    QVector<Horizontal> findHorizontalsV(const QVector<QDateTime>& ts) const;
 
     QString info() const {return "NREL (2003)";}
 };
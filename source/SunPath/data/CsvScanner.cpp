@@ -0,0 +1,87 @@
+#include "CsvScanner.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace sp {
+
+
+namespace {
+
+std::string_view trimmed(std::string_view s)
+{
+    auto isSpace = [](char c) {return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';};
+    while (!s.empty() && isSpace(s.front())) s.remove_prefix(1);
+    while (!s.empty() && isSpace(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+// the field without spaces and without a plus sign, which from_chars rejects
+std::string_view number(std::string_view s)
+{
+    s = trimmed(s);
+    if (s.size() > 1 && s.front() == '+' && s[1] != '-') s.remove_prefix(1);
+    return s;
+}
+
+} // namespace
+
+
+CsvScanner::CsvScanner(const char* begin, const char* end):
+    m_next(begin),
+    m_end(end)
+{
+
+}
+
+bool CsvScanner::nextLine()
+{
+    if (m_next >= m_end) return false;
+
+    const char* eol = static_cast<const char*>(std::memchr(m_next, '\n', m_end - m_next));
+    const char* lineEnd = eol ? eol : m_end;
+    m_line = std::string_view(m_next, lineEnd - m_next);
+    if (!m_line.empty() && m_line.back() == '\r') m_line.remove_suffix(1);
+    m_next = eol ? eol + 1 : m_end;
+
+    m_fields.clear();
+    std::string_view rest = m_line;
+    while (true) {
+        std::size_t comma = rest.find(',');
+        m_fields.push_back(rest.substr(0, comma));
+        if (comma == std::string_view::npos) break;
+        rest.remove_prefix(comma + 1);
+    }
+    return true;
+}
+
+bool CsvScanner::toInt(int i, int* value) const
+{
+    if (i < 0 || i >= fieldCount()) return false;
+    std::string_view s = number(m_fields[i]);
+    if (s.empty()) return false;
+    std::from_chars_result r = std::from_chars(s.data(), s.data() + s.size(), *value);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+bool CsvScanner::toDouble(int i, double* value) const
+{
+    if (i < 0 || i >= fieldCount()) return false;
+    std::string_view s = number(m_fields[i]);
+    if (s.empty()) return false;
+    std::from_chars_result r = std::from_chars(s.data(), s.data() + s.size(), *value);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+int CsvScanner::countLines() const
+{
+    int ans = 0;
+    for (const char* p = m_next; p < m_end; ++ans) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', m_end - p));
+        p = eol ? eol + 1 : m_end;
+    }
+    return ans;
+}
+
+
+} // namespace sp
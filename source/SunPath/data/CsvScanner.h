@@ -0,0 +1,39 @@
+#pragma once
+
+#include "SunPath/SunPath.h"
+
+#include <string_view>
+#include <vector>
+
+namespace sp {
+
+
+// walks the comma separated lines of a buffer, as a mapped file,
+// with fields viewed in place and numbers read by from_chars
+class SunPath CsvScanner
+{
+public:
+    CsvScanner(const char* begin, const char* end);
+
+    // the next line, without its end of line; false after the last
+    bool nextLine();
+    std::string_view line() const {return m_line;}
+    int fieldCount() const {return int(m_fields.size());}
+    std::string_view field(int i) const {return m_fields[i];}
+
+    // as QString::toInt and toDouble: spaces around and a plus sign allowed
+    bool toInt(int i, int* value) const;
+    bool toDouble(int i, double* value) const;
+
+    // lines left, ending the last one without end of line
+    int countLines() const;
+
+private:
+    const char* m_next;
+    const char* m_end;
+    std::string_view m_line;
+    std::vector<std::string_view> m_fields;
+};
+
+
+} // namespace sp
@@ -1,15 +1,46 @@
 #include "SunPath/data/FormatTMY.h"
 
+#include "SunPath/data/CsvScanner.h"
+
+#include <QCryptographicHash>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QTextStream>
 #include <QStringList>
 #include <QString>
 
+#include <cstring>
+#include <typeinfo>
+
 using Qt::endl;
 
 namespace sp {
 
 
+namespace {
+
+const char CacheMagic[4] = {'S', 'P', 'T', 'C'};
+const quint32 CacheVersion = 1;
+
+// followed by the times, sun vectors and corrected hours of the stamps,
+// then by the data, all of 8 bytes
+struct CacheHeader
+{
+    char magic[4];
+    quint32 version;
+    quint64 stamps;
+    quint64 values;
+    double latitude;
+    double longitude;
+    qint32 offsetUTC; // of the location
+    qint32 offsetStamps; // of the times
+};
+
+} // namespace
+
 
 FormatTMY::FormatTMY(SunTemporal* sunTemporal):
     m_sunTemporal(sunTemporal)
@@ -21,12 +52,39 @@ bool FormatTMY::read(QString fileName, const ParamsTMY& params)
 {
     try {
         QFile file(fileName);
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        if (!file.open(QIODevice::ReadOnly))
             throw QString("File not opened: ") + fileName;
+        // mapped and viewed in place, read only where mapping is not supported
+        QByteArray bytes;
+        const uchar* mapped = params.mapped && file.size() > 0 ? file.map(0, file.size()) : nullptr;
+        if (mapped)
+            bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), file.size());
+        else
+            bytes = file.readAll();
+
+        QString cacheName;
+        if (params.cache) {
+            cacheName = findCacheName(bytes, params);
+            if (!cacheName.isEmpty() && readCache(cacheName)) {
+                m_message.clear();
+                return true;
+            }
+        }
 
-        QTextStream fin(&file);
-        readInfo(fin, params);
-        readData(fin, params);
+        if (params.mapped) {
+            const char* begin = bytes.constData();
+            const char* end = begin + bytes.size();
+            if (bytes.startsWith("\xEF\xBB\xBF")) begin += 3; // as QTextStream, which skips the BOM
+            CsvScanner scanner(begin, end);
+            readInfo(scanner, params);
+            readData(scanner, params);
+        } else {
+            QTextStream fin(&bytes, QIODevice::ReadOnly);
+            readInfo(fin, params);
+            readData(fin, params);
+        }
+        if (!cacheName.isEmpty())
+            writeCache(cacheName);
 
         m_message.clear();
         return true;
@@ -95,10 +153,30 @@ bool FormatTMY::write(QString fileName, const ParamsTMY& params)
 
 void FormatTMY::readInfo(QTextStream& fin, const ParamsTMY& /*params*/)
 {
-    // line 1
-    QString line = fin.readLine();
-    if (line.isNull())
+    QString line1 = fin.readLine();
+    if (line1.isNull())
         throw QString("line 1 is missing");
+    QString line2 = fin.readLine();
+    if (line2.isNull())
+        throw QString("line 2 is missing");
+    setLocation(line1, line2);
+}
+
+void FormatTMY::readInfo(CsvScanner& fin, const ParamsTMY& /*params*/)
+{
+    if (!fin.nextLine())
+        throw QString("line 1 is missing");
+    QString line1 = QString::fromUtf8(fin.line().data(), fin.line().size());
+    if (!fin.nextLine())
+        throw QString("line 2 is missing");
+    QString line2 = QString::fromUtf8(fin.line().data(), fin.line().size());
+    setLocation(line1, line2);
+}
+
+void FormatTMY::setLocation(const QString& line1, const QString& line2)
+{
+    // line 1
+    QString line = line1;
     QStringList list = line.split(',');
 
     int iLatitude = -1;
@@ -114,9 +192,7 @@ void FormatTMY::readInfo(QTextStream& fin, const ParamsTMY& /*params*/)
     }
 
     // line 2
-    line = fin.readLine();
-    if (line.isNull())
-        throw QString("line 2 is missing");
+    line = line2;
     list = line.split(',');
     bool ok;
 
@@ -140,37 +216,42 @@ void FormatTMY::readInfo(QTextStream& fin, const ParamsTMY& /*params*/)
     m_sunTemporal->calculator()->setLocation(location);
 }
 
-void FormatTMY::readData(QTextStream& fin, const ParamsTMY& params)
+FormatTMY::Columns FormatTMY::findColumns(const QString& line)
 {
-    // line 3
-    QString line = fin.readLine();
-    if (line.isNull()) throw QString("line 1 is missing");
     QStringList list = line.split(',');
-
-    int iYear = -1;
-    int iMonth = -1;
-    int iDay = -1;
-    int iHour = -1;
-    int iMinute = -1;
-    int iSecond = -1;
-    int iDNI = -1;
-
+    Columns ans;
     for (int i = 0; i < list.size(); ++i) {
         if (list[i].contains("Year", Qt::CaseInsensitive))
-            iYear = i;
+            ans.year = i;
         else if (list[i].contains("Month", Qt::CaseInsensitive))
-            iMonth = i;
+            ans.month = i;
         else if (list[i].contains("Day", Qt::CaseInsensitive))
-            iDay = i;
+            ans.day = i;
         else if (list[i].contains("Hour", Qt::CaseInsensitive))
-            iHour = i;
+            ans.hour = i;
         else if (list[i].contains("Minute", Qt::CaseInsensitive))
-            iMinute = i;
+            ans.minute = i;
         else if (list[i].contains("Second", Qt::CaseInsensitive))
-            iSecond = i;
+            ans.second = i;
         else if (list[i].contains("DNI", Qt::CaseInsensitive))
-            iDNI = i;
+            ans.dni = i;
     }
+    return ans;
+}
+
+void FormatTMY::readData(QTextStream& fin, const ParamsTMY& params)
+{
+    // line 3
+    QString line = fin.readLine();
+    if (line.isNull()) throw QString("line 1 is missing");
+    const Columns columns = findColumns(line);
+    const int iYear = columns.year;
+    const int iMonth = columns.month;
+    const int iDay = columns.day;
+    const int iHour = columns.hour;
+    const int iMinute = columns.minute;
+    const int iSecond = columns.second;
+    const int iDNI = columns.dni;
 
     int year = 0;
     int month = 0;
@@ -220,6 +301,56 @@ void FormatTMY::readData(QTextStream& fin, const ParamsTMY& params)
         ds << DNI;
     }
 
+    setSamples(ts, ds, params);
+}
+
+/*!
+ * Reads the same fields as the QTextStream reader, in place: a field
+ * becomes a number without a QString, and the arrays are allocated once
+ * for the lines counted ahead.
+ */
+void FormatTMY::readData(CsvScanner& fin, const ParamsTMY& params)
+{
+    // line 3
+    if (!fin.nextLine()) throw QString("line 1 is missing");
+    const Columns columns = findColumns(QString::fromUtf8(fin.line().data(), fin.line().size()));
+
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    double DNI = 0.;
+
+    int offsetUTC = m_sunTemporal->calculator()->location().offsetUTC();
+    const int lines = fin.countLines();
+    QVector<QDateTime> ts;
+    ts.reserve(lines + 1);
+    ts << QDateTime();
+    QVector<double> ds;
+    ds.reserve(lines);
+
+    auto lineText = [&fin]() {return QString::fromUtf8(fin.line().data(), fin.line().size());};
+    while (fin.nextLine()) {
+        if (!fin.toInt(columns.year, &year)) throw QString("toInt ") + lineText();
+        if (!fin.toInt(columns.month, &month)) throw QString("toInt ") + lineText();
+        if (!fin.toInt(columns.day, &day)) throw QString("toInt ") + lineText();
+        if (!fin.toInt(columns.hour, &hour)) throw QString("toInt ") + lineText();
+        if (columns.minute > 0 && !fin.toInt(columns.minute, &minute)) throw QString("toInt ") + lineText();
+        if (columns.second > 0 && !fin.toInt(columns.second, &second)) throw QString("toInt ") + lineText();
+        if (!fin.toDouble(columns.dni, &DNI)) throw QString("toDouble ") + lineText();
+
+        ts << QDateTime(QDate(year, month, day), QTime(hour, minute, second), Qt::OffsetFromUTC, offsetUTC);
+        ds << DNI;
+    }
+
+    setSamples(ts, ds, params);
+}
+
+void FormatTMY::setSamples(QVector<QDateTime>& ts, const QVector<double>& ds, const ParamsTMY& params)
+{
+    if (ts.size() < 3) throw QString("fewer than two data lines");
     int tStep = ts[1].msecsTo(ts[2]);
     ts[0] = ts[1].addMSecs(-tStep);
 
@@ -233,5 +364,99 @@ void FormatTMY::readData(QTextStream& fin, const ParamsTMY& params)
     m_sunTemporal->setData(ds);
 }
 
+// empty if there is no cache directory
+QString FormatTMY::findCacheName(const QByteArray& bytes, const ParamsTMY& params)
+{
+    QString dirName = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (dirName.isEmpty()) return QString();
+
+    const SunCalculator* sc = m_sunTemporal->calculator();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(bytes);
+    hash.addData(QByteArray(typeid(*sc).name()));
+    hash.addData(QString(" obliquity=%1 offset=%2 adjustDay=%3")
+        .arg(SunCalculator::obliquity(), 0, 'g', 17)
+        .arg(params.offset)
+        .arg(params.adjustDay ? 1 : 0).toUtf8());
+    return dirName + "/tmy/" + hash.result().toHex() + ".bin";
+}
+
+bool FormatTMY::readCache(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const qint64 size = file.size();
+    if (size < qint64(sizeof(CacheHeader))) return false;
+    const uchar* bytes = file.map(0, size);
+    if (!bytes) return false;
+
+    CacheHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0) return false;
+    if (header.version != CacheVersion) return false;
+    if (header.stamps < 2 || header.values + 1 != header.stamps) return false;
+    if (size != qint64(sizeof(header) + 8*(5*header.stamps + header.values))) return false;
+
+    const qint64* times = reinterpret_cast<const qint64*>(bytes + sizeof(header));
+    const double* vectors = reinterpret_cast<const double*>(times + header.stamps);
+    const double* hours = vectors + 3*header.stamps;
+    const double* values = hours + header.stamps;
+
+    QVector<TimeStamp> stamps(header.stamps);
+    for (quint64 n = 0; n < header.stamps; ++n) {
+        const double* s = vectors + 3*n;
+        stamps[n] = TimeStamp(
+            QDateTime::fromMSecsSinceEpoch(times[n], Qt::OffsetFromUTC, header.offsetStamps),
+            vec3d(s[0], s[1], s[2]), hours[n]
+        );
+    }
+    QVector<double> data(values, values + header.values);
+
+    Location location("TMY", header.latitude, header.longitude, header.offsetUTC);
+    m_sunTemporal->calculator()->setLocation(location);
+    m_sunTemporal->setTimeStamps(stamps);
+    m_sunTemporal->setData(data);
+    return true;
+}
+
+// a cache that cannot be written is left out
+void FormatTMY::writeCache(const QString& fileName)
+{
+    const QVector<TimeStamp>& stamps = m_sunTemporal->timeStamps();
+    const QVector<double>& data = m_sunTemporal->data();
+    const Location& location = m_sunTemporal->calculator()->location();
+
+    CacheHeader header;
+    std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = CacheVersion;
+    header.stamps = stamps.size();
+    header.values = data.size();
+    header.latitude = location.latitude();
+    header.longitude = location.longitude();
+    header.offsetUTC = location.offsetUTC();
+    header.offsetStamps = stamps.isEmpty() ? 0 : stamps[0].t.offsetFromUtc();
+
+    QByteArray bytes;
+    bytes.reserve(sizeof(header) + 8*(5*stamps.size() + data.size()));
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const TimeStamp& ts : stamps) {
+        qint64 t = ts.t.toMSecsSinceEpoch();
+        bytes.append(reinterpret_cast<const char*>(&t), sizeof(t));
+    }
+    for (const TimeStamp& ts : stamps) {
+        const double s[] = {ts.s.x, ts.s.y, ts.s.z};
+        bytes.append(reinterpret_cast<const char*>(s), sizeof(s));
+    }
+    for (const TimeStamp& ts : stamps)
+        bytes.append(reinterpret_cast<const char*>(&ts.tc), sizeof(ts.tc));
+    bytes.append(reinterpret_cast<const char*>(data.constData()), sizeof(double)*data.size());
+
+    if (!QDir().mkpath(QFileInfo(fileName).absolutePath())) return;
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) return;
+    if (file.write(bytes) != bytes.size()) return;
+    file.commit();
+}
+
 
 } // namespace sp
@@ -4,6 +4,7 @@
 
 namespace sp {
 
+class CsvScanner;
 
 struct SunPath ParamsTMY
 {
@@ -11,6 +12,11 @@ struct SunPath ParamsTMY
     bool adjustDay = false;
     int offset = 0; // in seconds
     int precision = 0; // precision for function
+    // timestamps, sun vectors and data kept in the user cache directory,
+    // keyed by the file contents, the calculator and the offset
+    bool cache = true;
+    // the file mapped and parsed in place; false parses it through QTextStream
+    bool mapped = true;
 };
 
 
@@ -24,8 +30,28 @@ public:
     QString message() const {return m_message;}
 
 protected:
+    // of the fields, -1 for those missing
+    struct Columns
+    {
+        int year = -1;
+        int month = -1;
+        int day = -1;
+        int hour = -1;
+        int minute = -1;
+        int second = -1;
+        int dni = -1;
+    };
+
     void readInfo(QTextStream& fin, const ParamsTMY& params);
+    void readInfo(CsvScanner& fin, const ParamsTMY& params);
+    void setLocation(const QString& line1, const QString& line2);
+    Columns findColumns(const QString& line);
     void readData(QTextStream& fin, const ParamsTMY& params);
+    void readData(CsvScanner& fin, const ParamsTMY& params);
+    void setSamples(QVector<QDateTime>& ts, const QVector<double>& ds, const ParamsTMY& params);
+    QString findCacheName(const QByteArray& bytes, const ParamsTMY& params);
+    bool readCache(const QString& fileName);
+    void writeCache(const QString& fileName);
 
 protected:
     SunTemporal* m_sunTemporal;
@@ -6,6 +6,32 @@
 
 namespace sp {
 
+struct MatrixNR::Factorization
+{
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr;
+};
+
+namespace {
+
+Eigen::MatrixXd toEigen(const Matrix<double>& matrix)
+{
+    Eigen::MatrixXd ans(matrix.rows(), matrix.columns());
+    for (int r = 0; r < matrix.rows(); ++r)
+        for (int c = 0; c < matrix.columns(); ++c)
+            ans(r, c) = matrix(r, c);
+    return ans;
+}
+
+QVector<double> fromEigen(const Eigen::VectorXd& vector)
+{
+    QVector<double> ans(vector.size());
+    for (int r = 0; r < ans.size(); ++r)
+        ans[r] = vector[r];
+    return ans;
+}
+
+}
+
 MatrixNR::MatrixNR(int rows, int columns):
     Matrix<double>(rows, columns)
 {
@@ -32,22 +58,37 @@ QVector<double> MatrixNR::solve(const QVector<double>& vector)
     using namespace Eigen;
 
     int size = m_rows;
-    MatrixXd mat(size, size);
     VectorXd vec(size);
-
     for (int r = 0; r < size; ++r)
-        for (int c = 0; c < size; ++c)
-            mat(r, c) = (*this)(r, c);
+        vec[r] = vector[r];
 
+    if (m_factorization)
+        vec = m_factorization->qr.solve(vec);
+    else
+        vec = toEigen(*this).colPivHouseholderQr().solve(vec);
+    return fromEigen(vec);
+}
+
+QVector<double> MatrixNR::solveTransposed(const QVector<double>& vector)
+{
+    using namespace Eigen;
+
+    int size = m_columns;
+    VectorXd vec(size);
     for (int r = 0; r < size; ++r)
         vec[r] = vector[r];
 
-    vec = mat.colPivHouseholderQr().solve(vec);
+    if (m_factorization)
+        vec = m_factorization->qr.transpose().solve(vec);
+    else
+        vec = toEigen(*this).transpose().colPivHouseholderQr().solve(vec);
+    return fromEigen(vec);
+}
 
-    QVector<double> ans(size);
-    for (int r = 0; r < size; ++r)
-        ans[r] = vec[r];
-    return ans;
+void MatrixNR::factorize()
+{
+    m_factorization.reset(new Factorization);
+    m_factorization->qr.compute(toEigen(*this));
 }
 
 void MatrixNR::invert()
@@ -2,6 +2,8 @@
 
 #include "SunPath/math/matrices/Matrix.h"
 
+#include <QSharedPointer>
+
 namespace sp {
 
 class SunPath MatrixNR: public Matrix<double>
@@ -11,8 +13,21 @@ public:
 
     QVector<double> multiply(const QVector<double>& vector);
     QVector<double> solve(const QVector<double>& vector);
+    // solves with the transpose of the matrix
+    QVector<double> solveTransposed(const QVector<double>& vector);
+
+    // keeps the QR factorization for the solves that follow, which then
+    // cost a back substitution each; the matrix must not change meanwhile.
+    // Without it every solve factorizes the matrix again
+    void factorize();
+    void clearFactorization() {m_factorization.reset();}
+    bool isFactorized() const {return !m_factorization.isNull();}
 
     void invert();
+
+private:
+    struct Factorization;
+    QSharedPointer<Factorization> m_factorization;
 };
 
 } // namespace sp
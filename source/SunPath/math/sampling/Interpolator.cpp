@@ -1,14 +1,42 @@
 #include "Interpolator.h"
 
 #include <algorithm>
+#include <cmath>
 
 namespace sp {
 
 
+void Interpolator::findGrid()
+{
+    m_gridOrigin = 0.;
+    m_gridStep = 0.;
+    int nMax = m_data.size();
+    if (nMax < 2) return;
+
+    double origin = m_data.first().x;
+    double step = (m_data.last().x - origin)/(nMax - 1);
+    if (!(step > 0.)) return;
+    for (int n = 0; n < nMax; ++n)
+        if (std::abs(m_data[n].x - (origin + n*step)) >= step) return;
+    m_gridOrigin = origin;
+    m_gridStep = step;
+}
+
 // m_data[iA].x < x <= m_data[iA + 1].x
 // range [0, size - 1)
 int Interpolator::indexA(double x) const
 {
+    if (m_gridStep > 0.) {
+        // the grid guess is at most a step off the data
+        int nMax = m_data.size();
+        int i = int(std::floor((x - m_gridOrigin)/m_gridStep));
+        i = std::clamp(i, 0, nMax - 2);
+        while (i > 0 && m_data[i].x >= x) --i;
+        while (i < nMax - 1 && m_data[i + 1].x < x) ++i;
+        if (m_data[i].x >= x) return i - 1;
+        return i;
+    }
+
     QVector<vec2d>::const_iterator iter = std::lower_bound(m_data.begin(), m_data.end(), x,
         [](const vec2d& a, double x) {return a.x < x;}
     );
@@ -25,6 +53,18 @@ double Interpolator::function(double x) const
     return functionA(i, x);
 }
 
+void Interpolator::function(const double* xs, int count, double* ans) const
+{
+    for (int n = 0; n < count; ++n)
+        ans[n] = function(xs[n]);
+}
+
+void Interpolator::derivative(const double* xs, int count, double* ans) const
+{
+    for (int n = 0; n < count; ++n)
+        ans[n] = derivative(xs[n]);
+}
+
 double Interpolator::functionA(int iA, double /*x*/) const
 {
     return m_data[iA].y;
@@ -48,6 +88,7 @@ double Interpolator::derivativeA(int /*iA*/, double /*x*/) const
 void InterpolatorLinear::setData(const QVector<vec2d>& data)
 {
     m_data = data;
+    findGrid();
 
     double f = 0.;
     m_derivatives << f;
@@ -78,6 +119,7 @@ double InterpolatorLinear::derivativeA(int iA, double /*x*/) const
 void InterpolatorCubic::setData(const QVector<vec2d>& data)
 {
     m_data = data;
+    findGrid();
 
     int nMax = m_data.size();
     m_m.resize(nMax);
@@ -162,6 +204,7 @@ void InterpolatorCubic::coeffs(int iA, double* a) const
 void InterpolatorCubicMono::setData(const QVector<vec2d>& data)
 {
     m_data = data;
+    findGrid();
 
     int nMax = m_data.size();
     m_m.resize(nMax);
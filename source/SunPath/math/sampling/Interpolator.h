@@ -7,6 +7,8 @@
 namespace sp {
 
 // data should be sorted
+// data within a step of a uniform grid, as time series of regular steps
+// with shifted sunrises and sunsets, are indexed from the grid directly
 class SunPath Interpolator
 {
 public:
@@ -14,8 +16,9 @@ public:
     virtual ~Interpolator() {}
 
     const QVector<vec2d>& data() const {return m_data;}
-    virtual void setData(const QVector<vec2d>& data) {m_data = data;}
+    virtual void setData(const QVector<vec2d>& data) {m_data = data; findGrid();}
     int indexA(double x) const;
+    bool isUniform() const {return m_gridStep > 0.;}
 
     double function(double x) const;
     virtual double functionA(int iA, double x) const;
@@ -23,8 +26,16 @@ public:
     double derivative(double x) const;
     virtual double derivativeA(int iA, double x) const;
 
+    // at count points xs, into ans
+    void function(const double* xs, int count, double* ans) const;
+    void derivative(const double* xs, int count, double* ans) const;
+
 protected:
+    void findGrid();
+
      QVector<vec2d> m_data;
+     double m_gridOrigin = 0.;
+     double m_gridStep = 0.; // 0 for data off a uniform grid
 };
 
 
@@ -11,6 +11,13 @@ double SkyKernelGaussian3D::operator()(const SkyNode& sn, const vec3d& r) const
     return exp(arg);
 }
 
+// for unit vectors dot(v, r) - 1 = -|v - r|^2/2
+double SkyKernelGaussian3D::radius(const SkyNode& sn) const
+{
+    if (!(sn.coeff > 0.)) return infinity;
+    return sqrt(40./sn.coeff);
+}
+
 // https://en.wikipedia.org/wiki/Polyharmonic_spline
 double SkyKernelPolyharmonic::operator()(const SkyNode& sn, const vec3d& r) const
 {
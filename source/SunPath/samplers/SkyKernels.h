@@ -6,24 +6,35 @@ namespace sp {
 
 
 typedef double (*KernelFunc)(void* k, const SkyNode& sn, const vec3d& r);
+typedef double (*KernelRadiusFunc)(void* k, const SkyNode& sn);
 
 template<class T>
 inline double kernelFuncT(void* k, const SkyNode& sn, const vec3d& r) {
     return (*(T*)k)(sn, r);
 }
 
+template<class T>
+inline double kernelRadiusT(void* k, const SkyNode& sn) {
+    return (*(T*)k).radius(sn);
+}
+
 struct SunPath SkyKernel
 {
-    SkyKernel() {kf = kernelFuncT<SkyKernel>;}
+    SkyKernel() {kf = kernelFuncT<SkyKernel>; rf = kernelRadiusT<SkyKernel>;}
     KernelFunc kf;
+    KernelRadiusFunc rf;
     inline double kernel(const SkyNode& sn, const vec3d& r) {return kf(this, sn, r);}
+    // |sn.v - r| beyond which the kernel of sn is zero, infinite for global support
+    inline double support(const SkyNode& sn) {return rf(this, sn);}
     double operator()(const SkyNode& /*sn*/, const vec3d& /*r*/) {return 0.;}
+    double radius(const SkyNode& /*sn*/) const {return infinity;}
 };
 
 struct SunPath SkyKernelGaussian3D: SkyKernel
 {
-    SkyKernelGaussian3D() {kf = kernelFuncT<SkyKernelGaussian3D>;}
+    SkyKernelGaussian3D() {kf = kernelFuncT<SkyKernelGaussian3D>; rf = kernelRadiusT<SkyKernelGaussian3D>;}
     double operator()(const SkyNode& sn, const vec3d& r) const;
+    double radius(const SkyNode& sn) const;
 };
 
 struct SunPath SkyKernelPolyharmonic: SkyKernel
@@ -1,27 +1,60 @@
 #include "SunPath/samplers/SunSpatial.h"
 
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <thread>
+#include <vector>
+
 #include "SunPath/samplers/SunTemporal.h"
 #include "SunPath/math/sampling/ErrorAnalysis.h"
 
 namespace sp {
 
 
-struct SkyKernelLocalized: SunFunctor
+namespace {
+
+// sky node queries per block of a worker
+const int QueryGrain = 256;
+
+// calls f(begin, end) over blocks of [0, count) on the hardware threads
+template<class F>
+void parallelFor(int count, int grain, F f)
+{
+    const int blocks = (count + grain - 1)/grain;
+    const int threads = qMin(blocks, qMax(1, int(std::thread::hardware_concurrency())));
+    if (threads <= 1) {
+        if (count > 0) f(0, count);
+        return;
+    }
+    std::atomic<int> next(0);
+    auto work = [&]() {
+        for (int b = next++; b < blocks; b = next++)
+            f(b*grain, qMin(count, (b + 1)*grain));
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t)
+        workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+} // namespace
+
+
+// the kernel of one node, zero below the horizon
+struct SkyKernelNode: SunFunctor
 {
-    SkyKernelLocalized(SkyKernel* k, QVector<SkyNode>& nodes, QVector<double> ampls):
+    SkyKernelNode(SkyKernel* k, const SkyNode& node):
         k(k),
-        nodes(nodes),
-        ampls(ampls)
+        node(node)
     {}
     SkyKernel* k;
-    QVector<SkyNode>& nodes;
-    QVector<double> ampls;
+    const SkyNode& node;
     double operator()(const vec3d& s) const {
         if (s.z <= 0.) return 0.;
-        double ans = 0.;
-        for (int n = 0; n < nodes.size(); n++)
-            ans += ampls[n]*k->kernel(nodes[n], s);
-        return ans;
+        return k->kernel(node, s);
     }
 };
 
@@ -55,19 +88,51 @@ void SunSpatial::setKernel(SkyKernel* kernel)
     m_kernel.reset(kernel);
 }
 
+/*!
+ * The kernel matrix is factorized once here, so the solves of the values
+ * and weights that follow cost a back substitution each. The nodes are
+ * also kept sorted by height, as arrays of coordinates, for interpolate.
+ */
 void SunSpatial::setSkyNodes(const QVector<SkyNode>& skyNodes)
 {
     m_skyNodes = skyNodes;
 
     int nMax = m_skyNodes.size();
+    m_matrixK.clearFactorization();
     m_matrixK.resize(nMax, nMax);
 
-    for (int n = 0; n < nMax; ++n)
-        for (int m = 0; m < nMax; ++m)
-            m_matrixK(n, m) = m_kernel->kernel(skyNodes[n], skyNodes[m].v);
+    SkyKernel* kernel = m_kernel.get();
+    double* matrix = m_matrixK.data().data(); // detached once, not by every worker
+    parallelFor(nMax, 16, [&](int begin, int end) {
+        for (int n = begin; n < end; ++n)
+            for (int m = 0; m < nMax; ++m)
+                matrix[m_matrixK.index(n, m)] = kernel->kernel(skyNodes[n], skyNodes[m].v);
+    });
+    m_matrixK.factorize();
+
+    m_order.resize(nMax);
+    std::iota(m_order.begin(), m_order.end(), 0);
+    std::sort(m_order.begin(), m_order.end(), [&](int a, int b) {
+        return skyNodes[a].v.z < skyNodes[b].v.z;
+    });
+    m_nodeX.resize(nMax);
+    m_nodeY.resize(nMax);
+    m_nodeZ.resize(nMax);
+    m_nodeSupport2.resize(nMax);
+    m_support = 0.;
+    for (int k = 0; k < nMax; ++k) {
+        const SkyNode& node = skyNodes[m_order[k]];
+        m_nodeX[k] = node.v.x;
+        m_nodeY[k] = node.v.y;
+        m_nodeZ[k] = node.v.z;
+        const double support = kernel->support(node);
+        m_nodeSupport2[k] = support*support;
+        m_support = qMax(m_support, support);
+    }
 
     m_values.fill(0., nMax);
     m_amplitudes.fill(0., nMax);
+    m_sortedAmplitudes.assign(nMax, 0.);
     m_weights.fill(1., nMax);
 }
 
@@ -76,6 +141,8 @@ void SunSpatial::setValues(const QVector<double>& values)
     Q_ASSERT(values.size() == m_skyNodes.size());
     m_values = values;
     m_amplitudes = m_matrixK.solve(values);
+    for (int k = 0; k < m_amplitudes.size(); ++k)
+        m_sortedAmplitudes[k] = m_amplitudes[m_order[k]];
 }
 
 void SunSpatial::setValues(const SunFunctor& sf)
@@ -88,15 +155,7 @@ void SunSpatial::setValues(const SunFunctor& sf)
 
 void SunSpatial::setValues(SunTemporal& sunTemporal)
 {  
-    QVector<double> overlapsW;
-    int pMax = m_skyNodes.size();
-    for (int p = 0; p < pMax; p++) {
-        QVector<double> values(pMax, 0.);
-        values[p] = 1.;
-        QVector<double> amplitudes = m_matrixK.solve(values);
-        SkyKernelLocalized sk(m_kernel.get(), m_skyNodes, amplitudes);
-        overlapsW << sunTemporal.integrateWeighted(sk);
-    }
+    QVector<double> overlapsW = findOverlaps(sunTemporal);
 
 //    int nMax = m_skyNodes.size();
 //    MatrixNR matrixKK(nMax, nMax);
@@ -144,17 +203,28 @@ void SunSpatial::setValues(SunTemporal& sunTemporal)
 //        m_values << interpolate(sn.v);
 }
 
+/*!
+ * The interpolant of the unit value at node p has the amplitudes of column
+ * p of the inverse kernel matrix K, so the integrals of all of them are
+ * the solution of the transposed system with the integrals of the kernels
+ * of the nodes, each integrated once.
+ */
+QVector<double> SunSpatial::findOverlaps(SunTemporal& sunTemporal)
+{
+    int nMax = m_skyNodes.size();
+    QVector<double> integrals(nMax, 0.);
+    double* integral = integrals.data();
+    SkyKernel* kernel = m_kernel.get();
+    parallelFor(nMax, 1, [&](int begin, int end) {
+        for (int n = begin; n < end; ++n)
+            integral[n] = sunTemporal.integrateWeighted(SkyKernelNode(kernel, m_skyNodes[n]));
+    });
+    return m_matrixK.solveTransposed(integrals);
+}
+
 void SunSpatial::setWeights(SunTemporal& sunTemporal, bool normalize)
 {
-    QVector<double> overlaps;
-    int pMax = m_skyNodes.size();
-    for (int p = 0; p < pMax; p++) {
-        QVector<double> values(pMax, 0.);
-        values[p] = 1.;
-        QVector<double> amplitudes = m_matrixK.solve(values);
-        SkyKernelLocalized sk(m_kernel.get(), m_skyNodes, amplitudes);
-        overlaps << sunTemporal.integrateWeighted(sk);
-    }
+    QVector<double> overlaps = findOverlaps(sunTemporal);
 
     QVector<double> weights = overlaps;
     if (normalize) {
@@ -167,11 +237,40 @@ void SunSpatial::setWeights(SunTemporal& sunTemporal, bool normalize)
     m_weights = weights;
 }
 
+/*!
+ * For unit vectors |v - r| is at least their difference in height, so of
+ * kernels with compact support only the nodes within the widest support in
+ * height are evaluated, and of those the ones whose support holds v.
+ */
 double SunSpatial::interpolate(const vec3d& v) const
 {
+    int begin = 0;
+    int end = int(m_nodeZ.size());
+    if (std::isfinite(m_support)) {
+        begin = int(std::lower_bound(m_nodeZ.begin(), m_nodeZ.end(), v.z - m_support) - m_nodeZ.begin());
+        end = int(std::upper_bound(m_nodeZ.begin(), m_nodeZ.end(), v.z + m_support) - m_nodeZ.begin());
+    }
+
+    SkyKernel* kernel = m_kernel.get();
     double ans = 0.;
-    for (int n = 0; n < m_skyNodes.size(); ++n)
-        ans += m_amplitudes[n]*m_kernel->kernel(m_skyNodes[n], v);
+    for (int k = begin; k < end; ++k) {
+        const double dx = m_nodeX[k] - v.x;
+        const double dy = m_nodeY[k] - v.y;
+        const double dz = m_nodeZ[k] - v.z;
+        if (dx*dx + dy*dy + dz*dz > m_nodeSupport2[k]) continue;
+        ans += m_sortedAmplitudes[k]*kernel->kernel(m_skyNodes[m_order[k]], v);
+    }
+    return ans;
+}
+
+QVector<double> SunSpatial::interpolate(const QVector<vec3d>& vs) const
+{
+    QVector<double> ans(vs.size(), 0.);
+    double* values = ans.data();
+    parallelFor(vs.size(), QueryGrain, [&](int begin, int end) {
+        for (int n = begin; n < end; ++n)
+            values[n] = interpolate(vs[n]);
+    });
     return ans;
 }
 
@@ -3,6 +3,8 @@
 #include <QSharedPointer>
 #include <QScopedPointer>
 
+#include <vector>
+
 #include "SunPath/samplers/SkyKernels.h"
 #include "SunPath/data/SunFunctor.h"
 #include "SunPath/math/matrices/MatrixNR.h"
@@ -34,6 +36,8 @@ public:
     const QVector<double>& weights() const {return m_weights;}
 
     double interpolate(const vec3d& v) const;
+    // at every vector, on the hardware threads
+    QVector<double> interpolate(const QVector<vec3d>& vs) const;
     double integrate() const; // weighted
     double average() const;
 
@@ -52,7 +56,19 @@ protected:
     QVector<double> m_amplitudes;
     QVector<double> m_weights;
 
-    MatrixNR m_matrixK;
+    MatrixNR m_matrixK; // factorized
+
+    // the nodes sorted by height, as arrays for interpolate
+    std::vector<int> m_order;
+    std::vector<double> m_nodeX;
+    std::vector<double> m_nodeY;
+    std::vector<double> m_nodeZ;
+    std::vector<double> m_nodeSupport2; // squared
+    std::vector<double> m_sortedAmplitudes;
+    double m_support = 0.; // widest, of SkyKernel::support
+
+    // integrals of the interpolants of the unit value at every node
+    QVector<double> findOverlaps(SunTemporal& sunTemporal);
 };
 
 
@@ -80,6 +80,41 @@ double SunTemporal::interpolate(QDateTime t) const
     return m_interpolator->derivative(x);
 }
 
+/*!
+ * The hours of the year are the seconds since the start of the year over
+ * 3600, so a QDateTime is made only when a time falls in another year. In
+ * local time the hours of toHours follow the clock, and every time is
+ * converted.
+ */
+QVector<double> SunTemporal::interpolate(const QVector<qint64>& seconds) const
+{
+    QVector<double> hours(seconds.size());
+    QDateTime t = m_timeStamps.first().t;
+    const bool fixedOffset = t.timeSpec() == Qt::UTC || t.timeSpec() == Qt::OffsetFromUTC;
+    qint64 yearBegin = 0;
+    qint64 yearEnd = 0; // the year of the last conversion, [begin, end)
+    for (int n = 0; n < seconds.size(); ++n) {
+        if (!fixedOffset) {
+            t.setSecsSinceEpoch(seconds[n]);
+            hours[n] = toHours(t);
+            continue;
+        }
+        if (seconds[n] < yearBegin || seconds[n] >= yearEnd) {
+            t.setSecsSinceEpoch(seconds[n]);
+            QDateTime begin = t;
+            begin.setDate(QDate(t.date().year(), 1, 1));
+            begin.setTime(QTime(0, 0));
+            yearBegin = begin.toSecsSinceEpoch();
+            yearEnd = begin.addYears(1).toSecsSinceEpoch();
+        }
+        hours[n] = (seconds[n] - yearBegin)/3600.;
+    }
+
+    QVector<double> ans(seconds.size());
+    m_interpolator->derivative(hours.constData(), hours.size(), ans.data());
+    return ans;
+}
+
 double SunTemporal::integrate() const
 {
     return m_interpolator->data().last().y;
@@ -109,6 +144,18 @@ double SunTemporal::average(QDateTime tA, QDateTime tB) const
     return (yB - yA)/(xB - xA);
 }
 
+double SunTemporal::integrateWeighted(const QVector<double>& values) const
+{
+    Q_ASSERT(values.size() == m_timeStamps.size());
+    Summator sum;
+    for (int n = 1; n < m_timeStamps.size(); ++n) {
+        double w = m_data[n - 1];
+        double f = values[n - 1] + values[n];
+        sum += w*f/2.;
+    }
+    return sum.result()*m_timeStepH;
+}
+
 double SunTemporal::integrateWeighted(const SunFunctor& sf) const
 {
     Summator sum;
@@ -26,6 +26,8 @@ public:
     const QVector<double>& data() const {return m_data;}
 
     double interpolate(QDateTime t) const;
+    // at times in seconds since the epoch, in the time zone of the time stamps
+    QVector<double> interpolate(const QVector<qint64>& seconds) const;
 
     double integrate() const;
     double integrate(QDateTime tA, QDateTime tB) const;
@@ -34,6 +36,8 @@ public:
     double average(QDateTime tA, QDateTime tB) const;
 
     double integrateWeighted(const SunFunctor& sf) const;
+    // of values at the time stamps
+    double integrateWeighted(const QVector<double>& values) const;
 
 protected:
     QSharedPointer<SunCalculator> m_calculator;
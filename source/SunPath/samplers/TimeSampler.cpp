@@ -66,10 +66,11 @@ QVector<TimeStamp> TimeSampler::makeSamples(const QVector<QDateTime>& ts)
     QVector<TimeStamp> ans;
 
     SunCalculator* sc = m_sunTemporal->calculator();
+    QVector<vec3d> ss = sc->findVectors(ts);
     double th = toHours(ts[0]);
     double dt = toHours(ts[1]) - th;
-    for (const QDateTime& t : ts) {
-        ans << TimeStamp(t, sc->findVector(t), th);
+    for (int n = 0; n < ts.size(); ++n) {
+        ans << TimeStamp(ts[n], ss[n], th);
         th += dt;
 //        ans << TimeStamp(t, sc->findVector(t), toHours(t));
 //        qDebug() << t << " " << sc->findHorizontalV(t).elevation()/sp::degree << toHours(t);
@@ -82,9 +83,15 @@ QVector<TimeStamp> TimeSampler::makeSamples(QDateTime tA, QDateTime tB, QTime tS
     QVector<TimeStamp> ans;
 
     int dt = tStep.msecsSinceStartOfDay();
-    SunCalculator* sc = m_sunTemporal->calculator();
+    QVector<QDateTime> ts;
     for (QDateTime t = tA; t <= tB; t = t.addMSecs(dt))
-        ans << TimeStamp(t, sc->findVector(t), toHours(t));
+        ts << t;
+
+    SunCalculator* sc = m_sunTemporal->calculator();
+    QVector<vec3d> ss = sc->findVectors(ts);
+    ans.reserve(ts.size());
+    for (int n = 0; n < ts.size(); ++n)
+        ans << TimeStamp(ts[n], ss[n], toHours(ts[n]));
 
     return ans;
 }
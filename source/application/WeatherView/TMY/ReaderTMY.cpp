@@ -370,10 +370,17 @@ double ReaderTMY::calculateDNIbelow(double origin)
     Location location("", latitude, longitude, offsetUTC);
     sunCalc->setLocation(location);
 
+    QVector<QDateTime> ts;
+    ts.reserve(m_data.size() + 1);
+    ts << m_data[0].time.addSecs(-offsetUTC + endTMY - tStep);
+    for (int n = 0; n < m_data.size(); n++)
+        ts << m_data[n].time.addSecs(-offsetUTC + endTMY);
+    QVector<sp::Horizontal> hcs = sunCalc->findHorizontalsV(ts);
+
     double dniBelow = 0.;
-    sp::Horizontal hcA = sunCalc->findHorizontalV(m_data[0].time.addSecs(-offsetUTC + endTMY - tStep));
+    sp::Horizontal hcA = hcs[0];
     for (int n = 0; n < m_data.size(); n++) {
-        sp::Horizontal hcB = sunCalc->findHorizontalV(m_data[n].time.addSecs(-offsetUTC + endTMY));
+        sp::Horizontal hcB = hcs[n + 1];
         if (hcA.elevation() < 0 && hcB.elevation() < 0.)
             dniBelow += m_data[n].DNI;
         hcA = hcB;
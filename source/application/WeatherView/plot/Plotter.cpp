@@ -3,7 +3,12 @@
 #include "qcustomplot/qcustomplot.h"
 #include "../TMY/ParameterItem.h"
 
-Plotter::Plotter(QCustomPlot* cp)
+Plotter::Plotter(QCustomPlot* cp):
+    m_bars(0),
+    m_model(0),
+    m_tStep(1.),
+    m_tOrigin(0.),
+    m_x0(0.)
 {
     m_customPlot = cp;
     m_customPlot->axisRect()->setupFullAxesBox(true);
@@ -55,6 +60,15 @@ m_customPlot->axisRect()->setMargins(QMargins(50,30,30,50));
     //dateTimeTicker->setDateTimeFormat("d. MMM\nyyyy")
     xAxis->setRange(0, 24*3600);
     yAxis->setRange(0, 1);
+
+    // the bars of the visible range are picked before each replot
+    m_rangeChanged = QObject::connect(xAxis, QOverload<const QCPRange&>::of(&QCPAxis::rangeChanged),
+        [this](const QCPRange&) {updateBars();});
+}
+
+Plotter::~Plotter()
+{
+    QObject::disconnect(m_rangeChanged);
 }
 
 void Plotter::makePlot(ModelTMY* md)
@@ -83,18 +97,39 @@ void Plotter::makePlot(ModelTMY* md)
         ys << format->data()[nf].DNI;
     }
 
+    m_summary.setData(xs, ys);
+
     m_customPlot->clearPlottables();
-    QCPBars* bars = new QCPBars(m_customPlot->xAxis, m_customPlot->yAxis);
-    bars->setWidth(0.9*m_tStep);
-    bars->setData(xs, ys);
-    bars->setPen(Qt::NoPen);
-    bars->setBrush(QBrush("#ccbb95"));
+    m_bars = new QCPBars(m_customPlot->xAxis, m_customPlot->yAxis);
+    m_bars->setPen(Qt::NoPen);
+    m_bars->setBrush(QBrush("#ccbb95"));
 
     resetPlot();
 }
 
+// bars of the visible range from the summary: one for the maximum of
+// each bucket, and one for its minimum where it is below zero
+void Plotter::updateBars()
+{
+    if (!m_bars) return;
+    QCPRange range = m_customPlot->xAxis->range();
+    QVector<double> xs, yMins, yMaxs;
+    int level = m_summary.query(range.lower, range.upper, m_customPlot->axisRect()->width(), &xs, &yMins, &yMaxs);
+
+    QVector<double> keys = xs;
+    QVector<double> values = yMaxs;
+    for (int n = 0; n < xs.size(); ++n) {
+        if (yMins[n] >= 0. || yMins[n] == yMaxs[n]) continue;
+        keys << xs[n];
+        values << yMins[n];
+    }
+    m_bars->setWidth(0.9*m_tStep*(1 << level));
+    m_bars->setData(keys, values);
+}
+
 void Plotter::resetPlot()
 {
+    if (!m_model) return;
     double xMin = m_model->filter().stampA;
     double xMax = m_model->filter().stampB;
 
@@ -1,8 +1,12 @@
 #pragma once
 
+class QCPBars;
 class QCustomPlot;
 
+#include <QMetaObject>
+
 #include "TMY/ModelTMY.h"
+#include "SeriesSummary.h"
 
 
 
@@ -10,6 +14,7 @@ class Plotter
 {
 public:
     Plotter(QCustomPlot* customPlot);
+    ~Plotter();
 
     void makePlot(ModelTMY* model);
     void resetPlot();
@@ -20,7 +25,12 @@ public:
     double tStep() {return m_tStep;}
 
 private:
+    void updateBars();
+
     QCustomPlot* m_customPlot;
+    QCPBars* m_bars;
+    SeriesSummary m_summary; // of the bars, drawn a few per pixel
+    QMetaObject::Connection m_rangeChanged;
     ModelTMY* m_model;
     double m_tStep;
     double m_tOrigin;
@@ -0,0 +1,70 @@
+#include "SeriesSummary.h"
+
+#include <algorithm>
+#include <numeric>
+
+
+void SeriesSummary::setData(const QVector<double>& xs, const QVector<double>& ys)
+{
+    m_levels.clear();
+    int nMax = std::min(xs.size(), ys.size());
+    if (nMax == 0) return;
+
+    QVector<int> order(nMax);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&xs](int a, int b) {return xs[a] < xs[b];});
+
+    Level level;
+    level.xa.reserve(nMax);
+    level.yMin.reserve(nMax);
+    for (int n : order) {
+        level.xa << xs[n];
+        level.yMin << ys[n];
+    }
+    level.xb = level.xa;
+    level.yMax = level.yMin;
+    m_levels << level;
+
+    while (m_levels.last().xa.size() > 1) {
+        const Level& fine = m_levels.last();
+        int mMax = fine.xa.size();
+        Level coarse;
+        for (int m = 0; m < mMax; m += 2) {
+            int k = std::min(m + 1, mMax - 1);
+            coarse.xa << fine.xa[m];
+            coarse.xb << fine.xb[k];
+            coarse.yMin << std::min(fine.yMin[m], fine.yMin[k]);
+            coarse.yMax << std::max(fine.yMax[m], fine.yMax[k]);
+        }
+        m_levels << coarse;
+    }
+}
+
+int SeriesSummary::query(double xMin, double xMax, int pixels,
+                         QVector<double>* xs, QVector<double>* yMins, QVector<double>* yMaxs) const
+{
+    xs->clear();
+    yMins->clear();
+    yMaxs->clear();
+    if (m_levels.isEmpty() || !(xMin <= xMax)) return 0;
+    pixels = std::max(pixels, 1);
+
+    // samples in view at full resolution
+    const QVector<double>& keys = m_levels[0].xa;
+    int count = int(std::upper_bound(keys.begin(), keys.end(), xMax) -
+                    std::lower_bound(keys.begin(), keys.end(), xMin));
+
+    int n = 0;
+    while (n + 1 < m_levels.size() && (count >> n) > 2*pixels) n++;
+    const Level& level = m_levels[n];
+
+    // buckets ending before the range or starting after it are out
+    int a = int(std::lower_bound(level.xb.begin(), level.xb.end(), xMin) - level.xb.begin());
+    int b = int(std::upper_bound(level.xa.begin(), level.xa.end(), xMax) - level.xa.begin());
+    for (int m = a; m < b; ++m) {
+        *xs << (level.xa[m] + level.xb[m])/2;
+        *yMins << level.yMin[m];
+        *yMaxs << level.yMax[m];
+    }
+    return n;
+}
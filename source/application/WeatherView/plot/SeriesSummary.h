@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QVector>
+
+//! SeriesSummary keeps a long series at every power of two of resolution.
+/*!
+ * Level n merges 2^n consecutive samples into one bucket with their
+ * minimum and maximum, so a view of any span is answered from the level
+ * whose buckets are about as wide as a pixel: the points drawn stay a few
+ * per pixel of the plot whatever the length of the series, and drawing
+ * the extremes of each bucket keeps the peaks that plain skipping loses.
+ */
+class SeriesSummary
+{
+public:
+    // xs need not be sorted
+    void setData(const QVector<double>& xs, const QVector<double>& ys);
+    void clear() {m_levels.clear();}
+    bool isEmpty() const {return m_levels.isEmpty();}
+
+    // buckets over [xMin, xMax] for a plot of the given width in pixels,
+    // the first and last of them may overlap the range; returns the level
+    int query(double xMin, double xMax, int pixels,
+              QVector<double>* xs, QVector<double>* yMins, QVector<double>* yMaxs) const;
+
+private:
+    struct Level
+    {
+        QVector<double> xa; // first key of each bucket
+        QVector<double> xb; // last key
+        QVector<double> yMin;
+        QVector<double> yMax;
+    };
+
+    QVector<Level> m_levels;
+};
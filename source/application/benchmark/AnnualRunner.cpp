@@ -0,0 +1,558 @@
+#include "AnnualRunner.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+
+#include "core/RayTraceRunner.h"
+#include "kernel/run/FluxAccumulator.h"
+#include "kernel/scene/TSceneKit.h"
+#include "kernel/sun/SunPosition.h"
+#include "SunPath/calculators/SunCalculatorMB.h"
+#include "SunPath/data/FormatTMY.h"
+#include "SunPath/samplers/SkySampler.h"
+#include "SunPath/samplers/SunSpatial.h"
+#include "SunPath/samplers/SunTemporal.h"
+
+namespace
+{
+struct AnnualConfig
+{
+    QString sceneFile;
+    QString tmyFile;
+    QString targetSurface;
+    int targetSideId = 1;
+    ulong rays = 1000000;
+    ulong seed = 123456789;
+    int workerCount = 0;
+    ulong chunkSize = 0;
+    QString randomGenerator = "stl";
+    double skyResolutionDeg = 5.;
+    int kernelOrder = 6;
+    bool symmetricEastWest = true;
+    // "nodes" traces every node with rays, "multilevel" corrects a coarse
+    // level at every node by fine traces of sampled nodes
+    QString estimator = "nodes";
+    QString coarseModel = "convolution";
+    ulong coarseRays = 0; // 0 takes a sixteenth of rays
+    double targetRelativeError = 0.01;
+    int pilotCorrections = 8;
+    int maxCorrections = 64;
+    QString outputFile = "annual_result.json";
+};
+
+// rounds of fine corrections after the pilot
+const int MaxCorrectionRounds = 4;
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+
+QString resolveRelativePath(const QDir& baseDir, const QString& path)
+{
+    QFileInfo info(path);
+    if (info.isAbsolute())
+        return info.absoluteFilePath();
+    return QFileInfo(baseDir.absoluteFilePath(path)).absoluteFilePath();
+}
+
+bool parseString(const QJsonObject& object, const QString& name, bool required, QString* value, QString* errorMessage)
+{
+    if (!object.contains(name))
+        return required ? fail(errorMessage, QString("%1 is required.").arg(name)) : true;
+    if (!object.value(name).isString() || object.value(name).toString().trimmed().isEmpty())
+        return fail(errorMessage, QString("%1 must be a non-empty string.").arg(name));
+    *value = object.value(name).toString();
+    return true;
+}
+
+bool parseNumber(const QJsonObject& object, const QString& name, bool integer, double minimum, double maximum, double* value, QString* errorMessage)
+{
+    if (!object.contains(name))
+        return true;
+    const double parsed = object.value(name).toDouble(std::numeric_limits<double>::quiet_NaN());
+    if (!object.value(name).isDouble() || !std::isfinite(parsed) || (integer && std::floor(parsed) != parsed) || parsed < minimum || parsed > maximum)
+        return fail(errorMessage, QString("%1 must be %2 from %3 to %4.").arg(name, integer ? "an integer" : "a number").arg(minimum).arg(maximum));
+    *value = parsed;
+    return true;
+}
+
+bool parseConfig(const QString& configFileName, AnnualConfig* config, QString* errorMessage)
+{
+    QFile file(configFileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(errorMessage, QString("Cannot open %1: %2").arg(configFileName, file.errorString()));
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError)
+        return fail(errorMessage, QString("Cannot parse %1: %2").arg(configFileName, parseError.errorString()));
+    if (!document.isObject())
+        return fail(errorMessage, QString("%1 must contain a JSON object.").arg(configFileName));
+    const QJsonObject object = document.object();
+
+    AnnualConfig parsed;
+    double rays = static_cast<double>(parsed.rays);
+    double seed = static_cast<double>(parsed.seed);
+    double workerCount = parsed.workerCount;
+    double chunkSize = static_cast<double>(parsed.chunkSize);
+    double targetSideId = parsed.targetSideId;
+    double kernelOrder = parsed.kernelOrder;
+    double coarseRays = static_cast<double>(parsed.coarseRays);
+    double pilotCorrections = parsed.pilotCorrections;
+    double maxCorrections = parsed.maxCorrections;
+    const double maxULong = static_cast<double>(std::numeric_limits<ulong>::max());
+    if (!parseString(object, "scene_file", true, &parsed.sceneFile, errorMessage) ||
+        !parseString(object, "tmy_file", true, &parsed.tmyFile, errorMessage) ||
+        !parseString(object, "target_surface", true, &parsed.targetSurface, errorMessage) ||
+        !parseString(object, "output_file", false, &parsed.outputFile, errorMessage) ||
+        !parseString(object, "random_generator", false, &parsed.randomGenerator, errorMessage) ||
+        !parseNumber(object, "target_side_id", true, 0., 1., &targetSideId, errorMessage) ||
+        !parseNumber(object, "rays", true, 1., maxULong, &rays, errorMessage) ||
+        !parseNumber(object, "seed", true, 0., maxULong, &seed, errorMessage) ||
+        !parseNumber(object, "worker_count", true, 1., std::numeric_limits<int>::max(), &workerCount, errorMessage) ||
+        !parseNumber(object, "chunk_size", true, 1., maxULong, &chunkSize, errorMessage) ||
+        !parseNumber(object, "sky_resolution_deg", false, 0.1, 90., &parsed.skyResolutionDeg, errorMessage) ||
+        !parseNumber(object, "kernel_order", true, 1., 20., &kernelOrder, errorMessage) ||
+        !parseString(object, "estimator", false, &parsed.estimator, errorMessage) ||
+        !parseString(object, "coarse_model", false, &parsed.coarseModel, errorMessage) ||
+        !parseNumber(object, "coarse_rays", true, 1., maxULong, &coarseRays, errorMessage) ||
+        !parseNumber(object, "target_relative_error", false, 1e-6, 1., &parsed.targetRelativeError, errorMessage) ||
+        !parseNumber(object, "pilot_corrections", true, 2., 1e6, &pilotCorrections, errorMessage) ||
+        !parseNumber(object, "max_corrections", true, 2., 1e6, &maxCorrections, errorMessage))
+        return false;
+    if (parsed.estimator != "nodes" && parsed.estimator != "multilevel")
+        return fail(errorMessage, "estimator must be \"nodes\" or \"multilevel\".");
+    if (parsed.coarseModel != "convolution" && parsed.coarseModel != "monte_carlo")
+        return fail(errorMessage, "coarse_model must be \"convolution\" or \"monte_carlo\".");
+    if (maxCorrections < pilotCorrections)
+        return fail(errorMessage, "max_corrections must not be less than pilot_corrections.");
+    if (parsed.randomGenerator != "stl" && parsed.randomGenerator != "philox" &&
+        parsed.randomGenerator != "philox_ray" && parsed.randomGenerator != "sobol")
+        return fail(errorMessage, "random_generator must be \"stl\", \"philox\", \"philox_ray\" or \"sobol\".");
+    if (object.contains("symmetric_east_west")) {
+        if (!object.value("symmetric_east_west").isBool())
+            return fail(errorMessage, "symmetric_east_west must be true or false.");
+        parsed.symmetricEastWest = object.value("symmetric_east_west").toBool();
+    }
+    parsed.rays = static_cast<ulong>(rays);
+    parsed.seed = static_cast<ulong>(seed);
+    parsed.workerCount = static_cast<int>(workerCount);
+    parsed.chunkSize = static_cast<ulong>(chunkSize);
+    parsed.targetSideId = static_cast<int>(targetSideId);
+    parsed.kernelOrder = static_cast<int>(kernelOrder);
+    parsed.coarseRays = static_cast<ulong>(coarseRays);
+    parsed.pilotCorrections = static_cast<int>(pilotCorrections);
+    parsed.maxCorrections = static_cast<int>(maxCorrections);
+
+    if (config)
+        *config = parsed;
+    return true;
+}
+
+RayTraceOptions makeTraceOptions(const AnnualConfig& config)
+{
+    RayTraceOptions options;
+    options.rays = config.rays;
+    options.seed = config.seed;
+    options.workerCount = config.workerCount > 0 ? config.workerCount : qMax(1, QThread::idealThreadCount());
+    options.chunkSize = config.chunkSize > 0 ? config.chunkSize : 10000;
+    if (config.randomGenerator == "philox")
+        options.randomGenerator = RayTraceRandomGenerator::CounterBased;
+    else if (config.randomGenerator == "philox_ray")
+        options.randomGenerator = RayTraceRandomGenerator::RayIndexed;
+    else if (config.randomGenerator == "sobol")
+        options.randomGenerator = RayTraceRandomGenerator::QuasiRandom;
+    options.outputMode = RayTraceOutputMode::FluxGrid;
+    return options;
+}
+
+// the effective area of the target at each of the sun positions of options,
+// hits times the aperture area per ray, traced as one batch
+bool traceAreas(TSceneKit* scene, const AnnualConfig& config, RayTraceOptions options,
+                QVector<double>* areas, QVector<RayTraceResult>* positionResults, RayTraceResult* traceResult,
+                QTextStream& out, QString* errorMessage)
+{
+    FluxAccumulator flux;
+    flux.addTarget(config.targetSurface, config.targetSideId != 0, 1, 1);
+    options.fluxAccumulator = &flux;
+
+    areas->clear();
+    positionResults->clear();
+    auto positionDone = [&](int, const RayTraceResult& positionResult) {
+        const double hits = static_cast<double>(flux.getHits(0));
+        *areas << hits*positionResult.sunApertureArea/options.rays;
+        *positionResults << positionResult;
+        flux.clear();
+    };
+
+    RayTraceRunner runner;
+    QString traceError;
+    if (!runner.trace(scene, options, traceResult, &traceError, [&out](const QString& message) {
+            out << message << Qt::endl;
+        }, RayTraceRunner::HitCallback(), RayTraceRunner::WorkerHitCallbackFactory(), RayTraceRunner::CancellationCallback(), positionDone))
+        return fail(errorMessage, QString("Annual trace failed: %1").arg(traceError));
+    if (positionResults->size() != options.sunPositions.size())
+        return fail(errorMessage, "Annual trace did not complete all sun positions.");
+    return true;
+}
+
+// the effective area at each sun position by the convolution model, the
+// power of the reflector images over the irradiance; the sun is restored after
+bool convolutionAreas(TSceneKit* scene, const AnnualConfig& config, const QVector<RayTraceSunPosition>& positions,
+                      QVector<double>* areas, double* seconds, QString* errorMessage)
+{
+    SunPosition* sunPosition = static_cast<SunPosition*>(scene->getPart("world.sun.position", false));
+    if (!sunPosition)
+        return fail(errorMessage, "Scene has no sun position.");
+    const double azimuth = sunPosition->azimuth.getValue();
+    const double elevation = sunPosition->elevation.getValue();
+
+    RayTraceOptions options = makeTraceOptions(config);
+    options.fluxModel = RayTraceFluxModel::Convolution;
+    bool ok = true;
+    areas->clear();
+    *seconds = 0.;
+    for (const RayTraceSunPosition& position : positions) {
+        sunPosition->azimuth = position.azimuth;
+        sunPosition->elevation = position.elevation;
+        scene->updateTrackers(false);
+
+        FluxAccumulator flux;
+        flux.addTarget(config.targetSurface, config.targetSideId != 0, 1, 1);
+        options.fluxAccumulator = &flux;
+        RayTraceResult result;
+        QString traceError;
+        RayTraceRunner runner;
+        if (!runner.trace(scene, options, &result, &traceError)) {
+            ok = fail(errorMessage, QString("Annual convolution failed: %1").arg(traceError));
+            break;
+        }
+        *areas << (result.irradiance > 0. ? flux.getTotalWeight(0)/result.irradiance : 0.);
+        *seconds += result.elapsedSeconds;
+    }
+
+    sunPosition->azimuth = azimuth;
+    sunPosition->elevation = elevation;
+    scene->updateTrackers(true);
+    return ok;
+}
+
+bool writeResult(const QString& outputFileName, const QJsonObject& result, QString* errorMessage)
+{
+    QFileInfo info(outputFileName);
+    QDir dir;
+    if (!dir.mkpath(info.absolutePath()))
+        return fail(errorMessage, QString("Cannot create output directory %1.").arg(info.absolutePath()));
+
+    QSaveFile file(outputFileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(errorMessage, QString("Cannot open output file %1: %2").arg(outputFileName, file.errorString()));
+    file.write(QJsonDocument(result).toJson(QJsonDocument::Indented));
+    if (!file.commit())
+        return fail(errorMessage, QString("Cannot write output file %1: %2").arg(outputFileName, file.errorString()));
+    return true;
+}
+}
+
+/*!
+ * Reads the DNI of a TMY file, samples sky nodes over the sun path of its
+ * location and traces the nodes above the horizon as one batch of sun
+ * positions. The effective area of the target at each node, hits times the
+ * aperture area per ray, is interpolated over the sky and integrated with
+ * the DNI over the year.
+ *
+ * The multilevel estimator takes the areas of every node from a cheap coarse
+ * level, the convolution model or a trace with few rays, and adds the node
+ * sum of the fine minus coarse areas estimated from nodes drawn with
+ * probabilities by their coarse energy. Draws are added until the standard
+ * error of the sum reaches the target, so most nodes are never traced with
+ * the full rays.
+ */
+int AnnualRunner::run(const QString& configFileName, TSceneKit* scene, QString* errorMessage, QString* output) const
+{
+    QTextStream out(stdout);
+    if (output)
+        out.setString(output);
+
+    AnnualConfig config;
+    if (!parseConfig(configFileName, &config, errorMessage))
+        return 1;
+    if (!scene)
+        return fail(errorMessage, "Scene is not loaded."), 1;
+
+    const QDir configDir = QFileInfo(configFileName).absoluteDir();
+    const QString sceneFileName = resolveRelativePath(configDir, config.sceneFile);
+    const QString tmyFileName = resolveRelativePath(configDir, config.tmyFile);
+    const QString outputFileName = resolveRelativePath(configDir, config.outputFile);
+
+    out << "Running annual yield." << Qt::endl;
+    out << "scene_file: " << sceneFileName << Qt::endl;
+    out << "tmy_file: " << tmyFileName << Qt::endl;
+    out << "target_surface: " << config.targetSurface << Qt::endl;
+    out << "rays: " << config.rays << Qt::endl;
+
+    sp::SunCalculatorMB calculator;
+    sp::SunTemporal temporal(calculator);
+    sp::FormatTMY format(&temporal);
+    if (!format.read(tmyFileName))
+        return fail(errorMessage, QString("Cannot read TMY file %1: %2").arg(tmyFileName, format.message())), 1;
+
+    sp::SunCalculator::setObliquity(23.4*sp::degree);
+    sp::SunSpatial spatial(*temporal.calculator());
+    spatial.setKernel(new sp::SkyKernelPolyharmonic(config.kernelOrder));
+    sp::SkySampler sampler(&spatial);
+    sampler.sample(config.skyResolutionDeg*sp::degree, 0., config.symmetricEastWest);
+    const QVector<sp::SkyNode>& nodes = spatial.skyNodes();
+    if (nodes.isEmpty())
+        return fail(errorMessage, "No sky nodes were sampled for the TMY location."), 1;
+    spatial.setWeights(temporal);
+
+    // nodes on or below the horizon see nothing
+    RayTraceOptions options;
+    QVector<int> nodeOfPosition;
+    QVector<sp::Horizontal> horizontals;
+    for (int n = 0; n < nodes.size(); ++n) {
+        const sp::Horizontal hc = temporal.calculator()->findHorizontal(nodes[n].v);
+        horizontals << hc;
+        if (hc.elevation() <= 0.) continue;
+        RayTraceSunPosition position;
+        position.azimuth = hc.azimuth()/sp::degree;
+        position.elevation = hc.elevation()/sp::degree;
+        options.sunPositions << position;
+        nodeOfPosition << n;
+    }
+    if (options.sunPositions.isEmpty())
+        return fail(errorMessage, "No sampled sun position is above the horizon."), 1;
+    out << "sky_nodes: " << nodes.size() << Qt::endl;
+    out << "sun_positions: " << options.sunPositions.size() << Qt::endl;
+
+    const RayTraceOptions traceOptions = makeTraceOptions(config);
+    QVector<double> positionAreas;
+    QVector<RayTraceResult> positionResults;
+    RayTraceResult traceResult;
+    const bool multilevel = config.estimator == "multilevel";
+
+    // the estimate of the node sum, its variance, and the correction of the coarse level
+    double coarseVariance = 0.;
+    double correction = 0.;
+    double correctionVariance = 0.;
+    int corrections = 0;
+    ulong coarseRays = 0;
+    double coarseSeconds = 0.;
+    double fineSeconds = 0.;
+    QHash<int, double> fineAreas; // by position
+    if (!multilevel) {
+        RayTraceOptions positionOptions = traceOptions;
+        positionOptions.sunPositions = options.sunPositions;
+        if (!traceAreas(scene, config, positionOptions, &positionAreas, &positionResults, &traceResult, out, errorMessage))
+            return 1;
+    } else {
+        const QVector<double>& weights = spatial.weights();
+        if (config.coarseModel == "convolution") {
+            out << "Tracing the coarse level by convolution." << Qt::endl;
+            if (!convolutionAreas(scene, config, options.sunPositions, &positionAreas, &coarseSeconds, errorMessage))
+                return 1;
+        } else {
+            coarseRays = config.coarseRays > 0 ? config.coarseRays : qMax<ulong>(1, config.rays/16);
+            out << "Tracing the coarse level with " << coarseRays << " rays." << Qt::endl;
+            RayTraceOptions coarseOptions = traceOptions;
+            coarseOptions.rays = coarseRays;
+            coarseOptions.sunPositions = options.sunPositions;
+            if (!traceAreas(scene, config, coarseOptions, &positionAreas, &positionResults, &traceResult, out, errorMessage))
+                return 1;
+            coarseSeconds = traceResult.elapsedSeconds;
+            // binomial variance of the hits of every node
+            for (int p = 0; p < positionAreas.size(); ++p) {
+                const double aperture = positionResults[p].sunApertureArea;
+                const double q = aperture > 0. ? qBound(0., positionAreas[p]/aperture, 1.) : 0.;
+                const double w = weights[nodeOfPosition[p]];
+                coarseVariance += w*w*aperture*aperture*q*(1. - q)/coarseRays;
+            }
+            positionResults.clear();
+        }
+
+        // nodes drawn by their coarse share of the energy, with a floor so
+        // every node above the horizon can be drawn
+        double coarseSum = 0.;
+        double meanArea = 0.;
+        for (int p = 0; p < positionAreas.size(); ++p) {
+            coarseSum += weights[nodeOfPosition[p]]*positionAreas[p];
+            meanArea += positionAreas[p]/positionAreas.size();
+        }
+        std::vector<double> probabilities;
+        double probabilitySum = 0.;
+        for (int p = 0; p < positionAreas.size(); ++p) {
+            probabilities.push_back(weights[nodeOfPosition[p]]*(qMax(0., positionAreas[p]) + 0.01*meanArea + 1e-12));
+            probabilitySum += probabilities.back();
+        }
+        for (double& probability : probabilities)
+            probability /= probabilitySum;
+        std::mt19937_64 generator(config.seed ^ 0x2545f4914f6cdd1dull);
+        std::discrete_distribution<int> draw(probabilities.begin(), probabilities.end());
+
+        // Hansen-Hurwitz estimate of the node sum of the fine minus coarse areas
+        QVector<int> samples;
+        int wanted = config.pilotCorrections;
+        for (int round = 0; ; ++round) {
+            while (samples.size() < wanted)
+                samples << draw(generator);
+            RayTraceOptions fineOptions = traceOptions;
+            QVector<int> traced;
+            for (int p : samples) {
+                if (fineAreas.contains(p) || traced.contains(p)) continue;
+                traced << p;
+                fineOptions.sunPositions << options.sunPositions[p];
+            }
+            if (!traced.isEmpty()) {
+                out << "Tracing " << traced.size() << " fine corrections." << Qt::endl;
+                QVector<double> areas;
+                QVector<RayTraceResult> results;
+                RayTraceResult fineResult;
+                if (!traceAreas(scene, config, fineOptions, &areas, &results, &fineResult, out, errorMessage))
+                    return 1;
+                for (int k = 0; k < traced.size(); ++k)
+                    fineAreas[traced[k]] = areas[k];
+                fineSeconds += fineResult.elapsedSeconds;
+                traceResult.workerCount = fineResult.workerCount;
+            }
+
+            double sum = 0.;
+            double sum2 = 0.;
+            for (int p : samples) {
+                const double y = weights[nodeOfPosition[p]]*(fineAreas[p] - positionAreas[p])/probabilities[p];
+                sum += y;
+                sum2 += y*y;
+            }
+            corrections = samples.size();
+            correction = sum/corrections;
+            const double spread = qMax(0., (sum2 - corrections*correction*correction)/(corrections - 1));
+            correctionVariance = spread/corrections;
+
+            const double estimate = std::abs(coarseSum + correction);
+            const double budget = std::pow(config.targetRelativeError*estimate, 2) - coarseVariance;
+            if (coarseVariance + correctionVariance <= std::pow(config.targetRelativeError*estimate, 2))
+                break;
+            if (corrections >= config.maxCorrections || round + 1 >= MaxCorrectionRounds)
+                break;
+            // the draws the spread of those so far needs for the target
+            const double needed = budget > 0. ? std::ceil(spread/budget) : config.maxCorrections;
+            wanted = qBound(corrections + 1, static_cast<int>(qMin<double>(needed, config.maxCorrections)), config.maxCorrections);
+        }
+    }
+
+    QVector<double> areas(nodes.size(), 0.);
+    for (int p = 0; p < positionAreas.size(); ++p)
+        areas[nodeOfPosition[p]] = positionAreas[p];
+
+    spatial.setValues(areas);
+    // effective area of the target seen from the sun at every TMY step,
+    // interpolated between the sky nodes in one batch
+    QVector<sp::vec3d> sunVectors;
+    for (const sp::TimeStamp& timeStamp : temporal.timeStamps())
+        sunVectors << timeStamp.s;
+    QVector<double> effectiveAreas = spatial.interpolate(sunVectors);
+    for (int n = 0; n < effectiveAreas.size(); ++n)
+        effectiveAreas[n] = sunVectors[n].z <= 0. ? 0. : qMax(0., effectiveAreas[n]);
+    const double energy = temporal.integrateWeighted(effectiveAreas) + correction; // Wh
+    const double energyNodes = spatial.integrate() + correction;
+    const double energyError = std::sqrt(coarseVariance + correctionVariance);
+    const double dni = temporal.integrate(); // Wh/m2
+    if (!std::isfinite(energy) || !std::isfinite(dni))
+        return fail(errorMessage, "Annual integration produced non-finite values."), 1;
+
+    const sp::Location& location = temporal.calculator()->location();
+    QJsonObject result;
+    result["schema_version"] = 1;
+    result["scene_file"] = sceneFileName;
+    result["tmy_file"] = tmyFileName;
+    result["latitude"] = location.latitude()/sp::degree;
+    result["longitude"] = location.longitude()/sp::degree;
+    result["target_surface"] = config.targetSurface;
+    result["target_side_id"] = config.targetSideId;
+    result["rays"] = static_cast<double>(config.rays);
+    result["seed"] = static_cast<double>(config.seed);
+    result["random_generator"] = config.randomGenerator;
+    result["sky_resolution_deg"] = config.skyResolutionDeg;
+    result["kernel_order"] = config.kernelOrder;
+    result["symmetric_east_west"] = config.symmetricEastWest;
+    result["worker_count"] = traceResult.workerCount;
+    result["estimator"] = config.estimator;
+    if (!multilevel) {
+        result["elapsed_seconds"] = traceResult.elapsedSeconds;
+        result["rays_per_second"] = traceResult.raysPerSecond;
+    } else {
+        result["elapsed_seconds"] = coarseSeconds + fineSeconds;
+        result["coarse_model"] = config.coarseModel;
+        if (coarseRays > 0)
+            result["coarse_rays"] = static_cast<double>(coarseRays);
+        result["coarse_seconds"] = coarseSeconds;
+        result["fine_seconds"] = fineSeconds;
+        result["target_relative_error"] = config.targetRelativeError;
+        result["corrections"] = corrections;
+        result["fine_positions"] = fineAreas.size();
+        result["correction_kwh"] = correction/1000.;
+        result["annual_energy_error_kwh"] = energyError/1000.;
+        result["relative_error"] = energy != 0. ? energyError/std::abs(energy) : 0.;
+        result["converged"] = energyError <= config.targetRelativeError*std::abs(energy);
+    }
+    result["annual_dni_kwh_m2"] = dni/1000.;
+    result["annual_energy_kwh"] = energy/1000.;
+    result["annual_energy_nodes_kwh"] = energyNodes/1000.;
+    result["effective_area_m2"] = dni > 0. ? energy/dni : 0.;
+
+    QJsonArray records;
+    const QVector<double>& weights = spatial.weights();
+    for (int n = 0; n < nodes.size(); ++n) {
+        QJsonObject record;
+        record["azimuth"] = horizontals[n].azimuth()/sp::degree;
+        record["elevation"] = horizontals[n].elevation()/sp::degree;
+        record["weight_kwh_m2"] = weights[n]/1000.;
+        record["effective_area_m2"] = areas[n];
+        const int position = nodeOfPosition.indexOf(n);
+        record["traced"] = position >= 0;
+        if (position >= 0 && !positionResults.isEmpty())
+            record["elapsed_seconds"] = positionResults[position].elapsedSeconds;
+        if (fineAreas.contains(position))
+            record["fine_effective_area_m2"] = fineAreas.value(position);
+        records.append(record);
+    }
+    result["sky_nodes"] = records;
+
+    if (!writeResult(outputFileName, result, errorMessage))
+        return 1;
+
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(6);
+    out << "Annual yield completed." << Qt::endl;
+    out << "elapsed_seconds: " << (multilevel ? coarseSeconds + fineSeconds : traceResult.elapsedSeconds) << Qt::endl;
+    out << "annual_dni_kwh_m2: " << dni/1000. << Qt::endl;
+    out << "annual_energy_kwh: " << energy/1000. << Qt::endl;
+    if (multilevel)
+        out << "annual_energy_error_kwh: " << energyError/1000. << Qt::endl;
+    out << "effective_area_m2: " << (dni > 0. ? energy/dni : 0.) << Qt::endl;
+    out << "Result written: " << outputFileName << Qt::endl;
+    return 0;
+}
+
+QString AnnualRunner::sceneFileName(const QString& configFileName, QString* errorMessage) const
+{
+    AnnualConfig config;
+    if (!parseConfig(configFileName, &config, errorMessage))
+        return QString();
+
+    return resolveRelativePath(QFileInfo(configFileName).absoluteDir(), config.sceneFile);
+}
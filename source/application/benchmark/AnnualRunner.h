@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QString>
+
+class TSceneKit;
+
+// annual energy on a target surface from a TMY file, tracing sampled suns
+class AnnualRunner
+{
+public:
+    QString sceneFileName(const QString& configFileName, QString* errorMessage) const;
+    // console output goes to output instead of stdout when it is given
+    int run(const QString& configFileName, TSceneKit* scene, QString* errorMessage, QString* output = nullptr) const;
+};
@@ -1,12 +1,35 @@
 #pragma once
 
+#include <QByteArray>
 #include <QString>
 
 class TSceneKit;
+struct RayTraceShard;
 
 class BenchmarkRunner
 {
 public:
     QString sceneFileName(const QString& configFileName, QString* errorMessage) const;
-    int run(const QString& configFileName, TSceneKit* scene, QString* errorMessage) const;
+    // the result JSON run writes
+    QString resultFileName(const QString& configFileName, QString* errorMessage) const;
+    // settings the scene is to be loaded with: huge pages for its meshes
+    void prepareScene(const QString& configFileName) const;
+    // single runs keep their result and flux grid files in directory, see
+    // TraceResultCache; typesKey is that of CorePluginRegistry
+    void setResultCache(const QString& directory, const QByteArray& typesKey);
+    // console output goes to output instead of stdout when it is given
+    int run(const QString& configFileName, TSceneKit* scene, QString* errorMessage, QString* output = nullptr) const;
+    // traces the chunks of shard of shards only and writes their counts to
+    // output_file.shard-i-of-N instead of the result, see RayTraceShard
+    int runShard(const QString& configFileName, TSceneKit* scene, int shard, int shards, QString* errorMessage, QString* output = nullptr) const;
+    // the result run writes, from the partial results of all shards as
+    // summed by RayTraceShard::merge
+    int merge(const RayTraceShard& merged, QString* errorMessage, QString* output = nullptr) const;
+
+private:
+    // with merged, its counts stand for the trace and scene is not used
+    int runTrace(const QString& configFileName, TSceneKit* scene, int shard, int shards, const RayTraceShard* merged, QString* errorMessage, QString* output) const;
+
+    QString m_resultCache;
+    QByteArray m_typesKey;
 };
@@ -0,0 +1,257 @@
+#include "BenchmarkSuite.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QThread>
+
+#include "benchmark/BenchmarkRunner.h"
+#include "libraries/math/CpuDispatch.h"
+
+namespace
+{
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+
+QString resolveRelativePath(const QDir& baseDir, const QString& path)
+{
+    QFileInfo info(path);
+    if (info.isAbsolute())
+        return info.absoluteFilePath();
+    return QFileInfo(baseDir.absoluteFilePath(path)).absoluteFilePath();
+}
+
+bool readJsonObject(const QString& fileName, QJsonObject* object, QString* errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(errorMessage, QString("Cannot open %1: %2").arg(fileName, file.errorString()));
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError)
+        return fail(errorMessage, QString("Cannot parse %1: %2").arg(fileName, parseError.errorString()));
+    if (!document.isObject())
+        return fail(errorMessage, QString("%1 must contain a JSON object.").arg(fileName));
+    *object = document.object();
+    return true;
+}
+
+bool parseString(const QJsonObject& object, const QString& name, QString* value, QString* errorMessage)
+{
+    if (!object.contains(name))
+        return fail(errorMessage, QString("%1 is required.").arg(name));
+    if (!object.value(name).isString() || object.value(name).toString().trimmed().isEmpty())
+        return fail(errorMessage, QString("%1 must be a non-empty string.").arg(name));
+    *value = object.value(name).toString();
+    return true;
+}
+
+// the hashes a run is compared by: the benchmark grid and every flux target
+QJsonObject hashesOf(const QJsonObject& result)
+{
+    QJsonObject hashes;
+    hashes["flux_grid"] = result.value("flux_grid_sha256");
+    for (const QJsonValue& value : result.value("flux_targets").toArray()) {
+        const QJsonObject target = value.toObject();
+        hashes[target.value("surface").toString()] = target.value("flux_grid_sha256");
+    }
+    return hashes;
+}
+
+bool writeJson(const QString& fileName, const QJsonObject& object, QString* errorMessage)
+{
+    QFileInfo info(fileName);
+    QDir dir;
+    if (!dir.mkpath(info.absolutePath()))
+        return fail(errorMessage, QString("Cannot create directory %1.").arg(info.absolutePath()));
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(errorMessage, QString("Cannot open %1: %2").arg(fileName, file.errorString()));
+    file.write(QJsonDocument(object).toJson(QJsonDocument::Indented));
+    if (!file.commit())
+        return fail(errorMessage, QString("Cannot write %1: %2").arg(fileName, file.errorString()));
+    return true;
+}
+
+// one compact JSON object per line, so runs are only ever appended
+bool appendJsonLine(const QString& fileName, const QJsonObject& object, QString* errorMessage)
+{
+    QFileInfo info(fileName);
+    QDir dir;
+    if (!dir.mkpath(info.absolutePath()))
+        return fail(errorMessage, QString("Cannot create directory %1.").arg(info.absolutePath()));
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        return fail(errorMessage, QString("Cannot open %1: %2").arg(fileName, file.errorString()));
+    const QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+    if (file.write(line) != line.size())
+        return fail(errorMessage, QString("Cannot write %1: %2").arg(fileName, file.errorString()));
+    return true;
+}
+}
+
+bool BenchmarkSuite::read(const QString& suiteFileName, QString* errorMessage)
+{
+    *this = BenchmarkSuite();
+
+    QJsonObject object;
+    if (!readJsonObject(suiteFileName, &object, errorMessage))
+        return false;
+    if (!parseString(object, "suite", &m_suite, errorMessage) ||
+        !parseString(object, "history_file", &m_historyFile, errorMessage) ||
+        !parseString(object, "baseline_file", &m_baselineFile, errorMessage))
+        return false;
+
+    const QDir suiteDir = QFileInfo(suiteFileName).absoluteDir();
+    m_historyFile = resolveRelativePath(suiteDir, m_historyFile);
+    m_baselineFile = resolveRelativePath(suiteDir, m_baselineFile);
+
+    if (!object.value("benchmarks").isArray() || object.value("benchmarks").toArray().isEmpty())
+        return fail(errorMessage, "benchmarks must be a non-empty array of benchmark config files.");
+    for (const QJsonValue& value : object.value("benchmarks").toArray()) {
+        if (!value.isString() || value.toString().trimmed().isEmpty())
+            return fail(errorMessage, "benchmarks must contain benchmark config file names.");
+        const QString configFileName = resolveRelativePath(suiteDir, value.toString());
+        const QString name = QFileInfo(configFileName).completeBaseName();
+        for (const QString& other : m_configFileNames)
+            if (QFileInfo(other).completeBaseName() == name)
+                return fail(errorMessage, QString("benchmarks has two configs named %1.").arg(name));
+        m_configFileNames << configFileName;
+    }
+
+    if (object.contains("regression_threshold")) {
+        m_threshold = object.value("regression_threshold").toDouble(-1.);
+        if (!object.value("regression_threshold").isDouble() || !(m_threshold >= 0. && m_threshold < 1.))
+            return fail(errorMessage, "regression_threshold must be a fraction from 0 to below 1.");
+    }
+    return true;
+}
+
+bool BenchmarkSuite::addResult(const QString& configFileName, double loadSeconds, QString* errorMessage)
+{
+    BenchmarkRunner benchmarkRunner;
+    const QString resultFileName = benchmarkRunner.resultFileName(configFileName, errorMessage);
+    if (resultFileName.isEmpty())
+        return false;
+    QJsonObject result;
+    if (!readJsonObject(resultFileName, &result, errorMessage))
+        return false;
+    if (!result.value("rays_per_second").isDouble())
+        return fail(errorMessage, QString("%1 is not the result of a single benchmark run; sweeps cannot be in a suite.").arg(resultFileName));
+
+    QJsonObject record;
+    record["name"] = QFileInfo(configFileName).completeBaseName();
+    record["config_file"] = configFileName;
+    record["scene_file"] = result.value("scene_file");
+    record["rays"] = result.value("rays");
+    record["worker_count"] = result.value("worker_count");
+    record["chunk_size"] = result.value("chunk_size");
+    record["elapsed_seconds"] = result.value("elapsed_seconds");
+    record["rays_per_second"] = result.value("rays_per_second");
+    record["load_seconds"] = loadSeconds;
+    record["setup_seconds"] = result.value("setup_seconds");
+    record["total_power_mw"] = result.value("total_power_mw");
+    record["hashes"] = hashesOf(result);
+    m_results.append(record);
+    return true;
+}
+
+int BenchmarkSuite::finish(const QString& host, bool updateBaseline, QString* errorMessage, QString* output) const
+{
+    QTextStream out(stdout);
+    if (output)
+        out.setString(output);
+
+    QJsonObject baselines;
+    if (QFileInfo::exists(m_baselineFile) && !readJsonObject(m_baselineFile, &baselines, errorMessage))
+        return 1;
+    QJsonObject hosts = baselines.value("hosts").toObject();
+    const QJsonObject baseline = hosts.value(host).toObject().value("benchmarks").toObject();
+    const bool compared = !updateBaseline && !baseline.isEmpty();
+
+    // each benchmark against its baseline, if it has one
+    QJsonArray benchmarks;
+    QStringList regressions;
+    out << "suite: " << m_suite << Qt::endl;
+    out << "host: " << host << Qt::endl;
+    for (const QJsonValue& value : m_results) {
+        QJsonObject record = value.toObject();
+        const QString name = record.value("name").toString();
+        const double raysPerSecond = record.value("rays_per_second").toDouble();
+        out << "benchmark " << name << ": rays_per_second " << raysPerSecond;
+        const QJsonObject reference = baseline.value(name).toObject();
+        if (compared && !reference.isEmpty()) {
+            const double baselineRaysPerSecond = reference.value("rays_per_second").toDouble();
+            const double ratio = baselineRaysPerSecond > 0. ? raysPerSecond/baselineRaysPerSecond : 0.;
+            const bool regressed = ratio < 1. - m_threshold;
+            const bool hashesMatch = reference.value("hashes").toObject() == record.value("hashes").toObject();
+            record["baseline_rays_per_second"] = baselineRaysPerSecond;
+            record["ratio"] = ratio;
+            record["regressed"] = regressed;
+            record["hashes_match"] = hashesMatch;
+            out << ", baseline " << baselineRaysPerSecond << ", ratio " << ratio
+                << (regressed ? ", REGRESSED" : "") << (hashesMatch ? "" : ", HASHES CHANGED");
+            if (regressed)
+                regressions << QString("%1 traced at %2 of its baseline rays/s").arg(name).arg(ratio);
+            if (!hashesMatch)
+                regressions << QString("%1 changed its flux grid hashes").arg(name);
+        }
+        out << Qt::endl;
+        benchmarks.append(record);
+    }
+
+    QJsonObject run;
+    run["suite"] = m_suite;
+    run["time"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    run["host"] = host;
+    run["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+    run["logical_cpus"] = QThread::idealThreadCount();
+    run["simd_path"] = CpuDispatch::name();
+    run["regression_threshold"] = m_threshold;
+    run["baseline"] = compared ? "compared" : "recorded";
+    run["benchmarks"] = benchmarks;
+    if (!appendJsonLine(m_historyFile, run, errorMessage))
+        return 1;
+    out << "history_file: " << m_historyFile << Qt::endl;
+
+    if (!compared) {
+        QJsonObject entries;
+        for (const QJsonValue& value : m_results) {
+            const QJsonObject record = value.toObject();
+            QJsonObject entry;
+            entry["rays_per_second"] = record.value("rays_per_second");
+            entry["hashes"] = record.value("hashes");
+            entries[record.value("name").toString()] = entry;
+        }
+        QJsonObject entry;
+        entry["time"] = run.value("time");
+        entry["simd_path"] = run.value("simd_path");
+        entry["benchmarks"] = entries;
+        hosts[host] = entry;
+        baselines["schema_version"] = 1;
+        baselines["hosts"] = hosts;
+        if (!writeJson(m_baselineFile, baselines, errorMessage))
+            return 1;
+        out << "Baseline written: " << m_baselineFile << Qt::endl;
+        return 0;
+    }
+
+    out << "regressions: " << regressions.size() << Qt::endl;
+    if (!regressions.isEmpty())
+        return fail(errorMessage, QString("Suite %1 regressed: %2.").arg(m_suite, regressions.join("; "))), 1;
+    out << "Benchmark suite passed." << Qt::endl;
+    return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QJsonArray>
+#include <QString>
+#include <QStringList>
+
+// a set of benchmark configs traced in turn, as a regression suite: each run
+// appends its rays/s, setup timings and flux grid hashes to a history file
+// and is compared with the baseline of its host in a baseline file
+class BenchmarkSuite
+{
+public:
+    bool read(const QString& suiteFileName, QString* errorMessage);
+    // absolute, in the order of the suite
+    const QStringList& getConfigFileNames() const {return m_configFileNames;}
+
+    // the result the benchmark config wrote, with the seconds its scene took to load
+    bool addResult(const QString& configFileName, double loadSeconds, QString* errorMessage);
+
+    // appends the run to the history and compares it with the baseline of
+    // host, stored from this run if the host has none or with updateBaseline;
+    // fails if any throughput regressed beyond the threshold or any hash changed
+    int finish(const QString& host, bool updateBaseline, QString* errorMessage, QString* output = nullptr) const;
+
+private:
+    QString m_suite;
+    QStringList m_configFileNames;
+    QString m_historyFile;
+    QString m_baselineFile;
+    double m_threshold = 0.1;
+    QJsonArray m_results;
+};
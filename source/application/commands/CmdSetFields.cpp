@@ -0,0 +1,88 @@
+#include "CmdSetFields.h"
+
+#include <Inventor/nodes/SoNode.h>
+#include <Inventor/fields/SoField.h>
+#include <Inventor/SbString.h>
+
+
+CmdSetFields::CmdSetFields(const QString& text, QUndoCommand* parent):
+    QUndoCommand(parent),
+    m_applied(true)
+{
+    setText(text);
+}
+
+CmdSetFields::~CmdSetFields()
+{
+    for (NodeDelta& nd : m_nodes)
+        nd.node->unref();
+}
+
+bool CmdSetFields::add(SoNode* node, const QString& field, const QString& value)
+{
+    if (!node) return false;
+    SbName name(field.toLatin1().data());
+    SoField* f = node->getField(name);
+    if (!f) return false;
+
+    int n = m_nodeIndex.value(node, -1);
+    if (n < 0) {
+        n = int(m_nodes.size());
+        node->ref();
+        m_nodes.push_back({node, {}});
+        m_nodeIndex.insert(node, n);
+    }
+    NodeDelta& nd = m_nodes[n];
+
+    QByteArray text = value.toLatin1();
+    FieldDelta* fd = 0;
+    for (FieldDelta& d : nd.fields)
+        if (d.field == name) fd = &d;
+    if (!fd) {
+        SbString valueOld;
+        f->get(valueOld);
+        nd.fields.push_back({name, addValue(valueOld.getString()), 0});
+        fd = &nd.fields.back();
+    }
+    fd->value = addValue(text);
+
+    f->set(text.data());
+    return true;
+}
+
+int CmdSetFields::getCount() const
+{
+    int ans = 0;
+    for (const NodeDelta& nd : m_nodes)
+        ans += int(nd.fields.size());
+    return ans;
+}
+
+int CmdSetFields::addValue(const QByteArray& value)
+{
+    int ans = m_valueIndex.value(value, -1);
+    if (ans < 0) {
+        ans = int(m_values.size());
+        m_values.push_back(value);
+        m_valueIndex.insert(value, ans);
+    }
+    return ans;
+}
+
+void CmdSetFields::undo()
+{
+    for (auto nd = m_nodes.rbegin(); nd != m_nodes.rend(); ++nd)
+        for (const FieldDelta& fd : nd->fields)
+            nd->node->getField(fd.field)->set(m_values[fd.valueOld].data());
+    m_applied = false;
+}
+
+void CmdSetFields::redo()
+{
+    // the values were set by add
+    if (m_applied) return;
+    for (const NodeDelta& nd : m_nodes)
+        for (const FieldDelta& fd : nd.fields)
+            nd.node->getField(fd.field)->set(m_values[fd.value].data());
+    m_applied = true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QUndoCommand>
+
+#include <Inventor/SbName.h>
+
+class SoNode;
+
+//! CmdSetFields sets fields of many nodes as one undo step.
+/*!
+ * A bulk edit, as the reflectivity of every heliostat of a field, goes on
+ * the stack as one command instead of one CmdSetFieldText per node. Each
+ * node is kept once with the deltas of its fields, and the texts of the
+ * values are stored once however many fields share them, so thousands of
+ * nodes set to the same value cost little more than their pointers.
+ *
+ * Values are applied as they are added, so scripts read back what they
+ * wrote; redo and undo then go over all the deltas in one pass.
+ */
+class CmdSetFields: public QUndoCommand
+{
+public:
+    CmdSetFields(const QString& text, QUndoCommand* parent = 0);
+    ~CmdSetFields();
+
+    // false if the node has no such field
+    bool add(SoNode* node, const QString& field, const QString& value);
+    bool isEmpty() const {return m_nodes.empty();}
+    int getCount() const;
+
+    void undo();
+    void redo();
+
+private:
+    struct FieldDelta
+    {
+        SbName field;
+        int valueOld; // in m_values
+        int value;
+    };
+
+    struct NodeDelta
+    {
+        SoNode* node;
+        std::vector<FieldDelta> fields;
+    };
+
+    int addValue(const QByteArray& value);
+
+    std::vector<NodeDelta> m_nodes;
+    QHash<SoNode*, int> m_nodeIndex; // in m_nodes
+    std::vector<QByteArray> m_values;
+    QHash<QByteArray, int> m_valueIndex; // in m_values
+    bool m_applied;
+};
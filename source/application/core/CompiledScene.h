@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+
+#include <QByteArray>
+#include <QString>
+
+#include "core/SceneInstanceBuilder.h"
+#include "kernel/run/SceneBVH.h"
+
+// The instance tree and scene BVH of a trace, kept for the next traces of
+// the scene while it does not change, as the slices of a service job. The
+// caller names the state of the scene in key, such as the hash of its file,
+// the patch applied and the sun; RayTraceRunner compiles the scene again when
+// key or the options the BVH depends on differ from those it compiled for.
+struct CompiledScene
+{
+    // set by the caller; empty compiles every trace
+    QByteArray key;
+    // key and options of the tree and BVH held, set by RayTraceRunner
+    QString compiledKey;
+    SceneInstanceTree instanceTree;
+    std::unique_ptr<SceneBVH> sceneBVH;
+
+    void clear()
+    {
+        compiledKey.clear();
+        sceneBVH.reset();
+        instanceTree = SceneInstanceTree();
+    }
+};
@@ -1,12 +1,27 @@
 #include "CorePluginRegistry.h"
 
+#include <cctype>
+
+#include <Inventor/SoType.h>
+#include <Inventor/lists/SoTypeList.h>
+#include <Inventor/nodes/SoNode.h>
+
+#include <QCoreApplication>
+#include <QDateTime>
 #include <QLibrary>
 #include <QPluginLoader>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
 #include <QJsonObject>
 #include <QObject>
+#include <QSaveFile>
 #include <QSet>
+#include <QStandardPaths>
+#include <QVariant>
 #include <QtAlgorithms>
 
 #include "core/TonatiuhCore.h"
@@ -21,6 +36,8 @@
 #include "kernel/material/MaterialTransparent.h"
 #include "kernel/material/MaterialVirtual.h"
 #include "kernel/node/TFactory.h"
+#include "kernel/photons/PhotonsAbstract.h"
+#include "kernel/photons/PhotonsWidget.h"
 #include "kernel/profiles/ProfileBox.h"
 #include "kernel/profiles/ProfileCircular.h"
 #include "kernel/profiles/ProfilePolygon.h"
@@ -45,10 +62,10 @@
 
 namespace
 {
-bool isSceneFactoryPlugin(const QString& fileName)
+const int IndexVersion = 1;
+
+bool isSceneFactoryIid(const QString& iid)
 {
-    QPluginLoader loader(fileName);
-    const QString iid = loader.metaData().value("IID").toString();
     static const QSet<QString> sceneFactoryIids = {
         "tonatiuh.AirFactory",
         "tonatiuh.MaterialFactory",
@@ -60,6 +77,36 @@ bool isSceneFactoryPlugin(const QString& fileName)
 
     return sceneFactoryIids.contains(iid);
 }
+
+QSet<QString> findNodeTypes()
+{
+    SoTypeList types;
+    SoType::getAllDerivedFrom(SoNode::getClassTypeId(), types);
+    QSet<QString> names;
+    for (int n = 0; n < types.getLength(); ++n)
+        names << types[n].getName().getString();
+    return names;
+}
+
+// the identifiers of a scene file, a superset of its node type names
+QSet<QByteArray> findWords(const QByteArray& bytes)
+{
+    QSet<QByteArray> words;
+    const char* data = bytes.constData();
+    const int size = bytes.size();
+    for (int n = 0; n < size;) {
+        const char c = data[n];
+        if (!(std::isalpha(uchar(c)) || c == '_')) {
+            ++n;
+            continue;
+        }
+        int begin = n;
+        while (n < size && (std::isalnum(uchar(data[n])) || data[n] == '_'))
+            ++n;
+        words.insert(QByteArray(data + begin, n - begin));
+    }
+    return words;
+}
 }
 
 CorePluginRegistry::CorePluginRegistry()
@@ -74,6 +121,10 @@ CorePluginRegistry::~CorePluginRegistry()
     qDeleteAll(m_ownedFactories);
 }
 
+/*!
+ * Plugins found in the index with their size and time are only recorded;
+ * new or changed plugins are opened now and indexed.
+ */
 void CorePluginRegistry::loadScenePlugins(const QStringList& directories)
 {
     QStringList files;
@@ -81,8 +132,67 @@ void CorePluginRegistry::loadScenePlugins(const QStringList& directories)
         findPluginFiles(directory, files);
     files.removeDuplicates();
 
+    QVector<PluginEntry> index = readIndex();
+    QHash<QString, int> indexed;
+    for (int n = 0; n < index.size(); ++n)
+        indexed[index[n].fileName] = n;
+
+    bool changed = false;
     for (const QString& fileName : files)
-        loadPluginFile(fileName);
+    {
+        QFileInfo info(fileName);
+        PluginEntry entry;
+        entry.fileName = fileName;
+        entry.size = info.size();
+        entry.modified = info.lastModified().toMSecsSinceEpoch();
+
+        auto it = indexed.find(fileName);
+        if (it != indexed.end()) {
+            const PluginEntry& e = index[it.value()];
+            if (e.size == entry.size && e.modified == entry.modified) {
+                if (isSceneFactoryIid(e.iid) && !e.types.isEmpty())
+                    m_pending << e;
+                continue;
+            }
+        }
+
+        entry.iid = QPluginLoader(fileName).metaData().value("IID").toString();
+        if (isSceneFactoryIid(entry.iid))
+            loadPluginFile(entry);
+        if (it != indexed.end()) {
+            index[it.value()] = entry;
+        } else {
+            indexed[fileName] = index.size();
+            index << entry;
+        }
+        changed = true;
+    }
+
+    if (changed)
+        writeIndex(index);
+}
+
+void CorePluginRegistry::loadScenePluginsFor(const QString& sceneFileName)
+{
+    if (m_pending.isEmpty())
+        return;
+
+    QFile file(sceneFileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    const QSet<QByteArray> words = findWords(file.readAll());
+
+    for (int n = 0; n < m_pending.size();) {
+        bool used = false;
+        for (const QString& type : m_pending[n].types)
+            used = used || words.contains(type.toLatin1());
+        if (!used) {
+            ++n;
+            continue;
+        }
+        loadPluginFile(m_pending[n]);
+        m_pending.remove(n);
+    }
 }
 
 void CorePluginRegistry::registerBuiltInSceneTypes()
@@ -134,28 +244,144 @@ void CorePluginRegistry::findPluginFiles(const QString& directory, QStringList&
     }
 }
 
-bool CorePluginRegistry::loadPluginFile(const QString& fileName)
+QByteArray CorePluginRegistry::typesKey() const
 {
-    if (!isSceneFactoryPlugin(fileName))
-        return false;
+    QStringList fileNames(QCoreApplication::applicationFilePath());
+    for (QPluginLoader* loader : m_pluginLoaders)
+        fileNames << loader->fileName();
+
+    QByteArray key;
+    for (const QString& fileName : fileNames) {
+        QFileInfo info(fileName);
+        key += QString("%1 %2 %3\n")
+            .arg(info.fileName())
+            .arg(info.size())
+            .arg(info.lastModified().toMSecsSinceEpoch()).toUtf8();
+    }
+    return key;
+}
 
-    QPluginLoader* loader = new QPluginLoader(fileName);
+PhotonsFactory* CorePluginRegistry::loadPhotonsFactory(const QStringList& directories, const QString& name, QStringList* names)
+{
+    if (names)
+        *names = QStringList(PhotonsAbstract::getClassName());
+    if (name == PhotonsAbstract::getClassName()) {
+        PhotonsFactory* factory = new PhotonsFactoryT<PhotonsAbstract, PhotonsWidget>;
+        m_ownedFactories << factory;
+        return factory;
+    }
+
+    QStringList files;
+    for (const QString& directory : directories)
+        findPluginFiles(directory, files);
+    files.removeDuplicates();
+
+    // the metadata is read without loading the library
+    for (const QString& fileName : files) {
+        if (QPluginLoader(fileName).metaData().value("IID").toString() != "tonatiuh.PhotonsFactory")
+            continue;
+        QPluginLoader* loader = new QPluginLoader(fileName);
+        PhotonsFactory* factory = dynamic_cast<PhotonsFactory*>(loader->instance());
+        if (!factory) {
+            delete loader;
+            continue;
+        }
+        m_pluginLoaders << loader;
+        if (names)
+            *names << factory->name();
+        if (factory->name() == name)
+            return factory;
+    }
+    return nullptr;
+}
+
+bool CorePluginRegistry::loadPluginFile(PluginEntry& entry)
+{
+    QPluginLoader* loader = new QPluginLoader(entry.fileName);
     QObject* plugin = loader->instance();
     if (!plugin) {
         delete loader;
         return false;
     }
 
+    const QSet<QString> types = findNodeTypes();
     TFactory* factory = dynamic_cast<TFactory*>(plugin);
     if (!factory || !registerSceneFactory(factory, false)) {
         delete loader;
         return false;
     }
 
+    entry.types = QStringList(findNodeTypes().subtract(types).values());
+    entry.types.sort();
+    entry.factories = QStringList(factory->name());
     m_pluginLoaders << loader;
     return true;
 }
 
+// empty if there is no cache directory
+QString CorePluginRegistry::indexFileName()
+{
+    QString dirName = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (dirName.isEmpty()) return QString();
+    return dirName + "/plugins.json";
+}
+
+QVector<CorePluginRegistry::PluginEntry> CorePluginRegistry::readIndex()
+{
+    QVector<PluginEntry> entries;
+    QFile file(indexFileName());
+    if (file.fileName().isEmpty() || !file.open(QIODevice::ReadOnly))
+        return entries;
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root.value("version").toInt() != IndexVersion)
+        return entries;
+
+    for (const QJsonValue& value : root.value("plugins").toArray()) {
+        const QJsonObject object = value.toObject();
+        PluginEntry entry;
+        entry.fileName = object.value("path").toString();
+        entry.size = object.value("size").toVariant().toLongLong();
+        entry.modified = object.value("modified").toVariant().toLongLong();
+        entry.iid = object.value("iid").toString();
+        for (const QJsonValue& type : object.value("types").toArray())
+            entry.types << type.toString();
+        for (const QJsonValue& factory : object.value("factories").toArray())
+            entry.factories << factory.toString();
+        entries << entry;
+    }
+    return entries;
+}
+
+// an index that cannot be written is left out
+void CorePluginRegistry::writeIndex(const QVector<PluginEntry>& entries)
+{
+    const QString fileName = indexFileName();
+    if (fileName.isEmpty())
+        return;
+
+    QJsonArray plugins;
+    for (const PluginEntry& entry : entries) {
+        QJsonObject object;
+        object["path"] = entry.fileName;
+        object["size"] = QString::number(entry.size);
+        object["modified"] = QString::number(entry.modified);
+        object["iid"] = entry.iid;
+        object["types"] = QJsonArray::fromStringList(entry.types);
+        object["factories"] = QJsonArray::fromStringList(entry.factories);
+        plugins << object;
+    }
+    QJsonObject root;
+    root["version"] = IndexVersion;
+    root["plugins"] = plugins;
+
+    if (!QDir().mkpath(QFileInfo(fileName).absolutePath())) return;
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) return;
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    file.commit();
+}
+
 bool CorePluginRegistry::registerSceneFactory(TFactory* factory, bool takeOwnership)
 {
     if (!factory)
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <QByteArray>
 #include <QStringList>
 #include <QVector>
 
+class PhotonsFactory;
 class QPluginLoader;
 class TFactory;
 
+// plugins indexed in plugins.json of the user cache are opened only for the scenes using their types
 class CorePluginRegistry
 {
 public:
@@ -13,13 +16,35 @@ public:
     ~CorePluginRegistry();
 
     void loadScenePlugins(const QStringList& directories);
+    // opens the indexed plugins whose node types appear in the scene file
+    void loadScenePluginsFor(const QString& sceneFileName);
+    // the application and loaded plugin files, for caches of scenes using their node types
+    QByteArray typesKey() const;
+    // the photon exporter named \a name, "No export" built in, others opened
+    // from the export plugins of the directories; null if none has the name
+    PhotonsFactory* loadPhotonsFactory(const QStringList& directories, const QString& name, QStringList* names = nullptr);
 
 private:
+    struct PluginEntry
+    {
+        QString fileName;
+        qint64 size = 0;
+        qint64 modified = 0;
+        QString iid;
+        QStringList types;     // Coin node types registered by the plugin
+        QStringList factories; // factory names
+    };
+
     void registerBuiltInSceneTypes();
     void findPluginFiles(const QString& directory, QStringList& files) const;
-    bool loadPluginFile(const QString& fileName);
+    bool loadPluginFile(PluginEntry& entry);
     bool registerSceneFactory(TFactory* factory, bool takeOwnership);
 
+    static QString indexFileName();
+    static QVector<PluginEntry> readIndex();
+    static void writeIndex(const QVector<PluginEntry>& entries);
+
     QVector<TFactory*> m_ownedFactories;
     QVector<QPluginLoader*> m_pluginLoaders;
+    QVector<PluginEntry> m_pending; // indexed, not opened yet
 };
@@ -0,0 +1,103 @@
+#include "DistributedRun.h"
+
+#ifdef TONATIUHPP_MPI
+#include <mpi.h>
+#endif
+
+namespace
+{
+DistributedRun* s_instance = nullptr;
+}
+
+DistributedRun::DistributedRun(int* argc, char*** argv)
+{
+#ifdef TONATIUHPP_MPI
+    int initialized = 0;
+    MPI_Initialized(&initialized);
+    if (!initialized) {
+        // workers never call MPI, the reductions run on the main thread
+        int provided = 0;
+        m_initialized = MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided) == MPI_SUCCESS;
+    }
+    MPI_Comm_rank(MPI_COMM_WORLD, &m_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &m_size);
+#else
+    Q_UNUSED(argc)
+    Q_UNUSED(argv)
+#endif
+    s_instance = this;
+}
+
+DistributedRun::~DistributedRun()
+{
+    if (s_instance == this)
+        s_instance = nullptr;
+#ifdef TONATIUHPP_MPI
+    if (m_initialized)
+        MPI_Finalize();
+#endif
+}
+
+const DistributedRun* DistributedRun::instance()
+{
+    return s_instance;
+}
+
+bool DistributedRun::isSupported()
+{
+#ifdef TONATIUHPP_MPI
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DistributedRun::allSucceeded(bool ok) const
+{
+#ifdef TONATIUHPP_MPI
+    if (m_size > 1) {
+        int local = ok ? 1 : 0;
+        int all = 0;
+        MPI_Allreduce(&local, &all, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        return all == 1;
+    }
+#endif
+    return ok;
+}
+
+void DistributedRun::sumToRoot(std::vector<qulonglong>& values) const
+{
+#ifdef TONATIUHPP_MPI
+    if (m_size <= 1 || values.empty()) return;
+    // a count argument is an int, large grids go in pieces
+    const size_t piece = 1 << 24;
+    for (size_t start = 0; start < values.size(); start += piece) {
+        int count = int(qMin(piece, values.size() - start));
+        if (isRoot())
+            MPI_Reduce(MPI_IN_PLACE, values.data() + start, count, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        else
+            MPI_Reduce(values.data() + start, nullptr, count, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+#else
+    Q_UNUSED(values)
+#endif
+}
+
+qulonglong DistributedRun::sumToRoot(qulonglong value) const
+{
+    std::vector<qulonglong> values(1, value);
+    sumToRoot(values);
+    return values[0];
+}
+
+double DistributedRun::maxToRoot(double value) const
+{
+#ifdef TONATIUHPP_MPI
+    if (m_size > 1) {
+        double ans = value;
+        MPI_Reduce(&value, &ans, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        return isRoot() ? ans : value;
+    }
+#endif
+    return value;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include <qglobal.h>
+
+// Ranks of a multi-node trace. Built with TONATIUHPP_MPI and started by mpirun,
+// every rank traces the chunk shard of its rank and the integer hit counts are
+// summed on rank 0, which then matches a single run on the chunk schedule bit
+// for bit. Otherwise, or outside mpirun, there is one rank and the reductions
+// keep the local values. Reductions are collective: every rank must call them
+// in the same order, from the thread that created the run.
+class DistributedRun
+{
+public:
+    // one per process, created before any trace and destroyed at exit
+    DistributedRun(int* argc, char*** argv);
+    ~DistributedRun();
+
+    static const DistributedRun* instance(); // null if none was created
+    static bool isSupported();
+
+    int getRank() const {return m_rank;}
+    int getSize() const {return m_size;}
+    bool isRoot() const {return m_rank == 0;}
+
+    // true on every rank if it is true on all of them
+    bool allSucceeded(bool ok) const;
+    // sums on rank 0, other ranks keep their values
+    void sumToRoot(std::vector<qulonglong>& values) const;
+    qulonglong sumToRoot(qulonglong value) const;
+    double maxToRoot(double value) const;
+
+private:
+    int m_rank = 0;
+    int m_size = 1;
+    bool m_initialized = false; // MPI was started here
+};
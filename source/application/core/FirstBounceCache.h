@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include "kernel/run/RayTracer.h"
+
+// A ray from the sun and its first intersection, the surface numbered as in
+// FirstBounceCache::surfaces, -1 for rays hitting nothing.
+struct FirstBounce
+{
+    RayTracerRay ray;
+    double distance = 0.;
+    int surface = -1;
+    bool isFront = false;
+    bool isReflected = false;
+    RayTracerRay reflected;
+};
+
+// First intersections of the rays from the sun of a trace, kept per chunk
+// with hashes of the surfaces. While the sun, its aperture cells and the
+// sampling options stay the same, a trace of the scene edited afterwards
+// traces again from the sun only the rays that hit a changed surface first
+// or cross one before their hit, and the others from their reflection on.
+struct FirstBounceCache
+{
+    // sun, aperture cells and sampling options the rays belong to, set by RayTraceRunner
+    QString key;
+    // by URL, with the hash of their transform, shape, profile and material;
+    // empty for surfaces removed since
+    QStringList surfaces;
+    std::vector<QByteArray> surfaceHashes;
+    std::vector<std::vector<FirstBounce>> chunks;
+};
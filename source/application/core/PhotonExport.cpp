@@ -0,0 +1,77 @@
+#include "PhotonExport.h"
+
+#include "core/RayTraceRunner.h"
+#include "kernel/photons/PhotonsAbstract.h"
+#include "kernel/photons/PhotonsBuffer.h"
+#include "kernel/photons/PhotonsSettings.h"
+
+namespace
+{
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+
+}
+
+PhotonExport::PhotonExport()
+{
+}
+
+PhotonExport::~PhotonExport()
+{
+    m_buffer.reset();
+    m_exporter.reset();
+}
+
+bool PhotonExport::open(PhotonsFactory* factory, const PhotonExportOptions& options, QString* errorMessage)
+{
+    m_buffer.reset();
+    m_exporter.reset();
+    if (!factory)
+        return fail(errorMessage, "No photon exporter was given.");
+    if (options.blockSize == 0 || options.pageSize == 0)
+        return fail(errorMessage, "Photon blocks and pages must hold at least one photon.");
+
+    m_exporter.reset(factory->create(0));
+    if (!m_exporter)
+        return fail(errorMessage, QString("Photon exporter %1 could not be created.").arg(factory->name()));
+
+    PhotonsSettings settings;
+    settings.name = factory->name();
+    settings.saveCoordinates = options.saveCoordinates;
+    settings.saveCoordinatesGlobal = options.saveCoordinatesGlobal;
+    settings.saveSurfaceID = options.saveSurfaceID;
+    settings.saveSurfaceSide = options.saveSurfaceSide;
+    settings.savePhotonsID = options.savePhotonsID;
+    settings.surfaces = options.surfaceUrls;
+    settings.parameters = options.parameters;
+    m_exporter->setPhotonSettings(&settings);
+
+    m_buffer.reset(new PhotonsBuffer(options.blockSize));
+    m_buffer->setSampleBudget(0); // no rays are drawn
+    m_buffer->setWriterQueue(options.writerQueue);
+    if (!m_buffer->setExporter(m_exporter.get())) {
+        m_buffer.reset();
+        m_exporter.reset();
+        return fail(errorMessage, "Photon export could not be started. Check that the output directory exists or can be created, and that it is writable.");
+    }
+    if (options.samplePaths > 0)
+        m_buffer->setReservoir(options.samplePaths, options.sampleStratified, options.sampleSeed);
+    m_options = options;
+    return true;
+}
+
+void PhotonExport::apply(RayTraceOptions* options) const
+{
+    if (!options || !m_buffer)
+        return;
+    options->outputMode = RayTraceOutputMode::PhotonBuffer;
+    options->photonBuffer = m_buffer.get();
+    options->photonPageSize = m_options.pageSize;
+    options->exportSurfaceUrls = m_options.surfaceUrls;
+    options->endPhotonExport = true;
+}
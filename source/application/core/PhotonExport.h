@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <qglobal.h>
+
+class PhotonsAbstract;
+class PhotonsBuffer;
+class PhotonsFactory;
+struct RayTraceOptions;
+
+struct PhotonExportOptions
+{
+    // the parameters of the exporter, as PhotonsSettings::parameters
+    QMap<QString, QString> parameters;
+    // all surfaces if empty
+    QStringList surfaceUrls;
+    bool saveCoordinates = true;
+    bool saveCoordinatesGlobal = true;
+    bool saveSurfaceID = true;
+    bool saveSurfaceSide = true;
+    bool savePhotonsID = true;
+    // photons per block handed to the exporter
+    ulong blockSize = 1 << 20;
+    // blocks in flight to the writer thread, 0 saves them in the merging worker
+    ulong writerQueue = 4;
+    // photons per worker page
+    ulong pageSize = 1 << 14;
+    // ray paths exported as a weighted sample, per final surface if
+    // stratified; 0 exports every photon
+    ulong samplePaths = 0;
+    bool sampleStratified = false;
+    quint64 sampleSeed = 1;
+};
+
+//! PhotonExport runs a photon exporter plugin for traces without a scene tree model.
+/*!
+ * open() creates the exporter of a PhotonsFactory, such as that of
+ * PhotonsFile, and starts its export into a buffer of paged workers: every
+ * worker records into pages of its own, the pages are merged in chunk order
+ * into blocks, and full blocks go to the exporter on a writer thread, so
+ * the tracers wait for the disk only when the writer queue is full.
+ *
+ * apply() sets the options of a RayTraceRunner trace to export into it; the
+ * runner ends the export with the power per ray of the trace, before the
+ * instances the photons point to are gone. Any exporter plugin is run the
+ * same way.
+ *
+ * With samplePaths, the workers keep reservoirs of whole ray paths instead,
+ * and only the merged sample reaches the exporter; see PhotonsBuffer::setReservoir.
+ */
+class PhotonExport
+{
+public:
+    PhotonExport();
+    ~PhotonExport();
+
+    PhotonExport(const PhotonExport&) = delete;
+    PhotonExport& operator=(const PhotonExport&) = delete;
+
+    bool open(PhotonsFactory* factory, const PhotonExportOptions& options, QString* errorMessage = nullptr);
+    void apply(RayTraceOptions* options) const;
+
+    PhotonsBuffer* getBuffer() const {return m_buffer.get();}
+
+private:
+    // the buffer holds the exporter until its writer stops
+    std::unique_ptr<PhotonsAbstract> m_exporter;
+    std::unique_ptr<PhotonsBuffer> m_buffer;
+    PhotonExportOptions m_options;
+};
@@ -0,0 +1,99 @@
+#include "RayBundle.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace
+{
+const quint32 Magic = 0x544e5242; // "TNRB"
+const quint32 Version = 1;
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+}
+
+double RayBundle::powerPerRay() const
+{
+    return sunRays > 0 ? sunApertureArea*irradiance/sunRays : 0.;
+}
+
+bool RayBundle::write(const QString& fileName, QString* errorMessage) const
+{
+    QFileInfo info(fileName);
+    QDir dir;
+    if (!dir.mkpath(info.absolutePath()))
+        return fail(errorMessage, QString("Cannot create ray bundle directory %1.").arg(info.absolutePath()));
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(errorMessage, QString("Cannot open ray bundle file %1: %2").arg(fileName, file.errorString()));
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    out << Magic << Version << key << quint64(sunRays) << sunApertureArea << irradiance;
+    out << quint64(rays.size());
+    for (const RayTracerRay& ray : rays) {
+        out << ray.origin.x << ray.origin.y << ray.origin.z;
+        out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+        out << float(ray.direction.x) << float(ray.direction.y) << float(ray.direction.z);
+        out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    }
+
+    if (out.status() != QDataStream::Ok || !file.commit())
+        return fail(errorMessage, QString("Cannot write ray bundle file %1: %2").arg(fileName, file.errorString()));
+    return true;
+}
+
+bool RayBundle::read(const QString& fileName, QString* errorMessage)
+{
+    *this = RayBundle();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(errorMessage, QString("Cannot open ray bundle file %1: %2").arg(fileName, file.errorString()));
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != Magic)
+        return fail(errorMessage, QString("%1 is not a ray bundle.").arg(fileName));
+    if (version != Version)
+        return fail(errorMessage, QString("Unsupported ray bundle version %1 in %2.").arg(version).arg(fileName));
+
+    quint64 sun = 0;
+    quint64 count = 0;
+    in >> key >> sun >> sunApertureArea >> irradiance >> count;
+    // 36 bytes per ray
+    if (in.status() != QDataStream::Ok || count > quint64(file.size())/36)
+        return fail(errorMessage, QString("Ray bundle %1 is corrupt.").arg(fileName));
+    sunRays = ulong(sun);
+
+    rays.resize(size_t(count));
+    for (RayTracerRay& ray : rays) {
+        float dx = 0.f;
+        float dy = 0.f;
+        float dz = 0.f;
+        in >> ray.origin.x >> ray.origin.y >> ray.origin.z;
+        in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+        in >> dx >> dy >> dz;
+        in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+        ray.direction = vec3d(dx, dy, dz);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        *this = RayBundle();
+        return fail(errorMessage, QString("Ray bundle %1 is truncated.").arg(fileName));
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include <QString>
+#include <qglobal.h>
+
+#include "kernel/run/RayTracer.h"
+
+// Rays leaving the field after their last reflection, traced from the scene
+// without the receiver subtree. While field, sun and sampling options stay
+// the same, a receiver can be traced again from these rays alone, each worth
+// the power per ray of the trace that recorded them.
+struct RayBundle
+{
+    // field, sun and options the rays belong to, set by RayTraceRunner
+    QString key;
+    // rays traced from the sun and the sun they came from
+    ulong sunRays = 0;
+    double sunApertureArea = 0.;
+    double irradiance = 0.;
+    std::vector<RayTracerRay> rays;
+
+    double powerPerRay() const;
+
+    // origins as doubles and unit directions as floats, written through QSaveFile
+    bool write(const QString& fileName, QString* errorMessage) const;
+    bool read(const QString& fileName, QString* errorMessage);
+};
@@ -0,0 +1,123 @@
+#include "RayTraceCheckpoint.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace
+{
+const quint32 Magic = 0x544e434b; // "TNCK"
+const quint32 Version = 1;
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+}
+
+qulonglong RayTraceCheckpoint::completedCount() const
+{
+    qulonglong ans = 0;
+    for (quint8 done : completed)
+        ans += done ? 1 : 0;
+    return ans;
+}
+
+QString RayTraceCheckpoint::sceneTag(const QString& sceneFileName)
+{
+    QFile file(sceneFileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool RayTraceCheckpoint::write(const QString& fileName, QString* errorMessage) const
+{
+    QFileInfo info(fileName);
+    QDir dir;
+    if (!dir.mkpath(info.absolutePath()))
+        return fail(errorMessage, QString("Cannot create checkpoint directory %1.").arg(info.absolutePath()));
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(errorMessage, QString("Cannot open checkpoint file %1: %2").arg(fileName, file.errorString()));
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << Magic << Version << key << quint64(chunkCount) << quint64(raysTraced);
+    out << QByteArray(reinterpret_cast<const char*>(completed.data()), int(completed.size()));
+    out << quint32(grids.size());
+    for (const Grid& grid : grids) {
+        out << grid.url << grid.isFront << qint32(grid.rows) << qint32(grid.cols) << quint64(grid.hits);
+        out << quint32(grid.counts.size());
+        for (qulonglong count : grid.counts)
+            out << quint64(count);
+    }
+
+    if (out.status() != QDataStream::Ok || !file.commit())
+        return fail(errorMessage, QString("Cannot write checkpoint file %1: %2").arg(fileName, file.errorString()));
+    return true;
+}
+
+bool RayTraceCheckpoint::read(const QString& fileName, QString* errorMessage)
+{
+    *this = RayTraceCheckpoint();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(errorMessage, QString("Cannot open checkpoint file %1: %2").arg(fileName, file.errorString()));
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != Magic)
+        return fail(errorMessage, QString("%1 is not a ray trace checkpoint.").arg(fileName));
+    if (version != Version)
+        return fail(errorMessage, QString("Unsupported ray trace checkpoint version %1 in %2.").arg(version).arg(fileName));
+
+    quint64 chunks = 0;
+    quint64 rays = 0;
+    QByteArray done;
+    quint32 gridCount = 0;
+    in >> key >> chunks >> rays >> done >> gridCount;
+    if (in.status() != QDataStream::Ok || quint64(done.size()) != chunks)
+        return fail(errorMessage, QString("Ray trace checkpoint %1 is corrupt.").arg(fileName));
+    chunkCount = chunks;
+    raysTraced = ulong(rays);
+    completed.assign(done.constBegin(), done.constEnd());
+
+    for (quint32 g = 0; g < gridCount && in.status() == QDataStream::Ok; ++g) {
+        Grid grid;
+        qint32 rows = 0;
+        qint32 cols = 0;
+        quint64 hits = 0;
+        quint32 size = 0;
+        in >> grid.url >> grid.isFront >> rows >> cols >> hits >> size;
+        if (in.status() != QDataStream::Ok || rows <= 0 || cols <= 0 || quint64(size) != quint64(rows)*quint64(cols))
+            return fail(errorMessage, QString("Ray trace checkpoint %1 is corrupt.").arg(fileName));
+        grid.rows = rows;
+        grid.cols = cols;
+        grid.hits = hits;
+        grid.counts.resize(size);
+        for (quint32 n = 0; n < size; ++n) {
+            quint64 count = 0;
+            in >> count;
+            grid.counts[n] = count;
+        }
+        grids.push_back(grid);
+    }
+
+    if (in.status() != QDataStream::Ok)
+        return fail(errorMessage, QString("Ray trace checkpoint %1 is truncated.").arg(fileName));
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include <QString>
+#include <qglobal.h>
+
+// Saved state of a chunked trace: the chunks that completed and what they added.
+// Every chunk has its own random stream and flux grids hold integer counts, so a
+// resumed trace that skips the completed chunks ends with the same result.
+struct RayTraceCheckpoint
+{
+    struct Grid
+    {
+        QString url;
+        bool isFront = true;
+        int rows = 0;
+        int cols = 0;
+        qulonglong hits = 0;
+        std::vector<qulonglong> counts;
+    };
+
+    // options and scene the chunks belong to, compared on resume
+    QString key;
+    qulonglong chunkCount = 0;
+    std::vector<quint8> completed;
+    ulong raysTraced = 0;
+    std::vector<Grid> grids;
+
+    qulonglong completedCount() const;
+
+    // checkpointTag of a scene file, from its contents
+    static QString sceneTag(const QString& sceneFileName);
+
+    // written through QSaveFile, so an interrupted write keeps the previous checkpoint
+    bool write(const QString& fileName, QString* errorMessage) const;
+    bool read(const QString& fileName, QString* errorMessage);
+};
@@ -1,33 +1,80 @@
 #include "RayTraceRunner.h"
 
 #include <atomic>
-#include <exception>
-#include <limits>
-#include <thread>
+#include <cmath>
+#include <memory>
 #include <vector>
 
+#include <QCryptographicHash>
 #include <QElapsedTimer>
+#include <QFileInfo>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QSet>
 #include <QVector>
 
+#include <Inventor/SbString.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/sensors/SoSensorManager.h>
+
+#include "core/CompiledScene.h"
+#include "core/FirstBounceCache.h"
+#include "core/RayBundle.h"
+#include "core/RayTraceCheckpoint.h"
+#include "core/SceneEditor.h"
 #include "core/SceneInstanceBuilder.h"
 #include "kernel/air/AirTransmission.h"
 #include "kernel/air/AirVacuum.h"
+#include "kernel/material/MaterialRT.h"
+#include "kernel/material/SlopeSampler.h"
 #include "kernel/node/TonatiuhFunctions.h"
 #include "kernel/photons/PhotonsBuffer.h"
+#include "kernel/profiles/ProfileRT.h"
+#include "kernel/random/RandomPhiloxRays.h"
+#include "kernel/random/RandomSobol.h"
 #include "kernel/random/RandomSTL.h"
+#include "kernel/run/BackwardTracer.h"
+#include "kernel/run/BatchMeans.h"
+#include "kernel/run/AdaptiveFlux.h"
+#include "kernel/run/AimImages.h"
+#include "kernel/run/CameraImage.h"
+#include "kernel/run/CellImportance.h"
+#include "kernel/run/ConvolutionFlux.h"
+#include "kernel/run/CpuTopology.h"
+#include "kernel/run/FluxAccumulator.h"
+#include "kernel/run/HugePages.h"
 #include "kernel/run/InstanceNode.h"
+#include "kernel/run/MaterialVariants.h"
+#include "kernel/run/MemoryUsage.h"
+#include "kernel/run/MirrorSymmetry.h"
+#include "kernel/run/PowerBudget.h"
+#include "kernel/run/TraceStatistics.h"
 #include "kernel/run/RayTracer.h"
+#include "kernel/run/ReflectorAttribution.h"
+#include "kernel/run/ReflectorSampler.h"
+#include "kernel/run/SceneBVH.h"
+#include "kernel/run/TraceEvents.h"
+#include "kernel/run/TraceScheduler.h"
+#include "kernel/run/TranslationalSymmetry.h"
 #include "kernel/scene/TSceneKit.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/ShapeRT.h"
 #include "kernel/sun/SunAperture.h"
 #include "kernel/sun/SunKit.h"
 #include "kernel/sun/SunPosition.h"
 #include "kernel/sun/SunShape.h"
+#include "libraries/math/1D/LookupTable.h"
 #include "libraries/math/3D/Transform.h"
 
 namespace
 {
+// rounds of a convergence-driven trace before its error is trusted
+const int MinRounds = 10;
+const ulong DefaultRounds = 100;
+// changed surfaces are tested one by one against the cached rays from the
+// sun, so with more of them the first bounce cache is recorded again
+const int MaxChangedSurfaces = 64;
+
 bool fail(QString* errorMessage, const QString& message)
 {
     if (errorMessage)
@@ -48,19 +95,280 @@ QString formatRayProgress(ulong traced, ulong total)
         .arg(QString::number(static_cast<qulonglong>(total)));
 }
 
-ulong chunkSeed(ulong seed, qulonglong chunkIndex)
+// the bytes of the children arrays in the tree of instance
+qulonglong childrenBytes(const InstanceNode* instance)
+{
+    qulonglong ans = qulonglong(instance->children.capacity())*sizeof(InstanceNode*);
+    for (const InstanceNode* child : instance->children)
+        ans += childrenBytes(child);
+    return ans;
+}
+
+// everything that decides which rays a chunk traces and where its hits go
+QString checkpointKey(const RayTraceOptions& options)
+{
+    QString key = QString("rays=%1 seed=%2 chunk=%3 random=%4 strategy=%5 wavefront=%6 sun=%7x%8")
+        .arg(QString::number(static_cast<qulonglong>(options.rays)))
+        .arg(QString::number(static_cast<qulonglong>(options.seed)))
+        .arg(QString::number(static_cast<qulonglong>(qMax<ulong>(1, options.chunkSize))))
+        .arg(static_cast<int>(options.randomGenerator))
+        .arg(static_cast<int>(options.strategy))
+        .arg(QString::number(static_cast<qulonglong>(options.wavefrontSize)))
+        .arg(options.sunWidthDivisions)
+        .arg(options.sunHeightDivisions);
+    if (options.sunAperture == RayTraceSunAperture::Profiles)
+        key += " aperture=profiles";
+    if (options.airTableSize > 0)
+        key += QString(" air=%1").arg(options.airTableSize);
+    if (options.sortBounces)
+        key += " sort=bounces";
+    if (options.sunDirectionBank > 0)
+        key += QString(" sun_bank=%1").arg(QString::number(static_cast<qulonglong>(options.sunDirectionBank)));
+    if (options.specularSpread)
+        key += " spread=specular";
+    if (options.outputMode == RayTraceOutputMode::FluxGrid && options.fluxAccumulator) {
+        for (int t = 0; t < options.fluxAccumulator->getTargetCount(); ++t) {
+            const FluxAccumulator::Target& target = options.fluxAccumulator->getTarget(t);
+            key += QString(" target=%1:%2:%3x%4").arg(target.url, QString(target.isFront ? "front" : "back")).arg(target.rows).arg(target.cols);
+            if (target.window.isValid())
+                key += QString(":%1,%2,%3,%4").arg(target.window.min().x, 0, 'g', 17).arg(target.window.max().x, 0, 'g', 17)
+                           .arg(target.window.min().y, 0, 'g', 17).arg(target.window.max().y, 0, 'g', 17);
+        }
+    }
+    if (options.shardCount > 1)
+        key += QString(" shard=%1/%2").arg(options.shardIndex).arg(options.shardCount);
+    if (!options.checkpointTag.isEmpty())
+        key += " tag=" + options.checkpointTag;
+    return key;
+}
+
+InstanceNode* findInstance(InstanceNode* instance, const QString& url)
+{
+    if (instance->getURL() == url)
+        return instance;
+    for (InstanceNode* child : instance->children)
+        if (InstanceNode* ans = findInstance(child, url))
+            return ans;
+    return nullptr;
+}
+
+void addFields(QCryptographicHash* hash, SoFieldContainer* node)
+{
+    if (!node) return;
+    SbString fields;
+    node->get(fields);
+    hash->addData(QByteArray(node->getTypeId().getName().getString()));
+    hash->addData(fields.getString(), fields.getLength());
+}
+
+// what decides the rays leaving the field: its leaves, the sun, the air and
+// the sampling options; the receiver subtree is left out
+bool rayBundleKey(TSceneKit* scene, const RayTraceOptions& options, QString* key, QString* errorMessage)
+{
+    SceneInstanceTree instanceTree = SceneInstanceBuilder::build(scene);
+    InstanceNode* instanceLayout = instanceTree.layoutRoot;
+    if (!instanceLayout)
+        return fail(errorMessage, "Scene has no layout.");
+    instanceLayout->updateTree(Transform::Identity);
+    InstanceNode* receiver = findInstance(instanceLayout, options.receiverUrl);
+    if (!receiver)
+        return fail(errorMessage, QString("Receiver %1 was not found.").arg(options.receiverUrl));
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QString("rays=%1 seed=%2 chunk=%3 random=%4 strategy=%5 wavefront=%6 sun=%7x%8 receiver=%9")
+        .arg(QString::number(static_cast<qulonglong>(options.rays)))
+        .arg(QString::number(static_cast<qulonglong>(options.seed)))
+        .arg(QString::number(static_cast<qulonglong>(qMax<ulong>(1, options.chunkSize))))
+        .arg(static_cast<int>(options.randomGenerator))
+        .arg(static_cast<int>(options.strategy))
+        .arg(QString::number(static_cast<qulonglong>(options.wavefrontSize)))
+        .arg(options.sunWidthDivisions)
+        .arg(options.sunHeightDivisions)
+        .arg(options.receiverUrl).toUtf8());
+    if (options.sunAperture == RayTraceSunAperture::Profiles)
+        hash.addData(QByteArray(" aperture=profiles"));
+    if (options.airTableSize > 0)
+        hash.addData(QString(" air=%1").arg(options.airTableSize).toUtf8());
+    if (options.sortBounces)
+        hash.addData(QByteArray(" sort=bounces"));
+    if (options.sunDirectionBank > 0)
+        hash.addData(QString(" sun_bank=%1").arg(QString::number(static_cast<qulonglong>(options.sunDirectionBank))).toUtf8());
+    if (options.specularSpread)
+        hash.addData(QByteArray(" spread=specular"));
+    if (options.firstSplits > 1)
+        hash.addData(QString(" splits=%1").arg(options.firstSplits).toUtf8());
+
+    const SceneBVH field(instanceLayout, 4, receiver);
+    for (const SceneBVHInstance& leaf : field.findLeaves()) {
+        hash.addData(leaf.instance->getURL().toUtf8());
+        hash.addData(reinterpret_cast<const char*>(leaf.transform.mdir), sizeof(leaf.transform.mdir));
+        addFields(&hash, leaf.shape);
+        addFields(&hash, leaf.profile);
+        addFields(&hash, leaf.material);
+    }
+
+    if (SunKit* sunKit = static_cast<SunKit*>(scene->getPart("world.sun", false))) {
+        addFields(&hash, sunKit->getPart("position", false));
+        addFields(&hash, sunKit->getPart("shape", false));
+    }
+    addFields(&hash, scene->getPart("world.air.transmission", false));
+    *key = QString::fromLatin1(hash.result().toHex());
+    return true;
+}
+
+// what decides the rays from the sun: the sun, the cells of its aperture and
+// the sampling options; the surfaces are compared one by one
+QString firstBounceKey(const RayTraceOptions& options, SunKit* sunKit, const SunAperture* aperture)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QString("rays=%1 seed=%2 chunk=%3 random=%4 sun=%5x%6")
+        .arg(QString::number(static_cast<qulonglong>(options.rays)))
+        .arg(QString::number(static_cast<qulonglong>(options.seed)))
+        .arg(QString::number(static_cast<qulonglong>(qMax<ulong>(1, options.chunkSize))))
+        .arg(static_cast<int>(options.randomGenerator))
+        .arg(options.sunWidthDivisions)
+        .arg(options.sunHeightDivisions).toUtf8());
+    if (options.sunAperture == RayTraceSunAperture::Profiles)
+        hash.addData(QByteArray(" aperture=profiles"));
+    if (options.sunDirectionBank > 0)
+        hash.addData(QString(" sun_bank=%1").arg(QString::number(static_cast<qulonglong>(options.sunDirectionBank))).toUtf8());
+    if (options.specularSpread)
+        hash.addData(QByteArray(" spread=specular"));
+    addFields(&hash, sunKit->getPart("position", false));
+    addFields(&hash, sunKit->getPart("shape", false));
+
+    // the aperture in world frame, by its first cell and the sun direction
+    const Transform sunTransform = tgf::makeTransform(sunKit->m_transform);
+    const vec3d frame[3] = {
+        sunTransform.transformPoint(aperture->Sample(0., 0., 0, 0)),
+        sunTransform.transformPoint(aperture->Sample(1., 1., 0, 0)),
+        sunTransform.transformVector(vec3d::UnitZ)
+    };
+    hash.addData(reinterpret_cast<const char*>(frame), sizeof(frame));
+    const std::vector<QPair<int, int>>& cells = aperture->getCells();
+    hash.addData(reinterpret_cast<const char*>(cells.data()), static_cast<int>(cells.size()*sizeof(cells[0])));
+    const double area = aperture->getArea();
+    hash.addData(reinterpret_cast<const char*>(&area), sizeof(area));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+// what decides the intersections of a surface: where it is, its shape,
+// profile and material
+QByteArray surfaceHash(const SceneBVHInstance& leaf)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(reinterpret_cast<const char*>(leaf.transform.mdir), sizeof(leaf.transform.mdir));
+    addFields(&hash, leaf.shape);
+    addFields(&hash, leaf.profile);
+    addFields(&hash, leaf.material);
+    return hash.result();
+}
+
+// turns the sun of the scene and its trackers, the instance tree is updated after;
+// the shapes of the trackers are not traced and are turned only with shapes
+void placeSun(TSceneKit* scene, SunPosition* sunPosition, const RayTraceSunPosition& position, bool shapes = false)
+{
+    sunPosition->azimuth = position.azimuth;
+    sunPosition->elevation = position.elevation;
+    scene->updateTrackers(shapes);
+}
+
+// the workers of a run summed over the processor groups they ran in; pinned
+// workers ran in the group of their processor
+std::vector<RayTraceProcessorGroup> findProcessorGroups(const TraceScheduler& scheduler, const CpuTopology& topology)
 {
-    quint64 value = static_cast<quint64>(seed);
-    value += 0x9e3779b97f4a7c15ull + (chunkIndex << 6) + (chunkIndex >> 2);
-    value ^= value >> 30;
-    value *= 0xbf58476d1ce4e5b9ull;
-    value ^= value >> 27;
-    value *= 0x94d049bb133111ebull;
-    value ^= value >> 31;
-    return static_cast<ulong>(value);
+    std::vector<RayTraceProcessorGroup> ans(static_cast<size_t>(topology.getGroupCount()));
+    for (size_t g = 0; g < ans.size(); ++g) {
+        ans[g].group = static_cast<int>(g);
+        ans[g].processors = static_cast<int>(topology.getGroupCpus(static_cast<int>(g)).size());
+    }
+    for (int w = 0; w < scheduler.getWorkerCount(); ++w) {
+        const int cpu = scheduler.getWorkerCpu(w);
+        const int group = cpu >= 0 ? topology.findGroup(cpu) : scheduler.getWorkerGroup(w);
+        RayTraceProcessorGroup& item = ans[static_cast<size_t>(qMax(0, group))];
+        item.workers++;
+        item.rays += scheduler.getWorkerRays(w);
+        item.busySeconds += static_cast<double>(scheduler.getWorkerBusyNs(w)) * 1e-9;
+    }
+    const double runSeconds = static_cast<double>(scheduler.getRunNs()) * 1e-9;
+    for (RayTraceProcessorGroup& item : ans)
+        item.utilization = runSeconds > 0. && item.processors > 0 ? item.busySeconds / (runSeconds * item.processors) : 0.;
+    return ans;
 }
+
+// puts back the sun a batch of sun positions started from
+class SunRestorer
+{
+public:
+    SunRestorer(TSceneKit* scene, SunPosition* sunPosition):
+        m_scene(scene),
+        m_sunPosition(sunPosition)
+    {
+        m_position.azimuth = sunPosition->azimuth.getValue();
+        m_position.elevation = sunPosition->elevation.getValue();
+    }
+
+    ~SunRestorer()
+    {
+        placeSun(m_scene, m_sunPosition, m_position, true);
+    }
+
+private:
+    TSceneKit* m_scene;
+    SunPosition* m_sunPosition;
+    RayTraceSunPosition m_position;
+};
+
+// references to the nodes made for a trace, released with it
+class NodeReferences
+{
+public:
+    NodeReferences() = default;
+    NodeReferences(const NodeReferences&) = delete;
+    NodeReferences& operator=(const NodeReferences&) = delete;
+
+    ~NodeReferences()
+    {
+        for (SoNode* node : m_nodes)
+            node->unref();
+    }
+
+    void add(SoNode* node)
+    {
+        node->ref();
+        m_nodes.push_back(node);
+    }
+
+private:
+    std::vector<SoNode*> m_nodes;
+};
+
+// keeps the pages of the process in memory while it lives
+class MemoryLock
+{
+public:
+    MemoryLock(bool on, QString* errorMessage):
+        m_locked(on && HugePages::lockAll(errorMessage)) {}
+
+    ~MemoryLock()
+    {
+        if (m_locked) HugePages::unlockAll();
+    }
+
+    bool isLocked() const {return m_locked;}
+
+private:
+    bool m_locked;
+};
 }
 
+// a trace of the field that records the rays leaving it, or of the receiver from them
+struct RayTraceRunner::BundlePass
+{
+    bool replay = false;
+    RayBundle* bundle = nullptr;
+};
+
 bool RayTraceRunner::trace(TSceneKit* scene,
                            const RayTraceOptions& options,
                            RayTraceResult* result,
@@ -68,11 +376,205 @@ bool RayTraceRunner::trace(TSceneKit* scene,
                            const ProgressCallback& progress,
                            const HitCallback& hitCallback,
                            const WorkerHitCallbackFactory& workerHitCallbackFactory,
-                           const CancellationCallback& cancellation) const
+                           const CancellationCallback& cancellation,
+                           const SunPositionCallback& sunPositionDone) const
+{
+    m_cancel.store(false, std::memory_order_relaxed);
+    if (options.fluxModel == RayTraceFluxModel::Convolution)
+        return traceConvolution(scene, options, result, errorMessage, progress);
+    if (!options.receiverUrl.isEmpty())
+        return traceReceiver(scene, options, result, errorMessage, progress, hitCallback, workerHitCallbackFactory, cancellation);
+    return traceScene(scene, options, result, errorMessage, progress, hitCallback, workerHitCallbackFactory, cancellation, sunPositionDone, nullptr);
+}
+
+/*!
+ * Sums the analytic images of the reflectors on the flux grids of
+ * options.fluxAccumulator, in the tree and sun of a trace; the materials
+ * are drawn from a generator seeded with options.seed.
+ */
+bool RayTraceRunner::traceConvolution(TSceneKit* scene,
+                                      const RayTraceOptions& options,
+                                      RayTraceResult* result,
+                                      QString* errorMessage,
+                                      const ProgressCallback& progress) const
 {
     if (result)
         *result = RayTraceResult();
 
+    if (!scene)
+        return fail(errorMessage, "Scene is not loaded.");
+    if (options.outputMode != RayTraceOutputMode::FluxGrid || !options.fluxAccumulator)
+        return fail(errorMessage, "Convolution flux requires FluxGrid output mode and a flux accumulator.");
+    if (!options.receiverUrl.isEmpty() || !options.sunPositions.isEmpty() || !options.checkpointFile.isEmpty() ||
+        options.shardCount > 1 || options.targetRelativeError > 0. || options.powerBudget || options.reflectorAttribution || options.cameraImage || options.adaptiveFlux || options.aimImages)
+        return fail(errorMessage, "Convolution flux does not support receivers, sun position batches, checkpoints, shards, convergence, power budgets, attribution, camera images, adaptive flux or aim images.");
+    if (options.symmetryNormal.norm2() > 0. || options.translationAxis >= 0 || !options.variants.isEmpty())
+        return fail(errorMessage, "Convolution flux does not support symmetry planes, translational symmetry or variants.");
+    if (options.convolutionSurfaceSamples < 1 || options.convolutionMaterialSamples < 1)
+        return fail(errorMessage, "Convolution samples must be greater than zero.");
+
+    SunKit* sunKit = static_cast<SunKit*>(scene->getPart("world.sun", false));
+    if (!sunKit)
+        return fail(errorMessage, "Scene has no sun.");
+    SunPosition* sunPosition = static_cast<SunPosition*>(sunKit->getPart("position", false));
+    SunShape* sunShape = static_cast<SunShape*>(sunKit->getPart("shape", false));
+    if (!sunShape || !sunPosition)
+        return fail(errorMessage, "Scene sun is missing position or shape data.");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    reportProgress(progress, "Building ray-tracing instance tree.");
+    SceneInstanceTree instanceTree = SceneInstanceBuilder::build(scene);
+    InstanceNode* instanceLayout = instanceTree.layoutRoot;
+    if (!instanceLayout)
+        return fail(errorMessage, "Scene has no layout.");
+    instanceLayout->updateTree(Transform::Identity);
+
+    FluxAccumulator* flux = options.fluxAccumulator;
+    QString fluxError;
+    if (!flux->bind(instanceLayout, &fluxError))
+        return fail(errorMessage, fluxError);
+
+    AirTransmission* air = static_cast<AirTransmission*>(scene->getPart("world.air.transmission", false));
+    if (air && air->getTypeId() == AirVacuum::getClassTypeId())
+        air = nullptr;
+
+    reportProgress(progress, "Compiling scene BVH.");
+    SceneBVH sceneBVH(instanceLayout);
+    const Transform sunTransform = tgf::makeTransform(sunKit->m_transform);
+    ConvolutionFlux convolution(sceneBVH, sunShape, sunTransform.transformVector(vec3d::UnitZ), sunPosition->irradiance.getValue(), air);
+    convolution.setSamples(options.convolutionSurfaceSamples, options.convolutionMaterialSamples);
+
+    reportProgress(progress, "Adding reflector images.");
+    RandomSTL rand(options.seed, Random::StreamSize);
+    convolution.addImages(*flux, rand);
+    // releases the bound surfaces, no worker holding hits
+    flux->beginWorkers(0);
+    flux->endWorkers();
+
+    if (result) {
+        result->outputMode = options.outputMode;
+        result->elapsedSeconds = timer.elapsed()/1000.;
+        result->irradiance = sunPosition->irradiance.getValue();
+        result->powerPerRay = 1.;
+    }
+    return true;
+}
+
+/*!
+ * Traces the receiver from the rays of options.rayBundle, recording them
+ * first if the key of the field, sun and options changed. The recording
+ * trace reports no hits; the result is that of the receiver, with the
+ * power per ray of the recording.
+ */
+bool RayTraceRunner::traceReceiver(TSceneKit* scene,
+                                   const RayTraceOptions& options,
+                                   RayTraceResult* result,
+                                   QString* errorMessage,
+                                   const ProgressCallback& progress,
+                                   const HitCallback& hitCallback,
+                                   const WorkerHitCallbackFactory& workerHitCallbackFactory,
+                                   const CancellationCallback& cancellation) const
+{
+    if (result)
+        *result = RayTraceResult();
+
+    if (!scene)
+        return fail(errorMessage, "Scene is not loaded.");
+    if (!options.rayBundle)
+        return fail(errorMessage, "A receiver trace requires a ray bundle.");
+    if (options.outputMode == RayTraceOutputMode::PhotonBuffer)
+        return fail(errorMessage, "Receiver traces support NoOutput and FluxGrid modes only.");
+    if (!options.sunPositions.isEmpty())
+        return fail(errorMessage, "Receiver traces do not support sun position batches.");
+    if (!options.checkpointFile.isEmpty())
+        return fail(errorMessage, "Receiver traces do not support checkpoints.");
+    if (options.shardCount > 1)
+        return fail(errorMessage, "Receiver traces do not support shards.");
+    if (options.targetRelativeError > 0.)
+        return fail(errorMessage, "Receiver traces do not support convergence-driven tracing.");
+    // the ray bundle records directions without weights
+    if (options.transport == RayTraceTransport::Weighted)
+        return fail(errorMessage, "Receiver traces do not support weighted transport.");
+
+    QString key;
+    if (!rayBundleKey(scene, options, &key, errorMessage))
+        return false;
+
+    RayBundle* bundle = options.rayBundle;
+    bool recorded = false;
+    double recordSeconds = 0.;
+    if (bundle->key != key) {
+        *bundle = RayBundle();
+        RayTraceOptions recordOptions = options;
+        recordOptions.outputMode = RayTraceOutputMode::NoOutput;
+        recordOptions.fluxAccumulator = nullptr;
+        BundlePass pass;
+        pass.bundle = bundle;
+        RayTraceResult recordResult;
+        if (!traceScene(scene, recordOptions, &recordResult, errorMessage, progress, HitCallback(), WorkerHitCallbackFactory(), cancellation, SunPositionCallback(), &pass)) {
+            *bundle = RayBundle();
+            return false;
+        }
+        if (recordResult.canceled) {
+            *bundle = RayBundle();
+            if (result) {
+                *result = recordResult;
+                result->outputMode = options.outputMode;
+                result->raysTraced = 0;
+            }
+            return true;
+        }
+        bundle->key = key;
+        bundle->sunRays = options.rays;
+        bundle->sunApertureArea = recordResult.sunApertureArea;
+        bundle->irradiance = recordResult.irradiance;
+        recorded = true;
+        recordSeconds = recordResult.elapsedSeconds;
+    }
+
+    RayTraceResult replayResult;
+    if (!bundle->rays.empty()) {
+        RayTraceOptions replayOptions = options;
+        replayOptions.rays = static_cast<ulong>(bundle->rays.size());
+        BundlePass pass;
+        pass.replay = true;
+        pass.bundle = bundle;
+        if (!traceScene(scene, replayOptions, &replayResult, errorMessage, progress, hitCallback, workerHitCallbackFactory, cancellation, SunPositionCallback(), &pass))
+            return false;
+    }
+    if (result) {
+        *result = replayResult;
+        result->outputMode = options.outputMode;
+        result->sunApertureArea = bundle->sunApertureArea;
+        result->irradiance = bundle->irradiance;
+        result->powerPerRay = bundle->powerPerRay();
+        result->elapsedSeconds += recordSeconds;
+        result->raysPerSecond = result->elapsedSeconds > 0. ? static_cast<double>(result->raysTraced) / result->elapsedSeconds : 0.;
+        result->rayBundleRecorded = recorded;
+        result->rayBundleRays = static_cast<ulong>(bundle->rays.size());
+    }
+    return true;
+}
+
+bool RayTraceRunner::traceScene(TSceneKit* scene,
+                                const RayTraceOptions& options,
+                                RayTraceResult* result,
+                                QString* errorMessage,
+                                const ProgressCallback& progress,
+                                const HitCallback& hitCallback,
+                                const WorkerHitCallbackFactory& workerHitCallbackFactory,
+                                const CancellationCallback& cancellation,
+                                const SunPositionCallback& sunPositionDone,
+                                const BundlePass* pass) const
+{
+    if (result) {
+        *result = RayTraceResult();
+        result->memory.residentBytes = MemoryUsage::getResidentBytes();
+    }
+    startProgress(0, qMax(1, static_cast<int>(options.sunPositions.size())));
+
     if (!scene)
         return fail(errorMessage, "Scene is not loaded.");
     if (options.rays == 0)
@@ -81,25 +583,313 @@ bool RayTraceRunner::trace(TSceneKit* scene,
         return fail(errorMessage, "Sun grid dimensions must be greater than zero.");
     if (options.outputMode == RayTraceOutputMode::PhotonBuffer && !options.photonBuffer)
         return fail(errorMessage, "PhotonBuffer output mode requires a photon buffer.");
-    if (options.outputMode != RayTraceOutputMode::NoOutput && options.outputMode != RayTraceOutputMode::PhotonBuffer)
+    if ((options.endPhotonExport || !options.exportSurfaceUrls.isEmpty()) && options.outputMode != RayTraceOutputMode::PhotonBuffer)
+        return fail(errorMessage, "Photon export options require PhotonBuffer output mode.");
+    if (options.outputMode == RayTraceOutputMode::FluxGrid && !options.fluxAccumulator)
+        return fail(errorMessage, "FluxGrid output mode requires a flux accumulator.");
+    if (options.outputMode != RayTraceOutputMode::NoOutput && options.outputMode != RayTraceOutputMode::PhotonBuffer && options.outputMode != RayTraceOutputMode::FluxGrid)
         return fail(errorMessage, "Unsupported ray trace output mode.");
+    if (options.strategy == RayTraceStrategy::Wavefront && options.outputMode == RayTraceOutputMode::PhotonBuffer)
+        return fail(errorMessage, "Wavefront tracing supports NoOutput and FluxGrid modes only.");
+    if (options.strategy == RayTraceStrategy::Wavefront && options.wavefrontSize == 0)
+        return fail(errorMessage, "Wavefront size must be greater than zero.");
+    if (options.sortBounces && options.strategy != RayTraceStrategy::Wavefront)
+        return fail(errorMessage, "Sorting bounces needs wavefront tracing.");
+    // a wavefront draws for many rays in turn, which one stream per ray cannot follow
+    if (options.strategy == RayTraceStrategy::Wavefront && options.randomGenerator == RayTraceRandomGenerator::RayIndexed)
+        return fail(errorMessage, "Random streams per ray need depth-first tracing.");
+    if (options.airTableSize < 0)
+        return fail(errorMessage, "Air table size must not be negative.");
+    if (options.neighbourCount < 0)
+        return fail(errorMessage, "Neighbour count must not be negative.");
+    if (options.refitRebuildRatio != 0. && !(options.refitRebuildRatio >= 1.))
+        return fail(errorMessage, "Refit rebuild ratio must be zero or at least one.");
+    const bool weighted = options.transport == RayTraceTransport::Weighted;
+    if (weighted && !(options.rouletteWeight > 0. && options.rouletteWeight <= 1.))
+        return fail(errorMessage, "Roulette weight must be greater than zero and at most one.");
+    if (weighted && options.outputMode == RayTraceOutputMode::PhotonBuffer)
+        return fail(errorMessage, "Weighted transport supports NoOutput and FluxGrid modes only.");
+    if (weighted && !options.checkpointFile.isEmpty())
+        return fail(errorMessage, "Checkpoints do not support weighted transport.");
+    if (options.firstSplits < 1)
+        return fail(errorMessage, "First splits must be at least one.");
+    if (options.firstSplits > 1 && (!weighted || options.strategy != RayTraceStrategy::DepthFirst))
+        return fail(errorMessage, "First splits need weighted depth-first traces.");
+    const bool checkpointing = !options.checkpointFile.isEmpty();
+    if (options.resume && !checkpointing)
+        return fail(errorMessage, "Resuming a trace requires a checkpoint file.");
+    if (checkpointing && options.outputMode == RayTraceOutputMode::PhotonBuffer)
+        return fail(errorMessage, "Checkpoints support NoOutput and FluxGrid modes only.");
+    if (checkpointing && !(options.checkpointInterval >= 0.))
+        return fail(errorMessage, "Checkpoint interval must not be negative.");
+    if (!(options.targetGrainMs >= 0.))
+        return fail(errorMessage, "Target grain must not be negative.");
+    if (options.shardCount < 1 || options.shardIndex < 0 || options.shardIndex >= options.shardCount)
+        return fail(errorMessage, "Shard index must be at least zero and less than the shard count.");
+    if (options.shardCount > 1 && options.outputMode == RayTraceOutputMode::PhotonBuffer)
+        return fail(errorMessage, "Sharded traces support NoOutput and FluxGrid modes only.");
+    const bool sunBatch = !options.sunPositions.isEmpty();
+    if (sunBatch && options.outputMode == RayTraceOutputMode::PhotonBuffer)
+        return fail(errorMessage, "Sun position batches support NoOutput and FluxGrid modes only.");
+    if (sunBatch && checkpointing)
+        return fail(errorMessage, "Sun position batches do not support checkpoints.");
+    if (!(options.targetRelativeError >= 0.) || !qIsFinite(options.targetRelativeError))
+        return fail(errorMessage, "Target relative error must be finite and not negative.");
+    const bool converging = options.targetRelativeError > 0.;
+    const ulong roundRays = options.roundRays > 0 ? options.roundRays : qMax<ulong>(1, options.rays / DefaultRounds);
+    if (converging && !(options.targetFluxFraction >= 0. && options.targetFluxFraction <= 1.))
+        return fail(errorMessage, "Target flux fraction must be between zero and one.");
+    if (converging && roundRays > options.rays)
+        return fail(errorMessage, "Round rays must not exceed the ray count.");
+    if (converging && !options.convergenceValues && options.outputMode != RayTraceOutputMode::FluxGrid)
+        return fail(errorMessage, "Convergence-driven tracing requires FluxGrid output or convergence values.");
+    if (converging && (checkpointing || sunBatch || options.shardCount > 1))
+        return fail(errorMessage, "Convergence-driven tracing does not support checkpoints, sun position batches or shards.");
+    if (options.powerBudget && (checkpointing || sunBatch || pass))
+        return fail(errorMessage, "Power budgets do not support checkpoints, sun position batches or receivers.");
+    if (options.reflectorAttribution && (options.outputMode == RayTraceOutputMode::PhotonBuffer || checkpointing || sunBatch || pass))
+        return fail(errorMessage, "Reflector attribution does not support photon buffers, checkpoints, sun position batches or receivers.");
+    if (options.cameraImage && (options.outputMode == RayTraceOutputMode::PhotonBuffer || checkpointing || sunBatch || pass))
+        return fail(errorMessage, "Camera images do not support photon buffers, checkpoints, sun position batches or receivers.");
+    if (options.aimImages && (options.outputMode == RayTraceOutputMode::PhotonBuffer || checkpointing || sunBatch || pass))
+        return fail(errorMessage, "Aim images do not support photon buffers, checkpoints, sun position batches or receivers.");
+    if (options.adaptiveFlux && (options.outputMode == RayTraceOutputMode::PhotonBuffer || checkpointing || sunBatch || pass || converging || options.shardCount > 1))
+        return fail(errorMessage, "Adaptive flux does not support photon buffers, checkpoints, sun position batches, receivers, convergence or shards.");
+    FirstBounceCache* firstBounces = options.firstBounceCache;
+    if (firstBounces && (options.strategy != RayTraceStrategy::DepthFirst || weighted || options.outputMode == RayTraceOutputMode::PhotonBuffer || options.substreamRandom))
+        return fail(errorMessage, "First bounce caches need depth-first analog traces in NoOutput or FluxGrid mode with the streams of the random generator.");
+    if (firstBounces && (pass || sunBatch || checkpointing || options.shardCount > 1 || converging || options.powerBudget || options.reflectorAttribution || options.cameraImage || options.adaptiveFlux || options.aimImages))
+        return fail(errorMessage, "First bounce caches do not support receivers, sun position batches, checkpoints, shards, convergence, power budgets, attribution, camera images, adaptive flux or aim images.");
+    const bool symmetric = options.symmetryNormal.norm2() > 0.;
+    if (symmetric && (!qIsFinite(options.symmetryNormal.norm2()) || !qIsFinite(options.symmetryOffset)))
+        return fail(errorMessage, "Symmetry plane must be finite.");
+    if (symmetric && (options.outputMode != RayTraceOutputMode::FluxGrid || !options.fluxAccumulator))
+        return fail(errorMessage, "Symmetry planes require FluxGrid output mode and a flux accumulator.");
+    if (symmetric && (pass || sunBatch || checkpointing || converging || options.powerBudget || options.reflectorAttribution || options.cameraImage || options.adaptiveFlux || options.aimImages || firstBounces))
+        return fail(errorMessage, "Symmetry planes do not support receivers, sun position batches, checkpoints, convergence, power budgets, attribution, camera images, adaptive flux, aim images or first bounce caches.");
+    const bool cellPilot = options.cellPilotRays > 0;
+    if (cellPilot && (!weighted || options.outputMode != RayTraceOutputMode::FluxGrid || !options.fluxAccumulator))
+        return fail(errorMessage, "Cell pilots require weighted transport, FluxGrid output mode and a flux accumulator.");
+    if (cellPilot && !(options.cellPilotUniform > 0. && options.cellPilotUniform <= 1.))
+        return fail(errorMessage, "Cell pilot uniform fraction must be greater than zero and at most one.");
+    if (cellPilot && !(options.cellPilotReuseDeg >= 0. && options.cellPilotReuseDeg <= 180.))
+        return fail(errorMessage, "Cell pilot reuse angle must be between zero and 180 degrees.");
+    const bool reflectorRays = options.sunAperture == RayTraceSunAperture::Reflectors;
+    if (reflectorRays && !weighted)
+        return fail(errorMessage, "Rays from the reflectors require weighted transport.");
+    if (reflectorRays && (cellPilot || symmetric || sunBatch || pass))
+        return fail(errorMessage, "Rays from the reflectors do not support cell pilots, symmetry planes, sun position batches or receivers.");
+    const bool translational = options.translationAxis >= 0;
+    if (options.translationAxis < -1 || options.translationAxis > 2)
+        return fail(errorMessage, "Translation axis must be 0, 1 or 2, or -1 for none.");
+    if (translational && options.strategy != RayTraceStrategy::DepthFirst)
+        return fail(errorMessage, "Translational symmetry needs depth-first tracing.");
+    if (translational && (reflectorRays || cellPilot || symmetric || sunBatch || pass || firstBounces))
+        return fail(errorMessage, "Translational symmetry does not support rays from the reflectors, cell pilots, symmetry planes, sun position batches, receivers or first bounce caches.");
+    const bool varying = !options.variants.isEmpty();
+    if (varying && (options.outputMode != RayTraceOutputMode::FluxGrid || !options.fluxAccumulator))
+        return fail(errorMessage, "Variants require FluxGrid output mode and a flux accumulator.");
+    if (varying && (options.randomGenerator != RayTraceRandomGenerator::RayIndexed || options.substreamRandom || options.strategy != RayTraceStrategy::DepthFirst))
+        return fail(errorMessage, "Variants need depth-first traces with the ray-indexed random generator, whose rays can be drawn again.");
+    if (varying && (pass || sunBatch || checkpointing || converging || symmetric || cellPilot || options.powerBudget || options.reflectorAttribution || options.cameraImage || options.adaptiveFlux || options.aimImages || firstBounces || hitCallback || workerHitCallbackFactory))
+        return fail(errorMessage, "Variants do not support receivers, sun position batches, checkpoints, convergence, symmetry planes, cell pilots, power budgets, attribution, camera images, adaptive flux, aim images, first bounce caches or hit callbacks.");
+    if (options.specularSpread && (options.strategy != RayTraceStrategy::DepthFirst || options.outputMode == RayTraceOutputMode::PhotonBuffer || translational || varying))
+        return fail(errorMessage, "Specular spreads need depth-first traces without photon buffers, translational symmetry or variants.");
+    if (options.firstSplits > 1 && (options.specularSpread || translational || varying))
+        return fail(errorMessage, "First splits do not support specular spreads, translational symmetry or variants.");
+    CompiledScene* compiled = options.compiledScene;
+    if (compiled && (pass || options.sunPositions.size() > 1))
+        return fail(errorMessage, "Compiled scenes do not support receivers or batches of more than one sun position.");
+    for (const RayTraceVariant& variant : options.variants)
+        if (!variant.fluxAccumulator || variant.fluxAccumulator->getTargetCount() != options.fluxAccumulator->getTargetCount())
+            return fail(errorMessage, "Every variant needs a flux accumulator with the targets of the scene.");
 
-    auto isCanceled = [&cancellation]() {
-        return cancellation && cancellation();
+    auto isCanceled = [this, &cancellation]() {
+        return m_cancel.load(std::memory_order_relaxed) || (cancellation && cancellation());
     };
 
     SunKit* sunKit = static_cast<SunKit*>(scene->getPart("world.sun", false));
     if (!sunKit)
         return fail(errorMessage, "Scene has no sun.");
+    SunPosition* sunPosition = static_cast<SunPosition*>(sunKit->getPart("position", false));
+    std::unique_ptr<SunRestorer> sunRestorer;
+    if (sunBatch && sunPosition) {
+        sunRestorer.reset(new SunRestorer(scene, sunPosition));
+        placeSun(scene, sunPosition, options.sunPositions.front());
+    }
+
+    // the tree and BVH of the previous call, if compiled for the same scene and options
+    QString compileKey;
+    if (compiled && !compiled->key.isEmpty())
+        compileKey = QString("%1 precision=%2 neighbours=%3 sun_view=%4 sun=%5x%6")
+            .arg(QString::fromLatin1(compiled->key.toHex()))
+            .arg(static_cast<int>(options.precision))
+            .arg(options.neighbourCount)
+            .arg(options.sunView ? 1 : 0)
+            .arg(options.sunWidthDivisions)
+            .arg(options.sunHeightDivisions);
+    const bool reused = compiled && !compileKey.isEmpty() && compiled->compiledKey == compileKey && compiled->sceneBVH;
+    if (compiled && !reused)
+        compiled->clear();
 
     reportProgress(progress, "Preparing scene.");
-    reportProgress(progress, "Building ray-tracing instance tree.");
-    SceneInstanceTree instanceTree = SceneInstanceBuilder::build(scene);
+    SceneInstanceTree localTree;
+    SceneInstanceTree& instanceTree = compiled ? compiled->instanceTree : localTree;
+    if (!reused) {
+        reportProgress(progress, "Building ray-tracing instance tree.");
+        TraceEventScope event("build instance tree", "setup");
+        instanceTree = SceneInstanceBuilder::build(scene);
+    }
     InstanceNode* instanceLayout = instanceTree.layoutRoot;
     if (!instanceLayout)
         return fail(errorMessage, "Scene has no layout.");
+    if (result && instanceTree.arena)
+        result->memory.instanceTreeBytes = instanceTree.arena->getMemoryUsage() + childrenBytes(instanceTree.sceneRoot);
 
-    instanceLayout->updateTree(Transform::Identity);
+    {
+        TraceEventScope event("updateTree", "setup");
+        instanceLayout->updateTree(Transform::Identity);
+    }
+
+    // a bundle pass traces the field without the receiver, or the receiver alone
+    InstanceNode* receiver = nullptr;
+    if (pass) {
+        receiver = findInstance(instanceLayout, options.receiverUrl);
+        if (!receiver)
+            return fail(errorMessage, QString("Receiver %1 was not found.").arg(options.receiverUrl));
+    }
+
+    FluxAccumulator* flux = options.outputMode == RayTraceOutputMode::FluxGrid ? options.fluxAccumulator : nullptr;
+    QString fluxError;
+    if (flux && !flux->bind(instanceLayout, &fluxError))
+        return fail(errorMessage, fluxError);
+    if (flux)
+        flux->setExactWeights(options.randomGenerator == RayTraceRandomGenerator::RayIndexed);
+    // each variant draws from copies of the materials it edits, variant 0
+    // being the scene; the copies live as long as the trace
+    MaterialVariants materialVariants;
+    std::vector<FluxAccumulator*> variantFluxes;
+    NodeReferences variantMaterials;
+    if (varying) {
+        variantFluxes.push_back(flux);
+        for (const RayTraceVariant& variant : options.variants) {
+            const int v = materialVariants.addVariant();
+            QHash<MaterialRT*, MaterialRT*> copies;
+            for (const RayTraceMaterialEdit& edit : variant.edits) {
+                QString editError;
+                TShapeKit* kit = dynamic_cast<TShapeKit*>(SceneEditor::findNode(scene, edit.url, &editError));
+                if (!kit)
+                    return fail(errorMessage, editError.isEmpty() ? QString("%1 is not a surface.").arg(edit.url) : editError);
+                MaterialRT* material = static_cast<MaterialRT*>(kit->materialRT.getValue());
+                if (!material)
+                    return fail(errorMessage, QString("%1 has no material.").arg(edit.url));
+                MaterialRT*& copy = copies[material];
+                if (!copy) {
+                    copy = static_cast<MaterialRT*>(material->copy());
+                    variantMaterials.add(copy);
+                    materialVariants.replace(v, material, copy);
+                }
+                SoField* field = copy->getField(edit.field.toLatin1().data());
+                if (!field || !SceneEditor::setField(field, edit.value))
+                    return fail(errorMessage, QString("\"%1\" is not a value of %2 of the material of %3.").arg(edit.value, edit.field, edit.url));
+            }
+            FluxAccumulator* variantFlux = variant.fluxAccumulator;
+            if (!variantFlux->bind(instanceLayout, &fluxError))
+                return fail(errorMessage, fluxError);
+            variantFlux->setExactWeights(true);
+            variantFluxes.push_back(variantFlux);
+        }
+        // the copies update what they derive from their fields
+        SoDB::getSensorManager()->processDelayQueue(TRUE);
+    }
+    const MaterialVariants* tracingVariants = varying ? &materialVariants : nullptr;
+    // the flux grids of the scene and of every variant
+    std::vector<FluxAccumulator*> fluxes = variantFluxes;
+    if (!varying && flux)
+        fluxes.push_back(flux);
+
+    ReflectorAttribution* attribution = options.reflectorAttribution;
+    QString attributionError;
+    if (attribution && !attribution->bind(instanceLayout, &attributionError))
+        return fail(errorMessage, attributionError);
+    CameraImage* cameraImage = options.cameraImage;
+    QString cameraImageError;
+    if (cameraImage && !cameraImage->bind(instanceLayout, &cameraImageError))
+        return fail(errorMessage, cameraImageError);
+    AdaptiveFlux* adaptiveFlux = options.adaptiveFlux;
+    QString adaptiveFluxError;
+    if (adaptiveFlux && !adaptiveFlux->bind(instanceLayout, &adaptiveFluxError))
+        return fail(errorMessage, adaptiveFluxError);
+    AimImages* aimImages = options.aimImages;
+    QString aimImagesError;
+    if (aimImages && !aimImages->bind(instanceLayout, &aimImagesError))
+        return fail(errorMessage, aimImagesError);
+
+    std::unique_ptr<SceneBVH> localBVH;
+    std::unique_ptr<SceneBVH>& compiledBVH = compiled ? compiled->sceneBVH : localBVH;
+    if (!reused) {
+        reportProgress(progress, "Compiling scene BVH.");
+        compiledBVH.reset(new SceneBVH(pass && pass->replay ? receiver : instanceLayout, 4, pass && !pass->replay ? receiver : nullptr));
+        compiledBVH->setSinglePrecision(options.precision == RayTracePrecision::Single);
+        if (compiled)
+            compiled->compiledKey = compileKey;
+    }
+    SceneBVH& sceneBVH = *compiledBVH;
+    if (result) {
+        result->memory.sceneBVHBytes = sceneBVH.getMemoryUsage();
+        for (const ShapeRT* shape : sceneBVH.getShapes())
+            result->memory.geometryBytes += shape->getMemoryUsage();
+    }
+    const ulong wavefrontSize = options.strategy == RayTraceStrategy::Wavefront ? options.wavefrontSize : 0;
+
+    // surfaces numbered in the order of the compiled leaves
+    QHash<InstanceNode*, int> budgetSurfaces;
+    QStringList budgetUrls;
+    if (options.powerBudget) {
+        for (const SceneBVHInstance& leaf : sceneBVH.findLeaves()) {
+            if (budgetSurfaces.contains(leaf.instance))
+                continue;
+            budgetSurfaces.insert(leaf.instance, budgetUrls.size());
+            budgetUrls << leaf.instance->getURL();
+        }
+    }
+    std::vector<PowerBudget> budgets;
+    auto beginBudgets = [&](int workerCount) {
+        budgets.assign(options.powerBudget ? static_cast<size_t>(workerCount) : 0, PowerBudget());
+        for (PowerBudget& budget : budgets)
+            budget.resize(budgetUrls.size());
+    };
+    auto setBudget = [&](RayTracer& tracer, int workerIndex) {
+        if (!budgets.empty())
+            tracer.setPowerBudget(&budgets[static_cast<size_t>(workerIndex)], &budgetSurfaces);
+    };
+    // counted in builds with TONATIUHPP_TRACE_STATS only
+    std::vector<TraceStatistics> statistics;
+    auto beginStatistics = [&](int workerCount) {
+        statistics.assign(TraceStatistics::isEnabled() ? static_cast<size_t>(workerCount) : 0, TraceStatistics());
+    };
+    auto setStatistics = [&](RayTracer& tracer, int workerIndex) {
+        if (!statistics.empty())
+            tracer.setStatistics(&statistics[static_cast<size_t>(workerIndex)]);
+    };
+    // started by each worker thread, read once the workers ended
+    std::unique_ptr<PerfCounters[]> perfCounters;
+    int perfCounterCount = 0;
+    auto beginPerfCounters = [&](int workerCount) {
+        perfCounterCount = options.perfCounters ? workerCount : 0;
+        perfCounters.reset(perfCounterCount > 0 ? new PerfCounters[static_cast<size_t>(perfCounterCount)] : nullptr);
+    };
+    auto endPerfCounters = [&]() {
+        if (!result)
+            return;
+        result->perfCounters.clear();
+        for (int workerIndex = 0; workerIndex < perfCounterCount; ++workerIndex) {
+            const PerfCounters& counters = perfCounters[workerIndex];
+            if (!counters.isStarted() && result->perfCountersError.isEmpty())
+                result->perfCountersError = counters.getError();
+            result->perfCounters.push_back(counters.read());
+        }
+    };
 
     reportProgress(progress, "Sizing sun aperture.");
     sunKit->setBox(instanceLayout->getBox());
@@ -109,17 +899,116 @@ bool RayTraceRunner::trace(TSceneKit* scene,
 
     SunShape* sunShape = static_cast<SunShape*>(sunKit->getPart("shape", false));
     SunAperture* sunAperture = static_cast<SunAperture*>(sunKit->getPart("aperture", false));
-    SunPosition* sunPosition = static_cast<SunPosition*>(sunKit->getPart("position", false));
     if (!sunShape || !sunAperture || !sunPosition)
         return fail(errorMessage, "Scene sun is missing position, shape, or aperture data.");
 
     reportProgress(progress, "Finding sun aperture cells.");
-    if (!sunKit->findTexture(options.sunWidthDivisions, options.sunHeightDivisions, instanceLayout))
+    const bool apertureProfiles = options.sunAperture == RayTraceSunAperture::Profiles;
+    if (!sunKit->findTexture(options.sunWidthDivisions, options.sunHeightDivisions, instanceLayout, apertureProfiles))
         return fail(errorMessage, "There are no surfaces defined for ray tracing.");
 
+    // half the aperture is traced, the image of every bin adds the other half
+    std::vector<std::vector<int>> mirrorBins;
+    std::vector<std::vector<qulonglong>> countsBefore;
+    std::vector<std::vector<double>> weightsBefore;
+    std::vector<qulonglong> hitsBefore;
+    if (symmetric) {
+        const MirrorSymmetry symmetry(options.symmetryNormal, options.symmetryOffset);
+        const Transform sunTransform = instanceSun.getTransform();
+        if (std::abs(dot(symmetry.getNormal(), sunTransform.transformVector(vec3d::UnitZ).normalized())) > 1e-6)
+            return fail(errorMessage, "The sun is not in the symmetry plane.");
+
+        const std::vector<QPair<int, int>> cells = sunAperture->getCells();
+        std::vector<vec3d> centers;
+        centers.reserve(cells.size());
+        for (const QPair<int, int>& cell : cells)
+            centers.push_back(sunTransform.transformPoint(sunAperture->Sample(0.5, 0.5, cell.first, cell.second)));
+        const double cellSize = (sunTransform.transformPoint(sunAperture->Sample(1., 1., 0, 0)) -
+                                 sunTransform.transformPoint(sunAperture->Sample(0., 0., 0, 0))).norm();
+        const std::vector<int> mirrorCells = symmetry.findMirrors(centers, 1e-3*cellSize);
+        if (mirrorCells.empty())
+            return fail(errorMessage, "The sun aperture is not symmetric about the symmetry plane.");
+        std::vector<QPair<int, int>> half;
+        for (size_t n = 0; n < cells.size(); ++n) {
+            if (mirrorCells[n] == static_cast<int>(n))
+                return fail(errorMessage, "The symmetry plane must pass between sun aperture cells.");
+            if (symmetry.distance(centers[n]) > 0.)
+                half.push_back(cells[n]);
+        }
+        sunAperture->setCells(half);
+
+        for (int t = 0; t < flux->getTargetCount(); ++t) {
+            const std::vector<FluxAccumulator::Bin> bins = flux->getBins(t);
+            std::vector<vec3d> points;
+            double area = 0.;
+            for (const FluxAccumulator::Bin& bin : bins) {
+                points.push_back(bin.point);
+                area += bin.area;
+            }
+            const double binSize = bins.empty() ? 0. : std::sqrt(area/bins.size());
+            mirrorBins.push_back(symmetry.findMirrors(points, 1e-2*binSize));
+            if (mirrorBins.back().empty())
+                return fail(errorMessage, QString("Flux target %1 is not symmetric about the symmetry plane.").arg(flux->getTarget(t).url));
+            countsBefore.push_back(flux->getCounts(t));
+            weightsBefore.push_back(flux->getWeights(t));
+            hitsBefore.push_back(flux->getHits(t));
+        }
+    }
+
+    // rays start on the projected boxes of the leaves instead of the lit
+    // cells, see ReflectorSampler; the area is the sum of the boxes
+    ReflectorSampler reflectorSampler;
+    if (reflectorRays) {
+        reportProgress(progress, "Finding reflector apertures.");
+        const Transform toSun = instanceSun.getTransform().inversed();
+        std::vector<Box2D> apertures;
+        std::vector<double> factors;
+        for (const SceneBVHInstance& leaf : sceneBVH.findLeaves()) {
+            Box2D aperture;
+            const vec3d& a = leaf.box.min();
+            const vec3d& b = leaf.box.max();
+            for (int n = 0; n < 8; ++n) {
+                const vec3d q = toSun.transformPoint(vec3d(n & 4 ? b.x : a.x, n & 2 ? b.y : a.y, n & 1 ? b.z : a.z));
+                aperture.expand(vec2d(q.x, q.y));
+            }
+            apertures.push_back(aperture);
+
+            double factor = 1.;
+            QString url = leaf.instance->getURL();
+            for (;;) {
+                const auto found = options.reflectorRayFactors.constFind(url);
+                if (found != options.reflectorRayFactors.constEnd()) {
+                    factor = found.value();
+                    break;
+                }
+                const qsizetype slash = url.lastIndexOf('/');
+                if (slash <= 0) break;
+                url.truncate(slash);
+            }
+            factors.push_back(factor);
+        }
+        reflectorSampler.setApertures(apertures, factors);
+        if (reflectorSampler.isEmpty())
+            return fail(errorMessage, "There are no reflector apertures to start rays from.");
+    }
+
+    // rays start on a strip of the sun plane holding every ray of the endless
+    // field once; its area is the aperture
+    std::unique_ptr<TranslationalSymmetry> translation;
+    if (translational) {
+        translation.reset(new TranslationalSymmetry(options.translationAxis, instanceLayout->getBox()));
+        if (!(translation->getPeriod() > 0.))
+            return fail(errorMessage, "The layout has no extent along the translation axis.");
+        if (!translation->setSun(instanceSun.getTransform()))
+            return fail(errorMessage, "The sun shines along the translation axis.");
+    }
+
     if (result) {
         result->outputMode = options.outputMode;
-        result->sunApertureArea = sunAperture->getArea();
+        if (translation)
+            result->sunApertureArea = translation->getApertureArea();
+        else
+            result->sunApertureArea = reflectorRays ? reflectorSampler.getArea() : sunAperture->getArea();
         result->irradiance = sunPosition->irradiance.getValue();
         result->powerPerRay = options.rays > 0 ? result->sunApertureArea * result->irradiance / options.rays : 0.;
     }
@@ -128,30 +1017,264 @@ bool RayTraceRunner::trace(TSceneKit* scene,
     AirTransmission* tracingAir = nullptr;
     if (air && air->getTypeId() != AirVacuum::getClassTypeId())
         tracingAir = air;
+    LookupTable airTable;
+    double airTableMax = 0.;
+    if (tracingAir && options.airTableSize > 0) {
+        airTableMax = instanceLayout->getBox().size().norm();
+        if (airTableMax > 0. && qIsFinite(airTableMax))
+            airTable = tracingAir->tabulate(airTableMax, options.airTableSize);
+    }
+    const LookupTable* tracingAirTable = airTable.isEmpty() ? nullptr : &airTable;
+
+    // drawn from a stream of their own, so the chunk streams stay those of the trace
+    std::vector<vec3d> sunDirections;
+    if (options.sunDirectionBank > 0) {
+        TraceEventScope event("sun direction bank", "setup");
+        sunDirections.resize(options.sunDirectionBank);
+        RandomSTL bankRandom(options.seed ^ 0x9e3779b97f4a7c15ull, Random::StreamSize);
+        sunShape->generateRays(bankRandom, sunDirections);
+    }
+    const std::vector<vec3d>* tracingSunDirections = sunDirections.empty() ? nullptr : &sunDirections;
+
+    // the reflectivity and slope errors of every specular material
+    QHash<const MaterialRT*, RayTracerSpread> spreads;
+    if (options.specularSpread) {
+        for (const MaterialRT* material : sceneBVH.getMaterials()) {
+            RayTracerSpread spread;
+            if (material->getSpecularModel(&spread.reflectivity, &spread.slope))
+                spreads.insert(material, spread);
+        }
+    }
+    const QHash<const MaterialRT*, RayTracerSpread>* tracingSpreads = spreads.isEmpty() ? nullptr : &spreads;
+
+    auto callerCallback = [&](int workerIndex) -> HitCallback {
+        return workerHitCallbackFactory ? workerHitCallbackFactory(workerIndex) : hitCallback;
+    };
+    auto chainCallbacks = [](const HitCallback& first, const HitCallback& second) -> HitCallback {
+        if (!first)
+            return second;
+        if (!second)
+            return first;
+        return [first, second](const RayTracerHit& hit) {
+            first(hit);
+            second(hit);
+        };
+    };
+    // flux grids, attribution, camera images, adaptive flux and aim images of the worker come before the
+    // caller callbacks; tracers bin the flux themselves, see RayTracer::setFluxAccumulator
+    auto tracerCallback = [&](int workerIndex, const HitCallback& callback) -> HitCallback {
+        HitCallback ans = callback;
+        if (attribution)
+            ans = chainCallbacks(attribution->hitCallback(workerIndex), ans);
+        if (cameraImage)
+            ans = chainCallbacks(cameraImage->hitCallback(workerIndex), ans);
+        if (adaptiveFlux)
+            ans = chainCallbacks(adaptiveFlux->hitCallback(workerIndex), ans);
+        if (aimImages)
+            ans = chainCallbacks(aimImages->hitCallback(workerIndex), ans);
+        return ans;
+    };
+    auto workerCallback = [&](int workerIndex, const HitCallback& callback) -> HitCallback {
+        HitCallback ans = tracerCallback(workerIndex, callback);
+        if (flux)
+            ans = chainCallbacks(flux->hitCallback(workerIndex), ans);
+        return ans;
+    };
+
+    // the rates at which the rays of a pilot reached the flux targets, by
+    // cell, draw the cells of the sun position of the pilot and of those near it
+    CellImportance cellImportance;
+    QHash<QPair<int, int>, double> cellRates;
+    vec3d pilotSun;
+    int cellPilots = 0;
+    auto pilotCells = [&]() {
+        const vec3d sun = instanceSun.getTransform().transformVector(vec3d::UnitZ).normalized();
+        const std::vector<QPair<int, int>>& cells = sunAperture->getCells();
+        if (cellPilots == 0 || dot(sun, pilotSun) < std::cos(options.cellPilotReuseDeg*gcf::degree)) {
+            TraceEventScope event("cell pilot", "setup", "pilot", cellPilots);
+            QSet<const InstanceNode*> targets;
+            for (int t = 0; t < flux->getTargetCount(); ++t)
+                targets.insert(flux->getSurface(t));
+            std::vector<double> hits(cells.size(), 0.);
+            // a stream of its own, so the chunk streams stay those of the trace
+            RandomSTL pilotRandom(options.seed ^ 0xd1b54a32d192ed03ull ^ static_cast<ulong>(cellPilots), Random::StreamSize);
+            RayTracer tracer(instanceLayout, &instanceSun, sunAperture, sunShape, tracingAir, &pilotRandom, nullptr,
+                             nullptr, nullptr, QVector<InstanceNode*>(), nullptr,
+                             [&targets, &hits](const RayTracerHit& hit) {
+                if (hit.cell >= 0 && targets.contains(hit.surface))
+                    hits[static_cast<size_t>(hit.cell)] += hit.weight;
+            });
+            tracer.setSceneBVH(&sceneBVH);
+            tracer.setAirTable(tracingAirTable, airTableMax);
+            tracer.setSunDirections(tracingSunDirections);
+            tracer.setSpecularSpreads(tracingSpreads);
+            tracer.setWeighted(options.rouletteWeight);
+            tracer(options.cellPilotRays);
+            cellRates.clear();
+            for (size_t c = 0; c < cells.size(); ++c)
+                cellRates.insert(cells[c], hits[c]);
+            pilotSun = sun;
+            ++cellPilots;
+        }
+        // cells the pilot did not have are drawn at the uniform floor
+        std::vector<double> rates(cells.size(), 0.);
+        for (size_t c = 0; c < cells.size(); ++c)
+            rates[c] = cellRates.value(cells[c], 0.);
+        cellImportance = CellImportance(static_cast<int>(cells.size()));
+        cellImportance.setRates(rates, options.cellPilotUniform);
+    };
 
     QVector<InstanceNode*> exportSurfaceList = options.exportSurfaceList;
+    for (const QString& url : options.exportSurfaceUrls) {
+        InstanceNode* surface = findInstance(instanceLayout, url);
+        if (!surface)
+            return fail(errorMessage, QString("Export surface %1 was not found.").arg(url));
+        exportSurfaceList << surface;
+    }
+    if (options.neighbourCount > 0) {
+        std::vector<InstanceNode*> targets(exportSurfaceList.begin(), exportSurfaceList.end());
+        for (int t = 0; flux && t < flux->getTargetCount(); ++t)
+            targets.push_back(flux->getSurface(t));
+        reportProgress(progress, "Finding neighbours.");
+        sceneBVH.findNeighbours(targets, options.neighbourCount);
+    }
+    if (options.sunView && !reused) {
+        reportProgress(progress, "Building the sun view.");
+        sceneBVH.buildSunView(instanceSun.getTransform().transformVector(vec3d::UnitZ), sunShape->getThetaMax(),
+                              options.sunWidthDivisions, options.sunHeightDivisions);
+    }
+
+    // surfaces numbered as in the table of the first bounce cache, those new
+    // appended; the cached rays are reused for the same rays from the sun
+    // and few enough changed surfaces
+    bool reuseFirstBounces = false;
+    QString bounceKey;
+    QStringList bounceSurfaces;
+    std::vector<QByteArray> bounceHashes;
+    std::vector<InstanceNode*> bounceInstances; // null once removed
+    std::vector<char> bounceChanged;
+    QHash<const InstanceNode*, int> bounceNumbers;
+    std::vector<std::unique_ptr<SceneBVH>> changedBVHs;
+    if (firstBounces) {
+        reportProgress(progress, "Comparing first bounce surfaces.");
+        bounceKey = firstBounceKey(options, sunKit, sunAperture);
+        reuseFirstBounces = firstBounces->key == bounceKey;
+        if (reuseFirstBounces) {
+            bounceSurfaces = firstBounces->surfaces;
+            bounceHashes = firstBounces->surfaceHashes;
+        }
+        QHash<QString, int> numbers;
+        for (int n = 0; n < bounceSurfaces.size(); ++n)
+            numbers.insert(bounceSurfaces[n], n);
+        bounceInstances.assign(static_cast<size_t>(bounceSurfaces.size()), nullptr);
+        bounceChanged.assign(static_cast<size_t>(bounceSurfaces.size()), 1);
+        std::vector<InstanceNode*> changed;
+        for (const SceneBVHInstance& leaf : sceneBVH.findLeaves()) {
+            const QString url = leaf.instance->getURL();
+            int n = numbers.value(url, -1);
+            if (n < 0) {
+                n = bounceSurfaces.size();
+                numbers.insert(url, n);
+                bounceSurfaces << url;
+                bounceHashes.push_back(QByteArray());
+                bounceInstances.push_back(nullptr);
+                bounceChanged.push_back(1);
+            }
+            const QByteArray hash = surfaceHash(leaf);
+            // a URL shared by several surfaces is never reused
+            const bool shared = bounceInstances[static_cast<size_t>(n)] != nullptr;
+            bounceChanged[static_cast<size_t>(n)] = shared || bounceHashes[static_cast<size_t>(n)] != hash;
+            bounceHashes[static_cast<size_t>(n)] = hash;
+            bounceInstances[static_cast<size_t>(n)] = leaf.instance;
+            bounceNumbers.insert(leaf.instance, n);
+            if (bounceChanged[static_cast<size_t>(n)])
+                changed.push_back(leaf.instance);
+        }
+        for (size_t n = 0; n < bounceInstances.size(); ++n)
+            if (!bounceInstances[n])
+                bounceHashes[n].clear();
+        if (changed.size() > static_cast<size_t>(MaxChangedSurfaces))
+            reuseFirstBounces = false;
+        for (size_t n = 0; reuseFirstBounces && n < changed.size(); ++n)
+            changedBVHs.emplace_back(new SceneBVH(changed[n]));
+    }
     PhotonsBuffer* photonBuffer = options.outputMode == RayTraceOutputMode::PhotonBuffer ? options.photonBuffer : nullptr;
     QMutex mutexPhotonBuffer;
     std::atomic_bool exportFailed(false);
     RandomSTL random(options.seed, 1);
     QMutex mutexRandom;
 
+    // the buffers filled while tracing, before the workers let theirs go
+    auto endMemory = [&](int workerCount) {
+        if (!result)
+            return;
+        RayTraceMemory& memory = result->memory;
+        memory.photonBytes = photonBuffer ? photonBuffer->getMemoryUsage() : 0;
+        memory.accumulatorBytes = 0;
+        for (const FluxAccumulator* grids : fluxes)
+            memory.accumulatorBytes += grids->getMemoryUsage();
+        if (attribution)
+            memory.accumulatorBytes += attribution->getMemoryUsage();
+        if (cameraImage)
+            memory.accumulatorBytes += cameraImage->getMemoryUsage();
+        memory.randomBytes = qulonglong(sunDirections.capacity())*sizeof(vec3d) +
+            qulonglong(workerCount)*Random::StreamSize*sizeof(double);
+    };
+
+    // the scene and its BVH faulted in before the clock starts
+    QString memoryLockError;
+    const MemoryLock memoryLock(options.lockMemory, &memoryLockError);
+
+    const qulonglong allocationsBefore = MemoryUsage::getAllocations();
     QElapsedTimer timer;
     timer.start();
 
+    if (cellPilot) {
+        reportProgress(progress, "Tracing cell pilot.");
+        pilotCells();
+    }
+
     reportProgress(progress, "Starting ray loop.");
     const ulong progressStep = qMax<ulong>(1, options.rays / 10);
 
     ulong raysTraced = 0;
     bool canceled = false;
-    const int requestedWorkers = qMax(1, options.workerCount);
-    if (requestedWorkers == 1) {
+    int requestedWorkers = qMax(1, options.workerCount);
+    if (options.reserveGuiCore)
+        requestedWorkers = qMin(requestedWorkers, qMax(1, CpuTopology::countProcessors() - 1));
+    const bool counterBased = options.randomGenerator == RayTraceRandomGenerator::CounterBased;
+    const bool quasiRandom = options.randomGenerator == RayTraceRandomGenerator::QuasiRandom;
+    const bool rayIndexed = options.randomGenerator == RayTraceRandomGenerator::RayIndexed;
+    // counter-based and quasi-random streams, checkpoints, shards, rounds and pinned workers always follow the chunk schedule so results do not depend on worker count
+    const bool photonPages = photonBuffer && options.photonPageSize > 0;
+    if (requestedWorkers == 1 && !counterBased && !quasiRandom && !rayIndexed && !converging && !checkpointing && !options.pinWorkers && options.shardCount == 1 && !sunBatch && !pass && !firstBounces) {
+        if (photonPages && !photonBuffer->beginPages(1, options.photonPageSize))
+            exportFailed.store(true);
+        if (flux)
+            flux->beginWorkers(1);
+        if (attribution)
+            attribution->beginWorkers(1);
+        if (cameraImage)
+            cameraImage->beginWorkers(1);
+        if (adaptiveFlux)
+            adaptiveFlux->beginWorkers(1);
+        if (aimImages)
+            aimImages->beginWorkers(1);
+        beginBudgets(1);
+        beginStatistics(1);
+        beginPerfCounters(1);
+        if (perfCounterCount > 0)
+            perfCounters[0].start();
+        const HitCallback tracerHitCallback = tracerCallback(0, callerCallback(0));
         if (result) {
             result->workerCount = 1;
             result->chunkSize = progressStep;
             result->chunkCount = (static_cast<qulonglong>(options.rays) + progressStep - 1) / progressStep;
+            result->dispatchCount = result->chunkCount;
         }
+        m_raysTotal.store(options.rays, std::memory_order_relaxed);
         ulong traced = 0;
+        qulonglong step = 0;
         while (traced < options.rays) {
             if (isCanceled()) {
                 canceled = true;
@@ -171,125 +1294,711 @@ bool RayTraceRunner::trace(TSceneKit* scene,
                 photonBuffer ? &mutexPhotonBuffer : nullptr,
                 exportSurfaceList,
                 photonBuffer ? &exportFailed : nullptr,
-                hitCallback
+                tracerHitCallback
             );
+            tracer.setSceneBVH(&sceneBVH);
+            tracer.setFluxAccumulator(flux, 0);
+            tracer.setWavefrontSize(wavefrontSize);
+            tracer.setBounceSorting(options.sortBounces);
+            tracer.setAirTable(tracingAirTable, airTableMax);
+            tracer.setSunDirections(tracingSunDirections);
+            tracer.setSpecularSpreads(tracingSpreads);
+            tracer.setWeighted(weighted ? options.rouletteWeight : 0.);
+            tracer.setFirstSplits(options.firstSplits);
+            tracer.setCellImportance(cellPilot ? &cellImportance : nullptr);
+            tracer.setReflectorSampler(reflectorRays ? &reflectorSampler : nullptr);
+            tracer.setTranslationalSymmetry(translation.get());
+            tracer.setMaterialVariants(tracingVariants, &variantFluxes);
+            if (photonPages)
+                tracer.setPhotonPages(0, step++);
+            setBudget(tracer, 0);
+            setStatistics(tracer, 0);
+            tracer.setProgress(&m_progressSlots[0].rays, &m_cancel);
             tracer(raysThisStep);
             if (exportFailed.load())
                 break;
+            if (m_cancel.load(std::memory_order_relaxed)) {
+                canceled = true;
+                break;
+            }
 
             traced += raysThisStep;
             raysTraced = traced;
             reportProgress(progress, formatRayProgress(traced, options.rays));
         }
+        endPerfCounters();
+        endMemory(1);
+        if (photonPages && !photonBuffer->endPages())
+            exportFailed.store(true);
+        if (flux)
+            flux->endWorkers();
+        if (attribution)
+            attribution->endWorkers();
+        if (cameraImage)
+            cameraImage->endWorkers();
+        if (adaptiveFlux)
+            adaptiveFlux->endWorkers();
+        if (aimImages)
+            aimImages->endWorkers();
     } else {
-        const ulong chunkSize = qMax<ulong>(1, options.chunkSize);
-        const qulonglong chunkCount = (static_cast<qulonglong>(options.rays) + chunkSize - 1) / chunkSize;
-        const int workerCount = qMin<int>(requestedWorkers, static_cast<int>(qMin<qulonglong>(chunkCount, static_cast<qulonglong>(std::numeric_limits<int>::max()))));
+        // one phase of options.rays per sun position, or one per round
+        const int positionCount = qMax(1, static_cast<int>(options.sunPositions.size()));
+        const std::vector<ulong> phaseRays = converging ?
+            std::vector<ulong>(static_cast<size_t>(options.rays / roundRays), roundRays) :
+            std::vector<ulong>(static_cast<size_t>(positionCount), options.rays);
+        TraceScheduler scheduler(phaseRays, options.chunkSize, requestedWorkers);
+        const qulonglong chunkCount = scheduler.getChunkCount();
+        if (options.shardCount > 1) {
+            qulonglong firstChunk = 0;
+            qulonglong endChunk = 0;
+            TraceScheduler::shardRange(chunkCount, options.shardIndex, options.shardCount, &firstChunk, &endChunk);
+            scheduler.setChunkRange(firstChunk, endChunk);
+        }
+        scheduler.setTargetGrain(options.targetGrainMs);
+        scheduler.setWorkerLimit(options.activeWorkers);
+        scheduler.setLowPriority(options.lowPriority);
+        const int workerCount = scheduler.getWorkerCount();
+        const ulong raysToTrace = scheduler.getRangeRays();
+        const ulong rangeProgressStep = qMax<ulong>(1, raysToTrace / 10);
         if (result) {
             result->workerCount = workerCount;
-            result->chunkSize = chunkSize;
+            result->chunkSize = scheduler.getChunkSize();
             result->chunkCount = chunkCount;
+            result->firstChunk = scheduler.getFirstChunk();
+            result->endChunk = scheduler.getEndChunk();
+        }
+        m_raysTotal.store(raysToTrace, std::memory_order_relaxed);
+
+        // chunks done by earlier runs are skipped and their flux added back
+        RayTraceCheckpoint checkpoint;
+        if (checkpointing) {
+            const QString key = checkpointKey(options);
+            if (options.resume && QFileInfo::exists(options.checkpointFile)) {
+                QString checkpointError;
+                if (!checkpoint.read(options.checkpointFile, &checkpointError))
+                    return fail(errorMessage, checkpointError);
+                if (checkpoint.key != key || checkpoint.chunkCount != chunkCount)
+                    return fail(errorMessage, QString("Checkpoint %1 was written by a trace with different options.").arg(options.checkpointFile));
+                if (flux) {
+                    bool restored = static_cast<int>(checkpoint.grids.size()) == flux->getTargetCount();
+                    for (int t = 0; restored && t < flux->getTargetCount(); ++t)
+                        restored = flux->addCounts(t, checkpoint.grids[static_cast<size_t>(t)].counts, checkpoint.grids[static_cast<size_t>(t)].hits);
+                    if (!restored)
+                        return fail(errorMessage, QString("Checkpoint %1 does not match the flux targets.").arg(options.checkpointFile));
+                }
+                if (result) {
+                    result->chunksResumed = checkpoint.completedCount();
+                    result->raysResumed = checkpoint.raysTraced;
+                }
+                m_raysBase.store(checkpoint.raysTraced, std::memory_order_relaxed);
+            } else {
+                checkpoint.key = key;
+                checkpoint.chunkCount = chunkCount;
+                checkpoint.completed.assign(static_cast<size_t>(chunkCount), 0);
+                for (int t = 0; flux && t < flux->getTargetCount(); ++t) {
+                    const FluxAccumulator::Target& target = flux->getTarget(t);
+                    RayTraceCheckpoint::Grid grid;
+                    grid.url = target.url;
+                    grid.isFront = target.isFront;
+                    grid.rows = target.rows;
+                    grid.cols = target.cols;
+                    grid.counts.assign(flux->getCounts(t).size(), 0);
+                    checkpoint.grids.push_back(grid);
+                }
+            }
         }
-        std::atomic<qulonglong> nextChunk(0);
-        std::atomic<ulong> traced(0);
-        std::atomic_bool failed(false);
-        std::atomic_bool canceledByUser(false);
-        std::vector<std::thread> workers;
-        workers.reserve(static_cast<size_t>(workerCount));
+
+        if (photonPages && !photonBuffer->beginPages(workerCount, options.photonPageSize))
+            exportFailed.store(true);
+        // weighted hits have fractional weights, summed by chunk so the grids
+        // do not depend on which worker traced a chunk
+        auto beginFluxWorkers = [&](int phase) {
+            for (FluxAccumulator* grids : fluxes)
+                grids->beginWorkers(workerCount);
+            if (!weighted)
+                return;
+            const qulonglong phaseEnd = phase + 1 < scheduler.getPhaseCount() ? scheduler.getPhaseFirstChunk(phase + 1) : chunkCount;
+            for (FluxAccumulator* grids : fluxes)
+                grids->beginChunks(qMax(scheduler.getPhaseFirstChunk(phase), scheduler.getFirstChunk()), qMin(phaseEnd, scheduler.getEndChunk()));
+        };
+        if (flux)
+            beginFluxWorkers(0);
+        if (attribution)
+            attribution->beginWorkers(workerCount);
+        if (cameraImage)
+            cameraImage->beginWorkers(workerCount);
+        // quadtree cells split by the order of their hits, which chunks fix
+        if (adaptiveFlux) {
+            adaptiveFlux->beginWorkers(workerCount);
+            adaptiveFlux->beginChunks(scheduler.getFirstChunk(), scheduler.getEndChunk());
+        }
+        if (aimImages)
+            aimImages->beginWorkers(workerCount);
+        beginBudgets(workerCount);
+        beginStatistics(workerCount);
+        beginPerfCounters(workerCount);
+
         QMutex progressMutex;
-        QMutex errorMutex;
-        ulong nextProgress = progressStep;
-        QString workerError;
-
-        auto setWorkerError = [&](const QString& message) {
-            QMutexLocker lock(&errorMutex);
-            if (workerError.isEmpty())
-                workerError = message;
-            failed.store(true);
+        ulong nextProgress = rangeProgressStep;
+        while (nextProgress <= checkpoint.raysTraced)
+            nextProgress += rangeProgressStep;
+        int checkpointsWritten = 0;
+
+        // with no chunk in flight
+        auto writeCheckpoint = [&]() -> bool {
+            RayTraceCheckpoint snapshot = checkpoint;
+            snapshot.raysTraced = scheduler.getRaysTraced();
+            for (size_t t = 0; t < snapshot.grids.size(); ++t) {
+                qulonglong hits = 0;
+                const std::vector<qulonglong> counts = flux->getWorkerCounts(static_cast<int>(t), &hits);
+                RayTraceCheckpoint::Grid& grid = snapshot.grids[t];
+                for (size_t n = 0; n < counts.size(); ++n)
+                    grid.counts[n] += counts[n];
+                grid.hits += hits;
+            }
+            QString checkpointError;
+            if (!snapshot.write(options.checkpointFile, &checkpointError)) {
+                scheduler.fail(checkpointError);
+                return false;
+            }
+            ++checkpointsWritten;
+            return true;
         };
 
+        scheduler.setCancellation(isCanceled);
+        if (checkpointing) {
+            // a worker past the interval holds the others between chunks, so the
+            // saved chunks, rays and grids describe the same work
+            scheduler.setSkipped([&checkpoint](qulonglong chunkIndex) {
+                return checkpoint.completed[static_cast<size_t>(chunkIndex)] != 0;
+            }, checkpoint.raysTraced);
+            scheduler.setPause(static_cast<qint64>(options.checkpointInterval * 1000.), [&writeCheckpoint]() {
+                writeCheckpoint();
+            });
+        }
+        scheduler.setDone([&](const TraceScheduler::Chunk& chunk, ulong tracedNow) {
+            if (checkpointing)
+                checkpoint.completed[static_cast<size_t>(chunk.index)] = 1;
+            if (!progress)
+                return;
+            QMutexLocker lock(&progressMutex);
+            while (nextProgress <= raysToTrace && tracedNow >= nextProgress) {
+                reportProgress(progress, formatRayProgress(nextProgress, raysToTrace));
+                if (raysToTrace - nextProgress < rangeProgressStep) {
+                    nextProgress = raysToTrace + 1;
+                } else {
+                    nextProgress += rangeProgressStep;
+                }
+            }
+            if (tracedNow == raysToTrace && nextProgress <= raysToTrace)
+                reportProgress(progress, formatRayProgress(raysToTrace, raysToTrace));
+        });
+
+        std::vector<HitCallback> callerHitCallbacks;
+        std::vector<HitCallback> workerHitCallbacks;
+        std::vector<HitCallback> tracerHitCallbacks;
         for (int workerIndex = 0; workerIndex < workerCount; ++workerIndex) {
-            workers.emplace_back([&, workerIndex]() {
-                try {
-                    const HitCallback workerHitCallback = workerHitCallbackFactory ? workerHitCallbackFactory(workerIndex) : hitCallback;
-                    QMutex workerRandomMutex;
-
-                    while (!failed.load()) {
-                        if (isCanceled()) {
-                            canceledByUser.store(true);
-                            failed.store(true);
-                            break;
-                        }
-
-                        const qulonglong chunkIndex = nextChunk.fetch_add(1);
-                        if (chunkIndex >= chunkCount)
-                            break;
-
-                        const qulonglong chunkStart = chunkIndex * static_cast<qulonglong>(chunkSize);
-                        const ulong raysThisChunk = static_cast<ulong>(qMin<qulonglong>(chunkSize, static_cast<qulonglong>(options.rays) - chunkStart));
-                        RandomSTL workerRandom(chunkSeed(options.seed, chunkIndex), 1);
-                        RayTracer tracer(
-                            instanceLayout,
-                            &instanceSun,
-                            sunAperture,
-                            sunShape,
-                            tracingAir,
-                            &workerRandom,
-                            &workerRandomMutex,
-                            photonBuffer,
-                            photonBuffer ? &mutexPhotonBuffer : nullptr,
-                            exportSurfaceList,
-                            photonBuffer ? &exportFailed : nullptr,
-                            workerHitCallback
-                        );
-                        tracer(raysThisChunk);
-                        if (exportFailed.load()) {
-                            failed.store(true);
-                            break;
-                        }
-
-                        const ulong tracedNow = traced.fetch_add(raysThisChunk) + raysThisChunk;
-                        if (progress) {
-                            QMutexLocker lock(&progressMutex);
-                            while (nextProgress <= options.rays && tracedNow >= nextProgress) {
-                                reportProgress(progress, formatRayProgress(nextProgress, options.rays));
-                                if (options.rays - nextProgress < progressStep) {
-                                    nextProgress = options.rays + 1;
-                                } else {
-                                    nextProgress += progressStep;
-                                }
-                            }
-                            if (tracedNow == options.rays && nextProgress <= options.rays)
-                                reportProgress(progress, formatRayProgress(options.rays, options.rays));
-                        }
-                    }
-                } catch (const std::exception& e) {
-                    setWorkerError(QString("Ray tracing worker failed: %1").arg(e.what()));
-                } catch (...) {
-                    setWorkerError("Ray tracing worker failed with an unknown exception.");
+            callerHitCallbacks.push_back(callerCallback(workerIndex));
+            workerHitCallbacks.push_back(workerCallback(workerIndex, callerHitCallbacks.back()));
+            tracerHitCallbacks.push_back(tracerCallback(workerIndex, callerHitCallbacks.back()));
+        }
+
+        // pinned workers trace a BVH copied on their own node and fill flux
+        // grids allocated by themselves; shapes and materials stay shared
+        std::vector<std::unique_ptr<SceneBVH>> nodeBVHs;
+        std::vector<const SceneBVH*> workerBVHs(static_cast<size_t>(workerCount), &sceneBVH);
+        // workers not pinned still spread over the processor groups
+        const CpuTopology topology = CpuTopology::detect();
+        if (!options.pinWorkers && topology.getGroupCount() > 1)
+            scheduler.setGroups(topology.spreadGroups(workerCount));
+        if (options.pinWorkers) {
+            reportProgress(progress, "Replicating scene BVH per NUMA node.");
+            scheduler.setPlacement(topology.spreadCpus());
+            nodeBVHs.resize(static_cast<size_t>(topology.getNodeCount()));
+            for (int workerIndex = 0; workerIndex < workerCount; ++workerIndex) {
+                const int node = qMax(0, topology.findNode(scheduler.getWorkerCpu(workerIndex)));
+                std::unique_ptr<SceneBVH>& replica = nodeBVHs[static_cast<size_t>(node)];
+                if (!replica) {
+                    CpuTopology::runOn(topology.getCpus(node).front(), [&replica, &sceneBVH]() {
+                        replica.reset(new SceneBVH(sceneBVH));
+                    });
                 }
+                workerBVHs[static_cast<size_t>(workerIndex)] = replica.get();
+            }
+            if (result) {
+                result->numaNodes = 0;
+                for (const std::unique_ptr<SceneBVH>& replica : nodeBVHs)
+                    result->numaNodes += replica ? 1 : 0;
+            }
+        }
+        const bool prepareFlux = options.pinWorkers && flux;
+        if (prepareFlux || perfCounterCount > 0) {
+            scheduler.setWorkerStart([&, prepareFlux](int workerIndex) {
+                if (prepareFlux)
+                    for (FluxAccumulator* grids : fluxes)
+                        grids->prepareWorker(workerIndex);
+                if (perfCounterCount > 0)
+                    perfCounters[workerIndex].start();
             });
         }
 
-        for (std::thread& worker : workers)
-            worker.join();
+        // between sun positions no chunk is in flight: the position done is
+        // reported with its flux merged, and the next one is traced with new
+        // trackers, BVH, flux transforms and sun aperture
+        QElapsedTimer positionTimer;
+        positionTimer.start();
+        ulong positionStartRays = 0;
+        int bvhRebuilds = 0;
+        bool positionRebuilt = false;
+        auto finishPosition = [&](int position) {
+            const ulong tracedNow = scheduler.getRaysTraced();
+            const double seconds = static_cast<double>(positionTimer.elapsed()) / 1000.;
+            if (result) {
+                result->sunPositions = position + 1;
+                result->bvhRebuilds = bvhRebuilds;
+            }
+            if (sunPositionDone) {
+                RayTraceResult positionResult;
+                positionResult.outputMode = options.outputMode;
+                positionResult.elapsedSeconds = seconds;
+                positionResult.raysTraced = tracedNow - positionStartRays;
+                positionResult.raysPerSecond = seconds > 0. ? static_cast<double>(positionResult.raysTraced) / seconds : 0.;
+                positionResult.sunApertureArea = sunAperture->getArea();
+                positionResult.irradiance = sunPosition->irradiance.getValue();
+                positionResult.powerPerRay = positionResult.sunApertureArea * positionResult.irradiance / options.rays;
+                positionResult.workerCount = workerCount;
+                positionResult.chunkSize = scheduler.getChunkSize();
+                positionResult.chunkCount = chunkCount / positionCount;
+                positionResult.bvhRebuilds = positionRebuilt ? 1 : 0;
+                positionResult.numaNodes = result ? result->numaNodes : 1;
+                sunPositionDone(position, positionResult);
+            }
+            positionStartRays = tracedNow;
+            positionTimer.restart();
+        };
+        auto restartWorkers = [&](int phase) {
+            beginFluxWorkers(phase);
+            for (int workerIndex = 0; workerIndex < workerCount; ++workerIndex) {
+                workerHitCallbacks[static_cast<size_t>(workerIndex)] = workerCallback(workerIndex, callerHitCallbacks[static_cast<size_t>(workerIndex)]);
+                tracerHitCallbacks[static_cast<size_t>(workerIndex)] = tracerCallback(workerIndex, callerHitCallbacks[static_cast<size_t>(workerIndex)]);
+            }
+        };
+        auto preparePosition = [&](int position) -> bool {
+            placeSun(scene, sunPosition, options.sunPositions[position]);
+            {
+                TraceEventScope event("updateTree", "setup", "sun_position", position);
+                instanceLayout->updateTree(Transform::Identity);
+            }
+            if (flux && !flux->bind(instanceLayout, &fluxError)) {
+                scheduler.fail(fluxError);
+                return false;
+            }
+            // only the trackers moved: the leaves are the same, their boxes are
+            // refitted, the top level built again if it got too costly
+            positionRebuilt = sceneBVH.refit(options.refitRebuildRatio);
+            if (positionRebuilt) bvhRebuilds++;
+            sunKit->setBox(instanceLayout->getBox());
+            instanceSun.setTransform(tgf::makeTransform(sunKit->m_transform));
+            if (options.sunView)
+                sceneBVH.buildSunView(instanceSun.getTransform().transformVector(vec3d::UnitZ), sunShape->getThetaMax(),
+                                      options.sunWidthDivisions, options.sunHeightDivisions);
+            // the replicas copy the view too
+            for (size_t node = 0; node < nodeBVHs.size(); ++node) {
+                std::unique_ptr<SceneBVH>& replica = nodeBVHs[node];
+                if (replica) {
+                    CpuTopology::runOn(topology.getCpus(static_cast<int>(node)).front(), [&replica, &sceneBVH]() {
+                        *replica = sceneBVH;
+                    });
+                }
+            }
+            if (!sunKit->findTexture(options.sunWidthDivisions, options.sunHeightDivisions, instanceLayout, apertureProfiles)) {
+                scheduler.fail("There are no surfaces defined for ray tracing.");
+                return false;
+            }
+            if (cellPilot)
+                pilotCells();
+            if (result) {
+                result->sunApertureArea = sunAperture->getArea();
+                result->irradiance = sunPosition->irradiance.getValue();
+                result->powerPerRay = result->sunApertureArea * result->irradiance / options.rays;
+            }
+            if (flux)
+                restartWorkers(position);
+            return true;
+        };
+        if (sunBatch) {
+            scheduler.setPhaseStart([&](int position) {
+                if (flux)
+                    flux->endWorkers();
+                finishPosition(position - 1);
+                preparePosition(position);
+                m_sunPosition.store(position, std::memory_order_relaxed);
+            });
+        }
+
+        // between rounds no chunk is in flight: the values of the round done
+        // are a batch, and the trace ends once their error is small enough
+        BatchMeans batchMeans;
+        std::vector<double> values;
+        bool converged = false;
+        double relativeError = 0.;
+        auto readValues = [&]() {
+            values.clear();
+            if (options.convergenceValues) {
+                options.convergenceValues(values);
+                return;
+            }
+            for (int t = 0; t < flux->getTargetCount(); ++t) {
+                const std::vector<double> targetFlux = flux->getFlux(t, 1.);
+                values.insert(values.end(), targetFlux.begin(), targetFlux.end());
+            }
+        };
+        auto finishRound = [&]() {
+            readValues();
+            batchMeans.addRound(values);
+            relativeError = batchMeans.getMaxRelativeError(options.targetFluxFraction);
+            converged = batchMeans.getRounds() >= MinRounds && relativeError <= options.targetRelativeError;
+            reportProgress(progress, QString("Round %1: relative error %2.")
+                .arg(batchMeans.getRounds())
+                .arg(relativeError));
+        };
+        if (converging) {
+            readValues();
+            batchMeans.begin(values);
+            scheduler.setPhaseStart([&](int round) {
+                if (flux)
+                    flux->endWorkers();
+                finishRound();
+                if (converged)
+                    scheduler.finish();
+                if (flux)
+                    restartWorkers(round);
+            });
+        }
 
-        canceled = canceledByUser.load();
-        raysTraced = traced.load();
-        if (failed.load() && !canceled && !exportFailed.load())
-            return fail(errorMessage, workerError.isEmpty() ? "Ray tracing worker failed." : workerError);
-        if (!canceled && !exportFailed.load() && raysTraced != options.rays)
+        // a chunk stopped halfway would leave hits the checkpoint does not
+        // count, so checkpointed traces are canceled between chunks only
+        const std::atomic_bool* tracerStop = checkpointing ? nullptr : &m_cancel;
+        // recorded rays are kept per chunk, so the bundle does not depend on the workers
+        const bool recording = pass && !pass->replay;
+        std::vector<std::vector<RayTracerRay>> chunkRays(recording ? static_cast<size_t>(chunkCount) : 0);
+        // first bounces are recorded per chunk, or reused in place
+        std::vector<std::vector<FirstBounce>> recordedBounces(firstBounces && !reuseFirstBounces ? static_cast<size_t>(chunkCount) : 0);
+        if (reuseFirstBounces && firstBounces->chunks.size() != static_cast<size_t>(chunkCount))
+            return fail(errorMessage, "First bounce cache does not match the chunks of the trace.");
+        std::vector<std::vector<FirstBounce>>& bounceChunks = reuseFirstBounces ? firstBounces->chunks : recordedBounces;
+        std::atomic<ulong> bouncesReused(0);
+        auto isBounceValid = [&](const FirstBounce& bounce) {
+            if (bounce.surface >= 0 && bounceChanged[static_cast<size_t>(bounce.surface)])
+                return false;
+            const Ray ray(bounce.ray.origin, bounce.ray.direction, gcf::Epsilon, bounce.distance);
+            for (const std::unique_ptr<SceneBVH>& changed : changedBVHs)
+                if (changed->occluded(ray))
+                    return false;
+            return true;
+        };
+        auto recordBounces = [&bounceNumbers](std::vector<FirstBounce>* bounces) {
+            return [bounces, &bounceNumbers](const RayTracerFirstBounce& b) {
+                const int surface = b.surface ? bounceNumbers.value(b.surface, -1) : -1;
+                bounces->push_back(FirstBounce{b.ray, b.distance, surface, b.isFront, b.isReflected, b.reflected});
+            };
+        };
+        // the receiver, and rays continued from a first bounce, draw from
+        // streams apart from those of the field
+        const ulong chunkSeed = pass && pass->replay ? options.seed ^ 0x9e3779b9ul :
+            reuseFirstBounces ? options.seed ^ 0x85ebca6bul : options.seed;
+        scheduler.run([&](const TraceScheduler::Chunk& chunk) {
+            // every sun position repeats the streams of a single trace, rounds
+            // take those of the chunks of one longer trace; points of the
+            // sequence and ray streams are numbered by ray, as chunks of a phase
+            // split its rays
+            const qulonglong streamChunk = converging ? chunk.index : chunk.phaseChunk;
+            const qulonglong firstRay = converging ? chunk.phase * static_cast<qulonglong>(roundRays) + chunk.start : chunk.start;
+            std::unique_ptr<Random> chunkRandom(quasiRandom ?
+                static_cast<Random*>(new RandomSobol(chunkSeed, firstRay)) :
+                rayIndexed ? new RandomPhiloxRays(chunkSeed, firstRay) :
+                TraceScheduler::createRandom(chunkSeed, streamChunk, counterBased, options.substreamRandom));
+            RayTracer tracer(
+                instanceLayout,
+                &instanceSun,
+                sunAperture,
+                sunShape,
+                tracingAir,
+                chunkRandom.get(),
+                nullptr, // the generator of the chunk is drawn by its tracer only
+                photonBuffer,
+                photonBuffer ? &mutexPhotonBuffer : nullptr,
+                exportSurfaceList,
+                photonBuffer ? &exportFailed : nullptr,
+                tracerHitCallbacks[static_cast<size_t>(chunk.worker)]
+            );
+            tracer.setSceneBVH(workerBVHs[static_cast<size_t>(chunk.worker)]);
+            tracer.setFluxAccumulator(flux, chunk.worker);
+            tracer.setWavefrontSize(wavefrontSize);
+            tracer.setBounceSorting(options.sortBounces);
+            tracer.setAirTable(tracingAirTable, airTableMax);
+            tracer.setSunDirections(tracingSunDirections);
+            tracer.setSpecularSpreads(tracingSpreads);
+            tracer.setWeighted(weighted ? options.rouletteWeight : 0.);
+            tracer.setFirstSplits(options.firstSplits);
+            tracer.setCellImportance(cellPilot ? &cellImportance : nullptr);
+            tracer.setReflectorSampler(reflectorRays ? &reflectorSampler : nullptr);
+            tracer.setTranslationalSymmetry(translation.get());
+            tracer.setMaterialVariants(tracingVariants, &variantFluxes);
+            if (photonPages)
+                tracer.setPhotonPages(chunk.worker, chunk.index);
+            setBudget(tracer, chunk.worker);
+            setStatistics(tracer, chunk.worker);
+            tracer.setProgress(&m_progressSlots[static_cast<size_t>(chunk.worker % ProgressSlots)].rays, tracerStop);
+            std::vector<RayTracerRay>* escaped = recording ? &chunkRays[static_cast<size_t>(chunk.index)] : nullptr;
+            if (escaped)
+                tracer.setEscapeCallback([escaped](const RayTracerRay& ray) {escaped->push_back(ray);});
+            if (pass && pass->replay)
+                tracer.setPrimaryRays(pass->bundle->rays.data() + chunk.start);
+            if (firstBounces && !reuseFirstBounces)
+                tracer.setFirstBounceCallback(recordBounces(&bounceChunks[static_cast<size_t>(chunk.index)]));
+            if (reuseFirstBounces) {
+                // hits of the first bounces reported as the tracer would, then
+                // the reflected rays traced on, and the rays from the sun whose
+                // first bounce changed traced again and recorded
+                std::vector<FirstBounce>& bounces = bounceChunks[static_cast<size_t>(chunk.index)];
+                const HitCallback& chunkCallback = workerHitCallbacks[static_cast<size_t>(chunk.worker)];
+                std::vector<RayTracerRay> reflected;
+                std::vector<RayTracerRay> sunRays;
+                std::vector<size_t> retraced;
+                for (size_t k = 0; k < bounces.size(); ++k) {
+                    const FirstBounce& bounce = bounces[k];
+                    if (!isBounceValid(bounce)) {
+                        retraced.push_back(k);
+                        sunRays.push_back(bounce.ray);
+                        continue;
+                    }
+                    if (bounce.surface < 0)
+                        continue;
+                    if (chunkCallback) {
+                        const Ray ray(bounce.ray.origin, bounce.ray.direction);
+                        chunkCallback(RayTracerHit{ray.point(bounce.distance), bounceInstances[static_cast<size_t>(bounce.surface)], bounce.isFront, 1., nullptr});
+                    }
+                    if (bounce.isReflected)
+                        reflected.push_back(bounce.reflected);
+                }
+                bouncesReused.fetch_add(static_cast<ulong>(bounces.size() - retraced.size()), std::memory_order_relaxed);
+                m_progressSlots[static_cast<size_t>(chunk.worker % ProgressSlots)].rays.fetch_add(
+                    static_cast<ulong>(bounces.size() - retraced.size() - reflected.size()), std::memory_order_relaxed);
+                if (!reflected.empty()) {
+                    tracer.setPrimaryRays(reflected.data());
+                    tracer(static_cast<ulong>(reflected.size()));
+                }
+                if (!sunRays.empty()) {
+                    std::vector<FirstBounce> fresh;
+                    fresh.reserve(sunRays.size());
+                    tracer.setPrimaryRays(sunRays.data(), true);
+                    tracer.setFirstBounceCallback(recordBounces(&fresh));
+                    tracer(static_cast<ulong>(sunRays.size()));
+                    // a stopped chunk leaves the cache to be cleared
+                    if (fresh.size() == retraced.size()) {
+                        for (size_t k = 0; k < fresh.size(); ++k)
+                            bounces[retraced[k]] = fresh[k];
+                    }
+                }
+            } else
+                tracer(chunk.rays);
+            for (FluxAccumulator* grids : fluxes)
+                grids->endChunk(chunk.worker, chunk.index);
+            if (adaptiveFlux)
+                adaptiveFlux->endChunk(chunk.worker, chunk.index);
+            return !exportFailed.load() && !(tracerStop && tracerStop->load(std::memory_order_relaxed));
+        });
+
+        endPerfCounters();
+        endMemory(workerCount);
+        canceled = scheduler.isCanceled() || m_cancel.load(std::memory_order_relaxed);
+        raysTraced = scheduler.getRaysTraced();
+        if (result) {
+            result->dispatchCount = scheduler.getDispatchCount();
+            result->processorGroups = findProcessorGroups(scheduler, topology);
+        }
+        // a cache reused in place is only whole after every chunk
+        if (firstBounces) {
+            if (canceled || scheduler.hasFailed()) {
+                *firstBounces = FirstBounceCache();
+            } else {
+                if (!reuseFirstBounces)
+                    firstBounces->chunks = std::move(recordedBounces);
+                firstBounces->key = bounceKey;
+                firstBounces->surfaces = bounceSurfaces;
+                firstBounces->surfaceHashes = bounceHashes;
+            }
+            if (result) {
+                result->firstBounceCacheRecorded = !reuseFirstBounces && !canceled;
+                result->firstBouncesReused = bouncesReused.load();
+            }
+        }
+        // a worker that failed may have left a chunk half binned
+        const bool checkpointFailed = checkpointing && !scheduler.hasFailed() && !writeCheckpoint();
+        if (result)
+            result->checkpointsWritten = checkpointsWritten;
+        if (photonPages && !photonBuffer->endPages())
+            exportFailed.store(true);
+        for (FluxAccumulator* grids : fluxes)
+            grids->endWorkers();
+        if (attribution)
+            attribution->endWorkers();
+        if (cameraImage)
+            cameraImage->endWorkers();
+        if (adaptiveFlux)
+            adaptiveFlux->endWorkers();
+        if (aimImages)
+            aimImages->endWorkers();
+        if (checkpointFailed || (scheduler.hasFailed() && !canceled && !exportFailed.load()))
+            return fail(errorMessage, scheduler.getError().isEmpty() ? "Ray tracing worker failed." : scheduler.getError());
+        if (!canceled && !exportFailed.load() && !converged && raysTraced != raysToTrace)
             return fail(errorMessage, "Ray tracing did not complete all requested rays.");
+        if (converging && !canceled && !converged && raysTraced > 0)
+            finishRound();
+        if (converging && result) {
+            result->rounds = batchMeans.getRounds();
+            result->relativeError = relativeError;
+            result->converged = converged;
+            if (raysTraced > 0)
+                result->powerPerRay = result->sunApertureArea * result->irradiance / raysTraced;
+        }
+        if (sunBatch && !canceled)
+            finishPosition(positionCount - 1);
+        if (recording && !canceled) {
+            size_t rayCount = 0;
+            for (const std::vector<RayTracerRay>& rays : chunkRays)
+                rayCount += rays.size();
+            pass->bundle->rays.reserve(rayCount);
+            for (std::vector<RayTracerRay>& rays : chunkRays) {
+                pass->bundle->rays.insert(pass->bundle->rays.end(), rays.begin(), rays.end());
+                std::vector<RayTracerRay>().swap(rays);
+            }
+        }
+    }
+
+    for (size_t t = 0; t < mirrorBins.size(); ++t)
+        flux->addMirrored(static_cast<int>(t), mirrorBins[t], countsBefore[t], weightsBefore[t], hitsBefore[t]);
+
+    // the exporter may name the surfaces of its photons as it ends
+    if (photonBuffer && options.endPhotonExport) {
+        TraceEventScope event("end photon export", "export");
+        const double power = raysTraced > 0 ? sunAperture->getArea() * sunPosition->irradiance.getValue() / raysTraced : 0.;
+        if (!photonBuffer->endExport(power))
+            exportFailed.store(true);
     }
 
     const double elapsedSeconds = static_cast<double>(timer.elapsed()) / 1000.;
     if (result) {
+        result->memory.allocationsCounted = MemoryUsage::isCounting();
+        result->memory.heapAllocations = MemoryUsage::getAllocations() - allocationsBefore;
+        result->memory.peakResidentBytes = MemoryUsage::getPeakResidentBytes();
         result->elapsedSeconds = elapsedSeconds;
         result->raysTraced = raysTraced;
+        result->cellPilots = cellPilots;
         result->raysPerSecond = elapsedSeconds > 0. ? static_cast<double>(raysTraced) / elapsedSeconds : 0.;
         result->canceled = canceled;
+        result->memoryLocked = memoryLock.isLocked();
+        result->memoryLockError = memoryLockError;
         result->exportFailed = exportFailed.load() || (photonBuffer && photonBuffer->hasExportFailed());
+        if (options.powerBudget) {
+            // the budgets of the workers in worker order
+            result->powerBudget.resize(budgetUrls.size());
+            for (const PowerBudget& budget : budgets)
+                result->powerBudget.add(budget);
+            result->powerBudget.scale(result->powerPerRay);
+            result->powerBudgetSurfaces = budgetUrls;
+        }
+        result->statistics.clear();
+        for (const TraceStatistics& worker : statistics)
+            result->statistics.add(worker);
     }
 
     return true;
 }
+
+bool RayTraceRunner::tracePoints(TSceneKit* scene,
+                                 const QString& surfaceUrl,
+                                 bool isFront,
+                                 const QVector<RayTracePointFlux>& points,
+                                 ulong samples,
+                                 ulong seed,
+                                 QVector<RayTracePointFlux>* fluxes,
+                                 QString* errorMessage) const
+{
+    if (!scene)
+        return fail(errorMessage, "Scene is not loaded.");
+    if (samples == 0)
+        return fail(errorMessage, "Sample count must be greater than zero.");
+
+    SunKit* sunKit = static_cast<SunKit*>(scene->getPart("world.sun", false));
+    if (!sunKit)
+        return fail(errorMessage, "Scene has no sun.");
+    SunPosition* sunPosition = static_cast<SunPosition*>(sunKit->getPart("position", false));
+    SunShape* sunShape = static_cast<SunShape*>(sunKit->getPart("shape", false));
+    if (!sunShape || !sunPosition)
+        return fail(errorMessage, "Scene sun is missing position or shape data.");
+
+    SceneInstanceTree instanceTree = SceneInstanceBuilder::build(scene);
+    InstanceNode* instanceLayout = instanceTree.layoutRoot;
+    if (!instanceLayout)
+        return fail(errorMessage, "Scene has no layout.");
+    instanceLayout->updateTree(Transform::Identity);
+
+    InstanceNode* surface = findInstance(instanceLayout, surfaceUrl);
+    if (!surface)
+        return fail(errorMessage, QString("Surface %1 was not found.").arg(surfaceUrl));
+    const std::vector<SceneBVHInstance> surfaceLeaves = SceneBVH(surface).findLeaves();
+    if (surfaceLeaves.size() != 1)
+        return fail(errorMessage, QString("Surface %1 must hold one shape.").arg(surfaceUrl));
+    const SceneBVHInstance& leaf = surfaceLeaves.front();
+
+    AirTransmission* air = static_cast<AirTransmission*>(scene->getPart("world.air.transmission", false));
+    if (air && air->getTypeId() == AirVacuum::getClassTypeId())
+        air = nullptr;
+
+    const Transform sunTransform = tgf::makeTransform(sunKit->m_transform);
+    SceneBVH sceneBVH(instanceLayout, 4, surface);
+    BackwardTracer tracer(sceneBVH, sunShape, sunTransform.transformVector(vec3d::UnitZ), sunPosition->irradiance.getValue(), air);
+
+    QVector<RayTracePointFlux> ans;
+    for (int n = 0; n < points.size(); ++n) {
+        RayTracePointFlux point = points[n];
+        point.position = leaf.transform.transformPoint(leaf.shape->getPoint(point.u, point.v));
+        point.normal = leaf.transform.transformNormal(leaf.shape->getNormal(point.u, point.v)).normalized();
+        if (!isFront)
+            point.normal = -point.normal;
+        std::unique_ptr<Random> rand(TraceScheduler::createRandom(seed, qulonglong(n), true));
+        BackwardFlux flux = tracer.trace(point.position, point.normal, samples, *rand);
+        point.irradiance = flux.irradiance;
+        point.error = flux.error;
+        point.direct = flux.direct;
+        point.samples = flux.samples;
+        ans << point;
+    }
+    if (fluxes)
+        *fluxes = ans;
+    return true;
+}
+
+RayTraceProgress RayTraceRunner::progress() const
+{
+    RayTraceProgress ans;
+    ans.raysTraced = m_raysBase.load(std::memory_order_relaxed);
+    for (const ProgressSlot& slot : m_progressSlots)
+        ans.raysTraced += slot.rays.load(std::memory_order_relaxed);
+    ans.raysTotal = m_raysTotal.load(std::memory_order_relaxed);
+    ans.sunPosition = m_sunPosition.load(std::memory_order_relaxed);
+    ans.sunPositionCount = m_sunPositionCount.load(std::memory_order_relaxed);
+    return ans;
+}
+
+void RayTraceRunner::startProgress(ulong raysTotal, int sunPositionCount) const
+{
+    for (ProgressSlot& slot : m_progressSlots)
+        slot.rays.store(0, std::memory_order_relaxed);
+    m_raysBase.store(0, std::memory_order_relaxed);
+    m_raysTotal.store(raysTotal, std::memory_order_relaxed);
+    m_sunPosition.store(0, std::memory_order_relaxed);
+    m_sunPositionCount.store(sunPositionCount, std::memory_order_relaxed);
+}
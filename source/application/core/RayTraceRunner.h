@@ -1,33 +1,358 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <functional>
+#include <vector>
 
+#include <QHash>
 #include <QVector>
 #include <QString>
+#include <QStringList>
 #include <qglobal.h>
 
+#include "kernel/run/PerfCounters.h"
+#include "kernel/run/PowerBudget.h"
+#include "kernel/run/TraceStatistics.h"
+#include "libraries/math/3D/vec3d.h"
+
+class AdaptiveFlux;
+class AimImages;
+class CameraImage;
+struct CompiledScene;
+class FluxAccumulator;
+struct FirstBounceCache;
 class InstanceNode;
 class PhotonsBuffer;
+class Random;
+class ReflectorAttribution;
+struct RayBundle;
 class TSceneKit;
 struct RayTracerHit;
 
 enum class RayTraceOutputMode
 {
     NoOutput,
-    PhotonBuffer
+    PhotonBuffer,
+    // hits binned on receiver surfaces by per-worker grids, no photons stored
+    FluxGrid
+};
+
+enum class RayTraceStrategy
+{
+    // one ray at a time through all its bounces
+    DepthFirst,
+    // batches of rays advanced bounce by bounce in staged queues
+    Wavefront
+};
+
+enum class RayTracePrecision
+{
+    // double node boxes throughout (matches published benchmark references)
+    Double,
+    // float node boxes for the scene BVH traversal, shapes and flux in double
+    Single
+};
+
+enum class RayTraceTransport
+{
+    // absorption by materials and air drawn per interaction, every ray
+    // carrying its full power or none (matches published benchmark references)
+    Analog,
+    // rays carry a weight scaled by reflectivity and air transmission, with
+    // Russian roulette below rouletteWeight; flux grids sum the weights
+    Weighted
+};
+
+enum class RayTraceFluxModel
+{
+    // rays traced from the sun (matches published benchmark references)
+    MonteCarlo,
+    // analytic images of the reflectors summed on the flux grids, see
+    // ConvolutionFlux; FluxGrid mode only, with no ray traced and a power
+    // of one per ray, so the weights of the grids are in W
+    Convolution
+};
+
+enum class RayTraceRandomGenerator
+{
+    // RandomSTL streams seeded per chunk (matches published benchmark references)
+    SeededSTL,
+    // RandomPhilox counter-based streams indexed by chunk, no shared state
+    CounterBased,
+    // RandomSobol scrambled Sobol points indexed by ray, for the sun cell,
+    // aperture, sunshape and first bounce; pseudo-random beyond
+    QuasiRandom,
+    // RandomPhiloxRays counter-based streams indexed by ray, with flux weights
+    // summed exactly, so results depend on neither workers nor chunk size
+    RayIndexed
+};
+
+enum class RayTraceSunAperture
+{
+    // cells under the projected bounding boxes of the surfaces, grown by one
+    // cell (matches published benchmark references)
+    Boxes,
+    // cells under the surfaces projected over their profiles, fewer rays
+    // started where no surface is
+    Profiles,
+    // points on the projected bounding rectangle of every surface, drawn by
+    // area, see ReflectorSampler; needs weighted transport
+    Reflectors
+};
+
+struct RayTraceSunPosition
+{
+    double azimuth = 0.; // in degrees
+    double elevation = 90.;
+};
+
+// a field of the material of a surface in a RayTraceVariant
+struct RayTraceMaterialEdit
+{
+    QString url;   // of the shape kit in the layout, as in SceneEditor
+    QString field; // of its material
+    QString value; // text as in the scene file
+};
+
+// a version of the scene differing in materials, see RayTraceOptions::variants
+struct RayTraceVariant
+{
+    QVector<RayTraceMaterialEdit> edits;
+    // the flux of the variant, with the targets of RayTraceOptions::fluxAccumulator
+    FluxAccumulator* fluxAccumulator = nullptr;
 };
 
 struct RayTraceOptions
 {
     ulong rays = 0;
     ulong seed = 0;
+    RayTraceFluxModel fluxModel = RayTraceFluxModel::MonteCarlo;
+    // points per side of each reflector and draws of its material for
+    // RayTraceFluxModel::Convolution
+    int convolutionSurfaceSamples = 8;
+    int convolutionMaterialSamples = 64;
     int sunWidthDivisions = 100;
     int sunHeightDivisions = 100;
+    RayTraceSunAperture sunAperture = RayTraceSunAperture::Boxes;
+    // directions drawn once from the sunshape in the sun frame and shared by
+    // every ray and sun position of the call, see RayTracer::setSunDirections;
+    // 0 draws the sunshape per ray
+    ulong sunDirectionBank = 0;
+    // rays from the sun reflected first by a specular mirror draw its slope
+    // errors from tables, see RayTracer::setSpecularSpreads; the same
+    // statistics from other numbers. Depth-first traces without translational
+    // symmetry or variants
+    bool specularSpread = false;
     int workerCount = 1;
     ulong chunkSize = 10000;
+    // a worker takes consecutive chunks for about this long per dispatch, so
+    // chunkSize can be small and cheap scenes still dispatch rarely; results
+    // stay per chunk. 0 takes one chunk at a time
+    double targetGrainMs = 0.;
+    RayTraceRandomGenerator randomGenerator = RayTraceRandomGenerator::SeededSTL;
+    // the generator picked by the user; chunks draw from its substreams in
+    // place of those of randomGenerator when it has them, see
+    // Random::createSubstream
+    const Random* substreamRandom = nullptr;
+    RayTraceStrategy strategy = RayTraceStrategy::DepthFirst;
+    RayTracePrecision precision = RayTracePrecision::Double;
+    // instances nearest each one, with the flux and export surfaces, tested
+    // first by the rays leaving it, see SceneBVH::findNeighbours; 0 traverses
+    // the scene BVH only
+    int neighbourCount = 0;
+    // rays from the sun test the instances of their cell in the view of the
+    // scene along the sun axis, see SceneBVH::buildSunView, built again per
+    // sun position; other rays traverse the scene BVH
+    bool sunView = false;
+    // distance samples of the air transmission over the layout diagonal, read
+    // by the tracer instead of the air model; 0 evaluates the model per ray
+    int airTableSize = 0;
+    RayTraceTransport transport = RayTraceTransport::Analog;
+    // weight below which a weighted ray survives with probability
+    // weight/rouletteWeight, carrying rouletteWeight
+    double rouletteWeight = 0.1;
+    // rays from the sun meeting a surface first are traced on from the hit
+    // that many times, each with 1/firstSplits of the weight, see
+    // RayTracer::setFirstSplits; weighted depth-first traces only
+    int firstSplits = 1;
+    ulong wavefrontSize = 4096;
+    // sorts wavefront rays between bounces for coherent traversal, see
+    // RayTracer::setBounceSorting; the same rays, drawn in another order
+    bool sortBounces = false;
     RayTraceOutputMode outputMode = RayTraceOutputMode::NoOutput;
     PhotonsBuffer* photonBuffer = nullptr;
+    // photons per worker page, 0 collects each call through the shared buffer mutex
+    ulong photonPageSize = 0;
     QVector<InstanceNode*> exportSurfaceList;
+    // surfaces by URL in the instance tree of the trace, added to exportSurfaceList
+    QStringList exportSurfaceUrls;
+    // ends the export of photonBuffer with the power per ray of the trace,
+    // while the instances its photons point to still exist
+    bool endPhotonExport = false;
+    // targets and totals of FluxGrid mode, adds to what it already holds
+    FluxAccumulator* fluxAccumulator = nullptr;
+    // sums the power incident, absorbed and reflected on each side of every
+    // surface, and the power missed, escaped and lost to air and roulette,
+    // in per-worker budgets added at the end; not with sun position batches,
+    // checkpoints or a receiver
+    bool powerBudget = false;
+    // sums the hits on its targets by the surface each ray reflected off
+    // first, adding to what it already holds; not in PhotonBuffer mode, nor
+    // with sun position batches, checkpoints or a receiver
+    ReflectorAttribution* reflectorAttribution = nullptr;
+    // splats the hits on its targets into the pixels of a camera, adding to
+    // what it already holds; as reflectorAttribution
+    CameraImage* cameraImage = nullptr;
+    // bins the hits on its targets in quadtree grids, adding to what they
+    // already hold, chunk by chunk in order; as cameraImage, and not with
+    // convergence or shards either
+    AdaptiveFlux* adaptiveFlux = nullptr;
+    // sums the hits on its target by the heliostat each ray reflected off
+    // first, adding to what it already holds; as reflectorAttribution
+    AimImages* aimImages = nullptr;
+    // counts cycles, instructions, cache and branch misses of every worker
+    // thread while it traces, see PerfCounters
+    bool perfCounters = false;
+    // completed chunks, rays and flux grids saved every checkpointInterval seconds
+    // and at the end; tracing then always follows the chunk schedule
+    QString checkpointFile;
+    double checkpointInterval = 60.;
+    // skips the chunks saved in checkpointFile, if it exists
+    bool resume = false;
+    // scene identity stored in the checkpoint, compared on resume
+    QString checkpointTag;
+    // for traces beside an interactive GUI: leaves one hardware thread to
+    // the GUI, runs the workers below normal priority, and holds the workers
+    // from *activeWorkers on while it is above 0, see
+    // TraceScheduler::setWorkerLimit; results do not change
+    bool reserveGuiCore = false;
+    bool lowPriority = false;
+    const std::atomic<int>* activeWorkers = nullptr;
+    // pins the workers across NUMA nodes, each node tracing its own copy of
+    // the scene BVH; tracing then always follows the chunk schedule
+    bool pinWorkers = false;
+    // faults in and locks the memory of the process, scene and BVH included,
+    // before the clock starts and unlocks it at the end; see HugePages
+    bool lockMemory = false;
+    // traces the contiguous chunk range shardIndex of shardCount only, chunks
+    // and seeds staying those of the whole trace, so the counts of all shards
+    // add up to a single run on the chunk schedule
+    int shardIndex = 0;
+    int shardCount = 1;
+    // traces rays for each sun position in turn with the same scene and
+    // workers, only trackers, BVH and sun aperture following the sun; the
+    // sun of the scene is restored at the end
+    QVector<RayTraceSunPosition> sunPositions;
+    // the scene is mirror-symmetric about the plane dot(symmetryNormal, p) =
+    // symmetryOffset, a zero normal for none: rays leave only the sun aperture
+    // cells on the positive side, with half the area, and the flux grids add
+    // the image of what they got. The sun must be in the plane and the grids
+    // symmetric; FluxGrid mode only, not with receivers, sun position
+    // batches, checkpoints, convergence, power budgets, attribution or first
+    // bounce caches
+    vec3d symmetryNormal;
+    double symmetryOffset = 0.;
+    // the layout is one period of a field endless along world axis
+    // translationAxis (0 x, 1 y, 2 z), -1 for none, such as a stretch of a
+    // trough or linear Fresnel row: the period is the extent of the layout
+    // along the axis, rays leaving it through an end enter it through the
+    // other, and rays start on a strip of the sun plane one period long, see
+    // TranslationalSymmetry. The flux is that of the middle of a long field,
+    // without its ends. Depth-first only, not with rays from the reflectors,
+    // cell pilots, symmetry planes, receivers, sun position batches or first
+    // bounce caches
+    int translationAxis = -1;
+    // traces every ray for each variant too, its edits applied to copies of
+    // the materials, with the same random numbers: rays meeting none of the
+    // edited materials are traced once for all, see MaterialVariants. An
+    // edit changes the material node, so every surface sharing it.
+    // fluxAccumulator gets the flux of the scene itself. Depth-first FluxGrid
+    // traces with the RayIndexed generator; not with receivers, sun position
+    // batches, checkpoints, convergence, symmetry planes, cell pilots, power
+    // budgets, attribution, first bounce caches or hit callbacks
+    QVector<RayTraceVariant> variants;
+    // with sunPositions, builds the top level of the scene BVH again when its
+    // SAH cost after a refit passes this ratio of its cost when last built;
+    // 0 only refits, keeping the hierarchy of the first position
+    double refitRebuildRatio = 0.;
+    // with weighted transport and FluxGrid output, traces cellPilotRays from
+    // the sun aperture cells drawn uniformly on one worker first, then draws
+    // the cells by the rate their rays reached the flux targets, as in
+    // CellImportance, with cellPilotUniform of the draws uniform. With
+    // sunPositions a pilot serves the positions whose sun is within
+    // cellPilotReuseDeg of its own. 0 draws the cells uniformly
+    ulong cellPilotRays = 0;
+    double cellPilotUniform = 0.1;
+    double cellPilotReuseDeg = 0.;
+    // with RayTraceSunAperture::Reflectors, factors of the rays drawn on the
+    // surfaces under these URLs, the deepest URL given counting, 1 elsewhere;
+    // 0 starts no rays on a surface, so only rays drawn for its neighbours reach it
+    QHash<QString, double> reflectorRayFactors;
+    // traces the rays of rayBundle against the subtree receiverUrl only; the
+    // bundle is recorded first, from the scene without the receiver, if it
+    // belongs to another field, sun or sampling options. The receiver sees
+    // reflected rays only, neither the direct sun nor its shade on the field
+    QString receiverUrl;
+    RayBundle* rayBundle = nullptr;
+    // traces rounds of roundRays, up to rays in whole rounds, until the
+    // relative standard error of the target flux, estimated with the rounds
+    // as batches, is at most targetRelativeError on the cells of at least
+    // targetFluxFraction of the peak; 0 traces rays. Tracing then always
+    // follows the chunk schedule, each round with streams of its own
+    double targetRelativeError = 0.;
+    double targetFluxFraction = 0.1;
+    ulong roundRays = 0; // 0 takes a hundredth of rays
+    // cumulative values per cell the error is estimated from, read between
+    // rounds with no chunk in flight; empty reads the flux of fluxAccumulator
+    std::function<void(std::vector<double>&)> convergenceValues;
+    // continues the rays from the sun it holds from their first reflection
+    // where the surfaces they meet first are unchanged, recording it first if
+    // the sun, its aperture cells or the sampling options changed; later
+    // bounces draw from streams apart. Depth-first analog traces in NoOutput
+    // and FluxGrid modes with the streams of randomGenerator, not with
+    // receivers, sun position batches, checkpoints, shards, convergence,
+    // power budgets or attribution
+    FirstBounceCache* firstBounceCache = nullptr;
+    // keeps the instance tree and scene BVH of the call for the next calls
+    // while its key stays the same, see CompiledScene; the sun aperture is
+    // found again per call. Not with receivers or batches of more than one
+    // sun position
+    CompiledScene* compiledScene = nullptr;
+};
+
+// the workers of a trace that ran in one processor group, see CpuTopology
+struct RayTraceProcessorGroup
+{
+    int group = 0;
+    int processors = 0;
+    int workers = 0;
+    qulonglong rays = 0;
+    double busySeconds = 0.; // in chunks, summed over the workers
+    // the share of the time of the processors of the group spent in chunks
+    // while the workers ran
+    double utilization = 0.;
+};
+
+// the memory of a trace by subsystem, estimated from the arrays each holds
+// as SceneStatistics does; photons, accumulators and generator buffers as
+// the workers ended, before the photons are exported
+struct RayTraceMemory
+{
+    // the process when the trace began, the Coin scene graph loaded and
+    // nothing compiled, and its peak when the trace ended; 0 where unknown
+    qulonglong residentBytes = 0;
+    qulonglong peakResidentBytes = 0;
+    qulonglong instanceTreeBytes = 0;
+    qulonglong sceneBVHBytes = 0;
+    qulonglong geometryBytes = 0; // ray tracing data of the distinct shapes
+    qulonglong photonBytes = 0;
+    qulonglong accumulatorBytes = 0; // flux grids, attribution and camera image
+    qulonglong randomBytes = 0; // the sun direction bank and a stream buffer per worker
+    // heap allocations while the clock ran, in builds with
+    // TONATIUHPP_ENABLE_ALLOCATION_COUNT, see MemoryUsage
+    bool allocationsCounted = false;
+    qulonglong heapAllocations = 0;
 };
 
 struct RayTraceResult
@@ -42,8 +367,77 @@ struct RayTraceResult
     int workerCount = 1;
     ulong chunkSize = 0;
     qulonglong chunkCount = 0;
+    qulonglong dispatchCount = 0;
     bool canceled = false;
     bool exportFailed = false;
+    // restored from the checkpoint, included in raysTraced
+    qulonglong chunksResumed = 0;
+    ulong raysResumed = 0;
+    int checkpointsWritten = 0;
+    // NUMA nodes of the pinned workers, one scene BVH replica each
+    int numaNodes = 1;
+    // every processor group of the host, empty when the rays were traced
+    // without the chunk schedule
+    std::vector<RayTraceProcessorGroup> processorGroups;
+    // with lockMemory, whether the memory could be locked, and why not
+    bool memoryLocked = false;
+    QString memoryLockError;
+    // chunks [firstChunk, endChunk) of chunkCount traced by this shard
+    qulonglong firstChunk = 0;
+    qulonglong endChunk = 0;
+    // sun positions traced; aperture, irradiance and power are of the last
+    int sunPositions = 0;
+    // times the scene BVH was built again after a refit, see refitRebuildRatio
+    int bvhRebuilds = 0;
+    // pilot traces of cellPilotRays, one unless sun positions were too far apart
+    int cellPilots = 0;
+    // with receiverUrl, whether this call recorded the bundle, and its rays;
+    // raysTraced counts the rays traced from the bundle
+    bool rayBundleRecorded = false;
+    ulong rayBundleRays = 0;
+    // with firstBounceCache, whether this call recorded it, and the rays
+    // continued from a reflection it held
+    bool firstBounceCacheRecorded = false;
+    ulong firstBouncesReused = 0;
+    // with targetRelativeError, the rounds traced, the error after the last
+    // and whether it reached the target; powerPerRay is of the rays traced
+    int rounds = 0;
+    double relativeError = 0.;
+    bool converged = false;
+    // with powerBudget, in W over the rays traced; surface n of the budget is
+    // powerBudgetSurfaces[n]
+    PowerBudget powerBudget;
+    QStringList powerBudgetSurfaces;
+    // the work of the workers added up, in builds with TONATIUHPP_TRACE_STATS
+    TraceStatistics statistics;
+    // with perfCounters, the counts of each worker; the error of the first
+    // worker whose counters could not be opened
+    std::vector<PerfCounterValues> perfCounters;
+    QString perfCountersError;
+    RayTraceMemory memory;
+};
+
+// a snapshot of a running trace, see RayTraceRunner::progress()
+struct RayTraceProgress
+{
+    // rays of chunks in flight included, so it may pass the count of the result
+    ulong raysTraced = 0;
+    ulong raysTotal = 0;
+    int sunPosition = 0;
+    int sunPositionCount = 1;
+};
+
+// the flux at a point of a surface, see RayTraceRunner::tracePoints()
+struct RayTracePointFlux
+{
+    double u = 0.;
+    double v = 0.;
+    vec3d position;     // in world frame
+    vec3d normal;       // of the side traced
+    double irradiance = 0.; // in W/m2, direct sun included
+    double error = 0.;      // standard error of irradiance
+    double direct = 0.;
+    ulong samples = 0;
 };
 
 class RayTraceRunner
@@ -53,11 +447,15 @@ public:
     using CancellationCallback = std::function<bool()>;
     using HitCallback = std::function<void(const RayTracerHit&)>;
     using WorkerHitCallbackFactory = std::function<HitCallback(int)>;
+    // a sun position done, its rays and time in the result; flux grids hold
+    // its hits only if cleared by the previous call
+    using SunPositionCallback = std::function<void(int, const RayTraceResult&)>;
 
     // Migration boundary: GUI code still owns exporter startup, append/non-append
     // buffer lifecycle, retained-photon safeguards, endExport(power), and ray
     // display. RayTraceRunner only executes tracing against an already-prepared
-    // photon buffer when outputMode is PhotonBuffer.
+    // photon buffer when outputMode is PhotonBuffer, ending its export only
+    // with endPhotonExport, as PhotonExport sets for headless runs.
     bool trace(TSceneKit* scene,
                const RayTraceOptions& options,
                RayTraceResult* result,
@@ -65,5 +463,67 @@ public:
                const ProgressCallback& progress = ProgressCallback(),
                const HitCallback& hitCallback = HitCallback(),
                const WorkerHitCallbackFactory& workerHitCallbackFactory = WorkerHitCallbackFactory(),
-               const CancellationCallback& cancellation = CancellationCallback()) const;
+               const CancellationCallback& cancellation = CancellationCallback(),
+               const SunPositionCallback& sunPositionDone = SunPositionCallback()) const;
+
+    // the irradiance at points (u, v) of the side of surfaceUrl, traced from
+    // each point to the sun by BackwardTracer with samples each, against the
+    // scene without surfaceUrl; point n draws from stream n of seed
+    bool tracePoints(TSceneKit* scene,
+                     const QString& surfaceUrl,
+                     bool isFront,
+                     const QVector<RayTracePointFlux>& points,
+                     ulong samples,
+                     ulong seed,
+                     QVector<RayTracePointFlux>* fluxes,
+                     QString* errorMessage) const;
+
+    // may be polled from any thread while trace() runs; the workers only add
+    // to relaxed counters once per micro-batch of rays
+    RayTraceProgress progress() const;
+    // stops the running trace within a micro-batch of rays per worker, with
+    // checkpoints between chunks; the result is marked canceled
+    void cancel() const {m_cancel.store(true, std::memory_order_relaxed);}
+
+private:
+    struct BundlePass;
+
+    bool traceScene(TSceneKit* scene,
+                    const RayTraceOptions& options,
+                    RayTraceResult* result,
+                    QString* errorMessage,
+                    const ProgressCallback& progress,
+                    const HitCallback& hitCallback,
+                    const WorkerHitCallbackFactory& workerHitCallbackFactory,
+                    const CancellationCallback& cancellation,
+                    const SunPositionCallback& sunPositionDone,
+                    const BundlePass* pass) const;
+    bool traceConvolution(TSceneKit* scene,
+                          const RayTraceOptions& options,
+                          RayTraceResult* result,
+                          QString* errorMessage,
+                          const ProgressCallback& progress) const;
+    bool traceReceiver(TSceneKit* scene,
+                       const RayTraceOptions& options,
+                       RayTraceResult* result,
+                       QString* errorMessage,
+                       const ProgressCallback& progress,
+                       const HitCallback& hitCallback,
+                       const WorkerHitCallbackFactory& workerHitCallbackFactory,
+                       const CancellationCallback& cancellation) const;
+    void startProgress(ulong raysTotal, int sunPositionCount) const;
+
+    // worker w counts into slot w % ProgressSlots, one cache line each
+    struct alignas(64) ProgressSlot
+    {
+        std::atomic<ulong> rays{0};
+    };
+    static const int ProgressSlots = 64;
+
+    mutable std::array<ProgressSlot, ProgressSlots> m_progressSlots;
+    mutable std::atomic<ulong> m_raysBase{0};
+    mutable std::atomic<ulong> m_raysTotal{0};
+    mutable std::atomic_int m_sunPosition{0};
+    mutable std::atomic_int m_sunPositionCount{1};
+    mutable std::atomic_bool m_cancel{false};
 };
@@ -0,0 +1,186 @@
+#include "RayTraceShard.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace
+{
+const quint32 Magic = 0x544e5348; // "TNSH"
+const quint32 Version = 1;
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+}
+
+bool RayTraceShard::write(const QString& fileName, QString* errorMessage) const
+{
+    QFileInfo info(fileName);
+    QDir dir;
+    if (!dir.mkpath(info.absolutePath()))
+        return fail(errorMessage, QString("Cannot create partial result directory %1.").arg(info.absolutePath()));
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(errorMessage, QString("Cannot open partial result file %1: %2").arg(fileName, file.errorString()));
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << Magic << Version << command << source << key;
+    out << qint32(shard) << qint32(shards) << quint64(firstChunk) << quint64(endChunk) << quint64(chunkCount) << quint64(chunkSize);
+    out << qint32(workerCount) << quint64(dispatchCount) << qint32(numaNodes) << memoryLocked;
+    out << quint64(statistics.rays) << quint64(statistics.bounces) << quint64(statistics.hits)
+        << quint64(statistics.sunMisses) << quint64(statistics.boxTests) << quint64(statistics.instanceSwitches);
+    out << quint32(traces.size());
+    for (const Trace& trace : traces) {
+        out << quint64(trace.raysTraced) << trace.elapsedSeconds << trace.powerPerRay << trace.sunApertureArea
+            << qint32(trace.bvhRebuilds) << quint64(trace.hits);
+        out << quint32(trace.counts.size());
+        for (qulonglong count : trace.counts)
+            out << quint64(count);
+    }
+
+    if (out.status() != QDataStream::Ok || !file.commit())
+        return fail(errorMessage, QString("Cannot write partial result file %1: %2").arg(fileName, file.errorString()));
+    return true;
+}
+
+bool RayTraceShard::read(const QString& fileName, QString* errorMessage)
+{
+    *this = RayTraceShard();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(errorMessage, QString("Cannot open partial result file %1: %2").arg(fileName, file.errorString()));
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != Magic)
+        return fail(errorMessage, QString("%1 is not a partial result of a shard.").arg(fileName));
+    if (version != Version)
+        return fail(errorMessage, QString("Unsupported partial result version %1 in %2.").arg(version).arg(fileName));
+
+    qint32 index = 0;
+    qint32 count = 0;
+    quint64 first = 0;
+    quint64 end = 0;
+    quint64 chunks = 0;
+    quint64 size = 0;
+    qint32 workers = 0;
+    quint64 dispatches = 0;
+    qint32 nodes = 0;
+    in >> command >> source >> key >> index >> count >> first >> end >> chunks >> size >> workers >> dispatches >> nodes >> memoryLocked;
+    quint64 counters[6] = {};
+    for (quint64& counter : counters)
+        in >> counter;
+    quint32 traceCount = 0;
+    in >> traceCount;
+    if (in.status() != QDataStream::Ok || count < 1 || index < 0 || index >= count || first > end || end > chunks)
+        return fail(errorMessage, QString("Partial result %1 is corrupt.").arg(fileName));
+    shard = index;
+    shards = count;
+    firstChunk = first;
+    endChunk = end;
+    chunkCount = chunks;
+    chunkSize = ulong(size);
+    workerCount = workers;
+    dispatchCount = dispatches;
+    numaNodes = nodes;
+    statistics.rays = counters[0];
+    statistics.bounces = counters[1];
+    statistics.hits = counters[2];
+    statistics.sunMisses = counters[3];
+    statistics.boxTests = counters[4];
+    statistics.instanceSwitches = counters[5];
+
+    for (quint32 t = 0; t < traceCount && in.status() == QDataStream::Ok; ++t) {
+        Trace trace;
+        quint64 rays = 0;
+        qint32 rebuilds = 0;
+        quint64 hits = 0;
+        quint32 cells = 0;
+        in >> rays >> trace.elapsedSeconds >> trace.powerPerRay >> trace.sunApertureArea >> rebuilds >> hits >> cells;
+        if (in.status() != QDataStream::Ok || qint64(cells)*8 > file.size())
+            return fail(errorMessage, QString("Partial result %1 is corrupt.").arg(fileName));
+        trace.raysTraced = ulong(rays);
+        trace.bvhRebuilds = rebuilds;
+        trace.hits = hits;
+        trace.counts.resize(cells);
+        for (quint32 n = 0; n < cells; ++n) {
+            quint64 value = 0;
+            in >> value;
+            trace.counts[n] = value;
+        }
+        traces.push_back(std::move(trace));
+    }
+
+    if (in.status() != QDataStream::Ok)
+        return fail(errorMessage, QString("Partial result %1 is truncated.").arg(fileName));
+    return true;
+}
+
+bool RayTraceShard::merge(const std::vector<RayTraceShard>& parts, RayTraceShard* merged, QString* errorMessage)
+{
+    if (parts.empty())
+        return fail(errorMessage, "No partial results to merge.");
+    const RayTraceShard& head = parts.front();
+    if (int(parts.size()) != head.shards)
+        return fail(errorMessage, QString("The job has %1 shards, %2 partial results were given.").arg(head.shards).arg(parts.size()));
+
+    // every shard once, and their ranges tiling the chunks
+    std::vector<const RayTraceShard*> order(parts.size(), nullptr);
+    for (const RayTraceShard& part : parts) {
+        if (part.command != head.command || part.key != head.key || part.shards != head.shards || part.chunkCount != head.chunkCount ||
+            part.traces.size() != head.traces.size())
+            return fail(errorMessage, QString("Shard %1 is of another job than shard %2.").arg(part.shard).arg(head.shard));
+        if (order[size_t(part.shard)])
+            return fail(errorMessage, QString("Shard %1 was given more than once.").arg(part.shard));
+        order[size_t(part.shard)] = &part;
+    }
+    qulonglong chunk = 0;
+    for (const RayTraceShard* part : order) {
+        if (part->firstChunk != chunk)
+            return fail(errorMessage, QString("The chunks of shard %1 do not follow those of the shard before.").arg(part->shard));
+        chunk = part->endChunk;
+    }
+    if (chunk != head.chunkCount)
+        return fail(errorMessage, "The shards do not cover every chunk.");
+
+    RayTraceShard ans = *order.front();
+    ans.shard = 0;
+    ans.shards = 1;
+    ans.endChunk = head.chunkCount;
+    for (size_t p = 1; p < order.size(); ++p) {
+        const RayTraceShard& part = *order[p];
+        ans.dispatchCount += part.dispatchCount;
+        ans.numaNodes = std::max(ans.numaNodes, part.numaNodes);
+        ans.memoryLocked = ans.memoryLocked && part.memoryLocked;
+        ans.statistics.add(part.statistics);
+        for (size_t t = 0; t < ans.traces.size(); ++t) {
+            Trace& trace = ans.traces[t];
+            const Trace& other = part.traces[t];
+            if (other.counts.size() != trace.counts.size() || other.powerPerRay != trace.powerPerRay)
+                return fail(errorMessage, QString("Shard %1 is of another job than shard 0.").arg(part.shard));
+            trace.raysTraced += other.raysTraced;
+            trace.elapsedSeconds = std::max(trace.elapsedSeconds, other.elapsedSeconds);
+            trace.bvhRebuilds = std::max(trace.bvhRebuilds, other.bvhRebuilds);
+            trace.hits += other.hits;
+            for (size_t n = 0; n < trace.counts.size(); ++n)
+                trace.counts[n] += other.counts[n];
+        }
+    }
+    *merged = std::move(ans);
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <QString>
+#include <qglobal.h>
+
+#include "kernel/run/TraceStatistics.h"
+
+// Partial result of one shard of an array job, for runs without MPI. The shards
+// trace disjoint chunk ranges of one trace, each chunk with the seed or stream
+// it has in a single run, and keep integer counts, so the sums of all shards
+// equal the single-process trace on the chunk schedule bit for bit.
+struct RayTraceShard
+{
+    // the whole trace, or one sun position of a batch
+    struct Trace
+    {
+        ulong raysTraced = 0;
+        double elapsedSeconds = 0.;
+        double powerPerRay = 0.;
+        double sunApertureArea = 0.;
+        int bvhRebuilds = 0;
+        qulonglong hits = 0;
+        std::vector<qulonglong> counts; // per cell, empty without a grid
+    };
+
+    QString command; // trace-scene or benchmark
+    QString source;  // the scene or benchmark config traced, absolute
+    // options and files of the job, equal for all of its shards
+    QString key;
+    int shard = 0;
+    int shards = 1;
+    qulonglong firstChunk = 0;
+    qulonglong endChunk = 0;
+    qulonglong chunkCount = 0;
+    ulong chunkSize = 0;
+    int workerCount = 1;
+    qulonglong dispatchCount = 0;
+    int numaNodes = 1;
+    bool memoryLocked = false;
+    TraceStatistics statistics; // the counters, shape tests are not kept
+    std::vector<Trace> traces;
+
+    // written through QSaveFile, as checkpoints
+    bool write(const QString& fileName, QString* errorMessage) const;
+    bool read(const QString& fileName, QString* errorMessage);
+
+    // shards 0 to shards - 1 of one job, in any order, summed as one shard of
+    // all chunks: counts and rays added, the longest elapsed time kept
+    static bool merge(const std::vector<RayTraceShard>& parts, RayTraceShard* merged, QString* errorMessage);
+};
@@ -0,0 +1,171 @@
+#include "SceneEditor.h"
+
+#include <cmath>
+
+#include <QStringList>
+
+#include <Inventor/SbString.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/fields/SoSFNode.h>
+#include <Inventor/fields/SoSFString.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/sensors/SoSensorManager.h>
+
+#include "kernel/scene/TSceneKit.h"
+#include "kernel/scene/TSeparatorKit.h"
+#include "kernel/sun/SunPosition.h"
+
+namespace
+{
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+
+// the field of node, labelled in errors as the node
+SoField* fieldOf(SoNode* node, const QString& label, const QString& name, QString* errorMessage)
+{
+    SoNode* owner = node;
+    QString field = name;
+    const int dot = name.lastIndexOf('.');
+    if (dot >= 0) {
+        SoBaseKit* kit = dynamic_cast<SoBaseKit*>(node);
+        owner = kit ? kit->getPart(name.left(dot).toLatin1().data(), false) : nullptr;
+        field = name.mid(dot + 1);
+    } else if (TSeparatorKit* kit = dynamic_cast<TSeparatorKit*>(node)) {
+        if (!kit->getField(field.toLatin1().data()))
+            owner = kit->getPart("transform", true);
+    }
+
+    SoField* ans = owner ? owner->getField(field.toLatin1().data()) : nullptr;
+    if (!ans) {
+        fail(errorMessage, QString("%1 has no field %2.").arg(label, name));
+        return nullptr;
+    }
+    if (ans->isOfType(SoSFNode::getClassTypeId())) {
+        fail(errorMessage, QString("%1 of %2 holds a node and cannot be set.").arg(name, label));
+        return nullptr;
+    }
+    return ans;
+}
+
+}
+
+SoNode* SceneEditor::findNode(TSceneKit* scene, const QString& url, QString* errorMessage)
+{
+    const QStringList names = url.split('/', Qt::SkipEmptyParts);
+    TSeparatorKit* layout = scene ? scene->getLayout() : nullptr;
+    if (names.isEmpty() || !layout || names.first() != layout->getName().getString()) {
+        fail(errorMessage, QString("%1 is not a node URL of the layout.").arg(url));
+        return nullptr;
+    }
+
+    SoNode* node = layout;
+    for (int n = 1; n < names.size(); ++n) {
+        TSeparatorKit* kit = dynamic_cast<TSeparatorKit*>(node);
+        SoGroup* group = kit ? static_cast<SoGroup*>(kit->getPart("group", false)) : nullptr;
+        SoNode* child = nullptr;
+        for (int c = 0; group && c < group->getNumChildren() && !child; ++c)
+            if (names[n] == group->getChild(c)->getName().getString())
+                child = group->getChild(c);
+        if (!child) {
+            fail(errorMessage, QString("Node %1 was not found.").arg(url));
+            return nullptr;
+        }
+        node = child;
+    }
+    return node;
+}
+
+SoField* SceneEditor::findField(TSceneKit* scene, const QString& url, const QString& name, QString* errorMessage)
+{
+    SoNode* node = findNode(scene, url, errorMessage);
+    if (!node)
+        return nullptr;
+    return fieldOf(node, url, name, errorMessage);
+}
+
+SoField* SceneEditor::findField(SoNode* node, const QString& name, QString* errorMessage)
+{
+    return fieldOf(node, node->getName().getString(), name, errorMessage);
+}
+
+bool SceneEditor::setField(SoField* field, const QString& text)
+{
+    if (field->isOfType(SoSFString::getClassTypeId())) {
+        static_cast<SoSFString*>(field)->setValue(text.toLatin1().data());
+        return true;
+    }
+    return field->set(text.toLatin1().data());
+}
+
+bool SceneEditor::setFields(const std::vector<SoNode*>& nodes, const QString& name, const QStringList& values, QString* errorMessage)
+{
+    if (values.size() != 1 && values.size() != qsizetype(nodes.size()))
+        return fail(errorMessage, QString("%1 values were given for %2 nodes.").arg(values.size()).arg(nodes.size()));
+
+    std::vector<SoField*> fields;
+    fields.reserve(nodes.size());
+    for (SoNode* node : nodes) {
+        SoField* field = findField(node, name, errorMessage);
+        if (!field)
+            return false;
+        fields.push_back(field);
+    }
+
+    // set silently; the old values are kept to undo a wrong value
+    std::vector<SbString> olds(fields.size());
+    std::vector<SbBool> notifies(fields.size());
+    for (size_t n = 0; n < fields.size(); ++n) {
+        fields[n]->get(olds[n]);
+        notifies[n] = fields[n]->isNotifyEnabled();
+        fields[n]->enableNotify(FALSE);
+    }
+    size_t done = 0;
+    for (; done < fields.size(); ++done)
+        if (!setField(fields[done], values[values.size() == 1 ? 0 : qsizetype(done)]))
+            break;
+    const bool ok = done == fields.size();
+    if (!ok)
+        for (size_t n = 0; n < done; ++n)
+            fields[n]->set(olds[n].getString());
+    for (size_t n = fields.size(); n-- > 0;)
+        fields[n]->enableNotify(notifies[n]);
+    if (!ok)
+        return fail(errorMessage, QString("%1 is not a value of %2 of %3.")
+            .arg(values[values.size() == 1 ? 0 : qsizetype(done)], name, nodes[done]->getName().getString()));
+
+    // one notification per field, and the sensors scheduled by them once
+    for (SoField* field : fields)
+        field->touch();
+    SoDB::getSensorManager()->processDelayQueue(TRUE);
+    return true;
+}
+
+bool SceneEditor::checkSunAngles(double azimuth, double elevation, QString* errorMessage)
+{
+    if (std::isfinite(azimuth) && std::isfinite(elevation) && elevation >= -90. && elevation <= 90.)
+        return true;
+    return fail(errorMessage, "Azimuth must be finite and elevation between -90 and 90 degrees.");
+}
+
+bool SceneEditor::setSun(TSceneKit* scene, double azimuth, double elevation, QString* errorMessage)
+{
+    if (!checkSunAngles(azimuth, elevation, errorMessage))
+        return false;
+    SunPosition* sunPosition = scene ? static_cast<SunPosition*>(scene->getPart("world.sun.position", false)) : nullptr;
+    if (!sunPosition)
+        return fail(errorMessage, "The scene has no sun position.");
+    sunPosition->azimuth = azimuth;
+    sunPosition->elevation = elevation;
+    return true;
+}
+
+void SceneEditor::followEdits(TSceneKit* scene)
+{
+    SoDB::getSensorManager()->processDelayQueue(TRUE);
+    scene->updateTrackers(false);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+class SoField;
+class SoNode;
+class TSceneKit;
+
+//! SceneEditor sets the parameters of a loaded scene by node URL, for scripts and bindings.
+/*!
+ * Nodes are found by their URL in the layout, such as //Layout/Field/Heliostat1.
+ * A field is named as in the scene file, or as part.field for a part of a
+ * node kit. The fields of a separator kit are those of its transform, as in
+ * the scene tree. Values are text as in the scene file.
+ *
+ * Edits are followed once by followEdits() before the next trace: the
+ * pending node sensors run and the trackers are aimed again.
+ *
+ * setFields() edits one field of many nodes at once, as the aim points or
+ * reflectivities of a field of heliostats: the fields do not notify while
+ * they are set, then each notifies once and the node sensors run once.
+ */
+class SceneEditor
+{
+public:
+    static SoNode* findNode(TSceneKit* scene, const QString& url, QString* errorMessage = nullptr);
+    // fields holding nodes are not found
+    static SoField* findField(TSceneKit* scene, const QString& url, const QString& field, QString* errorMessage = nullptr);
+    static SoField* findField(SoNode* node, const QString& field, QString* errorMessage = nullptr);
+    // false if text is not a value of field
+    static bool setField(SoField* field, const QString& text);
+    // one value per node or one for all; if any node lacks the field or any
+    // value is wrong, no field is changed
+    static bool setFields(const std::vector<SoNode*>& nodes, const QString& field, const QStringList& values, QString* errorMessage = nullptr);
+
+    static bool checkSunAngles(double azimuth, double elevation, QString* errorMessage = nullptr);
+    // in degrees
+    static bool setSun(TSceneKit* scene, double azimuth, double elevation, QString* errorMessage = nullptr);
+
+    static void followEdits(TSceneKit* scene);
+};
@@ -1,46 +1,154 @@
 #include "SceneInstanceBuilder.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include <Inventor/nodes/SoGroup.h>
 
 #include "kernel/run/InstanceNode.h"
 #include "kernel/scene/TSceneKit.h"
 #include "kernel/scene/TSeparatorKit.h"
 
+namespace {
+
+// subtrees per thread below which they are made on the calling thread
+const int BuildGrain = 16;
+
+// the group of a TSeparatorKit
+SoGroup* findGroup(SoNode* node)
+{
+    TSeparatorKit* kit = dynamic_cast<TSeparatorKit*>(node);
+    if (!kit)
+        return nullptr;
+    return static_cast<SoGroup*>(kit->getPart("group", false));
+}
+
+// the Coin nodes below an instance, in the order generateSubtree adds them:
+// the child count of a node, then its children, then each child in turn
+struct SubtreeNodes
+{
+    std::vector<int> counts;
+    std::vector<SoNode*> nodes;
+};
+
+void listSubtree(SoNode* node, SubtreeNodes& list)
+{
+    SoGroup* group = findGroup(node);
+    const int count = group ? group->getNumChildren() : 0;
+    list.counts.push_back(count);
+    const size_t first = list.nodes.size();
+    for (int n = 0; n < count; ++n)
+        list.nodes.push_back(group->getChild(n));
+    for (int n = 0; n < count; ++n)
+        listSubtree(list.nodes[first + n], list);
+}
+
+void makeSubtree(InstanceNode* instance, const SubtreeNodes& list, size_t& c, size_t& n, InstanceArena* arena)
+{
+    const int count = list.counts[c++];
+    instance->children.reserve(count);
+    for (int k = 0; k < count; ++k)
+        instance->addChild(arena->create(list.nodes[n++]));
+    for (InstanceNode* child : instance->children)
+        makeSubtree(child, list, c, n, arena);
+}
+
+} // namespace
+
 SceneInstanceTree SceneInstanceBuilder::build(TSceneKit* scene)
 {
     SceneInstanceTree tree;
     if (!scene)
         return tree;
 
-    tree.sceneRoot = std::make_unique<InstanceNode>(scene);
+    tree.arena = std::make_unique<InstanceArena>();
+    tree.sceneRoot = tree.arena->create(scene);
 
     TSeparatorKit* layout = scene->getLayout();
     if (!layout)
         return tree;
 
-    tree.layoutRoot = new InstanceNode(layout);
+    tree.layoutRoot = tree.arena->create(layout);
     tree.sceneRoot->addChild(tree.layoutRoot);
-    generateInstanceTree(tree.layoutRoot);
+    generateInstanceTree(tree.layoutRoot, tree.arena.get());
     return tree;
 }
 
-void SceneInstanceBuilder::generateInstanceTree(InstanceNode* instance)
+int SceneInstanceBuilder::getChildCount(const InstanceNode* instance)
 {
     if (!instance || !instance->getNode())
-        return;
+        return 0;
 
-    TSeparatorKit* kit = dynamic_cast<TSeparatorKit*>(instance->getNode());
-    if (!kit)
-        return;
+    SoGroup* group = findGroup(instance->getNode());
+    return group ? group->getNumChildren() : 0;
+}
 
+int SceneInstanceBuilder::fetchChildren(InstanceNode* instance, int count, InstanceArena* arena)
+{
+    const int first = instance ? instance->children.count() : 0;
+    const int last = std::min(first + count, getChildCount(instance));
+    if (last <= first)
+        return 0;
+
+    TSeparatorKit* kit = static_cast<TSeparatorKit*>(instance->getNode());
     SoGroup* group = static_cast<SoGroup*>(kit->getPart("group", false));
-    if (!group)
+    instance->children.reserve(last);
+    for (int n = first; n < last; ++n)
+        instance->addChild(arena ? arena->create(group->getChild(n)) : new InstanceNode(group->getChild(n)));
+    return last - first;
+}
+
+void SceneInstanceBuilder::generateInstanceTree(InstanceNode* instance, InstanceArena* arena)
+{
+    if (!instance)
         return;
 
-    for (int n = 0; n < group->getNumChildren(); ++n) {
-        SoNode* childNode = group->getChild(n);
-        InstanceNode* childInstance = new InstanceNode(childNode);
-        instance->addChild(childInstance);
-        generateInstanceTree(childInstance);
+    // the first levels here, the children of an instance together as below
+    const int threads = std::max(1, int(std::thread::hardware_concurrency()));
+    std::vector<InstanceNode*> level = {instance};
+    while (!level.empty() && int(level.size()) < threads*BuildGrain) {
+        std::vector<InstanceNode*> next;
+        for (InstanceNode* node : level) {
+            fetchChildren(node, getChildCount(node), arena);
+            next.insert(next.end(), node->children.begin(), node->children.end());
+        }
+        level.swap(next);
+    }
+
+    const int workers = std::min(threads, int(level.size())/BuildGrain);
+    if (workers <= 1) {
+        for (InstanceNode* node : level)
+            generateSubtree(node, arena);
+        return;
     }
+    // Coin nodes are read here, the threads only allocate the instances
+    std::vector<SubtreeNodes> lists(level.size());
+    for (size_t n = 0; n < level.size(); ++n)
+        listSubtree(level[n]->getNode(), lists[n]);
+
+    std::vector<InstanceArena> arenas(workers);
+    std::atomic<size_t> next(0);
+    auto make = [&](int w) {
+        for (size_t n = next++; n < level.size(); n = next++) {
+            size_t c = 0, k = 0;
+            makeSubtree(level[n], lists[n], c, k, &arenas[w]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int w = 1; w < workers; ++w)
+        pool.emplace_back(make, w);
+    make(0);
+    for (std::thread& thread : pool)
+        thread.join();
+    for (InstanceArena& a : arenas)
+        arena->merge(a);
+}
+
+void SceneInstanceBuilder::generateSubtree(InstanceNode* instance, InstanceArena* arena)
+{
+    fetchChildren(instance, getChildCount(instance), arena);
+    for (InstanceNode* child : instance->children)
+        generateSubtree(child, arena);
 }
@@ -2,20 +2,45 @@
 
 #include <memory>
 
+#include "kernel/run/InstanceArena.h"
+
 class InstanceNode;
 class TSceneKit;
 
+// the nodes of the tree live as long as its arena
 struct SceneInstanceTree
 {
-    std::unique_ptr<InstanceNode> sceneRoot;
+    std::unique_ptr<InstanceArena> arena;
+    InstanceNode* sceneRoot = nullptr;
     InstanceNode* layoutRoot = nullptr;
 };
 
+//! SceneInstanceBuilder makes the InstanceNode trees of scenes.
+/*!
+ * build() makes the whole tree at once, as the ray tracer needs it, while
+ * fetchChildren() adds the children of one instance a few at a time, as
+ * SceneTreeModel shows them, so both trees are made the same way.
+ * Trees of build() are allocated from an InstanceArena and freed at once.
+ *
+ * build() makes the first levels breadth first, until they hold enough
+ * subtrees for the processors, and lists the Coin nodes of the subtrees
+ * below, all on the calling thread, since Coin is not safe to read from
+ * several threads. The instances of the subtrees are then made in parallel,
+ * each thread taking the next subtree not made and allocating from an arena
+ * of its own, merged into that of the tree at the end.
+ */
 class SceneInstanceBuilder
 {
 public:
     static SceneInstanceTree build(TSceneKit* scene);
 
+    // children of the node of the instance, of the group of a TSeparatorKit
+    static int getChildCount(const InstanceNode* instance);
+    // adds instances for the next count children not yet added, returns how many;
+    // without an arena they are made with new
+    static int fetchChildren(InstanceNode* instance, int count, InstanceArena* arena = nullptr);
+
 private:
-    static void generateInstanceTree(InstanceNode* instance);
+    static void generateInstanceTree(InstanceNode* instance, InstanceArena* arena);
+    static void generateSubtree(InstanceNode* instance, InstanceArena* arena);
 };
@@ -1,13 +1,179 @@
 #include "SceneLoader.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
 #include <Inventor/SoDB.h>
 #include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/actions/SoSearchAction.h>
+#include <Inventor/actions/SoWriteAction.h>
 #include <Inventor/fields/SoSFString.h>
 #include <Inventor/nodes/SoSeparator.h>
 
+#include <QCryptographicHash>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
 
+#include "kernel/node/SensorBatch.h"
 #include "kernel/scene/TSceneKit.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/ShapeRT.h"
+
+namespace {
+
+const char CacheMagic[4] = {'T', 'N', 'S', 'C'};
+const quint32 CacheVersion = 1;
+
+struct CacheHeader
+{
+    char magic[4];
+    quint32 version;
+    char key[20]; // Sha1 of the scene file, the node types and Coin
+};
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+
+// reports the bytes read at every name, as nodes and fields begin
+class ProgressInput: public SoInput
+{
+public:
+    ProgressInput(SceneLoadProgress* progress, qint64 size):
+        m_progress(progress),
+        m_size(size)
+    {}
+
+    using SoInput::read;
+    SbBool read(SbName& name, SbBool validIdent = FALSE) override
+    {
+        if (m_progress->isCanceled()) return FALSE;
+        m_progress->set(SceneLoadProgress::Parsing, qint64(getNumBytesRead()), m_size);
+        return SoInput::read(name, validIdent);
+    }
+
+private:
+    SceneLoadProgress* m_progress;
+    qint64 m_size;
+};
+
+void* reallocBuffer(void* buffer, size_t size)
+{
+    return std::realloc(buffer, size);
+}
+
+// the scene root of a file read by SoInput, fileName is for the messages
+bool readInput(SoInput* input, const QString& fileName, LoadedScene* scene, QString* errorMessage)
+{
+    if (!input->isValidFile())
+        return fail(errorMessage, QString("Error reading file %1.").arg(fileName));
+
+    // the nodes update what they derive from their fields once, on return
+    SensorBatch batch;
+    SoSeparator* separator = SoDB::readAll(input);
+    if (!separator)
+        return fail(errorMessage, QString("Error reading file %1.").arg(fileName));
+
+    separator->ref();
+    auto failWithSeparator = [separator, errorMessage](const QString& message) {
+        separator->unref();
+        return fail(errorMessage, message);
+    };
+
+    if (separator->getNumChildren() < 1)
+        return failWithSeparator(QString("Error reading file %1: missing Tonatiuh++ scene root.").arg(fileName));
+
+    TSceneKit* loadedScene = dynamic_cast<TSceneKit*>(separator->getChild(0));
+    if (!loadedScene)
+        return failWithSeparator(QString("Error reading file %1: invalid Tonatiuh++ scene root.").arg(fileName));
+
+    SoSFString* versionField = dynamic_cast<SoSFString*>(loadedScene->getField("version"));
+    if (!versionField)
+        return failWithSeparator(QString("Error reading file %1: missing Tonatiuh++ project version.").arg(fileName));
+
+    const QString version = versionField->getValue().getString();
+    if (version != "2020")
+        return failWithSeparator(QString("Version %1 is not compatible.").arg(version));
+
+    if (scene)
+        scene->reset(loadedScene);
+
+    separator->removeChild(loadedScene);
+    separator->unref();
+    return true;
+}
+
+// a missing, stale or unreadable cache is a miss
+bool readCache(const QString& cacheName, const QByteArray& key, const QString& fileName, LoadedScene* scene)
+{
+    QFile file(cacheName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const qint64 size = file.size();
+    if (size <= qint64(sizeof(CacheHeader))) return false;
+    const uchar* bytes = file.map(0, size);
+    if (!bytes) return false;
+
+    CacheHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0) return false;
+    if (header.version != CacheVersion) return false;
+    if (key.size() != int(sizeof(header.key)) || std::memcmp(header.key, key.constData(), sizeof(header.key)) != 0) return false;
+
+    SoInput input;
+    input.setBuffer(bytes + sizeof(header), size_t(size - qint64(sizeof(header))));
+    return readInput(&input, fileName, scene, nullptr);
+}
+
+// a cache that cannot be written is left out
+void writeCache(const QString& cacheName, const QByteArray& key, TSceneKit* scene)
+{
+    if (!scene || key.size() != int(sizeof(CacheHeader::key))) return;
+
+    SoOutput output;
+    output.setBinary(TRUE);
+    size_t size = 1 << 16;
+    output.setBuffer(std::malloc(size), size, reallocBuffer);
+    SoWriteAction action(&output);
+    action.apply(scene);
+
+    void* buffer = nullptr;
+    output.getBuffer(buffer, size);
+
+    CacheHeader header;
+    std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = CacheVersion;
+    std::memcpy(header.key, key.constData(), sizeof(header.key));
+
+    QSaveFile file(cacheName);
+    bool ok = file.open(QIODevice::WriteOnly) &&
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header)) &&
+        file.write(static_cast<const char*>(buffer), qint64(size)) == qint64(size);
+    std::free(buffer);
+    if (ok) file.commit();
+}
+
+} // namespace
+
+double SceneLoadProgress::getFraction() const
+{
+    const qint64 total = m_total.load();
+    if (total <= 0) return 0.;
+    return std::min(double(m_done.load())/total, 1.);
+}
+
+void SceneLoadProgress::set(Stage stage, qint64 done, qint64 total)
+{
+    m_stage.store(stage);
+    m_total.store(total);
+    m_done.store(done);
+}
 
 LoadedScene::~LoadedScene()
 {
@@ -31,61 +197,96 @@ void LoadedScene::reset(TSceneKit* scene)
         m_scene->ref();
 }
 
-bool SceneLoader::readFile(const QString& fileName, LoadedScene* scene, QString* errorMessage)
+bool SceneLoader::readFile(const QString& fileName, LoadedScene* scene, QString* errorMessage, SceneLoadProgress* progress)
 {
-    auto fail = [errorMessage](const QString& message) {
-        if (errorMessage)
-            *errorMessage = message;
-        return false;
-    };
-
     if (scene)
         scene->reset();
 
     if (fileName.isEmpty())
-        return fail("Scene file path is empty.");
+        return fail(errorMessage, "Scene file path is empty.");
 
-    SoInput input;
+    SoInput plainInput;
+    ProgressInput progressInput(progress, QFileInfo(fileName).size());
+    SoInput& input = progress ? progressInput : plainInput;
     const QByteArray encodedFileName = QFile::encodeName(fileName);
     if (!input.openFile(encodedFileName.constData()))
-        return fail(QString("Cannot open file %1.").arg(fileName));
+        return fail(errorMessage, QString("Cannot open file %1.").arg(fileName));
 
-    if (!input.isValidFile()) {
-        input.closeFile();
-        return fail(QString("Error reading file %1.").arg(fileName));
+    bool ok = readInput(&input, fileName, scene, errorMessage);
+    input.closeFile();
+    if (progress && progress->isCanceled()) {
+        if (scene)
+            scene->reset();
+        ok = fail(errorMessage, QString("Reading of %1 was canceled.").arg(fileName));
     }
+    return ok;
+}
 
-    SoSeparator* separator = SoDB::readAll(&input);
-    input.closeFile();
+bool SceneLoader::prepareShapes(TSceneKit* scene, SceneLoadProgress* progress, QString* errorMessage)
+{
+    // deferred meshes are built as they are drawn
+    if (!scene || TShapeKit::isDeferredGL())
+        return true;
 
-    if (!separator)
-        return fail(QString("Error reading file %1.").arg(fileName));
+    SoSearchAction search;
+    search.setType(TShapeKit::getClassTypeId());
+    search.setInterest(SoSearchAction::ALL);
+    search.setSearchingAll(TRUE);
+    search.apply(scene);
 
-    separator->ref();
-    auto failWithSeparator = [separator, &fail](const QString& message) {
-        separator->unref();
-        return fail(message);
-    };
+    const SoPathList& paths = search.getPaths();
+    // the distinct polygon profiles are triangulated first, on all processors
+    std::vector<TShapeKit*> kits;
+    kits.reserve(paths.getLength());
+    for (int n = 0; n < paths.getLength(); ++n)
+        kits.push_back(static_cast<TShapeKit*>(paths[n]->getTail()));
+    ShapeRT::prepareMeshes(kits);
 
-    if (separator->getNumChildren() < 1)
-        return failWithSeparator(QString("Error reading file %1: missing Tonatiuh++ scene root.").arg(fileName));
+    for (int n = 0; n < paths.getLength(); ++n) {
+        if (progress && progress->isCanceled())
+            return fail(errorMessage, "Preparation of shapes was canceled.");
+        if (progress)
+            progress->set(SceneLoadProgress::Shapes, n, paths.getLength());
+        kits[n]->updateShapeGL();
+    }
+    if (progress)
+        progress->set(SceneLoadProgress::Shapes, paths.getLength(), paths.getLength());
+    return true;
+}
 
-    TSceneKit* loadedScene = dynamic_cast<TSceneKit*>(separator->getChild(0));
-    if (!loadedScene)
-        return failWithSeparator(QString("Error reading file %1: invalid Tonatiuh++ scene root.").arg(fileName));
+bool SceneLoader::readFileCached(const QString& fileName, const QByteArray& typesKey, LoadedScene* scene, QString* errorMessage, bool* hit)
+{
+    if (hit)
+        *hit = false;
+    if (scene)
+        scene->reset();
 
-    SoSFString* versionField = dynamic_cast<SoSFString*>(loadedScene->getField("version"));
-    if (!versionField)
-        return failWithSeparator(QString("Error reading file %1: missing Tonatiuh++ project version.").arg(fileName));
+    QFile file(fileName);
+    if (fileName.isEmpty() || !file.open(QIODevice::ReadOnly))
+        return readFile(fileName, scene, errorMessage);
 
-    const QString version = versionField->getValue().getString();
-    if (version != "2020")
-        return failWithSeparator(QString("Version %1 is not compatible.").arg(version));
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(file.readAll());
+    hash.addData(typesKey);
+    hash.addData(QByteArray(SoDB::getVersion()));
+    const QByteArray key = hash.result();
+    file.close();
 
-    if (scene)
-        scene->reset(loadedScene);
+    const QString cacheName = cacheFileName(fileName);
+    if (readCache(cacheName, key, fileName, scene)) {
+        if (hit)
+            *hit = true;
+        return true;
+    }
 
-    separator->removeChild(loadedScene);
-    separator->unref();
+    if (!readFile(fileName, scene, errorMessage))
+        return false;
+    if (scene)
+        writeCache(cacheName, key, scene->get());
     return true;
 }
+
+QString SceneLoader::cacheFileName(const QString& fileName)
+{
+    return fileName + ".cache";
+}
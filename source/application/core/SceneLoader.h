@@ -1,9 +1,39 @@
 #pragma once
 
+#include <atomic>
+
+#include <QByteArray>
 #include <QString>
 
 class TSceneKit;
 
+//! SceneLoadProgress follows a scene read on a worker thread.
+/*!
+ * The reader sets the stage and how much of it is done, and stops soon
+ * after cancel() is called; any thread can poll or cancel.
+ */
+class SceneLoadProgress
+{
+public:
+    enum Stage {
+        Parsing, // bytes of the file, meshes of plugins included
+        Shapes // shapes prepared for the view
+    };
+
+    Stage getStage() const {return m_stage.load();}
+    double getFraction() const;
+    void set(Stage stage, qint64 done, qint64 total);
+
+    void cancel() {m_canceled.store(true);}
+    bool isCanceled() const {return m_canceled.load();}
+
+private:
+    std::atomic<Stage> m_stage{Parsing};
+    std::atomic<qint64> m_done{0};
+    std::atomic<qint64> m_total{0};
+    std::atomic_bool m_canceled{false};
+};
+
 class LoadedScene
 {
 public:
@@ -24,5 +54,12 @@ private:
 class SceneLoader
 {
 public:
-    static bool readFile(const QString& fileName, LoadedScene* scene, QString* errorMessage = nullptr);
+    static bool readFile(const QString& fileName, LoadedScene* scene, QString* errorMessage = nullptr, SceneLoadProgress* progress = nullptr);
+    // builds the meshes shapes draw, so the first frame does not
+    static bool prepareShapes(TSceneKit* scene, SceneLoadProgress* progress = nullptr, QString* errorMessage = nullptr);
+
+    // as readFile, through a binary Open Inventor copy in the sidecar cacheFileName,
+    // used while the scene bytes and typesKey are those it was written for
+    static bool readFileCached(const QString& fileName, const QByteArray& typesKey, LoadedScene* scene, QString* errorMessage = nullptr, bool* hit = nullptr);
+    static QString cacheFileName(const QString& fileName);
 };
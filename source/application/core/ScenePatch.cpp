@@ -0,0 +1,173 @@
+#include "ScenePatch.h"
+
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QStringList>
+
+#include <Inventor/fields/SoField.h>
+
+#include "core/SceneEditor.h"
+
+namespace
+{
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+
+// the text of a field value, false for objects and null
+bool fieldText(const QJsonValue& value, QString* text)
+{
+    if (value.isBool()) {
+        *text = value.toBool() ? QStringLiteral("TRUE") : QStringLiteral("FALSE");
+        return true;
+    }
+    if (value.isDouble()) {
+        *text = QString::number(value.toDouble(), 'g', 17);
+        return true;
+    }
+    if (value.isString()) {
+        *text = value.toString();
+        return true;
+    }
+    if (!value.isArray())
+        return false;
+    QStringList items;
+    for (const QJsonValue& item : value.toArray()) {
+        QString itemText;
+        if (item.isArray() || !fieldText(item, &itemText))
+            return false;
+        items << itemText;
+    }
+    *text = items.join(' ');
+    return true;
+}
+
+}
+
+bool ScenePatch::fromJson(const QJsonValue& value, QString* errorMessage)
+{
+    if (!value.isArray())
+        return fail(errorMessage, "patch must be an array of edits.");
+
+    std::vector<Edit> edits;
+    const QJsonArray items = value.toArray();
+    for (int n = 0; n < items.size(); ++n) {
+        const QString name = QString("patch[%1]").arg(n);
+        const QJsonObject item = items[n].toObject();
+        const QString field = item.value("field").toString();
+        if (!items[n].isObject() || field.isEmpty())
+            return fail(errorMessage, QString("%1 must be an object with a field name.").arg(name));
+
+        if (item.contains("node")) {
+            const QString url = item.value("node").toString();
+            QString text;
+            if (url.isEmpty() || !fieldText(item.value("value"), &text))
+                return fail(errorMessage, QString("%1 must give a node URL and a value.").arg(name));
+            edits.push_back(Edit{url, field, text});
+            continue;
+        }
+
+        const QJsonArray urls = item.value("nodes").toArray();
+        const QJsonArray values = item.value("values").toArray();
+        if (urls.isEmpty() || (values.size() != 1 && values.size() != urls.size()))
+            return fail(errorMessage, QString("%1 must give nodes and one value for all or one per node.").arg(name));
+        for (int k = 0; k < urls.size(); ++k) {
+            const QString url = urls[k].toString();
+            QString text;
+            if (url.isEmpty() || !fieldText(values[values.size() == 1 ? 0 : k], &text))
+                return fail(errorMessage, QString("%1 has a wrong node URL or value at %2.").arg(name).arg(k));
+            edits.push_back(Edit{url, field, text});
+        }
+    }
+    if (m_scene)
+        undo();
+    m_edits.swap(edits);
+    return true;
+}
+
+void ScenePatch::addEdit(const QString& url, const QString& field, const QString& value)
+{
+    m_edits.push_back(Edit{url, field, value});
+}
+
+QByteArray ScenePatch::getKey() const
+{
+    if (m_edits.empty())
+        return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (const Edit& edit : m_edits)
+        for (const QString* text : {&edit.url, &edit.field, &edit.value}) {
+            hash.addData(text->toUtf8());
+            hash.addData(QByteArrayView("", 1)); // the texts cannot run together
+        }
+    return hash.result();
+}
+
+bool ScenePatch::apply(TSceneKit* scene, QString* errorMessage)
+{
+    if (m_scene)
+        undo();
+
+    std::vector<SoField*> fields;
+    fields.reserve(m_edits.size());
+    for (const Edit& edit : m_edits) {
+        SoField* field = SceneEditor::findField(scene, edit.url, edit.field, errorMessage);
+        if (!field)
+            return false;
+        fields.push_back(field);
+    }
+
+    // set silently, the old values kept to undo a wrong value and the patch
+    std::vector<std::pair<SoField*, SbString>> olds(fields.size());
+    std::vector<SbBool> notifies(fields.size());
+    for (size_t n = 0; n < fields.size(); ++n) {
+        olds[n].first = fields[n];
+        fields[n]->get(olds[n].second);
+        notifies[n] = fields[n]->isNotifyEnabled();
+        fields[n]->enableNotify(FALSE);
+    }
+    size_t done = 0;
+    for (; done < fields.size(); ++done)
+        if (!SceneEditor::setField(fields[done], m_edits[done].value))
+            break;
+    const bool ok = done == fields.size();
+    if (!ok)
+        for (size_t n = done; n-- > 0;)
+            fields[n]->set(olds[n].second.getString());
+    for (size_t n = fields.size(); n-- > 0;)
+        fields[n]->enableNotify(notifies[n]);
+    if (!ok)
+        return fail(errorMessage, QString("\"%1\" is not a value of %2 of %3.")
+            .arg(m_edits[done].value, m_edits[done].field, m_edits[done].url));
+
+    for (SoField* field : fields)
+        field->touch();
+    SceneEditor::followEdits(scene);
+    m_scene = scene;
+    m_undo.swap(olds);
+    return true;
+}
+
+// the values restored silently, then each field notifies once
+void ScenePatch::undo()
+{
+    if (!m_scene)
+        return;
+    for (auto it = m_undo.rbegin(); it != m_undo.rend(); ++it) {
+        const SbBool notify = it->first->isNotifyEnabled();
+        it->first->enableNotify(FALSE);
+        it->first->set(it->second.getString());
+        it->first->enableNotify(notify);
+    }
+    for (const auto& old : m_undo)
+        old.first->touch();
+    SceneEditor::followEdits(m_scene);
+    m_scene = nullptr;
+    m_undo.clear();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+#include <Inventor/SbString.h>
+
+class QJsonValue;
+class SoField;
+class TSceneKit;
+
+//! ScenePatch is a list of field edits that turns a loaded base scene into a design candidate.
+/*!
+ * An edit names a node by its URL, as InstanceNode::getURL gives it, a field
+ * as SceneEditor finds it, and the new value as text of the scene file, so
+ * a worker holding the base scene gets a candidate as a few edits instead of
+ * a scene file. In JSON a patch is an array of
+ *   {"node": url, "field": name, "value": value} or
+ *   {"nodes": [url, ...], "field": name, "values": [value, ...]},
+ * the second with one value per node or one for all. Values are strings,
+ * numbers, booleans or arrays of them, the items of arrays separated by
+ * spaces as in the scene file.
+ *
+ * apply() sets the fields without notifying, keeping their values; if any
+ * edit fails none is changed. Each field then notifies once and the edits
+ * are followed as SceneEditor::followEdits does, so the node sensors and
+ * trackers update the scene as after any edit, and the next trace builds its
+ * instances and BVH from it. undo() restores the values the same way.
+ */
+class ScenePatch
+{
+public:
+    struct Edit
+    {
+        QString url;
+        QString field;
+        QString value;
+    };
+
+    bool fromJson(const QJsonValue& value, QString* errorMessage = nullptr);
+    void addEdit(const QString& url, const QString& field, const QString& value);
+    bool isEmpty() const {return m_edits.empty();}
+    int getEditCount() const {return int(m_edits.size());}
+    const Edit& getEdit(int n) const {return m_edits[n];}
+    // SHA-256 of the edits in order, empty for none
+    QByteArray getKey() const;
+
+    bool apply(TSceneKit* scene, QString* errorMessage = nullptr);
+    bool isApplied() const {return m_scene != nullptr;}
+    void undo();
+
+private:
+    std::vector<Edit> m_edits;
+    // while applied
+    TSceneKit* m_scene = nullptr;
+    std::vector<std::pair<SoField*, SbString>> m_undo;
+};
@@ -0,0 +1,125 @@
+#include "SceneStatistics.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <QElapsedTimer>
+
+#include "core/RayTraceRunner.h"
+#include "core/SceneInstanceBuilder.h"
+#include "kernel/run/InstanceNode.h"
+#include "kernel/run/SceneBVH.h"
+#include "kernel/scene/TSceneKit.h"
+#include "kernel/shape/ShapeRT.h"
+#include "kernel/sun/SunAperture.h"
+#include "kernel/sun/SunKit.h"
+#include "libraries/math/3D/Transform.h"
+
+namespace
+{
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+
+// the nodes below instance and the bytes they hold
+void countInstances(const InstanceNode* instance, int* nodes, qulonglong* bytes)
+{
+    ++*nodes;
+    *bytes += sizeof(InstanceNode) + qulonglong(instance->children.capacity())*sizeof(InstanceNode*);
+    for (const InstanceNode* child : instance->children)
+        countInstances(child, nodes, bytes);
+}
+
+}
+
+double SceneStatistics::getLitCellFraction(bool profiles) const
+{
+    const double cells = double(sunWidthDivisions)*sunHeightDivisions;
+    return cells > 0. ? (profiles ? litCellsProfiles : litCells)/cells : 0.;
+}
+
+bool SceneStatistics::find(TSceneKit* scene, SceneStatistics* statistics, QString* errorMessage)
+{
+    if (!scene)
+        return fail(errorMessage, "Scene is not loaded.");
+    SunKit* sunKit = static_cast<SunKit*>(scene->getPart("world.sun", false));
+    if (!sunKit)
+        return fail(errorMessage, "Scene has no sun.");
+
+    SceneInstanceTree instanceTree = SceneInstanceBuilder::build(scene);
+    InstanceNode* instanceLayout = instanceTree.layoutRoot;
+    if (!instanceLayout)
+        return fail(errorMessage, "Scene has no layout.");
+    instanceLayout->updateTree(Transform::Identity);
+
+    SceneStatistics ans;
+    countInstances(instanceTree.sceneRoot, &ans.instanceNodes, &ans.instanceTreeBytes);
+
+    QElapsedTimer timer;
+    timer.start();
+    SceneBVH sceneBVH(instanceLayout);
+    ans.sceneBVHSeconds = timer.nsecsElapsed()/1e9;
+    ans.sceneBVHBytes = sceneBVH.getMemoryUsage();
+    ans.sceneBVH = BVHStatistics::find(sceneBVH.getNodes());
+    for (const SceneBVHPrototype& prototype : sceneBVH.getPrototypes()) {
+        const BVHStatistics s = BVHStatistics::find(prototype.nodes);
+        ans.prototypeBVH.nodes += s.nodes;
+        ans.prototypeBVH.leaves += s.leaves;
+        ans.prototypeBVH.primitives += s.primitives;
+        ans.prototypeBVH.depth = std::max(ans.prototypeBVH.depth, s.depth);
+        ans.prototypeBVH.sahCost += s.sahCost;
+        ans.prototypeBVH.bytes += s.bytes;
+    }
+    ans.topLevelLeaves = sceneBVH.instanceCount();
+    ans.prototypes = int(sceneBVH.getPrototypes().size());
+    ans.geometries = int(sceneBVH.getShapes().size());
+    ans.materials = int(sceneBVH.getMaterials().size());
+
+    // distinct shapes by class, with the leaves using them
+    std::map<QString, SceneShapeStatistics> shapes;
+    std::set<const ShapeRT*> counted;
+    const std::vector<SceneBVHInstance> leaves = sceneBVH.findLeaves();
+    ans.leaves = int(leaves.size());
+    for (const SceneBVHInstance& leaf : leaves) {
+        SceneShapeStatistics& s = shapes[QString::fromLatin1(leaf.shape->getTypeName())];
+        s.instances++;
+        if (!counted.insert(leaf.shape).second)
+            continue;
+        s.geometries++;
+        s.triangles += leaf.shape->getTriangleCount();
+        s.bytes += leaf.shape->getMemoryUsage();
+    }
+    for (std::pair<const QString, SceneShapeStatistics>& s : shapes) {
+        s.second.shape = s.first;
+        ans.triangles += s.second.triangles;
+        ans.geometryBytes += s.second.bytes;
+        ans.shapes.push_back(s.second);
+    }
+    std::stable_sort(ans.shapes.begin(), ans.shapes.end(), [](const SceneShapeStatistics& a, const SceneShapeStatistics& b) {
+        return a.triangles > b.triangles;
+    });
+
+    SunAperture* sunAperture = static_cast<SunAperture*>(sunKit->getPart("aperture", false));
+    if (!sunAperture)
+        return fail(errorMessage, "Scene sun is missing position, shape, or aperture data.");
+    sunKit->setBox(instanceLayout->getBox());
+    const RayTraceOptions defaults;
+    ans.sunWidthDivisions = defaults.sunWidthDivisions;
+    ans.sunHeightDivisions = defaults.sunHeightDivisions;
+    if (!sunKit->findTexture(ans.sunWidthDivisions, ans.sunHeightDivisions, instanceLayout, true))
+        return fail(errorMessage, "There are no surfaces defined for ray tracing.");
+    ans.litCellsProfiles = int(sunAperture->getCells().size());
+    // the boxes last, as traced by default
+    sunKit->findTexture(ans.sunWidthDivisions, ans.sunHeightDivisions, instanceLayout, false);
+    ans.litCells = int(sunAperture->getCells().size());
+    ans.sunApertureArea = sunAperture->getArea();
+    ans.sunApertureBytes = qulonglong(sunAperture->getCells().capacity())*sizeof(QPair<int, int>);
+
+    *statistics = ans;
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include <QString>
+#include <qglobal.h>
+
+#include "kernel/shape/BVH.h"
+
+class TSceneKit;
+
+//! SceneShapeStatistics counts the distinct shapes of one shape class.
+struct SceneShapeStatistics
+{
+    QString shape; // type name, as in trace statistics
+    int geometries = 0;
+    int instances = 0; // traced leaves using them
+    qulonglong triangles = 0;
+    qulonglong bytes = 0;
+};
+
+//! SceneStatistics describes what a scene costs to trace and to hold in memory.
+/*!
+ * The scene is compiled as RayTraceRunner does: the instance tree is built
+ * and updated, the SceneBVH compiled and the sun aperture cells found with
+ * the default sun grid, once from the bounding boxes of the surfaces and
+ * once from their profiles.
+ *
+ * Memory is estimated from the arrays held by each subsystem: the instance
+ * tree, the compiled hierarchy with its leaves and batches, the ray tracing
+ * data of the distinct shapes, and the aperture cells. Buffers of the Coin
+ * scene graph and of the workers are not counted.
+ */
+struct SceneStatistics
+{
+    int instanceNodes = 0; // of the instance tree
+    int leaves = 0;        // traced shape leaves, shared subtrees expanded
+    int topLevelLeaves = 0;
+    int prototypes = 0;    // shared subtrees compiled once
+    int geometries = 0;    // distinct shapes
+    int materials = 0;
+    qulonglong triangles = 0;
+    std::vector<SceneShapeStatistics> shapes; // by class, most triangles first
+
+    BVHStatistics sceneBVH; // top level
+    BVHStatistics prototypeBVH; // all prototypes, depth the deepest
+    double sceneBVHSeconds = 0.;
+
+    int sunWidthDivisions = 0;
+    int sunHeightDivisions = 0;
+    int litCells = 0;
+    int litCellsProfiles = 0;
+    double sunApertureArea = 0.; // of the box cells
+
+    qulonglong instanceTreeBytes = 0;
+    qulonglong sceneBVHBytes = 0;
+    qulonglong geometryBytes = 0;
+    qulonglong sunApertureBytes = 0;
+
+    double getLitCellFraction(bool profiles) const;
+    qulonglong getTotalBytes() const {return instanceTreeBytes + sceneBVHBytes + geometryBytes + sunApertureBytes;}
+
+    static bool find(TSceneKit* scene, SceneStatistics* statistics, QString* errorMessage = nullptr);
+};
@@ -0,0 +1,151 @@
+#include "TraceResultCache.h"
+
+#include <cstdlib>
+
+#include <Inventor/SoOutput.h>
+#include <Inventor/actions/SoWriteAction.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include "kernel/scene/TSceneKit.h"
+#include "libraries/auxiliary/S3Upload.h"
+
+namespace
+{
+// changes with the layout of entries and with anything else a result depends on beyond the key
+const QByteArray CacheVersion = "tonatiuhpp-trace-result-cache-1";
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage)
+        *errorMessage = message;
+    return false;
+}
+
+void* reallocBuffer(void* buffer, size_t size)
+{
+    return std::realloc(buffer, size);
+}
+
+// binary, so field values count to the bit
+void addScene(QCryptographicHash* hash, TSceneKit* scene)
+{
+    if (!scene) return;
+
+    SoOutput output;
+    output.setBinary(TRUE);
+    size_t size = 1 << 16;
+    output.setBuffer(std::malloc(size), size, reallocBuffer);
+    SoWriteAction action(&output);
+    action.apply(scene);
+
+    void* buffer = nullptr;
+    output.getBuffer(buffer, size);
+    hash->addData(QByteArrayView(static_cast<const char*>(buffer), qsizetype(size)));
+    std::free(buffer);
+}
+
+// each part with its size ahead, so no two lists of parts hash alike
+void addPart(QCryptographicHash* hash, const QByteArray& part)
+{
+    hash->addData(QByteArray::number(part.size()) + ':');
+    hash->addData(part);
+}
+
+// files uploaded to object storage are not kept, so such traces always run
+bool hasUpload(const QStringList& fileNames)
+{
+    for (const QString& fileName : fileNames)
+        if (S3Upload::isUrl(fileName))
+            return true;
+    return false;
+}
+
+bool copyFile(const QString& sourceName, const QString& targetName, QString* errorMessage)
+{
+    QFile source(sourceName);
+    if (!source.open(QIODevice::ReadOnly))
+        return fail(errorMessage, QString("Cannot open %1: %2").arg(sourceName, source.errorString()));
+    QSaveFile target(targetName);
+    if (!target.open(QIODevice::WriteOnly))
+        return fail(errorMessage, QString("Cannot open %1: %2").arg(targetName, target.errorString()));
+
+    QByteArray block;
+    while (!(block = source.read(1 << 20)).isEmpty())
+        if (target.write(block) != block.size())
+            return fail(errorMessage, QString("Cannot write %1: %2").arg(targetName, target.errorString()));
+    if (source.error() != QFileDevice::NoError)
+        return fail(errorMessage, QString("Cannot read %1: %2").arg(sourceName, source.errorString()));
+    if (!target.commit())
+        return fail(errorMessage, QString("Cannot write %1: %2").arg(targetName, target.errorString()));
+    return true;
+}
+} // namespace
+
+TraceResultCache::TraceResultCache(const QString& directory):
+    m_directory(directory)
+{
+}
+
+QString TraceResultCache::key(const QString& command, TSceneKit* scene, const QByteArray& typesKey, const QByteArray& options)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    addPart(&hash, CacheVersion);
+    addPart(&hash, command.toUtf8());
+    addPart(&hash, typesKey);
+    addPart(&hash, options);
+    addScene(&hash, scene);
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool TraceResultCache::restore(const QString& key, const QStringList& fileNames, QJsonObject* result) const
+{
+    if (hasUpload(fileNames)) return false;
+
+    const QDir dir(m_directory);
+    QFile file(dir.filePath(key + ".json"));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const QJsonObject entry = QJsonDocument::fromJson(file.readAll()).object();
+    if (entry.value("schema_version").toInt() != 1 || entry.value("key").toString() != key) return false;
+    if (entry.value("files").toInt(-1) != fileNames.size() || !entry.value("result").isObject()) return false;
+
+    for (int n = 0; n < fileNames.size(); ++n) {
+        if (!QDir().mkpath(QFileInfo(fileNames[n]).absolutePath())) return false;
+        if (!copyFile(dir.filePath(QString("%1.%2").arg(key).arg(n)), fileNames[n], nullptr)) return false;
+    }
+    *result = entry.value("result").toObject();
+    return true;
+}
+
+bool TraceResultCache::store(const QString& key, const QJsonObject& result, const QStringList& fileNames, QString* errorMessage) const
+{
+    if (hasUpload(fileNames)) return true;
+
+    const QDir dir(m_directory);
+    if (!QDir().mkpath(dir.absolutePath()))
+        return fail(errorMessage, QString("Cannot create directory %1.").arg(dir.absolutePath()));
+
+    for (int n = 0; n < fileNames.size(); ++n)
+        if (!copyFile(fileNames[n], dir.filePath(QString("%1.%2").arg(key).arg(n)), errorMessage))
+            return false;
+
+    QJsonObject entry;
+    entry["schema_version"] = 1;
+    entry["key"] = key;
+    entry["files"] = int(fileNames.size());
+    entry["result"] = result;
+
+    const QString entryName = dir.filePath(key + ".json");
+    QSaveFile file(entryName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(errorMessage, QString("Cannot open %1: %2").arg(entryName, file.errorString()));
+    file.write(QJsonDocument(entry).toJson(QJsonDocument::Indented));
+    if (!file.commit())
+        return fail(errorMessage, QString("Cannot write %1: %2").arg(entryName, file.errorString()));
+    return true;
+}
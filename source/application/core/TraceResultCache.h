@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+class TSceneKit;
+
+//! TraceResultCache keeps the results of traces under a hash of all they depend on.
+/*!
+ * The key hashes the command, the scene as it is written from memory, so
+ * edits made after loading count, the node types of the plugins, as
+ * CorePluginRegistry::typesKey, and the options of the trace as text. Files
+ * a scene refers to by name, such as meshes, count by their name only.
+ *
+ * An entry is <key>.json in the directory, with the result and the number
+ * of files the trace wrote, and a copy <key>.<n> of each file. The copies
+ * are written first and the entry last, each through QSaveFile, so
+ * processes sharing the directory see whole entries only. Traces that
+ * upload files to s3:// URLs are neither stored nor restored.
+ */
+class TraceResultCache
+{
+public:
+    explicit TraceResultCache(const QString& directory);
+
+    static QString key(const QString& command, TSceneKit* scene, const QByteArray& typesKey, const QByteArray& options);
+
+    // the result stored for key, its files copied back to fileNames in
+    // order; false on a miss, also for an entry that cannot be read
+    bool restore(const QString& key, const QStringList& fileNames, QJsonObject* result) const;
+    // the result of a trace and copies of the files fileNames it wrote
+    bool store(const QString& key, const QJsonObject& result, const QStringList& fileNames, QString* errorMessage = nullptr) const;
+
+private:
+    QString m_directory;
+};
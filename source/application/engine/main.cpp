@@ -0,0 +1,17 @@
+#include <QCoreApplication>
+
+#include "core/DistributedRun.h"
+#include "headless/HeadlessCommandRunner.h"
+
+// tonatiuhpp-engine: the headless commands of tonatiuhpp --headless, built
+// without the GUI sources, forms, resources and SoQt, for clusters and containers
+int main(int argc, char** argv)
+{
+    DistributedRun distributed(&argc, &argv);
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("Tonatiuh");
+    app.setApplicationVersion(APP_VERSION);
+
+    HeadlessCommandRunner runner; // --headless is optional and dropped
+    return runner.run(app.arguments());
+}
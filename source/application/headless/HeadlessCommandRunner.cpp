@@ -1,18 +1,39 @@
 #include "HeadlessCommandRunner.h"
 
 #include <limits>
+#include <memory>
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QJsonObject>
+#include <QSysInfo>
 #include <QTextStream>
 #include <QThread>
 
+#include "benchmark/AnnualRunner.h"
 #include "benchmark/BenchmarkRunner.h"
+#include "benchmark/BenchmarkSuite.h"
 #include "core/CorePluginRegistry.h"
+#include "core/PhotonExport.h"
+#include "core/RayTraceCheckpoint.h"
 #include "core/RayTraceRunner.h"
+#include "core/RayTraceShard.h"
 #include "core/SceneLoader.h"
+#include "core/SceneStatistics.h"
 #include "core/TonatiuhCore.h"
+#include "core/TraceResultCache.h"
+#include "headless/HeadlessEvents.h"
+#include "headless/HeadlessHttpService.h"
 #include "headless/HeadlessScriptHost.h"
+#include "headless/HeadlessServer.h"
+#include "kernel/photons/PhotonsBuffer.h"
+#include "kernel/run/CpuTopology.h"
+#include "kernel/run/TraceEvents.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/PagedMesh.h"
+#include "kernel/shape/TriangleMesh.h"
+#include "libraries/math/CpuDispatch.h"
 
 int HeadlessCommandRunner::run(const QStringList& arguments) const
 {
@@ -21,13 +42,72 @@ int HeadlessCommandRunner::run(const QStringList& arguments) const
         args.removeFirst();
 
     args.removeAll("--headless");
+    TShapeKit::setDeferredGL(true); // nothing is rendered
 
+    // meshes viewed in their mapped caches, shared by the processes using them
+    if (args.removeAll("--shared-meshes") > 0)
+        TriangleMesh::setMappedCaches(true);
+
+    // meshes paged from files of clusters, each worker caching up to N MB of them
+    const qsizetype pagedIndex = args.indexOf("--paged-meshes");
+    if (pagedIndex >= 0) {
+        bool ok = false;
+        const qlonglong megabytes = pagedIndex + 1 < args.size() ? args[pagedIndex + 1].toLongLong(&ok) : 0;
+        if (!ok || megabytes <= 0)
+            return printUsageError("--paged-meshes requires a cache size in MB per worker.");
+        args.remove(pagedIndex, 2);
+        PagedMesh::setPagedMeshes(true);
+        PagedMesh::setCacheBytes(qulonglong(megabytes) << 20);
+    }
+
+    // structured records on stdout in place of the text output
+    std::unique_ptr<HeadlessEvents> ndjson;
+    const qsizetype eventsIndex = args.indexOf("--events");
+    if (eventsIndex >= 0) {
+        if (eventsIndex + 1 >= args.size() || args[eventsIndex + 1] != "ndjson")
+            return printUsageError("--events requires the format ndjson.");
+        args.remove(eventsIndex, 2);
+        ndjson.reset(new HeadlessEvents);
+    }
+
+    // the events of the whole command, written when it ends
+    const qsizetype traceEventsIndex = args.indexOf("--trace-events");
+    if (traceEventsIndex >= 0) {
+        if (traceEventsIndex + 1 >= args.size() || args[traceEventsIndex + 1].isEmpty() || args[traceEventsIndex + 1].startsWith("--"))
+            return printUsageError("--trace-events requires a file path.");
+        const QString traceEventsFile = args[traceEventsIndex + 1];
+        args.remove(traceEventsIndex, 2);
+
+        TraceEvents events;
+        events.nameThread("main");
+        TraceEvents::setActive(&events);
+        const int code = runCommand(args, ndjson.get());
+        TraceEvents::setActive(nullptr);
+
+        QTextStream err(stderr);
+        QString errorMessage;
+        if (!events.write(traceEventsFile, &errorMessage)) {
+            err << "Trace events were not written: " << errorMessage << Qt::endl;
+            return code != 0 ? code : 1;
+        }
+        err << "Trace events written: " << QFileInfo(traceEventsFile).absoluteFilePath()
+            << " (" << events.getEventCount() << " events)" << Qt::endl;
+        return code;
+    }
+    return runCommand(args, ndjson.get());
+}
+
+int HeadlessCommandRunner::runCommand(const QStringList& args, HeadlessEvents* events) const
+{
     if (args.isEmpty() || args[0] == "--help" || args[0] == "-h") {
         printUsage();
         return 0;
     }
 
     const QString command = args[0];
+    if (events && command != "trace-scene")
+        return printUsageError("--events ndjson is supported by trace-scene only.");
+
     if (command == "validate-scene") {
         if (args.size() != 2)
             return printUsageError("validate-scene requires exactly one scene file path.");
@@ -35,15 +115,37 @@ int HeadlessCommandRunner::run(const QStringList& arguments) const
         return validateScene(args[1]);
     }
 
+    if (command == "scene-stats") {
+        if (args.size() != 2)
+            return printUsageError("scene-stats requires exactly one scene file path.");
+
+        return sceneStats(args[1]);
+    }
+
     if (command == "trace-scene")
-        return traceScene(args.mid(1));
+        return traceScene(args.mid(1), events);
 
     if (command == "benchmark")
         return benchmark(args.mid(1));
 
+    if (command == "benchmark-suite")
+        return benchmarkSuite(args.mid(1));
+
+    if (command == "merge-results")
+        return mergeResults(args.mid(1));
+
+    if (command == "annual")
+        return annual(args.mid(1));
+
     if (command == "run-script")
         return runScript(args.mid(1));
 
+    if (command == "serve")
+        return serve(args.mid(1));
+
+    if (command == "serve-http")
+        return serveHttp(args.mid(1));
+
     return printUsageError(QString("Unknown headless command: %1.").arg(command));
 }
 
@@ -67,73 +169,530 @@ int HeadlessCommandRunner::validateScene(const QString& fileName) const
     return 0;
 }
 
-int HeadlessCommandRunner::traceScene(const QStringList& args) const
+int HeadlessCommandRunner::sceneStats(const QString& fileName) const
 {
     QTextStream out(stdout);
     QTextStream err(stderr);
 
+    TonatiuhCore::initializeCoin();
+    CorePluginRegistry plugins;
+    initializeSceneServices(fileName, &plugins);
+
+    LoadedScene scene;
+    QString errorMessage;
+    if (!SceneLoader::readFile(fileName, &scene, &errorMessage)) {
+        err << "Scene load failed: " << errorMessage << Qt::endl;
+        return 1;
+    }
+
+    SceneStatistics statistics;
+    if (!SceneStatistics::find(scene.get(), &statistics, &errorMessage)) {
+        err << "Scene statistics failed: " << errorMessage << Qt::endl;
+        return 1;
+    }
+
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(6);
+    out << "scene_file: " << QFileInfo(fileName).absoluteFilePath() << Qt::endl;
+    out << "instance_nodes: " << statistics.instanceNodes << Qt::endl;
+    out << "shape_instances: " << statistics.leaves << Qt::endl;
+    out << "top_level_leaves: " << statistics.topLevelLeaves << Qt::endl;
+    out << "shared_subtrees: " << statistics.prototypes << Qt::endl;
+    out << "unique_geometries: " << statistics.geometries << Qt::endl;
+    out << "unique_materials: " << statistics.materials << Qt::endl;
+    out << "triangles: " << statistics.triangles << Qt::endl;
+    for (const SceneShapeStatistics& shape : statistics.shapes)
+        out << "shape " << shape.shape << ": geometries " << shape.geometries << ", instances " << shape.instances
+            << ", triangles " << shape.triangles << ", bytes " << shape.bytes << Qt::endl;
+    out << "bvh_nodes: " << statistics.sceneBVH.nodes << Qt::endl;
+    out << "bvh_leaves: " << statistics.sceneBVH.leaves << Qt::endl;
+    out << "bvh_depth: " << statistics.sceneBVH.depth << Qt::endl;
+    out << "bvh_sah_cost: " << statistics.sceneBVH.sahCost << Qt::endl;
+    out << "bvh_build_seconds: " << statistics.sceneBVHSeconds << Qt::endl;
+    if (statistics.prototypes > 0) {
+        out << "shared_bvh_nodes: " << statistics.prototypeBVH.nodes << Qt::endl;
+        out << "shared_bvh_depth: " << statistics.prototypeBVH.depth << Qt::endl;
+        out << "shared_bvh_sah_cost: " << statistics.prototypeBVH.sahCost << Qt::endl;
+    }
+    out << "sun_divisions: " << statistics.sunWidthDivisions << "x" << statistics.sunHeightDivisions << Qt::endl;
+    out << "sun_lit_cells: " << statistics.litCells << Qt::endl;
+    out << "sun_lit_cell_fraction: " << statistics.getLitCellFraction(false) << Qt::endl;
+    out << "sun_lit_cells_profiles: " << statistics.litCellsProfiles << Qt::endl;
+    out << "sun_lit_cell_fraction_profiles: " << statistics.getLitCellFraction(true) << Qt::endl;
+    out << "sun_aperture_area: " << statistics.sunApertureArea << Qt::endl;
+    out << "memory_instance_tree_bytes: " << statistics.instanceTreeBytes << Qt::endl;
+    out << "memory_scene_bvh_bytes: " << statistics.sceneBVHBytes << Qt::endl;
+    out << "memory_geometry_bytes: " << statistics.geometryBytes << Qt::endl;
+    out << "memory_sun_aperture_bytes: " << statistics.sunApertureBytes << Qt::endl;
+    out << "memory_total_bytes: " << statistics.getTotalBytes() << Qt::endl;
+    out << "simd_path: " << CpuDispatch::name() << Qt::endl;
+    return 0;
+}
+
+int HeadlessCommandRunner::traceScene(const QStringList& args, HeadlessEvents* events) const
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    // the events take stdout, the text is dropped
+    QString discarded;
+    if (events)
+        out.setString(&discarded);
+
     TraceSceneArguments parsed;
     QString errorMessage;
     if (!parseTraceSceneArguments(args, &parsed, &errorMessage))
         return printUsageError(errorMessage);
 
+    const QString sceneFilePath = QFileInfo(parsed.sceneFileName).absoluteFilePath();
+    auto failed = [&](const QString& message) {
+        err << message << Qt::endl;
+        if (events) {
+            QJsonObject record;
+            record.insert("message", message);
+            events->post("error", record);
+            events->flush();
+        }
+        return 1;
+    };
+    if (events) {
+        QJsonObject record;
+        record.insert("command", "trace-scene");
+        record.insert("scene_file", sceneFilePath);
+        record.insert("rays", double(parsed.rays));
+        record.insert("seed", double(parsed.seed));
+        events->post("start", record);
+        events->beginPhase("load");
+    }
+
     TonatiuhCore::initializeCoin();
     CorePluginRegistry plugins;
     initializeSceneServices(parsed.sceneFileName, &plugins);
 
     LoadedScene scene;
-    if (!SceneLoader::readFile(parsed.sceneFileName, &scene, &errorMessage)) {
-        err << "Scene load failed: " << errorMessage << Qt::endl;
-        return 1;
-    }
+    bool cacheHit = false;
+    if (parsed.sceneCache ?
+            !SceneLoader::readFileCached(parsed.sceneFileName, plugins.typesKey(), &scene, &errorMessage, &cacheHit) :
+            !SceneLoader::readFile(parsed.sceneFileName, &scene, &errorMessage))
+        return failed("Scene load failed: " + errorMessage);
+    if (events)
+        events->endPhase();
 
-    const QString sceneFilePath = QFileInfo(parsed.sceneFileName).absoluteFilePath();
     out << "Tracing scene: " << sceneFilePath << Qt::endl;
     out << "scene_file: " << sceneFilePath << Qt::endl;
     out << "rays: " << parsed.rays << Qt::endl;
     out << "seed: " << parsed.seed << Qt::endl;
-    out << "photon_export: false" << Qt::endl;
-    out << "export_path: none" << Qt::endl;
+    out << "photon_export: " << (parsed.noExport ? "false" : "true") << Qt::endl;
+    out << "export_path: " << (parsed.noExport ? QString("none") : parsed.exportParameters.value("ExportDirectory", "none")) << Qt::endl;
+    if (!parsed.noExport)
+        out << "photon_exporter: " << parsed.exporter << Qt::endl;
+    if (!parsed.checkpointFile.isEmpty())
+        out << "checkpoint_file: " << QFileInfo(parsed.checkpointFile).absoluteFilePath() << Qt::endl;
+    if (parsed.sceneCache)
+        out << "scene_cache: " << (cacheHit ? "hit" : "miss") << Qt::endl;
+    if (parsed.hasShard)
+        out << "shard: " << parsed.shard << "/" << parsed.shards << Qt::endl;
 
     RayTraceOptions options;
     options.rays = parsed.rays;
     options.seed = parsed.seed;
-    options.workerCount = qMax(1, QThread::idealThreadCount());
+    options.workerCount = CpuTopology::countProcessors();
     options.chunkSize = 10000;
+    options.checkpointFile = parsed.checkpointFile;
+    options.checkpointInterval = parsed.checkpointInterval;
+    options.resume = parsed.resume;
+    if (!parsed.checkpointFile.isEmpty())
+        options.checkpointTag = RayTraceCheckpoint::sceneTag(parsed.sceneFileName);
+    options.shardIndex = parsed.shard;
+    options.shardCount = parsed.shards;
+
+    // a trace of the same scene and options gives the summary and record it stored, timings too
+    QString resultKey;
+    if (!parsed.resultCache.isEmpty()) {
+        const QString resultOptions = QString("rays=%1 seed=%2 chunk=%3 statistics=%4")
+            .arg(options.rays).arg(options.seed).arg(options.chunkSize).arg(int(TraceStatistics::isEnabled()));
+        resultKey = TraceResultCache::key("trace-scene", scene.get(), plugins.typesKey(), resultOptions.toUtf8());
+        QJsonObject entry;
+        if (TraceResultCache(parsed.resultCache).restore(resultKey, QStringList(), &entry)) {
+            out << entry.value("output").toString();
+            out << "result_cache: hit" << Qt::endl;
+            if (events) {
+                QJsonObject record = entry.value("record").toObject();
+                record.remove("scene_cache");
+                if (parsed.sceneCache)
+                    record.insert("scene_cache", cacheHit ? "hit" : "miss");
+                record.insert("result_cache", "hit");
+                events->post("result", record);
+                events->flush();
+            }
+            return 0;
+        }
+    }
+
+    PhotonExport photonExport;
+    if (!parsed.noExport) {
+        QStringList exporters;
+        PhotonsFactory* factory = plugins.loadPhotonsFactory(TonatiuhCore::pluginSearchPaths(QCoreApplication::applicationDirPath()), parsed.exporter, &exporters);
+        if (!factory)
+            return failed(QString("Photon exporter %1 was not found; available: %2.").arg(parsed.exporter, exporters.join(", ")));
+        PhotonExportOptions exportOptions;
+        exportOptions.parameters = parsed.exportParameters;
+        exportOptions.surfaceUrls = parsed.exportSurfaces;
+        exportOptions.writerQueue = parsed.exportQueue;
+        exportOptions.samplePaths = parsed.exportSample;
+        exportOptions.sampleStratified = parsed.exportSampleStratified;
+        exportOptions.sampleSeed = parsed.seed;
+        if (!photonExport.open(factory, exportOptions, &errorMessage))
+            return failed("Photon export failed: " + errorMessage);
+        photonExport.apply(&options);
+    }
 
     RayTraceResult result;
     RayTraceRunner runner;
-    if (!runner.trace(scene.get(), options, &result, &errorMessage, [&out](const QString& message) {
-            out << message << Qt::endl;
-        })) {
-        err << "Trace failed: " << errorMessage << Qt::endl;
+    RayTraceRunner::ProgressCallback progress = [&out](const QString& message) {
+        out << message << Qt::endl;
+    };
+    if (events) {
+        progress = events->progressCallback();
+        events->startProgress(&runner);
+    }
+    const bool traced = runner.trace(scene.get(), options, &result, &errorMessage, progress);
+    if (events) {
+        events->stopProgress();
+        events->endPhase();
+    }
+    if (!traced)
+        return failed("Trace failed: " + errorMessage);
+    if (result.exportFailed)
+        return failed("Photon export failed: some photons were not written. Check the output directory.");
+
+    // the text a cached result prints again
+    QString summary;
+    QTextStream text(&summary);
+    text.setRealNumberNotation(QTextStream::FixedNotation);
+    text.setRealNumberPrecision(6);
+    text << "Trace completed." << Qt::endl;
+    text << "rays_traced: " << result.raysTraced << Qt::endl;
+    text << "elapsed_seconds: " << result.elapsedSeconds << Qt::endl;
+    text << "rays_per_second: " << result.raysPerSecond << Qt::endl;
+    text << "worker_count: " << result.workerCount << Qt::endl;
+    text << "chunk_count: " << result.chunkCount << Qt::endl;
+    text << "chunk_size: " << result.chunkSize << Qt::endl;
+    if (TraceStatistics::isEnabled()) {
+        const TraceStatistics& statistics = result.statistics;
+        text << "statistics_rays: " << statistics.rays << Qt::endl;
+        text << "statistics_bounces: " << statistics.bounces << Qt::endl;
+        text << "statistics_bounces_per_ray: " << (statistics.rays > 0 ? double(statistics.bounces) / statistics.rays : 0.) << Qt::endl;
+        text << "statistics_hits: " << statistics.hits << Qt::endl;
+        text << "statistics_sun_misses: " << statistics.sunMisses << Qt::endl;
+        text << "statistics_box_tests: " << statistics.boxTests << Qt::endl;
+        text << "statistics_instance_switches: " << statistics.instanceSwitches << Qt::endl;
+        for (const TraceStatistics::ShapeTests& shape : statistics.getShapeTests())
+            text << "statistics_shape_tests " << shape.shape << ": " << shape.count << Qt::endl;
+    }
+    if (parsed.exportSample > 0) {
+        const PhotonsBuffer* buffer = photonExport.getBuffer();
+        qulonglong paths = 0;
+        qulonglong kept = 0;
+        for (const PhotonsSampleStratum& stratum : buffer->getSampleStrata()) {
+            paths += stratum.paths;
+            kept += stratum.kept;
+        }
+        text << "photon_sample_paths: " << paths << Qt::endl;
+        text << "photon_sample_kept: " << kept << Qt::endl;
+        for (const PhotonsSampleStratum& stratum : buffer->getSampleStrata()) {
+            if (parsed.exportSampleStratified)
+                text << "photon_sample_stratum " << (stratum.surface.isEmpty() ? QString("air") : stratum.surface) << ": paths "
+                    << stratum.paths << ", kept " << stratum.kept << ", weight " << stratum.weight << Qt::endl;
+            else
+                text << "photon_sample_weight: " << stratum.weight << Qt::endl;
+        }
+    }
+    if (!parsed.checkpointFile.isEmpty()) {
+        text << "resumed_chunks: " << result.chunksResumed << Qt::endl;
+        text << "resumed_rays: " << result.raysResumed << Qt::endl;
+        text << "checkpoints_written: " << result.checkpointsWritten << Qt::endl;
+    }
+    text.flush();
+    out << summary;
+    if (parsed.hasShard) {
+        RayTraceShard partial;
+        partial.command = "trace-scene";
+        partial.source = sceneFilePath;
+        partial.key = QString("rays=%1 seed=%2 chunk=%3 scene=%4").arg(parsed.rays).arg(parsed.seed).arg(result.chunkSize)
+            .arg(RayTraceCheckpoint::sceneTag(parsed.sceneFileName));
+        partial.shard = parsed.shard;
+        partial.shards = parsed.shards;
+        partial.firstChunk = result.firstChunk;
+        partial.endChunk = result.endChunk;
+        partial.chunkCount = result.chunkCount;
+        partial.chunkSize = result.chunkSize;
+        partial.workerCount = result.workerCount;
+        partial.dispatchCount = result.dispatchCount;
+        partial.numaNodes = result.numaNodes;
+        partial.memoryLocked = result.memoryLocked;
+        partial.statistics = result.statistics;
+        RayTraceShard::Trace trace;
+        trace.raysTraced = result.raysTraced;
+        trace.elapsedSeconds = result.elapsedSeconds;
+        trace.powerPerRay = result.powerPerRay;
+        trace.sunApertureArea = result.sunApertureArea;
+        partial.traces.push_back(trace);
+        if (!partial.write(parsed.partialFile, &errorMessage))
+            return failed("Partial result failed: " + errorMessage);
+        out << "chunks: " << result.firstChunk << " to " << result.endChunk << " of " << result.chunkCount << Qt::endl;
+        out << "partial_file: " << QFileInfo(parsed.partialFile).absoluteFilePath() << Qt::endl;
+    }
+    QJsonObject record;
+    record.insert("rays_traced", double(result.raysTraced));
+    record.insert("elapsed_seconds", result.elapsedSeconds);
+    record.insert("rays_per_second", result.raysPerSecond);
+    record.insert("worker_count", result.workerCount);
+    record.insert("chunk_count", double(result.chunkCount));
+    record.insert("chunk_size", double(result.chunkSize));
+    record.insert("sun_aperture_area", result.sunApertureArea);
+    record.insert("photon_export", !parsed.noExport);
+    if (parsed.sceneCache)
+        record.insert("scene_cache", cacheHit ? "hit" : "miss");
+    if (TraceStatistics::isEnabled()) {
+        const TraceStatistics& statistics = result.statistics;
+        QJsonObject counts;
+        counts.insert("rays", double(statistics.rays));
+        counts.insert("bounces", double(statistics.bounces));
+        counts.insert("hits", double(statistics.hits));
+        counts.insert("sun_misses", double(statistics.sunMisses));
+        counts.insert("box_tests", double(statistics.boxTests));
+        counts.insert("instance_switches", double(statistics.instanceSwitches));
+        record.insert("statistics", counts);
+    }
+    if (!parsed.checkpointFile.isEmpty()) {
+        record.insert("resumed_chunks", double(result.chunksResumed));
+        record.insert("resumed_rays", double(result.raysResumed));
+        record.insert("checkpoints_written", double(result.checkpointsWritten));
+    }
+    if (parsed.hasShard) {
+        record.insert("shard", parsed.shard);
+        record.insert("shards", parsed.shards);
+        record.insert("first_chunk", double(result.firstChunk));
+        record.insert("end_chunk", double(result.endChunk));
+        record.insert("partial_file", QFileInfo(parsed.partialFile).absoluteFilePath());
+    }
+    if (!parsed.resultCache.isEmpty()) {
+        QJsonObject entry;
+        entry["output"] = summary;
+        entry["record"] = record;
+        if (!TraceResultCache(parsed.resultCache).store(resultKey, entry, QStringList(), &errorMessage))
+            return failed("Result cache failed: " + errorMessage);
+        out << "result_cache: miss" << Qt::endl;
+        record.insert("result_cache", "miss");
+    }
+    if (events) {
+        events->post("result", record);
+        events->flush();
+    }
+    return 0;
+}
+
+int HeadlessCommandRunner::benchmark(const QStringList& args) const
+{
+    QTextStream err(stderr);
+
+    if (args.isEmpty() || args[0].startsWith("--"))
+        return printUsageError("benchmark requires exactly one benchmark config JSON file path before options.");
+    bool sceneCache = false;
+    bool hasShard = false;
+    int shard = 0;
+    int shards = 1;
+    QString resultCache;
+    QString errorMessage;
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--scene-cache" && !sceneCache) {
+            sceneCache = true;
+        } else if (args[i] == "--shard" && !hasShard) {
+            if (++i >= args.size())
+                return printUsageError("--shard requires i/N.");
+            if (!parseShardOption(args[i], &shard, &shards, &errorMessage))
+                return printUsageError(errorMessage);
+            hasShard = true;
+        } else if (args[i] == "--result-cache" && resultCache.isEmpty()) {
+            if (++i >= args.size() || args[i].isEmpty() || args[i].startsWith("--"))
+                return printUsageError("--result-cache requires a directory path.");
+            resultCache = args[i];
+        } else {
+            return printUsageError("benchmark accepts only --scene-cache, --shard i/N and --result-cache DIR, once each.");
+        }
+    }
+    if (hasShard && !resultCache.isEmpty())
+        return printUsageError("--result-cache does not support --shard.");
+
+    BenchmarkRunner benchmarkRunner;
+    const QString sceneFileName = benchmarkRunner.sceneFileName(args[0], &errorMessage);
+    if (sceneFileName.isEmpty()) {
+        err << "Benchmark configuration failed: " << errorMessage << Qt::endl;
         return 1;
     }
+    benchmarkRunner.prepareScene(args[0]);
 
+    TonatiuhCore::initializeCoin();
+    CorePluginRegistry plugins;
+    initializeSceneServices(sceneFileName, &plugins);
+
+    LoadedScene scene;
+    if (sceneCache ?
+            !SceneLoader::readFileCached(sceneFileName, plugins.typesKey(), &scene, &errorMessage) :
+            !SceneLoader::readFile(sceneFileName, &scene, &errorMessage)) {
+        err << "Scene load failed: " << errorMessage << Qt::endl;
+        return 1;
+    }
+    if (!resultCache.isEmpty())
+        benchmarkRunner.setResultCache(resultCache, plugins.typesKey());
+
+    const int result = hasShard ?
+        benchmarkRunner.runShard(args[0], scene.get(), shard, shards, &errorMessage) :
+        benchmarkRunner.run(args[0], scene.get(), &errorMessage);
+    if (result != 0)
+        err << "Benchmark failed: " << errorMessage << Qt::endl;
+    return result;
+}
+
+int HeadlessCommandRunner::benchmarkSuite(const QStringList& args) const
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (args.isEmpty() || args[0].startsWith("--"))
+        return printUsageError("benchmark-suite requires exactly one suite JSON file path before options.");
+    bool sceneCache = false;
+    bool updateBaseline = false;
+    QString host;
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--scene-cache" && !sceneCache) {
+            sceneCache = true;
+        } else if (args[i] == "--update-baseline" && !updateBaseline) {
+            updateBaseline = true;
+        } else if (args[i] == "--host" && host.isEmpty()) {
+            if (++i >= args.size() || args[i].trimmed().isEmpty())
+                return printUsageError("--host requires a name.");
+            host = args[i];
+        } else {
+            return printUsageError("benchmark-suite accepts only --scene-cache, --update-baseline and --host NAME, once each.");
+        }
+    }
+    if (host.isEmpty())
+        host = QSysInfo::machineHostName();
+
+    BenchmarkSuite suite;
+    QString errorMessage;
+    if (!suite.read(args[0], &errorMessage)) {
+        err << "Benchmark suite configuration failed: " << errorMessage << Qt::endl;
+        return 1;
+    }
+
+    // one registry for the plugins of every scene, as serve keeps
+    TonatiuhCore::initializeCoin();
+    CorePluginRegistry plugins;
+    plugins.loadScenePlugins(TonatiuhCore::pluginSearchPaths(QCoreApplication::applicationDirPath()));
+    for (const QString& configFileName : suite.getConfigFileNames()) {
+        BenchmarkRunner benchmarkRunner;
+        const QString sceneFileName = benchmarkRunner.sceneFileName(configFileName, &errorMessage);
+        if (sceneFileName.isEmpty()) {
+            err << "Benchmark configuration failed: " << configFileName << ": " << errorMessage << Qt::endl;
+            return 1;
+        }
+        out << "Running suite benchmark: " << configFileName << Qt::endl;
+        benchmarkRunner.prepareScene(configFileName);
+        plugins.loadScenePluginsFor(sceneFileName);
+        TonatiuhCore::setProjectSearchPaths(sceneFileName);
+
+        QElapsedTimer timer;
+        timer.start();
+        LoadedScene scene;
+        if (sceneCache ?
+                !SceneLoader::readFileCached(sceneFileName, plugins.typesKey(), &scene, &errorMessage) :
+                !SceneLoader::readFile(sceneFileName, &scene, &errorMessage)) {
+            err << "Scene load failed: " << errorMessage << Qt::endl;
+            return 1;
+        }
+        const double loadSeconds = timer.nsecsElapsed()*1e-9;
+
+        // the progress of each benchmark is not printed, its result is kept
+        QString benchmarkOutput;
+        if (benchmarkRunner.run(configFileName, scene.get(), &errorMessage, &benchmarkOutput) != 0 ||
+            !suite.addResult(configFileName, loadSeconds, &errorMessage)) {
+            err << benchmarkOutput;
+            err << "Benchmark failed: " << configFileName << ": " << errorMessage << Qt::endl;
+            return 1;
+        }
+    }
+
+    const int result = suite.finish(host, updateBaseline, &errorMessage);
+    if (result != 0)
+        err << "Benchmark suite failed: " << errorMessage << Qt::endl;
+    return result;
+}
+
+int HeadlessCommandRunner::mergeResults(const QStringList& args) const
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (args.isEmpty())
+        return printUsageError("merge-results requires the partial result file of every shard.");
+
+    std::vector<RayTraceShard> parts(static_cast<size_t>(args.size()));
+    RayTraceShard merged;
+    QString errorMessage;
+    for (int i = 0; i < args.size(); ++i)
+        if (!parts[static_cast<size_t>(i)].read(args[i], &errorMessage)) {
+            err << "Merge failed: " << errorMessage << Qt::endl;
+            return 1;
+        }
+    if (!RayTraceShard::merge(parts, &merged, &errorMessage)) {
+        err << "Merge failed: " << errorMessage << Qt::endl;
+        return 1;
+    }
+
+    if (merged.command == "benchmark") {
+        BenchmarkRunner benchmarkRunner;
+        const int result = benchmarkRunner.merge(merged, &errorMessage);
+        if (result != 0)
+            err << "Merge failed: " << errorMessage << Qt::endl;
+        return result;
+    }
+
+    // the counters trace-scene prints for a single run
+    const RayTraceShard::Trace& trace = merged.traces.front();
     out.setRealNumberNotation(QTextStream::FixedNotation);
     out.setRealNumberPrecision(6);
-    out << "Trace completed." << Qt::endl;
-    out << "rays_traced: " << result.raysTraced << Qt::endl;
-    out << "elapsed_seconds: " << result.elapsedSeconds << Qt::endl;
-    out << "rays_per_second: " << result.raysPerSecond << Qt::endl;
-    out << "worker_count: " << result.workerCount << Qt::endl;
-    out << "chunk_count: " << result.chunkCount << Qt::endl;
-    out << "chunk_size: " << result.chunkSize << Qt::endl;
+    out << "Merged shards of scene: " << merged.source << Qt::endl;
+    out << "shards: " << parts.size() << Qt::endl;
+    out << "rays_traced: " << trace.raysTraced << Qt::endl;
+    out << "elapsed_seconds: " << trace.elapsedSeconds << Qt::endl;
+    out << "rays_per_second: " << (trace.elapsedSeconds > 0. ? double(trace.raysTraced) / trace.elapsedSeconds : 0.) << Qt::endl;
+    out << "worker_count: " << merged.workerCount << Qt::endl;
+    out << "chunk_count: " << merged.chunkCount << Qt::endl;
+    out << "chunk_size: " << merged.chunkSize << Qt::endl;
+    if (TraceStatistics::isEnabled()) {
+        out << "statistics_rays: " << merged.statistics.rays << Qt::endl;
+        out << "statistics_bounces: " << merged.statistics.bounces << Qt::endl;
+        out << "statistics_hits: " << merged.statistics.hits << Qt::endl;
+        out << "statistics_sun_misses: " << merged.statistics.sunMisses << Qt::endl;
+        out << "statistics_box_tests: " << merged.statistics.boxTests << Qt::endl;
+    }
     return 0;
 }
 
-int HeadlessCommandRunner::benchmark(const QStringList& args) const
+int HeadlessCommandRunner::annual(const QStringList& args) const
 {
     QTextStream err(stderr);
 
     if (args.size() != 1)
-        return printUsageError("benchmark requires exactly one benchmark config JSON file path.");
+        return printUsageError("annual requires exactly one annual config JSON file path.");
 
-    BenchmarkRunner benchmarkRunner;
+    AnnualRunner annualRunner;
     QString errorMessage;
-    const QString sceneFileName = benchmarkRunner.sceneFileName(args[0], &errorMessage);
+    const QString sceneFileName = annualRunner.sceneFileName(args[0], &errorMessage);
     if (sceneFileName.isEmpty()) {
-        err << "Benchmark configuration failed: " << errorMessage << Qt::endl;
+        err << "Annual configuration failed: " << errorMessage << Qt::endl;
         return 1;
     }
 
@@ -147,9 +706,9 @@ int HeadlessCommandRunner::benchmark(const QStringList& args) const
         return 1;
     }
 
-    const int result = benchmarkRunner.run(args[0], scene.get(), &errorMessage);
+    const int result = annualRunner.run(args[0], scene.get(), &errorMessage);
     if (result != 0)
-        err << "Benchmark failed: " << errorMessage << Qt::endl;
+        err << "Annual yield failed: " << errorMessage << Qt::endl;
     return result;
 }
 
@@ -162,10 +721,95 @@ int HeadlessCommandRunner::runScript(const QStringList& args) const
     return host.runScript(args[0]);
 }
 
+int HeadlessCommandRunner::serve(const QStringList& args) const
+{
+    ulong cacheSize = 4;
+    QString socketName;
+    for (int i = 0; i < args.size(); ++i) {
+        const QString option = args[i];
+        if (option == "--socket") {
+            if (++i >= args.size() || args[i].isEmpty())
+                return printUsageError("--socket requires a name.");
+            socketName = args[i];
+        } else if (option == "--cache") {
+            if (++i >= args.size())
+                return printUsageError("--cache requires an integer value.");
+            QString errorMessage;
+            if (!parseUnsignedLongOption("--cache", args[i], false, &cacheSize, &errorMessage))
+                return printUsageError(errorMessage);
+        } else {
+            return printUsageError(QString("Unknown serve option: %1.").arg(option));
+        }
+    }
+
+    QTextStream in(stdin);
+    QTextStream out(stdout);
+    HeadlessServer server(static_cast<int>(qMin<ulong>(cacheSize, 1024)));
+    if (!socketName.isEmpty()) {
+        QTextStream err(stderr);
+        return server.listen(socketName, out, err);
+    }
+    return server.run(in, out);
+}
+
+int HeadlessCommandRunner::serveHttp(const QStringList& args) const
+{
+    ulong port = 8650;
+    ulong cacheSize = 4;
+    ulong workers = static_cast<ulong>(qMax(1, QThread::idealThreadCount()));
+    ulong sliceRays = 1000000;
+    QString ringFileName;
+    ulong ringSlots = 8;
+    ulong ringCells = 250000;
+    for (int i = 0; i < args.size(); ++i) {
+        const QString option = args[i];
+        if (option == "--flux-ring") {
+            if (++i >= args.size() || args[i].isEmpty())
+                return printUsageError("--flux-ring requires a file name.");
+            ringFileName = args[i];
+            continue;
+        }
+        ulong* value = option == "--port" ? &port :
+            option == "--cache" ? &cacheSize :
+            option == "--workers" ? &workers :
+            option == "--slice-rays" ? &sliceRays :
+            option == "--ring-slots" ? &ringSlots :
+            option == "--ring-cells" ? &ringCells : nullptr;
+        if (!value)
+            return printUsageError(QString("Unknown serve-http option: %1.").arg(option));
+        if (++i >= args.size())
+            return printUsageError(QString("%1 requires an integer value.").arg(option));
+        QString errorMessage;
+        if (!parseUnsignedLongOption(option, args[i], option == "--port", value, &errorMessage))
+            return printUsageError(errorMessage);
+    }
+    if (port > 65535)
+        return printUsageError("--port must be at most 65535.");
+    if (ringSlots < 1 || ringSlots > 4096 || ringCells < 1 || ringCells > 10000000)
+        return printUsageError("--ring-slots must be from 1 to 4096 and --ring-cells from 1 to 10000000.");
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    HeadlessHttpService service(static_cast<int>(qMin<ulong>(cacheSize, 1024)), static_cast<int>(qMin<ulong>(workers, 4096)), sliceRays);
+    QString errorMessage;
+    if (!ringFileName.isEmpty() && !service.openFluxRing(ringFileName, static_cast<int>(ringSlots), ringCells, &errorMessage)) {
+        err << "Service failed to create the flux ring: " << errorMessage << Qt::endl;
+        return 1;
+    }
+    if (!service.listen(static_cast<quint16>(port), &errorMessage)) {
+        err << "Service failed to listen: " << errorMessage << Qt::endl;
+        return 1;
+    }
+    out << "Listening on http://127.0.0.1:" << service.getPort() << Qt::endl;
+    return service.exec();
+}
+
 void HeadlessCommandRunner::initializeSceneServices(const QString& fileName, CorePluginRegistry* plugins) const
 {
-    if (plugins)
+    if (plugins) {
         plugins->loadScenePlugins(TonatiuhCore::pluginSearchPaths(QCoreApplication::applicationDirPath()));
+        plugins->loadScenePluginsFor(fileName);
+    }
     TonatiuhCore::setProjectSearchPaths(fileName);
 }
 
@@ -212,6 +856,85 @@ bool HeadlessCommandRunner::parseTraceSceneArguments(const QStringList& args, Tr
             if (parsed->noExport)
                 return fail("--no-export was specified more than once.");
             parsed->noExport = true;
+        } else if (option == "--export") {
+            if (!parsed->exporter.isEmpty())
+                return fail("--export was specified more than once.");
+            if (++i >= args.size() || args[i].isEmpty() || args[i].startsWith("--"))
+                return fail("--export requires a photon exporter name.");
+            parsed->exporter = args[i];
+        } else if (option == "--export-parameter") {
+            if (++i >= args.size() || !args[i].contains('='))
+                return fail("--export-parameter requires NAME=VALUE.");
+            const qsizetype equals = args[i].indexOf('=');
+            parsed->exportParameters.insert(args[i].left(equals), args[i].mid(equals + 1));
+        } else if (option == "--export-surface") {
+            if (++i >= args.size() || args[i].isEmpty() || args[i].startsWith("--"))
+                return fail("--export-surface requires a surface URL.");
+            parsed->exportSurfaces << args[i];
+        } else if (option == "--export-queue") {
+            if (parsed->hasExportQueue)
+                return fail("--export-queue was specified more than once.");
+            if (++i >= args.size())
+                return fail("--export-queue requires an integer value.");
+            if (!parseUnsignedLongOption("--export-queue", args[i], true, &parsed->exportQueue, errorMessage))
+                return false;
+            parsed->hasExportQueue = true;
+        } else if (option == "--export-sample") {
+            if (parsed->hasExportSample)
+                return fail("--export-sample was specified more than once.");
+            if (++i >= args.size())
+                return fail("--export-sample requires an integer value.");
+            if (!parseUnsignedLongOption("--export-sample", args[i], false, &parsed->exportSample, errorMessage))
+                return false;
+            parsed->hasExportSample = true;
+        } else if (option == "--export-sample-stratified") {
+            if (parsed->exportSampleStratified)
+                return fail("--export-sample-stratified was specified more than once.");
+            parsed->exportSampleStratified = true;
+        } else if (option == "--checkpoint") {
+            if (!parsed->checkpointFile.isEmpty())
+                return fail("--checkpoint was specified more than once.");
+            if (++i >= args.size() || args[i].isEmpty() || args[i].startsWith("--"))
+                return fail("--checkpoint requires a file path.");
+            parsed->checkpointFile = args[i];
+        } else if (option == "--checkpoint-interval") {
+            if (parsed->hasCheckpointInterval)
+                return fail("--checkpoint-interval was specified more than once.");
+            if (++i >= args.size())
+                return fail("--checkpoint-interval requires a number of seconds.");
+            bool ok = false;
+            parsed->checkpointInterval = args[i].toDouble(&ok);
+            if (!ok || !(parsed->checkpointInterval >= 0.))
+                return fail("--checkpoint-interval requires a non-negative number of seconds.");
+            parsed->hasCheckpointInterval = true;
+        } else if (option == "--resume") {
+            if (parsed->resume)
+                return fail("--resume was specified more than once.");
+            parsed->resume = true;
+        } else if (option == "--scene-cache") {
+            if (parsed->sceneCache)
+                return fail("--scene-cache was specified more than once.");
+            parsed->sceneCache = true;
+        } else if (option == "--result-cache") {
+            if (!parsed->resultCache.isEmpty())
+                return fail("--result-cache was specified more than once.");
+            if (++i >= args.size() || args[i].isEmpty() || args[i].startsWith("--"))
+                return fail("--result-cache requires a directory path.");
+            parsed->resultCache = args[i];
+        } else if (option == "--shard") {
+            if (parsed->hasShard)
+                return fail("--shard was specified more than once.");
+            if (++i >= args.size())
+                return fail("--shard requires i/N.");
+            if (!parseShardOption(args[i], &parsed->shard, &parsed->shards, errorMessage))
+                return false;
+            parsed->hasShard = true;
+        } else if (option == "--partial") {
+            if (!parsed->partialFile.isEmpty())
+                return fail("--partial was specified more than once.");
+            if (++i >= args.size() || args[i].isEmpty() || args[i].startsWith("--"))
+                return fail("--partial requires a file path.");
+            parsed->partialFile = args[i];
         } else {
             return fail(QString("Unknown trace-scene option: %1.").arg(option));
         }
@@ -221,9 +944,42 @@ bool HeadlessCommandRunner::parseTraceSceneArguments(const QStringList& args, Tr
         return fail("trace-scene requires --rays N.");
     if (!parsed->hasSeed)
         return fail("trace-scene requires --seed S.");
-    if (!parsed->noExport)
-        return fail("trace-scene currently requires --no-export.");
+    if (parsed->noExport == !parsed->exporter.isEmpty())
+        return fail("trace-scene requires either --no-export or --export NAME.");
+    if (parsed->exporter.isEmpty() && (!parsed->exportParameters.isEmpty() || !parsed->exportSurfaces.isEmpty() || parsed->hasExportQueue))
+        return fail("--export-parameter, --export-surface and --export-queue require --export NAME.");
+    if (parsed->exporter.isEmpty() && parsed->hasExportSample)
+        return fail("--export-sample requires --export NAME.");
+    if (parsed->exportSampleStratified && !parsed->hasExportSample)
+        return fail("--export-sample-stratified requires --export-sample N.");
+    if (!parsed->exporter.isEmpty() && !parsed->checkpointFile.isEmpty())
+        return fail("--checkpoint does not support photon export.");
+    if (parsed->checkpointFile.isEmpty() && (parsed->resume || parsed->hasCheckpointInterval))
+        return fail("--resume and --checkpoint-interval require --checkpoint FILE.");
+    if (parsed->hasShard == parsed->partialFile.isEmpty())
+        return fail("--shard i/N and --partial FILE require each other.");
+    if (parsed->hasShard && !parsed->noExport)
+        return fail("--shard does not support photon export.");
+    if (!parsed->resultCache.isEmpty() && (!parsed->noExport || !parsed->checkpointFile.isEmpty() || parsed->hasShard))
+        return fail("--result-cache requires --no-export and supports neither --checkpoint nor --shard.");
+
+    return true;
+}
 
+bool HeadlessCommandRunner::parseShardOption(const QString& value, int* shard, int* shards, QString* errorMessage) const
+{
+    const QStringList parts = value.split('/');
+    bool okShard = false;
+    bool okShards = false;
+    const int index = parts.size() == 2 ? parts[0].toInt(&okShard) : 0;
+    const int count = parts.size() == 2 ? parts[1].toInt(&okShards) : 0;
+    if (!okShard || !okShards || count < 1 || index < 0 || index >= count) {
+        if (errorMessage)
+            *errorMessage = "--shard requires i/N with 0 <= i < N.";
+        return false;
+    }
+    *shard = index;
+    *shards = count;
     return true;
 }
 
@@ -262,23 +1018,70 @@ void HeadlessCommandRunner::printUsage() const
     out << "Usage:" << Qt::endl;
     out << "  tonatiuhpp --headless --help" << Qt::endl;
     out << "  tonatiuhpp --headless validate-scene <scene.tnhpp>" << Qt::endl;
-    out << "  tonatiuhpp --headless trace-scene <scene.tnhpp> --rays N --seed S --no-export" << Qt::endl;
-    out << "  tonatiuhpp --headless benchmark <benchmark_config.json>" << Qt::endl;
+    out << "  tonatiuhpp --headless scene-stats <scene.tnhpp>" << Qt::endl;
+    out << "  tonatiuhpp --headless trace-scene <scene.tnhpp> --rays N --seed S --no-export [--checkpoint FILE [--checkpoint-interval S] [--resume]] [--scene-cache] [--shard i/N --partial FILE]" << Qt::endl;
+    out << "  tonatiuhpp --headless trace-scene <scene.tnhpp> --rays N --seed S --export NAME [--export-parameter NAME=VALUE ...] [--export-surface URL ...] [--export-queue N] [--scene-cache]" << Qt::endl;
+    out << "  tonatiuhpp --headless benchmark <benchmark_config.json> [--scene-cache] [--shard i/N]" << Qt::endl;
+    out << "  tonatiuhpp --headless benchmark-suite <suite.json> [--scene-cache] [--update-baseline] [--host NAME]" << Qt::endl;
+    out << "  tonatiuhpp --headless merge-results <partial> ..." << Qt::endl;
+    out << "  tonatiuhpp --headless annual <annual_config.json>" << Qt::endl;
     out << "  tonatiuhpp --headless run-script <script.tnhpps>" << Qt::endl;
+    out << "  tonatiuhpp --headless serve [--cache N] [--socket NAME]" << Qt::endl;
+    out << "  tonatiuhpp --headless serve-http [--port N] [--cache N] [--workers N] [--slice-rays N] [--flux-ring FILE] [--ring-slots N] [--ring-cells N]" << Qt::endl;
+    out << "  tonatiuhpp --headless --trace-events <events.json> <command> ..." << Qt::endl;
+    out << "  tonatiuhpp --headless --events ndjson trace-scene ..." << Qt::endl;
+    out << "  tonatiuhpp --headless --shared-meshes <command> ..." << Qt::endl;
+    out << "  tonatiuhpp --headless --paged-meshes <MB> <command> ..." << Qt::endl;
+    out << "  tonatiuhpp-engine <command> ..." << Qt::endl;
     out << Qt::endl;
     out << "Commands:" << Qt::endl;
     out << "  validate-scene <scene.tnhpp>                         Validate that a Tonatiuh++ scene can be loaded." << Qt::endl;
+    out << "  scene-stats <scene.tnhpp>                            Report instances, geometry, BVH, sun aperture cells and memory of a scene." << Qt::endl;
     out << "  trace-scene <scene.tnhpp> --rays N --seed S --no-export" << Qt::endl;
     out << "                                                     Run ray tracing without photon export." << Qt::endl;
+    out << "    --export NAME                                      Export photons through the exporter plugin NAME, such as File, instead of --no-export." << Qt::endl;
+    out << "    --export-parameter NAME=VALUE                      Set a parameter of the exporter, such as ExportDirectory=out." << Qt::endl;
+    out << "    --export-surface URL                               Export the photons of this surface only; repeat for more." << Qt::endl;
+    out << "    --export-queue N                                   Photon blocks in flight to the writer thread (default 4, 0 writes in the tracers)." << Qt::endl;
+    out << "    --export-sample N                                  Export a weighted sample of N whole ray paths instead of every photon." << Qt::endl;
+    out << "    --export-sample-stratified                         Sample N paths per final surface, each surface with its own weight." << Qt::endl;
+    out << "    --checkpoint FILE                                  Save completed chunks to FILE every interval and at the end." << Qt::endl;
+    out << "    --checkpoint-interval S                            Seconds between checkpoints (default 60)." << Qt::endl;
+    out << "    --resume                                           Skip the chunks saved in FILE, if it exists." << Qt::endl;
+    out << "    --scene-cache                                      Load the scene from its binary copy <scene.tnhpp>.cache, written if stale." << Qt::endl;
+    out << "    --shard i/N --partial FILE                         Trace shard i of N of the chunks only and write its counters to FILE for merge-results." << Qt::endl;
+    out << "    --result-cache DIR                                 Print the stored result of a trace of the same scene and options from DIR, stored if missing." << Qt::endl;
     out << "  benchmark <benchmark_config.json>                  Run a headless benchmark and write JSON results." << Qt::endl;
+    out << "    --scene-cache                                      As for trace-scene." << Qt::endl;
+    out << "    --shard i/N                                        Trace shard i of N of the chunks only and write its raw counts to <output_file>.shard-i-of-N." << Qt::endl;
+    out << "    --result-cache DIR                                 As for trace-scene, restoring the result and flux grid files; not for sweeps or HDF5 grids." << Qt::endl;
+    out << "  benchmark-suite <suite.json>                       Run the benchmark configs of a suite, append rays/s, setup times and hashes to its history" << Qt::endl;
+    out << "                                                     and compare them with the baseline of this host." << Qt::endl;
+    out << "    --update-baseline                                  Store this run as the baseline of the host; a host without one stores its first run." << Qt::endl;
+    out << "    --host NAME                                        Host name the baseline is kept under (default the machine host name)." << Qt::endl;
+    out << "  merge-results <partial> ...                        Sum the partial results of all shards of a job; for a benchmark, write its result JSON." << Qt::endl;
+    out << "  annual <annual_config.json>                        Trace sampled sun positions of a TMY file and write the annual energy." << Qt::endl;
     out << "  run-script <script.tnhpps>                         Run a script through the limited true-headless API." << Qt::endl;
+    out << "  serve [--cache N] [--socket NAME]                  Run JSON jobs read line by line from stdin, or from the clients of local socket NAME, keeping up to N scenes loaded (default 4)." << Qt::endl;
+    out << "  serve-http [--port N] [--cache N] [--workers N] [--slice-rays N] [--flux-ring FILE] [--ring-slots N] [--ring-cells N]" << Qt::endl;
+    out << "                                                     Serve trace jobs and binary flux grids over HTTP on the local host (default port 8650)," << Qt::endl;
+    out << "                                                     taking turns in slices of N rays (default 1000000) on one pool of workers." << Qt::endl;
+    out << "                                                     GET /metrics gives live counters in the Prometheus text format." << Qt::endl;
+    out << "                                                     --flux-ring publishes the grids of every job done to a memory-mapped ring" << Qt::endl;
+    out << "                                                     of N slots (default 8) of up to N cells (default 250000), see FluxRingLayout.h." << Qt::endl;
+    out << "  --trace-events <events.json>                       Record chunk, wait, export and setup events of any command as a Chrome trace." << Qt::endl;
+    out << "  --events ndjson                                    Write phase, progress and result records of trace-scene to stdout as JSON lines." << Qt::endl;
+    out << "  --shared-meshes                                    Trace mesh shapes in their mapped cache files, shared with other processes, instead of copies." << Qt::endl;
+    out << "  --paged-meshes <MB>                                Trace mesh shapes paged from cluster files, each worker caching up to MB of clusters." << Qt::endl;
     out << Qt::endl;
     out << "Headless script API:" << Qt::endl;
     out << "  print(value)" << Qt::endl;
     out << "  tn.writeJson(path, value)" << Qt::endl;
     out << "  tn.validateScene(path)" << Qt::endl;
     out << "  tn.runBenchmark(path)" << Qt::endl;
-    out << "  tn.traceScene({ scene, rays, seed, noExport: true })" << Qt::endl;
+    out << "  tn.traceScene({ scene, rays, seed, noExport: true, flux, typedArrays, powerBudget, checkpoint, checkpointInterval, resume, cache })" << Qt::endl;
+    out << "  tn.openScene(path): setField(url, field, value), setFields(urls, field, values), setSun(azimuth, elevation), trace(options), close()" << Qt::endl;
+    out << "  tn.sweep({ scene, variants: [{ rays, seed, sun, fields }], rays, seed, flux, typedArrays, powerBudget, concurrency })" << Qt::endl;
 }
 
 int HeadlessCommandRunner::printUsageError(const QString& message) const
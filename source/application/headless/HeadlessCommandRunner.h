@@ -1,10 +1,12 @@
 #pragma once
 
+#include <QMap>
 #include <QString>
 #include <QStringList>
 #include <qglobal.h>
 
 class CorePluginRegistry;
+class HeadlessEvents;
 
 class HeadlessCommandRunner
 {
@@ -20,14 +22,40 @@ private:
         bool hasRays = false;
         bool hasSeed = false;
         bool noExport = false;
+        QString exporter;
+        QMap<QString, QString> exportParameters;
+        QStringList exportSurfaces;
+        ulong exportQueue = 4;
+        bool hasExportQueue = false;
+        ulong exportSample = 0;
+        bool hasExportSample = false;
+        bool exportSampleStratified = false;
+        QString checkpointFile;
+        double checkpointInterval = 60.;
+        bool hasCheckpointInterval = false;
+        bool resume = false;
+        bool sceneCache = false;
+        bool hasShard = false;
+        int shard = 0;
+        int shards = 1;
+        QString partialFile;
+        QString resultCache;
     };
 
+    int runCommand(const QStringList& args, HeadlessEvents* events) const;
     int validateScene(const QString& fileName) const;
-    int traceScene(const QStringList& args) const;
+    int sceneStats(const QString& fileName) const;
+    int traceScene(const QStringList& args, HeadlessEvents* events) const;
     int benchmark(const QStringList& args) const;
+    int benchmarkSuite(const QStringList& args) const;
+    int mergeResults(const QStringList& args) const;
+    int annual(const QStringList& args) const;
     int runScript(const QStringList& args) const;
+    int serve(const QStringList& args) const;
+    int serveHttp(const QStringList& args) const;
     void initializeSceneServices(const QString& fileName, CorePluginRegistry* plugins) const;
     bool parseTraceSceneArguments(const QStringList& args, TraceSceneArguments* parsed, QString* errorMessage) const;
+    bool parseShardOption(const QString& value, int* shard, int* shards, QString* errorMessage) const;
     bool parseUnsignedLongOption(const QString& optionName, const QString& value, bool allowZero, ulong* parsed, QString* errorMessage) const;
     void printUsage() const;
     int printUsageError(const QString& message) const;
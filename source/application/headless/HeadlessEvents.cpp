@@ -0,0 +1,154 @@
+#include "HeadlessEvents.h"
+
+#include <chrono>
+
+#include <QJsonDocument>
+
+
+HeadlessEvents::HeadlessEvents(FILE* file, double progressInterval):
+    m_file(file),
+    m_interval(progressInterval > 0. ? progressInterval : 0.5)
+{
+    m_timer.start();
+    m_writer = std::thread([this]() {run();});
+}
+
+HeadlessEvents::~HeadlessEvents()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_writer.join();
+}
+
+void HeadlessEvents::post(const QString& event, QJsonObject record)
+{
+    record.insert("event", event);
+    record.insert("t", seconds());
+    QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+    line += '\n';
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(line));
+    }
+    m_wake.notify_one();
+}
+
+void HeadlessEvents::beginPhase(const QString& phase)
+{
+    endPhase();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_phase = phase;
+    m_phaseStart = seconds();
+}
+
+void HeadlessEvents::endPhase()
+{
+    QString phase;
+    double start = 0.;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        phase.swap(m_phase);
+        start = m_phaseStart;
+    }
+    if (phase.isEmpty())
+        return;
+
+    QJsonObject record;
+    record.insert("phase", phase);
+    record.insert("seconds", seconds() - start);
+    post("phase", record);
+}
+
+RayTraceRunner::ProgressCallback HeadlessEvents::progressCallback()
+{
+    // ray counts come from the poll, so the messages of workers end here
+    return [this](const QString& message) {
+        if (message == "Building ray-tracing instance tree.")
+            beginPhase("build");
+        else if (message == "Sizing sun aperture.")
+            beginPhase("aperture");
+        else if (message == "Starting ray loop.")
+            beginPhase("trace");
+    };
+}
+
+void HeadlessEvents::startProgress(const RayTraceRunner* runner)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_runner = runner;
+    m_progressTime = seconds();
+    m_progressRays = 0;
+}
+
+void HeadlessEvents::stopProgress()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_runner = nullptr;
+}
+
+void HeadlessEvents::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wake.notify_one();
+    m_written.wait(lock, [this]() {return m_queue.empty() && !m_writing;});
+}
+
+// called with the mutex held
+void HeadlessEvents::postProgress(double t)
+{
+    const RayTraceProgress progress = m_runner->progress();
+    if (progress.raysTotal == 0)
+        return;
+    const ulong rays = qMin(progress.raysTraced, progress.raysTotal);
+    const double dt = t - m_progressTime;
+
+    QJsonObject record;
+    record.insert("event", "progress");
+    record.insert("t", t);
+    record.insert("rays_traced", double(rays));
+    record.insert("rays_total", double(progress.raysTotal));
+    record.insert("fraction", double(rays)/double(progress.raysTotal));
+    record.insert("rays_per_second", dt > 0. && rays >= m_progressRays ? double(rays - m_progressRays)/dt : 0.);
+    if (progress.sunPositionCount > 1) {
+        record.insert("sun_position", progress.sunPosition);
+        record.insert("sun_positions", progress.sunPositionCount);
+    }
+    QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+    line += '\n';
+    m_queue.push_back(std::move(line));
+
+    m_progressTime = t;
+    m_progressRays = rays;
+}
+
+void HeadlessEvents::run()
+{
+    const auto interval = std::chrono::microseconds(qint64(m_interval*1e6));
+    std::vector<QByteArray> lines;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_wake.wait_for(lock, interval, [this]() {return m_stop || !m_queue.empty();});
+        const double t = seconds();
+        if (m_runner && t - m_progressTime >= m_interval)
+            postProgress(t);
+
+        if (m_queue.empty()) {
+            if (m_stop)
+                break;
+            continue;
+        }
+        lines.swap(m_queue);
+        m_writing = true;
+        lock.unlock();
+        for (const QByteArray& line : lines)
+            std::fwrite(line.constData(), 1, size_t(line.size()), m_file);
+        std::fflush(m_file);
+        lines.clear();
+        lock.lock();
+        m_writing = false;
+        m_written.notify_all();
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QString>
+
+#include "core/RayTraceRunner.h"
+
+//! HeadlessEvents writes the records of a headless command as NDJSON.
+/*!
+ * Records are queued by any thread and written by a writer thread of their
+ * own, so a slow reader of the pipe only holds the writer. Every record is
+ * a JSON object on one line with its "event" and "t", the seconds since the
+ * events were created.
+ *
+ * Phases (load, build, aperture, trace) are timed from the progress
+ * messages of RayTraceRunner; the ray counts of a running trace are polled
+ * from RayTraceRunner::progress() by the writer every interval, so the
+ * workers never report them.
+ */
+class HeadlessEvents
+{
+public:
+    explicit HeadlessEvents(FILE* file = stdout, double progressInterval = 0.5);
+    ~HeadlessEvents();
+
+    HeadlessEvents(const HeadlessEvents&) = delete;
+    HeadlessEvents& operator=(const HeadlessEvents&) = delete;
+
+    // queues a record of the given event, from any thread
+    void post(const QString& event, QJsonObject record = QJsonObject());
+
+    // ends the running phase, if any, with a phase record, and starts another
+    void beginPhase(const QString& phase);
+    void endPhase();
+
+    // a callback for RayTraceRunner::trace that turns its messages into phases
+    RayTraceRunner::ProgressCallback progressCallback();
+    // polls the ray counts of runner until stopProgress
+    void startProgress(const RayTraceRunner* runner);
+    void stopProgress();
+
+    // waits until the queued records are written
+    void flush();
+
+private:
+    void run();
+    void postProgress(double t);
+    double seconds() const {return m_timer.nsecsElapsed()*1e-9;}
+
+    FILE* m_file;
+    double m_interval;
+    QElapsedTimer m_timer;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_written;
+    std::vector<QByteArray> m_queue;
+    bool m_writing = false;
+    bool m_stop = false;
+
+    QString m_phase;
+    double m_phaseStart = 0.;
+
+    const RayTraceRunner* m_runner = nullptr;
+    double m_progressTime = 0.;
+    ulong m_progressRays = 0;
+
+    std::thread m_writer;
+};
@@ -0,0 +1,742 @@
+#include "HeadlessHttpService.h"
+
+#include <atomic>
+#include <list>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtEndian>
+
+#include "core/CompiledScene.h"
+#include "core/CorePluginRegistry.h"
+#include "core/RayTraceRunner.h"
+#include "core/SceneLoader.h"
+#include "core/ScenePatch.h"
+#include "core/TonatiuhCore.h"
+#include "kernel/run/FluxAccumulator.h"
+#include "kernel/run/TraceScheduler.h"
+#include "libraries/auxiliary/FluxRing.h"
+
+namespace
+{
+
+// requests and their bodies, a scene file path and a few flux targets
+const qsizetype MaximumRequestBytes = 1 << 20;
+
+const char* stateNames[] = {"queued", "running", "done", "failed", "canceled"};
+
+QByteArray reasonPhrase(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    default: return "Internal Server Error";
+    }
+}
+
+QByteArray toJson(const QJsonObject& object)
+{
+    return QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+}
+
+void appendMetric(QByteArray& out, const QByteArray& name, const char* type, const char* help, double value)
+{
+    out += "# HELP tonatiuhpp_" + name + ' ' + help + '\n';
+    out += "# TYPE tonatiuhpp_" + name + ' ' + type + '\n';
+    out += "tonatiuhpp_" + name + ' ' + QByteArray::number(value, 'g', QLocale::FloatingPointShortest) + '\n';
+}
+
+}
+
+struct HeadlessHttpService::Job
+{
+    enum State {Queued, Running, Done, Failed, Canceled};
+
+    int id = 0;
+    QString sceneFileName; // empty for a base scene given by its key only
+    QByteArray sceneKey; // SHA-256 of the scene file when submitted
+    ScenePatch patch; // applied to the scene for its slices
+    QByteArray patchKey;
+    ulong rays = 0;
+    ulong seed = 0;
+    bool hasSun = false; // else the sun of the scene
+    RayTraceSunPosition sun;
+    FluxAccumulator flux; // by the scheduler only
+    std::atomic_bool cancel{false};
+    QElapsedTimer timer;
+
+    // under the service mutex
+    State state = Queued;
+    ulong raysTraced = 0; // of the slices done
+    qulonglong slices = 0;
+    bool sceneCached = false;
+    QString error;
+    double sunApertureArea = 0.;
+    double irradiance = 0.;
+    double traceSeconds = 0.;
+    double elapsedSeconds = 0.;
+    // once done
+    std::vector<std::vector<double>> grids;
+    std::vector<qulonglong> hits;
+    std::vector<qulonglong> ringRecords; // of the grids, 0 if not published
+};
+
+// loaded scenes by file hash, the least recently used dropped first
+struct HeadlessHttpService::SceneCache
+{
+    struct Entry
+    {
+        QByteArray key;
+        std::unique_ptr<LoadedScene> scene;
+        ScenePatch patch; // applied, kept for the next slice of the same patch
+        QByteArray patchKey;
+        CompiledScene compiled; // for the next slice of the same patch and sun
+    };
+
+    int capacity = 4;
+    CorePluginRegistry plugins;
+    std::list<Entry> entries; // most recent first
+};
+
+HeadlessHttpService::HeadlessHttpService(int sceneCacheSize, int workerCount, ulong sliceRays):
+    m_server(new QTcpServer),
+    m_workerCount(qMax(1, workerCount)),
+    m_sliceRays(qMax<ulong>(1, sliceRays))
+{
+    TraceMetrics::setActive(&m_metrics);
+    QObject::connect(m_server, &QTcpServer::newConnection, [this]() {
+        while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+            m_requests.insert(socket, QByteArray());
+            QObject::connect(socket, &QTcpSocket::readyRead, [this, socket]() {readRequest(socket);});
+            QObject::connect(socket, &QTcpSocket::disconnected, [this, socket]() {
+                m_requests.remove(socket);
+                socket->deleteLater();
+            });
+        }
+    });
+
+    m_scheduler = std::thread([this, sceneCacheSize]() {
+        TonatiuhCore::initializeCoin();
+        m_scenes.reset(new SceneCache);
+        m_scenes->capacity = qMax(1, sceneCacheSize);
+        m_scenes->plugins.loadScenePlugins(TonatiuhCore::pluginSearchPaths(QCoreApplication::applicationDirPath()));
+        runScheduler();
+        m_scenes.reset(); // the scenes go with the thread that read them
+    });
+}
+
+HeadlessHttpService::~HeadlessHttpService()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        for (auto& entry : m_jobs)
+            entry.second->cancel.store(true);
+        if (m_running)
+            m_running->cancel.store(true);
+    }
+    m_wake.notify_all();
+    m_scheduler.join();
+    TraceMetrics::setActive(nullptr);
+    delete m_server;
+}
+
+bool HeadlessHttpService::openFluxRing(const QString& fileName, int slotCount, qulonglong maxCells, QString* errorMessage)
+{
+    std::unique_ptr<FluxRing> ring(new FluxRing);
+    if (!ring->create(fileName, slotCount, maxCells, errorMessage))
+        return false;
+    m_ring = std::move(ring);
+    return true;
+}
+
+bool HeadlessHttpService::listen(quint16 port, QString* errorMessage)
+{
+    if (m_server->listen(QHostAddress::LocalHost, port))
+        return true;
+    if (errorMessage)
+        *errorMessage = m_server->errorString();
+    return false;
+}
+
+quint16 HeadlessHttpService::getPort() const
+{
+    return m_server->serverPort();
+}
+
+int HeadlessHttpService::exec()
+{
+    return QCoreApplication::exec();
+}
+
+void HeadlessHttpService::readRequest(QTcpSocket* socket)
+{
+    QByteArray& data = m_requests[socket];
+    data += socket->readAll();
+
+    Reply reply;
+    const qsizetype headerEnd = data.indexOf("\r\n\r\n");
+    if (data.size() > MaximumRequestBytes) {
+        reply.status = 413;
+        reply.body = toJson(QJsonObject{{"error", "The request is too large."}});
+    } else if (headerEnd < 0) {
+        return;
+    } else {
+        const QList<QByteArray> lines = data.left(headerEnd).split('\n');
+        const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+        qsizetype contentLength = 0;
+        for (int n = 1; n < lines.size(); ++n) {
+            const qsizetype colon = lines[n].indexOf(':');
+            if (colon > 0 && lines[n].left(colon).trimmed().toLower() == "content-length")
+                contentLength = lines[n].mid(colon + 1).trimmed().toLongLong();
+        }
+        if (data.size() < headerEnd + 4 + contentLength)
+            return;
+
+        if (requestLine.size() < 2) {
+            reply.status = 400;
+            reply.body = toJson(QJsonObject{{"error", "The request line is malformed."}});
+        } else {
+            QByteArray path = requestLine[1];
+            const qsizetype query = path.indexOf('?');
+            if (query >= 0)
+                path.truncate(query);
+            reply = handle(requestLine[0], path, data.mid(headerEnd + 4, contentLength));
+        }
+    }
+
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(reply.status) + " " + reasonPhrase(reply.status) + "\r\n";
+    response += "Content-Type: " + reply.contentType + "\r\n";
+    response += "Content-Length: " + QByteArray::number(reply.body.size()) + "\r\n";
+    response += "Connection: close\r\n";
+    response += reply.headers;
+    response += "\r\n";
+    response += reply.body;
+    socket->write(response);
+    socket->disconnectFromHost();
+    m_requests.remove(socket);
+}
+
+HeadlessHttpService::Reply HeadlessHttpService::handle(const QByteArray& method, const QByteArray& path, const QByteArray& body)
+{
+    auto error = [](int status, const QString& message) {
+        Reply reply;
+        reply.status = status;
+        reply.body = toJson(QJsonObject{{"error", message}});
+        return reply;
+    };
+
+    const QList<QByteArray> parts = path.split('/');
+    // parts[0] is empty, before the leading slash
+    if (path == "/shutdown") {
+        if (method != "POST")
+            return error(405, "Use POST /shutdown.");
+        QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+        return Reply{200, "application/json", toJson(QJsonObject{{"ok", true}}), QByteArray()};
+    }
+    if (path == "/metrics") {
+        if (method != "GET")
+            return error(405, "Use GET /metrics.");
+        return metrics();
+    }
+    if (parts.size() < 2 || parts[1] != "jobs")
+        return error(404, QString("No resource %1.").arg(QString::fromUtf8(path)));
+
+    if (parts.size() == 2) {
+        if (method == "POST")
+            return submit(body);
+        if (method != "GET")
+            return error(405, "Use GET or POST /jobs.");
+        QJsonArray ids;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& entry : m_jobs)
+                ids << entry.first;
+        }
+        return Reply{200, "application/json", toJson(QJsonObject{{"jobs", ids}}), QByteArray()};
+    }
+
+    bool ok = false;
+    const int id = parts[2].toInt(&ok);
+    if (!ok)
+        return error(404, QString("No job %1.").arg(QString::fromUtf8(parts[2])));
+
+    if (parts.size() == 3) {
+        if (method == "GET")
+            return status(id);
+        if (method == "DELETE")
+            return cancel(id, true);
+        return error(405, "Use GET or DELETE /jobs/<id>.");
+    }
+    if (parts.size() == 4 && parts[3] == "cancel") {
+        if (method != "POST")
+            return error(405, "Use POST /jobs/<id>/cancel.");
+        return cancel(id, false);
+    }
+    if (parts.size() == 4 && parts[3] == "result") {
+        if (method != "GET")
+            return error(405, "Use GET /jobs/<id>/result.");
+        return result(id);
+    }
+    if (parts.size() == 5 && parts[3] == "flux") {
+        if (method != "GET")
+            return error(405, "Use GET /jobs/<id>/flux/<n>.");
+        const int n = parts[4].toInt(&ok);
+        if (!ok)
+            return error(404, QString("No flux grid %1.").arg(QString::fromUtf8(parts[4])));
+        return flux(id, n);
+    }
+    return error(404, QString("No resource %1.").arg(QString::fromUtf8(path)));
+}
+
+HeadlessHttpService::Reply HeadlessHttpService::submit(const QByteArray& body)
+{
+    auto error = [](const QString& message) {
+        Reply reply;
+        reply.status = 400;
+        reply.body = toJson(QJsonObject{{"error", message}});
+        return reply;
+    };
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(body, &parseError);
+    if (parseError.error != QJsonParseError::NoError || !document.isObject())
+        return error("A job must be a JSON object.");
+    const QJsonObject job = document.object();
+
+    const QString sceneFileName = job.value("scene").toString();
+    const QByteArray sceneKey = QByteArray::fromHex(job.value("scene_sha256").toString().toLatin1());
+    const double rays = job.value("rays").toDouble();
+    const double seed = job.value("seed").toDouble(0.);
+    if ((sceneFileName.isEmpty() && !job.contains("scene_sha256")) || !(rays >= 1.))
+        return error("A job requires a scene or its scene_sha256 and a positive ray count.");
+    if (job.contains("scene_sha256") && sceneKey.size() != 32)
+        return error("scene_sha256 must be 64 hexadecimal digits.");
+    if (!(seed >= 0.))
+        return error("seed must not be negative.");
+
+    std::shared_ptr<Job> ans(new Job);
+    if (!sceneFileName.isEmpty())
+        ans->sceneFileName = QFileInfo(sceneFileName).absoluteFilePath();
+    ans->rays = static_cast<ulong>(rays);
+    ans->seed = static_cast<ulong>(seed);
+    if (job.contains("sun")) {
+        const QJsonObject sun = job.value("sun").toObject();
+        ans->sun.azimuth = sun.value("azimuth").toDouble(qQNaN());
+        ans->sun.elevation = sun.value("elevation").toDouble(qQNaN());
+        if (!job.value("sun").isObject() || !qIsFinite(ans->sun.azimuth) || !(ans->sun.elevation >= -90. && ans->sun.elevation <= 90.))
+            return error("sun must give azimuth and an elevation from -90 to 90 degrees.");
+        ans->hasSun = true;
+    }
+
+    const QJsonArray targets = job.value("flux").toArray();
+    for (int n = 0; n < targets.size(); ++n) {
+        const QJsonObject target = targets[n].toObject();
+        const QString name = QString("flux[%1]").arg(n);
+        const QString surface = target.value("surface").toString();
+        const QString side = target.value("side").toString("front");
+        const int gridRows = target.value("rows").toInt();
+        const int gridCols = target.value("cols").toInt();
+        if (surface.trimmed().isEmpty())
+            return error(QString("%1.surface must be a non-empty surface URL.").arg(name));
+        if (side != "front" && side != "back")
+            return error(QString("%1.side must be \"front\" or \"back\".").arg(name));
+        if (gridRows < 1 || gridCols < 1 || double(gridRows) * double(gridCols) > 1.e7)
+            return error(QString("%1 must have positive rows and cols and at most 10000000 cells.").arg(name));
+        if (m_ring && qulonglong(gridRows) * qulonglong(gridCols) > m_ring->getMaxCells())
+            return error(QString("%1 must have at most %2 cells, those of a slot of the flux ring.").arg(name).arg(m_ring->getMaxCells()));
+        ans->flux.addTarget(surface, side == "front", gridRows, gridCols);
+    }
+
+    if (job.contains("patch")) {
+        QString patchError;
+        if (!ans->patch.fromJson(job.value("patch"), &patchError))
+            return error(patchError);
+        ans->patchKey = ans->patch.getKey();
+    }
+
+    // a base scene given by its key alone has to be loaded already
+    ans->sceneKey = sceneKey;
+    if (!ans->sceneFileName.isEmpty()) {
+        QFile file(ans->sceneFileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return error(QString("Scene %1 cannot be read.").arg(ans->sceneFileName));
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        hash.addData(&file);
+        ans->sceneKey = hash.result();
+        if (!sceneKey.isEmpty() && sceneKey != ans->sceneKey)
+            return error(QString("scene_sha256 is not that of scene %1.").arg(ans->sceneFileName));
+    }
+    ans->timer.start();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ans->id = m_nextId++;
+        m_jobsSubmitted++;
+        m_jobs[ans->id] = ans;
+        m_queue.push_back(ans);
+    }
+    m_wake.notify_one();
+
+    Reply reply;
+    reply.status = 202;
+    reply.body = toJson(QJsonObject{{"id", ans->id}, {"status", "queued"}});
+    reply.headers = "Location: /jobs/" + QByteArray::number(ans->id) + "\r\n";
+    return reply;
+}
+
+HeadlessHttpService::Reply HeadlessHttpService::status(int id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end())
+        return Reply{404, "application/json", toJson(QJsonObject{{"error", QString("No job %1.").arg(id)}}), QByteArray()};
+    const Job& job = *it->second;
+
+    ulong raysTraced = job.raysTraced;
+    if (job.state == Job::Running && m_running.get() == &job && m_runner)
+        raysTraced += qMin(m_runner->progress().raysTraced, qMin(m_sliceRays, job.rays - job.raysTraced));
+
+    QJsonObject ans;
+    ans["id"] = job.id;
+    ans["status"] = stateNames[job.state];
+    ans["scene"] = job.sceneFileName;
+    ans["scene_sha256"] = QString::fromLatin1(job.sceneKey.toHex());
+    ans["patch_edits"] = job.patch.getEditCount();
+    ans["rays"] = double(job.rays);
+    ans["rays_traced"] = double(raysTraced);
+    ans["slices"] = double(job.slices);
+    ans["scene_cached"] = job.sceneCached;
+    ans["elapsed_seconds"] = job.state == Job::Queued || job.state == Job::Running ? job.timer.elapsed()/1000. : job.elapsedSeconds;
+    if (!job.error.isEmpty())
+        ans["error"] = job.error;
+    return Reply{200, "application/json", toJson(ans), QByteArray()};
+}
+
+HeadlessHttpService::Reply HeadlessHttpService::result(int id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end())
+        return Reply{404, "application/json", toJson(QJsonObject{{"error", QString("No job %1.").arg(id)}}), QByteArray()};
+    const Job& job = *it->second;
+    if (job.state != Job::Done)
+        return Reply{409, "application/json", toJson(QJsonObject{{"error", QString("Job %1 is %2.").arg(id).arg(stateNames[job.state])}}), QByteArray()};
+
+    QJsonObject ans;
+    ans["id"] = job.id;
+    ans["scene"] = job.sceneFileName;
+    ans["scene_sha256"] = QString::fromLatin1(job.sceneKey.toHex());
+    ans["rays_traced"] = double(job.raysTraced);
+    ans["sun_aperture_area"] = job.sunApertureArea;
+    ans["irradiance"] = job.irradiance;
+    ans["power_per_ray"] = job.raysTraced > 0 ? job.sunApertureArea * job.irradiance / job.raysTraced : 0.;
+    ans["trace_seconds"] = job.traceSeconds;
+    ans["elapsed_seconds"] = job.elapsedSeconds;
+    QJsonArray targets;
+    for (int n = 0; n < int(job.grids.size()); ++n) {
+        const FluxAccumulator::Target& target = job.flux.getTarget(n);
+        double maximum = 0.;
+        double sum = 0.;
+        for (double value : job.grids[n]) {
+            maximum = qMax(maximum, value);
+            sum += value;
+        }
+        QJsonObject t;
+        t["surface"] = target.url;
+        t["side"] = target.isFront ? "front" : "back";
+        t["rows"] = target.rows;
+        t["cols"] = target.cols;
+        t["hits"] = double(job.hits[n]);
+        t["maximum_flux"] = maximum;
+        t["average_flux"] = job.grids[n].empty() ? 0. : sum / double(job.grids[n].size());
+        t["grid"] = QString("/jobs/%1/flux/%2").arg(id).arg(n);
+        if (job.ringRecords[n] > 0)
+            t["ring_record"] = double(job.ringRecords[n]);
+        targets << t;
+    }
+    ans["flux"] = targets;
+    return Reply{200, "application/json", toJson(ans), QByteArray()};
+}
+
+HeadlessHttpService::Reply HeadlessHttpService::flux(int id, int n) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end())
+        return Reply{404, "application/json", toJson(QJsonObject{{"error", QString("No job %1.").arg(id)}}), QByteArray()};
+    const Job& job = *it->second;
+    if (job.state != Job::Done)
+        return Reply{409, "application/json", toJson(QJsonObject{{"error", QString("Job %1 is %2.").arg(id).arg(stateNames[job.state])}}), QByteArray()};
+    if (n < 0 || n >= int(job.grids.size()))
+        return Reply{404, "application/json", toJson(QJsonObject{{"error", QString("Job %1 has no flux grid %2.").arg(id).arg(n)}}), QByteArray()};
+
+    // row by row with rows along u, as the flux grid files
+    const std::vector<double>& grid = job.grids[n];
+    Reply reply;
+    reply.contentType = "application/octet-stream";
+    reply.body.resize(qsizetype(grid.size() * sizeof(double)));
+    qToLittleEndian<double>(grid.data(), qsizetype(grid.size()), reply.body.data());
+    const FluxAccumulator::Target& target = job.flux.getTarget(n);
+    reply.headers = "X-Flux-Rows: " + QByteArray::number(target.rows) + "\r\n" +
+        "X-Flux-Cols: " + QByteArray::number(target.cols) + "\r\n" +
+        "X-Flux-Format: float64-le\r\n";
+    return reply;
+}
+
+HeadlessHttpService::Reply HeadlessHttpService::cancel(int id, bool remove)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end())
+        return Reply{404, "application/json", toJson(QJsonObject{{"error", QString("No job %1.").arg(id)}}), QByteArray()};
+    // a queued job is dropped when its turn comes, a running one within a micro-batch of rays
+    Job& job = *it->second;
+    job.cancel.store(true);
+    const QString state = stateNames[job.state];
+    if (remove)
+        m_jobs.erase(it);
+    return Reply{200, "application/json", toJson(QJsonObject{{"id", id}, {"status", state}, {"removed", remove}}), QByteArray()};
+}
+
+// the jobs waiting or running are labeled by id, the others only counted by state
+HeadlessHttpService::Reply HeadlessHttpService::metrics() const
+{
+    QByteArray out;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int states[5] = {0, 0, 0, 0, 0};
+        for (const auto& entry : m_jobs)
+            states[entry.second->state]++;
+        out += "# HELP tonatiuhpp_jobs Jobs kept by the service, by state.\n";
+        out += "# TYPE tonatiuhpp_jobs gauge\n";
+        for (int state = 0; state < 5; ++state)
+            out += QByteArray("tonatiuhpp_jobs{state=\"") + stateNames[state] + "\"} " + QByteArray::number(states[state]) + '\n';
+        appendMetric(out, "jobs_submitted_total", "counter", "Jobs submitted.", double(m_jobsSubmitted));
+        appendMetric(out, "queue_depth", "gauge", "Jobs waiting for their next slice.", double(m_queue.size()));
+        appendMetric(out, "slices_total", "counter", "Slices of rays traced.", double(m_slices));
+        appendMetric(out, "workers", "gauge", "Trace workers of the pool.", m_workerCount);
+        appendMetric(out, "workers_busy", "gauge", "Trace workers tracing a slice.", m_running ? m_workerCount : 0);
+        appendMetric(out, "scene_cache_hits_total", "counter", "Slices whose scene was loaded.", double(m_sceneHits));
+        appendMetric(out, "scene_cache_misses_total", "counter", "Slices that read their scene.", double(m_sceneMisses));
+        const qulonglong lookups = m_sceneHits + m_sceneMisses;
+        appendMetric(out, "scene_cache_hit_ratio", "gauge", "Scene cache hits over all lookups.", lookups > 0 ? double(m_sceneHits)/lookups : 0.);
+        appendMetric(out, "scenes_loaded", "gauge", "Scenes kept loaded.", m_scenesLoaded);
+
+        QByteArray rates;
+        QByteArray traced;
+        for (const auto& entry : m_jobs) {
+            const Job& job = *entry.second;
+            if (job.state != Job::Queued && job.state != Job::Running)
+                continue;
+            double raysTraced = double(job.raysTraced);
+            double seconds = job.traceSeconds;
+            if (m_running.get() == &job && m_runner) {
+                raysTraced += double(qMin(m_runner->progress().raysTraced, qMin(m_sliceRays, job.rays - job.raysTraced)));
+                seconds += m_sliceTimer.nsecsElapsed()*1e-9;
+            }
+            const QByteArray label = "{job=\"" + QByteArray::number(job.id) + "\"} ";
+            rates += "tonatiuhpp_job_rays_per_second" + label + QByteArray::number(seconds > 0. ? raysTraced/seconds : 0., 'g', QLocale::FloatingPointShortest) + '\n';
+            traced += "tonatiuhpp_job_rays_traced" + label + QByteArray::number(raysTraced, 'g', QLocale::FloatingPointShortest) + '\n';
+        }
+        out += "# HELP tonatiuhpp_job_rays_per_second Rays per second of the slices of a job waiting or running.\n";
+        out += "# TYPE tonatiuhpp_job_rays_per_second gauge\n" + rates;
+        out += "# HELP tonatiuhpp_job_rays_traced Rays traced of a job waiting or running.\n";
+        out += "# TYPE tonatiuhpp_job_rays_traced gauge\n" + traced;
+    }
+    out += m_metrics.toPrometheus("tonatiuhpp_");
+
+    Reply reply;
+    reply.contentType = "text/plain; version=0.0.4; charset=utf-8";
+    reply.body = out;
+    return reply;
+}
+
+void HeadlessHttpService::runScheduler()
+{
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() {return m_stop || !m_queue.empty();});
+            if (m_stop)
+                return;
+            job = m_queue.front();
+            m_queue.pop_front();
+            if (job->cancel.load()) {
+                job->state = Job::Canceled;
+                job->elapsedSeconds = job->timer.elapsed()/1000.;
+                continue;
+            }
+            job->state = Job::Running;
+            m_running = job;
+        }
+
+        traceSlice(job);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running.reset();
+        if (job->state == Job::Running)
+            m_queue.push_back(job); // its next turn after the other jobs
+    }
+}
+
+// one slice of the job; it ends the job if it fails, is canceled or traced all rays
+void HeadlessHttpService::traceSlice(const std::shared_ptr<Job>& job)
+{
+    auto finish = [this, &job](Job::State state, const QString& error) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job->state = state;
+        job->error = error;
+        job->elapsedSeconds = job->timer.elapsed()/1000.;
+    };
+
+    // the scene of the job, read again if it left the cache
+    std::list<SceneCache::Entry>& entries = m_scenes->entries;
+    auto entry = entries.begin();
+    while (entry != entries.end() && entry->key != job->sceneKey)
+        ++entry;
+    const bool cached = entry != entries.end();
+    if (cached) {
+        entries.splice(entries.begin(), entries, entry);
+    } else if (job->sceneFileName.isEmpty()) {
+        return finish(Job::Failed, QString("Scene %1 is not loaded; submit a job with its file first.").arg(QString::fromLatin1(job->sceneKey.toHex())));
+    } else {
+        TonatiuhCore::setProjectSearchPaths(job->sceneFileName);
+        m_scenes->plugins.loadScenePluginsFor(job->sceneFileName);
+        std::unique_ptr<LoadedScene> scene(new LoadedScene);
+        QString errorMessage;
+        if (!SceneLoader::readFile(job->sceneFileName, scene.get(), &errorMessage))
+            return finish(Job::Failed, "Scene load failed: " + errorMessage);
+        entries.push_front(SceneCache::Entry{job->sceneKey, std::move(scene), ScenePatch(), QByteArray(), CompiledScene()});
+        while (int(entries.size()) > m_scenes->capacity)
+            entries.pop_back();
+    }
+    TSceneKit* scene = entries.front().scene->get();
+
+    // the base scene turned into that of the job, unless the last slice left it so
+    SceneCache::Entry& loaded = entries.front();
+    if (loaded.patchKey != job->patchKey) {
+        loaded.compiled.clear();
+        loaded.patch.undo();
+        loaded.patch = job->patch;
+        loaded.patchKey.clear();
+        QString errorMessage;
+        if (!loaded.patch.apply(scene, &errorMessage)) {
+            loaded.patch = ScenePatch();
+            return finish(Job::Failed, "Scene patch failed: " + errorMessage);
+        }
+        loaded.patchKey = job->patchKey;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        (cached ? m_sceneHits : m_sceneMisses)++;
+        m_scenesLoaded = int(entries.size());
+    }
+
+    RayTraceOptions options;
+    options.rays = qMin(m_sliceRays, job->rays - job->raysTraced);
+    options.seed = TraceScheduler::chunkSeed(job->seed, job->slices);
+    options.workerCount = m_workerCount;
+    options.chunkSize = 10000;
+    if (job->hasSun)
+        options.sunPositions << job->sun;
+    // the slices of a job compile the scene once, as the patch and sun stay
+    loaded.compiled.key = job->sceneKey + '/' + job->patchKey;
+    if (job->hasSun)
+        loaded.compiled.key += '/' + QByteArray::number(job->sun.azimuth, 'g', 17) + ',' + QByteArray::number(job->sun.elevation, 'g', 17);
+    options.compiledScene = &loaded.compiled;
+    if (job->flux.getTargetCount() > 0) {
+        options.outputMode = RayTraceOutputMode::FluxGrid;
+        options.fluxAccumulator = &job->flux;
+    }
+
+    RayTraceRunner runner;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (job->slices == 0)
+            job->sceneCached = cached;
+        m_runner = &runner;
+        m_sliceTimer.start();
+    }
+    RayTraceResult result;
+    QString errorMessage;
+    const bool traced = runner.trace(scene, options, &result, &errorMessage,
+        RayTraceRunner::ProgressCallback(), RayTraceRunner::HitCallback(), RayTraceRunner::WorkerHitCallbackFactory(),
+        [&job]() {return job->cancel.load(std::memory_order_relaxed);});
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_runner = nullptr;
+    }
+
+    if (!traced)
+        return finish(Job::Failed, "Trace failed: " + errorMessage);
+    if (result.canceled)
+        return finish(Job::Canceled, QString());
+
+    ulong raysTraced = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job->raysTraced += result.raysTraced;
+        job->slices++;
+        m_slices++;
+        job->sunApertureArea = result.sunApertureArea;
+        job->irradiance = result.irradiance;
+        job->traceSeconds += result.elapsedSeconds;
+        raysTraced = job->raysTraced;
+    }
+    if (raysTraced < job->rays)
+        return;
+
+    // the grids of all slices with the power of a ray of the whole job
+    const double powerPerRay = result.sunApertureArea * result.irradiance / raysTraced;
+    std::vector<std::vector<double>> grids;
+    std::vector<qulonglong> hits;
+    for (int n = 0; n < job->flux.getTargetCount(); ++n) {
+        grids.push_back(job->flux.getFlux(n, powerPerRay));
+        hits.push_back(job->flux.getHits(n));
+    }
+
+    // published before the job is done, so a client that sees it done finds them
+    std::vector<qulonglong> records(grids.size(), 0);
+    for (size_t n = 0; m_ring && n < grids.size(); ++n) {
+        const FluxAccumulator::Target& target = job->flux.getTarget(int(n));
+        FluxRing::Record record;
+        record.job = qulonglong(job->id);
+        record.target = int(n);
+        record.isFront = target.isFront;
+        record.rows = target.rows;
+        record.cols = target.cols;
+        record.raysTraced = raysTraced;
+        record.hits = hits[n];
+        record.powerPerRay = powerPerRay;
+        if (job->hasSun) {
+            record.sunAzimuth = job->sun.azimuth;
+            record.sunElevation = job->sun.elevation;
+        }
+        m_ring->publish(record, grids[n], &records[n]);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    job->grids.swap(grids);
+    job->hits.swap(hits);
+    job->ringRecords.swap(records);
+    job->state = Job::Done;
+    job->elapsedSeconds = job->timer.elapsed()/1000.;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <qglobal.h>
+
+#include "kernel/run/TraceMetrics.h"
+
+class FluxRing;
+class QTcpServer;
+class QTcpSocket;
+class RayTraceRunner;
+
+//! HeadlessHttpService serves trace jobs over HTTP on the local host.
+/*!
+ * Clients submit jobs with POST /jobs, poll GET /jobs/<id>, cancel with
+ * POST /jobs/<id>/cancel or DELETE /jobs/<id>, and read GET
+ * /jobs/<id>/result and the binary flux grids of GET /jobs/<id>/flux/<n>.
+ * GET /metrics gives the counters of the service and of its traces, see
+ * TraceMetrics, in the Prometheus text format. With a flux ring, the grids
+ * of every job done are also published to it, see FluxRing, for solvers
+ * that map it.
+ *
+ * All jobs share one pool of trace workers. A job is traced in slices of
+ * rays, each with a random stream of its own, and the running jobs take
+ * turns slice by slice, so a large job does not hold back the small ones
+ * and the cores are never oversubscribed. Its flux grids add up over the
+ * slices.
+ *
+ * Scenes are read, cached and traced by the scheduler thread only, as Coin
+ * is not shared between threads; the network runs on the thread of the
+ * event loop. Loaded scenes are kept by the SHA-256 of their file, the
+ * least recently used dropped first. A job may name a loaded scene by that
+ * key alone, and give a ScenePatch that turns it into a candidate design; the
+ * patch stays applied until a slice of another patch takes the scene. The
+ * instance tree and scene BVH of a slice are kept with the scene, see
+ * CompiledScene, so the next slices of the same patch and sun do not compile
+ * it again.
+ */
+class HeadlessHttpService
+{
+public:
+    HeadlessHttpService(int sceneCacheSize, int workerCount, ulong sliceRays);
+    ~HeadlessHttpService();
+
+    HeadlessHttpService(const HeadlessHttpService&) = delete;
+    HeadlessHttpService& operator=(const HeadlessHttpService&) = delete;
+
+    // before listen; rings of slotCount grids of at most maxCells values
+    bool openFluxRing(const QString& fileName, int slotCount, qulonglong maxCells, QString* errorMessage = nullptr);
+    // on the local host, any port if port is 0
+    bool listen(quint16 port, QString* errorMessage = nullptr);
+    quint16 getPort() const;
+    // runs the event loop until POST /shutdown
+    int exec();
+
+private:
+    struct Job;
+    struct SceneCache;
+
+    struct Reply
+    {
+        int status = 200;
+        QByteArray contentType = "application/json";
+        QByteArray body;
+        QByteArray headers; // extra lines, each ending in \r\n
+    };
+
+    void readRequest(QTcpSocket* socket);
+    Reply handle(const QByteArray& method, const QByteArray& path, const QByteArray& body);
+    Reply submit(const QByteArray& body);
+    Reply status(int id) const;
+    Reply result(int id) const;
+    Reply flux(int id, int n) const;
+    Reply cancel(int id, bool remove);
+    Reply metrics() const;
+
+    void runScheduler();
+    void traceSlice(const std::shared_ptr<Job>& job);
+
+    QTcpServer* m_server;
+    QHash<QTcpSocket*, QByteArray> m_requests; // bytes read so far
+
+    int m_workerCount;
+    ulong m_sliceRays;
+    std::unique_ptr<SceneCache> m_scenes; // by the scheduler only
+    std::unique_ptr<FluxRing> m_ring; // written by the scheduler only
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::map<int, std::shared_ptr<Job>> m_jobs;
+    std::deque<std::shared_ptr<Job>> m_queue; // jobs waiting for a slice, in turn
+    int m_nextId = 1;
+    const RayTraceRunner* m_runner = nullptr; // of the slice being traced
+    QElapsedTimer m_sliceTimer; // of the slice being traced
+    std::shared_ptr<Job> m_running;
+    qulonglong m_jobsSubmitted = 0;
+    qulonglong m_slices = 0;
+    qulonglong m_sceneHits = 0; // slices whose scene was loaded
+    qulonglong m_sceneMisses = 0;
+    int m_scenesLoaded = 0;
+    bool m_stop = false;
+    std::thread m_scheduler;
+    TraceMetrics m_metrics; // active while the service runs
+};
@@ -1,7 +1,11 @@
 #include "HeadlessScriptHost.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
+#include <thread>
+#include <vector>
 
 #include <QCoreApplication>
 #include <QDir>
@@ -9,14 +13,41 @@
 #include <QFileDevice>
 #include <QFileInfo>
 #include <QJSEngine>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QTextStream>
 #include <QThread>
 
+#include <Inventor/fields/SoField.h>
+
 #include "benchmark/BenchmarkRunner.h"
 #include "core/CorePluginRegistry.h"
+#include "core/RayTraceCheckpoint.h"
 #include "core/RayTraceRunner.h"
+#include "core/SceneEditor.h"
 #include "core/SceneLoader.h"
 #include "core/TonatiuhCore.h"
+#include "core/TraceResultCache.h"
+#include "kernel/run/FluxAccumulator.h"
+#include "kernel/scene/TSceneKit.h"
+#include "kernel/sun/SunPosition.h"
+#include "libraries/auxiliary/FluxGridFile.h"
+
+// options of tn.traceScene and scene.trace besides the scene
+struct HeadlessScriptTrace
+{
+    ulong rays = 0;
+    ulong seed = 0;
+    FluxAccumulator flux;
+    QStringList fluxFiles;
+    QString checkpointFile;
+    double checkpointInterval = 60.;
+    bool resume = false;
+    bool typedArrays = false;
+    bool powerBudget = false;
+    QString resultCache;
+    QByteArray typesKey; // of the plugins the scene was loaded with
+};
 
 namespace
 {
@@ -86,8 +117,434 @@ QJSValue makeTraceSummary(QJSEngine* engine, const QString& sceneFilePath, ulong
     summary.setProperty("sun_aperture_area", QJSValue(result.sunApertureArea));
     summary.setProperty("irradiance", QJSValue(result.irradiance));
     summary.setProperty("power_per_ray", QJSValue(result.powerPerRay));
+    summary.setProperty("resumed_chunks", QJSValue(static_cast<double>(result.chunksResumed)));
+    summary.setProperty("resumed_rays", QJSValue(static_cast<double>(result.raysResumed)));
+    summary.setProperty("checkpoints_written", QJSValue(result.checkpointsWritten));
+    if (TraceStatistics::isEnabled()) {
+        const TraceStatistics& statistics = result.statistics;
+        QJSValue shapeTests = engine->newObject();
+        for (const TraceStatistics::ShapeTests& shape : statistics.getShapeTests())
+            shapeTests.setProperty(shape.shape, QJSValue(static_cast<double>(shape.count)));
+        QJSValue object = engine->newObject();
+        object.setProperty("rays", QJSValue(static_cast<double>(statistics.rays)));
+        object.setProperty("bounces", QJSValue(static_cast<double>(statistics.bounces)));
+        object.setProperty("hits", QJSValue(static_cast<double>(statistics.hits)));
+        object.setProperty("sun_misses", QJSValue(static_cast<double>(statistics.sunMisses)));
+        object.setProperty("box_tests", QJSValue(static_cast<double>(statistics.boxTests)));
+        object.setProperty("instance_switches", QJSValue(static_cast<double>(statistics.instanceSwitches)));
+        object.setProperty("shape_tests", shapeTests);
+        summary.setProperty("trace_statistics", object);
+    }
     return summary;
 }
+
+// reads options.flux, an array of {surface, side, rows, cols, file}
+bool readFluxTargets(const QJSValue& value, FluxAccumulator* flux, QStringList* files, QString* errorMessage)
+{
+    auto fail = [errorMessage](const QString& message) {
+        if (errorMessage)
+            *errorMessage = message;
+        return false;
+    };
+
+    if (!value.isArray())
+        return fail("options.flux must be an array.");
+    const int count = value.property("length").toInt();
+    for (int n = 0; n < count; ++n) {
+        const QJSValue target = value.property(static_cast<quint32>(n));
+        const QString name = QString("options.flux[%1]").arg(n);
+        if (!target.isObject())
+            return fail(QString("%1 must be an object.").arg(name));
+
+        const QJSValue surface = target.property("surface");
+        if (!surface.isString() || surface.toString().trimmed().isEmpty())
+            return fail(QString("%1.surface must be a non-empty surface URL.").arg(name));
+
+        QString side = "front";
+        const QJSValue sideValue = target.property("side");
+        if (!sideValue.isUndefined()) {
+            side = sideValue.toString();
+            if (!sideValue.isString() || (side != "front" && side != "back"))
+                return fail(QString("%1.side must be \"front\" or \"back\".").arg(name));
+        }
+
+        ulong rows = 0;
+        ulong cols = 0;
+        if (!readIntegerOption(target.property("rows"), name + ".rows", false, &rows, errorMessage) ||
+            !readIntegerOption(target.property("cols"), name + ".cols", false, &cols, errorMessage))
+            return false;
+        if (static_cast<double>(rows) * static_cast<double>(cols) > 1.e7)
+            return fail(QString("%1 must not exceed 10000000 cells.").arg(name));
+
+        QString file;
+        const QJSValue fileValue = target.property("file");
+        if (!fileValue.isUndefined()) {
+            FluxGridFile::Format format;
+            file = fileValue.toString();
+            if (!fileValue.isString() || !FluxGridFile::findFormat(file, &format))
+                return fail(QString("%1.file must be a file name ending in .npy, .npz, .pfm, .f32 or .f64.").arg(name));
+        }
+        files->append(file);
+
+        flux->addTarget(surface.toString(), side == "front", static_cast<int>(rows), static_cast<int>(cols));
+    }
+    return true;
+}
+
+// an opened scene may have been edited, so it is not checkpointed against its file
+bool readTraceOptions(const QJSValue& optionsValue, bool openedScene, HeadlessScriptTrace* trace, QString* errorMessage)
+{
+    auto fail = [errorMessage](const QString& message) {
+        if (errorMessage)
+            *errorMessage = message;
+        return false;
+    };
+
+    const QJSValue raysValue = optionsValue.property("rays");
+    if (raysValue.isUndefined())
+        return fail("options.rays is required.");
+    if (!readIntegerOption(raysValue, "options.rays", false, &trace->rays, errorMessage))
+        return false;
+
+    const QJSValue seedValue = optionsValue.property("seed");
+    if (!seedValue.isUndefined() && !readIntegerOption(seedValue, "options.seed", true, &trace->seed, errorMessage))
+        return false;
+
+    const QJSValue noExportValue = optionsValue.property("noExport");
+    if (!(openedScene && noExportValue.isUndefined()) && (!noExportValue.isBool() || !noExportValue.toBool()))
+        return fail("options.noExport must be true; photon export is not supported in headless scripts.");
+
+    const QJSValue fluxValue = optionsValue.property("flux");
+    if (!fluxValue.isUndefined() && !readFluxTargets(fluxValue, &trace->flux, &trace->fluxFiles, errorMessage))
+        return false;
+
+    const QJSValue checkpointValue = optionsValue.property("checkpoint");
+    if (!checkpointValue.isUndefined()) {
+        if (openedScene)
+            return fail("options.checkpoint is not supported on opened scenes; use tn.traceScene.");
+        if (!checkpointValue.isString() || checkpointValue.toString().trimmed().isEmpty())
+            return fail("options.checkpoint must be a non-empty file path.");
+        trace->checkpointFile = checkpointValue.toString();
+    }
+
+    const QJSValue intervalValue = optionsValue.property("checkpointInterval");
+    if (!intervalValue.isUndefined()) {
+        if (!intervalValue.isNumber() || !(intervalValue.toNumber() >= 0.) || trace->checkpointFile.isEmpty())
+            return fail("options.checkpointInterval must be a non-negative number of seconds and requires options.checkpoint.");
+        trace->checkpointInterval = intervalValue.toNumber();
+    }
+
+    const QJSValue typedArraysValue = optionsValue.property("typedArrays");
+    if (!typedArraysValue.isUndefined() && !typedArraysValue.isBool())
+        return fail("options.typedArrays must be a boolean.");
+    trace->typedArrays = typedArraysValue.toBool();
+
+    const QJSValue powerBudgetValue = optionsValue.property("powerBudget");
+    if (!powerBudgetValue.isUndefined() && !powerBudgetValue.isBool())
+        return fail("options.powerBudget must be a boolean.");
+    trace->powerBudget = powerBudgetValue.toBool();
+
+    const QJSValue resumeValue = optionsValue.property("resume");
+    if (!resumeValue.isUndefined() && (!resumeValue.isBool() || (resumeValue.toBool() && trace->checkpointFile.isEmpty())))
+        return fail("options.resume must be a boolean and requires options.checkpoint.");
+    trace->resume = resumeValue.toBool();
+
+    const QJSValue cacheValue = optionsValue.property("cache");
+    if (!cacheValue.isUndefined()) {
+        if (!cacheValue.isString() || cacheValue.toString().trimmed().isEmpty() || !trace->checkpointFile.isEmpty())
+            return fail("options.cache must be a non-empty directory path and does not support options.checkpoint.");
+        trace->resultCache = cacheValue.toString();
+    }
+    return true;
+}
+
+// numbers as exact decimals, arrays of them as the space-separated vectors of Inventor
+QString fieldText(const QJSValue& value)
+{
+    if (value.isBool())
+        return value.toBool() ? QStringLiteral("TRUE") : QStringLiteral("FALSE");
+    if (value.isNumber())
+        return QString::number(value.toNumber(), 'g', 17);
+    if (value.isArray()) {
+        QStringList items;
+        const int count = value.property("length").toInt();
+        for (int n = 0; n < count; ++n)
+            items << fieldText(value.property(static_cast<quint32>(n)));
+        return items.join(' ');
+    }
+    return value.toString();
+}
+
+// a Float64Array over data; the ArrayBuffer of the engine shares the bytes of data
+QJSValue makeFloat64Array(QJSEngine* engine, const QByteArray& data)
+{
+    const QJSValue buffer = engine->toScriptValue(data);
+    return engine->globalObject().property("Float64Array").callAsConstructor({buffer});
+}
+
+QJSValue makeNumberArray(QJSEngine* engine, const std::vector<double>& values, bool typed)
+{
+    if (typed) {
+        QByteArray data(static_cast<qsizetype>(values.size() * sizeof(double)), Qt::Uninitialized);
+        if (!values.empty())
+            std::memcpy(data.data(), values.data(), data.size());
+        return makeFloat64Array(engine, data);
+    }
+    QJSValue ans = engine->newArray(static_cast<uint>(values.size()));
+    for (size_t index = 0; index < values.size(); ++index)
+        ans.setProperty(static_cast<quint32>(index), QJSValue(values[index]));
+    return ans;
+}
+
+QJSValue makePowerBudgetSummary(QJSEngine* engine, const PowerBudget& budget, const QStringList& surfaces, bool typed)
+{
+    const int count = budget.getSurfaceCount();
+    std::vector<double> columns[6];
+    for (std::vector<double>& column : columns)
+        column.reserve(static_cast<size_t>(count));
+    QJSValue urls = engine->newArray(static_cast<uint>(count));
+    for (int n = 0; n < count; ++n) {
+        urls.setProperty(static_cast<quint32>(n), QJSValue(surfaces.value(n)));
+        const PowerBudget::Side& front = budget.getSide(n, true);
+        const PowerBudget::Side& back = budget.getSide(n, false);
+        columns[0].push_back(front.incident);
+        columns[1].push_back(front.absorbed);
+        columns[2].push_back(front.reflected);
+        columns[3].push_back(back.incident);
+        columns[4].push_back(back.absorbed);
+        columns[5].push_back(back.reflected);
+    }
+
+    QJSValue summary = engine->newObject();
+    summary.setProperty("emitted", QJSValue(budget.getTotal()));
+    summary.setProperty("absorbed", QJSValue(budget.getAbsorbed()));
+    summary.setProperty("missed", QJSValue(budget.getMissed()));
+    summary.setProperty("escaped", QJSValue(budget.getEscaped()));
+    summary.setProperty("air", QJSValue(budget.getAir()));
+    summary.setProperty("roulette", QJSValue(budget.getRoulette()));
+    summary.setProperty("surfaces", urls);
+    const char* names[6] = {"front_incident", "front_absorbed", "front_reflected",
+                            "back_incident", "back_absorbed", "back_reflected"};
+    for (int c = 0; c < 6; ++c)
+        summary.setProperty(names[c], makeNumberArray(engine, columns[c], typed));
+    return summary;
+}
+
+QJSValue makeFluxSummary(QJSEngine* engine, const FluxAccumulator& flux, const QStringList& files, double powerPerRay, bool typed)
+{
+    QJSValue targets = engine->newArray(static_cast<uint>(flux.getTargetCount()));
+    for (int n = 0; n < flux.getTargetCount(); ++n) {
+        const FluxAccumulator::Target& target = flux.getTarget(n);
+        const Box2D& box = flux.getBox(n);
+
+        QJSValue grid;
+        if (typed) {
+            // filled in place, the script sees these bytes without a copy
+            const qsizetype cells = static_cast<qsizetype>(target.rows) * target.cols;
+            QByteArray data(cells * static_cast<qsizetype>(sizeof(double)), Qt::Uninitialized);
+            flux.getFlux(n, powerPerRay, reinterpret_cast<double*>(data.data()));
+            grid = makeFloat64Array(engine, data);
+        } else
+            grid = makeNumberArray(engine, flux.getFlux(n, powerPerRay), false);
+
+        QJSValue summary = engine->newObject();
+        summary.setProperty("surface", QJSValue(target.url));
+        summary.setProperty("side", QJSValue(target.isFront ? QStringLiteral("front") : QStringLiteral("back")));
+        summary.setProperty("rows", QJSValue(target.rows));
+        summary.setProperty("cols", QJSValue(target.cols));
+        summary.setProperty("u_min", QJSValue(box.min().x));
+        summary.setProperty("u_max", QJSValue(box.max().x));
+        summary.setProperty("v_min", QJSValue(box.min().y));
+        summary.setProperty("v_max", QJSValue(box.max().y));
+        summary.setProperty("hits", QJSValue(static_cast<double>(flux.getHits(n))));
+        summary.setProperty("power", QJSValue(static_cast<double>(flux.getHits(n)) * powerPerRay));
+        summary.setProperty("flux", grid);
+        if (!files[n].isEmpty())
+            summary.setProperty("file", QJSValue(absoluteFilePath(files[n])));
+        targets.setProperty(static_cast<quint32>(n), summary);
+    }
+    return targets;
+}
+
+RayTraceOptions makeScriptTraceOptions(HeadlessScriptTrace* trace, const QString& sceneFileName, int workerCount)
+{
+    RayTraceOptions options;
+    options.rays = trace->rays;
+    options.seed = trace->seed;
+    options.workerCount = workerCount;
+    options.chunkSize = 10000;
+    options.outputMode = RayTraceOutputMode::NoOutput;
+    if (trace->flux.getTargetCount() > 0) {
+        options.outputMode = RayTraceOutputMode::FluxGrid;
+        options.fluxAccumulator = &trace->flux;
+    }
+    options.powerBudget = trace->powerBudget;
+    if (!trace->checkpointFile.isEmpty()) {
+        options.checkpointFile = trace->checkpointFile;
+        options.checkpointInterval = trace->checkpointInterval;
+        options.resume = trace->resume;
+        options.checkpointTag = RayTraceCheckpoint::sceneTag(sceneFileName);
+    }
+    return options;
+}
+
+// what a trace summary depends on besides the scene, see TraceResultCache
+QByteArray makeScriptTraceCacheOptions(const HeadlessScriptTrace& trace, const QString& sceneFileName, const RayTraceOptions& options)
+{
+    QString ans = QString("scene=%1 rays=%2 seed=%3 chunk=%4 statistics=%5 power_budget=%6\n")
+        .arg(absoluteFilePath(sceneFileName)).arg(trace.rays).arg(trace.seed).arg(options.chunkSize)
+        .arg(int(TraceStatistics::isEnabled())).arg(int(trace.powerBudget));
+    for (int n = 0; n < trace.flux.getTargetCount(); ++n) {
+        const FluxAccumulator::Target& target = trace.flux.getTarget(n);
+        ans += QString("flux=%1 side=%2 rows=%3 cols=%4 file=%5\n")
+            .arg(target.url, target.isFront ? QStringLiteral("front") : QStringLiteral("back"))
+            .arg(target.rows).arg(target.cols)
+            .arg(trace.fluxFiles[n].isEmpty() ? QString() : absoluteFilePath(trace.fluxFiles[n]));
+    }
+    return ans.toUtf8();
+}
+
+// typed arrays as plain arrays
+QJsonObject summaryToJson(QJSEngine* engine, const QJSValue& summary)
+{
+    QJSValue stringify = engine->evaluate("(function(value) { return JSON.stringify(value, function(key, item) {"
+        " return ArrayBuffer.isView(item) ? Array.from(item) : item; }); })", QStringLiteral("<headless-json>"));
+    return QJsonDocument::fromJson(stringify.call({summary}).toString().toUtf8()).object();
+}
+
+// arrays of numbers as Float64Array if typed, as makeScriptTraceSummary makes them
+QJSValue summaryFromJson(QJSEngine* engine, const QJsonObject& object, bool typed)
+{
+    QJSValue parse = engine->evaluate("(function(text, typed) { return JSON.parse(text, function(key, item) {"
+        " return typed && Array.isArray(item) && item.every(function(x) { return typeof x === 'number'; }) ?"
+        " new Float64Array(item) : item; }); })", QStringLiteral("<headless-json>"));
+    const QString text = QString::fromUtf8(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    return parse.call({QJSValue(text), QJSValue(typed)});
+}
+
+QJSValue makeScriptTraceSummary(QJSEngine* engine, const QString& sceneFileName, const HeadlessScriptTrace& trace, const RayTraceResult& result)
+{
+    QJSValue summary = makeTraceSummary(engine, absoluteFilePath(sceneFileName), trace.rays, trace.seed, result);
+    if (trace.flux.getTargetCount() > 0)
+        summary.setProperty("flux", makeFluxSummary(engine, trace.flux, trace.fluxFiles, result.powerPerRay, trace.typedArrays));
+    if (trace.powerBudget)
+        summary.setProperty("power_budget", makePowerBudgetSummary(engine, result.powerBudget, result.powerBudgetSurfaces, trace.typedArrays));
+    return summary;
+}
+
+// a variant of tn.sweep: its edits of the base scene and its trace
+struct SweepVariant
+{
+    struct Edit
+    {
+        QString url; // empty for the sun
+        QString field;
+        QString value;
+    };
+
+    std::vector<Edit> edits;
+    HeadlessScriptTrace trace;
+    RayTraceResult result;
+    QString error;
+};
+
+// reads options.variants[n], {rays, seed, sun: {azimuth, elevation}, fields: [{url, field, value}]}
+bool readSweepVariant(const QJSValue& value, int n, const QJSValue& optionsValue, SweepVariant* variant, QString* errorMessage)
+{
+    auto fail = [errorMessage](const QString& message) {
+        if (errorMessage)
+            *errorMessage = message;
+        return false;
+    };
+
+    const QString name = QString("options.variants[%1]").arg(n);
+    if (!value.isObject())
+        return fail(QString("%1 must be an object.").arg(name));
+
+    HeadlessScriptTrace& trace = variant->trace;
+    if (!readTraceOptions(optionsValue, true, &trace, errorMessage))
+        return false;
+    for (const QString& file : trace.fluxFiles)
+        if (!file.isEmpty())
+            return fail("options.flux files are not supported by tn.sweep; write the grids of the results instead.");
+    if (!trace.resultCache.isEmpty())
+        return fail("options.cache is not supported by tn.sweep.");
+
+    const QJSValue raysValue = value.property("rays");
+    if (!raysValue.isUndefined() && !readIntegerOption(raysValue, name + ".rays", false, &trace.rays, errorMessage))
+        return false;
+    const QJSValue seedValue = value.property("seed");
+    if (!seedValue.isUndefined() && !readIntegerOption(seedValue, name + ".seed", true, &trace.seed, errorMessage))
+        return false;
+
+    const QJSValue sunValue = value.property("sun");
+    if (!sunValue.isUndefined()) {
+        const QJSValue azimuth = sunValue.property("azimuth");
+        const QJSValue elevation = sunValue.property("elevation");
+        if (!sunValue.isObject() || !azimuth.isNumber() || !elevation.isNumber())
+            return fail(QString("%1.sun must be an object {azimuth, elevation} in degrees.").arg(name));
+        QString sunError;
+        if (!SceneEditor::checkSunAngles(azimuth.toNumber(), elevation.toNumber(), &sunError))
+            return fail(QString("%1.sun: %2").arg(name, sunError));
+        variant->edits.push_back(SweepVariant::Edit{QString(), "azimuth", fieldText(azimuth)});
+        variant->edits.push_back(SweepVariant::Edit{QString(), "elevation", fieldText(elevation)});
+    }
+
+    const QJSValue fieldsValue = value.property("fields");
+    if (!fieldsValue.isUndefined()) {
+        if (!fieldsValue.isArray())
+            return fail(QString("%1.fields must be an array.").arg(name));
+        const int count = fieldsValue.property("length").toInt();
+        for (int f = 0; f < count; ++f) {
+            const QJSValue edit = fieldsValue.property(static_cast<quint32>(f));
+            const QJSValue url = edit.property("url");
+            const QJSValue field = edit.property("field");
+            if (!edit.isObject() || !url.isString() || !field.isString() || edit.property("value").isUndefined())
+                return fail(QString("%1.fields[%2] must be an object {url, field, value}.").arg(name).arg(f));
+            variant->edits.push_back(SweepVariant::Edit{url.toString(), field.toString(), fieldText(edit.property("value"))});
+        }
+    }
+    return true;
+}
+
+// applies the edits of variant to scene, keeping the previous values in undo
+bool applySweepVariant(TSceneKit* scene, const SweepVariant& variant, std::vector<std::pair<SoField*, SbString>>* undo, QString* errorMessage)
+{
+    SunPosition* sunPosition = static_cast<SunPosition*>(scene->getPart("world.sun.position", false));
+    for (const SweepVariant::Edit& edit : variant.edits) {
+        SoField* field = nullptr;
+        if (edit.url.isEmpty()) {
+            if (!sunPosition) {
+                if (errorMessage)
+                    *errorMessage = "The scene has no sun position.";
+                return false;
+            }
+            field = sunPosition->getField(edit.field.toLatin1().data());
+        } else if (!(field = SceneEditor::findField(scene, edit.url, edit.field, errorMessage)))
+            return false;
+
+        SbString previous;
+        field->get(previous);
+        undo->push_back({field, previous});
+        if (!SceneEditor::setField(field, edit.value)) {
+            if (errorMessage)
+                *errorMessage = QString("\"%1\" is not a value of %2 of %3.").arg(edit.value, edit.field, edit.url);
+            return false;
+        }
+    }
+    SceneEditor::followEdits(scene);
+    return true;
+}
+
+// restores the values of undo in reverse order
+void undoSweepVariant(TSceneKit* scene, std::vector<std::pair<SoField*, SbString>>* undo)
+{
+    for (auto it = undo->rbegin(); it != undo->rend(); ++it)
+        it->first->set(it->second.getString());
+    if (!undo->empty())
+        SceneEditor::followEdits(scene);
+    undo->clear();
+}
 }
 
 HeadlessScriptApi::HeadlessScriptApi(QJSEngine* engine, QObject* parent)
@@ -96,6 +553,12 @@ HeadlessScriptApi::HeadlessScriptApi(QJSEngine* engine, QObject* parent)
 {
 }
 
+HeadlessScriptApi::~HeadlessScriptApi()
+{
+    // the scenes go before the plugins of their nodes
+    qDeleteAll(findChildren<HeadlessSceneHandle*>(QString(), Qt::FindDirectChildrenOnly));
+}
+
 void HeadlessScriptApi::print(const QJSValue& value)
 {
     QTextStream out(stdout);
@@ -173,6 +636,7 @@ int HeadlessScriptApi::runBenchmark(const QString& configFileName)
         recordError(QString("tn.runBenchmark failed for %1: %2").arg(absoluteFilePath(configFileName), errorMessage));
         return 1;
     }
+    benchmarkRunner.prepareScene(configFileName);
 
     TonatiuhCore::initializeCoin();
     CorePluginRegistry plugins;
@@ -208,27 +672,13 @@ QJSValue HeadlessScriptApi::traceScene(const QJSValue& optionsValue)
         return QJSValue();
     }
 
-    ulong rays = 0;
+    HeadlessScriptTrace trace;
     QString errorMessage;
-    const QJSValue raysValue = optionsValue.property("rays");
-    if (raysValue.isUndefined() || !readIntegerOption(raysValue, "options.rays", false, &rays, &errorMessage)) {
-        recordError(QString("tn.traceScene failed: %1").arg(errorMessage.isEmpty() ? QStringLiteral("options.rays is required.") : errorMessage));
-        return QJSValue();
-    }
-
-    ulong seed = 0;
-    const QJSValue seedValue = optionsValue.property("seed");
-    if (!seedValue.isUndefined() && !readIntegerOption(seedValue, "options.seed", true, &seed, &errorMessage)) {
+    if (!readTraceOptions(optionsValue, false, &trace, &errorMessage)) {
         recordError(QString("tn.traceScene failed: %1").arg(errorMessage));
         return QJSValue();
     }
 
-    const QJSValue noExportValue = optionsValue.property("noExport");
-    if (!noExportValue.isBool() || !noExportValue.toBool()) {
-        recordError("tn.traceScene failed: options.noExport must be true; photon export is not supported in headless scripts.");
-        return QJSValue();
-    }
-
     const QString sceneFileName = sceneValue.toString();
     TonatiuhCore::initializeCoin();
     CorePluginRegistry plugins;
@@ -239,28 +689,329 @@ QJSValue HeadlessScriptApi::traceScene(const QJSValue& optionsValue)
         recordError(QString("tn.traceScene failed while loading %1: %2").arg(absoluteFilePath(sceneFileName), errorMessage));
         return QJSValue();
     }
+    trace.typesKey = plugins.typesKey();
 
-    RayTraceOptions options;
-    options.rays = rays;
-    options.seed = seed;
-    options.workerCount = qMax(1, QThread::idealThreadCount());
-    options.chunkSize = 10000;
-    options.outputMode = RayTraceOutputMode::NoOutput;
+    return traceLoadedScene("tn.traceScene", scene.get(), sceneFileName, &trace);
+}
+
+QJSValue HeadlessScriptApi::openScene(const QString& fileName)
+{
+    if (!m_engine) {
+        recordError("tn.openScene failed: script engine is not available.");
+        return QJSValue();
+    }
+    if (fileName.trimmed().isEmpty()) {
+        recordError("tn.openScene failed: scene path must not be empty.");
+        return QJSValue();
+    }
+
+    loadOpenScenePlugins(fileName);
+
+    std::unique_ptr<LoadedScene> scene(new LoadedScene);
+    QString errorMessage;
+    if (!SceneLoader::readFile(fileName, scene.get(), &errorMessage)) {
+        recordError(QString("tn.openScene failed for %1: %2").arg(absoluteFilePath(fileName), errorMessage));
+        return QJSValue();
+    }
+
+    HeadlessSceneHandle* handle = new HeadlessSceneHandle(this, absoluteFilePath(fileName), std::move(scene));
+    return m_engine->newQObject(handle);
+}
+
+/*!
+ * Traces the variants of options.variants, each an edit of the base scene
+ * options.scene, and returns their summaries in order. Up to
+ * options.concurrency variants are traced at once, by default as many as
+ * there are cores, each on its own copy of the scene with its share of the
+ * cores. A copy is loaded once and its edits are undone after each variant.
+ */
+QJSValue HeadlessScriptApi::sweep(const QJSValue& optionsValue)
+{
+    if (!m_engine) {
+        recordError("tn.sweep failed: script engine is not available.");
+        return QJSValue();
+    }
+    if (!optionsValue.isObject()) {
+        recordError("tn.sweep failed: options must be an object.");
+        return QJSValue();
+    }
+
+    const QJSValue sceneValue = optionsValue.property("scene");
+    if (!sceneValue.isString() || sceneValue.toString().trimmed().isEmpty()) {
+        recordError("tn.sweep failed: options.scene must be a non-empty scene path.");
+        return QJSValue();
+    }
+    const QJSValue variantsValue = optionsValue.property("variants");
+    const int count = variantsValue.isArray() ? variantsValue.property("length").toInt() : 0;
+    if (count < 1) {
+        recordError("tn.sweep failed: options.variants must be a non-empty array.");
+        return QJSValue();
+    }
+
+    QString errorMessage;
+    std::vector<std::unique_ptr<SweepVariant>> variants;
+    for (int n = 0; n < count; ++n) {
+        variants.emplace_back(new SweepVariant);
+        if (!readSweepVariant(variantsValue.property(static_cast<quint32>(n)), n, optionsValue, variants.back().get(), &errorMessage)) {
+            recordError(QString("tn.sweep failed: %1").arg(errorMessage));
+            return QJSValue();
+        }
+    }
+
+    const int cores = qMax(1, QThread::idealThreadCount());
+    ulong concurrency = static_cast<ulong>(qMin(count, cores));
+    const QJSValue concurrencyValue = optionsValue.property("concurrency");
+    if (!concurrencyValue.isUndefined() && !readIntegerOption(concurrencyValue, "options.concurrency", false, &concurrency, &errorMessage)) {
+        recordError(QString("tn.sweep failed: %1").arg(errorMessage));
+        return QJSValue();
+    }
+    const int slots = static_cast<int>(qMin<ulong>(concurrency, static_cast<ulong>(count)));
+    const int workerCount = qMax(1, cores / slots);
+
+    // Coin reads and edits scenes on this thread only; the traces of the copies run meanwhile
+    const QString sceneFileName = sceneValue.toString();
+    loadOpenScenePlugins(sceneFileName);
+    std::vector<std::unique_ptr<LoadedScene>> scenes;
+    for (int s = 0; s < slots; ++s) {
+        scenes.emplace_back(new LoadedScene);
+        if (!SceneLoader::readFile(sceneFileName, scenes.back().get(), &errorMessage)) {
+            recordError(QString("tn.sweep failed while loading %1: %2").arg(absoluteFilePath(sceneFileName), errorMessage));
+            return QJSValue();
+        }
+    }
+
+    std::vector<std::vector<std::pair<SoField*, SbString>>> undo(static_cast<size_t>(slots));
+    for (int begin = 0; begin < count; begin += slots) {
+        const int end = qMin(count, begin + slots);
+        for (int n = begin; n < end; ++n) {
+            TSceneKit* scene = scenes[static_cast<size_t>(n - begin)]->get();
+            if (!applySweepVariant(scene, *variants[static_cast<size_t>(n)], &undo[static_cast<size_t>(n - begin)], &errorMessage)) {
+                recordError(QString("tn.sweep failed for options.variants[%1]: %2").arg(n).arg(errorMessage));
+                return QJSValue();
+            }
+        }
+
+        std::vector<std::thread> threads;
+        for (int n = begin; n < end; ++n)
+            threads.emplace_back([&, n]() {
+                SweepVariant& variant = *variants[static_cast<size_t>(n)];
+                const RayTraceOptions options = makeScriptTraceOptions(&variant.trace, sceneFileName, workerCount);
+                RayTraceRunner runner;
+                if (!runner.trace(scenes[static_cast<size_t>(n - begin)]->get(), options, &variant.result, &variant.error) && variant.error.isEmpty())
+                    variant.error = "The trace failed.";
+            });
+        for (std::thread& thread : threads)
+            thread.join();
+
+        for (int s = 0; s < end - begin; ++s)
+            undoSweepVariant(scenes[static_cast<size_t>(s)]->get(), &undo[static_cast<size_t>(s)]);
+    }
+
+    QJSValue results = m_engine->newArray(static_cast<uint>(count));
+    bool failed = false;
+    for (int n = 0; n < count; ++n) {
+        const SweepVariant& variant = *variants[static_cast<size_t>(n)];
+        if (!variant.error.isEmpty()) {
+            recordError(QString("tn.sweep failed for options.variants[%1]: %2").arg(n).arg(variant.error));
+            failed = true;
+            continue;
+        }
+        QJSValue summary = makeScriptTraceSummary(m_engine, sceneFileName, variant.trace, variant.result);
+        summary.setProperty("variant", QJSValue(n));
+        results.setProperty(static_cast<quint32>(n), summary);
+    }
+    return failed ? QJSValue() : results;
+}
+
+QJSValue HeadlessScriptApi::traceLoadedScene(const QString& apiName, TSceneKit* scene, const QString& sceneFileName, HeadlessScriptTrace* trace)
+{
+    RayTraceOptions options = makeScriptTraceOptions(trace, sceneFileName, qMax(1, QThread::idealThreadCount()));
+
+    // a trace of the same scene and options gives the summary and flux files it stored
+    QString resultKey;
+    QStringList resultFileNames;
+    if (!trace->resultCache.isEmpty()) {
+        for (const QString& file : trace->fluxFiles)
+            if (!file.isEmpty())
+                resultFileNames << file;
+        resultKey = TraceResultCache::key("script-trace", scene, trace->typesKey, makeScriptTraceCacheOptions(*trace, sceneFileName, options));
+        QJsonObject stored;
+        if (TraceResultCache(trace->resultCache).restore(resultKey, resultFileNames, &stored)) {
+            QJSValue summary = summaryFromJson(m_engine, stored, trace->typedArrays);
+            summary.setProperty("result_cache", QJSValue(QStringLiteral("hit")));
+            return summary;
+        }
+    }
 
     RayTraceResult result;
     RayTraceRunner runner;
-    if (!runner.trace(scene.get(), options, &result, &errorMessage)) {
-        recordError(QString("tn.traceScene failed for %1: %2").arg(absoluteFilePath(sceneFileName), errorMessage));
+    QString errorMessage;
+    if (!runner.trace(scene, options, &result, &errorMessage)) {
+        recordError(QString("%1 failed for %2: %3").arg(apiName, absoluteFilePath(sceneFileName), errorMessage));
         return QJSValue();
     }
 
-    return makeTraceSummary(m_engine, absoluteFilePath(sceneFileName), rays, seed, result);
+    const FluxAccumulator& flux = trace->flux;
+    for (int n = 0; n < flux.getTargetCount(); ++n) {
+        FluxGridFile::Format format;
+        if (trace->fluxFiles[n].isEmpty() || !FluxGridFile::findFormat(trace->fluxFiles[n], &format))
+            continue;
+        const FluxAccumulator::Target& target = flux.getTarget(n);
+        if (!FluxGridFile::write(trace->fluxFiles[n], format, target.rows, target.cols, flux.getFlux(n, result.powerPerRay), &errorMessage)) {
+            recordError(QString("%1 failed: %2").arg(apiName, errorMessage));
+            return QJSValue();
+        }
+    }
+
+    QJSValue summary = makeScriptTraceSummary(m_engine, sceneFileName, *trace, result);
+    if (!trace->resultCache.isEmpty()) {
+        if (!TraceResultCache(trace->resultCache).store(resultKey, summaryToJson(m_engine, summary), resultFileNames, &errorMessage)) {
+            recordError(QString("%1 failed: %2").arg(apiName, errorMessage));
+            return QJSValue();
+        }
+        summary.setProperty("result_cache", QJSValue(QStringLiteral("miss")));
+    }
+    return summary;
+}
+
+HeadlessSceneHandle::HeadlessSceneHandle(HeadlessScriptApi* api, const QString& fileName, std::unique_ptr<LoadedScene> scene)
+    : QObject(api)
+    , m_api(api)
+    , m_fileName(fileName)
+    , m_scene(std::move(scene))
+{
+}
+
+HeadlessSceneHandle::~HeadlessSceneHandle()
+{
+}
+
+bool HeadlessSceneHandle::setField(const QString& url, const QString& field, const QJSValue& value)
+{
+    if (!m_scene) {
+        m_api->recordError("scene.setField failed: the scene is closed.");
+        return false;
+    }
+
+    QString errorMessage;
+    SoField* target = SceneEditor::findField(m_scene->get(), url, field, &errorMessage);
+    const QString text = fieldText(value);
+    if (target && !SceneEditor::setField(target, text))
+        errorMessage = QString("\"%1\" is not a value of %2 of %3.").arg(text, field, url);
+    if (!target || !errorMessage.isEmpty()) {
+        m_api->recordError(QString("scene.setField failed: %1").arg(errorMessage));
+        return false;
+    }
+    m_edited = true;
+    return true;
+}
+
+bool HeadlessSceneHandle::setFields(const QJSValue& urls, const QString& field, const QJSValue& values)
+{
+    if (!m_scene) {
+        m_api->recordError("scene.setFields failed: the scene is closed.");
+        return false;
+    }
+    if (!urls.isArray()) {
+        m_api->recordError("scene.setFields failed: urls must be an array of node URLs.");
+        return false;
+    }
+
+    QString errorMessage;
+    std::vector<SoNode*> nodes;
+    const int count = urls.property("length").toInt();
+    nodes.reserve(size_t(std::max(count, 0)));
+    for (int n = 0; n < count; ++n) {
+        SoNode* node = SceneEditor::findNode(m_scene->get(), urls.property(quint32(n)).toString(), &errorMessage);
+        if (!node) {
+            m_api->recordError(QString("scene.setFields failed: %1").arg(errorMessage));
+            return false;
+        }
+        nodes.push_back(node);
+    }
+    QStringList texts;
+    if (values.isArray() && values.property("length").toInt() == count) {
+        for (int n = 0; n < count; ++n)
+            texts << fieldText(values.property(quint32(n)));
+    } else
+        texts << fieldText(values);
+
+    if (!SceneEditor::setFields(nodes, field, texts, &errorMessage)) {
+        m_api->recordError(QString("scene.setFields failed: %1").arg(errorMessage));
+        return false;
+    }
+    m_edited = true;
+    return true;
+}
+
+bool HeadlessSceneHandle::setSun(double azimuth, double elevation)
+{
+    if (!m_scene) {
+        m_api->recordError("scene.setSun failed: the scene is closed.");
+        return false;
+    }
+    QString errorMessage;
+    if (!SceneEditor::setSun(m_scene->get(), azimuth, elevation, &errorMessage)) {
+        m_api->recordError(QString("scene.setSun failed: %1").arg(errorMessage));
+        return false;
+    }
+    m_edited = true;
+    return true;
+}
+
+QJSValue HeadlessSceneHandle::trace(const QJSValue& optionsValue)
+{
+    if (!m_scene) {
+        m_api->recordError("scene.trace failed: the scene is closed.");
+        return QJSValue();
+    }
+    if (!optionsValue.isObject()) {
+        m_api->recordError("scene.trace failed: options must be an object.");
+        return QJSValue();
+    }
+
+    HeadlessScriptTrace trace;
+    QString errorMessage;
+    if (!readTraceOptions(optionsValue, true, &trace, &errorMessage)) {
+        m_api->recordError(QString("scene.trace failed: %1").arg(errorMessage));
+        return QJSValue();
+    }
+
+    // only edits since the last trace are followed: the sensors of the
+    // edited nodes, then the trackers for the sun and the moved frames
+    TSceneKit* scene = m_scene->get();
+    if (m_edited) {
+        SceneEditor::followEdits(scene);
+        m_edited = false;
+    }
+    TonatiuhCore::setProjectSearchPaths(m_fileName);
+    trace.typesKey = m_api->m_plugins->typesKey();
+    return m_api->traceLoadedScene("scene.trace", scene, m_fileName, &trace);
+}
+
+void HeadlessSceneHandle::close()
+{
+    m_scene.reset();
+}
+
+// the plugins of every opened scene stay loaded with the api
+void HeadlessScriptApi::loadOpenScenePlugins(const QString& fileName)
+{
+    TonatiuhCore::initializeCoin();
+    if (!m_plugins) {
+        m_plugins.reset(new CorePluginRegistry);
+        m_plugins->loadScenePlugins(TonatiuhCore::pluginSearchPaths(QCoreApplication::applicationDirPath()));
+    }
+    m_plugins->loadScenePluginsFor(fileName);
+    TonatiuhCore::setProjectSearchPaths(fileName);
 }
 
 void HeadlessScriptApi::initializeSceneServices(const QString& fileName, CorePluginRegistry* plugins) const
 {
-    if (plugins)
+    if (plugins) {
         plugins->loadScenePlugins(TonatiuhCore::pluginSearchPaths(QCoreApplication::applicationDirPath()));
+        plugins->loadScenePluginsFor(fileName);
+    }
     TonatiuhCore::setProjectSearchPaths(fileName);
 }
 
@@ -384,6 +1135,12 @@ int HeadlessScriptHost::runScript(const QString& fileName) const
     },
     traceScene: function(options) {
       return api.traceScene(options);
+    },
+    openScene: function(path) {
+      return api.openScene(requirePath("tn.openScene", path));
+    },
+    sweep: function(options) {
+      return api.sweep(options);
     }
   };
 
@@ -397,7 +1154,7 @@ int HeadlessScriptHost::runScript(const QString& fileName) const
           return undefined;
         }
         return function() {
-          throw new Error("Headless script API does not support '" + String(property) + "'. Available APIs: print(value), tn.writeJson(path, value), tn.validateScene(path), tn.runBenchmark(path), tn.traceScene(options).");
+          throw new Error("Headless script API does not support '" + String(property) + "'. Available APIs: print(value), tn.writeJson(path, value), tn.validateScene(path), tn.runBenchmark(path), tn.traceScene(options), tn.openScene(path), tn.sweep(options).");
         };
       }
     });
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include <QObject>
 #include <QJSValue>
 #include <QString>
@@ -7,6 +9,10 @@
 
 class QJSEngine;
 class CorePluginRegistry;
+class HeadlessSceneHandle;
+class LoadedScene;
+class TSceneKit;
+struct HeadlessScriptTrace;
 
 class HeadlessScriptApi : public QObject
 {
@@ -14,17 +20,24 @@ class HeadlessScriptApi : public QObject
 
 public:
     explicit HeadlessScriptApi(QJSEngine* engine, QObject* parent = nullptr);
+    ~HeadlessScriptApi() override;
 
     Q_INVOKABLE void print(const QJSValue& value);
     Q_INVOKABLE bool writeJson(const QString& fileName, const QJSValue& value);
     Q_INVOKABLE bool validateScene(const QString& fileName);
     Q_INVOKABLE int runBenchmark(const QString& configFileName);
     Q_INVOKABLE QJSValue traceScene(const QJSValue& options);
+    Q_INVOKABLE QJSValue openScene(const QString& fileName);
+    Q_INVOKABLE QJSValue sweep(const QJSValue& options);
 
     bool hasErrors() const { return !m_errors.isEmpty(); }
     QStringList errors() const { return m_errors; }
 
 private:
+    friend class HeadlessSceneHandle;
+
+    void loadOpenScenePlugins(const QString& fileName);
+    QJSValue traceLoadedScene(const QString& apiName, TSceneKit* scene, const QString& sceneFileName, HeadlessScriptTrace* trace);
     void initializeSceneServices(const QString& fileName, CorePluginRegistry* plugins) const;
     void recordError(const QString& message);
     QString toDisplayString(const QJSValue& value) const;
@@ -32,6 +45,41 @@ private:
 
     QJSEngine* m_engine = nullptr;
     QStringList m_errors;
+    std::unique_ptr<CorePluginRegistry> m_plugins; // of opened scenes
+};
+
+//! HeadlessSceneHandle is a scene kept loaded by tn.openScene for repeated traces.
+/*!
+ * Parameter studies edit node fields and the sun between traces of the
+ * same scene, without reading the file or loading plugins again. Before a
+ * trace only the edits since the previous one are followed: the pending
+ * node sensors run and the trackers are aimed again. The handle belongs to
+ * the script api and close() releases the scene early.
+ */
+class HeadlessSceneHandle : public QObject
+{
+    Q_OBJECT
+
+public:
+    HeadlessSceneHandle(HeadlessScriptApi* api, const QString& fileName, std::unique_ptr<LoadedScene> scene);
+    ~HeadlessSceneHandle() override;
+
+    // url as //Layout/Node, field as name or part.name, value as an Inventor field string,
+    // number, boolean or array of numbers
+    Q_INVOKABLE bool setField(const QString& url, const QString& field, const QJSValue& value);
+    // the field of every node of urls, values an array with one value per URL or a single value for all
+    Q_INVOKABLE bool setFields(const QJSValue& urls, const QString& field, const QJSValue& values);
+    // in degrees
+    Q_INVOKABLE bool setSun(double azimuth, double elevation);
+    // the options of tn.traceScene without scene and checkpoints
+    Q_INVOKABLE QJSValue trace(const QJSValue& options);
+    Q_INVOKABLE void close();
+
+private:
+    HeadlessScriptApi* m_api;
+    QString m_fileName;
+    std::unique_ptr<LoadedScene> m_scene;
+    bool m_edited = false;
 };
 
 class HeadlessScriptHost
@@ -0,0 +1,292 @@
+#include "HeadlessServer.h"
+
+#include <list>
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTextStream>
+#include <QThread>
+
+#include "benchmark/AnnualRunner.h"
+#include "benchmark/BenchmarkRunner.h"
+#include "core/CorePluginRegistry.h"
+#include "core/RayTraceRunner.h"
+#include "core/SceneLoader.h"
+#include "core/ScenePatch.h"
+#include "core/TonatiuhCore.h"
+
+// loaded scenes by path, the least recently used dropped first
+struct HeadlessServer::SceneCache
+{
+    struct Entry
+    {
+        QString fileName;
+        QDateTime modified;
+        QByteArray key; // SHA-256 of the file
+        std::unique_ptr<LoadedScene> scene;
+        ScenePatch patch; // applied, kept for the next job of the same patch
+        QByteArray patchKey;
+    };
+
+    int capacity;
+    CorePluginRegistry plugins;
+    std::list<Entry> entries; // most recent first
+};
+
+HeadlessServer::HeadlessServer(int sceneCacheSize):
+    m_scenes(new SceneCache)
+{
+    m_scenes->capacity = qMax(1, sceneCacheSize);
+}
+
+HeadlessServer::~HeadlessServer()
+{
+
+}
+
+/*!
+ * Reads jobs from \a in until it ends or a shutdown job, and answers each
+ * on \a out. Coin and the scene plugins are initialized once; the console
+ * output of a job is returned in its reply as "log".
+ */
+int HeadlessServer::run(QTextStream& in, QTextStream& out)
+{
+    initialize();
+
+    QString line;
+    bool shutdown = false;
+    while (!shutdown && in.readLineInto(&line))
+    {
+        if (line.trimmed().isEmpty()) continue;
+        out << runLine(line, &shutdown) << Qt::endl;
+    }
+    return 0;
+}
+
+/*!
+ * Listens on the local socket \a name, a named pipe on Windows, and runs
+ * the jobs of each client as run does those of stdin, until a shutdown job.
+ * Clients are served one at a time, the next waiting until the previous one
+ * disconnects; the scenes stay loaded between them. A socket left by a server
+ * that did not end is removed. The socket name is printed on \a out once it
+ * listens, errors on \a err.
+ */
+int HeadlessServer::listen(const QString& name, QTextStream& out, QTextStream& err)
+{
+    QLocalServer server;
+    if (!server.listen(name)) {
+        if (server.serverError() != QAbstractSocket::AddressInUseError || !QLocalServer::removeServer(name) || !server.listen(name)) {
+            err << "Server failed to listen on " << name << ": " << server.errorString() << Qt::endl;
+            return 1;
+        }
+    }
+    initialize();
+    out << "Listening on " << server.fullServerName() << Qt::endl;
+
+    bool shutdown = false;
+    while (!shutdown && server.waitForNewConnection(-1))
+    {
+        std::unique_ptr<QLocalSocket> socket(server.nextPendingConnection());
+        while (!shutdown && socket)
+        {
+            // the last job may end without a newline when the client disconnects
+            if (!socket->canReadLine()) {
+                if (socket->state() == QLocalSocket::ConnectedState && socket->waitForReadyRead(-1))
+                    continue;
+                if (socket->bytesAvailable() == 0)
+                    break;
+            }
+            const QString line = QString::fromUtf8(socket->readLine()).trimmed();
+            if (line.isEmpty()) continue;
+            socket->write(runLine(line, &shutdown) + '\n');
+            socket->waitForBytesWritten(-1);
+        }
+        if (socket && socket->state() == QLocalSocket::ConnectedState) {
+            socket->disconnectFromServer();
+            if (socket->state() != QLocalSocket::UnconnectedState)
+                socket->waitForDisconnected(1000);
+        }
+    }
+    if (!shutdown) {
+        err << "Server stopped: " << server.errorString() << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
+
+void HeadlessServer::initialize()
+{
+    TonatiuhCore::initializeCoin();
+    m_scenes->plugins.loadScenePlugins(TonatiuhCore::pluginSearchPaths(QCoreApplication::applicationDirPath()));
+}
+
+QByteArray HeadlessServer::runLine(const QString& line, bool* shutdown)
+{
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(line.toUtf8(), &parseError);
+    QJsonObject reply;
+    if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+        reply["ok"] = false;
+        reply["error"] = "A job must be a JSON object on one line.";
+    } else {
+        const QJsonObject job = document.object();
+        reply = runJob(job, shutdown);
+        if (job.contains("id"))
+            reply["id"] = job.value("id");
+    }
+    return QJsonDocument(reply).toJson(QJsonDocument::Compact);
+}
+
+QJsonObject HeadlessServer::runJob(const QJsonObject& job, bool* shutdown)
+{
+    QJsonObject reply;
+    QString errorMessage;
+    QString log;
+    bool cached = false;
+    QByteArray sceneKey;
+    int exitCode = 1;
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString command = job.value("command").toString();
+    if (command == "shutdown") {
+        *shutdown = true;
+        exitCode = 0;
+    } else if (command == "benchmark" || command == "annual") {
+        const QString configFileName = job.value("config").toString();
+        BenchmarkRunner benchmarkRunner;
+        AnnualRunner annualRunner;
+        const QString sceneFileName = command == "benchmark" ?
+            benchmarkRunner.sceneFileName(configFileName, &errorMessage) :
+            annualRunner.sceneFileName(configFileName, &errorMessage);
+        if (!sceneFileName.isEmpty()) {
+            if (command == "benchmark")
+                benchmarkRunner.prepareScene(configFileName);
+            if (TSceneKit* scene = findScene(sceneFileName, &sceneKey, ScenePatch(), &cached, &errorMessage)) {
+                exitCode = command == "benchmark" ?
+                    benchmarkRunner.run(configFileName, scene, &errorMessage, &log) :
+                    annualRunner.run(configFileName, scene, &errorMessage, &log);
+            }
+        }
+    } else if (command == "trace") {
+        const QString sceneFileName = job.value("scene").toString();
+        sceneKey = QByteArray::fromHex(job.value("scene_sha256").toString().toLatin1());
+        const double rays = job.value("rays").toDouble();
+        ScenePatch patch;
+        if ((sceneFileName.isEmpty() && !job.contains("scene_sha256")) || !(rays >= 1.)) {
+            errorMessage = "trace requires a scene or its scene_sha256 and a positive ray count.";
+        } else if (job.contains("scene_sha256") && sceneKey.size() != 32) {
+            errorMessage = "scene_sha256 must be 64 hexadecimal digits.";
+        } else if (!job.contains("patch") || patch.fromJson(job.value("patch"), &errorMessage)) {
+            if (TSceneKit* scene = findScene(sceneFileName, &sceneKey, patch, &cached, &errorMessage)) {
+                RayTraceOptions options;
+                options.rays = static_cast<ulong>(rays);
+                options.seed = static_cast<ulong>(job.value("seed").toDouble());
+                options.workerCount = job.value("worker_count").toInt(qMax(1, QThread::idealThreadCount()));
+                options.chunkSize = 10000;
+                RayTraceResult result;
+                RayTraceRunner runner;
+                if (runner.trace(scene, options, &result, &errorMessage)) {
+                    reply["rays_traced"] = static_cast<double>(result.raysTraced);
+                    reply["rays_per_second"] = result.raysPerSecond;
+                    reply["worker_count"] = result.workerCount;
+                    exitCode = 0;
+                }
+            }
+        }
+    } else {
+        errorMessage = QString("Unknown job command: %1.").arg(command);
+    }
+
+    reply["ok"] = exitCode == 0;
+    reply["exit_code"] = exitCode;
+    if (exitCode != 0)
+        reply["error"] = errorMessage;
+    reply["scene_cached"] = cached;
+    if (!sceneKey.isEmpty())
+        reply["scene_sha256"] = QString::fromLatin1(sceneKey.toHex());
+    reply["elapsed_seconds"] = static_cast<double>(timer.elapsed()) / 1000.;
+    if (!log.isEmpty())
+        reply["log"] = log;
+    return reply;
+}
+
+// the scene is read again if its file changed since it was cached
+TSceneKit* HeadlessServer::findScene(const QString& fileName, QByteArray* key, const ScenePatch& patch, bool* cached, QString* errorMessage)
+{
+    std::list<SceneCache::Entry>& entries = m_scenes->entries;
+    auto found = entries.end();
+    *cached = true;
+    if (fileName.isEmpty()) {
+        for (auto it = entries.begin(); it != entries.end() && found == entries.end(); ++it)
+            if (it->key == *key)
+                found = it;
+        if (found == entries.end()) {
+            *errorMessage = QString("Scene %1 is not loaded; run a job with its file first.").arg(QString::fromLatin1(key->toHex()));
+            return nullptr;
+        }
+        TonatiuhCore::setProjectSearchPaths(found->fileName);
+    } else {
+        const QFileInfo info(fileName);
+        const QString path = info.absoluteFilePath();
+        const QDateTime modified = info.lastModified();
+        TonatiuhCore::setProjectSearchPaths(path);
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->fileName != path) continue;
+            if (it->modified == modified)
+                found = it;
+            else
+                entries.erase(it);
+            break;
+        }
+        if (found == entries.end()) {
+            *cached = false;
+            QFile file(path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                *errorMessage = QString("Scene %1 cannot be read.").arg(path);
+                return nullptr;
+            }
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            hash.addData(&file);
+
+            m_scenes->plugins.loadScenePluginsFor(path);
+            std::unique_ptr<LoadedScene> scene(new LoadedScene);
+            if (!SceneLoader::readFile(path, scene.get(), errorMessage))
+                return nullptr;
+            entries.push_front(SceneCache::Entry{path, modified, hash.result(), std::move(scene), ScenePatch(), QByteArray()});
+            while (static_cast<int>(entries.size()) > m_scenes->capacity)
+                entries.pop_back();
+            found = entries.begin();
+        }
+        if (!key->isEmpty() && *key != found->key) {
+            *errorMessage = QString("scene_sha256 is not that of scene %1.").arg(path);
+            return nullptr;
+        }
+    }
+    entries.splice(entries.begin(), entries, found);
+    SceneCache::Entry& entry = entries.front();
+    *key = entry.key;
+
+    // the scene of the file turned into that of the job, unless the last job left it so
+    TSceneKit* scene = entry.scene->get();
+    const QByteArray patchKey = patch.getKey();
+    if (entry.patchKey != patchKey) {
+        entry.patch.undo();
+        entry.patch = patch;
+        entry.patchKey.clear();
+        if (!entry.patch.apply(scene, errorMessage)) {
+            entry.patch = ScenePatch();
+            return nullptr;
+        }
+        entry.patchKey = patchKey;
+    }
+    return scene;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+
+#include <QString>
+
+#include <QByteArray>
+
+class QJsonObject;
+class QTextStream;
+class ScenePatch;
+class TSceneKit;
+
+// long-lived headless mode: one JSON job per line in, one JSON reply per line out
+class HeadlessServer
+{
+public:
+    explicit HeadlessServer(int sceneCacheSize = 4);
+    ~HeadlessServer();
+
+    int run(QTextStream& in, QTextStream& out);
+    // the same jobs from the clients of a local socket, one client at a time
+    int listen(const QString& name, QTextStream& out, QTextStream& err);
+
+private:
+    struct SceneCache;
+
+    void initialize();
+    // the reply line to a job line
+    QByteArray runLine(const QString& line, bool* shutdown);
+    QJsonObject runJob(const QJsonObject& job, bool* shutdown);
+    // by path, or by *key alone if fileName is empty; *key gets that of the
+    // scene found, which is turned into patch, or into its file without one
+    TSceneKit* findScene(const QString& fileName, QByteArray* key, const ScenePatch& patch, bool* cached, QString* errorMessage);
+
+    std::unique_ptr<SceneCache> m_scenes;
+};
@@ -46,10 +46,18 @@ bool Document::ReadFile(const QString& fileName)
         return false;
     }
 
+    SetScene(&loadedScene);
+    return true;
+}
+
+/*!
+ * Sets the \a scene read by SceneLoader, on another thread possibly, to the document.
+ */
+void Document::SetScene(LoadedScene* scene)
+{
     if (m_scene) ClearScene();
-    m_scene = loadedScene.release();
+    m_scene = scene->release();
     m_isModified = false;
-    return true;
 }
 
 /*!
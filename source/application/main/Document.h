@@ -7,6 +7,7 @@ class SoSelection;
 class SoSeparator;
 class TSceneKit;
 class GraphicRoot;
+class LoadedScene;
 
 
 class Document: public QObject
@@ -19,6 +20,7 @@ public:
 
     void New();
     bool ReadFile(const QString& fileName);
+    void SetScene(LoadedScene* scene);
     bool WriteFile(const QString& fileName);
 
     bool isModified() {return m_isModified;}
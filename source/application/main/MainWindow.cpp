@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include <iostream>
+#include <memory>
 
 #include <QCloseEvent>
 #include <QDir>
@@ -18,7 +19,7 @@
 #include <QStandardPaths>
 #include <QStringList>
 #include <QTimer>
-#include <QtConcurrentMap>
+#include <QtConcurrentRun>
 #include <QTime>
 #include <QUndoStack>
 #include <QUndoView>
@@ -62,7 +63,10 @@
 #include "commands/CmdInsertNode.h"
 #include "commands/CmdSetFieldNode.h"
 #include "commands/CmdSetFieldText.h"
+#include "commands/CmdSetFields.h"
 #include "commands/CmdPaste.h"
+#include "core/RayTraceRunner.h"
+#include "core/SceneLoader.h"
 
 #include "PluginManager.h"
 #include "kernel/node/TonatiuhFunctions.h"
@@ -74,8 +78,12 @@
 #include "kernel/photons/PhotonsAbstract.h"
 #include "kernel/photons/PhotonsSettings.h"
 #include "kernel/random/Random.h"
+#include "kernel/run/FluxAccumulator.h"
 #include "kernel/run/InstanceNode.h"
 #include "kernel/run/RayTracer.h"
+#include "kernel/run/SceneBVH.h"
+#include "kernel/run/TraceEvents.h"
+#include "kernel/run/TraceScheduler.h"
 #include "kernel/profiles/ProfileRT.h"
 #include "kernel/scene/TSceneKit.h"
 #include "kernel/scene/TSeparatorKit.h"
@@ -93,6 +101,7 @@
 #include "main/Document.h"
 #include "run/FluxAnalysis.h"
 #include "run/FluxAnalysisDialog.h"
+#include "run/LiveTrace.h"
 #include "run/RayTracingDialog.h"
 #include "script/ScriptWindow.h"
 #include "tree/SceneTreeModel.h"
@@ -260,10 +269,15 @@ MainWindow::MainWindow(QString fileName, CustomSplashScreen* splash, QWidget* pa
     m_photonsBuffer(0),
     m_photonBufferSize(1'000'000),
     m_photonBufferAppend(false),
+    m_photonWriterQueue(2),
+    m_photonMemoryBudget(qulonglong(1) << 30),
     m_photonsSettings(0),
 
+    m_liveTrace(0),
+
     m_graphicView(0),
-    m_focusView(0)
+    m_focusView(0),
+    m_edits(0)
 {
     ui->setupUi(this);
 
@@ -319,6 +333,8 @@ MainWindow::MainWindow(QString fileName, CustomSplashScreen* splash, QWidget* pa
 
 MainWindow::~MainWindow()
 {
+    delete m_liveTrace; // stops its workers before the scene and buffer go
+    delete m_edits;
     delete ui;
     delete m_pluginManager;
     delete m_modelScene;
@@ -367,6 +383,10 @@ void MainWindow::SetupDocument()
         m_graphicsRoot, SIGNAL(selectionChanged(SoSelection*)),
         this, SLOT(SelectionFinish(SoSelection*))
     );
+    connect(
+        m_graphicsRoot, SIGNAL(picked(QVector<int>)),
+        this, SLOT(SelectionPicked(QVector<int>))
+    );
 
     // models
     m_modelScene = new SceneTreeModel;
@@ -414,6 +434,10 @@ void MainWindow::SetupGraphicView()
         m_modelSelection, SIGNAL(currentChanged(QModelIndex,QModelIndex)),
         m_graphicView[0], SLOT(currentChanged(QModelIndex,QModelIndex))
     );
+    // a background trace gives way while the view is moved
+    connect(m_graphicView[0], &GraphicView::interacted, this, [this]() {
+        if (m_liveTrace) m_liveTrace->interact();
+    });
 
     m_focusView = 0;
 
@@ -573,6 +597,7 @@ void MainWindow::SetupTriggers()
 
     // run
     connect(ui->actionRun, SIGNAL(triggered()), this, SLOT(RunCompleteRayTracer()) );
+    connect(ui->actionRunLive, SIGNAL(toggled(bool)), this, SLOT(RunLive(bool)) );
     connect(ui->actionRunFlux, SIGNAL(triggered()), this, SLOT(RunFluxAnalysisDialog()) );
 
     // layout
@@ -1063,8 +1088,32 @@ void MainWindow::SelectionFinish(SoSelection* selection)
     m_graphicView[0]->render();
 }
 
+/*!
+ * Selects the surface picked in the 3D view, or nothing for empty \a rows.
+ */
+void MainWindow::SelectionPicked(const QVector<int>& rows)
+{
+    QModelIndex index = m_modelScene->indexFromRows(rows);
+    m_graphicsRoot->deselectAll();
+    if (!index.isValid()) {
+        m_modelSelection->clearSelection();
+        m_graphicView[0]->render();
+        return;
+    }
+    m_modelSelection->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect);
+
+    SoPath* path = m_modelScene->pathFromIndex(index);
+    if (path) m_graphicsRoot->select(path);
+    m_graphicView[0]->render();
+}
+
 void MainWindow::setFieldText(SoNode* node, QString field, QString value)
 {
+    if (m_edits) {
+        m_edits->add(node, field, value);
+        setDocumentModified(true);
+        return;
+    }
     CmdSetFieldText* cmd = new CmdSetFieldText(node, field, value);
     m_undoStack->push(cmd);
     setDocumentModified(true);
@@ -1072,6 +1121,12 @@ void MainWindow::setFieldText(SoNode* node, QString field, QString value)
 
 void MainWindow::setFieldNode(SoNode* node, QString field, SoNode* value)
 {
+    // keeps the order of the stack
+    if (m_edits) {
+        QString name = m_edits->text();
+        EndEdits();
+        BeginEdits(name);
+    }
     CmdSetFieldNode* cmd = new CmdSetFieldNode(node, field, value);
     m_undoStack->push(cmd);
     setDocumentModified(true);
@@ -1743,9 +1798,9 @@ QJSValue MainWindow::getScene()
 
 QJSValue MainWindow::FindInterception(QJSValue surface, QJSValue rays, QJSValue show)
 {
-//    m_graphicView[0]->render();
-//    double ans = findInterception(surface.toString(), rays.toUInt(), this);
-//    return ans;
+    // the photons are kept only to draw the rays
+    if (show.toBool() != true)
+        return findInterception(surface.toString(), rays.toUInt(), this);
 
     if (!m_rand)
         m_rand = m_pluginManager->getRandomFactories()[m_raysRandomFactoryIndex]->create(0);
@@ -1754,11 +1809,8 @@ QJSValue MainWindow::FindInterception(QJSValue surface, QJSValue rays, QJSValue
     fa.run(surface.toString(), "front", rays.toUInt(), false, 5, 5, true);
     double ans = fa.powerTotal();
 
-    if (show.toBool() == true) {
-         trf::DrawRays(m_graphicsRoot->rays(), *fa.getPhotonsBuffer(), m_raysScreen);
-        m_graphicsRoot->showRays(true);
-//       m_graphicView[0]->render();
-    }
+    trf::DrawRays(m_graphicsRoot->rays(), *fa.getPhotonsBuffer(), m_raysScreen);
+    m_graphicsRoot->showRays(true);
     return ans;
 }
 
@@ -1878,6 +1930,27 @@ void MainWindow::SetValue(QString url, QString parameter, QString value)
     setFieldText(node, parameter, value);
 }
 
+/*!
+ * Gathers the following field edits into one undo command named \a name,
+ * until EndEdits. Meant for scripts that edit thousands of nodes.
+ */
+void MainWindow::BeginEdits(QString name)
+{
+    if (m_edits) EndEdits();
+    m_edits = new CmdSetFields(name);
+}
+
+void MainWindow::EndEdits()
+{
+    CmdSetFields* cmd = m_edits;
+    m_edits = 0;
+    if (!cmd) return;
+    if (cmd->isEmpty())
+        delete cmd;
+    else
+        m_undoStack->push(cmd);
+}
+
 /*!
  * Starts new tonatiuh empty model.
  */
@@ -1943,40 +2016,7 @@ void MainWindow::Run()
     UpdateLightSize();// better use tree below
 
     if (!ReadyForRaytracing(instanceLayout, &instanceSun, air) ) return;
-
-    if (!m_photonsBuffer->getExporter() )
-    {
-//        if (!m_photonsSettings) return;
-        if (!m_photonsSettings) {
-            m_photonsSettings = new PhotonsSettings;
-            PhotonsSettings& settings = *m_photonsSettings;
-            settings.name = "No export";
-
-            settings.saveCoordinates = true;
-            settings.saveCoordinatesGlobal = true;
-            settings.saveSurfaceID = true;
-            settings.saveSurfaceSide = true;
-            settings.savePhotonsID = true;
-        }
-
-        PhotonsAbstract* photonsExporter = CreatePhotonMapExport();
-        if (!photonsExporter) return;
-        if (!m_photonsBuffer->setExporter(photonsExporter)) {
-            QMessageBox::warning(
-                this,
-                "Tonatiuh",
-                "Photon export could not be started. Check that the output directory exists or can be created, and that it is writable."
-            );
-            return;
-        }
-    } else if (!m_photonsBuffer->getExporter()->startExport()) {
-        QMessageBox::warning(
-            this,
-            "Tonatiuh",
-            "Photon export could not be started. Check that the output directory exists or can be created, and that it is writable."
-        );
-        return;
-    }
+    if (!StartPhotonExport()) return;
 
     QVector<InstanceNode*> exportSurfaceList;
     for (QString s : m_photonsSettings->surfaces)
@@ -1986,7 +2026,13 @@ void MainWindow::Run()
         exportSurfaceList << node;
     }
 
-    instanceLayout->updateTree(Transform::Identity);
+    // rays for the 3D view are sampled from all photons as they are traced
+    m_photonsBuffer->setSampleBudget(exportSurfaceList.empty() ? m_raysScreen : 0);
+
+    {
+        TraceEventScope event("updateTree", "setup");
+        instanceLayout->updateTree(Transform::Identity);
+    }
 
     SunKit* sunKit = (SunKit*) instanceSun.getNode();
     SunPosition* sunPosition = (SunPosition*) sunKit->getPart("position", false);
@@ -1999,55 +2045,64 @@ void MainWindow::Run()
         return;
     }
 
-    QVector<long> raysPerThread;
-    int progressMax = 100;
-    ulong t1 = m_raysNumber/progressMax;
-    for (int progress = 0; progress < progressMax; ++progress)
-        raysPerThread << t1;
-
-    if (t1*progressMax < m_raysNumber)
-        raysPerThread << m_raysNumber - t1*progressMax;
-
-
-
-    // single thread for gprof
-    //        QThreadPool::globalInstance()->setMaxThreadCount(1);
-    // change ideal
+    // chunks of a fixed size on all cores, each with its own random stream
+    bool counterBased = false;
+    const ulong seed = TraceScheduler::drawSeed(m_rand, &counterBased);
+    TraceScheduler scheduler(m_raysNumber, 10000, QThread::idealThreadCount());
 
     // Create a progress dialog.
     QProgressDialog dialog;
     dialog.setWindowFlag(Qt::WindowContextHelpButtonHint, false);
-    dialog.setLabelText(QString("Progressing using %1 thread(s)...").arg(QThread::idealThreadCount() ) );
+    dialog.setLabelText(QString("Progressing using %1 thread(s)...").arg(scheduler.getWorkerCount()));
+    dialog.setRange(0, 100);
 
-    QFutureWatcher<void> watcher;
+    QFutureWatcher<bool> watcher;
     connect(&watcher, SIGNAL(finished()), &dialog, SLOT(reset()));
-    connect(&dialog, SIGNAL(canceled()), &watcher, SLOT(cancel()));
-    connect(&watcher, SIGNAL(progressRangeChanged(int, int)), &dialog, SLOT(setRange(int, int)));
-    connect(&watcher, SIGNAL(progressValueChanged(int)), &dialog, SLOT(setValue(int)));
+    connect(&dialog, &QProgressDialog::canceled, [&scheduler]() {scheduler.cancel();});
+    QTimer progressTimer;
+    connect(&progressTimer, &QTimer::timeout, [&]() {
+        dialog.setValue(int(100.*scheduler.getRaysTraced()/m_raysNumber));
+    });
+    progressTimer.start(100);
 
-    std::cout << "QtConcurrent started: " << timer.elapsed() << std::endl;
-    QMutex mutex;
+    std::cout << "Tracing started: " << timer.elapsed() << std::endl;
     QMutex mutexPhotonMap;
-    QFuture<void> photonMap;
     std::atomic_bool exportFailed(false);
     AirTransmission* airTemp = 0;
     if (air->getTypeId() != AirVacuum::getClassTypeId())
         airTemp = air;
 
-    photonMap = QtConcurrent::map(raysPerThread, RayTracer(instanceLayout,
-                                                           &instanceSun, sunAperture, sunShape, airTemp,
-                                                           m_rand,
-                                                           &mutex, m_photonsBuffer, &mutexPhotonMap,
-                                                           exportSurfaceList, &exportFailed) );
-    watcher.setFuture(photonMap);
+    // photons are merged in chunk order
+    SceneBVH sceneBVH(instanceLayout);
+    if (!m_photonsBuffer->beginPages(scheduler.getWorkerCount(), 1 << 14))
+        exportFailed.store(true);
+    watcher.setFuture(QtConcurrent::run([&]() {
+        return scheduler.run([&](const TraceScheduler::Chunk& chunk) {
+            std::unique_ptr<Random> random(TraceScheduler::createRandom(seed, chunk.index, counterBased, m_rand));
+            RayTracer rayTracer(instanceLayout,
+                                &instanceSun, sunAperture, sunShape, airTemp,
+                                random.get(),
+                                nullptr, m_photonsBuffer, &mutexPhotonMap,
+                                exportSurfaceList, &exportFailed);
+            rayTracer.setSceneBVH(&sceneBVH);
+            rayTracer.setPhotonPages(chunk.worker, chunk.index);
+            rayTracer(chunk.rays);
+            return !exportFailed.load();
+        });
+    }));
 
     dialog.exec();
     watcher.waitForFinished();
-    std::cout << "QtConcurrent finished: " << timer.elapsed() << std::endl;
+    progressTimer.stop();
+    if (!m_photonsBuffer->endPages())
+        exportFailed.store(true);
+    std::cout << "Tracing finished: " << timer.elapsed() << std::endl;
+    if (scheduler.hasFailed())
+        QMessageBox::warning(this, "Tonatiuh", scheduler.getError());
 
     bool tracingCancelledByExport = exportFailed.load();
     if (!tracingCancelledByExport)
-        m_raysTracedTotal += m_raysNumber;
+        m_raysTracedTotal += scheduler.getRaysTraced();
 
     if (exportSurfaceList.empty())
         ShowRaysIn3DView(); // all photons must be stored
@@ -2073,6 +2128,103 @@ void MainWindow::Run()
     showInStatusBar(msg, 2000);
 }
 
+/*!
+ * Starts a ray trace of the current parameters in the background if \a on,
+ * otherwise stops the running one. The 3D view draws the rays traced so far
+ * and can be navigated meanwhile; editing is locked until the trace ends.
+ */
+void MainWindow::RunLive(bool on)
+{
+    if (!on) {
+        if (m_liveTrace && m_liveTrace->isRunning())
+            m_liveTrace->cancel();
+        return;
+    }
+    if (m_liveTrace && m_liveTrace->isRunning()) return;
+
+    InstanceNode* instanceLayout = 0;
+    InstanceNode instanceSun(0);
+    AirTransmission* air = 0;
+    UpdateLightSize();
+    if (!ReadyForRaytracing(instanceLayout, &instanceSun, air) || !StartPhotonExport()) {
+        ui->actionRunLive->setChecked(false);
+        return;
+    }
+
+    // rays for the 3D view are sampled from all photons as they are traced
+    m_photonsBuffer->setSampleBudget(m_photonsSettings->surfaces.isEmpty() ? m_raysScreen : 0);
+
+    RayTraceOptions options;
+    bool counterBased = false;
+    options.seed = TraceScheduler::drawSeed(m_rand, &counterBased);
+    options.randomGenerator = counterBased ? RayTraceRandomGenerator::CounterBased : RayTraceRandomGenerator::SeededSTL;
+    options.substreamRandom = m_rand;
+    options.rays = m_raysNumber;
+    options.sunWidthDivisions = m_raysGridWidth;
+    options.sunHeightDivisions = m_raysGridHeight;
+    options.workerCount = qMax(1, QThread::idealThreadCount());
+    options.reserveGuiCore = true;
+    options.lowPriority = true;
+    options.outputMode = RayTraceOutputMode::PhotonBuffer;
+    options.photonBuffer = m_photonsBuffer;
+    options.photonPageSize = 1 << 14;
+    // the photons point to the instances of the runner, gone after the trace
+    options.exportSurfaceUrls = m_photonsSettings->surfaces;
+    options.endPhotonExport = true;
+
+    if (!m_liveTrace) {
+        m_liveTrace = new LiveTrace(this);
+        connect(m_liveTrace, &LiveTrace::updated, this, &MainWindow::UpdateLiveTrace);
+        connect(m_liveTrace, &LiveTrace::finished, this, &MainWindow::FinishLiveTrace);
+    }
+    if (!m_liveTrace->start(m_document->getSceneKit(), options)) {
+        ui->actionRunLive->setChecked(false);
+        return;
+    }
+    setSceneLocked(true);
+    showInStatusBar("Tracing in background", 0);
+}
+
+void MainWindow::UpdateLiveTrace()
+{
+    const RayTraceProgress progress = m_liveTrace->progress();
+    if (progress.raysTotal > 0) {
+        const ulong rays = qMin(progress.raysTraced, progress.raysTotal);
+        showInStatusBar(QString("Tracing in background: %1%").arg(int(100.*rays/progress.raysTotal)), 0);
+    }
+    if (m_photonsSettings->surfaces.isEmpty()) {
+        trf::DrawRays(m_graphicsRoot->rays(), m_photonsBuffer->copySamplePaths());
+        m_graphicView[0]->showRays();
+    }
+}
+
+void MainWindow::FinishLiveTrace(bool ok)
+{
+    setSceneLocked(false);
+    ui->actionRunLive->setChecked(false);
+
+    const RayTraceResult& result = m_liveTrace->getResult();
+    if (!ok)
+        QMessageBox::warning(this, "Tonatiuh", m_liveTrace->getError());
+    if (!result.exportFailed)
+        m_raysTracedTotal += result.raysTraced;
+    if (m_photonsSettings->surfaces.isEmpty())
+        ShowRaysIn3DView();
+    if (result.exportFailed) {
+        QMessageBox::warning(
+            this,
+            "Tonatiuh",
+            "Photon export failed. Some photons were not written and remain buffered in memory. Check the output directory before starting a new export."
+        );
+    }
+
+    QString msg = QString("%1 %2 rays: %3 s")
+        .arg(result.canceled ? "Stopped after" : "Traced")
+        .arg(result.raysTraced)
+        .arg(result.elapsedSeconds, 0, 'f', 3);
+    showInStatusBar(msg, 5000);
+}
+
 /*
  * Runs ray trace to calculate a flux distribution map in the surface of the node \a nodeURL related to the side \a surfaceSide.
  * The map will be calculated with the parameters \a nOfRays, \a heightDivisions and \a heightDivisions.
@@ -2239,6 +2391,26 @@ void MainWindow::SetPhotonBufferAppend(bool on)
     m_photonBufferAppend = on;
 }
 
+void MainWindow::SetPhotonWriterQueue(uint blocks)
+{
+    if (m_photonWriterQueue == blocks)
+        return;
+    if (!ResetPhotonExporter())
+        return;
+    m_photonWriterQueue = blocks;
+}
+
+/*!
+ * Keeps at most \a megabytes of retained photons in memory, 0 for no limit.
+ * The others are spilled to a temporary file and still drawn and binned.
+ */
+void MainWindow::SetPhotonMemoryBudget(uint megabytes)
+{
+    m_photonMemoryBudget = qulonglong(megabytes) << 20;
+    if (m_photonsBuffer)
+        m_photonsBuffer->setMemoryBudget(m_photonMemoryBudget);
+}
+
 /*!
  * Sets the random number generator type, \a typeName, for ray tracing.
  */
@@ -2804,7 +2976,8 @@ bool MainWindow::ReadyForRaytracing(InstanceNode*& instanceLayout,
     TSceneKit* sceneKit = m_document->getSceneKit();
     if (!sceneKit) return false;
 
-    InstanceNode* instanceScene = m_modelScene->getInstance(QModelIndex());
+    // the rows the tree view has not fetched are traced too
+    InstanceNode* instanceScene = m_modelScene->fetchInstanceTree();
     if (!instanceScene) return false;
 
     instanceLayout = instanceScene->children[0];
@@ -2828,12 +3001,83 @@ bool MainWindow::ReadyForRaytracing(InstanceNode*& instanceLayout,
     if (!m_photonsBuffer)
     {
         m_photonsBuffer = new PhotonsBuffer(m_photonBufferSize, m_photonBufferSize);
+        m_photonsBuffer->setWriterQueue(m_photonWriterQueue);
+        m_photonsBuffer->setMemoryBudget(m_photonMemoryBudget);
         m_raysTracedTotal = 0;
     }
 
     return true;
 }
 
+/*!
+ * Starts the export of the photon buffer, creating the exporter of the
+ * photon settings the first time. Returns \a false with a warning if the
+ * export cannot start.
+ */
+bool MainWindow::StartPhotonExport()
+{
+    if (!m_photonsBuffer->getExporter() )
+    {
+//        if (!m_photonsSettings) return;
+        if (!m_photonsSettings) {
+            m_photonsSettings = new PhotonsSettings;
+            PhotonsSettings& settings = *m_photonsSettings;
+            settings.name = "No export";
+
+            settings.saveCoordinates = true;
+            settings.saveCoordinatesGlobal = true;
+            settings.saveSurfaceID = true;
+            settings.saveSurfaceSide = true;
+            settings.savePhotonsID = true;
+        }
+
+        PhotonsAbstract* photonsExporter = CreatePhotonMapExport();
+        if (!photonsExporter) return false;
+        if (!m_photonsBuffer->setExporter(photonsExporter)) {
+            QMessageBox::warning(
+                this,
+                "Tonatiuh",
+                "Photon export could not be started. Check that the output directory exists or can be created, and that it is writable."
+            );
+            return false;
+        }
+    } else if (!m_photonsBuffer->getExporter()->startExport()) {
+        QMessageBox::warning(
+            this,
+            "Tonatiuh",
+            "Photon export could not be started. Check that the output directory exists or can be created, and that it is writable."
+        );
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * Disables the actions and views that change the scene if \a on, while a
+ * background trace reads it, and enables them again otherwise.
+ */
+void MainWindow::setSceneLocked(bool on)
+{
+    if (on) {
+        QList<QAction*> actions;
+        actions << ui->menuFile->actions() << ui->menuEdit->actions();
+        actions << ui->actionRun << ui->actionRunFlux << ui->actionRunScript << ui->actionSunPosition;
+        actions << ui->menuComponent->menuAction() << ui->menuTest->menuAction();
+        m_lockedActions.clear();
+        for (QAction* action : actions) {
+            if (!action->isEnabled()) continue;
+            action->setEnabled(false);
+            m_lockedActions << action;
+        }
+    } else {
+        for (QAction* action : m_lockedActions)
+            action->setEnabled(true);
+        m_lockedActions.clear();
+    }
+    ui->sceneView->setEnabled(!on);
+    ui->parametersTabs->setEnabled(!on);
+}
+
 /*!
  * Returns \a true if the tonatiuh model is correctly saved into the the given \a fileName. Otherwise, returns \a false.
  *
@@ -2895,6 +3139,58 @@ void MainWindow::ShowRaysIn3DView()
 //    }
 }
 
+/*!
+ * Reads the scene of \a fileName into \a document on a worker thread.
+ *
+ * The window keeps drawing while the file is parsed and its shapes are
+ * prepared, and the progress dialog cancels the read; only setting the
+ * scene to the document is left to this thread.
+ */
+bool MainWindow::ReadDocument(Document* document, const QString& fileName)
+{
+    SceneLoadProgress progress;
+    LoadedScene scene;
+    QString message;
+
+    QProgressDialog dialog(this);
+    dialog.setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+    dialog.setWindowTitle("Open");
+    dialog.setRange(0, 100);
+    dialog.setMinimumDuration(500);
+
+    QFutureWatcher<bool> watcher;
+    connect(&watcher, SIGNAL(finished()), &dialog, SLOT(reset()));
+    connect(&dialog, &QProgressDialog::canceled, [&progress]() {progress.cancel();});
+    QTimer progressTimer;
+    const QString name = QFileInfo(fileName).fileName();
+    auto update = [&]() {
+        if (progress.getStage() == SceneLoadProgress::Parsing)
+            dialog.setLabelText(QString("Reading %1...").arg(name));
+        else
+            dialog.setLabelText(QString("Preparing shapes of %1...").arg(name));
+        dialog.setValue(int(100.*progress.getFraction()));
+    };
+    connect(&progressTimer, &QTimer::timeout, update);
+    update();
+    progressTimer.start(100);
+
+    watcher.setFuture(QtConcurrent::run([&]() {
+        return SceneLoader::readFile(fileName, &scene, &message, &progress) &&
+            SceneLoader::prepareShapes(scene.get(), &progress, &message);
+    }));
+    dialog.exec();
+    watcher.waitForFinished();
+    progressTimer.stop();
+
+    if (!watcher.result()) {
+        if (!progress.isCanceled())
+            showWarning(message);
+        return false;
+    }
+    document->SetScene(&scene);
+    return true;
+}
+
 /*!
  * Returns to the start origin state and starts with a new model defined in \a fileName.
  * If the file name is not defined, it starts with an empty scene.
@@ -2918,7 +3214,7 @@ bool MainWindow::openFileProject(const QString& fileName)
             loadedDocument, SIGNAL(Warning(QString)),
             this, SLOT(showWarning(QString))
         );
-        if (!loadedDocument->ReadFile(fileName)) {
+        if (!ReadDocument(loadedDocument, fileName)) {
             QDir::setSearchPaths("project", previousProjectSearchPaths);
             delete loadedDocument;
             showInStatusBar("Open canceled");
@@ -2926,6 +3222,8 @@ bool MainWindow::openFileProject(const QString& fileName)
         }
     }
 
+    delete m_edits; // its nodes are of the scene going
+    m_edits = 0;
     m_undoStack->clear();
     m_modelScene->clear();
     m_graphicsRoot->removeScene();
@@ -3014,14 +3312,42 @@ void MainWindow::dropEvent(QDropEvent* event)
     event->acceptProposedAction();
 }
 
+/*!
+ * Returns the power on the front of \a surface from \a rays traced by the
+ * shared RayTraceRunner: chunks on all cores with a generator each, and the
+ * hits counted by the workers as flux, so no photons are kept.
+ */
 double findInterception(QString surface, uint rays, MainWindow* mw)
 {
+    TSceneKit* sceneKit = mw->m_document->getSceneKit();
+    if (!sceneKit || rays == 0) return 0.;
+
     if (!mw->m_rand)
         mw->m_rand = mw->m_pluginManager->getRandomFactories()[mw->m_raysRandomFactoryIndex]->create(0);
 
-    FluxAnalysis fa(mw->m_document->getSceneKit(), mw->m_modelScene, mw->m_raysGridWidth, mw->m_raysGridHeight, mw->m_rand);
-    fa.run(surface, "front", rays, false, 5, 5, true);
-    return fa.powerTotal();
+    FluxAccumulator flux;
+    flux.addTarget(surface, true, 1, 1);
+
+    RayTraceOptions options;
+    bool counterBased = false;
+    options.seed = TraceScheduler::drawSeed(mw->m_rand, &counterBased);
+    options.randomGenerator = counterBased ? RayTraceRandomGenerator::CounterBased : RayTraceRandomGenerator::SeededSTL;
+    options.substreamRandom = mw->m_rand;
+    options.rays = rays;
+    options.sunWidthDivisions = mw->m_raysGridWidth;
+    options.sunHeightDivisions = mw->m_raysGridHeight;
+    options.workerCount = qMax(1, QThread::idealThreadCount());
+    options.outputMode = RayTraceOutputMode::FluxGrid;
+    options.fluxAccumulator = &flux;
+
+    RayTraceRunner runner;
+    RayTraceResult result;
+    QString errorMessage;
+    if (!runner.trace(sceneKit, options, &result, &errorMessage)) {
+        emit mw->Abort(QString("FindInterception: %1").arg(errorMessage));
+        return 0.;
+    }
+    return flux.getHits(0)*result.powerPerRay;
 }
 
 //#include "widgets/HelpDialog.h"
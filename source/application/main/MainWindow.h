@@ -1,11 +1,13 @@
 #pragma once
 
+#include <QList>
 #include <QMainWindow>
 #include <QVariant>
 #include <QJSValue>
 
 class QItemSelectionModel;
 class QSplitter;
+class CmdSetFields;
 class CustomSplashScreen;
 
 #include <Inventor/SbVec3f.h>
@@ -14,6 +16,8 @@ class Document;
 class GraphicRoot;
 class GraphicView;
 class IfwUpdateService;
+class QAction;
+class LiveTrace;
 class InstanceNode;
 class PhotonsAbstract;
 class PluginManager;
@@ -113,6 +117,9 @@ public slots:
     void Select(QString url);
     void SetName(QString name);
     void SetValue(QString url, QString parameter, QString value);
+    // SetValue and parameter edits between them are one undo step
+    void BeginEdits(QString name);
+    void EndEdits();
 
     void ChangeSunPosition(double azimuth, double elevation);
     void ChangeSunPosition(int year, int month, int day, double hours, double minutes, double seconds, double latitude, double longitude);
@@ -133,6 +140,8 @@ public slots:
     void SetRaysGrid(int width, int height);
     void SetPhotonBufferSize(uint size);
     void SetPhotonBufferAppend(bool on);
+    void SetPhotonWriterQueue(uint blocks);
+    void SetPhotonMemoryBudget(uint megabytes);
 
 private slots:
     void fileOpen();
@@ -153,9 +162,13 @@ private slots:
     void onUndoStack();
 
     void RunCompleteRayTracer();
+    void RunLive(bool on);
+    void UpdateLiveTrace();
+    void FinishLiveTrace(bool ok);
     void RunFluxAnalysisDialog();
 
     void SelectionFinish(SoSelection* selection);
+    void SelectionPicked(const QVector<int>& rows);
 
     void setFieldText(SoNode* node, QString field, QString value);
     void setFieldNode(SoNode* node, QString field, SoNode* value);
@@ -213,12 +226,15 @@ private:
     void SetCurrentFile(const QString& filePath);
     bool OkToContinue();
     bool openFileProject(const QString& fileName);
+    bool ReadDocument(Document* document, const QString& fileName);
     void setDocumentModified(bool value);
 
     bool Delete(QModelIndex index);
     bool Paste(QModelIndex index, bool isShared);
 
     bool ReadyForRaytracing(InstanceNode*& instanceLayout, InstanceNode* instanceSun, AirTransmission*& air);
+    bool StartPhotonExport();
+    void setSceneLocked(bool on);
 
     void SetupDocument();
     void SetupViews();
@@ -248,6 +264,7 @@ private:
 
     QUndoStack* m_undoStack;
     UndoView* m_undoView;
+    CmdSetFields* m_edits; // open bulk edit, see BeginEdits
 
     Document* m_document;
     GraphicRoot* m_graphicsRoot;
@@ -272,8 +289,13 @@ private:
     PhotonsBuffer* m_photonsBuffer;
     ulong m_photonBufferSize;
     bool m_photonBufferAppend;
+    ulong m_photonWriterQueue; // blocks saved off the tracing threads, 0 saves in place
+    qulonglong m_photonMemoryBudget; // bytes of retained photons in memory, 0 for no limit
     PhotonsSettings* m_photonsSettings;
 
+    LiveTrace* m_liveTrace; // traces in the background, see RunLive
+    QList<QAction*> m_lockedActions; // while it runs
+
     QVector<GraphicView*> m_graphicView;
     int m_focusView;
     bool m_saveCoordinates;
@@ -22,6 +22,7 @@
 #include "kernel/profiles/ProfileRectangular.h"
 #include "kernel/profiles/ProfileRegular.h"
 #include "kernel/profiles/ProfileTriangle.h"
+#include "kernel/random/RandomPhilox.h"
 #include "kernel/random/RandomSTL.h"
 #include "kernel/scene/TSceneKit.h"
 #include "kernel/scene/TSeparatorKit.h"
@@ -44,6 +45,8 @@
 #include "view/SunNode3D.h"
 #include "view/OverlayNode.h"
 #include "view/SeparatorStyle.h"
+#include "view/PhotonsNode.h"
+#include "view/InstancedFieldNode.h"
 
 
 PluginManager::PluginManager()
@@ -53,6 +56,8 @@ PluginManager::PluginManager()
     SunNode3D::initClass();
     OverlayNode::initClass();
     SeparatorStyle::initClass();
+    PhotonsNode::initClass();
+    InstancedFieldNode::initClass();
 }
 
 /*!
@@ -88,6 +93,7 @@ void PluginManager::load(QDir dir)
     loadPlugin(new MaterialFactoryT<MaterialRough>);
 
     loadPlugin(new RandomFactoryT<RandomSTL>);
+    loadPlugin(new RandomFactoryT<RandomPhilox>);
 
     loadPlugin(new TrackerFactoryT<TrackerArmature1A>);
     loadPlugin(new TrackerFactoryT<TrackerArmature2A>);
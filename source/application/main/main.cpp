@@ -1,3 +1,5 @@
+#include <memory>
+
 #include <QApplication>
 #include <QCoreApplication>
 #include <QStyleFactory>
@@ -13,7 +15,9 @@
 #include <QTextStream>
 
 #include <Inventor/Qt/SoQt.h>
+#include "core/DistributedRun.h"
 #include "headless/HeadlessCommandRunner.h"
+#include "kernel/run/TraceEvents.h"
 #include "MainWindow.h"
 
 QTextStream cerr(stderr);
@@ -69,11 +73,36 @@ QString startupFileFromPositionalArguments(const QStringList& arguments, QString
 
     return startupFiles.first();
 }
+
+// records trace events while the application runs, written when it ends
+class TraceEventsFile
+{
+public:
+    explicit TraceEventsFile(const QString& fileName):
+        m_fileName(fileName)
+    {
+        m_events.nameThread("main");
+        TraceEvents::setActive(&m_events);
+    }
+
+    ~TraceEventsFile()
+    {
+        TraceEvents::setActive(nullptr);
+        QString errorMessage;
+        if (!m_events.write(m_fileName, &errorMessage))
+            cerr << "Trace events were not written: " << errorMessage << Qt::endl;
+    }
+
+private:
+    QString m_fileName;
+    TraceEvents m_events;
+};
 }
 
 int main(int argc, char** argv)
 {  
     if (hasHeadlessArgument(argc, argv)) {
+        DistributedRun distributed(&argc, &argv);
         QCoreApplication app(argc, argv);
         app.setApplicationName("Tonatiuh");
         app.setApplicationVersion(APP_VERSION);
@@ -114,6 +143,12 @@ int main(int argc, char** argv)
         "w", "Window mode"
     );
     parser.addOption(optionWindow);
+
+    QCommandLineOption optionTraceEvents( // --trace-events=events.json
+        "trace-events", "Chrome trace file of the ray tracing events", // option name and description
+        "file", "" // value type and default
+    );
+    parser.addOption(optionTraceEvents);
     parser.addPositionalArgument(
         "project",
         "Tonatiuh++ project or script file to open.",
@@ -123,6 +158,9 @@ int main(int argc, char** argv)
     // processing
     parser.process(app);
 //    bool isTest = parser.isSet(optionTest);
+    std::unique_ptr<TraceEventsFile> traceEvents;
+    if (parser.isSet(optionTraceEvents))
+        traceEvents.reset(new TraceEventsFile(parser.value(optionTraceEvents)));
 
     QSettings settings("Tonatiuh", "Cyprus");
     QString theme = settings.value("theme", "").toString();
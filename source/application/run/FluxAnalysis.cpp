@@ -1,14 +1,17 @@
 #include "FluxAnalysis.h"
 
 #include <cmath>
+#include <memory>
 #include <vector>
 
+#include <QEventLoop>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QFutureWatcher>
 #include <QMutex>
 #include <QPair>
-#include <QProgressDialog>
-#include <QtConcurrentMap>
+#include <QThread>
+#include <QtConcurrentRun>
 
 #include <Inventor/actions/SoGetBoundingBoxAction.h>
 #include <Inventor/nodes/SoTransform.h>
@@ -18,8 +21,11 @@
 #include "kernel/air/AirTransmission.h"
 #include "kernel/run/InstanceNode.h"
 #include "kernel/photons/PhotonsBuffer.h"
+#include "kernel/photons/PhotonsFileMap.h"
 #include "kernel/random//Random.h"
 #include "kernel/run/RayTracer.h"
+#include "kernel/run/SceneBVH.h"
+#include "kernel/run/TraceScheduler.h"
 #include "kernel/scene/TSceneKit.h"
 #include "kernel/scene/TShapeKit.h"
 #include "kernel/shape/ShapeRT.h"
@@ -31,8 +37,37 @@
 #include "libraries/math/gcf.h"
 #include "kernel/profiles/ProfileRT.h"
 #include "libraries/math/2D/Matrix2D.h"
+#include "libraries/auxiliary/FluxGridFile.h"
 #include "kernel/photons/Photon.h"
 #include <QCoreApplication>
+#include <QDebug>
+#ifdef TONATIUHPP_HDF5
+#include "libraries/auxiliary/HDF5File.h"
+#endif
+
+namespace {
+
+// cells per side of the base grid of the photons
+const int BaseDivisionsMax = 1024;
+
+// live bins are updated between chunks at most this often
+const qint64 ProgressIntervalMs = 500;
+
+// photons kept in memory, the others are spilled to disk
+const qulonglong PhotonsMemoryBudget = qulonglong(1) << 30;
+
+// adds a photon at q, (u, v) normalized to the profile box, to its bin
+void addToBin(Matrix2D<int>& bins, const vec2d& q)
+{
+    int r = floor(q.x*bins.rows());
+    int c = floor(q.y*bins.cols());
+    if (r == bins.rows()) r--;
+    if (c == bins.cols()) c--;
+    if (r < 0 || r >= bins.rows() || c < 0 || c >= bins.cols()) return;
+    bins(r, c)++;
+}
+
+} // namespace
 
 FluxAnalysis::FluxAnalysis(TSceneKit* sceneKit,
     SceneTreeModel* sceneModel,
@@ -51,7 +86,14 @@ FluxAnalysis::FluxAnalysis(TSceneKit* sceneKit,
     m_powerTotal(0.),
     m_powerPhoton(0.),
     m_photonsMax(0),
-    m_photonsError(0)
+    m_photonsError(0),
+    m_photonsCached(false),
+    m_photonsTotal(0),
+    m_baseDivs(0),
+    m_progressPending(false),
+    m_progressPhotons(0),
+    m_progressPower(0.),
+    m_scheduler(0)
 {
     m_instanceLayout = m_sceneModel->getInstance(QModelIndex());
     m_instanceLayout = m_instanceLayout->children[0];
@@ -92,6 +134,8 @@ void FluxAnalysis::run(QString nodeURL, QString surfaceSide, ulong nRays, bool p
     m_surfaceSide = surfaceSide;
 
     m_binsPhotons.resize(uDivs, vDivs);
+    m_cellAreas.resize(0, 0);
+    m_photonsCached = false;
 
     if (!m_sceneKit) return;
 
@@ -122,10 +166,14 @@ void FluxAnalysis::run(QString nodeURL, QString surfaceSide, ulong nRays, bool p
     //Create the photon map where photons are going to be stored
     if (!m_photons || !photonBufferAppend)
     {
+        qDeleteAll(m_maps);
+        m_maps.clear();
         if (m_photons) m_photons->endExport(-1);
         delete m_photons;
 //        long q = std::vector<Photon>::max_size();
         m_photons = new PhotonsBuffer(std::numeric_limits<int>::max(), std::numeric_limits<int>::max()/64);
+        m_photons->setCompact(true);
+        m_photons->setMemoryBudget(PhotonsMemoryBudget);
         m_tracedRays = 0;
         m_powerPhoton = 0;
         m_powerTotal = 0;
@@ -143,72 +191,148 @@ void FluxAnalysis::run(QString nodeURL, QString surfaceSide, ulong nRays, bool p
     m_sceneModel->UpdateSceneModel();
 
     //Compute bounding boxes and world to object transforms
+    m_sceneModel->fetchInstanceTree(); // rows not shown are traced too
     m_instanceLayout->updateTree(Transform::Identity);
 
     if (!sunKit->findTexture(m_sunDivs.x, m_sunDivs.y, m_instanceLayout)) return;
 
-    QVector<long> raysPerThread;
-    int maximumValueProgressScale = 100;
-
-    ulong t1 = nRays / maximumValueProgressScale;
-    for (int progressCount = 0; progressCount < maximumValueProgressScale; ++progressCount)
-        raysPerThread << t1;
-
-    if (t1*maximumValueProgressScale < nRays)
-        raysPerThread << nRays - t1*maximumValueProgressScale;
-
     Transform lightToWorld = tgf::makeTransform(sunTransform);
     instanceSun.setTransform(lightToWorld);
 
-//    QThreadPool::globalInstance()->setMaxThreadCount(1);
-    // Create a progress dialog.
-    QProgressDialog dialog;
-    dialog.setWindowFlag(Qt::WindowContextHelpButtonHint, false);
-    dialog.setLabelText(QString("Progressing using %1 thread(s)...").arg(QThread::idealThreadCount() ) );
-
-    // Create a QFutureWatcher and connect signals and slots.
-    QFutureWatcher<void> watcher;
-//    QObject::connect(&watcher, SIGNAL(finished()), &dialog, SLOT(reset()));
-    QObject::connect(&dialog, SIGNAL(canceled()), &watcher, SLOT(cancel()));
-//    QObject::connect(&watcher, SIGNAL(progressRangeChanged(int,int)), &dialog, SLOT(setRange(int,int)));
-//    QObject::connect(&watcher, SIGNAL(progressValueChanged(int)), &dialog, SLOT(setValue(int)));
-
-    QObject::connect(&watcher, SIGNAL(progressValueChanged(int)), this, SLOT(processEvents()));
-    QObject::connect(this, SIGNAL(stopSignal()), &watcher, SLOT(cancel()));
+    double irradiance = sunPosition->irradiance.getValue();
+    double area = sunAperture->getArea();
 
-    QMutex mutex;
     QMutex mutexPhotonMap;
-    QFuture<void> photonMap;
     AirTransmission* airTemp = 0;
     if (air->getTypeId() != AirTransmission::getClassTypeId())
         airTemp = air;
 
-    photonMap = QtConcurrent::map(raysPerThread, RayTracer(
-        m_instanceLayout,
-        &instanceSun, sunAperture, sunShape, airTemp,
-        m_rand, &mutex, m_photons, &mutexPhotonMap, exportSuraceList
-    ));
-
-    watcher.setFuture(photonMap);
+    // chunks of a fixed size on all cores, each with its own random stream
+    bool counterBased = false;
+    const ulong seed = TraceScheduler::drawSeed(m_rand, &counterBased);
+    TraceScheduler scheduler(nRays, 10000, QThread::idealThreadCount());
+    m_scheduler = &scheduler;
 
-    // Display the dialog and start the event loop.
-//    if (!silent) {
-//        dialog.exec();
-//    }
+    // the photons merged so far are binned while no chunk is in flight, and
+    // progressed() tells the dialog, whose events run while tracing
+    TShapeKit* shapeKit = static_cast<TShapeKit*>(instanceNode->getNode());
+    ShapeRT* shape = (ShapeRT*) shapeKit->shapeRT.getValue();
+    ProfileRT* profile = (ProfileRT*) shapeKit->profileRT.getValue();
+    if (shape && profile)
+    {
+        m_box = profile->getBox();
+        m_progressBins.resize(uDivs, vDivs);
+        m_progressBins.fill(0);
+        m_progressErrors.resize(qMax(0, uDivs - 1), qMax(0, vDivs - 1));
+        m_progressErrors.fill(0);
+        m_progressPhotons = 0;
+        m_progressPending = false;
+
+        const bool isFront = m_surfaceSide != "back";
+        const Transform toObject = instanceNode->getTransform().inversed();
+        const ulong tracedBefore = m_tracedRays;
+        const Box2D box = m_box;
+        size_t binned = 0;
+        scheduler.setPause(ProgressIntervalMs, [&, isFront, toObject, tracedBefore, box]() {
+            const PhotonsCompact& photons = m_photons->getPhotonsCompact();
+            const int surfaceIndex = photons.findSurface(instanceNode);
+            QMutexLocker lock(&m_progressMutex);
+            photons.forEach(binned, [&](const PhotonCompact& photon) {
+                if (photon.isFront() != isFront) return;
+                m_progressPhotons++;
+                vec3d p = int(photon.surface) == surfaceIndex ? photon.posLocal() : toObject.transformPoint(photons.getPosition(photon));
+                vec2d q = (shape->getUV(p) - box.min())/box.size();
+                if (std::isnan(q.x) || std::isnan(q.y)) return;
+                addToBin(m_progressBins, q);
+                if (!m_progressErrors.isEmpty()) addToBin(m_progressErrors, q);
+            });
+            binned = photons.size();
+            m_progressPower = area*irradiance/(tracedBefore + scheduler.getRaysTraced());
+            if (!m_progressPending) {
+                m_progressPending = true;
+                emit progressed();
+            }
+        });
+    }
 
-//    dialog.setModal(false);
-//    dialog.show();
+    SceneBVH sceneBVH(m_instanceLayout);
+    m_photons->beginPages(scheduler.getWorkerCount(), 1 << 14);
+    QEventLoop loop;
+    QFutureWatcher<bool> watcher;
+    connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+    watcher.setFuture(QtConcurrent::run([&]() {
+        return scheduler.run([&](const TraceScheduler::Chunk& chunk) {
+            std::unique_ptr<Random> random(TraceScheduler::createRandom(seed, chunk.index, counterBased, m_rand));
+            RayTracer rayTracer(
+                m_instanceLayout,
+                &instanceSun, sunAperture, sunShape, airTemp,
+                random.get(), nullptr, m_photons, &mutexPhotonMap, exportSuraceList
+            );
+            rayTracer.setSceneBVH(&sceneBVH);
+            rayTracer.setPhotonPages(chunk.worker, chunk.index);
+            rayTracer(chunk.rays);
+            return true;
+        });
+    }));
+    if (!watcher.isFinished()) loop.exec();
     watcher.waitForFinished();
+    m_photons->endPages();
+    m_scheduler = 0;
+    {
+        // a progress not taken yet is older than the bins below
+        QMutexLocker lock(&m_progressMutex);
+        m_progressPending = false;
+    }
 
-    m_tracedRays += nRays;
-
-    double irradiance = sunPosition->irradiance.getValue();
-    double area = sunAperture->getArea();
+    m_tracedRays += scheduler.getRaysTraced();
     m_powerPhoton = area*irradiance/m_tracedRays;
 
     fillBins();
 }
 
+/*
+ * Takes the bins of the photons traced so far, while run is tracing
+ * Returns false if there are none since the last call
+ */
+bool FluxAnalysis::takeProgress()
+{
+    if (!m_scheduler) return false;
+    QModelIndex index = m_sceneModel->indexFromUrl(m_surfaceURL);
+    InstanceNode* instance = m_sceneModel->getInstance(index);
+    if (!instance) return false;
+    TShapeKit* shapeKit = static_cast<TShapeKit*>(instance->getNode());
+    ShapeRT* shape = (ShapeRT*) shapeKit->shapeRT.getValue();
+    if (!shape) return false;
+
+    Matrix2D<int> binErrors;
+    {
+        QMutexLocker lock(&m_progressMutex);
+        if (!m_progressPending) return false;
+        m_progressPending = false;
+        m_binsPhotons = m_progressBins;
+        binErrors = m_progressErrors;
+        m_photonsTotal = m_progressPhotons;
+        m_powerPhoton = m_progressPower;
+    }
+
+    m_photonsMax = 0;
+    m_photonsMaxPos = vec2i(0, 0);
+    for (int r = 0; r < m_binsPhotons.rows(); ++r) {
+        for (int c = 0; c < m_binsPhotons.cols(); ++c) {
+            if (m_photonsMax < m_binsPhotons(r, c)) {
+                m_photonsMax = m_binsPhotons(r, c);
+                m_photonsMaxPos = vec2i(r, c);
+            }
+        }
+    }
+    m_photonsError = 0;
+    for (int binE : binErrors.data())
+        m_photonsError = qMax(m_photonsError, binE);
+    m_powerTotal = m_photonsTotal*m_powerPhoton;
+    fillFlux(shape, instance->getTransform());
+    return true;
+}
+
 /*
  * Update photon counts for a specific grid divisions
  */
@@ -218,48 +342,135 @@ void FluxAnalysis::setBins(int rows, int cols)
     fillBins();
 }
 
+/*
+ * Opens exported photon files to bin them instead of traced photons
+ * The files are mapped, not read, so large maps open at once
+ */
+bool FluxAnalysis::load(QStringList fileNames, bool rowsGlobal, QString* error)
+{
+    QList<PhotonsFileMap*> maps;
+    for (const QString& fileName : fileNames)
+    {
+        PhotonsFileMap* map = new PhotonsFileMap;
+        maps << map;
+        QString message;
+        if (!map->open(fileName, rowsGlobal))
+            message = map->getError();
+        else if (!map->hasField(PhotonsFileMap::X) || !map->hasField(PhotonsFileMap::Y) ||
+                 !map->hasField(PhotonsFileMap::Z) || !map->hasField(PhotonsFileMap::Side) ||
+                 !map->hasField(PhotonsFileMap::SurfaceID))
+            message = QString("%1 does not hold coordinates, sides and surface IDs").arg(fileName);
+        if (!message.isEmpty()) {
+            if (error) *error = message;
+            qDeleteAll(maps);
+            return false;
+        }
+    }
+    if (maps.isEmpty()) return false;
+
+    clear();
+    m_maps = maps;
+    m_cellAreas.resize(0, 0);
+    m_photonsCached = false;
+    // files of one export share the photon power
+    m_powerPhoton = m_maps[0]->getPhotonPower();
+    return true;
+}
+
+/*
+ * Selects the surface binned by setBins
+ */
+void FluxAnalysis::setSurface(QString nodeURL, QString surfaceSide)
+{
+    m_surfaceURL = nodeURL;
+    m_surfaceSide = surfaceSide;
+    m_cellAreas.resize(0, 0);
+    m_photonsCached = false;
+}
+
 /*
  * Export the flux distribution
  */
-void FluxAnalysis::write(QString fileName, bool withCoords)
+bool FluxAnalysis::write(QString fileName, bool withCoords)
 {
-    if (!m_photons) return;
+    if (!m_photons && m_maps.isEmpty()) return false;
+
+#ifdef TONATIUHPP_HDF5
+    if (QFileInfo(fileName).suffix() == "h5")
+        return writeHDF5(fileName);
+#endif
+
+    // arrays in W/m2, rows along u as in the text
+    FluxGridFile::Format format;
+    if (FluxGridFile::findFormat(fileName, &format)) {
+        std::vector<double> flux(m_binsFlux.data().begin(), m_binsFlux.data().end());
+        QString error;
+        if (!FluxGridFile::write(fileName, format, m_binsFlux.rows(), m_binsFlux.cols(), flux, &error)) {
+            qWarning() << error;
+            return false;
+        }
+        return true;
+    }
 
     QFile file(fileName);
-    file.open(QIODevice::WriteOnly);
+    if (!file.open(QIODevice::WriteOnly)) return false;
     QTextStream out(&file);
 
-    double uStep = m_box.size().x/m_binsPhotons.rows();
-    double vStep = m_box.size().y/m_binsPhotons.cols();
-    QModelIndex nodeIndex = m_sceneModel->indexFromUrl(m_surfaceURL);
-    InstanceNode* instanceNode = m_sceneModel->getInstance(nodeIndex);
-    vec3d sJ = instanceNode->getTransform().getScales();
-    TShapeKit* kit = (TShapeKit*) instanceNode->getNode();
-    ShapeRT* shape = (ShapeRT*) kit->shapeRT.getValue();
-    // works for cylinder, not sphere
-    double areaCell = dot(sJ, shape->getDerivativeU(0., 0.))*uStep;
-    areaCell *= dot(sJ, shape->getDerivativeV(0., 0.))*vStep;
-    // cross product better?
-
-    double coeff = m_powerPhoton/areaCell;
+    double uStep = m_box.size().x/m_binsFlux.rows();
+    double vStep = m_box.size().y/m_binsFlux.cols();
 
     if (withCoords)
     {
         out << "x(m)\ty(m)\tFlux(W/m2)\n";
-        for (int r = 0; r < m_binsPhotons.rows(); ++r) {
-            for (int c = 0; c < m_binsPhotons.cols(); ++c)
-                out << m_box.min().x + uStep*(r + 0.5)  << "\t" << m_box.min().y + vStep*(c + 0.5) << "\t" << m_binsPhotons(r, c)*coeff << "\n";
+        for (int r = 0; r < m_binsFlux.rows(); ++r) {
+            for (int c = 0; c < m_binsFlux.cols(); ++c)
+                out << m_box.min().x + uStep*(r + 0.5)  << "\t" << m_box.min().y + vStep*(c + 0.5) << "\t" << m_binsFlux(r, c) << "\n";
         }
     }
     else
     {
-        for (int r = 0; r < m_binsPhotons.rows(); ++r) {
-            for (int c = 0; c < m_binsPhotons.cols(); c++)
-                out << m_binsPhotons(r, c)*coeff << "\t";
+        for (int r = 0; r < m_binsFlux.rows(); ++r) {
+            for (int c = 0; c < m_binsFlux.cols(); c++)
+                out << m_binsFlux(r, c) << "\t";
             out << "\n";
         }
     }
+    return true;
+}
+
+#ifdef TONATIUHPP_HDF5
+/*
+ * Append the flux distribution and the sun position to an HDF5 file
+ * Repeated calls, e.g. one per sun position, add rows to the flux group
+ */
+bool FluxAnalysis::writeHDF5(QString fileName)
+{
+    if (!m_photons && m_maps.isEmpty()) return false;
+
+    std::vector<double> flux(m_binsFlux.data().begin(), m_binsFlux.data().end());
+
+    SunKit* sunKit = static_cast<SunKit*>(m_sceneKit->getPart("world.sun", false));
+    SunPosition* sunPosition = (SunPosition*) sunKit->getPart("position", false);
+
+    HDF5File file;
+    bool ok = file.open(fileName, false) &&
+        file.appendGrid("flux/grid", m_binsFlux.rows(), m_binsFlux.cols(), flux) &&
+        file.append("flux/surface", QStringList{m_surfaceURL}) &&
+        file.append("flux/side", QStringList{m_surfaceSide}) &&
+        file.append("flux/azimuth", std::vector<double>{sunPosition->azimuth.getValue()}) &&
+        file.append("flux/elevation", std::vector<double>{sunPosition->elevation.getValue()}) &&
+        file.append("flux/rays", std::vector<quint64>{m_tracedRays}) &&
+        file.append("flux/photon_power", std::vector<double>{m_powerPhoton}) &&
+        file.append("flux/x_min", std::vector<double>{m_box.min().x}) &&
+        file.append("flux/x_max", std::vector<double>{m_box.max().x}) &&
+        file.append("flux/y_min", std::vector<double>{m_box.min().y}) &&
+        file.append("flux/y_max", std::vector<double>{m_box.max().y}) &&
+        file.close();
+    if (!ok)
+        qWarning() << file.getError();
+    return ok;
 }
+#endif
 
 /*
  * Clear photon map
@@ -269,9 +480,13 @@ void FluxAnalysis::clear()
     if (m_photons) m_photons->endExport(-1);
     delete m_photons;
     m_photons = 0;
+    qDeleteAll(m_maps);
+    m_maps.clear();
     m_tracedRays = 0;
     m_powerPhoton = 0.;
     m_powerTotal = 0.;
+    m_photonsCached = false;
+    std::vector<vec2d>().swap(m_photonsUV);
 }
 
 void FluxAnalysis::processEvents()
@@ -281,15 +496,18 @@ void FluxAnalysis::processEvents()
 
 void FluxAnalysis::stop()
 {
+    if (m_scheduler) m_scheduler->cancel();
     emit stopSignal();
 }
 
 /*
  * Update photon counts
+ * The photons are read once per trace or load into a base grid, see
+ * cachePhotons, and every grid after that is binned from it
  */
 void FluxAnalysis::fillBins()
 {
-    if (!m_photons) return;
+    if (!m_photons && m_maps.isEmpty()) return;
 
     m_binsPhotons.fill(0);
     m_photonsMax = 0;
@@ -307,56 +525,190 @@ void FluxAnalysis::fillBins()
     ProfileRT* profile = (ProfileRT*) shapeKit->profileRT.getValue();
     m_box = profile->getBox();
 
-    int activeSideID = m_surfaceSide == "back" ? 0 : 1;
     Transform toWorld = instance->getTransform();
-    Transform toObject = toWorld.inversed();
+    if (!m_photonsCached) cachePhotons(instance, shape);
+
+    binPhotons(m_binsPhotons);
+    for (int r = 0; r < m_binsPhotons.rows(); ++r) {
+        for (int c = 0; c < m_binsPhotons.cols(); ++c) {
+            if (m_photonsMax < m_binsPhotons(r, c)) {
+                m_photonsMax = m_binsPhotons(r, c);
+                m_photonsMaxPos = vec2i(r, c);
+            }
+        }
+    }
 
-    Matrix2D<int> binErrors(m_binsPhotons.rows() - 1, m_binsPhotons.cols() - 1);
-    binErrors.fill(0);
+    Matrix2D<int> binErrors(qMax(0, m_binsPhotons.rows() - 1), qMax(0, m_binsPhotons.cols() - 1));
+    binPhotons(binErrors);
+    for (int binE : binErrors.data())
+        m_photonsError = qMax(m_photonsError, binE);
+
+    m_powerTotal = m_photonsTotal*m_powerPhoton;
+    fillFlux(shape, toWorld);
+}
 
-    int photonsTotal = 0;
-    for (const Photon& photon : m_photons->getPhotons())
+/*
+ * Flux of the bins, from the area of each cell on the surface, found once per grid
+ */
+void FluxAnalysis::fillFlux(ShapeRT* shape, const Transform& toWorld)
+{
+    vec2i dims(m_binsPhotons.rows(), m_binsPhotons.cols());
+    if (m_cellAreas.rows() != dims.x || m_cellAreas.cols() != dims.y)
     {
-        if (photon.isFront != activeSideID) continue;
-        photonsTotal++;
-        vec3d p = toObject.transformPoint(photon.pos);
+        m_cellAreas.resize(dims.x, dims.y);
+        double uStep = m_box.size().x/dims.x;
+        double vStep = m_box.size().y/dims.y;
+        for (int r = 0; r < dims.x; ++r) {
+            for (int c = 0; c < dims.y; ++c) {
+                double u0 = m_box.min().x + r*uStep;
+                double v0 = m_box.min().y + c*vStep;
+                m_cellAreas(r, c) = shape->findArea(u0, v0, u0 + uStep, v0 + vStep, toWorld);
+            }
+        }
+    }
+    m_binsFlux.resize(dims.x, dims.y);
+    for (int r = 0; r < dims.x; ++r) {
+        for (int c = 0; c < dims.y; ++c) {
+            double area = m_cellAreas(r, c);
+            m_binsFlux(r, c) = area > 0. ? m_binsPhotons(r, c)*m_powerPhoton/area : 0.;
+        }
+    }
+}
+
+/*
+ * Reads the photons on the side of the surface once, in (u, v) normalized
+ * to the profile box, sorted by the cells of a base grid with the bounds
+ * of the photons in each cell
+ */
+void FluxAnalysis::cachePhotons(InstanceNode* instance, ShapeRT* shape)
+{
+    int activeSideID = m_surfaceSide == "back" ? 0 : 1;
+    Transform toObject = instance->getTransform().inversed();
+
+    std::vector<vec2d> qs;
+    m_photonsTotal = 0;
+    auto addPhoton = [&](const vec3d& p) {
+        m_photonsTotal++;
         vec2d uv = shape->getUV(p);
         vec2d q = (uv - m_box.min())/m_box.size();
+        if (std::isnan(q.x) || std::isnan(q.y)) return;
+        qs.push_back(q);
+    };
 
-        int r = floor(q.x*m_binsPhotons.rows());
-        int c = floor(q.y*m_binsPhotons.cols());
-        if (r == m_binsPhotons.rows()) r--;
-        if (c == m_binsPhotons.cols()) c--;
-        int& bin = m_binsPhotons(r, c);
-        bin++;
-        if (m_photonsMax < bin)
+    if (!m_photons) {
+        for (PhotonsFileMap* map : m_maps)
         {
-            m_photonsMax = bin;
-            m_photonsMaxPos = vec2i(r, c);
+            quint32 surfaceID = map->findSurface(m_surfaceURL);
+            if (surfaceID == 0) continue;
+            // photons on the surface are in its frame unless saved globally
+            bool global = map->isCoordinatesGlobal();
+            for (quint64 b = 0; b < map->getBlockCount(); ++b)
+            {
+                PhotonsFileMap::Block block = map->getBlock(b);
+                if (block.rows == 0 && !map->getError().isEmpty())
+                    qWarning() << map->getError();
+                const PhotonsFileMap::Column& xs = block.columns[PhotonsFileMap::X];
+                const PhotonsFileMap::Column& ys = block.columns[PhotonsFileMap::Y];
+                const PhotonsFileMap::Column& zs = block.columns[PhotonsFileMap::Z];
+                const PhotonsFileMap::Column& sides = block.columns[PhotonsFileMap::Side];
+                const PhotonsFileMap::Column& surfaces = block.columns[PhotonsFileMap::SurfaceID];
+                for (quint64 n = 0; n < block.rows; ++n)
+                {
+                    if (quint32(surfaces[n]) != surfaceID) continue;
+                    if ((sides[n] != 0.) != bool(activeSideID)) continue;
+                    vec3d p(xs[n], ys[n], zs[n]);
+                    addPhoton(global ? toObject.transformPoint(p) : p);
+                }
+            }
         }
-
-        int rE = floor(q.x*binErrors.rows());
-        int cE = floor(q.y*binErrors.cols());
-        if (rE == binErrors.rows()) rE--;
-        if (cE == binErrors.cols()) cE--;
-        int& binE = binErrors(rE, cE);
-        binE++;
-        if (m_photonsError < binE)
-            m_photonsError = binE;
+    } else if (m_photons->isCompact()) {
+        // photons on the surface are already in its frame
+        const PhotonsCompact& photons = m_photons->getPhotonsCompact();
+        const int surfaceIndex = photons.findSurface(instance);
+        photons.forEach(0, [&](const PhotonCompact& photon) {
+            if (photon.isFront() != bool(activeSideID)) return;
+            if (int(photon.surface) == surfaceIndex)
+                addPhoton(photon.posLocal());
+            else
+                addPhoton(toObject.transformPoint(photons.getPosition(photon)));
+        });
+    } else {
+        m_photons->forEachPhoton(0, [&](const Photon& photon) {
+            if (photon.isFront != activeSideID) return;
+            addPhoton(toObject.transformPoint(photon.pos));
+        });
     }
 
-    m_powerTotal = photonsTotal*m_powerPhoton;
+    // a few photons per base cell
+    m_baseDivs = qBound(1, int(std::sqrt(qs.size()/4.)), BaseDivisionsMax);
+    const int cells = m_baseDivs*m_baseDivs;
+    auto baseCell = [this](const vec2d& q) {
+        int i = int(qBound(0., std::floor(q.x*m_baseDivs), m_baseDivs - 1.));
+        int j = int(qBound(0., std::floor(q.y*m_baseDivs), m_baseDivs - 1.));
+        return i*m_baseDivs + j;
+    };
+
+    m_baseBegins.assign(cells + 1, 0);
+    m_baseBoxes.assign(cells, Box2D());
+    for (const vec2d& q : qs) {
+        int k = baseCell(q);
+        m_baseBegins[k + 1]++;
+        m_baseBoxes[k] << q;
+    }
+    for (int k = 0; k < cells; ++k)
+        m_baseBegins[k + 1] += m_baseBegins[k];
+    m_photonsUV.resize(qs.size());
+    std::vector<int> fill(m_baseBegins.begin(), m_baseBegins.end() - 1);
+    for (const vec2d& q : qs)
+        m_photonsUV[fill[baseCell(q)]++] = q;
+    m_photonsCached = true;
+}
 
-    // flux
-    vec2i dims(m_binsPhotons.rows(), m_binsPhotons.cols());
-    m_binsFlux.resize(dims.x, dims.y);
-    double uStep = m_box.size().x/dims.x;
-    double vStep = m_box.size().y/dims.y;
-    for (int r = 0; r < dims.x; ++r) {
-        for (int c = 0; c < dims.y; ++c) {
-            double u0 = m_box.min().x + r*uStep;
-            double v0 = m_box.min().y + c*vStep;
-            m_binsFlux(r, c) = m_binsPhotons(r, c)*m_powerPhoton/shape->findArea(u0, v0, u0 + uStep, v0 + vStep, toWorld);
+/*
+ * Counts the cached photons in bins over the profile box
+ * floor(q*n) does not decrease with q, so a base cell whose bounds fall in
+ * one bin is added whole and only the photons of the others are binned
+ */
+void FluxAnalysis::binPhotons(Matrix2D<int>& bins) const
+{
+    bins.fill(0);
+    const int rows = bins.rows();
+    const int cols = bins.cols();
+    if (rows == 0 || cols == 0) return;
+
+    auto row = [rows](double x) {
+        int r = floor(x*rows);
+        if (r == rows) r--;
+        return r;
+    };
+    auto col = [cols](double y) {
+        int c = floor(y*cols);
+        if (c == cols) c--;
+        return c;
+    };
+    auto isInside = [rows, cols](int r, int c) {
+        return r >= 0 && r < rows && c >= 0 && c < cols;
+    };
+
+    for (int k = 0; k < int(m_baseBoxes.size()); ++k)
+    {
+        const int begin = m_baseBegins[k];
+        const int end = m_baseBegins[k + 1];
+        if (begin == end) continue;
+
+        const Box2D& box = m_baseBoxes[k];
+        int r = row(box.min().x);
+        int c = col(box.min().y);
+        if (r == row(box.max().x) && c == col(box.max().y)) {
+            if (isInside(r, c)) bins(r, c) += end - begin;
+            continue;
+        }
+        for (int n = begin; n < end; ++n) {
+            const vec2d& q = m_photonsUV[n];
+            r = row(q.x);
+            c = col(q.y);
+            // getUV may leave the profile box by rounding or on curved shapes
+            if (isInside(r, c)) bins(r, c)++;
         }
     }
 }
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <QList>
+#include <QMutex>
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <vector>
 #include "libraries/math/2D/Matrix2D.h"
 #include "libraries/math/2D/Box2D.h"
 #include "libraries/math/2D/vec2i.h"
@@ -9,8 +13,12 @@
 class TSceneKit;
 class SceneTreeModel;
 class InstanceNode;
+class ShapeRT;
+class Transform;
 class Random;
 class PhotonsBuffer;
+class PhotonsFileMap;
+class TraceScheduler;
 
 class FluxAnalysis: public QObject
 {
@@ -23,9 +31,20 @@ public:
     QString getShapeType(QString nodeURL);
     void run(QString nodeURL, QString surfaceSide, ulong nRays, bool increasePhotonMap, int uDivs, int vDivs, bool silent = false);
     void setBins(int rows, int cols);
-    void write(QString fileName, bool withCoords);
+    bool load(QStringList fileNames, bool rowsGlobal, QString* error = 0);
+    void setSurface(QString nodeURL, QString surfaceSide);
+    bool hasPhotonFile() const {return !m_maps.isEmpty();}
+    // text, or the format of FluxGridFile that the suffix names
+    bool write(QString fileName, bool withCoords);
+#ifdef TONATIUHPP_HDF5
+    bool writeHDF5(QString fileName);
+#endif
     void clear();
 
+    // while run traces, with the events of the caller processed
+    bool isRunning() const {return m_scheduler;}
+    bool takeProgress();
+
     Matrix2D<int>& getBinsPhotons() {return m_binsPhotons;}
     Matrix2D<double>& getBinsFlux() {return m_binsFlux;}
     const Box2D& box() const {return m_box;}
@@ -39,13 +58,19 @@ public:
 
 signals:
     void stopSignal();
+    void progressed(); // from a tracing thread, takeProgress reads the bins
+
+public slots:
+    void stop();
 
 private slots:
     void processEvents();
-    void stop();
 
 private:
     void fillBins();
+    void fillFlux(ShapeRT* shape, const Transform& toWorld);
+    void cachePhotons(InstanceNode* instance, ShapeRT* shape);
+    void binPhotons(Matrix2D<int>& bins) const;
 
     TSceneKit* m_sceneKit;
     SceneTreeModel* m_sceneModel;
@@ -54,6 +79,7 @@ private:
     Random* m_rand;
 
     PhotonsBuffer* m_photons;
+    QList<PhotonsFileMap*> m_maps; // opened photon files, instead of m_photons
 
     QString m_surfaceURL;
     QString m_surfaceSide;
@@ -64,10 +90,30 @@ private:
 
     Matrix2D<int> m_binsPhotons;
     Matrix2D<double> m_binsFlux;
+    Matrix2D<double> m_cellAreas; // on the surface, found once per trace or load
 
     Box2D m_box;
 
     int m_photonsMax; // maximal number of photons in a cell
     vec2i m_photonsMaxPos; // indices of cell with maximal number of photons
     int m_photonsError; // ?maximal number of photons in a cell for a reduced grid
+
+    // photons of the surface side read once per trace or load, to rebin
+    // them without reading the photons again
+    bool m_photonsCached;
+    int m_photonsTotal; // on the side, in the box or not
+    int m_baseDivs;
+    std::vector<vec2d> m_photonsUV; // normalized to the box, by base cell
+    std::vector<int> m_baseBegins;
+    std::vector<Box2D> m_baseBoxes; // of the photons in each base cell
+
+    // bins of the photons traced so far, filled between chunks while run traces
+    QMutex m_progressMutex;
+    bool m_progressPending;
+    Matrix2D<int> m_progressBins;
+    Matrix2D<int> m_progressErrors;
+    int m_progressPhotons;
+    double m_progressPower;
+
+    TraceScheduler* m_scheduler; // while tracing
 };
@@ -1,6 +1,7 @@
 #include "FluxAnalysisDialog.h"
 #include "ui_FluxAnalysisDialog.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include <QFileDialog>
@@ -10,6 +11,8 @@
 #include <QMutex>
 #include <QPair>
 #include <QProgressDialog>
+#include <QToolTip>
+#include <QtConcurrentRun>
 #include <QtConcurrentMap>
 
 #include <Inventor/actions/SoGetBoundingBoxAction.h>
@@ -38,7 +41,8 @@ FluxAnalysisDialog::FluxAnalysisDialog(TSceneKit* sceneKit, SceneTreeModel* scen
     QDialog(parent),
     ui(new Ui::FluxAnalysisDialog),
     m_sceneModel(sceneModel),
-    m_fluxLabel("Flux, W/m^2")
+    m_fluxLabel("Flux, W/m^2"),
+    m_fluxPyramidVersion(0)
 {
     ui->setupUi(this);
 
@@ -50,6 +54,8 @@ FluxAnalysisDialog::FluxAnalysisDialog(TSceneKit* sceneKit, SceneTreeModel* scen
     connect(ui->surfaceXSpin, SIGNAL(editingFinished()), this, SLOT(UpdateAnalysis()));
     connect(ui->surfaceYSpin, SIGNAL(editingFinished()), this, SLOT(UpdateAnalysis()));
     connect(ui->raysButton, SIGNAL(clicked()), this, SLOT(run()));
+    connect(m_fluxAnalysis, SIGNAL(progressed()), this, SLOT(ShowProgress()));
+    connect(ui->photonsButton, SIGNAL(clicked()), this, SLOT(OpenPhotons()));
 
     connect(ui->exportLengthEdit, SIGNAL(editingFinished()), this, SLOT(UnitsChanged()));
     connect(ui->exportPowerEdit, SIGNAL(editingFinished()), this, SLOT(UnitsChanged()));
@@ -63,6 +69,9 @@ FluxAnalysisDialog::FluxAnalysisDialog(TSceneKit* sceneKit, SceneTreeModel* scen
     ui->plotFxy->plotLayout()->addElement(0, 0, new QCPTextElement(ui->plotFxy, "Flux Distribution") );
     ui->plotFxy->xAxis->setLabel("u");
     ui->plotFxy->yAxis->setLabel("v");
+    connect(ui->plotFxy->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(UpdateFluxTiles()));
+    connect(ui->plotFxy->yAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(UpdateFluxTiles()));
+    connect(ui->plotFxy, SIGNAL(mouseMove(QMouseEvent*)), this, SLOT(ShowFluxCell(QMouseEvent*)));
 
     ui->plotFx->xAxis->setLabel("u");
     ui->plotFx->yAxis->setLabel(m_fluxLabel);
@@ -103,10 +112,13 @@ void FluxAnalysisDialog::SurfaceSelected()
     if (fluxSurfaceURL.isEmpty()) return;
     if (fluxSurfaceURL == m_fluxSurfaceURL) return;
 
-    m_fluxAnalysis->clear();
     ClearAnalysis();
     ui->surfaceEdit->setText(fluxSurfaceURL);
     m_fluxSurfaceURL = fluxSurfaceURL;
+    if (m_fluxAnalysis->hasPhotonFile())
+        BinPhotonFile();
+    else
+        m_fluxAnalysis->clear();
 }
 
 /*!
@@ -124,12 +136,16 @@ void FluxAnalysisDialog::SurfaceChanged()
     QString shapeType = m_fluxAnalysis->getShapeType(fluxSurfaceURL);
     if (sFilters.contains(shapeType))
     {
-        m_fluxAnalysis->clear();
-        ui->raysAppendCheck->setChecked(false);
-        ui->raysAppendCheck->setEnabled(false);
         ClearAnalysis();
         ui->surfaceEdit->setText(fluxSurfaceURL);
         m_fluxSurfaceURL = fluxSurfaceURL;
+        if (m_fluxAnalysis->hasPhotonFile()) {
+            BinPhotonFile();
+            return;
+        }
+        m_fluxAnalysis->clear();
+        ui->raysAppendCheck->setChecked(false);
+        ui->raysAppendCheck->setEnabled(false);
     }
 }
 
@@ -138,6 +154,11 @@ void FluxAnalysisDialog::SurfaceChanged()
  */
 void FluxAnalysisDialog::SideChanged()
 {
+    if (m_fluxAnalysis->hasPhotonFile()) {
+        ClearAnalysis();
+        BinPhotonFile();
+        return;
+    }
     m_fluxAnalysis->clear();
     ui->raysAppendCheck->setChecked(false);
     ui->raysAppendCheck->setEnabled(false);
@@ -163,12 +184,30 @@ void FluxAnalysisDialog::UpdateAnalysis()
 //		return;
 //	}
 
-    if (m_fluxAnalysis->getBinsPhotons().isEmpty())
+    if (m_fluxAnalysis->getBinsPhotons().isEmpty() && !m_fluxAnalysis->hasPhotonFile())
+        return;
+    if (m_fluxSurfaceURL.isEmpty() || m_fluxAnalysis->isRunning())
         return;
 
-    vec2i divs(ui->surfaceXSpin->value(), ui->surfaceYSpin->value());
-    m_fluxAnalysis->setBins(divs.x, divs.y);
+    m_fluxAnalysis->setBins(ui->surfaceXSpin->value(), ui->surfaceYSpin->value());
+    ShowAnalysis();
+}
+
+/*
+ * Shows the flux of the photons traced so far, while tracing
+ */
+void FluxAnalysisDialog::ShowProgress()
+{
+    if (m_fluxAnalysis->takeProgress())
+        ShowAnalysis();
+}
 
+/*
+ * Statistics and plots of the current bins
+ */
+void FluxAnalysisDialog::ShowAnalysis()
+{
+    vec2i divs(m_fluxAnalysis->getBinsPhotons().rows(), m_fluxAnalysis->getBinsPhotons().cols());
 //    const Matrix2D<int>& photonCounts = m_fluxAnalysis->getBinsPhotons();
     const Matrix2D<double>& fluxCounts = m_fluxAnalysis->getBinsFlux();
 
@@ -224,11 +263,26 @@ void FluxAnalysisDialog::UpdateAnalysis()
     UpdateSectorPlots(fluxCounts, box);
 }
 
+/*!
+ * Closing the dialog stops a trace in progress.
+ */
+void FluxAnalysisDialog::reject()
+{
+    m_fluxAnalysis->stop();
+    QDialog::reject();
+}
+
 /*!
  * Runs flux analysis for current defined surface.
  */
 void FluxAnalysisDialog::run()
 {
+    // the Run button stops a trace in progress
+    if (m_fluxAnalysis->isRunning()) {
+        m_fluxAnalysis->stop();
+        return;
+    }
+
     QElapsedTimer timer;
     timer.start();
 
@@ -240,13 +294,79 @@ void FluxAnalysisDialog::run()
     QString surfaceSide = ui->surfaceSideCombo->currentText();
     bool increasePhotonMap = ui->raysAppendCheck->isEnabled() && ui->raysAppendCheck->isChecked();
 
+    // the map is redrawn while tracing, with the inputs locked
+    QList<QWidget*> inputs = {
+        ui->surfaceButton, ui->surfaceEdit, ui->surfaceSideCombo, ui->surfaceXSpin, ui->surfaceYSpin,
+        ui->raysSpin, ui->raysAppendCheck, ui->photonsButton, ui->pushButton
+    };
+    QList<bool> enabled;
+    for (QWidget* input : inputs) {
+        enabled << input->isEnabled();
+        input->setEnabled(false);
+    }
+    ui->raysButton->setText("Stop");
     m_fluxAnalysis->run(m_fluxSurfaceURL, surfaceSide, ui->raysSpin->value(), increasePhotonMap, ui->surfaceXSpin->value(), ui->surfaceYSpin->value());
+    ui->raysButton->setText("Run");
+    for (int n = 0; n < inputs.size(); ++n)
+        inputs[n]->setEnabled(enabled[n]);
+
     UpdateAnalysis();
     ui->raysAppendCheck->setEnabled(true);
+    ui->photonsFileLabel->setText("traced");
 
     std::cout << "Elapsed time: " << timer.elapsed() << std::endl;
 }
 
+/*!
+ * Opens exported photon files to analyse them without tracing.
+ * The files stay mapped while the surface, side and cells change.
+ */
+void FluxAnalysisDialog::OpenPhotons()
+{
+    QSettings settings("Tonatiuh", "Cyprus");
+    QString dirName = settings.value("dirPhotons", settings.value("dirProjects", "").toString()).toString();
+    QStringList fileNames = QFileDialog::getOpenFileNames(
+        this, "Open Photons", dirName,
+        "Photons (*.tnpc *.dat);;Columnar photons (*.tnpc);;Photon rows (*.dat)"
+    );
+    if (fileNames.isEmpty()) return;
+    settings.setValue("dirPhotons", QFileInfo(fileNames[0]).absolutePath());
+
+    // the row format does not record the coordinate frame
+    bool rowsGlobal = true;
+    for (const QString& fileName : fileNames) {
+        if (QFileInfo(fileName).suffix() != "dat") continue;
+        rowsGlobal = QMessageBox::question(this, "Tonatiuh",
+            "Were the photon coordinates of the .dat files exported in global coordinates?") == QMessageBox::Yes;
+        break;
+    }
+
+    QString error;
+    if (!m_fluxAnalysis->load(fileNames, rowsGlobal, &error))
+    {
+        QMessageBox::warning(this, "Tonatiuh", QString("Could not open the photon files.\n%1").arg(error));
+        return;
+    }
+
+    ui->raysAppendCheck->setChecked(false);
+    ui->raysAppendCheck->setEnabled(false);
+    QString label = QFileInfo(fileNames[0]).fileName();
+    if (fileNames.size() > 1)
+        label += QString(" (+%1)").arg(fileNames.size() - 1);
+    ui->photonsFileLabel->setText(label);
+    ClearAnalysis();
+    BinPhotonFile();
+}
+
+/*
+ * Bins the opened photon files on the current surface and side
+ */
+void FluxAnalysisDialog::BinPhotonFile()
+{
+    m_fluxAnalysis->setSurface(m_fluxSurfaceURL, ui->surfaceSideCombo->currentText());
+    UpdateAnalysis();
+}
+
 /*
  * Updates the labels of the plots
  */
@@ -294,11 +414,26 @@ void FluxAnalysisDialog::on_pushButton_clicked()
             selectedFilter = "Data (*.txt)";
         else if (info.suffix() == "dat")
             selectedFilter = "Data with grid (*.dat)";
+        else if (info.suffix() == "h5")
+            selectedFilter = "HDF5, appended (*.h5)";
+        else if (info.suffix() == "npy")
+            selectedFilter = "NumPy array (*.npy)";
+        else if (info.suffix() == "npz")
+            selectedFilter = "NumPy array, compressed (*.npz)";
+        else if (info.suffix() == "f32")
+            selectedFilter = "Raw float32 (*.f32)";
+        else if (info.suffix() == "f64")
+            selectedFilter = "Raw float64 (*.f64)";
     }
 
+    QString filters = "Image (*.png);;Image (*.jpg);;Data (*.txt);;Data with grid (*.dat);;"
+        "NumPy array (*.npy);;NumPy array, compressed (*.npz);;Raw float32 (*.f32);;Raw float64 (*.f64)";
+#ifdef TONATIUHPP_HDF5
+    filters += ";;HDF5, appended (*.h5)";
+#endif
     QString fileName = QFileDialog::getSaveFileName(
         this, "Export", dirName,
-        "Image (*.png);;Image (*.jpg);;Data (*.txt);;Data with grid (*.dat)",
+        filters,
          &selectedFilter
     );
     if (fileName.isEmpty()) return;
@@ -319,6 +454,12 @@ void FluxAnalysisDialog::on_pushButton_clicked()
         m_fluxAnalysis->write(m_path, false);
     else if (info.suffix() == "dat")
         m_fluxAnalysis->write(m_path, true);
+    else if ((info.suffix() == "npy" || info.suffix() == "npz" || info.suffix() == "f32" || info.suffix() == "f64") && !m_fluxAnalysis->write(m_path, false))
+        QMessageBox::warning(this, "Tonatiuh", QString("Could not write the flux distribution to %1").arg(m_path));
+#ifdef TONATIUHPP_HDF5
+    else if (info.suffix() == "h5" && !m_fluxAnalysis->writeHDF5(m_path))
+        QMessageBox::warning(this, "Tonatiuh", QString("Could not append the flux distribution to %1").arg(m_path));
+#endif
     else if (info.suffix() == "jpg")
         ui->plotFxy->saveJpg(m_path);
     else if (info.suffix() == "png")
@@ -350,6 +491,8 @@ void FluxAnalysisDialog::ClearAnalysis()
     ui->plotFx->replot();
 
     ui->plotFxy->clearPlottables();
+    m_fluxPyramid = MatrixPyramid<double>();
+    m_fluxPyramidVersion++;
     for (int i = 0; i < ui->plotFxy->plotLayout()->elementCount(); i++)
     {
         //test to see if any of the layout elements are of QCPColorScale type
@@ -415,11 +558,19 @@ void FluxAnalysisDialog::UpdateFluxMapPlot(const Matrix2D<double>& flux, const B
     QCPColorMap* colorMap = new QCPColorMap(ui->plotFxy->xAxis, ui->plotFxy->yAxis);
 //    ui->plotFxy->addPlottable(colorMap);
 
-    colorMap->data()->setSize(flux.rows(), flux.cols());
-    colorMap->data()->setRange(QCPRange(box.min().x, box.max().x), QCPRange(box.min().y, box.max().y));
-    for (int x = 0; x < flux.rows(); ++x)
-        for (int y = 0; y < flux.cols(); ++y)
-            colorMap->data()->setCell(x, y, flux(x, y));
+    // the cells in view are filled from the pyramid, see UpdateFluxTiles
+    m_fluxPyramid = MatrixPyramid<double>();
+    int version = ++m_fluxPyramidVersion;
+    QFutureWatcher<MatrixPyramid<double>>* watcher = new QFutureWatcher<MatrixPyramid<double>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, version]() {
+        if (version == m_fluxPyramidVersion) {
+            m_fluxPyramid = watcher->result();
+            UpdateFluxTiles();
+            ui->plotFxy->replot();
+        }
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([flux]() {return MatrixPyramid<double>(flux);}));
 
 	// add a color scale:
     QCPColorScale* colorScale = new QCPColorScale(ui->plotFxy);
@@ -431,18 +582,93 @@ void FluxAnalysisDialog::UpdateFluxMapPlot(const Matrix2D<double>& flux, const B
 
     colorMap->setColorScale(colorScale);   // associate the color map with the color scale
     colorMap->setGradient(QCPColorGradient::gpThermal); // set the contour plot color
-    colorMap->rescaleDataRange(); // rescale the data dimension (color) such that all data points lie in the span visualized by the color gradient:
+    // colors of the whole map, not of the cells in view
+    if (!flux.isEmpty()) {
+        auto range = std::minmax_element(flux.data().begin(), flux.data().end());
+        colorMap->setDataRange(QCPRange(*range.first, *range.second));
+    }
 
 	// make sure the axis rect and color scale synchronize their bottom and top margins (so they line up):
     QCPMarginGroup* marginGroup = new QCPMarginGroup(ui->plotFxy);
     ui->plotFxy->axisRect()->setMarginGroup(QCP::msBottom | QCP::msTop, marginGroup);
     colorScale->setMarginGroup(QCP::msBottom | QCP::msTop, marginGroup);
 
-	// rescale axes and update plot view
-    ui->plotFxy->rescaleAxes();
+	// update plot view
+    ui->plotFxy->xAxis->setRange(box.min().x, box.max().x);
+    ui->plotFxy->yAxis->setRange(box.min().y, box.max().y);
     ui->plotFxy->replot();
 }
 
+/*
+ * Fills the color map with the cells in view, from the pyramid level
+ * with about one cell per pixel, so the cost of a redraw follows the
+ * size of the plot and not that of the grid
+ */
+void FluxAnalysisDialog::UpdateFluxTiles()
+{
+    QCPColorMap* colorMap = qobject_cast<QCPColorMap*>(ui->plotFxy->plottable());
+    if (!colorMap || m_fluxPyramid.isEmpty()) return;
+
+    const Matrix2D<double>& flux = m_fluxPyramid.level(0);
+    Box2D box = m_fluxAnalysis->box();
+    double uStep = box.size().x/flux.rows();
+    double vStep = box.size().y/flux.cols();
+
+    QCPRange uRange = ui->plotFxy->xAxis->range();
+    QCPRange vRange = ui->plotFxy->yAxis->range();
+    int r0 = qBound(0, int(floor((uRange.lower - box.min().x)/uStep)), flux.rows());
+    int r1 = qBound(0, int(ceil((uRange.upper - box.min().x)/uStep)), flux.rows());
+    int c0 = qBound(0, int(floor((vRange.lower - box.min().y)/vStep)), flux.cols());
+    int c1 = qBound(0, int(ceil((vRange.upper - box.min().y)/vStep)), flux.cols());
+    if (r0 >= r1 || c0 >= c1) {
+        colorMap->data()->clear();
+        return;
+    }
+
+    QCPAxisRect* rect = ui->plotFxy->axisRect();
+    int n = m_fluxPyramid.findLevel(r1 - r0, c1 - c0, rect->width(), rect->height());
+    const Matrix2D<double>& level = m_fluxPyramid.level(n);
+    int s = 1 << n;
+    int a0 = r0/s;
+    int a1 = qMin((r1 + s - 1)/s, level.rows());
+    int b0 = c0/s;
+    int b1 = qMin((c1 + s - 1)/s, level.cols());
+
+    // the range of QCPColorMapData is that of the centers of its cells
+    double du = uStep*s;
+    double dv = vStep*s;
+    QCPColorMapData* data = colorMap->data();
+    data->setSize(a1 - a0, b1 - b0);
+    data->setRange(QCPRange(box.min().x + (a0 + 0.5)*du, box.min().x + (a1 - 0.5)*du),
+                   QCPRange(box.min().y + (b0 + 0.5)*dv, box.min().y + (b1 - 0.5)*dv));
+    for (int a = a0; a < a1; ++a)
+        for (int b = b0; b < b1; ++b)
+            data->setCell(a - a0, b - b0, level(a, b));
+}
+
+/*
+ * Shows the flux of the cell under the cursor, at full resolution
+ */
+void FluxAnalysisDialog::ShowFluxCell(QMouseEvent* event)
+{
+    const Matrix2D<double>& flux = m_fluxAnalysis->getBinsFlux();
+    if (flux.isEmpty() || !qobject_cast<QCPColorMap*>(ui->plotFxy->plottable())) return;
+
+    Box2D box = m_fluxAnalysis->box();
+    double u = ui->plotFxy->xAxis->pixelToCoord(event->position().x());
+    double v = ui->plotFxy->yAxis->pixelToCoord(event->position().y());
+    int r = int(floor((u - box.min().x)/box.size().x*flux.rows()));
+    int c = int(floor((v - box.min().y)/box.size().y*flux.cols()));
+    if (r < 0 || r >= flux.rows() || c < 0 || c >= flux.cols()) {
+        QToolTip::hideText();
+        return;
+    }
+
+    QString text = QString("u = %1, v = %2\n%3: %4")
+        .arg(u).arg(v).arg(m_fluxLabel).arg(flux(r, c));
+    QToolTip::showText(event->globalPosition().toPoint(), text, ui->plotFxy);
+}
+
 /*
  * Create sector plots
  */
@@ -8,6 +8,7 @@ class FluxAnalysisDialog;
 
 #include "kernel/photons/PhotonsBuffer.h"
 #include "libraries/math/2D/Matrix2D.h"
+#include "libraries/math/2D/MatrixPyramid.h"
 #include "libraries/math/2D/vec2i.h"
 #include "libraries/math/2D/Box2D.h"
 
@@ -18,6 +19,7 @@ class Random;
 class TSceneKit;
 class FluxAnalysis;
 class QCPItemLine;
+class QMouseEvent;
 
 class FluxAnalysisDialog: public QDialog
 {
@@ -28,19 +30,28 @@ public:
                        Random* randomDeviate, QWidget* parent = 0);
     ~FluxAnalysisDialog();
 
+protected:
+    void reject() override;
+
 private slots:
     void SurfaceSelected();
     void SurfaceChanged();
     void SideChanged();
     void UpdateAnalysis();
+    void ShowProgress();
     void run();
+    void OpenPhotons();
 
     void UnitsChanged();
     void UpdateSectorPlotSlot();
+    void UpdateFluxTiles();
+    void ShowFluxCell(QMouseEvent* event);
     void on_pushButton_clicked();
 
 private:
     void ClearAnalysis();
+    void ShowAnalysis();
+    void BinPhotonFile();
 
     void UpdateStatistics(double powerTotal, double fluxMin, double fluxAverage, double fluxMax,
                           double fluxMaxU, double fluxMaxV, double error, double uniformity, double gravityX, double gravityY);
@@ -59,4 +70,6 @@ private:
     QString m_path;
     QCPItemLine* m_lineV;
     QCPItemLine* m_lineH;
+    MatrixPyramid<double> m_fluxPyramid; // of the flux map, built in the background
+    int m_fluxPyramidVersion;
 };
@@ -0,0 +1,78 @@
+#include "LiveTrace.h"
+
+#include <QMetaObject>
+
+namespace {
+
+// ms without interaction before all workers trace again
+const int IdleInterval = 400;
+
+}
+
+
+LiveTrace::LiveTrace(QObject* parent):
+    QObject(parent),
+    m_ok(false),
+    m_canceled(false),
+    m_activeWorkers(0)
+{
+    connect(&m_timer, &QTimer::timeout, this, &LiveTrace::updated);
+    m_idleTimer.setSingleShot(true);
+    m_idleTimer.setInterval(IdleInterval);
+    connect(&m_idleTimer, &QTimer::timeout, this, [this]() {m_activeWorkers.store(0);});
+}
+
+LiveTrace::~LiveTrace()
+{
+    if (!isRunning()) return;
+    cancel();
+    m_thread.join();
+}
+
+bool LiveTrace::start(TSceneKit* scene, const RayTraceOptions& options, int interval)
+{
+    if (isRunning() || !scene) return false;
+
+    m_options = options;
+    m_result = RayTraceResult();
+    m_error.clear();
+    m_ok = false;
+    m_canceled.store(false);
+    m_activeWorkers.store(0);
+    m_options.activeWorkers = &m_activeWorkers;
+
+    m_thread = std::thread([this, scene]() {
+        m_ok = m_runner.trace(scene, m_options, &m_result, &m_error,
+                              RayTraceRunner::ProgressCallback(),
+                              RayTraceRunner::HitCallback(),
+                              RayTraceRunner::WorkerHitCallbackFactory(),
+                              [this]() {return m_canceled.load();});
+        // joined on the thread of the object
+        QMetaObject::invokeMethod(this, [this]() {finish();}, Qt::QueuedConnection);
+    });
+    m_timer.start(interval);
+    return true;
+}
+
+void LiveTrace::cancel()
+{
+    // the runner clears its flag as it starts, the callback is read per chunk
+    m_canceled.store(true);
+    m_runner.cancel();
+}
+
+void LiveTrace::interact()
+{
+    if (!isRunning()) return;
+    m_activeWorkers.store(qMax(1, m_options.workerCount/2));
+    m_idleTimer.start();
+}
+
+void LiveTrace::finish()
+{
+    m_timer.stop();
+    m_idleTimer.stop();
+    if (m_thread.joinable())
+        m_thread.join();
+    emit finished(m_ok);
+}
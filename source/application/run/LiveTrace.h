@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include "core/RayTraceRunner.h"
+
+class TSceneKit;
+
+//! LiveTrace runs a RayTraceRunner trace on a thread of its own.
+/*!
+ * start() returns at once and the caller keeps its event loop: updated() is
+ * emitted every interval while the workers trace, so the view can draw the
+ * photons merged so far (see PhotonsBuffer::copySamplePaths) and show
+ * progress(), and finished() once the trace is done, canceled or failed.
+ *
+ * cancel() stops the workers within a micro-batch of rays, not at the end
+ * of their chunks, so a trace can be stopped as soon as it shows enough.
+ *
+ * interact() holds half the workers between their chunks until the view
+ * has been still for a moment, so moving it stays smooth; with the options
+ * reserveGuiCore and lowPriority the GUI thread also keeps a core and goes
+ * before the workers.
+ * The scene is read by the workers, so it must not be edited until the
+ * trace has finished.
+ */
+class LiveTrace: public QObject
+{
+    Q_OBJECT
+
+public:
+    LiveTrace(QObject* parent = 0);
+    ~LiveTrace();
+
+    // interval between updates in ms
+    bool start(TSceneKit* scene, const RayTraceOptions& options, int interval = 500);
+    bool isRunning() const {return m_thread.joinable();}
+    void cancel();
+    // the user moves the view, see the class comment
+    void interact();
+
+    RayTraceProgress progress() const {return m_runner.progress();}
+    // after finished
+    const RayTraceResult& getResult() const {return m_result;}
+    const QString& getError() const {return m_error;}
+
+signals:
+    void updated();
+    void finished(bool ok);
+
+private:
+    void finish();
+
+    RayTraceRunner m_runner;
+    RayTraceOptions m_options;
+    RayTraceResult m_result;
+    QString m_error;
+    bool m_ok;
+    std::atomic_bool m_canceled;
+    std::atomic<int> m_activeWorkers; // 0 for all, see RayTraceOptions::activeWorkers
+    QTimer m_timer;
+    QTimer m_idleTimer; // ends the hold of interact()
+    std::thread m_thread;
+};
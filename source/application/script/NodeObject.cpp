@@ -1,6 +1,15 @@
 #include "NodeObject.h"
 
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QJSEngine>
+#include <QMessageBox>
+#include <QVector>
+
+#include <cmath>
+#include <string>
+#include <vector>
 
 #include <Inventor/nodes/SoSeparator.h>
 #include <Inventor/nodes/SoTransform.h>
@@ -13,15 +22,134 @@
 #include "kernel/material/MaterialRT.h"
 #include "kernel/trackers/TrackerArmature.h"
 #include "kernel/trackers/TrackerKit.h"
+#include "kernel/trackers/TrackerTarget.h"
 #include "kernel/sun/SunKit.h"
 #include "kernel/air/AirKit.h"
 #include "kernel/sun/SunShape.h"
 #include "kernel/air/AirTransmission.h"
 
+#include "core/SceneEditor.h"
+#include "libraries/auxiliary/LayoutTable.h"
 #include "main/MainWindow.h"
 #include "main/PluginManager.h"
 #include <QQmlEngine>
 
+namespace {
+
+// the columns of a vector in options, as "1 2 3" or [1, 2, 3]
+bool readColumns(QJSValue options, const QString& name, const std::vector<int>& byDefault, std::vector<int>& columns)
+{
+    QJSValue value = options.property(name);
+    if (value.isUndefined()) {
+        columns.insert(columns.end(), byDefault.begin(), byDefault.end());
+        return true;
+    }
+    QStringList list;
+    if (value.isArray()) {
+        for (int i = 0; i < value.property("length").toInt(); ++i)
+            list << value.property(i).toString();
+    } else
+        list = value.toString().split(' ', Qt::SkipEmptyParts);
+    if (list.size() != 3) return false;
+    for (const QString& item : list) {
+        bool ok;
+        columns.push_back(item.toInt(&ok));
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// a new node with the transform and name of kit; the nodes of its group
+// are added shared, but for separators copied down to depth
+TSeparatorKit* copyJoints(TSeparatorKit* kit, int depth)
+{
+    TSeparatorKit* ans = new TSeparatorKit;
+    ans->setName(kit->getName());
+    SoNode* transform = kit->getPart("transform", false);
+    if (transform) ans->setPart("transform", transform->copy());
+
+    SoGroup* group = (SoGroup*) kit->getPart("group", false);
+    if (!group) return ans;
+    SoGroup* groupNew = (SoGroup*) ans->getPart("group", true);
+    for (int q = 0; q < group->getNumChildren(); ++q) {
+        SoNode* child = group->getChild(q);
+        if (depth > 0 && child->getTypeId() == TSeparatorKit::getClassTypeId())
+            groupNew->addChild(copyJoints((TSeparatorKit*) child, depth - 1));
+        else
+            groupNew->addChild(child);
+    }
+    return ans;
+}
+
+// the surfaces of the shapes below node get focal lengths fX and fY,
+// for those that have them
+void setFocus(SoNode* node, double focus)
+{
+    if (node->getTypeId() == TShapeKit::getClassTypeId()) {
+        TShapeKit* kit = (TShapeKit*) node;
+        SoNode* shape = kit->shapeRT.getValue();
+        if (!shape) return;
+        shape = shape->copy();
+        const QString value = QString::number(focus, 'g', 12);
+        for (const char* name : {"fX", "fY"}) {
+            SoField* field = shape->getField(name);
+            if (field) field->set(value.toLatin1().data());
+        }
+        kit->shapeRT = shape;
+    } else if (node->getTypeId() == TSeparatorKit::getClassTypeId()) {
+        SoGroup* group = (SoGroup*) ((TSeparatorKit*) node)->getPart("group", false);
+        if (!group) return;
+        for (int q = 0; q < group->getNumChildren(); ++q)
+            setFocus(group->getChild(q), focus);
+    }
+}
+
+// the shape and profile of a shape kit, or the shape itself without profile
+ShapeRT* findShape(SoNode* node, ProfileRT** profile)
+{
+    *profile = 0;
+    if (node->getTypeId() == TShapeKit::getClassTypeId()) {
+        TShapeKit* kit = (TShapeKit*) node;
+        *profile = (ProfileRT*) kit->profileRT.getValue();
+        return dynamic_cast<ShapeRT*>(kit->shapeRT.getValue());
+    }
+    return dynamic_cast<ShapeRT*>(node);
+}
+
+// the nodes below node by name, the first of each name
+void collectNames(SoNode* node, QHash<QString, SoNode*>& names)
+{
+    if (node->getTypeId() != TSeparatorKit::getClassTypeId()) return;
+    SoGroup* group = (SoGroup*) ((TSeparatorKit*) node)->getPart("group", false);
+    if (!group) return;
+    for (int q = 0; q < group->getNumChildren(); ++q) {
+        SoNode* child = group->getChild(q);
+        const QString name = child->getName().getString();
+        if (!name.isEmpty() && !names.contains(name))
+            names.insert(name, child);
+        collectNames(child, names);
+    }
+}
+
+// a value as text of a field, numbers and arrays of them as vectors
+QString valueText(const QJSValue& value)
+{
+    if (value.isBool())
+        return value.toBool() ? "TRUE" : "FALSE";
+    if (value.isNumber())
+        return QString::number(value.toNumber(), 'g', 17);
+    if (value.isArray()) {
+        QStringList items;
+        for (int i = 0; i < value.property("length").toInt(); ++i)
+            items << valueText(value.property(i));
+        return items.join(' ');
+    }
+    return value.toString();
+}
+
+} // namespace
+
+
 MainWindow* NodeObject::s_mainWindow = 0;
 QJSEngine* NodeObject::s_engine = 0;
 
@@ -214,6 +342,235 @@ void NodeObject::setParameter(const QString& name, const QString& value)
         field->set(value.toLatin1().data());
 }
 
+/*!
+ * The fields are set by SceneEditor without notifying, then each notifies
+ * once, and the sensors of the shapes and trackers run once for all nodes
+ * rather than once per node as with setParameter.
+ */
+QJSValue NodeObject::setParameters(QJSValue nodes, const QString& name, QJSValue values)
+{
+    if (!nodes.isArray()) {
+        QMessageBox::warning(0, "Warning", "The nodes are not an array.");
+        return false;
+    }
+    const int count = nodes.property("length").toInt();
+
+    QHash<QString, SoNode*> names;
+    bool named = false;
+    std::vector<SoNode*> selection;
+    selection.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QJSValue item = nodes.property(i);
+        SoNode* node = 0;
+        if (NodeObject* object = qobject_cast<NodeObject*>(item.toQObject()))
+            node = object->m_node;
+        else {
+            if (!named) {
+                collectNames(m_node, names);
+                named = true;
+            }
+            node = names.value(item.toString(), 0);
+        }
+        if (!node) {
+            QMessageBox::warning(0, "Warning", QString("Node not found:\n") + item.toString());
+            return false;
+        }
+        selection.push_back(node);
+    }
+
+    QStringList texts;
+    if (values.isArray() && values.property("length").toInt() == count) {
+        for (int i = 0; i < count; ++i)
+            texts << valueText(values.property(i));
+    } else
+        texts << valueText(values);
+
+    QString error;
+    if (!SceneEditor::setFields(selection, name, texts, &error)) {
+        QMessageBox::warning(0, "Warning", error);
+        return false;
+    }
+    return count;
+}
+
+/*!
+ * The rows of the file are read by LayoutTable, in parallel, and the nodes
+ * are made here without going through the script per heliostat. The
+ * heliostat node is a template, not in the scene, with a tracker and the
+ * joints its armature turns, as primary and secondary. Every heliostat
+ * gets the translation of its row, its own tracker aiming at the point of
+ * the row, sharing the armature, and copies of the joints; the parts below
+ * the joints, as the facets, are shared among all heliostats, so InstancedFieldNode
+ * draws them with one template.
+ *
+ * Options, SolarPILOT layouts by default:
+ * headerRows (2), position ("1 2 3") and aiming ("9 10 11") columns,
+ * aimingShift ("0 0 0") added to the aiming points, prefix ("H") of the
+ * names, groupSize (0) heliostats under nodes named after their range, and
+ * focusStep (0), taking the focal lengths fX and fY of the surfaces from the
+ * distance to the aiming point rounded to this step; the parts below the
+ * joints are then shared among heliostats of the same focal length.
+ * With terrain, a shape node or kit in the frame of this node, the
+ * elevation of the ground under every heliostat is added to its z, and
+ * rows off the terrain keep theirs.
+ */
+QJSValue NodeObject::createField(const QString& fileName, QJSValue heliostat, QJSValue options)
+{
+    if (m_node->getTypeId() != TSeparatorKit::getClassTypeId())
+        return false;
+    NodeObject* templateObject = qobject_cast<NodeObject*>(heliostat.toQObject());
+    if (!templateObject || templateObject->m_node->getTypeId() != TSeparatorKit::getClassTypeId()) {
+        QMessageBox::warning(0, "Warning", "The heliostat is not a node.");
+        return false;
+    }
+    TSeparatorKit* heliostatKit = (TSeparatorKit*) templateObject->m_node;
+
+    QFileInfo info(QString("project:") + fileName);
+    if (!info.exists()) {
+        QMessageBox::warning(0, "Warning", QString("File not found:\n") + fileName);
+        return false;
+    }
+    QFile file(info.absoluteFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(0, "Warning", QString("File cannot be opened:\n") + fileName);
+        return false;
+    }
+
+    const int headerRows = options.property("headerRows").isUndefined() ? 2 : options.property("headerRows").toInt();
+    std::vector<int> columns;
+    if (!readColumns(options, "position", {1, 2, 3}, columns) || !readColumns(options, "aiming", {9, 10, 11}, columns)) {
+        QMessageBox::warning(0, "Warning", "The position and aiming options take three columns.");
+        return false;
+    }
+    SbVec3f aimingShift(0.f, 0.f, 0.f);
+    if (!options.property("aimingShift").isUndefined()) {
+        QStringList list = options.property("aimingShift").toString().split(' ', Qt::SkipEmptyParts);
+        for (int k = 0; k < 3 && k < list.size(); ++k)
+            aimingShift[k] = list[k].toFloat();
+    }
+    const QString prefix = options.property("prefix").isUndefined() ? "H" : options.property("prefix").toString();
+    const int groupSize = options.property("groupSize").toInt();
+    const double focusStep = options.property("focusStep").toNumber();
+    ShapeRT* terrain = 0;
+    ProfileRT* terrainProfile = 0;
+    if (NodeObject* terrainObject = qobject_cast<NodeObject*>(options.property("terrain").toQObject())) {
+        terrain = findShape(terrainObject->m_node, &terrainProfile);
+        if (!terrain) {
+            QMessageBox::warning(0, "Warning", "The terrain is not a shape.");
+            return false;
+        }
+    }
+
+    // mapped, read where mapping is not supported
+    QByteArray bytes;
+    const uchar* mapped = file.size() > 0 ? file.map(0, file.size()) : nullptr;
+    if (mapped)
+        bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), file.size());
+    else
+        bytes = file.readAll();
+
+    std::vector<std::vector<double>> values;
+    std::string error;
+    if (!LayoutTable::read(bytes.constData(), bytes.size(), headerRows, columns, &values, &error)) {
+        QMessageBox::warning(0, "Warning", fileName + ":\n" + QString::fromStdString(error));
+        return false;
+    }
+
+    // the template
+    TrackerKit* trackerTemplate = 0;
+    QVector<TSeparatorKit*> joints;
+    QVector<SoNode*> others;
+    SoGroup* group = (SoGroup*) heliostatKit->getPart("group", false);
+    for (int q = 0; group && q < group->getNumChildren(); ++q) {
+        SoNode* child = group->getChild(q);
+        if (child->getTypeId() == TrackerKit::getClassTypeId() && !trackerTemplate)
+            trackerTemplate = (TrackerKit*) child;
+        else if (child->getTypeId() == TSeparatorKit::getClassTypeId())
+            joints << (TSeparatorKit*) child;
+        else
+            others << child;
+    }
+
+    // joints below the secondary of a focal length
+    QHash<qint64, QVector<TSeparatorKit*>> jointsByFocus;
+
+    TSeparatorKit* parent = (TSeparatorKit*) m_node;
+    SoGroup* parentGroup = (SoGroup*) parent->getPart("group", true);
+    SoGroup* target = parentGroup;
+    const int count = int(values[0].size());
+    for (int n = 0; n < count; ++n)
+    {
+        if (groupSize > 0 && n % groupSize == 0) {
+            TSeparatorKit* kit = new TSeparatorKit;
+            QString name = prefix + QString::number(n + 1) + "-" + prefix + QString::number(qMin(n + groupSize, count));
+            kit->setName(name.toLatin1().data());
+            parentGroup->addChild(kit);
+            target = (SoGroup*) kit->getPart("group", true);
+        }
+
+        SbVec3f position(values[0][n], values[1][n], values[2][n]);
+        double ground;
+        if (terrain && terrain->findHeight(position[0], position[1], &ground, terrainProfile))
+            position[2] += ground;
+        const SbVec3f aiming = SbVec3f(values[3][n], values[4][n], values[5][n]) + aimingShift;
+
+        TSeparatorKit* kit = new TSeparatorKit;
+        kit->setName((prefix + QString::number(n + 1)).toLatin1().data());
+        TTransform* transform = (TTransform*) kit->getPart("transform", true);
+        transform->translation = position;
+        SoGroup* kitGroup = (SoGroup*) kit->getPart("group", true);
+
+        if (trackerTemplate) {
+            TrackerKit* tracker = new TrackerKit;
+            tracker->enabled = trackerTemplate->enabled.getValue();
+            tracker->armature = trackerTemplate->armature.getValue();
+            if (trackerTemplate->target.getValue())
+                tracker->target = trackerTemplate->target.getValue()->copy();
+            TrackerTarget* tt = (TrackerTarget*) tracker->target.getValue();
+            tt->aimingPoint = aiming;
+            tracker->shape = trackerTemplate->shape.getValue();
+            tracker->m_parent = kit;
+            kitGroup->addChild(tracker);
+        }
+
+        QVector<TSeparatorKit*>* jointList = &joints;
+        if (focusStep > 0.) {
+            const qint64 key = std::llround((aiming - position).length()/focusStep);
+            auto it = jointsByFocus.find(key);
+            if (it == jointsByFocus.end()) {
+                QVector<TSeparatorKit*> copies;
+                for (TSeparatorKit* joint : joints) {
+                    TSeparatorKit* copy = (TSeparatorKit*) joint->copy();
+                    copy->ref();
+                    setFocus(copy, key*focusStep);
+                    copies << copy;
+                }
+                it = jointsByFocus.insert(key, copies);
+            }
+            jointList = &it.value();
+        }
+        for (TSeparatorKit* joint : *jointList)
+            kitGroup->addChild(copyJoints(joint, 1));
+        for (SoNode* node : others)
+            kitGroup->addChild(node);
+        target->addChild(kit);
+    }
+
+    for (const QVector<TSeparatorKit*>& copies : jointsByFocus)
+        for (TSeparatorKit* copy : copies)
+            copy->unref();
+    return count;
+}
+
+QJSValue NodeObject::getHeight(double x, double y)
+{
+    ProfileRT* profile;
+    ShapeRT* shape = findShape(m_node, &profile);
+    double z;
+    if (!shape || !shape->findHeight(x, y, &z, profile)) return false;
+    return z;
+}
+
 QJSValue NodeObject::FindInterception(QJSValue surface, QJSValue rays)
 {
     return ::findInterception(surface.toString(), rays.toUInt(), s_mainWindow);
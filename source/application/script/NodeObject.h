@@ -40,6 +40,16 @@ public slots:
 
     void setName(const QString& name);
     void setParameter(const QString& name, const QString& value);
+    // the parameter of many nodes in one edit, as node objects or names of
+    // nodes below this node, values one per node or a single one for all;
+    // returns how many nodes, false if a node, field or value is wrong
+    QJSValue setParameters(QJSValue nodes, const QString& name, QJSValue values);
+
+    // a heliostat per row of a layout file, made after the heliostat node;
+    // returns how many, false if the file is not read
+    QJSValue createField(const QString& fileName, QJSValue heliostat, QJSValue options = QJSValue());
+    // z of a shape, as a terrain, above (x, y) in its frame; false if there is none
+    QJSValue getHeight(double x, double y);
 
     static QJSValue FindInterception(QJSValue surface, QJSValue rays);
 
@@ -1,21 +1,22 @@
 #include "ScriptRayTracer.h"
 
-#include <QFutureWatcher>
-#include <QMutex>
 #include <QPoint>
-//#include <QScriptContext>
-#include <QtConcurrentMap>
+#include <QThread>
 
 #include <Inventor/actions/SoSearchAction.h>
 #include <Inventor/nodes/SoTransform.h>
 #include <Inventor/nodekits/SoSceneKit.h>
 #include <Inventor/nodes/SoSelection.h>
 
+#include "core/RayTraceRunner.h"
+#include "core/SceneEditor.h"
 #include "kernel/air/AirTransmission.h"
 #include "kernel/node/TonatiuhFunctions.h"
 #include "kernel/photons/PhotonsBuffer.h"
 #include "kernel/random/Random.h"
 #include "kernel/run/RayTracer.h"
+#include "kernel/run/TraceScheduler.h"
+#include "kernel/scene/TSceneKit.h"
 #include "kernel/scene/TSeparatorKit.h"
 #include "kernel/shape/ShapeRT.h"
 #include "kernel/sun/SunAperture.h"
@@ -222,135 +223,60 @@ int ScriptRayTracer::openFile(QString filename)
     return 1;
 }
 
+/*!
+ * Traces the rays of the opened scene with the shared RayTraceRunner, in
+ * chunks on all cores with a generator each. No photons are kept; the
+ * aperture area and photon power of the trace are saved.
+ */
 int ScriptRayTracer::Trace()
 {
-    /*
-           m_sceneModel->UpdateSceneModel();
-           delete m_photonMap;
-           m_photonMap = 0;
-
-           m_photonMap = new TPhotonMap;
-           if( m_photonMapToFile )
-           {
-                ExportToFilePhotonMap* pExportMode
-           }
-           //if( m_selectedPhotonMap > -1 )    m_photonMap = m_TPhotonMapFactoryList[m_selectedPhotonMap]->CreateTPhotonMap();
-           if( !m_photonMap )
-           {
-                std::cerr<<"ScriptRayTracer::Trace() no photonMap defined"<<std::endl;
-                return 0;
-           }
-           if( !m_randomDeviate )
-           {
-                std::cerr<<"ScriptRayTracer::Trace() no random generator defined"<<std::endl;
-                return 0;
-           }
-
-           if( !m_sceneModel )
-           {
-                std::cerr<<"ScriptRayTracer::Trace() no model defined"<<std::endl;
-                return 0;
-           }
-
-           QModelIndex sceneIndex;
-           InstanceNode* sceneInstance = m_sceneModel->NodeFromIndex( sceneIndex );
-           if ( !sceneInstance )
-           {
-                std::cerr<<"ScriptRayTracer::Trace() no scene defined"<<std::endl;
-                return 0;
-           }
-
-           InstanceNode* rootSeparatorInstance = sceneInstance->children[1];
-           if( !rootSeparatorInstance )
-           {
-                std::cerr<<"ScriptRayTracer::Trace() no scene root defined"<<std::endl;
-                return 0;
-           }
-
-           InstanceNode* lightInstance = sceneInstance->children[0];
-           if ( !lightInstance )
-           {
-                std::cerr<<"ScriptRayTracer::Trace() no light defined"<<std::endl;
-                return 0;
-           }
-
-
-           SoSceneKit* coinScene =  static_cast< SoSceneKit* >( sceneInstance->GetNode() );
-
-           if ( !coinScene->getPart( "lightList[0]", false ) )    return 0;
-           SunKit* lightKit = static_cast< SunKit* >( coinScene->getPart( "lightList[0]", false ) );
-           if( m_sunPosistionChanged )    lightKit->ChangePosition( m_sunAzimuth, gc::Pi/2 - m_sunElevation );
-           m_sceneModel->UpdateSceneModel();
-
-           if( !lightKit->getPart( "tsunshape", false ) ) return 0;
-           SunShape* sunShape = static_cast< SunShape * >( lightKit->getPart( "tsunshape", false ) );
-
-
-           if( !lightKit->getPart( "icon", false ) ) return 0;
-           SunAperture* raycastingSurface = static_cast< SunAperture * >( lightKit->getPart( "icon", false ) );
-
-           if( !lightKit->getPart( "transform" ,false ) ) return 0;
-           SoTransform* lightTransform = static_cast< SoTransform* >( lightKit->getPart( "transform" ,false ) );
-           Transform lightToWorld = tgf::TransformFromSoTransform( lightTransform );
-           lightInstance->SetIntersectionTransform( lightToWorld. GetInverse() );
-
-
-           m_sceneModel->PrepareAnalyze();
-
-           //Compute bounding boxes and world to object transforms
-           trf::ComputeSceneTreeMap( rootSeparatorInstance, Transform( new Matrix4x4 ), true );
-
-           SunKit* light = static_cast< SunKit* > ( lightInstance->GetNode() );
-           QStringList disabledNodes = QString( light->disabledNodes.getValue().getString() ).split( ";", Qt::SkipEmptyParts );
-           QVector< QPair< TShapeKit*, Transform > > surfacesList;
-           trf::ComputeFistStageSurfaceList( rootSeparatorInstance, disabledNodes, &surfacesList );
-           light->ComputeLightSourceArea( m_widthDivisions, m_heightDivisions, surfacesList );
-           if( surfacesList.count() < 1 )
-           {
-                std::cerr<<"There are no surfaces defined for ray tracing"<<std::endl;
-                return 0;
-           }
-
-
-           //Check if there is a transmissivity defined
-           AirTransmission* transmissivity;
-           if ( !coinScene->getPart( "air", false ) )    transmissivity = 0;
-           else
-                transmissivity = static_cast< AirTransmission* > ( coinScene->getPart( "air", false ) );
-
-           //Compute the valid areas for the raytracing
-
-           QVector< double > raysPerThread;
-           const int maximumValueProgressScale = 100;
-           unsigned long  t1 = m_numberOfRays / maximumValueProgressScale;
-           for( int progressCount = 0; progressCount < maximumValueProgressScale; ++ progressCount )
-                raysPerThread<< t1;
-
-           if( ( t1 * maximumValueProgressScale ) < m_numberOfRays )    raysPerThread<< ( m_numberOfRays-( t1* maximumValueProgressScale) );
-
-           // Create a QFutureWatcher and connect signals and slots.
-           QFutureWatcher< TPhotonMap* > futureWatcher;
-
-           QMutex mutex;
-           QFuture< TPhotonMap* > photonMap;
-           if( transmissivity )
-                photonMap = QtConcurrent::mappedReduced( raysPerThread, RayTracer(  rootSeparatorInstance, lightInstance, raycastingSurface, sunShape, lightToWorld, transmissivity, *m_randomDeviate, &mutex, m_photonMap ), trf::CreatePhotonMap, QtConcurrent::UnorderedReduce );
-
-           else
-                photonMap = QtConcurrent::mappedReduced( raysPerThread, RayTracerNoTr(  rootSeparatorInstance, lightInstance, raycastingSurface, sunShape, lightToWorld, *m_randomDeviate, &mutex, m_photonMap ), trf::CreatePhotonMap, QtConcurrent::UnorderedReduce );
-
-           futureWatcher.setFuture( photonMap );
-           futureWatcher.waitForFinished();
-
+    if (!m_document || !m_document->getSceneKit())
+    {
+        std::cerr << "ScriptRayTracer::Trace() no scene defined" << std::endl;
+        return 0;
+    }
+    if (m_numberOfRays == 0)
+    {
+        std::cerr << "ScriptRayTracer::Trace() no rays defined" << std::endl;
+        return 0;
+    }
 
-           if( !m_photonMap ) return 1;
-           //if( m_photonMap->StoredRays() == 0 )    return 1;
+    TSceneKit* sceneKit = m_document->getSceneKit();
+    if (m_sunPosistionChanged)
+    {
+        QString errorMessage;
+        if (!SceneEditor::setSun(sceneKit, m_sunAzimuth/gcf::degree, m_sunElevation/gcf::degree, &errorMessage))
+        {
+            std::cerr << "ScriptRayTracer::Trace() " << errorMessage.toStdString() << std::endl;
+            return 0;
+        }
+        SceneEditor::followEdits(sceneKit);
+        m_sunPosistionChanged = false;
+    }
 
-           double irradiance  = m_irradiance;
-           if( irradiance < 0 ) irradiance = sunShape->GetIrradiance();
-           m_area = raycastingSurface->GetValidArea();
-           m_wPhoton = ( m_area * irradiance ) / m_numberOfRays;
+    RayTraceOptions options;
+    bool counterBased = false;
+    if (m_random)
+        options.seed = TraceScheduler::drawSeed(m_random, &counterBased);
+    options.randomGenerator = counterBased ? RayTraceRandomGenerator::CounterBased : RayTraceRandomGenerator::SeededSTL;
+    options.substreamRandom = m_random;
+    options.rays = m_numberOfRays;
+    options.sunWidthDivisions = m_widthDivisions;
+    options.sunHeightDivisions = m_heightDivisions;
+    options.workerCount = qMax(1, QThread::idealThreadCount());
+
+    RayTraceRunner runner;
+    RayTraceResult result;
+    QString errorMessage;
+    if (!runner.trace(sceneKit, options, &result, &errorMessage))
+    {
+        std::cerr << "ScriptRayTracer::Trace() " << errorMessage.toStdString() << std::endl;
+        return 0;
+    }
 
-         */
+    double irradiance = m_irradiance;
+    if (irradiance < 0) irradiance = result.irradiance;
+    m_area = result.sunApertureArea;
+    m_wPhoton = m_area*irradiance/result.raysTraced;
     return 1;
 }
@@ -1,5 +1,7 @@
 #include "SceneTreeModel.h"
 
+#include <algorithm>
+
 #include <QIcon>
 #include <QMessageBox>
 
@@ -11,6 +13,7 @@
 #include <Inventor/nodes/SoSelection.h>
 #include <Inventor/nodes/SoMaterial.h>
 
+#include "application/core/SceneInstanceBuilder.h"
 #include "application/view/GraphicRoot.h"
 #include "kernel/profiles/ProfileRT.h"
 #include "kernel/material/MaterialRT.h"
@@ -32,6 +35,8 @@
 #include "tree/SoPathVariant.h"
 #include "main/Document.h"
 
+// rows added by a fetchMore
+const int FetchBatch = 1000;
 
 SceneTreeModel::SceneTreeModel(QObject* parent):
     QAbstractItemModel(parent),
@@ -115,10 +120,7 @@ void SceneTreeModel::setDocument(Document* document)
 
     TSeparatorKit* nodeLayout = m_nodeScene->getLayout();
     if (nodeLayout)
-    {
         m_instanceLayout = addInstanceNode(m_instanceScene, nodeLayout);
-        generateInstanceTree(m_instanceLayout);
-    }
 
     endResetModel();
 }
@@ -134,24 +136,56 @@ InstanceNode* SceneTreeModel::addInstanceNode(InstanceNode* parent, SoNode* node
     return instance;
 }
 
-void SceneTreeModel::generateInstanceTree(InstanceNode* instance)
+QModelIndex SceneTreeModel::indexOf(InstanceNode* instance) const
 {
-    if (!instance) return;
+    InstanceNode* instanceParent = instance ? instance->getParent() : 0;
+    if (!instanceParent) return QModelIndex();
+    return createIndex(instanceParent->children.indexOf(instance), 0, instance);
+}
 
-    SoNode* node = instance->getNode();
-    if (!node) return;
+int SceneTreeModel::pendingRows(InstanceNode* instance) const
+{
+    if (!instance) return 0;
+    return SceneInstanceBuilder::getChildCount(instance) - instance->children.count();
+}
+
+void SceneTreeModel::fetchRows(InstanceNode* instance, int count)
+{
+    count = std::min(count, pendingRows(instance));
+    if (count <= 0) return;
 
-    if (TSeparatorKit* kit = dynamic_cast<TSeparatorKit*>(node))
+    int first = instance->children.count();
+    beginInsertRows(indexOf(instance), first, first + count - 1);
+    SceneInstanceBuilder::fetchChildren(instance, count);
+    for (int n = first; n < instance->children.count(); ++n)
     {
-        SoGroup* group = (SoGroup*) kit->getPart("group", false);
-        if (!group) return;
-        for (int n = 0; n < group->getNumChildren(); ++n)
-        {
-            SoNode* childNode = (SoNode*) group->getChild(n);
-            InstanceNode* childInstance = addInstanceNode(instance, childNode);
-            generateInstanceTree(childInstance);
-        }
+        InstanceNode* child = instance->children[n];
+        m_mapCoinQt[child->getNode()].append(child);
+        m_instances.insert(child);
     }
+    endInsertRows();
+}
+
+// rows of edited parents must match the children of their groups
+void SceneTreeModel::fetchChildren(SoNode* parent)
+{
+    const QList<InstanceNode*> instances = m_mapCoinQt[parent];
+    for (InstanceNode* instance : instances)
+        fetchRows(instance, pendingRows(instance));
+}
+
+void SceneTreeModel::fetchAll(InstanceNode* instance)
+{
+    if (!instance) return;
+    fetchRows(instance, pendingRows(instance));
+    for (InstanceNode* child : instance->children)
+        fetchAll(child);
+}
+
+InstanceNode* SceneTreeModel::fetchInstanceTree()
+{
+    fetchAll(m_instanceScene);
+    return m_instanceScene;
 }
 
 void SceneTreeModel::deleteInstanceTree(InstanceNode* instance)
@@ -223,6 +257,27 @@ int SceneTreeModel::columnCount(const QModelIndex& /*index*/) const
     return 1;
 }
 
+bool SceneTreeModel::hasChildren(const QModelIndex& index) const
+{
+    if (index.isValid() && index.column() != 0) return false;
+
+    InstanceNode* instance = getInstance(index);
+    if (!instance) return false;
+    return instance->children.count() > 0 || pendingRows(instance) > 0;
+}
+
+bool SceneTreeModel::canFetchMore(const QModelIndex& index) const
+{
+    if (index.isValid() && index.column() != 0) return false;
+    return pendingRows(getInstance(index)) > 0;
+}
+
+void SceneTreeModel::fetchMore(const QModelIndex& index)
+{
+    if (index.isValid() && index.column() != 0) return;
+    fetchRows(getInstance(index), FetchBatch);
+}
+
 QModelIndex SceneTreeModel::parent(const QModelIndex& index) const
 {
     if (!index.isValid() || index.model() != this || index.column() != 0) return QModelIndex();
@@ -359,6 +414,8 @@ bool SceneTreeModel::setNodeName(SoNode* node, QString name)
 {
     SbName sbname(name.toStdString().c_str());
 
+    for (InstanceNode* instance : m_mapCoinQt[node])
+        fetchRows(instance->getParent(), pendingRows(instance->getParent()));
     for (InstanceNode* instance : m_mapCoinQt[node])
     {
         for (InstanceNode* sibling : instance->getParent()->children)
@@ -403,6 +460,9 @@ QModelIndex SceneTreeModel::indexFromUrl(QString url) const
     QModelIndex parentIndex = indexFromUrl(parentURL);
     InstanceNode* instanceParent = getInstance(parentIndex);
     if (!instanceParent) return QModelIndex();
+    // found rows are fetched as views would
+    SceneTreeModel* model = const_cast<SceneTreeModel*>(this);
+    model->fetchRows(instanceParent, pendingRows(instanceParent));
 
     int row = 0;
     for (InstanceNode* child : instanceParent->children)
@@ -491,9 +551,27 @@ QModelIndex SceneTreeModel::indexFromPath(const SoNodeKitPath& path) const
     pathParent->truncate(pathParent->getLength() - temp);
     QModelIndex indexParent = indexFromPath(*pathParent);
     pathParent->unref();
+    InstanceNode* instanceParent = getInstance(indexParent);
+    SceneTreeModel* model = const_cast<SceneTreeModel*>(this);
+    model->fetchRows(instanceParent, row + 1 - (instanceParent ? instanceParent->children.count() : 0));
     return index(row, 0, indexParent);
 }
 
+QModelIndex SceneTreeModel::indexFromRows(const QVector<int>& rows) const
+{
+    SceneTreeModel* model = const_cast<SceneTreeModel*>(this);
+    QModelIndex ans;
+    for (int row : rows)
+    {
+        InstanceNode* instance = getInstance(ans);
+        if (!instance) return QModelIndex();
+        model->fetchRows(instance, row + 1 - instance->children.count());
+        ans = index(row, 0, ans);
+        if (!ans.isValid()) return QModelIndex();
+    }
+    return ans;
+}
+
 SoNodeKitPath* SceneTreeModel::pathFromIndex(const QModelIndex& index) const
 {
     InstanceNode* instance = getInstance(index);
@@ -551,6 +629,8 @@ bool SceneTreeModel::hasChild(SoType type, SoBaseKit* parent)
 
 int SceneTreeModel::insertCoinNode(SoNode* node, SoBaseKit* parent)
 {
+    fetchChildren(parent);
+
     int row = -1;
     if (dynamic_cast<TSeparatorKit*>(parent))
     {
@@ -570,7 +650,6 @@ int SceneTreeModel::insertCoinNode(SoNode* node, SoBaseKit* parent)
         instanceParent->insertChild(row, instance);
         m_mapCoinQt[node].append(instance);
         m_instances.insert(instance);
-        generateInstanceTree(instance);
     }
 
     emit layoutChanged();
@@ -579,6 +658,7 @@ int SceneTreeModel::insertCoinNode(SoNode* node, SoBaseKit* parent)
 
 void SceneTreeModel::removeCoinNode(int row, SoBaseKit* parent)
 {
+    fetchChildren(parent);
     if (parent->getTypeId().isDerivedFrom(TSeparatorKit::getClassTypeId()))
     {
          if (SoGroup* parts = (SoGroup*) parent->getPart("group", false))
@@ -603,6 +683,7 @@ void SceneTreeModel::removeCoinNode(int row, SoBaseKit* parent)
 bool SceneTreeModel::Cut(SoBaseKit* parent, int row)
 {
     if (row < 0) return false;
+    fetchChildren(parent);
 
     QList<InstanceNode*> instancesParent = m_mapCoinQt[parent];
     InstanceNode* instanceParent = instancesParent[0]; //?
@@ -658,6 +739,8 @@ bool SceneTreeModel::Cut(SoBaseKit* parent, int row)
 
 bool SceneTreeModel::Paste(SoBaseKit* parent, SoNode* node, int row, bool isShared) // bugs
 {
+    fetchChildren(parent);
+
     SoNode* child;
     if (isShared)
         child = node;
@@ -676,7 +759,6 @@ bool SceneTreeModel::Paste(SoBaseKit* parent, SoNode* node, int row, bool isShar
         instanceParent->insertChild(row, instance);
         m_mapCoinQt[child].append(instance);
         m_instances.insert(instance);
-        generateInstanceTree(instance);
     }
 
     emit layoutChanged();
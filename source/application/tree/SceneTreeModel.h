@@ -2,6 +2,7 @@
 
 #include <QAbstractItemModel>
 #include <QSet>
+#include <QVector>
 #include <Inventor/SoType.h>
 
 class InstanceNode;
@@ -18,6 +19,13 @@ class Document;
 class AirKit;
 
 
+//! SceneTreeModel shows the layout of a scene as a tree of InstanceNode.
+/*!
+ * Children are fetched as views ask for them (canFetchMore, fetchMore), a
+ * batch at a time, so a scene of many thousands of heliostats opens at
+ * once. Edits fetch the children of the instances they change first, and
+ * fetchInstanceTree() completes the tree ray tracing compiles.
+ */
 class SceneTreeModel: public QAbstractItemModel
 {
     Q_OBJECT
@@ -34,6 +42,9 @@ public:
     QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const;
     int rowCount(const QModelIndex& index) const;
     int columnCount(const QModelIndex& index) const;
+    bool hasChildren(const QModelIndex& index = QModelIndex()) const;
+    bool canFetchMore(const QModelIndex& index) const;
+    void fetchMore(const QModelIndex& index);
     QModelIndex parent(const QModelIndex& index) const;
     QVariant data(const QModelIndex& modelIndex, int role = Qt::DisplayRole) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
@@ -42,10 +53,14 @@ public:
     Qt::DropActions supportedDragActions() const;
 
     InstanceNode* getInstance(const QModelIndex& index) const;
+    // the scene instance with every child fetched
+    InstanceNode* fetchInstanceTree();
     bool setNodeName(SoNode* node, QString name);
     bool setNodeNameUnique(SoNode* node, QString name);
     QModelIndex indexFromUrl(QString url) const;
     QModelIndex indexFromPath(const SoNodeKitPath& path) const;
+    // rows from the scene instance down, as ScenePicker gives them
+    QModelIndex indexFromRows(const QVector<int>& rows) const;
     SoNodeKitPath* pathFromIndex(const QModelIndex& index) const;
 
     bool hasChild(SoType type, SoBaseKit* parent);
@@ -60,7 +75,11 @@ public:
 private:
     void clearInstanceTree();
     InstanceNode* addInstanceNode(InstanceNode* parent, SoNode* node);
-    void generateInstanceTree(InstanceNode* instance);
+    QModelIndex indexOf(InstanceNode* instance) const;
+    int pendingRows(InstanceNode* instance) const;
+    void fetchRows(InstanceNode* instance, int count);
+    void fetchChildren(SoNode* parent);
+    void fetchAll(InstanceNode* instance);
     void deleteInstanceTree(InstanceNode* instance);
     bool containsInstance(InstanceNode* instance) const;
 
@@ -29,6 +29,9 @@
 #include "kernel/scene/GridNode.h"
 #include "kernel/sun/SunPosition.h"
 #include "SeparatorStyle.h"
+#include "InstancedFieldNode.h"
+#include "ScenePicker.h"
+#include "kernel/scene/TShapeKit.h"
 /*
 SoSelection
 selectionFinishCallback
@@ -81,8 +84,10 @@ SoSeparator m_root
            SoShadowDirectionalLight
         SoGroup groupStyle
             SoSwitch sWires
-            SoSelection m_selection
-                TSceneKit
+            SoSwitch m_sceneSwitch
+                SoSelection m_selection
+                    TSceneKit
+                InstancedFieldNode m_field
         GridNode3D m_grid
      SoSeparator m_rays
      OverlayNode m_overlayNode
@@ -92,6 +97,7 @@ GraphicRoot::GraphicRoot()
     m_root = new SoSeparator;
     m_root->renderCulling = SoSeparator::OFF;
     m_root->ref();
+    m_scene = 0;
 
     m_sky = new SkyNode3D;
     m_root->addChild(m_sky);
@@ -136,9 +142,16 @@ GraphicRoot::GraphicRoot()
 
     m_selection = new SoSelection;
     m_selection->renderCulling = SoSeparator::OFF;
-    m_selection->policy = SoSelection::SINGLE;
+    m_selection->policy = SoSelection::DISABLE; // picks come from pick()
+    m_selectionEnabled = true;
+    m_picker = new ScenePicker;
     m_selection->addFinishCallback(selectionFinishCallback, (void*) this);
-    m_groupStyle->addChild(m_selection);
+    m_sceneSwitch = new SoSwitch;
+    m_sceneSwitch->whichChild = 0;
+    m_sceneSwitch->addChild(m_selection);
+    m_field = new InstancedFieldNode;
+    m_sceneSwitch->addChild(m_field);
+    m_groupStyle->addChild(m_sceneSwitch);
 
     m_sepStyle = new SeparatorStyle;
     m_sepStyle->m_root->addChild(m_groupStyle);
@@ -167,6 +180,7 @@ GraphicRoot::~GraphicRoot()
 {
     m_root->unref();
     delete m_sensor;
+    delete m_picker;
 }
 
 #include "kernel/scene/TCameraKit.h"
@@ -205,6 +219,9 @@ void GraphicRoot::setDocument(Document* document)
     m_grid->attach(gridNode);
 
     scene->m_graphicRoot = this;
+    if (m_sceneSwitch->whichChild.getValue() == 1)
+        m_field->setScene(scene);
+    m_picker->setScene(scene);
 
     m_sensor->attach(scene->getPart("world", false)->getField("sun"));
 }
@@ -220,6 +237,8 @@ void GraphicRoot::removeScene()
 //    m_grid->removeAllChildren();
     m_rays->removeAllChildren();
     m_selection->removeAllChildren();
+    m_field->setScene(0);
+    m_picker->setScene(0);
 }
 
 void GraphicRoot::showGrid(bool on)
@@ -264,9 +283,25 @@ void GraphicRoot::setDrawStyle(bool materialOn, bool meshOn)
     m_sepStyle->showMesh = meshOn;
 }
 
+void GraphicRoot::showInstancedField(bool on)
+{
+    // surfaces not drawn build no meshes until they are
+    TShapeKit::setDeferredGL(on);
+    m_field->setScene(on ? m_scene : 0);
+    m_sceneSwitch->whichChild = on ? 1 : 0;
+}
+
 void GraphicRoot::enableSelection(bool on)
 {
-    m_selection->policy = on ? SoSelection::SINGLE : SoSelection::DISABLE;
+    m_selectionEnabled = on;
+}
+
+void GraphicRoot::pick(const Ray& ray)
+{
+    if (!m_selectionEnabled) return;
+    QVector<int> rows;
+    m_picker->pick(ray, &rows);
+    emit picked(rows);
 }
 
 void GraphicRoot::select(const SoPath* path)
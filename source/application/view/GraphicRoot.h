@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QObject>
+#include <QVector>
 #include "GridNode3D.h"
 
 class SoSeparator;
@@ -20,6 +21,10 @@ class OverlayNode;
 class SeparatorStyle;
 class SoDrawStyle;
 class SoPolygonOffset;
+class SoSwitch;
+class InstancedFieldNode;
+class ScenePicker;
+class Ray;
 
 class GraphicRoot: public QObject
 {
@@ -46,8 +51,13 @@ public:
     void showPhotons(bool on);
 
     void setDrawStyle(bool materialOn, bool meshOn);
+    // draws the surfaces of the scene instanced by template
+    void showInstancedField(bool on);
 
     void enableSelection(bool on);
+    bool isSelectionEnabled() const {return m_selectionEnabled;}
+    // emits picked for the surface the world ray hits first
+    void pick(const Ray& ray);
     void select(const SoPath* path);
     void deselectAll();
     void onSelectionChanged(SoSelection* selection);
@@ -60,6 +70,8 @@ public:
 
 signals:
     void selectionChanged(SoSelection* selection);
+    // rows of SceneTreeModel from the scene down to the surface, empty for none
+    void picked(const QVector<int>& rows);
 
 private:
     SoSeparator* m_root;
@@ -69,6 +81,10 @@ private:
     OverlayNode* m_overlayNode;
 
     SoSelection* m_selection;
+    SoSwitch* m_sceneSwitch; // the scene or its instanced field
+    InstancedFieldNode* m_field;
+    ScenePicker* m_picker;
+    bool m_selectionEnabled;
     SoSeparator* m_rays;
     SeparatorStyle* m_sepStyle;
     SoPolygonOffset* m_offset;
@@ -266,6 +266,7 @@ void GraphicView::currentChanged(const QModelIndex& current, const QModelIndex&
 #include <Inventor/nodes/SoTransform.h>
 #include "libraries/math/gcf.h"
 #include "view/OverlayNode.h"
+#include "libraries/math/3D/Ray.h"
 
 void GraphicView::mousePressEvent(QMouseEvent* event)
 {
@@ -311,6 +312,14 @@ void GraphicView::mousePressEvent(QMouseEvent* event)
 void GraphicView::mouseReleaseEvent(QMouseEvent* event)
 {
 //    qDebug() << "release" << event->pos();
+    // a click without a drag selects
+    if (event->button() == Qt::LeftButton && m_modifiersPressed == Qt::NoModifier &&
+        (event->pos() - m_mousePressed).manhattanLength() <= QApplication::startDragDistance())
+    {
+        vec3d direction = m_camera->findRayGlobal(m_viewer, event->pos());
+        m_graphicRoot->pick(Ray(m_camera->m_position, direction));
+    }
+
     if (m_modifiersPressed & Qt::AltModifier)
     {
         if (m_modifiersPressed & Qt::ShiftModifier) {
@@ -542,6 +551,11 @@ void GraphicView::resizeEvent(QResizeEvent* event)
 
 bool GraphicView::eventFilter(QObject* /*obj*/, QEvent* event)
 {
+    // hovering does not move the view
+    if (event->type() == QEvent::MouseButtonPress || event->type() == QEvent::Wheel || event->type() == QEvent::KeyPress ||
+        (event->type() == QEvent::MouseMove && static_cast<QMouseEvent*>(event)->buttons() != Qt::NoButton))
+        emit interacted();
+
     if (event->type() == QEvent::MouseButtonPress ||
         event->type() == QEvent::MouseButtonRelease ||
         event->type() == QEvent::MouseMove ||
@@ -742,6 +756,16 @@ void GraphicView::initContextMenu()
 //    actionViewGroup->setExclusive(false);
 
     menuRendering->addActions(actionViewGroup->actions());
+    menuRendering->addSeparator();
+
+    actionInstancedField = new QAction("Instanced Field", this);
+    actionInstancedField->setCheckable(true);
+    actionInstancedField->setChecked(false);
+    connect(
+        actionInstancedField, SIGNAL(triggered(bool)),
+        this, SLOT(onInstancedField(bool))
+    );
+    menuRendering->addAction(actionInstancedField);
 
     addActions(m_menu->actions()); // for shortcuts
     addAction(actionDrawSwitch); //?
@@ -970,6 +994,12 @@ void GraphicView::onShowPhotons(bool on)
     m_graphicRoot->showPhotons(on);
 }
 
+void GraphicView::onInstancedField(bool on)
+{
+    m_graphicRoot->showInstancedField(on);
+    m_viewer->render();
+}
+
 void GraphicView::hideMenu()
 {
 //    QWindow * hw  = m_viewer->getGLWidget()->property("SoQtGLArea").value<QWindow*>();
@@ -55,8 +55,13 @@ public slots:
     void on_actionDrawSwitch_triggered();
     void onShowRays(bool on);
     void onShowPhotons(bool on);
+    void onInstancedField(bool on);
     void hideMenu();
 
+signals:
+    // a mouse button, wheel or key moved the view
+    void interacted();
+
 public:
     QObject* m_filter;
 
@@ -117,4 +122,5 @@ private:
 
     QAction* actionShowRays;
     QAction* actionShowPhotons;
+    QAction* actionInstancedField;
 };
@@ -0,0 +1,556 @@
+#include "InstancedFieldNode.h"
+
+#include <cstddef>
+#include <string>
+
+#include <Inventor/system/gl.h>
+#include <Inventor/C/glue/gl.h>
+#include <Inventor/SbString.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoGLCacheContextElement.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/elements/SoProjectionMatrixElement.h>
+#include <Inventor/elements/SoViewingMatrixElement.h>
+#include <Inventor/nodes/SoTransformation.h>
+#include <Inventor/sensors/SoNodeSensor.h>
+
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/trackers/TrackerKit.h"
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef GL_DYNAMIC_DRAW
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER 0x8B31
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+
+SO_NODE_SOURCE(InstancedFieldNode)
+
+
+namespace
+{
+
+// attribute locations, the matrix of an instance taking four
+const GLuint PositionAttribute = 0;
+const GLuint NormalAttribute = 1;
+const GLuint InstanceAttribute = 2;
+
+// in the conventions of SbMatrix: row vectors, model before view
+const char* VertexShader = R"(#version 330
+in vec3 position;
+in vec3 normal;
+in mat4 instance;
+uniform mat4 matrixProjectionViewModel;
+uniform mat4 matrixViewModel;
+out float shade;
+
+void main()
+{
+    vec3 n = normalize(mat3(matrixViewModel*instance)*normal);
+    shade = 0.35 + 0.65*abs(n.z); // both sides lit from the eye
+    gl_Position = matrixProjectionViewModel*instance*vec4(position, 1.);
+}
+)";
+
+const char* FragmentShader = R"(#version 330
+in float shade;
+uniform vec3 color;
+out vec4 fragColor;
+
+void main()
+{
+    fragColor = vec4(color*shade, 1.);
+}
+)";
+
+typedef GLuint (APIENTRY* CreateShaderProc)(GLenum);
+typedef void (APIENTRY* ShaderSourceProc)(GLuint, GLsizei, const char* const*, const GLint*);
+typedef void (APIENTRY* CompileShaderProc)(GLuint);
+typedef void (APIENTRY* GetShaderivProc)(GLuint, GLenum, GLint*);
+typedef void (APIENTRY* DeleteShaderProc)(GLuint);
+typedef GLuint (APIENTRY* CreateProgramProc)();
+typedef void (APIENTRY* AttachShaderProc)(GLuint, GLuint);
+typedef void (APIENTRY* BindAttribLocationProc)(GLuint, GLuint, const char*);
+typedef void (APIENTRY* LinkProgramProc)(GLuint);
+typedef void (APIENTRY* GetProgramivProc)(GLuint, GLenum, GLint*);
+typedef void (APIENTRY* DeleteProgramProc)(GLuint);
+typedef void (APIENTRY* UseProgramProc)(GLuint);
+typedef GLint (APIENTRY* GetUniformLocationProc)(GLuint, const char*);
+typedef void (APIENTRY* UniformMatrix4fvProc)(GLint, GLsizei, GLboolean, const GLfloat*);
+typedef void (APIENTRY* Uniform3fProc)(GLint, GLfloat, GLfloat, GLfloat);
+typedef void (APIENTRY* VertexAttribPointerProc)(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*);
+typedef void (APIENTRY* EnableVertexAttribArrayProc)(GLuint);
+typedef void (APIENTRY* DisableVertexAttribArrayProc)(GLuint);
+typedef void (APIENTRY* VertexAttribDivisorProc)(GLuint, GLuint);
+typedef void (APIENTRY* DrawArraysInstancedProc)(GLenum, GLint, GLsizei, GLsizei);
+
+template<class Proc>
+bool resolve(const cc_glglue* glue, const char* name, Proc& proc)
+{
+    proc = reinterpret_cast<Proc>(cc_glglue_getprocaddress(glue, name));
+    return proc != nullptr;
+}
+
+}
+
+
+// the program and buffers of one GL context
+struct InstancedFieldNode::ContextData
+{
+    bool ready = false;
+    GLuint program = 0;
+    GLint matrixProjectionViewModel = -1;
+    GLint matrixViewModel = -1;
+    GLint color = -1;
+    std::vector<unsigned int> vertexBuffers;
+    std::vector<unsigned int> instanceBuffers;
+    ulong geometryVersion = 0;
+    ulong transformVersion = 0;
+
+    CreateShaderProc createShader = nullptr;
+    ShaderSourceProc shaderSource = nullptr;
+    CompileShaderProc compileShader = nullptr;
+    GetShaderivProc getShaderiv = nullptr;
+    DeleteShaderProc deleteShader = nullptr;
+    CreateProgramProc createProgram = nullptr;
+    AttachShaderProc attachShader = nullptr;
+    BindAttribLocationProc bindAttribLocation = nullptr;
+    LinkProgramProc linkProgram = nullptr;
+    GetProgramivProc getProgramiv = nullptr;
+    DeleteProgramProc deleteProgram = nullptr;
+    UseProgramProc useProgram = nullptr;
+    GetUniformLocationProc getUniformLocation = nullptr;
+    UniformMatrix4fvProc uniformMatrix4fv = nullptr;
+    Uniform3fProc uniform3f = nullptr;
+    VertexAttribPointerProc vertexAttribPointer = nullptr;
+    EnableVertexAttribArrayProc enableVertexAttribArray = nullptr;
+    DisableVertexAttribArrayProc disableVertexAttribArray = nullptr;
+    VertexAttribDivisorProc vertexAttribDivisor = nullptr;
+    DrawArraysInstancedProc drawArraysInstanced = nullptr;
+
+    bool init(const cc_glglue* glue);
+    GLuint compile(GLenum type, const char* source);
+    void deleteBuffers(const cc_glglue* glue);
+};
+
+bool InstancedFieldNode::ContextData::init(const cc_glglue* glue)
+{
+    if (!cc_glglue_has_vertex_buffer_object(glue)) return false;
+    bool ok = resolve(glue, "glCreateShader", createShader) &&
+        resolve(glue, "glShaderSource", shaderSource) &&
+        resolve(glue, "glCompileShader", compileShader) &&
+        resolve(glue, "glGetShaderiv", getShaderiv) &&
+        resolve(glue, "glDeleteShader", deleteShader) &&
+        resolve(glue, "glCreateProgram", createProgram) &&
+        resolve(glue, "glAttachShader", attachShader) &&
+        resolve(glue, "glBindAttribLocation", bindAttribLocation) &&
+        resolve(glue, "glLinkProgram", linkProgram) &&
+        resolve(glue, "glGetProgramiv", getProgramiv) &&
+        resolve(glue, "glDeleteProgram", deleteProgram) &&
+        resolve(glue, "glUseProgram", useProgram) &&
+        resolve(glue, "glGetUniformLocation", getUniformLocation) &&
+        resolve(glue, "glUniformMatrix4fv", uniformMatrix4fv) &&
+        resolve(glue, "glUniform3f", uniform3f) &&
+        resolve(glue, "glVertexAttribPointer", vertexAttribPointer) &&
+        resolve(glue, "glEnableVertexAttribArray", enableVertexAttribArray) &&
+        resolve(glue, "glDisableVertexAttribArray", disableVertexAttribArray) &&
+        resolve(glue, "glVertexAttribDivisor", vertexAttribDivisor) &&
+        resolve(glue, "glDrawArraysInstanced", drawArraysInstanced);
+    if (!ok) return false;
+
+    GLuint vs = compile(GL_VERTEX_SHADER, VertexShader);
+    GLuint fs = compile(GL_FRAGMENT_SHADER, FragmentShader);
+    if (vs && fs) {
+        program = createProgram();
+        attachShader(program, vs);
+        attachShader(program, fs);
+        bindAttribLocation(program, PositionAttribute, "position");
+        bindAttribLocation(program, NormalAttribute, "normal");
+        bindAttribLocation(program, InstanceAttribute, "instance");
+        linkProgram(program);
+        GLint linked = 0;
+        getProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            deleteProgram(program);
+            program = 0;
+        }
+    }
+    if (vs) deleteShader(vs);
+    if (fs) deleteShader(fs);
+    if (!program) return false;
+
+    matrixProjectionViewModel = getUniformLocation(program, "matrixProjectionViewModel");
+    matrixViewModel = getUniformLocation(program, "matrixViewModel");
+    color = getUniformLocation(program, "color");
+    return true;
+}
+
+GLuint InstancedFieldNode::ContextData::compile(GLenum type, const char* source)
+{
+    GLuint shader = createShader(type);
+    shaderSource(shader, 1, &source, nullptr);
+    compileShader(shader);
+    GLint compiled = 0;
+    getShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled) return shader;
+    deleteShader(shader);
+    return 0;
+}
+
+void InstancedFieldNode::ContextData::deleteBuffers(const cc_glglue* glue)
+{
+    if (!vertexBuffers.empty())
+        cc_glglue_glDeleteBuffers(glue, GLsizei(vertexBuffers.size()), vertexBuffers.data());
+    if (!instanceBuffers.empty())
+        cc_glglue_glDeleteBuffers(glue, GLsizei(instanceBuffers.size()), instanceBuffers.data());
+    vertexBuffers.clear();
+    instanceBuffers.clear();
+}
+
+void InstancedFieldNode::initClass()
+{
+    SO_NODE_INIT_CLASS(InstancedFieldNode, SoNode, "Node");
+}
+
+InstancedFieldNode::InstancedFieldNode():
+    m_scene(0),
+    m_geometryDirty(false),
+    m_transformsDirty(false),
+    m_geometryVersion(1),
+    m_transformVersion(1)
+{
+    SO_NODE_CONSTRUCTOR(InstancedFieldNode);
+    m_box.makeEmpty();
+
+    // sorts every change as it is notified, before the next frame
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+}
+
+InstancedFieldNode::~InstancedFieldNode()
+{
+    delete m_sensor;
+    if (m_scene) m_scene->unref();
+    releaseContexts();
+}
+
+void InstancedFieldNode::setScene(SoNode* scene)
+{
+    if (scene == m_scene) return;
+    m_sensor->detach();
+    if (m_scene) m_scene->unref();
+
+    m_scene = scene;
+    if (m_scene) {
+        m_scene->ref();
+        m_sensor->attach(m_scene);
+    }
+    m_geometryDirty = true;
+    touch();
+}
+
+ulong InstancedFieldNode::getInstanceCount() const
+{
+    return m_instanceTemplates.size();
+}
+
+void InstancedFieldNode::onSensor(void* data, SoSensor* sensor)
+{
+    InstancedFieldNode* field = static_cast<InstancedFieldNode*>(data);
+    SoNode* trigger = static_cast<SoNodeSensor*>(sensor)->getTriggerNode();
+    if (!trigger || field->m_geometryNodes.count(trigger))
+        field->m_geometryDirty = true;
+    else if (field->m_transformNodes.count(trigger))
+        field->m_transformsDirty = true;
+}
+
+void InstancedFieldNode::update()
+{
+    if (m_geometryDirty || (m_transformsDirty && !readTransforms())) {
+        build();
+        ++m_geometryVersion;
+    }
+    if (m_geometryDirty || m_transformsDirty) {
+        ++m_transformVersion;
+        updateBox();
+    }
+    m_geometryDirty = false;
+    m_transformsDirty = false;
+}
+
+/*!
+ * Sorts the surfaces of the scene into templates by the fields of their
+ * shape, profile and material, reading the triangles of the first of each.
+ */
+void InstancedFieldNode::build()
+{
+    m_templates.clear();
+    m_instanceTemplates.clear();
+    m_geometryNodes.clear();
+    m_transformNodes.clear();
+    if (!m_scene) return;
+
+    std::map<std::string, int> keys;
+    auto key = [](const TShapeKit* kit) {
+        std::string ans;
+        for (SoNode* part : {kit->shapeRT.getValue(), kit->profileRT.getValue(), kit->material.getValue()}) {
+            if (!part) {
+                ans += "-";
+                continue;
+            }
+            SbString fields;
+            part->get(fields);
+            ans += part->getTypeId().getName().getString();
+            ans += "{";
+            ans += fields.getString();
+            ans += "}";
+        }
+        return ans;
+    };
+
+    struct Build
+    {
+        InstancedFieldNode* field;
+        std::map<std::string, int>* keys;
+        decltype(key)* key;
+    } data = {this, &keys, &key};
+
+    SoCallbackAction action;
+    action.addPreCallback(SoNode::getClassTypeId(), [](void* closure, SoCallbackAction* action, const SoNode* node) {
+        Build* data = static_cast<Build*>(closure);
+        InstancedFieldNode* field = data->field;
+        if (node->isOfType(SoTransformation::getClassTypeId())) {
+            field->m_transformNodes.insert(const_cast<SoNode*>(node));
+            return SoCallbackAction::CONTINUE;
+        }
+        if (dynamic_cast<const TrackerKit*>(node))
+            return SoCallbackAction::PRUNE;
+        field->m_geometryNodes.insert(const_cast<SoNode*>(node));
+
+        const TShapeKit* kit = dynamic_cast<const TShapeKit*>(node);
+        if (!kit) return SoCallbackAction::CONTINUE;
+        for (SoNode* part : {kit->shapeRT.getValue(), kit->profileRT.getValue(), kit->material.getValue()})
+            if (part) field->m_geometryNodes.insert(part);
+
+        auto it = data->keys->emplace((*data->key)(kit), int(field->m_templates.size())).first;
+        if (it->second == int(field->m_templates.size())) {
+            field->m_templates.emplace_back();
+            readTemplate(field->m_templates.back(), const_cast<TShapeKit*>(kit));
+        }
+        field->m_templates[it->second].instances.push_back(action->getModelMatrix());
+        field->m_instanceTemplates.push_back(it->second);
+        return SoCallbackAction::PRUNE;
+    }, &data);
+    action.apply(m_scene);
+}
+
+/*!
+ * Reads the transforms of the surfaces again, in the order of build(), and
+ * returns false if the surfaces found are not those of the templates.
+ */
+bool InstancedFieldNode::readTransforms()
+{
+    for (Template& t : m_templates)
+        t.instances.clear();
+
+    struct Read
+    {
+        InstancedFieldNode* field;
+        size_t count;
+    } data = {this, 0};
+
+    SoCallbackAction action;
+    action.addPreCallback(SoNode::getClassTypeId(), [](void* closure, SoCallbackAction* action, const SoNode* node) {
+        Read* data = static_cast<Read*>(closure);
+        InstancedFieldNode* field = data->field;
+        if (dynamic_cast<const TrackerKit*>(node))
+            return SoCallbackAction::PRUNE;
+        if (!dynamic_cast<const TShapeKit*>(node))
+            return SoCallbackAction::CONTINUE;
+        if (data->count == field->m_instanceTemplates.size())
+            return SoCallbackAction::ABORT;
+        const int t = field->m_instanceTemplates[data->count++];
+        field->m_templates[t].instances.push_back(action->getModelMatrix());
+        return SoCallbackAction::PRUNE;
+    }, &data);
+    action.apply(m_scene);
+    return !action.hasTerminated() && data.count == m_instanceTemplates.size();
+}
+
+void InstancedFieldNode::readTemplate(Template& t, TShapeKit* kit)
+{
+    t.box.makeEmpty();
+    t.color.setValue(0.8f, 0.8f, 0.8f);
+    kit->updateShapeGL(); // deferred until now, see TShapeKit::setDeferredGL
+
+    SoCallbackAction action;
+    action.addTriangleCallback(SoShape::getClassTypeId(), [](void* closure, SoCallbackAction* action,
+                                                             const SoPrimitiveVertex* v1,
+                                                             const SoPrimitiveVertex* v2,
+                                                             const SoPrimitiveVertex* v3) {
+        Template* t = static_cast<Template*>(closure);
+        if (t->vertices.empty()) {
+            SbColor ambient, specular, emission;
+            float shininess, transparency;
+            action->getMaterial(ambient, t->color, specular, emission, shininess, transparency);
+        }
+        // in the frame of the kit
+        const SbMatrix& matrix = action->getModelMatrix();
+        for (const SoPrimitiveVertex* v : {v1, v2, v3}) {
+            SbVec3f pos, normal;
+            matrix.multVecMatrix(v->getPoint(), pos);
+            matrix.multDirMatrix(v->getNormal(), normal);
+            normal.normalize();
+            Vertex vertex;
+            pos.getValue(vertex.pos[0], vertex.pos[1], vertex.pos[2]);
+            normal.getValue(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+            t->vertices.push_back(vertex);
+            t->box.extendBy(pos);
+        }
+    }, &t);
+    action.apply(kit);
+}
+
+void InstancedFieldNode::updateBox()
+{
+    m_box.makeEmpty();
+    for (const Template& t : m_templates) {
+        if (t.box.isEmpty()) continue;
+        for (const SbMatrix& matrix : t.instances) {
+            SbBox3f box = t.box;
+            box.transform(matrix);
+            m_box.extendBy(box);
+        }
+    }
+}
+
+void InstancedFieldNode::GLRender(SoGLRenderAction* action)
+{
+    if (!m_scene) return;
+    update();
+
+    SoState* state = action->getState();
+    // the buffers change without notifying the caches
+    SoCacheElement::invalidate(state);
+
+    const uint32_t contextId = SoGLCacheContextElement::get(state);
+    const cc_glglue* glue = cc_glglue_instance(int(contextId));
+    ContextData*& context = m_contexts[contextId];
+    if (!context) {
+        context = new ContextData;
+        context->ready = context->init(glue);
+    }
+    if (!context->ready) {
+        // without instancing the scene is drawn as it is
+        action->traverse(m_scene);
+        return;
+    }
+
+    if (context->geometryVersion != m_geometryVersion) {
+        context->deleteBuffers(glue);
+        context->vertexBuffers.assign(m_templates.size(), 0);
+        context->instanceBuffers.assign(m_templates.size(), 0);
+        if (!m_templates.empty()) {
+            cc_glglue_glGenBuffers(glue, GLsizei(m_templates.size()), context->vertexBuffers.data());
+            cc_glglue_glGenBuffers(glue, GLsizei(m_templates.size()), context->instanceBuffers.data());
+        }
+        for (size_t n = 0; n < m_templates.size(); ++n) {
+            const Template& t = m_templates[n];
+            cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, context->vertexBuffers[n]);
+            cc_glglue_glBufferData(glue, GL_ARRAY_BUFFER, t.vertices.size()*sizeof(Vertex), t.vertices.data(), GL_STATIC_DRAW);
+            cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, context->instanceBuffers[n]);
+            cc_glglue_glBufferData(glue, GL_ARRAY_BUFFER, t.instances.size()*sizeof(SbMatrix), t.instances.data(), GL_DYNAMIC_DRAW);
+        }
+        context->geometryVersion = m_geometryVersion;
+        context->transformVersion = m_transformVersion;
+    } else if (context->transformVersion != m_transformVersion) {
+        // the same surfaces, moved
+        for (size_t n = 0; n < m_templates.size(); ++n) {
+            const Template& t = m_templates[n];
+            cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, context->instanceBuffers[n]);
+            cc_glglue_glBufferSubData(glue, GL_ARRAY_BUFFER, 0, t.instances.size()*sizeof(SbMatrix), t.instances.data());
+        }
+        context->transformVersion = m_transformVersion;
+    }
+
+    const SbMatrix matrixViewModel = SoModelMatrixElement::get(state)*SoViewingMatrixElement::get(state);
+    const SbMatrix matrixProjectionViewModel = matrixViewModel*SoProjectionMatrixElement::get(state);
+    context->useProgram(context->program);
+    context->uniformMatrix4fv(context->matrixViewModel, 1, GL_FALSE, matrixViewModel[0]);
+    context->uniformMatrix4fv(context->matrixProjectionViewModel, 1, GL_FALSE, matrixProjectionViewModel[0]);
+
+    for (size_t n = 0; n < m_templates.size(); ++n) {
+        const Template& t = m_templates[n];
+        if (t.vertices.empty() || t.instances.empty()) continue;
+        context->uniform3f(context->color, t.color[0], t.color[1], t.color[2]);
+
+        cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, context->vertexBuffers[n]);
+        context->vertexAttribPointer(PositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*) offsetof(Vertex, pos));
+        context->vertexAttribPointer(NormalAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*) offsetof(Vertex, normal));
+        context->enableVertexAttribArray(PositionAttribute);
+        context->enableVertexAttribArray(NormalAttribute);
+
+        // a row of SbMatrix is a column of the GL matrix
+        cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, context->instanceBuffers[n]);
+        for (GLuint c = 0; c < 4; ++c) {
+            context->vertexAttribPointer(InstanceAttribute + c, 4, GL_FLOAT, GL_FALSE, sizeof(SbMatrix), (const void*) (c*4*sizeof(float)));
+            context->enableVertexAttribArray(InstanceAttribute + c);
+            context->vertexAttribDivisor(InstanceAttribute + c, 1);
+        }
+        context->drawArraysInstanced(GL_TRIANGLES, 0, GLsizei(t.vertices.size()), GLsizei(t.instances.size()));
+    }
+
+    for (GLuint c = 0; c < 4; ++c) {
+        context->vertexAttribDivisor(InstanceAttribute + c, 0);
+        context->disableVertexAttribArray(InstanceAttribute + c);
+    }
+    context->disableVertexAttribArray(NormalAttribute);
+    context->disableVertexAttribArray(PositionAttribute);
+    cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, 0);
+    context->useProgram(0);
+}
+
+void InstancedFieldNode::getBoundingBox(SoGetBoundingBoxAction* action)
+{
+    if (!m_scene) return;
+    update();
+    if (!m_box.isEmpty())
+        action->extendBy(m_box);
+}
+
+void InstancedFieldNode::releaseContexts()
+{
+    // deleted once the context is current
+    auto deleteContext = [](void* closure, uint32_t contextId) {
+        ContextData* context = static_cast<ContextData*>(closure);
+        context->deleteBuffers(cc_glglue_instance(int(contextId)));
+        if (context->program)
+            context->deleteProgram(context->program);
+        delete context;
+    };
+    for (auto& it : m_contexts)
+        SoGLCacheContextElement::scheduleDeleteCallback(it.first, deleteContext, it.second);
+    m_contexts.clear();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <map>
+#include <unordered_set>
+#include <vector>
+
+#include <Inventor/SbBox3f.h>
+#include <Inventor/SbColor.h>
+#include <Inventor/SbMatrix.h>
+#include <Inventor/nodes/SoSubNode.h>
+
+#include <qglobal.h>
+
+class SoNodeSensor;
+class SoSensor;
+class TShapeKit;
+
+//! InstancedFieldNode draws the surfaces of a scene with hardware instancing.
+/*!
+ * Surfaces with the same shape, profile and material, as the mirrors of a
+ * heliostat field, share one template: its triangles are taken once, from
+ * the first of them, into a vertex buffer, and every surface adds one
+ * transform to the instance buffer of its template. A template is drawn
+ * with one instanced call, so neither the draw calls nor the memory of the
+ * view grow with a mesh per heliostat.
+ *
+ * Changes to the scene are sorted as they are notified: when only
+ * transforms moved, as trackers turn with the sun, the transforms are read
+ * again and the instance buffers rewritten in place; other changes build
+ * the templates anew. Tracker armatures are not drawn, and the node is not
+ * picked.
+ */
+class InstancedFieldNode: public SoNode
+{
+    SO_NODE_HEADER(InstancedFieldNode);
+
+public:
+    static void initClass();
+    InstancedFieldNode();
+
+    // 0 to release the scene
+    void setScene(SoNode* scene);
+    int getTemplateCount() const {return int(m_templates.size());}
+    ulong getInstanceCount() const;
+
+    void GLRender(SoGLRenderAction* action);
+    void getBoundingBox(SoGetBoundingBoxAction* action);
+
+protected:
+    ~InstancedFieldNode();
+
+private:
+    struct Vertex
+    {
+        float pos[3];
+        float normal[3];
+    };
+
+    struct Template
+    {
+        std::vector<Vertex> vertices; // triangles in the frame of the surface
+        SbBox3f box;
+        SbColor color;
+        std::vector<SbMatrix> instances; // surface to world
+    };
+
+    struct ContextData;
+
+    static void onSensor(void* data, SoSensor* sensor);
+    void update();
+    void build();
+    bool readTransforms();
+    static void readTemplate(Template& t, TShapeKit* kit);
+    void updateBox();
+    void releaseContexts();
+
+    SoNode* m_scene;
+    SoNodeSensor* m_sensor;
+    bool m_geometryDirty;
+    bool m_transformsDirty;
+
+    std::vector<Template> m_templates;
+    std::vector<int> m_instanceTemplates; // template of every surface, in traversal order
+    std::unordered_set<SoNode*> m_geometryNodes;  // changes rebuild the templates
+    std::unordered_set<SoNode*> m_transformNodes; // changes move instances
+    SbBox3f m_box;
+    ulong m_geometryVersion;
+    ulong m_transformVersion;
+    std::map<uint32_t, ContextData*> m_contexts; // by GL context
+};
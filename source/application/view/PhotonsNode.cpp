@@ -0,0 +1,258 @@
+#include "PhotonsNode.h"
+
+#include <cmath>
+#include <cstddef>
+#include <unordered_map>
+
+#include <Inventor/system/gl.h>
+#include <Inventor/C/glue/gl.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoGLCacheContextElement.h>
+#include <Inventor/elements/SoGLLazyElement.h>
+#include <Inventor/elements/SoLightModelElement.h>
+
+#include "kernel/photons/PhotonsBuffer.h"
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+SO_NODE_SOURCE(PhotonsNode)
+
+
+namespace
+{
+
+// vertices per buffer object, 16 MB
+const ulong ChunkSize = 1 << 20;
+
+void deleteBuffers(void* closure, uint32_t context)
+{
+    std::vector<unsigned int>* ids = static_cast<std::vector<unsigned int>*>(closure);
+    const cc_glglue* glue = cc_glglue_instance(int(context));
+    cc_glglue_glDeleteBuffers(glue, GLsizei(ids->size()), ids->data());
+    delete ids;
+}
+
+// golden ratio steps of the hue keep neighbouring keys apart
+void setColor(unsigned char* color, int key)
+{
+    double hue = std::fmod(key*0.618033988749895, 1.)*6.;
+    int sector = int(hue);
+    double f = hue - sector;
+    double v = 1.;
+    double p = 0.3;
+    double q = v - (v - p)*f;
+    double t = p + (v - p)*f;
+    double rgb[3];
+    switch (sector) {
+    case 0: rgb[0] = v; rgb[1] = t; rgb[2] = p; break;
+    case 1: rgb[0] = q; rgb[1] = v; rgb[2] = p; break;
+    case 2: rgb[0] = p; rgb[1] = v; rgb[2] = t; break;
+    case 3: rgb[0] = p; rgb[1] = q; rgb[2] = v; break;
+    case 4: rgb[0] = t; rgb[1] = p; rgb[2] = v; break;
+    default: rgb[0] = v; rgb[1] = p; rgb[2] = q; break;
+    }
+    for (int n = 0; n < 3; ++n)
+        color[n] = (unsigned char)(rgb[n]*255. + 0.5);
+    color[3] = 255;
+}
+
+void setColor(unsigned char* color, unsigned char r, unsigned char g, unsigned char b)
+{
+    color[0] = r;
+    color[1] = g;
+    color[2] = b;
+    color[3] = 255;
+}
+
+}
+
+
+void PhotonsNode::initClass()
+{
+    SO_NODE_INIT_CLASS(PhotonsNode, SoShape, "Shape");
+}
+
+PhotonsNode::PhotonsNode():
+    m_style(Points),
+    m_version(1)
+{
+    SO_NODE_CONSTRUCTOR(PhotonsNode);
+    m_box.makeEmpty();
+}
+
+PhotonsNode::~PhotonsNode()
+{
+    releaseBuffers();
+}
+
+void PhotonsNode::setPhotons(const PhotonsBuffer& buffer, Style style, Coloring coloring, ulong limit)
+{
+    clear();
+    m_style = style;
+
+    const ulong total = buffer.isCompact() ? buffer.getPhotonsCompact().size() : buffer.getPhotonCount();
+    // whole rays are skipped, so lines stay joined
+    const ulong rayStride = limit > 0 && total > limit ? (total + limit - 1)/limit : 1;
+
+    std::unordered_map<InstanceNode*, int> surfaces;
+    ulong ray = 0;
+    bool keep = true;
+    bool hasPrevious = false;
+    Vertex previous;
+
+    auto push = [this](const Vertex& vertex) {
+        if (m_chunks.empty() || m_chunks.back().size() == ChunkSize) {
+            m_chunks.emplace_back();
+            m_chunks.back().reserve(ChunkSize);
+        }
+        m_chunks.back().push_back(vertex);
+        m_box.extendBy(SbVec3f(vertex.pos));
+    };
+
+    // surface 0 is air
+    auto add = [&](int id, const vec3d& pos, int surface, bool isAbsorbed) {
+        if (id == 0) {
+            keep = ray % rayStride == 0;
+            ++ray;
+            hasPrevious = false;
+        }
+        if (!keep) return;
+
+        Vertex vertex;
+        vertex.pos[0] = float(pos.x);
+        vertex.pos[1] = float(pos.y);
+        vertex.pos[2] = float(pos.z);
+        if (coloring == ByAbsorption)
+            isAbsorbed ? setColor(vertex.color, 230, 60, 40) : setColor(vertex.color, 255, 255, 200);
+        else if (coloring == ByPathPoint)
+            id == 0 ? setColor(vertex.color, 255, 255, 0) : setColor(vertex.color, id);
+        else
+            surface == 0 ? setColor(vertex.color, 128, 128, 128) : setColor(vertex.color, surface);
+
+        if (m_style == Points)
+            push(vertex);
+        else if (hasPrevious) {
+            push(previous);
+            push(vertex);
+        }
+        previous = vertex;
+        hasPrevious = true;
+    };
+
+    if (buffer.isCompact()) {
+        const PhotonsCompact& photons = buffer.getPhotonsCompact();
+        photons.forEach(0, [&](const PhotonCompact& photon) {
+            add(photon.id(), photons.getPosition(photon), int(photon.surface), photon.isAbsorbed());
+        });
+    } else {
+        buffer.forEachPhoton(0, [&](const Photon& photon) {
+            int surface = 0;
+            if (photon.surface) {
+                auto it = surfaces.emplace(photon.surface, int(surfaces.size()) + 1).first;
+                surface = it->second;
+            }
+            add(photon.id, photon.pos, surface, photon.isAbsorbed);
+        });
+    }
+    touch();
+}
+
+void PhotonsNode::clear()
+{
+    m_chunks.clear();
+    m_box.makeEmpty();
+    ++m_version;
+    touch();
+}
+
+ulong PhotonsNode::getVertexCount() const
+{
+    ulong ans = 0;
+    for (const std::vector<Vertex>& chunk : m_chunks)
+        ans += chunk.size();
+    return ans;
+}
+
+void PhotonsNode::GLRender(SoGLRenderAction* action)
+{
+    if (m_chunks.empty() || !shouldGLRender(action)) return;
+
+    SoState* state = action->getState();
+    // the vertices do not belong in display lists
+    SoCacheElement::invalidate(state);
+
+    const uint32_t context = SoGLCacheContextElement::get(state);
+    const cc_glglue* glue = cc_glglue_instance(int(context));
+    if (!cc_glglue_has_vertex_array(glue)) return;
+
+    state->push();
+    SoLightModelElement::set(state, SoLightModelElement::BASE_COLOR);
+    SoGLLazyElement* lazy = SoGLLazyElement::getInstance(state);
+    lazy->send(state, SoLazyElement::ALL_MASK);
+
+    const bool vbo = cc_glglue_has_vertex_buffer_object(glue);
+    ContextBuffers* buffers = nullptr;
+    if (vbo) {
+        buffers = &m_buffers[context];
+        if (buffers->version != m_version) {
+            if (!buffers->ids.empty())
+                cc_glglue_glDeleteBuffers(glue, GLsizei(buffers->ids.size()), buffers->ids.data());
+            buffers->ids.assign(m_chunks.size(), 0);
+            cc_glglue_glGenBuffers(glue, GLsizei(buffers->ids.size()), buffers->ids.data());
+            for (size_t n = 0; n < m_chunks.size(); ++n) {
+                cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, buffers->ids[n]);
+                cc_glglue_glBufferData(glue, GL_ARRAY_BUFFER, m_chunks[n].size()*sizeof(Vertex), m_chunks[n].data(), GL_STATIC_DRAW);
+            }
+            buffers->version = m_version;
+        }
+    }
+
+    cc_glglue_glEnableClientState(glue, GL_VERTEX_ARRAY);
+    cc_glglue_glEnableClientState(glue, GL_COLOR_ARRAY);
+    const GLenum mode = m_style == Points ? GL_POINTS : GL_LINES;
+    for (size_t n = 0; n < m_chunks.size(); ++n) {
+        const char* base = nullptr; // offset into the bound buffer
+        if (vbo)
+            cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, buffers->ids[n]);
+        else
+            base = reinterpret_cast<const char*>(m_chunks[n].data());
+        cc_glglue_glVertexPointer(glue, 3, GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, pos));
+        cc_glglue_glColorPointer(glue, 4, GL_UNSIGNED_BYTE, sizeof(Vertex), base + offsetof(Vertex, color));
+        cc_glglue_glDrawArrays(glue, mode, 0, GLsizei(m_chunks[n].size()));
+    }
+    cc_glglue_glDisableClientState(glue, GL_COLOR_ARRAY);
+    cc_glglue_glDisableClientState(glue, GL_VERTEX_ARRAY);
+    if (vbo)
+        cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, 0);
+
+    // the colour array leaves the current colour undefined
+    lazy->reset(state, SoLazyElement::DIFFUSE_MASK);
+    state->pop();
+}
+
+void PhotonsNode::computeBBox(SoAction* /*action*/, SbBox3f& box, SbVec3f& center)
+{
+    box = m_box;
+    center = m_box.isEmpty() ? SbVec3f(0.f, 0.f, 0.f) : m_box.getCenter();
+}
+
+void PhotonsNode::generatePrimitives(SoAction* /*action*/)
+{
+    // photons are drawn only
+}
+
+void PhotonsNode::releaseBuffers()
+{
+    for (auto& it : m_buffers) {
+        if (it.second.ids.empty()) continue;
+        std::vector<unsigned int>* ids = new std::vector<unsigned int>(it.second.ids);
+        SoGLCacheContextElement::scheduleDeleteCallback(it.first, deleteBuffers, ids);
+    }
+    m_buffers.clear();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <Inventor/SbBox3f.h>
+#include <Inventor/nodes/SoShape.h>
+#include <Inventor/nodes/SoSubNode.h>
+
+#include <qglobal.h>
+
+class PhotonsBuffer;
+
+//! PhotonsNode draws the photons of a photon buffer from vertex buffers.
+/*!
+ * setPhotons() copies the positions of the retained photons, full or
+ * compact, into chunks of float vertices with a colour each, without an
+ * SoCoordinate3 field in between. They are drawn as points, or as lines
+ * from every photon to the next one along its ray.
+ *
+ * The chunks are uploaded once per GL context into vertex buffer objects
+ * and drawn unlit, so the frame rate does not depend on copying millions of
+ * photons through the scene graph. Without vertex buffer objects the chunks
+ * are drawn as client vertex arrays.
+ *
+ * Photons are not picked and generate no primitives.
+ */
+class PhotonsNode: public SoShape
+{
+    SO_NODE_HEADER(PhotonsNode);
+
+public:
+    enum Style {
+        Points,
+        Lines
+    };
+
+    enum Coloring {
+        BySurface,   // a colour per surface, grey for air
+        ByPathPoint, // by the number of the point along the ray
+        ByAbsorption // absorbed photons in red, the others in yellow
+    };
+
+    static void initClass();
+    PhotonsNode();
+
+    // every photon if limit is 0, else about limit photons evenly spread over the rays
+    void setPhotons(const PhotonsBuffer& buffer, Style style = Points, Coloring coloring = BySurface, ulong limit = 0);
+    void clear();
+    ulong getVertexCount() const;
+
+    void GLRender(SoGLRenderAction* action);
+
+protected:
+    ~PhotonsNode();
+
+    void computeBBox(SoAction* action, SbBox3f& box, SbVec3f& center);
+    void generatePrimitives(SoAction* action);
+
+private:
+    struct Vertex
+    {
+        float pos[3];
+        unsigned char color[4];
+    };
+
+    struct ContextBuffers
+    {
+        std::vector<unsigned int> ids;
+        ulong version = 0;
+    };
+
+    void releaseBuffers();
+
+    Style m_style;
+    std::vector<std::vector<Vertex>> m_chunks;
+    SbBox3f m_box;
+    ulong m_version; // of the chunks
+    std::map<uint32_t, ContextBuffers> m_buffers; // by GL context
+};
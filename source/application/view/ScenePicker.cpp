@@ -0,0 +1,72 @@
+#include "ScenePicker.h"
+
+#include <algorithm>
+
+#include <Inventor/sensors/SoNodeSensor.h>
+
+#include "kernel/run/InstanceNode.h"
+#include "kernel/run/SceneBVH.h"
+#include "kernel/scene/TSceneKit.h"
+#include "kernel/scene/TSeparatorKit.h"
+#include "libraries/math/3D/Ray.h"
+#include "libraries/math/3D/Transform.h"
+
+
+ScenePicker::ScenePicker():
+    m_scene(0),
+    m_dirty(true)
+{
+    m_sensor = new SoNodeSensor(onSensor, this);
+}
+
+ScenePicker::~ScenePicker()
+{
+    delete m_sensor;
+}
+
+void ScenePicker::setScene(TSceneKit* scene)
+{
+    m_sensor->detach();
+    m_scene = scene;
+    // the camera is outside, so views do not recompile
+    TSeparatorKit* layout = m_scene ? m_scene->getLayout() : 0;
+    if (layout) m_sensor->attach(layout);
+    m_bvh.reset();
+    m_tree = SceneInstanceTree();
+    m_dirty = true;
+}
+
+void ScenePicker::onSensor(void* data, SoSensor*)
+{
+    ScenePicker* picker = static_cast<ScenePicker*>(data);
+    picker->m_dirty = true;
+}
+
+void ScenePicker::compile()
+{
+    m_bvh.reset();
+    m_tree = SceneInstanceBuilder::build(m_scene);
+    m_dirty = false;
+    if (!m_tree.layoutRoot) return;
+
+    m_tree.layoutRoot->updateTree(Transform::Identity);
+    m_bvh.reset(new SceneBVH(m_tree.layoutRoot));
+}
+
+bool ScenePicker::pick(const Ray& ray, QVector<int>* rows)
+{
+    if (m_dirty) compile();
+    if (!m_bvh || m_bvh->isEmpty()) return false;
+
+    Ray r = ray;
+    SceneBVHHit hit;
+    if (!m_bvh->findHit(r, hit) || !hit.instance) return false;
+
+    if (rows) {
+        rows->clear();
+        for (InstanceNode* instance = hit.instance; instance->getParent(); instance = instance->getParent())
+            rows->append(instance->getParent()->children.indexOf(instance));
+        std::reverse(rows->begin(), rows->end());
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+
+#include <QVector>
+
+#include "core/SceneInstanceBuilder.h"
+
+class Ray;
+class SceneBVH;
+class SoNodeSensor;
+class SoSensor;
+class TSceneKit;
+
+//! ScenePicker answers viewport picks with the compiled scene of the ray tracer.
+/*!
+ * The instance tree and the SceneBVH of the layout are built at the first
+ * pick after the layout changed, so a pick costs one BVH traversal however
+ * large the field is, instead of a pick traversal of the scene graph.
+ *
+ * A hit is given as the rows from the scene instance down to the surface,
+ * which are those of SceneTreeModel, built from the same kit groups. As by
+ * the ray tracer, surfaces with a transparent material are not hit.
+ */
+class ScenePicker
+{
+public:
+    ScenePicker();
+    ~ScenePicker();
+
+    void setScene(TSceneKit* scene);
+    // false without a hit
+    bool pick(const Ray& ray, QVector<int>* rows);
+
+private:
+    static void onSensor(void* data, SoSensor*);
+    void compile();
+
+    TSceneKit* m_scene;
+    SoNodeSensor* m_sensor;
+    bool m_dirty;
+    SceneInstanceTree m_tree;
+    std::unique_ptr<SceneBVH> m_bvh;
+};
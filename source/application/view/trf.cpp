@@ -24,29 +24,72 @@
 #include "kernel/sun/SunKit.h"
 #include "libraries/math/3D/Matrix4x4.h"
 #include "libraries/math/3D/Ray.h"
+#include "view/PhotonsNode.h"
 
+namespace
+{
+
+// photons drawn from vertex buffers, 256 MB of them
+const ulong PhotonsLimit = 1 << 24;
+
+}
 
+
+/*!
+ * Draws at most \a raysLimit rays of \a map: the display sample collected while
+ * tracing or, without one, a uniform sample of the retained photons.
+ * The photons themselves are all drawn, up to PhotonsLimit, from the vertex
+ * buffers of a PhotonsNode coloured by surface.
+ */
 void trf::DrawRays(SoSeparator* parent, const PhotonsBuffer& map, long raysLimit)
+{
+    const PhotonsSample& sample = map.getSample();
+    if (sample.getBudget() > 0 && sample.getBudget() <= ulong(raysLimit))
+        DrawRays(parent, sample);
+    else {
+        PhotonsSample retained(raysLimit > 0 ? ulong(raysLimit) : 0);
+        if (map.isCompact())
+            retained.add(map.getPhotonsCompact());
+        else
+            map.forEachPhoton(0, [&](const Photon& photon) {retained.add(photon);});
+        DrawRays(parent, retained);
+    }
+    if (!map.hasRetainedPhotons()) return;
+
+    for (int n = 0; n < parent->getNumChildren(); ++n) {
+        SoNode* node = parent->getChild(n);
+        if (!node->isOfType(SoSwitch::getClassTypeId()) || node->getName() != "photons") continue;
+        SoSwitch* sPhotons = static_cast<SoSwitch*>(node);
+        sPhotons->removeAllChildren();
+        PhotonsNode* photons = new PhotonsNode;
+        photons->setPhotons(map, PhotonsNode::Points, PhotonsNode::BySurface, PhotonsLimit);
+        sPhotons->addChild(photons);
+        break;
+    }
+}
+
+void trf::DrawRays(SoSeparator* parent, const PhotonsSample& sample)
+{
+    DrawRays(parent, sample.getPaths());
+}
+
+void trf::DrawRays(SoSeparator* parent, const std::vector<std::vector<vec3d>>& paths)
 {
     parent->removeAllChildren();
 
-    SoCoordinate3* points = new SoCoordinate3;
-    QVector<int> rayLengths;
-    uint n = 0;
-    int s = 0;
-    for (const Photon& photon : map.getPhotons())
-    {
-        if (photon.id == 0 && s > 0) {
-            rayLengths << s;
-            s = 0;
-            if (rayLengths.size() >= raysLimit) break;
-        }
-        const vec3d& pos = photon.pos;
-        points->point.set1Value(n++, pos.x, pos.y, pos.z);
-        s++;
+    std::vector<SbVec3f> points;
+    std::vector<int> rayLengths;
+    for (const std::vector<vec3d>& path : paths) {
+        if (path.empty()) continue;
+        for (const vec3d& pos : path)
+            points.emplace_back(pos.x, pos.y, pos.z);
+        rayLengths.push_back(int(path.size()));
     }
-    if (s > 0) rayLengths << s;
-    parent->addChild(points);
+
+    // one copy into the field instead of growing it point by point
+    SoCoordinate3* coordinates = new SoCoordinate3;
+    coordinates->point.setValues(0, int(points.size()), points.data());
+    parent->addChild(coordinates);
 
     SoDrawStyle* style = new SoDrawStyle;
     style->lineWidth = 1.;
@@ -63,7 +106,7 @@ void trf::DrawRays(SoSeparator* parent, const PhotonsBuffer& map, long raysLimit
     sRays->addChild(materialRays);
 
     SoLineSet* lineSet = new SoLineSet;
-    lineSet->numVertices.setValues(0, rayLengths.size(), rayLengths.data());
+    lineSet->numVertices.setValues(0, int(rayLengths.size()), rayLengths.data());
     sRays->addChild(lineSet);
 
     // points
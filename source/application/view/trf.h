@@ -22,10 +22,13 @@
 class InstanceNode;
 class Random;
 class PhotonsBuffer;
+class PhotonsSample;
 
 namespace trf
 {
     void DrawRays(SoSeparator* group, const PhotonsBuffer& map, long raysLimit);
+    void DrawRays(SoSeparator* group, const PhotonsSample& sample);
+    void DrawRays(SoSeparator* group, const std::vector<std::vector<vec3d>>& paths);
 
 //    TONATIUH_KERNEL void CreatePhotonMap(Photons*& photonMap, QPair<Photons*, std::vector<Photon> > photonsList);
     Transform GetObjectToWorld(SoPath* nodePath);
@@ -19,3 +19,10 @@ double AirExponential::transmission(double distance) const
 {
     return exp(-constant.getValue()*distance);
 }
+
+void AirExponential::transmissions(std::span<const double> distances, std::span<double> values) const
+{
+    const double c = -constant.getValue();
+    for (std::size_t n = 0; n < distances.size(); ++n)
+        values[n] = exp(c*distances[n]);
+}
@@ -12,6 +12,7 @@ public:
     AirExponential();
 
     double transmission(double distance) const;
+    void transmissions(std::span<const double> distances, std::span<double> values) const;
     SoSFDouble constant;
 
     NAME_ICON_FUNCTIONS("Exponential", ":/air/AirAbstract.png")
@@ -1,5 +1,7 @@
 #include "AirTransmission.h"
 
+#include <algorithm>
+
 SO_NODE_ABSTRACT_SOURCE(AirTransmission)
 
 
@@ -7,3 +9,22 @@ void AirTransmission::initClass()
 {
     SO_NODE_INIT_ABSTRACT_CLASS(AirTransmission, TNode, "TNode");
 }
+
+void AirTransmission::transmissions(std::span<const double> distances, std::span<double> values) const
+{
+    for (std::size_t n = 0; n < distances.size(); ++n)
+        values[n] = transmission(distances[n]);
+}
+
+LookupTable AirTransmission::tabulate(double distanceMax, int size) const
+{
+    // fits that turn up again past their range are held at their minimum,
+    // build evaluates the distances in increasing order
+    double tMin = 1.;
+    LookupTable ans;
+    ans.build([this, &tMin](double d) {
+        tMin = std::min(tMin, std::clamp(transmission(d), 0., 1.));
+        return tMin;
+    }, 0., distanceMax, size);
+    return ans;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <span>
+
 #include "kernel/node/TNode.h"
+#include "libraries/math/1D/LookupTable.h"
 
 
 class TONATIUH_KERNEL AirTransmission: public TNode
@@ -11,6 +14,11 @@ public:
     static void initClass();
 
     virtual double transmission(double distance) const = 0;
+    // transmission of every distance into values, which is as long
+    virtual void transmissions(std::span<const double> distances, std::span<double> values) const;
+    // transmission sampled at size distances spanning [0, distanceMax],
+    // clamped to [0, 1] and never increasing
+    LookupTable tabulate(double distanceMax, int size) const;
 
     NAME_ICON_FUNCTIONS("Air", ":/images/AirX.png")
 };
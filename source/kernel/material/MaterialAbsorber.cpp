@@ -27,3 +27,10 @@ bool MaterialAbsorber::OutputRay(const Ray& rayIn, const DifferentialGeometry& d
 
     return false;
 }
+
+void MaterialAbsorber::OutputRays(std::span<MaterialHit> hits, Random& rand) const
+{
+    Q_UNUSED(rand)
+    for (MaterialHit& hit : hits)
+        hit.isReflected = false;
+}
@@ -27,15 +27,33 @@ MaterialFresnelUnpolarized::MaterialFresnelUnpolarized()
     SO_NODE_ADD_FIELD(slope, (0.002) ); // in radians
 }
 
-bool MaterialFresnelUnpolarized::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const
+namespace {
+
+// the fields, read once per call or batch
+struct Surface
+{
+    explicit Surface(const MaterialFresnelUnpolarized& m):
+        nFront(m.nFront.getValue()),
+        nBack(m.nBack.getValue()),
+        distribution(m.distribution.getValue()),
+        slope(m.slope.getValue())
+    {}
+
+    double nFront;
+    double nBack;
+    int distribution;
+    double slope;
+};
+
+bool shade(const Surface& surface, const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut)
 {
     Q_UNUSED(rand)
 
     // surface roughness
     vec3d normal;
-    double sigma = slope.getValue();
+    double sigma = surface.slope;
     if (sigma > 0.) {
-        if (distribution.getValue() == Distribution::pillbox)
+        if (surface.distribution == MaterialFresnelUnpolarized::Distribution::pillbox)
         {
             double phi = gcf::TwoPi*rand.RandomDouble();
             double sinTheta = sin(sigma)*sqrt(rand.RandomDouble());
@@ -44,7 +62,7 @@ bool MaterialFresnelUnpolarized::OutputRay(const Ray& rayIn, const DifferentialG
             normal.y = sinTheta*sin(phi);
             normal.z = cosTheta;
         }
-        else //if (distribution.getValue() == Distribution::Gaussian)
+        else //if (surface.distribution == Distribution::Gaussian)
         {
             // https://en.wikipedia.org/wiki/Marsaglia_polar_method
             double u, v, s;
@@ -70,8 +88,8 @@ bool MaterialFresnelUnpolarized::OutputRay(const Ray& rayIn, const DifferentialG
     // select sides according to incident ray
     const vec3d& dI = rayIn.direction();
     double dIn = dot(dI, normal);
-    double nI = nFront.getValue();
-    double nT = nBack.getValue();
+    double nI = surface.nFront;
+    double nT = surface.nBack;
     if (dIn > 0.) {
         std::swap(nI, nT);
         normal = -normal;
@@ -101,3 +119,18 @@ bool MaterialFresnelUnpolarized::OutputRay(const Ray& rayIn, const DifferentialG
     rayOut.setDirection(dO);
     return true;
 }
+
+} // namespace
+
+
+bool MaterialFresnelUnpolarized::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const
+{
+    return shade(Surface(*this), rayIn, dg, rand, rayOut);
+}
+
+void MaterialFresnelUnpolarized::OutputRays(std::span<MaterialHit> hits, Random& rand) const
+{
+    const Surface surface(*this);
+    for (MaterialHit& hit : hits)
+        hit.isReflected = shade(surface, *hit.rayIn, *hit.dg, rand, hit.rayOut);
+}
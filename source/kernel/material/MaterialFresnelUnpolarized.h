@@ -23,6 +23,7 @@ public:
     SoSFDouble slope;
 
     bool OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const;
+    void OutputRays(std::span<MaterialHit> hits, Random& rand) const;
 
     NAME_ICON_FUNCTIONS("Fresnel (unpolarized)", ":/material/MaterialFresnel.png")
 
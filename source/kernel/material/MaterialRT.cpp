@@ -1,5 +1,7 @@
 #include "MaterialRT.h"
 
+#include "kernel/random/Random.h"
+
 SO_NODE_ABSTRACT_SOURCE(MaterialRT)
 
 
@@ -7,3 +9,19 @@ void MaterialRT::initClass()
 {
     SO_NODE_INIT_ABSTRACT_CLASS(MaterialRT, TNode, "TNode");
 }
+
+void MaterialRT::OutputRays(std::span<MaterialHit> hits, Random& rand) const
+{
+    for (MaterialHit& hit : hits)
+        hit.isReflected = OutputRay(*hit.rayIn, *hit.dg, rand, hit.rayOut);
+}
+
+bool MaterialRT::OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& /*weight*/) const
+{
+    return OutputRay(rayIn, dg, rand, rayOut);
+}
+
+bool MaterialRT::getSpecularModel(double* /*reflectivity*/, SlopeSampler* /*slope*/) const
+{
+    return false;
+}
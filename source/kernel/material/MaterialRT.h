@@ -1,10 +1,23 @@
 #pragma once
 
+#include <span>
+
 #include "kernel/node/TNode.h"
+#include "libraries/math/3D/Ray.h"
 
 struct DifferentialGeometry;
 class Random;
-class Ray;
+class SlopeSampler;
+
+
+//! MaterialHit is one hit of a batch shaded by MaterialRT::OutputRays.
+struct MaterialHit
+{
+    const Ray* rayIn;
+    const DifferentialGeometry* dg;
+    Ray rayOut; // set if isReflected
+    bool isReflected;
+};
 
 
 class TONATIUH_KERNEL MaterialRT: public TNode
@@ -16,6 +29,15 @@ public:
 
     //Ray* OutputRay(const Ray& incident, DifferentialGeometry* dg, RandomDeviate& rand) const;
     virtual bool OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const = 0;
+    // the hits in order, drawing the random numbers of OutputRay for each
+    virtual void OutputRays(std::span<MaterialHit> hits, Random& rand) const;
+    // as OutputRay, but the fraction reflected multiplies weight instead of
+    // being decided by a draw; by default the draw decides and weight is kept
+    virtual bool OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& weight) const;
+    // for a mirror reflecting with probability reflectivity about the normal
+    // tilted by the errors of slope, from both sides, sets them and returns
+    // true; false by default, see RayTracer::setSpecularSpreads
+    virtual bool getSpecularModel(double* reflectivity, SlopeSampler* slope) const;
 
     NAME_ICON_FUNCTIONS("X", ":/MaterialX.png")
 };
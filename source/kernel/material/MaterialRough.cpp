@@ -27,11 +27,28 @@ MaterialRough::MaterialRough()
 
 }
 
+namespace {
+
+// the fields, read once per call or batch
+struct Surface
+{
+    explicit Surface(const MaterialRough& m):
+        diffuse(m.diffuse.getValue()),
+        specular(m.specular.getValue()),
+        distribution(m.distribution.getValue()),
+        roughness(m.roughness.getValue())
+    {}
+
+    double diffuse;
+    double specular;
+    int distribution;
+    double roughness;
+};
 
 // http://www.pbr-book.org/3ed-2018/Light_Transport_I_Surface_Reflection/Sampling_Reflection_Functions.html
-bool MaterialRough::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const
+bool shade(const Surface& surface, const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut)
 {
-    if (rand.RandomDouble() <= diffuse.getValue())
+    if (rand.RandomDouble() <= surface.diffuse)
     {
         rayOut.origin = dg.point;
 
@@ -55,20 +72,20 @@ bool MaterialRough::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg,
         rayOut.setDirection(dDiff);
         return true;
     }
-    else if (rand.RandomDouble() <= diffuse.getValue() + specular.getValue())
+    else if (rand.RandomDouble() <= surface.diffuse + surface.specular)
     {
         rayOut.origin = dg.point;
 
         vec3d normal;
-        double alpha = roughness.getValue();
+        double alpha = surface.roughness;
         if (alpha > 0.) {
             double phi = gcf::TwoPi*rand.RandomDouble();
             double tan2Theta = 0.;
-            if (distribution.getValue() == Distribution::Beckmann)
+            if (surface.distribution == MaterialRough::Distribution::Beckmann)
             {
                 tan2Theta = -gcf::pow2(alpha)*std::log(rand.RandomDouble());
             }
-            else if (distribution.getValue() == Distribution::Trowbridge)
+            else if (surface.distribution == MaterialRough::Distribution::Trowbridge)
             {
                 double u = rand.RandomDouble();
                 tan2Theta = gcf::pow2(alpha)*u/(1. - u);
@@ -98,3 +115,18 @@ bool MaterialRough::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg,
 
     return false;
 }
+
+} // namespace
+
+
+bool MaterialRough::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const
+{
+    return shade(Surface(*this), rayIn, dg, rand, rayOut);
+}
+
+void MaterialRough::OutputRays(std::span<MaterialHit> hits, Random& rand) const
+{
+    const Surface surface(*this);
+    for (MaterialHit& hit : hits)
+        hit.isReflected = shade(surface, *hit.rayIn, *hit.dg, rand, hit.rayOut);
+}
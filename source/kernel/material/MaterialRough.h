@@ -17,6 +17,7 @@ public:
     MaterialRough();
 
     bool OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const;
+    void OutputRays(std::span<MaterialHit> hits, Random& rand) const;
 
     SoSFDouble diffuse;
     SoSFDouble specular;
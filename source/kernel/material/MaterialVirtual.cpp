@@ -26,3 +26,13 @@ bool MaterialVirtual::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg
     rayOut.setDirection(rayIn.direction());
 	return true;
 }
+
+void MaterialVirtual::OutputRays(std::span<MaterialHit> hits, Random& rand) const
+{
+    Q_UNUSED(rand)
+    for (MaterialHit& hit : hits) {
+        hit.rayOut.origin = hit.dg->point;
+        hit.rayOut.setDirection(hit.rayIn->direction());
+        hit.isReflected = true;
+    }
+}
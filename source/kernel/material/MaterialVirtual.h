@@ -12,6 +12,7 @@ public:
     MaterialVirtual();
 
     bool OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const;
+    void OutputRays(std::span<MaterialHit> hits, Random& rand) const;
 
     NAME_ICON_FUNCTIONS("Virtual", ":/material/MaterialVirtual.png")
 
@@ -0,0 +1,87 @@
+#include "SlopeSampler.h"
+
+#include <cmath>
+
+#include "libraries/math/gcf.h"
+#include "libraries/math/1D/LookupTable.h"
+
+namespace {
+
+const int TableSize = 1024;
+const double TailMin = 63./64.;
+
+struct Tables
+{
+    Tables()
+    {
+        tilt2.build([](double u) {return -2.*std::log(1. - u);}, 0., TailMin, TableSize);
+        cosine.build([](double v) {return std::cos(gcf::TwoPi*v);}, 0., 1., TableSize);
+        sine.build([](double v) {return std::sin(gcf::TwoPi*v);}, 0., 1., TableSize);
+    }
+
+    LookupTable tilt2; // squared tilt tangent of unit deviation
+    LookupTable cosine; // of the azimuth in turns
+    LookupTable sine;
+};
+
+const Tables& tables()
+{
+    static const Tables ans;
+    return ans;
+}
+
+} // namespace
+
+
+SlopeSampler::SlopeSampler(Distribution distribution, double sigma):
+    m_distribution(distribution),
+    m_sigma(sigma),
+    m_sinSigma(std::sin(sigma))
+{
+    tables();
+}
+
+vec3d SlopeSampler::sample(double u, double v) const
+{
+    double c, s;
+    azimuth(v, c, s);
+
+    if (m_distribution == pillbox) {
+        double sinTheta = m_sinSigma*std::sqrt(u);
+        double cosTheta = std::sqrt(1. - sinTheta*sinTheta);
+        return vec3d(sinTheta*c, sinTheta*s, cosTheta);
+    }
+
+    const Tables& t = tables();
+    double r2 = u < TailMin ? t.tilt2(u) : -2.*std::log(1. - u);
+    double r = m_sigma*std::sqrt(r2);
+    vec3d ans(r*c, r*s, 1.);
+    return ans/std::sqrt(1. + r*r);
+}
+
+void SlopeSampler::azimuth(double v, double& c, double& s)
+{
+    const Tables& t = tables();
+    c = t.cosine(v);
+    s = t.sine(v);
+    double k = 1./std::sqrt(c*c + s*s); // the lerps shorten (c, s) slightly
+    c *= k;
+    s *= k;
+}
+
+vec3d SlopeSampler::toFrame(const vec3d& v, const vec3d& n, const vec3d& t)
+{
+    vec3d vx = t - n*dot(t, n);
+    if (!vx.normalize()) {
+        vx = n.findOrthogonal();
+        vx.normalize();
+    }
+    vec3d vy = cross(n, vx);
+    return vx*v.x + vy*v.y + n*v.z;
+}
+
+vec3d SlopeSampler::reflect(const vec3d& d, const vec3d& n, const vec3d& t, double u, double v) const
+{
+    if (isZero()) return d.reflected(n);
+    return d.reflected(toFrame(sample(u, v), n, t));
+}
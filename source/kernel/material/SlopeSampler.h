@@ -0,0 +1,60 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+#include "libraries/math/3D/vec3d.h"
+
+
+//! SlopeSampler draws slope errors from a fixed number of uniforms.
+/*!
+ * A sample is the unit vector z tilted by the error, made from two uniforms:
+ * one gives the tilt through the inverse of its cumulative distribution and
+ * the other the azimuth. Both are read from tables shared by all samplers,
+ * so there is no rejection loop and, outside the Gaussian tail, no logarithm
+ * or trigonometric function per ray.
+ *
+ * Gaussian errors of deviation sigma along each tangent have the tilt tangent
+ * sigma*sqrt(-2 ln(1 - u)), as the polar method; its square is tabulated up to
+ * u = 63/64 and computed beyond, where it grows too fast for the table.
+ * Pillbox errors within sigma have the tilt sine sin(sigma)*sqrt(u), uniform
+ * over the cone.
+ *
+ * toFrame maps a sample around a unit axis, orthogonalizing a tangent
+ * instead of building and inverting a matrix.
+ *
+ * reflect turns a direction about a normal tilted by a sample, as a specular
+ * mirror with these errors does, so the reflected rays deviate twice the tilt
+ * within the plane of incidence and less across it, by the cosine of the
+ * incidence angle.
+ */
+class TONATIUH_KERNEL SlopeSampler
+{
+public:
+    enum Distribution {
+        pillbox,
+        Gaussian
+    };
+
+    SlopeSampler(Distribution distribution = Gaussian, double sigma = 0.);
+
+    Distribution distribution() const {return m_distribution;}
+    double sigma() const {return m_sigma;}
+    bool isZero() const {return !(m_sigma > 0.);}
+
+    // u and v uniform in [0, 1)
+    vec3d sample(double u, double v) const;
+
+    // cosine and sine of the azimuth 2 pi v, from the tables of the samplers
+    static void azimuth(double v, double& c, double& s);
+
+    // from the frame of axis z = n and x along t to world, n normalized
+    static vec3d toFrame(const vec3d& v, const vec3d& n, const vec3d& t);
+
+    // d reflected about n tilted by the sample of u and v, n normalized and
+    // t a tangent
+    vec3d reflect(const vec3d& d, const vec3d& n, const vec3d& t, double u, double v) const;
+
+private:
+    Distribution m_distribution;
+    double m_sigma;
+    double m_sinSigma;
+};
@@ -0,0 +1,59 @@
+#include "SensorBatch.h"
+
+#include <algorithm>
+
+
+SensorBatch::SensorBatch()
+{
+    state().depth++;
+}
+
+SensorBatch::~SensorBatch()
+{
+    State& s = state();
+    if (--s.depth > 0) return;
+
+    std::vector<Held> order;
+    order.swap(s.order);
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        // a callback may have destroyed nodes held after it
+        auto found = s.pending.find(it->data);
+        if (found == s.pending.end()) continue;
+        std::vector<Callback>& callbacks = found->second;
+        auto callback = std::find(callbacks.begin(), callbacks.end(), it->callback);
+        if (callback == callbacks.end()) continue;
+        callbacks.erase(callback);
+        if (callbacks.empty())
+            s.pending.erase(found);
+        it->callback(it->data, nullptr);
+    }
+}
+
+bool SensorBatch::isActive()
+{
+    return state().depth > 0;
+}
+
+bool SensorBatch::defer(Callback callback, void* data)
+{
+    State& s = state();
+    if (s.depth == 0) return false;
+    std::vector<Callback>& callbacks = s.pending[data];
+    if (std::find(callbacks.begin(), callbacks.end(), callback) == callbacks.end()) {
+        callbacks.push_back(callback);
+        s.order.push_back(Held{callback, data});
+    }
+    return true;
+}
+
+void SensorBatch::forget(void* data)
+{
+    state().pending.erase(data);
+}
+
+SensorBatch::State& SensorBatch::state()
+{
+    thread_local State ans;
+    return ans;
+}
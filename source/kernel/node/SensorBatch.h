@@ -0,0 +1,58 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <unordered_map>
+#include <vector>
+
+class SoSensor;
+
+
+//! SensorBatch holds the sensor callbacks of kernel nodes while it lives and calls each once at its end.
+/*!
+ * Reading a scene or turning its trackers writes many fields, and the
+ * callbacks that rebuild what nodes derive from them, such as the meshes of
+ * shape kits, would run again on every write and on the direct calls of
+ * constructors. Inside a batch such a callback asks defer() first and
+ * returns at once if it was held; the outermost batch of the thread then
+ * calls every callback held with a null sensor, once per node, in the
+ * reverse order of their first deferral: the parts of a kit read from a
+ * file are created after it, so they are updated before the kit reading
+ * them. Calls made by the callbacks themselves run at once.
+ *
+ * Batches are per thread, as a scene is read or turned by one thread. A
+ * node destroyed inside a batch drops its callbacks with forget().
+ */
+class TONATIUH_KERNEL SensorBatch
+{
+public:
+    using Callback = void (*)(void*, SoSensor*);
+
+    SensorBatch();
+    ~SensorBatch();
+    SensorBatch(const SensorBatch&) = delete;
+    SensorBatch& operator=(const SensorBatch&) = delete;
+
+    // whether a batch of the calling thread is open
+    static bool isActive();
+    // true if the call of callback with data is held for the end of the batch
+    static bool defer(Callback callback, void* data);
+    // drops the calls held for data
+    static void forget(void* data);
+
+private:
+    struct Held
+    {
+        Callback callback;
+        void* data;
+    };
+
+    struct State
+    {
+        int depth = 0;
+        std::vector<Held> order; // by first deferral
+        std::unordered_map<void*, std::vector<Callback>> pending;
+    };
+
+    static State& state();
+};
@@ -1,8 +1,13 @@
 #include <cmath>
+#include <iostream>
 
 #include <Inventor/SbVec2f.h>
 #include <Inventor/nodes/SoTransform.h>
 
+#include <QApplication>
+#include <QMessageBox>
+#include <QThread>
+
 #include "kernel/random/Random.h"
 #include "kernel/scene/TTransform.h"
 #include "TonatiuhFunctions.h"
@@ -107,3 +112,18 @@ Transform tgf::makeTransform(SoTransform* soTransform)
 {
     return makeTransform(makeSbMatrix(soTransform));
 }
+
+void tgf::showWarning(const QString& message)
+{
+    // scenes are also read on worker threads and without a GUI
+    QApplication* app = qobject_cast<QApplication*>(QCoreApplication::instance());
+    if (!app) {
+        std::cerr << "Warning: " << message.toStdString() << std::endl;
+        return;
+    }
+    auto show = [message]() {QMessageBox::warning(0, "Warning", message);};
+    if (QThread::currentThread() == app->thread())
+        show();
+    else
+        QMetaObject::invokeMethod(app, show, Qt::QueuedConnection);
+}
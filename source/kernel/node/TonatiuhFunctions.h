@@ -3,6 +3,7 @@
 #include "kernel/TonatiuhKernel.h"
 
 #include <QPointF>
+class QString;
 class Random;
 
 class SbMatrix;
@@ -30,5 +31,8 @@ namespace tgf
     TONATIUH_KERNEL Transform makeTransform(const SbMatrix& matrix);
     TONATIUH_KERNEL Transform makeTransform(TTransform* soTransform);
     TONATIUH_KERNEL Transform makeTransform(SoTransform* soTransform);
+
+    // a message box on the GUI thread from any thread, the standard error without a GUI
+    TONATIUH_KERNEL void showWarning(const QString& message);
 }
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
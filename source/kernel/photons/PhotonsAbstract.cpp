@@ -1,5 +1,9 @@
 #include "PhotonsAbstract.h"
 
+#include <QApplication>
+#include <QDebug>
+#include <QMessageBox>
+
 #include "PhotonsSettings.h"
 
 PhotonsAbstract::PhotonsAbstract()
@@ -29,3 +33,11 @@ void PhotonsAbstract::setPhotonSettings(PhotonsSettings* ps)
     for (auto it = ps->parameters.cbegin(); it != ps->parameters.cend(); ++it)
         setParameter(it.key(), it.value());
 }
+
+void PhotonsAbstract::showWarning(const QString& message)
+{
+    qWarning() << message;
+    // headless runs have a QCoreApplication only
+    if (qobject_cast<QApplication*>(QCoreApplication::instance()))
+        QMessageBox::warning(0, "Tonatiuh", message);
+}
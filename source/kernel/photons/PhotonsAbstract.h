@@ -33,6 +33,9 @@ public:
     NAME_ICON_FUNCTIONS("No export", ":/photons/PhotonsDefault.png")
 
 protected:
+    // logs the message, also shown in a message box when there is a GUI
+    static void showWarning(const QString& message);
+
     SceneTreeModel* m_sceneModel = nullptr;   // <-- FIX: declared + default init
 
     bool m_saveAllPhotonsData = false;
@@ -3,6 +3,11 @@
 
 #include <algorithm>
 
+#include <QElapsedTimer>
+
+#include "kernel/run/TraceEvents.h"
+#include "kernel/run/TraceMetrics.h"
+
 PhotonsBuffer::PhotonsBuffer(ulong size, ulong sizeReserve):
     m_photonsMax(size),
     m_exporter(0),
@@ -12,6 +17,11 @@ PhotonsBuffer::PhotonsBuffer(ulong size, ulong sizeReserve):
         m_photons.reserve(sizeReserve);
 }
 
+PhotonsBuffer::~PhotonsBuffer()
+{
+    stopWriter();
+}
+
 bool PhotonsBuffer::addPhotons(const std::vector<Photon>& photons)
 {
     if (m_exportFailed)
@@ -20,74 +30,255 @@ bool PhotonsBuffer::addPhotons(const std::vector<Photon>& photons)
     if (photons.empty())
         return true;
 
+    addSample(photons);
+
+    if (m_reservoirSize > 0) {
+        m_reservoirs[0]->add(photons, (m_reservoirPass << 40) + m_reservoirCalls++, 0);
+        return true;
+    }
+
+    if (m_compact) {
+        if (m_photonsMax > 0 && m_photonsCompact.size() >= m_photonsMax)
+            m_photonsCompact.clear(); // as flush without exporter
+        m_photonsCompact.append(photons);
+        return true;
+    }
+
     if (m_photonsMax == 0) {
         m_photons.insert(m_photons.end(), photons.begin(), photons.end());
+        spill();
         return true;
     }
 
     ulong nBegin = 0;
     while (nBegin < photons.size()) {
-        if (m_photons.size() >= m_photonsMax && !flush()) {
+        if (getPhotonCount() >= m_photonsMax && !flush()) {
             m_exportFailed = true;
+            spill();
             return false;
         }
 
-        ulong space = m_photonsMax - m_photons.size();
+        ulong space = m_photonsMax - getPhotonCount();
         ulong nCopy = std::min<ulong>(space, photons.size() - nBegin);
         m_photons.insert(m_photons.end(), photons.begin() + nBegin, photons.begin() + nBegin + nCopy);
         nBegin += nCopy;
+        spill();
     }
 
     return true;
 }
 
+std::vector<Photon> PhotonsBuffer::takeVector()
+{
+    std::lock_guard<std::mutex> lock(m_vectorsMutex);
+    if (m_vectors.empty())
+        return std::vector<Photon>();
+    std::vector<Photon> photons = std::move(m_vectors.back());
+    m_vectors.pop_back();
+    return photons;
+}
+
+void PhotonsBuffer::recycleVector(std::vector<Photon>&& photons)
+{
+    photons.clear();
+    std::lock_guard<std::mutex> lock(m_vectorsMutex);
+    m_vectors.push_back(std::move(photons));
+}
+
 bool PhotonsBuffer::endExport(double p)
 {
-    if (m_exportFailed) {
-        if (m_exporter) {
-            m_exporter->setPhotonPower(p);
-            m_exporter->endExport();
-        }
-        return false;
-    }
+    TraceEventScope event("endExport", "export");
+    if (isPaged())
+        endPages();
 
-    if (!flush())
+    bool ok = !m_exportFailed && flush();
+    stopWriter();
+    if (m_reservoirSize > 0)
+        p = exportReservoir(p);
+    ok = ok && !m_exportFailed;
     {
-        if (m_exporter) {
-            m_exporter->setPhotonPower(p);
-            m_exporter->endExport();
-        }
-        return false;
+        std::lock_guard<std::mutex> lock(m_vectorsMutex);
+        m_vectors.clear();
     }
 
     if (m_exporter)
     {
         m_exporter->setPhotonPower(p);
-        return m_exporter->endExport();
+        bool ended = m_exporter->endExport();
+        return ok && ended;
     }
 
-    return true;
+    return ok;
 }
 
 bool PhotonsBuffer::setExporter(PhotonsAbstract* exporter)
 {
-    if (!exporter) return false;
+    if (!exporter || m_compact) return false;
     m_exporter = exporter;
     m_exportFailed = !m_exporter->startExport();
     return !m_exportFailed;
 }
 
-bool PhotonsBuffer::flush()
+/*!
+ * Keeps a PhotonsReservoir per worker instead of saving the photons as they
+ * come: workers add their pages to their own reservoir without locking, and
+ * endExport merges them and exports the kept paths in key order through the
+ * exporter, so the sample is the same for any number of workers. Without
+ * strata, the power of the export is that of a kept path, the power per
+ * ray times its weight; with strata, it stays the power per ray and the
+ * weight of every final surface is in getSampleStrata.
+ */
+bool PhotonsBuffer::setReservoir(ulong paths, bool stratified, quint64 seed)
 {
-    if (m_photons.empty())
-        return true;
+    if (!m_exporter || isPaged() || hasRetainedPhotons()) return false;
+    m_reservoirSize = paths;
+    m_reservoirStratified = stratified;
+    m_reservoirSeed = seed;
+    m_reservoirs.clear();
+    if (paths > 0)
+        m_reservoirs.emplace_back(new PhotonsReservoir<Photon>(paths, stratified, seed));
+    m_sampleStrata.clear();
+    return true;
+}
+
+// returns the photon power of the export
+double PhotonsBuffer::exportReservoir(double p)
+{
+    TraceEventScope event("export sample", "export");
+    PhotonsReservoir<Photon>& merged = *m_reservoirs[0];
+    for (size_t w = 1; w < m_reservoirs.size(); ++w)
+        merged.merge(std::move(*m_reservoirs[w]));
+    m_reservoirs.resize(1);
+
+    m_sampleStrata.clear();
+    for (const PhotonsReservoir<Photon>::Stratum* stratum : merged.getStrata()) {
+        PhotonsSampleStratum sampleStratum;
+        if (stratum->surface)
+            sampleStratum.surface = stratum->surface->getURL();
+        sampleStratum.paths = stratum->seen;
+        sampleStratum.kept = ulong(stratum->paths.size());
+        sampleStratum.weight = stratum->getWeight();
+        m_sampleStrata.push_back(sampleStratum);
+    }
+
+    exportPhotons(merged.getRecords(), m_photons);
+    merged.clear();
+    spill();
+
+    if (!m_reservoirStratified && m_sampleStrata.size() == 1)
+        return p*m_sampleStrata[0].weight;
+    return p;
+}
+
+/*!
+ * Keeps retained photons as PhotonCompact records, about 20 instead of
+ * 48 bytes each, with positions in float precision in surface frames.
+ * Readers use getPhotonsCompact instead of getPhotons. Exporters get full
+ * precision photons, so compaction is refused once an exporter is set;
+ * it must also be chosen before any photon is added.
+ */
+bool PhotonsBuffer::setCompact(bool on)
+{
+    if (on == m_compact) return true;
+    if (m_exporter || hasRetainedPhotons()) return false;
+
+    m_compact = on;
+    if (m_compact) {
+        m_photonsCompact.reserve(m_photons.capacity());
+        std::vector<Photon>().swap(m_photons);
+    } else {
+        m_photons.reserve(m_photonsCompact.getPhotons().capacity());
+        m_photonsCompact = PhotonsCompact();
+    }
+    return true;
+}
+
+qulonglong PhotonsBuffer::getMemoryUsage() const
+{
+    auto bytes = [](const std::vector<Photon>& photons) {return qulonglong(photons.capacity())*sizeof(Photon);};
+    qulonglong ans = bytes(m_photons) + bytes(m_photonsUnsaved) + m_photonsCompact.getMemoryUsage();
+    for (const std::vector<Photon>& photons : m_vectors)
+        ans += bytes(photons);
+    for (const std::unique_ptr<PageRing>& ring : m_rings)
+        for (const std::unique_ptr<PhotonsPage>& page : ring->pages)
+            ans += sizeof(PhotonsPage) + bytes(page->photons);
+    for (const std::unique_ptr<PhotonsPage>& page : m_writerPool)
+        ans += sizeof(PhotonsPage) + bytes(page->photons);
+    return ans;
+}
+
+void PhotonsBuffer::setMemoryBudget(qulonglong bytes)
+{
+    m_memoryBudget = bytes;
+    m_photonsCompact.setMemoryBudget(bytes);
+    spill();
+}
+
+/*!
+ * Moves the photons in memory to the spill file once they take more than the
+ * memory budget. Only retained photons are spilled: those kept without an
+ * exporter and those left by a failed export. Blocks waiting for a working
+ * exporter stay in memory. If the disk refuses them they stay in memory too.
+ */
+void PhotonsBuffer::spill()
+{
+    if (m_memoryBudget == 0 || qulonglong(m_photons.size())*sizeof(Photon) <= m_memoryBudget)
+        return;
+    if (m_exporter && !m_exportFailed)
+        return;
+
+    TraceEventScope event("spill photons", "photons", "photons", qint64(m_photons.size()));
+    m_spill.append(m_photons);
+}
+
+void PhotonsBuffer::setSampleBudget(ulong rays)
+{
+    std::lock_guard<std::mutex> lock(m_sampleMutex);
+    m_sample.setBudget(rays);
+}
+
+/*!
+ * Copies the paths sampled so far. Pages end on ray boundaries, so while
+ * workers trace the copy holds whole rays of the chunks merged.
+ */
+std::vector<std::vector<vec3d>> PhotonsBuffer::copySamplePaths() const
+{
+    std::lock_guard<std::mutex> lock(m_sampleMutex);
+    return m_sample.getPaths();
+}
+
+void PhotonsBuffer::addSample(const std::vector<Photon>& photons)
+{
+    std::lock_guard<std::mutex> lock(m_sampleMutex);
+    m_sample.add(photons);
+}
 
+bool PhotonsBuffer::flush()
+{
     if (!m_exporter) {
         m_photons.clear();
+        m_spill.clear();
+        return true;
+    }
+
+    if (m_photons.empty())
         return true;
+
+    if (isWriting()) {
+        PhotonsPage* page = writerPage();
+        if (!page) return false;
+        ulong capacity = m_photons.capacity();
+        page->photons.swap(m_photons);
+        m_photons.reserve(capacity);
+        writePage(page);
+        return !m_exportFailed;
     }
 
-    ulong saved = m_exporter->savePhotons(m_photons);
+    ulong saved = 0;
+    {
+        TraceEventScope event("savePhotons", "export", "photons", qint64(m_photons.size()));
+        saved = m_exporter->savePhotons(m_photons);
+    }
     if (saved > m_photons.size())
         saved = m_photons.size();
     if (saved > 0)
@@ -96,5 +287,363 @@ bool PhotonsBuffer::flush()
     if (m_exporter->hasExportError() || !m_photons.empty())
         m_exportFailed = true;
 
+    spill();
+    return !m_exportFailed;
+}
+
+namespace {
+
+void pushPage(std::atomic<PhotonsPage*>& head, PhotonsPage* page)
+{
+    PhotonsPage* top = head.load(std::memory_order_relaxed);
+    do {
+        page->next = top;
+    } while (!head.compare_exchange_weak(top, page, std::memory_order_release, std::memory_order_relaxed));
+}
+
+}
+
+/*!
+ * Switches the buffer to paged mode for \a workers concurrent workers.
+ *
+ * Each worker records into pages of about \a pageSize photons taken from its
+ * own ring and hands full pages back with submitPage. Submitted pages go
+ * through a lock-free stack; whichever worker wins the merge flag puts them in
+ * (chunk, sequence) order and passes them to the exporter without copying.
+ * The export order is thus fixed by the chunk indices, not by the scheduling.
+ * Chunks must be numbered from 0 for every beginPages call.
+ */
+bool PhotonsBuffer::beginPages(int workers, ulong pageSize)
+{
+    if (isPaged())
+        endPages();
+    if (m_exportFailed || !flush())
+        return false;
+
+    m_pageSize = std::max<ulong>(1, pageSize);
+    if (m_reservoirSize > 0) {
+        ++m_reservoirPass;
+        while (m_reservoirs.size() < size_t(std::max(1, workers)))
+            m_reservoirs.emplace_back(new PhotonsReservoir<Photon>(m_reservoirSize, m_reservoirStratified, m_reservoirSeed));
+    }
+    if (m_photonsMax > 0)
+        m_pageSize = std::min(m_pageSize, m_photonsMax);
+
+    const int pagesPerWorker = 2;
+    for (int w = 0; w < std::max(1, workers); ++w) {
+        std::unique_ptr<PageRing> ring(new PageRing);
+        for (int n = 0; n < pagesPerWorker; ++n) {
+            std::unique_ptr<PhotonsPage> page(new PhotonsPage);
+            page->photons.reserve(m_pageSize);
+            page->owner = w;
+            page->next = ring->local;
+            ring->local = page.get();
+            ring->pages.push_back(std::move(page));
+        }
+        m_rings.push_back(std::move(ring));
+    }
+
+    m_nextChunk = 0;
+    m_nextSequence = 0;
+    return true;
+}
+
+/*!
+ * Exports the pages still waiting for the merge and leaves paged mode.
+ * Workers must have stopped. Pages of chunks that never completed,
+ * e.g. after a cancellation, are exported in chunk order as well.
+ */
+bool PhotonsBuffer::endPages()
+{
+    if (!isPaged())
+        return !m_exportFailed;
+
+    mergePages();
+    stopWriter(); // it recycles into the rings
+    for (auto& item : m_pending) {
+        addSample(item.second->photons);
+        savePage(item.second);
+    }
+    m_pending.clear();
+    m_submitted.store(nullptr);
+
+    m_rings.clear();
+    m_pageSize = 0;
     return !m_exportFailed;
 }
+
+/*!
+ * Returns an empty page of the ring of \a worker; called by that worker only.
+ * When the merge is still holding every page, waiting for an earlier chunk,
+ * the ring grows by one page.
+ */
+PhotonsPage* PhotonsBuffer::acquirePage(int worker, qulonglong chunk, ulong sequence)
+{
+    PageRing& ring = *m_rings[worker];
+    if (!ring.local)
+        ring.local = ring.returned.exchange(nullptr, std::memory_order_acquire);
+    if (!ring.local) {
+        mergePages();
+        ring.local = ring.returned.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    if (!ring.local && isWriting()) {
+        waitWriter();
+        ring.local = ring.returned.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    PhotonsPage* page = ring.local;
+    if (page) {
+        ring.local = page->next;
+    } else {
+        std::unique_ptr<PhotonsPage> pageNew(new PhotonsPage);
+        pageNew->photons.reserve(m_pageSize);
+        pageNew->owner = worker;
+        page = pageNew.get();
+        ring.pages.push_back(std::move(pageNew));
+    }
+
+    page->photons.clear();
+    page->chunk = chunk;
+    page->sequence = sequence;
+    page->isLast = false;
+    page->next = nullptr;
+    return page;
+}
+
+void PhotonsBuffer::submitPage(PhotonsPage* page)
+{
+    // sampled by the worker, nothing is merged
+    if (m_reservoirSize > 0) {
+        m_reservoirs[page->owner]->add(page->photons, (m_reservoirPass << 40) + page->chunk, page->sequence);
+        recyclePage(page);
+        return;
+    }
+
+    pushPage(m_submitted, page);
+    mergePages();
+}
+
+void PhotonsBuffer::mergePages()
+{
+    while (true)
+    {
+        if (m_merging.test_and_set(std::memory_order_acquire))
+            return; // another worker merges, it will see our pages
+
+        PhotonsPage* page = m_submitted.exchange(nullptr, std::memory_order_acquire);
+        while (page) {
+            PhotonsPage* next = page->next;
+            m_pending.emplace(std::make_pair(page->chunk, page->sequence), page);
+            page = next;
+        }
+
+        while (!m_pending.empty()) {
+            auto it = m_pending.begin();
+            if (it->first != std::make_pair(m_nextChunk, m_nextSequence)) break;
+            page = it->second;
+            m_pending.erase(it);
+
+            if (page->isLast) {
+                ++m_nextChunk;
+                m_nextSequence = 0;
+            } else
+                ++m_nextSequence;
+
+            addSample(page->photons);
+            if (isWriting() && !page->photons.empty())
+                writePage(page); // recycled by the writer
+            else {
+                savePage(page);
+                recyclePage(page);
+            }
+        }
+
+        m_merging.clear(std::memory_order_release);
+        if (!m_submitted.load(std::memory_order_acquire))
+            return;
+    }
+}
+
+bool PhotonsBuffer::savePage(PhotonsPage* page)
+{
+    if (m_exportFailed)
+        return false;
+
+    const std::vector<Photon>& photons = page->photons;
+    if (photons.empty())
+        return true;
+
+    if (m_compact) {
+        if (m_photonsMax > 0 && m_photonsCompact.size() >= m_photonsMax)
+            m_photonsCompact.clear(); // as flush without exporter
+        m_photonsCompact.append(photons);
+        return true;
+    }
+
+    if (m_photonsMax == 0) {
+        m_photons.insert(m_photons.end(), photons.begin(), photons.end());
+        spill();
+        return true;
+    }
+
+    if (!m_exporter)
+        return true;
+
+    exportPhotons(photons, m_photons);
+    spill();
+    return !m_exportFailed;
+}
+
+/*!
+ * Saves \a photons with the exporter; the ones not saved are kept in \a unsaved,
+ * as flush does.
+ */
+void PhotonsBuffer::exportPhotons(const std::vector<Photon>& photons, std::vector<Photon>& unsaved)
+{
+    if (m_exportFailed) {
+        unsaved.insert(unsaved.end(), photons.begin(), photons.end());
+        return;
+    }
+
+    ulong saved = 0;
+    {
+        TraceEventScope event("savePhotons", "export", "photons", qint64(photons.size()));
+        saved = m_exporter->savePhotons(photons);
+    }
+    if (saved > photons.size())
+        saved = photons.size();
+    if (TraceMetrics* metrics = TraceMetrics::active())
+        metrics->addExport(saved, saved*sizeof(Photon));
+
+    if (m_exporter->hasExportError() || saved < photons.size()) {
+        unsaved.insert(unsaved.end(), photons.begin() + saved, photons.end());
+        m_exportFailed = true;
+    }
+}
+
+void PhotonsBuffer::recyclePage(PhotonsPage* page)
+{
+    pushPage(m_rings[page->owner]->returned, page);
+}
+
+/*!
+ * Moves saving off the tracing threads. Full blocks, either the shared buffer
+ * or pages of the paged mode, are queued to a writer thread that owns the
+ * exporter until endExport. When \a blocks are queued, producers wait, so the
+ * memory in flight stays bounded. A failed save sets the export failure flag
+ * seen by the tracers; the photons not saved are kept as retained photons.
+ * Applies to buffers with an exporter and a size limit.
+ */
+void PhotonsBuffer::setWriterQueue(ulong blocks)
+{
+    stopWriter();
+    m_writerQueue = blocks;
+}
+
+// a wait of a tracer for the writer, a stall of the export if it blocks
+template<class Ready>
+void PhotonsBuffer::waitWriterSpace(std::unique_lock<std::mutex>& lock, Ready ready)
+{
+    TraceEventScope wait("photon queue", "wait");
+    TraceMetrics* metrics = TraceMetrics::active();
+    if (!metrics || ready()) {
+        m_writerSpace.wait(lock, ready);
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    m_writerSpace.wait(lock, ready);
+    metrics->addExportStall(timer.nsecsElapsed());
+}
+
+// a pool page for the shared buffer, waits while the queue is full
+PhotonsPage* PhotonsBuffer::writerPage()
+{
+    std::unique_lock<std::mutex> lock(m_writerMutex);
+    waitWriterSpace(lock, [this]() {
+        return m_exportFailed || !m_writerFree.empty() || m_writerPool.size() < m_writerQueue;
+    });
+    if (m_exportFailed) return nullptr;
+
+    if (!m_writerFree.empty()) {
+        PhotonsPage* page = m_writerFree.back();
+        m_writerFree.pop_back();
+        return page;
+    }
+
+    m_writerPool.emplace_back(new PhotonsPage);
+    m_writerPool.back()->owner = -1;
+    return m_writerPool.back().get();
+}
+
+void PhotonsBuffer::writePage(PhotonsPage* page)
+{
+    std::unique_lock<std::mutex> lock(m_writerMutex);
+    if (!m_writer.joinable()) {
+        m_writerStop = false;
+        m_writer = std::thread(&PhotonsBuffer::runWriter, this);
+    }
+
+    waitWriterSpace(lock, [this]() {
+        return m_writerPages.size() < m_writerQueue;
+    });
+    m_writerPages.push_back(page);
+    m_writerWake.notify_one();
+}
+
+// waits while the queue is full
+void PhotonsBuffer::waitWriter()
+{
+    std::unique_lock<std::mutex> lock(m_writerMutex);
+    waitWriterSpace(lock, [this]() {
+        return m_writerPages.size() < m_writerQueue;
+    });
+}
+
+void PhotonsBuffer::runWriter()
+{
+    if (TraceEvents* events = TraceEvents::active())
+        events->nameThread("photon writer");
+    while (true)
+    {
+        PhotonsPage* page = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_writerMutex);
+            m_writerWake.wait(lock, [this]() {
+                return m_writerStop || !m_writerPages.empty();
+            });
+            if (m_writerPages.empty()) return;
+            page = m_writerPages.front();
+        }
+
+        exportPhotons(page->photons, m_photonsUnsaved);
+        page->photons.clear();
+
+        {
+            std::unique_lock<std::mutex> lock(m_writerMutex);
+            m_writerPages.pop_front();
+            if (page->owner < 0)
+                m_writerFree.push_back(page);
+        }
+        if (page->owner >= 0)
+            recyclePage(page);
+        m_writerSpace.notify_all();
+    }
+}
+
+// saves the queued blocks and joins the writer
+void PhotonsBuffer::stopWriter()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_writerMutex);
+        if (!m_writer.joinable()) return;
+        m_writerStop = true;
+    }
+    m_writerWake.notify_one();
+    m_writer.join();
+
+    m_photons.insert(m_photons.end(), m_photonsUnsaved.begin(), m_photonsUnsaved.end());
+    m_photonsUnsaved.clear();
+    spill();
+}
@@ -1,30 +1,197 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <QString>
+
 #include "Photon.h"
+#include "PhotonsCompact.h"
+#include "PhotonsReservoir.h"
+#include "PhotonsSample.h"
+#include "PhotonsSpill.h"
 
 class PhotonsAbstract;
 
 
+//! PhotonsSampleStratum is a final surface of the ray paths of a sampled export.
+struct TONATIUH_KERNEL PhotonsSampleStratum
+{
+    QString surface; // the URL, empty for the air or without strata
+    qulonglong paths = 0;
+    ulong kept = 0;
+    double weight = 0.; // of each kept path
+};
+
+
+//! PhotonsPage is a block of photons recorded by one worker for one chunk.
+/*!
+ * Pages belong to the ring of the worker that acquired them and go back to it
+ * once exported. A page always ends on a ray boundary; the last page of a
+ * chunk is marked even when it is empty, so the merge knows the chunk is done.
+ */
+struct TONATIUH_KERNEL PhotonsPage
+{
+    std::vector<Photon> photons;
+    qulonglong chunk = 0;
+    ulong sequence = 0; // page number within the chunk
+    bool isLast = false;
+    int owner = 0; // worker, -1 for the writer pool
+    PhotonsPage* next = nullptr; // link in lock-free lists
+};
+
+
 class TONATIUH_KERNEL PhotonsBuffer
 {
 public:
     PhotonsBuffer(ulong size, ulong sizeReserve = 0);
+    PhotonsBuffer(const PhotonsBuffer&) = delete;
+    PhotonsBuffer& operator=(const PhotonsBuffer&) = delete;
+    ~PhotonsBuffer();
 
     bool addPhotons(const std::vector<Photon>& photons);
-    const std::vector<Photon>& getPhotons() const {return m_photons;} // for flux and screen
-    bool hasRetainedPhotons() const {return !m_photons.empty();}
-    bool hasExportFailed() const {return m_exportFailed;}
+    // empty vectors for addPhotons, one per caller at a time,
+    // keeping their capacity until endExport
+    std::vector<Photon> takeVector();
+    void recycleVector(std::vector<Photon>&& photons);
+    const std::vector<Photon>& getPhotons() const {return m_photons;} // in memory, see forEachPhoton
+    bool hasRetainedPhotons() const {return !m_photons.empty() || !m_spill.isEmpty() || !m_photonsCompact.isEmpty();}
+    bool hasExportFailed() const {return m_exportFailed.load();}
     bool endExport(double p);
 
     bool setExporter(PhotonsAbstract* exporter);
     PhotonsAbstract* getExporter() const {return m_exporter;}
 
+    // retained photons kept as PhotonCompact records, for buffers without exporter
+    bool setCompact(bool on);
+    bool isCompact() const {return m_compact;}
+    const PhotonsCompact& getPhotonsCompact() const {return m_photonsCompact;}
+
+    // bytes of retained photons kept in memory, the others are spilled to
+    // a temporary file; 0 for no limit
+    void setMemoryBudget(qulonglong bytes);
+    qulonglong getMemoryBudget() const {return m_memoryBudget;}
+    // bytes of the photons in memory and of the vectors and pages of the
+    // workers, while none adds photons
+    qulonglong getMemoryUsage() const;
+    // retained photons, for flux and screen, spilled ones included
+    ulong getPhotonCount() const {return m_spill.size() + m_photons.size();}
+    template<class F>
+    void forEachPhoton(ulong from, F f) const;
+
+    // rays kept for display from every photon added, 0 rays to disable
+    void setSampleBudget(ulong rays);
+    const PhotonsSample& getSample() const {return m_sample;}
+    // a copy of the sampled paths, which may be taken while workers trace
+    std::vector<std::vector<vec3d>> copySamplePaths() const;
+
+    // exports a sample of \a paths ray paths, per final surface if
+    // \a stratified, instead of every photon; 0 paths exports them all
+    bool setReservoir(ulong paths, bool stratified, quint64 seed);
+    ulong getReservoirSize() const {return m_reservoirSize;}
+    // the strata of the sample, after endExport
+    const std::vector<PhotonsSampleStratum>& getSampleStrata() const {return m_sampleStrata;}
+
+    // full blocks saved by a writer thread, at most \a blocks in flight
+    // 0 saves them synchronously in the tracing threads
+    void setWriterQueue(ulong blocks);
+    ulong getWriterQueue() const {return m_writerQueue;}
+
+    // paged mode, used instead of addPhotons by concurrent workers
+    bool beginPages(int workers, ulong pageSize);
+    bool endPages();
+    bool isPaged() const {return !m_rings.empty();}
+    ulong getPageSize() const {return m_pageSize;}
+    PhotonsPage* acquirePage(int worker, qulonglong chunk, ulong sequence);
+    void submitPage(PhotonsPage* page);
+
 private:
     bool flush();
+    void spill();
+    void addSample(const std::vector<Photon>& photons);
+    bool savePage(PhotonsPage* page);
+    void mergePages();
+    void recyclePage(PhotonsPage* page);
+    void exportPhotons(const std::vector<Photon>& photons, std::vector<Photon>& unsaved);
+    double exportReservoir(double p);
+
+    bool isWriting() const {return m_writerQueue > 0 && m_exporter && m_photonsMax > 0 && !m_compact;}
+    PhotonsPage* writerPage();
+    void writePage(PhotonsPage* page);
+    void waitWriter();
+    template<class Ready>
+    void waitWriterSpace(std::unique_lock<std::mutex>& lock, Ready ready);
+    void runWriter();
+    void stopWriter();
 
     std::vector<Photon> m_photons; // buffer, std is faster than QVector
     ulong m_photonsMax;
+    PhotonsSpill<Photon> m_spill; // retained photons older than m_photons
+    qulonglong m_memoryBudget = 0;
 
     PhotonsAbstract* m_exporter;
-    bool m_exportFailed;
+    std::atomic_bool m_exportFailed;
+
+    bool m_compact = false;
+    PhotonsCompact m_photonsCompact; // instead of m_photons if m_compact
+    PhotonsSample m_sample;
+    mutable std::mutex m_sampleMutex; // for copies while tracing
+
+    ulong m_reservoirSize = 0;
+    bool m_reservoirStratified = false;
+    quint64 m_reservoirSeed = 1;
+    std::vector<std::unique_ptr<PhotonsReservoir<Photon>>> m_reservoirs; // per worker
+    qulonglong m_reservoirPass = 0; // beginPages calls, chunks restart in each
+    qulonglong m_reservoirCalls = 0; // of addPhotons
+    std::vector<PhotonsSampleStratum> m_sampleStrata;
+
+    std::mutex m_vectorsMutex;
+    std::vector<std::vector<Photon>> m_vectors; // free, for takeVector
+
+    struct PageRing
+    {
+        std::vector<std::unique_ptr<PhotonsPage>> pages; // owned, grown by the worker only
+        PhotonsPage* local = nullptr; // free pages, touched by the worker only
+        std::atomic<PhotonsPage*> returned{nullptr}; // free pages pushed back by the merge
+    };
+
+    ulong m_pageSize = 0;
+    std::vector<std::unique_ptr<PageRing>> m_rings;
+    std::atomic<PhotonsPage*> m_submitted{nullptr};
+    std::atomic_flag m_merging = ATOMIC_FLAG_INIT;
+    std::map<std::pair<qulonglong, ulong>, PhotonsPage*> m_pending; // by the merge only
+    qulonglong m_nextChunk = 0;
+    ulong m_nextSequence = 0;
+
+    ulong m_writerQueue = 0;
+    std::thread m_writer;
+    std::mutex m_writerMutex;
+    std::condition_variable m_writerWake;  // page queued or stop
+    std::condition_variable m_writerSpace; // page written
+    std::deque<PhotonsPage*> m_writerPages; // queued for the exporter
+    std::vector<std::unique_ptr<PhotonsPage>> m_writerPool;
+    std::vector<PhotonsPage*> m_writerFree;
+    bool m_writerStop = false;
+    std::vector<Photon> m_photonsUnsaved; // by the writer, moved back at stop
 };
+
+
+
+template<class F>
+void PhotonsBuffer::forEachPhoton(ulong from, F f) const
+{
+    for (const auto& block : m_spill.getBlocks()) {
+        for (ulong n = from; n < block.size; ++n)
+            f(block.data[n]);
+        from = from > block.size ? from - block.size : 0;
+    }
+    for (ulong n = from; n < m_photons.size(); ++n)
+        f(m_photons[n]);
+}
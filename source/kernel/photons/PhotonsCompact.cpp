@@ -0,0 +1,85 @@
+#include "PhotonsCompact.h"
+
+
+PhotonsCompact::PhotonsCompact()
+{
+    clear();
+}
+
+void PhotonsCompact::append(const std::vector<Photon>& photons)
+{
+    InstanceNode* surfaceLast = nullptr;
+    quint32 index = 0;
+    for (const Photon& photon : photons)
+    {
+        // photons of one ray often hit the same surface
+        if (photon.surface != surfaceLast) {
+            surfaceLast = photon.surface;
+            index = addSurface(photon.surface);
+        }
+
+        vec3d p = m_transforms[index].transformInversePoint(photon.pos);
+        PhotonCompact q;
+        q.pos[0] = float(p.x);
+        q.pos[1] = float(p.y);
+        q.pos[2] = float(p.z);
+        q.surface = index;
+        q.bits = quint32(photon.id) << 2 | quint32(photon.isAbsorbed) << 1 | quint32(photon.isFront);
+        m_photons.push_back(q);
+    }
+    spill();
+}
+
+void PhotonsCompact::clear()
+{
+    m_photons.clear();
+    m_spill.clear();
+    m_surfaces.assign(1, nullptr);
+    m_transforms.assign(1, Affine3D());
+    m_surfaceIndex.clear();
+}
+
+int PhotonsCompact::findSurface(InstanceNode* surface) const
+{
+    if (!surface) return 0;
+    auto it = m_surfaceIndex.find(surface);
+    return it == m_surfaceIndex.end() ? -1 : int(it->second);
+}
+
+qulonglong PhotonsCompact::getMemoryUsage() const
+{
+    return qulonglong(m_photons.capacity())*sizeof(PhotonCompact) +
+        qulonglong(m_surfaces.capacity())*sizeof(InstanceNode*) +
+        qulonglong(m_transforms.capacity())*sizeof(Affine3D);
+}
+
+void PhotonsCompact::setMemoryBudget(qulonglong bytes)
+{
+    m_memoryBudget = bytes;
+    spill();
+}
+
+// a full disk keeps the records in memory
+void PhotonsCompact::spill()
+{
+    if (m_memoryBudget == 0 || qulonglong(m_photons.size())*sizeof(PhotonCompact) <= m_memoryBudget)
+        return;
+    m_spill.append(m_photons);
+}
+
+Photon PhotonsCompact::getPhoton(ulong n) const
+{
+    const PhotonCompact& q = n < m_spill.size() ? m_spill.at(n) : m_photons[n - m_spill.size()];
+    return Photon(q.id(), getPosition(q), m_surfaces[q.surface], q.isFront(), q.isAbsorbed());
+}
+
+quint32 PhotonsCompact::addSurface(InstanceNode* surface)
+{
+    if (!surface) return 0;
+    auto it = m_surfaceIndex.emplace(surface, quint32(m_surfaces.size()));
+    if (it.second) {
+        m_surfaces.push_back(surface);
+        m_transforms.push_back(surface->getAffine());
+    }
+    return it.first->second;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "Photon.h"
+#include "PhotonsSpill.h"
+#include "libraries/math/3D/Affine3D.h"
+
+
+//! PhotonCompact is a 20-byte photon record for retained photon maps.
+/*!
+ * The position is stored in float precision in the local frame of the
+ * intersected surface, or in the world frame for air. The surface is
+ * an index into the table of the owning PhotonsCompact and the path
+ * number and the side flags share one word.
+ */
+struct TONATIUH_KERNEL PhotonCompact
+{
+    float pos[3];
+    quint32 surface; // 0 for air
+    quint32 bits;    // id << 2 | isAbsorbed << 1 | isFront
+
+    int id() const {return int(bits >> 2);}
+    bool isFront() const {return bits & 1;}
+    bool isAbsorbed() const {return bits & 2;}
+    vec3d posLocal() const {return vec3d(pos[0], pos[1], pos[2]);}
+};
+
+static_assert(sizeof(PhotonCompact) == 20, "PhotonCompact must stay packed");
+
+
+//! PhotonsCompact stores photons as PhotonCompact records with a surface table.
+/*!
+ * Each distinct surface is added to the table on first use together with its
+ * object to world transform, so positions can be restored in the world frame
+ * without touching the instance tree later. Entry 0 is reserved for air.
+ *
+ * Over the memory budget the records are spilled to disk, see PhotonsSpill;
+ * getPhotons() then holds the latest ones only and forEach visits them all.
+ */
+class TONATIUH_KERNEL PhotonsCompact
+{
+public:
+    PhotonsCompact();
+
+    void append(const std::vector<Photon>& photons);
+    void reserve(ulong size) {m_photons.reserve(size);}
+    void clear();
+
+    // bytes of records kept in memory, 0 for no limit
+    void setMemoryBudget(qulonglong bytes);
+    qulonglong getMemoryBudget() const {return m_memoryBudget;}
+
+    bool isEmpty() const {return size() == 0;}
+    ulong size() const {return m_spill.size() + m_photons.size();}
+    const std::vector<PhotonCompact>& getPhotons() const {return m_photons;} // in memory
+    bool isSpilled() const {return !m_spill.isEmpty();}
+    // bytes of the records and surfaces in memory
+    qulonglong getMemoryUsage() const;
+
+    // calls f(photon) for the records from \a from on, in the order appended
+    template<class F>
+    void forEach(ulong from, F f) const;
+
+    int surfaceCount() const {return int(m_surfaces.size());}
+    InstanceNode* getSurface(quint32 index) const {return m_surfaces[index];}
+    int findSurface(InstanceNode* surface) const; // -1 if absent
+
+    vec3d getPosition(const PhotonCompact& photon) const
+    {
+        return m_transforms[photon.surface].transformPoint(photon.posLocal());
+    }
+    Photon getPhoton(ulong n) const;
+
+private:
+    quint32 addSurface(InstanceNode* surface);
+    void spill();
+
+    std::vector<PhotonCompact> m_photons;
+    PhotonsSpill<PhotonCompact> m_spill; // older than m_photons
+    qulonglong m_memoryBudget = 0;
+    std::vector<InstanceNode*> m_surfaces;
+    std::vector<Affine3D> m_transforms; // from surface to world
+    std::unordered_map<InstanceNode*, quint32> m_surfaceIndex;
+};
+
+
+
+template<class F>
+void PhotonsCompact::forEach(ulong from, F f) const
+{
+    for (const auto& block : m_spill.getBlocks()) {
+        for (ulong n = from; n < block.size; ++n)
+            f(block.data[n]);
+        from = from > block.size ? from - block.size : 0;
+    }
+    for (ulong n = from; n < m_photons.size(); ++n)
+        f(m_photons[n]);
+}
@@ -0,0 +1,330 @@
+#include "PhotonsFileMap.h"
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QTextStream>
+
+
+namespace {
+
+const char Magic[8] = {'T', 'N', 'P', 'H', 'O', 'T', 'O', 'N'};
+const quint64 HeaderSize = 72;
+const quint64 HeaderSizeV1 = 64; // version 1, without the block index offset
+const quint64 ColumnSize = 24;
+
+double toDouble(quint64 bits)
+{
+    double ans;
+    std::memcpy(&ans, &bits, sizeof(ans));
+    return ans;
+}
+
+// field of a column name in either format, -1 if not read
+int findField(const QString& name)
+{
+    if (name == "x") return PhotonsFileMap::X;
+    if (name == "y") return PhotonsFileMap::Y;
+    if (name == "z") return PhotonsFileMap::Z;
+    if (name == "side") return PhotonsFileMap::Side;
+    if (name == "surface_id" || name == "surface ID") return PhotonsFileMap::SurfaceID;
+    return -1;
+}
+
+}
+
+
+PhotonsFileMap::PhotonsFileMap():
+    m_data(0),
+    m_size(0),
+    m_photons(0),
+    m_photonPower(0.),
+    m_global(true),
+    m_compressed(false),
+    m_stride(0)
+{
+
+}
+
+PhotonsFileMap::~PhotonsFileMap()
+{
+    close();
+}
+
+/*!
+ * Maps \a fileName, a .tnpc or a .dat file.
+ * \a rowsGlobal is the coordinate frame of .dat files.
+ */
+bool PhotonsFileMap::open(const QString& fileName, bool rowsGlobal)
+{
+    close();
+    m_path = fileName;
+    m_error.clear();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return fail("Could not open photon file");
+    m_size = m_file.size();
+    if (m_size == 0)
+        return fail("Photon file is empty");
+    m_data = m_file.map(0, m_size);
+    if (!m_data)
+        return fail("Could not map photon file");
+
+    bool ok = QFileInfo(fileName).suffix() == "tnpc" ? openColumns() : openRows(rowsGlobal);
+    if (!ok) {
+        QString error = m_error;
+        close();
+        m_error = error;
+    }
+    return ok;
+}
+
+void PhotonsFileMap::close()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar*>(m_data));
+    m_data = 0;
+    m_file.close();
+    m_size = 0;
+    m_photons = 0;
+    m_photonPower = 0.;
+    m_global = true;
+    m_compressed = false;
+    m_stride = 0;
+    for (int f = 0; f < FieldCount; ++f) {
+        m_fields[f] = FieldInfo();
+        m_buffer[f].clear();
+    }
+    m_surfaces.clear();
+    m_blocks.clear();
+}
+
+quint32 PhotonsFileMap::findSurface(const QString& url) const
+{
+    return quint32(m_surfaces.indexOf(url) + 1);
+}
+
+bool PhotonsFileMap::openColumns()
+{
+    if (m_size < HeaderSizeV1 || std::memcmp(m_data, Magic, sizeof(Magic)) != 0)
+        return fail("Not a columnar photon file");
+    quint32 version = qFromLittleEndian<quint32>(m_data + 8);
+    if (version != 1 && version != 2)
+        return fail("Unsupported columnar photon file version");
+    quint64 headerSize = version == 1 ? HeaderSizeV1 : HeaderSize;
+    if (m_size < headerSize)
+        return fail("Not a columnar photon file");
+
+    quint32 flags = qFromLittleEndian<quint32>(m_data + 12);
+    quint64 blockSize = qFromLittleEndian<quint32>(m_data + 16);
+    quint32 columns = qFromLittleEndian<quint32>(m_data + 20);
+    quint64 dataOffset = qFromLittleEndian<quint64>(m_data + 24);
+    m_photons = qFromLittleEndian<quint64>(m_data + 32);
+    quint64 blocks = qFromLittleEndian<quint64>(m_data + 40);
+    quint64 surfacesOffset = qFromLittleEndian<quint64>(m_data + 48);
+    m_photonPower = toDouble(qFromLittleEndian<quint64>(m_data + 56));
+    quint64 indexOffset = version == 1 ? 0 : qFromLittleEndian<quint64>(m_data + 64);
+    m_global = flags & 1;
+    m_compressed = flags & 2;
+
+    if ((version == 1 && m_compressed) ||
+        blockSize == 0 || headerSize + ColumnSize*columns > m_size || blocks*blockSize < m_photons ||
+        (blocks > 0 && (blocks - 1)*blockSize >= m_photons))
+        return fail("Corrupt columnar photon file header");
+
+    // fields read and, for uncompressed blocks, their offsets inside a block
+    quint64 rowSize = 0;
+    for (quint32 c = 0; c < columns; ++c)
+    {
+        const uchar* p = m_data + headerSize + ColumnSize*c;
+        QString name = QString::fromUtf8(reinterpret_cast<const char*>(p), int(qstrnlen(reinterpret_cast<const char*>(p), 16)));
+        quint32 type = qFromLittleEndian<quint32>(p + 16);
+        quint32 size = qFromLittleEndian<quint32>(p + 20);
+        if (type < Column::UInt8 || type > Column::Float64 || size == 0)
+            return fail("Unknown column type in photon file");
+
+        int f = findField(name);
+        if (f >= 0) {
+            FieldInfo& info = m_fields[f];
+            info.type = Column::Type(type);
+            info.size = int(size);
+            info.column = int(c);
+            info.offset = blockSize*rowSize;
+        }
+        rowSize += size;
+    }
+
+    if (!m_compressed) {
+        if (dataOffset + blocks*blockSize*rowSize > m_size)
+            return fail("Photon file is shorter than its header");
+        for (quint64 k = 0; k < blocks; ++k)
+            m_blocks.push_back({dataOffset + k*blockSize*rowSize, std::min(blockSize, m_photons - k*blockSize), {}});
+    } else {
+        quint64 entrySize = 8 + 4*quint64(columns);
+        if (indexOffset == 0 || indexOffset + blocks*entrySize > m_size)
+            return fail("Photon file has no block index");
+        for (quint64 k = 0; k < blocks; ++k)
+        {
+            const uchar* p = m_data + indexOffset + k*entrySize;
+            BlockInfo block{qFromLittleEndian<quint64>(p), std::min(blockSize, m_photons - k*blockSize), {}};
+            quint64 end = block.offset;
+            for (quint32 c = 0; c < columns; ++c) {
+                block.sizes.push_back(qFromLittleEndian<quint32>(p + 8 + 4*c));
+                end += block.sizes.back();
+            }
+            if (end > m_size)
+                return fail("Photon block lies outside the file");
+            m_blocks.push_back(block);
+        }
+    }
+
+    // surface table
+    if (surfacesOffset + 4 > m_size)
+        return fail("Photon file has no surface table");
+    quint64 pos = surfacesOffset;
+    quint32 count = qFromLittleEndian<quint32>(m_data + pos);
+    pos += 4;
+    for (quint32 n = 0; n < count; ++n)
+    {
+        if (pos + 8 > m_size)
+            return fail("Corrupt photon surface table");
+        quint32 id = qFromLittleEndian<quint32>(m_data + pos);
+        quint32 length = qFromLittleEndian<quint32>(m_data + pos + 4);
+        pos += 8;
+        if (id == 0 || pos + length > m_size)
+            return fail("Corrupt photon surface table");
+        while (m_surfaces.size() < int(id)) m_surfaces << QString();
+        m_surfaces[id - 1] = QString::fromUtf8(reinterpret_cast<const char*>(m_data + pos), int(length));
+        pos += length;
+    }
+    return true;
+}
+
+bool PhotonsFileMap::openRows(bool global)
+{
+    QFileInfo info(m_path);
+    QString base = info.dir().absoluteFilePath(info.completeBaseName());
+    QString parameters = base + "_parameters.txt";
+    if (!QFileInfo::exists(parameters)) {
+        // the files of a split export share one parameters file
+        base.remove(QRegularExpression("_\\d+$"));
+        parameters = base + "_parameters.txt";
+    }
+    if (!readParameters(parameters))
+        return false;
+
+    m_global = global;
+    m_photons = m_size/m_stride;
+    if (m_photons*m_stride != m_size)
+        return fail("Photon file does not hold whole rows");
+
+    for (quint64 k = 0; k*BlockRows < m_photons; ++k)
+        m_blocks.push_back({k*BlockRows*m_stride, std::min(BlockRows, m_photons - k*BlockRows), {}});
+    return true;
+}
+
+// fields, surfaces and photon power written by the File exporter
+bool PhotonsFileMap::readParameters(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        m_error = QString("Could not open photon parameters file %1").arg(fileName);
+        return false;
+    }
+
+    QTextStream in(&file);
+    QString section;
+    int column = 0;
+    bool hasPower = false;
+    while (!in.atEnd())
+    {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty()) continue;
+        if (line.startsWith("START ")) {
+            section = line.mid(6);
+        } else if (line.startsWith("END ")) {
+            section.clear();
+        } else if (section == "PARAMETERS") {
+            int f = findField(line);
+            if (f >= 0)
+                m_fields[f] = {Column::Float64BE, 8, column, quint64(8*column)};
+            column++;
+        } else if (section == "SURFACES") {
+            int space = line.indexOf(' ');
+            int id = line.left(space).toInt();
+            if (space < 0 || id < 1) continue;
+            while (m_surfaces.size() < id) m_surfaces << QString();
+            m_surfaces[id - 1] = line.mid(space + 1);
+        } else if (section.isEmpty()) {
+            m_photonPower = line.toDouble(&hasPower);
+        }
+    }
+
+    if (column == 0 || !hasPower) {
+        m_error = QString("Photon parameters file %1 is incomplete").arg(fileName);
+        return false;
+    }
+    m_stride = 8*column;
+    return true;
+}
+
+/*!
+ * Returns block \a n. Views of a compressed block stay valid until the next call.
+ * On a corrupt block the rows are 0 and getError() tells why.
+ */
+PhotonsFileMap::Block PhotonsFileMap::getBlock(quint64 n)
+{
+    Block ans;
+    if (n >= m_blocks.size()) return ans;
+    const BlockInfo& block = m_blocks[n];
+
+    for (int f = 0; f < FieldCount; ++f)
+    {
+        const FieldInfo& info = m_fields[f];
+        if (info.type == Column::None) continue;
+        Column& column = ans.columns[f];
+        column.type = info.type;
+
+        if (!m_compressed) {
+            column.data = m_data + block.offset + info.offset;
+            column.stride = m_stride > 0 ? m_stride : info.size;
+            continue;
+        }
+
+        // inflate and unshuffle the chunk of this field
+        quint64 offset = block.offset;
+        for (int c = 0; c < info.column; ++c)
+            offset += block.sizes[c];
+        quint32 expected = quint32(block.rows*info.size);
+        QByteArray chunk(4, '\0');
+        qToBigEndian<quint32>(expected, chunk.data());
+        chunk.append(reinterpret_cast<const char*>(m_data + offset), int(block.sizes[info.column]));
+        QByteArray shuffled = qUncompress(chunk);
+        if (quint32(shuffled.size()) != expected) {
+            fail(QString("Could not inflate photon block %1").arg(n));
+            return Block();
+        }
+
+        QByteArray& buffer = m_buffer[f];
+        buffer.resize(int(expected));
+        char* out = buffer.data();
+        const char* in = shuffled.constData();
+        for (int b = 0; b < info.size; ++b)
+            for (quint64 r = 0; r < block.rows; ++r)
+                out[r*info.size + b] = *in++;
+        column.data = reinterpret_cast<const uchar*>(buffer.constData());
+        column.stride = info.size;
+    }
+
+    ans.rows = block.rows;
+    return ans;
+}
+
+bool PhotonsFileMap::fail(const QString& message)
+{
+    m_error = QString("%1: %2").arg(message, m_path);
+    return false;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <cstring>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QtEndian>
+
+
+//! PhotonsFileMap maps an exported photon file for reading.
+/*!
+ * Reads the files of the File photon exporter: the columnar format (.tnpc,
+ * see docs/photon-column-format.md) or the row format (.dat with its
+ * _parameters.txt). The file is mapped into memory and read through
+ * Column views, so only the pages of the columns used are loaded and
+ * maps larger than memory can be binned again without tracing.
+ *
+ * Rows are visited in blocks. Blocks of uncompressed columnar files point
+ * into the mapping; compressed blocks are inflated one at a time into a
+ * buffer that is reused, so getBlock() is not reentrant. Row files are cut
+ * into blocks of BlockRows rows of big-endian doubles.
+ *
+ * The row format does not record the coordinate frame, which is then given
+ * to open().
+ */
+class TONATIUH_KERNEL PhotonsFileMap
+{
+public:
+    enum Field {
+        X,
+        Y,
+        Z,
+        Side,
+        SurfaceID,
+        FieldCount
+    };
+
+    //! Column is a strided view of one field in a block.
+    struct Column
+    {
+        enum Type {
+            None = 0,
+            UInt8 = 1,
+            UInt32 = 2,
+            UInt64 = 3,
+            Float64 = 4,  // little-endian
+            Float64BE = 5 // big-endian, from QDataStream
+        };
+
+        const uchar* data = nullptr;
+        int stride = 0; // bytes between rows
+        Type type = None;
+
+        bool isValid() const {return data;}
+        double operator[](quint64 n) const;
+    };
+
+    struct Block
+    {
+        quint64 rows = 0;
+        Column columns[FieldCount];
+    };
+
+    static constexpr quint64 BlockRows = 1 << 16;
+
+    PhotonsFileMap();
+    ~PhotonsFileMap();
+
+    bool open(const QString& fileName, bool rowsGlobal = true);
+    void close();
+    bool isOpen() const {return m_data;}
+
+    const QString& getPath() const {return m_path;}
+    QString getError() const {return m_error;}
+
+    quint64 getPhotonCount() const {return m_photons;}
+    double getPhotonPower() const {return m_photonPower;}
+    bool isCoordinatesGlobal() const {return m_global;}
+    bool hasField(Field field) const {return m_fields[field].type != Column::None;}
+
+    const QStringList& getSurfaces() const {return m_surfaces;} // URL of surface ID n in n - 1
+    quint32 findSurface(const QString& url) const; // 0 if absent
+
+    quint64 getBlockCount() const {return m_blocks.size();}
+    Block getBlock(quint64 n);
+
+private:
+    bool openColumns();
+    bool openRows(bool global);
+    bool readParameters(const QString& fileName);
+    bool fail(const QString& message);
+
+    struct FieldInfo
+    {
+        Column::Type type = Column::None;
+        int size = 0;
+        int column = -1;    // in the file
+        quint64 offset = 0; // in a block or a row
+    };
+
+    struct BlockInfo
+    {
+        quint64 offset;
+        quint64 rows;
+        std::vector<quint32> sizes; // per file column, compressed blocks only
+    };
+
+    QString m_path;
+    QString m_error;
+    QFile m_file;
+    const uchar* m_data;
+    quint64 m_size;
+
+    quint64 m_photons;
+    double m_photonPower;
+    bool m_global;
+    bool m_compressed;
+    int m_stride; // bytes per row for row files
+    FieldInfo m_fields[FieldCount];
+    QStringList m_surfaces;
+    std::vector<BlockInfo> m_blocks;
+    QByteArray m_buffer[FieldCount]; // inflated columns of compressed blocks
+};
+
+
+inline double PhotonsFileMap::Column::operator[](quint64 n) const
+{
+    const uchar* p = data + n*stride;
+    quint64 bits;
+    switch (type) {
+    case UInt8: return *p;
+    case UInt32: return qFromLittleEndian<quint32>(p);
+    case UInt64: return double(qFromLittleEndian<quint64>(p));
+    case Float64: bits = qFromLittleEndian<quint64>(p); break;
+    case Float64BE: bits = qFromBigEndian<quint64>(p); break;
+    default: return 0.;
+    }
+    double ans;
+    std::memcpy(&ans, &bits, sizeof(ans));
+    return ans;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <QtGlobal>
+
+
+//! PhotonsReservoir keeps a weighted sample of whole ray paths for export.
+/*!
+ * Records of type T, as Photon, come in ray order with members id and
+ * surface: a path starts where the id does not grow, and every call holds
+ * whole paths, as the pages of a paged buffer do.
+ *
+ * Each path gets a uniform random key from the seed and its place in the
+ * trace, (chunk, sequence, path within the call), and the reservoir keeps
+ * the paths of smallest keys (bottom-k sampling): at most size paths of
+ * each final surface when stratified, size paths overall otherwise. The
+ * keys do not depend on which worker traced a path, so reservoirs of
+ * workers merged in any order keep the paths a single one would.
+ *
+ * A stratum that saw n paths and kept k keeps each with probability k/n,
+ * so its paths have weight n/k and weighted sums over the sample are
+ * unbiased estimates of the sums over all paths.
+ */
+template<class T>
+class PhotonsReservoir
+{
+public:
+    using Surface = decltype(T::surface);
+
+    struct Path
+    {
+        std::tuple<quint64, qulonglong, ulong, ulong> key; // random, then place
+        std::vector<T> records;
+        bool operator<(const Path& other) const {return key < other.key;}
+    };
+
+    struct Stratum
+    {
+        Surface surface = Surface(); // the final surface, none without strata
+        qulonglong seen = 0;
+        std::vector<Path> paths; // a heap with the largest key on top
+        double getWeight() const {return paths.empty() ? 0. : double(seen)/paths.size();}
+    };
+
+    PhotonsReservoir(ulong size = 0, bool stratified = false, quint64 seed = 1):
+        m_size(size), m_stratified(stratified), m_seed(seed) {}
+
+    ulong getSize() const {return m_size;}
+    bool isStratified() const {return m_stratified;}
+
+    void add(const std::vector<T>& records, qulonglong chunk, ulong sequence);
+    // the paths of other, whose calls of add were at other places
+    void merge(PhotonsReservoir&& other);
+    void clear() {m_strata.clear();}
+
+    qulonglong getPathsSeen() const;
+    qulonglong getPathsKept() const;
+    // in the order of their smallest kept key
+    std::vector<const Stratum*> getStrata() const;
+    // the records of the kept paths, the paths in key order
+    std::vector<T> getRecords() const;
+
+private:
+    static quint64 mix(quint64 z);
+    void offer(Stratum& stratum, Path&& path);
+    void offer(Stratum& stratum, const std::tuple<quint64, qulonglong, ulong, ulong>& key,
+        typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end);
+
+    ulong m_size;
+    bool m_stratified;
+    quint64 m_seed;
+    std::map<Surface, Stratum> m_strata;
+};
+
+
+
+template<class T>
+void PhotonsReservoir<T>::add(const std::vector<T>& records, qulonglong chunk, ulong sequence)
+{
+    if (m_size == 0) return;
+    const quint64 page = mix(mix(m_seed + chunk) + sequence);
+    ulong index = 0;
+    auto begin = records.begin();
+    while (begin != records.end()) {
+        auto end = begin + 1;
+        while (end != records.end() && end->id > (end - 1)->id)
+            ++end;
+        const Surface surface = m_stratified ? (end - 1)->surface : Surface();
+        Stratum& stratum = m_strata[surface];
+        stratum.surface = surface;
+        ++stratum.seen;
+        offer(stratum, std::make_tuple(mix(page + index), chunk, sequence, index), begin, end);
+        ++index;
+        begin = end;
+    }
+}
+
+template<class T>
+void PhotonsReservoir<T>::merge(PhotonsReservoir&& other)
+{
+    for (auto& item : other.m_strata) {
+        Stratum& stratum = m_strata[item.first];
+        stratum.surface = item.first;
+        stratum.seen += item.second.seen;
+        for (Path& path : item.second.paths)
+            offer(stratum, std::move(path));
+    }
+    other.m_strata.clear();
+}
+
+template<class T>
+qulonglong PhotonsReservoir<T>::getPathsSeen() const
+{
+    qulonglong ans = 0;
+    for (const auto& item : m_strata)
+        ans += item.second.seen;
+    return ans;
+}
+
+template<class T>
+qulonglong PhotonsReservoir<T>::getPathsKept() const
+{
+    qulonglong ans = 0;
+    for (const auto& item : m_strata)
+        ans += item.second.paths.size();
+    return ans;
+}
+
+template<class T>
+std::vector<const typename PhotonsReservoir<T>::Stratum*> PhotonsReservoir<T>::getStrata() const
+{
+    std::vector<std::pair<const Path*, const Stratum*>> strata;
+    for (const auto& item : m_strata) {
+        const std::vector<Path>& paths = item.second.paths;
+        if (!paths.empty())
+            strata.emplace_back(&*std::min_element(paths.begin(), paths.end()), &item.second);
+    }
+    std::sort(strata.begin(), strata.end(), [](const auto& a, const auto& b) {return *a.first < *b.first;});
+
+    std::vector<const Stratum*> ans;
+    for (const auto& item : strata)
+        ans.push_back(item.second);
+    return ans;
+}
+
+template<class T>
+std::vector<T> PhotonsReservoir<T>::getRecords() const
+{
+    std::vector<const Path*> paths;
+    size_t count = 0;
+    for (const auto& item : m_strata)
+        for (const Path& path : item.second.paths) {
+            paths.push_back(&path);
+            count += path.records.size();
+        }
+    std::sort(paths.begin(), paths.end(), [](const Path* a, const Path* b) {return *a < *b;});
+
+    std::vector<T> ans;
+    ans.reserve(count);
+    for (const Path* path : paths)
+        ans.insert(ans.end(), path->records.begin(), path->records.end());
+    return ans;
+}
+
+// splitmix64
+template<class T>
+quint64 PhotonsReservoir<T>::mix(quint64 z)
+{
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27))*0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+template<class T>
+void PhotonsReservoir<T>::offer(Stratum& stratum, Path&& path)
+{
+    std::vector<Path>& paths = stratum.paths;
+    if (paths.size() < m_size) {
+        paths.push_back(std::move(path));
+        std::push_heap(paths.begin(), paths.end());
+    } else if (path < paths.front()) {
+        std::pop_heap(paths.begin(), paths.end());
+        paths.back() = std::move(path);
+        std::push_heap(paths.begin(), paths.end());
+    }
+}
+
+// copies the records only if the path is kept
+template<class T>
+void PhotonsReservoir<T>::offer(Stratum& stratum, const std::tuple<quint64, qulonglong, ulong, ulong>& key,
+    typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end)
+{
+    std::vector<Path>& paths = stratum.paths;
+    if (paths.size() < m_size) {
+        paths.push_back(Path{key, std::vector<T>(begin, end)});
+        std::push_heap(paths.begin(), paths.end());
+    } else if (key < paths.front().key) {
+        std::pop_heap(paths.begin(), paths.end());
+        paths.back().key = key;
+        paths.back().records.assign(begin, end); // keeps the capacity
+        std::push_heap(paths.begin(), paths.end());
+    }
+}
@@ -0,0 +1,84 @@
+#include "PhotonsSample.h"
+
+#include "PhotonsCompact.h"
+
+
+PhotonsSample::PhotonsSample(ulong budget, quint64 seed):
+    m_budget(budget),
+    m_seed(seed)
+{
+    clear();
+}
+
+void PhotonsSample::setBudget(ulong rays)
+{
+    if (rays == m_budget) return;
+    m_budget = rays;
+    clear();
+}
+
+void PhotonsSample::clear()
+{
+    m_state = m_seed;
+    m_raysSeen = 0;
+    m_paths.clear();
+    m_path = 0;
+    m_inRay = false;
+}
+
+void PhotonsSample::add(const std::vector<Photon>& photons)
+{
+    if (m_budget == 0) return;
+    for (const Photon& photon : photons)
+        addPoint(photon.id, photon.pos);
+}
+
+void PhotonsSample::add(const PhotonsCompact& photons)
+{
+    if (m_budget == 0) return;
+    photons.forEach(0, [&](const PhotonCompact& photon) {
+        addPoint(photon.id(), photons.getPosition(photon));
+    });
+}
+
+void PhotonsSample::add(const Photon& photon)
+{
+    if (m_budget == 0) return;
+    addPoint(photon.id, photon.pos);
+}
+
+void PhotonsSample::addPoint(int id, const vec3d& pos)
+{
+    if (id == 0 || !m_inRay)
+        beginRay();
+    if (m_path)
+        m_path->push_back(pos);
+}
+
+// keeps the first rays, then replaces a random one with probability budget/seen
+void PhotonsSample::beginRay()
+{
+    m_inRay = true;
+    qulonglong n = m_raysSeen++;
+    if (n < m_budget) {
+        m_paths.emplace_back();
+        m_path = &m_paths.back();
+        return;
+    }
+
+    quint64 j = random() % (n + 1);
+    if (j < m_budget) {
+        m_path = &m_paths[j];
+        m_path->clear();
+    } else
+        m_path = 0;
+}
+
+// splitmix64
+quint64 PhotonsSample::random()
+{
+    quint64 z = (m_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27))*0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "Photon.h"
+
+class PhotonsCompact;
+
+
+//! PhotonsSample keeps a uniform sample of ray paths for display.
+/*!
+ * Photons are given in ray order, a path starting at a photon with id 0,
+ * and every ray seen has the same chance to be kept (reservoir sampling).
+ * Memory and drawing then depend on the budget, not on the rays traced,
+ * while the retained or exported photons are not touched.
+ *
+ * A ray may continue in the next call of add. The sample is deterministic
+ * for a given seed and order of photons.
+ */
+class TONATIUH_KERNEL PhotonsSample
+{
+public:
+    PhotonsSample(ulong budget = 0, quint64 seed = 1);
+
+    void setBudget(ulong rays); // restarts the sample if changed
+    ulong getBudget() const {return m_budget;}
+    void clear();
+
+    void add(const std::vector<Photon>& photons);
+    void add(const PhotonsCompact& photons);
+    void add(const Photon& photon);
+
+    qulonglong getRaysSeen() const {return m_raysSeen;}
+    const std::vector<std::vector<vec3d>>& getPaths() const {return m_paths;}
+
+private:
+    void beginRay();
+    void addPoint(int id, const vec3d& pos);
+    quint64 random();
+
+    ulong m_budget;
+    quint64 m_seed;
+    quint64 m_state;
+    qulonglong m_raysSeen;
+    std::vector<std::vector<vec3d>> m_paths;
+    std::vector<vec3d>* m_path; // of the current ray, 0 if not kept
+    bool m_inRay;
+};
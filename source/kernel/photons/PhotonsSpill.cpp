@@ -0,0 +1,47 @@
+#include "PhotonsSpill.h"
+
+#include <QDir>
+#include <QTemporaryFile>
+
+
+PhotonsSpillFile::PhotonsSpillFile():
+    m_bytes(0)
+{
+
+}
+
+PhotonsSpillFile::~PhotonsSpillFile()
+{
+    clear();
+}
+
+const uchar* PhotonsSpillFile::append(const void* data, qint64 bytes)
+{
+    if (!m_file) {
+        m_file.reset(new QTemporaryFile(QDir::temp().filePath("tonatiuh-photons-XXXXXX")));
+        if (!m_file->open()) {
+            m_file.reset();
+            return nullptr;
+        }
+    }
+
+    // a partial write is cut off again
+    if (!m_file->seek(m_bytes) || m_file->write(static_cast<const char*>(data), bytes) != bytes || !m_file->flush()) {
+        m_file->resize(m_bytes);
+        return nullptr;
+    }
+
+    uchar* ans = m_file->map(m_bytes, bytes);
+    if (!ans) {
+        m_file->resize(m_bytes);
+        return nullptr;
+    }
+    m_bytes += bytes;
+    return ans;
+}
+
+void PhotonsSpillFile::clear()
+{
+    m_file.reset(); // unmaps and removes the file
+    m_bytes = 0;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <memory>
+#include <vector>
+
+#include <QtGlobal>
+
+class QTemporaryFile;
+
+
+//! PhotonsSpillFile is a temporary file of blocks mapped back for reading.
+/*!
+ * Each block is written at the end of the file and mapped read-only, so the
+ * records stay addressable while the system pages them out to disk.
+ * The file is removed when the object is destroyed or cleared.
+ */
+class TONATIUH_KERNEL PhotonsSpillFile
+{
+public:
+    PhotonsSpillFile();
+    PhotonsSpillFile(const PhotonsSpillFile&) = delete;
+    PhotonsSpillFile& operator=(const PhotonsSpillFile&) = delete;
+    ~PhotonsSpillFile();
+
+    // the mapping of the block written, 0 if the disk refused it
+    const uchar* append(const void* data, qint64 bytes);
+    void clear();
+
+    qint64 getBytes() const {return m_bytes;}
+
+private:
+    std::unique_ptr<QTemporaryFile> m_file;
+    qint64 m_bytes;
+};
+
+
+//! PhotonsSpill keeps records of type T in blocks of a PhotonsSpillFile.
+/*!
+ * Used by photon maps over their memory budget: the records in memory are
+ * appended as one block and their vector is emptied. Blocks are read in
+ * the order they were added.
+ */
+template<class T>
+class PhotonsSpill
+{
+public:
+    struct Block
+    {
+        const T* data;
+        ulong size;
+    };
+
+    // moves \a records to a new block, false if they are kept
+    bool append(std::vector<T>& records);
+    void clear();
+
+    bool isEmpty() const {return m_size == 0;}
+    ulong size() const {return m_size;}
+    const std::vector<Block>& getBlocks() const {return m_blocks;}
+
+    // the record \a n counted over the blocks, n < size()
+    const T& at(ulong n) const;
+
+private:
+    std::unique_ptr<PhotonsSpillFile> m_file;
+    std::vector<Block> m_blocks;
+    ulong m_size = 0;
+};
+
+
+
+template<class T>
+bool PhotonsSpill<T>::append(std::vector<T>& records)
+{
+    if (records.empty()) return true;
+    if (!m_file) m_file.reset(new PhotonsSpillFile);
+
+    const uchar* data = m_file->append(records.data(), qint64(records.size()*sizeof(T)));
+    if (!data) return false;
+
+    m_blocks.push_back(Block{reinterpret_cast<const T*>(data), ulong(records.size())});
+    m_size += records.size();
+    records.clear();
+    return true;
+}
+
+template<class T>
+void PhotonsSpill<T>::clear()
+{
+    m_blocks.clear();
+    m_size = 0;
+    m_file.reset();
+}
+
+template<class T>
+const T& PhotonsSpill<T>::at(ulong n) const
+{
+    for (const Block& block : m_blocks) {
+        if (n < block.size) return block.data[n];
+        n -= block.size;
+    }
+    return m_blocks.back().data[m_blocks.back().size - 1];
+}
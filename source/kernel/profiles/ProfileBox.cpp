@@ -1,5 +1,7 @@
 #include "ProfileBox.h"
 
+#include <Inventor/sensors/SoNodeSensor.h>
+
 
 SO_NODE_SOURCE(ProfileBox)
 
@@ -14,11 +16,21 @@ ProfileBox::ProfileBox()
     isBuiltIn = TRUE;
     SO_NODE_ADD_FIELD( uSize, (1.) );
     SO_NODE_ADD_FIELD( vSize, (1.) );
+
+    onSensor(this, 0);
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+}
+
+ProfileBox::~ProfileBox()
+{
+    delete m_sensor;
 }
 
 Box2D ProfileBox::getBox() const
 {
-    vec2d v(uSize.getValue()/2., vSize.getValue()/2.);
+    vec2d v(m_uSize/2., m_vSize/2.);
     return Box2D(-v, v);
 }
 
@@ -31,8 +43,8 @@ void ProfileBox::setBox(const Box2D& box)
 
 bool ProfileBox::isInside(double u, double v) const
 {
-    return 2.*std::abs(u) <= uSize.getValue() &&
-           2.*std::abs(v) <= vSize.getValue();
+    return 2.*std::abs(u) <= m_uSize &&
+           2.*std::abs(v) <= m_vSize;
 }
 
 QVector<vec2d> ProfileBox::makeMesh(QSize& dims) const
@@ -52,3 +64,10 @@ QVector<vec2d> ProfileBox::makeMesh(QSize& dims) const
     }
     return ans;
 }
+
+void ProfileBox::onSensor(void* data, SoSensor*)
+{
+    ProfileBox* profile = (ProfileBox*) data;
+    profile->m_uSize = profile->uSize.getValue();
+    profile->m_vSize = profile->vSize.getValue();
+}
@@ -21,4 +21,14 @@ public:
     QVector<vec2d> makeMesh(QSize& dims) const;
 
     NAME_ICON_FUNCTIONS("Box", ":/profiles/ProfileBox.png")
+
+protected:
+    ~ProfileBox();
+
+    // the fields, for tracing
+    double m_uSize;
+    double m_vSize;
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
 };
@@ -2,6 +2,8 @@
 
 #include "libraries/math/gcf.h"
 
+#include <Inventor/sensors/SoNodeSensor.h>
+
 
 SO_NODE_SOURCE(ProfileCircular)
 
@@ -27,9 +29,24 @@ ProfileCircular::ProfileCircular()
 
 //    SO_NODE_ADD_FIELD( phiMin, ("-180d) );
 //    SO_NODE_ADD_FIELD( phiMax, ("180d") );
+
+    onSensor(this, 0);
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+}
+
+ProfileCircular::~ProfileCircular()
+{
+    delete m_sensor;
 }
 
 Box2D ProfileCircular::getBox() const
+{
+    return m_box;
+}
+
+Box2D ProfileCircular::findBox() const
 {
     double rMinV = rMin.getValue();
     double rMaxV = rMax.getValue();
@@ -76,11 +93,11 @@ void ProfileCircular::setBox(const Box2D& box)
 bool ProfileCircular::isInside(double u, double v) const
 {
     double r2 = u*u + v*v;
-    if (r2 < gcf::pow2(rMin.getValue())) return false;
-    if (r2 > gcf::pow2(rMax.getValue())) return false;
+    if (r2 < m_r2Min) return false;
+    if (r2 > m_r2Max) return false;
     double phi = atan2(v, u);
-    if (phi < phiMin.getValue()) return false;
-    if (phi > phiMax.getValue()) return false;
+    if (phi < m_phiMin) return false;
+    if (phi > m_phiMax) return false;
     return true;
 }
 
@@ -103,3 +120,13 @@ QVector<vec2d> ProfileCircular::makeMesh(QSize& dims) const
     }
     return ans;
 }
+
+void ProfileCircular::onSensor(void* data, SoSensor*)
+{
+    ProfileCircular* profile = (ProfileCircular*) data;
+    profile->m_r2Min = gcf::pow2(profile->rMin.getValue());
+    profile->m_r2Max = gcf::pow2(profile->rMax.getValue());
+    profile->m_phiMin = profile->phiMin.getValue();
+    profile->m_phiMax = profile->phiMax.getValue();
+    profile->m_box = profile->findBox();
+}
@@ -25,5 +25,16 @@ public:
     NAME_ICON_FUNCTIONS("Circular", ":/profiles/ProfileCircular.png")
 
 protected:
-    ~ProfileCircular() {}
+    ~ProfileCircular();
+    Box2D findBox() const;
+
+    // the fields, for tracing
+    double m_r2Min;
+    double m_r2Max;
+    double m_phiMin;
+    double m_phiMax;
+    Box2D m_box;
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
 };
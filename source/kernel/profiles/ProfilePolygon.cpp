@@ -73,9 +73,10 @@ void ProfilePolygon::setBox(const Box2D& box)
     points.setValues(0, 4, vs);
 }
 
+// same as m_polygon.containsPoint(QPointF(u, v), Qt::OddEvenFill)
 bool ProfilePolygon::isInside(double u, double v) const
 {
-    return m_polygon.containsPoint(QPointF(u, v), Qt::OddEvenFill);
+    return m_grid.isInside(vec2d(u, v));
 }
 
 QVector<vec2d> ProfilePolygon::makeMesh(QSize& dims) const //?
@@ -105,9 +106,15 @@ void ProfilePolygon::onSensor(void* data, SoSensor*)
 
     polygon.clear();
     profile->m_box = Box2D();
+    std::vector<vec2d> vertices;
     for (int n = 0; n < points.getNum(); ++n) {
        const SbVec2f& v = *points.getValues(n);
        polygon << QPointF(v[0], v[1]);
        profile->m_box << vec2d(v[0], v[1]);
+       vertices.push_back(vec2d(v[0], v[1]));
     }
+
+    // containsPoint closes the polygon unless its ends compare equal
+    bool closed = !polygon.isEmpty() && polygon.last() != polygon.first();
+    profile->m_grid.build(vertices, closed);
 }
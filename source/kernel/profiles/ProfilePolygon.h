@@ -4,6 +4,7 @@
 #include <Inventor/fields/SoMFVec2f.h>
 
 #include "kernel/profiles/ProfileRT.h"
+#include "libraries/math/2D/PolygonGrid.h"
 #include "libraries/math/2D/vec2d.h"
 #include "libraries/Coin3D/MFVec2.h"
 
@@ -29,6 +30,7 @@ public:
 
 protected:
     QPolygonF m_polygon;
+    PolygonGrid m_grid; // for isInside
     Box2D m_box;
 
     QSharedPointer<SoFieldSensor> m_sensor;
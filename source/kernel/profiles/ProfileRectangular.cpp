@@ -2,6 +2,8 @@
 
 #include "libraries/math/gcf.h"
 
+#include <Inventor/sensors/SoNodeSensor.h>
+
 
 SO_NODE_SOURCE(ProfileRectangular)
 
@@ -18,13 +20,23 @@ ProfileRectangular::ProfileRectangular()
     SO_NODE_ADD_FIELD( uMax, (0.5) );
     SO_NODE_ADD_FIELD( vMin, (-0.5) );
     SO_NODE_ADD_FIELD( vMax, (0.5) );
+
+    onSensor(this, 0);
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+}
+
+ProfileRectangular::~ProfileRectangular()
+{
+    delete m_sensor;
 }
 
 Box2D ProfileRectangular::getBox() const
 {
     return Box2D(
-        vec2d(uMin.getValue(), vMin.getValue()),
-        vec2d(uMax.getValue(), vMax.getValue())
+        vec2d(m_uMin, m_vMin),
+        vec2d(m_uMax, m_vMax)
     );
 }
 
@@ -38,8 +50,8 @@ void ProfileRectangular::setBox(const Box2D& box)
 
 bool ProfileRectangular::isInside(double u, double v) const
 {
-    return uMin.getValue() <= u && u <= uMax.getValue() &&
-           vMin.getValue() <= v && v <= vMax.getValue();
+    return m_uMin <= u && u <= m_uMax &&
+           m_vMin <= v && v <= m_vMax;
 }
 
 QVector<vec2d> ProfileRectangular::makeMesh(QSize& dims) const
@@ -57,3 +69,12 @@ QVector<vec2d> ProfileRectangular::makeMesh(QSize& dims) const
     }
     return ans;
 }
+
+void ProfileRectangular::onSensor(void* data, SoSensor*)
+{
+    ProfileRectangular* profile = (ProfileRectangular*) data;
+    profile->m_uMin = profile->uMin.getValue();
+    profile->m_uMax = profile->uMax.getValue();
+    profile->m_vMin = profile->vMin.getValue();
+    profile->m_vMax = profile->vMax.getValue();
+}
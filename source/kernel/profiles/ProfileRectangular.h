@@ -23,4 +23,16 @@ public:
     QVector<vec2d> makeMesh(QSize& dims) const;
 
     NAME_ICON_FUNCTIONS("Rectangular", ":/profiles/ProfileRectangular.png")
+
+protected:
+    ~ProfileRectangular();
+
+    // the fields, for tracing
+    double m_uMin;
+    double m_uMax;
+    double m_vMin;
+    double m_vMax;
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
 };
@@ -2,6 +2,8 @@
 
 #include "libraries/math/gcf.h"
 
+#include <Inventor/sensors/SoNodeSensor.h>
+
 
 SO_NODE_SOURCE(ProfileRegular)
 
@@ -15,6 +17,16 @@ ProfileRegular::ProfileRegular()
     SO_NODE_CONSTRUCTOR(ProfileRegular);
     SO_NODE_ADD_FIELD( r, (1.) );
     SO_NODE_ADD_FIELD( n, (6) );
+
+    onSensor(this, 0);
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+}
+
+ProfileRegular::~ProfileRegular()
+{
+    delete m_sensor;
 }
 
 Box2D ProfileRegular::getBox() const
@@ -33,11 +45,11 @@ void ProfileRegular::setBox(const Box2D& box)
 bool ProfileRegular::isInside(double u, double v) const
 {
     double r2 = u*u + v*v;
-    double rOut = r.getValue();
+    double rOut = m_rOut;
     if (r2 > rOut*rOut) return false;
 
-    double phiStep = gcf::TwoPi/n.getValue();
-    double rIn = rOut*cos(phiStep/2.);
+    double phiStep = m_phiStep;
+    double rIn = m_rIn;
     if (r2 < rIn*rIn) return true;
 
     double phi = atan2(v, u) + phiStep/2. + 90.*gcf::degree;
@@ -67,3 +79,11 @@ QVector<vec2d> ProfileRegular::makeMesh(QSize& dims) const
     }
     return ans;
 }
+
+void ProfileRegular::onSensor(void* data, SoSensor*)
+{
+    ProfileRegular* profile = (ProfileRegular*) data;
+    profile->m_rOut = profile->r.getValue();
+    profile->m_phiStep = gcf::TwoPi/profile->n.getValue();
+    profile->m_rIn = profile->m_rOut*cos(profile->m_phiStep/2.);
+}
@@ -23,5 +23,13 @@ public:
     NAME_ICON_FUNCTIONS("Regular", ":/profiles/ProfileRegular.png")
 
 protected:
-    ~ProfileRegular() {}
+    ~ProfileRegular();
+
+    // the fields, for tracing
+    double m_rOut;
+    double m_rIn;
+    double m_phiStep;
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
 };
@@ -22,6 +22,9 @@ public:
 
     virtual ~Random() {}
 
+    // buffer of generators drawn on the hot path of a tracer, 16 kB to stay in L1
+    static const ulong StreamSize = 2048;
+
     double RandomDouble()
     {
         if (m_index >= m_array.size())
@@ -35,6 +38,22 @@ public:
 
     virtual void FillArray(std::vector<double>& array) = 0;
 
+    // the numbers of a ray start here; quasi-random generators number them as
+    // dimensions of one point of their sequence, pseudo-random ones ignore it
+    virtual void beginSample() {}
+    // the next number is that of dimension, if no later one was drawn
+    virtual void skipToDimension(int /*dimension*/) {}
+    // the next beginSample begins the last sample again, so a ray draws the
+    // same numbers once more; false if not supported
+    virtual bool repeatSample() {return false;}
+
+    // independent lock-free generator for one worker, or nullptr if not supported
+    virtual Random* createStream() {return nullptr;}
+    // generator of the same kind for substream \a index of the stream seeded
+    // with \a seed, the same for the same arguments whatever this one drew;
+    // nullptr if not supported
+    virtual Random* createSubstream(ulong /*seed*/, qulonglong /*index*/) const {return nullptr;}
+
     ulong NumbersGenerated() const {return m_total;}
     ulong NumbersProvided() const {return m_total - m_array.size() + m_index;}
 
@@ -1,5 +1,7 @@
 #include "RandomParallel.h"
 
+#include "kernel/run/TraceEvents.h"
+
 
 RandomParallel::RandomParallel(Random* rand, QMutex* mutex, ulong size):
     Random(size),
@@ -11,7 +13,11 @@ RandomParallel::RandomParallel(Random* rand, QMutex* mutex, ulong size):
 
 void RandomParallel::FillArray(std::vector<double>& array)
 {
-    m_mutex->lock();
+    TraceEventScope event("random refill", "random", "numbers", qint64(array.size()));
+    {
+        TraceEventScope wait("random lock", "wait");
+        m_mutex->lock();
+    }
     m_rand->FillArray(array);
     m_mutex->unlock();
 }
@@ -0,0 +1,84 @@
+#include "RandomPhilox.h"
+
+namespace
+{
+const quint32 PhiloxM0 = 0xD2511F53u;
+const quint32 PhiloxM1 = 0xCD9E8D57u;
+const quint32 PhiloxW0 = 0x9E3779B9u;
+const quint32 PhiloxW1 = 0xBB67AE85u;
+const double Double53 = 1./9007199254740992.; // 2^-53
+
+inline void philoxRound(quint32* c, const quint32* k)
+{
+    quint64 p0 = quint64(PhiloxM0)*c[0];
+    quint64 p1 = quint64(PhiloxM1)*c[2];
+    quint32 hi0 = quint32(p0 >> 32), lo0 = quint32(p0);
+    quint32 hi1 = quint32(p1 >> 32), lo1 = quint32(p1);
+    c[0] = hi1 ^ c[1] ^ k[0];
+    c[1] = lo1;
+    c[2] = hi0 ^ c[3] ^ k[1];
+    c[3] = lo0;
+}
+
+// 10 rounds of Philox4x32
+inline void philox(quint32* c, quint32 k0, quint32 k1)
+{
+    quint32 k[2] = {k0, k1};
+    for (int r = 0; r < 10; ++r) {
+        philoxRound(c, k);
+        k[0] += PhiloxW0;
+        k[1] += PhiloxW1;
+    }
+}
+}
+
+
+RandomPhilox::RandomPhilox(ulong seed, ulong stream, ulong substream, ulong size):
+    Random(size),
+    m_seed(seed),
+    m_stream(stream),
+    m_substream(substream),
+    m_block(0),
+    m_substreamNext(0)
+{
+
+}
+
+void RandomPhilox::FillArray(std::vector<double>& array)
+{
+    const quint64 seed = quint64(m_seed);
+    const quint32 k0 = quint32(seed);
+    const quint32 k1 = quint32(seed >> 32);
+
+    ulong n = 0;
+    while (n < array.size())
+    {
+        quint32 c[4] = {
+            quint32(m_block),
+            quint32(m_block >> 32),
+            quint32(m_stream),
+            quint32(m_substream)
+        };
+        philox(c, k0, k1);
+        ++m_block;
+
+        // two 53-bit doubles in [0, 1) per block
+        quint64 a = (quint64(c[0]) << 32 | c[1]) >> 11;
+        array[n++] = a*Double53;
+        if (n == array.size()) break;
+        quint64 b = (quint64(c[2]) << 32 | c[3]) >> 11;
+        array[n++] = b*Double53;
+    }
+}
+
+/*!
+ * Returns a new independent substream of this stream, numbered from 1.
+ * Safe to call concurrently; no state is shared with the returned generator.
+ * Substreams do not create further streams.
+ */
+Random* RandomPhilox::createStream()
+{
+    if (m_substream != 0) return nullptr;
+    ulong substream = 1 + m_substreamNext.fetch_add(1);
+    return new RandomPhilox(m_seed, m_stream, substream, StreamSize);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "kernel/random/Random.h"
+
+#include <atomic>
+
+
+//! RandomPhilox is a counter-based (Philox4x32-10) random generator.
+/*!
+ * The generator has no sequential state besides a block counter, so any
+ * number of independent streams can be derived from one seed without
+ * locking. Each (seed, stream, substream) triple defines its own sequence.
+ */
+class TONATIUH_KERNEL RandomPhilox: public Random
+{
+public:
+    RandomPhilox(ulong seed, ulong stream = 0, ulong substream = 0, ulong size = 100'000);
+
+    void FillArray(std::vector<double>& array);
+    Random* createStream();
+
+    ulong seed() const {return m_seed;}
+    ulong stream() const {return m_stream;}
+    ulong substream() const {return m_substream;}
+
+    NAME_ICON_FUNCTIONS("Philox (counter-based)", ":/RandomX.png")
+
+protected:
+    ulong m_seed;
+    ulong m_stream;
+    ulong m_substream;
+    quint64 m_block;
+    std::atomic<ulong> m_substreamNext;
+};
@@ -0,0 +1,38 @@
+#include "RandomPhiloxRays.h"
+
+namespace
+{
+// numbers of a ray rarely exceed one buffer
+const ulong RayBufferSize = 16;
+// set in the substream of ray streams, numbered by chunk streams from 0
+const ulong RayStreams = 0x80000000ul;
+}
+
+
+RandomPhiloxRays::RandomPhiloxRays(ulong seed, qulonglong firstRay):
+    RandomPhilox(seed, 0xFFFFFFFFul, 0xFFFFFFFFul, RayBufferSize), // numbers before the first ray
+    m_ray(firstRay)
+{
+
+}
+
+void RandomPhiloxRays::beginSample()
+{
+    m_stream = ulong(quint32(m_ray));
+    m_substream = RayStreams | ulong(quint32(m_ray >> 32));
+    m_block = 0;
+    m_index = m_array.size();
+    ++m_ray;
+}
+
+bool RandomPhiloxRays::repeatSample()
+{
+    if (m_ray == 0) return false;
+    --m_ray;
+    return true;
+}
+
+Random* RandomPhiloxRays::createStream()
+{
+    return new RandomPhiloxRays(m_seed, m_ray);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "kernel/random/RandomPhilox.h"
+
+
+//! RandomPhiloxRays gives every ray its own Philox4x32-10 stream.
+/*!
+ * beginSample moves to the stream of the next ray, from firstRay on, and
+ * the numbers of the ray are drawn from it alone. A ray then depends on the
+ * seed and its index in the trace only, not on the chunk or worker tracing
+ * it, so chunks of a trace are generators starting at the first ray of the
+ * chunk and results do not depend on the chunk size either.
+ *
+ * Ray streams are apart from the chunk streams and substreams of
+ * RandomPhilox with the same seed.
+ */
+class TONATIUH_KERNEL RandomPhiloxRays: public RandomPhilox
+{
+public:
+    RandomPhiloxRays(ulong seed, qulonglong firstRay = 0);
+
+    void beginSample();
+    bool repeatSample();
+    // a generator continuing at nextRay, drawn by a tracer without locking;
+    // only one of the two is drawn from afterwards
+    Random* createStream();
+
+    qulonglong nextRay() const {return m_ray;}
+
+    NAME_ICON_FUNCTIONS("Philox per ray (counter-based)", ":/RandomX.png")
+
+protected:
+    qulonglong m_ray;
+};
@@ -0,0 +1,40 @@
+#include "RandomSobol.h"
+
+
+RandomSobol::RandomSobol(ulong seed, qulonglong firstSample):
+    Random(SobolSequence::Dimensions),
+    m_sequence(quint32(seed)),
+    m_sample(firstSample),
+    m_inPoint(false),
+    m_generator(static_cast<std::mt19937_64::result_type>(seed) ^ (firstSample*0x9e3779b97f4a7c15ull)),
+    m_distribution(0., 1.)
+{
+
+}
+
+// the numbers past the point, or before the first sample
+void RandomSobol::FillArray(std::vector<double>& array)
+{
+    for (ulong n = 0; n < array.size(); ++n)
+        array[n] = m_distribution(m_generator);
+    m_inPoint = false;
+}
+
+void RandomSobol::beginSample()
+{
+    m_sequence.point(m_sample++, m_array.data(), int(m_array.size()));
+    m_total += m_array.size();
+    m_index = 0;
+    m_inPoint = true;
+}
+
+Random* RandomSobol::createStream()
+{
+    return new RandomSobol(m_sequence.seed(), m_sample);
+}
+
+void RandomSobol::skipToDimension(int dimension)
+{
+    if (!m_inPoint || dimension <= int(m_index)) return;
+    m_index = qMin<ulong>(dimension, m_array.size());
+}
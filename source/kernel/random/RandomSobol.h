@@ -0,0 +1,44 @@
+#pragma once
+
+#include "kernel/random/Random.h"
+#include "kernel/random/SobolSequence.h"
+
+#include <random>
+
+
+//! RandomSobol gives every ray a point of a scrambled Sobol sequence.
+/*!
+ * beginSample takes the next point, from firstSample on, and the numbers of
+ * the ray are its dimensions in order; skipToDimension moves forward to a
+ * fixed dimension, so a part of the ray that draws a varying count of
+ * numbers does not shift the dimensions of the next part. Numbers beyond
+ * the dimensions of the point come from a Mersenne-Twister seeded with the
+ * seed and firstSample.
+ *
+ * A ray then depends on seed and its index only, as with counter-based
+ * streams, so chunks of a trace are generators starting at the first ray
+ * of the chunk.
+ */
+class TONATIUH_KERNEL RandomSobol: public Random
+{
+public:
+    RandomSobol(ulong seed, qulonglong firstSample = 0);
+
+    void FillArray(std::vector<double>& array);
+    void beginSample();
+    void skipToDimension(int dimension);
+    // a generator continuing at nextSample, drawn by a tracer without locking;
+    // only one of the two is drawn from afterwards
+    Random* createStream();
+
+    qulonglong nextSample() const {return m_sample;}
+
+    NAME_ICON_FUNCTIONS("Sobol (quasi-random)", ":/RandomX.png")
+
+protected:
+    SobolSequence m_sequence;
+    qulonglong m_sample;
+    bool m_inPoint; // m_array holds the point of the current sample
+    std::mt19937_64 m_generator;
+    std::uniform_real_distribution<double> m_distribution;
+};
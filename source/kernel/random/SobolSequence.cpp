@@ -0,0 +1,120 @@
+#include "SobolSequence.h"
+
+namespace {
+
+// Joe and Kuo, new-joe-kuo-6.21201, dimensions 2 to 8: degree, coefficients, initial numbers
+struct Polynomial
+{
+    int s;
+    quint32 a;
+    quint32 m[5];
+};
+
+const Polynomial Polynomials[SobolSequence::Dimensions - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}}
+};
+
+struct Directions
+{
+    Directions()
+    {
+        for (int k = 0; k < 32; ++k)
+            v[0][k] = 1u << (31 - k);
+
+        for (int d = 1; d < SobolSequence::Dimensions; ++d) {
+            const Polynomial& p = Polynomials[d - 1];
+            quint32* w = v[d];
+            for (int k = 0; k < p.s; ++k)
+                w[k] = p.m[k] << (31 - k);
+            for (int k = p.s; k < 32; ++k) {
+                w[k] = w[k - p.s] ^ (w[k - p.s] >> p.s);
+                for (int j = 1; j < p.s; ++j)
+                    if ((p.a >> (p.s - 1 - j)) & 1u)
+                        w[k] ^= w[k - j];
+            }
+        }
+    }
+
+    quint32 v[SobolSequence::Dimensions][32];
+};
+
+const Directions& directions()
+{
+    static const Directions ans;
+    return ans;
+}
+
+quint32 reverseBits(quint32 x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Laine-Karras permutation with Burley's constants: every bit is flipped
+// by a hash of the bits below it only
+quint32 laineKarras(quint32 x, quint32 seed)
+{
+    x += seed;
+    x ^= x*0x6c50b47cu;
+    x ^= x*0xb82f1e52u;
+    x ^= x*0xc7afe638u;
+    x ^= x*0x8d22f6e6u;
+    return x;
+}
+
+// a nested uniform (Owen) scramble, every bit flipped by a hash of the bits above it
+quint32 scramble(quint32 x, quint32 seed)
+{
+    return reverseBits(laineKarras(reverseBits(x), seed));
+}
+
+quint32 hashCombine(quint32 seed, quint32 v)
+{
+    return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+quint32 hash(quint32 x)
+{
+    // lowbias32 by Chris Wellons
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+} // namespace
+
+
+SobolSequence::SobolSequence(quint32 seed):
+    m_seed(seed)
+{
+
+}
+
+double SobolSequence::sample(quint64 index, int dimension) const
+{
+    const quint32 i = scramble(quint32(index), m_seed);
+    const quint32* v = directions().v[dimension];
+    quint32 x = 0;
+    for (quint32 bits = i; bits; bits >>= 1, ++v)
+        if (bits & 1u) x ^= *v;
+    x = scramble(x, hash(hashCombine(m_seed, quint32(dimension))));
+    return (double(x) + 0.5)/4294967296.;
+}
+
+void SobolSequence::point(quint64 index, double* values, int size) const
+{
+    for (int d = 0; d < size; ++d)
+        values[d] = sample(index, d);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <qglobal.h>
+
+
+//! SobolSequence gives points of an Owen-scrambled Sobol sequence.
+/*!
+ * Dimension 0 is the van der Corput sequence and the others use the
+ * Joe-Kuo direction numbers. The index and every dimension are scrambled by
+ * nested uniform permutations hashed from the seed (Burley 2020), so aligned
+ * blocks of 2^k indices stay stratified in every dimension and in pairs of
+ * dimensions, and seeds give independent randomizations.
+ *
+ * Indices are taken modulo 2^32 and values lie in (0, 1).
+ */
+class TONATIUH_KERNEL SobolSequence
+{
+public:
+    static const int Dimensions = 8;
+
+    explicit SobolSequence(quint32 seed = 0);
+
+    quint32 seed() const {return m_seed;}
+    double sample(quint64 index, int dimension) const;
+    // the point of index in dimensions [0, size)
+    void point(quint64 index, double* values, int size = Dimensions) const;
+
+private:
+    quint32 m_seed;
+};
@@ -0,0 +1,138 @@
+#include "AdaptiveFlux.h"
+
+#include "kernel/profiles/ProfileRT.h"
+#include "kernel/run/InstanceNode.h"
+#include "kernel/run/RayTracer.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/ShapeRT.h"
+
+
+namespace {
+
+InstanceNode* findShape(InstanceNode* instance, const QString& url)
+{
+    SoNode* node = instance->getNode();
+    if (node && node->getTypeId().isDerivedFrom(TShapeKit::getClassTypeId()))
+        return instance->getURL() == url ? instance : 0;
+
+    for (InstanceNode* child : instance->children)
+        if (InstanceNode* ans = findShape(child, url))
+            return ans;
+    return 0;
+}
+
+}
+
+
+AdaptiveFlux::AdaptiveFlux()
+{
+
+}
+
+AdaptiveFlux::~AdaptiveFlux()
+{
+
+}
+
+// before the first bind
+void AdaptiveFlux::addTarget(const QString& url, bool isFront, const QuadtreeGrid::Settings& settings, const Box2D& window)
+{
+    TargetData data;
+    data.target = Target{url, isFront, settings, window};
+    m_targets.push_back(std::move(data));
+}
+
+bool AdaptiveFlux::bind(InstanceNode* root, QString* error)
+{
+    for (TargetData& data : m_targets)
+    {
+        data.surface = root ? findShape(root, data.target.url) : 0;
+        if (!data.surface) {
+            if (error) *error = QString("Adaptive flux surface %1 was not found.").arg(data.target.url);
+            return false;
+        }
+
+        TShapeKit* kit = static_cast<TShapeKit*>(data.surface->getNode());
+        data.shape = static_cast<ShapeRT*>(kit->shapeRT.getValue());
+        ProfileRT* profile = static_cast<ProfileRT*>(kit->profileRT.getValue());
+        if (!data.shape || !profile) {
+            if (error) *error = QString("Adaptive flux surface %1 has no shape or profile.").arg(data.target.url);
+            return false;
+        }
+        data.toWorld = data.surface->getTransform();
+        data.toObject = data.toWorld.inversed();
+        if (!data.grid) {
+            const Box2D box = data.target.window.isValid() ? data.target.window : profile->getBox();
+            data.grid.reset(new QuadtreeGrid(box, data.target.settings));
+        }
+    }
+    return true;
+}
+
+void AdaptiveFlux::beginWorkers(int workers)
+{
+    for (TargetData& data : m_targets)
+        data.grid->beginWorkers(workers);
+}
+
+AdaptiveFlux::HitCallback AdaptiveFlux::hitCallback(int worker)
+{
+    return [this, worker](const RayTracerHit& hit) {
+        addHit(worker, hit);
+    };
+}
+
+void AdaptiveFlux::addHit(int worker, const RayTracerHit& hit) const
+{
+    for (const TargetData& data : m_targets)
+    {
+        if (hit.surface != data.surface || hit.isFront != data.target.isFront) continue;
+        const vec2d uv = data.shape->getUV(data.toObject.transformPoint(hit.position));
+        data.grid->addPoint(worker, uv, hit.weight);
+    }
+}
+
+void AdaptiveFlux::beginChunks(qulonglong first, qulonglong end)
+{
+    for (TargetData& data : m_targets)
+        data.grid->beginChunks(first, end);
+}
+
+void AdaptiveFlux::endChunk(int worker, qulonglong chunk)
+{
+    for (TargetData& data : m_targets)
+        data.grid->endChunk(worker, chunk);
+}
+
+void AdaptiveFlux::endWorkers()
+{
+    for (TargetData& data : m_targets)
+        data.grid->endWorkers();
+}
+
+void AdaptiveFlux::clear()
+{
+    for (TargetData& data : m_targets)
+        if (data.grid)
+            data.grid->clear();
+}
+
+std::vector<double> AdaptiveFlux::getFlux(int n, double powerPerRay) const
+{
+    const TargetData& data = m_targets[n];
+    const std::vector<QuadtreeGrid::Cell> cells = data.grid->getCells();
+    std::vector<double> ans(cells.size(), 0.);
+    for (size_t k = 0; k < cells.size(); ++k) {
+        const QuadtreeGrid::Cell& cell = cells[k];
+        if (cell.weight == 0.) continue;
+        const double area = data.shape->findArea(cell.box.min().x, cell.box.min().y, cell.box.max().x, cell.box.max().y, data.toWorld);
+        if (area > 0.)
+            ans[k] = cell.weight*powerPerRay/area;
+    }
+    return ans;
+}
+
+std::vector<double> AdaptiveFlux::getUniformFlux(int n, double powerPerRay, int rows, int cols) const
+{
+    return m_targets[n].grid->resample(getFlux(n, powerPerRay), rows, cols);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QString>
+
+#include "kernel/run/QuadtreeGrid.h"
+#include "libraries/math/3D/Transform.h"
+
+class InstanceNode;
+class ShapeRT;
+struct RayTracerHit;
+
+
+//! AdaptiveFlux bins ray hits on receiver surfaces in grids that refine at the peaks.
+/*!
+ * Each target is one side of a surface with a QuadtreeGrid over the (u, v)
+ * box of its profile, or over a window of it, so cells split where the
+ * flux varies and stay coarse where it is flat, up to a depth and a number
+ * of cells. Every worker hands its hits over through hitCallback(worker);
+ * with beginChunks() they are added chunk by chunk in the order of the
+ * chunks, and the grids depend neither on the workers nor on when they
+ * finish, as those of FluxAccumulator.
+ *
+ * The flux of a cell is its weight over its area on the surface. Grids are
+ * also resampled on uniform grids for the tools that read those.
+ */
+class TONATIUH_KERNEL AdaptiveFlux
+{
+public:
+    using HitCallback = std::function<void(const RayTracerHit&)>;
+
+    struct Target
+    {
+        QString url;
+        bool isFront;
+        QuadtreeGrid::Settings settings;
+        Box2D window; // (u, v) binned, invalid for the box of the profile
+    };
+
+    AdaptiveFlux();
+    ~AdaptiveFlux();
+
+    void addTarget(const QString& url, bool isFront, const QuadtreeGrid::Settings& settings, const Box2D& window = Box2D());
+    int getTargetCount() const {return int(m_targets.size());}
+    const Target& getTarget(int n) const {return m_targets[n].target;}
+
+    // the grids are made by the first bind and kept by later ones
+    bool bind(InstanceNode* root, QString* error = nullptr);
+    void beginWorkers(int workers);
+    HitCallback hitCallback(int worker);
+    void beginChunks(qulonglong first, qulonglong end);
+    void endChunk(int worker, qulonglong chunk);
+    void endWorkers();
+    void clear();
+
+    // while bound
+    const QuadtreeGrid& getGrid(int n) const {return *m_targets[n].grid;}
+    // W/m2 per cell of getGrid(n).getCells()
+    std::vector<double> getFlux(int n, double powerPerRay) const;
+    // W/m2 averaged over the cells of a uniform grid over the box, row-major
+    // with rows along u
+    std::vector<double> getUniformFlux(int n, double powerPerRay, int rows, int cols) const;
+
+private:
+    struct TargetData
+    {
+        Target target;
+        InstanceNode* surface = nullptr; // valid while bound
+        ShapeRT* shape = nullptr;
+        Transform toWorld;
+        Transform toObject;
+        std::unique_ptr<QuadtreeGrid> grid;
+    };
+
+    void addHit(int worker, const RayTracerHit& hit) const;
+
+    std::vector<TargetData> m_targets;
+};
@@ -0,0 +1,202 @@
+#include "AimImages.h"
+
+#include <Inventor/nodes/SoGroup.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "kernel/node/TonatiuhFunctions.h"
+#include "kernel/profiles/ProfileRT.h"
+#include "kernel/run/InstanceNode.h"
+#include "kernel/run/RayTracer.h"
+#include "kernel/scene/TSeparatorKit.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/ShapeRT.h"
+#include "kernel/trackers/TrackerKit.h"
+#include "kernel/trackers/TrackerTarget.h"
+
+
+namespace {
+
+// the enabled tracker moving a separator, null for none
+TrackerKit* findTracker(InstanceNode* instance)
+{
+    TSeparatorKit* kit = dynamic_cast<TSeparatorKit*>(instance->getNode());
+    SoGroup* group = kit ? (SoGroup*) kit->getPart("group", false) : 0;
+    for (int n = 0; group && n < group->getNumChildren(); ++n) {
+        TrackerKit* tracker = dynamic_cast<TrackerKit*>(group->getChild(n));
+        if (tracker && tracker->enabled.getValue())
+            return tracker;
+    }
+    return 0;
+}
+
+bool isShape(InstanceNode* instance)
+{
+    SoNode* node = instance->getNode();
+    return node && node->getTypeId().isDerivedFrom(TShapeKit::getClassTypeId());
+}
+
+}
+
+
+AimImages::AimImages()
+{
+
+}
+
+AimImages::~AimImages()
+{
+
+}
+
+void AimImages::setTarget(const QString& url, bool isFront, int rows, int cols, const Box2D& window)
+{
+    m_url = url;
+    m_isFront = isFront;
+    m_rows = qMax(1, rows);
+    m_cols = qMax(1, cols);
+    m_window = window;
+}
+
+/*!
+ * Numbers the heliostats of the tree of \a root, which must be updated,
+ * the outermost separator with a tracker on each path counting.
+ */
+bool AimImages::bind(InstanceNode* root, QString* error)
+{
+    m_surface = nullptr;
+    m_heliostatOf.clear();
+    m_heliostats.clear();
+    m_aimed.clear();
+    m_aims.clear();
+
+    // depth first, with the heliostat of the path
+    std::vector<std::pair<InstanceNode*, int>> stack;
+    if (root)
+        stack.emplace_back(root, -1);
+    while (!stack.empty())
+    {
+        InstanceNode* instance = stack.back().first;
+        int heliostat = stack.back().second;
+        stack.pop_back();
+
+        if (isShape(instance)) {
+            if (instance->getURL() == m_url && !m_surface)
+                m_surface = instance;
+            else if (heliostat >= 0)
+                m_heliostatOf.insert(instance, heliostat);
+            continue;
+        }
+        if (heliostat < 0) {
+            if (TrackerKit* tracker = findTracker(instance)) {
+                heliostat = m_heliostats.size();
+                m_heliostats << instance->getURL();
+                TrackerTarget* target = (TrackerTarget*) tracker->target.getValue();
+                const bool global = target && target->aimingType.getValue() == TrackerTarget::global;
+                m_aimed.push_back(global);
+                m_aims.push_back(global ? tgf::makeVector3D(target->aimingPoint.getValue()) : vec3d());
+            }
+        }
+        for (int n = instance->children.size() - 1; n >= 0; --n)
+            stack.emplace_back(instance->children[n], heliostat);
+    }
+
+    if (!m_surface) {
+        if (error) *error = QString("Aim image target %1 was not found.").arg(m_url);
+        return false;
+    }
+    TShapeKit* kit = static_cast<TShapeKit*>(m_surface->getNode());
+    m_shape = static_cast<ShapeRT*>(kit->shapeRT.getValue());
+    ProfileRT* profile = static_cast<ProfileRT*>(kit->profileRT.getValue());
+    if (!m_shape || !profile) {
+        if (error) *error = QString("Aim image target %1 has no shape or profile.").arg(m_url);
+        return false;
+    }
+    if (m_heliostats.isEmpty()) {
+        if (error) *error = "Aim images need heliostats, separators with an enabled tracker.";
+        return false;
+    }
+    m_toWorld = m_surface->getTransform();
+    m_toObject = m_toWorld.inversed();
+    m_box = m_window.isValid() ? m_window : profile->getBox();
+    return true;
+}
+
+void AimImages::beginWorkers(int workers)
+{
+    m_workers.clear();
+    for (int w = 0; w < qMax(1, workers); ++w)
+        m_workers.emplace_back(new Cells);
+}
+
+AimImages::HitCallback AimImages::hitCallback(int worker)
+{
+    Cells* cells = m_workers[worker].get();
+    return [this, cells](const RayTracerHit& hit) {
+        addHit(*cells, hit);
+    };
+}
+
+void AimImages::addHit(Cells& cells, const RayTracerHit& hit) const
+{
+    if (!hit.reflector || hit.surface != m_surface || hit.isFront != m_isFront) return;
+    const auto found = m_heliostatOf.constFind(hit.reflector);
+    if (found == m_heliostatOf.constEnd()) return;
+
+    const vec2d q = (findUV(hit.position) - m_box.min())/m_box.size();
+    int r = int(std::floor(q.x*m_rows));
+    int c = int(std::floor(q.y*m_cols));
+    if (r == m_rows) r--;
+    if (c == m_cols) c--;
+    if (r < 0 || r >= m_rows || c < 0 || c >= m_cols) return;
+    cells[quint64(found.value()) << 32 | quint64(r*m_cols + c)] += hit.weight;
+}
+
+void AimImages::endWorkers()
+{
+    for (const std::unique_ptr<Cells>& worker : m_workers)
+        for (const auto& cell : *worker)
+            m_totals[cell.first] += cell.second;
+    m_workers.clear();
+}
+
+void AimImages::clear()
+{
+    m_totals.clear();
+}
+
+vec2d AimImages::findUV(const vec3d& point) const
+{
+    return m_shape->getUV(m_toObject.transformPoint(point));
+}
+
+AimKernels AimImages::makeKernels(double powerPerRay) const
+{
+    AimKernels ans(m_box, m_rows, m_cols);
+    const vec2d step(m_box.size().x/m_rows, m_box.size().y/m_cols);
+    std::vector<double> areas(size_t(m_rows)*m_cols, 0.);
+    for (int r = 0; r < m_rows; ++r)
+        for (int c = 0; c < m_cols; ++c) {
+            const vec2d a = m_box.min() + vec2d(r*step.x, c*step.y);
+            areas[size_t(r)*m_cols + c] = m_shape->findArea(a.x, a.y, a.x + step.x, a.y + step.y, m_toWorld);
+        }
+    ans.setAreas(areas);
+
+    // the cells sorted by heliostat, filled in one grid at a time
+    std::vector<std::pair<quint64, double>> cells(m_totals.begin(), m_totals.end());
+    std::sort(cells.begin(), cells.end());
+    std::vector<double> power(areas.size(), 0.);
+    size_t k = 0;
+    for (int h = 0; h < m_heliostats.size(); ++h)
+    {
+        const size_t first = k;
+        for (; k < cells.size() && int(cells[k].first >> 32) == h; ++k)
+            power[cells[k].first & 0xffffffffu] = cells[k].second*powerPerRay;
+        const bool aimed = m_aimed[h];
+        ans.addKernel(m_heliostats[h], aimed, aimed ? findUV(m_aims[h]) : vec2d(), power);
+        for (size_t n = first; n < k; ++n)
+            power[cells[n].first & 0xffffffffu] = 0.;
+    }
+    return ans;
+}
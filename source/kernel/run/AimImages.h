@@ -0,0 +1,86 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include "kernel/run/AimKernels.h"
+#include "libraries/math/3D/Transform.h"
+
+class InstanceNode;
+class ShapeRT;
+struct RayTracerHit;
+
+
+//! AimImages traces the flux image of every heliostat on a receiver, to make AimKernels.
+/*!
+ * A heliostat is a separator holding an enabled TrackerKit, with the
+ * surfaces under it; bind() numbers them in tree order. A hit on the target,
+ * one side of a surface, of a ray that reflected off a heliostat first adds
+ * its weight to the cell of a uniform (u, v) grid of that heliostat, so one
+ * trace gives the images of all of them, which makeKernels() turns into
+ * AimKernels with the aim points of their trackers.
+ *
+ * Every worker sums its own cells through hitCallback(worker) and
+ * endWorkers() adds them to the totals in worker order, as
+ * ReflectorAttribution does; whole weights are exact in any order.
+ */
+class TONATIUH_KERNEL AimImages
+{
+public:
+    using HitCallback = std::function<void(const RayTracerHit&)>;
+
+    AimImages();
+    ~AimImages();
+
+    // before the first bind; rows along u, cols along v over the window, or
+    // the box of the profile if it is invalid
+    void setTarget(const QString& url, bool isFront, int rows, int cols, const Box2D& window = Box2D());
+
+    bool bind(InstanceNode* root, QString* error = nullptr);
+    int getHeliostatCount() const {return m_heliostats.size();}
+    const QString& getHeliostat(int n) const {return m_heliostats[n];}
+
+    void beginWorkers(int workers);
+    HitCallback hitCallback(int worker);
+    void endWorkers();
+    void clear();
+
+    // while bound: the (u, v) of the target at a point, in world frame
+    vec2d findUV(const vec3d& point) const;
+    // the images of the heliostats in W with powerPerRay, heliostats aimed
+    // at global points being aimed on the target
+    AimKernels makeKernels(double powerPerRay) const;
+
+private:
+    using Cells = std::unordered_map<quint64, double>; // heliostat << 32 | cell
+
+    void addHit(Cells& cells, const RayTracerHit& hit) const;
+
+    QString m_url;
+    bool m_isFront = true;
+    int m_rows = 1;
+    int m_cols = 1;
+    Box2D m_window;
+
+    // valid while bound
+    InstanceNode* m_surface = nullptr;
+    ShapeRT* m_shape = nullptr;
+    Transform m_toWorld;
+    Transform m_toObject;
+    Box2D m_box;
+    QHash<InstanceNode*, int> m_heliostatOf; // by surface
+    std::vector<bool> m_aimed;
+    std::vector<vec3d> m_aims; // world frame
+
+    QStringList m_heliostats;
+    Cells m_totals;
+    std::vector<std::unique_ptr<Cells>> m_workers;
+};
@@ -0,0 +1,339 @@
+#include "AimKernels.h"
+
+#include <cmath>
+#include <cstring>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+
+
+namespace {
+
+bool fail(QString* error, const QString& message)
+{
+    if (error) *error = message;
+    return false;
+}
+
+/*
+ * Files start with a header of
+ *   "TNAIMKRN", uint32 version, int32 rows, int32 cols, uint32 kernels,
+ *   float64 box min u, min v, max u, max v, sun azimuth, sun elevation,
+ *   uint64 areas, followed by that many float64 areas,
+ * and hold each kernel as
+ *   uint32 name bytes, the UTF-8 name, uint32 aimed, float64 aim u, aim v,
+ *   int32 row, col, rows, cols, followed by rows*cols float64 powers,
+ * all little-endian.
+ */
+const char Magic[] = "TNAIMKRN";
+const quint32 Version = 1;
+
+template<class T>
+void put(QByteArray& out, T value)
+{
+    const T bits = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+}
+
+void putDouble(QByteArray& out, double value)
+{
+    quint64 bits = 0;
+    std::memcpy(&bits, &value, sizeof(value));
+    put<quint64>(out, bits);
+}
+
+// reads the fields in order, each false once the data is short
+class Reader
+{
+public:
+    Reader(const QByteArray& data): m_data(data) {}
+
+    template<class T>
+    bool get(T& value)
+    {
+        if (m_data.size() - m_offset < qsizetype(sizeof(T))) return false;
+        value = qFromLittleEndian<T>(m_data.constData() + m_offset);
+        m_offset += sizeof(T);
+        return true;
+    }
+
+    bool getDouble(double& value)
+    {
+        quint64 bits = 0;
+        if (!get(bits)) return false;
+        std::memcpy(&value, &bits, sizeof(value));
+        return true;
+    }
+
+    bool getDoubles(std::vector<double>& values, quint64 count)
+    {
+        if (quint64(m_data.size() - m_offset)/sizeof(double) < count) return false;
+        values.resize(count);
+        for (double& value : values)
+            getDouble(value);
+        return true;
+    }
+
+    bool getBytes(QByteArray& bytes, quint32 count)
+    {
+        if (quint64(m_data.size() - m_offset) < count) return false;
+        bytes = m_data.mid(m_offset, count);
+        m_offset += count;
+        return true;
+    }
+
+    bool atEnd() const {return m_offset == m_data.size();}
+
+private:
+    const QByteArray& m_data;
+    qsizetype m_offset = 0;
+};
+
+}
+
+
+AimKernels::AimKernels()
+{
+
+}
+
+AimKernels::AimKernels(const Box2D& box, int rows, int cols):
+    m_box(box),
+    m_rows(qMax(1, rows)),
+    m_cols(qMax(1, cols))
+{
+
+}
+
+AimKernels::~AimKernels()
+{
+
+}
+
+void AimKernels::setSun(double azimuth, double elevation)
+{
+    m_sunAzimuth = azimuth;
+    m_sunElevation = elevation;
+}
+
+void AimKernels::addKernel(const QString& name, bool aimed, const vec2d& aim, const std::vector<double>& power)
+{
+    Kernel kernel;
+    kernel.name = name;
+    kernel.aimed = aimed;
+    kernel.aim = aim;
+
+    int r0 = m_rows, r1 = -1, c0 = m_cols, c1 = -1;
+    if (power.size() == size_t(m_rows)*size_t(m_cols)) {
+        for (int r = 0; r < m_rows; ++r)
+            for (int c = 0; c < m_cols; ++c)
+                if (power[size_t(r)*m_cols + c] != 0.) {
+                    r0 = qMin(r0, r);
+                    r1 = qMax(r1, r);
+                    c0 = qMin(c0, c);
+                    c1 = qMax(c1, c);
+                }
+    }
+    if (r1 >= 0) {
+        kernel.row = r0;
+        kernel.col = c0;
+        kernel.rows = r1 - r0 + 1;
+        kernel.cols = c1 - c0 + 1;
+        kernel.power.reserve(size_t(kernel.rows)*kernel.cols);
+        for (int r = r0; r <= r1; ++r)
+            kernel.power.insert(kernel.power.end(), power.begin() + size_t(r)*m_cols + c0, power.begin() + size_t(r)*m_cols + c1 + 1);
+    }
+    m_names.insert(name, int(m_kernels.size()));
+    m_kernels.push_back(std::move(kernel));
+}
+
+int AimKernels::findKernel(const QString& name) const
+{
+    return m_names.value(name, -1);
+}
+
+/*!
+ * A kernel moved by s cells along u and t along v puts each of its cells
+ * on the four cells from (floor(s), floor(t)) on, in the shares of the
+ * fractions of s and t, so a move by whole cells keeps the values.
+ */
+std::vector<double> AimKernels::evaluate(const std::vector<vec2d>& aims, double* spilled) const
+{
+    std::vector<double> ans(size_t(m_rows)*size_t(m_cols), 0.);
+    const vec2d step(m_box.size().x/m_rows, m_box.size().y/m_cols);
+    double lost = 0.;
+    for (size_t n = 0; n < m_kernels.size(); ++n)
+    {
+        const Kernel& kernel = m_kernels[n];
+        if (kernel.power.empty()) continue;
+
+        double s = 0., t = 0.;
+        if (n < aims.size() && kernel.aimed && std::isfinite(aims[n].x) && std::isfinite(aims[n].y)) {
+            s = (aims[n].x - kernel.aim.x)/step.x;
+            t = (aims[n].y - kernel.aim.y)/step.y;
+        }
+        const double rs = std::floor(s);
+        const double ct = std::floor(t);
+        // kernels moved off the grid altogether, or by more than it holds
+        if (std::abs(rs) > m_rows + kernel.rows || std::abs(ct) > m_cols + kernel.cols) {
+            for (double value : kernel.power)
+                lost += value;
+            continue;
+        }
+        const int dr = int(rs);
+        const int dc = int(ct);
+        const double fs = s - rs;
+        const double ft = t - ct;
+        const double weights[4] = {(1. - fs)*(1. - ft), (1. - fs)*ft, fs*(1. - ft), fs*ft};
+
+        for (int r = 0; r < kernel.rows; ++r) {
+            const double* values = kernel.power.data() + size_t(r)*kernel.cols;
+            for (int k = 0; k < 4; ++k) {
+                if (weights[k] == 0.) continue;
+                const int row = kernel.row + r + dr + (k >> 1);
+                if (row < 0 || row >= m_rows) {
+                    for (int c = 0; c < kernel.cols; ++c)
+                        lost += weights[k]*values[c];
+                    continue;
+                }
+                double* out = ans.data() + size_t(row)*m_cols;
+                const int col0 = kernel.col + dc + (k & 1);
+                for (int c = 0; c < kernel.cols; ++c) {
+                    const int col = col0 + c;
+                    if (col >= 0 && col < m_cols)
+                        out[col] += weights[k]*values[c];
+                    else
+                        lost += weights[k]*values[c];
+                }
+            }
+        }
+    }
+    if (spilled) *spilled = lost;
+    return ans;
+}
+
+std::vector<double> AimKernels::findFlux(const std::vector<double>& power) const
+{
+    std::vector<double> ans(power.size(), 0.);
+    if (m_areas.size() != power.size()) return ans;
+    for (size_t n = 0; n < power.size(); ++n)
+        if (m_areas[n] > 0.)
+            ans[n] = power[n]/m_areas[n];
+    return ans;
+}
+
+QByteArray AimKernels::toBytes() const
+{
+    QByteArray ans(Magic, 8);
+    put<quint32>(ans, Version);
+    put<qint32>(ans, m_rows);
+    put<qint32>(ans, m_cols);
+    put<quint32>(ans, quint32(m_kernels.size()));
+    for (double value : {m_box.min().x, m_box.min().y, m_box.max().x, m_box.max().y, m_sunAzimuth, m_sunElevation})
+        putDouble(ans, value);
+    put<quint64>(ans, quint64(m_areas.size()));
+    for (double area : m_areas)
+        putDouble(ans, area);
+
+    for (const Kernel& kernel : m_kernels)
+    {
+        const QByteArray name = kernel.name.toUtf8();
+        put<quint32>(ans, quint32(name.size()));
+        ans.append(name);
+        put<quint32>(ans, kernel.aimed ? 1 : 0);
+        putDouble(ans, kernel.aim.x);
+        putDouble(ans, kernel.aim.y);
+        for (int value : {kernel.row, kernel.col, kernel.rows, kernel.cols})
+            put<qint32>(ans, value);
+        for (double value : kernel.power)
+            putDouble(ans, value);
+    }
+    return ans;
+}
+
+bool AimKernels::fromBytes(const QByteArray& data, QString* error)
+{
+    Reader reader(data);
+    QByteArray magic;
+    quint32 version = 0, count = 0;
+    qint32 rows = 0, cols = 0;
+    if (!reader.getBytes(magic, 8) || magic != QByteArray(Magic, 8) || !reader.get(version) || version != Version)
+        return fail(error, QString("Not an aim kernel file of version %1.").arg(Version));
+
+    double box[6];
+    quint64 areaCount = 0;
+    std::vector<double> areas;
+    bool valid = reader.get(rows) && reader.get(cols) && reader.get(count) && rows > 0 && cols > 0;
+    for (double& value : box)
+        valid = valid && reader.getDouble(value);
+    valid = valid && reader.get(areaCount) && (areaCount == 0 || areaCount == quint64(rows)*quint64(cols)) &&
+        reader.getDoubles(areas, areaCount);
+    if (!valid)
+        return fail(error, "The aim kernel file has a damaged header.");
+
+    std::vector<Kernel> kernels(count);
+    for (Kernel& kernel : kernels)
+    {
+        quint32 nameSize = 0, aimed = 0;
+        QByteArray name;
+        qint32 window[4];
+        valid = reader.get(nameSize) && reader.getBytes(name, nameSize) && reader.get(aimed) &&
+            reader.getDouble(kernel.aim.x) && reader.getDouble(kernel.aim.y);
+        for (qint32& value : window)
+            valid = valid && reader.get(value);
+        valid = valid && window[0] >= 0 && window[1] >= 0 && window[2] >= 0 && window[3] >= 0 &&
+            window[0] + window[2] <= rows && window[1] + window[3] <= cols &&
+            reader.getDoubles(kernel.power, quint64(window[2])*quint64(window[3]));
+        if (!valid)
+            return fail(error, "The aim kernel file has a damaged kernel.");
+        kernel.name = QString::fromUtf8(name);
+        kernel.aimed = aimed != 0;
+        kernel.row = window[0];
+        kernel.col = window[1];
+        kernel.rows = window[2];
+        kernel.cols = window[3];
+    }
+    if (!reader.atEnd())
+        return fail(error, "The aim kernel file has data past its kernels.");
+
+    m_box = Box2D(vec2d(box[0], box[1]), vec2d(box[2], box[3]));
+    m_rows = rows;
+    m_cols = cols;
+    m_sunAzimuth = box[4];
+    m_sunElevation = box[5];
+    m_areas.swap(areas);
+    m_kernels.swap(kernels);
+    m_names.clear();
+    for (size_t n = 0; n < m_kernels.size(); ++n)
+        m_names.insert(m_kernels[n].name, int(n));
+    return true;
+}
+
+bool AimKernels::write(const QString& fileName, QString* error) const
+{
+    QFileInfo info(fileName);
+    if (!QDir().mkpath(info.absolutePath()))
+        return fail(error, QString("Cannot create output directory %1.").arg(info.absolutePath()));
+
+    const QByteArray data = toBytes();
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(error, QString("Cannot open aim kernel file %1: %2").arg(fileName, file.errorString()));
+    if (file.write(data) != data.size() || !file.commit())
+        return fail(error, QString("Cannot write aim kernel file %1: %2").arg(fileName, file.errorString()));
+    return true;
+}
+
+bool AimKernels::read(const QString& fileName, QString* error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(error, QString("Cannot open aim kernel file %1: %2").arg(fileName, file.errorString()));
+    QString message;
+    if (!fromBytes(file.readAll(), &message))
+        return fail(error, QString("%1: %2").arg(fileName, message));
+    return true;
+}
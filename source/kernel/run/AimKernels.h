@@ -0,0 +1,93 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <limits>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include "libraries/math/2D/Box2D.h"
+
+
+//! AimKernels holds the flux images of heliostats on a receiver and sums them for other aim points.
+/*!
+ * A kernel is the power one heliostat puts on the cells of a uniform grid
+ * over a (u, v) box of the receiver, traced once with its tracker aimed at
+ * a point of the receiver, and kept as the window of the grid its image
+ * covers. Aiming the heliostat at another point of the receiver moves its
+ * image there, so the flux of any assignment of aim points is the sum of
+ * the kernels moved by the change of their aim points, without tracing:
+ * each kernel is split by the fractions of cells it moves over the four
+ * cells it lands on. The shape of an image is taken not to change with its
+ * aim point, which holds for moves small next to the distance to the
+ * heliostat; power moved off the grid is spilled.
+ *
+ * Kernels are those of one sun and are written with it, so a file of them
+ * serves optimizers for that sun.
+ */
+class TONATIUH_KERNEL AimKernels
+{
+public:
+    struct Kernel
+    {
+        QString name; // URL of the heliostat
+        bool aimed = false; // false if the aim point is not on the receiver, the kernel does not move
+        vec2d aim; // (u, v) of the aim point the kernel was traced for
+        int row = 0; // first cell of the window in the grid
+        int col = 0;
+        int rows = 0;
+        int cols = 0;
+        std::vector<double> power; // W per cell of the window, row-major
+    };
+
+    AimKernels();
+    AimKernels(const Box2D& box, int rows, int cols);
+    ~AimKernels();
+
+    // rows along u, cols along v
+    const Box2D& getBox() const {return m_box;}
+    int getRows() const {return m_rows;}
+    int getCols() const {return m_cols;}
+
+    // m2 of each cell on the surface, row-major
+    void setAreas(const std::vector<double>& areas) {m_areas = areas;}
+    const std::vector<double>& getAreas() const {return m_areas;}
+
+    // degrees, NaN for the sun of the scene
+    void setSun(double azimuth, double elevation);
+    double getSunAzimuth() const {return m_sunAzimuth;}
+    double getSunElevation() const {return m_sunElevation;}
+
+    // power is rows by cols W per cell; the window drops the cells without power
+    void addKernel(const QString& name, bool aimed, const vec2d& aim, const std::vector<double>& power);
+    int getKernelCount() const {return int(m_kernels.size());}
+    const Kernel& getKernel(int n) const {return m_kernels[n];}
+    // -1 for none
+    int findKernel(const QString& name) const;
+
+    // W per cell, row-major, of every kernel moved from its aim to aims[n];
+    // kernels past the aims given, not aimed or with a NaN aim stay, and
+    // spilled, if given, gets the power moved off the grid
+    std::vector<double> evaluate(const std::vector<vec2d>& aims, double* spilled = nullptr) const;
+    // W/m2 per cell of the power per cell of evaluate
+    std::vector<double> findFlux(const std::vector<double>& power) const;
+
+    // the little-endian file format, see AimKernels.cpp
+    QByteArray toBytes() const;
+    bool fromBytes(const QByteArray& data, QString* error = nullptr);
+    bool write(const QString& fileName, QString* error = nullptr) const;
+    bool read(const QString& fileName, QString* error = nullptr);
+
+private:
+    Box2D m_box;
+    int m_rows = 0;
+    int m_cols = 0;
+    std::vector<double> m_areas;
+    double m_sunAzimuth = std::numeric_limits<double>::quiet_NaN();
+    double m_sunElevation = std::numeric_limits<double>::quiet_NaN();
+    std::vector<Kernel> m_kernels;
+    QHash<QString, int> m_names;
+};
@@ -0,0 +1,126 @@
+#include "BackwardTracer.h"
+
+#include <cmath>
+
+#include "kernel/air/AirTransmission.h"
+#include "kernel/material/MaterialRT.h"
+#include "kernel/profiles/ProfileRT.h"
+#include "kernel/random/Random.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/ShapeRT.h"
+#include "kernel/sun/SunShape.h"
+#include "libraries/math/3D/Ray.h"
+#include "libraries/math/gcf.h"
+
+namespace
+{
+// steps of the sunshape integral over the sun disk
+const int ShapeSteps = 2000;
+}
+
+
+BackwardTracer::BackwardTracer(const SceneBVH& scene, const SunShape* sunShape, const vec3d& sunDirection,
+                               double irradiance, const AirTransmission* air):
+    m_scene(scene),
+    m_sunShape(sunShape),
+    m_toSun(-sunDirection.normalized()),
+    m_irradiance(irradiance),
+    m_air(air),
+    m_thetaMax(sunShape->getThetaMax()),
+    m_radianceScale(0.)
+{
+    // integral of shape(theta) over the solid angle, by the midpoint rule
+    double sum = 0.;
+    const double step = m_thetaMax/ShapeSteps;
+    for (int n = 0; n < ShapeSteps; ++n) {
+        double theta = (n + 0.5)*step;
+        sum += sunShape->shape(theta)*sin(theta);
+    }
+    sum *= gcf::TwoPi*step;
+    if (sum > 0.) m_radianceScale = irradiance/sum;
+
+    for (const SceneBVHInstance& leaf : scene.findLeaves()) {
+        if (!leaf.shape || !leaf.profile || !leaf.material) continue;
+        if (leaf.shape->getTriangleCount() > 0) continue;
+        double area = leaf.profile->getBox().area();
+        if (!(area > 0.)) continue;
+        m_leaves.push_back(leaf);
+        m_leafAreas.push_back(area);
+    }
+}
+
+BackwardFlux BackwardTracer::trace(const vec3d& point, const vec3d& normal, ulong samples, Random& rand) const
+{
+    BackwardFlux ans;
+    if (samples == 0) return ans;
+    vec3d n = normal.normalized();
+
+    double cosSun = dot(m_toSun, n);
+    if (cosSun > 0. && !m_scene.occluded(Ray(point, m_toSun)))
+        ans.direct = m_irradiance*cosSun;
+
+    double sum = 0.;
+    double sum2 = 0.;
+    if (!m_leaves.empty()) {
+        for (ulong s = 0; s < samples; ++s) {
+            double f = sample(point, n, rand);
+            sum += f;
+            sum2 += f*f;
+        }
+    }
+
+    double mean = sum/samples;
+    ans.irradiance = ans.direct + mean;
+    if (samples > 1) {
+        double variance = (sum2/samples - mean*mean)/(samples - 1);
+        ans.error = variance > 0. ? sqrt(variance) : 0.;
+    }
+    ans.samples = samples;
+    return ans;
+}
+
+double BackwardTracer::sample(const vec3d& point, const vec3d& normal, Random& rand) const
+{
+    const int count = int(m_leaves.size());
+    int index = qMin(int(rand.RandomDouble()*count), count - 1);
+    double a = rand.RandomDouble();
+    double b = rand.RandomDouble();
+
+    const SceneBVHInstance& leaf = m_leaves[index];
+    Box2D box = leaf.profile->getBox();
+    double u = box.min().x + a*box.size().x;
+    double v = box.min().y + b*box.size().y;
+    if (!leaf.profile->isInside(u, v)) return 0.;
+
+    vec3d target = leaf.transform.transformPoint(leaf.shape->getPoint(u, v));
+    vec3d du = leaf.transform.transformVector(leaf.shape->getDerivativeU(u, v));
+    vec3d dv = leaf.transform.transformVector(leaf.shape->getDerivativeV(u, v));
+    double jacobian = cross(du, dv).norm();
+
+    vec3d delta = target - point;
+    double distance = delta.norm();
+    if (!(distance > 0.)) return 0.;
+    vec3d direction = delta/distance;
+    double cosPoint = dot(direction, normal);
+    if (cosPoint <= 0.) return 0.;
+
+    // the point picked must be the first one seen
+    Ray ray(point, direction);
+    SceneBVHHit hit;
+    if (!m_scene.findHit(ray, hit)) return 0.;
+    if ((hit.dg.point - target).norm() > 1e-6*(1. + distance)) return 0.;
+    double cosTarget = std::abs(dot(direction, hit.dg.normal));
+
+    Ray reflected;
+    double weight = 1.;
+    if (!hit.leaf->material->OutputRayWeighted(ray, hit.dg, rand, reflected, weight)) return 0.;
+    vec3d toSun = reflected.direction().normalized();
+    double theta = acos(qBound(-1., dot(toSun, m_toSun), 1.));
+    if (theta > m_thetaMax) return 0.;
+    double radiance = m_radianceScale*m_sunShape->shape(theta);
+    if (radiance <= 0.) return 0.;
+    if (m_scene.occluded(Ray(reflected.origin, toSun))) return 0.;
+
+    if (m_air) weight *= m_air->transmission(distance);
+    return weight*radiance*cosPoint*cosTarget*jacobian*m_leafAreas[index]*count/(distance*distance);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include "kernel/run/SceneBVH.h"
+#include "libraries/math/3D/vec3d.h"
+
+class AirTransmission;
+class Random;
+class SunShape;
+
+//! BackwardFlux is the irradiance at one point estimated by BackwardTracer.
+struct TONATIUH_KERNEL BackwardFlux
+{
+    double irradiance = 0.; // in W/m2
+    double error = 0.;      // standard error of irradiance
+    double direct = 0.;     // of irradiance, straight from the sun
+    ulong samples = 0;
+};
+
+//! BackwardTracer estimates the flux at a point by tracing from it to the sun.
+/*!
+ * Each sample picks a leaf of the scene uniformly and a point of it uniformly
+ * in the box of its profile, and traces from the query point towards it
+ * through the scene. If that point is hit first, its material reflects the
+ * ray, and the sunshape gives the radiance arriving along the reflected ray
+ * when nothing shades it. The sample is that radiance over the solid angle
+ * of the area picked, so the mean is the irradiance reflected once onto the
+ * point, and its spread gives the error without tracing the whole field.
+ *
+ * The radiance is SunShape::shape of the angle to the sun, normalized over
+ * the sun disk to irradiance. The direct sun is added when the point sees it.
+ * Air, if given, attenuates the path from the reflection to the point.
+ *
+ * Rays reflected more than once and leaves of triangle meshes, which have no
+ * parametrization to pick points by, are not sampled. The scene is expected
+ * to leave out the surface of the query point, as receiver traces do.
+ *
+ * trace() is const and draws from the generator given only, so several
+ * points can be traced in parallel with a generator each.
+ */
+class TONATIUH_KERNEL BackwardTracer
+{
+public:
+    // sunDirection is the direction the sun rays travel in, in world frame
+    BackwardTracer(const SceneBVH& scene, const SunShape* sunShape, const vec3d& sunDirection,
+                   double irradiance, const AirTransmission* air = nullptr);
+
+    int leafCount() const {return int(m_leaves.size());}
+
+    BackwardFlux trace(const vec3d& point, const vec3d& normal, ulong samples, Random& rand) const;
+
+private:
+    // one sample of the flux reflected by the scene onto the point
+    double sample(const vec3d& point, const vec3d& normal, Random& rand) const;
+
+    const SceneBVH& m_scene;
+    const SunShape* m_sunShape;
+    vec3d m_toSun;
+    double m_irradiance;
+    const AirTransmission* m_air;
+    double m_thetaMax;
+    double m_radianceScale; // irradiance over the integral of the sunshape
+    std::vector<SceneBVHInstance> m_leaves;
+    std::vector<double> m_leafAreas; // of the profile boxes in uv
+};
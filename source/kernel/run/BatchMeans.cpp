@@ -0,0 +1,60 @@
+#include "BatchMeans.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const double Infinity = std::numeric_limits<double>::infinity();
+
+} // namespace
+
+
+void BatchMeans::begin(const std::vector<double>& totals)
+{
+    m_last = totals;
+    m_means.assign(totals.size(), 0.);
+    m_deviations.assign(totals.size(), 0.);
+    m_rounds = 0;
+}
+
+// Welford's update, the batches differ little from their mean
+void BatchMeans::addRound(const std::vector<double>& totals)
+{
+    ++m_rounds;
+    for (std::size_t n = 0; n < totals.size(); ++n) {
+        const double batch = totals[n] - m_last[n];
+        const double delta = batch - m_means[n];
+        m_means[n] += delta/m_rounds;
+        m_deviations[n] += delta*(batch - m_means[n]);
+    }
+    m_last = totals;
+}
+
+double BatchMeans::getMean(int cell) const
+{
+    return m_means[cell];
+}
+
+double BatchMeans::getRelativeError(int cell) const
+{
+    const double mean = m_means[cell];
+    if (m_rounds < 2 || !(mean > 0.)) return Infinity;
+    const double variance = m_deviations[cell]/(m_rounds - 1);
+    return std::sqrt(variance/m_rounds)/mean;
+}
+
+double BatchMeans::getMaxRelativeError(double fraction) const
+{
+    double peak = 0.;
+    for (double mean : m_means)
+        peak = std::max(peak, mean);
+    if (!(peak > 0.)) return Infinity;
+
+    double ans = 0.;
+    for (int n = 0; n < getCells(); ++n)
+        if (m_means[n] >= fraction*peak && m_means[n] > 0.)
+            ans = std::max(ans, getRelativeError(n));
+    return ans;
+}
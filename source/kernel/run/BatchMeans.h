@@ -0,0 +1,41 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+
+//! BatchMeans estimates the standard error of per-cell totals from batches.
+/*!
+ * A trace in rounds of equal ray counts gives one batch per round. The
+ * totals of the cells are given after every round, cumulative as in a flux
+ * grid, and the batch of a cell is its change since the round before; the
+ * relative standard error of a cell is that of the mean of its batches.
+ *
+ * The error of a trace is the largest over the cells whose mean reaches a
+ * fraction of the peak mean, so dim cells with few hits do not hold it up.
+ */
+class TONATIUH_KERNEL BatchMeans
+{
+public:
+    // cumulative totals before the first round
+    void begin(const std::vector<double>& totals);
+    // cumulative totals after a round, of the cells given to begin
+    void addRound(const std::vector<double>& totals);
+
+    int getRounds() const {return m_rounds;}
+    int getCells() const {return int(m_means.size());}
+    double getMean(int cell) const;
+    // standard error of the mean over its mean, infinite without two rounds
+    // or with a mean of zero
+    double getRelativeError(int cell) const;
+    // over the cells with a mean of at least fraction times the peak,
+    // infinite if no cell has a positive mean
+    double getMaxRelativeError(double fraction) const;
+
+private:
+    std::vector<double> m_last;
+    std::vector<double> m_means;
+    std::vector<double> m_deviations; // sums of squared deviations from the mean
+    int m_rounds = 0;
+};
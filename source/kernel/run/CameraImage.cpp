@@ -0,0 +1,198 @@
+#include "CameraImage.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "kernel/run/InstanceNode.h"
+#include "kernel/run/RayTracer.h"
+#include "kernel/scene/TCameraKit.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/ShapeRT.h"
+#include "libraries/math/gcf.h"
+
+
+namespace {
+
+// units of pixel sums
+const double PixelScale = 4294967296.; // 2^32
+
+InstanceNode* findShape(InstanceNode* instance, const QString& url)
+{
+    SoNode* node = instance->getNode();
+    if (node && node->getTypeId().isDerivedFrom(TShapeKit::getClassTypeId()))
+        return instance->getURL() == url ? instance : 0;
+
+    for (InstanceNode* child : instance->children)
+        if (InstanceNode* ans = findShape(child, url))
+            return ans;
+    return 0;
+}
+
+}
+
+
+CameraImage::Camera CameraImage::findCamera(TCameraKit* kit)
+{
+    Camera ans;
+    const SbVec3f position = kit->position.getValue();
+    ans.position = vec3d(position[0], position[1], position[2]);
+    ans.azimuth = kit->rotation.getValue()[0];
+    ans.elevation = kit->rotation.getValue()[1];
+    ans.angle = kit->angle.getValue();
+    return ans;
+}
+
+/*!
+ * The frame is that of TPerspectiveCamera::updateTransform: the camera
+ * looks along the direction of azimuth and elevation, with x to the right
+ * and the up vector in the vertical plane of the view.
+ */
+CameraImage::CameraImage(const Camera& camera, int width, int height):
+    m_camera(camera),
+    m_width(width),
+    m_height(height)
+{
+    const double azimuth = camera.azimuth*gcf::degree;
+    const double elevation = camera.elevation*gcf::degree;
+    m_forward = vec3d::directionAE(azimuth, elevation);
+    m_right = vec3d(std::cos(azimuth), -std::sin(azimuth), 0.);
+    m_up = cross(m_right, m_forward);
+    m_pixel = height > 0 ? 2.*std::tan(camera.angle*gcf::degree/2.)/height : 0.;
+    m_pixels.assign(size_t(qMax(0, width))*size_t(qMax(0, height)), 0);
+}
+
+CameraImage::~CameraImage()
+{
+
+}
+
+// before the first bind
+void CameraImage::addTarget(const QString& url)
+{
+    m_targets << url;
+    m_targetData.push_back(TargetData());
+}
+
+/*!
+ * Finds the targets in the tree of \a root, which must be updated. The
+ * first bind takes the distance from the camera to the origin of the first
+ * target as the reference of the pixel sums.
+ */
+bool CameraImage::bind(InstanceNode* root, QString* error)
+{
+    if (m_width <= 0 || m_height <= 0 || !(m_camera.angle > 0.) || !(m_camera.angle < 180.)) {
+        if (error) *error = "Camera images need a positive size and a field of view between 0 and 180 degrees.";
+        return false;
+    }
+
+    for (int t = 0; t < m_targets.size(); ++t)
+    {
+        TargetData& data = m_targetData[t];
+        data.surface = root ? findShape(root, m_targets[t]) : 0;
+        if (!data.surface) {
+            if (error) *error = QString("Camera image target %1 was not found.").arg(m_targets[t]);
+            return false;
+        }
+        TShapeKit* kit = static_cast<TShapeKit*>(data.surface->getNode());
+        data.shape = static_cast<ShapeRT*>(kit->shapeRT.getValue());
+        if (!data.shape) {
+            if (error) *error = QString("Camera image target %1 has no shape.").arg(m_targets[t]);
+            return false;
+        }
+        data.toWorld = data.surface->getTransform();
+        data.toObject = data.toWorld.inversed();
+    }
+
+    if (m_reference <= 0. && !m_targetData.empty())
+        m_reference = (m_targetData[0].toWorld.transformPoint(vec3d(0., 0., 0.)) - m_camera.position).norm();
+    if (m_reference <= 0.)
+        m_reference = 1.;
+    return true;
+}
+
+void CameraImage::beginWorkers(int workers)
+{
+    m_workers.clear();
+    for (int w = 0; w < qMax(1, workers); ++w)
+    {
+        std::unique_ptr<Worker> worker(new Worker);
+        worker->pixels.assign(m_pixels.size(), 0);
+        m_workers.push_back(std::move(worker));
+    }
+}
+
+CameraImage::HitCallback CameraImage::hitCallback(int worker)
+{
+    Worker* w = m_workers[worker].get();
+    return [this, w](const RayTracerHit& hit) {
+        addHit(*w, hit);
+    };
+}
+
+/*!
+ * A pixel of side s at unit distance sees the solid angle s^2 (z/d)^3 at
+ * depth z and distance d, and on a surface tilted by theta from the view
+ * the area of that solid angle times d^2/cos(theta), whose inverse, times
+ * the weight, is what the hit adds to the irradiance.
+ */
+void CameraImage::addHit(Worker& worker, const RayTracerHit& hit) const
+{
+    for (const TargetData& data : m_targetData)
+    {
+        if (hit.surface != data.surface) continue;
+
+        const vec3d p = hit.position - m_camera.position;
+        const double z = dot(p, m_forward);
+        if (z <= 0.) return;
+        const double col = m_width/2. + dot(p, m_right)/(z*m_pixel);
+        const double row = m_height/2. - dot(p, m_up)/(z*m_pixel);
+        if (!(col >= 0. && col < m_width && row >= 0. && row < m_height)) return;
+
+        const vec2d uv = data.shape->getUV(data.toObject.transformPoint(hit.position));
+        vec3d normal = data.toWorld.transformNormal(data.shape->getNormal(uv.x, uv.y)).normalized();
+        if (!hit.isFront) normal = -normal;
+        const double d = p.norm();
+        const double cosTheta = -dot(normal, p)/d;
+        if (cosTheta <= 0.) return;
+
+        const double irradiance = hit.weight*cosTheta*d/(z*z*z)*m_reference*m_reference;
+        const size_t index = size_t(row)*m_width + size_t(col);
+        worker.pixels[index] += quint64(std::llround(irradiance*PixelScale));
+        worker.hits++;
+        return;
+    }
+}
+
+void CameraImage::endWorkers()
+{
+    for (const std::unique_ptr<Worker>& worker : m_workers)
+    {
+        for (size_t n = 0; n < m_pixels.size(); ++n)
+            m_pixels[n] += worker->pixels[n];
+        m_hits += worker->hits;
+    }
+    m_workers.clear();
+}
+
+qulonglong CameraImage::getMemoryUsage() const
+{
+    qulonglong ans = qulonglong(m_pixels.capacity())*sizeof(quint64);
+    for (const std::unique_ptr<Worker>& worker : m_workers)
+        ans += qulonglong(worker->pixels.capacity())*sizeof(quint64);
+    return ans;
+}
+
+void CameraImage::clear()
+{
+    std::fill(m_pixels.begin(), m_pixels.end(), 0);
+    m_hits = 0;
+}
+
+std::vector<double> CameraImage::getIrradiance(double powerPerRay) const
+{
+    const double unit = powerPerRay/(PixelScale*m_pixel*m_pixel*m_reference*m_reference);
+    std::vector<double> ans(m_pixels.size());
+    for (size_t n = 0; n < m_pixels.size(); ++n)
+        ans[n] = double(m_pixels[n])*unit;
+    return ans;
+}
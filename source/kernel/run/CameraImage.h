@@ -0,0 +1,109 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+#include "libraries/math/3D/Transform.h"
+
+class InstanceNode;
+class ShapeRT;
+class TCameraKit;
+struct RayTracerHit;
+
+
+//! CameraImage renders the irradiance of Lambertian targets as a camera sees it.
+/*!
+ * The camera is a pinhole with square pixels, placed and aimed as a
+ * TCameraKit of the scene. Every hit on a target, on a side facing the
+ * camera, is splatted into the pixel its position projects to, with its
+ * power over the area that pixel sees on the surface there, so a pixel
+ * holds the irradiance of the surface it sees, in W/m2. A Lambertian target
+ * of reflectance rho has the radiance rho E/pi, to which a CCD image of it
+ * is proportional, without exporting photons. Hits hidden from the camera
+ * behind other surfaces are not tested and count too.
+ *
+ * Every worker fills its own image through hitCallback(worker) and
+ * endWorkers() adds them to the totals, so several traces in a row
+ * accumulate. Pixels sum integers of 2^-32 of the irradiance of a ray of
+ * weight 1 seen head-on at the reference distance, exact in any order, so
+ * images depend neither on the workers nor on the chunks.
+ */
+class TONATIUH_KERNEL CameraImage
+{
+public:
+    using HitCallback = std::function<void(const RayTracerHit&)>;
+
+    struct Camera
+    {
+        vec3d position;
+        double azimuth = 0.;   // degrees from y toward x, as TCameraKit
+        double elevation = 0.; // degrees
+        double angle = 30.;    // full vertical field of view in degrees
+    };
+
+    // the camera of a scene, perspective or not
+    static Camera findCamera(TCameraKit* kit);
+
+    CameraImage(const Camera& camera, int width, int height);
+    ~CameraImage();
+
+    void addTarget(const QString& url);
+    int getTargetCount() const {return m_targets.size();}
+    const QString& getTarget(int n) const {return m_targets[n];}
+
+    const Camera& getCamera() const {return m_camera;}
+    int getWidth() const {return m_width;}
+    int getHeight() const {return m_height;}
+
+    // false if a target URL does not name a shape or the camera is invalid
+    bool bind(InstanceNode* root, QString* error = nullptr);
+    void beginWorkers(int workers);
+    HitCallback hitCallback(int worker);
+    void endWorkers();
+    void clear();
+    // bytes of the pixels of the image and of the workers
+    qulonglong getMemoryUsage() const;
+
+    // hits splatted into a pixel
+    qulonglong getHits() const {return m_hits;}
+    // W/m2 per pixel, row-major with row 0 at the top of the image
+    std::vector<double> getIrradiance(double powerPerRay) const;
+
+private:
+    struct TargetData
+    {
+        InstanceNode* surface = nullptr; // valid while bound
+        ShapeRT* shape = nullptr;
+        Transform toWorld;
+        Transform toObject;
+    };
+
+    struct Worker
+    {
+        std::vector<quint64> pixels;
+        qulonglong hits = 0;
+    };
+
+    void addHit(Worker& worker, const RayTracerHit& hit) const;
+
+    Camera m_camera;
+    int m_width;
+    int m_height;
+    vec3d m_forward;
+    vec3d m_right;
+    vec3d m_up;
+    double m_pixel; // side of a pixel at unit distance
+    double m_reference = 0.; // distance, set by the first bind
+
+    QStringList m_targets;
+    std::vector<TargetData> m_targetData;
+    std::vector<quint64> m_pixels;
+    qulonglong m_hits = 0;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+};
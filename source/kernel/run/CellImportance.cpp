@@ -0,0 +1,44 @@
+#include "CellImportance.h"
+
+#include <algorithm>
+
+
+CellImportance::CellImportance(int cellCount)
+{
+    setRates(std::vector<double>(std::max(0, cellCount), 0.), 1.);
+}
+
+void CellImportance::setRates(const std::vector<double>& rates, double uniformFraction)
+{
+    const int n = int(rates.size());
+    double sum = 0.;
+    for (double rate : rates)
+        sum += std::max(0., rate);
+    const double uniform = sum > 0. ? std::min(std::max(uniformFraction, 0.), 1.) : 1.;
+
+    m_cumulative.resize(n);
+    m_weights.resize(n);
+    double total = 0.;
+    for (int c = 0; c < n; ++c) {
+        double p = uniform/n;
+        if (sum > 0.) p += (1. - uniform)*std::max(0., rates[c])/sum;
+        total += p;
+        m_cumulative[c] = total;
+        m_weights[c] = 1./(n*p);
+    }
+    // the last end is one, so every u below it finds a cell
+    if (n > 0) m_cumulative.back() = 1.;
+}
+
+double CellImportance::getProbability(int cell) const
+{
+    return cell > 0 ? m_cumulative[cell] - m_cumulative[cell - 1] : m_cumulative[cell];
+}
+
+int CellImportance::sample(double u, double* weight) const
+{
+    int cell = int(std::upper_bound(m_cumulative.begin(), m_cumulative.end(), u) - m_cumulative.begin());
+    cell = std::min(cell, int(m_cumulative.size()) - 1);
+    if (weight) *weight = m_weights[cell];
+    return cell;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+
+//! CellImportance draws sun aperture cells by their share of the flux.
+/*!
+ * A pilot trace gives the rate at which the rays of every cell reach the
+ * targets. Cells are then drawn with probabilities proportional to the
+ * rates, mixed with the uniform draw so that no cell has probability zero,
+ * and a ray from cell c carries the weight 1/(n p_c) of n cells drawn with
+ * probabilities p. The weighted flux has the mean of a uniform trace and
+ * less variance when few cells send rays to the targets.
+ */
+class TONATIUH_KERNEL CellImportance
+{
+public:
+    // uniform over cellCount cells
+    CellImportance(int cellCount = 0);
+
+    // rates of reaching the targets, one per cell and not negative; a
+    // fraction uniformFraction in (0, 1] of the draws stays uniform, all of
+    // them if every rate is zero
+    void setRates(const std::vector<double>& rates, double uniformFraction);
+
+    int getCellCount() const {return int(m_weights.size());}
+    double getProbability(int cell) const;
+    double getWeight(int cell) const {return m_weights[cell];}
+
+    // the cell of u in [0, 1), with the weight of its rays
+    int sample(double u, double* weight) const;
+
+private:
+    std::vector<double> m_cumulative; // upper ends
+    std::vector<double> m_weights;
+};
@@ -0,0 +1,79 @@
+#include "ChunkReduction.h"
+
+#include <algorithm>
+
+
+void ChunkReduction::begin(qulonglong first, qulonglong end, std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_first = first;
+    m_count = end > first ? end - first : 0;
+    if (size != m_size) m_free.clear();
+    m_size = size;
+    m_nodes.clear();
+}
+
+std::vector<double> ChunkReduction::acquire()
+{
+    std::vector<double> ans;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free.empty()) {
+            ans = std::move(m_free.back());
+            m_free.pop_back();
+        }
+    }
+    ans.assign(m_size, 0.);
+    return ans;
+}
+
+/*!
+ * Moves the grid up the tree while its sibling is given, or lies past the
+ * range, and leaves it at the first node whose sibling is missing. The
+ * grids are added outside the lock, the nodes taken out of the tree.
+ */
+void ChunkReduction::add(qulonglong chunk, std::vector<double>&& grid)
+{
+    std::vector<double> sum = std::move(grid);
+    int level = 0;
+    qulonglong index = chunk - m_first;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while ((qulonglong(1) << level) < m_count)
+    {
+        const qulonglong sibling = index ^ 1;
+        if ((sibling << level) < m_count) {
+            auto it = m_nodes.find(Node(level, sibling));
+            if (it == m_nodes.end()) break;
+            std::vector<double> other = std::move(it->second);
+            m_nodes.erase(it);
+            lock.unlock();
+            // a + b equals b + a, so only the tree decides the sums
+            addTo(sum, other);
+            lock.lock();
+            m_free.push_back(std::move(other));
+        }
+        index >>= 1;
+        ++level;
+    }
+    m_nodes[Node(level, index)] = std::move(sum);
+}
+
+std::vector<double> ChunkReduction::take()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<double> ans(m_size, 0.);
+    for (std::pair<const Node, std::vector<double>>& node : m_nodes) {
+        addTo(ans, node.second);
+        m_free.push_back(std::move(node.second));
+    }
+    m_nodes.clear();
+    return ans;
+}
+
+void ChunkReduction::addTo(std::vector<double>& sum, const std::vector<double>& grid)
+{
+    const std::size_t size = std::min(sum.size(), grid.size());
+    for (std::size_t n = 0; n < size; ++n)
+        sum[n] += grid[n];
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <qglobal.h>
+
+
+//! ChunkReduction sums per-chunk grids in an order fixed by the chunk indices.
+/*!
+ * Each chunk of a range gives the grid it filled, from any worker and in
+ * any order. Grids are added in a pairwise tree over the chunk indices:
+ * two siblings are added as soon as both are given and the sum moves up,
+ * a sibling past the end of the range counting as absent. Floating point
+ * sums then depend on the chunks only, not on which worker traced them or
+ * when, and only the nodes waiting for a sibling are held.
+ *
+ * Grids come from acquire(), which reuses those already added.
+ */
+class TONATIUH_KERNEL ChunkReduction
+{
+public:
+    // chunks [first, end) of grids of size values
+    void begin(qulonglong first, qulonglong end, std::size_t size);
+    std::size_t getSize() const {return m_size;}
+
+    // thread safe; a zeroed grid
+    std::vector<double> acquire();
+    // thread safe; the grid of a chunk of the range, given once
+    void add(qulonglong chunk, std::vector<double>&& grid);
+
+    // the sum of the grids given, while none is being added; the chunks not
+    // given leave their nodes unmerged, which are then added in tree order
+    std::vector<double> take();
+
+private:
+    using Node = std::pair<int, qulonglong>; // level and index in the level
+
+    static void addTo(std::vector<double>& sum, const std::vector<double>& grid);
+
+    qulonglong m_first = 0;
+    qulonglong m_count = 0;
+    std::size_t m_size = 0;
+    std::mutex m_mutex;
+    std::map<Node, std::vector<double>> m_nodes;
+    std::vector<std::vector<double>> m_free;
+};
@@ -0,0 +1,212 @@
+#include "ConvolutionFlux.h"
+
+#include <cmath>
+
+#include <QSet>
+
+#include "kernel/air/AirTransmission.h"
+#include "kernel/material/MaterialRT.h"
+#include "kernel/profiles/ProfileRT.h"
+#include "kernel/random/Random.h"
+#include "kernel/run/FluxAccumulator.h"
+#include "kernel/run/SceneBVH.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/ShapeRT.h"
+#include "kernel/sun/SunShape.h"
+#include "libraries/math/3D/Ray.h"
+#include "libraries/math/gcf.h"
+
+namespace
+{
+// steps of the sunshape moments over the sun disk
+const int ShapeSteps = 2000;
+// images are cut at this many deviations
+const double Cutoff = 4.;
+
+// a point of a reflector lit and not blocked
+struct Spot
+{
+    vec3d point;
+    vec3d direction; // specular
+    double weight;   // projected area
+};
+
+// the Gaussian image of one reflector
+struct Image
+{
+    vec3d center;
+    vec3d axis;
+    double power = 0.;
+    double variance = 0.; // angular, along one axis
+    std::vector<Spot> spots;
+};
+
+vec3d reflect(const vec3d& d, const vec3d& n)
+{
+    return d - 2.*dot(d, n)*n;
+}
+}
+
+
+ConvolutionFlux::ConvolutionFlux(const SceneBVH& scene, const SunShape* sunShape, const vec3d& sunDirection,
+                                 double irradiance, const AirTransmission* air):
+    m_scene(scene),
+    m_sunDirection(sunDirection.normalized()),
+    m_irradiance(irradiance),
+    m_air(air),
+    m_sunVariance(0.),
+    m_surfaceSamples(8),
+    m_materialSamples(64)
+{
+    // half the mean square angle of the sunshape over the solid angle
+    double sum = 0.;
+    double sum2 = 0.;
+    const double thetaMax = sunShape->getThetaMax();
+    const double step = thetaMax/ShapeSteps;
+    for (int n = 0; n < ShapeSteps; ++n) {
+        double theta = (n + 0.5)*step;
+        double w = sunShape->shape(theta)*sin(theta);
+        sum += w;
+        sum2 += w*theta*theta;
+    }
+    if (sum > 0.) m_sunVariance = sum2/(2.*sum);
+}
+
+void ConvolutionFlux::setSamples(int surfaceSamples, int materialSamples)
+{
+    m_surfaceSamples = qMax(1, surfaceSamples);
+    m_materialSamples = qMax(1, materialSamples);
+}
+
+void ConvolutionFlux::addImages(FluxAccumulator& flux, Random& rand) const
+{
+    QSet<InstanceNode*> targets;
+    for (int t = 0; t < flux.getTargetCount(); ++t)
+        targets.insert(flux.getSurface(t));
+    const vec3d toSun = -m_sunDirection;
+
+    std::vector<Image> images;
+    for (const SceneBVHInstance& leaf : m_scene.findLeaves())
+    {
+        if (!leaf.shape || !leaf.profile || !leaf.material) continue;
+        if (targets.contains(leaf.instance)) continue;
+
+        Image image;
+        const Box2D box = leaf.profile->getBox();
+        const double cellArea = box.area()/(m_surfaceSamples*m_surfaceSamples);
+        double weights = 0.;
+        vec3d center;
+        vec3d axis;
+        // the material is sampled at the point lit nearest the middle
+        DifferentialGeometry dgMiddle;
+        vec3d directionMiddle;
+        double distanceMiddle = gcf::infinity;
+        for (int i = 0; i < m_surfaceSamples; ++i) {
+            for (int j = 0; j < m_surfaceSamples; ++j) {
+                double u = box.min().x + (i + 0.5)/m_surfaceSamples*box.size().x;
+                double v = box.min().y + (j + 0.5)/m_surfaceSamples*box.size().y;
+                if (!leaf.profile->isInside(u, v)) continue;
+
+                vec3d point = leaf.transform.transformPoint(leaf.shape->getPoint(u, v));
+                vec3d du = leaf.transform.transformVector(leaf.shape->getDerivativeU(u, v));
+                vec3d dv = leaf.transform.transformVector(leaf.shape->getDerivativeV(u, v));
+                vec3d normal = leaf.transform.transformNormal(leaf.shape->getNormal(u, v)).normalized();
+                double cosSun = dot(toSun, normal);
+                vec3d side = cosSun >= 0. ? normal : -normal;
+                cosSun = std::abs(cosSun);
+                if (cosSun <= 0.) continue;
+
+                if (m_scene.occluded(Ray(point, toSun))) continue;
+                vec3d direction = reflect(m_sunDirection, side);
+                SceneBVHHit hit;
+                if (m_scene.findHit(Ray(point, direction), hit) && !targets.contains(hit.instance)) continue;
+
+                double weight = cosSun*cross(du, dv).norm()*cellArea;
+                image.spots.push_back(Spot{point, direction, weight});
+                weights += weight;
+                center += weight*point;
+                axis += weight*direction;
+
+                double distance = std::hypot((i + 0.5)/m_surfaceSamples - 0.5, (j + 0.5)/m_surfaceSamples - 0.5);
+                if (distance < distanceMiddle) {
+                    distanceMiddle = distance;
+                    dgMiddle = DifferentialGeometry(point, u, v, du, dv, normal, leaf.shape, dot(normal, m_sunDirection) <= 0.);
+                    directionMiddle = direction;
+                }
+            }
+        }
+        if (image.spots.empty()) continue;
+
+        // reflectivity and spread of the material, by its own draws
+        Ray rayIn(dgMiddle.point - m_sunDirection, m_sunDirection);
+        double reflected = 0.;
+        double spread = 0.;
+        for (int n = 0; n < m_materialSamples; ++n) {
+            Ray rayOut;
+            double weight = 1.;
+            if (!leaf.material->OutputRayWeighted(rayIn, dgMiddle, rand, rayOut, weight)) continue;
+            double cosAngle = qBound(-1., dot(rayOut.direction().normalized(), directionMiddle), 1.);
+            double angle = acos(cosAngle);
+            reflected += weight;
+            spread += weight*angle*angle;
+        }
+        if (reflected <= 0.) continue;
+
+        image.center = center/weights;
+        image.axis = axis.normalized();
+        image.power = m_irradiance*weights*reflected/m_materialSamples;
+        image.variance = m_sunVariance + spread/(2.*reflected);
+        images.push_back(std::move(image));
+    }
+
+    for (int t = 0; t < flux.getTargetCount(); ++t)
+    {
+        const std::vector<FluxAccumulator::Bin> bins = flux.getBins(t);
+        if (bins.empty()) continue;
+        vec3d targetCenter;
+        double targetArea = 0.;
+        for (const FluxAccumulator::Bin& bin : bins) {
+            targetCenter += bin.area*bin.point;
+            targetArea += bin.area;
+        }
+        if (!(targetArea > 0.)) continue;
+        targetCenter = targetCenter/targetArea;
+
+        std::vector<double> weights(bins.size(), 0.);
+        for (const Image& image : images)
+        {
+            double distance = dot(targetCenter - image.center, image.axis);
+            if (distance <= 0.) continue;
+
+            // the spots of the specular rays on the image plane at the target
+            double spotWeights = 0.;
+            double spotVariance = 0.;
+            for (const Spot& spot : image.spots) {
+                double cosAxis = dot(spot.direction, image.axis);
+                if (cosAxis <= 0.) continue;
+                double s = (distance - dot(spot.point - image.center, image.axis))/cosAxis;
+                vec3d q = spot.point + s*spot.direction - image.center - distance*image.axis;
+                spotVariance += spot.weight*q.norm2();
+                spotWeights += spot.weight;
+            }
+            if (spotWeights > 0.) spotVariance /= 2.*spotWeights;
+
+            for (size_t k = 0; k < bins.size(); ++k) {
+                const FluxAccumulator::Bin& bin = bins[k];
+                vec3d v = bin.point - image.center;
+                double d = dot(v, image.axis);
+                if (d <= 0.) continue;
+                double cosBin = -dot(image.axis, bin.normal);
+                if (cosBin <= 0.) continue;
+                double variance = d*d*image.variance + spotVariance;
+                if (!(variance > 0.)) continue;
+                double r2 = qMax(0., v.norm2() - d*d);
+                if (r2 > Cutoff*Cutoff*variance) continue;
+                double irradiance = image.power/(gcf::TwoPi*variance)*exp(-r2/(2.*variance));
+                if (m_air) irradiance *= m_air->transmission(v.norm());
+                weights[k] += irradiance*cosBin*bin.area;
+            }
+        }
+        flux.addWeights(t, weights);
+    }
+}
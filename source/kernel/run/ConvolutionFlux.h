@@ -0,0 +1,58 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include "libraries/math/3D/vec3d.h"
+
+class AirTransmission;
+class FluxAccumulator;
+class Random;
+class SceneBVH;
+class SunShape;
+
+//! ConvolutionFlux adds analytic images of the reflectors to flux grids.
+/*!
+ * Every leaf of the scene that is not a target is a reflector, in the
+ * orientation its tracker has in the updated tree. A grid of points on it
+ * is checked for shading towards the sun and for blocking along the
+ * specular reflection with the occlusion queries of the scene; the power
+ * of the points left is the irradiance on the reflector times its
+ * reflectivity.
+ *
+ * The image of a reflector is a circular Gaussian around its mean reflected
+ * ray, as in HFLCAL: the angular variances of the sunshape and of the
+ * material spread grow with the distance, and the spread of the specular
+ * rays of the points at the distance of the target adds the size of the
+ * reflector and its astigmatism. The material is sampled by
+ * MaterialRT::OutputRayWeighted at the reflector, so reflectivity and
+ * slope errors are those the tracer uses. Air attenuates the images.
+ *
+ * The images are added to the bins of every target as weights in W, so the
+ * flux of FluxAccumulator::getFlux with a power of one per ray is in W/m2.
+ * They approximate a trace at a fraction of its cost, for layout searches;
+ * a Monte Carlo trace validates the result.
+ */
+class TONATIUH_KERNEL ConvolutionFlux
+{
+public:
+    // sunDirection is the direction the sun rays travel in, in world frame
+    ConvolutionFlux(const SceneBVH& scene, const SunShape* sunShape, const vec3d& sunDirection,
+                    double irradiance, const AirTransmission* air = nullptr);
+
+    // points per side of the profile box of a reflector, and draws of its material
+    void setSamples(int surfaceSamples, int materialSamples);
+
+    // to the targets of flux, bound to the tree of the scene
+    void addImages(FluxAccumulator& flux, Random& rand) const;
+
+private:
+    const SceneBVH& m_scene;
+    vec3d m_sunDirection;
+    double m_irradiance;
+    const AirTransmission* m_air;
+    double m_sunVariance; // of the angle along one axis
+    int m_surfaceSamples;
+    int m_materialSamples;
+};
@@ -0,0 +1,273 @@
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <thread>
+
+#include <QDir>
+#include <QFile>
+#include <QThread>
+
+#if defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_MACOS)
+#include <pthread.h>
+#endif
+
+// the Windows processor group calls, see TONATIUHPP_ENABLE_PROCESSOR_GROUPS
+#if defined(Q_OS_WIN) && defined(TONATIUHPP_PROCESSOR_GROUPS)
+#define TONATIUHPP_WINDOWS_GROUPS
+#endif
+
+#if defined(TONATIUHPP_WINDOWS_GROUPS)
+namespace {
+
+// the group of a processor numbered across groups and its number in the
+// group, the active processors of a group coming first
+bool findGroupProcessor(int cpu, WORD* group, BYTE* number)
+{
+    const WORD groups = GetActiveProcessorGroupCount();
+    for (WORD g = 0; g < groups; ++g) {
+        const int count = int(GetActiveProcessorCount(g));
+        if (cpu < count) {
+            *group = g;
+            *number = BYTE(cpu);
+            return true;
+        }
+        cpu -= count;
+    }
+    return false;
+}
+
+}
+#endif
+
+
+CpuTopology::CpuTopology(const std::vector<std::vector<int>>& nodes, const std::vector<std::vector<int>>& groups)
+{
+    for (const std::vector<int>& cpus : nodes)
+        if (!cpus.empty())
+            m_nodes.push_back(cpus);
+    if (m_nodes.empty()) {
+        std::vector<int> cpus;
+        for (int n = 0; n < countProcessors(); ++n)
+            cpus.push_back(n);
+        m_nodes.push_back(cpus);
+    }
+
+    for (const std::vector<int>& cpus : groups)
+        if (!cpus.empty())
+            m_groups.push_back(cpus);
+    if (m_groups.empty()) {
+        std::vector<int> cpus;
+        for (const std::vector<int>& node : m_nodes)
+            cpus.insert(cpus.end(), node.begin(), node.end());
+        std::sort(cpus.begin(), cpus.end());
+        cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+        m_groups.push_back(cpus);
+    }
+}
+
+CpuTopology CpuTopology::detect()
+{
+    std::vector<std::vector<int>> nodes;
+    std::vector<std::vector<int>> groups;
+#if defined(Q_OS_LINUX)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool hasMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    QDir dir("/sys/devices/system/node");
+    QStringList names = dir.entryList({"node*"}, QDir::Dirs);
+    std::sort(names.begin(), names.end(), [](const QString& a, const QString& b) {
+        return a.mid(4).toInt() < b.mid(4).toInt();
+    });
+    for (const QString& name : names)
+    {
+        QFile file(dir.filePath(name + "/cpulist"));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) continue;
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(QString::fromLatin1(file.readAll())))
+            if (!hasMask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)))
+                cpus.push_back(cpu);
+        nodes.push_back(cpus);
+    }
+#elif defined(TONATIUHPP_WINDOWS_GROUPS)
+    std::vector<int> firsts; // first processor of every group
+    const WORD groupCount = GetActiveProcessorGroupCount();
+    int first = 0;
+    for (WORD g = 0; g < groupCount; ++g)
+    {
+        const int count = int(GetActiveProcessorCount(g));
+        std::vector<int> cpus;
+        for (int n = 0; n < count; ++n)
+            cpus.push_back(first + n);
+        firsts.push_back(first);
+        first += count;
+        groups.push_back(cpus);
+    }
+
+    // a node of more than one group lists those of its primary group
+    ULONG highest = 0;
+    if (GetNumaHighestNodeNumber(&highest)) {
+        for (ULONG node = 0; node <= highest; ++node)
+        {
+            GROUP_AFFINITY affinity = {};
+            std::vector<int> cpus;
+            if (GetNumaNodeProcessorMaskEx(USHORT(node), &affinity) && affinity.Group < firsts.size())
+                for (int n = 0; n < int(8*sizeof(KAFFINITY)); ++n)
+                    if (affinity.Mask & (KAFFINITY(1) << n))
+                        cpus.push_back(firsts[affinity.Group] + n);
+            nodes.push_back(cpus);
+        }
+    }
+#endif
+    return CpuTopology(nodes, groups);
+}
+
+int CpuTopology::findNode(int cpu) const
+{
+    for (size_t n = 0; n < m_nodes.size(); ++n)
+        if (std::find(m_nodes[n].begin(), m_nodes[n].end(), cpu) != m_nodes[n].end())
+            return int(n);
+    return -1;
+}
+
+std::vector<int> CpuTopology::spreadCpus() const
+{
+    std::vector<int> ans;
+    for (size_t k = 0; ; ++k)
+    {
+        bool any = false;
+        for (const std::vector<int>& cpus : m_nodes) {
+            if (k >= cpus.size()) continue;
+            ans.push_back(cpus[k]);
+            any = true;
+        }
+        if (!any) break;
+    }
+    return ans;
+}
+
+int CpuTopology::findGroup(int cpu) const
+{
+    for (size_t n = 0; n < m_groups.size(); ++n)
+        if (std::find(m_groups[n].begin(), m_groups[n].end(), cpu) != m_groups[n].end())
+            return int(n);
+    return -1;
+}
+
+std::vector<int> CpuTopology::spreadGroups(int workers) const
+{
+    std::vector<int> ans;
+    for (size_t k = 0; int(ans.size()) < workers; ++k)
+    {
+        bool any = false;
+        for (size_t g = 0; g < m_groups.size() && int(ans.size()) < workers; ++g) {
+            if (k >= m_groups[g].size()) continue;
+            ans.push_back(int(g));
+            any = true;
+        }
+        // workers past the processors start over
+        if (!any) k = size_t(-1);
+    }
+    return ans;
+}
+
+int CpuTopology::countProcessors()
+{
+#if defined(TONATIUHPP_WINDOWS_GROUPS)
+    const DWORD count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    if (count > 0)
+        return int(count);
+#endif
+    return qMax(1, QThread::idealThreadCount());
+}
+
+std::vector<int> CpuTopology::parseCpuList(const QString& text)
+{
+    std::vector<int> ans;
+    for (const QString& part : text.trimmed().split(',', Qt::SkipEmptyParts))
+    {
+        QStringList range = part.trimmed().split('-');
+        bool ok = false;
+        int first = range[0].toInt(&ok);
+        if (!ok || first < 0) continue;
+        int last = first;
+        if (range.size() == 2) {
+            last = range[1].toInt(&ok);
+            if (!ok || last < first) continue;
+        }
+        for (int cpu = first; cpu <= last; ++cpu)
+            ans.push_back(cpu);
+    }
+    return ans;
+}
+
+bool CpuTopology::pinThread(int cpu)
+{
+    if (cpu < 0) return false;
+#if defined(Q_OS_LINUX)
+    if (cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(TONATIUHPP_WINDOWS_GROUPS)
+    GROUP_AFFINITY affinity = {};
+    BYTE number = 0;
+    if (!findGroupProcessor(cpu, &affinity.Group, &number)) return false;
+    affinity.Mask = KAFFINITY(1) << number;
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#elif defined(Q_OS_WIN)
+    if (cpu >= int(8*sizeof(DWORD_PTR))) return false;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+    return false;
+#endif
+}
+
+bool CpuTopology::joinGroup(int group)
+{
+#if defined(TONATIUHPP_WINDOWS_GROUPS)
+    if (group < 0 || group >= int(GetActiveProcessorGroupCount())) return false;
+    const DWORD count = GetActiveProcessorCount(WORD(group));
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = WORD(group);
+    affinity.Mask = count >= 8*sizeof(KAFFINITY) ? ~KAFFINITY(0) : (KAFFINITY(1) << count) - 1;
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#else
+    Q_UNUSED(group)
+    return false;
+#endif
+}
+
+bool CpuTopology::lowerThreadPriority()
+{
+#if defined(Q_OS_LINUX)
+    // every thread has a nice value of its own on Linux
+    const id_t thread = id_t(syscall(SYS_gettid));
+    const int nice = getpriority(PRIO_PROCESS, thread);
+    return setpriority(PRIO_PROCESS, thread, qMin(19, nice + 10)) == 0;
+#elif defined(Q_OS_WIN)
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL) != 0;
+#elif defined(Q_OS_MACOS)
+    return pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+void CpuTopology::runOn(int cpu, const std::function<void()>& function)
+{
+    std::thread thread([cpu, &function]() {
+        pinThread(cpu);
+        function();
+    });
+    thread.join();
+}
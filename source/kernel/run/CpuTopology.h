@@ -0,0 +1,68 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <functional>
+#include <vector>
+
+#include <QString>
+
+
+//! CpuTopology lists the processors of every NUMA node and processor group.
+/*!
+ * On Linux the nodes are read from /sys/devices/system/node and limited to
+ * the processors the process may run on. Elsewhere, or when the nodes can
+ * not be read, there is one node with countProcessors() processors.
+ *
+ * Windows schedules threads within processor groups of at most 64 logical
+ * processors. Builds with TONATIUHPP_ENABLE_PROCESSOR_GROUPS read the groups
+ * and the nodes from the Windows API, number processors across groups, those
+ * of group g following those of the groups before it, and joinGroup() moves
+ * a thread to another group. Other builds and systems have a single group.
+ *
+ * Threads are pinned with pinThread(); memory then comes from the node of
+ * the thread that first touches it, so data built by pinned threads stays
+ * local to their node.
+ */
+class TONATIUH_KERNEL CpuTopology
+{
+public:
+    // one group with the processors of every node if \a groups is empty
+    explicit CpuTopology(const std::vector<std::vector<int>>& nodes = {}, const std::vector<std::vector<int>>& groups = {});
+
+    static CpuTopology detect();
+
+    int getNodeCount() const {return int(m_nodes.size());}
+    const std::vector<int>& getCpus(int node) const {return m_nodes[node];}
+    int findNode(int cpu) const; // -1 if unknown
+
+    // processors taking the nodes in turn, so the first n cover every node
+    std::vector<int> spreadCpus() const;
+
+    int getGroupCount() const {return int(m_groups.size());}
+    const std::vector<int>& getGroupCpus(int group) const {return m_groups[group];}
+    int findGroup(int cpu) const; // -1 if unknown
+    // the group of each of \a workers, taking the groups in turn while they
+    // have processors left, so workers fill the groups evenly
+    std::vector<int> spreadGroups(int workers) const;
+
+    // logical processors of every group, QThread::idealThreadCount() elsewhere
+    static int countProcessors();
+
+    // "0-3,8,10-11" as in sysfs
+    static std::vector<int> parseCpuList(const QString& text);
+    // pins the calling thread, false if not supported
+    static bool pinThread(int cpu);
+    // lets the calling thread run on any processor of \a group, false if
+    // not supported
+    static bool joinGroup(int group);
+    // runs the calling thread below normal priority, so interactive threads
+    // of the process go first; false if not supported
+    static bool lowerThreadPriority();
+    // runs \a function on a new thread pinned to \a cpu and waits for it
+    static void runOn(int cpu, const std::function<void()>& function);
+
+private:
+    std::vector<std::vector<int>> m_nodes;
+    std::vector<std::vector<int>> m_groups;
+};
@@ -0,0 +1,359 @@
+#include "FluxAccumulator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "kernel/profiles/ProfileRT.h"
+#include "kernel/run/InstanceNode.h"
+#include "kernel/run/RayTracer.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/ShapeRT.h"
+
+
+namespace {
+
+// units of exact weights
+const double ExactWeightScale = 4294967296.; // 2^32
+
+InstanceNode* findShape(InstanceNode* instance, const QString& url)
+{
+    SoNode* node = instance->getNode();
+    if (node && node->getTypeId().isDerivedFrom(TShapeKit::getClassTypeId()))
+        return instance->getURL() == url ? instance : 0;
+
+    for (InstanceNode* child : instance->children)
+        if (InstanceNode* ans = findShape(child, url))
+            return ans;
+    return 0;
+}
+
+}
+
+
+FluxAccumulator::FluxAccumulator()
+{
+
+}
+
+FluxAccumulator::~FluxAccumulator()
+{
+
+}
+
+void FluxAccumulator::addTarget(const QString& url, bool isFront, int rows, int cols, const Box2D& window)
+{
+    TargetData data;
+    data.target = {url, isFront, qMax(1, rows), qMax(1, cols), window};
+    data.counts.assign(size_t(data.target.rows)*data.target.cols, 0);
+    data.weights.assign(data.counts.size(), 0.);
+    data.offset = m_bins;
+    m_bins += data.counts.size();
+    m_targets.push_back(data);
+}
+
+/*!
+ * Finds the target surfaces in the tree of \a root, which must be updated.
+ * Returns false if a URL does not name a shape.
+ */
+bool FluxAccumulator::bind(InstanceNode* root, QString* error)
+{
+    for (TargetData& data : m_targets)
+    {
+        data.surface = root ? findShape(root, data.target.url) : 0;
+        if (!data.surface) {
+            if (error) *error = QString("Flux surface %1 was not found.").arg(data.target.url);
+            return false;
+        }
+
+        TShapeKit* kit = static_cast<TShapeKit*>(data.surface->getNode());
+        data.shape = static_cast<ShapeRT*>(kit->shapeRT.getValue());
+        ProfileRT* profile = static_cast<ProfileRT*>(kit->profileRT.getValue());
+        if (!data.shape || !profile) {
+            if (error) *error = QString("Flux surface %1 has no shape or profile.").arg(data.target.url);
+            return false;
+        }
+        data.box = data.target.window.isValid() ? data.target.window : profile->getBox();
+        data.toWorld = data.surface->getTransform();
+        data.toObject = data.toWorld.inversed();
+        // the surface may have been edited since the last trace
+        data.areas.clear();
+    }
+    return true;
+}
+
+void FluxAccumulator::beginWorkers(int workers)
+{
+    m_workers.clear();
+    m_chunked = false;
+    for (int w = 0; w < qMax(1, workers); ++w)
+    {
+        std::unique_ptr<Worker> worker(new Worker);
+        for (const TargetData& data : m_targets)
+            worker->counts.emplace_back(data.counts.size(), 0);
+        worker->weights.assign(m_bins, 0.);
+        if (m_exactWeights)
+            worker->exactWeights.assign(m_bins, 0);
+        worker->hits.assign(m_targets.size(), 0);
+        m_workers.push_back(std::move(worker));
+    }
+}
+
+/*!
+ * Allocates the grids of \a worker again from the calling thread, so a
+ * pinned worker fills memory of its own NUMA node. Its callback stays valid.
+ */
+void FluxAccumulator::prepareWorker(int worker)
+{
+    Worker* w = m_workers[worker].get();
+    for (std::vector<qulonglong>& counts : w->counts)
+        std::vector<qulonglong>(counts.size(), 0).swap(counts);
+    std::vector<double>(w->weights.size(), 0.).swap(w->weights);
+    std::vector<quint64>(w->exactWeights.size(), 0).swap(w->exactWeights);
+    std::vector<qulonglong>(w->hits.size(), 0).swap(w->hits);
+}
+
+/*!
+ * Returns the callback of \a worker, to be called from one thread only.
+ */
+FluxAccumulator::HitCallback FluxAccumulator::hitCallback(int worker)
+{
+    Worker* w = m_workers[worker].get();
+    return [this, w](const RayTracerHit& hit) {
+        addHit(*w, hit);
+    };
+}
+
+void FluxAccumulator::addHit(Worker& worker, const RayTracerHit& hit) const
+{
+    for (size_t t = 0; t < m_targets.size(); ++t)
+    {
+        const TargetData& data = m_targets[t];
+        if (hit.surface != data.surface || hit.isFront != data.target.isFront) continue;
+
+        vec2d uv = data.shape->getUV(data.toObject.transformPoint(hit.position));
+        vec2d q = (uv - data.box.min())/data.box.size();
+        int r = int(std::floor(q.x*data.target.rows));
+        int c = int(std::floor(q.y*data.target.cols));
+        if (r == data.target.rows) r--;
+        if (c == data.target.cols) c--;
+        if (r < 0 || r >= data.target.rows || c < 0 || c >= data.target.cols) continue;
+
+        const size_t index = size_t(r)*data.target.cols + c;
+        worker.counts[t][index]++;
+        if (m_exactWeights)
+            worker.exactWeights[data.offset + index] += quint64(std::llround(hit.weight*ExactWeightScale));
+        else
+            worker.weights[data.offset + index] += hit.weight;
+        worker.hits[t]++;
+    }
+}
+
+void FluxAccumulator::beginChunks(qulonglong first, qulonglong end)
+{
+    // exact weights do not depend on the chunks
+    if (m_exactWeights) return;
+    m_reduction.begin(first, end, m_bins);
+    m_chunked = true;
+}
+
+/*!
+ * Swaps the weights of \a worker, which hold those of \a chunk only, for
+ * zeroed ones and hands them to the reduction.
+ */
+void FluxAccumulator::endChunk(int worker, qulonglong chunk)
+{
+    if (!m_chunked) return;
+    std::vector<double> weights = m_reduction.acquire();
+    weights.swap(m_workers[worker]->weights);
+    m_reduction.add(chunk, std::move(weights));
+}
+
+/*!
+ * Adds the worker grids to the totals and releases the bound surfaces.
+ * Weights summed by chunk come first, then those of chunks not ended.
+ */
+void FluxAccumulator::endWorkers()
+{
+    if (m_chunked) {
+        const std::vector<double> weights = m_reduction.take();
+        for (TargetData& data : m_targets)
+            for (size_t n = 0; n < data.weights.size(); ++n)
+                data.weights[n] += weights[data.offset + n];
+        m_chunked = false;
+    }
+    if (m_exactWeights && !m_workers.empty()) {
+        std::vector<quint64> weights(m_bins, 0);
+        for (const std::unique_ptr<Worker>& worker : m_workers)
+            for (size_t n = 0; n < worker->exactWeights.size(); ++n)
+                weights[n] += worker->exactWeights[n];
+        for (TargetData& data : m_targets)
+            for (size_t n = 0; n < data.weights.size(); ++n)
+                data.weights[n] += double(weights[data.offset + n])/ExactWeightScale;
+    }
+    for (const std::unique_ptr<Worker>& worker : m_workers)
+    {
+        for (size_t t = 0; t < m_targets.size(); ++t)
+        {
+            std::vector<qulonglong>& counts = m_targets[t].counts;
+            const std::vector<qulonglong>& workerCounts = worker->counts[t];
+            for (size_t n = 0; n < counts.size(); ++n)
+                counts[n] += workerCounts[n];
+            std::vector<double>& weights = m_targets[t].weights;
+            const double* workerWeights = worker->weights.data() + m_targets[t].offset;
+            for (size_t n = 0; n < weights.size(); ++n)
+                weights[n] += workerWeights[n];
+            m_targets[t].hits += worker->hits[t];
+        }
+    }
+    m_workers.clear();
+    for (TargetData& data : m_targets)
+        data.surface = 0;
+}
+
+qulonglong FluxAccumulator::getMemoryUsage() const
+{
+    qulonglong ans = 0;
+    for (const TargetData& data : m_targets)
+        ans += qulonglong(data.areas.capacity() + data.weights.capacity())*sizeof(double) +
+            qulonglong(data.counts.capacity())*sizeof(qulonglong);
+    for (const std::unique_ptr<Worker>& worker : m_workers) {
+        for (const std::vector<qulonglong>& counts : worker->counts)
+            ans += qulonglong(counts.capacity())*sizeof(qulonglong);
+        ans += qulonglong(worker->weights.capacity())*sizeof(double) +
+            qulonglong(worker->exactWeights.capacity())*sizeof(quint64) +
+            qulonglong(worker->hits.capacity())*sizeof(qulonglong);
+    }
+    return ans;
+}
+
+void FluxAccumulator::clear()
+{
+    for (TargetData& data : m_targets) {
+        std::fill(data.counts.begin(), data.counts.end(), 0);
+        std::fill(data.weights.begin(), data.weights.end(), 0.);
+        data.hits = 0;
+    }
+}
+
+std::vector<qulonglong> FluxAccumulator::getWorkerCounts(int n, qulonglong* hits) const
+{
+    std::vector<qulonglong> ans(m_targets[n].counts.size(), 0);
+    qulonglong total = 0;
+    for (const std::unique_ptr<Worker>& worker : m_workers)
+    {
+        const std::vector<qulonglong>& workerCounts = worker->counts[n];
+        for (size_t k = 0; k < ans.size(); ++k)
+            ans[k] += workerCounts[k];
+        total += worker->hits[n];
+    }
+    if (hits) *hits = total;
+    return ans;
+}
+
+bool FluxAccumulator::addCounts(int n, const std::vector<qulonglong>& counts, qulonglong hits)
+{
+    TargetData& data = m_targets[n];
+    if (counts.size() != data.counts.size()) return false;
+    // saved runs are analog, each hit weighing one
+    for (size_t k = 0; k < counts.size(); ++k) {
+        data.counts[k] += counts[k];
+        data.weights[k] += double(counts[k]);
+    }
+    data.hits += hits;
+    return true;
+}
+
+bool FluxAccumulator::addWeights(int n, const std::vector<double>& weights)
+{
+    TargetData& data = m_targets[n];
+    if (weights.size() != data.weights.size()) return false;
+    for (size_t k = 0; k < weights.size(); ++k)
+        data.weights[k] += weights[k];
+    return true;
+}
+
+bool FluxAccumulator::addMirrored(int n, const std::vector<int>& mirrors, const std::vector<qulonglong>& counts,
+                                  const std::vector<double>& weights, qulonglong hits)
+{
+    TargetData& data = m_targets[n];
+    if (mirrors.size() != data.counts.size() || counts.size() != data.counts.size() || weights.size() != data.weights.size())
+        return false;
+    const std::vector<qulonglong> countsNow = data.counts;
+    const std::vector<double> weightsNow = data.weights;
+    for (size_t k = 0; k < mirrors.size(); ++k) {
+        size_t m = size_t(mirrors[k]);
+        data.counts[k] += countsNow[m] - counts[m];
+        data.weights[k] += weightsNow[m] - weights[m];
+    }
+    data.hits += data.hits - hits;
+    return true;
+}
+
+std::vector<FluxAccumulator::Bin> FluxAccumulator::getBins(int n) const
+{
+    const TargetData& data = m_targets[n];
+    std::vector<Bin> ans;
+    if (!data.surface) return ans;
+    findAreas(data);
+
+    ans.resize(data.counts.size());
+    double uStep = data.box.size().x/data.target.rows;
+    double vStep = data.box.size().y/data.target.cols;
+    for (int r = 0; r < data.target.rows; ++r) {
+        for (int c = 0; c < data.target.cols; ++c) {
+            double u = data.box.min().x + (r + 0.5)*uStep;
+            double v = data.box.min().y + (c + 0.5)*vStep;
+            Bin& bin = ans[size_t(r)*data.target.cols + c];
+            bin.point = data.toWorld.transformPoint(data.shape->getPoint(u, v));
+            bin.normal = data.toWorld.transformNormal(data.shape->getNormal(u, v)).normalized();
+            if (!data.target.isFront) bin.normal = -bin.normal;
+            bin.area = data.areas[size_t(r)*data.target.cols + c];
+        }
+    }
+    return ans;
+}
+
+double FluxAccumulator::getTotalWeight(int n) const
+{
+    double ans = 0.;
+    for (double weight : m_targets[n].weights)
+        ans += weight;
+    return ans;
+}
+
+void FluxAccumulator::findAreas(const TargetData& data) const
+{
+    if (!data.areas.empty()) return;
+    data.areas.resize(data.counts.size());
+    double uStep = data.box.size().x/data.target.rows;
+    double vStep = data.box.size().y/data.target.cols;
+    for (int r = 0; r < data.target.rows; ++r) {
+        for (int c = 0; c < data.target.cols; ++c) {
+            double u0 = data.box.min().x + r*uStep;
+            double v0 = data.box.min().y + c*vStep;
+            data.areas[size_t(r)*data.target.cols + c] = data.shape->findArea(u0, v0, u0 + uStep, v0 + vStep, data.toWorld);
+        }
+    }
+}
+
+std::vector<double> FluxAccumulator::getFlux(int n, double powerPerRay) const
+{
+    std::vector<double> ans(m_targets[n].counts.size(), 0.);
+    getFlux(n, powerPerRay, ans.data());
+    return ans;
+}
+
+void FluxAccumulator::getFlux(int n, double powerPerRay, double* values) const
+{
+    const TargetData& data = m_targets[n];
+    std::fill(values, values + data.counts.size(), 0.);
+    if (!data.shape) return;
+
+    findAreas(data);
+
+    for (size_t index = 0; index < data.counts.size(); ++index) {
+        double area = data.areas[index];
+        if (data.weights[index] != 0. && area > 0.)
+            values[index] = data.weights[index]*powerPerRay/area;
+    }
+}
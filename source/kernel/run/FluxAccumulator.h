@@ -0,0 +1,147 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QString>
+
+#include "kernel/run/ChunkReduction.h"
+#include "libraries/math/2D/Box2D.h"
+#include "libraries/math/3D/Transform.h"
+
+class InstanceNode;
+class ShapeRT;
+struct RayTracerHit;
+
+
+//! FluxAccumulator bins ray hits on receiver surfaces while tracing.
+/*!
+ * Each target is one side of a surface with a grid over the (u, v) box of
+ * its profile, or over a window of it, binned as in FluxAnalysis. Every worker fills its own grids
+ * through hitCallback(worker) and endWorkers() adds them to the totals, so
+ * memory grows with the grids and not with the number of photons, and
+ * several traces in a row accumulate.
+ *
+ * Bins count hits and sum their weights, which are the counts unless the
+ * rays carry weights (see RayTracer::setWeighted); the flux is that of the
+ * weights. Counts and whole weights are exact in any order; fractional
+ * weights summed per worker are not, so beginChunks() sums them per chunk
+ * in a ChunkReduction instead, and totals do not depend on the workers.
+ * With setExactWeights() workers sum the weights as integers of 2^-32
+ * instead, exact in any order, so totals depend neither on the workers nor
+ * on the chunks.
+ *
+ * Targets are given by URL and resolved by bind() in the instance tree that
+ * is traced, which may be rebuilt for every trace.
+ */
+class TONATIUH_KERNEL FluxAccumulator
+{
+public:
+    using HitCallback = std::function<void(const RayTracerHit&)>;
+
+    struct Target
+    {
+        QString url;
+        bool isFront;
+        int rows; // along u
+        int cols; // along v
+        Box2D window; // (u, v) binned, invalid for the box of the profile
+    };
+
+    // a bin on the surface, in world frame
+    struct Bin
+    {
+        vec3d point;  // at the center of the cell in (u, v)
+        vec3d normal; // of the side binned
+        double area;
+    };
+
+    FluxAccumulator();
+    ~FluxAccumulator();
+
+    void addTarget(const QString& url, bool isFront, int rows, int cols, const Box2D& window = Box2D());
+    // before beginWorkers; weights are rounded to 2^-32 each
+    void setExactWeights(bool exact) {m_exactWeights = exact;}
+    int getTargetCount() const {return int(m_targets.size());}
+    const Target& getTarget(int n) const {return m_targets[n].target;}
+
+    bool bind(InstanceNode* root, QString* error = nullptr);
+    void beginWorkers(int workers);
+    HitCallback hitCallback(int worker);
+    // as the callback of worker, for tracers that bin without one
+    void addHit(int worker, const RayTracerHit& hit) {addHit(*m_workers[size_t(worker)], hit);}
+    void prepareWorker(int worker); // on the thread of the worker
+    // after beginWorkers, the weights of chunks [first, end) are summed by
+    // chunk; endChunk hands those of the worker over, on its thread
+    void beginChunks(qulonglong first, qulonglong end);
+    void endChunk(int worker, qulonglong chunk);
+    void endWorkers();
+    void clear();
+    // bytes of the grids of the totals and of the workers
+    qulonglong getMemoryUsage() const;
+
+    // checkpoints of a trace: the worker grids so far, read while no worker
+    // is adding hits, and saved counts added back to the totals
+    std::vector<qulonglong> getWorkerCounts(int n, qulonglong* hits) const;
+    bool addCounts(int n, const std::vector<qulonglong>& counts, qulonglong hits);
+    // weights of a model instead of hits, one per bin, counting no hit
+    bool addWeights(int n, const std::vector<double>& weights);
+    // adds to bin k what bin mirrors[k] gained since it held counts,
+    // weights and hits, for a trace of half a symmetric field, see MirrorSymmetry
+    bool addMirrored(int n, const std::vector<int>& mirrors, const std::vector<qulonglong>& counts,
+                     const std::vector<double>& weights, qulonglong hits);
+
+    // while bound, row-major as the counts
+    std::vector<Bin> getBins(int n) const;
+    InstanceNode* getSurface(int n) const {return m_targets[n].surface;}
+
+    // hits per bin, row-major with rows along u
+    const std::vector<qulonglong>& getCounts(int n) const {return m_targets[n].counts;}
+    // sums of the hit weights per bin, as the counts
+    const std::vector<double>& getWeights(int n) const {return m_targets[n].weights;}
+    double getTotalWeight(int n) const;
+    qulonglong getHits(int n) const {return m_targets[n].hits;}
+    const Box2D& getBox(int n) const {return m_targets[n].box;}
+    // W/m2 per bin, from the area of each cell on the surface; the areas are
+    // found once after every bind
+    std::vector<double> getFlux(int n, double powerPerRay) const;
+    // the same into values, one per bin
+    void getFlux(int n, double powerPerRay, double* values) const;
+
+private:
+    struct TargetData
+    {
+        Target target;
+        InstanceNode* surface = nullptr; // valid while bound
+        ShapeRT* shape = nullptr;
+        Transform toWorld;
+        Transform toObject;
+        Box2D box;
+        mutable std::vector<double> areas; // per bin, filled by getFlux
+        std::vector<qulonglong> counts;
+        std::vector<double> weights;
+        qulonglong hits = 0;
+        std::size_t offset = 0; // in the weights of the workers
+    };
+
+    struct Worker
+    {
+        std::vector<std::vector<qulonglong>> counts; // per target
+        std::vector<double> weights; // of all targets
+        std::vector<quint64> exactWeights; // of all targets, in 2^-32 with exact weights
+        std::vector<qulonglong> hits;
+    };
+
+    void addHit(Worker& worker, const RayTracerHit& hit) const;
+    void findAreas(const TargetData& data) const;
+
+    std::vector<TargetData> m_targets;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::size_t m_bins = 0; // of all targets
+    bool m_chunked = false;
+    bool m_exactWeights = false;
+    ChunkReduction m_reduction;
+};
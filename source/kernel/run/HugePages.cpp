@@ -0,0 +1,67 @@
+#include "HugePages.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#if defined(Q_OS_LINUX)
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+std::atomic<bool> s_enabled(false);
+
+bool fail(QString* errorMessage, const QString& message)
+{
+    if (errorMessage) *errorMessage = message;
+    return false;
+}
+
+}
+
+
+void HugePages::setEnabled(bool on)
+{
+    s_enabled = on;
+}
+
+bool HugePages::isEnabled()
+{
+    return s_enabled;
+}
+
+bool HugePages::advise(const void* data, size_t bytes)
+{
+#if defined(Q_OS_LINUX) && defined(MADV_HUGEPAGE)
+    std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(data);
+    std::uintptr_t end = begin + bytes;
+    begin = (begin + PageSize - 1) & ~std::uintptr_t(PageSize - 1);
+    end &= ~std::uintptr_t(PageSize - 1);
+    if (end <= begin) return false;
+    return madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE) == 0;
+#else
+    Q_UNUSED(data)
+    Q_UNUSED(bytes)
+    return false;
+#endif
+}
+
+bool HugePages::lockAll(QString* errorMessage)
+{
+#if defined(Q_OS_LINUX)
+    if (mlockall(MCL_CURRENT) != 0)
+        return fail(errorMessage, QString("Cannot lock memory: %1.").arg(QString::fromLocal8Bit(std::strerror(errno))));
+    return true;
+#else
+    return fail(errorMessage, "Locking memory is only supported on Linux.");
+#endif
+}
+
+void HugePages::unlockAll()
+{
+#if defined(Q_OS_LINUX)
+    munlockall();
+#endif
+}
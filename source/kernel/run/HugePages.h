@@ -0,0 +1,70 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <iterator>
+#include <vector>
+
+#include <QString>
+
+
+//! HugePages backs the large read-only arrays of the tracer with huge pages.
+/*!
+ * When enabled, arrays of at least PageSize bytes reserved through reserve()
+ * or assign() are advised as transparent huge pages before they are first
+ * touched, so the kernel can fault them in 2 MB at a time and traversal
+ * takes fewer TLB misses. The advice is taken when the system allows
+ * transparent huge pages for madvise regions; otherwise, and outside Linux,
+ * the arrays keep normal pages. Disabled, both calls are those of the vector.
+ *
+ * lockAll() faults in and locks every page of the process, so a timed run
+ * does not wait for page faults; it fails without the memory lock limit.
+ */
+class TONATIUH_KERNEL HugePages
+{
+public:
+    static const size_t PageSize = size_t(2) << 20;
+
+    // for arrays reserved from now on
+    static void setEnabled(bool on);
+    static bool isEnabled();
+
+    // capacity for n elements, the elements kept
+    template<class T>
+    static void reserve(std::vector<T>& values, size_t n);
+    // values replaced by [begin, end)
+    template<class T, class It>
+    static void assign(std::vector<T>& values, It begin, It end);
+
+    // huge pages for the aligned pages of [data, data + bytes), false if refused
+    static bool advise(const void* data, size_t bytes);
+
+    // pages mapped now faulted in and kept in memory, false if refused
+    static bool lockAll(QString* errorMessage = nullptr);
+    static void unlockAll();
+};
+
+
+
+template<class T>
+void HugePages::reserve(std::vector<T>& values, size_t n)
+{
+    if (!isEnabled() || n <= values.capacity() || n*sizeof(T) < PageSize) {
+        values.reserve(n);
+        return;
+    }
+    // advised before the elements touch the pages
+    std::vector<T> ans;
+    ans.reserve(n);
+    advise(ans.data(), n*sizeof(T));
+    ans.insert(ans.end(), values.begin(), values.end());
+    values.swap(ans);
+}
+
+template<class T, class It>
+void HugePages::assign(std::vector<T>& values, It begin, It end)
+{
+    values.clear();
+    reserve(values, size_t(std::distance(begin, end)));
+    values.assign(begin, end);
+}
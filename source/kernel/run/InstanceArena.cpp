@@ -0,0 +1,51 @@
+#include "InstanceArena.h"
+
+#include <new>
+
+#include "InstanceNode.h"
+
+
+InstanceArena::InstanceArena():
+    m_count(0)
+{
+}
+
+InstanceArena::~InstanceArena()
+{
+    // destructors of arena nodes free their child lists only
+    for (Block& block : m_blocks) {
+        for (int n = 0; n < block.count; ++n)
+            block.nodes[n].~InstanceNode();
+        ::operator delete(block.nodes);
+    }
+}
+
+InstanceNode* InstanceArena::create(SoNode* node)
+{
+    if (m_blocks.empty() || m_blocks.back().count == BlockSize)
+        m_blocks.push_back({static_cast<InstanceNode*>(::operator new(BlockSize*sizeof(InstanceNode))), 0});
+    Block& block = m_blocks.back();
+    InstanceNode* ans = new (block.nodes + block.count) InstanceNode(node);
+    ans->m_arena = true;
+    block.count++;
+    m_count++;
+    return ans;
+}
+
+/*!
+ * The blocks of \a other are appended as they are, the last one partly
+ * filled, so creating nodes goes on in it; no node moves.
+ */
+void InstanceArena::merge(InstanceArena& other)
+{
+    if (&other == this) return;
+    m_blocks.insert(m_blocks.end(), other.m_blocks.begin(), other.m_blocks.end());
+    m_count += other.m_count;
+    other.m_blocks.clear();
+    other.m_count = 0;
+}
+
+qulonglong InstanceArena::getMemoryUsage() const
+{
+    return qulonglong(m_blocks.size())*BlockSize*sizeof(InstanceNode);
+}
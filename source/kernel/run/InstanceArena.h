@@ -0,0 +1,53 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include <QtGlobal>
+
+class InstanceNode;
+class SoNode;
+
+//! InstanceArena allocates the InstanceNode objects of a compiled tree.
+/*!
+ * Nodes are placed in blocks of contiguous storage in the order they are
+ * made, so the children of an instance, made together by
+ * SceneInstanceBuilder, sit next to each other with their boxes and
+ * transforms. Nodes of an arena are not deleted one by one: the arena frees
+ * them all with its blocks, without walking the tree.
+ *
+ * Trees kept by SceneTreeModel are edited row by row and stay on the heap;
+ * the nodes of one tree come from one of the two only.
+ *
+ * An arena is used by one thread at a time. Threads building subtrees
+ * together fill arenas of their own, then merge moves their blocks into
+ * the arena of the tree.
+ */
+class TONATIUH_KERNEL InstanceArena
+{
+public:
+    InstanceArena();
+    ~InstanceArena();
+    InstanceArena(const InstanceArena&) = delete;
+    InstanceArena& operator=(const InstanceArena&) = delete;
+
+    InstanceNode* create(SoNode* node);
+    // takes the nodes of other, which is left empty
+    void merge(InstanceArena& other);
+
+    int getCount() const {return m_count;}
+    qulonglong getMemoryUsage() const;
+
+private:
+    static const int BlockSize = 1024; // nodes
+
+    // merged blocks may be partly filled
+    struct Block
+    {
+        InstanceNode* nodes;
+        int count;
+    };
+    std::vector<Block> m_blocks;
+    int m_count;
+};
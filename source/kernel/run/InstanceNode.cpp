@@ -1,6 +1,10 @@
 #include "InstanceNode.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include <QDataStream>
 #include <QtAlgorithms>
@@ -20,6 +24,14 @@
 #include "shape/DifferentialGeometry.h"
 #include "sun/SunKit.h"
 #include "trackers/TrackerArmature.h"
+#include "TraceStatistics.h"
+
+namespace {
+
+// subtrees per thread below which they are updated on the calling thread
+const int UpdateGrain = 64;
+
+} // namespace
 
 InstanceNode::InstanceNode(SoNode* node)
     : m_node(node)
@@ -29,7 +41,7 @@ InstanceNode::InstanceNode(SoNode* node)
 
 InstanceNode::~InstanceNode()
 {
-    qDeleteAll(children);
+    if (!m_arena) qDeleteAll(children);
 }
 
 /**
@@ -54,7 +66,7 @@ void InstanceNode::insertChild(int row, InstanceNode* child)
 
 void InstanceNode::replaceChild(int row, InstanceNode* child)
 {
-    delete children[row];
+    if (!children[row]->m_arena) delete children[row];
     children[row] = child;
     child->m_parent = this;
 }
@@ -90,15 +102,47 @@ void InstanceNode::Print(int level) const
         child->Print(level + 1); // was level++
 }
 
-bool InstanceNode::intersect(const Ray& rayIn, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut)
+/**
+ * Finds the closest hit below this instance and shades it: the ray leaving
+ * the material is \a rayOut, returns whether there is one.
+ **/
+bool InstanceNode::intersect(const Ray& rayIn, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight)
+{
+    InstanceHit hit;
+    if (!findHit(rayIn, hit)) return false;
+
+    const Affine3D& transform = hit.instance->m_transform;
+    DifferentialGeometry& dg = hit.dg;
+    dg.point = transform.transformPoint(dg.point);
+    dg.dpdu = transform.transformVector(dg.dpdu);
+    dg.dpdv = transform.transformVector(dg.dpdv);
+    dg.normal = transform.transformNormal(dg.normal);
+
+    isFront = dg.isFront;
+    instance = hit.instance;
+
+    TShapeKit* kit = (TShapeKit*) hit.instance->m_node;
+    MaterialRT* material = (MaterialRT*) kit->materialRT.getValue();
+    if (weight)
+        return material->OutputRayWeighted(rayIn, dg, rand, rayOut, *weight);
+    return material->OutputRay(rayIn, dg, rand, rayOut);
+}
+
+/**
+ * Records the closest hit below this instance with t < ray.tMax, which
+ * becomes its t. Only the hit is kept, so materials are evaluated once,
+ * for the surface that wins, as in SceneBVH.
+ **/
+bool InstanceNode::findHit(const Ray& ray, InstanceHit& hit)
 {
-    if (!m_box.intersect(rayIn)) return false;
+    TRACE_STATS(boxTests++);
+    if (!m_box.intersect(ray)) return false;
 
     InstanceNode* instance1 = this;
     while (instance1->children.size() == 1)
         instance1 = instance1->children[0];
     if (instance1 != this)
-        return instance1->intersect(rayIn, rand, isFront, instance, rayOut);
+        return instance1->findHit(ray, hit);
 
     // if (TShapeKit* kit = dynamic_cast<TShapeKit*>(m_node)) // slower
     if (m_node->getTypeId() == TShapeKit::getClassTypeId()) // faster
@@ -113,45 +157,57 @@ bool InstanceNode::intersect(const Ray& rayIn, Random& rand, bool& isFront, Inst
         if (!shape) return false;
         ProfileRT* profile = (ProfileRT*) kit->profileRT.getValue();
 
-        Ray rayLocal = m_transform.transformInverse(rayIn);
+        Ray rayLocal = m_transform.transformInverse(ray);
         double tHit = 0.;
         DifferentialGeometry dg;
+        TRACE_STATS(addShapeTest(shape->getTypeName()));
         if (!shape->intersect(rayLocal, &tHit, &dg, profile)) return false;
 
-        rayIn.tMax = tHit;
-        isFront = dg.isFront;
-        instance = this;
+        ray.tMax = tHit;
+        hit.instance = this;
+        hit.dg = dg;
+        return true;
+    }
+    else if (m_node->getTypeId() == TSeparatorKit::getClassTypeId())
+    {
+        // tMax is mutable, so later children are cut by closer hits
+        bool ans = false;
+        for (InstanceNode* instanceChild : children)
+            if (instanceChild->findHit(ray, hit)) ans = true;
+        return ans;
+    }
 
-        dg.point = m_transform.transformPoint(dg.point);
-        dg.dpdu = m_transform.transformVector(dg.dpdu);
-        dg.dpdv = m_transform.transformVector(dg.dpdv);
-        dg.normal = m_transform.transformNormal(dg.normal);
+    return false;
+}
+
+bool InstanceNode::occluded(const Ray& ray) const
+{
+    if (!m_box.intersect(ray)) return false;
 
-        return material->OutputRay(rayIn, dg, rand, rayOut);
+    const InstanceNode* instance1 = this;
+    while (instance1->children.size() == 1)
+        instance1 = instance1->children[0];
+    if (instance1 != this)
+        return instance1->occluded(ray);
+
+    if (m_node->getTypeId() == TShapeKit::getClassTypeId())
+    {
+        TShapeKit* kit = (TShapeKit*) m_node;
+
+        MaterialRT* material = (MaterialRT*) kit->materialRT.getValue();
+        if (!material) return false;
+        if (material->getTypeId() == MaterialTransparent::getClassTypeId()) return false;
+
+        ShapeRT* shape = (ShapeRT*) kit->shapeRT.getValue();
+        if (!shape) return false;
+        ProfileRT* profile = (ProfileRT*) kit->profileRT.getValue();
+        return shape->intersectP(m_transform.transformInverse(ray), profile);
     }
     else if (m_node->getTypeId() == TSeparatorKit::getClassTypeId())
     {
-        bool hasRayOut = false;
-        double t = rayIn.tMax;
-
         for (InstanceNode* instanceChild : children)
-        {
-            Ray rayOutChild;
-            bool isFrontChild = true;
-            bool hasRayOutChild = instanceChild->intersect(rayIn, rand, isFrontChild, instanceChild, rayOutChild);
-
-            if (rayIn.tMax < t) // tMax mutable
-            {
-                t = rayIn.tMax;
-                isFront = isFrontChild;
-                instance = instanceChild;
-                hasRayOut = hasRayOutChild;
-                rayOut = rayOutChild;
-            }
-        }
-        return hasRayOut;
+            if (instanceChild->occluded(ray)) return true;
     }
-
     return false;
 }
 
@@ -166,35 +222,147 @@ void InstanceNode::extendBoxForLight(SbBox3f* extendedBox)
 
 /**
  * Set node world to object transform to \a nodeTransform .
+ * Subtrees unchanged since the previous call are skipped.
  */
 void InstanceNode::updateTree(const Transform& tParent)
 {
-    if (TSeparatorKit* separatorKit = dynamic_cast<TSeparatorKit*>(m_node))
+    readSubtree();
+
+    // the first levels here, with the transforms of their children
+    struct Task
     {
-        TTransform* t = SO_GET_PART(separatorKit, "transform", TTransform);
-        m_transform = tParent * tgf::makeTransform(t);
+        InstanceNode* node;
+        Transform tParent;
+    };
+    const int threads = std::max(1, int(std::thread::hardware_concurrency()));
+    std::vector<Task> level = {{this, tParent}};
+    std::vector<InstanceNode*> separators; // to merge the boxes of, parents first
+    while (!level.empty() && int(level.size()) < threads*UpdateGrain) {
+        std::vector<Task> next;
+        for (const Task& task : level) {
+            Transform transform;
+            if (!task.node->updateNode(task.tParent, transform)) continue;
+            separators.push_back(task.node);
+            for (InstanceNode* child : task.node->children)
+                next.push_back({child, transform});
+        }
+        level.swap(next);
+    }
 
+    const int workers = std::min(threads, int(level.size())/UpdateGrain);
+    if (workers <= 1) {
+        for (const Task& task : level)
+            task.node->updateSubtree(task.tParent);
+    } else {
+        std::atomic<size_t> next(0);
+        auto update = [&]() {
+            for (size_t n = next++; n < level.size(); n = next++)
+                level[n].node->updateSubtree(level[n].tParent);
+        };
+        std::vector<std::thread> pool;
+        for (int w = 1; w < workers; ++w)
+            pool.emplace_back(update);
+        update();
+        for (std::thread& thread : pool)
+            thread.join();
+    }
+
+    for (auto it = separators.rbegin(); it != separators.rend(); ++it) {
         Box3D box;
-        for (InstanceNode* child : children)
-        {
-            child->updateTree(m_transform);
+        for (InstanceNode* child : (*it)->children)
             box.expand(child->m_box);
-        }
-        m_box = box;
+        (*it)->m_box = box;
     }
-    else if (TShapeKit* shapeKit = dynamic_cast<TShapeKit*>(m_node))
+}
+
+void InstanceNode::updateSubtree(const Transform& tParent)
+{
+    Transform transform;
+    if (!updateNode(tParent, transform)) return;
+    Box3D box;
+    for (InstanceNode* child : children)
     {
-        TShapeKit* kit = (TShapeKit*) m_node;
+        child->updateSubtree(transform);
+        box.expand(child->m_box);
+    }
+    m_box = box;
+}
 
-        if (TTransform* t = (TTransform*) shapeKit->getPart("transform", false))
-            m_transform = tParent * tgf::makeTransform(t);
+void InstanceNode::readSubtree()
+{
+    SbUniqueId nodeId = m_node ? m_node->getNodeId() : 0;
+    if (m_kind != KindUnknown && nodeId == m_readId) return;
+    m_readId = nodeId;
+
+    if (m_kind == KindUnknown) {
+        if (dynamic_cast<TSeparatorKit*>(m_node))
+            m_kind = KindSeparator;
+        else if (dynamic_cast<TShapeKit*>(m_node))
+            m_kind = KindShape;
         else
-            m_transform = tParent;
+            m_kind = KindOther;
+    }
+
+    if (m_kind == KindSeparator)
+    {
+        TSeparatorKit* separatorKit = (TSeparatorKit*) m_node;
+        m_hasTransform = true;
+        m_matrix = SbMatrix::identity();
+        if (TTransform* t = (TTransform*) separatorKit->getPart("transform", false))
+            m_matrix = tgf::makeSbMatrix(t);
+    }
+    else if (m_kind == KindShape)
+    {
+        TShapeKit* kit = (TShapeKit*) m_node;
+        TTransform* t = (TTransform*) kit->getPart("transform", false);
+        m_hasTransform = t;
+        if (t) m_matrix = tgf::makeSbMatrix(t);
 
         ShapeRT* shape = (ShapeRT*) kit->shapeRT.getValue();
         ProfileRT* profile = (ProfileRT*) kit->profileRT.getValue();
-        m_box = m_transform(shape->getBox(profile));
+        m_boxShape = shape ? shape->getBox(profile) : Box3D();
+    }
+
+    for (InstanceNode* child : children)
+        child->readSubtree();
+}
+
+bool InstanceNode::updateNode(const Transform& tParent, Transform& transform)
+{
+    Affine3D transformParent(tParent);
+    if (m_isUpdated && m_readId == m_nodeId &&
+        std::equal(&transformParent.mdir[0][0], &transformParent.mdir[0][0] + 12, &m_transformParent.mdir[0][0]))
+        return false;
+    m_isUpdated = true;
+    m_nodeId = m_readId;
+    m_transformParent = transformParent;
+
+    if (m_kind == KindSeparator)
+    {
+        transform = tParent * tgf::makeTransform(m_matrix);
+        m_transform = Affine3D(transform);
+        return true;
     }
+    else if (m_kind == KindShape)
+    {
+        transform = tParent;
+        if (m_hasTransform)
+            transform = tParent * tgf::makeTransform(m_matrix);
+        m_transform = Affine3D(transform);
+        m_box = transform(m_boxShape);
+    }
+    return false;
+}
+
+/**
+ * Makes the next updateTree recompute the whole subtree.
+ */
+void InstanceNode::invalidateTree()
+{
+    m_kind = KindUnknown;
+    m_isUpdated = false;
+    for (InstanceNode* child : children)
+        child->invalidateTree();
 }
 
 void InstanceNode::collectShapeTransforms(QStringList disabledNodes, QVector<QPair<TShapeKit*, Transform>>& shapes)
@@ -208,7 +376,7 @@ void InstanceNode::collectShapeTransforms(QStringList disabledNodes, QVector<QPa
     }
     else if (TShapeKit* shape = dynamic_cast<TShapeKit*>(m_node))
     {
-        shapes << QPair<TShapeKit*, Transform>(shape, m_transform);
+        shapes << QPair<TShapeKit*, Transform>(shape, getTransform());
     }
 }
 
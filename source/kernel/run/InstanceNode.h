@@ -9,20 +9,49 @@
 #include <QDataStream>
 
 #include <Inventor/SbBox3f.h>
+#include <Inventor/SbMatrix.h>
 
 #include "libraries/math/3D/Box3D.h"
 #include "libraries/math/3D/Transform.h"
+#include "libraries/math/3D/Affine3D.h"
+#include "kernel/shape/DifferentialGeometry.h"
 
+class InstanceNode;
 class Random;
 class Ray;
 class SoNode;
 class TShapeKit;
 
+// the closest hit of InstanceNode::findHit, before shading
+struct TONATIUH_KERNEL InstanceHit
+{
+    InstanceNode* instance = nullptr; // of the shape hit
+    DifferentialGeometry dg; // in the frame of the shape
+};
+
 //! InstanceNode class represents an instance of a node in the scene.
 /*!
  * In a scene, a node can be shared by more than one parent. Each of these shared
  * instances is represented in a scene as an InstanceNode object.
  * Any change made within a shared node is reflected in all node's InstanceNode.
+ *
+ * updateTree is incremental: a subtree is skipped when its parent transform
+ * and the Coin node id of its root are those of the previous update.
+ * Coin renews the id of a node on every notification and passes notifications
+ * up to the auditing kits, so a moved tracker or an edited shape renews the ids
+ * along its path only. Call invalidateTree after changes made with
+ * notification disabled.
+ *
+ * Coin nodes are not safe to read from several threads, so updateTree first
+ * reads the kind, the transform part and the shape box of the changed nodes
+ * on the calling thread. A large tree is then updated on all processors: its
+ * first levels breadth first, until they hold enough subtrees, then the
+ * subtrees in parallel, each thread taking the next one not updated, and the
+ * boxes of the first levels merged from their children at the end. The
+ * threads only compose transforms and boxes.
+ *
+ * Nodes made by an InstanceArena belong to it and do not delete their
+ * children; nodes made with new delete theirs.
  */
 class TONATIUH_KERNEL InstanceNode
 {
@@ -31,7 +60,7 @@ public:
     ~InstanceNode();
 
     SoNode* getNode() const { return m_node; }
-    void setNode(SoNode* node) { m_node = node; }
+    void setNode(SoNode* node) { m_node = node; m_kind = KindUnknown; m_isUpdated = false; }
 
     InstanceNode* getParent() const { return m_parent; }
     void setParent(InstanceNode* parent) { m_parent = parent; }
@@ -39,8 +68,9 @@ public:
     const Box3D& getBox() const { return m_box; }
     void setBox(const Box3D& box) { m_box = box; }
 
-    const Transform& getTransform() const { return m_transform; }
-    void setTransform(const Transform& t) { m_transform = t; }
+    Transform getTransform() const { return m_transform.toTransform(); }
+    void setTransform(const Transform& t) { m_transform = Affine3D(t); }
+    const Affine3D& getAffine() const { return m_transform; }
 
     void addChild(InstanceNode* child);
     void insertChild(int row, InstanceNode* child);
@@ -50,20 +80,50 @@ public:
     QString getURL() const;
     void Print(int level) const;
 
-    bool intersect(const Ray& rayIn, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut);
+    // with weight the material is evaluated by MaterialRT::OutputRayWeighted
+    bool intersect(const Ray& rayIn, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight = nullptr);
+    // closest hit with t < ray.tMax, which is set to it; no material is evaluated
+    bool findHit(const Ray& ray, InstanceHit& hit);
+    // any hit of an opaque shape with t < ray.tMax
+    bool occluded(const Ray& ray) const;
 
     void extendBoxForLight(SbBox3f* extendedBox);
 
     void updateTree(const Transform& tParent);
+    void invalidateTree();
     void collectShapeTransforms(QStringList disabledNodes, QVector<QPair<TShapeKit*, Transform>>& shapes);
 
     QVector<InstanceNode*> children;
 
 private:
+    friend class InstanceArena;
+
     SoNode* m_node = nullptr;
     InstanceNode* m_parent = nullptr;
     Box3D m_box;            // in world frame
-    Transform m_transform;  // from object to world
+    Affine3D m_transform;   // from object to world
+
+    // Coin data read by readSubtree, as of the node id m_readId
+    enum Kind {KindUnknown, KindSeparator, KindShape, KindOther};
+    Kind m_kind = KindUnknown;
+    SbUniqueId m_readId = 0;
+    bool m_hasTransform = false; // else the transform of the parent
+    SbMatrix m_matrix;           // of the transform part
+    Box3D m_boxShape;            // in the frame of the shape
+
+    // state of the last updateTree, to skip unchanged subtrees
+    bool m_isUpdated = false;
+    SbUniqueId m_nodeId = 0;
+    Affine3D m_transformParent;
+    bool m_arena = false;
+
+    // reads the Coin data of the nodes changed since the last read,
+    // on the thread owning the scene
+    void readSubtree();
+    // updates this node but not its children, false if they are not to be
+    // updated within transform; reads no Coin node
+    bool updateNode(const Transform& tParent, Transform& transform);
+    void updateSubtree(const Transform& tParent);
 };
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
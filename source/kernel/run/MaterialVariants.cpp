@@ -0,0 +1,20 @@
+#include "MaterialVariants.h"
+
+
+MaterialVariants::MaterialVariants():
+    m_replacements(1)
+{
+}
+
+int MaterialVariants::addVariant()
+{
+    m_replacements.emplace_back();
+    return getCount() - 1;
+}
+
+void MaterialVariants::replace(int variant, const MaterialRT* material, MaterialRT* replacement)
+{
+    if (variant <= 0 || variant >= getCount()) return;
+    m_replacements[size_t(variant)].insert(material, replacement);
+    m_varied.insert(material);
+}
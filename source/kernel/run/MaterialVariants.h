@@ -0,0 +1,48 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include <QHash>
+#include <QSet>
+
+class MaterialRT;
+
+
+//! MaterialVariants are versions of a scene that differ in some materials.
+/*!
+ * Variant 0 is the scene itself; every other variant replaces some of its
+ * materials by others, such as copies with another slope error or
+ * reflectivity. A tracer given the variants traces every ray for each of
+ * them with the same random numbers, see RayTracer::setMaterialVariants,
+ * so the flux of two variants differs by what their materials do, not by
+ * the noise of two traces.
+ *
+ * The replacements are not owned.
+ */
+class TONATIUH_KERNEL MaterialVariants
+{
+public:
+    MaterialVariants();
+
+    // a variant with the materials of the scene, to be replaced
+    int addVariant();
+    int getCount() const {return int(m_replacements.size());}
+    bool isEmpty() const {return m_replacements.size() < 2;}
+
+    // variant draws with replacement where the scene has material
+    void replace(int variant, const MaterialRT* material, MaterialRT* replacement);
+    // the material of variant for material of the scene
+    MaterialRT* find(int variant, MaterialRT* material) const
+    {
+        if (variant == 0) return material;
+        return m_replacements[size_t(variant)].value(material, material);
+    }
+    // whether some variant replaces material
+    bool isVaried(const MaterialRT* material) const {return m_varied.contains(material);}
+
+private:
+    std::vector<QHash<const MaterialRT*, MaterialRT*>> m_replacements;
+    QSet<const MaterialRT*> m_varied;
+};
@@ -0,0 +1,172 @@
+#include "MemoryUsage.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <QtGlobal>
+
+#if defined(Q_OS_LINUX)
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+#elif defined(Q_OS_MACOS)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+#if defined(TONATIUHPP_COUNT_ALLOCATIONS)
+namespace {
+
+std::atomic<qulonglong> s_allocations(0);
+
+void* allocate(std::size_t bytes)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(bytes > 0 ? bytes : 1);
+}
+
+void* allocate(std::size_t bytes, std::align_val_t alignment)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t a = static_cast<std::size_t>(alignment);
+#if defined(Q_OS_WIN)
+    return _aligned_malloc(bytes > 0 ? bytes : 1, a);
+#else
+    // aligned_alloc takes a multiple of the alignment
+    return std::aligned_alloc(a, bytes > 0 ? (bytes + a - 1)/a*a : a);
+#endif
+}
+
+void release(void* p)
+{
+    std::free(p);
+}
+
+void release(void* p, std::align_val_t)
+{
+#if defined(Q_OS_WIN)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+// operator new retries through the new handler, as the one it replaces
+template<class... Alignment>
+void* allocateOrThrow(std::size_t bytes, Alignment... alignment)
+{
+    for (;;) {
+        if (void* p = allocate(bytes, alignment...))
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+template<class... Alignment>
+void* allocateOrNull(std::size_t bytes, Alignment... alignment) noexcept
+{
+    try {
+        return allocateOrThrow(bytes, alignment...);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+} // namespace
+
+void* operator new(std::size_t bytes) {return allocateOrThrow(bytes);}
+void* operator new[](std::size_t bytes) {return allocateOrThrow(bytes);}
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept {return allocateOrNull(bytes);}
+void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept {return allocateOrNull(bytes);}
+void* operator new(std::size_t bytes, std::align_val_t alignment) {return allocateOrThrow(bytes, alignment);}
+void* operator new[](std::size_t bytes, std::align_val_t alignment) {return allocateOrThrow(bytes, alignment);}
+void* operator new(std::size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {return allocateOrNull(bytes, alignment);}
+void* operator new[](std::size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {return allocateOrNull(bytes, alignment);}
+
+void operator delete(void* p) noexcept {release(p);}
+void operator delete[](void* p) noexcept {release(p);}
+void operator delete(void* p, std::size_t) noexcept {release(p);}
+void operator delete[](void* p, std::size_t) noexcept {release(p);}
+void operator delete(void* p, const std::nothrow_t&) noexcept {release(p);}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {release(p);}
+void operator delete(void* p, std::align_val_t alignment) noexcept {release(p, alignment);}
+void operator delete[](void* p, std::align_val_t alignment) noexcept {release(p, alignment);}
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept {release(p, alignment);}
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept {release(p, alignment);}
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept {release(p, alignment);}
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept {release(p, alignment);}
+#endif
+
+
+qulonglong MemoryUsage::getResidentBytes()
+{
+#if defined(Q_OS_LINUX)
+    // pages of the total and of the resident sets
+    std::FILE* file = std::fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    unsigned long long pages = 0;
+    unsigned long long resident = 0;
+    const bool read = std::fscanf(file, "%llu %llu", &pages, &resident) == 2;
+    std::fclose(file);
+    return read ? qulonglong(resident)*qulonglong(sysconf(_SC_PAGESIZE)) : 0;
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return qulonglong(info.resident_size);
+#elif defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return qulonglong(counters.WorkingSetSize);
+#else
+    return 0;
+#endif
+}
+
+qulonglong MemoryUsage::getPeakResidentBytes()
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(Q_OS_LINUX)
+    return qulonglong(usage.ru_maxrss)*1024; // in kB
+#else
+    return qulonglong(usage.ru_maxrss);
+#endif
+#elif defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return qulonglong(counters.PeakWorkingSetSize);
+#else
+    return 0;
+#endif
+}
+
+bool MemoryUsage::isCounting()
+{
+#if defined(TONATIUHPP_COUNT_ALLOCATIONS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+qulonglong MemoryUsage::getAllocations()
+{
+#if defined(TONATIUHPP_COUNT_ALLOCATIONS)
+    return s_allocations.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <qglobal.h>
+
+
+//! MemoryUsage reads the resident memory of the process and counts its heap allocations.
+/*!
+ * The resident sizes are those the system reports: the peak is the high
+ * water mark of the process since it started, never lowered, so a run
+ * reading it at its end sees the largest of its own and of what loaded
+ * before it. Both are 0 where the system does not tell.
+ *
+ * Heap allocations are counted only in builds with
+ * TONATIUHPP_ENABLE_ALLOCATION_COUNT, which replace the global operator new
+ * of the kernel with one adding to a process-wide counter; a run reads it
+ * before and after its timed phase. With ELF and Mach-O the replacement
+ * serves the whole process, on Windows the allocations of the kernel only.
+ */
+class TONATIUH_KERNEL MemoryUsage
+{
+public:
+    static qulonglong getResidentBytes();
+    static qulonglong getPeakResidentBytes();
+
+    // whether this build counts heap allocations
+    static bool isCounting();
+    // allocations by operator new so far, 0 if not counting
+    static qulonglong getAllocations();
+};
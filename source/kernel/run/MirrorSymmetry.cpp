@@ -0,0 +1,74 @@
+#include "MirrorSymmetry.h"
+
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+struct CellHash
+{
+    size_t operator()(const std::array<long long, 3>& c) const
+    {
+        size_t h = std::hash<long long>()(c[0]);
+        h = h*31 + std::hash<long long>()(c[1]);
+        return h*31 + std::hash<long long>()(c[2]);
+    }
+};
+
+} // namespace
+
+
+MirrorSymmetry::MirrorSymmetry(const vec3d& normal, double offset):
+    m_normal(normal.normalized()),
+    m_offset(offset)
+{
+}
+
+/*!
+ * The points are hashed into cubes of side tolerance, so the image of a
+ * point is looked for in the 27 cubes around it.
+ */
+std::vector<int> MirrorSymmetry::findMirrors(const std::vector<vec3d>& points, double tolerance) const
+{
+    std::vector<int> ans;
+    if (points.empty() || !(tolerance > 0.)) return ans;
+
+    auto cellOf = [tolerance](const vec3d& p) {
+        return std::array<long long, 3>{
+            (long long) std::floor(p.x/tolerance),
+            (long long) std::floor(p.y/tolerance),
+            (long long) std::floor(p.z/tolerance)
+        };
+    };
+    std::unordered_map<std::array<long long, 3>, std::vector<int>, CellHash> cells;
+    for (int n = 0; n < int(points.size()); ++n)
+        cells[cellOf(points[n])].push_back(n);
+
+    ans.reserve(points.size());
+    for (const vec3d& point : points)
+    {
+        const vec3d image = reflect(point);
+        const std::array<long long, 3> c = cellOf(image);
+        int nearest = -1;
+        double nearestDistance = tolerance*tolerance;
+        for (long long i = c[0] - 1; i <= c[0] + 1; ++i) {
+            for (long long j = c[1] - 1; j <= c[1] + 1; ++j) {
+                for (long long k = c[2] - 1; k <= c[2] + 1; ++k) {
+                    auto it = cells.find({i, j, k});
+                    if (it == cells.end()) continue;
+                    for (int m : it->second) {
+                        double d = (points[m] - image).norm2();
+                        if (d <= nearestDistance) {
+                            nearestDistance = d;
+                            nearest = m;
+                        }
+                    }
+                }
+            }
+        }
+        if (nearest < 0) return std::vector<int>();
+        ans.push_back(nearest);
+    }
+    return ans;
+}
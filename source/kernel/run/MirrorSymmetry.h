@@ -0,0 +1,42 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include "libraries/math/3D/vec3d.h"
+
+
+//! MirrorSymmetry is a plane a scene is declared mirror-symmetric about.
+/*!
+ * A field symmetric about a plane that holds the sun direction sends the
+ * same flux to a point and to its mirror image. Rays from the half of the
+ * sun aperture on the positive side of the plane then give the flux of the
+ * other half as the image of their own, so half the rays reach the
+ * variance of a trace of the whole aperture.
+ *
+ * findMirrors pairs the sun aperture cells, or the bins of a flux grid,
+ * with their images, and tells when they are not symmetric; the scene
+ * itself is not checked.
+ */
+class TONATIUH_KERNEL MirrorSymmetry
+{
+public:
+    // the plane dot(normal, p) = offset, with normal normalized here
+    MirrorSymmetry(const vec3d& normal, double offset = 0.);
+
+    const vec3d& getNormal() const {return m_normal;}
+    double getOffset() const {return m_offset;}
+
+    // signed, positive on the side normal points to
+    double distance(const vec3d& p) const {return dot(m_normal, p) - m_offset;}
+    vec3d reflect(const vec3d& p) const {return p - 2.*distance(p)*m_normal;}
+
+    // for each point the index of the point nearest its image, empty if the
+    // image of some point is farther than tolerance from all of them
+    std::vector<int> findMirrors(const std::vector<vec3d>& points, double tolerance) const;
+
+private:
+    vec3d m_normal;
+    double m_offset;
+};
@@ -0,0 +1,126 @@
+#include "PerfCounters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(Q_OS_LINUX)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+PerfCounterValues PerfCounterValues::sum(const std::vector<PerfCounterValues>& values)
+{
+    PerfCounterValues ans;
+    for (int c = 0; c < CounterCount; ++c) {
+        ans.counted[c] = !values.empty();
+        for (const PerfCounterValues& v : values) {
+            ans.counts[c] += v.counts[c];
+            ans.counted[c] = ans.counted[c] && v.counted[c];
+        }
+        if (!ans.counted[c])
+            ans.counts[c] = 0;
+    }
+    return ans;
+}
+
+PerfCounters::PerfCounters()
+{
+    for (int& fd : m_fds)
+        fd = -1;
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+void PerfCounters::close()
+{
+#if defined(Q_OS_LINUX)
+    for (int& fd : m_fds)
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#endif
+    m_leader = -1;
+}
+
+#if defined(Q_OS_LINUX)
+
+bool PerfCounters::start()
+{
+    close();
+    m_error.clear();
+
+    const quint64 configs[PerfCounterValues::CounterCount] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int c = 0; c < PerfCounterValues::CounterCount; ++c)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[c];
+        attr.disabled = m_leader < 0 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const int fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, m_leader, 0));
+        if (fd < 0) {
+            if (m_error.isEmpty())
+                m_error = QString("perf_event_open failed: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+            continue;
+        }
+        m_fds[c] = fd;
+        if (m_leader < 0)
+            m_leader = fd;
+    }
+    if (m_leader < 0)
+        return false;
+
+    ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+PerfCounterValues PerfCounters::read() const
+{
+    PerfCounterValues ans;
+    for (int c = 0; c < PerfCounterValues::CounterCount; ++c)
+    {
+        if (m_fds[c] < 0) continue;
+        quint64 data[3] = {0, 0, 0}; // value, time enabled, time running
+        if (::read(m_fds[c], data, sizeof(data)) != ssize_t(sizeof(data))) continue;
+        double value = double(data[0]);
+        if (data[2] > 0 && data[2] < data[1])
+            value *= double(data[1])/double(data[2]);
+        ans.counts[c] = qulonglong(value);
+        // a group enabled but never scheduled counted nothing it could report
+        ans.counted[c] = data[2] > 0 || data[1] == 0;
+    }
+    return ans;
+}
+
+#else
+
+bool PerfCounters::start()
+{
+    m_error = "Hardware counters need Linux perf_event_open.";
+    return false;
+}
+
+PerfCounterValues PerfCounters::read() const
+{
+    return PerfCounterValues();
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include <QString>
+#include <qglobal.h>
+
+
+//! PerfCounterValues holds the hardware counts of one thread or a sum of them.
+struct TONATIUH_KERNEL PerfCounterValues
+{
+    enum Counter {
+        Cycles,
+        Instructions,
+        CacheMisses, // last level cache
+        BranchMisses,
+        CounterCount
+    };
+
+    qulonglong counts[CounterCount] = {};
+    bool counted[CounterCount] = {};
+
+    // a counter is counted in the sum if it was in all values
+    static PerfCounterValues sum(const std::vector<PerfCounterValues>& values);
+};
+
+
+//! PerfCounters counts cycles, instructions, cache and branch misses of a thread.
+/*!
+ * On Linux the counters are a perf_event_open group on the calling thread,
+ * user space only, so they work with the default perf_event_paranoid of 2.
+ * Counters the processor or a virtual machine does not have are left out
+ * of the group. When the kernel multiplexes the group with other events,
+ * the counts are scaled to the time the group was enabled.
+ *
+ * The counters may be read from any thread, also once the counted one has
+ * ended. Elsewhere start() fails.
+ */
+class TONATIUH_KERNEL PerfCounters
+{
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // counts the calling thread from now on, false if no counter could be opened
+    bool start();
+    bool isStarted() const {return m_leader >= 0;}
+    // the counts since start; nothing counted if not started
+    PerfCounterValues read() const;
+
+    QString getError() const {return m_error;}
+
+private:
+    void close();
+
+    int m_leader = -1;
+    int m_fds[PerfCounterValues::CounterCount];
+    QString m_error;
+};
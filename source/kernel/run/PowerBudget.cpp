@@ -0,0 +1,50 @@
+#include "PowerBudget.h"
+
+
+void PowerBudget::resize(int count)
+{
+    m_sides.assign(2*static_cast<std::size_t>(count > 0 ? count : 0), Side());
+    m_missed = 0.;
+    m_escaped = 0.;
+    m_air = 0.;
+    m_roulette = 0.;
+}
+
+double PowerBudget::getAbsorbed() const
+{
+    double ans = 0.;
+    for (const Side& side : m_sides)
+        ans += side.absorbed;
+    return ans;
+}
+
+double PowerBudget::getTotal() const
+{
+    return m_missed + getAbsorbed() + m_escaped + m_air + m_roulette;
+}
+
+void PowerBudget::add(const PowerBudget& other)
+{
+    for (std::size_t n = 0; n < m_sides.size() && n < other.m_sides.size(); ++n) {
+        m_sides[n].incident += other.m_sides[n].incident;
+        m_sides[n].absorbed += other.m_sides[n].absorbed;
+        m_sides[n].reflected += other.m_sides[n].reflected;
+    }
+    m_missed += other.m_missed;
+    m_escaped += other.m_escaped;
+    m_air += other.m_air;
+    m_roulette += other.m_roulette;
+}
+
+void PowerBudget::scale(double factor)
+{
+    for (Side& side : m_sides) {
+        side.incident *= factor;
+        side.absorbed *= factor;
+        side.reflected *= factor;
+    }
+    m_missed *= factor;
+    m_escaped *= factor;
+    m_air *= factor;
+    m_roulette *= factor;
+}
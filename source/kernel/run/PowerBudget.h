@@ -0,0 +1,68 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+
+//! PowerBudget sums where the power of traced rays goes, per surface side.
+/*!
+ * Surfaces are numbered by the caller. A hit adds the weight arriving to
+ * the incident power of its side, the weight leaving to the reflected power
+ * and the rest to the absorbed power; unweighted rays carry 1.
+ *
+ * Rays that never hit are missed, rays leaving after a reflection escaped.
+ * The air takes the weight lost between hits, and Russian roulette the
+ * weight of the rays it ends less what it adds to the survivors, which may
+ * be negative. All of these add up to the weight emitted.
+ *
+ * A budget is filled by one worker without locking; the budgets of the
+ * workers are added once tracing ends.
+ */
+class TONATIUH_KERNEL PowerBudget
+{
+public:
+    struct Side
+    {
+        double incident = 0.;
+        double absorbed = 0.;
+        double reflected = 0.;
+    };
+
+    // surfaces [0, count), cleared
+    void resize(int count);
+    int getSurfaceCount() const {return int(m_sides.size()/2);}
+
+    void addHit(int surface, bool isFront, double incident, double reflected)
+    {
+        Side& side = m_sides[2*surface + (isFront ? 1 : 0)];
+        side.incident += incident;
+        side.absorbed += incident - reflected;
+        side.reflected += reflected;
+    }
+    void addMissed(double weight) {m_missed += weight;}
+    void addEscaped(double weight) {m_escaped += weight;}
+    void addAir(double weight) {m_air += weight;}
+    void addRoulette(double weight) {m_roulette += weight;}
+
+    const Side& getSide(int surface, bool isFront) const {return m_sides[2*surface + (isFront ? 1 : 0)];}
+    double getMissed() const {return m_missed;}
+    double getEscaped() const {return m_escaped;}
+    double getAir() const {return m_air;}
+    double getRoulette() const {return m_roulette;}
+    // over all surfaces and sides
+    double getAbsorbed() const;
+    // missed, absorbed, escaped, air and roulette, the weight emitted
+    double getTotal() const;
+
+    // a budget of the same surfaces
+    void add(const PowerBudget& other);
+    void scale(double factor);
+
+private:
+    std::vector<Side> m_sides; // back and front of each surface
+    double m_missed = 0.;
+    double m_escaped = 0.;
+    double m_air = 0.;
+    double m_roulette = 0.;
+};
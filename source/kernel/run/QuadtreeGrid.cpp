@@ -0,0 +1,239 @@
+#include "QuadtreeGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+QuadtreeGrid::QuadtreeGrid(const Box2D& box, const Settings& settings):
+    m_box(box),
+    m_settings(settings)
+{
+    m_settings.rows = qMax(1, m_settings.rows);
+    m_settings.cols = qMax(1, m_settings.cols);
+    m_settings.maxDepth = qMax(0, m_settings.maxDepth);
+    m_settings.splitHits = qMax<qulonglong>(1, m_settings.splitHits);
+    clear();
+}
+
+QuadtreeGrid::~QuadtreeGrid()
+{
+
+}
+
+void QuadtreeGrid::beginWorkers(int workers)
+{
+    m_workers.clear();
+    for (int w = 0; w < qMax(1, workers); ++w)
+        m_workers.emplace_back(new std::vector<Point>);
+    m_chunked = false;
+    m_pending.clear();
+}
+
+void QuadtreeGrid::addPoint(int worker, const vec2d& uv, double weight)
+{
+    if (m_chunked) {
+        m_workers[worker]->push_back(Point{uv, weight});
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    add(uv, weight);
+}
+
+void QuadtreeGrid::beginChunks(qulonglong first, qulonglong end)
+{
+    m_chunked = true;
+    m_next = first;
+    m_end = end;
+}
+
+/*!
+ * Hands over the points \a worker took in \a chunk and adds those of every
+ * chunk ended so far that follows the last one added; a chunk out of the
+ * range is added at once.
+ */
+void QuadtreeGrid::endChunk(int worker, qulonglong chunk)
+{
+    if (!m_chunked) return;
+    std::vector<Point> points;
+    points.swap(*m_workers[worker]);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (chunk < m_next || chunk >= m_end) {
+        for (const Point& point : points)
+            add(point.uv, point.weight);
+        return;
+    }
+    m_pending.emplace(chunk, std::move(points));
+    while (!m_pending.empty() && m_pending.begin()->first == m_next) {
+        for (const Point& point : m_pending.begin()->second)
+            add(point.uv, point.weight);
+        m_pending.erase(m_pending.begin());
+        m_next++;
+    }
+}
+
+void QuadtreeGrid::endWorkers()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& pending : m_pending)
+        for (const Point& point : pending.second)
+            add(point.uv, point.weight);
+    m_pending.clear();
+    for (const std::unique_ptr<std::vector<Point>>& worker : m_workers)
+        for (const Point& point : *worker)
+            add(point.uv, point.weight);
+    m_workers.clear();
+    m_chunked = false;
+}
+
+void QuadtreeGrid::clear()
+{
+    const int rows = m_settings.rows;
+    const int cols = m_settings.cols;
+    const vec2d step(m_box.size().x/rows, m_box.size().y/cols);
+    m_nodes.assign(size_t(rows)*cols, Node());
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            Node& node = m_nodes[size_t(r)*cols + c];
+            const vec2d a = m_box.min() + vec2d(r*step.x, c*step.y);
+            node.box = Box2D(a, a + step);
+            node.nextTest = m_settings.splitHits;
+        }
+    }
+    m_leaves = m_nodes.size();
+    m_hits = 0;
+}
+
+int QuadtreeGrid::findQuadrant(const Node& node, const vec2d& uv)
+{
+    const vec2d center = node.box.center();
+    return (uv.x >= center.x ? 2 : 0) + (uv.y >= center.y ? 1 : 0);
+}
+
+void QuadtreeGrid::add(const vec2d& uv, double weight)
+{
+    const vec2d q = (uv - m_box.min())/m_box.size();
+    int r = int(std::floor(q.x*m_settings.rows));
+    int c = int(std::floor(q.y*m_settings.cols));
+    if (r == m_settings.rows) r--;
+    if (c == m_settings.cols) c--;
+    if (r < 0 || r >= m_settings.rows || c < 0 || c >= m_settings.cols) return;
+
+    int index = r*m_settings.cols + c;
+    while (m_nodes[index].child >= 0)
+        index = m_nodes[index].child + findQuadrant(m_nodes[index], uv);
+
+    Node& node = m_nodes[index];
+    node.weight += weight;
+    const int quadrant = findQuadrant(node, uv);
+    node.quadrants[quadrant] += weight;
+    node.squares[quadrant] += weight*weight;
+    node.hits++;
+    m_hits++;
+    if (node.hits < node.nextTest) return;
+    node.nextTest += m_settings.splitHits;
+
+    if (node.depth >= m_settings.maxDepth) return;
+    if (m_settings.maxCells > 0 && m_leaves + 3 > m_settings.maxCells) return;
+    const double* quadrants = node.quadrants;
+    const double sum = quadrants[0] + quadrants[1] + quadrants[2] + quadrants[3];
+    if (sum <= 0.) return;
+    const int high = int(std::max_element(quadrants, quadrants + 4) - quadrants);
+    const int low = int(std::min_element(quadrants, quadrants + 4) - quadrants);
+    const double spread = quadrants[high] - quadrants[low];
+    // three standard errors of the difference of the two sums of weights
+    const double noise = 3.*std::sqrt(node.squares[high] + node.squares[low]);
+    if (spread >= m_settings.splitGradient*sum/4. && spread > noise)
+        split(index);
+}
+
+/*!
+ * The weight the node took from its parent is shared among its quadrants
+ * as the weights they took since, evenly if they took none.
+ */
+void QuadtreeGrid::split(int index)
+{
+    const Node parent = m_nodes[index];
+    const double sum = parent.quadrants[0] + parent.quadrants[1] + parent.quadrants[2] + parent.quadrants[3];
+    const double inherited = parent.weight - sum;
+    const vec2d center = parent.box.center();
+
+    m_nodes[index].child = int(m_nodes.size());
+    for (int k = 0; k < 4; ++k) {
+        Node child;
+        const vec2d a(k & 2 ? center.x : parent.box.min().x, k & 1 ? center.y : parent.box.min().y);
+        const vec2d b(k & 2 ? parent.box.max().x : center.x, k & 1 ? parent.box.max().y : center.y);
+        child.box = Box2D(a, b);
+        child.depth = parent.depth + 1;
+        child.weight = parent.quadrants[k] + (sum > 0. ? inherited*parent.quadrants[k]/sum : inherited/4.);
+        child.nextTest = m_settings.splitHits;
+        m_nodes.push_back(child);
+    }
+    m_leaves += 3;
+}
+
+void QuadtreeGrid::collect(int index, std::vector<int>& leaves) const
+{
+    const Node& node = m_nodes[index];
+    if (node.child < 0) {
+        leaves.push_back(index);
+        return;
+    }
+    for (int k = 0; k < 4; ++k)
+        collect(node.child + k, leaves);
+}
+
+std::vector<QuadtreeGrid::Cell> QuadtreeGrid::getCells() const
+{
+    std::vector<int> leaves;
+    leaves.reserve(m_leaves);
+    for (int n = 0; n < m_settings.rows*m_settings.cols; ++n)
+        collect(n, leaves);
+
+    std::vector<Cell> ans;
+    ans.reserve(leaves.size());
+    for (int index : leaves) {
+        const Node& node = m_nodes[index];
+        ans.push_back(Cell{node.box, node.depth, node.weight, node.hits});
+    }
+    return ans;
+}
+
+int QuadtreeGrid::getDepth() const
+{
+    int ans = 0;
+    for (const Node& node : m_nodes)
+        ans = qMax(ans, node.depth);
+    return ans;
+}
+
+/*!
+ * Each leaf adds to a cell of the uniform grid its value times the part of
+ * the cell it covers.
+ */
+std::vector<double> QuadtreeGrid::resample(const std::vector<double>& values, int rows, int cols) const
+{
+    std::vector<double> ans(size_t(qMax(0, rows))*size_t(qMax(0, cols)), 0.);
+    const std::vector<Cell> cells = getCells();
+    if (rows <= 0 || cols <= 0 || values.size() != cells.size()) return ans;
+
+    const vec2d step(m_box.size().x/rows, m_box.size().y/cols);
+    for (size_t n = 0; n < cells.size(); ++n) {
+        if (values[n] == 0.) continue;
+        const Box2D& box = cells[n].box;
+        const vec2d a = (box.min() - m_box.min())/step;
+        const vec2d b = (box.max() - m_box.min())/step;
+        const int r1 = qMin(rows, int(std::ceil(b.x)));
+        const int c1 = qMin(cols, int(std::ceil(b.y)));
+        for (int r = qMax(0, int(std::floor(a.x))); r < r1; ++r) {
+            const double du = qMin(b.x, r + 1.) - qMax(a.x, double(r));
+            if (du <= 0.) continue;
+            for (int c = qMax(0, int(std::floor(a.y))); c < c1; ++c) {
+                const double dv = qMin(b.y, c + 1.) - qMax(a.y, double(c));
+                if (dv > 0.)
+                    ans[size_t(r)*cols + c] += values[n]*du*dv;
+            }
+        }
+    }
+    return ans;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <qglobal.h>
+
+#include "libraries/math/2D/Box2D.h"
+
+
+//! QuadtreeGrid bins weighted points in cells that split where the weights vary.
+/*!
+ * The grid starts as rows by cols cells over a box, rows along u as in
+ * FluxAccumulator. Every cell also sums the weights falling in each of its
+ * quadrants. Once a cell has taken splitHits points, and again after every
+ * splitHits more, it splits into its quadrants if the spread of their
+ * weights, the largest less the smallest over their mean, reaches
+ * splitGradient and passes three standard errors of that difference, so
+ * the noise of a flat region does not split it, unless the cell is at
+ * maxDepth or the grid has maxCells leaves.
+ * Quadrants then start with the weights they took; what the cell held from
+ * its own parent is shared as those weights, so samples are never lost and
+ * flat regions keep coarse cells, which leaves the memory to the peaks.
+ *
+ * Whether a cell splits depends on the order of the points, so workers do
+ * not add theirs to the grid. With beginChunks(), the points of a chunk are
+ * held by its worker until endChunk() and chunks are added in the order of
+ * their indices, so the grid depends on the chunks only. Without it, points
+ * are added as they come, as one worker does in order.
+ */
+class TONATIUH_KERNEL QuadtreeGrid
+{
+public:
+    struct Settings
+    {
+        int rows = 8; // along u
+        int cols = 8; // along v
+        int maxDepth = 4; // splits below the base cells
+        qulonglong splitHits = 256;
+        double splitGradient = 0.5;
+        std::size_t maxCells = 0; // leaves, 0 for no limit
+    };
+
+    struct Cell
+    {
+        Box2D box;
+        int depth;
+        double weight; // including that shared from its parents
+        qulonglong hits; // since the cell was made
+    };
+
+    QuadtreeGrid(const Box2D& box, const Settings& settings);
+    ~QuadtreeGrid();
+
+    const Box2D& getBox() const {return m_box;}
+    const Settings& getSettings() const {return m_settings;}
+
+    void beginWorkers(int workers);
+    // thread safe across workers; points outside the box are dropped
+    void addPoint(int worker, const vec2d& uv, double weight);
+    // after beginWorkers, the points of chunks [first, end) are added by chunk
+    void beginChunks(qulonglong first, qulonglong end);
+    // on the thread of the worker, once its chunk is traced
+    void endChunk(int worker, qulonglong chunk);
+    // adds the chunks not ended, in order, then what workers still hold
+    void endWorkers();
+    void clear();
+
+    // leaves in tree order, the base cells row-major
+    std::vector<Cell> getCells() const;
+    std::size_t getCellCount() const {return m_leaves;}
+    int getDepth() const; // of the deepest leaf
+    qulonglong getHits() const {return m_hits;}
+
+    // values per unit area of the leaves, as getCells, averaged over the
+    // cells of a uniform grid rows by cols over the box, row-major
+    std::vector<double> resample(const std::vector<double>& values, int rows, int cols) const;
+
+private:
+    struct Node
+    {
+        Box2D box;
+        int depth = 0;
+        int child = -1; // first of four, by quadrant
+        double weight = 0.;
+        qulonglong hits = 0;
+        qulonglong nextTest = 0;
+        double quadrants[4] = {0., 0., 0., 0.}; // weights since the node was made
+        double squares[4] = {0., 0., 0., 0.}; // of the weights
+    };
+
+    struct Point
+    {
+        vec2d uv;
+        double weight;
+    };
+
+    static int findQuadrant(const Node& node, const vec2d& uv);
+    void add(const vec2d& uv, double weight);
+    void split(int index);
+    void collect(int index, std::vector<int>& leaves) const;
+
+    Box2D m_box;
+    Settings m_settings;
+    std::vector<Node> m_nodes; // base cells first
+    std::size_t m_leaves = 0;
+    qulonglong m_hits = 0;
+
+    std::mutex m_mutex;
+    bool m_chunked = false;
+    qulonglong m_next = 0; // the next chunk to add
+    qulonglong m_end = 0;
+    std::map<qulonglong, std::vector<Point>> m_pending; // ended chunks after m_next
+    std::vector<std::unique_ptr<std::vector<Point>>> m_workers;
+};
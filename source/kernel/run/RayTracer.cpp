@@ -1,14 +1,138 @@
+#include <algorithm>
+#include <memory>
+
 #include <QPoint>
 
 #include "shape/DifferentialGeometry.h"
 #include "random/RandomParallel.h"
+#include "random/SobolSequence.h"
 #include "libraries/math/3D/Ray.h"
 #include "RayTracer.h"
+#include "SceneBVH.h"
+#include "kernel/material/MaterialRT.h"
+#include "kernel/material/SlopeSampler.h"
+#include "CellImportance.h"
+#include "FluxAccumulator.h"
+#include "InstanceNode.h"
+#include "MaterialVariants.h"
+#include "PowerBudget.h"
+#include "ReflectorSampler.h"
+#include "TraceEvents.h"
+#include "TraceStatistics.h"
+#include "TranslationalSymmetry.h"
 #include "kernel/photons/PhotonsBuffer.h"
+#include "kernel/trackers/TrackingError.h"
 #include "sun/SunAperture.h"
 #include "sun/SunShape.h"
 #include "air/AirTransmission.h"
+#include "libraries/math/1D/LookupTable.h"
+
+namespace
+{
+// rays between progress updates and stop or export checks
+const ulong MicroBatch = 256;
+
+// dimensions of a ray for quasi-random generators, which number its draws
+// from Random::beginSample on; the rest of the path is pseudo-random
+const int DimensionCell = 0;
+const int DimensionAperture = 1; // and 2
+const int DimensionSun = 4;      // 3 pairs least evenly with the aperture
+const int DimensionMaterial = 6; // the first bounce
+const int DimensionEnd = SobolSequence::Dimensions;
+
+// periods a ray crosses at most with a translational symmetry, for rays
+// nearly along the axis; the ray is lost after them
+const int MaxPeriods = 1 << 16;
+
+// where the depth-first loop hands the hits it reports, called inline
+struct NoHits
+{
+    static const bool Enabled = false;
+    void operator()(const RayTracerHit&) const {}
+};
+
+struct CallbackHits
+{
+    static const bool Enabled = true;
+    const RayTracer::HitCallback* callback;
+    void operator()(const RayTracerHit& hit) const {(*callback)(hit);}
+};
+
+// the flux grids of the worker, binned before any callback
+struct FluxHits
+{
+    static const bool Enabled = true;
+    FluxAccumulator* flux;
+    int worker;
+    void operator()(const RayTracerHit& hit) const {flux->addHit(worker, hit);}
+};
+
+struct FluxCallbackHits
+{
+    static const bool Enabled = true;
+    FluxAccumulator* flux;
+    int worker;
+    const RayTracer::HitCallback* callback;
+    void operator()(const RayTracerHit& hit) const
+    {
+        flux->addHit(worker, hit);
+        (*callback)(hit);
+    }
+};
+
+// the surfaces whose photons are recorded
+struct ExportAll
+{
+    bool operator()(const InstanceNode*) const {return true;}
+};
+
+struct ExportReceiver
+{
+    const InstanceNode* receiver;
+    bool operator()(const InstanceNode* surface) const {return surface == receiver;}
+};
+
+struct ExportSet
+{
+    const QSet<const InstanceNode*>* surfaces;
+    bool operator()(const InstanceNode* surface) const {return surfaces->contains(surface);}
+};
+
+// symmetry 0-7 of the square about the sun axis, which circular sunshapes keep
+vec3d turnAboutAxis(const vec3d& d, int symmetry)
+{
+    double x = symmetry & 1 ? -d.x : d.x;
+    double y = symmetry & 2 ? -d.y : d.y;
+    if (symmetry & 4) std::swap(x, y);
+    return vec3d(x, y, d.z);
+}
 
+// spreads the low 10 bits of v to every third bit
+quint32 spreadBits(quint32 v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// instance left, then direction octant, then Morton code of the origin in box
+quint64 bounceKey(const Ray& ray, int origin, const Box3D& box)
+{
+    const vec3d& d = ray.direction();
+    quint64 octant = (d.x < 0. ? 4 : 0) | (d.y < 0. ? 2 : 0) | (d.z < 0. ? 1 : 0);
+    quint32 cell[3];
+    for (int i = 0; i < 3; ++i) {
+        double size = box.max()[i] - box.min()[i];
+        double f = size > 0. ? (ray.origin[i] - box.min()[i])/size : 0.;
+        cell[i] = quint32(qBound(0., f, 1.)*1023.);
+    }
+    quint64 morton = spreadBits(cell[0]) << 2 | spreadBits(cell[1]) << 1 | spreadBits(cell[2]);
+    return quint64(quint32(origin + 1)) << 33 | octant << 30 | morton;
+}
+}
 
 RayTracer::RayTracer(InstanceNode* instanceRoot,
     InstanceNode* instanceSun,
@@ -19,7 +143,7 @@ RayTracer::RayTracer(InstanceNode* instanceRoot,
     QMutex* mutexRand,
     PhotonsBuffer* photonBuffer,
     QMutex* mutexPhotons,
-    QVector<InstanceNode*> exportSuraceList,
+    const QVector<InstanceNode*>& exportSuraceList,
     std::atomic_bool* exportFailed,
     HitCallback hitCallback
 ):
@@ -35,81 +159,358 @@ RayTracer::RayTracer(InstanceNode* instanceRoot,
     m_mutexPhotonsBuffer(mutexPhotons),
     m_exportFailed(exportFailed),
     m_hitCallback(hitCallback),
-    m_exportSurfaceList(exportSuraceList),
     m_sunCells(sunAperture->getCells())
-{   
-
+{
+    // looked up at every hit
+    m_exportSurfaces.reserve(exportSuraceList.size());
+    for (InstanceNode* surface : exportSuraceList)
+        m_exportSurfaces.insert(surface);
+    if (m_exportSurfaces.size() == 1)
+        m_receiver = *m_exportSurfaces.begin();
 }
 
 void RayTracer::operator()(ulong nRays)
 {
     if (m_sunCells.empty()) return;
-    if (m_exportFailed && m_exportFailed->load())
+    if (m_exportFailed && m_exportFailed->load(std::memory_order_relaxed))
         return;
 
-    RandomParallel rand(m_rand, m_mutexRand);
+    // counter-based generators give each call its own stream without locking,
+    // and a generator without a mutex is this tracer's alone
+    std::unique_ptr<Random> randStream(m_rand->createStream());
+    if (!randStream && m_mutexRand)
+        randStream.reset(new RandomParallel(m_rand, m_mutexRand));
+    Random& rand = randStream ? *randStream : *m_rand;
+    m_primaryNext = 0;
+    m_spreading = false;
+    m_splitting = false;
+    TraceStatisticsScope statisticsScope(m_statistics);
     const bool recordPhotons = m_photonBuffer && m_mutexPhotonsBuffer;
 
+    if (!recordPhotons && m_sceneBVH && m_wavefrontSize > 0) {
+        traceWavefront(nRays, rand);
+        return;
+    }
+
+    if (!recordPhotons && m_variants && m_sceneBVH) {
+        traceVariants(nRays, rand);
+        return;
+    }
+
+    // the loops are specialized for the options of the tracer once per call
     if (!recordPhotons) {
-        for (ulong n = 0; n < nRays; ++n) {
-            if (m_exportFailed && m_exportFailed->load())
-                return;
+        m_spreading = m_spreads && !m_spreads->isEmpty() && m_sceneBVH && !m_primaryRays && !m_translation;
+        m_splitting = m_splits > 1 && m_rouletteWeight > 0. && m_sceneBVH && !m_spreading && !m_translation && !m_firstBounceCallback;
+        if (m_flux && m_hitCallback)
+            traceDepthFirst(nRays, rand, FluxCallbackHits{m_flux, m_fluxWorker, &m_hitCallback});
+        else if (m_flux)
+            traceDepthFirst(nRays, rand, FluxHits{m_flux, m_fluxWorker});
+        else if (m_hitCallback)
+            traceDepthFirst(nRays, rand, CallbackHits{&m_hitCallback});
+        else
+            traceDepthFirst(nRays, rand, NoHits());
+        return;
+    }
+
+    if (m_receiver)
+        tracePhotons(nRays, rand, ExportReceiver{m_receiver});
+    else if (!m_exportSurfaces.empty())
+        tracePhotons(nRays, rand, ExportSet{&m_exportSurfaces});
+    else
+        tracePhotons(nRays, rand, ExportAll());
+}
 
-            Ray ray;
-            NewPrimitiveRay(&ray, rand);
-            bool isFront = true;
-            int rayLength = 0;
-            InstanceNode* intersectedSurface = nullptr;
+template<class Sink>
+void RayTracer::traceDepthFirst(ulong nRays, Random& rand, const Sink& sink)
+{
+    const bool weighted = m_rouletteWeight > 0.;
+    if (m_air && weighted)
+        traceRays<true, true>(nRays, rand, sink);
+    else if (m_air)
+        traceRays<true, false>(nRays, rand, sink);
+    else if (weighted)
+        traceRays<false, true>(nRays, rand, sink);
+    else
+        traceRays<false, false>(nRays, rand, sink);
+}
+
+template<class Exported>
+void RayTracer::tracePhotons(ulong nRays, Random& rand, const Exported& isExported)
+{
+    if (m_air)
+        recordRays<true>(nRays, rand, isExported);
+    else
+        recordRays<false>(nRays, rand, isExported);
+}
+
+/*!
+ * Traces \a nRays depth-first, handing the hits that reflect and those the
+ * rays end on to \a sink. With the air, the weights and the sink given as
+ * template arguments the loop tests none of them per bounce and calls the
+ * sink inline.
+ */
+template<bool Air, bool Weighted, class Sink>
+void RayTracer::traceRays(ulong nRays, Random& rand, const Sink& sink)
+{
+    ulong reported = 0;
+    for (ulong n = 0; n < nRays; ++n) {
+        if (n % MicroBatch == 0 && !poll(n, &reported))
+            return;
+
+        Ray ray;
+        int cell = -1;
+        double weight = 1.;
+        NewPrimitiveRay(&ray, rand, &cell, Weighted ? &weight : nullptr);
+        rand.skipToDimension(DimensionMaterial);
+        bool isFront = true;
+        int rayLength = m_primaryRays && !m_primaryFromSun ? 1 : 0;
+        InstanceNode* intersectedSurface = nullptr;
+        InstanceNode* reflector = nullptr;
+        int origin = -1; // see SceneBVH::findNeighbours
 
+        // the paths of the splits leave the first hit one after another
+        const bool splitting = Weighted && m_splitting && rayLength == 0;
+        int splits = splitting ? m_splits : 1;
+        SceneBVHHit splitHit;
+        Ray splitRay;
+        const double splitWeight = weight/splits;
+        for (int split = 0; split < splits; ++split) {
+            if (split > 0) {
+                ray = splitRay;
+                rayLength = 0;
+                reflector = nullptr;
+                origin = -1;
+            }
             bool isReflected = true;
             while (isReflected) {
                 Ray rayReflected;
                 isFront = false;
                 intersectedSurface = nullptr;
-                isReflected = m_instanceLayout->intersect(ray, rand, isFront, intersectedSurface, rayReflected);
+                double reflected = 1.;
+                if (m_spreading && rayLength == 0)
+                    isReflected = intersectSpread(ray, rand, isFront, intersectedSurface, rayReflected, Weighted ? &reflected : nullptr, &origin);
+                else if (splitting && rayLength == 0)
+                    isReflected = intersectSplit(ray, rand, splitHit, split == 0, isFront, intersectedSurface, rayReflected, &reflected, &origin);
+                else
+                    isReflected = intersect(ray, rand, isFront, intersectedSurface, rayReflected, Weighted ? &reflected : nullptr, &origin);
+                rand.skipToDimension(DimensionEnd);
+                if (split == 0 || rayLength > 0)
+                    countHit(intersectedSurface, rayLength);
+                if (splitting && rayLength == 0) {
+                    // a ray missing the scene is not split
+                    if (!intersectedSurface)
+                        splits = 1;
+                    else
+                        weight = splitWeight;
+                    if (split == 0)
+                        splitRay = ray;
+                }
+                if (m_firstBounceCallback && rayLength == 0) {
+                    m_firstBounceCallback(RayTracerFirstBounce{
+                        RayTracerRay{ray.origin, ray.direction()},
+                        intersectedSurface ? ray.tMax : gcf::infinity,
+                        intersectedSurface, isFront, isReflected,
+                        RayTracerRay{rayReflected.origin, rayReflected.direction()}
+                    });
+                }
 
-                if (m_air && rayLength > 0 && m_air->transmission(ray.tMax) < rand.RandomDouble()) {
+                // a ray leaving the scene is recorded before the air, which
+                // applies when it is traced again
+                if (m_budget && !intersectedSurface) {
+                    if (rayLength > 0)
+                        m_budget->addEscaped(weight);
+                    else
+                        m_budget->addMissed(weight);
+                }
+                if (m_escapeCallback && !intersectedSurface && rayLength > 0) {
+                    m_escapeCallback(RayTracerRay{ray.origin, ray.direction()});
+                    break;
+                }
+
+                if (Air && Weighted && rayLength > 0) {
+                    const double t = transmission(ray.tMax);
+                    if (m_budget && intersectedSurface)
+                        m_budget->addAir(weight*(1. - t));
+                    weight *= t;
+                } else if (Air && rayLength > 0 && transmission(ray.tMax) < rand.RandomDouble()) {
+                    if (m_budget && intersectedSurface)
+                        m_budget->addAir(weight);
                     intersectedSurface = nullptr;
                     ray.tMax = gcf::infinity;
                     break;
                 }
 
+                if (m_budget && intersectedSurface)
+                    addHitPower(intersectedSurface, isFront, weight, isReflected ? weight*reflected : 0.);
                 if (!isReflected)
                     break;
 
-                if (m_hitCallback && intersectedSurface)
-                    m_hitCallback(RayTracerHit{ray.point(ray.tMax), intersectedSurface, isFront});
+                if (Sink::Enabled && intersectedSurface)
+                    sink(RayTracerHit{ray.point(ray.tMax), intersectedSurface, isFront, weight, reflector, cell});
+                if (!reflector && (!m_primaryRays || m_primaryFromSun))
+                    reflector = intersectedSurface;
 
+                TRACE_STATS(bounces++);
                 ++rayLength;
                 ray = rayReflected;
+                if (!Weighted)
+                    continue;
+                weight *= reflected;
+                const double reflectedWeight = weight;
+                if (!survives(weight, rand)) {
+                    if (m_budget)
+                        m_budget->addRoulette(reflectedWeight);
+                    intersectedSurface = nullptr;
+                    break;
+                }
+                if (m_budget && weight != reflectedWeight)
+                    m_budget->addRoulette(reflectedWeight - weight);
             }
 
-            if (m_hitCallback && intersectedSurface && ray.tMax != gcf::infinity)
-                m_hitCallback(RayTracerHit{ray.point(ray.tMax), intersectedSurface, isFront});
+            if (Sink::Enabled && intersectedSurface && ray.tMax != gcf::infinity)
+                sink(RayTracerHit{ray.point(ray.tMax), intersectedSurface, isFront, weight, reflector, cell});
         }
-        return;
     }
+    poll(nRays, &reported);
+}
+
+/*!
+ * Traces \a nRays for every material variant. A ray is traced with the
+ * materials of the scene first; if it met no varied material its hits hold
+ * for every variant, otherwise it is traced again from its first number
+ * for each other variant, so the variants share the sun sample and every
+ * draw up to where their materials first make the paths differ.
+ */
+void RayTracer::traceVariants(ulong nRays, Random& rand)
+{
+    const std::vector<FluxAccumulator*>& fluxes = *m_variantFluxes;
+    std::vector<RayTracerHit> hits;
+    ulong reported = 0;
+    for (ulong n = 0; n < nRays; ++n) {
+        if (n % MicroBatch == 0 && !poll(n, &reported))
+            break;
+
+        hits.clear();
+        m_variant = 0;
+        const bool varied = traceVariant(rand, hits);
+        for (size_t k = 0; k < (varied ? 1 : fluxes.size()); ++k)
+            for (const RayTracerHit& hit : hits)
+                fluxes[k]->addHit(m_fluxWorker, hit);
+        if (!varied) continue;
+
+        for (int k = 1; k < m_variants->getCount(); ++k) {
+            rand.repeatSample();
+            hits.clear();
+            m_variant = k;
+            traceVariant(rand, hits);
+            for (const RayTracerHit& hit : hits)
+                fluxes[size_t(k)]->addHit(m_fluxWorker, hit);
+        }
+    }
+    m_variant = 0;
+    poll(nRays, &reported);
+}
+
+// one ray with the materials of m_variant, true if it met a varied material
+bool RayTracer::traceVariant(Random& rand, std::vector<RayTracerHit>& hits)
+{
+    const bool weighted = m_rouletteWeight > 0.;
+    Ray ray;
+    int cell = -1;
+    double weight = 1.;
+    NewPrimitiveRay(&ray, rand, &cell, weighted ? &weight : nullptr);
+    rand.skipToDimension(DimensionMaterial);
+    m_metVaried = false;
+    int rayLength = 0;
+    InstanceNode* reflector = nullptr;
+    int origin = -1;
+
+    for (;;) {
+        Ray rayReflected;
+        bool isFront = false;
+        InstanceNode* surface = nullptr;
+        double reflected = 1.;
+        const bool isReflected = intersect(ray, rand, isFront, surface, rayReflected, weighted ? &reflected : nullptr, &origin);
+        rand.skipToDimension(DimensionEnd);
+        countHit(surface, rayLength);
+        if (!surface) break;
 
-    bool bExportAll = m_exportSurfaceList.empty();
-    bool bExportLight = bExportAll ? true : m_exportSurfaceList.contains(m_instanceSun);
+        if (m_air && rayLength > 0) {
+            const double t = transmission(ray.tMax);
+            if (weighted)
+                weight *= t;
+            else if (t < rand.RandomDouble())
+                break;
+        }
+        hits.push_back(RayTracerHit{ray.point(ray.tMax), surface, isFront, weight, reflector, cell});
+        if (!isReflected) break;
+
+        if (!reflector)
+            reflector = surface;
+        TRACE_STATS(bounces++);
+        ++rayLength;
+        ray = rayReflected;
+        if (weighted) {
+            weight *= reflected;
+            if (!survives(weight, rand)) break;
+        }
+    }
+    return m_metVaried;
+}
 
-    std::vector<Photon> photons;
-    photons.reserve(2*nRays);
+/*!
+ * Traces \a nRays depth-first into the photon buffer, keeping the photons
+ * on the surfaces \a isExported takes and the light when it takes the sun.
+ */
+template<bool Air, class Exported>
+void RayTracer::recordRays(ulong nRays, Random& rand, const Exported& isExported)
+{
+    ulong reported = 0;
+    bool bExportLight = isExported(m_instanceSun);
+
+    // pages are handed over on ray boundaries
+    const bool paged = m_pageWorker >= 0 && m_photonBuffer->isPaged();
+    PhotonsPage* page = nullptr;
+    ulong pageSequence = 0;
+    std::vector<Photon> photonsLocal;
+    std::vector<Photon>* photons = &photonsLocal;
+    if (paged) {
+        page = m_photonBuffer->acquirePage(m_pageWorker, m_pageChunk, pageSequence++);
+        photons = &page->photons;
+    } else {
+        // reused from an earlier call, so it is grown already
+        photonsLocal = m_photonBuffer->takeVector();
+        photonsLocal.reserve(2*nRays);
+    }
     // Photon(Point3D pos, int side, double id = 0, InstanceNode* intersectedSurface = 0, int absorbedPhoton = 0);
 
-    for (ulong n = 0; n < nRays; ++n)
+    ulong n = 0;
+    for (; n < nRays; ++n)
     {
-        if (m_exportFailed && m_exportFailed->load())
-            return;
+        if (n % MicroBatch == 0) {
+            if (m_exportFailed && m_exportFailed->load(std::memory_order_relaxed))
+                return;
+            // the photons of a stopped call are still saved
+            if (!poll(n, &reported))
+                break;
+        }
+
+        if (page && page->photons.size() >= m_photonBuffer->getPageSize()) {
+            m_photonBuffer->submitPage(page);
+            page = m_photonBuffer->acquirePage(m_pageWorker, m_pageChunk, pageSequence++);
+            photons = &page->photons;
+        }
 
         // Part 1: first photon point (on sun surface)
         Ray ray;
         NewPrimitiveRay(&ray, rand);
+        rand.skipToDimension(DimensionMaterial);
         bool isFront = true;
         int rayLength = 0;
         InstanceNode* intersectedSurface = m_instanceSun;
+        int origin = -1;
         if (bExportLight)
-            photons.push_back(Photon(rayLength, ray.origin, m_instanceSun, isFront));
+            photons->push_back(Photon(rayLength, ray.origin, m_instanceSun, isFront));
 
         // Part 2: middle photon points (intersection with shapes)
         bool isReflected = true;
@@ -117,11 +518,21 @@ void RayTracer::operator()(ulong nRays)
             Ray rayReflected; // scattered?
             isFront = false;
             intersectedSurface = 0;
-            isReflected = m_instanceLayout->intersect(ray, rand, isFront, intersectedSurface, rayReflected);
+            isReflected = intersect(ray, rand, isFront, intersectedSurface, rayReflected, nullptr, &origin);
+            rand.skipToDimension(DimensionEnd);
+            countHit(intersectedSurface, rayLength);
+            if (m_budget && !intersectedSurface) {
+                if (rayLength > 0)
+                    m_budget->addEscaped(1.);
+                else
+                    m_budget->addMissed(1.);
+            }
 
             // check absorption after the first reflection
-            if (m_air && rayLength > 0) {
-                if (m_air->transmission(ray.tMax) < rand.RandomDouble()) {
+            if (Air && rayLength > 0) {
+                if (transmission(ray.tMax) < rand.RandomDouble()) {
+                    if (m_budget && intersectedSurface)
+                        m_budget->addAir(1.);
                     ++rayLength;
                     intersectedSurface = 0;
                     ray.tMax = gcf::infinity;
@@ -130,39 +541,485 @@ void RayTracer::operator()(ulong nRays)
             }
 
             // save intersection
+            if (m_budget && intersectedSurface)
+                addHitPower(intersectedSurface, isFront, 1., isReflected ? 1. : 0.);
             if (!isReflected) break;
+            TRACE_STATS(bounces++);
             ++rayLength;
-            if (bExportAll || m_exportSurfaceList.contains(intersectedSurface))
-                photons.push_back(Photon(rayLength, ray.point(ray.tMax), intersectedSurface, isFront, true));
+            if (isExported(intersectedSurface))
+                photons->push_back(Photon(rayLength, ray.point(ray.tMax), intersectedSurface, isFront, true));
             ray = rayReflected;
         }
 
         // Part 3: last photon point (absorption in air)
         // skip rays without intersections
         if (rayLength == 0 && ray.tMax == gcf::infinity) continue;
-        if (!bExportAll && !m_exportSurfaceList.contains(intersectedSurface)) continue;
+        if (!isExported(intersectedSurface)) continue;
         // limit length of other rays
         if (ray.tMax == gcf::infinity) {// always true?
             ray.tMax = 1.;
             isFront = 0; // ? back for air
         }
-        photons.push_back(Photon(++rayLength, ray.point(ray.tMax), intersectedSurface, isFront));
+        photons->push_back(Photon(++rayLength, ray.point(ray.tMax), intersectedSurface, isFront));
     }
+    poll(n, &reported);
 
-    m_mutexPhotonsBuffer->lock();
-    bool photonsSaved = m_photonBuffer->addPhotons(photons);
-    m_mutexPhotonsBuffer->unlock();
+    bool photonsSaved = true;
+    if (page) {
+        page->isLast = true;
+        m_photonBuffer->submitPage(page);
+        photonsSaved = !m_photonBuffer->hasExportFailed();
+    } else {
+        {
+            TraceEventScope wait("photon lock", "wait");
+            m_mutexPhotonsBuffer->lock();
+        }
+        {
+            TraceEventScope event("add photons", "photons", "photons", qint64(photonsLocal.size()));
+            photonsSaved = m_photonBuffer->addPhotons(photonsLocal);
+        }
+        m_mutexPhotonsBuffer->unlock();
+        m_photonBuffer->recycleVector(std::move(photonsLocal));
+    }
     if (!photonsSaved && m_exportFailed)
         m_exportFailed->store(true);
 }
 
-bool RayTracer::NewPrimitiveRay(Ray* ray, Random& rand)
+/*!
+ * Traces \a nRays breadth-first in batches of m_wavefrontSize rays.
+ * Each bounce runs as separate stages over the whole batch: closest-hit
+ * search, air attenuation, shading grouped by material with one
+ * MaterialRT::OutputRays call per group, and compaction of the reflected rays.
+ * Hits are reported exactly as in the depth-first loop.
+ */
+void RayTracer::traceWavefront(ulong nRays, Random& rand)
+{
+    struct WavefrontPath
+    {
+        Ray ray;
+        int rayLength;
+        double weight;
+        InstanceNode* reflector;
+        int origin; // see SceneBVH::findNeighbours
+        int cell;
+    };
+
+    const ulong batchSize = qMin(m_wavefrontSize, nRays);
+    std::vector<WavefrontPath> paths(batchSize);
+    std::vector<SceneBVHHit> hits(batchSize);
+    std::vector<ulong> shading;
+    shading.reserve(batchSize);
+    std::vector<MaterialHit> materialHits;
+    materialHits.reserve(batchSize);
+    const bool weighted = m_rouletteWeight > 0.;
+    std::vector<double> reflected(weighted ? batchSize : 0);
+    std::vector<std::pair<quint64, ulong>> sortKeys;
+    std::vector<WavefrontPath> sorted;
+    if (m_sortBounces) {
+        sortKeys.reserve(batchSize);
+        sorted.reserve(batchSize);
+    }
+    std::vector<double> airDistances;
+    std::vector<double> airFactors;
+    if (m_air) {
+        airDistances.reserve(batchSize);
+        airFactors.reserve(batchSize);
+    }
+
+    ulong traced = 0;
+    ulong reported = 0;
+    while (traced < nRays)
+    {
+        if (!poll(traced, &reported))
+            return;
+
+        // stage 1: primary rays, the bounces are pseudo-random for
+        // quasi-random generators as rays are shaded out of order
+        ulong active = qMin(batchSize, nRays - traced);
+        for (ulong n = 0; n < active; ++n) {
+            paths[n].weight = 1.;
+            NewPrimitiveRay(&paths[n].ray, rand, &paths[n].cell, weighted ? &paths[n].weight : nullptr);
+            paths[n].rayLength = m_primaryRays && !m_primaryFromSun ? 1 : 0;
+            paths[n].reflector = nullptr;
+            paths[n].origin = -1;
+        }
+        rand.skipToDimension(DimensionEnd);
+        traced += active;
+
+        while (active > 0)
+        {
+            // stage 2: closest hits
+            shading.clear();
+            for (ulong n = 0; n < active; ++n) {
+                const bool isHit = m_sceneBVH->findHit(paths[n].ray, hits[n], paths[n].origin);
+                countHit(hits[n].instance, paths[n].rayLength);
+                TRACE_STATS(instanceSwitches += n > 0 && hits[n].top != hits[n - 1].top);
+                if (isHit) {
+                    shading.push_back(n);
+                    continue;
+                }
+                if (m_budget && paths[n].rayLength > 0)
+                    m_budget->addEscaped(paths[n].weight);
+                else if (m_budget)
+                    m_budget->addMissed(paths[n].weight);
+                if (m_escapeCallback && paths[n].rayLength > 0)
+                    m_escapeCallback(RayTracerRay{paths[n].ray.origin, paths[n].ray.direction()});
+            }
+
+            // stage 3: air attenuation after the first reflection
+            // (the factors are computed in one call, the uniforms drawn in hit order)
+            if (m_air) {
+                airDistances.clear();
+                for (ulong n : shading)
+                    if (paths[n].rayLength > 0)
+                        airDistances.push_back(paths[n].ray.tMax);
+                airFactors.resize(airDistances.size());
+                if (m_airTable) {
+                    for (std::size_t k = 0; k < airDistances.size(); ++k)
+                        airFactors[k] = transmission(airDistances[k]);
+                } else
+                    m_air->transmissions(airDistances, airFactors);
+
+                ulong kept = 0;
+                std::size_t k = 0;
+                for (ulong n : shading) {
+                    if (weighted) {
+                        if (paths[n].rayLength > 0) {
+                            if (m_budget)
+                                m_budget->addAir(paths[n].weight*(1. - airFactors[k]));
+                            paths[n].weight *= airFactors[k++];
+                        }
+                        shading[kept++] = n;
+                        continue;
+                    }
+                    if (paths[n].rayLength > 0 && airFactors[k++] < rand.RandomDouble()) {
+                        if (m_budget)
+                            m_budget->addAir(paths[n].weight);
+                        continue;
+                    }
+                    shading[kept++] = n;
+                }
+                shading.resize(kept);
+            }
+
+            // stage 4: shading, grouped by material for coherent dispatch
+            // (indices, not pointers, keep the random draw order reproducible)
+            std::stable_sort(shading.begin(), shading.end(), [&hits](ulong a, ulong b) {
+                return hits[a].leaf->materialIndex < hits[b].leaf->materialIndex;
+            });
+
+            // one OutputRays call per run of hits on the same material
+            ulong survivors = 0;
+            for (ulong a = 0, b = 0; a < shading.size(); a = b)
+            {
+                const SceneBVHInstance* leaf = hits[shading[a]].leaf;
+                materialHits.clear();
+                for (b = a; b < shading.size() && hits[shading[b]].leaf->materialIndex == leaf->materialIndex; ++b) {
+                    SceneBVHHit& hit = hits[shading[b]];
+                    const double trackingError = m_sceneBVH->getTrackingError(hit);
+                    if (trackingError > 0.)
+                        TrackingError::tilt(hit.dg, trackingError, rand);
+                    materialHits.push_back(MaterialHit{&paths[shading[b]].ray, &hit.dg, Ray(), false});
+                }
+                if (weighted) {
+                    for (std::size_t k = 0; k < materialHits.size(); ++k) {
+                        MaterialHit& shaded = materialHits[k];
+                        reflected[k] = 1.;
+                        shaded.isReflected = leaf->material->OutputRayWeighted(*shaded.rayIn, *shaded.dg, rand, shaded.rayOut, reflected[k]);
+                    }
+                } else
+                    leaf->material->OutputRays(materialHits, rand);
+
+                for (ulong k = a; k < b; ++k) {
+                    ulong n = shading[k];
+                    WavefrontPath& path = paths[n];
+                    const SceneBVHHit& hit = hits[n];
+                    const MaterialHit& shaded = materialHits[k - a];
+
+                    if (m_flux || m_hitCallback)
+                        reportHit(RayTracerHit{path.ray.point(path.ray.tMax), hit.instance, hit.dg.isFront, path.weight, path.reflector, path.cell});
+                    if (m_budget) {
+                        const double leaving = !shaded.isReflected ? 0. : weighted ? path.weight*reflected[k - a] : path.weight;
+                        addHitPower(hit.instance, hit.dg.isFront, path.weight, leaving);
+                    }
+                    if (!shaded.isReflected) continue;
+                    if (weighted) {
+                        path.weight *= reflected[k - a];
+                        const double reflectedWeight = path.weight;
+                        const bool alive = survives(path.weight, rand);
+                        if (m_budget)
+                            m_budget->addRoulette(reflectedWeight - (alive ? path.weight : 0.));
+                        if (!alive) continue;
+                    }
+
+                    path.ray = shaded.rayOut;
+                    path.origin = hit.top;
+                    if (!path.reflector && (!m_primaryRays || m_primaryFromSun))
+                        path.reflector = hit.instance;
+                    TRACE_STATS(bounces++);
+                    path.rayLength++;
+                    // stage 5: compaction, shading order is increasing within a material only
+                    shading[survivors++] = n;
+                }
+            }
+
+            std::sort(shading.begin(), shading.begin() + survivors);
+            for (ulong k = 0; k < survivors; ++k)
+                if (shading[k] != k) paths[k] = paths[shading[k]];
+            active = survivors;
+
+            // stage 6: rays leaving the same instance the same way traverse
+            // alike; ties keep the compacted order, so traces repeat
+            if (m_sortBounces && active > 1) {
+                const Box3D& box = m_sceneBVH->getBox();
+                sortKeys.clear();
+                for (ulong k = 0; k < active; ++k)
+                    sortKeys.push_back({bounceKey(paths[k].ray, paths[k].origin, box), k});
+                std::sort(sortKeys.begin(), sortKeys.end());
+                sorted.clear();
+                for (const auto& key : sortKeys)
+                    sorted.push_back(paths[key.second]);
+                std::copy(sorted.begin(), sorted.end(), paths.begin());
+            }
+        }
+    }
+    poll(traced, &reported);
+}
+
+// publishes the rays traced since the last call, false once stopped or the export failed
+bool RayTracer::poll(ulong traced, ulong* reported) const
+{
+    if (m_raysTraced && traced > *reported) {
+        m_raysTraced->fetch_add(traced - *reported, std::memory_order_relaxed);
+        *reported = traced;
+    }
+    if (m_stop && m_stop->load(std::memory_order_relaxed))
+        return false;
+    return !(m_exportFailed && m_exportFailed->load(std::memory_order_relaxed));
+}
+
+// the flux grids first, then the callback, as the depth-first sinks
+void RayTracer::reportHit(const RayTracerHit& hit) const
+{
+    if (m_flux)
+        m_flux->addHit(m_fluxWorker, hit);
+    if (m_hitCallback)
+        m_hitCallback(hit);
+}
+
+double RayTracer::transmission(double distance) const
+{
+    if (m_airTable && distance <= m_airTableMax)
+        return (*m_airTable)(distance);
+    return m_air->transmission(distance);
+}
+
+// hits of surfaces without a number are left out
+void RayTracer::addHitPower(InstanceNode* surface, bool isFront, double incident, double reflected) const
+{
+    if (!m_budgetSurfaces) return;
+    const auto found = m_budgetSurfaces->constFind(surface);
+    if (found != m_budgetSurfaces->constEnd())
+        m_budget->addHit(found.value(), isFront, incident, reflected);
+}
+
+// a closest-hit search ended on surface, or on nothing
+void RayTracer::countHit(const InstanceNode* surface, int rayLength) const
+{
+#ifdef TONATIUHPP_TRACE_STATS
+    if (!m_statistics) return;
+    if (surface)
+        m_statistics->hits++;
+    else if (rayLength == 0)
+        m_statistics->sunMisses++;
+#else
+    Q_UNUSED(surface);
+    Q_UNUSED(rayLength);
+#endif
+}
+
+// Russian roulette, survivors carrying m_rouletteWeight keep the expected weight
+bool RayTracer::survives(double& weight, Random& rand) const
+{
+    if (weight >= m_rouletteWeight) return true;
+    if (rand.RandomDouble()*m_rouletteWeight >= weight) return false;
+    weight = m_rouletteWeight;
+    return true;
+}
+
+/*!
+ * With a translational symmetry the ray is traced period by period, each
+ * piece ending at the end faces of the period, until it hits a surface or
+ * leaves the box grown along the axis for good.
+ */
+bool RayTracer::intersect(Ray& ray, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight, int* origin) const
+{
+    if (!m_translation)
+        return intersectScene(ray, rand, isFront, instance, rayOut, weight, origin);
+
+    const double exit = m_translation->findExit(ray);
+    Ray piece(ray.origin, ray.direction(), ray.tMin);
+    m_translation->wrap(piece.origin);
+    int pieceOrigin = origin ? *origin : -1;
+    double travelled = 0.;
+    for (int n = 0; n < MaxPeriods && travelled < exit; ++n) {
+        const double end = m_translation->findEnd(piece);
+        piece.tMax = qMin(end, exit - travelled);
+        instance = nullptr;
+        const bool isReflected = intersectScene(piece, rand, isFront, instance, rayOut, weight, &pieceOrigin);
+        if (instance) {
+            ray.tMax = travelled + piece.tMax;
+            ray.origin = piece.point(piece.tMax) - ray.direction()*ray.tMax;
+            if (origin) *origin = pieceOrigin;
+            return isReflected;
+        }
+        if (!(end < exit - travelled)) break;
+        travelled += end;
+        piece.origin = piece.point(end);
+        m_translation->crossEnd(piece.origin, piece.direction());
+        // the instance left is in another period
+        pieceOrigin = -1;
+    }
+    if (origin) *origin = -1;
+    ray.tMax = gcf::infinity;
+    return false;
+}
+
+bool RayTracer::intersectScene(const Ray& ray, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight, int* origin) const
+{
+    if (m_variants && m_sceneBVH) {
+        SceneBVHHit hit;
+        const bool found = m_sceneBVH->findHit(ray, hit, origin ? *origin : -1);
+        if (origin) *origin = hit.top;
+        if (!found) return false;
+
+        isFront = hit.dg.isFront;
+        instance = hit.instance;
+        if (m_variants->isVaried(hit.leaf->material))
+            m_metVaried = true;
+        MaterialRT* material = m_variants->find(m_variant, hit.leaf->material);
+        const double trackingError = m_sceneBVH->getTrackingError(hit);
+        if (trackingError > 0.)
+            TrackingError::tilt(hit.dg, trackingError, rand);
+        if (weight)
+            return material->OutputRayWeighted(ray, hit.dg, rand, rayOut, *weight);
+        return material->OutputRay(ray, hit.dg, rand, rayOut);
+    }
+    if (m_sceneBVH)
+        return m_sceneBVH->intersect(ray, rand, isFront, instance, rayOut, weight, origin);
+    return m_instanceLayout->intersect(ray, rand, isFront, instance, rayOut, weight);
+}
+
+/*!
+ * The ray keeps its sun direction, so it meets the surfaces it would without
+ * the spreads. A mirror of the spreads draws its reflectivity and tilts the
+ * normal, after the tracker error, by a sample of its slope errors from the
+ * tables of SlopeSampler, which MaterialSpecular draws by rejection with a
+ * logarithm per ray; the distribution is the same. Other materials shade the
+ * hit as in SceneBVH::intersect.
+ */
+bool RayTracer::intersectSpread(Ray& ray, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight, int* origin) const
+{
+    SceneBVHHit hit;
+    const bool found = m_sceneBVH->findHit(ray, hit, origin ? *origin : -1);
+    if (origin) *origin = hit.top;
+    if (!found) return false;
+
+    isFront = hit.dg.isFront;
+    instance = hit.instance;
+    const double trackingError = m_sceneBVH->getTrackingError(hit);
+    if (trackingError > 0.)
+        TrackingError::tilt(hit.dg, trackingError, rand);
+    const auto it = m_spreads->constFind(hit.leaf->material);
+    if (it == m_spreads->constEnd()) {
+        if (weight)
+            return hit.leaf->material->OutputRayWeighted(ray, hit.dg, rand, rayOut, *weight);
+        return hit.leaf->material->OutputRay(ray, hit.dg, rand, rayOut);
+    }
+
+    if (weight)
+        *weight *= it->reflectivity;
+    else if (rand.RandomDouble() >= it->reflectivity)
+        return false;
+
+    const double u = rand.RandomDouble();
+    const double v = rand.RandomDouble();
+    rayOut.origin = hit.dg.point;
+    rayOut.setDirection(it->slope.reflect(ray.direction(), hit.dg.normal.normalized(), hit.dg.dpdu, u, v));
+    return true;
+}
+
+/*!
+ * The first split finds the hit and keeps it in \a hit, the others start
+ * from it with the ray of the first, so the sun sample and the traversal
+ * are paid once. Each draws the tracking error and the material again.
+ */
+bool RayTracer::intersectSplit(const Ray& ray, Random& rand, SceneBVHHit& hit, bool first, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight, int* origin) const
+{
+    if (first)
+        m_sceneBVH->findHit(ray, hit, origin ? *origin : -1);
+    if (origin) *origin = hit.top;
+    if (!hit.leaf) return false;
+
+    isFront = hit.dg.isFront;
+    instance = hit.instance;
+    DifferentialGeometry dg = hit.dg;
+    const double trackingError = m_sceneBVH->getTrackingError(hit);
+    if (trackingError > 0.)
+        TrackingError::tilt(dg, trackingError, rand);
+    return hit.leaf->material->OutputRayWeighted(ray, dg, rand, rayOut, *weight);
+}
+
+bool RayTracer::NewPrimitiveRay(Ray* ray, Random& rand, int* cellIndex, double* weight)
 {
-    int index = int(rand.RandomDouble()*m_sunCells.size());
-    QPair<int, int> cell = m_sunCells[index];
+    TRACE_STATS(rays++);
+    rand.beginSample();
+    if (m_primaryRays) {
+        const RayTracerRay& primary = m_primaryRays[m_primaryNext++];
+        *ray = Ray(primary.origin, primary.direction);
+        if (cellIndex) *cellIndex = -1;
+        return true;
+    }
 
-    vec3d origin = m_sunAperture->Sample(rand.RandomDouble(), rand.RandomDouble(), cell.first, cell.second);
-    vec3d direction = m_sunShape->generateRay(rand);
-    *ray = m_sunTransform(Ray(origin, direction));
+    rand.skipToDimension(DimensionCell);
+    vec3d origin;
+    if (m_reflectorSampler) {
+        const double pick = rand.RandomDouble();
+        rand.skipToDimension(DimensionAperture);
+        const double s = rand.RandomDouble();
+        const double t = rand.RandomDouble();
+        vec2d p = m_reflectorSampler->sample(pick, s, t, weight);
+        origin = vec3d(p.x, p.y, 0.);
+        if (cellIndex) *cellIndex = -1;
+    } else if (m_translation) {
+        rand.skipToDimension(DimensionAperture);
+        const double u = rand.RandomDouble();
+        origin = m_translation->sampleAperture(u, rand.RandomDouble());
+        if (cellIndex) *cellIndex = -1;
+    } else {
+        int index;
+        if (m_cellImportance)
+            index = m_cellImportance->sample(rand.RandomDouble(), weight);
+        else
+            index = int(rand.RandomDouble()*m_sunCells.size());
+        if (cellIndex) *cellIndex = index;
+        QPair<int, int> cell = m_sunCells[index];
+
+        rand.skipToDimension(DimensionAperture);
+        origin = m_sunAperture->Sample(rand.RandomDouble(), rand.RandomDouble(), cell.first, cell.second);
+    }
+    rand.skipToDimension(DimensionSun);
+    *ray = m_sunTransform(Ray(origin, sunDirection(rand)));
+    if (m_translation)
+        m_translation->enter(*ray);
     return true;
 }
+
+vec3d RayTracer::sunDirection(Random& rand) const
+{
+    if (!m_sunDirections)
+        return m_sunShape->generateRay(rand);
+    const qulonglong picks = 8*qulonglong(m_sunDirections->size());
+    qulonglong pick = qMin(qulonglong(rand.RandomDouble()*picks), picks - 1);
+    return turnAboutAxis((*m_sunDirections)[pick >> 3], int(pick & 7));
+}
@@ -5,16 +5,21 @@
 #include <functional>
 #include <vector>
 
+#include <QHash>
+#include <QSet>
 #include <QVector>
 #include <QMap>
 #include <QPair>
 #include <QObject>
 
+#include "kernel/material/SlopeSampler.h"
 #include "libraries/math/3D/Transform.h"
 #include "libraries/math/3D/vec3d.h"
 
 class InstanceNode;
 class RandomParallel;
+class SceneBVH;
+struct SceneBVHHit;
 struct Photon;
 class Random;
 struct RayTracerPhoton;
@@ -24,12 +29,54 @@ class PhotonsBuffer;
 class SunAperture;
 class SunShape;
 class AirTransmission;
+class CellImportance;
+class ReflectorSampler;
+class TranslationalSymmetry;
+class FluxAccumulator;
+class MaterialRT;
+class MaterialVariants;
+class LookupTable;
+class PowerBudget;
+class TraceStatistics;
 
 struct TONATIUH_KERNEL RayTracerHit
 {
     vec3d position;
     InstanceNode* surface = nullptr;
     bool isFront = false;
+    double weight = 1.; // of the ray arriving, 1 unless weighted
+    // the surface the ray reflected off first, null for rays from the sun
+    // not reflected yet and for reflected rays given by setPrimaryRays
+    InstanceNode* reflector = nullptr;
+    // in SunAperture::getCells of the cell the ray left, -1 for rays given by
+    // setPrimaryRays or drawn by setReflectorSampler or setTranslationalSymmetry
+    int cell = -1;
+};
+
+// a ray without its bounds, recorded to be traced again
+struct TONATIUH_KERNEL RayTracerRay
+{
+    vec3d origin;
+    vec3d direction;
+};
+
+// the first intersection of a ray from the sun, recorded to be reused
+struct TONATIUH_KERNEL RayTracerFirstBounce
+{
+    RayTracerRay ray;
+    double distance = 0.; // to the hit, infinity for rays hitting nothing
+    InstanceNode* surface = nullptr;
+    bool isFront = false;
+    bool isReflected = false;
+    RayTracerRay reflected; // if isReflected
+};
+
+// a specular mirror material that rays from the sun reflect off with its slope
+// errors read from tables, see RayTracer::setSpecularSpreads
+struct TONATIUH_KERNEL RayTracerSpread
+{
+    double reflectivity = 1.;
+    SlopeSampler slope;
 };
 
 class TONATIUH_KERNEL RayTracer
@@ -37,7 +84,11 @@ class TONATIUH_KERNEL RayTracer
 
 public:
     using HitCallback = std::function<void(const RayTracerHit&)>;
+    using EscapeCallback = std::function<void(const RayTracerRay&)>;
+    using FirstBounceCallback = std::function<void(const RayTracerFirstBounce&)>;
 
+    // mutexRand guards a generator shared by tracers, and is null for one
+    // drawn by this tracer only, which is then read without a wrapper
     RayTracer(InstanceNode* instanceRoot,
               InstanceNode* instanceSun,
               SunAperture* sunAperture,
@@ -47,16 +98,140 @@ public:
               QMutex* mutexRand,
               PhotonsBuffer* photonBuffer,
               QMutex* mutexPhotons,
-              QVector<InstanceNode*> exportSuraceList,
+              const QVector<InstanceNode*>& exportSuraceList,
               std::atomic_bool* exportFailed = nullptr,
               HitCallback hitCallback = HitCallback());
 
     typedef void result_type;
 
+    // optional compiled scene, traversed instead of the instance tree
+    void setSceneBVH(const SceneBVH* sceneBVH) {m_sceneBVH = sceneBVH;}
+
+    // rays per wavefront batch, 0 traces depth-first
+    // wavefront tracing needs a compiled scene and no photon buffer
+    void setWavefrontSize(ulong size) {m_wavefrontSize = size;}
+
+    // sorts the rays of a wavefront batch between bounces by the instance
+    // they leave, their direction octant and the Morton code of their origin;
+    // the rays are the same, the draws of the next bounces go in another order
+    void setBounceSorting(bool sort) {m_sortBounces = sort;}
+
+    // records photons into pages of a paged buffer, see PhotonsBuffer::beginPages
+    // the call traces chunk \a chunk of the run on worker \a worker
+    void setPhotonPages(int worker, qulonglong chunk) {m_pageWorker = worker; m_pageChunk = chunk;}
+
+    // once per micro-batch of rays the rays traced are added to raysTraced
+    // and stop is polled, both relaxed; a stopped call returns early
+    void setProgress(std::atomic<ulong>* raysTraced, const std::atomic_bool* stop) {m_raysTraced = raysTraced; m_stop = stop;}
+
+    // called with every ray that leaves the scene after a reflection,
+    // not with rays absorbed by the air; needs no photon buffer
+    void setEscapeCallback(const EscapeCallback& callback) {m_escapeCallback = callback;}
+
+    // the call traces these rays, one per ray, instead of rays from the sun;
+    // they count as reflected once for air attenuation, or as rays from the
+    // sun with fromSun, recorded earlier by a first bounce callback
+    void setPrimaryRays(const RayTracerRay* rays, bool fromSun = false) {m_primaryRays = rays; m_primaryFromSun = fromSun;}
+
+    // called with the first intersection of every ray from the sun, once per
+    // ray and in order, by depth-first traces without a photon buffer
+    void setFirstBounceCallback(const FirstBounceCallback& callback) {m_firstBounceCallback = callback;}
+
+    // rays carry a weight, multiplied by the reflectivity of the materials
+    // that support it (MaterialRT::OutputRayWeighted) and by the air
+    // transmission instead of drawing whether they are absorbed; below
+    // rouletteWeight a ray survives with probability weight/rouletteWeight at
+    // rouletteWeight. 0 draws every interaction; photon buffers are not weighted
+    void setWeighted(double rouletteWeight) {m_rouletteWeight = rouletteWeight;}
+
+    // transmission read from table for distances up to distanceMax instead of
+    // the air model, see AirTransmission::tabulate
+    void setAirTable(const LookupTable* table, double distanceMax) {m_airTable = table; m_airTableMax = distanceMax;}
+
+    // rays from the sun take their directions, in the sun frame, from
+    // directions drawn once from the sunshape, each turned about the sun axis
+    // by one of the eight symmetries of a square; one draw picks both
+    void setSunDirections(const std::vector<vec3d>* directions) {m_sunDirections = directions;}
+
+    // a ray from the sun reflected first by a material of spreads leaves about
+    // the normal tilted by a sample of its SlopeSampler, with the reflectivity
+    // drawn or weighing the ray as in MaterialSpecular, instead of calling the
+    // material. Depth-first traces on a compiled scene, without primary rays
+    // or translational symmetry
+    void setSpecularSpreads(const QHash<const MaterialRT*, RayTracerSpread>* spreads) {m_spreads = spreads;}
+
+    // a ray from the sun meeting a surface first is traced on from that hit
+    // splits times, each path drawing the tracking error and the material
+    // there again and carrying 1/splits of the weight. Weighted depth-first
+    // traces on a compiled scene, without specular spreads, translational
+    // symmetry or a first bounce callback; rays given by setPrimaryRays split
+    // only with fromSun
+    void setFirstSplits(int splits) {m_splits = splits;}
+
+    // rays from the sun leave the cells drawn by importance, with its weights
+    // when weighted; importance numbers the cells of the sun aperture
+    void setCellImportance(const CellImportance* importance) {m_cellImportance = importance;}
+
+    // rays from the sun start on the apertures of sampler instead of the sun
+    // aperture cells, with its weights when weighted; hits then have no cell
+    void setReflectorSampler(const ReflectorSampler* sampler) {m_reflectorSampler = sampler;}
+
+    // the layout is one period of a field endless along the axis of symmetry:
+    // rays from the sun start on its strip, and rays leaving the period through
+    // an end enter it again through the other; depth-first traces only
+    void setTranslationalSymmetry(const TranslationalSymmetry* symmetry) {m_translation = symmetry;}
+
+    // adds the power of the rays traced to budget, hits counted for the
+    // surfaces numbered by surfaces only; budget is not locked
+    void setPowerBudget(PowerBudget* budget, const QHash<InstanceNode*, int>* surfaces) {m_budget = budget; m_budgetSurfaces = surfaces;}
+
+    // bins the hits into the grids of worker of flux before the hit callback,
+    // with no callback in between; the wavefront loop calls it the same way
+    void setFluxAccumulator(FluxAccumulator* flux, int worker) {m_flux = flux; m_fluxWorker = worker;}
+
+    // traces every ray for each variant with the same random numbers, which
+    // the generator must repeat (Random::repeatSample), and bins the hits of
+    // variant k into the grids of the flux worker of fluxes[k] only; a ray
+    // meeting no varied material is traced once for all. Depth-first on a
+    // compiled scene, without photon buffers or other hit consumers
+    void setMaterialVariants(const MaterialVariants* variants, const std::vector<FluxAccumulator*>* fluxes) {m_variants = variants; m_variantFluxes = fluxes;}
+
+    // counts into statistics, current for the thread while tracing, in
+    // builds with TONATIUHPP_TRACE_STATS; statistics is not locked
+    void setStatistics(TraceStatistics* statistics) {m_statistics = statistics;}
+
     void operator()(ulong nRays);
 
 private:
-    bool NewPrimitiveRay(Ray* ray, Random& rand);
+    // the cell and weight of the ray, without cell for rays of setPrimaryRays
+    bool NewPrimitiveRay(Ray* ray, Random& rand, int* cell = nullptr, double* weight = nullptr);
+    // a direction of the sunshape or of the bank, in the sun frame
+    vec3d sunDirection(Random& rand) const;
+    // origin as in SceneBVH::intersect, unused by the instance tree; with a
+    // translational symmetry a ray hitting a surface in another period is
+    // moved along its line so that ray.point(ray.tMax) is the hit
+    bool intersect(Ray& ray, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight = nullptr, int* origin = nullptr) const;
+    bool intersectScene(const Ray& ray, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight, int* origin) const;
+    // the first bounce of a ray from the sun, with the spreads
+    bool intersectSpread(Ray& ray, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight, int* origin) const;
+    // the first bounce of a ray from the sun with splits, found by the first
+    // and kept in hit for the others; weight is not null
+    bool intersectSplit(const Ray& ray, Random& rand, SceneBVHHit& hit, bool first, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight, int* origin) const;
+    // the depth-first loops, specialized on the air, the weights, the hit
+    // sink and the export filter of the tracer
+    template<class Sink> void traceDepthFirst(ulong nRays, Random& rand, const Sink& sink);
+    template<bool Air, bool Weighted, class Sink> void traceRays(ulong nRays, Random& rand, const Sink& sink);
+    template<class Exported> void tracePhotons(ulong nRays, Random& rand, const Exported& isExported);
+    template<bool Air, class Exported> void recordRays(ulong nRays, Random& rand, const Exported& isExported);
+    void traceVariants(ulong nRays, Random& rand);
+    bool traceVariant(Random& rand, std::vector<RayTracerHit>& hits);
+    void traceWavefront(ulong nRays, Random& rand);
+    void reportHit(const RayTracerHit& hit) const;
+    bool poll(ulong traced, ulong* reported) const;
+    double transmission(double distance) const;
+    bool survives(double& weight, Random& rand) const;
+    void addHitPower(InstanceNode* surface, bool isFront, double incident, double reflected) const;
+    void countHit(const InstanceNode* surface, int rayLength) const;
 
     InstanceNode* m_instanceLayout;
     InstanceNode* m_instanceSun;
@@ -70,7 +245,40 @@ private:
     QMutex* m_mutexPhotonsBuffer;
     std::atomic_bool* m_exportFailed;
     HitCallback m_hitCallback;
-    QVector<InstanceNode*> m_exportSurfaceList;
+    FluxAccumulator* m_flux = nullptr;
+    int m_fluxWorker = 0;
+    QSet<const InstanceNode*> m_exportSurfaces; // empty for all
+    const InstanceNode* m_receiver = nullptr; // the only export surface, as in flux analysis
 
     const std::vector< QPair<int, int> >&  m_sunCells;
+    const SceneBVH* m_sceneBVH = nullptr;
+    ulong m_wavefrontSize = 0;
+    bool m_sortBounces = false;
+    int m_pageWorker = -1;
+    qulonglong m_pageChunk = 0;
+    std::atomic<ulong>* m_raysTraced = nullptr;
+    const std::atomic_bool* m_stop = nullptr;
+    EscapeCallback m_escapeCallback;
+    const RayTracerRay* m_primaryRays = nullptr;
+    bool m_primaryFromSun = false;
+    FirstBounceCallback m_firstBounceCallback;
+    ulong m_primaryNext = 0;
+    const LookupTable* m_airTable = nullptr;
+    double m_airTableMax = 0.;
+    const std::vector<vec3d>* m_sunDirections = nullptr;
+    const QHash<const MaterialRT*, RayTracerSpread>* m_spreads = nullptr;
+    bool m_spreading = false; // in this call
+    int m_splits = 1;
+    bool m_splitting = false; // in this call
+    const CellImportance* m_cellImportance = nullptr;
+    const ReflectorSampler* m_reflectorSampler = nullptr;
+    const TranslationalSymmetry* m_translation = nullptr;
+    const MaterialVariants* m_variants = nullptr;
+    const std::vector<FluxAccumulator*>* m_variantFluxes = nullptr;
+    int m_variant = 0; // whose materials intersect evaluates
+    mutable bool m_metVaried = false; // since the ray began
+    double m_rouletteWeight = 0.;
+    PowerBudget* m_budget = nullptr;
+    const QHash<InstanceNode*, int>* m_budgetSurfaces = nullptr;
+    TraceStatistics* m_statistics = nullptr;
 };
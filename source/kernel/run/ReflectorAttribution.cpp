@@ -0,0 +1,156 @@
+#include "ReflectorAttribution.h"
+
+#include <algorithm>
+
+#include "kernel/run/InstanceNode.h"
+#include "kernel/run/RayTracer.h"
+#include "kernel/scene/TShapeKit.h"
+
+
+namespace {
+
+void findShapes(InstanceNode* instance, std::vector<InstanceNode*>& shapes)
+{
+    SoNode* node = instance->getNode();
+    if (node && node->getTypeId().isDerivedFrom(TShapeKit::getClassTypeId())) {
+        shapes.push_back(instance);
+        return;
+    }
+    for (InstanceNode* child : instance->children)
+        findShapes(child, shapes);
+}
+
+}
+
+
+ReflectorAttribution::ReflectorAttribution()
+{
+
+}
+
+ReflectorAttribution::~ReflectorAttribution()
+{
+
+}
+
+// before the first bind
+void ReflectorAttribution::addTarget(const QString& url)
+{
+    m_targets << url;
+    m_targetSurfaces.push_back(nullptr);
+    m_direct.push_back(0.);
+}
+
+/*!
+ * Numbers the shapes in the tree of \a root, which must be updated, after
+ * those of the trees bound before, matched by URL. Returns false if a
+ * target URL does not name a shape.
+ */
+bool ReflectorAttribution::bind(InstanceNode* root, QString* error)
+{
+    std::vector<InstanceNode*> shapes;
+    if (root)
+        findShapes(root, shapes);
+
+    QHash<QString, int> known;
+    for (int n = 0; n < m_reflectors.size(); ++n)
+        known.insert(m_reflectors[n], n);
+    m_reflectorIndices.clear();
+    for (InstanceNode* shape : shapes) {
+        const QString url = shape->getURL();
+        auto found = known.constFind(url);
+        if (found == known.constEnd()) {
+            found = known.insert(url, m_reflectors.size());
+            m_reflectors << url;
+        }
+        m_reflectorIndices.insert(shape, found.value());
+    }
+    m_incident.resize(static_cast<std::size_t>(m_reflectors.size()), 0.);
+    m_intercepted.resize(static_cast<std::size_t>(m_reflectors.size())*m_targets.size(), 0.);
+
+    for (int t = 0; t < m_targets.size(); ++t) {
+        m_targetSurfaces[t] = nullptr;
+        for (InstanceNode* shape : shapes)
+            if (shape->getURL() == m_targets[t]) {
+                m_targetSurfaces[t] = shape;
+                break;
+            }
+        if (!m_targetSurfaces[t]) {
+            if (error) *error = QString("Attribution target %1 was not found.").arg(m_targets[t]);
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReflectorAttribution::beginWorkers(int workers)
+{
+    m_workers.clear();
+    for (int w = 0; w < qMax(1, workers); ++w)
+    {
+        std::unique_ptr<Worker> worker(new Worker);
+        worker->incident.assign(m_incident.size(), 0.);
+        worker->intercepted.assign(m_intercepted.size(), 0.);
+        worker->direct.assign(m_direct.size(), 0.);
+        m_workers.push_back(std::move(worker));
+    }
+}
+
+ReflectorAttribution::HitCallback ReflectorAttribution::hitCallback(int worker)
+{
+    Worker* w = m_workers[worker].get();
+    return [this, w](const RayTracerHit& hit) {
+        addHit(*w, hit);
+    };
+}
+
+void ReflectorAttribution::addHit(Worker& worker, const RayTracerHit& hit) const
+{
+    int reflector = -1;
+    if (hit.reflector) {
+        const auto found = m_reflectorIndices.constFind(hit.reflector);
+        if (found == m_reflectorIndices.constEnd()) return;
+        reflector = found.value();
+    } else {
+        const auto found = m_reflectorIndices.constFind(hit.surface);
+        if (found != m_reflectorIndices.constEnd())
+            worker.incident[found.value()] += hit.weight;
+    }
+
+    for (std::size_t t = 0; t < m_targetSurfaces.size(); ++t) {
+        if (hit.surface != m_targetSurfaces[t]) continue;
+        if (reflector < 0)
+            worker.direct[t] += hit.weight;
+        else
+            worker.intercepted[std::size_t(reflector)*m_targetSurfaces.size() + t] += hit.weight;
+    }
+}
+
+void ReflectorAttribution::endWorkers()
+{
+    for (const std::unique_ptr<Worker>& worker : m_workers)
+    {
+        for (std::size_t n = 0; n < m_incident.size(); ++n)
+            m_incident[n] += worker->incident[n];
+        for (std::size_t n = 0; n < m_intercepted.size(); ++n)
+            m_intercepted[n] += worker->intercepted[n];
+        for (std::size_t n = 0; n < m_direct.size(); ++n)
+            m_direct[n] += worker->direct[n];
+    }
+    m_workers.clear();
+}
+
+qulonglong ReflectorAttribution::getMemoryUsage() const
+{
+    qulonglong ans = qulonglong(m_incident.capacity() + m_intercepted.capacity() + m_direct.capacity())*sizeof(double);
+    for (const std::unique_ptr<Worker>& worker : m_workers)
+        ans += qulonglong(worker->incident.capacity() + worker->intercepted.capacity() + worker->direct.capacity())*sizeof(double);
+    return ans;
+}
+
+void ReflectorAttribution::clear()
+{
+    std::fill(m_incident.begin(), m_incident.end(), 0.);
+    std::fill(m_intercepted.begin(), m_intercepted.end(), 0.);
+    std::fill(m_direct.begin(), m_direct.end(), 0.);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+class InstanceNode;
+struct RayTracerHit;
+
+
+//! ReflectorAttribution sums target hits by the surface rays reflected off first.
+/*!
+ * Every shape of the traced tree is a reflector, numbered in tree order by
+ * bind(). A hit of a ray not reflected yet adds its weight to the incident
+ * power of the surface hit; a hit on a target adds its weight to the
+ * (reflector, target) cell of the first reflector of the ray, or to the
+ * direct power of the target. Both sides of a target count, and every hit
+ * of a ray on it, as in the flux grids.
+ *
+ * The power a heliostat puts on a receiver over the power it intercepts
+ * from the sun is then its optical efficiency, without exporting photons.
+ *
+ * Every worker fills its own matrix through hitCallback(worker) and
+ * endWorkers() adds them to the totals in worker order, so several traces
+ * in a row accumulate. Whole weights are exact in any order.
+ */
+class TONATIUH_KERNEL ReflectorAttribution
+{
+public:
+    using HitCallback = std::function<void(const RayTracerHit&)>;
+
+    ReflectorAttribution();
+    ~ReflectorAttribution();
+
+    void addTarget(const QString& url);
+    int getTargetCount() const {return m_targets.size();}
+    const QString& getTarget(int n) const {return m_targets[n];}
+
+    // the reflectors of a tree bound before are kept, so totals stay in place
+    bool bind(InstanceNode* root, QString* error = nullptr);
+    int getReflectorCount() const {return m_reflectors.size();}
+    const QString& getReflector(int n) const {return m_reflectors[n];}
+
+    void beginWorkers(int workers);
+    HitCallback hitCallback(int worker);
+    void endWorkers();
+    void clear();
+    // bytes of the sums of the totals and of the workers
+    qulonglong getMemoryUsage() const;
+
+    // weight of the rays from the sun hitting the reflector before any other
+    double getIncident(int reflector) const {return m_incident[reflector];}
+    // weight arriving on the target of the rays the reflector reflected first
+    double getIntercepted(int reflector, int target) const {return m_intercepted[std::size_t(reflector)*m_targets.size() + target];}
+    // weight arriving on the target straight from the sun
+    double getDirect(int target) const {return m_direct[target];}
+
+private:
+    struct Worker
+    {
+        std::vector<double> incident;    // per reflector
+        std::vector<double> intercepted; // reflectors by targets
+        std::vector<double> direct;      // per target
+    };
+
+    void addHit(Worker& worker, const RayTracerHit& hit) const;
+
+    QStringList m_targets;
+    std::vector<InstanceNode*> m_targetSurfaces; // valid while bound
+    QStringList m_reflectors;
+    QHash<InstanceNode*, int> m_reflectorIndices; // valid while bound
+    std::vector<double> m_incident;
+    std::vector<double> m_intercepted;
+    std::vector<double> m_direct;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+};
@@ -0,0 +1,110 @@
+#include "ReflectorSampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+void ReflectorSampler::setApertures(const std::vector<Box2D>& apertures, const std::vector<double>& factors)
+{
+    m_apertures = apertures;
+    m_densities.assign(apertures.size(), 0.);
+    m_drawn.clear();
+    m_cumulative.clear();
+    m_area = 0.;
+    m_box = Box2D();
+
+    std::vector<double> shares;
+    for (size_t r = 0; r < apertures.size(); ++r) {
+        const Box2D& box = apertures[r];
+        const double area = box.isValid() ? box.area() : 0.;
+        const double factor = r < factors.size() ? std::max(0., factors[r]) : 1.;
+        if (!(area > 0.) || !(factor > 0.) || !std::isfinite(area*factor)) continue;
+        m_drawn.push_back(int(r));
+        shares.push_back(area*factor);
+        m_area += area;
+        m_box.expand(box);
+    }
+    double total = 0.;
+    for (double share : shares)
+        total += share;
+    double sum = 0.;
+    for (size_t k = 0; k < m_drawn.size(); ++k) {
+        m_densities[m_drawn[k]] = shares[k]/total/m_apertures[m_drawn[k]].area();
+        m_cumulative.push_back(sum += shares[k]/total);
+    }
+    // the last end is one, so every u below it finds an aperture
+    if (!m_cumulative.empty()) m_cumulative.back() = 1.;
+
+    m_cols = m_rows = 0;
+    m_cellBegins.clear();
+    m_cellApertures.clear();
+    if (m_drawn.empty()) return;
+
+    // about one cell per aperture, square in the sun plane
+    const vec2d size = m_box.size();
+    const double cell = std::sqrt(size.x*size.y/m_drawn.size());
+    m_cols = cell > 0. ? std::max(1, std::min(int(std::ceil(size.x/cell)), 4096)) : 1;
+    m_rows = cell > 0. ? std::max(1, std::min(int(std::ceil(size.y/cell)), 4096)) : 1;
+
+    auto cellRange = [this](const Box2D& box, int* i0, int* i1, int* j0, int* j1) {
+        const vec2d a = (box.min() - m_box.min())/m_box.size();
+        const vec2d b = (box.max() - m_box.min())/m_box.size();
+        *i0 = std::max(0, std::min(int(a.x*m_cols), m_cols - 1));
+        *i1 = std::max(0, std::min(int(b.x*m_cols), m_cols - 1));
+        *j0 = std::max(0, std::min(int(a.y*m_rows), m_rows - 1));
+        *j1 = std::max(0, std::min(int(b.y*m_rows), m_rows - 1));
+    };
+
+    // counted, then filled in place
+    m_cellBegins.assign(size_t(m_cols)*m_rows + 1, 0);
+    for (int r : m_drawn) {
+        int i0, i1, j0, j1;
+        cellRange(m_apertures[r], &i0, &i1, &j0, &j1);
+        for (int j = j0; j <= j1; ++j)
+            for (int i = i0; i <= i1; ++i)
+                m_cellBegins[size_t(j)*m_cols + i + 1]++;
+    }
+    for (size_t c = 1; c < m_cellBegins.size(); ++c)
+        m_cellBegins[c] += m_cellBegins[c - 1];
+    m_cellApertures.resize(m_cellBegins.back());
+    std::vector<int> next(m_cellBegins.begin(), m_cellBegins.end() - 1);
+    for (int r : m_drawn) {
+        int i0, i1, j0, j1;
+        cellRange(m_apertures[r], &i0, &i1, &j0, &j1);
+        for (int j = j0; j <= j1; ++j)
+            for (int i = i0; i <= i1; ++i)
+                m_cellApertures[next[size_t(j)*m_cols + i]++] = r;
+    }
+}
+
+double ReflectorSampler::getProbability(int aperture) const
+{
+    return m_densities[aperture]*m_apertures[aperture].area();
+}
+
+vec2d ReflectorSampler::sample(double u, double s, double t, double* weight) const
+{
+    int k = int(std::upper_bound(m_cumulative.begin(), m_cumulative.end(), u) - m_cumulative.begin());
+    k = std::min(k, int(m_cumulative.size()) - 1);
+    const vec2d p = m_apertures[m_drawn[k]].fromNormalized(vec2d(s, t));
+    if (weight) *weight = findWeight(p);
+    return p;
+}
+
+double ReflectorSampler::findWeight(const vec2d& p) const
+{
+    if (m_drawn.empty()) return 0.;
+    const vec2d q = (p - m_box.min())/m_box.size();
+    const int i = std::max(0, std::min(int(q.x*m_cols), m_cols - 1));
+    const int j = std::max(0, std::min(int(q.y*m_rows), m_rows - 1));
+    const size_t c = size_t(j)*m_cols + i;
+
+    double density = 0.;
+    for (int n = m_cellBegins[c]; n < m_cellBegins[c + 1]; ++n) {
+        const int r = m_cellApertures[n];
+        if (m_apertures[r].isInside(p))
+            density += m_densities[r];
+    }
+    // outside every aperture, it is never drawn
+    return density > 0. ? 1./(m_area*density) : 0.;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include "libraries/math/2D/Box2D.h"
+
+
+//! ReflectorSampler starts the rays from the sun on the apertures of the surfaces.
+/*!
+ * An aperture is the bounding rectangle of a surface projected on the sun
+ * plane, in the sun frame. A ray picks aperture r with probability p_r,
+ * proportional to its area times a factor, 1 unless given, and a point
+ * uniformly in it. Apertures overlap where surfaces are close, so a point x
+ * may be drawn from several; its ray carries the weight 1/(A q(x)), q(x)
+ * the sum of p_r/A_r over the apertures holding x and A the sum of their
+ * areas. The weighted flux then has the mean of a uniform trace from a sun
+ * aperture of area A, and with disjoint apertures and no factors every
+ * weight is one. Apertures of zero area or factor are never drawn.
+ *
+ * The apertures holding a point are found in a grid of about one cell per
+ * aperture over their bounds.
+ */
+class TONATIUH_KERNEL ReflectorSampler
+{
+public:
+    // factors one per aperture and not negative, or empty for all one
+    void setApertures(const std::vector<Box2D>& apertures, const std::vector<double>& factors = std::vector<double>());
+
+    int getApertureCount() const {return int(m_apertures.size());}
+    // of the apertures drawn
+    double getArea() const {return m_area;}
+    double getProbability(int aperture) const;
+    bool isEmpty() const {return m_drawn.empty();}
+
+    // the point of (u, s, t) in [0, 1)^3 in the sun frame, with the weight of its ray
+    vec2d sample(double u, double s, double t, double* weight) const;
+    double findWeight(const vec2d& p) const;
+
+private:
+    std::vector<Box2D> m_apertures;
+    std::vector<double> m_densities; // p_r/A_r
+    std::vector<int> m_drawn; // apertures of nonzero probability
+    std::vector<double> m_cumulative; // upper ends, by m_drawn
+    double m_area = 0.;
+
+    Box2D m_box;
+    int m_cols = 0; // along x
+    int m_rows = 0;
+    std::vector<int> m_cellBegins; // into m_cellApertures, one more than cells
+    std::vector<int> m_cellApertures;
+};
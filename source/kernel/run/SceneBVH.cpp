@@ -0,0 +1,990 @@
+#include "SceneBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "kernel/material/MaterialRT.h"
+#include "kernel/material/MaterialTransparent.h"
+#include "kernel/profiles/ProfileBox.h"
+#include "kernel/profiles/ProfileRectangular.h"
+#include "kernel/run/HugePages.h"
+#include "kernel/run/InstanceNode.h"
+#include "kernel/run/TraceEvents.h"
+#include "kernel/run/TraceStatistics.h"
+#include "kernel/scene/TSeparatorKit.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/ShapeCylinder.h"
+#include "kernel/shape/ShapeParabolic.h"
+#include "kernel/shape/ShapePlanar.h"
+#include "kernel/shape/ShapeSphere.h"
+#include "kernel/trackers/TrackingError.h"
+#include "libraries/math/3D/Ray.h"
+
+
+namespace {
+
+// the material and shape of an unshared leaf, false if it is not traced
+bool readLeaf(InstanceNode* node, SceneBVHInstance& leaf)
+{
+    TShapeKit* kit = (TShapeKit*) node->getNode();
+
+    MaterialRT* material = (MaterialRT*) kit->materialRT.getValue();
+    if (!material) return false;
+    if (material->getTypeId() == MaterialTransparent::getClassTypeId()) return false;
+
+    ShapeRT* shape = (ShapeRT*) kit->shapeRT.getValue();
+    if (!shape) return false;
+
+    leaf.instance = node;
+    leaf.shape = shape;
+    leaf.profile = (ProfileRT*) kit->profileRT.getValue();
+    leaf.material = material;
+    return true;
+}
+
+// a prototype leaf relative to the prototype root
+void placeLeaf(const Transform& toRoot, SceneBVHInstance& leaf)
+{
+    Transform transform = toRoot * leaf.instance->getTransform();
+    leaf.transform = Affine3D(transform);
+    leaf.box = transform(leaf.shape->getBox(leaf.profile));
+}
+
+bool isSeparator(SoNode* node)
+{
+    return node->getTypeId() == TSeparatorKit::getClassTypeId();
+}
+
+void countSeparators(InstanceNode* node, std::unordered_map<SoNode*, int>& counts)
+{
+    SoNode* soNode = node->getNode();
+    if (!soNode) return;
+    if (isSeparator(soNode)) counts[soNode]++;
+    for (InstanceNode* child : node->children)
+        countSeparators(child, counts);
+}
+
+InstanceNode* findInstance(InstanceNode* root, const std::vector<int>& path)
+{
+    InstanceNode* node = root;
+    for (int row : path)
+        node = node->children[row];
+    return node;
+}
+
+// closest hit with the shape of a leaf, the geometry stays in the shape frame
+bool hitShape(const SceneBVHInstance& s, const Ray& ray, SceneBVHHit& hit)
+{
+    TRACE_STATS(boxTests++);
+    if (!s.box.intersect(ray)) return false;
+
+    Ray rayLocal = s.transform.transformInverse(ray);
+    double tHit = 0.;
+    DifferentialGeometry dg;
+    TRACE_STATS(addShapeTest(s.shape->getTypeName()));
+    if (!s.shape->intersect(rayLocal, &tHit, &dg, s.profile)) return false;
+
+    ray.tMax = tHit;
+    hit.leaf = &s;
+    hit.dg = dg;
+    return true;
+}
+
+// any hit, without the geometry
+bool blocksShape(const SceneBVHInstance& s, const Ray& ray)
+{
+    if (!s.box.intersect(ray)) return false;
+    return s.shape->intersectP(s.transform.transformInverse(ray), s.profile);
+}
+
+// the quadric of the analytic shapes, false for the others
+bool readQuadric(const SceneBVHInstance& leaf, QuadricBatch::Quadric& quadric)
+{
+    SoType type = leaf.shape->getTypeId();
+    if (type == ShapePlanar::getClassTypeId()) {
+        quadric.b = 1.;
+    } else if (type == ShapeParabolic::getClassTypeId()) {
+        ShapeParabolic* shape = (ShapeParabolic*) leaf.shape;
+        quadric.a = vec3d(1./shape->fX.getValue(), 1./shape->fY.getValue(), 0.);
+        quadric.b = -4.;
+    } else if (type == ShapeSphere::getClassTypeId()) {
+        quadric.a = vec3d(1., 1., 1.);
+        quadric.c = -1.;
+        return true;
+    } else if (type == ShapeCylinder::getClassTypeId()) {
+        ShapeCylinder* shape = (ShapeCylinder*) leaf.shape;
+        if (shape->caps.getValue() != ShapeCylinder::none) return false;
+        quadric.a = vec3d(1., 1., 0.);
+        quadric.c = -1.;
+        return true;
+    } else {
+        return false;
+    }
+
+    // planar and parabolic profiles are in x and y
+    SoType profileType = leaf.profile->getTypeId();
+    if (profileType == ProfileBox::getClassTypeId()) {
+        ProfileBox* profile = (ProfileBox*) leaf.profile;
+        quadric.xMax = profile->uSize.getValue()/2.;
+        quadric.xMin = -quadric.xMax;
+        quadric.yMax = profile->vSize.getValue()/2.;
+        quadric.yMin = -quadric.yMax;
+    } else if (profileType == ProfileRectangular::getClassTypeId()) {
+        ProfileRectangular* profile = (ProfileRectangular*) leaf.profile;
+        quadric.xMin = profile->uMin.getValue();
+        quadric.xMax = profile->uMax.getValue();
+        quadric.yMin = profile->vMin.getValue();
+        quadric.yMax = profile->vMax.getValue();
+    }
+    return true;
+}
+
+void fillBatch(const std::vector<SceneBVHInstance>& leaves, QuadricBatch& batch)
+{
+    batch.clear();
+    for (const SceneBVHInstance& leaf : leaves) {
+        QuadricBatch::Quadric quadric;
+        if (leaf.prototype < 0 && readQuadric(leaf, quadric))
+            batch.add(leaf.box, leaf.transform, quadric);
+        else
+            batch.add(leaf.box);
+    }
+}
+
+// the leaves in [begin, begin + count) kept by the batch, in order
+template<class Test>
+void forCandidates(const QuadricBatch& batch, const Ray& ray, int begin, int count, Test test)
+{
+    for (int n = begin; n < begin + count; n += QuadricBatch::Width)
+    {
+        int lanes = std::min(QuadricBatch::Width, begin + count - n);
+        int mask = batch.filter(ray, n, lanes);
+        for (int k = 0; k < lanes; ++k)
+            if (mask & (1 << k)) test(n + k);
+    }
+}
+
+// as forCandidates until test returns true
+template<class Test>
+bool anyCandidate(const QuadricBatch& batch, const Ray& ray, int begin, int count, Test test)
+{
+    for (int n = begin; n < begin + count; n += QuadricBatch::Width)
+    {
+        int lanes = std::min(QuadricBatch::Width, begin + count - n);
+        int mask = batch.filter(ray, n, lanes);
+        for (int k = 0; k < lanes; ++k)
+            if ((mask & (1 << k)) && test(n + k)) return true;
+    }
+    return false;
+}
+
+void transformGeometry(const Affine3D& transform, DifferentialGeometry& dg)
+{
+    dg.point = transform.transformPoint(dg.point);
+    dg.dpdu = transform.transformVector(dg.dpdu);
+    dg.dpdv = transform.transformVector(dg.dpdv);
+    dg.normal = transform.transformNormal(dg.normal);
+}
+
+// items per thread below which refits stay on the calling thread
+const int RefitGrain = 4096;
+
+// f(begin, end) over ranges of [0, count) of at least grain items, one per thread
+template<class F>
+void parallelFor(int count, int grain, F f)
+{
+    const int threads = std::max(1, std::min(int(std::thread::hardware_concurrency()), count/grain));
+    if (threads == 1) {
+        f(0, count);
+        return;
+    }
+    const int step = (count + threads - 1)/threads;
+    std::vector<std::thread> workers;
+    for (int w = 1; w < threads; ++w)
+        workers.emplace_back(f, w*step, std::min(count, (w + 1)*step));
+    f(0, std::min(count, step));
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void refitNode(std::vector<BVHNode4>& nodes, int n, const std::vector<SceneBVHInstance>& leaves)
+{
+    BVHNode4& node = nodes[n];
+    for (int lane = 0; lane < Box3DPack::Width; ++lane)
+    {
+        int child = node.child[lane];
+        if (child < 0) continue;
+        Box3D box;
+        if (node.count[lane] > 0) {
+            for (int i = child; i < child + node.count[lane]; ++i)
+                box << leaves[i].box;
+        } else {
+            const BVHNode4& c = nodes[child];
+            for (int k = 0; k < Box3DPack::Width; ++k)
+                if (c.child[k] >= 0) box << c.boxes.box(k);
+        }
+        node.boxes.set(lane, box);
+    }
+}
+
+// recomputes the lane boxes from the leaves, children are stored after their node;
+// large hierarchies go level by level from the deepest, each level in parallel
+void refitNodes(std::vector<BVHNode4>& nodes, const std::vector<SceneBVHInstance>& leaves)
+{
+    const int size = int(nodes.size());
+    if (size < 2*RefitGrain) {
+        for (int n = size - 1; n >= 0; --n)
+            refitNode(nodes, n, leaves);
+        return;
+    }
+
+    std::vector<int> depths(nodes.size(), 0);
+    std::vector<std::vector<int>> levels;
+    for (int n = 0; n < size; ++n) {
+        const BVHNode4& node = nodes[n];
+        for (int lane = 0; lane < Box3DPack::Width; ++lane)
+            if (node.child[lane] >= 0 && node.count[lane] == 0)
+                depths[node.child[lane]] = depths[n] + 1;
+        if (depths[n] >= int(levels.size())) levels.resize(depths[n] + 1);
+        levels[depths[n]].push_back(n);
+    }
+    for (int d = int(levels.size()) - 1; d >= 0; --d) {
+        const std::vector<int>& level = levels[d];
+        parallelFor(int(level.size()), RefitGrain, [&](int begin, int end) {
+            for (int k = begin; k < end; ++k)
+                refitNode(nodes, level[k], leaves);
+        });
+    }
+}
+
+} // namespace
+
+
+struct SceneBVH::Collector
+{
+    const InstanceNode* excluded = nullptr;
+    std::unordered_map<SoNode*, int> counts;     // instances of each separator
+    std::unordered_set<SoNode*> unshared;        // the excluded node and its ancestors
+    std::unordered_map<SoNode*, int> prototypes; // -1 if not worth sharing
+};
+
+/*!
+ * Reads the shape, profile and material of every TShapeKit leaf from the Coin
+ * kit fields once; leaves without a shape, or with an absent or transparent
+ * material, are dropped. Distinct shapes and materials are numbered in scene
+ * order, so tracing never goes through SoSFNode fields or type checks.
+ *
+ * Subtrees shared by several parents (Coin DEF/USE) with more than one leaf
+ * are compiled once into a SceneBVHPrototype; the top level holds one leaf per
+ * instance of them, with its transform only, so repeated facets or meshes do
+ * not add leaves per copy. Intersection matches InstanceNode::intersect.
+ */
+SceneBVH::SceneBVH(InstanceNode* root, int leafSize, const InstanceNode* excluded):
+    m_leafSize(leafSize)
+{
+    if (!root) return;
+    TraceEventScope event("compile BVH", "setup");
+
+    Collector collector;
+    collector.excluded = excluded;
+    countSeparators(root, collector.counts);
+    for (const InstanceNode* node = excluded; node; node = node->getParent())
+        collector.unshared.insert(node->getNode());
+    collect(root, collector);
+    if (m_instances.empty()) return;
+    makeTables();
+
+    for (SceneBVHPrototype& prototype : m_prototypes)
+    {
+        std::vector<Box3D> boxes;
+        boxes.reserve(prototype.leaves.size());
+        for (const SceneBVHInstance& leaf : prototype.leaves) {
+            boxes.push_back(leaf.box);
+            prototype.box << leaf.box;
+        }
+
+        BVHBuilder builder(leafSize);
+        builder.build(boxes);
+        builder.reorder(prototype.leaves);
+        builder.reorder(prototype.paths);
+        HugePages::assign(prototype.nodes, builder.getNodes().begin(), builder.getNodes().end());
+        fillBatch(prototype.leaves, prototype.batch);
+    }
+
+    for (const SceneBVHInstance& leaf : m_instances)
+        m_box << leaf.box;
+    buildTop();
+    fillBatch(m_instances, m_batch);
+}
+
+// the top-level hierarchy over the instance boxes, with the neighbour lists renumbered
+void SceneBVH::buildTop()
+{
+    std::vector<Box3D> boxes;
+    boxes.reserve(m_instances.size());
+    for (const SceneBVHInstance& leaf : m_instances)
+        boxes.push_back(leaf.box);
+
+    BVHBuilder builder(m_leafSize);
+    builder.build(boxes);
+    if (hasNeighbours()) {
+        const std::vector<int>& order = builder.getOrder();
+        std::vector<int> indices(order.size());
+        for (size_t n = 0; n < order.size(); ++n)
+            indices[order[n]] = int(n);
+        std::vector<int> offsets = {0};
+        std::vector<int> neighbours;
+        neighbours.reserve(m_neighbours.size());
+        for (int n : order) {
+            for (int k = m_neighbourOffsets[n]; k < m_neighbourOffsets[n + 1]; ++k)
+                neighbours.push_back(indices[m_neighbours[k]]);
+            offsets.push_back(int(neighbours.size()));
+        }
+        m_neighbourOffsets.swap(offsets);
+        m_neighbours.swap(neighbours);
+    }
+    builder.reorder(m_instances);
+    HugePages::assign(m_nodes, builder.getNodes().begin(), builder.getNodes().end());
+    m_builtCost = BVHStatistics::find(m_nodes).sahCost;
+}
+
+/*!
+ * Updates the leaves from their instances and the node boxes bottom-up,
+ * the top-level instances and nodes in parallel on large fields.
+ * The leaves must be the same as when built: only moved, not added or removed.
+ *
+ * If maxCostRatio is positive and the SAH cost of the refitted top level
+ * passes maxCostRatio times its cost when last built, as trackers turning
+ * far from their orientation then make the boxes overlap, the top level is
+ * built again over the new boxes. Returns whether it was.
+ */
+bool SceneBVH::refit(double maxCostRatio)
+{
+    TraceEventScope event("refit BVH", "setup");
+    m_sunView = SunView();
+    for (SceneBVHPrototype& prototype : m_prototypes)
+    {
+        Transform toRoot = prototype.instance->getTransform().inversed();
+        prototype.box = Box3D();
+        for (SceneBVHInstance& leaf : prototype.leaves) {
+            placeLeaf(toRoot, leaf);
+            prototype.box << leaf.box;
+        }
+        refitNodes(prototype.nodes, prototype.leaves);
+        fillBatch(prototype.leaves, prototype.batch);
+    }
+
+    parallelFor(instanceCount(), RefitGrain, [this](int begin, int end) {
+        for (int n = begin; n < end; ++n) {
+            SceneBVHInstance& leaf = m_instances[n];
+            if (leaf.prototype >= 0) {
+                leaf.box = leaf.instance->getTransform()(m_prototypes[leaf.prototype].box);
+            } else {
+                leaf.box = leaf.instance->getBox();
+            }
+            leaf.transform = leaf.instance->getAffine();
+        }
+    });
+    m_box = Box3D();
+    for (const SceneBVHInstance& leaf : m_instances)
+        m_box << leaf.box;
+    refitNodes(m_nodes, m_instances);
+
+    bool rebuilt = false;
+    if (maxCostRatio > 0. && !m_nodes.empty() && BVHStatistics::find(m_nodes).sahCost > maxCostRatio*m_builtCost) {
+        TraceEventScope rebuild("rebuild BVH", "setup");
+        buildTop();
+        rebuilt = true;
+    }
+    fillBatch(m_instances, m_batch);
+    if (m_isSingle) makeSingleNodes();
+    return rebuilt;
+}
+
+/*!
+ * Traverses both levels with float node boxes. Shapes are still intersected
+ * in double, so hits differ from the double traversal only where two leaves
+ * tie for the closest hit.
+ */
+void SceneBVH::setSinglePrecision(bool on)
+{
+    m_isSingle = on;
+    if (on) {
+        makeSingleNodes();
+    } else {
+        m_nodesSingle.clear();
+        for (SceneBVHPrototype& prototype : m_prototypes)
+            prototype.nodesSingle.clear();
+    }
+}
+
+void SceneBVH::makeSingleNodes()
+{
+    for (SceneBVHPrototype& prototype : m_prototypes)
+        HugePages::assign(prototype.nodesSingle, prototype.nodes.begin(), prototype.nodes.end());
+    HugePages::assign(m_nodesSingle, m_nodes.begin(), m_nodes.end());
+}
+
+qulonglong SceneBVH::getMemoryUsage() const
+{
+    auto bytes = [](const auto& v) {return qulonglong(v.capacity()*sizeof(v[0]));};
+    qulonglong ans = bytes(m_instances) + bytes(m_prototypes) + bytes(m_nodes) + bytes(m_nodesSingle) +
+        m_batch.getMemoryUsage() + bytes(m_shapes) + bytes(m_materials) +
+        bytes(m_neighbourOffsets) + bytes(m_neighbours) + bytes(m_sunView.cells) + bytes(m_sunView.items);
+    for (const SceneBVHPrototype& prototype : m_prototypes) {
+        ans += bytes(prototype.leaves) + bytes(prototype.paths) + bytes(prototype.nodes) +
+            bytes(prototype.nodesSingle) + prototype.batch.getMemoryUsage();
+        for (const std::vector<int>& path : prototype.paths)
+            ans += bytes(path);
+    }
+    return ans;
+}
+
+std::vector<SceneBVHInstance> SceneBVH::findLeaves() const
+{
+    std::vector<SceneBVHInstance> ans;
+    for (const SceneBVHInstance& leaf : m_instances)
+    {
+        if (leaf.prototype < 0) {
+            ans.push_back(leaf);
+            continue;
+        }
+        const SceneBVHPrototype& prototype = m_prototypes[leaf.prototype];
+        for (size_t n = 0; n < prototype.leaves.size(); ++n) {
+            SceneBVHInstance s = prototype.leaves[n];
+            s.instance = findInstance(leaf.instance, prototype.paths[n]);
+            s.box = s.instance->getBox();
+            s.transform = s.instance->getAffine();
+            s.trackingError = TrackingError::find(s.instance);
+            ans.push_back(s);
+        }
+    }
+    return ans;
+}
+
+/*!
+ * Collects the shape leaves that InstanceNode::intersect would test.
+ * The first instance of a shared subtree with several leaves makes its prototype.
+ * The tree must be updated with InstanceNode::updateTree beforehand.
+ */
+void SceneBVH::collect(InstanceNode* node, Collector& collector)
+{
+    if (node == collector.excluded) return;
+    SoNode* soNode = node->getNode();
+    if (!soNode) return;
+
+    if (soNode->getTypeId() == TShapeKit::getClassTypeId())
+    {
+        SceneBVHInstance leaf;
+        if (!readLeaf(node, leaf)) return;
+        leaf.box = node->getBox();
+        leaf.transform = node->getAffine();
+        leaf.trackingError = TrackingError::find(node);
+        m_instances.push_back(leaf);
+    }
+    else if (isSeparator(soNode) || node->children.size() == 1)
+    {
+        if (isSeparator(soNode) && collector.counts[soNode] > 1 && !collector.unshared.count(soNode))
+        {
+            auto it = collector.prototypes.find(soNode);
+            if (it == collector.prototypes.end()) {
+                SceneBVHPrototype prototype;
+                prototype.instance = node;
+                std::vector<int> path;
+                collectPrototype(node, prototype, path);
+                int index = -1;
+                if (prototype.leaves.size() > 1) {
+                    Transform toRoot = node->getTransform().inversed();
+                    for (SceneBVHInstance& leaf : prototype.leaves)
+                        placeLeaf(toRoot, leaf);
+                    index = int(m_prototypes.size());
+                    m_prototypes.push_back(std::move(prototype));
+                }
+                it = collector.prototypes.emplace(soNode, index).first;
+            }
+            if (it->second >= 0) {
+                SceneBVHInstance leaf;
+                leaf.instance = node;
+                leaf.prototype = it->second;
+                leaf.transform = node->getAffine();
+                Box3D box;
+                for (const SceneBVHInstance& s : m_prototypes[it->second].leaves)
+                    box << s.box;
+                leaf.box = node->getTransform()(box);
+                leaf.trackingError = TrackingError::find(node);
+                m_instances.push_back(leaf);
+                return;
+            }
+        }
+
+        for (InstanceNode* child : node->children)
+            collect(child, collector);
+    }
+}
+
+/*!
+ * Collects the shape leaves of a shared subtree, with their child rows from its root.
+ */
+void SceneBVH::collectPrototype(InstanceNode* node, SceneBVHPrototype& prototype, std::vector<int>& path)
+{
+    SoNode* soNode = node->getNode();
+    if (!soNode) return;
+
+    if (soNode->getTypeId() == TShapeKit::getClassTypeId())
+    {
+        SceneBVHInstance leaf;
+        if (!readLeaf(node, leaf)) return;
+        // trackers inside the subtree are shared by all its instances
+        leaf.trackingError = TrackingError::find(node, prototype.instance);
+        prototype.leaves.push_back(leaf);
+        prototype.paths.push_back(path);
+    }
+    else if (isSeparator(soNode) || node->children.size() == 1)
+    {
+        for (int n = 0; n < node->children.size(); ++n) {
+            path.push_back(n);
+            collectPrototype(node->children[n], prototype, path);
+            path.pop_back();
+        }
+    }
+}
+
+/*!
+ * Numbers the distinct shapes and materials in the order they were collected.
+ */
+void SceneBVH::makeTables()
+{
+    std::unordered_map<ShapeRT*, int> shapes;
+    std::unordered_map<MaterialRT*, int> materials;
+    auto number = [&](SceneBVHInstance& leaf) {
+        auto s = shapes.emplace(leaf.shape, int(m_shapes.size()));
+        if (s.second) m_shapes.push_back(leaf.shape);
+        leaf.shapeIndex = s.first->second;
+
+        auto m = materials.emplace(leaf.material, int(m_materials.size()));
+        if (m.second) m_materials.push_back(leaf.material);
+        leaf.materialIndex = m.first->second;
+    };
+
+    int numbered = 0; // prototypes are made in the order of their first instance
+    for (SceneBVHInstance& leaf : m_instances)
+    {
+        if (leaf.prototype < 0) {
+            number(leaf);
+        } else if (leaf.prototype == numbered) {
+            for (SceneBVHInstance& s : m_prototypes[numbered].leaves)
+                number(s);
+            numbered++;
+        }
+    }
+}
+
+/*!
+ * Lists for every top-level instance the \a count instances with the nearest
+ * box centers, found in a grid over x and y with cells of the mean box
+ * width, and the instances under or holding one of \a targets. Count 0
+ * and no targets remove the lists.
+ *
+ * A ray leaving an instance, given as origin to findHit or occluded, tests
+ * them before the hierarchy: a hit on a neighbour, as a blocking heliostat,
+ * or on the receiver ends the traversal at its distance, and occluded stops
+ * there. The hierarchy is still traversed, so hits do not change, only the
+ * leaves tied for the closest may swap. refit keeps the lists, renumbered
+ * when it builds the top level again.
+ */
+void SceneBVH::findNeighbours(const std::vector<InstanceNode*>& targets, int count)
+{
+    TraceEventScope event("find neighbours", "setup");
+    m_neighbourOffsets.clear();
+    m_neighbours.clear();
+    const int size = instanceCount();
+    count = qMin(qMax(0, count), size - 1);
+    if (size == 0 || (count == 0 && targets.empty())) return;
+
+    auto isUnder = [](const InstanceNode* node, const InstanceNode* root) {
+        for (; node; node = node->getParent())
+            if (node == root) return true;
+        return false;
+    };
+    std::vector<int> targetIndices;
+    for (int n = 0; n < size; ++n) {
+        const InstanceNode* instance = m_instances[n].instance;
+        for (const InstanceNode* target : targets) {
+            if (isUnder(instance, target) || isUnder(target, instance)) {
+                targetIndices.push_back(n);
+                break;
+            }
+        }
+    }
+
+    std::vector<vec3d> centers(size);
+    double width = 0.;
+    for (int n = 0; n < size; ++n) {
+        const Box3D& box = m_instances[n].box;
+        centers[n] = box.center();
+        width += qMax(box.size().x, box.size().y);
+    }
+    width = qMax(width/size, m_box.size().norm()*1e-6);
+    if (!(width > 0.)) width = 1.;
+    // at most about four cells per instance
+    const double cells = (m_box.size().x/width + 1.)*(m_box.size().y/width + 1.);
+    if (cells > 4.*size) width *= std::sqrt(cells/(4.*size));
+    const int columns = int(m_box.size().x/width) + 1;
+    const int rows = int(m_box.size().y/width) + 1;
+    auto cellOf = [&](const vec3d& p, int& i, int& j) {
+        i = qBound(0, int((p.x - m_box.min().x)/width), columns - 1);
+        j = qBound(0, int((p.y - m_box.min().y)/width), rows - 1);
+    };
+
+    std::vector<int> cellStarts(size_t(columns)*rows + 1, 0);
+    std::vector<int> cellItems(size);
+    for (int n = 0; n < size; ++n) {
+        int i, j;
+        cellOf(centers[n], i, j);
+        cellStarts[size_t(j)*columns + i + 1]++;
+    }
+    for (size_t c = 1; c < cellStarts.size(); ++c)
+        cellStarts[c] += cellStarts[c - 1];
+    std::vector<int> cellFill(cellStarts.begin(), cellStarts.end() - 1);
+    for (int n = 0; n < size; ++n) {
+        int i, j;
+        cellOf(centers[n], i, j);
+        cellItems[cellFill[size_t(j)*columns + i]++] = n;
+    }
+
+    m_neighbourOffsets.reserve(size + 1);
+    m_neighbourOffsets.push_back(0);
+    std::vector<std::pair<double, int>> found;
+    for (int n = 0; n < size; ++n)
+    {
+        // rings of cells until count are found, and one more ring for those
+        // nearer than the ring distance in another cell
+        found.clear();
+        int i0, j0;
+        cellOf(centers[n], i0, j0);
+        int extra = -1;
+        for (int ring = 0; count > 0 && ring <= qMax(columns, rows); ++ring) {
+            for (int j = j0 - ring; j <= j0 + ring; ++j) {
+                for (int i = i0 - ring; i <= i0 + ring; ++i) {
+                    if (qMax(std::abs(i - i0), std::abs(j - j0)) != ring) continue;
+                    if (i < 0 || i >= columns || j < 0 || j >= rows) continue;
+                    size_t c = size_t(j)*columns + i;
+                    for (int k = cellStarts[c]; k < cellStarts[c + 1]; ++k)
+                        if (cellItems[k] != n)
+                            found.push_back({(centers[cellItems[k]] - centers[n]).norm2(), cellItems[k]});
+                }
+            }
+            if (extra < 0 && int(found.size()) >= count) extra = ring + 1;
+            if (ring == extra) break;
+        }
+        const int kept = qMin(count, int(found.size()));
+        std::partial_sort(found.begin(), found.begin() + kept, found.end());
+
+        const int begin = int(m_neighbours.size());
+        for (int k = 0; k < kept; ++k)
+            m_neighbours.push_back(found[k].second);
+        for (int t : targetIndices)
+            if (t != n && std::find(m_neighbours.begin() + begin, m_neighbours.end(), t) == m_neighbours.end())
+                m_neighbours.push_back(t);
+        m_neighbourOffsets.push_back(int(m_neighbours.size()));
+    }
+}
+
+/*!
+ * Makes the visibility grid of the scene seen from the sun, in place of
+ * rasterizing it: the top-level boxes are projected along the sun axis onto a
+ * grid across it, and every cell lists the instances over it by the least
+ * depth of their box along the axis. A ray within \a angle of the axis is
+ * looked up where it crosses the nearest depth of the scene and tests the
+ * instances of its cell in depth order, until the next one starts beyond its
+ * closest hit. A cell lists every instance such a ray can meet, so hits are
+ * those of the traversal but for leaves tied for the closest. refit drops the
+ * grid, since the boxes moved.
+ *
+ * The cells are as wide as the mean footprint of an instance, no wider than
+ * those of \a columns by \a rows over the view, at most about four per
+ * instance when that gives more. A footprint is widened by the tangent of
+ * \a angle times the depth from the nearest box of the scene to the back side
+ * of its own box: a ray looked up at that depth drifts no farther across the
+ * axis before it leaves the box. Boxes not finite leave no view.
+ */
+void SceneBVH::buildSunView(const vec3d& direction, double angle, int columns, int rows)
+{
+    TraceEventScope event("sun view", "setup");
+    m_sunView = SunView();
+    const int size = instanceCount();
+    if (size == 0 || !(direction.norm2() > 0.) || !(angle >= 0.) || !(angle < 0.5*gcf::pi)) return;
+
+    SunView view;
+    view.axis = direction.normalized();
+    view.u = cross(view.axis, std::abs(view.axis.x) < 0.9 ? vec3d::UnitX : vec3d::UnitY).normalized();
+    view.v = cross(view.axis, view.u);
+    view.cosAngle = std::cos(angle);
+
+    // the boxes across and along the axis
+    struct Footprint
+    {
+        double u0, u1, v0, v1;
+        double front, back;
+    };
+    std::vector<Footprint> footprints(size);
+    view.front = gcf::infinity;
+    double width = 0.;
+    for (int n = 0; n < size; ++n) {
+        const Box3D& box = m_instances[n].box;
+        Footprint f = {gcf::infinity, -gcf::infinity, gcf::infinity, -gcf::infinity, gcf::infinity, -gcf::infinity};
+        for (int c = 0; c < 8; ++c) {
+            const vec3d p((c & 1) ? box.max().x : box.min().x, (c & 2) ? box.max().y : box.min().y, (c & 4) ? box.max().z : box.min().z);
+            const double u = dot(p, view.u);
+            const double v = dot(p, view.v);
+            const double d = dot(p, view.axis);
+            f.u0 = qMin(f.u0, u);
+            f.u1 = qMax(f.u1, u);
+            f.v0 = qMin(f.v0, v);
+            f.v1 = qMax(f.v1, v);
+            f.front = qMin(f.front, d);
+            f.back = qMax(f.back, d);
+        }
+        if (!qIsFinite(f.u1 - f.u0) || !qIsFinite(f.v1 - f.v0) || !qIsFinite(f.back - f.front)) return;
+        width += qMax(f.u1 - f.u0, f.v1 - f.v0);
+        view.front = qMin(view.front, f.front);
+        footprints[n] = f;
+    }
+
+    // a ray inside the angle up to rounding stays inside
+    const double slope = std::tan(angle)*(1. + 1e-9);
+    const double margin = 1e-9*m_box.size().norm();
+    double u0 = gcf::infinity, u1 = -gcf::infinity, v0 = gcf::infinity, v1 = -gcf::infinity;
+    for (Footprint& f : footprints) {
+        const double drift = slope*(f.back - view.front) + margin;
+        f.u0 -= drift;
+        f.u1 += drift;
+        f.v0 -= drift;
+        f.v1 += drift;
+        u0 = qMin(u0, f.u0);
+        u1 = qMax(u1, f.u1);
+        v0 = qMin(v0, f.v0);
+        v1 = qMax(v1, f.v1);
+    }
+
+    width = qMax(width/size, (u1 - u0 + v1 - v0)*1e-6);
+    width = qMin(width, qMax((u1 - u0)/qMax(1, columns), (v1 - v0)/qMax(1, rows)));
+    if (!(width > 0.)) width = 1.;
+    const double cells = ((u1 - u0)/width + 1.)*((v1 - v0)/width + 1.);
+    const double cellsMax = qMax(4.*size, double(qMax(1, columns))*qMax(1, rows));
+    if (cells > cellsMax) width *= std::sqrt(cells/cellsMax);
+    view.u0 = u0;
+    view.v0 = v0;
+    view.width = width;
+    view.columns = int((u1 - u0)/width) + 1;
+    view.rows = int((v1 - v0)/width) + 1;
+
+    auto cellsOf = [&view](const Footprint& f, int& i0, int& i1, int& j0, int& j1) {
+        i0 = qBound(0, int((f.u0 - view.u0)/view.width), view.columns - 1);
+        i1 = qBound(0, int((f.u1 - view.u0)/view.width), view.columns - 1);
+        j0 = qBound(0, int((f.v0 - view.v0)/view.width), view.rows - 1);
+        j1 = qBound(0, int((f.v1 - view.v0)/view.width), view.rows - 1);
+    };
+    view.cells.assign(size_t(view.columns)*view.rows + 1, 0);
+    for (const Footprint& f : footprints) {
+        int i0, i1, j0, j1;
+        cellsOf(f, i0, i1, j0, j1);
+        for (int j = j0; j <= j1; ++j)
+            for (int i = i0; i <= i1; ++i)
+                view.cells[size_t(j)*view.columns + i + 1]++;
+    }
+    for (size_t c = 1; c < view.cells.size(); ++c)
+        view.cells[c] += view.cells[c - 1];
+    view.items.resize(size_t(view.cells.back()));
+    std::vector<int> fill(view.cells.begin(), view.cells.end() - 1);
+    for (int n = 0; n < size; ++n) {
+        int i0, i1, j0, j1;
+        cellsOf(footprints[n], i0, i1, j0, j1);
+        for (int j = j0; j <= j1; ++j)
+            for (int i = i0; i <= i1; ++i)
+                view.items[size_t(fill[size_t(j)*view.columns + i]++)] = {footprints[n].front, n};
+    }
+    for (size_t c = 0; c + 1 < view.cells.size(); ++c)
+        std::sort(view.items.begin() + view.cells[c], view.items.begin() + view.cells[c + 1], [](const SunViewItem& a, const SunViewItem& b) {
+            return a.front < b.front;
+        });
+    m_sunView = std::move(view);
+}
+
+bool SceneBVH::findSunCell(const Ray& ray, int& begin, int& end) const
+{
+    const SunView& view = m_sunView;
+    if (view.cells.empty()) return false;
+    const vec3d& direction = ray.direction();
+    const double rate = dot(direction, view.axis);
+    if (!(rate > 0.) || rate*rate < view.cosAngle*view.cosAngle*direction.norm2()) return false;
+
+    // where the ray crosses the nearest depth, before or after its origin
+    const vec3d p = ray.origin + direction*((view.front - dot(ray.origin, view.axis))/rate);
+    const double i = (dot(p, view.u) - view.u0)/view.width;
+    const double j = (dot(p, view.v) - view.v0)/view.width;
+    begin = end = 0;
+    if (!(i >= 0.) || !(j >= 0.) || i >= view.columns || j >= view.rows)
+        return true;
+    const size_t c = size_t(j)*view.columns + size_t(i);
+    begin = view.cells[c];
+    end = view.cells[c + 1];
+    return true;
+}
+
+/*!
+ * The leaves of a hierarchy leaf are first rejected in groups with
+ * QuadricBatch, which also solves planar, parabolic, spherical and capless
+ * cylindrical shapes; only the leaves it keeps call ShapeRT::intersect.
+ */
+bool SceneBVH::findHit(const Ray& ray, SceneBVHHit& hit, int origin) const
+{
+    if (m_isSingle)
+        return findHit(m_nodesSingle, &SceneBVHPrototype::nodesSingle, ray, hit, origin);
+    return findHit(m_nodes, &SceneBVHPrototype::nodes, ray, hit, origin);
+}
+
+/*!
+ * For shading and blocking checks: visits the same leaves as findHit with
+ * ShapeRT::intersectP and stops at the first one hit, in any order.
+ */
+bool SceneBVH::occluded(const Ray& ray, int origin) const
+{
+    if (m_isSingle)
+        return occluded(m_nodesSingle, &SceneBVHPrototype::nodesSingle, ray, origin);
+    return occluded(m_nodes, &SceneBVHPrototype::nodes, ray, origin);
+}
+
+template<class Node>
+bool SceneBVH::findHit(const std::vector<Node>& nodes, NodesOf<Node> nodesOf, const Ray& ray, SceneBVHHit& hit, int origin) const
+{
+    hit.leaf = nullptr;
+    hit.instance = nullptr;
+    hit.top = -1;
+    if (nodes.empty()) return false;
+
+    const SceneBVHInstance* reference = nullptr; // of a hit inside a prototype
+    auto visit = [&](int n) {
+        const SceneBVHInstance& s = m_instances[n];
+        if (s.prototype < 0) {
+            if (hitShape(s, ray, hit)) {
+                reference = nullptr;
+                hit.top = n;
+            }
+            return;
+        }
+
+        TRACE_STATS(boxTests++);
+        if (!s.box.intersect(ray)) return;
+        const SceneBVHPrototype& prototype = m_prototypes[s.prototype];
+        Ray rayLocal = s.transform.transformInverse(ray);
+        bool found = false;
+        traverseBVH(prototype.*nodesOf, rayLocal, [&](int b, int c) {
+            forCandidates(prototype.batch, rayLocal, b, c, [&](int k) {
+                if (hitShape(prototype.leaves[k], rayLocal, hit)) found = true;
+            });
+        });
+        if (!found) return;
+        ray.tMax = rayLocal.tMax;
+        reference = &s;
+        hit.top = n;
+    };
+
+    // a hit on a neighbour bounds the traversal
+    if (origin >= 0 && !m_neighbourOffsets.empty())
+        for (int k = m_neighbourOffsets[origin]; k < m_neighbourOffsets[origin + 1]; ++k)
+            visit(m_neighbours[k]);
+    int cellBegin, cellEnd;
+    if (findSunCell(ray, cellBegin, cellEnd)) {
+        // in depth order, until the boxes start past the closest hit
+        const double depth = dot(ray.origin, m_sunView.axis);
+        const double rate = dot(ray.direction(), m_sunView.axis);
+        for (int k = cellBegin; k < cellEnd; ++k) {
+            const SunViewItem& item = m_sunView.items[size_t(k)];
+            if (item.front > depth + ray.tMax*rate) break;
+            visit(item.instance);
+        }
+    } else {
+        traverseBVH(nodes, ray, [&](int begin, int count) {
+            forCandidates(m_batch, ray, begin, count, visit);
+        });
+    }
+
+    if (!hit.leaf) return false;
+
+    transformGeometry(hit.leaf->transform, hit.dg);
+    hit.instance = hit.leaf->instance;
+    if (reference) {
+        const SceneBVHPrototype& prototype = m_prototypes[reference->prototype];
+        transformGeometry(reference->transform, hit.dg);
+        hit.instance = findInstance(reference->instance, prototype.paths[hit.leaf - prototype.leaves.data()]);
+    }
+    return true;
+}
+
+template<class Node>
+bool SceneBVH::occluded(const std::vector<Node>& nodes, NodesOf<Node> nodesOf, const Ray& ray, int origin) const
+{
+    auto blocks = [&](int n) {
+        const SceneBVHInstance& s = m_instances[n];
+        if (s.prototype < 0) return blocksShape(s, ray);
+
+        if (!s.box.intersect(ray)) return false;
+        const SceneBVHPrototype& prototype = m_prototypes[s.prototype];
+        Ray rayLocal = s.transform.transformInverse(ray);
+        return traverseBVHUntil(prototype.*nodesOf, rayLocal, [&](int b, int c) {
+            return anyCandidate(prototype.batch, rayLocal, b, c, [&](int k) {
+                return blocksShape(prototype.leaves[k], rayLocal);
+            });
+        });
+    };
+
+    if (origin >= 0 && !m_neighbourOffsets.empty())
+        for (int k = m_neighbourOffsets[origin]; k < m_neighbourOffsets[origin + 1]; ++k)
+            if (blocks(m_neighbours[k])) return true;
+    int cellBegin, cellEnd;
+    if (findSunCell(ray, cellBegin, cellEnd)) {
+        const double depth = dot(ray.origin, m_sunView.axis);
+        const double rate = dot(ray.direction(), m_sunView.axis);
+        for (int k = cellBegin; k < cellEnd; ++k) {
+            const SunViewItem& item = m_sunView.items[size_t(k)];
+            if (item.front > depth + ray.tMax*rate) break;
+            if (blocks(item.instance)) return true;
+        }
+        return false;
+    }
+    return traverseBVHUntil(nodes, ray, [&](int begin, int count) {
+        return anyCandidate(m_batch, ray, begin, count, blocks);
+    });
+}
+
+/*!
+ * A leaf inside a prototype takes the tracking error of the trackers inside
+ * its subtree, else that of the instance of the subtree.
+ */
+double SceneBVH::getTrackingError(const SceneBVHHit& hit) const
+{
+    if (hit.leaf->trackingError > 0.) return hit.leaf->trackingError;
+    return hit.top >= 0 ? m_instances[hit.top].trackingError : 0.;
+}
+
+bool SceneBVH::intersect(const Ray& rayIn, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight, int* origin) const
+{
+    SceneBVHHit hit;
+    const bool found = findHit(rayIn, hit, origin ? *origin : -1);
+    if (origin) *origin = hit.top;
+    if (!found) return false;
+
+    isFront = hit.dg.isFront;
+    instance = hit.instance;
+    const double trackingError = getTrackingError(hit);
+    if (trackingError > 0.)
+        TrackingError::tilt(hit.dg, trackingError, rand);
+    if (weight)
+        return hit.leaf->material->OutputRayWeighted(rayIn, hit.dg, rand, rayOut, *weight);
+    return hit.leaf->material->OutputRay(rayIn, hit.dg, rand, rayOut);
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include "kernel/shape/BVH.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/QuadricBatch.h"
+#include "libraries/math/3D/Affine3D.h"
+
+class InstanceNode;
+class MaterialRT;
+class ProfileRT;
+class Random;
+class Ray;
+class ShapeRT;
+
+//! SceneBVHInstance is a flattened, world-space shape leaf of the instance tree.
+/*!
+ * A leaf with a nonnegative \a prototype stands for a shared subtree instead
+ * of a shape: the box and transform are those of the subtree root, and the
+ * prototype holds its shapes in the frame of that root.
+ */
+struct TONATIUH_KERNEL SceneBVHInstance
+{
+    Box3D box;              // in world frame
+    Affine3D transform;     // from object to world
+    InstanceNode* instance = nullptr;
+    ShapeRT* shape = nullptr;
+    ProfileRT* profile = nullptr;
+    MaterialRT* material = nullptr;
+    int shapeIndex = 0;     // into SceneBVH::getShapes
+    int materialIndex = 0;  // into SceneBVH::getMaterials
+    int prototype = -1;     // into SceneBVH::getPrototypes
+    double trackingError = 0.; // of the nearest tracker holding it, see TrackingError
+};
+
+//! SceneBVHPrototype is the compiled copy of a subtree shared by several parents.
+/*!
+ * The leaves are in the frame of the subtree root, as found in its first
+ * instance \a instance; \a paths gives the child rows from the root to each
+ * leaf, to find the InstanceNode of a hit in any other instance.
+ */
+struct TONATIUH_KERNEL SceneBVHPrototype
+{
+    InstanceNode* instance = nullptr;
+    std::vector<SceneBVHInstance> leaves;
+    std::vector<std::vector<int>> paths;
+    std::vector<BVHNode4> nodes;
+    std::vector<BVHNode4F> nodesSingle; // with SceneBVH::setSinglePrecision
+    QuadricBatch batch; // of the leaves
+    Box3D box;
+};
+
+//! SceneBVHHit is the closest intersection found before shading.
+struct TONATIUH_KERNEL SceneBVHHit
+{
+    const SceneBVHInstance* leaf = nullptr;
+    InstanceNode* instance = nullptr; // of the hit path, leaf->instance for unshared leaves
+    DifferentialGeometry dg; // in world frame
+    int top = -1; // into SceneBVH::getInstances, of the leaf or prototype hit
+};
+
+//! SceneBVH is the compiled scene used by the ray tracer.
+/*!
+ * It flattens the traceable leaves of an updated InstanceNode tree into
+ * world-space instances under a 4-wide bounding volume hierarchy, with shared
+ * subtrees compiled once as prototypes. A copy shares the shapes and materials.
+ */
+class TONATIUH_KERNEL SceneBVH
+{
+public:
+    // the subtree excluded is left out, as if it were not in the scene
+    explicit SceneBVH(InstanceNode* root, int leafSize = 4, const InstanceNode* excluded = nullptr);
+
+    // rereads the leaves of moved trackers; maxCostRatio 0 keeps the hierarchy,
+    // true if the top level was built again
+    bool refit(double maxCostRatio = 0.);
+    // traverses float copies of the nodes, see BVHNode4F; shapes stay in double
+    void setSinglePrecision(bool on);
+    bool isSinglePrecision() const {return m_isSingle;}
+
+    bool isEmpty() const {return m_nodes.empty();}
+    const Box3D& getBox() const {return m_box;}
+    int instanceCount() const {return int(m_instances.size());}
+    int nodeCount() const {return int(m_nodes.size());}
+
+    const std::vector<SceneBVHInstance>& getInstances() const {return m_instances;}
+    const std::vector<SceneBVHPrototype>& getPrototypes() const {return m_prototypes;}
+    // the shape leaves with the prototypes expanded, in world frame
+    std::vector<SceneBVHInstance> findLeaves() const;
+    const std::vector<BVHNode4>& getNodes() const {return m_nodes;}
+    const std::vector<ShapeRT*>& getShapes() const {return m_shapes;}
+    const std::vector<MaterialRT*>& getMaterials() const {return m_materials;}
+    // bytes of the leaves, nodes and batches, without the shared shapes
+    qulonglong getMemoryUsage() const;
+
+    // up to count nearest instances of each and those under or holding targets,
+    // tested first by rays leaving an instance
+    void findNeighbours(const std::vector<InstanceNode*>& targets, int count);
+    bool hasNeighbours() const {return !m_neighbourOffsets.empty();}
+
+    // instances by depth along direction in a grid across it, looked up by rays
+    // within angle of it, as rays from the sun, instead of the hierarchy
+    void buildSunView(const vec3d& direction, double angle, int columns, int rows);
+    bool hasSunView() const {return !m_sunView.cells.empty();}
+
+    // closest hit without evaluating the material, sets ray.tMax; origin is
+    // the top-level instance the ray leaves, or -1
+    bool findHit(const Ray& ray, SceneBVHHit& hit, int origin = -1) const;
+    // with weight the material is evaluated by MaterialRT::OutputRayWeighted;
+    // origin, if given, is read as in findHit and set to SceneBVHHit::top
+    bool intersect(const Ray& rayIn, Random& rand, bool& isFront, InstanceNode*& instance, Ray& rayOut, double* weight = nullptr, int* origin = nullptr) const;
+    // the deviation in radians to tilt the normal of the hit by, 0 for none
+    double getTrackingError(const SceneBVHHit& hit) const;
+    // any hit with t < ray.tMax, stops at the first one and computes no geometry
+    bool occluded(const Ray& ray, int origin = -1) const;
+
+private:
+    struct Collector;
+    void collect(InstanceNode* node, Collector& collector);
+    void collectPrototype(InstanceNode* node, SceneBVHPrototype& prototype, std::vector<int>& path);
+    void makeTables();
+    void buildTop();
+    void makeSingleNodes();
+    // the instances of the cell of ray, [begin, end) of the view items;
+    // false if the ray is not within the angle of the view
+    bool findSunCell(const Ray& ray, int& begin, int& end) const;
+
+    template<class Node>
+    using NodesOf = std::vector<Node> SceneBVHPrototype::*;
+    template<class Node>
+    bool findHit(const std::vector<Node>& nodes, NodesOf<Node> nodesOf, const Ray& ray, SceneBVHHit& hit, int origin) const;
+    template<class Node>
+    bool occluded(const std::vector<Node>& nodes, NodesOf<Node> nodesOf, const Ray& ray, int origin) const;
+
+    int m_leafSize = 4;
+    double m_builtCost = 0.; // SAH cost of m_nodes when built, see BVHStatistics
+    std::vector<SceneBVHInstance> m_instances;
+    std::vector<SceneBVHPrototype> m_prototypes;
+    std::vector<BVHNode4> m_nodes;
+    std::vector<BVHNode4F> m_nodesSingle;
+    bool m_isSingle = false;
+    QuadricBatch m_batch;
+    Box3D m_box;
+    std::vector<ShapeRT*> m_shapes;
+    std::vector<MaterialRT*> m_materials;
+    // instance n tests m_neighbours[m_neighbourOffsets[n], m_neighbourOffsets[n + 1])
+    std::vector<int> m_neighbourOffsets;
+    std::vector<int> m_neighbours;
+
+    struct SunViewItem
+    {
+        double front; // least depth of the box along the axis
+        int instance;
+    };
+    // cell (i, j) lists items[cells[j*columns + i], cells[j*columns + i + 1])
+    struct SunView
+    {
+        vec3d axis;
+        vec3d u; // across the axis, with v
+        vec3d v;
+        double cosAngle = 1.;
+        double front = 0.; // least depth of the scene, where rays are looked up
+        double u0 = 0.;
+        double v0 = 0.;
+        double width = 1.; // of the cells
+        int columns = 0;
+        int rows = 0;
+        std::vector<int> cells;
+        std::vector<SunViewItem> items;
+    };
+    SunView m_sunView;
+};
@@ -0,0 +1,68 @@
+#include "TiledCounts.h"
+
+
+TiledCounts::TiledCounts(int width, int height):
+    m_width(std::max(0, width)),
+    m_height(std::max(0, height)),
+    m_tilesX(std::size_t(m_width + TileSize - 1) >> TileShift)
+{
+    m_tiles.resize(m_tilesX*(std::size_t(m_height + TileSize - 1) >> TileShift));
+}
+
+qulonglong TiledCounts::get(int column, int row) const
+{
+    const std::vector<qulonglong>& tile = m_tiles[std::size_t(row >> TileShift)*m_tilesX + (column >> TileShift)];
+    if (tile.empty()) return 0;
+    return tile[std::size_t(row & (TileSize - 1))*TileSize + (column & (TileSize - 1))];
+}
+
+void TiledCounts::merge(const TiledCounts& other)
+{
+    if (other.m_width != m_width || other.m_height != m_height) return;
+    for (std::size_t t = 0; t < m_tiles.size(); ++t) {
+        const std::vector<qulonglong>& source = other.m_tiles[t];
+        if (source.empty()) continue;
+        std::vector<qulonglong>& tile = m_tiles[t];
+        if (tile.empty()) {
+            tile = source;
+            continue;
+        }
+        for (std::size_t n = 0; n < tile.size(); ++n)
+            tile[n] += source[n];
+    }
+}
+
+void TiledCounts::clear()
+{
+    for (std::vector<qulonglong>& tile : m_tiles)
+        std::vector<qulonglong>().swap(tile);
+}
+
+void TiledCounts::addTo(std::vector<qulonglong>& dense) const
+{
+    dense.resize(std::size_t(m_width)*m_height, 0);
+    forEach([&dense](std::size_t index, qulonglong count) {
+        dense[index] += count;
+    });
+}
+
+int TiledCounts::getTileCount() const
+{
+    int ans = 0;
+    for (const std::vector<qulonglong>& tile : m_tiles)
+        if (!tile.empty()) ans++;
+    return ans;
+}
+
+qulonglong TiledCounts::getMemoryUsage() const
+{
+    qulonglong ans = m_tiles.capacity()*sizeof(std::vector<qulonglong>);
+    for (const std::vector<qulonglong>& tile : m_tiles)
+        ans += tile.capacity()*sizeof(qulonglong);
+    return ans;
+}
+
+bool TiledCounts::isPreferred(std::size_t cells, int workers, qulonglong bytes)
+{
+    return qulonglong(cells)*sizeof(qulonglong)*qulonglong(std::max(1, workers)) > bytes;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <qglobal.h>
+
+
+//! TiledCounts counts hits on a grid in square tiles allocated on first hit.
+/*!
+ * A fine grid over a large receiver is mostly empty in the copy of each
+ * worker, so a dense grid per worker spends its memory on zeros. Here the
+ * grid is cut into tiles of TileSize x TileSize cells, a tile is allocated
+ * when one of its cells is first counted, and merge() adds the tiles of
+ * another grid one by one, skipping those it never allocated.
+ *
+ * Cells are given by column and row and dense grids are row-major, as the
+ * benchmark grid.
+ */
+class TONATIUH_KERNEL TiledCounts
+{
+public:
+    static const int TileShift = 6;
+    static const int TileSize = 1 << TileShift;
+
+    TiledCounts(int width = 0, int height = 0);
+
+    int getWidth() const {return m_width;}
+    int getHeight() const {return m_height;}
+
+    void add(int column, int row, qulonglong count = 1)
+    {
+        std::vector<qulonglong>& tile = m_tiles[std::size_t(row >> TileShift)*m_tilesX + (column >> TileShift)];
+        if (tile.empty()) tile.assign(std::size_t(TileSize)*TileSize, 0);
+        tile[std::size_t(row & (TileSize - 1))*TileSize + (column & (TileSize - 1))] += count;
+    }
+    qulonglong get(int column, int row) const;
+
+    void merge(const TiledCounts& other);
+    void clear(); // frees the tiles
+
+    // f(index, count) for each counted cell, index row-major in the grid
+    template<class F>
+    void forEach(F f) const;
+    // adds the counts to a row-major grid of width x height
+    void addTo(std::vector<qulonglong>& dense) const;
+
+    int getTileCount() const; // allocated
+    qulonglong getMemoryUsage() const;
+
+    // whether the dense grids of cells counts per worker take more than bytes
+    static bool isPreferred(std::size_t cells, int workers, qulonglong bytes);
+
+private:
+    int m_width;
+    int m_height;
+    std::size_t m_tilesX;
+    std::vector<std::vector<qulonglong>> m_tiles; // row-major, empty until hit
+};
+
+
+template<class F>
+void TiledCounts::forEach(F f) const
+{
+    for (std::size_t t = 0; t < m_tiles.size(); ++t) {
+        const std::vector<qulonglong>& tile = m_tiles[t];
+        if (tile.empty()) continue;
+        const int column0 = int(t % m_tilesX) << TileShift;
+        const int row0 = int(t / m_tilesX) << TileShift;
+        const int columns = std::min(TileSize, m_width - column0);
+        const int rows = std::min(TileSize, m_height - row0);
+        for (int r = 0; r < rows; ++r)
+            for (int c = 0; c < columns; ++c) {
+                const qulonglong count = tile[std::size_t(r)*TileSize + c];
+                if (count > 0)
+                    f(std::size_t(row0 + r)*m_width + (column0 + c), count);
+            }
+    }
+}
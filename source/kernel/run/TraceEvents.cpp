@@ -0,0 +1,151 @@
+#include "TraceEvents.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+
+namespace {
+
+// recordings are numbered, so a thread does not reuse the buffer of an
+// earlier one created at the same address
+std::atomic<quint64> s_serials(0);
+
+struct ThreadCache
+{
+    quint64 serial = 0;
+    void* thread = nullptr;
+};
+
+thread_local ThreadCache s_thread;
+
+bool fail(QString* error, const QString& message)
+{
+    if (error) *error = message;
+    return false;
+}
+
+void appendMicroseconds(QByteArray& out, qint64 ns)
+{
+    out += QByteArray::number(double(ns)/1000., 'f', 3);
+}
+
+}
+
+
+std::atomic<TraceEvents*> TraceEvents::s_active(nullptr);
+
+TraceEvents::TraceEvents():
+    m_serial(++s_serials)
+{
+    m_timer.start();
+}
+
+TraceEvents::~TraceEvents()
+{
+    TraceEvents* self = this;
+    s_active.compare_exchange_strong(self, nullptr);
+}
+
+void TraceEvents::setActive(TraceEvents* events)
+{
+    s_active.store(events);
+}
+
+void TraceEvents::nameThread(const char* name, int index)
+{
+    Thread* t = thread();
+    t->name = name;
+    t->index = index;
+}
+
+void TraceEvents::add(const char* name, const char* category, qint64 start, qint64 end,
+                      const char* argName, qint64 arg, const char* argName2, qint64 arg2)
+{
+    Thread* t = thread();
+    t->events.push_back(Event{name, category, start, end - start, {argName, argName2}, {arg, arg2}});
+}
+
+// the buffer of the calling thread, registered on its first event
+TraceEvents::Thread* TraceEvents::thread()
+{
+    if (s_thread.serial == m_serial)
+        return static_cast<Thread*>(s_thread.thread);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_threads.emplace_back(new Thread{int(m_threads.size()) + 1, "thread", -1, {}});
+    s_thread.serial = m_serial;
+    s_thread.thread = m_threads.back().get();
+    return m_threads.back().get();
+}
+
+qulonglong TraceEvents::getEventCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    qulonglong ans = 0;
+    for (const std::unique_ptr<Thread>& t : m_threads)
+        ans += t->events.size();
+    return ans;
+}
+
+/*!
+ * Complete ("X") events with times in microseconds, after one thread_name
+ * metadata event per thread. Threads must not add events meanwhile.
+ */
+QByteArray TraceEvents::toJson() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    QByteArray out;
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Tonatiuh++\"}}";
+    for (const std::unique_ptr<Thread>& t : m_threads) {
+        const QByteArray tid = QByteArray::number(t->id);
+        out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"name\":\"";
+        out += t->name;
+        if (t->index >= 0)
+            out += " " + QByteArray::number(t->index);
+        out += "\"}}";
+        out += ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"sort_index\":" + tid + "}}";
+
+        for (const Event& e : t->events) {
+            out += ",\n{\"name\":\"";
+            out += e.name;
+            out += "\",\"cat\":\"";
+            out += e.category;
+            out += "\",\"ph\":\"X\",\"ts\":";
+            appendMicroseconds(out, e.start);
+            out += ",\"dur\":";
+            appendMicroseconds(out, e.duration);
+            out += ",\"pid\":1,\"tid\":" + tid;
+            if (e.argNames[0]) {
+                out += ",\"args\":{\"";
+                out += e.argNames[0];
+                out += "\":" + QByteArray::number(e.args[0]);
+                if (e.argNames[1]) {
+                    out += ",\"";
+                    out += e.argNames[1];
+                    out += "\":" + QByteArray::number(e.args[1]);
+                }
+                out += "}";
+            }
+            out += "}";
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool TraceEvents::write(const QString& fileName, QString* error) const
+{
+    QFileInfo info(fileName);
+    if (!QDir().mkpath(info.absolutePath()))
+        return fail(error, QString("Cannot create output directory %1.").arg(info.absolutePath()));
+
+    const QByteArray data = toJson();
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(error, QString("Cannot open trace events file %1: %2").arg(fileName, file.errorString()));
+    if (file.write(data) != data.size() || !file.commit())
+        return fail(error, QString("Cannot write trace events file %1: %2").arg(fileName, file.errorString()));
+    return true;
+}
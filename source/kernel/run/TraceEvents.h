@@ -0,0 +1,126 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <qglobal.h>
+
+
+//! TraceEvents records timed events of the threads of a trace, for a timeline.
+/*!
+ * While a recording is active, TraceEventScope objects add one complete
+ * event each to the buffer of their thread: chunks of the workers, refills
+ * of large random arrays, waits for the photon buffer and its writer, saves
+ * of the exporter and the setup phases of a trace. With no active
+ * recording a scope costs one relaxed atomic load.
+ *
+ * The events are written in the Chrome trace-event format, a JSON object
+ * with a traceEvents array, read by chrome://tracing and Perfetto.
+ * Names, categories and argument names are string literals, referenced
+ * and not copied.
+ */
+class TONATIUH_KERNEL TraceEvents
+{
+public:
+    TraceEvents();
+    ~TraceEvents();
+
+    TraceEvents(const TraceEvents&) = delete;
+    TraceEvents& operator=(const TraceEvents&) = delete;
+
+    // the recording of the process, null if none
+    static TraceEvents* active() {return s_active.load(std::memory_order_relaxed);}
+    // set before the recorded threads start and cleared after they end
+    static void setActive(TraceEvents* events);
+
+    // timeline label of the calling thread, "name index" or name alone for
+    // a negative index
+    void nameThread(const char* name, int index = -1);
+
+    // nanoseconds since the recording was created
+    qint64 now() const {return m_timer.nsecsElapsed();}
+
+    // an event of the calling thread from start to end, with up to two
+    // integer arguments named when not null
+    void add(const char* name, const char* category, qint64 start, qint64 end,
+             const char* argName = nullptr, qint64 arg = 0,
+             const char* argName2 = nullptr, qint64 arg2 = 0);
+
+    qulonglong getEventCount() const;
+
+    QByteArray toJson() const;
+    bool write(const QString& fileName, QString* error = nullptr) const;
+
+private:
+    struct Event
+    {
+        const char* name;
+        const char* category;
+        qint64 start;
+        qint64 duration;
+        const char* argNames[2];
+        qint64 args[2];
+    };
+
+    struct Thread
+    {
+        int id;
+        const char* name;
+        int index;
+        std::vector<Event> events;
+    };
+
+    Thread* thread();
+
+    static std::atomic<TraceEvents*> s_active;
+
+    quint64 m_serial;
+    QElapsedTimer m_timer;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Thread>> m_threads;
+};
+
+
+//! adds an event from construction to destruction to the active recording
+class TraceEventScope
+{
+public:
+    explicit TraceEventScope(const char* name, const char* category,
+                             const char* argName = nullptr, qint64 arg = 0,
+                             const char* argName2 = nullptr, qint64 arg2 = 0):
+        m_events(TraceEvents::active())
+    {
+        if (!m_events) return;
+        m_name = name;
+        m_category = category;
+        m_argNames[0] = argName;
+        m_argNames[1] = argName2;
+        m_args[0] = arg;
+        m_args[1] = arg2;
+        m_start = m_events->now();
+    }
+
+    ~TraceEventScope()
+    {
+        if (m_events)
+            m_events->add(m_name, m_category, m_start, m_events->now(), m_argNames[0], m_args[0], m_argNames[1], m_args[1]);
+    }
+
+    TraceEventScope(const TraceEventScope&) = delete;
+    TraceEventScope& operator=(const TraceEventScope&) = delete;
+
+private:
+    TraceEvents* m_events;
+    const char* m_name = nullptr;
+    const char* m_category = nullptr;
+    const char* m_argNames[2] = {nullptr, nullptr};
+    qint64 m_args[2] = {0, 0};
+    qint64 m_start = 0;
+};
@@ -0,0 +1,95 @@
+#include "TraceMetrics.h"
+
+#include <QLocale>
+
+
+namespace {
+
+void appendHeader(QByteArray& out, const QByteArray& name, const char* type, const char* help)
+{
+    out += "# HELP " + name + ' ' + help + '\n';
+    out += "# TYPE " + name + ' ' + type + '\n';
+}
+
+void appendCounter(QByteArray& out, const QByteArray& name, const char* help, double value)
+{
+    appendHeader(out, name, "counter", help);
+    out += name + ' ' + QByteArray::number(value, 'g', QLocale::FloatingPointShortest) + '\n';
+}
+
+}
+
+
+const double TraceMetrics::ChunkBuckets[TraceMetrics::BucketCount] =
+    {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1., 2.5, 5., 10., 30.};
+
+std::atomic<TraceMetrics*> TraceMetrics::s_active(nullptr);
+
+TraceMetrics::~TraceMetrics()
+{
+    TraceMetrics* self = this;
+    s_active.compare_exchange_strong(self, nullptr);
+}
+
+void TraceMetrics::setActive(TraceMetrics* metrics)
+{
+    s_active.store(metrics);
+}
+
+void TraceMetrics::addChunk(ulong rays, qint64 ns)
+{
+    m_chunks.fetch_add(1, std::memory_order_relaxed);
+    m_rays.fetch_add(rays, std::memory_order_relaxed);
+    m_chunkNs.fetch_add(ns, std::memory_order_relaxed);
+    int n = 0;
+    while (n < BucketCount && ns > ChunkBuckets[n]*1e9)
+        ++n;
+    m_buckets[n].fetch_add(1, std::memory_order_relaxed);
+}
+
+void TraceMetrics::addExport(qulonglong photons, qulonglong bytes)
+{
+    m_exportPhotons.fetch_add(photons, std::memory_order_relaxed);
+    m_exportBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void TraceMetrics::addExportStall(qint64 ns)
+{
+    m_exportStalls.fetch_add(1, std::memory_order_relaxed);
+    m_exportStallNs.fetch_add(ns, std::memory_order_relaxed);
+}
+
+qulonglong TraceMetrics::getChunksWithin(int n) const
+{
+    qulonglong ans = 0;
+    for (int b = 0; b <= qMin(n, int(BucketCount)); ++b)
+        ans += m_buckets[b].load(std::memory_order_relaxed);
+    return ans;
+}
+
+// the buckets are read one by one while chunks are added, so the count is
+// their sum, which keeps the histogram consistent
+QByteArray TraceMetrics::toPrometheus(const QByteArray& prefix) const
+{
+    QByteArray out;
+    appendCounter(out, prefix + "chunks_total", "Chunks of rays traced.", double(getChunks()));
+    appendCounter(out, prefix + "rays_total", "Rays traced in chunks.", double(getRays()));
+    appendCounter(out, prefix + "worker_busy_seconds_total", "Time the workers spent tracing chunks.", getChunkNs()*1e-9);
+
+    const QByteArray histogram = prefix + "chunk_seconds";
+    appendHeader(out, histogram, "histogram", "Time to trace a chunk of rays.");
+    qulonglong count = 0;
+    for (int n = 0; n <= BucketCount; ++n) {
+        count += m_buckets[n].load(std::memory_order_relaxed);
+        const QByteArray bound = n < BucketCount ? QByteArray::number(ChunkBuckets[n], 'g', QLocale::FloatingPointShortest) : QByteArray("+Inf");
+        out += histogram + "_bucket{le=\"" + bound + "\"} " + QByteArray::number(count) + '\n';
+    }
+    out += histogram + "_sum " + QByteArray::number(getChunkNs()*1e-9, 'g', QLocale::FloatingPointShortest) + '\n';
+    out += histogram + "_count " + QByteArray::number(count) + '\n';
+
+    appendCounter(out, prefix + "photon_export_photons_total", "Photons handed to the exporter.", double(getExportPhotons()));
+    appendCounter(out, prefix + "photon_export_bytes_total", "Photon records handed to the exporter, in bytes.", double(getExportBytes()));
+    appendCounter(out, prefix + "photon_export_stalls_total", "Waits of tracers on a full photon writer queue.", double(getExportStalls()));
+    appendCounter(out, prefix + "photon_export_stall_seconds_total", "Time tracers waited on a full photon writer queue.", getExportStallNs()*1e-9);
+    return out;
+}
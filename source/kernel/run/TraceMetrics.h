@@ -0,0 +1,69 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <atomic>
+
+#include <QByteArray>
+#include <qglobal.h>
+
+
+//! TraceMetrics counts the work of the traces of a process for live monitoring.
+/*!
+ * While a set of metrics is active, the scheduler adds every chunk it
+ * traces with its rays and time, and the photon buffer every block it
+ * hands to its exporter and every wait of a tracer on a full writer queue.
+ * As for TraceEvents, no active set costs one relaxed atomic load per
+ * chunk or block, and the counters are relaxed atomics, so a service may
+ * keep its set active while it runs.
+ *
+ * toPrometheus writes the counters and a histogram of the chunk times in
+ * the Prometheus text format, which OpenMetrics scrapers read too.
+ */
+class TONATIUH_KERNEL TraceMetrics
+{
+public:
+    // upper bounds of the chunk time buckets in seconds, +Inf after the last
+    static const int BucketCount = 14;
+    static const double ChunkBuckets[BucketCount];
+
+    TraceMetrics() = default;
+    ~TraceMetrics();
+
+    TraceMetrics(const TraceMetrics&) = delete;
+    TraceMetrics& operator=(const TraceMetrics&) = delete;
+
+    // the metrics of the process, null if none
+    static TraceMetrics* active() {return s_active.load(std::memory_order_relaxed);}
+    static void setActive(TraceMetrics* metrics);
+
+    void addChunk(ulong rays, qint64 ns);
+    void addExport(qulonglong photons, qulonglong bytes);
+    void addExportStall(qint64 ns);
+
+    qulonglong getChunks() const {return m_chunks.load(std::memory_order_relaxed);}
+    qulonglong getRays() const {return m_rays.load(std::memory_order_relaxed);}
+    // of the chunks of all workers
+    qint64 getChunkNs() const {return m_chunkNs.load(std::memory_order_relaxed);}
+    // chunks of at most ChunkBuckets[n] seconds, any for n of BucketCount
+    qulonglong getChunksWithin(int n) const;
+    qulonglong getExportPhotons() const {return m_exportPhotons.load(std::memory_order_relaxed);}
+    qulonglong getExportBytes() const {return m_exportBytes.load(std::memory_order_relaxed);}
+    qulonglong getExportStalls() const {return m_exportStalls.load(std::memory_order_relaxed);}
+    qint64 getExportStallNs() const {return m_exportStallNs.load(std::memory_order_relaxed);}
+
+    // names begin with prefix, such as tonatiuhpp_
+    QByteArray toPrometheus(const QByteArray& prefix) const;
+
+private:
+    static std::atomic<TraceMetrics*> s_active;
+
+    std::atomic<qulonglong> m_chunks{0};
+    std::atomic<qulonglong> m_rays{0};
+    std::atomic<qint64> m_chunkNs{0};
+    std::atomic<qulonglong> m_buckets[BucketCount + 1] = {}; // not cumulative
+    std::atomic<qulonglong> m_exportPhotons{0};
+    std::atomic<qulonglong> m_exportBytes{0};
+    std::atomic<qulonglong> m_exportStalls{0};
+    std::atomic<qint64> m_exportStallNs{0};
+};
@@ -0,0 +1,415 @@
+#include "TraceScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <QMutexLocker>
+
+#include "CpuTopology.h"
+#include "TraceEvents.h"
+#include "TraceMetrics.h"
+#include "kernel/random/RandomPhilox.h"
+#include "kernel/random/RandomSTL.h"
+
+namespace {
+
+const qulonglong MaxBatch = 4096; // chunks per dispatch
+
+}
+
+
+TraceScheduler::TraceScheduler(ulong rays, ulong chunkSize, int workers):
+    TraceScheduler(std::vector<ulong>(1, rays), chunkSize, workers)
+{
+
+}
+
+TraceScheduler::TraceScheduler(const std::vector<ulong>& phaseRays, ulong chunkSize, int workers):
+    m_rays(0),
+    m_chunkSize(qMax<ulong>(1, chunkSize)),
+    m_workersRequested(workers),
+    m_phaseRays(phaseRays)
+{
+    if (m_phaseRays.empty())
+        m_phaseRays.push_back(0);
+    m_phaseFirst.push_back(0);
+    m_phaseFirstRay.push_back(0);
+    for (ulong rays : m_phaseRays) {
+        m_rays += rays;
+        m_phaseFirst.push_back(m_phaseFirst.back() + (qulonglong(rays) + m_chunkSize - 1)/m_chunkSize);
+        m_phaseFirstRay.push_back(m_phaseFirstRay.back() + rays);
+    }
+    m_chunkCount = m_phaseFirst.back();
+    setChunkRange(0, m_chunkCount);
+}
+
+void TraceScheduler::setChunkRange(qulonglong first, qulonglong end)
+{
+    m_endChunk = qMin(end, m_chunkCount);
+    m_firstChunk = qMin(first, m_endChunk);
+    qulonglong limit = qMin<qulonglong>(m_endChunk - m_firstChunk, qulonglong(std::numeric_limits<int>::max()));
+    m_workerCount = qMax(1, qMin(m_workersRequested, int(limit)));
+}
+
+ulong TraceScheduler::getRangeRays() const
+{
+    return ulong(raysBefore(m_endChunk) - raysBefore(m_firstChunk));
+}
+
+// the last phase starting at or before the chunk, skipping empty phases
+int TraceScheduler::findPhase(qulonglong chunk) const
+{
+    auto it = std::upper_bound(m_phaseFirst.begin(), m_phaseFirst.end(), chunk);
+    return int(it - m_phaseFirst.begin()) - 1;
+}
+
+qulonglong TraceScheduler::raysBefore(qulonglong chunk) const
+{
+    int phase = findPhase(chunk);
+    if (phase >= getPhaseCount()) return m_phaseFirstRay.back();
+    qulonglong rays = (chunk - m_phaseFirst[phase])*m_chunkSize;
+    return m_phaseFirstRay[phase] + qMin<qulonglong>(rays, m_phaseRays[phase]);
+}
+
+qulonglong TraceScheduler::getRangeChunks(int phase) const
+{
+    qulonglong first = qMax(m_phaseFirst[phase], m_firstChunk);
+    qulonglong end = qMin(m_phaseFirst[phase + 1], m_endChunk);
+    return end > first ? end - first : 0;
+}
+
+void TraceScheduler::shardRange(qulonglong chunks, int shard, int shards, qulonglong* first, qulonglong* end)
+{
+    shards = qMax(1, shards);
+    *first = chunks/shards*shard + qMin<qulonglong>(chunks%shards, shard);
+    *end = *first + chunks/shards + (qulonglong(shard) < chunks%shards ? 1 : 0);
+}
+
+void TraceScheduler::setSkipped(const SkipFunction& skipped, ulong rays)
+{
+    m_skipped = skipped;
+    m_raysSkipped = rays;
+}
+
+void TraceScheduler::setPause(qint64 intervalMs, const PauseFunction& pause)
+{
+    m_pauseInterval = intervalMs;
+    m_pause = pause;
+}
+
+int TraceScheduler::getWorkerCpu(int worker) const
+{
+    if (m_placement.empty()) return -1;
+    return m_placement[size_t(worker) % m_placement.size()];
+}
+
+int TraceScheduler::getWorkerGroup(int worker) const
+{
+    if (m_groups.empty()) return -1;
+    return m_groups[size_t(worker) % m_groups.size()];
+}
+
+/*!
+ * Traces every chunk with \a trace and returns when all workers are done.
+ * Returns false if the trace failed; a canceled trace returns true.
+ * With one worker and no placement the chunks are traced in the calling thread.
+ */
+bool TraceScheduler::run(const ChunkFunction& trace)
+{
+    m_nextChunk.store(m_firstChunk);
+    m_traced.store(m_raysSkipped);
+    m_stopped.store(false);
+    m_canceled.store(false);
+    m_failed.store(false);
+    m_error.clear();
+    m_active = 0;
+    m_paused = false;
+    m_pauseTimer.start();
+    m_dispatches.store(0);
+    m_phase = 0;
+    m_phaseDone = 0;
+    m_inline = m_workerCount == 1 && m_placement.empty();
+    m_workerBusyNs.assign(size_t(m_workerCount), 0);
+    m_workerRays.assign(size_t(m_workerCount), 0);
+    QElapsedTimer runTimer;
+    runTimer.start();
+
+    if (m_inline) {
+        work(trace, 0);
+        if (!m_stopped.load())
+            startPhases(getPhaseCount() - 1);
+    } else {
+        std::vector<std::thread> workers;
+        workers.reserve(size_t(m_workerCount));
+        for (int w = 0; w < m_workerCount; ++w)
+            workers.emplace_back([this, &trace, w]() {
+                if (!m_placement.empty())
+                    CpuTopology::pinThread(getWorkerCpu(w));
+                else if (!m_groups.empty())
+                    CpuTopology::joinGroup(getWorkerGroup(w));
+                if (m_lowPriority)
+                    CpuTopology::lowerThreadPriority();
+                work(trace, w);
+            });
+        startPhases(getPhaseCount() - 1);
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+    m_runNs = runTimer.nsecsElapsed();
+    return !m_failed.load();
+}
+
+// on the calling thread: starts the phases up to \a last, each once the
+// chunks of the one before are done
+void TraceScheduler::startPhases(int last)
+{
+    std::unique_lock<std::mutex> lock(m_gateMutex);
+    while (m_phase < last)
+    {
+        m_gate.wait(lock, [this]() {
+            return m_phaseDone == getRangeChunks(m_phase) || m_stopped.load();
+        });
+        if (m_stopped.load()) return;
+        lock.unlock();
+        try {
+            if (m_phaseStart)
+                m_phaseStart(m_phase + 1);
+        } catch (const std::exception& e) {
+            fail(QString("Ray tracing phase failed: %1").arg(e.what()));
+        } catch (...) {
+            fail("Ray tracing phase failed with an unknown exception.");
+        }
+        lock.lock();
+        m_phase++;
+        m_phaseDone = 0;
+        m_gate.notify_all();
+    }
+}
+
+void TraceScheduler::work(const ChunkFunction& trace, int worker)
+{
+    try {
+        TraceEvents* events = TraceEvents::active();
+        if (events && !m_inline)
+            events->nameThread("worker", worker);
+        if (m_start)
+            m_start(worker);
+        qulonglong batch = 1;
+        QElapsedTimer timer;
+        while (!m_stopped.load())
+        {
+            if (m_limit)
+                waitLimit(worker);
+            if (m_cancellation && m_cancellation()) {
+                cancel();
+                break;
+            }
+            if (m_stopped.load()) break;
+
+            qulonglong first = m_nextChunk.fetch_add(batch);
+            if (first >= m_endChunk) break;
+            qulonglong end = qMin(first + batch, m_endChunk);
+            m_dispatches.fetch_add(1);
+
+            timer.start();
+            qulonglong traced = 0;
+            bool ok = true;
+            for (qulonglong index = first; ok && index < end; ++index) {
+                bool chunkTraced = false;
+                ok = traceChunk(trace, index, worker, &chunkTraced);
+                if (chunkTraced) traced++;
+            }
+            if (!ok) break;
+            if (m_grain > 0 && traced > 0)
+                batch = nextBatch(double(timer.nsecsElapsed())/traced);
+        }
+    } catch (const std::exception& e) {
+        fail(QString("Ray tracing worker failed: %1").arg(e.what()));
+    } catch (...) {
+        fail("Ray tracing worker failed with an unknown exception.");
+    }
+}
+
+// the limit is set without the gate mutex, so a held worker polls it
+void TraceScheduler::waitLimit(int worker)
+{
+    auto held = [this, worker]() {
+        const int limit = m_limit->load(std::memory_order_relaxed);
+        return limit > 0 && worker >= limit;
+    };
+    if (!held()) return;
+
+    TraceEventScope event("worker limit", "wait");
+    while (held() && !m_stopped.load() && !(m_cancellation && m_cancellation()))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+bool TraceScheduler::traceChunk(const ChunkFunction& trace, qulonglong index, int worker, bool* traced)
+{
+    Chunk chunk;
+    chunk.index = index;
+    chunk.phase = findPhase(index);
+    chunk.phaseChunk = index - m_phaseFirst[chunk.phase];
+    chunk.start = chunk.phaseChunk*m_chunkSize;
+    chunk.rays = ulong(qMin<qulonglong>(m_chunkSize, m_phaseRays[chunk.phase] - chunk.start));
+    chunk.worker = worker;
+
+    if (!beginChunk(chunk.phase)) return false;
+    // skipped chunks still count as done for their phase
+    if (m_skipped && m_skipped(index)) {
+        endChunk();
+        return !m_stopped.load();
+    }
+    *traced = true;
+
+    bool ok = false;
+    TraceMetrics* metrics = TraceMetrics::active();
+    QElapsedTimer timer;
+    timer.start();
+    {
+        TraceEventScope event("chunk", "trace", "chunk", qint64(index), "rays", qint64(chunk.rays));
+        ok = trace(chunk);
+    }
+    const qint64 chunkNs = timer.nsecsElapsed();
+    m_workerBusyNs[size_t(worker)] += chunkNs;
+    if (metrics && ok)
+        metrics->addChunk(chunk.rays, chunkNs);
+    if (!ok) {
+        stop();
+        endChunk();
+        return false;
+    }
+
+    m_workerRays[size_t(worker)] += chunk.rays;
+    ulong tracedNow = m_traced.fetch_add(chunk.rays) + chunk.rays;
+    if (m_done)
+        m_done(chunk, tracedNow);
+    endChunk();
+    return !m_stopped.load();
+}
+
+// chunks of the next dispatch from the time per chunk, fewer towards the end
+// so the last dispatches still balance
+qulonglong TraceScheduler::nextBatch(double chunkNs) const
+{
+    double grainNs = m_grain*1e6;
+    qulonglong ans = chunkNs > 0. ? qulonglong(qMax(1., grainNs/chunkNs)) : MaxBatch;
+    qulonglong next = m_nextChunk.load();
+    qulonglong left = next < m_endChunk ? m_endChunk - next : 0;
+    qulonglong share = left/(4*qulonglong(m_workerCount));
+    return qMax<qulonglong>(1, qMin(qMin(ans, share), MaxBatch));
+}
+
+bool TraceScheduler::beginChunk(int phase)
+{
+    if (m_inline && phase > m_phase) {
+        // the only worker has done the chunks before
+        startPhases(phase);
+    }
+    std::unique_lock<std::mutex> lock(m_gateMutex);
+    TraceEventScope event("chunk gate", "wait");
+    m_gate.wait(lock, [this, phase]() {return (!m_paused && m_phase == phase) || m_stopped.load();});
+    if (m_stopped.load()) return false;
+    ++m_active;
+    return true;
+}
+
+// the worker past the interval waits for the others and pauses
+void TraceScheduler::endChunk()
+{
+    std::unique_lock<std::mutex> lock(m_gateMutex);
+    --m_active;
+    ++m_phaseDone;
+    m_gate.notify_all();
+    if (!m_pause || m_paused || m_pauseTimer.elapsed() < m_pauseInterval) return;
+
+    m_paused = true;
+    m_gate.wait(lock, [this]() {return m_active == 0 || m_stopped.load();});
+    if (!m_stopped.load()) {
+        // no chunk can begin while paused
+        lock.unlock();
+        m_pause();
+        lock.lock();
+    }
+    m_pauseTimer.restart();
+    m_paused = false;
+    m_gate.notify_all();
+}
+
+void TraceScheduler::stop()
+{
+    m_stopped.store(true);
+    std::lock_guard<std::mutex> lock(m_gateMutex);
+    m_gate.notify_all();
+}
+
+void TraceScheduler::finish()
+{
+    stop();
+}
+
+void TraceScheduler::cancel()
+{
+    m_canceled.store(true);
+    stop();
+}
+
+void TraceScheduler::fail(const QString& message)
+{
+    {
+        QMutexLocker lock(&m_errorMutex);
+        if (m_error.isEmpty())
+            m_error = message;
+    }
+    m_failed.store(true);
+    stop();
+}
+
+QString TraceScheduler::getError() const
+{
+    QMutexLocker lock(&m_errorMutex);
+    return m_error;
+}
+
+ulong TraceScheduler::chunkSeed(ulong seed, qulonglong chunk)
+{
+    quint64 value = quint64(seed);
+    value += 0x9e3779b97f4a7c15ull + (chunk << 6) + (chunk >> 2);
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ull;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebull;
+    value ^= value >> 31;
+    return ulong(value);
+}
+
+/*!
+ * Returns the generator of \a chunk. A substream of \a rand is drawn by the
+ * tracer directly; the others hold no numbers themselves: the tracer takes a
+ * stream of them or fills its own buffer from them.
+ */
+Random* TraceScheduler::createRandom(ulong seed, qulonglong chunk, bool counterBased, const Random* rand)
+{
+    if (rand)
+        if (Random* substream = rand->createSubstream(seed, chunk))
+            return substream;
+    if (counterBased)
+        return new RandomPhilox(seed, ulong(chunk), 0, 1);
+    return new RandomSTL(chunkSeed(seed, chunk), Random::StreamSize);
+}
+
+/*!
+ * Draws the seed of a trace from the generator selected by the user, so
+ * consecutive traces differ and a seeded generator repeats them.
+ */
+ulong TraceScheduler::drawSeed(Random* rand, bool* counterBased)
+{
+    std::unique_ptr<Random> stream(rand->createStream());
+    if (counterBased) *counterBased = bool(stream);
+    return ulong(rand->RandomDouble()*std::numeric_limits<quint32>::max());
+}
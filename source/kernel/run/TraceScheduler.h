@@ -0,0 +1,224 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+
+class Random;
+
+
+//! TraceScheduler runs a trace as chunks of rays on worker threads.
+/*!
+ * The rays are cut into chunks of a fixed size and every worker takes the
+ * next chunk when it is done with its own, so fast workers take more chunks
+ * and none waits for a fixed share. A chunk is defined by its index only:
+ * when its generator comes from createRandom() and its hits go to sinks of
+ * the worker, the result does not depend on the number of workers or on
+ * the order in which chunks complete.
+ *
+ * Cancellation is polled between chunks and cancel() may be called from any
+ * thread; chunks in flight are finished. An exception in a chunk stops the
+ * trace with an error.
+ *
+ * A pause function, if set, is called about every interval while no chunk
+ * is in flight, for checkpoints of what the workers have accumulated.
+ *
+ * With a target grain a worker takes several consecutive chunks at once,
+ * as many as it traced in about that time before. Chunks stay the unit of
+ * random streams and results, so only the dispatch overhead changes.
+ *
+ * A chunk range restricts the trace to the shard of one process of a
+ * distributed run; the chunks and their generators stay those of the
+ * whole trace.
+ *
+ * Phases trace several ray counts in a row, such as one per sun position,
+ * with one set of workers: the chunks of a phase begin only when those of
+ * the phase before are done and the phase start function has run on the
+ * calling thread, which may then change what the chunks read.
+ *
+ * A trace may also end early with finish(), such as once the phases done
+ * are enough for a convergence test run from the phase start function.
+ *
+ * With a placement every worker runs on a thread of its own pinned to a
+ * processor, and the start function lets it allocate what it fills on its
+ * own NUMA node before the first chunk.
+ *
+ * Without a placement, groups let every worker run on any processor of
+ * its processor group, see CpuTopology::joinGroup, so a pool wider than the
+ * group of the process spreads over the host.
+ *
+ * The time each worker spent in its chunks and the rays it traced are kept
+ * for the utilization of processors.
+ *
+ * A worker limit, which may change while the trace runs, holds the workers
+ * past it between dispatches, such as while the user of a GUI moves the
+ * view. The other workers take their chunks, so results do not change.
+ */
+class TONATIUH_KERNEL TraceScheduler
+{
+public:
+    struct Chunk
+    {
+        qulonglong index;
+        qulonglong start; // first ray of the phase
+        ulong rays;
+        int worker;
+        int phase;
+        qulonglong phaseChunk; // index in the phase
+    };
+
+    // false if the chunk was not completed, which stops the trace
+    using ChunkFunction = std::function<bool(const Chunk&)>;
+    using CancelFunction = std::function<bool()>;
+    using SkipFunction = std::function<bool(qulonglong)>;
+    // called on the worker after every completed chunk, with the rays traced so far
+    using DoneFunction = std::function<void(const Chunk&, ulong)>;
+    using PauseFunction = std::function<void()>;
+    using PhaseFunction = std::function<void(int)>;
+    using StartFunction = std::function<void(int)>;
+
+    TraceScheduler(ulong rays, ulong chunkSize, int workers);
+    TraceScheduler(const std::vector<ulong>& phaseRays, ulong chunkSize, int workers);
+
+    ulong getRays() const {return m_rays;}
+    ulong getChunkSize() const {return m_chunkSize;}
+    qulonglong getChunkCount() const {return m_chunkCount;}
+    int getWorkerCount() const {return m_workerCount;} // at most one per chunk
+    int getPhaseCount() const {return int(m_phaseRays.size());}
+    qulonglong getPhaseFirstChunk(int phase) const {return m_phaseFirst[phase];}
+
+    // worker dispatches of about \a ms each, 0 takes one chunk at a time
+    void setTargetGrain(double ms) {m_grain = qMax(0., ms);}
+    double getTargetGrain() const {return m_grain;}
+    qulonglong getDispatchCount() const {return m_dispatches.load();}
+
+    // traces chunks [first, end) only
+    void setChunkRange(qulonglong first, qulonglong end);
+    qulonglong getFirstChunk() const {return m_firstChunk;}
+    qulonglong getEndChunk() const {return m_endChunk;}
+    ulong getRangeRays() const;
+    // contiguous chunks of \a shard out of \a shards
+    static void shardRange(qulonglong chunks, int shard, int shards, qulonglong* first, qulonglong* end);
+
+    void setCancellation(const CancelFunction& cancellation) {m_cancellation = cancellation;}
+    // chunks completed before, their rays counted as traced
+    void setSkipped(const SkipFunction& skipped, ulong rays);
+    void setDone(const DoneFunction& done) {m_done = done;}
+    void setPause(qint64 intervalMs, const PauseFunction& pause);
+    // worker w is pinned to cpus[w % size]
+    void setPlacement(const std::vector<int>& cpus) {m_placement = cpus;}
+    int getWorkerCpu(int worker) const; // -1 if not placed
+    // worker w joins processor group groups[w % size] unless it is placed
+    void setGroups(const std::vector<int>& groups) {m_groups = groups;}
+    int getWorkerGroup(int worker) const; // -1 if not set
+    // workers from *limit on wait between dispatches while it is above 0;
+    // it may be set from any thread during run(), null lets all trace
+    void setWorkerLimit(const std::atomic<int>* limit) {m_limit = limit;}
+    // worker threads below normal priority, see CpuTopology::lowerThreadPriority;
+    // not the calling thread when it traces alone
+    void setLowPriority(bool on) {m_lowPriority = on;}
+    // called on the worker thread before its first chunk
+    void setWorkerStart(const StartFunction& start) {m_start = start;}
+    // called with the phase before every phase but the first, even if it has
+    // no chunks in the range, once the chunks of the phases before are done
+    void setPhaseStart(const PhaseFunction& start) {m_phaseStart = start;}
+
+    bool run(const ChunkFunction& trace);
+
+    // thread safe
+    void cancel();
+    // ends the trace without canceling it, chunks in flight are finished;
+    // from the phase start function no chunk of the next phase begins
+    void finish();
+    void fail(const QString& message);
+    bool isCanceled() const {return m_canceled.load();}
+    bool isStopped() const {return m_stopped.load();}
+    ulong getRaysTraced() const {return m_traced.load();}
+
+    // after run(): its wall time, and the time worker w spent in the chunks
+    // it traced and their rays
+    qint64 getRunNs() const {return m_runNs;}
+    qint64 getWorkerBusyNs(int worker) const {return m_workerBusyNs[worker];}
+    qulonglong getWorkerRays(int worker) const {return m_workerRays[worker];}
+
+    bool hasFailed() const {return m_failed.load();}
+    QString getError() const;
+
+    // seed of the RandomSTL generator of a chunk
+    static ulong chunkSeed(ulong seed, qulonglong chunk);
+    // generator of a chunk: the substream of \a rand if it has substreams,
+    // else a RandomPhilox stream or a seeded RandomSTL, buffered to be drawn
+    // by the tracer of the chunk without a mutex
+    static Random* createRandom(ulong seed, qulonglong chunk, bool counterBased, const Random* rand = nullptr);
+    // run seed drawn from \a rand; counter-based if \a rand gives streams
+    static ulong drawSeed(Random* rand, bool* counterBased);
+
+private:
+    void work(const ChunkFunction& trace, int worker);
+    bool traceChunk(const ChunkFunction& trace, qulonglong index, int worker, bool* traced);
+    void waitLimit(int worker);
+    qulonglong nextBatch(double chunkNs) const;
+    bool beginChunk(int phase);
+    void endChunk();
+    int findPhase(qulonglong chunk) const;
+    qulonglong raysBefore(qulonglong chunk) const;
+    qulonglong getRangeChunks(int phase) const;
+    void startPhases(int last);
+    void stop();
+
+    ulong m_rays;
+    ulong m_chunkSize;
+    qulonglong m_chunkCount;
+    int m_workersRequested;
+    int m_workerCount;
+    qulonglong m_firstChunk = 0;
+    qulonglong m_endChunk;
+    std::vector<ulong> m_phaseRays;
+    std::vector<qulonglong> m_phaseFirst; // chunks, with the end last
+    std::vector<qulonglong> m_phaseFirstRay;
+
+    CancelFunction m_cancellation;
+    SkipFunction m_skipped;
+    ulong m_raysSkipped = 0;
+    DoneFunction m_done;
+    PauseFunction m_pause;
+    qint64 m_pauseInterval = 0;
+    double m_grain = 0.;
+    std::vector<int> m_placement;
+    std::vector<int> m_groups;
+    const std::atomic<int>* m_limit = nullptr;
+    bool m_lowPriority = false;
+    StartFunction m_start;
+    PhaseFunction m_phaseStart;
+
+    std::atomic<qulonglong> m_nextChunk{0};
+    std::atomic<ulong> m_traced{0};
+    std::atomic<qulonglong> m_dispatches{0};
+    std::atomic_bool m_stopped{false};
+    std::atomic_bool m_canceled{false};
+    std::atomic_bool m_failed{false};
+    // each worker writes its own
+    std::vector<qint64> m_workerBusyNs;
+    std::vector<qulonglong> m_workerRays;
+    qint64 m_runNs = 0;
+    mutable QMutex m_errorMutex;
+    QString m_error;
+
+    // pause gate
+    std::mutex m_gateMutex;
+    std::condition_variable m_gate;
+    int m_active = 0; // chunks in flight
+    bool m_paused = false;
+    int m_phase = 0; // whose chunks may begin
+    qulonglong m_phaseDone = 0; // its chunks done
+    bool m_inline = false;
+    QElapsedTimer m_pauseTimer;
+};
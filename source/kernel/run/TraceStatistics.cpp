@@ -0,0 +1,83 @@
+#include "TraceStatistics.h"
+
+#include <algorithm>
+
+
+namespace {
+
+thread_local TraceStatistics* s_current = nullptr;
+
+}
+
+
+bool TraceStatistics::isEnabled()
+{
+#ifdef TONATIUHPP_TRACE_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+TraceStatistics* TraceStatistics::current()
+{
+    return s_current;
+}
+
+void TraceStatistics::setCurrent(TraceStatistics* statistics)
+{
+    s_current = statistics;
+}
+
+void TraceStatistics::addShapeTest(const char* shape)
+{
+    for (Counter& counter : m_shapeTests)
+        if (counter.shape == shape) {
+            counter.count++;
+            return;
+        }
+    const QString name = QString::fromLatin1(shape);
+    for (Counter& counter : m_shapeTests)
+        if (counter.name == name) {
+            counter.shape = shape;
+            counter.count++;
+            return;
+        }
+    m_shapeTests.push_back(Counter{shape, name, 1});
+}
+
+void TraceStatistics::add(const TraceStatistics& other)
+{
+    rays += other.rays;
+    bounces += other.bounces;
+    hits += other.hits;
+    sunMisses += other.sunMisses;
+    boxTests += other.boxTests;
+    instanceSwitches += other.instanceSwitches;
+    for (const Counter& counter : other.m_shapeTests) {
+        auto found = std::find_if(m_shapeTests.begin(), m_shapeTests.end(), [&counter](const Counter& c) {
+            return c.name == counter.name;
+        });
+        if (found == m_shapeTests.end())
+            m_shapeTests.push_back(counter);
+        else
+            found->count += counter.count;
+    }
+}
+
+void TraceStatistics::clear()
+{
+    *this = TraceStatistics();
+}
+
+// sorted by shape name
+std::vector<TraceStatistics::ShapeTests> TraceStatistics::getShapeTests() const
+{
+    std::vector<ShapeTests> ans;
+    for (const Counter& counter : m_shapeTests)
+        ans.push_back(ShapeTests{counter.name, counter.count});
+    std::sort(ans.begin(), ans.end(), [](const ShapeTests& a, const ShapeTests& b) {
+        return a.shape < b.shape;
+    });
+    return ans;
+}
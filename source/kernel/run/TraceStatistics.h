@@ -0,0 +1,90 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include <QString>
+#include <qglobal.h>
+
+
+//! TraceStatistics counts the work done by a trace, to see why a scene is slow.
+/*!
+ * The counters are filled only in builds with TONATIUHPP_ENABLE_TRACE_STATS,
+ * through the TRACE_STATS macro, which does nothing otherwise. A tracer
+ * makes its statistics current for its thread while it runs, so the
+ * intersection code below it counts into them without locking.
+ *
+ * Box tests count the calls of the box intersection of instances and of
+ * the nodes of the scene and mesh hierarchies, one per node of four boxes.
+ * Shape tests count the calls of ShapeRT::intersect by shape class.
+ */
+class TONATIUH_KERNEL TraceStatistics
+{
+public:
+    struct ShapeTests
+    {
+        QString shape;
+        qulonglong count = 0;
+    };
+
+    // whether this build counts
+    static bool isEnabled();
+
+    // the statistics of the calling thread, null if none is current
+    static TraceStatistics* current();
+    static void setCurrent(TraceStatistics* statistics);
+
+    // shape is a type name, its address compared first
+    void addShapeTest(const char* shape);
+
+    void add(const TraceStatistics& other);
+    void clear();
+
+    std::vector<ShapeTests> getShapeTests() const;
+
+    qulonglong rays = 0;
+    qulonglong bounces = 0;   // reflections
+    qulonglong hits = 0;      // intersections found, reflected or not
+    qulonglong sunMisses = 0; // rays from the sun hitting nothing
+    qulonglong boxTests = 0;
+    // closest hits of a wavefront batch on another top-level instance than
+    // the ray before, how incoherent the batch is
+    qulonglong instanceSwitches = 0;
+
+private:
+    struct Counter
+    {
+        const char* shape; // compared, not read, as plugins may be unloaded
+        QString name;
+        qulonglong count;
+    };
+    std::vector<Counter> m_shapeTests;
+};
+
+
+//! makes statistics current for the thread until the scope ends
+class TraceStatisticsScope
+{
+public:
+    explicit TraceStatisticsScope(TraceStatistics* statistics):
+        m_previous(TraceStatistics::current())
+    {
+        TraceStatistics::setCurrent(statistics);
+    }
+    ~TraceStatisticsScope() {TraceStatistics::setCurrent(m_previous);}
+
+    TraceStatisticsScope(const TraceStatisticsScope&) = delete;
+    TraceStatisticsScope& operator=(const TraceStatisticsScope&) = delete;
+
+private:
+    TraceStatistics* m_previous;
+};
+
+
+#ifdef TONATIUHPP_TRACE_STATS
+#define TRACE_STATS(statement) \
+    do { if (TraceStatistics* traceStatistics_ = TraceStatistics::current()) traceStatistics_->statement; } while (false)
+#else
+#define TRACE_STATS(statement) do {} while (false)
+#endif
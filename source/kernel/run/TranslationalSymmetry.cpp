@@ -0,0 +1,126 @@
+#include "TranslationalSymmetry.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "libraries/math/gcf.h"
+#include "libraries/math/3D/Ray.h"
+#include "libraries/math/3D/Transform.h"
+
+
+TranslationalSymmetry::TranslationalSymmetry(int axis, const Box3D& box):
+    m_axis(axis),
+    m_box(box)
+{
+}
+
+/*!
+ * Translating a ray by a period along the axis moves its origin on the sun
+ * plane by the period times the axis projected onto the plane, so a strip
+ * that long holds every ray of the endless field once. Its side spans the
+ * box as seen from the sun, which the translations keep.
+ */
+bool TranslationalSymmetry::setSun(const Transform& sunToWorld)
+{
+    m_area = 0.;
+    const Transform toSun = sunToWorld.inversed();
+    vec3d unit(0., 0., 0.);
+    unit[m_axis] = 1.;
+    const vec3d a = toSun.transformVector(unit);
+    const vec2d step(a.x, a.y);
+    if (step.norm() < 1e-6) return false;
+
+    const vec2d along = step.normalized();
+    const vec2d across(-along.y, along.x);
+    double uMin = gcf::infinity;
+    double vMin = gcf::infinity;
+    double vMax = -gcf::infinity;
+    const vec3d& p = m_box.min();
+    const vec3d& q = m_box.max();
+    for (int n = 0; n < 8; ++n) {
+        const vec3d c = toSun.transformPoint(vec3d(n & 4 ? q.x : p.x, n & 2 ? q.y : p.y, n & 1 ? q.z : p.z));
+        const vec2d c2(c.x, c.y);
+        uMin = std::min(uMin, dot(c2, along));
+        vMin = std::min(vMin, dot(c2, across));
+        vMax = std::max(vMax, dot(c2, across));
+    }
+
+    m_stripOrigin = along*uMin + across*vMin;
+    m_stripStep = step*getPeriod();
+    m_stripSide = across*(vMax - vMin);
+    m_area = getPeriod()*step.norm()*(vMax - vMin);
+    return m_area > 0.;
+}
+
+vec3d TranslationalSymmetry::sampleAperture(double u, double v) const
+{
+    const vec2d p = m_stripOrigin + m_stripStep*u + m_stripSide*v;
+    return vec3d(p.x, p.y, 0.);
+}
+
+/*!
+ * The endless field may cross the sun plane, so the rays from the sun start
+ * just before the box grown along the axis instead, on the same line.
+ */
+void TranslationalSymmetry::enter(Ray& ray) const
+{
+    double t0, t1;
+    if (findSides(ray, &t0, &t1) && std::isfinite(t0))
+        ray.origin = ray.point(t0 - 1e-3*m_box.size().norm());
+    wrap(ray.origin);
+}
+
+void TranslationalSymmetry::wrap(vec3d& p) const
+{
+    const double period = getPeriod();
+    if (!(period > 0.)) return;
+    const double x = p[m_axis] - m_box.min()[m_axis];
+    p[m_axis] = m_box.min()[m_axis] + (x - period*std::floor(x/period));
+}
+
+double TranslationalSymmetry::findEnd(const Ray& ray) const
+{
+    const double d = ray.direction()[m_axis];
+    if (d > 0.)
+        return (m_box.max()[m_axis] - ray.origin[m_axis])/d;
+    if (d < 0.)
+        return (m_box.min()[m_axis] - ray.origin[m_axis])/d;
+    return gcf::infinity;
+}
+
+double TranslationalSymmetry::findExit(const Ray& ray) const
+{
+    double t0, t1;
+    if (!findSides(ray, &t0, &t1) || t1 < 0.)
+        return -1.;
+    return t1;
+}
+
+void TranslationalSymmetry::crossEnd(vec3d& p, const vec3d& direction) const
+{
+    p[m_axis] = direction[m_axis] > 0. ? m_box.min()[m_axis] : m_box.max()[m_axis];
+}
+
+// the line of ray between the sides of the box, those parallel to the axis
+bool TranslationalSymmetry::findSides(const Ray& ray, double* t0, double* t1) const
+{
+    double tNear = -gcf::infinity;
+    double tFar = gcf::infinity;
+    for (int i = 0; i < 3; ++i) {
+        if (i == m_axis) continue;
+        const double o = ray.origin[i];
+        const double d = ray.direction()[i];
+        if (d == 0.) {
+            if (o < m_box.min()[i] || o > m_box.max()[i]) return false;
+            continue;
+        }
+        double ta = (m_box.min()[i] - o)/d;
+        double tb = (m_box.max()[i] - o)/d;
+        if (ta > tb) std::swap(ta, tb);
+        tNear = std::max(tNear, ta);
+        tFar = std::min(tFar, tb);
+    }
+    *t0 = tNear;
+    *t1 = tFar;
+    return tNear <= tFar;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include "libraries/math/2D/vec2d.h"
+#include "libraries/math/3D/Box3D.h"
+#include "libraries/math/3D/vec3d.h"
+
+class Ray;
+class Transform;
+
+
+//! TranslationalSymmetry is an axis a scene is declared invariant along.
+/*!
+ * A trough or linear Fresnel field is an extrusion. Its layout is traced as
+ * one period of an endless field: the extent of its box along a world axis.
+ * A ray leaving the period through an end face enters it again through the
+ * other, so a period of a receiver tube gets the flux of the middle of a
+ * long one from the rays of a short stretch of the field.
+ *
+ * Rays from the sun start on a strip of the sun plane whose points stand
+ * for each ray of the endless field once, and that strip is the aperture.
+ * The ends of a real field, where the flux falls off, are not modelled.
+ */
+class TONATIUH_KERNEL TranslationalSymmetry
+{
+public:
+    // the field box repeats along world axis 0, 1 or 2
+    TranslationalSymmetry(int axis, const Box3D& box);
+
+    int getAxis() const {return m_axis;}
+    const Box3D& getBox() const {return m_box;}
+    double getPeriod() const {return m_box.max()[m_axis] - m_box.min()[m_axis];}
+
+    // finds the strip for the sun frame sunToWorld, false if the sun shines
+    // along the axis, where no strip is
+    bool setSun(const Transform& sunToWorld);
+    double getApertureArea() const {return m_area;}
+    // a point of the strip in the sun frame, from u and v in [0, 1)
+    vec3d sampleAperture(double u, double v) const;
+
+    // moves the origin of a ray from the sun back to where it enters the
+    // box grown along the axis, then into the period
+    void enter(Ray& ray) const;
+    void wrap(vec3d& p) const;
+
+    // how far ray, starting in the period, goes before it leaves the period
+    // through an end face, infinity if it leaves through a side or never
+    double findEnd(const Ray& ray) const;
+    // how far ray goes before it leaves the box grown along the axis for
+    // good, negative if it never is in it
+    double findExit(const Ray& ray) const;
+    // moves a point on an end face onto the other, for a ray going direction
+    void crossEnd(vec3d& p, const vec3d& direction) const;
+
+private:
+    bool findSides(const Ray& ray, double* t0, double* t1) const;
+
+    int m_axis;
+    Box3D m_box;
+    // the strip in the sun frame
+    vec2d m_stripOrigin;
+    vec2d m_stripStep; // one period
+    vec2d m_stripSide;
+    double m_area = 0.;
+};
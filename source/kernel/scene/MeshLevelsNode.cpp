@@ -0,0 +1,223 @@
+#include "MeshLevelsNode.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Inventor/SbViewVolume.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/elements/SoViewVolumeElement.h>
+#include <Inventor/elements/SoViewportRegionElement.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+
+#include <QCoreApplication>
+#include <QThreadPool>
+
+#include "kernel/shape/MeshSimplifier.h"
+
+SO_NODE_SOURCE(MeshLevelsNode)
+
+
+// a copy of the mesh for the worker
+struct MeshLevelsNode::Job
+{
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    std::vector<int> faces;
+    std::vector<int> normalFaces;
+    bool reverseNormals = false;
+    std::atomic<bool> canceled{false};
+};
+
+void MeshLevelsNode::initClass()
+{
+    SO_NODE_INIT_CLASS(MeshLevelsNode, SoShape, "Shape");
+}
+
+MeshLevelsNode::MeshLevelsNode():
+    m_full(0)
+{
+    SO_NODE_CONSTRUCTOR(MeshLevelsNode);
+    isBuiltIn = TRUE;
+}
+
+MeshLevelsNode::~MeshLevelsNode()
+{
+    clear();
+}
+
+SoShape* MeshLevelsNode::makeShape(SoIndexedFaceSet* full,
+                                   const SbVec3f* vertices, int vertexCount,
+                                   const SbVec3f* normals, bool reverseNormals)
+{
+    // a triangle takes 4 indices
+    if (full->coordIndex.getNum() < 4*MinTriangles || !QCoreApplication::instance())
+        return full;
+
+    MeshLevelsNode* node = new MeshLevelsNode;
+    node->setMesh(full, vertices, vertexCount, normals, reverseNormals);
+    return node;
+}
+
+void MeshLevelsNode::clear()
+{
+    if (m_job) m_job->canceled = true;
+    m_job.reset();
+    for (SoIndexedFaceSet* level : m_levels)
+        level->unref();
+    m_levels.clear();
+    m_errors.clear();
+    if (m_full) m_full->unref();
+    m_full = 0;
+}
+
+void MeshLevelsNode::setMesh(SoIndexedFaceSet* full,
+                             const SbVec3f* vertices, int vertexCount,
+                             const SbVec3f* normals, bool reverseNormals)
+{
+    if (full) full->ref();
+    clear();
+    m_full = full;
+    m_box.makeEmpty();
+    touch();
+    if (!m_full || vertexCount <= 0) return;
+
+    for (int n = 0; n < vertexCount; ++n)
+        m_box.extendBy(vertices[n]);
+
+    QCoreApplication* app = QCoreApplication::instance();
+    if (!app) return;
+
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    const float* v = vertices[0].getValue();
+    job->vertices.assign(v, v + 3*vertexCount);
+    const int32_t* faces = m_full->coordIndex.getValues(0);
+    job->faces.assign(faces, faces + m_full->coordIndex.getNum());
+    int normalCount = vertexCount;
+    if (m_full->normalIndex.getNum() > 0) {
+        const int32_t* normalFaces = m_full->normalIndex.getValues(0);
+        job->normalFaces.assign(normalFaces, normalFaces + m_full->normalIndex.getNum());
+        normalCount = 1 + *std::max_element(job->normalFaces.begin(), job->normalFaces.end());
+    }
+    if (normals && normalCount > 0) {
+        const float* nv = normals[0].getValue();
+        job->normals.assign(nv, nv + 3*normalCount);
+    }
+    job->reverseNormals = reverseNormals;
+    m_job = job;
+
+    // the node is kept until the levels come back to the GUI thread
+    ref();
+    QThreadPool::globalInstance()->start([this, job, app]() {
+        MeshSimplifier::Input input;
+        input.vertices = job->vertices.data();
+        input.vertexCount = int(job->vertices.size()/3);
+        input.faces = job->faces.data();
+        input.faceCount = int(job->faces.size());
+        input.normals = job->normals.empty() ? nullptr : job->normals.data();
+        input.normalFaces = job->normalFaces.empty() ? nullptr : job->normalFaces.data();
+
+        std::vector<MeshLevel> levels = MeshSimplifier::makeLevels(input, LevelTriangles,
+            [job]() {return job->canceled.load();});
+        if (job->reverseNormals)
+            for (MeshLevel& level : levels)
+                for (float& x : level.normals) x = -x;
+
+        QMetaObject::invokeMethod(app, [this, job, levels = std::move(levels)]() {
+            if (m_job == job && !job->canceled) setLevels(levels);
+            unref();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MeshLevelsNode::setLevels(const std::vector<MeshLevel>& levels)
+{
+    m_job.reset();
+    for (const MeshLevel& level : levels) {
+        SoVertexProperty* vp = new SoVertexProperty;
+        int vertexCount = int(level.vertices.size()/3);
+        vp->vertex.setNum(vertexCount);
+        SbVec3f* vertices = vp->vertex.startEditing();
+        for (int n = 0; n < vertexCount; ++n)
+            vertices[n].setValue(&level.vertices[3*n]);
+        vp->vertex.finishEditing();
+
+        vp->normal.setNum(vertexCount);
+        SbVec3f* normals = vp->normal.startEditing();
+        for (int n = 0; n < vertexCount; ++n)
+            normals[n].setValue(&level.normals[3*n]);
+        vp->normal.finishEditing();
+        vp->normalBinding = SoVertexProperty::PER_VERTEX_INDEXED;
+
+        SoIndexedFaceSet* faceSet = new SoIndexedFaceSet;
+        faceSet->vertexProperty = vp;
+        int triangleCount = level.getTriangleCount();
+        faceSet->coordIndex.setNum(4*triangleCount);
+        int32_t* indices = faceSet->coordIndex.startEditing();
+        for (int t = 0; t < triangleCount; ++t) {
+            indices[4*t] = level.triangles[3*t];
+            indices[4*t + 1] = level.triangles[3*t + 1];
+            indices[4*t + 2] = level.triangles[3*t + 2];
+            indices[4*t + 3] = -1;
+        }
+        faceSet->coordIndex.finishEditing();
+
+        faceSet->ref();
+        m_levels.push_back(faceSet);
+        m_errors.push_back(level.error);
+    }
+    touch();
+}
+
+void MeshLevelsNode::GLRender(SoGLRenderAction* action)
+{
+    if (!m_full) return;
+    SoIndexedFaceSet* shape = m_full;
+
+    if (!m_levels.empty()) {
+        // reading the view elements makes render caches depend on them
+        SoState* state = action->getState();
+        const SbViewVolume& volume = SoViewVolumeElement::get(state);
+        const SbViewportRegion& region = SoViewportRegionElement::get(state);
+        const SbMatrix& model = SoModelMatrixElement::get(state);
+
+        SbVec3f center;
+        model.multVecMatrix(m_box.getCenter(), center);
+        int height = std::max<int>(region.getViewportSizePixels()[1], 1);
+        float pixel = volume.getWorldToScreenScale(center, 1.f/height);
+        float scale = std::cbrt(std::fabs(model.det3()));
+
+        for (int n = 0; n < int(m_levels.size()); ++n)
+            if (m_errors[n]*scale <= pixel) shape = m_levels[n];
+    }
+    shape->GLRender(action);
+}
+
+void MeshLevelsNode::rayPick(SoRayPickAction* action)
+{
+    if (m_full) m_full->rayPick(action);
+}
+
+void MeshLevelsNode::callback(SoCallbackAction* action)
+{
+    if (m_full) m_full->callback(action);
+}
+
+void MeshLevelsNode::getBoundingBox(SoGetBoundingBoxAction* action)
+{
+    if (m_full) m_full->getBoundingBox(action);
+}
+
+void MeshLevelsNode::getPrimitiveCount(SoGetPrimitiveCountAction* action)
+{
+    if (m_full) m_full->getPrimitiveCount(action);
+}
+
+void MeshLevelsNode::computeBBox(SoAction*, SbBox3f& box, SbVec3f& center)
+{
+    box = m_box;
+    if (!box.isEmpty()) center = box.getCenter();
+}
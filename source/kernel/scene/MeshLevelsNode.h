@@ -0,0 +1,73 @@
+#pragma once
+#include "kernel/TonatiuhKernel.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <Inventor/SbBox3f.h>
+#include <Inventor/nodes/SoShape.h>
+
+class SbVec3f;
+class SoIndexedFaceSet;
+struct MeshLevel;
+
+//! MeshLevelsNode draws a large mesh at the detail its size on screen needs.
+/*!
+ * It takes the place of the SoIndexedFaceSet of a shape in the shape kit,
+ * which stays the full mesh: it is drawn until coarser levels are ready and
+ * answers picks, bounding boxes and callbacks. The levels are made from a
+ * copy of the mesh by MeshSimplifier on a worker thread and attached on the
+ * GUI thread; each frame the coarsest level whose error covers at most a
+ * pixel is drawn.
+ *
+ * Only the view is affected: the ray tracer reads the shapes, not this node.
+ */
+class TONATIUH_KERNEL MeshLevelsNode: public SoShape
+{
+    SO_NODE_HEADER(MeshLevelsNode);
+
+public:
+    static void initClass();
+    MeshLevelsNode();
+
+    // the full mesh, or a MeshLevelsNode over it when it is large enough to
+    // need levels; normals are indexed by the normalIndex of the face set
+    // when it has one, and per vertex otherwise
+    static SoShape* makeShape(SoIndexedFaceSet* full,
+                              const SbVec3f* vertices, int vertexCount,
+                              const SbVec3f* normals, bool reverseNormals = false);
+
+    void setMesh(SoIndexedFaceSet* full,
+                 const SbVec3f* vertices, int vertexCount,
+                 const SbVec3f* normals, bool reverseNormals = false);
+    SoIndexedFaceSet* getFull() const {return m_full;}
+    int getLevelCount() const {return int(m_levels.size());}
+
+    void GLRender(SoGLRenderAction* action);
+    void rayPick(SoRayPickAction* action);
+    void callback(SoCallbackAction* action);
+    void getBoundingBox(SoGetBoundingBoxAction* action);
+    void getPrimitiveCount(SoGetPrimitiveCountAction* action);
+
+    static const int MinTriangles = 100000; // smaller meshes are drawn in full
+    static const int LevelTriangles = 5000; // the coarsest level
+
+protected:
+    ~MeshLevelsNode();
+
+    void computeBBox(SoAction* action, SbBox3f& box, SbVec3f& center);
+    void generatePrimitives(SoAction*) {}
+
+private:
+    struct Job;
+
+    void setLevels(const std::vector<MeshLevel>& levels);
+    void clear();
+
+    SoIndexedFaceSet* m_full;
+    std::vector<SoIndexedFaceSet*> m_levels; // from fine to coarse
+    std::vector<float> m_errors;
+    SbBox3f m_box;
+    std::shared_ptr<Job> m_job;
+};
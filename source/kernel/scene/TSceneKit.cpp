@@ -3,12 +3,20 @@
 #include <Inventor/nodes/SoTransform.h>
 #include <Inventor/nodes/SoGroup.h>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
 
 #include "libraries/math/gcf.h"
+#include "libraries/math/2D/vec2d.h"
 #include "libraries/math/3D/Transform.h"
 #include "libraries/math/3D/vec3d.h"
 
+#include "kernel/node/SensorBatch.h"
+#include "kernel/trackers/TrackerArmature.h"
 #include "kernel/trackers/TrackerKit.h"
+#include "kernel/trackers/TrackerTarget.h"
 #include "kernel/air/AirTransmission.h"
 #include "kernel/sun/SunShapePillbox.h"
 #include "kernel/sun/SunKit.h"
@@ -68,11 +76,134 @@ TSeparatorKit* TSceneKit::getLayout()
     return (TSeparatorKit*) getPart("group", false);
 }
 
-void TSceneKit::updateTrackers()
+// a tracker with what its armature solves from, read before solving
+struct TSceneKit::TrackerJob
+{
+    TrackerKit* tracker;
+    TSeparatorKit* parent;
+    Transform toGlobal;
+    TrackerArmature* armature;
+    int aimingType;
+    vec3d aimingPoint;
+};
+
+/*!
+ * Updates all trackers for the current sun. The trackers are collected
+ * with their transforms first. Their armatures are solved on several
+ * threads from plain data, trackers of armatures with the same joints
+ * together in batches, and the angles are set in scene order. If a
+ * tracker sits below another one, that tracker moves it while it is
+ * solved, and the scene is walked one tracker at a time instead.
+ */
+void TSceneKit::updateTrackers(bool shapes)
 {
     SunPosition* sp = (SunPosition*) getPart("world.sun.position", false);
+    if (!sp->trackable.getValue()) return;
     vec3d vSun = sp->getSunVector();
-    updateTrackers(getLayout(), Transform::Identity, vSun);
+    // callbacks of the trackers and what they move run once, on return
+    SensorBatch batch;
+
+    std::vector<TrackerJob> jobs;
+    if (collectTrackers(getLayout(), Transform::Identity, false, jobs)) {
+        updateTrackers(getLayout(), Transform::Identity, vSun);
+        return;
+    }
+
+    // trackers of armatures with the same joints, in batches
+    std::map<QByteArray, std::vector<size_t> > groups;
+    for (size_t n = 0; n < jobs.size(); ++n)
+        groups[jobs[n].armature->jointsKey()].push_back(n);
+
+    const size_t batchSize = 1024;
+    std::vector< std::pair<const std::vector<size_t>*, size_t> > batches;
+    for (const auto& group : groups)
+        for (size_t begin = 0; begin < group.second.size(); begin += batchSize)
+            batches.push_back({&group.second, begin});
+
+    std::vector<vec2d> angles(jobs.size());
+    std::vector<char> solved(jobs.size(), 0);
+    std::atomic<size_t> next(0);
+    auto solve = [&]() {
+        std::vector<Transform> toGlobals;
+        std::vector<int> aimingTypes;
+        std::vector<vec3d> aimingPoints;
+        std::vector<vec2d> batchAngles;
+        std::vector<char> batchSolved;
+        for (size_t b = next++; b < batches.size(); b = next++) {
+            const std::vector<size_t>& group = *batches[b].first;
+            const size_t begin = batches[b].second;
+            const size_t end = std::min(group.size(), begin + batchSize);
+            toGlobals.clear();
+            aimingTypes.clear();
+            aimingPoints.clear();
+            for (size_t q = begin; q < end; ++q) {
+                const TrackerJob& job = jobs[group[q]];
+                toGlobals.push_back(job.toGlobal);
+                aimingTypes.push_back(job.aimingType);
+                aimingPoints.push_back(job.aimingPoint);
+            }
+            const int count = end - begin;
+            batchAngles.resize(count);
+            batchSolved.resize(count);
+            jobs[group[begin]].armature->solve(count, toGlobals.data(), vSun, aimingTypes.data(), aimingPoints.data(), batchAngles.data(), batchSolved.data());
+            for (int q = 0; q < count; ++q) {
+                angles[group[begin + q]] = batchAngles[q];
+                solved[group[begin + q]] = batchSolved[q];
+            }
+        }
+    };
+
+    const size_t jobsPerThread = 256;
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), jobs.size()/jobsPerThread));
+    std::vector<std::thread> workers;
+    for (size_t w = 1; w < threads; ++w)
+        workers.emplace_back(solve);
+    solve();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    for (size_t n = 0; n < jobs.size(); ++n) {
+        const TrackerJob& job = jobs[n];
+        if (solved[n])
+            job.tracker->setAngles(angles[n], shapes);
+        else
+            job.tracker->update(job.parent, job.toGlobal, vSun);
+    }
+}
+
+// true if a tracker is found below another one
+bool TSceneKit::collectTrackers(TSeparatorKit* parent, const Transform& toGlobal, bool tracked, std::vector<TrackerJob>& jobs)
+{
+    TTransform* tParent = (TTransform*) parent->getPart("transform", true);
+    Transform t = toGlobal*tgf::makeTransform(tParent);
+
+    SoGroup* nodes = (SoGroup*) parent->getPart("group", false);
+    if (!nodes) return false;
+
+    bool hasTracker = false;
+    for (int n = 0; n < nodes->getNumChildren(); ++n)
+        if (dynamic_cast<TrackerKit*>(nodes->getChild(n))) hasTracker = true;
+    if (hasTracker && tracked) return true;
+
+    for (int n = 0; n < nodes->getNumChildren(); ++n)
+    {
+        SoNode* node = nodes->getChild(n);
+        if (TSeparatorKit* child = dynamic_cast<TSeparatorKit*>(node)) {
+            if (collectTrackers(child, t, tracked || hasTracker, jobs)) return true;
+        } else if (TrackerKit* tracker = dynamic_cast<TrackerKit*>(node)) {
+            if (!tracker->enabled.getValue()) continue;
+            TrackerTarget* target = (TrackerTarget*) tracker->target.getValue();
+            TrackerJob job;
+            job.tracker = tracker;
+            job.parent = parent;
+            job.toGlobal = t;
+            job.armature = (TrackerArmature*) tracker->armature.getValue();
+            job.aimingType = target->aimingType.getValue();
+            job.aimingPoint = tgf::makeVector3D(target->aimingPoint.getValue());
+            jobs.push_back(job);
+        }
+    }
+    return false;
 }
 
 void TSceneKit::updateParents(TSeparatorKit* parent)
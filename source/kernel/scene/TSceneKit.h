@@ -2,6 +2,8 @@
 
 #include <Inventor/nodekits/SoSceneKit.h>
 
+#include <vector>
+
 #include "kernel/TonatiuhKernel.h"
 #include "kernel/node/TonatiuhTypes.h"
 #include "kernel/node/TonatiuhFunctions.h"
@@ -28,7 +30,9 @@ public:
 
     TSeparatorKit* getLayout();
 
-    void updateTrackers();
+    // shapes of the trackers are left as they are without shapes, the
+    // joints that carry their surfaces are always turned
+    void updateTrackers(bool shapes = true);
     void updateParents(TSeparatorKit* parent = 0);
 
     GraphicRoot* m_graphicRoot;
@@ -36,4 +40,7 @@ public:
 protected:
     ~TSceneKit();
     void updateTrackers(TSeparatorKit* parent, Transform t, const vec3d& vSun);
+
+    struct TrackerJob;
+    bool collectTrackers(TSeparatorKit* parent, const Transform& toGlobal, bool tracked, std::vector<TrackerJob>& jobs);
 };
@@ -9,14 +9,18 @@
 #include "kernel/profiles/ProfileBox.h"
 #include "kernel/profiles/ProfileRectangular.h"
 #include "kernel/material/MaterialAbsorber.h"
+#include "kernel/node/SensorBatch.h"
 #include "kernel/shape/DifferentialGeometry.h"
 #include "kernel/shape/ShapePlanar.h"
 #include "kernel/shape/ShapeSphere.h"
 #include "libraries/math/3D/Ray.h"
 #include "scene/MaterialGL.h"
+#include "scene/MeshLevelsNode.h"
 
 SO_KIT_SOURCE(TShapeKit)
 
+bool TShapeKit::s_deferredGL = false;
+
 
 void TShapeKit::initClass()
 {
@@ -26,6 +30,7 @@ void TShapeKit::initClass()
     ProfileRT::initClass();
     MaterialRT::initClass();
     MaterialGL::initClass();
+    MeshLevelsNode::initClass();
 }
 
 TShapeKit::TShapeKit()
@@ -85,11 +90,13 @@ TShapeKit::~TShapeKit()
     delete m_sensor_shapeRT;
     delete m_sensor_profileRT;
     delete m_sensor_material;
+    SensorBatch::forget(this);
 //    m_shapeKit->unref();
 }
 
 void TShapeKit::onSensor(void* data, SoSensor*)
 {
+    if (SensorBatch::defer(onSensor, data)) return;
     TShapeKit* kit = (TShapeKit*) data;
     //    qDebug() << "called " << kit->getName();
 
@@ -100,11 +107,15 @@ void TShapeKit::onSensor(void* data, SoSensor*)
     }
 
     ShapeRT* shape = (ShapeRT*) kit->shapeRT.getValue();
-    shape->updateShapeGL(kit);
+    shape->updateShapeRT(kit);
+    kit->m_dirtyGL = true;
+    if (!s_deferredGL) kit->updateShapeGL();
 }
 
 void TShapeKit::onSensorShape(void* data, SoSensor*)
 {
+    // the update of onSensor, held once with it
+    if (SensorBatch::defer(onSensor, data)) return;
     TShapeKit* kit = (TShapeKit*) data;
 
     SoGroup* g = (SoGroup*) kit->topSeparator.getValue();
@@ -116,7 +127,35 @@ void TShapeKit::onSensorShape(void* data, SoSensor*)
 //    kit->enableNotify(FALSE);
 //    kit->profileRT = shape->getDefaultProfile();
 //    kit->enableNotify(TRUE);
-    shape->updateShapeGL(kit);
+    shape->updateShapeRT(kit);
+    kit->m_dirtyGL = true;
+    if (!s_deferredGL) kit->updateShapeGL();
+}
+
+void TShapeKit::updateShapeGL()
+{
+    if (!m_dirtyGL) return;
+    m_dirtyGL = false;
+    ShapeRT* shape = (ShapeRT*) shapeRT.getValue();
+    shape->updateShapeGL(this);
+}
+
+void TShapeKit::GLRender(SoGLRenderAction* action)
+{
+    updateShapeGL();
+    SoBaseKit::GLRender(action);
+}
+
+void TShapeKit::getBoundingBox(SoGetBoundingBoxAction* action)
+{
+    updateShapeGL();
+    SoBaseKit::getBoundingBox(action);
+}
+
+void TShapeKit::rayPick(SoRayPickAction* action)
+{
+    updateShapeGL();
+    SoBaseKit::rayPick(action);
 }
 
 void TShapeKit::setDefaultOnNonWritingFields()
@@ -138,10 +177,3 @@ SbBool TShapeKit::readInstance(SoInput* in, unsigned short flags)
 //    shapeRT.enableNotify(TRUE);
     return ans;
 }
-
-//#include <Inventor/actions/SoRayPickAction.h>
-//void TShapeKit::rayPick(SoRayPickAction* action)
-//{
-//    action->p
-//    m_shapeKit->rayPick(action);
-//}
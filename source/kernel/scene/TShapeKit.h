@@ -5,6 +5,9 @@
 #include <Inventor/nodekits/SoShapeKit.h>
 
 class SoFieldSensor;
+class SoGetBoundingBoxAction;
+class SoGLRenderAction;
+class SoRayPickAction;
 class SoSensor;
 
 
@@ -26,6 +29,16 @@ public:
 
     SoShapeKit* m_shapeKit;
 
+    // with deferred GL, as in headless runs, shapes build only their ray tracing
+    // data on changes and their GL geometry once it is rendered, picked or bounded
+    static void setDeferredGL(bool on) {s_deferredGL = on;}
+    static bool isDeferredGL() {return s_deferredGL;}
+    void updateShapeGL();
+
+    void GLRender(SoGLRenderAction* action);
+    void getBoundingBox(SoGetBoundingBoxAction* action);
+    void rayPick(SoRayPickAction* action);
+
 protected:
      ~TShapeKit();
 public:
@@ -42,7 +55,7 @@ public:
 
     virtual SbBool readInstance(SoInput * in, unsigned short flags);
 
-    // SoNode interface
-//public:
-//    void rayPick(SoRayPickAction* action);
+private:
+    static bool s_deferredGL;
+    bool m_dirtyGL = true;
 };
@@ -0,0 +1,239 @@
+#include "BVH.h"
+
+#include <algorithm>
+
+namespace
+{
+const int BinsSAH = 12;
+
+double surfaceArea(const Box3D& box)
+{
+    vec3d d = box.size();
+    if (d.x < 0. || d.y < 0. || d.z < 0.) return 0.;
+    return 2.*(d.x*d.y + d.y*d.z + d.z*d.x);
+}
+}
+
+
+BVHNode4F::BVHNode4F(const BVHNode4& node):
+    boxes(node.boxes)
+{
+    std::copy(node.child, node.child + Box3DPack::Width, child);
+    std::copy(node.count, node.count + Box3DPack::Width, count);
+}
+
+BVHBuilder::BVHBuilder(int leafSize):
+    m_leafSize(std::max(1, leafSize))
+{
+
+}
+
+void BVHBuilder::build(const std::vector<Box3D>& boxes)
+{
+    m_order.clear();
+    m_nodes.clear();
+    m_nodes4.clear();
+    if (boxes.empty()) return;
+
+    m_boxes = &boxes;
+    m_centers.resize(boxes.size());
+    m_order.resize(boxes.size());
+    for (int n = 0; n < int(boxes.size()); ++n) {
+        m_centers[n] = boxes[n].center();
+        m_order[n] = n;
+    }
+
+    m_nodes.reserve(2*boxes.size());
+    build(0, int(boxes.size()), 0);
+
+    m_nodes4.reserve(m_nodes.size()/2 + 1);
+    collapse(0);
+
+    m_boxes = nullptr;
+    m_centers = std::vector<vec3d>();
+    m_nodes = std::vector<Node>();
+}
+
+/*!
+ * Builds the subtree over order slots [\a begin, \a end) and returns its node index.
+ */
+int BVHBuilder::build(int begin, int end, int depth)
+{
+    const std::vector<Box3D>& boxes = *m_boxes;
+    int nodeIndex = int(m_nodes.size());
+    m_nodes.push_back(Node());
+
+    Box3D box;
+    Box3D boxCenters;
+    for (int n = begin; n < end; ++n) {
+        box << boxes[m_order[n]];
+        boxCenters << m_centers[m_order[n]];
+    }
+    m_nodes[nodeIndex].box = box;
+
+    int count = end - begin;
+    if (count <= m_leafSize || depth >= DepthMax) {
+        m_nodes[nodeIndex].offset = begin;
+        m_nodes[nodeIndex].count = count;
+        return nodeIndex;
+    }
+
+    vec3d extent = boxCenters.size();
+    int axis = extent.maxDimension();
+    double cMin = boxCenters.min()[axis];
+    double cExtent = extent[axis];
+
+    int split = begin + count/2;
+    if (cExtent > 0.)
+    {
+        Box3D binBoxes[BinsSAH];
+        int binCounts[BinsSAH] = {0};
+        auto binIndex = [&](int p) {
+            int b = int(BinsSAH*(m_centers[p][axis] - cMin)/cExtent);
+            return std::min(b, BinsSAH - 1);
+        };
+        for (int n = begin; n < end; ++n) {
+            int b = binIndex(m_order[n]);
+            binCounts[b]++;
+            binBoxes[b] << boxes[m_order[n]];
+        }
+
+        // sweep from the right to get suffix areas
+        double areaRight[BinsSAH];
+        int countRight[BinsSAH];
+        Box3D boxAcc;
+        int countAcc = 0;
+        for (int b = BinsSAH - 1; b > 0; --b) {
+            boxAcc << binBoxes[b];
+            countAcc += binCounts[b];
+            areaRight[b] = surfaceArea(boxAcc);
+            countRight[b] = countAcc;
+        }
+
+        double costBest = count*surfaceArea(box);
+        int binBest = -1;
+        boxAcc = Box3D();
+        countAcc = 0;
+        for (int b = 1; b < BinsSAH; ++b) {
+            boxAcc << binBoxes[b - 1];
+            countAcc += binCounts[b - 1];
+            if (countAcc == 0 || countRight[b] == 0) continue;
+            double cost = countAcc*surfaceArea(boxAcc) + countRight[b]*areaRight[b];
+            if (cost < costBest) {
+                costBest = cost;
+                binBest = b;
+            }
+        }
+
+        if (binBest > 0) {
+            auto it = std::partition(
+                m_order.begin() + begin, m_order.begin() + end,
+                [&](int p) {return binIndex(p) < binBest;}
+            );
+            split = int(it - m_order.begin());
+        } else if (count <= 4*m_leafSize) {
+            m_nodes[nodeIndex].offset = begin;
+            m_nodes[nodeIndex].count = count;
+            return nodeIndex;
+        }
+    }
+
+    if (split == begin || split == end) {
+        split = begin + count/2;
+        std::nth_element(
+            m_order.begin() + begin, m_order.begin() + split, m_order.begin() + end,
+            [this, axis](int a, int b) {return m_centers[a][axis] < m_centers[b][axis];}
+        );
+    }
+
+    build(begin, split, depth + 1);
+    int right = build(split, end, depth + 1);
+    m_nodes[nodeIndex].offset = right;
+    return nodeIndex;
+}
+
+/*!
+ * Collapses the binary subtree at \a nodeIndex into a wide node by opening
+ * the child with the largest surface area until four lanes are filled.
+ * Returns the index of the wide node.
+ */
+int BVHBuilder::collapse(int nodeIndex)
+{
+    int children[Box3DPack::Width];
+    int nChildren = 0;
+    const Node& node = m_nodes[nodeIndex];
+    if (node.count > 0) {
+        children[nChildren++] = nodeIndex;
+    } else {
+        children[nChildren++] = nodeIndex + 1;
+        children[nChildren++] = node.offset;
+    }
+
+    while (nChildren < Box3DPack::Width)
+    {
+        int best = -1;
+        double areaBest = -1.;
+        for (int n = 0; n < nChildren; ++n) {
+            const Node& c = m_nodes[children[n]];
+            if (c.count > 0) continue;
+            double area = surfaceArea(c.box);
+            if (area > areaBest) {
+                areaBest = area;
+                best = n;
+            }
+        }
+        if (best < 0) break;
+        int opened = children[best];
+        children[best] = opened + 1;
+        children[nChildren++] = m_nodes[opened].offset;
+    }
+
+    int index4 = int(m_nodes4.size());
+    m_nodes4.push_back(BVHNode4());
+    for (int n = 0; n < nChildren; ++n)
+    {
+        const Node& c = m_nodes[children[n]];
+        int child = c.count > 0 ? c.offset : collapse(children[n]);
+        BVHNode4& node4 = m_nodes4[index4];
+        node4.boxes.set(n, c.box);
+        node4.child[n] = child;
+        node4.count[n] = c.count;
+    }
+    return index4;
+}
+
+BVHStatistics BVHStatistics::find(std::span<const BVHNode4> nodes, double primitiveCost)
+{
+    BVHStatistics ans;
+    ans.nodes = int(nodes.size());
+    ans.bytes = nodes.size()*sizeof(BVHNode4);
+    if (nodes.empty()) return ans;
+
+    Box3D root;
+    for (int n = 0; n < Box3DPack::Width; ++n)
+        if (nodes[0].child[n] >= 0)
+            root.expand(nodes[0].boxes.box(n));
+    const double rootArea = surfaceArea(root);
+    ans.sahCost = 1.;
+
+    std::vector<std::pair<int, int>> stack = {{0, 1}}; // node, depth
+    while (!stack.empty()) {
+        const std::pair<int, int> entry = stack.back();
+        stack.pop_back();
+        ans.depth = std::max(ans.depth, entry.second);
+        const BVHNode4& node = nodes[entry.first];
+        for (int n = 0; n < Box3DPack::Width; ++n) {
+            if (node.child[n] < 0) continue;
+            const double p = rootArea > 0. ? surfaceArea(node.boxes.box(n))/rootArea : 1.;
+            if (node.count[n] > 0) {
+                ans.leaves++;
+                ans.primitives += qulonglong(node.count[n]);
+                ans.sahCost += p*primitiveCost*node.count[n];
+            } else {
+                ans.sahCost += p;
+                stack.push_back({node.child[n], entry.second + 1});
+            }
+        }
+    }
+    return ans;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <initializer_list>
+#include <span>
+#include <vector>
+
+#include "libraries/math/3D/Box3D.h"
+#include "libraries/math/3D/Box3DPack.h"
+#include "libraries/math/3D/Box3DPackF.h"
+#include "libraries/math/3D/Ray.h"
+#include "kernel/run/TraceStatistics.h"
+
+
+//! BVHNode4 is a node of a linear 4-wide bounding volume hierarchy.
+/*!
+ * The boxes of the four children are packed for a single SIMD slab test.
+ * A lane with a nonzero \a count is a leaf holding primitives
+ * [\a child, \a child + \a count); otherwise \a child is the index
+ * of a node, or -1 for an empty lane. The root is node 0.
+ */
+struct TONATIUH_KERNEL BVHNode4
+{
+    Box3DPack boxes;
+    int child[Box3DPack::Width] = {-1, -1, -1, -1};
+    int count[Box3DPack::Width] = {0, 0, 0, 0};
+};
+
+//! BVHNode4F is a BVHNode4 with single-precision boxes, for float traversal.
+/*!
+ * The boxes are rounded outward, so traversal visits every leaf the double
+ * node would, and a few more whose boxes the ray passes within float rounding.
+ */
+struct TONATIUH_KERNEL BVHNode4F
+{
+    BVHNode4F() = default;
+    explicit BVHNode4F(const BVHNode4& node);
+
+    Box3DPackF boxes;
+    int child[Box3DPack::Width] = {-1, -1, -1, -1};
+    int count[Box3DPack::Width] = {0, 0, 0, 0};
+};
+
+
+//! BVHBuilder builds the hierarchy shared by the scene and the mesh shapes.
+/*!
+ * A binary tree is built over the primitive boxes with a binned surface area
+ * heuristic (median split as fallback) into a depth-first node array, then
+ * collapsed into 4-wide nodes. Primitives are not moved: getOrder() tells
+ * which primitive belongs to each leaf slot, and the caller reorders its
+ * own storage accordingly.
+ */
+class TONATIUH_KERNEL BVHBuilder
+{
+public:
+    static const int DepthMax = 60;
+    static const int StackSize = (Box3DPack::Width - 1)*DepthMax + 4;
+
+    explicit BVHBuilder(int leafSize = 4);
+
+    void build(const std::vector<Box3D>& boxes);
+
+    const std::vector<int>& getOrder() const {return m_order;}
+    const std::vector<BVHNode4>& getNodes() const {return m_nodes4;}
+
+    template<class T>
+    void reorder(std::vector<T>& primitives) const;
+
+private:
+    struct Node {
+        Box3D box;
+        int offset = 0; // second child or first primitive
+        int count = 0;
+    };
+
+    int build(int begin, int end, int depth);
+    int collapse(int nodeIndex);
+
+    int m_leafSize;
+    const std::vector<Box3D>* m_boxes = nullptr;
+    std::vector<vec3d> m_centers;
+    std::vector<int> m_order;
+    std::vector<Node> m_nodes;
+    std::vector<BVHNode4> m_nodes4;
+};
+
+//! BVHStatistics describes the size and expected traversal cost of a hierarchy.
+/*!
+ * The surface area heuristic cost is the expected work of a ray passing
+ * through the root box: a lane is entered with the probability of its area
+ * over that of the root, and then costs one node test, or primitiveCost per
+ * primitive of a leaf. The root node itself counts one test.
+ */
+struct TONATIUH_KERNEL BVHStatistics
+{
+    int nodes = 0;
+    int leaves = 0; // lanes holding primitives
+    qulonglong primitives = 0;
+    int depth = 0; // nodes on the longest path from the root, 0 when empty
+    double sahCost = 0.;
+    qulonglong bytes = 0; // of the nodes
+
+    static BVHStatistics find(std::span<const BVHNode4> nodes, double primitiveCost = 1.);
+    static BVHStatistics find(std::initializer_list<BVHNode4> nodes, double primitiveCost = 1.) {return find(std::span<const BVHNode4>(nodes.begin(), nodes.size()), primitiveCost);}
+};
+
+
+template<class T>
+void BVHBuilder::reorder(std::vector<T>& primitives) const
+{
+    std::vector<T> sorted;
+    sorted.reserve(m_order.size());
+    for (int n : m_order)
+        sorted.push_back(primitives[n]);
+    primitives.swap(sorted);
+}
+
+
+// the traversal of both node types, boxes(node, tNear) returns the lanes hit
+template<class Node, class BoxTest, class LeafTest>
+bool traverseBVHNodes(std::span<const Node> nodes, const Ray& ray, BoxTest boxes, LeafTest leaf)
+{
+    if (nodes.empty()) return false;
+
+    struct Entry {
+        int child;
+        int count;
+        double t;
+    };
+    Entry stack[BVHBuilder::StackSize];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, ray.tMin};
+
+    while (stackSize > 0)
+    {
+        const Entry entry = stack[--stackSize];
+        if (entry.t > ray.tMax) continue;
+
+        if (entry.count > 0) {
+            if (leaf(entry.child, entry.count)) return true;
+            continue;
+        }
+
+        const Node& node = nodes[entry.child];
+        double tNear[Box3DPack::Width];
+        TRACE_STATS(boxTests++);
+        int mask = boxes(node, tNear);
+        if (mask == 0) continue;
+
+        // push the hit lanes far to near so the nearest is popped first
+        Entry lanes[Box3DPack::Width];
+        int nLanes = 0;
+        for (int n = 0; n < Box3DPack::Width; ++n) {
+            if (!(mask & (1 << n))) continue;
+            Entry e = {node.child[n], node.count[n], tNear[n]};
+            int k = nLanes++;
+            while (k > 0 && lanes[k - 1].t < e.t) {
+                lanes[k] = lanes[k - 1];
+                --k;
+            }
+            lanes[k] = e;
+        }
+        for (int k = 0; k < nLanes; ++k)
+            stack[stackSize++] = lanes[k];
+    }
+    return false;
+}
+
+/*!
+ * Visits the leaves of \a nodes hit by \a ray, nearest box first, until
+ * \a leaf(begin, count) returns true, and tells whether it did.
+ * For any-hit queries such as occlusion, which need no closest hit.
+ */
+template<class LeafTest>
+bool traverseBVHUntil(std::span<const BVHNode4> nodes, const Ray& ray, LeafTest leaf)
+{
+    auto boxes = [&ray](const BVHNode4& node, double* tNear) {
+        return node.boxes.intersect(ray, tNear);
+    };
+    return traverseBVHNodes(nodes, ray, boxes, leaf);
+}
+
+// with the ray rounded once for the float boxes
+template<class LeafTest>
+bool traverseBVHUntil(std::span<const BVHNode4F> nodes, const Ray& ray, LeafTest leaf)
+{
+    const Box3DPackF::Query query(ray);
+    auto boxes = [&ray, &query](const BVHNode4F& node, double* tNear) {
+        return node.boxes.intersect(query, ray.tMax, tNear);
+    };
+    return traverseBVHNodes(nodes, ray, boxes, leaf);
+}
+
+/*!
+ * Visits the leaves of \a nodes hit by \a ray, nearest box first.
+ * \a leaf(begin, count) tests the primitives of a leaf; it lowers ray.tMax
+ * when it finds a closer hit, which culls the remaining boxes.
+ */
+template<class Nodes, class LeafTest>
+void traverseBVH(const Nodes& nodes, const Ray& ray, LeafTest leaf)
+{
+    traverseBVHUntil(nodes, ray, [&](int begin, int count) {
+        leaf(begin, count);
+        return false;
+    });
+}
@@ -0,0 +1,70 @@
+#include "FacetArray.h"
+
+
+void FacetArray::clear()
+{
+    m_facets.clear();
+    m_index.clear();
+    m_nodes.clear();
+    m_box = Box3D();
+}
+
+void FacetArray::addFacet(const vec3d& center, const vec3d& axisX, const vec3d& axisZ)
+{
+    Facet facet;
+    facet.center = center;
+    facet.axes[2] = axisZ.normalized();
+    vec3d x = axisX - facet.axes[2]*dot(axisX, facet.axes[2]);
+    if (x.norm() < 1e-9) // x along z, any x will do
+        x = cross(std::abs(facet.axes[2].x) < 0.9 ? vec3d(1., 0., 0.) : vec3d(0., 1., 0.), facet.axes[2]);
+    facet.axes[0] = x.normalized();
+    facet.axes[1] = cross(facet.axes[2], facet.axes[0]);
+    m_facets.push_back(facet);
+}
+
+void FacetArray::build(const Box3D& facetBox)
+{
+    m_nodes.clear();
+    m_index.clear();
+    m_box = Box3D();
+    if (m_facets.empty() || !facetBox.isValid()) return;
+
+    const vec3d& p = facetBox.min();
+    const vec3d& q = facetBox.max();
+    std::vector<Box3D> boxes;
+    boxes.reserve(m_facets.size());
+    for (const Facet& facet : m_facets) {
+        Box3D box;
+        for (int n = 0; n < 8; ++n)
+            box << facet.toArrayPoint(vec3d(n & 4 ? q.x : p.x, n & 2 ? q.y : p.y, n & 1 ? q.z : p.z));
+        boxes.push_back(box);
+        m_box << box;
+    }
+
+    // a few dozen facets, leaves of one so every facet has its own box
+    BVHBuilder builder(1);
+    builder.build(boxes);
+    builder.reorder(m_facets);
+    m_index = builder.getOrder();
+    m_nodes = builder.getNodes();
+}
+
+qulonglong FacetArray::getMemoryUsage() const
+{
+    return m_facets.capacity()*sizeof(Facet) + m_index.capacity()*sizeof(int) + m_nodes.capacity()*sizeof(BVHNode4);
+}
+
+Ray FacetArray::toFacet(int n, const Ray& ray) const
+{
+    const Facet& facet = m_facets[n];
+    return Ray(facet.toFacetPoint(ray.origin), facet.toFacetVector(ray.direction()), ray.tMin, ray.tMax);
+}
+
+void FacetArray::toArray(int n, DifferentialGeometry& dg) const
+{
+    const Facet& facet = m_facets[n];
+    dg.point = facet.toArrayPoint(dg.point);
+    dg.dpdu = facet.toArrayVector(dg.dpdu);
+    dg.dpdv = facet.toArrayVector(dg.dpdv);
+    dg.normal = facet.toArrayVector(dg.normal);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include "kernel/shape/BVH.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "libraries/math/3D/Box3D.h"
+#include "libraries/math/3D/Ray.h"
+
+
+//! FacetArray places copies of one facet in the frame of a compound shape.
+/*!
+ * Facet n has its center and its axes, the columns of its canting rotation,
+ * in the frame of the array; the facet itself is traced in its own frame by
+ * the caller. The boxes of the facets, Box3D of the facet carried into the
+ * array, are held in a small BVHBuilder hierarchy, so a ray tests only the
+ * facets whose boxes it passes, nearest first.
+ * Fill the array with addFacet() and call build() before intersecting.
+ */
+class TONATIUH_KERNEL FacetArray
+{
+public:
+    struct Facet {
+        vec3d center;
+        vec3d axes[3]; // orthonormal
+
+        vec3d toFacetPoint(const vec3d& p) const {return toFacetVector(p - center);}
+        vec3d toFacetVector(const vec3d& v) const {return vec3d(dot(v, axes[0]), dot(v, axes[1]), dot(v, axes[2]));}
+        vec3d toArrayPoint(const vec3d& p) const {return center + toArrayVector(p);}
+        vec3d toArrayVector(const vec3d& v) const {return axes[0]*v.x + axes[1]*v.y + axes[2]*v.z;}
+    };
+
+    void clear();
+    void reserve(int n) {m_facets.reserve(n);}
+    // the axes are made orthonormal, z kept and x turned about it
+    void addFacet(const vec3d& center, const vec3d& axisX, const vec3d& axisZ);
+    // facetBox bounds the facet in its frame
+    void build(const Box3D& facetBox);
+
+    bool isEmpty() const {return m_nodes.empty();}
+    int size() const {return int(m_facets.size());}
+    // in leaf order, not in the order added; getIndex() tells which was added as n
+    const Facet& getFacet(int n) const {return m_facets[n];}
+    int getIndex(int n) const {return m_index[n];}
+    const Box3D& getBox() const {return m_box;}
+    qulonglong getMemoryUsage() const;
+
+    // the ray in the frame of facet n, with the same parameter
+    Ray toFacet(int n, const Ray& ray) const;
+    // dg of facet n in the frame of the array
+    void toArray(int n, DifferentialGeometry& dg) const;
+
+    // closest hit with t < ray.tMax; test(n, rayFacet, &t, &dg) intersects
+    // facet n in its frame, dg then in the frame of the array
+    template<class FacetTest>
+    bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, FacetTest test) const;
+    // any hit with t < ray.tMax, test(n, rayFacet) as above without dg
+    template<class FacetTest>
+    bool intersectP(const Ray& ray, FacetTest test) const;
+
+private:
+    std::vector<Facet> m_facets;
+    std::vector<int> m_index;
+    std::vector<BVHNode4> m_nodes;
+    Box3D m_box;
+};
+
+
+template<class FacetTest>
+bool FacetArray::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, FacetTest test) const
+{
+    if (isEmpty()) return false;
+    Ray rayT = ray;
+    int best = -1;
+    DifferentialGeometry dgT;
+    traverseBVH(m_nodes, rayT, [&](int begin, int count) {
+        for (int n = begin; n < begin + count; ++n) {
+            double t;
+            DifferentialGeometry dgN;
+            if (!test(n, toFacet(n, rayT), &t, &dgN)) continue;
+            if (t > rayT.tMax) continue;
+            rayT.tMax = t;
+            dgT = dgN;
+            best = n;
+        }
+    });
+    if (best < 0) return false;
+
+    *tHit = rayT.tMax;
+    *dg = dgT;
+    toArray(best, *dg);
+    return true;
+}
+
+template<class FacetTest>
+bool FacetArray::intersectP(const Ray& ray, FacetTest test) const
+{
+    if (isEmpty()) return false;
+    return traverseBVHUntil(m_nodes, ray, [&](int begin, int count) {
+        for (int n = begin; n < begin + count; ++n)
+            if (test(n, toFacet(n, ray))) return true;
+        return false;
+    });
+}
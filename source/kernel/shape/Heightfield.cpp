@@ -0,0 +1,295 @@
+#include "Heightfield.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "kernel/shape/DifferentialGeometry.h"
+#include "libraries/math/3D/Ray.h"
+
+struct Heightfield::Hit
+{
+    int vertices[3] = {-1, -1, -1};
+    double u = 0.;
+    double v = 0.;
+    bool any = false; // stop at the first hit
+};
+
+
+void Heightfield::clear()
+{
+    m_nx = 0;
+    m_ny = 0;
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_normals.clear();
+    m_levels.clear();
+    m_pad = 0.;
+    m_box = Box3D();
+}
+
+qulonglong Heightfield::getMemoryUsage() const
+{
+    auto bytes = [](const auto& v) {return qulonglong(v.capacity()*sizeof(v[0]));};
+    qulonglong ans = bytes(m_x) + bytes(m_y) + bytes(m_z) + bytes(m_normals) + bytes(m_levels);
+    for (const Level& level : m_levels)
+        ans += bytes(level.zMin) + bytes(level.zMax);
+    return ans;
+}
+
+bool Heightfield::build(int nx, int ny, const float* points, const float* normals)
+{
+    clear();
+    if (nx < 2 || ny < 2) return false;
+
+    // x depends on i only, y on j only
+    std::vector<double> xs(nx), ys(ny);
+    for (int i = 0; i < nx; ++i) xs[i] = points[3*i*ny];
+    for (int j = 0; j < ny; ++j) ys[j] = points[3*j + 1];
+    for (int i = 1; i < nx; ++i)
+        if (!(xs[i - 1] < xs[i])) return false;
+    for (int j = 1; j < ny; ++j)
+        if (!(ys[j - 1] < ys[j])) return false;
+    for (int i = 0; i < nx; ++i)
+        for (int j = 0; j < ny; ++j) {
+            const float* p = &points[3*(i*ny + j)];
+            if (p[0] != xs[i] || p[1] != ys[j]) return false;
+        }
+
+    m_nx = nx;
+    m_ny = ny;
+    m_x = xs;
+    m_y = ys;
+    m_z.resize(nx*ny);
+    for (int n = 0; n < nx*ny; ++n) {
+        m_z[n] = points[3*n + 2];
+        m_box << vec3d(m_x[n/ny], m_y[n%ny], m_z[n]);
+    }
+    m_normals.assign(normals, normals + 3*nx*ny);
+
+    // the cells, then blocks of 2x2 until one is left
+    Level level;
+    level.nx = nx - 1;
+    level.ny = ny - 1;
+    level.zMin.resize(level.nx*level.ny);
+    level.zMax.resize(level.nx*level.ny);
+    for (int i = 0; i < level.nx; ++i)
+        for (int j = 0; j < level.ny; ++j) {
+            const double zs[] = {
+                m_z[i*ny + j], m_z[(i + 1)*ny + j],
+                m_z[(i + 1)*ny + j + 1], m_z[i*ny + j + 1]
+            };
+            level.zMin[i*level.ny + j] = *std::min_element(zs, zs + 4);
+            level.zMax[i*level.ny + j] = *std::max_element(zs, zs + 4);
+        }
+    m_levels.push_back(level);
+
+    while (level.nx > 1 || level.ny > 1)
+    {
+        const Level& below = m_levels.back();
+        Level above;
+        above.nx = (below.nx + 1)/2;
+        above.ny = (below.ny + 1)/2;
+        above.zMin.assign(above.nx*above.ny, gcf::infinity);
+        above.zMax.assign(above.nx*above.ny, -gcf::infinity);
+        for (int i = 0; i < below.nx; ++i)
+            for (int j = 0; j < below.ny; ++j) {
+                int b = i*below.ny + j;
+                int a = (i/2)*above.ny + j/2;
+                above.zMin[a] = std::min(above.zMin[a], below.zMin[b]);
+                above.zMax[a] = std::max(above.zMax[a], below.zMax[b]);
+            }
+        m_levels.push_back(above);
+        level = above;
+    }
+
+    // block boxes are widened so rounding never drops a hit on their faces
+    vec3d size = m_box.size();
+    m_pad = 1e-9*std::max({size.x, size.y, size.z, 1.});
+    return true;
+}
+
+void Heightfield::getVertex(int i, int j, float* point, float* normal) const
+{
+    int n = i*m_ny + j;
+    point[0] = float(m_x[i]);
+    point[1] = float(m_y[j]);
+    point[2] = float(m_z[n]);
+    std::copy(&m_normals[3*n], &m_normals[3*n] + 3, normal);
+}
+
+// slab test of the block against [ray.tMin, ray.tMax], as Box3D::intersect
+bool Heightfield::enterBlock(int level, int i, int j, const Ray& ray, double* t0) const
+{
+    const Level& block = m_levels[level];
+    int i0 = i << level;
+    int j0 = j << level;
+    int i1 = std::min((i + 1) << level, m_nx - 1);
+    int j1 = std::min((j + 1) << level, m_ny - 1);
+    int n = i*block.ny + j;
+    const double a[] = {m_x[i0] - m_pad, m_y[j0] - m_pad, block.zMin[n] - m_pad};
+    const double b[] = {m_x[i1] + m_pad, m_y[j1] + m_pad, block.zMax[n] + m_pad};
+
+    const vec3d& rayI = ray.invDirection();
+    double tMin = ray.tMin;
+    double tMax = ray.tMax;
+    for (int k = 0; k < 3; ++k) {
+        double tA = (a[k] - ray.origin[k])*rayI[k];
+        double tB = (b[k] - ray.origin[k])*rayI[k];
+        if (rayI[k] < 0.) std::swap(tA, tB);
+        if (tA > tMin) tMin = tA;
+        if (tB < tMax) tMax = tB;
+        if (tMin > tMax) return false;
+    }
+    *t0 = tMin;
+    return true;
+}
+
+bool Heightfield::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg) const
+{
+    if (m_levels.empty()) return false;
+
+    Ray rayT = ray;
+    Hit hit;
+    int top = int(m_levels.size()) - 1;
+    double t0;
+    if (enterBlock(top, 0, 0, rayT, &t0))
+        traverse(top, 0, 0, rayT, hit);
+    if (hit.vertices[0] < 0) return false;
+
+    // normal
+    const float* nA = &m_normals[3*hit.vertices[0]];
+    const float* nB = &m_normals[3*hit.vertices[1]];
+    const float* nC = &m_normals[3*hit.vertices[2]];
+    double w = 1. - hit.u - hit.v;
+    vec3d vN(
+        hit.u*nA[0] + hit.v*nB[0] + w*nC[0],
+        hit.u*nA[1] + hit.v*nB[1] + w*nC[1],
+        hit.u*nA[2] + hit.v*nB[2] + w*nC[2]
+    );
+    vN.normalize();
+    vec3d vU = vN.findOrthogonal().normalize();
+    vec3d vV = cross(vN, vU);
+
+    *tHit = rayT.tMax;
+    dg->point = ray.point(rayT.tMax);
+    dg->uv = vec2d(hit.u, hit.v);
+    dg->dpdu = vU;
+    dg->dpdv = vV;
+    dg->normal = vN;
+    dg->shape = 0;
+    dg->isFront = dot(vN, ray.direction()) <= 0.;
+    return true;
+}
+
+bool Heightfield::intersectP(const Ray& ray) const
+{
+    if (m_levels.empty()) return false;
+
+    Ray rayT = ray;
+    Hit hit;
+    hit.any = true;
+    int top = int(m_levels.size()) - 1;
+    double t0;
+    if (enterBlock(top, 0, 0, rayT, &t0))
+        traverse(top, 0, 0, rayT, hit);
+    return hit.vertices[0] >= 0;
+}
+
+// the block is known to be reached, its children are visited by entry distance
+void Heightfield::traverse(int level, int i, int j, Ray& ray, Hit& hit) const
+{
+    if (level == 0) {
+        intersectCell(i, j, ray, hit);
+        return;
+    }
+
+    const Level& below = m_levels[level - 1];
+    struct Child {double t; int i; int j;} children[4];
+    int count = 0;
+    for (int ci = 2*i; ci < std::min(2*i + 2, below.nx); ++ci)
+        for (int cj = 2*j; cj < std::min(2*j + 2, below.ny); ++cj) {
+            double t0;
+            if (!enterBlock(level - 1, ci, cj, ray, &t0)) continue;
+            int k = count++;
+            for (; k > 0 && children[k - 1].t > t0; --k)
+                children[k] = children[k - 1];
+            children[k] = {t0, ci, cj};
+        }
+
+    for (int k = 0; k < count; ++k) {
+        if (children[k].t > ray.tMax) break;
+        traverse(level - 1, children[k].i, children[k].j, ray, hit);
+        if (hit.any && hit.vertices[0] >= 0) return;
+    }
+}
+
+// same arithmetic as TriangleMesh::intersect for the two triangles of the cell
+void Heightfield::intersectCell(int i, int j, Ray& ray, Hit& hit) const
+{
+    const int iA = i*m_ny + j;
+    const int iB = iA + m_ny;
+    const int iC = iB + 1;
+    const int iD = iA + 1;
+    const int triangles[2][3] = {{iA, iB, iC}, {iA, iC, iD}};
+
+    const vec3d& d = ray.direction();
+    for (const int* vs : triangles)
+    {
+        vec3d pA(m_x[vs[0]/m_ny], m_y[vs[0]%m_ny], m_z[vs[0]]);
+        vec3d pB(m_x[vs[1]/m_ny], m_y[vs[1]%m_ny], m_z[vs[1]]);
+        vec3d pC(m_x[vs[2]/m_ny], m_y[vs[2]%m_ny], m_z[vs[2]]);
+        vec3d eu = pA - pC;
+        vec3d ev = pB - pC;
+        double tolerance = eu.norm()*ev.norm()*1e-6;
+
+        vec3d qv = cross(d, ev);
+        double det = dot(eu, qv);
+        if (!(tolerance <= std::abs(det))) continue;
+        double detInv = 1./det;
+
+        vec3d qt = ray.origin - pC;
+        double u = dot(qv, qt)*detInv;
+        if (!(0. <= u && u <= 1.)) continue;
+
+        vec3d qu = cross(qt, eu);
+        double v = dot(qu, d)*detInv;
+        if (!(0. <= v && u + v <= 1.)) continue;
+
+        double t = dot(qu, ev)*detInv;
+        if (!(ray.tMin + tolerance <= t && t < ray.tMax)) continue;
+
+        ray.tMax = t;
+        std::copy(vs, vs + 3, hit.vertices);
+        hit.u = u;
+        hit.v = v;
+    }
+}
+
+/*!
+ * The cell is found by bisection of the lines, so a query costs
+ * O(log nx + log ny) and touches three vertices.
+ */
+bool Heightfield::findHeight(double x, double y, double* z) const
+{
+    if (isEmpty()) return false;
+    if (x < m_x.front() || x > m_x.back() || y < m_y.front() || y > m_y.back()) return false;
+
+    int i = int(std::upper_bound(m_x.begin(), m_x.end(), x) - m_x.begin()) - 1;
+    int j = int(std::upper_bound(m_y.begin(), m_y.end(), y) - m_y.begin()) - 1;
+    i = std::clamp(i, 0, m_nx - 2);
+    j = std::clamp(j, 0, m_ny - 2);
+
+    double u = (x - m_x[i])/(m_x[i + 1] - m_x[i]);
+    double v = (y - m_y[j])/(m_y[j + 1] - m_y[j]);
+    double z00 = m_z[i*m_ny + j];
+    double z10 = m_z[(i + 1)*m_ny + j];
+    double z11 = m_z[(i + 1)*m_ny + j + 1];
+    double z01 = m_z[i*m_ny + j + 1];
+    // the triangles split the cell along (i, j) (i+1, j+1)
+    if (u >= v)
+        *z = z00 + u*(z10 - z00) + v*(z11 - z10);
+    else
+        *z = z00 + v*(z01 - z00) + u*(z11 - z01);
+    return true;
+}
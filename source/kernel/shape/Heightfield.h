@@ -0,0 +1,69 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include "libraries/math/3D/Box3D.h"
+
+class Ray;
+struct DifferentialGeometry;
+
+
+//! Heightfield is the ray tracing surface of a shape sampled on a regular grid.
+/*!
+ * Vertex (i, j) sits at (x_i, y_j, z_ij) and each cell is split into the
+ * triangles (i, j) (i+1, j) (i+1, j+1) and (i, j) (i+1, j+1) (i, j+1),
+ * the triangulation the grid profiles give to TriangleMesh.
+ * Levels of z ranges over blocks of 2^k x 2^k cells are walked front to back,
+ * so blocks the ray passes above or below are skipped without touching their cells.
+ * Memory is linear in the vertices with no per-triangle objects.
+ */
+class TONATIUH_KERNEL Heightfield
+{
+public:
+    void clear();
+    // points and normals hold 3 floats per vertex with index i*ny + j,
+    // fails when the points are not a grid with increasing lines
+    bool build(int nx, int ny, const float* points, const float* normals);
+
+    bool isEmpty() const {return m_levels.empty();}
+    qulonglong getTriangleCount() const {return isEmpty() ? 0 : 2ull*(m_nx - 1)*(m_ny - 1);}
+    qulonglong getMemoryUsage() const;
+    const Box3D& getBox() const {return m_box;}
+    int getCountX() const {return m_nx;}
+    int getCountY() const {return m_ny;}
+    // point and normal of vertex (i, j), 3 floats each
+    void getVertex(int i, int j, float* point, float* normal) const;
+
+    // closest hit with t < ray.tMax
+    bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg) const;
+    // any hit with t < ray.tMax, for occlusion
+    bool intersectP(const Ray& ray) const;
+    // z of the triangles above (x, y), false outside the grid
+    bool findHeight(double x, double y, double* z) const;
+
+private:
+    struct Level {
+        int nx; // blocks along x
+        int ny;
+        std::vector<double> zMin; // index i*ny + j
+        std::vector<double> zMax;
+    };
+    struct Hit;
+
+    bool enterBlock(int level, int i, int j, const Ray& ray, double* t0) const;
+    void traverse(int level, int i, int j, Ray& ray, Hit& hit) const;
+    void intersectCell(int i, int j, Ray& ray, Hit& hit) const;
+
+    int m_nx = 0; // vertices along x
+    int m_ny = 0;
+    std::vector<double> m_x;
+    std::vector<double> m_y;
+    std::vector<double> m_z;
+    std::vector<float> m_normals;
+
+    std::vector<Level> m_levels; // cells first
+    double m_pad = 0.;
+    Box3D m_box;
+};
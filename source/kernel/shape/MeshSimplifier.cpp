@@ -0,0 +1,166 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+
+struct TriangleHash
+{
+    size_t operator()(const std::array<int, 3>& t) const
+    {
+        size_t h = size_t(t[0]);
+        h = h*1000003u ^ size_t(t[1]);
+        h = h*1000003u ^ size_t(t[2]);
+        return h;
+    }
+};
+
+// calls f(a, b, c) for the corners of the fans of every polygon
+template<class F>
+void forTriangles(const MeshSimplifier::Input& input, F f)
+{
+    int first = -1;
+    int previous = -1;
+    for (int n = 0; n < input.faceCount; ++n) {
+        if (input.faces[n] < 0) {
+            first = -1;
+            previous = -1;
+            continue;
+        }
+        if (first < 0)
+            first = n;
+        else if (previous >= 0)
+            f(first, previous, n);
+        if (n != first)
+            previous = n;
+    }
+}
+
+bool findBox(const MeshSimplifier::Input& input, float* min, float* max)
+{
+    if (!input.vertices || input.vertexCount <= 0) return false;
+    for (int k = 0; k < 3; ++k) {
+        min[k] = input.vertices[k];
+        max[k] = input.vertices[k];
+    }
+    for (int n = 1; n < input.vertexCount; ++n)
+        for (int k = 0; k < 3; ++k) {
+            min[k] = std::min(min[k], input.vertices[3*n + k]);
+            max[k] = std::max(max[k], input.vertices[3*n + k]);
+        }
+    return true;
+}
+
+}
+
+
+MeshLevel MeshSimplifier::makeLevel(const Input& input, float cell)
+{
+    MeshLevel ans;
+    ans.error = cell;
+    float min[3], max[3];
+    if (!findBox(input, min, max) || !input.faces || !(cell > 0.f)) return ans;
+
+    // 21 bits per axis
+    const int64_t cellsMax = (int64_t(1) << 21) - 1;
+    std::unordered_map<int64_t, int> cells;
+    std::vector<int> clusters(size_t(input.vertexCount));
+    std::vector<double> positions;
+    std::vector<int> counts;
+    for (int n = 0; n < input.vertexCount; ++n) {
+        int64_t key = 0;
+        for (int k = 0; k < 3; ++k) {
+            int64_t c = int64_t((input.vertices[3*n + k] - min[k])/cell);
+            key = (key << 21) | std::min(std::max(c, int64_t(0)), cellsMax);
+        }
+        auto it = cells.emplace(key, int(counts.size())).first;
+        if (it->second == int(counts.size())) {
+            positions.insert(positions.end(), 3, 0.);
+            counts.push_back(0);
+        }
+        const int c = it->second;
+        clusters[size_t(n)] = c;
+        for (int k = 0; k < 3; ++k)
+            positions[3*size_t(c) + k] += input.vertices[3*n + k];
+        counts[size_t(c)]++;
+    }
+
+    std::vector<double> normals(positions.size(), 0.);
+    std::unordered_set<std::array<int, 3>, TriangleHash> kept;
+    auto addNormal = [&](int corner, const double* face) {
+        const int c = clusters[size_t(input.faces[corner])];
+        if (input.normals) {
+            const int index = input.normalFaces ? input.normalFaces[corner] : input.faces[corner];
+            if (index >= 0) {
+                for (int k = 0; k < 3; ++k)
+                    normals[3*size_t(c) + k] += input.normals[3*index + k];
+                return;
+            }
+        }
+        for (int k = 0; k < 3; ++k)
+            normals[3*size_t(c) + k] += face[k];
+    };
+
+    forTriangles(input, [&](int a, int b, int c) {
+        const float* pa = &input.vertices[3*input.faces[a]];
+        const float* pb = &input.vertices[3*input.faces[b]];
+        const float* pc = &input.vertices[3*input.faces[c]];
+        double u[3], v[3];
+        for (int k = 0; k < 3; ++k) {
+            u[k] = double(pb[k]) - pa[k];
+            v[k] = double(pc[k]) - pa[k];
+        }
+        const double face[3] = {u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0]};
+        addNormal(a, face);
+        addNormal(b, face);
+        addNormal(c, face);
+
+        std::array<int, 3> t = {clusters[size_t(input.faces[a])], clusters[size_t(input.faces[b])], clusters[size_t(input.faces[c])]};
+        if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2]) return;
+        std::array<int, 3> key = t;
+        std::sort(key.begin(), key.end());
+        if (!kept.insert(key).second) return;
+        ans.triangles.insert(ans.triangles.end(), t.begin(), t.end());
+    });
+
+    ans.vertices.resize(positions.size());
+    ans.normals.resize(positions.size());
+    for (size_t c = 0; c < counts.size(); ++c) {
+        double* n = &normals[3*c];
+        double length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        for (int k = 0; k < 3; ++k) {
+            ans.vertices[3*c + k] = float(positions[3*c + k]/counts[c]);
+            ans.normals[3*c + k] = length > 0. ? float(n[k]/length) : (k == 2 ? 1.f : 0.f);
+        }
+    }
+    return ans;
+}
+
+std::vector<MeshLevel> MeshSimplifier::makeLevels(const Input& input, int minTriangles, const std::function<bool()>& isCanceled)
+{
+    std::vector<MeshLevel> ans;
+    float min[3], max[3];
+    if (!findBox(input, min, max) || !input.faces) return ans;
+    const float extent = std::max({max[0] - min[0], max[1] - min[1], max[2] - min[2]});
+    if (!(extent > 0.f)) return ans;
+
+    int triangles = 0;
+    forTriangles(input, [&triangles](int, int, int) {++triangles;});
+
+    // from a thousand cells along the box down to a single one
+    for (float cell = extent/1024; cell <= extent && triangles > minTriangles; cell *= 2) {
+        if (isCanceled && isCanceled()) return std::vector<MeshLevel>();
+        MeshLevel level = makeLevel(input, cell);
+        if (level.getTriangleCount() == 0) break;
+        if (level.getTriangleCount() > triangles/2) continue;
+        triangles = level.getTriangleCount();
+        ans.push_back(std::move(level));
+    }
+    return ans;
+}
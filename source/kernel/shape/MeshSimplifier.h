@@ -0,0 +1,52 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <functional>
+#include <vector>
+
+//! MeshLevel is a display copy of a mesh, triangulated and indexed.
+struct TONATIUH_KERNEL MeshLevel
+{
+    std::vector<float> vertices; // 3 floats per vertex
+    std::vector<float> normals;  // 3 floats per vertex
+    std::vector<int> triangles;  // 3 vertices per triangle
+    float error = 0.f;           // cell size of the clustering, in the units of the vertices
+
+    int getTriangleCount() const {return int(triangles.size()/3);}
+};
+
+//! MeshSimplifier makes coarser display copies of a mesh by vertex clustering.
+/*!
+ * The vertices of a level are merged within the cells of a grid over the
+ * bounding box, each cell keeping the mean of its vertices and of their
+ * normals; triangles collapsed by the merge and repeated ones are dropped.
+ * No vertex moves by more than a cell, which is the error of the level.
+ *
+ * Faces are given as coordIndex of SoIndexedFaceSet: polygons ended by -1,
+ * split into fans. Normals are read per corner with a normal index in the
+ * same layout, or per vertex without one.
+ *
+ * The levels are for the view only; the ray tracer keeps the full mesh.
+ */
+class TONATIUH_KERNEL MeshSimplifier
+{
+public:
+    struct Input
+    {
+        const float* vertices = nullptr;
+        int vertexCount = 0;
+        const int* faces = nullptr;
+        int faceCount = 0; // of indices, -1 included
+        const float* normals = nullptr; // per vertex or indexed
+        const int* normalFaces = nullptr; // as faces, null for normals per vertex
+    };
+
+    // levels from fine to coarse, each with at most half the triangles of
+    // the one before, down to minTriangles; empty when canceled
+    static std::vector<MeshLevel> makeLevels(const Input& input, int minTriangles = 1000,
+                                             const std::function<bool()>& isCanceled = std::function<bool()>());
+
+    // one level with cells of the given size
+    static MeshLevel makeLevel(const Input& input, float cell);
+};
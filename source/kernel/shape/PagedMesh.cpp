@@ -0,0 +1,478 @@
+#include "PagedMesh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <type_traits>
+#include <unordered_map>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/TriangleMesh.h"
+
+namespace
+{
+/*
+ * Files hold the clusters, each starting Alignment bytes apart as
+ *   float64 origin x, y, z, int32 triangles, int32 nodes, the BVHNode4 nodes,
+ *   float32 offsets of a, b and c from the origin, 9 per triangle, and
+ *   int16 octahedral normals of a, b and c, 6 per triangle,
+ * then the BVHNode4 top nodes, the uint64 offsets of the clusters and of the
+ * top nodes, and a Trailer, in the byte order of the machine writing them,
+ * as the caches of TriangleMesh.
+ */
+const char Magic[4] = {'T', 'N', 'P', 'M'};
+const std::uint32_t Version = 1;
+const size_t Alignment = TriangleMesh::Alignment;
+
+struct Trailer
+{
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t clusters;
+    std::int32_t nodes;
+    std::uint64_t triangles;
+    std::uint64_t table; // offset of the top nodes
+    double box[6];
+};
+
+struct ClusterHeader
+{
+    double origin[3];
+    std::int32_t triangles;
+    std::int32_t nodes;
+};
+
+static_assert(std::is_trivially_copyable<BVHNode4>::value, "BVHNode4 is written as bytes");
+
+bool PagedMeshes = false;
+qulonglong CacheBytes = qulonglong(256) << 20;
+std::atomic<std::uint64_t> NextId(1);
+
+// the clusters a thread built, most recently used first
+struct ClusterCache
+{
+    struct Entry {
+        std::uint64_t key; // id << 32 | cluster
+        std::unique_ptr<TriangleMesh> mesh;
+        qulonglong bytes;
+    };
+    std::list<Entry> entries;
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+    PagedMesh::CacheStatistics statistics;
+};
+
+thread_local ClusterCache Cache;
+
+bool fail(QString* error, const QString& message)
+{
+    if (error) *error = message;
+    return false;
+}
+
+void append(std::vector<char>& data, const void* p, size_t size)
+{
+    const char* bytes = static_cast<const char*>(p);
+    data.insert(data.end(), bytes, bytes + size);
+}
+
+double sign(double x)
+{
+    return x < 0. ? -1. : 1.;
+}
+
+void encodeNormal(const vec3d& n, std::int16_t* out)
+{
+    const double s = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    double u = s > 0. ? n.x/s : 0.;
+    double v = s > 0. ? n.y/s : 0.;
+    if (n.z < 0.) {
+        const double w = (1. - std::abs(v))*sign(u);
+        v = (1. - std::abs(u))*sign(v);
+        u = w;
+    }
+    out[0] = std::int16_t(std::lround(u*32767.));
+    out[1] = std::int16_t(std::lround(v*32767.));
+}
+
+vec3d decodeNormal(const std::int16_t* in)
+{
+    double u = in[0]/32767.;
+    double v = in[1]/32767.;
+    const double z = 1. - std::abs(u) - std::abs(v);
+    if (z < 0.) {
+        const double w = (1. - std::abs(v))*sign(u);
+        v = (1. - std::abs(u))*sign(v);
+        u = w;
+    }
+    return vec3d(u, v, z).normalized();
+}
+
+vec3d decodePoint(const double* origin, const float* offset)
+{
+    return vec3d(origin[0] + double(offset[0]), origin[1] + double(offset[1]), origin[2] + double(offset[2]));
+}
+
+// the nodes form a tree, children after their parents, with leaves in [0, primitives)
+bool isValid(std::span<const BVHNode4> nodes, std::uint64_t primitives)
+{
+    for (size_t n = 0; n < nodes.size(); ++n)
+        for (int k = 0; k < Box3DPack::Width; ++k) {
+            const int child = nodes[n].child[k];
+            const int count = nodes[n].count[k];
+            if (count < 0) return false;
+            if (count > 0 && (child < 0 || std::uint64_t(child) + std::uint64_t(count) > primitives)) return false;
+            if (count == 0 && child != -1 && (child <= int(n) || size_t(child) >= nodes.size())) return false;
+        }
+    return true;
+}
+
+// the lane boxes of the subtree at n made to hold those of its clusters
+Box3D refit(std::vector<BVHNode4>& nodes, int n, const std::vector<Box3D>& clusters)
+{
+    Box3D ans;
+    for (int k = 0; k < Box3DPack::Width; ++k) {
+        const int child = nodes[n].child[k];
+        if (child < 0) continue;
+        const Box3D box = nodes[n].count[k] > 0 ? clusters[child] : refit(nodes, child, clusters);
+        nodes[n].boxes.set(k, box);
+        ans << box;
+    }
+    return ans;
+}
+
+/*
+ * Appends the cluster of triangles, rounded first so that its hierarchy is
+ * that of the triangles read back, and returns the box of those.
+ */
+Box3D writeCluster(std::vector<char>& data, std::vector<Triangle> triangles, int leafSize)
+{
+    Box3D box;
+    for (const Triangle& t : triangles)
+        box << t.box();
+    const double origin[3] = {box.min().x, box.min().y, box.min().z};
+
+    std::vector<float> offsets(9*triangles.size());
+    std::vector<std::int16_t> normals(6*triangles.size());
+    std::vector<Box3D> boxes;
+    boxes.reserve(triangles.size());
+    for (size_t n = 0; n < triangles.size(); ++n) {
+        Triangle& t = triangles[n];
+        const vec3d* ps[] = {&t.pA(), &t.pB(), &t.pC()};
+        const vec3d* ns[] = {&t.nA(), &t.nB(), &t.nC()};
+        for (int k = 0; k < 3; ++k) {
+            float* offset = &offsets[9*n + 3*k];
+            offset[0] = float(ps[k]->x - origin[0]);
+            offset[1] = float(ps[k]->y - origin[1]);
+            offset[2] = float(ps[k]->z - origin[2]);
+            encodeNormal(*ns[k], &normals[6*n + 2*k]);
+        }
+        t = Triangle(
+            decodePoint(origin, &offsets[9*n]), decodePoint(origin, &offsets[9*n + 3]), decodePoint(origin, &offsets[9*n + 6]),
+            t.nA(), t.nB(), t.nC()
+        );
+        boxes.push_back(t.box());
+    }
+
+    BVHBuilder builder(leafSize);
+    builder.build(boxes);
+    const std::vector<int>& order = builder.getOrder();
+    std::vector<float> sortedOffsets(offsets.size());
+    std::vector<std::int16_t> sortedNormals(normals.size());
+    for (size_t n = 0; n < order.size(); ++n) {
+        std::copy_n(&offsets[9*order[n]], 9, &sortedOffsets[9*n]);
+        std::copy_n(&normals[6*order[n]], 6, &sortedNormals[6*n]);
+    }
+
+    ClusterHeader header;
+    std::copy_n(origin, 3, header.origin);
+    header.triangles = std::int32_t(triangles.size());
+    header.nodes = std::int32_t(builder.getNodes().size());
+    const size_t begin = data.size();
+    append(data, &header, sizeof(header));
+    append(data, builder.getNodes().data(), builder.getNodes().size()*sizeof(BVHNode4));
+    append(data, sortedOffsets.data(), sortedOffsets.size()*sizeof(float));
+    append(data, sortedNormals.data(), sortedNormals.size()*sizeof(std::int16_t));
+    data.resize(begin + (data.size() - begin + Alignment - 1)/Alignment*Alignment);
+
+    Box3D ans;
+    for (const Box3D& b : boxes)
+        ans << b;
+    return ans;
+}
+}
+
+
+PagedMesh::PagedMesh(int clusterSize, int leafSize):
+    m_clusterSize(std::max(1, clusterSize)),
+    m_leafSize(leafSize)
+{
+
+}
+
+PagedMesh::~PagedMesh()
+{
+
+}
+
+void PagedMesh::clear()
+{
+    m_input.clear();
+    m_file.reset();
+    m_data = nullptr;
+    m_id = 0;
+    m_size = 0;
+    m_nodes.clear();
+    m_offsets.clear();
+    m_box = Box3D();
+}
+
+void PagedMesh::setPagedMeshes(bool on)
+{
+    PagedMeshes = on;
+}
+
+bool PagedMesh::isPagedMeshes()
+{
+    return PagedMeshes;
+}
+
+void PagedMesh::setCacheBytes(qulonglong bytes)
+{
+    CacheBytes = bytes;
+}
+
+qulonglong PagedMesh::getCacheBytes()
+{
+    return CacheBytes;
+}
+
+PagedMesh::CacheStatistics PagedMesh::getCacheStatistics()
+{
+    return Cache.statistics;
+}
+
+void PagedMesh::addTriangle(
+    const vec3d& pA, const vec3d& pB, const vec3d& pC,
+    const vec3d& nA, const vec3d& nB, const vec3d& nC)
+{
+    m_input.push_back(Triangle(pA, pB, pC, nA, nB, nC));
+}
+
+/*!
+ * The top hierarchy is built over the triangles with leaves of up to the
+ * cluster size, written one cluster at a time, and refitted to the boxes of
+ * the rounded clusters; its leaves then name their cluster.
+ */
+bool PagedMesh::build(const QString& fileName, QString* error)
+{
+    std::vector<Triangle> input;
+    input.swap(m_input);
+    clear();
+
+    std::vector<Box3D> boxes;
+    boxes.reserve(input.size());
+    for (const Triangle& t : input)
+        boxes.push_back(t.box());
+    BVHBuilder builder(m_clusterSize);
+    builder.build(boxes);
+    builder.reorder(input);
+    boxes = std::vector<Box3D>();
+    std::vector<BVHNode4> nodes = builder.getNodes();
+
+    QFileInfo info(fileName);
+    if (!QDir().mkpath(info.absolutePath()))
+        return fail(error, QString("Cannot create output directory %1.").arg(info.absolutePath()));
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(error, QString("Cannot open paged mesh file %1: %2").arg(fileName, file.errorString()));
+
+    std::vector<std::uint64_t> offsets;
+    std::vector<Box3D> clusters;
+    Box3D box;
+    std::vector<char> data;
+    std::uint64_t offset = 0;
+    for (BVHNode4& node : nodes)
+        for (int k = 0; k < Box3DPack::Width; ++k) {
+            if (node.count[k] <= 0) continue;
+            const int begin = node.child[k];
+            data.clear();
+            clusters.push_back(writeCluster(data, std::vector<Triangle>(input.begin() + begin, input.begin() + begin + node.count[k]), m_leafSize));
+            box << clusters.back();
+            if (file.write(data.data(), qint64(data.size())) != qint64(data.size()))
+                return fail(error, QString("Cannot write paged mesh file %1: %2").arg(fileName, file.errorString()));
+            offsets.push_back(offset);
+            offset += data.size();
+            node.child[k] = int(clusters.size()) - 1;
+            node.count[k] = 1;
+        }
+    offsets.push_back(offset);
+    if (!nodes.empty()) refit(nodes, 0, clusters);
+
+    Trailer trailer;
+    std::memcpy(trailer.magic, Magic, sizeof(Magic));
+    trailer.version = Version;
+    trailer.clusters = std::int32_t(clusters.size());
+    trailer.nodes = std::int32_t(nodes.size());
+    trailer.triangles = input.size();
+    trailer.table = offset;
+    const vec3d corners[] = {box.min(), box.max()};
+    std::memcpy(trailer.box, corners, sizeof(trailer.box));
+
+    data.clear();
+    append(data, nodes.data(), nodes.size()*sizeof(BVHNode4));
+    append(data, offsets.data(), offsets.size()*sizeof(std::uint64_t));
+    append(data, &trailer, sizeof(trailer));
+    if (file.write(data.data(), qint64(data.size())) != qint64(data.size()) || !file.commit())
+        return fail(error, QString("Cannot write paged mesh file %1: %2").arg(fileName, file.errorString()));
+
+    input = std::vector<Triangle>();
+    return open(fileName, error);
+}
+
+bool PagedMesh::open(const QString& fileName, QString* error)
+{
+    clear();
+    std::unique_ptr<QFile> file(new QFile(fileName));
+    if (!file->open(QIODevice::ReadOnly))
+        return fail(error, QString("Cannot open paged mesh file %1: %2").arg(fileName, file->errorString()));
+    const qint64 size = file->size();
+    const char* data = size >= qint64(sizeof(Trailer)) ? reinterpret_cast<const char*>(file->map(0, size)) : nullptr;
+
+    Trailer trailer;
+    if (data) std::memcpy(&trailer, data + size - sizeof(Trailer), sizeof(Trailer));
+    if (!data || std::memcmp(trailer.magic, Magic, sizeof(Magic)) != 0 || trailer.version != Version)
+        return fail(error, QString("%1 is not a paged mesh file of version %2.").arg(fileName).arg(Version));
+
+    const std::uint64_t tableBytes = std::uint64_t(trailer.nodes)*sizeof(BVHNode4) + (std::uint64_t(trailer.clusters) + 1)*sizeof(std::uint64_t);
+    bool ok = trailer.nodes >= 0 && trailer.clusters >= 0 && trailer.table + tableBytes + sizeof(Trailer) == std::uint64_t(size);
+    std::vector<BVHNode4> nodes;
+    std::vector<std::uint64_t> offsets;
+    if (ok) {
+        nodes.resize(trailer.nodes);
+        offsets.resize(size_t(trailer.clusters) + 1);
+        const char* table = data + trailer.table;
+        std::memcpy(nodes.data(), table, nodes.size()*sizeof(BVHNode4));
+        std::memcpy(offsets.data(), table + nodes.size()*sizeof(BVHNode4), offsets.size()*sizeof(std::uint64_t));
+        ok = isValid(nodes, offsets.size() - 1) && offsets.front() == 0 && offsets.back() == trailer.table &&
+            std::is_sorted(offsets.begin(), offsets.end());
+    }
+    if (!ok)
+        return fail(error, QString("The paged mesh file %1 is damaged.").arg(fileName));
+
+    m_file = std::move(file);
+    m_data = data;
+    m_id = NextId++;
+    m_size = trailer.triangles;
+    m_nodes.swap(nodes);
+    m_offsets.swap(offsets);
+    const vec3d corners[] = {vec3d(trailer.box[0], trailer.box[1], trailer.box[2]), vec3d(trailer.box[3], trailer.box[4], trailer.box[5])};
+    if (corners[0] <= corners[1]) { // an empty box stays empty
+        m_box << corners[0];
+        m_box << corners[1];
+    }
+    return true;
+}
+
+qulonglong PagedMesh::getMemoryUsage() const
+{
+    return qulonglong(m_input.capacity()*sizeof(Triangle) + m_nodes.capacity()*sizeof(BVHNode4) +
+        m_offsets.capacity()*sizeof(std::uint64_t));
+}
+
+// null for a damaged cluster, which then has no hits
+std::unique_ptr<TriangleMesh> PagedMesh::loadCluster(int n) const
+{
+    const char* p = m_data + m_offsets[n];
+    const size_t bytes = size_t(m_offsets[n + 1] - m_offsets[n]);
+    ClusterHeader header;
+    if (bytes < sizeof(header)) return nullptr;
+    std::memcpy(&header, p, sizeof(header));
+    if (header.triangles <= 0 || header.nodes <= 0) return nullptr;
+    const size_t nodeBytes = size_t(header.nodes)*sizeof(BVHNode4);
+    const size_t offsetBytes = 9*size_t(header.triangles)*sizeof(float);
+    const size_t normalBytes = 6*size_t(header.triangles)*sizeof(std::int16_t);
+    if (sizeof(header) + nodeBytes + offsetBytes + normalBytes > bytes) return nullptr;
+
+    std::vector<BVHNode4> nodes(header.nodes);
+    p += sizeof(header);
+    std::memcpy(nodes.data(), p, nodeBytes);
+    if (!isValid(nodes, std::uint64_t(header.triangles))) return nullptr;
+    const char* offsets = p + nodeBytes;
+    const char* normals = offsets + offsetBytes;
+
+    std::unique_ptr<TriangleMesh> ans(new TriangleMesh(m_leafSize));
+    ans->reserve(header.triangles);
+    for (int t = 0; t < header.triangles; ++t) {
+        float offset[9];
+        std::int16_t normal[6];
+        std::memcpy(offset, offsets + 9*size_t(t)*sizeof(float), sizeof(offset));
+        std::memcpy(normal, normals + 6*size_t(t)*sizeof(std::int16_t), sizeof(normal));
+        ans->addTriangle(
+            decodePoint(header.origin, offset), decodePoint(header.origin, offset + 3), decodePoint(header.origin, offset + 6),
+            decodeNormal(normal), decodeNormal(normal + 2), decodeNormal(normal + 4)
+        );
+    }
+    ans->build(nodes);
+    return ans;
+}
+
+// valid until the next call on this thread
+const TriangleMesh* PagedMesh::findCluster(int n) const
+{
+    ClusterCache& cache = Cache;
+    const std::uint64_t key = m_id << 32 | std::uint64_t(n);
+    auto found = cache.index.find(key);
+    if (found != cache.index.end()) {
+        cache.statistics.hits++;
+        cache.entries.splice(cache.entries.begin(), cache.entries, found->second);
+        return found->second->mesh.get();
+    }
+
+    cache.statistics.misses++;
+    std::unique_ptr<TriangleMesh> mesh = loadCluster(n);
+    if (!mesh) return nullptr;
+    const qulonglong bytes = mesh->getMemoryUsage();
+    cache.entries.push_front({key, std::move(mesh), bytes});
+    cache.index[key] = cache.entries.begin();
+    cache.statistics.bytes += bytes;
+    while (cache.statistics.bytes > CacheBytes && cache.entries.size() > 1) {
+        cache.statistics.bytes -= cache.entries.back().bytes;
+        cache.index.erase(cache.entries.back().key);
+        cache.entries.pop_back();
+    }
+    cache.statistics.clusters = cache.entries.size();
+    return cache.entries.front().mesh.get();
+}
+
+bool PagedMesh::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg) const
+{
+    Ray rayT = ray;
+    bool isHit = false;
+    traverseBVH(getNodes(), rayT, [&](int cluster, int) {
+        const TriangleMesh* mesh = findCluster(cluster);
+        double t = 0.;
+        DifferentialGeometry dgT;
+        if (!mesh || !mesh->intersect(rayT, &t, &dgT)) return;
+        rayT.tMax = t;
+        *dg = dgT;
+        isHit = true;
+    });
+    if (!isHit) return false;
+    *tHit = rayT.tMax;
+    return true;
+}
+
+bool PagedMesh::intersectP(const Ray& ray) const
+{
+    return traverseBVHUntil(getNodes(), ray, [&](int cluster, int) {
+        const TriangleMesh* mesh = findCluster(cluster);
+        return mesh && mesh->intersectP(ray);
+    });
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <QString>
+
+#include "kernel/shape/BVH.h"
+#include "kernel/shape/Triangle.h"
+
+class QFile;
+class TriangleMesh;
+struct DifferentialGeometry;
+
+
+//! PagedMesh is the ray tracing mesh of triangulated shapes too large to hold built.
+/*!
+ * The triangles are split into clusters of up to clusterSize along a
+ * BVHBuilder hierarchy, the top hierarchy, whose leaves are the clusters and
+ * which is kept in memory. Each cluster is written to a file with its own
+ * hierarchy, its vertices as float offsets from the corner of its box and its
+ * normals octahedral in two 16-bit values, about half the bytes of the built
+ * cluster. The file is mapped read-only and a cluster a ray reaches is built
+ * from it into a TriangleMesh on demand.
+ *
+ * Every thread keeps the clusters it built in its own cache of getCacheBytes(),
+ * dropping the least recently used, so a worker tracing a mesh larger than
+ * memory holds the clusters its rays have reached lately, and the pages of the
+ * file are left to the system. Hits are those of the TriangleMesh of the
+ * rounded vertices, within 1e-7 of the size of a cluster of the exact ones.
+ *
+ * Fill the mesh with addTriangle() and build() it to a file, or open() one
+ * written before.
+ */
+class TONATIUH_KERNEL PagedMesh
+{
+public:
+    explicit PagedMesh(int clusterSize = 2048, int leafSize = 4);
+    ~PagedMesh();
+
+    PagedMesh(const PagedMesh&) = delete;
+    PagedMesh& operator=(const PagedMesh&) = delete;
+
+    void clear();
+    void reserve(int n) {m_input.reserve(n);}
+    void addTriangle(
+        const vec3d& pA, const vec3d& pB, const vec3d& pC,
+        const vec3d& nA, const vec3d& nB, const vec3d& nC
+    );
+    // writes the clusters of the triangles added to fileName and opens it;
+    // the triangles are dropped either way
+    bool build(const QString& fileName, QString* error = nullptr);
+    // maps a file written by build, which has to stay until the mesh is cleared
+    bool open(const QString& fileName, QString* error = nullptr);
+
+    bool isEmpty() const {return m_nodes.empty();}
+    qulonglong size() const {return m_size;}
+    int getClusterCount() const {return int(m_offsets.size()) - 1;}
+    const Box3D& getBox() const {return m_box;}
+    std::span<const BVHNode4> getNodes() const {return m_nodes;}
+    // bytes of the top hierarchy, without the clusters cached
+    qulonglong getMemoryUsage() const;
+
+    bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg) const;
+    bool intersectP(const Ray& ray) const;
+
+    // meshes of the shapes loading them are to be paged, from now on
+    static void setPagedMeshes(bool on);
+    static bool isPagedMeshes();
+
+    // bytes of built clusters each thread keeps; one cluster is kept at least
+    static void setCacheBytes(qulonglong bytes);
+    static qulonglong getCacheBytes();
+
+    // of the cache of the calling thread
+    struct CacheStatistics {
+        qulonglong hits = 0;
+        qulonglong misses = 0; // clusters built
+        qulonglong clusters = 0; // kept
+        qulonglong bytes = 0;
+    };
+    static CacheStatistics getCacheStatistics();
+
+private:
+    const TriangleMesh* findCluster(int n) const;
+    std::unique_ptr<TriangleMesh> loadCluster(int n) const;
+
+    int m_clusterSize;
+    int m_leafSize;
+    std::vector<Triangle> m_input; // until build
+
+    std::unique_ptr<QFile> m_file;
+    const char* m_data = nullptr;
+    std::uint64_t m_id = 0; // of the file opened, for the caches
+    qulonglong m_size = 0;
+    std::vector<BVHNode4> m_nodes; // leaves of one lane a cluster
+    std::vector<std::uint64_t> m_offsets; // of the clusters in the file, and their end
+    Box3D m_box;
+};
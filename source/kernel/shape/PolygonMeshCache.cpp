@@ -0,0 +1,126 @@
+#include "PolygonMeshCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <thread>
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+
+namespace {
+
+struct Cache
+{
+    QMutex mutex;
+    QHash<QByteArray, PolygonMeshCache::Mesh> meshes;
+    std::deque<QByteArray> order; // of insertion, the oldest first
+    int capacity = 1024;
+
+    // under the lock
+    void insert(const QByteArray& key, const PolygonMeshCache::Mesh& mesh)
+    {
+        if (meshes.contains(key)) return;
+        meshes.insert(key, mesh);
+        order.push_back(key);
+        trim();
+    }
+
+    void trim()
+    {
+        while (int(order.size()) > capacity) {
+            meshes.remove(order.front());
+            order.pop_front();
+        }
+    }
+};
+
+Cache& cache()
+{
+    static Cache ans;
+    return ans;
+}
+
+} // namespace
+
+
+PolygonMeshCache::Mesh PolygonMeshCache::find(const QByteArray& key, const Maker& make)
+{
+    Cache& c = cache();
+    {
+        QMutexLocker lock(&c.mutex);
+        auto it = c.meshes.constFind(key);
+        if (it != c.meshes.constEnd())
+            return *it;
+    }
+    Mesh mesh = make();
+    QMutexLocker lock(&c.mutex);
+    c.insert(key, mesh);
+    return mesh;
+}
+
+void PolygonMeshCache::prepare(const std::vector<std::pair<QByteArray, Maker>>& jobs)
+{
+    Cache& c = cache();
+    std::vector<const std::pair<QByteArray, Maker>*> missing;
+    {
+        QMutexLocker lock(&c.mutex);
+        QSet<QByteArray> keys;
+        for (const auto& job : jobs) {
+            if (c.meshes.contains(job.first) || keys.contains(job.first)) continue;
+            keys.insert(job.first);
+            missing.push_back(&job);
+        }
+    }
+    if (missing.empty()) return;
+
+    std::vector<Mesh> meshes(missing.size());
+    std::atomic<size_t> next(0);
+    auto make = [&]() {
+        for (size_t n = next++; n < missing.size(); n = next++)
+            meshes[n] = missing[n]->second();
+    };
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), missing.size()));
+    std::vector<std::thread> workers;
+    for (size_t w = 1; w < threads; ++w)
+        workers.emplace_back(make);
+    make();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    QMutexLocker lock(&c.mutex);
+    for (size_t n = 0; n < missing.size(); ++n)
+        c.insert(missing[n]->first, meshes[n]);
+}
+
+void PolygonMeshCache::setCapacity(int meshes)
+{
+    Cache& c = cache();
+    QMutexLocker lock(&c.mutex);
+    c.capacity = std::max(0, meshes);
+    c.trim();
+}
+
+int PolygonMeshCache::getCapacity()
+{
+    Cache& c = cache();
+    QMutexLocker lock(&c.mutex);
+    return c.capacity;
+}
+
+int PolygonMeshCache::getCount()
+{
+    Cache& c = cache();
+    QMutexLocker lock(&c.mutex);
+    return int(c.meshes.size());
+}
+
+void PolygonMeshCache::clear()
+{
+    Cache& c = cache();
+    QMutexLocker lock(&c.mutex);
+    c.meshes.clear();
+    c.order.clear();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <QByteArray>
+
+class PolygonMesh;
+
+
+//! PolygonMeshCache keeps the triangulations of polygon profiles, shared by the shapes that repeat them.
+/*!
+ * A field of facets repeats a few polygon profiles on shapes of a few kinds,
+ * and the DistMesh relaxation of PolygonMesh dominates the time to open it.
+ * The meshes are kept by a key of whatever decides them, see
+ * ShapeRT::makeQuadMesh, so every facet after the first of its kind copies
+ * the mesh instead of relaxing it again. Meshes that failed are kept as null.
+ *
+ * prepare makes the meshes of keys not kept yet before they are asked for,
+ * each distinct key once and the keys in parallel, so loading a scene pays
+ * its distinct profiles on all processors. Its makers run on worker threads
+ * and must not read scene nodes, only copies of what they need.
+ *
+ * The cache holds up to getCapacity() meshes, dropping the oldest. It is
+ * locked, and the meshes are made outside the lock: two threads asking for
+ * a key not kept may both make it.
+ */
+class TONATIUH_KERNEL PolygonMeshCache
+{
+public:
+    using Mesh = std::shared_ptr<const PolygonMesh>;
+    using Maker = std::function<Mesh()>;
+
+    // the mesh kept for key, or the one make returns, then kept
+    static Mesh find(const QByteArray& key, const Maker& make);
+    // makes and keeps the meshes of the keys not kept, each once, in parallel
+    static void prepare(const std::vector<std::pair<QByteArray, Maker>>& jobs);
+
+    // meshes kept at most, 1024 by default
+    static void setCapacity(int meshes);
+    static int getCapacity();
+    static int getCount();
+    static void clear();
+};
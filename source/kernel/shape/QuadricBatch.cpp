@@ -0,0 +1,120 @@
+#include "QuadricBatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "libraries/math/3D/Ray.h"
+
+namespace
+{
+// relative widening of the tests, far above the rounding of the shape code
+const double Slack = 1e-9;
+
+double widened(double x)
+{
+    return Slack*(1. + std::abs(x));
+}
+}
+
+
+void QuadricBatch::clear()
+{
+    m_leaves.clear();
+}
+
+void QuadricBatch::add(const Box3D& box)
+{
+    Affine3D identity;
+    Quadric quadric;
+    add(box, identity, quadric);
+    m_leaves.back() = 0.;
+}
+
+void QuadricBatch::add(const Box3D& box, const Affine3D& transform, const Quadric& quadric)
+{
+    const double values[FieldCount] = {
+        box.min().x, box.min().y, box.min().z, box.max().x, box.max().y, box.max().z,
+        transform.minv[0][0], transform.minv[0][1], transform.minv[0][2], transform.minv[0][3],
+        transform.minv[1][0], transform.minv[1][1], transform.minv[1][2], transform.minv[1][3],
+        transform.minv[2][0], transform.minv[2][1], transform.minv[2][2], transform.minv[2][3],
+        quadric.a.x, quadric.a.y, quadric.a.z, quadric.b, quadric.c,
+        quadric.xMin, quadric.xMax, quadric.yMin, quadric.yMax,
+        1.
+    };
+    m_leaves.insert(m_leaves.end(), values, values + FieldCount);
+}
+
+/*!
+ * Every comparison is written so that a NaN lets the leaf pass.
+ */
+int QuadricBatch::filter(const Ray& ray, int begin, int count) const
+{
+    const double* leaves = m_leaves.data() + begin*FieldCount;
+
+    const vec3d& rO = ray.origin;
+    const vec3d& rD = ray.direction();
+    const vec3d& rI = ray.invDirection();
+    const double tLow = ray.tMin + 1e-5;
+    const double tHigh = ray.tMax;
+
+    // slab tests, most leaves stop here
+    const double rOs[] = {rO.x, rO.y, rO.z};
+    const double rIs[] = {rI.x, rI.y, rI.z};
+    int mask = 0;
+    for (int k = 0; k < count; ++k)
+    {
+        double tNear = ray.tMin;
+        double tFar = ray.tMax;
+        for (int i = 0; i < 3; ++i) {
+            double tA = (leaves[k*FieldCount + BoxMinX + i] - rOs[i])*rIs[i];
+            double tB = (leaves[k*FieldCount + BoxMaxX + i] - rOs[i])*rIs[i];
+            double t0 = rIs[i] >= 0. ? tA : tB;
+            double t1 = rIs[i] >= 0. ? tB : tA;
+            if (t0 > tNear) tNear = t0;
+            if (t1 < tFar) tFar = t1;
+        }
+        // an axis the ray is parallel to gives infinite distances
+        double slack = widened(std::min(std::abs(tNear), std::abs(tFar)));
+        if (!(tNear > tFar + 2.*slack)) mask |= 1 << k;
+    }
+
+    for (int k = 0; k < count; ++k)
+    {
+        if (!(mask & (1 << k)) || leaves[k*FieldCount + IsQuadric] == 0.) continue;
+
+        // ray in the shape frame
+        double oX = leaves[k*FieldCount + M00]*rO.x + leaves[k*FieldCount + M01]*rO.y + leaves[k*FieldCount + M02]*rO.z + leaves[k*FieldCount + M03];
+        double oY = leaves[k*FieldCount + M10]*rO.x + leaves[k*FieldCount + M11]*rO.y + leaves[k*FieldCount + M12]*rO.z + leaves[k*FieldCount + M13];
+        double oZ = leaves[k*FieldCount + M20]*rO.x + leaves[k*FieldCount + M21]*rO.y + leaves[k*FieldCount + M22]*rO.z + leaves[k*FieldCount + M23];
+        double dX = leaves[k*FieldCount + M00]*rD.x + leaves[k*FieldCount + M01]*rD.y + leaves[k*FieldCount + M02]*rD.z;
+        double dY = leaves[k*FieldCount + M10]*rD.x + leaves[k*FieldCount + M11]*rD.y + leaves[k*FieldCount + M12]*rD.z;
+        double dZ = leaves[k*FieldCount + M20]*rD.x + leaves[k*FieldCount + M21]*rD.y + leaves[k*FieldCount + M22]*rD.z;
+
+        // roots with the stable formula, the linear root twice when qA = 0
+        double aX = leaves[k*FieldCount + CoefAX], aY = leaves[k*FieldCount + CoefAY], aZ = leaves[k*FieldCount + CoefAZ];
+        double b = leaves[k*FieldCount + CoefB];
+        double qA = aX*dX*dX + aY*dY*dY + aZ*dZ*dZ;
+        double qB = 2.*(aX*oX*dX + aY*oY*dY + aZ*oZ*dZ) + b*dZ;
+        double qC = aX*oX*oX + aY*oY*oY + aZ*oZ*oZ + b*oZ + leaves[k*FieldCount + CoefC];
+        double d = qB*qB - 4.*qA*qC;
+        if (d < -Slack*(qB*qB + std::abs(4.*qA*qC))) {
+            mask &= ~(1 << k);
+            continue;
+        }
+        double q = -0.5*(qB + std::copysign(std::sqrt(std::max(d, 0.)), qB));
+        double t1 = qC/q;
+        const double ts[] = {qA == 0. ? t1 : q/qA, t1};
+
+        bool rootsOut = true;
+        for (double t : ts) {
+            double x = oX + dX*t;
+            double y = oY + dY*t;
+            bool out = t < tLow - widened(t) || t > tHigh + widened(t) ||
+                x < leaves[k*FieldCount + XMin] - widened(x) || x > leaves[k*FieldCount + XMax] + widened(x) ||
+                y < leaves[k*FieldCount + YMin] - widened(y) || y > leaves[k*FieldCount + YMax] + widened(y);
+            rootsOut = rootsOut && out;
+        }
+        if (rootsOut) mask &= ~(1 << k);
+    }
+    return mask;
+}
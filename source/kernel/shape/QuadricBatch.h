@@ -0,0 +1,64 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <vector>
+
+#include "libraries/math/gcf.h"
+#include "libraries/math/3D/Affine3D.h"
+#include "libraries/math/3D/Box3D.h"
+
+class Ray;
+
+
+//! QuadricBatch rejects the leaves of a scene array four at a time.
+/*!
+ * Every leaf keeps its box; leaves with an analytic shape also keep the inverse
+ * transform and the coefficients of a.x x^2 + a.y y^2 + a.z z^2 + b z + c = 0
+ * in the shape frame, with the rectangle of the profile when it clips x and y.
+ * filter() runs the slab test, solves the quadric and clips the roots to the
+ * ray interval and the rectangle in structure-of-arrays lanes.
+ *
+ * The tests are widened slightly, so a leaf may pass without being hit but is
+ * never rejected when ShapeRT::intersect would hit it: hits are still resolved
+ * by the shape. Leaves without a quadric are only tested against their box.
+ */
+class TONATIUH_KERNEL QuadricBatch
+{
+public:
+    static const int Width = 4;
+
+    struct Quadric
+    {
+        vec3d a;
+        double b = 0.;
+        double c = 0.;
+        // clip of x and y, none by default
+        double xMin = -gcf::infinity;
+        double xMax = gcf::infinity;
+        double yMin = -gcf::infinity;
+        double yMax = gcf::infinity;
+    };
+
+    void clear();
+    // a leaf tested only against its box
+    void add(const Box3D& box);
+    void add(const Box3D& box, const Affine3D& transform, const Quadric& quadric);
+    int size() const {return int(m_leaves.size())/FieldCount;}
+    qulonglong getMemoryUsage() const {return m_leaves.capacity()*sizeof(double);}
+
+    // bit k is set when leaf begin + k may be hit, count <= Width
+    int filter(const Ray& ray, int begin, int count) const;
+
+private:
+    enum Field {
+        BoxMinX, BoxMinY, BoxMinZ, BoxMaxX, BoxMaxY, BoxMaxZ,
+        M00, M01, M02, M03, M10, M11, M12, M13, M20, M21, M22, M23,
+        CoefAX, CoefAY, CoefAZ, CoefB, CoefC,
+        XMin, XMax, YMin, YMax,
+        IsQuadric,
+        FieldCount
+    };
+
+    std::vector<double> m_leaves; // FieldCount per leaf
+};
@@ -1,5 +1,7 @@
 #include "ShapeCone.h"
 
+#include <Inventor/sensors/SoNodeSensor.h>
+
 #include "kernel/profiles/ProfileBox.h"
 #include "kernel/scene/TShapeKit.h"
 #include "kernel/shape/DifferentialGeometry.h"
@@ -20,6 +22,16 @@ ShapeCone::ShapeCone()
     SO_NODE_CONSTRUCTOR(ShapeCone);
 
     SO_NODE_ADD_FIELD( dr, (-1.) );
+
+    onSensor(this, 0);
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+}
+
+ShapeCone::~ShapeCone()
+{
+    delete m_sensor;
 }
 
 vec3d ShapeCone::getPoint(double u, double v) const
@@ -70,7 +82,7 @@ bool ShapeCone::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg
 {
     const vec3d& rayO = ray.origin;
     const vec3d& rayD = ray.direction();
-    double drV = dr.getValue();
+    double drV = m_dr;
 
     // |rxy|^2 = |1 + dr*z|^2, r = r0 + t*d
     double rz = 1. + drV*rayO.z;
@@ -123,3 +135,9 @@ void ShapeCone::updateShapeGL(TShapeKit* parent)
 
     makeQuadMesh(parent, QSize(rows, 2));
 }
+
+void ShapeCone::onSensor(void* data, SoSensor*)
+{
+    ShapeCone* shape = (ShapeCone*) data;
+    shape->m_dr = shape->dr.getValue();
+}
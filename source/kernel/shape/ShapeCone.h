@@ -21,8 +21,17 @@ public:
 
     bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* aperture) const;
     void updateShapeGL(TShapeKit* parent);
+    bool hasQuadMesh() const {return true;}
 
     SoSFDouble dr;
 
     NAME_ICON_FUNCTIONS("Cone", ":/shape/ShapeCone.png")
+
+protected:
+    ~ShapeCone();
+
+    double m_dr; // the field, for tracing
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
 };
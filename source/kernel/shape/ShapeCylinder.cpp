@@ -4,6 +4,7 @@
 #include <Inventor/nodes/SoNormal.h>
 #include <Inventor/nodes/SoQuadMesh.h>
 #include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/sensors/SoNodeSensor.h>
 
 #include "kernel/profiles/ProfileBox.h"
 #include "kernel/scene/TShapeKit.h"
@@ -31,6 +32,16 @@ ShapeCylinder::ShapeCylinder()
 
     SO_NODE_SET_SF_ENUM_TYPE(caps, Caps);
     SO_NODE_ADD_FIELD(caps, (none) );
+
+    onSensor(this, 0);
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+}
+
+ShapeCylinder::~ShapeCylinder()
+{
+    delete m_sensor;
 }
 
 ProfileRT* ShapeCylinder::getDefaultProfile() const
@@ -116,6 +127,11 @@ double ShapeCylinder::getStepHint(double u, double v) const
     return 2*gcf::pi/48;
 }
 
+std::function<double(double, double)> ShapeCylinder::getStepHints() const
+{
+    return [](double, double) {return 2*gcf::pi/48;};
+}
+
 void ShapeCylinder::updateShapeGL(TShapeKit* parent)
 {
     ProfileRT* profile = (ProfileRT*) parent->profileRT.getValue();
@@ -196,9 +212,9 @@ bool ShapeCylinder::intersect(const Ray& ray, double* tHit, DifferentialGeometry
         {ans = true; break;}
     }
 
-    if (caps.getValue() != Caps::none) {
+    if (m_caps != Caps::none) {
         Box2D box2d = profile->getBox();
-        if (caps.getValue() & Caps::top) {
+        if (m_caps & Caps::top) {
             double t = (box2d.max().y - rayO.z)*ray.invDirection().z;
             if (t < ray.tMin + 1e-5 || t > ray.tMax || (ans && t > *tHit)) {}
             else {
@@ -219,7 +235,7 @@ bool ShapeCylinder::intersect(const Ray& ray, double* tHit, DifferentialGeometry
                 }
             }
         }
-        if (caps.getValue() & Caps::bottom) {
+        if (m_caps & Caps::bottom) {
             double t = (box2d.min().y - rayO.z)*ray.invDirection().z;
             if (t < ray.tMin + 1e-5 || t > ray.tMax || (ans && t > *tHit)) {}
             else {
@@ -244,3 +260,9 @@ bool ShapeCylinder::intersect(const Ray& ray, double* tHit, DifferentialGeometry
 
     return ans;
 }
+
+void ShapeCylinder::onSensor(void* data, SoSensor*)
+{
+    ShapeCylinder* shape = (ShapeCylinder*) data;
+    shape->m_caps = shape->caps.getValue();
+}
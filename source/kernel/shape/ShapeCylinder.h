@@ -28,11 +28,21 @@ public:
     vec2d getUV(const vec3d& p) const;
     Box3D getBox(ProfileRT* profile) const;
     double getStepHint(double u, double v) const;
+    std::function<double(double, double)> getStepHints() const;
 
     void updateShapeGL(TShapeKit* parent);
+    bool hasQuadMesh() const {return true;}
     bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* aperture) const;
 
     SoSFEnum caps;
 
     NAME_ICON_FUNCTIONS("Cylinder", ":/shape/ShapeCylinder.png")
+
+protected:
+    ~ShapeCylinder();
+
+    int m_caps; // the field, for tracing
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
 };
@@ -1,5 +1,7 @@
 #include "ShapeParabolic.h"
 
+#include <Inventor/sensors/SoNodeSensor.h>
+
 #include "kernel/profiles/ProfileRT.h"
 #include "kernel/scene/TShapeKit.h"
 #include "kernel/shape/DifferentialGeometry.h"
@@ -10,6 +12,26 @@ using gcf::pow2;
 SO_NODE_SOURCE(ShapeParabolic)
 
 
+namespace {
+
+// step for focal lengths fX and fY at (u, v)
+double findStepHint(double fX, double fY, double u, double v)
+{
+    vec3d n = vec3d(-u/fX, -v/fY, 2.).normalized();
+
+//    double L = n.z/(2.*fX);
+//    double M = 0.;
+//    double N = n.z/(2.*fY);
+//    double radius = std::min(std::abs(1./L), std::abs(1./N));
+
+    double fMin = std::min(std::abs(fX), std::abs(fY));
+    double radius = 2*fMin/std::abs(n.z);
+    return 2*gcf::pi*radius/48;
+}
+
+}
+
+
 void ShapeParabolic::initClass()
 {
     SO_NODE_INIT_CLASS(ShapeParabolic, ShapeRT, "ShapeRT");
@@ -21,6 +43,16 @@ ShapeParabolic::ShapeParabolic()
 
     SO_NODE_ADD_FIELD( fX, (1.) );
     SO_NODE_ADD_FIELD( fY, (1.) );
+
+    onSensor(this, 0);
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+}
+
+ShapeParabolic::~ShapeParabolic()
+{
+    delete m_sensor;
 }
 
 vec3d ShapeParabolic::getPoint(double u, double v) const
@@ -43,16 +75,14 @@ vec3d ShapeParabolic::getNormal(double u, double v) const
 
 double ShapeParabolic::getStepHint(double u, double v) const
 {
-    vec3d n = getNormal(u, v);
-
-//    double L = n.z/(2.*fX.getValue());
-//    double M = 0.;
-//    double N = n.z/(2.*fY.getValue());
-//    double radius = std::min(std::abs(1./L), std::abs(1./N));
+    return findStepHint(fX.getValue(), fY.getValue(), u, v);
+}
 
-    double fMin = std::min(std::abs(fX.getValue()), std::abs(fY.getValue()));
-    double radius = 2*fMin/std::abs(n.z);
-    return 2*gcf::pi*radius/48;
+std::function<double(double, double)> ShapeParabolic::getStepHints() const
+{
+    const double x = fX.getValue();
+    const double y = fY.getValue();
+    return [x, y](double u, double v) {return findStepHint(x, y, u, v);};
 }
 
 void ShapeParabolic::updateShapeGL(TShapeKit* parent)
@@ -92,8 +122,8 @@ bool ShapeParabolic::intersect(const Ray& ray, double* tHit, DifferentialGeometr
 {
     const vec3d& rayO = ray.origin;
     const vec3d& rayD = ray.direction();
-    double gX = 1./fX.getValue();
-    double gY = 1./fY.getValue();
+    double gX = m_gX;
+    double gY = m_gY;
 
     double A = pow2(rayD.x)*gX + pow2(rayD.y)*gY;
     double B = 2.*(rayD.x*rayO.x*gX + rayD.y*rayO.y*gY) - 4.*rayD.z;
@@ -126,3 +156,10 @@ bool ShapeParabolic::intersect(const Ray& ray, double* tHit, DifferentialGeometr
     }
     return false;
 }
+
+void ShapeParabolic::onSensor(void* data, SoSensor*)
+{
+    ShapeParabolic* shape = (ShapeParabolic*) data;
+    shape->m_gX = 1./shape->fX.getValue();
+    shape->m_gY = 1./shape->fY.getValue();
+}
@@ -16,12 +16,24 @@ public:
 
     Box3D getBox(ProfileRT* profile) const;
     double getStepHint(double u, double v) const;
+    std::function<double(double, double)> getStepHints() const;
 
     void updateShapeGL(TShapeKit* parent);
+    bool hasQuadMesh() const {return true;}
     bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const;
 
     SoSFDouble fX;
     SoSFDouble fY;
 
     NAME_ICON_FUNCTIONS("Parabolic", ":/shape/ShapeParabolic.png")
+
+protected:
+    ~ShapeParabolic();
+
+    // the fields, for tracing
+    double m_gX; // 1/fX
+    double m_gY;
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
 };
@@ -24,3 +24,42 @@ void ShapePlanar::updateShapeGL(TShapeKit* parent)
 {
     makeQuadMesh(parent, QSize(2, 2));
 }
+
+/*!
+ * The plane z = 0 is crossed at t = -oz/dz, computed for all rays before the
+ * profile is tested on the points inside the range, so the first loop has
+ * no branches and vectorizes.
+ */
+void ShapePlanar::intersectBatch(ShapeRayBatch& batch, ProfileRT* profile) const
+{
+    const double* oz = batch.origin[2];
+    const double* dz = batch.direction[2];
+    for (int n = 0; n < batch.size; ++n) {
+        double t = -oz[n]/dz[n];
+        batch.isHit[n] = t >= batch.tMin[n] + 1e-5 && t <= batch.tMax[n];
+    }
+
+    for (int n = 0; n < batch.size; ++n) {
+        if (!batch.isHit[n]) continue;
+        double t = -oz[n]/dz[n];
+        vec3d pHit(
+            batch.origin[0][n] + batch.direction[0][n]*t,
+            batch.origin[1][n] + batch.direction[1][n]*t,
+            oz[n] + dz[n]*t
+        );
+        if (!profile->isInside(pHit.x, pHit.y)) {
+            batch.isHit[n] = false;
+            continue;
+        }
+        if (!batch.dg) continue;
+        batch.tMax[n] = t;
+        DifferentialGeometry& dg = batch.dg[n];
+        dg.point = pHit;
+        dg.uv = vec2d(pHit.x, pHit.y);
+        dg.dpdu = vec3d(1., 0., 0.);
+        dg.dpdv = vec3d(0., 1., 0.);
+        dg.normal = vec3d(0., 0., 1.);
+        dg.shape = this;
+        dg.isFront = dz[n] <= 0.;
+    }
+}
@@ -13,4 +13,8 @@ public:
 
     NAME_ICON_FUNCTIONS("Planar", ":/shape/ShapePlanar.png")
     void updateShapeGL(TShapeKit* parent);
+    bool hasQuadMesh() const {return true;}
+
+    void intersectBatch(ShapeRayBatch& batch, ProfileRT* profile) const;
+    enum {BatchVersion = 1};
 };
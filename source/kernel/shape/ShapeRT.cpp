@@ -1,5 +1,8 @@
 #include "ShapeRT.h"
 
+#include <memory>
+
+#include <QCryptographicHash>
 #include <QSize>
 #include <QVector>
 
@@ -7,9 +10,11 @@
 #include <Inventor/nodes/SoNormal.h>
 #include <Inventor/nodes/SoQuadMesh.h>
 #include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/lists/SoFieldList.h>
 
 #include "kernel/scene/TShapeKit.h"
 #include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/PolygonMeshCache.h"
 //#include "kernel/profiles/ProfileRT.h"
 #include "kernel/profiles/ProfileBox.h"
 #include "libraries/math/3D/vec3d.h"
@@ -89,6 +94,11 @@ double ShapeRT::getStepHint(double u, double v) const
     return 1.; // use infinity
 }
 
+std::function<double(double, double)> ShapeRT::getStepHints() const
+{
+    return [](double, double) {return 1.;};
+}
+
 Box3D ShapeRT::getBox(ProfileRT* profile) const
 {
     Box2D box = profile->getBox();
@@ -133,12 +143,76 @@ bool ShapeRT::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg,
     return true;
 }
 
+void ShapeRT::intersectBatch(ShapeRayBatch& batch, ProfileRT* profile) const
+{
+    for (int n = 0; n < batch.size; ++n) {
+        Ray ray(
+            vec3d(batch.origin[0][n], batch.origin[1][n], batch.origin[2][n]),
+            vec3d(batch.direction[0][n], batch.direction[1][n], batch.direction[2][n]),
+            batch.tMin[n], batch.tMax[n]
+        );
+        bool isHit;
+        if (batch.dg) {
+            double tHit = 0.;
+            isHit = intersect(ray, &tHit, &batch.dg[n], profile);
+            if (isHit) batch.tMax[n] = tHit;
+        } else
+            isHit = intersectP(ray, profile);
+        batch.isHit[n] = isHit;
+    }
+}
+
 struct MeshDensityShape: public MeshDensity
 {
-    virtual double operator()(double u, double v) {return shape->getStepHint(u, v);}
-    ShapeRT* shape;
+    virtual double operator()(double u, double v) {return stepHints(u, v);}
+    std::function<double(double, double)> stepHints;
 };
 
+namespace {
+
+// the mesh of polygon refined by the step hints of a shape, see ShapeRT::getStepHints
+PolygonMeshCache::Mesh triangulate(const std::function<double(double, double)>& stepHints, const QPolygonF& polygon)
+{
+    MeshDensityShape mds;
+    mds.stepHints = stepHints;
+    std::shared_ptr<PolygonMesh> mesh = std::make_shared<PolygonMesh>(polygon);
+    if (!mesh->makeMesh(1e8, mds))
+        return nullptr;
+    return mesh;
+}
+
+// the type and fields of shape, which decide its step hints, and the polygon
+QByteArray polygonKey(ShapeRT* shape, const QPolygonF& polygon)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray(shape->getTypeId().getName().getString()));
+    SoFieldList fields;
+    shape->getFields(fields);
+    for (int n = 0; n < fields.getLength(); ++n) {
+        SbString text;
+        fields[n]->get(text);
+        hash.addData(QByteArrayView(text.getString(), text.getLength() + 1));
+    }
+    hash.addData(QByteArrayView(reinterpret_cast<const char*>(polygon.constData()), polygon.size()*qsizetype(sizeof(QPointF))));
+    return hash.result();
+}
+
+} // namespace
+
+bool ShapeRT::findHeight(double x, double y, double* z, ProfileRT* profile) const
+{
+    if (!profile) return false;
+    Box3D box = getBox(profile);
+    if (!box.isValid()) return false;
+    double zTop = box.max().z + 1. + 0.01*box.size().max();
+    Ray ray(vec3d(x, y, zTop), vec3d(0., 0., -1.));
+    double tHit = 0.;
+    DifferentialGeometry dg;
+    if (!intersect(ray, &tHit, &dg, profile)) return false;
+    *z = zTop - tHit;
+    return true;
+}
+
 void ShapeRT::makeQuadMesh(TShapeKit* parent, const QSize& dims, bool forceIndexed)
 {
     MaterialGL* mGL = (MaterialGL*) parent->material.getValue();
@@ -149,25 +223,21 @@ void ShapeRT::makeQuadMesh(TShapeKit* parent, const QSize& dims, bool forceIndex
 
     if (ProfilePolygon* profilePolygon = dynamic_cast<ProfilePolygon*>(profile))
     {
-        // call
+        // the mesh of the first facet of its kind, see prepareMeshes
         const QPolygonF& qpolygon = profilePolygon->getPolygon();
 //        QSizeF rect = qpolygon.boundingRect().size();
 //        double s = std::min(rect.width()/(dims.width() - 1), rect.height()/(dims.height() - 1));
 
-        MeshDensityShape mds;
-        mds.shape = (ShapeRT*) parent->shapeRT.getValue();
-
-
-        PolygonMesh polygonMesh(qpolygon);
-//        if (!polygonMesh.makeMesh(s))
-//            return;
-        if (!polygonMesh.makeMesh(1e8, mds))
+        ShapeRT* shape = (ShapeRT*) parent->shapeRT.getValue();
+        PolygonMeshCache::Mesh polygonMesh = PolygonMeshCache::find(polygonKey(shape, qpolygon),
+            [shape, &qpolygon]() {return triangulate(shape->getStepHints(), qpolygon);});
+        if (!polygonMesh)
             return;
 
         // fill
         QVector<SbVec3f> vertices;
         QVector<SbVec3f> normals;
-        for (const vec2d& uv : polygonMesh.getPoints()) {
+        for (const vec2d& uv : polygonMesh->getPoints()) {
             vec3d point = getPoint(uv.x, uv.y);
             vec3d normal = getNormal(uv.x, uv.y);
             if (reverseNormals) normal = -normal;
@@ -176,7 +246,7 @@ void ShapeRT::makeQuadMesh(TShapeKit* parent, const QSize& dims, bool forceIndex
         }
 
         QVector<int> faces;
-        for (const auto& tri : polygonMesh.getTriangles()) {
+        for (const auto& tri : polygonMesh->getTriangles()) {
             faces << tri.a;
             faces << tri.b;
             faces << tri.c;
@@ -240,3 +310,19 @@ void ShapeRT::makeQuadMesh(TShapeKit* parent, const QSize& dims, bool forceIndex
         }
     }
 }
+
+void ShapeRT::prepareMeshes(const std::vector<TShapeKit*>& kits)
+{
+    std::vector<std::pair<QByteArray, PolygonMeshCache::Maker>> jobs;
+    for (TShapeKit* kit : kits) {
+        ShapeRT* shape = (ShapeRT*) kit->shapeRT.getValue();
+        ProfilePolygon* profile = dynamic_cast<ProfilePolygon*>((ProfileRT*) kit->profileRT.getValue());
+        if (!shape || !profile || !shape->hasQuadMesh())
+            continue;
+        // the nodes belong to this thread, the makers get copies of what they read
+        const QPolygonF polygon = profile->getPolygon();
+        std::function<double(double, double)> stepHints = shape->getStepHints();
+        jobs.emplace_back(polygonKey(shape, polygon), [stepHints, polygon]() {return triangulate(stepHints, polygon);});
+    }
+    PolygonMeshCache::prepare(jobs);
+}
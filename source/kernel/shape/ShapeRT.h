@@ -1,5 +1,8 @@
 #pragma once
 
+#include <functional>
+#include <vector>
+
 #include "kernel/node/TNode.h"
 
 struct vec2d;
@@ -12,6 +15,23 @@ class TShapeKit;
 class ProfileRT;
 class Transform;
 
+//! ShapeRayBatch holds rays in the frame of a shape as arrays, for ShapeRT::intersectBatch.
+/*!
+ * Rays are read from origin, direction, tMin and tMax, each array of size
+ * elements. For every ray isHit is set. When dg is not null it is filled
+ * for the closest hits and tMax becomes their distance, otherwise any hit
+ * is looked for and tMax is kept.
+ */
+struct ShapeRayBatch
+{
+    int size = 0;
+    const double* origin[3] = {};
+    const double* direction[3] = {};
+    const double* tMin = nullptr;
+    double* tMax = nullptr;
+    unsigned char* isHit = nullptr;
+    DifferentialGeometry* dg = nullptr;
+};
 
 class TONATIUH_KERNEL ShapeRT: public TNode
 {
@@ -30,13 +50,37 @@ public:
 
     virtual vec2d getUV(const vec3d& p) const;
     virtual double getStepHint(double u, double v) const;
+    // getStepHint over copies of the fields, safe to call off the scene thread;
+    // shapes overriding getStepHint override it too
+    virtual std::function<double(double, double)> getStepHints() const;
+    // ray tracing data depending on the kit, built even when the GL geometry is deferred
+    virtual void updateShapeRT(TShapeKit* /*parent*/) {}
+    // GL geometry, after updateShapeRT
     virtual void updateShapeGL(TShapeKit* /*parent*/) {}
+    // whether updateShapeGL meshes the profile by makeQuadMesh
+    virtual bool hasQuadMesh() const {return false;}
+    // triangulates the polygon profiles of the kits whose shapes have quad
+    // meshes, once per distinct shape and polygon and in parallel, into the
+    // PolygonMeshCache that makeQuadMesh reads
+    static void prepareMeshes(const std::vector<TShapeKit*>& kits);
 
     virtual Box3D getBox(ProfileRT* profile) const;
     // with computing dg, ray in local coordinates
     virtual bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const;
     // without computing dg
     virtual bool intersectP(const Ray& ray, ProfileRT* profile) const {return intersect(ray, 0, 0, profile);}
+    // the rays of a batch in order, by intersect or intersectP unless the
+    // shape knows better; shapes that do also raise BatchVersion
+    virtual void intersectBatch(ShapeRayBatch& batch, ProfileRT* profile) const;
+    enum {BatchVersion = 0};
+    // z of the highest point above (x, y) in local coordinates, by a ray down
+    // through the box unless the shape knows better; false if there is none,
+    // and without profile for shapes that need one
+    virtual bool findHeight(double x, double y, double* z, ProfileRT* profile) const;
+
+    // triangles traced and bytes held by triangulated shapes, for scene statistics
+    virtual qulonglong getTriangleCount() const {return 0;}
+    virtual qulonglong getMemoryUsage() const {return 0;}
 
     NAME_ICON_FUNCTIONS("X", ":/ShapeX.png")
 
@@ -57,6 +101,8 @@ class ShapeFactory: public TFactory
 public:
     ShapeRT* create() const = 0;
     ShapeRT* create(QVector<QVariant> /*parameters*/) const {return create();}
+    // version of ShapeRT::intersectBatch the shape implements, 0 for one by scalar calls
+    virtual int batchVersion() const {return 0;}
 };
 
 Q_DECLARE_INTERFACE(ShapeFactory, "tonatiuh.ShapeFactory")
@@ -72,4 +118,5 @@ public:
     QIcon icon() const {return QIcon(T::getClassIcon());}
     void init() const {T::initClass();}
     T* create() const {return new T;}
+    int batchVersion() const {return T::BatchVersion;}
 };
@@ -122,6 +122,11 @@ double ShapeSphere::getStepHint(double u, double v) const
     return 2*gcf::pi/48;
 }
 
+std::function<double(double, double)> ShapeSphere::getStepHints() const
+{
+    return [](double, double) {return 2*gcf::pi/48;};
+}
+
 void ShapeSphere::updateShapeGL(TShapeKit* parent)
 {
     ProfileRT* profile = (ProfileRT*) parent->profileRT.getValue();
@@ -19,8 +19,10 @@ public:
     vec2d getUV(const vec3d& p) const;
     Box3D getBox(ProfileRT* profile) const;
     double getStepHint(double u, double v) const;
+    std::function<double(double, double)> getStepHints() const;
 
     void updateShapeGL(TShapeKit* parent);
+    bool hasQuadMesh() const {return true;}
     bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const;
 
     NAME_ICON_FUNCTIONS("Sphere", ":/shape/ShapeSphere.png")
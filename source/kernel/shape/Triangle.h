@@ -1,11 +1,13 @@
 #pragma once
 
+#include "kernel/TonatiuhKernel.h"
+
 #include "libraries/math/3D/Box3D.h"
 
 struct DifferentialGeometry;
 
 
-class Triangle
+class TONATIUH_KERNEL Triangle
 {
 
 public:
@@ -27,7 +29,7 @@ public:
 
     bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg) const;
 
-private:  
+private:
     vec3d m_pA, m_pB, m_pC;
     vec3d m_nA, m_nB, m_nC;
 
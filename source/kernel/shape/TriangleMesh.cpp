@@ -0,0 +1,366 @@
+#include "TriangleMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "kernel/shape/DifferentialGeometry.h"
+#include "libraries/math/CpuDispatch.h"
+#include "libraries/math/gcf.h"
+
+#if defined(__AVX__) || defined(TONATIUH_DISPATCH_AVX2)
+#include <immintrin.h>
+#endif
+#if defined(__AVX__)
+// 256-bit lanes only
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TONATIUH_MESH_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TONATIUH_MESH_NEON
+#endif
+
+namespace
+{
+const int Width = Box3DPack::Width;
+
+// the vertex arrays and tolerances of a mesh, as the lanes read them
+struct MeshLanes
+{
+    const double* a[3];
+    const double* b[3];
+    const double* c[3];
+    const double* tolerance;
+};
+
+namespace base {
+#define TONATIUH_LANES_TARGET
+#include "TriangleMeshLanes.h"
+#undef TONATIUH_LANES_TARGET
+}
+
+#if defined(TONATIUH_DISPATCH_AVX2) && !defined(__AVX__)
+namespace avx2 {
+#define TONATIUH_LANES_AVX
+#define TONATIUH_LANES_TARGET TONATIUH_TARGET_AVX2
+#include "TriangleMeshLanes.h"
+#undef TONATIUH_LANES_TARGET
+#undef TONATIUH_LANES_AVX
+}
+
+// chosen once, the branch is then always predicted
+const bool UseAVX2 = CpuDispatch::level() == CpuDispatch::AVX2;
+#endif
+
+static_assert(std::is_trivially_copyable<BVHNode4>::value, "BVHNode4 is written as bytes");
+
+const int Alignment = TriangleMesh::Alignment;
+
+bool MappedCaches = false;
+
+void writeBytes(std::vector<char>& data, const void* p, size_t size)
+{
+    const char* bytes = static_cast<const char*>(p);
+    data.insert(data.end(), bytes, bytes + size);
+}
+
+bool readBytes(const char*& data, const char* end, void* p, size_t size)
+{
+    if (size_t(end - data) < size) return false;
+    std::memcpy(p, data, size);
+    data += size;
+    return true;
+}
+
+// the values of an array start Alignment bytes apart from the copy at base
+template<class T>
+void writeArray(std::vector<char>& data, size_t base, const T* values, std::uint64_t n)
+{
+    writeBytes(data, &n, sizeof(n));
+    data.resize(base + (data.size() - base + Alignment - 1)/Alignment*Alignment);
+    writeBytes(data, values, n*sizeof(T));
+}
+
+template<class T>
+const T* takeArray(const char*& data, const char* base, const char* end, std::uint64_t* n)
+{
+    if (!readBytes(data, end, n, sizeof(*n))) return nullptr;
+    const size_t padding = (Alignment - size_t(data - base)%Alignment)%Alignment;
+    if (size_t(end - data) < padding) return nullptr;
+    data += padding;
+    if (*n > std::uint64_t(end - data)/sizeof(T)) return nullptr;
+    const T* values = reinterpret_cast<const T*>(data);
+    data += *n*sizeof(T);
+    return values;
+}
+}
+
+
+TriangleMesh::TriangleMesh(int leafSize):
+    m_leafSize(leafSize)
+{
+
+}
+
+void TriangleMesh::clear()
+{
+    m_size = 0;
+    m_input.clear();
+    m_a = Vertices();
+    m_b = Vertices();
+    m_c = Vertices();
+    m_tolerance = Array<double>();
+    m_normals = Array<float>();
+    m_nodes = Array<BVHNode4>();
+    m_box = Box3D();
+    m_isMapped = false;
+}
+
+void TriangleMesh::setMappedCaches(bool on)
+{
+    MappedCaches = on;
+}
+
+bool TriangleMesh::isMappedCaches()
+{
+    return MappedCaches;
+}
+
+void TriangleMesh::addTriangle(
+    const vec3d& pA, const vec3d& pB, const vec3d& pC,
+    const vec3d& nA, const vec3d& nB, const vec3d& nC)
+{
+    m_input.push_back(Triangle(pA, pB, pC, nA, nB, nC));
+}
+
+void TriangleMesh::build()
+{
+    std::vector<Box3D> boxes;
+    boxes.reserve(m_input.size());
+    for (const Triangle& t : m_input)
+        boxes.push_back(t.box());
+
+    BVHBuilder builder(m_leafSize);
+    builder.build(boxes);
+    builder.reorder(m_input);
+    build(builder.getNodes());
+}
+
+void TriangleMesh::build(std::span<const BVHNode4> nodes)
+{
+    m_box = Box3D();
+    for (const Triangle& t : m_input)
+        m_box << t.box();
+
+    m_nodes = Array<BVHNode4>();
+    HugePages::assign(m_nodes.values, nodes.begin(), nodes.end());
+    m_nodes.bind();
+    m_isMapped = false;
+
+    // a leaf reads full lanes, the padding lanes can never be hit
+    m_size = int(m_input.size());
+    int nPadded = m_size + Width - 1;
+    m_a.resize(nPadded);
+    m_b.resize(nPadded);
+    m_c.resize(nPadded);
+    m_tolerance = Array<double>();
+    HugePages::reserve(m_tolerance.values, nPadded);
+    m_tolerance.values.assign(nPadded, gcf::infinity);
+    m_normals = Array<float>();
+    HugePages::reserve(m_normals.values, 9*m_size);
+    m_normals.values.resize(9*m_size);
+
+    for (int n = 0; n < m_size; ++n)
+    {
+        const Triangle& t = m_input[n];
+        m_a.set(n, t.pA());
+        m_b.set(n, t.pB());
+        m_c.set(n, t.pC());
+        m_tolerance.values[n] = (t.pA() - t.pC()).norm()*(t.pB() - t.pC()).norm()*1e-6;
+
+        float* normals = &m_normals.values[9*n];
+        const vec3d* ns[] = {&t.nA(), &t.nB(), &t.nC()};
+        for (int k = 0; k < 3; ++k) {
+            normals[3*k] = float(ns[k]->x);
+            normals[3*k + 1] = float(ns[k]->y);
+            normals[3*k + 2] = float(ns[k]->z);
+        }
+    }
+    m_tolerance.bind();
+    m_normals.bind();
+    m_input = std::vector<Triangle>();
+}
+
+void TriangleMesh::write(std::vector<char>& data) const
+{
+    const size_t base = data.size();
+    const std::int32_t sizes[] = {m_leafSize, m_size};
+    writeBytes(data, sizes, sizeof(sizes));
+    for (const Vertices* vs : {&m_a, &m_b, &m_c}) {
+        writeArray(data, base, vs->x.data, vs->x.size);
+        writeArray(data, base, vs->y.data, vs->y.size);
+        writeArray(data, base, vs->z.data, vs->z.size);
+    }
+    writeArray(data, base, m_tolerance.data, m_tolerance.size);
+    writeArray(data, base, m_normals.data, m_normals.size);
+    writeArray(data, base, m_nodes.data, m_nodes.size);
+    const vec3d corners[] = {m_box.min(), m_box.max()};
+    writeBytes(data, corners, sizeof(corners));
+}
+
+bool TriangleMesh::read(const char*& data, const char* end)
+{
+    return load(data, end, false);
+}
+
+bool TriangleMesh::map(const char*& data, const char* end)
+{
+    return load(data, end, true);
+}
+
+bool TriangleMesh::load(const char*& data, const char* end, bool isView)
+{
+    clear();
+    const char* base = data;
+    std::int32_t sizes[2];
+    vec3d corners[2];
+    bool ok = readBytes(data, end, sizes, sizeof(sizes));
+
+    // copied, or viewed where aligned for their type
+    auto take = [&](auto& array) {
+        using T = typename std::remove_reference_t<decltype(array)>::value_type;
+        if (!ok) return;
+        std::uint64_t n = 0;
+        const T* values = takeArray<T>(data, base, end, &n);
+        ok = values != nullptr;
+        if (!ok) return;
+        if (isView) {
+            ok = reinterpret_cast<std::uintptr_t>(values)%alignof(T) == 0;
+            array.view(values, n);
+            return;
+        }
+        HugePages::reserve(array.values, n);
+        array.values.resize(n);
+        std::memcpy(array.values.data(), values, n*sizeof(T));
+        array.bind();
+    };
+    for (Vertices* vs : {&m_a, &m_b, &m_c}) {
+        take(vs->x);
+        take(vs->y);
+        take(vs->z);
+    }
+    take(m_tolerance);
+    take(m_normals);
+    take(m_nodes);
+    ok = ok && readBytes(data, end, corners, sizeof(corners));
+
+    // the lanes read past the last triangle must exist
+    size_t nPadded = size_t(ok ? sizes[1] : 0) + Width - 1;
+    for (const Vertices* vs : {&m_a, &m_b, &m_c})
+        ok = ok && vs->x.size == nPadded && vs->y.size == nPadded && vs->z.size == nPadded;
+    ok = ok && m_tolerance.size == nPadded && m_normals.size == 9*size_t(sizes[1]);
+    if (!ok) {
+        clear();
+        return false;
+    }
+
+    m_leafSize = sizes[0];
+    m_size = sizes[1];
+    m_isMapped = isView;
+    if (corners[0] <= corners[1]) { // an empty box stays empty
+        m_box << corners[0];
+        m_box << corners[1];
+    }
+    return true;
+}
+
+Triangle TriangleMesh::getTriangle(int n) const
+{
+    const float* normals = &m_normals[9*n];
+    return Triangle(
+        m_a.get(n), m_b.get(n), m_c.get(n),
+        vec3d(normals[0], normals[1], normals[2]),
+        vec3d(normals[3], normals[4], normals[5]),
+        vec3d(normals[6], normals[7], normals[8])
+    );
+}
+
+/*!
+ * Same arithmetic as Triangle::intersect, evaluated for four triangles per step.
+ */
+qulonglong TriangleMesh::getMemoryUsage() const
+{
+    auto bytes = [](const auto& v) {return qulonglong(v.capacity()*sizeof(v[0]));};
+    qulonglong ans = bytes(m_input) + bytes(m_tolerance.values) + bytes(m_normals.values) + bytes(m_nodes.values);
+    for (const Vertices* v : {&m_a, &m_b, &m_c})
+        ans += bytes(v->x.values) + bytes(v->y.values) + bytes(v->z.values);
+    return ans;
+}
+
+bool TriangleMesh::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg) const
+{
+    Ray rayT = ray;
+    const vec3d& d = ray.direction();
+    const MeshLanes mesh = {
+        {m_a.x.data, m_a.y.data, m_a.z.data},
+        {m_b.x.data, m_b.y.data, m_b.z.data},
+        {m_c.x.data, m_c.y.data, m_c.z.data},
+        m_tolerance.data
+    };
+
+    int best = -1;
+    double uBest = 0.;
+    double vBest = 0.;
+    traverseBVH(getNodes(), rayT, [&](int begin, int count) {
+#if defined(TONATIUH_DISPATCH_AVX2) && !defined(__AVX__)
+        if (UseAVX2) {
+            avx2::findClosest(mesh, begin, count, rayT, best, uBest, vBest);
+            return;
+        }
+#endif
+        base::findClosest(mesh, begin, count, rayT, best, uBest, vBest);
+    });
+    if (best < 0) return false;
+
+    // normal
+    const float* normals = &m_normals[9*best];
+    double wBest = 1. - uBest - vBest;
+    vec3d vN(
+        uBest*normals[0] + vBest*normals[3] + wBest*normals[6],
+        uBest*normals[1] + vBest*normals[4] + wBest*normals[7],
+        uBest*normals[2] + vBest*normals[5] + wBest*normals[8]
+    );
+    vN.normalize();
+    vec3d vU = vN.findOrthogonal().normalize();
+    vec3d vV = cross(vN, vU);
+
+    *tHit = rayT.tMax;
+    dg->point = ray.point(rayT.tMax);
+    dg->uv = vec2d(uBest, vBest);
+    dg->dpdu = vU;
+    dg->dpdv = vV;
+    dg->normal = vN;
+    dg->shape = 0;
+    dg->isFront = dot(vN, d) <= 0.;
+    return true;
+}
+
+// stops at the first triangle hit, in whatever order the leaves come
+bool TriangleMesh::intersectP(const Ray& ray) const
+{
+    const MeshLanes mesh = {
+        {m_a.x.data, m_a.y.data, m_a.z.data},
+        {m_b.x.data, m_b.y.data, m_b.z.data},
+        {m_c.x.data, m_c.y.data, m_c.z.data},
+        m_tolerance.data
+    };
+    return traverseBVHUntil(getNodes(), ray, [&](int begin, int count) {
+#if defined(TONATIUH_DISPATCH_AVX2) && !defined(__AVX__)
+        if (UseAVX2) return avx2::findAny(mesh, begin, count, ray);
+#endif
+        return base::findAny(mesh, begin, count, ray);
+    });
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+#include <span>
+#include <vector>
+
+#include "kernel/run/HugePages.h"
+#include "kernel/shape/BVH.h"
+#include "kernel/shape/Triangle.h"
+
+struct DifferentialGeometry;
+
+
+//! TriangleMesh is the ray tracing mesh of the triangulated shapes.
+/*!
+ * Vertices are kept as structure-of-arrays in leaf order of a BVHBuilder
+ * hierarchy and tested four triangles at a time (Moller-Trumbore with AVX,
+ * SSE2 or NEON lanes, scalar elsewhere). Vertex normals live in a separate
+ * single-precision array that is read only for the closest hit.
+ * The built arrays take huge pages when HugePages is enabled.
+ * Fill the mesh with addTriangle() and call build() before intersecting.
+ *
+ * map() views the arrays of a cache written by write() in place instead of
+ * copying them, so processes mapping the same cache file read-only share its
+ * pages and a large mesh is held once on the machine however many use it.
+ */
+class TONATIUH_KERNEL TriangleMesh
+{
+public:
+    explicit TriangleMesh(int leafSize = 4);
+
+    void clear();
+    void reserve(int n) {m_input.reserve(n);}
+    void addTriangle(
+        const vec3d& pA, const vec3d& pB, const vec3d& pC,
+        const vec3d& nA, const vec3d& nB, const vec3d& nC
+    );
+    void build();
+    // the triangles added being in the leaf order of nodes, as getTriangle()
+    // gives those of a built mesh
+    void build(std::span<const BVHNode4> nodes);
+
+    bool isEmpty() const {return m_nodes.size == 0;}
+    int size() const {return m_size;}
+    const Box3D& getBox() const {return m_box;}
+    Triangle getTriangle(int n) const;
+    std::span<const BVHNode4> getNodes() const {return {m_nodes.data, m_nodes.size};}
+    // bytes of the built mesh and its hierarchy, without those of a mapped cache
+    qulonglong getMemoryUsage() const;
+    bool isMapped() const {return m_isMapped;}
+
+    // closest hit with t < ray.tMax
+    bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg) const;
+    // any hit with t < ray.tMax, for occlusion
+    bool intersectP(const Ray& ray) const;
+
+    // binary copy of a built mesh for file caches, its arrays aligned to
+    // Alignment bytes from the start of the copy; read() advances data and
+    // fails on truncated input
+    static const int Alignment = 64;
+    void write(std::vector<char>& data) const;
+    bool read(const char*& data, const char* end);
+    // as read, the arrays viewed in data, which has to stay mapped until the
+    // mesh is cleared; fails, leaving the mesh empty, where they are misaligned
+    bool map(const char*& data, const char* end);
+
+    // caches of meshes are to be mapped rather than read, for the shapes
+    // reading them, from now on
+    static void setMappedCaches(bool on);
+    static bool isMappedCaches();
+
+private:
+    // an array built or read here, or a view of a mapped cache
+    template<class T>
+    struct Array {
+        using value_type = T;
+        std::vector<T> values; // empty for a view
+        const T* data = nullptr;
+        size_t size = 0;
+
+        Array() = default;
+        Array(const Array& a): values(a.values), data(a.data), size(a.size) {if (a.data == a.values.data()) bind();}
+        Array(Array&&) = default;
+        Array& operator=(const Array& a) {
+            if (this == &a) return *this;
+            values = a.values;
+            data = a.data;
+            size = a.size;
+            if (a.data == a.values.data()) bind();
+            return *this;
+        }
+        Array& operator=(Array&&) = default;
+
+        void bind() {data = values.data(); size = values.size();}
+        void view(const T* p, size_t n) {values = std::vector<T>(); data = p; size = n;}
+        const T& operator[](size_t n) const {return data[n];}
+    };
+
+    struct Vertices {
+        Array<double> x;
+        Array<double> y;
+        Array<double> z;
+        void resize(int n) {
+            for (Array<double>* v : {&x, &y, &z}) {
+                HugePages::reserve(v->values, n);
+                v->values.resize(n);
+                v->bind();
+            }
+        }
+        vec3d get(int n) const {return vec3d(x[n], y[n], z[n]);}
+        void set(int n, const vec3d& v) {x.values[n] = v.x; y.values[n] = v.y; z.values[n] = v.z;}
+    };
+
+    bool load(const char*& data, const char* end, bool isView);
+
+    int m_leafSize;
+    int m_size = 0;
+    std::vector<Triangle> m_input; // until build
+
+    // hot data, padded with degenerate lanes
+    Vertices m_a;
+    Vertices m_b;
+    Vertices m_c;
+    Array<double> m_tolerance;
+
+    // cold data
+    Array<float> m_normals; // 9 per triangle
+
+    Array<BVHNode4> m_nodes;
+    Box3D m_box;
+    bool m_isMapped = false;
+};
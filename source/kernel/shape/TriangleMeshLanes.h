@@ -0,0 +1,170 @@
+// The lanes of TriangleMesh, included by TriangleMesh.cpp once per instruction
+// set into a namespace of its own, with every function marked by
+// TONATIUH_LANES_TARGET and the 256-bit lanes chosen by TONATIUH_LANES_AVX.
+// It has no include guard and needs the intrinsics included before.
+
+// four double lanes on the widest instruction set available
+struct D4
+{
+#if defined(__AVX__) || defined(TONATIUH_LANES_AVX)
+    __m256d v;
+    TONATIUH_LANES_TARGET static D4 set(double s) {return {_mm256_set1_pd(s)};}
+    TONATIUH_LANES_TARGET static D4 load(const double* p) {return {_mm256_loadu_pd(p)};}
+    TONATIUH_LANES_TARGET void store(double* p) const {_mm256_storeu_pd(p, v);}
+    TONATIUH_LANES_TARGET friend D4 operator+(D4 a, D4 b) {return {_mm256_add_pd(a.v, b.v)};}
+    TONATIUH_LANES_TARGET friend D4 operator-(D4 a, D4 b) {return {_mm256_sub_pd(a.v, b.v)};}
+    TONATIUH_LANES_TARGET friend D4 operator*(D4 a, D4 b) {return {_mm256_mul_pd(a.v, b.v)};}
+    TONATIUH_LANES_TARGET friend D4 operator/(D4 a, D4 b) {return {_mm256_div_pd(a.v, b.v)};}
+    TONATIUH_LANES_TARGET friend int operator<=(D4 a, D4 b) {return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ));}
+    TONATIUH_LANES_TARGET friend int operator<(D4 a, D4 b) {return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ));}
+    TONATIUH_LANES_TARGET D4 abs() const {return {_mm256_andnot_pd(_mm256_set1_pd(-0.), v)};}
+#elif defined(TONATIUH_MESH_SSE2)
+    __m128d lo, hi;
+    static D4 set(double s) {__m128d t = _mm_set1_pd(s); return {t, t};}
+    static D4 load(const double* p) {return {_mm_loadu_pd(p), _mm_loadu_pd(p + 2)};}
+    void store(double* p) const {_mm_storeu_pd(p, lo); _mm_storeu_pd(p + 2, hi);}
+    friend D4 operator+(D4 a, D4 b) {return {_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi)};}
+    friend D4 operator-(D4 a, D4 b) {return {_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi)};}
+    friend D4 operator*(D4 a, D4 b) {return {_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi)};}
+    friend D4 operator/(D4 a, D4 b) {return {_mm_div_pd(a.lo, b.lo), _mm_div_pd(a.hi, b.hi)};}
+    friend int operator<=(D4 a, D4 b) {return _mm_movemask_pd(_mm_cmple_pd(a.lo, b.lo)) | _mm_movemask_pd(_mm_cmple_pd(a.hi, b.hi)) << 2;}
+    friend int operator<(D4 a, D4 b) {return _mm_movemask_pd(_mm_cmplt_pd(a.lo, b.lo)) | _mm_movemask_pd(_mm_cmplt_pd(a.hi, b.hi)) << 2;}
+    D4 abs() const {__m128d s = _mm_set1_pd(-0.); return {_mm_andnot_pd(s, lo), _mm_andnot_pd(s, hi)};}
+#elif defined(TONATIUH_MESH_NEON)
+    float64x2_t lo, hi;
+    static D4 set(double s) {float64x2_t t = vdupq_n_f64(s); return {t, t};}
+    static D4 load(const double* p) {return {vld1q_f64(p), vld1q_f64(p + 2)};}
+    void store(double* p) const {vst1q_f64(p, lo); vst1q_f64(p + 2, hi);}
+    friend D4 operator+(D4 a, D4 b) {return {vaddq_f64(a.lo, b.lo), vaddq_f64(a.hi, b.hi)};}
+    friend D4 operator-(D4 a, D4 b) {return {vsubq_f64(a.lo, b.lo), vsubq_f64(a.hi, b.hi)};}
+    friend D4 operator*(D4 a, D4 b) {return {vmulq_f64(a.lo, b.lo), vmulq_f64(a.hi, b.hi)};}
+    friend D4 operator/(D4 a, D4 b) {return {vdivq_f64(a.lo, b.lo), vdivq_f64(a.hi, b.hi)};}
+    static int mask(uint64x2_t lo, uint64x2_t hi) {
+        return int(vgetq_lane_u64(lo, 0) & 1) | int(vgetq_lane_u64(lo, 1) & 1) << 1 |
+               int(vgetq_lane_u64(hi, 0) & 1) << 2 | int(vgetq_lane_u64(hi, 1) & 1) << 3;
+    }
+    friend int operator<=(D4 a, D4 b) {return mask(vcleq_f64(a.lo, b.lo), vcleq_f64(a.hi, b.hi));}
+    friend int operator<(D4 a, D4 b) {return mask(vcltq_f64(a.lo, b.lo), vcltq_f64(a.hi, b.hi));}
+    D4 abs() const {return {vabsq_f64(lo), vabsq_f64(hi)};}
+#else
+    double v[Width];
+    template<class F> static D4 map(F f) {D4 r; for (int n = 0; n < Width; ++n) r.v[n] = f(n); return r;}
+    static D4 set(double s) {return map([=](int) {return s;});}
+    static D4 load(const double* p) {return map([=](int n) {return p[n];});}
+    void store(double* p) const {for (int n = 0; n < Width; ++n) p[n] = v[n];}
+    friend D4 operator+(D4 a, D4 b) {return map([&](int n) {return a.v[n] + b.v[n];});}
+    friend D4 operator-(D4 a, D4 b) {return map([&](int n) {return a.v[n] - b.v[n];});}
+    friend D4 operator*(D4 a, D4 b) {return map([&](int n) {return a.v[n]*b.v[n];});}
+    friend D4 operator/(D4 a, D4 b) {return map([&](int n) {return a.v[n]/b.v[n];});}
+    friend int operator<=(D4 a, D4 b) {int m = 0; for (int n = 0; n < Width; ++n) m |= int(a.v[n] <= b.v[n]) << n; return m;}
+    friend int operator<(D4 a, D4 b) {int m = 0; for (int n = 0; n < Width; ++n) m |= int(a.v[n] < b.v[n]) << n; return m;}
+    D4 abs() const {return map([&](int n) {return std::abs(v[n]);});}
+#endif
+};
+
+struct V4
+{
+    D4 x, y, z;
+};
+
+TONATIUH_LANES_TARGET inline V4 load(const double* x, const double* y, const double* z, int n)
+{
+    return {D4::load(x + n), D4::load(y + n), D4::load(z + n)};
+}
+
+TONATIUH_LANES_TARGET inline V4 operator-(const V4& a, const V4& b) {return {a.x - b.x, a.y - b.y, a.z - b.z};}
+
+TONATIUH_LANES_TARGET inline D4 dot(const V4& a, const V4& b) {return a.x*b.x + a.y*b.y + a.z*b.z;}
+
+TONATIUH_LANES_TARGET inline V4 cross(const V4& a, const V4& b)
+{
+    return {a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x};
+}
+
+// Moller-Trumbore for the lanes in mask, the lanes hit in [tMin + tolerance, tMax)
+TONATIUH_LANES_TARGET inline int hitLanes(
+    const V4& pA, const V4& pB, const V4& pC, D4 tolerance,
+    const V4& rO, const V4& rD, double tMin, double tMax, int mask,
+    D4& t, D4& u, D4& v)
+{
+    const D4 zero = D4::set(0.);
+    const D4 one = D4::set(1.);
+
+    V4 eu = pA - pC;
+    V4 ev = pB - pC;
+    V4 qv = cross(rD, ev);
+    D4 det = dot(eu, qv);
+    mask &= tolerance <= det.abs();
+    if (!mask) return 0;
+    D4 detInv = one/det;
+
+    V4 qt = rO - pC;
+    u = dot(qv, qt)*detInv;
+    mask &= (zero <= u) & (u <= one);
+    if (!mask) return 0;
+
+    V4 qu = cross(qt, eu);
+    v = dot(qu, rD)*detInv;
+    mask &= (zero <= v) & (u + v <= one);
+    if (!mask) return 0;
+
+    t = dot(qu, ev)*detInv;
+    return mask & (D4::set(tMin) + tolerance <= t) & (t < D4::set(tMax));
+}
+
+// the closest hit with the triangles [begin, begin + count), lowering ray.tMax;
+// best and its barycentric coordinates are kept when none is closer
+TONATIUH_LANES_TARGET inline void findClosest(const MeshLanes& mesh, int begin, int count,
+    const Ray& ray, int& best, double& uBest, double& vBest)
+{
+    const vec3d& d = ray.direction();
+    const V4 rO = {D4::set(ray.origin.x), D4::set(ray.origin.y), D4::set(ray.origin.z)};
+    const V4 rD = {D4::set(d.x), D4::set(d.y), D4::set(d.z)};
+    for (int n = begin; n < begin + count; n += Width)
+    {
+        int mask = (1 << std::min(Width, begin + count - n)) - 1;
+        D4 t, u, v;
+        mask = hitLanes(
+            load(mesh.a[0], mesh.a[1], mesh.a[2], n),
+            load(mesh.b[0], mesh.b[1], mesh.b[2], n),
+            load(mesh.c[0], mesh.c[1], mesh.c[2], n),
+            D4::load(mesh.tolerance + n),
+            rO, rD, ray.tMin, ray.tMax, mask, t, u, v
+        );
+        if (!mask) continue;
+
+        double ts[Width], us[Width], vs[Width];
+        t.store(ts);
+        u.store(us);
+        v.store(vs);
+        for (int k = 0; k < Width; ++k) {
+            if (!(mask & (1 << k)) || ts[k] >= ray.tMax) continue;
+            ray.tMax = ts[k];
+            best = n + k;
+            uBest = us[k];
+            vBest = vs[k];
+        }
+    }
+}
+
+// whether one of the triangles [begin, begin + count) is hit
+TONATIUH_LANES_TARGET inline bool findAny(const MeshLanes& mesh, int begin, int count, const Ray& ray)
+{
+    const vec3d& d = ray.direction();
+    const V4 rO = {D4::set(ray.origin.x), D4::set(ray.origin.y), D4::set(ray.origin.z)};
+    const V4 rD = {D4::set(d.x), D4::set(d.y), D4::set(d.z)};
+    for (int n = begin; n < begin + count; n += Width)
+    {
+        int mask = (1 << std::min(Width, begin + count - n)) - 1;
+        D4 t, u, v;
+        mask = hitLanes(
+            load(mesh.a[0], mesh.a[1], mesh.a[2], n),
+            load(mesh.b[0], mesh.b[1], mesh.b[2], n),
+            load(mesh.c[0], mesh.c[1], mesh.c[2], n),
+            D4::load(mesh.tolerance + n),
+            rO, rD, ray.tMin, ray.tMax, mask, t, u, v
+        );
+        if (mask) return true;
+    }
+    return false;
+}
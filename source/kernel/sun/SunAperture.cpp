@@ -7,6 +7,11 @@
 #include <QColor>
 #include <QImage>
 #include <QPaintEngine>
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
 
 #include <Inventor/SoPrimitiveVertex.h>
 #include <Inventor/nodes/SoTexture2.h>
@@ -14,7 +19,7 @@
 #include <Inventor/elements/SoGLTextureCoordinateElement.h>
 #include <Inventor/elements/SoMaterialBindingElement.h>
 
-#include <math.h>
+#include "libraries/math/2D/Box2D.h"
 #include "libraries/math/3D/Box3D.h"
 #include "libraries/math/3D/Ray.h"
 #include "libraries/math/3D/Transform.h"
@@ -91,87 +96,267 @@ void SunAperture::setSize(double xMin, double xMax, double yMin, double yMax, do
     disabledNodes = disabledNodes.getValue().getString(); // for update
 }
 
-void SunAperture::findTexture(int xPixels, int yPixels, QVector<QPair<TShapeKit*, Transform> > surfaces, SunKit* sunKit)
-{
-    double xWidth = m_xMax - m_xMin;
-    double yWidth = m_yMax - m_yMin;
+namespace {
 
-    while (xWidth / xPixels < m_delta) xPixels--;
-    double xStep = xWidth/xPixels;
+struct Raster
+{
+    double xMin;
+    double yMin;
+    double xStep;
+    double yStep;
+    int xPixels;
+    int yPixels;
+
+    vec2d project(const Transform& t, const vec3d& p) const
+    {
+        vec3d q = t.transformPoint(p);
+        return vec2d((q.x - xMin)/xStep, (q.y - yMin)/yStep);
+    }
+};
 
-    while (yWidth / yPixels < m_delta) yPixels--;
-    double yStep = yWidth/yPixels;
+// grids of one profile, kept by a worker from surface to surface
+struct ProfileSamples
+{
+    std::vector<vec2d> points;
+    std::vector<uchar> inside;
+    std::vector<uchar> grown;
+};
 
-    QImage* image = new QImage(xPixels, yPixels, QImage::Format_Grayscale8);
-    image->fill(Qt::black);
+// workers share the surfaces, one mask each, when there are enough of them
+int findWorkerCount(int surfaces)
+{
+    const int surfacesPerWorker = 256;
+    int threads = int(std::thread::hardware_concurrency());
+    return std::max(1, std::min(threads, surfaces/surfacesPerWorker));
+}
 
-    QPainter painter(image);
+// the faces of every bounding box, as drawn before the cells are grown;
+// an aliased opaque fill, so masks of disjoint surface ranges add up to
+// the mask of all surfaces in one image
+void paintBoxes(const QPair<TShapeKit*, Transform>* begin, const QPair<TShapeKit*, Transform>* end, const Raster& raster, uchar* mask)
+{
+    QImage image(raster.xPixels, raster.yPixels, QImage::Format_Grayscale8);
+    image.fill(Qt::black);
+    {
+        QPainter painter(&image);
+        painter.setBrush(QBrush(Qt::white));
+        painter.setPen(QPen(Qt::white));
+        painter.setRenderHint(QPainter::Antialiasing, false);
 
-    QBrush brush(Qt::white);
-    painter.setBrush(brush);
+        QPointF qps[8];
+        for (const QPair<TShapeKit*, Transform>* s = begin; s != end; ++s)
+        {
+            ShapeRT* shape = static_cast<ShapeRT*>(s->first->shapeRT.getValue());
+            if (!shape) continue;
+            ProfileRT* aperture = static_cast<ProfileRT*>(s->first->profileRT.getValue());
+            if (!aperture) continue;
+            Box3D box = shape->getBox(aperture);
+
+            const vec3d& vA = box.min();
+            const vec3d& vB = box.max();
+            for (int n = 0; n < 8; ++n) {
+                vec3d p(n & 4 ? vB.x : vA.x, n & 2 ? vB.y : vA.y, n & 1 ? vB.z : vA.z);
+                vec2d q = raster.project(s->second, p);
+                qps[n] = QPointF(q.x, q.y);
+                painter.drawPoint(qps[n]); // for polygons smaller than pixel
+            }
+
+            const int faces[6][4] = {
+                {0, 1, 3, 2}, // -x
+                {4, 5, 7, 6}, // +x
+                {0, 4, 5, 1}, // -y
+                {2, 6, 7, 3}, // +y
+                {0, 4, 6, 2}, // -z
+                {5, 1, 3, 7}  // +z
+            };
+            for (const int* f : faces) {
+                const QPointF polygon[4] = {qps[f[0]], qps[f[1]], qps[f[2]], qps[f[3]]};
+                painter.drawPolygon(polygon, 4);
+            }
+        }
+    }
 
-    QPen pen(Qt::white);
-    painter.setPen(pen);
+    for (int j = 0; j < raster.yPixels; ++j) {
+        const uchar* line = image.constScanLine(j);
+        for (int i = 0; i < raster.xPixels; ++i)
+            if (line[i] > 0) mask[size_t(i)*raster.yPixels + j] = 1;
+    }
+}
 
-    painter.setRenderHint(QPainter::Antialiasing, false);
+/*!
+ * Marks the cells that the surfaces cover, from their shapes over their
+ * profiles rather than from their bounding boxes. Every profile box is
+ * sampled on a grid fine enough that neighbouring points project less than
+ * half a cell apart, and each grid quad with a corner at most one sample
+ * from the profile marks the cells under its projected bounds. Round
+ * profiles and curved or deep shapes then light fewer empty cells than their
+ * boxes, and the area and the power per ray follow the cells that are left.
+ */
+void markProfiles(const QPair<TShapeKit*, Transform>* begin, const QPair<TShapeKit*, Transform>* end, const Raster& raster, ProfileSamples& samples, uchar* mask)
+{
+    const int probes = 8;
+    const int samplesMax = 2048;
+    const int xPixels = raster.xPixels;
+    const int yPixels = raster.yPixels;
 
-    for (const QPair<TShapeKit*, Transform>& s : surfaces)
+    for (const QPair<TShapeKit*, Transform>* s = begin; s != end; ++s)
     {
-        ShapeRT* shape = static_cast<ShapeRT*>(s.first->shapeRT.getValue());
+        ShapeRT* shape = static_cast<ShapeRT*>(s->first->shapeRT.getValue());
         if (!shape) continue;
-        ProfileRT* aperture = static_cast<ProfileRT*>(s.first->profileRT.getValue());
-        if (!aperture) continue;
-        Box3D box = shape->getBox(aperture);
-
-        const vec3d& vA = box.min();
-        const vec3d& vB = box.max();
-        QVector<vec3d> ps;
-        ps << vec3d(vA.x, vA.y, vA.z);
-        ps << vec3d(vA.x, vA.y, vB.z);
-        ps << vec3d(vA.x, vB.y, vA.z);
-        ps << vec3d(vA.x, vB.y, vB.z);
-        ps << vec3d(vB.x, vA.y, vA.z);
-        ps << vec3d(vB.x, vA.y, vB.z);
-        ps << vec3d(vB.x, vB.y, vA.z);
-        ps << vec3d(vB.x, vB.y, vB.z);
-
-        QVector<QPointF> qps;
-        for (vec3d& p : ps) {
-            p = s.second.transformPoint(p);
-            QPointF q((p.x - m_xMin)/xStep, (p.y - m_yMin)/yStep);
-            qps << q;
-            painter.drawPoint(q); // for polygons smaller than pixel
+        ProfileRT* profile = static_cast<ProfileRT*>(s->first->profileRT.getValue());
+        if (!profile) continue;
+        const Box2D box = profile->getBox();
+        const vec2d& a = box.min();
+        const vec2d& b = box.max();
+
+        // in cells of the aperture
+        auto project = [&](double u, double v) {
+            return raster.project(s->second, shape->getPoint(u, v));
+        };
+
+        // projected lengths along u and v, as polylines for curved shapes
+        double lu = 0.;
+        double lv = 0.;
+        for (double t : {0., 0.5, 1.}) {
+            double su = 0.;
+            double sv = 0.;
+            for (int k = 0; k < probes; ++k) {
+                double k0 = double(k)/probes;
+                double k1 = double(k + 1)/probes;
+                double v = gcf::lerp(a.y, b.y, t);
+                double u = gcf::lerp(a.x, b.x, t);
+                su += (project(gcf::lerp(a.x, b.x, k1), v) - project(gcf::lerp(a.x, b.x, k0), v)).norm();
+                sv += (project(u, gcf::lerp(a.y, b.y, k1)) - project(u, gcf::lerp(a.y, b.y, k0))).norm();
+            }
+            lu = std::max(lu, su);
+            lv = std::max(lv, sv);
+        }
+        const int nu = std::min(samplesMax, std::max(1, int(std::ceil(2.*lu))));
+        const int nv = std::min(samplesMax, std::max(1, int(std::ceil(2.*lv))));
+
+        std::vector<vec2d>& points = samples.points;
+        std::vector<uchar>& inside = samples.inside;
+        std::vector<uchar>& grown = samples.grown;
+        points.resize(size_t(nu + 1)*(nv + 1));
+        inside.resize(points.size());
+        for (int i = 0; i <= nu; ++i) {
+            double u = gcf::lerp(a.x, b.x, double(i)/nu);
+            for (int j = 0; j <= nv; ++j) {
+                double v = gcf::lerp(a.y, b.y, double(j)/nv);
+                size_t n = size_t(i)*(nv + 1) + j;
+                points[n] = project(u, v);
+                inside[n] = profile->isInside(u, v) ? 1 : 0;
+            }
         }
 
-        painter.drawPolygon(QPolygonF({qps[0], qps[1], qps[3], qps[2]})); // -x
-        painter.drawPolygon(QPolygonF({qps[4], qps[5], qps[7], qps[6]})); // +x
-        painter.drawPolygon(QPolygonF({qps[0], qps[4], qps[5], qps[1]})); // -y
-        painter.drawPolygon(QPolygonF({qps[2], qps[6], qps[7], qps[3]})); // +y
-        painter.drawPolygon(QPolygonF({qps[0], qps[4], qps[6], qps[2]})); // -z
-        painter.drawPolygon(QPolygonF({qps[5], qps[1], qps[3], qps[7]})); // +z
+        // grow by one sample so that edges between samples are kept
+        grown.assign(inside.size(), 0);
+        for (int i = 0; i <= nu; ++i)
+            for (int j = 0; j <= nv; ++j) {
+                if (!inside[size_t(i)*(nv + 1) + j]) continue;
+                for (int qi = std::max(0, i - 1); qi <= std::min(nu, i + 1); ++qi)
+                    for (int qj = std::max(0, j - 1); qj <= std::min(nv, j + 1); ++qj)
+                        grown[size_t(qi)*(nv + 1) + qj] = 1;
+            }
+
+        for (int i = 0; i < nu; ++i) {
+            for (int j = 0; j < nv; ++j) {
+                const size_t corners[] = {
+                    size_t(i)*(nv + 1) + j,
+                    size_t(i)*(nv + 1) + j + 1,
+                    size_t(i + 1)*(nv + 1) + j,
+                    size_t(i + 1)*(nv + 1) + j + 1
+                };
+                bool any = false;
+                double xMin = gcf::infinity;
+                double xMax = -gcf::infinity;
+                double yMin = gcf::infinity;
+                double yMax = -gcf::infinity;
+                for (size_t n : corners) {
+                    any = any || grown[n];
+                    xMin = std::min(xMin, points[n].x);
+                    xMax = std::max(xMax, points[n].x);
+                    yMin = std::min(yMin, points[n].y);
+                    yMax = std::max(yMax, points[n].y);
+                }
+                if (!any) continue;
+                int x0 = std::max(0, int(std::floor(xMin)));
+                int x1 = std::min(xPixels - 1, int(std::floor(xMax)));
+                int y0 = std::max(0, int(std::floor(yMin)));
+                int y1 = std::min(yPixels - 1, int(std::floor(yMax)));
+                for (int x = x0; x <= x1; ++x)
+                    for (int y = y0; y <= y1; ++y)
+                        mask[size_t(x)*yPixels + y] = 1;
+            }
+        }
     }
+}
+
+}
+
+/*!
+ * Finds the cells of the aperture that rays start from. The surfaces are
+ * shared between worker threads, each filling a plain mask of its own, and
+ * the masks are merged, grown and read into the cells at the end. The cells
+ * do not depend on the number of workers.
+ */
+void SunAperture::findTexture(int xPixels, int yPixels, QVector<QPair<TShapeKit*, Transform> > surfaces, SunKit* sunKit, bool profiles)
+{
+    double xWidth = m_xMax - m_xMin;
+    double yWidth = m_yMax - m_yMin;
 
-    int** areaMatrix = new int*[yPixels];
-    for (int i = 0; i < yPixels; i++)
-        areaMatrix[i] = new int[xPixels];
+    while (xWidth / xPixels < m_delta) xPixels--;
+    double xStep = xWidth/xPixels;
 
-    QVector<uchar> bmp;
-    bmp.resize(xPixels*yPixels);
+    while (yWidth / yPixels < m_delta) yPixels--;
+    double yStep = yWidth/yPixels;
 
-    QRgb black = qRgb(0, 0, 0);
-    for (int i = 0; i < xPixels; ++i)
-    {
-        for (int j = 0; j < yPixels; ++j)
-        {
-            int v = 0;
-            for (int qi = i - 1; qi <= i + 1; ++qi)
-                for (int qj = j - 1; qj <= j + 1; ++qj)
-                {
-                    if (qi < 0 || qi >= xPixels) continue;
-                    if (qj < 0 || qj >= yPixels) continue;
-                    v += image->pixel(qi, qj) == black ? 0 : 1;
-                }
-            bmp[i*yPixels + j] = v > 0 ? 255 : 0;
+    const Raster raster = {m_xMin, m_yMin, xStep, yStep, xPixels, yPixels};
+    const size_t pixels = size_t(xPixels)*yPixels;
+    const int workerCount = findWorkerCount(surfaces.size());
+
+    // one mask per worker and one more for growing the cells
+    std::vector< std::vector<uchar> > masks(workerCount + 1);
+    auto fill = [&](int w) {
+        const QPair<TShapeKit*, Transform>* begin = surfaces.constData() + qint64(surfaces.size())*w/workerCount;
+        const QPair<TShapeKit*, Transform>* end = surfaces.constData() + qint64(surfaces.size())*(w + 1)/workerCount;
+        masks[w].assign(pixels, 0);
+        if (profiles) {
+            ProfileSamples samples;
+            markProfiles(begin, end, raster, samples, masks[w].data());
+        } else
+            paintBoxes(begin, end, raster, masks[w].data());
+    };
+
+    std::vector<std::thread> workers;
+    for (int w = 1; w < workerCount; ++w)
+        workers.emplace_back(fill, w);
+    fill(0);
+    for (std::thread& worker : workers)
+        worker.join();
+
+    std::vector<uchar>& mask = masks[0];
+    for (int w = 1; w < workerCount; ++w)
+        for (size_t n = 0; n < pixels; ++n)
+            mask[n] |= masks[w][n];
+
+    if (!profiles) {
+        // grown by one cell, along y then along x
+        std::vector<uchar>& rows = masks[workerCount];
+        rows.resize(pixels);
+        for (int i = 0; i < xPixels; ++i) {
+            const uchar* column = &mask[size_t(i)*yPixels];
+            uchar* out = &rows[size_t(i)*yPixels];
+            for (int j = 0; j < yPixels; ++j)
+                out[j] = column[j] | (j > 0 ? column[j - 1] : 0) | (j + 1 < yPixels ? column[j + 1] : 0);
+        }
+        for (int i = 0; i < xPixels; ++i) {
+            uchar* out = &mask[size_t(i)*yPixels];
+            const uchar* column = &rows[size_t(i)*yPixels];
+            const uchar* left = i > 0 ? column - yPixels : nullptr;
+            const uchar* right = i + 1 < xPixels ? column + yPixels : nullptr;
+            for (int j = 0; j < yPixels; ++j)
+                out[j] = column[j] | (left ? left[j] : 0) | (right ? right[j] : 0);
         }
     }
 
@@ -182,7 +367,7 @@ void SunAperture::findTexture(int xPixels, int yPixels, QVector<QPair<TShapeKit*
 
     for (int i = 0; i < m_xCells; ++i)
         for (int j = 0; j < m_yCells; ++j)
-            if (bmp[i*m_yCells + j] > 0)
+            if (mask[size_t(i)*m_yCells + j] > 0)
                 m_cells.push_back(QPair<int, int>(i, j));
 
     Q_UNUSED(sunKit)
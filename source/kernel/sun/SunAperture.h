@@ -28,11 +28,14 @@ public:
 
     double getArea() const;
     const std::vector< QPair<int, int> >& getCells() const {return m_cells;}
+    // a subset of the cells found, as half a symmetric aperture; the area follows
+    void setCells(const std::vector< QPair<int, int> >& cells) {m_cells = cells;}
 
     vec3d Sample(double u, double v, int w, int h) const;
 
     void setSize(double xMin, double xMax, double yMin, double yMax, double delta);
-    void findTexture(int widthDivisions, int heightDivisions, QVector< QPair<TShapeKit*, Transform> > surfaces, SunKit* sunKit);
+    // cells lit by the bounding boxes of the surfaces, or by their profiles
+    void findTexture(int widthDivisions, int heightDivisions, QVector< QPair<TShapeKit*, Transform> > surfaces, SunKit* sunKit, bool profiles = false);
 
     SoSFString disabledNodes;
 
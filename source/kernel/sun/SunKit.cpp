@@ -18,6 +18,7 @@
 #include "scene/TSceneKit.h"
 #include "scene/TSeparatorKit.h"
 #include "kernel/run/InstanceNode.h"
+#include "kernel/run/TraceEvents.h"
 #include "libraries/math/3D/Box3D.h"
 #include "libraries/math/3D/Matrix4x4.h"
 #include "libraries/math/3D/Transform.h"
@@ -141,8 +142,9 @@ void SunKit::setBox(TSceneKit* scene)
     }
 }
 
-bool SunKit::findTexture(int sizeX, int sizeY, InstanceNode* instanceRoot)
+bool SunKit::findTexture(int sizeX, int sizeY, InstanceNode* instanceRoot, bool profiles)
 {
+    TraceEventScope event("findTexture", "setup", "width", sizeX, "height", sizeY);
     SunAperture* aperture = static_cast<SunAperture*>(getPart("aperture", false));
     if (!aperture) return false;
 
@@ -157,6 +159,6 @@ bool SunKit::findTexture(int sizeX, int sizeY, InstanceNode* instanceRoot)
     for (auto& s : surfacesList)
         s.second = tSun*s.second;
 
-    aperture->findTexture(sizeX, sizeY, surfacesList, this);
+    aperture->findTexture(sizeX, sizeY, surfacesList, this, profiles);
     return true;
 }
@@ -32,7 +32,7 @@ public:
     void updateTransform();
     void setBox(Box3D box);
     void setBox(TSceneKit* scene);
-    bool findTexture(int sizeX, int sizeY, InstanceNode* instanceRoot);
+    bool findTexture(int sizeX, int sizeY, InstanceNode* instanceRoot, bool profiles = false);
 
 public:
     SoMaterial* m_imageMaterial;
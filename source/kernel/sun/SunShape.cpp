@@ -7,3 +7,9 @@ void SunShape::initClass()
 {
     SO_NODE_INIT_ABSTRACT_CLASS(SunShape, TNode, "TNode");
 }
+
+void SunShape::generateRays(Random& rand, std::span<vec3d> directions) const
+{
+    for (vec3d& d : directions)
+        d = generateRay(rand);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <span>
+
 #include "kernel/node/TNode.h"
 #include "kernel/random/Random.h"
 #include "libraries/math/3D/vec3d.h"
@@ -13,6 +15,8 @@ public:
     static void initClass();
 
     virtual vec3d generateRay(Random& rand) const = 0;
+    // fills directions with rays drawn as by generateRay, one after another
+    virtual void generateRays(Random& rand, std::span<vec3d> directions) const;
     virtual double getThetaMax() const = 0;
     virtual double shape(double theta) const = 0;
 
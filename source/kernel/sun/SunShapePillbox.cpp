@@ -1,11 +1,20 @@
 #include "SunShapePillbox.h"
 
+#include <algorithm>
+
 #include <Inventor/sensors/SoNodeSensor.h>
 
 #include "libraries/math/gcf.h"
 
 SO_NODE_SOURCE(SunShapePillbox)
 
+namespace {
+
+// rays whose uniforms are drawn before their directions are computed
+const int Block = 64;
+
+} // namespace
+
 
 void SunShapePillbox::initClass()
 {
@@ -43,6 +52,31 @@ vec3d SunShapePillbox::generateRay(Random& rand) const
     );
 }
 
+/*!
+ * The uniforms of a block are drawn in the order of generateRay and the
+ * directions are then computed in a loop without calls into the generator,
+ * with the arithmetic of generateRay, so both give the same rays.
+ */
+void SunShapePillbox::generateRays(Random& rand, std::span<vec3d> directions) const
+{
+    double phis[Block];
+    double us[Block];
+    for (std::size_t a = 0; a < directions.size(); a += Block)
+    {
+        const int size = int(std::min<std::size_t>(Block, directions.size() - a));
+        for (int n = 0; n < size; ++n) {
+            phis[n] = rand.RandomDouble();
+            us[n] = rand.RandomDouble();
+        }
+        for (int n = 0; n < size; ++n) {
+            double phi = gcf::TwoPi*phis[n];
+            double sinTheta = m_sinThetaMax*sqrt(us[n]);
+            double cosTheta = sqrt(1. - sinTheta*sinTheta);
+            directions[a + n] = vec3d(sinTheta*cos(phi), sinTheta*sin(phi), cosTheta);
+        }
+    }
+}
+
 double SunShapePillbox::getThetaMax() const
 {
     return thetaMax.getValue();
@@ -13,6 +13,7 @@ public:
     SoNode* copy(SbBool copyConnections) const;
 
     vec3d generateRay(Random& rand) const;
+    void generateRays(Random& rand, std::span<vec3d> directions) const;
     double getThetaMax() const;
     double shape(double theta) const;
 
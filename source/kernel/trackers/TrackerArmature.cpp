@@ -1,5 +1,9 @@
 #include "TrackerArmature.h"
 
+#include "kernel/node/TonatiuhFunctions.h"
+#include "libraries/math/2D/vec2d.h"
+#include "TrackerTarget.h"
+
 
 SO_NODE_ABSTRACT_SOURCE(TrackerArmature)
 
@@ -12,9 +16,34 @@ void TrackerArmature::initClass()
 void TrackerArmature::update(TSeparatorKit* parent, const Transform& toGlobal, const vec3d& vSun, TrackerTarget* target)
 {
     Q_UNUSED(parent)
+    vec2d angles;
+    if (!solve(toGlobal, vSun, target->aimingType.getValue(), tgf::makeVector3D(target->aimingPoint.getValue()), &angles))
+        return;
+    target->angles.setValue(angles.x, angles.y);
+}
+
+bool TrackerArmature::solve(const Transform& toGlobal, const vec3d& vSun, int aimingType, const vec3d& aimingPoint, vec2d* angles) const
+{
     Q_UNUSED(toGlobal)
     Q_UNUSED(vSun)
-    Q_UNUSED(target)
+    Q_UNUSED(aimingType)
+    Q_UNUSED(aimingPoint)
+    Q_UNUSED(angles)
+    return false;
+}
+
+void TrackerArmature::solve(int count, const Transform* toGlobal, const vec3d& vSun,
+                            const int* aimingTypes, const vec3d* aimingPoints,
+                            vec2d* angles, char* solved) const
+{
+    for (int n = 0; n < count; ++n)
+        solved[n] = solve(toGlobal[n], vSun, aimingTypes[n], aimingPoints[n], &angles[n]);
+}
+
+QByteArray TrackerArmature::jointsKey() const
+{
+    const TrackerArmature* self = this;
+    return QByteArray(reinterpret_cast<const char*>(&self), sizeof(self));
 }
 
 void TrackerArmature::updateShape(TSeparatorKit* parent, SoShapeKit* shape, TrackerTarget* target)
@@ -3,10 +3,12 @@
 #include "kernel/node/TNode.h"
 
 #include <Inventor/nodekits/SoBaseKit.h>
+#include <QByteArray>
 
 class TSeparatorKit;
 class Transform;
 class SoShapeKit;
+struct vec2d;
 struct vec3d;
 class TrackerTarget;
 
@@ -21,6 +23,18 @@ public:
     virtual void update(TSeparatorKit* parent, const Transform& toGlobal,
                         const vec3d& vSun, TrackerTarget* target);
 
+    // angles in degrees from the joints of the armature and the aim only,
+    // so that trackers can be solved on several threads; false if none
+    virtual bool solve(const Transform& toGlobal, const vec3d& vSun,
+                       int aimingType, const vec3d& aimingPoint, vec2d* angles) const;
+    // solve for count trackers at once, by default one at a time
+    virtual void solve(int count, const Transform* toGlobal, const vec3d& vSun,
+                       const int* aimingTypes, const vec3d* aimingPoints,
+                       vec2d* angles, char* solved) const;
+    // armatures of the same key solve the same angles for the same trackers,
+    // so their trackers can be solved together
+    virtual QByteArray jointsKey() const;
+
     virtual void updateShape(TSeparatorKit* parent, SoShapeKit* shape, TrackerTarget* target);
 
     NAME_ICON_FUNCTIONS("X", ":/TrackerX.png")
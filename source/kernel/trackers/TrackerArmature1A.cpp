@@ -5,7 +5,9 @@
 #include <Inventor/nodes/SoTransform.h>
 
 #include "kernel/scene/TSeparatorKit.h"
+#include "kernel/node/SensorBatch.h"
 #include "kernel/node/TonatiuhFunctions.h"
+#include "libraries/math/2D/vec2d.h"
 #include "TrackerSolver1A.h"
 #include "TrackerTarget.h"
 
@@ -42,27 +44,29 @@ TrackerArmature1A::TrackerArmature1A()
 TrackerArmature1A::~TrackerArmature1A()
 {
     delete m_sensor;
+    SensorBatch::forget(this);
     delete m_solver;
 }
 
-void TrackerArmature1A::update(TSeparatorKit* /*parent*/, const Transform& toGlobal,
-                               const vec3d& vSun, TrackerTarget* target)
+bool TrackerArmature1A::solve(const Transform& toGlobal, const vec3d& vSun,
+                              int aimingType, const vec3d& aimingPoint, vec2d* angles) const
 {
     Transform toLocal = toGlobal.inversed();
     vec3d vSunL = toLocal.transformVector(vSun);
-    vec3d rAim = tgf::makeVector3D(target->aimingPoint.getValue());
+    vec3d rAim = aimingPoint;
 
     double angle;
-    if (target->aimingType.getValue() == TrackerTarget::global) {
+    if (aimingType == TrackerTarget::global) {
         rAim = toLocal.transformPoint(rAim);
         angle = m_solver->solveReflectionGlobal(vSunL, rAim);
-    } else if (target->aimingType.getValue() == TrackerTarget::local) {
+    } else if (aimingType == TrackerTarget::local) {
         angle = m_solver->solveReflectionPrimary(vSunL, rAim);
     } else {
         angle = 0;
     }
     angle = m_solver->selectSolution(angle);
-    target->angles.setValue(angle/gcf::degree, 0.);
+    *angles = vec2d(angle/gcf::degree, 0.);
+    return true;
 }
 
 void TrackerArmature1A::updateShape(TSeparatorKit* parent, SoShapeKit* /*shape*/, TrackerTarget* target)
@@ -84,6 +88,7 @@ void TrackerArmature1A::updateShape(TSeparatorKit* parent, SoShapeKit* /*shape*/
 
 void TrackerArmature1A::onModified(void* data, SoSensor*)
 {
+    if (SensorBatch::defer(onModified, data)) return;
     TrackerArmature1A* tracker = (TrackerArmature1A*) data;
     tracker->onModified();
 }
@@ -16,8 +16,8 @@ public:
     static void initClass();
     TrackerArmature1A();
 
-    void update(TSeparatorKit* parent, const Transform& toGlobal,
-                const vec3d& vSun, TrackerTarget* target);
+    bool solve(const Transform& toGlobal, const vec3d& vSun,
+               int aimingType, const vec3d& aimingPoint, vec2d* angles) const;
 
     void updateShape(TSeparatorKit* parent, SoShapeKit* shape, TrackerTarget* target);
 
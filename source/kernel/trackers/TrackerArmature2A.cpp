@@ -7,10 +7,13 @@
 
 #include "kernel/scene/TSeparatorKit.h"
 #include "kernel/scene/TShapeKit.h"
+#include "kernel/node/SensorBatch.h"
 #include "kernel/node/TonatiuhFunctions.h"
 #include "TrackerSolver2A.h"
 #include "TrackerTarget.h"
 
+#include <vector>
+
 SO_NODE_SOURCE(TrackerArmature2A)
 
 
@@ -48,6 +51,7 @@ TrackerArmature2A::TrackerArmature2A()
 TrackerArmature2A::~TrackerArmature2A()
 {
     delete m_sensor;
+    SensorBatch::forget(this);
     delete m_solver;
 }
 
@@ -72,21 +76,75 @@ static SoTransform* findPart(SoShapeKit* parent, const char* name)
 }
 
 #include <QDebug>
-void TrackerArmature2A::update(TSeparatorKit* /*parent*/, const Transform& toGlobal,
-                               const vec3d& vSun, TrackerTarget* target)
+bool TrackerArmature2A::solve(const Transform& toGlobal, const vec3d& vSun,
+                              int aimingType, const vec3d& aimingPoint, vec2d* angles) const
+{
+    char solved;
+    solve(1, &toGlobal, vSun, &aimingType, &aimingPoint, angles, &solved);
+    return solved;
+}
+
+/*!
+ * Trackers aimed at global points go through one allocation-free sweep of
+ * TrackerSolver2A over arrays of their local sun vectors and aim points;
+ * trackers aimed at local points are solved one at a time.
+ */
+void TrackerArmature2A::solve(int count, const Transform* toGlobal, const vec3d& vSun,
+                              const int* aimingTypes, const vec3d* aimingPoints,
+                              vec2d* angles, char* solved) const
 {
-    QVector<Angles> solutions;
-    Transform toLocal = toGlobal.inversed();
-    vec3d vSunL = toLocal.transformVector(vSun);
-    vec3d rAim = tgf::makeVector3D(target->aimingPoint.getValue());
-    if (target->aimingType.getValue() == TrackerTarget::global) {
-        rAim = toLocal.transformPoint(rAim);
-        solutions = m_solver->solveReflectionGlobal(vSunL, rAim);
-    } else if (target->aimingType.getValue() == TrackerTarget::local) {
-        solutions = m_solver->solveReflectionSecondary(vSunL, rAim);
+    std::vector<double> buffer(8*count);
+    double* sun[3] = {&buffer[0], &buffer[count], &buffer[2*count]};
+    double* aim[3] = {&buffer[3*count], &buffer[4*count], &buffer[5*count]};
+    double* alpha = &buffer[6*count];
+    double* beta = &buffer[7*count];
+    std::vector<int> global;
+    global.reserve(count);
+
+    for (int n = 0; n < count; ++n) {
+        Transform toLocal = toGlobal[n].inversed();
+        vec3d vSunL = toLocal.transformVector(vSun);
+        solved[n] = true;
+        if (aimingTypes[n] == TrackerTarget::global) {
+            vec3d rAim = toLocal.transformPoint(aimingPoints[n]);
+            int m = global.size();
+            sun[0][m] = vSunL.x;
+            sun[1][m] = vSunL.y;
+            sun[2][m] = vSunL.z;
+            aim[0][m] = rAim.x;
+            aim[1][m] = rAim.y;
+            aim[2][m] = rAim.z;
+            global.push_back(n);
+            continue;
+        }
+        QVector<Angles> solutions;
+        if (aimingTypes[n] == TrackerTarget::local)
+            solutions = m_solver->solveReflectionSecondary(vSunL, aimingPoints[n]);
+        Angles solution = m_solver->selectSolution(solutions);
+        angles[n] = vec2d(solution.x/gcf::degree, solution.y/gcf::degree);
     }
-    Angles solution = m_solver->selectSolution(solutions);
-    target->angles.setValue(solution.x/gcf::degree, solution.y/gcf::degree);
+
+    const int m = global.size();
+    m_solver->solveReflectionGlobal(m, sun[0], sun[1], sun[2], aim[0], aim[1], aim[2], alpha, beta);
+    for (int q = 0; q < m; ++q)
+        angles[global[q]] = vec2d(alpha[q]/gcf::degree, beta[q]/gcf::degree);
+}
+
+QByteArray TrackerArmature2A::jointsKey() const
+{
+    const double values[] = {
+        primary.shift.x, primary.shift.y, primary.shift.z,
+        primary.axis.x, primary.axis.y, primary.axis.z,
+        primary.angles.min(), primary.angles.max(),
+        secondary.shift.x, secondary.shift.y, secondary.shift.z,
+        secondary.axis.x, secondary.axis.y, secondary.axis.z,
+        secondary.angles.min(), secondary.angles.max(),
+        facet.shift.x, facet.shift.y, facet.shift.z,
+        facet.normal.x, facet.normal.y, facet.normal.z,
+        angles0.x, angles0.y
+    };
+    return QByteArray(getTypeId().getName().getString()) +
+        QByteArray(reinterpret_cast<const char*>(values), sizeof(values));
 }
 
 void TrackerArmature2A::updateShape(TSeparatorKit* parent, SoShapeKit* shape, TrackerTarget* target)
@@ -126,6 +184,7 @@ void TrackerArmature2A::updateShape(TSeparatorKit* parent, SoShapeKit* shape, Tr
 //    if (!shapeKit) return;
 
 //    SoNodeKitListPart* cList = (SoNodeKitListPart*) shapeKit->m_shapeKit->getPart("childList", true);
+    if (!shape) return; // joints only
     SoTransform* st;
     SbMatrix m1, m2, m3, mP, mS;
 
@@ -148,6 +207,7 @@ void TrackerArmature2A::updateShape(TSeparatorKit* parent, SoShapeKit* shape, Tr
 
 void TrackerArmature2A::onModified(void* data, SoSensor*)
 {
+    if (SensorBatch::defer(onModified, data)) return;
     TrackerArmature2A* tracker = (TrackerArmature2A*) data;
     tracker->onModified();
 }
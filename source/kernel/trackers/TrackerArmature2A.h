@@ -17,8 +17,12 @@ public:
     static void initClass();
     TrackerArmature2A();
 
-    void update(TSeparatorKit* parent, const Transform& toGlobal,
-                const vec3d& vSun, TrackerTarget* target);
+    bool solve(const Transform& toGlobal, const vec3d& vSun,
+               int aimingType, const vec3d& aimingPoint, vec2d* angles) const;
+    void solve(int count, const Transform* toGlobal, const vec3d& vSun,
+               const int* aimingTypes, const vec3d* aimingPoints,
+               vec2d* angles, char* solved) const;
+    QByteArray jointsKey() const;
 
     void updateShape(TSeparatorKit* parent, SoShapeKit* shape, TrackerTarget* target);
 
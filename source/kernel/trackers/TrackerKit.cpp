@@ -2,16 +2,18 @@
 
 #include "TrackerArmature2A.h"
 #include "TrackerTarget.h"
+#include "libraries/math/2D/vec2d.h"
 #include <Inventor/nodes/SoGroup.h>
 #include <Inventor/nodes/SoCoordinate3.h>
 #include <Inventor/nodes/SoNormal.h>
 #include <Inventor/nodes/SoGroup.h>
 #include <Inventor/nodes/SoIndexedFaceSet.h>
 #include <QFileInfo>
-#include <QMessageBox>
 #include <Inventor/sensors/SoFieldSensor.h>
 
 #include "libraries/auxiliary/tiny_obj_loader.h"
+#include "kernel/node/SensorBatch.h"
+#include "kernel/node/TonatiuhFunctions.h"
 
 
 SO_KIT_SOURCE(TrackerKit)
@@ -36,6 +38,7 @@ TrackerKit::TrackerKit()
     SO_NODE_ADD_FIELD( armature, (0) );
     SO_NODE_ADD_FIELD( shape, ("") );
     SO_NODE_ADD_FIELD( target, (0) );
+    SO_NODE_ADD_FIELD( trackingError, (0.) );
 
     SO_KIT_INIT_INSTANCE();
 
@@ -65,12 +68,23 @@ void TrackerKit::update(TSeparatorKit* parent, const Transform& toGlobal, const
     TrackerArmature* ta = (TrackerArmature*) armature.getValue();
     TrackerTarget* tt = (TrackerTarget*) target.getValue();
     ta->update(parent, toGlobal, vSun, tt);
-    onSensor_target(this, 0);
+    // at once, trackers below read the transforms it moves
+    updateTarget();
+}
+
+void TrackerKit::setAngles(const vec2d& angles, bool shape)
+{
+    TrackerTarget* tt = (TrackerTarget*) target.getValue();
+    tt->angles.setValue(angles.x, angles.y);
+    if (!m_parent) return;
+    TrackerArmature* ta = (TrackerArmature*) armature.getValue();
+    ta->updateShape(m_parent, shape ? m_shapeKit : 0, tt);
 }
 
 TrackerKit::~TrackerKit()
 {
     delete m_sensor_target;
+    SensorBatch::forget(this);
 }
 
 void TrackerKit::setDefaultOnNonWritingFields()
@@ -81,6 +95,7 @@ void TrackerKit::setDefaultOnNonWritingFields()
 
 void TrackerKit::onSensor_shape(void* data, SoSensor*)
 {
+    if (SensorBatch::defer(onSensor_shape, data)) return;
     TrackerKit* kit = (TrackerKit*) data;
 
     SoMFVec3f vertices;
@@ -93,11 +108,11 @@ void TrackerKit::onSensor_shape(void* data, SoSensor*)
     fileName = QString("project:") + fileName;
     QFileInfo info(fileName);
     if (info.suffix() != "obj") {
-        QMessageBox::warning(0, "Warning", "File is not in obj-format");
+        tgf::showWarning("File is not in obj-format");
         return;
     }
     if (!info.exists()) {
-        QMessageBox::warning(0, "Warning", QString("File not found:\n") + fileName);
+        tgf::showWarning(QString("File not found:\n") + fileName);
         return;
     }
     fileName = info.absoluteFilePath();
@@ -196,9 +211,17 @@ void TrackerKit::onSensor_shape(void* data, SoSensor*)
 
 void TrackerKit::onSensor_target(void* data, SoSensor*)
 {
+    if (SensorBatch::defer(onSensor_target, data)) return;
     TrackerKit* kit = (TrackerKit*) data;
-    if (!kit->m_parent) return;
-    TrackerArmature* ta = (TrackerArmature*) kit->armature.getValue();
-    TrackerTarget* tt = (TrackerTarget*) kit->target.getValue();
-    ta->updateShape(kit->m_parent, kit->m_shapeKit, tt);
+    kit->updateTarget();
+}
+
+void TrackerKit::updateTarget()
+{
+    // the angles are read now, a pending notice of the target would repeat it
+    m_sensor_target->unschedule();
+    if (!m_parent) return;
+    TrackerArmature* ta = (TrackerArmature*) armature.getValue();
+    TrackerTarget* tt = (TrackerTarget*) target.getValue();
+    ta->updateShape(m_parent, m_shapeKit, tt);
 }
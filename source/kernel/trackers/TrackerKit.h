@@ -4,12 +4,14 @@
 
 #include <Inventor/nodekits/SoBaseKit.h>
 #include <Inventor/fields/SoSFBool.h>
+#include <Inventor/fields/SoSFDouble.h>
 #include <Inventor/nodekits/SoShapeKit.h>
 #include <Inventor/fields/SoSFString.h>
 
 
 class TSeparatorKit;
 class Transform;
+struct vec2d;
 struct vec3d;
 class SoFieldSensor;
 class SoSensor;
@@ -28,8 +30,13 @@ public:
     SoSFNode armature;
     SoSFString shape;
     SoSFNode target;
+    // Gaussian deviation in radians of the tilt about each axis, see TrackingError
+    SoSFDouble trackingError;
 
     void update(TSeparatorKit* parent, const Transform& toGlobal, const vec3d& vSun);
+    // angles in degrees from TrackerArmature::solve, the shape of the
+    // tracker is turned too if shape is set
+    void setAngles(const vec2d& angles, bool shape = true);
 
     TSeparatorKit* m_parent;
     SoShapeKit* m_shapeKit;
@@ -44,5 +51,7 @@ protected:
 
     SoFieldSensor* m_sensor_target;
     static void onSensor_target(void* data, SoSensor*);
+    // turns the nodes under the parent to the angles of the target
+    void updateTarget();
 };
 
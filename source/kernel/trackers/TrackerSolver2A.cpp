@@ -11,6 +11,122 @@ inline double findAngle(const vec3d& a, const vec3d& m, const vec3d& v, double a
 }
 
 
+namespace {
+
+// the joints of an armature as plain numbers, with what solveRotation
+// takes from the axes and the facet normal found once
+struct Joints2A
+{
+    Joints2A(const TrackerArmature2A& armature):
+        a(armature.primary.axis),
+        b(armature.secondary.axis),
+        shiftP(armature.primary.shift),
+        shiftS(armature.secondary.shift),
+        shiftF(armature.facet.shift),
+        n0(armature.facet.normal),
+        rangeP(armature.primary.angles),
+        rangeS(armature.secondary.angles),
+        angles0(armature.angles0)
+    {
+        k = cross(a, b);
+        k2 = k.norm2();
+        ab = dot(a, b);
+        det = 1. - ab*ab;
+        bn0 = dot(b, n0);
+    }
+
+    vec3d a;
+    vec3d b;
+    vec3d shiftP;
+    vec3d shiftS;
+    vec3d shiftF;
+    vec3d n0;
+    IntervalPeriodic rangeP;
+    IntervalPeriodic rangeS;
+    Angles angles0;
+
+    vec3d k;
+    double k2;
+    double ab;
+    double det;
+    double bn0;
+};
+
+// p rotated around the unit axis
+inline vec3d rotate(const vec3d& p, const vec3d& axis, double angle)
+{
+    double c = cos(angle);
+    double s = sin(angle);
+    return p*c + cross(axis, p)*s + axis*(dot(axis, p)*(1. - c));
+}
+
+inline vec3d findFacetPoint(const Joints2A& j, const Angles& angles)
+{
+    vec3d r = j.shiftS + rotate(j.shiftF, j.b, angles.y);
+    return j.shiftP + rotate(r, j.a, angles.x);
+}
+
+// solveFacetNormal into two solutions, false if there are none
+inline bool solveFacetNormal(const Joints2A& j, const vec3d& v, Angles* ans)
+{
+    if (std::abs(j.det) < 1e-8) return false;
+
+    double av = dot(j.a, v);
+    double ma = (av - j.ab*j.bn0)/j.det;
+    double mb = (j.bn0 - j.ab*av)/j.det;
+    double mk = 1. - ma*ma - mb*mb - 2.*ma*mb*j.ab;
+    if (mk < 0.) return false;
+
+    mk = sqrt(mk/j.k2);
+    vec3d m0 = ma*j.a + mb*j.b;
+    vec3d m = m0 - mk*j.k;
+    ans[0] = Angles(findAngle(j.a, m, v, av), findAngle(j.b, j.n0, m, j.bn0));
+    m = m0 + mk*j.k;
+    ans[1] = Angles(findAngle(j.a, m, v, av), findAngle(j.b, j.n0, m, j.bn0));
+    return true;
+}
+
+inline Angles solveReflectionGlobal(const Joints2A& j, const vec3d& vSun, const vec3d& rAim)
+{
+    const int iMax = 5; // max iterations
+    const double deltaMin = 0.001; // accuracy in meters
+
+    Angles ans = j.angles0;
+    double zAns = gcf::infinity;
+    for (int s = 0; s < 2; ++s) // solutions
+    {
+        vec3d rFacet = findFacetPoint(j, j.angles0);
+        for (int i = 0; i < iMax; ++i)
+        {
+            vec3d vTarget = (rAim - rFacet).normalized();
+            vec3d normal = (vSun + vTarget).normalized();
+            Angles temp[2];
+            if (!solveFacetNormal(j, normal, temp)) break;
+            const Angles& angles = temp[s];
+            rFacet = findFacetPoint(j, angles);
+            double delta = cross(rAim - rFacet, vTarget).norm();
+            if (delta > deltaMin) continue;
+
+            // as selectSolution
+            Angles t;
+            t.x = j.rangeP.normalizeAngle(angles.x);
+            t.y = j.rangeS.normalizeAngle(angles.y);
+            if (j.rangeP.isInside(t.x) && j.rangeS.isInside(t.y)) {
+                double z = (t - j.angles0).norm2();
+                if (z <= zAns) {
+                    ans = t;
+                    zAns = z;
+                }
+            }
+            break;
+        }
+    }
+    return ans;
+}
+
+} // namespace
+
+
 TrackerSolver2A::TrackerSolver2A(TrackerArmature2A* armature)
 {
     m_armature = armature;
@@ -113,3 +229,20 @@ Angles TrackerSolver2A::selectSolution(const QVector<Angles>& solutions)
         return ans;
     return m_armature->angles0;
 }
+
+void TrackerSolver2A::solveReflectionGlobal(int count,
+                                            const double* sunX, const double* sunY, const double* sunZ,
+                                            const double* aimX, const double* aimY, const double* aimZ,
+                                            double* alpha, double* beta) const
+{
+    const Joints2A joints(*m_armature);
+    for (int n = 0; n < count; ++n) {
+        Angles angles = ::solveReflectionGlobal(
+            joints,
+            vec3d(sunX[n], sunY[n], sunZ[n]),
+            vec3d(aimX[n], aimY[n], aimZ[n])
+        );
+        alpha[n] = angles.x;
+        beta[n] = angles.y;
+    }
+}
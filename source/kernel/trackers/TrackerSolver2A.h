@@ -20,6 +20,14 @@ public:
 
     Angles selectSolution(const QVector<Angles>& solutions);
 
+    // solveReflectionGlobal and selectSolution for count trackers of these
+    // joints at once, without allocations; the sun vectors and aim points are
+    // in the frame of each tracker, as arrays of coordinates
+    void solveReflectionGlobal(int count,
+                               const double* sunX, const double* sunY, const double* sunZ,
+                               const double* aimX, const double* aimY, const double* aimZ,
+                               double* alpha, double* beta) const;
+
 private:
     TrackerArmature2A* m_armature;
 };
@@ -0,0 +1,40 @@
+#include "TrackingError.h"
+
+#include <Inventor/nodes/SoGroup.h>
+
+#include "kernel/material/SlopeSampler.h"
+#include "kernel/random/Random.h"
+#include "kernel/run/InstanceNode.h"
+#include "kernel/scene/TSeparatorKit.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/trackers/TrackerKit.h"
+
+
+double TrackingError::find(InstanceNode* node, InstanceNode* end)
+{
+    for (InstanceNode* instance = node; instance; instance = instance->getParent())
+    {
+        TSeparatorKit* kit = dynamic_cast<TSeparatorKit*>(instance->getNode());
+        SoGroup* group = kit ? (SoGroup*) kit->getPart("group", false) : 0;
+        for (int n = 0; group && n < group->getNumChildren(); ++n)
+        {
+            TrackerKit* tracker = dynamic_cast<TrackerKit*>(group->getChild(n));
+            if (tracker && tracker->enabled.getValue() && tracker->trackingError.getValue() > 0.)
+                return tracker->trackingError.getValue();
+        }
+        if (instance == end) break;
+    }
+    return 0.;
+}
+
+/*!
+ * The rotation turns the normal to the direction a slope error of the same
+ * deviation would take, around the frame of the normal and dpdu.
+ */
+void TrackingError::tilt(DifferentialGeometry& dg, double sigma, Random& rand)
+{
+    const SlopeSampler sampler(SlopeSampler::Gaussian, sigma);
+    const double u = rand.RandomDouble();
+    const double v = rand.RandomDouble();
+    dg.normal = SlopeSampler::toFrame(sampler.sample(u, v), dg.normal, dg.dpdu);
+}
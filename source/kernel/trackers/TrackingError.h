@@ -0,0 +1,33 @@
+#pragma once
+
+#include "kernel/TonatiuhKernel.h"
+
+class InstanceNode;
+class Random;
+struct DifferentialGeometry;
+
+
+//! TrackingError tilts the surfaces a tracker moves by random errors of its angles.
+/*!
+ * A TrackerKit with a trackingError turns the separator holding it, and all
+ * its surfaces, by a small random rotation of Gaussian deviation
+ * trackingError about each axis across the normal. Instead of solving the
+ * tracker again for drawn errors, every hit on such a surface tilts its
+ * normal by a rotation drawn for that hit, so one trace gives the flux
+ * expected over the errors. The shift of the hit point, of the order of the
+ * error times the distance to the pivot, and the change of the shading of
+ * the incoming rays are left out, as they are for slope errors.
+ *
+ * The tilt is that of SlopeSampler, from two uniforms per hit, so traces of
+ * scenes without tracking errors draw as before.
+ */
+class TONATIUH_KERNEL TrackingError
+{
+public:
+    // the trackingError, in radians, of the nearest enabled tracker with one
+    // holding node, looking up to end included, or the root; 0 for none
+    static double find(InstanceNode* node, InstanceNode* end = nullptr);
+
+    // turns dg.normal, in world frame, by a rotation of deviation sigma
+    static void tilt(DifferentialGeometry& dg, double sigma, Random& rand);
+};
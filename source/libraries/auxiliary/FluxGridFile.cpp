@@ -0,0 +1,286 @@
+#include "FluxGridFile.h"
+
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include "S3Upload.h"
+
+#ifdef TONATIUHPP_HDF5
+#include "HDF5File.h"
+#endif
+
+
+namespace {
+
+bool fail(QString* error, const QString& message)
+{
+    if (error) *error = message;
+    return false;
+}
+
+quint64 float64Bits(double value)
+{
+    quint64 bits = 0;
+    std::memcpy(&bits, &value, sizeof(value));
+    return qToLittleEndian(bits);
+}
+
+quint32 float32Bits(double value)
+{
+    const float single = float(value);
+    quint32 bits = 0;
+    std::memcpy(&bits, &single, sizeof(single));
+    return qToLittleEndian(bits);
+}
+
+// the zip CRC-32, reflected polynomial 0xedb88320
+quint32 crc32(const QByteArray& data)
+{
+    static quint32 table[256] = {};
+    static const bool filled = [] {
+        for (quint32 n = 0; n < 256; ++n) {
+            quint32 c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        return true;
+    }();
+    Q_UNUSED(filled);
+
+    quint32 c = 0xffffffffu;
+    for (char byte : data)
+        c = table[(c ^ quint8(byte)) & 0xff] ^ (c >> 8);
+    return c ^ 0xffffffffu;
+}
+
+void put16(QByteArray& out, quint16 value)
+{
+    const quint16 bits = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+}
+
+void put32(QByteArray& out, quint32 value)
+{
+    const quint32 bits = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+}
+
+// zip members are dated 1980-01-01 00:00, so equal grids give equal files
+const quint16 ZipTime = 0;
+const quint16 ZipDate = (1 << 5) | 1;
+
+}
+
+
+bool FluxGridFile::findFormat(const QString& fileName, Format* format)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "f32")
+        *format = Float32;
+    else if (suffix == "f64" || suffix == "bin")
+        *format = Float64;
+    else if (suffix == "npy")
+        *format = Npy;
+    else if (suffix == "npz")
+        *format = Npz;
+    else if (suffix == "pfm")
+        *format = Pfm;
+#ifdef TONATIUHPP_HDF5
+    else if (suffix == "h5")
+        *format = Hdf5;
+#endif
+    else
+        return false;
+    return true;
+}
+
+bool FluxGridFile::write(const QString& fileName, Format format, int rows, int cols, const std::vector<double>& values, QString* error, const QString& dataset)
+{
+    if (rows < 0 || cols < 0 || values.size() != size_t(rows)*size_t(cols))
+        return fail(error, "Flux grid size does not match its dimensions.");
+
+    const bool remote = S3Upload::isUrl(fileName);
+    QFileInfo info(fileName);
+    if (!remote && !QDir().mkpath(info.absolutePath()))
+        return fail(error, QString("Cannot create output directory %1.").arg(info.absolutePath()));
+
+    if (format == Hdf5) {
+        if (remote)
+            return fail(error, QString("HDF5 flux grids are appended in place and cannot be written to %1.").arg(fileName));
+#ifdef TONATIUHPP_HDF5
+        HDF5File file;
+        if (!file.open(fileName, false) || !file.appendGrid(dataset, rows, cols, values) || !file.close())
+            return fail(error, QString("Cannot write HDF5 flux grid %1: %2").arg(fileName, file.getError()));
+        return true;
+#else
+        return fail(error, "HDF5 flux grids need a build with TONATIUHPP_ENABLE_HDF5.");
+#endif
+    }
+
+    QByteArray data;
+    if (format == Npy)
+        data = toNpy(rows, cols, values);
+    else if (format == Npz) {
+        data = toNpz(dataset, toNpy(rows, cols, values));
+        if (data.isEmpty())
+            return fail(error, QString("Flux grid %1 is too large for a zip archive.").arg(fileName));
+    } else if (format == Pfm)
+        data = toPfm(rows, cols, values);
+    else
+        data = toRaw(values, format == Float32);
+
+    if (remote) {
+        QString message;
+        if (!S3Upload::put(fileName, data, &message))
+            return fail(error, QString("Cannot upload flux grid %1: %2").arg(fileName, message));
+        return true;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return fail(error, QString("Cannot open flux grid file %1: %2").arg(fileName, file.errorString()));
+    if (file.write(data) != data.size() || !file.commit())
+        return fail(error, QString("Cannot write flux grid file %1: %2").arg(fileName, file.errorString()));
+    return true;
+}
+
+/*!
+ * Version 1.0 of the format: the magic string, a little-endian header
+ * length and a Python dict literal padded with spaces so the data starts
+ * on a multiple of 64 bytes, then the values.
+ */
+QByteArray FluxGridFile::toNpy(int rows, int cols, const std::vector<double>& values)
+{
+    QByteArray header = QString("{'descr': '<f8', 'fortran_order': False, 'shape': (%1, %2), }")
+        .arg(rows).arg(cols).toLatin1();
+    const int prefix = 10;
+    const int padding = 64 - (prefix + header.size() + 1) % 64;
+    header.append(QByteArray(padding % 64, ' '));
+    header.append('\n');
+
+    QByteArray ans("\x93NUMPY\x01\x00", 8);
+    put16(ans, quint16(header.size()));
+    ans.append(header);
+    ans.append(toRaw(values, false));
+    return ans;
+}
+
+/*!
+ * One deflated member in a zip archive without zip64 extensions, empty if
+ * the member passes 4 GB. qCompress gives a zlib stream after a 4-byte
+ * length, zip stores the raw deflate stream inside it.
+ */
+QByteArray FluxGridFile::toNpz(const QString& dataset, const QByteArray& npy)
+{
+    const QByteArray name = (dataset.isEmpty() ? QString("flux") : dataset).toUtf8() + ".npy";
+    const QByteArray compressed = qCompress(npy, 6);
+    if (quint64(npy.size()) >= 0xffffffffull || compressed.size() < 10)
+        return QByteArray();
+    const QByteArray deflated = compressed.mid(6, compressed.size() - 10);
+    const quint32 crc = crc32(npy);
+
+    QByteArray ans;
+    put32(ans, 0x04034b50); // local file header
+    put16(ans, 20);         // version needed, deflate
+    put16(ans, 0);          // flags
+    put16(ans, 8);          // deflated
+    put16(ans, ZipTime);
+    put16(ans, ZipDate);
+    put32(ans, crc);
+    put32(ans, quint32(deflated.size()));
+    put32(ans, quint32(npy.size()));
+    put16(ans, quint16(name.size()));
+    put16(ans, 0);          // extra field
+    ans.append(name);
+    ans.append(deflated);
+
+    const quint32 directory = quint32(ans.size());
+    put32(ans, 0x02014b50); // central directory header
+    put16(ans, 20);         // made by
+    put16(ans, 20);
+    put16(ans, 0);
+    put16(ans, 8);
+    put16(ans, ZipTime);
+    put16(ans, ZipDate);
+    put32(ans, crc);
+    put32(ans, quint32(deflated.size()));
+    put32(ans, quint32(npy.size()));
+    put16(ans, quint16(name.size()));
+    put16(ans, 0);          // extra field
+    put16(ans, 0);          // comment
+    put16(ans, 0);          // disk
+    put16(ans, 0);          // internal attributes
+    put32(ans, 0);          // external attributes
+    put32(ans, 0);          // offset of the local header
+    ans.append(name);
+    const quint32 directorySize = quint32(ans.size()) - directory;
+
+    put32(ans, 0x06054b50); // end of central directory
+    put16(ans, 0);
+    put16(ans, 0);
+    put16(ans, 1);
+    put16(ans, 1);
+    put32(ans, directorySize);
+    put32(ans, directory);
+    put16(ans, 0);
+    return ans;
+}
+
+QByteArray FluxGridFile::toRaw(const std::vector<double>& values, bool singlePrecision)
+{
+    QByteArray ans;
+    if (singlePrecision) {
+        ans.resize(qsizetype(values.size()*sizeof(quint32)));
+        char* out = ans.data();
+        for (double value : values) {
+            const quint32 bits = float32Bits(value);
+            std::memcpy(out, &bits, sizeof(bits));
+            out += sizeof(bits);
+        }
+    } else {
+        ans.resize(qsizetype(values.size()*sizeof(quint64)));
+        char* out = ans.data();
+        for (double value : values) {
+            const quint64 bits = float64Bits(value);
+            std::memcpy(out, &bits, sizeof(bits));
+            out += sizeof(bits);
+        }
+    }
+    return ans;
+}
+
+/*!
+ * The grayscale header Pf, the width and height, and a negative scale for
+ * little-endian values, then the rows from the bottom of the image up.
+ */
+QByteArray FluxGridFile::toPfm(int rows, int cols, const std::vector<double>& values)
+{
+    QByteArray ans = "Pf\n" + QByteArray::number(cols) + ' ' + QByteArray::number(rows) + "\n-1.0\n";
+    const qsizetype header = ans.size();
+    ans.resize(header + qsizetype(values.size()*sizeof(quint32)));
+    char* out = ans.data() + header;
+    for (int r = rows - 1; r >= 0; --r) {
+        for (int c = 0; c < cols; ++c) {
+            const quint32 bits = float32Bits(values[size_t(r)*cols + c]);
+            std::memcpy(out, &bits, sizeof(bits));
+            out += sizeof(bits);
+        }
+    }
+    return ans;
+}
+
+QString FluxGridFile::sha256(const std::vector<double>& values)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (double value : values) {
+        const quint64 bits = float64Bits(value);
+        hash.addData(QByteArrayView(reinterpret_cast<const char*>(&bits), sizeof(bits)));
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "libraries/TonatiuhLibraries.h"
+
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+
+//! FluxGridFile writes flux grids as raw, NumPy, PFM or HDF5 arrays.
+/*!
+ * A grid is rows by cols values in row-major order. Raw files hold the
+ * values alone as little-endian float32 or float64. NPY files hold them as
+ * a float64 array of shape (rows, cols), and NPZ files hold that array,
+ * deflated, as the member <dataset>.npy of a zip archive, as
+ * numpy.savez_compressed writes it. PFM files hold them as a grayscale
+ * Portable FloatMap of cols by rows float32 pixels, row 0 at the top, a
+ * high dynamic range image most image tools read. HDF5 files, in builds with
+ * TONATIUHPP_HDF5, get the grid appended to dataset, see
+ * HDF5File::appendGrid.
+ *
+ * A file name s3://bucket/key uploads the file to object storage with
+ * S3Upload, except for HDF5.
+ *
+ * The SHA256 of a grid is that of its float64 file, so it can be checked
+ * against any of the float64 formats once read back.
+ */
+class TONATIUH_LIBRARIES FluxGridFile
+{
+public:
+    enum Format {
+        Float32,
+        Float64,
+        Npy,
+        Npz,
+        Pfm,
+        Hdf5
+    };
+
+    // from the suffix of fileName: f32, f64 or bin, npy, npz, pfm and h5; false
+    // for other suffixes or h5 without HDF5 support
+    static bool findFormat(const QString& fileName, Format* format);
+
+    // replaces the file, or appends for HDF5
+    static bool write(const QString& fileName, Format format, int rows, int cols, const std::vector<double>& values,
+                      QString* error = nullptr, const QString& dataset = "flux");
+
+    // the bytes written for Npy and Npz, and for raw formats without a header
+    static QByteArray toNpy(int rows, int cols, const std::vector<double>& values);
+    static QByteArray toNpz(const QString& dataset, const QByteArray& npy);
+    static QByteArray toRaw(const std::vector<double>& values, bool singlePrecision);
+    static QByteArray toPfm(int rows, int cols, const std::vector<double>& values);
+
+    // lower-case hex SHA256 of the values as little-endian float64
+    static QString sha256(const std::vector<double>& values);
+};
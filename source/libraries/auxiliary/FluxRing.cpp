@@ -0,0 +1,186 @@
+#include "FluxRing.h"
+
+#include <atomic>
+#include <cstring>
+
+#include "FluxRingLayout.h"
+
+static_assert(sizeof(TonatiuhFluxRingHeader) == 64, "the header of a flux ring is 64 bytes");
+static_assert(sizeof(TonatiuhFluxRingSlot) == 128, "the header of a slot is 128 bytes");
+static_assert(std::atomic_ref<uint64_t>::is_always_lock_free, "rings are shared through lock-free 64-bit atomics");
+
+
+namespace {
+
+std::atomic_ref<uint64_t> atomic(uint64_t& value)
+{
+    return std::atomic_ref<uint64_t>(value);
+}
+
+bool fail(QString* error, const QString& message)
+{
+    if (error) *error = message;
+    return false;
+}
+
+}
+
+
+FluxRing::FluxRing()
+{
+
+}
+
+FluxRing::~FluxRing()
+{
+    close();
+}
+
+bool FluxRing::create(const QString& fileName, int slotCount, qulonglong maxCells, QString* error)
+{
+    close();
+    if (slotCount < 1 || maxCells < 1 || maxCells > (qulonglong(1) << 32))
+        return fail(error, "A flux ring needs at least one slot of 1 to 2^32 cells.");
+    const qulonglong slotBytes = (sizeof(TonatiuhFluxRingSlot) + maxCells*sizeof(double) + 63)/64*64;
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return fail(error, QString("Cannot create flux ring %1: %2").arg(fileName, m_file.errorString()));
+    m_size = qint64(sizeof(TonatiuhFluxRingHeader) + slotCount*slotBytes);
+    if (!m_file.resize(m_size) || !(m_data = m_file.map(0, m_size))) {
+        const QString message = QString("Cannot map flux ring %1: %2").arg(fileName, m_file.errorString());
+        close();
+        return fail(error, message);
+    }
+
+    // a new file is zeros, so no slot is written and head is 0
+    TonatiuhFluxRingHeader* header = reinterpret_cast<TonatiuhFluxRingHeader*>(m_data);
+    header->version = TONATIUH_FLUX_RING_VERSION;
+    header->slotCount = uint32_t(slotCount);
+    header->slotBytes = slotBytes;
+    header->maxCells = maxCells;
+    // readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    atomic(header->magic).store(TONATIUH_FLUX_RING_MAGIC, std::memory_order_release);
+    return true;
+}
+
+bool FluxRing::open(const QString& fileName, QString* error)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadWrite))
+        return fail(error, QString("Cannot open flux ring %1: %2").arg(fileName, m_file.errorString()));
+    m_size = m_file.size();
+    if (m_size < qint64(sizeof(TonatiuhFluxRingHeader)) || !(m_data = m_file.map(0, m_size))) {
+        close();
+        return fail(error, QString("%1 is not a flux ring.").arg(fileName));
+    }
+
+    TonatiuhFluxRingHeader* header = reinterpret_cast<TonatiuhFluxRingHeader*>(m_data);
+    const bool valid = atomic(header->magic).load(std::memory_order_acquire) == TONATIUH_FLUX_RING_MAGIC &&
+        header->version == TONATIUH_FLUX_RING_VERSION && header->slotCount > 0 &&
+        header->slotBytes >= sizeof(TonatiuhFluxRingSlot) + header->maxCells*sizeof(double) &&
+        sizeof(TonatiuhFluxRingHeader) + header->slotCount*header->slotBytes <= qulonglong(m_size);
+    if (!valid) {
+        close();
+        return fail(error, QString("%1 is not a flux ring of version %2.").arg(fileName).arg(TONATIUH_FLUX_RING_VERSION));
+    }
+    return true;
+}
+
+void FluxRing::close()
+{
+    if (m_data)
+        m_file.unmap(m_data);
+    m_data = nullptr;
+    m_size = 0;
+    if (m_file.isOpen())
+        m_file.close();
+}
+
+int FluxRing::getSlotCount() const
+{
+    return m_data ? int(reinterpret_cast<const TonatiuhFluxRingHeader*>(m_data)->slotCount) : 0;
+}
+
+qulonglong FluxRing::getMaxCells() const
+{
+    return m_data ? reinterpret_cast<const TonatiuhFluxRingHeader*>(m_data)->maxCells : 0;
+}
+
+qulonglong FluxRing::getHead() const
+{
+    if (!m_data) return 0;
+    TonatiuhFluxRingHeader* header = reinterpret_cast<TonatiuhFluxRingHeader*>(m_data);
+    return atomic(header->head).load(std::memory_order_acquire);
+}
+
+/*!
+ * Writes the next record as FluxRingLayout.h tells: the slot is marked odd,
+ * filled, and marked with the record before head moves to it.
+ */
+bool FluxRing::publish(const Record& record, const std::vector<double>& values, qulonglong* number, QString* error)
+{
+    if (!m_data)
+        return fail(error, "The flux ring is not open.");
+    TonatiuhFluxRingHeader* header = reinterpret_cast<TonatiuhFluxRingHeader*>(m_data);
+    if (record.rows < 1 || record.cols < 1 || values.size() != size_t(record.rows)*size_t(record.cols))
+        return fail(error, "A flux ring record needs rows by cols values.");
+    if (values.size() > header->maxCells)
+        return fail(error, QString("The flux ring holds grids of at most %1 cells.").arg(header->maxCells));
+
+    const qulonglong n = atomic(header->head).load(std::memory_order_relaxed) + 1;
+    TonatiuhFluxRingSlot* slot = tonatiuhFluxRingSlot(m_data, n);
+    atomic(slot->sequence).store(2*n - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->record = n;
+    slot->job = record.job;
+    slot->target = uint32_t(record.target);
+    slot->isFront = record.isFront ? 1 : 0;
+    slot->rows = uint32_t(record.rows);
+    slot->cols = uint32_t(record.cols);
+    slot->raysTraced = record.raysTraced;
+    slot->hits = record.hits;
+    slot->powerPerRay = record.powerPerRay;
+    slot->sunAzimuth = record.sunAzimuth;
+    slot->sunElevation = record.sunElevation;
+    std::memcpy(tonatiuhFluxRingValues(slot), values.data(), values.size()*sizeof(double));
+
+    atomic(slot->sequence).store(2*n, std::memory_order_release);
+    atomic(header->head).store(n, std::memory_order_release);
+    if (number) *number = n;
+    return true;
+}
+
+bool FluxRing::read(qulonglong number, Record* record, std::vector<double>* values) const
+{
+    if (!m_data || number == 0 || number > getHead()) return false;
+    TonatiuhFluxRingHeader* header = reinterpret_cast<TonatiuhFluxRingHeader*>(m_data);
+    TonatiuhFluxRingSlot* slot = tonatiuhFluxRingSlot(m_data, number);
+    if (atomic(slot->sequence).load(std::memory_order_acquire) != 2*number) return false;
+
+    TonatiuhFluxRingSlot copy;
+    std::memcpy(&copy, slot, sizeof(copy));
+    const size_t cells = qMin<qulonglong>(qulonglong(copy.rows)*copy.cols, header->maxCells);
+    std::vector<double> data(cells);
+    std::memcpy(data.data(), tonatiuhFluxRingValues(slot), cells*sizeof(double));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (atomic(slot->sequence).load(std::memory_order_relaxed) != 2*number) return false;
+
+    if (record) {
+        record->job = copy.job;
+        record->target = int(copy.target);
+        record->isFront = copy.isFront != 0;
+        record->rows = int(copy.rows);
+        record->cols = int(copy.cols);
+        record->raysTraced = copy.raysTraced;
+        record->hits = copy.hits;
+        record->powerPerRay = copy.powerPerRay;
+        record->sunAzimuth = copy.sunAzimuth;
+        record->sunElevation = copy.sunElevation;
+    }
+    if (values) values->swap(data);
+    return true;
+}
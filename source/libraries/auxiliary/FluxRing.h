@@ -0,0 +1,68 @@
+#pragma once
+
+#include "libraries/TonatiuhLibraries.h"
+
+#include <limits>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+
+
+//! FluxRing hands flux grids to other processes through a memory-mapped ring.
+/*!
+ * The ring is a file of a few slots, each holding one grid and what it is
+ * of, mapped by the writer and by its readers, so a thermal solver on the
+ * same machine gets every grid as soon as it is traced, without files to
+ * parse. Records are numbered from 1; a record takes the slot of the record
+ * slotCount before it, so readers must keep up. The layout and the protocol
+ * that lets readers check a record was not overwritten while they read it
+ * are those of FluxRingLayout.h, a C header for the readers.
+ *
+ * A ring has one writer, which creates the file; readers open it.
+ */
+class TONATIUH_LIBRARIES FluxRing
+{
+public:
+    struct Record
+    {
+        qulonglong job = 0;
+        int target = 0;
+        bool isFront = true;
+        int rows = 0; // along u
+        int cols = 0; // along v
+        qulonglong raysTraced = 0;
+        qulonglong hits = 0;
+        double powerPerRay = 0.;
+        double sunAzimuth = std::numeric_limits<double>::quiet_NaN(); // degrees, NaN for the sun of the scene
+        double sunElevation = std::numeric_limits<double>::quiet_NaN();
+    };
+
+    FluxRing();
+    ~FluxRing();
+
+    FluxRing(const FluxRing&) = delete;
+    FluxRing& operator=(const FluxRing&) = delete;
+
+    // replaces fileName with an empty ring of slotCount slots of maxCells values
+    bool create(const QString& fileName, int slotCount, qulonglong maxCells, QString* error = nullptr);
+    // an existing ring, to read
+    bool open(const QString& fileName, QString* error = nullptr);
+    void close();
+    bool isOpen() const {return m_data != nullptr;}
+
+    int getSlotCount() const;
+    qulonglong getMaxCells() const;
+    // the last record written, 0 for none
+    qulonglong getHead() const;
+
+    // by the writer; values are rows by cols, at most maxCells
+    bool publish(const Record& record, const std::vector<double>& values, qulonglong* number = nullptr, QString* error = nullptr);
+    // false if record number is not written yet or was overwritten
+    bool read(qulonglong number, Record* record, std::vector<double>* values) const;
+
+private:
+    QFile m_file;
+    uchar* m_data = nullptr;
+    qint64 m_size = 0;
+};
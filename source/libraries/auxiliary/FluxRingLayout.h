@@ -0,0 +1,76 @@
+#ifndef TONATIUHPP_FLUX_RING_LAYOUT_H
+#define TONATIUHPP_FLUX_RING_LAYOUT_H
+
+/*
+ * Layout of the flux ring files of tonatiuhpp, see FluxRing.
+ *
+ * This header is C and takes no other header of the tree, so that a solver
+ * in another process can map the file and read the grids in place. All
+ * fields are in the byte order of the host, which writes and reads them on
+ * the same machine.
+ *
+ * The file is a TonatiuhFluxRingHeader followed by slotCount slots of
+ * slotBytes bytes each. A slot is a TonatiuhFluxRingSlot followed by
+ * rows*cols doubles, row by row with rows along u, as the flux grid files.
+ * Records are numbered from 1 and record n is in slot (n - 1) % slotCount.
+ *
+ * The writer marks a slot odd, 2n - 1, before writing record n into it,
+ * and 2n once it is written, then sets head to n. A reader of record n:
+ *
+ *   1. loads head with acquire order, and waits while head < n;
+ *   2. loads sequence of the slot with acquire order, which must be 2n;
+ *   3. copies the slot header and the values;
+ *   4. issues an acquire fence and loads sequence again, which must still
+ *      be 2n, else the record was overwritten while read.
+ *
+ * A reader that falls slotCount records behind head has lost the records
+ * in between and takes up again at head.
+ */
+
+#include <stdint.h>
+
+#define TONATIUH_FLUX_RING_MAGIC 0x474e495258554c46ull /* "FLUXRING" little-endian */
+#define TONATIUH_FLUX_RING_VERSION 1u
+
+typedef struct TonatiuhFluxRingHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint64_t slotBytes; /* a multiple of 64, header included */
+    uint64_t maxCells; /* values a slot holds */
+    uint64_t head; /* last record written, 0 for none; atomic */
+    uint64_t reserved[3];
+} TonatiuhFluxRingHeader;
+
+typedef struct TonatiuhFluxRingSlot
+{
+    uint64_t sequence; /* 2n once record n is written, odd while written; atomic */
+    uint64_t record;
+    uint64_t job; /* of the service */
+    uint32_t target; /* index of the flux target in the job */
+    uint32_t isFront;
+    uint32_t rows; /* along u */
+    uint32_t cols; /* along v */
+    uint64_t raysTraced;
+    uint64_t hits;
+    double powerPerRay; /* W */
+    double sunAzimuth; /* degrees, NaN for the sun of the scene */
+    double sunElevation;
+    uint64_t reserved[6];
+} TonatiuhFluxRingSlot;
+
+/* the slot of record n > 0 */
+static inline TonatiuhFluxRingSlot* tonatiuhFluxRingSlot(void* file, uint64_t n)
+{
+    const TonatiuhFluxRingHeader* header = (const TonatiuhFluxRingHeader*) file;
+    return (TonatiuhFluxRingSlot*) ((char*) file + sizeof(TonatiuhFluxRingHeader) + (n - 1) % header->slotCount * header->slotBytes);
+}
+
+/* the values of a slot */
+static inline double* tonatiuhFluxRingValues(TonatiuhFluxRingSlot* slot)
+{
+    return (double*) (slot + 1);
+}
+
+#endif
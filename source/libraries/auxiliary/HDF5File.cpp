@@ -0,0 +1,300 @@
+#include "HDF5File.h"
+
+#include <QFile>
+
+#include <hdf5.h>
+
+static_assert(sizeof(hid_t) == sizeof(qint64), "hid_t is stored as qint64");
+
+
+namespace {
+
+const hsize_t ColumnChunk = 1 << 16;
+const hsize_t StringChunk = 256;
+
+// closes an HDF5 handle at the end of a scope
+struct Handle
+{
+    Handle(hid_t id, herr_t (*close)(hid_t)): id(id), close(close) {}
+    ~Handle() {if (id >= 0) close(id);}
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+    operator hid_t() const {return id;}
+
+    hid_t id;
+    herr_t (*close)(hid_t);
+};
+
+hid_t stringType()
+{
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, H5T_VARIABLE);
+    H5Tset_cset(type, H5T_CSET_UTF8);
+    return type;
+}
+
+// false if a link on the path is missing
+bool exists(hid_t file, const QString& path)
+{
+    QByteArray name;
+    for (const QString& part : path.split('/', Qt::SkipEmptyParts)) {
+        name += '/' + part.toUtf8();
+        if (H5Lexists(file, name.constData(), H5P_DEFAULT) <= 0)
+            return false;
+    }
+    return !name.isEmpty();
+}
+
+}
+
+
+HDF5File::HDF5File():
+    m_file(-1)
+{
+
+}
+
+HDF5File::~HDF5File()
+{
+    close();
+}
+
+/*!
+ * Opens \a path for writing, creating the file if needed.
+ * With \a truncate an existing file is emptied.
+ */
+bool HDF5File::open(const QString& path, bool truncate)
+{
+    close();
+    m_path = path;
+    m_error.clear();
+
+    // errors are reported by getError, not printed by the library
+    H5Eset_auto2(H5E_DEFAULT, 0, 0);
+
+    QByteArray name = path.toLocal8Bit();
+    hid_t file = -1;
+    if (!truncate && QFile::exists(path)) {
+        if (H5Fis_hdf5(name.constData()) <= 0)
+            return fail("Not an HDF5 file:");
+        file = H5Fopen(name.constData(), H5F_ACC_RDWR, H5P_DEFAULT);
+    } else
+        file = H5Fcreate(name.constData(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file < 0)
+        return fail("Could not open HDF5 file");
+    m_file = file;
+    return true;
+}
+
+bool HDF5File::close()
+{
+    if (m_file < 0) return true;
+    herr_t status = H5Fclose(m_file);
+    m_file = -1;
+    if (status < 0)
+        return fail("Could not close HDF5 file");
+    return true;
+}
+
+quint64 HDF5File::getRows(const QString& dataset) const
+{
+    if (m_file < 0 || !exists(m_file, dataset)) return 0;
+
+    Handle set(H5Dopen2(m_file, dataset.toUtf8().constData(), H5P_DEFAULT), H5Dclose);
+    if (set < 0) return 0;
+    Handle space(H5Dget_space(set), H5Sclose);
+    hsize_t dims[H5S_MAX_RANK];
+    if (H5Sget_simple_extent_dims(space, dims, 0) < 1) return 0;
+    return dims[0];
+}
+
+bool HDF5File::append(const QString& dataset, const std::vector<double>& values)
+{
+    quint64 dims[] = {values.size()};
+    return appendRows(dataset, H5T_NATIVE_DOUBLE, 1, dims, values.data());
+}
+
+bool HDF5File::append(const QString& dataset, const std::vector<quint64>& values)
+{
+    quint64 dims[] = {values.size()};
+    return appendRows(dataset, H5T_NATIVE_UINT64, 1, dims, values.data());
+}
+
+bool HDF5File::append(const QString& dataset, const std::vector<quint32>& values)
+{
+    quint64 dims[] = {values.size()};
+    return appendRows(dataset, H5T_NATIVE_UINT32, 1, dims, values.data());
+}
+
+bool HDF5File::append(const QString& dataset, const std::vector<quint8>& values)
+{
+    quint64 dims[] = {values.size()};
+    return appendRows(dataset, H5T_NATIVE_UINT8, 1, dims, values.data());
+}
+
+bool HDF5File::append(const QString& dataset, const QStringList& values)
+{
+    std::vector<QByteArray> bytes;
+    std::vector<const char*> data;
+    for (const QString& value : values)
+        bytes.push_back(value.toUtf8());
+    for (const QByteArray& b : bytes)
+        data.push_back(b.constData());
+
+    Handle type(stringType(), H5Tclose);
+    quint64 dims[] = {data.size()};
+    return appendRows(dataset, type, 1, dims, data.data());
+}
+
+bool HDF5File::appendGrid(const QString& dataset, int rows, int cols, const std::vector<double>& values)
+{
+    if (rows < 1 || cols < 1 || values.size() != size_t(rows)*size_t(cols))
+        return fail("Flux grid size does not match its dimensions for " + dataset + " in");
+    quint64 dims[] = {1, quint64(rows), quint64(cols)};
+    return appendRows(dataset, H5T_NATIVE_DOUBLE, 3, dims, values.data());
+}
+
+QStringList HDF5File::readStrings(const QString& dataset)
+{
+    QStringList ans;
+    quint64 rows = getRows(dataset);
+    if (rows == 0) return ans;
+
+    Handle set(H5Dopen2(m_file, dataset.toUtf8().constData(), H5P_DEFAULT), H5Dclose);
+    Handle type(stringType(), H5Tclose);
+    Handle space(H5Dget_space(set), H5Sclose);
+    std::vector<char*> data(rows, 0);
+    if (H5Dread(set, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.data()) < 0) {
+        fail("Could not read " + dataset + " from");
+        return ans;
+    }
+    for (char* s : data)
+        ans << QString::fromUtf8(s ? s : "");
+#if H5_VERSION_GE(1, 12, 0)
+    H5Treclaim(type, space, H5P_DEFAULT, data.data());
+#else
+    H5Dvlen_reclaim(type, space, H5P_DEFAULT, data.data());
+#endif
+    return ans;
+}
+
+bool HDF5File::setAttribute(const QString& name, double value)
+{
+    return writeAttribute(name, H5T_NATIVE_DOUBLE, &value);
+}
+
+bool HDF5File::setAttribute(const QString& name, const QString& value)
+{
+    QByteArray bytes = value.toUtf8();
+    const char* data = bytes.constData();
+    Handle type(stringType(), H5Tclose);
+    return writeAttribute(name, type, &data);
+}
+
+// opens the dataset or creates an empty extendable one
+qint64 HDF5File::openDataset(const QString& dataset, qint64 type, int rank, const quint64* dims)
+{
+    QByteArray name = dataset.toUtf8();
+    if (exists(m_file, dataset)) {
+        hid_t set = H5Dopen2(m_file, name.constData(), H5P_DEFAULT);
+        if (set < 0) return set;
+
+        // the trailing dimensions of grids must match
+        Handle space(H5Dget_space(set), H5Sclose);
+        hsize_t current[H5S_MAX_RANK];
+        bool ok = H5Sget_simple_extent_dims(space, current, 0) == rank;
+        for (int n = 1; ok && n < rank; ++n)
+            ok = current[n] == dims[n];
+        if (!ok) {
+            H5Dclose(set);
+            fail("Shape of " + dataset + " does not match in");
+            return -1;
+        }
+        return set;
+    }
+
+    hsize_t zero[H5S_MAX_RANK];
+    hsize_t maxDims[H5S_MAX_RANK];
+    hsize_t chunk[H5S_MAX_RANK];
+    for (int n = 0; n < rank; ++n) {
+        zero[n] = n == 0 ? 0 : dims[n];
+        maxDims[n] = n == 0 ? H5S_UNLIMITED : dims[n];
+        chunk[n] = dims[n];
+    }
+    if (rank == 1)
+        chunk[0] = H5Tis_variable_str(type) > 0 ? StringChunk : ColumnChunk;
+    else
+        chunk[0] = 1;
+
+    Handle space(H5Screate_simple(rank, zero, maxDims), H5Sclose);
+    Handle properties(H5Pcreate(H5P_DATASET_CREATE), H5Pclose);
+    H5Pset_chunk(properties, rank, chunk);
+    if (H5Tis_variable_str(type) <= 0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0) {
+        H5Pset_shuffle(properties);
+        H5Pset_deflate(properties, 4);
+    }
+    Handle links(H5Pcreate(H5P_LINK_CREATE), H5Pclose);
+    H5Pset_create_intermediate_group(links, 1);
+
+    return H5Dcreate2(m_file, name.constData(), type, space, links, properties, H5P_DEFAULT);
+}
+
+// appends dims[0] rows, data holds the whole slab in row-major order
+bool HDF5File::appendRows(const QString& dataset, qint64 type, int rank, const quint64* dims, const void* data)
+{
+    if (m_file < 0)
+        return fail("HDF5 file is not open");
+
+    Handle set(openDataset(dataset, type, rank, dims), H5Dclose);
+    if (set < 0) {
+        if (m_error.isEmpty()) fail("Could not create " + dataset + " in");
+        return false;
+    }
+    if (dims[0] == 0) return true;
+
+    hsize_t current[H5S_MAX_RANK];
+    {
+        Handle space(H5Dget_space(set), H5Sclose);
+        H5Sget_simple_extent_dims(space, current, 0);
+    }
+    hsize_t offset[H5S_MAX_RANK] = {};
+    hsize_t count[H5S_MAX_RANK];
+    hsize_t extent[H5S_MAX_RANK];
+    for (int n = 0; n < rank; ++n) {
+        count[n] = dims[n];
+        extent[n] = current[n];
+    }
+    offset[0] = current[0];
+    extent[0] += dims[0];
+    if (H5Dset_extent(set, extent) < 0)
+        return fail("Could not extend " + dataset + " in");
+
+    Handle fileSpace(H5Dget_space(set), H5Sclose);
+    Handle memorySpace(H5Screate_simple(rank, count, 0), H5Sclose);
+    if (H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, offset, 0, count, 0) < 0 ||
+        H5Dwrite(set, type, memorySpace, fileSpace, H5P_DEFAULT, data) < 0)
+        return fail("Could not write " + dataset + " to");
+    return true;
+}
+
+bool HDF5File::writeAttribute(const QString& name, qint64 type, const void* data)
+{
+    if (m_file < 0)
+        return fail("HDF5 file is not open");
+
+    QByteArray bytes = name.toUtf8();
+    if (H5Aexists(m_file, bytes.constData()) > 0)
+        H5Adelete(m_file, bytes.constData());
+
+    Handle space(H5Screate(H5S_SCALAR), H5Sclose);
+    Handle attribute(H5Acreate2(m_file, bytes.constData(), type, space, H5P_DEFAULT, H5P_DEFAULT), H5Aclose);
+    if (attribute < 0 || H5Awrite(attribute, type, data) < 0)
+        return fail("Could not write attribute " + name + " to");
+    return true;
+}
+
+bool HDF5File::fail(const QString& message)
+{
+    m_error = QString("%1 %2").arg(message, m_path);
+    return false;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "libraries/TonatiuhLibraries.h"
+
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+
+//! HDF5File appends rows to chunked, extendable HDF5 datasets.
+/*!
+ * Every dataset has an unlimited first dimension: columns are 1D arrays
+ * and grids are 3D arrays of shape (n, rows, cols), one grid per append.
+ * Datasets and intermediate groups are created on first use, so a file
+ * opened again with truncate = false keeps growing without rewriting
+ * what is already stored.
+ *
+ * Built only with TONATIUHPP_ENABLE_HDF5 (TONATIUHPP_HDF5 defined).
+ */
+class TONATIUH_LIBRARIES HDF5File
+{
+public:
+    HDF5File();
+    ~HDF5File();
+
+    HDF5File(const HDF5File&) = delete;
+    HDF5File& operator=(const HDF5File&) = delete;
+
+    bool open(const QString& path, bool truncate);
+    bool close();
+    bool isOpen() const {return m_file >= 0;}
+    const QString& getPath() const {return m_path;}
+    QString getError() const {return m_error;}
+
+    // rows in the first dimension, 0 if the dataset does not exist
+    quint64 getRows(const QString& dataset) const;
+
+    bool append(const QString& dataset, const std::vector<double>& values);
+    bool append(const QString& dataset, const std::vector<quint64>& values);
+    bool append(const QString& dataset, const std::vector<quint32>& values);
+    bool append(const QString& dataset, const std::vector<quint8>& values);
+    bool append(const QString& dataset, const QStringList& values);
+    bool appendGrid(const QString& dataset, int rows, int cols, const std::vector<double>& values);
+
+    QStringList readStrings(const QString& dataset);
+
+    // attributes of the root group, replaced if present
+    bool setAttribute(const QString& name, double value);
+    bool setAttribute(const QString& name, const QString& value);
+
+private:
+    qint64 openDataset(const QString& dataset, qint64 type, int rank, const quint64* dims);
+    bool appendRows(const QString& dataset, qint64 type, int rank, const quint64* dims, const void* data);
+    bool writeAttribute(const QString& name, qint64 type, const void* data);
+    bool fail(const QString& message);
+
+    QString m_path;
+    qint64 m_file; // hid_t
+    QString m_error;
+};
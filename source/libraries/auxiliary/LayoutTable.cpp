@@ -0,0 +1,161 @@
+#include "LayoutTable.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+namespace {
+
+// chunks below this size are not worth a thread
+const std::size_t ChunkMin = 1 << 18;
+
+struct Chunk
+{
+    std::vector<std::vector<double>> values;
+    std::size_t rows = 0; // lines, blank ones too, to locate errors
+    std::size_t badRow = 0; // of the chunk, from 1
+};
+
+inline bool isSeparator(char c)
+{
+    return c == ',' || c == '\t' || c == ';';
+}
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// a number with spaces around, a plus sign allowed
+bool parseDouble(const char* p, const char* end, double* value)
+{
+    while (p < end && *p == ' ') ++p;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\r')) --end;
+    if (end - p > 1 && *p == '+' && p[1] != '-') ++p;
+    if (p == end) return false;
+    std::from_chars_result r = std::from_chars(p, end, *value);
+    return r.ec == std::errc() && r.ptr == end;
+}
+
+const char* findLineEnd(const char* p, const char* end)
+{
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return eol ? eol : end;
+}
+
+// the fields of a line, the columns in order of the line
+bool parseLine(const char* p, const char* end, const std::vector<int>& order, const std::vector<int>& columns,
+               std::vector<std::vector<double>>& values)
+{
+    int column = 0;
+    std::size_t next = 0; // in order
+    while (next < order.size()) {
+        const char* fieldEnd = p;
+        while (fieldEnd < end && !isSeparator(*fieldEnd)) ++fieldEnd;
+        while (next < order.size() && columns[order[next]] == column) {
+            double value;
+            if (!parseDouble(p, fieldEnd, &value)) return false;
+            values[order[next]].push_back(value);
+            ++next;
+        }
+        if (fieldEnd == end) break;
+        p = fieldEnd + 1;
+        ++column;
+    }
+    return next == order.size();
+}
+
+void parseChunk(const char* p, const char* end, const std::vector<int>& order, const std::vector<int>& columns, Chunk& chunk)
+{
+    chunk.values.resize(columns.size());
+    while (p < end)
+    {
+        const char* lineEnd = findLineEnd(p, end);
+        ++chunk.rows;
+        const char* q = p;
+        while (q < lineEnd && isSpace(*q)) ++q;
+        if (q < lineEnd && !parseLine(p, lineEnd, order, columns, chunk.values)) {
+            chunk.badRow = chunk.rows;
+            return;
+        }
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+} // namespace
+
+
+bool LayoutTable::read(
+    const char* text, std::size_t size,
+    int headerRows, const std::vector<int>& columns,
+    std::vector<std::vector<double>>* values,
+    std::string* error, int threads)
+{
+    values->assign(columns.size(), std::vector<double>());
+    for (int c : columns) {
+        if (c < 0) {
+            if (error) *error = "Column numbers start at 0.";
+            return false;
+        }
+    }
+
+    const char* begin = text;
+    const char* end = text + size;
+    if (size >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0) begin += 3;
+    for (int n = 0; n < headerRows && begin < end; ++n) {
+        const char* lineEnd = findLineEnd(begin, end);
+        begin = lineEnd < end ? lineEnd + 1 : end;
+    }
+    size = end - begin;
+
+    // the columns as they come along a line
+    std::vector<int> order(columns.size());
+    for (std::size_t k = 0; k < order.size(); ++k)
+        order[k] = int(k);
+    std::stable_sort(order.begin(), order.end(), [&columns](int a, int b) {return columns[a] < columns[b];});
+
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = int(std::min<std::size_t>(threads, size/ChunkMin + 1));
+
+    // chunks start after a line feed
+    std::vector<const char*> starts = {begin};
+    for (int n = 1; n < threads; ++n) {
+        const char* p = std::max(begin + size*n/threads, starts.back());
+        while (p < end && *p != '\n') ++p;
+        if (p < end) starts.push_back(p + 1);
+    }
+    starts.push_back(end);
+
+    std::vector<Chunk> chunks(starts.size() - 1);
+    if (chunks.size() == 1) {
+        parseChunk(starts[0], starts[1], order, columns, chunks[0]);
+    } else {
+        std::vector<std::thread> pool;
+        for (std::size_t n = 0; n < chunks.size(); ++n)
+            pool.emplace_back(parseChunk, starts[n], starts[n + 1], std::cref(order), std::cref(columns), std::ref(chunks[n]));
+        for (std::thread& t : pool)
+            t.join();
+    }
+
+    std::size_t rows = headerRows;
+    std::size_t total = 0;
+    for (const Chunk& chunk : chunks) {
+        if (chunk.badRow > 0) {
+            if (error) *error = "Row " + std::to_string(rows + chunk.badRow) + " has no number in a column read.";
+            values->assign(columns.size(), std::vector<double>());
+            return false;
+        }
+        rows += chunk.rows;
+        total += chunk.values.empty() ? 0 : chunk.values[0].size();
+    }
+
+    for (std::size_t k = 0; k < columns.size(); ++k) {
+        std::vector<double>& column = (*values)[k];
+        column.reserve(total);
+        for (const Chunk& chunk : chunks)
+            column.insert(column.end(), chunk.values[k].begin(), chunk.values[k].end());
+    }
+    return true;
+}
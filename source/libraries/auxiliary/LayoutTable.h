@@ -0,0 +1,33 @@
+#pragma once
+
+#include "libraries/TonatiuhLibraries.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+//! LayoutTable reads columns of numbers from delimited text on several threads.
+/*!
+ * Layout files, as those of SolarPILOT, hold a row per heliostat with its
+ * position, aiming point and other fields separated by commas, tabs or
+ * semicolons. After the header rows the text is split at line ends and the
+ * chunks are parsed in parallel by std::from_chars, keeping only the
+ * columns asked for, then joined in file order.
+ *
+ * Blank lines are skipped. A row where one of the columns is missing or
+ * is not a number fails the read, with the row in the error; fields that
+ * are not read, as the NULL entries of SolarPILOT, do not matter.
+ */
+class TONATIUH_LIBRARIES LayoutTable
+{
+public:
+    // columns numbered from 0, values[k] gets the rows of columns[k];
+    // threads = 0 uses the hardware concurrency
+    static bool read(
+        const char* text, std::size_t size,
+        int headerRows, const std::vector<int>& columns,
+        std::vector<std::vector<double>>* values,
+        std::string* error = nullptr, int threads = 0
+    );
+};
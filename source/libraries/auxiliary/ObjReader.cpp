@@ -0,0 +1,296 @@
+#include "ObjReader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace {
+
+// chunks below this size are not worth a thread
+const std::size_t ChunkMin = 1 << 20;
+
+struct Chunk
+{
+    struct Name {
+        std::size_t triangle; // triangles of the chunk before the g or o line
+        std::string name;
+    };
+
+    std::vector<tinyobj::real_t> vertices;
+    std::vector<tinyobj::real_t> normals;
+    std::vector<tinyobj::index_t> indices; // 3 per triangle
+    std::vector<Name> names;
+    bool ok = true;
+};
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+inline bool isDigit(char c)
+{
+    return unsigned(c - '0') < 10u;
+}
+
+inline void skipSpaces(const char*& p, const char* end)
+{
+    while (p < end && isSpace(*p)) ++p;
+}
+
+// tinyobj's tryParseDouble, so both readers round alike
+bool parseDouble(const char* s, const char* end, double* result)
+{
+    if (s >= end) return false;
+
+    double mantissa = 0.;
+    int exponent = 0;
+    char sign = '+';
+    const char* p = s;
+    bool leadingDot = false;
+
+    if (*p == '+' || *p == '-') {
+        sign = *p++;
+        if (p != end && *p == '.') leadingDot = true;
+    } else if (*p == '.') {
+        leadingDot = true;
+    } else if (!isDigit(*p)) {
+        return false;
+    }
+
+    if (!leadingDot) {
+        int read = 0;
+        for (; p != end && isDigit(*p); ++p, ++read) {
+            mantissa *= 10;
+            mantissa += int(*p - '0');
+        }
+        if (read == 0) return false;
+    }
+
+    if (p != end && *p == '.') {
+        static const double powers[] = {1., 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001};
+        const int nPowers = sizeof(powers)/sizeof(powers[0]);
+        ++p;
+        for (int read = 1; p != end && isDigit(*p); ++p, ++read)
+            mantissa += int(*p - '0')*(read < nPowers ? powers[read] : std::pow(10., -read));
+    }
+
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        char expSign = '+';
+        if (p != end && (*p == '+' || *p == '-'))
+            expSign = *p++;
+        else if (p == end || !isDigit(*p))
+            return false;
+        int read = 0;
+        for (; p != end && isDigit(*p); ++p, ++read) {
+            exponent *= 10;
+            exponent += int(*p - '0');
+        }
+        if (read == 0) return false;
+        if (expSign == '-') exponent = -exponent;
+    }
+
+    *result = (sign == '+' ? 1 : -1)*(exponent ? std::ldexp(mantissa*std::pow(5., exponent), exponent) : mantissa);
+    return true;
+}
+
+// tinyobj's parseReal, a token that is not a number reads as 0
+tinyobj::real_t parseReal(const char*& p, const char* end)
+{
+    skipSpaces(p, end);
+    const char* tokenEnd = p;
+    while (tokenEnd < end && !isSpace(*tokenEnd)) ++tokenEnd;
+    double value = 0.;
+    parseDouble(p, tokenEnd, &value);
+    p = tokenEnd;
+    return tinyobj::real_t(value);
+}
+
+// a positive one-based index, anything else is left to tinyobj
+bool parseIndex(const char*& p, const char* end, int* index)
+{
+    int value = 0;
+    int read = 0;
+    for (; p < end && isDigit(*p); ++p, ++read) {
+        if (read == 9) return false;
+        value = value*10 + int(*p - '0');
+    }
+    if (value == 0) return false;
+    if (p < end && *p != '/' && !isSpace(*p)) return false;
+    *index = value - 1;
+    return true;
+}
+
+// v, v/t, v//n or v/t/n
+bool parseCorner(const char*& p, const char* end, tinyobj::index_t* index)
+{
+    index->vertex_index = -1;
+    index->normal_index = -1;
+    index->texcoord_index = -1;
+    if (!parseIndex(p, end, &index->vertex_index)) return false;
+    if (p == end || *p != '/') return true;
+    ++p;
+    if (p < end && *p == '/') {
+        ++p;
+        return parseIndex(p, end, &index->normal_index);
+    }
+    if (!parseIndex(p, end, &index->texcoord_index)) return false;
+    if (p == end || *p != '/') return true;
+    ++p;
+    return parseIndex(p, end, &index->normal_index);
+}
+
+// a line without its end, as tinyobj::LoadObj sees it
+bool parseLine(const char* p, const char* end, Chunk& chunk)
+{
+    skipSpaces(p, end);
+    if (p == end || *p == '#') return true;
+
+    if (p[0] == 'v' && p + 1 < end && isSpace(p[1])) {
+        p += 2;
+        for (int k = 0; k < 3; ++k)
+            chunk.vertices.push_back(parseReal(p, end));
+        return true;
+    }
+
+    if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && isSpace(p[2])) {
+        p += 3;
+        for (int k = 0; k < 3; ++k)
+            chunk.normals.push_back(parseReal(p, end));
+        return true;
+    }
+
+    if (p[0] == 'f' && p + 1 < end && isSpace(p[1])) {
+        p += 2;
+        skipSpaces(p, end);
+        tinyobj::index_t corners[3];
+        int n = 0;
+        while (p < end) {
+            if (n == 3 || !parseCorner(p, end, &corners[n++])) return false;
+            skipSpaces(p, end);
+        }
+        if (n != 3) return false;
+        chunk.indices.insert(chunk.indices.end(), corners, corners + 3);
+        return true;
+    }
+
+    if (p[0] == 'g' && p + 1 < end && isSpace(p[1])) {
+        // the names after g joined by a space
+        std::string name;
+        for (p += 1, skipSpaces(p, end); p < end; skipSpaces(p, end)) {
+            const char* tokenEnd = p;
+            while (tokenEnd < end && !isSpace(*tokenEnd)) ++tokenEnd;
+            if (!name.empty()) name += ' ';
+            name.append(p, tokenEnd);
+            p = tokenEnd;
+        }
+        chunk.names.push_back({chunk.indices.size()/3, name});
+        return true;
+    }
+
+    if (p[0] == 'o' && p + 1 < end && isSpace(p[1])) {
+        chunk.names.push_back({chunk.indices.size()/3, std::string(p + 2, end)});
+        return true;
+    }
+
+    // lines and points make shapes of their own
+    if ((p[0] == 'l' || p[0] == 'p') && p + 1 < end && isSpace(p[1]))
+        return false;
+
+    // texture coordinates, materials, smoothing groups and unknown commands
+    return true;
+}
+
+void parseChunk(const char* p, const char* end, Chunk& chunk)
+{
+    while (p < end && chunk.ok)
+    {
+        const char* lineEnd = p;
+        while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r') ++lineEnd;
+        chunk.ok = parseLine(p, lineEnd, chunk);
+        p = lineEnd;
+        if (p < end && *p == '\r') ++p;
+        if (p < end && *p == '\n') ++p;
+    }
+}
+
+void appendTriangles(const Chunk& chunk, std::size_t a, std::size_t b, const std::string& name, tinyobj::shape_t& shape)
+{
+    if (a == b) return;
+    tinyobj::mesh_t& mesh = shape.mesh;
+    if (mesh.indices.empty()) shape.name = name;
+    mesh.indices.insert(mesh.indices.end(), chunk.indices.begin() + 3*a, chunk.indices.begin() + 3*b);
+    mesh.num_face_vertices.resize(mesh.num_face_vertices.size() + (b - a), 3);
+    mesh.material_ids.resize(mesh.material_ids.size() + (b - a), -1);
+    mesh.smoothing_group_ids.resize(mesh.smoothing_group_ids.size() + (b - a), 0);
+}
+
+} // namespace
+
+
+bool ObjReader::read(
+    const char* text, std::size_t size,
+    tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+    int threads)
+{
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = int(std::min<std::size_t>(threads, size/ChunkMin + 1));
+
+    // chunks start after a line feed
+    std::vector<const char*> starts = {text};
+    for (int n = 1; n < threads; ++n) {
+        const char* p = std::max(text + size*n/threads, starts.back());
+        const char* end = text + size;
+        while (p < end && *p != '\n') ++p;
+        if (p < end) starts.push_back(p + 1);
+    }
+    starts.push_back(text + size);
+
+    std::vector<Chunk> chunks(starts.size() - 1);
+    if (chunks.size() == 1) {
+        parseChunk(starts[0], starts[1], chunks[0]);
+    } else {
+        std::vector<std::thread> pool;
+        for (std::size_t n = 0; n < chunks.size(); ++n)
+            pool.emplace_back(parseChunk, starts[n], starts[n + 1], std::ref(chunks[n]));
+        for (std::thread& t : pool)
+            t.join();
+    }
+
+    std::size_t nVertices = 0;
+    std::size_t nNormals = 0;
+    for (const Chunk& chunk : chunks) {
+        if (!chunk.ok) return false;
+        nVertices += chunk.vertices.size();
+        nNormals += chunk.normals.size();
+    }
+
+    *attrib = tinyobj::attrib_t();
+    attrib->vertices.reserve(nVertices);
+    attrib->normals.reserve(nNormals);
+    shapes->clear();
+
+    // a g or o line ends the shape, which is kept when it has faces
+    tinyobj::shape_t shape;
+    std::string name;
+    for (const Chunk& chunk : chunks)
+    {
+        attrib->vertices.insert(attrib->vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        attrib->normals.insert(attrib->normals.end(), chunk.normals.begin(), chunk.normals.end());
+
+        std::size_t a = 0;
+        for (const Chunk::Name& event : chunk.names) {
+            appendTriangles(chunk, a, event.triangle, name, shape);
+            if (!shape.mesh.indices.empty()) shapes->push_back(std::move(shape));
+            shape = tinyobj::shape_t();
+            name = event.name;
+            a = event.triangle;
+        }
+        appendTriangles(chunk, a, chunk.indices.size()/3, name, shape);
+    }
+    if (!shape.mesh.indices.empty()) shapes->push_back(std::move(shape));
+    return true;
+}
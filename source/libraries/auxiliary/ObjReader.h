@@ -0,0 +1,33 @@
+#pragma once
+
+#include "libraries/TonatiuhLibraries.h"
+
+#include <cstddef>
+#include <vector>
+
+#include "libraries/auxiliary/tiny_obj_loader.h"
+
+
+//! ObjReader parses triangulated OBJ text on several threads.
+/*!
+ * The text is split at line ends and the chunks are parsed in parallel,
+ * then vertices, normals and faces are joined in file order.
+ * Numbers are rounded as by tinyobj::LoadObj and shapes are split at the
+ * same g and o lines, so both readers give the same attrib_t::vertices,
+ * attrib_t::normals and shape names and indices.
+ * Texture coordinates and materials are not read.
+ *
+ * Only triangles with positive indices are read; for anything else
+ * (polygons, negative indices, lines or points) read() fails and callers
+ * fall back to tinyobj::LoadObj.
+ */
+class TONATIUH_LIBRARIES ObjReader
+{
+public:
+    // threads = 0 uses the hardware concurrency
+    static bool read(
+        const char* text, std::size_t size,
+        tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+        int threads = 0
+    );
+};
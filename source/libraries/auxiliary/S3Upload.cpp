@@ -0,0 +1,309 @@
+#include "S3Upload.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QEventLoop>
+#include <QMessageAuthenticationCode>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QThread>
+#include <QUrl>
+#include <QXmlStreamReader>
+
+
+namespace {
+
+const qint64 MinPartSize = qint64(5) << 20;
+
+struct Response
+{
+    int status = 0; // 0 without an HTTP answer
+    QByteArray body;
+    QByteArray etag;
+    QString error;
+};
+
+QString environment(const char* name, const char* fallback = nullptr)
+{
+    QString ans = qEnvironmentVariable(name);
+    if (ans.isEmpty() && fallback)
+        ans = qEnvironmentVariable(fallback);
+    return ans;
+}
+
+QByteArray hmac(const QByteArray& key, const QByteArray& message)
+{
+    return QMessageAuthenticationCode::hash(message, key, QCryptographicHash::Sha256);
+}
+
+// text of the first element name in an S3 XML answer
+QString xmlValue(const QByteArray& body, const QString& name)
+{
+    QXmlStreamReader xml(body);
+    while (!xml.atEnd())
+        if (xml.readNext() == QXmlStreamReader::StartElement && xml.name() == name)
+            return xml.readElementText();
+    return QString();
+}
+
+bool isTransient(const Response& response)
+{
+    const int status = response.status;
+    // S3 may answer a completion with 200 and an error body
+    return status == 0 || status == 408 || status == 429 || status >= 500 || (status >= 200 && status < 300);
+}
+
+/*!
+ * Sends one signed request for the object key of bucket, retried as the
+ * class comment says; query is canonical, its names sorted and its values
+ * encoded.
+ */
+bool sendRequest(const S3Upload::Settings& settings, const QString& bucket, const QString& key, const QByteArray& method,
+          const QByteArray& query, const QByteArray& body, Response* response)
+{
+    const QUrl endpoint(settings.endpoint);
+    if (!endpoint.isValid() || endpoint.host().isEmpty()) {
+        response->error = QString("Invalid S3 endpoint %1.").arg(settings.endpoint);
+        return false;
+    }
+    QByteArray host = endpoint.host().toUtf8();
+    const int defaultPort = endpoint.scheme() == "http" ? 80 : 443;
+    if (endpoint.port() != -1 && endpoint.port() != defaultPort)
+        host += ':' + QByteArray::number(endpoint.port());
+    const QByteArray path = QString("/%1/%2").arg(bucket, key).toUtf8().toPercentEncoding("/");
+    const QUrl url = QUrl::fromEncoded(endpoint.scheme().toLatin1() + "://" + host + path + (query.isEmpty() ? QByteArray() : "?" + query), QUrl::StrictMode);
+    const QByteArray payloadHash = QCryptographicHash::hash(body, QCryptographicHash::Sha256).toHex();
+
+    for (int attempt = 1; ; ++attempt) {
+        const QByteArray amzDate = QDateTime::currentDateTimeUtc().toString("yyyyMMdd'T'HHmmss'Z'").toLatin1();
+        QList<QPair<QByteArray, QByteArray>> headers = {{"host", host}, {"x-amz-content-sha256", payloadHash}, {"x-amz-date", amzDate}};
+        if (!settings.sessionToken.isEmpty())
+            headers.append({"x-amz-security-token", settings.sessionToken.toUtf8()});
+
+        QNetworkRequest request(url);
+        for (const auto& header : headers)
+            if (header.first != "host")
+                request.setRawHeader(header.first, header.second);
+        request.setRawHeader("Authorization", S3Upload::authorization(settings, method, path, query, headers, payloadHash, amzDate));
+        request.setTransferTimeout(settings.timeout*1000);
+
+        // a manager of the calling thread, which need not run an event loop
+        QNetworkAccessManager manager;
+        QNetworkReply* reply = manager.sendCustomRequest(request, method, body);
+        QEventLoop loop;
+        QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+        if (!reply->isFinished())
+            loop.exec();
+
+        response->status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        response->body = reply->readAll();
+        response->etag = reply->rawHeader("ETag");
+        const QString networkError = reply->errorString();
+        delete reply;
+
+        const bool answered = response->status >= 200 && response->status < 300;
+        if (answered && !response->body.contains("<Error>"))
+            return true;
+
+        if (response->status == 0)
+            response->error = networkError;
+        else {
+            const QString code = xmlValue(response->body, "Code");
+            const QString message = xmlValue(response->body, "Message");
+            response->error = QString("HTTP %1 %2 %3").arg(response->status).arg(code, message).trimmed();
+        }
+        if (!isTransient(*response) || attempt >= settings.attempts)
+            return false;
+        QThread::msleep(500UL << qMin(attempt - 1, 6));
+    }
+}
+
+}
+
+
+S3Upload::Settings S3Upload::settingsFromEnvironment()
+{
+    Settings ans;
+    ans.region = environment("AWS_REGION", "AWS_DEFAULT_REGION");
+    if (ans.region.isEmpty())
+        ans.region = "us-east-1";
+    ans.endpoint = environment("AWS_ENDPOINT_URL_S3", "AWS_ENDPOINT_URL");
+    if (ans.endpoint.isEmpty())
+        ans.endpoint = QString("https://s3.%1.amazonaws.com").arg(ans.region);
+    ans.accessKey = environment("AWS_ACCESS_KEY_ID");
+    ans.secretKey = environment("AWS_SECRET_ACCESS_KEY");
+    ans.sessionToken = environment("AWS_SESSION_TOKEN");
+    const qint64 partMB = environment("TONATIUHPP_S3_PART_MB").toLongLong();
+    if (partMB > 0)
+        ans.partSize = partMB << 20;
+    return ans;
+}
+
+bool S3Upload::parseUrl(const QString& url, QString* bucket, QString* key)
+{
+    if (!isUrl(url)) return false;
+    const QString path = url.mid(5);
+    const int slash = path.indexOf('/');
+    if (slash <= 0 || slash + 1 == path.size()) return false;
+    *bucket = path.left(slash);
+    *key = path.mid(slash + 1);
+    return true;
+}
+
+QString S3Upload::join(const QString& url, const QString& name)
+{
+    return url.endsWith('/') ? url + name : url + '/' + name;
+}
+
+S3Upload::S3Upload(const QString& url, const Settings& settings):
+    m_url(url),
+    m_settings(settings)
+{
+    m_settings.partSize = qMax(m_settings.partSize, MinPartSize);
+    if (!parseUrl(url, &m_bucket, &m_key))
+        m_error = QString("%1 is not an s3://bucket/key URL.").arg(url);
+    else if (m_settings.accessKey.isEmpty() || m_settings.secretKey.isEmpty())
+        m_error = "S3 credentials are missing: set AWS_ACCESS_KEY_ID and AWS_SECRET_ACCESS_KEY.";
+}
+
+S3Upload::~S3Upload()
+{
+    if (!m_finished)
+        abort();
+}
+
+bool S3Upload::write(const QByteArray& data)
+{
+    if (!m_error.isEmpty()) return false;
+    if (m_finished) return fail("The upload is finished.");
+
+    m_buffer.append(data);
+    m_bytes += data.size();
+    while (m_buffer.size() >= m_settings.partSize) {
+        if (!uploadPart(m_buffer.left(m_settings.partSize)))
+            return false;
+        m_buffer.remove(0, m_settings.partSize);
+    }
+    return true;
+}
+
+bool S3Upload::finish()
+{
+    if (m_finished) return m_error.isEmpty();
+    if (!m_error.isEmpty()) {
+        abort();
+        return false;
+    }
+
+    Response response;
+    if (m_uploadId.isEmpty()) {
+        m_finished = true;
+        if (!sendRequest(m_settings, m_bucket, m_key, "PUT", QByteArray(), m_buffer, &response))
+            return fail(QString("Cannot upload %1: %2").arg(m_url, response.error));
+        m_buffer.clear();
+        return true;
+    }
+
+    if (!m_buffer.isEmpty() && !uploadPart(m_buffer)) {
+        abort();
+        return false;
+    }
+    m_buffer.clear();
+
+    QByteArray xml = "<CompleteMultipartUpload>";
+    for (int n = 0; n < m_etags.size(); ++n)
+        xml += "<Part><PartNumber>" + QByteArray::number(n + 1) + "</PartNumber><ETag>" + m_etags[n] + "</ETag></Part>";
+    xml += "</CompleteMultipartUpload>";
+    if (!sendRequest(m_settings, m_bucket, m_key, "POST", "uploadId=" + m_uploadId.toUtf8().toPercentEncoding(), xml, &response)) {
+        fail(QString("Cannot complete the upload of %1: %2").arg(m_url, response.error));
+        abort();
+        return false;
+    }
+    m_finished = true;
+    return true;
+}
+
+void S3Upload::abort()
+{
+    m_finished = true;
+    m_buffer.clear();
+    if (m_uploadId.isEmpty()) return;
+
+    Response response;
+    if (!sendRequest(m_settings, m_bucket, m_key, "DELETE", "uploadId=" + m_uploadId.toUtf8().toPercentEncoding(), QByteArray(), &response))
+        qWarning("Cannot abort the upload of %s: %s", qPrintable(m_url), qPrintable(response.error));
+    m_uploadId.clear();
+}
+
+bool S3Upload::put(const QString& url, const QByteArray& data, QString* error, const Settings& settings)
+{
+    S3Upload upload(url, settings);
+    if (upload.write(data) && upload.finish())
+        return true;
+    if (error) *error = upload.getError();
+    return false;
+}
+
+/*!
+ * Signature Version 4: the canonical request is hashed into the string to
+ * sign, which is signed with a key derived from the secret for the day,
+ * region and service.
+ */
+QByteArray S3Upload::authorization(const Settings& settings, const QByteArray& method, const QByteArray& path, const QByteArray& query,
+                                   const QList<QPair<QByteArray, QByteArray>>& headers, const QByteArray& payloadHash, const QByteArray& amzDate)
+{
+    QByteArray canonical = method + '\n' + path + '\n' + query + '\n';
+    QByteArray names;
+    for (const auto& header : headers) {
+        canonical += header.first + ':' + header.second.trimmed() + '\n';
+        if (!names.isEmpty())
+            names += ';';
+        names += header.first;
+    }
+    canonical += '\n' + names + '\n' + payloadHash;
+
+    const QByteArray date = amzDate.left(8);
+    const QByteArray region = settings.region.toUtf8();
+    const QByteArray scope = date + '/' + region + "/s3/aws4_request";
+    const QByteArray toSign = "AWS4-HMAC-SHA256\n" + amzDate + '\n' + scope + '\n' +
+        QCryptographicHash::hash(canonical, QCryptographicHash::Sha256).toHex();
+
+    QByteArray key = hmac("AWS4" + settings.secretKey.toUtf8(), date);
+    key = hmac(key, region);
+    key = hmac(key, "s3");
+    key = hmac(key, "aws4_request");
+    return "AWS4-HMAC-SHA256 Credential=" + settings.accessKey.toUtf8() + '/' + scope +
+        ",SignedHeaders=" + names + ",Signature=" + hmac(key, toSign).toHex();
+}
+
+bool S3Upload::uploadPart(const QByteArray& data)
+{
+    Response response;
+    if (m_uploadId.isEmpty()) {
+        if (!sendRequest(m_settings, m_bucket, m_key, "POST", "uploads=", QByteArray(), &response))
+            return fail(QString("Cannot start the upload of %1: %2").arg(m_url, response.error));
+        m_uploadId = xmlValue(response.body, "UploadId");
+        if (m_uploadId.isEmpty())
+            return fail(QString("Cannot start the upload of %1: no upload ID in the answer.").arg(m_url));
+    }
+
+    // S3 allows 10000 parts
+    const int part = int(m_etags.size()) + 1;
+    if (part > 10000)
+        return fail(QString("Cannot upload %1: more than 10000 parts, raise TONATIUHPP_S3_PART_MB.").arg(m_url));
+    const QByteArray query = "partNumber=" + QByteArray::number(part) + "&uploadId=" + m_uploadId.toUtf8().toPercentEncoding();
+    if (!sendRequest(m_settings, m_bucket, m_key, "PUT", query, data, &response))
+        return fail(QString("Cannot upload part %1 of %2: %3").arg(part).arg(m_url, response.error));
+    if (response.etag.isEmpty())
+        return fail(QString("Cannot upload part %1 of %2: no ETag in the answer.").arg(part).arg(m_url));
+    m_etags.append(response.etag);
+    return true;
+}
+
+bool S3Upload::fail(const QString& message)
+{
+    if (m_error.isEmpty())
+        m_error = message;
+    return false;
+}
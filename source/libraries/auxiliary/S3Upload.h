@@ -0,0 +1,91 @@
+#pragma once
+
+#include "libraries/TonatiuhLibraries.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+
+//! S3Upload streams an object to S3-compatible storage as a multipart upload.
+/*!
+ * Written data is kept until it fills a part, which is then uploaded by a
+ * blocking request from the calling thread, so at most one part is held in
+ * memory; the writer thread of a photon export uploads while the tracers
+ * go on. finish uploads the rest and completes the object, and an object
+ * smaller than a part is sent in one PUT. Requests that fail on the
+ * network, time out or get HTTP 408, 429 or 5xx are retried after waits
+ * that double from half a second. An upload that is not finished is
+ * aborted, so no parts are left in the bucket.
+ *
+ * URLs are s3://bucket/key. Requests are signed with AWS Signature
+ * Version 4 and sent to endpoint/bucket/key, the path-style address that
+ * MinIO, Ceph and other S3-compatible stores take too.
+ */
+class TONATIUH_LIBRARIES S3Upload
+{
+public:
+    struct Settings
+    {
+        QString endpoint; // such as https://s3.eu-west-1.amazonaws.com
+        QString region;
+        QString accessKey;
+        QString secretKey;
+        QString sessionToken; // of temporary credentials, else empty
+        qint64 partSize = qint64(16) << 20; // at least 5 MiB, as S3 requires
+        int attempts = 5;
+        int timeout = 300; // seconds a request may stall
+    };
+
+    // from the variables of the AWS command line tools: AWS_ACCESS_KEY_ID,
+    // AWS_SECRET_ACCESS_KEY, AWS_SESSION_TOKEN, AWS_REGION or
+    // AWS_DEFAULT_REGION (default us-east-1), AWS_ENDPOINT_URL_S3 or
+    // AWS_ENDPOINT_URL; TONATIUHPP_S3_PART_MB sets the part size
+    static Settings settingsFromEnvironment();
+
+    static bool isUrl(const QString& name) {return name.startsWith("s3://");}
+    // false if the bucket or the key is empty
+    static bool parseUrl(const QString& url, QString* bucket, QString* key);
+    // url with name appended to its key
+    static QString join(const QString& url, const QString& name);
+
+    explicit S3Upload(const QString& url, const Settings& settings = settingsFromEnvironment());
+    ~S3Upload();
+
+    S3Upload(const S3Upload&) = delete;
+    S3Upload& operator=(const S3Upload&) = delete;
+
+    bool write(const QByteArray& data);
+    bool finish();
+    // drops the parts uploaded so far
+    void abort();
+
+    const QString& getUrl() const {return m_url;}
+    qint64 getBytes() const {return m_bytes;}
+    // set by the constructor for a bad URL or missing credentials
+    QString getError() const {return m_error;}
+
+    // data as one object, in parts if it is larger than one
+    static bool put(const QString& url, const QByteArray& data, QString* error = nullptr, const Settings& settings = settingsFromEnvironment());
+
+    // the Authorization header of a request; headers have lower-case names,
+    // sorted, and are all signed; amzDate is as yyyyMMddTHHmmssZ
+    static QByteArray authorization(const Settings& settings, const QByteArray& method, const QByteArray& path, const QByteArray& query,
+                                    const QList<QPair<QByteArray, QByteArray>>& headers, const QByteArray& payloadHash, const QByteArray& amzDate);
+
+private:
+    bool uploadPart(const QByteArray& data);
+    bool fail(const QString& message);
+
+    QString m_url;
+    Settings m_settings;
+    QString m_bucket;
+    QString m_key;
+    QString m_uploadId; // empty until the first part
+    QList<QByteArray> m_etags; // of the parts in order
+    QByteArray m_buffer;
+    qint64 m_bytes = 0;
+    bool m_finished = false;
+    QString m_error;
+};
@@ -0,0 +1,31 @@
+#include "LookupTable.h"
+
+#include <algorithm>
+
+
+void LookupTable::build(const std::function<double(double)>& f, double a, double b, int size)
+{
+    m_values.clear();
+    if (size < 1) return;
+
+    m_a = a;
+    m_last = size - 1;
+    m_scale = (size > 1 && b > a) ? m_last/(b - a) : 0.;
+    m_values.resize(size);
+    for (int n = 0; n < size; ++n)
+        m_values[n] = f(size > 1 ? a + (b - a)*n/m_last : a);
+}
+
+double LookupTable::interpolate(const std::vector<vec2d>& points, double x)
+{
+    if (points.empty()) return 0.;
+    if (!(x > points.front().x)) return points.front().y;
+    if (!(x < points.back().x)) return points.back().y;
+
+    auto it = std::upper_bound(points.begin(), points.end(), x,
+        [](double x, const vec2d& p) {return x < p.x;});
+    const vec2d& p0 = *(it - 1);
+    const vec2d& p1 = *it;
+    double t = (x - p0.x)/(p1.x - p0.x);
+    return p0.y + t*(p1.y - p0.y);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "libraries/TonatiuhLibraries.h"
+
+#include <functional>
+#include <vector>
+
+#include "libraries/math/2D/vec2d.h"
+
+
+//! LookupTable holds samples of a function at uniform steps of its argument.
+/*!
+ * build evaluates the function once at \a size points spanning [a, b];
+ * a lookup is then one indexed linear interpolation between two samples,
+ * with the argument clamped to [a, b]. An empty table returns 0.
+ *
+ * interpolate is the piecewise linear curve through points sorted by x,
+ * constant beyond the first and last point, to resample tabulated data.
+ */
+class TONATIUH_LIBRARIES LookupTable
+{
+public:
+    void build(const std::function<double(double)>& f, double a, double b, int size);
+    void clear() {m_values.clear();}
+    bool isEmpty() const {return m_values.empty();}
+
+    double operator()(double x) const
+    {
+        if (m_values.empty()) return 0.;
+        double u = (x - m_a)*m_scale;
+        if (!(u > 0.)) return m_values.front();
+        if (u >= m_last) return m_values.back();
+        int n = int(u);
+        double t = u - n;
+        return m_values[n] + t*(m_values[n + 1] - m_values[n]);
+    }
+
+    static double interpolate(const std::vector<vec2d>& points, double x);
+
+private:
+    std::vector<double> m_values;
+    double m_a = 0.;
+    double m_scale = 0.; // samples per unit of x
+    double m_last = 0.; // index of the last sample
+};
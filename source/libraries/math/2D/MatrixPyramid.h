@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+
+#include "Matrix2D.h"
+
+/**
+ * MatrixPyramid keeps a matrix at every power of two of resolution
+ * Level 0 is the matrix itself, a cell of level n is the maximum
+ * of the 2^n x 2^n cells of level 0 it covers,
+ * so a peak of one cell is still seen at any level
+ *
+ * Usage:
+ * MatrixPyramid<double> p(m);
+ * int n = p.findLevel(rows, cols, width, height);
+ * p.level(n)(r, c);
+ */
+
+template <class T>
+class MatrixPyramid
+{
+public:
+    // constructors
+    MatrixPyramid() {}
+    explicit MatrixPyramid(const Matrix2D<T>& matrix) {build(matrix);}
+
+    void build(const Matrix2D<T>& matrix);
+
+    // components
+    bool isEmpty() const {return m_levels.isEmpty() || m_levels[0].isEmpty();}
+    int levels() const {return m_levels.size();}
+    const Matrix2D<T>& level(int n) const {return m_levels[n];}
+
+    // the finest level that shows rows x cols cells of level 0
+    // in at most rowsMax x colsMax cells
+    int findLevel(int rows, int cols, int rowsMax, int colsMax) const;
+
+protected:
+    QVector<Matrix2D<T>> m_levels;
+};
+
+
+
+template<class T>
+void MatrixPyramid<T>::build(const Matrix2D<T>& matrix)
+{
+    m_levels.clear();
+    m_levels << matrix;
+    if (matrix.isEmpty()) return;
+
+    while (m_levels.last().rows() > 1 || m_levels.last().cols() > 1) {
+        const Matrix2D<T>& fine = m_levels.last();
+        int rows = (fine.rows() + 1)/2;
+        int cols = (fine.cols() + 1)/2;
+        Matrix2D<T> coarse(rows, cols);
+        for (int r = 0; r < rows; ++r) {
+            int r0 = 2*r;
+            int r1 = std::min(r0 + 1, fine.rows() - 1);
+            for (int c = 0; c < cols; ++c) {
+                int c0 = 2*c;
+                int c1 = std::min(c0 + 1, fine.cols() - 1);
+                coarse(r, c) = std::max(std::max(fine(r0, c0), fine(r0, c1)),
+                                        std::max(fine(r1, c0), fine(r1, c1)));
+            }
+        }
+        m_levels << coarse;
+    }
+}
+
+template<class T>
+int MatrixPyramid<T>::findLevel(int rows, int cols, int rowsMax, int colsMax) const
+{
+    rowsMax = std::max(rowsMax, 1);
+    colsMax = std::max(colsMax, 1);
+    // cells of level n over rows of level 0, rounded up
+    auto cells = [](int count, int n) {return (count + (1 << n) - 1) >> n;};
+    int n = 0;
+    while (n + 1 < m_levels.size() && (cells(rows, n) > rowsMax || cells(cols, n) > colsMax))
+        n++;
+    return n;
+}
@@ -0,0 +1,199 @@
+#include "PolygonGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+namespace {
+
+const unsigned char Parity = 1;
+const unsigned char Full = 2;
+
+const int CellsPerEdge = 4;
+const int CellsMax = 1 << 20;
+
+// qFuzzyCompare for doubles
+bool isFuzzyEqual(double a, double b)
+{
+    return std::abs(a - b)*1000000000000. <= std::min(std::abs(a), std::abs(b));
+}
+
+// an edge left of the cells from column on, for a row
+struct Left
+{
+    int column;
+    bool value; // contribution at the bottom of the row
+    int nBreaks;
+    double breaks[2]; // where the contribution changes inside the row
+};
+
+} // namespace
+
+
+void PolygonGrid::clear()
+{
+    m_edges.clear();
+    m_box = Box2D();
+    m_eps = 0.;
+    m_nx = 0;
+    m_ny = 0;
+    m_states.clear();
+    m_begins.clear();
+    m_list.clear();
+}
+
+void PolygonGrid::build(const std::vector<vec2d>& points, bool closed)
+{
+    clear();
+
+    // the edges QPolygonF::containsPoint counts, lower end first
+    auto addEdge = [this](vec2d a, vec2d b) {
+        if (isFuzzyEqual(a.y, b.y)) return;
+        if (b.y < a.y) std::swap(a, b);
+        m_edges.push_back({a, b});
+        m_box << a;
+        m_box << b;
+    };
+    for (std::size_t n = 1; n < points.size(); ++n)
+        addEdge(points[n - 1], points[n]);
+    if (closed && points.size() > 1)
+        addEdge(points.back(), points.front());
+    if (m_edges.empty()) return;
+
+    // cells are widened by m_eps, far above the rounding of the tests
+    const vec2d size = m_box.size();
+    const double scale = std::max({
+        size.x, size.y,
+        std::abs(m_box.min().x), std::abs(m_box.max().x),
+        std::abs(m_box.min().y), std::abs(m_box.max().y)
+    });
+    m_eps = 1e-9*scale;
+
+    const double width = size.x + 2.*m_eps;
+    const double height = size.y;
+    const double cells = std::min<double>(CellsPerEdge*double(m_edges.size()), CellsMax);
+    m_nx = std::clamp(int(std::sqrt(cells*width/height)), 1, CellsMax);
+    m_ny = std::clamp(int(cells/m_nx), 1, CellsMax/m_nx);
+    m_origin = vec2d(m_box.min().x - m_eps, m_box.min().y);
+    m_step = vec2d(width/m_nx, height/m_ny);
+
+    auto column = [this](double x) {
+        return std::clamp(int(std::floor((x - m_origin.x)/m_step.x)), 0, m_nx - 1);
+    };
+    auto row = [this](double y) {
+        return std::clamp(int(std::floor((y - m_origin.y)/m_step.y)), 0, m_ny - 1);
+    };
+
+    std::vector<std::vector<int>> rows(m_ny);
+    for (int e = 0; e < int(m_edges.size()); ++e) {
+        const Edge& edge = m_edges[e];
+        for (int j = row(edge.a.y - 3.*m_eps); j <= row(edge.b.y + 3.*m_eps); ++j)
+            rows[j].push_back(e);
+    }
+
+    m_states.assign(m_nx*m_ny, 0);
+    std::vector<std::pair<int, int>> entries; // cell and edge
+    for (int j = 0; j < m_ny; ++j)
+    {
+        const double y0 = m_origin.y + j*m_step.y - m_eps;
+        const double y1 = m_origin.y + (j + 1)*m_step.y + m_eps;
+
+        std::vector<Left> lefts;
+        for (int e : rows[j]) {
+            const Edge& edge = m_edges[e];
+            const double ya = std::max(edge.a.y, y0);
+            const double yb = std::min(edge.b.y, y1);
+            if (ya > yb) continue;
+
+            // the part of the edge in the row is tested in its cells
+            const double dxdy = (edge.b.x - edge.a.x)/(edge.b.y - edge.a.y);
+            const double xa = edge.a.x + dxdy*(ya - edge.a.y);
+            const double xb = edge.a.x + dxdy*(yb - edge.a.y);
+            const int iMin = column(std::min(xa, xb) - 3.*m_eps);
+            const int iMax = column(std::max(xa, xb) + 3.*m_eps);
+            for (int i = iMin; i <= iMax; ++i)
+                entries.push_back({j*m_nx + i, e});
+            if (iMax + 1 >= m_nx) continue;
+
+            // and counted by the cells to its right
+            Left left;
+            left.column = iMax + 1;
+            left.value = y0 >= edge.a.y && y0 < edge.b.y;
+            left.nBreaks = 0;
+            if (edge.a.y > y0) left.breaks[left.nBreaks++] = edge.a.y;
+            if (edge.b.y <= y1) left.breaks[left.nBreaks++] = edge.b.y;
+            lefts.push_back(left);
+        }
+
+        // the parity from the left is constant in a cell when every
+        // change inside it is undone at the same height
+        std::sort(lefts.begin(), lefts.end(), [](const Left& a, const Left& b) {
+            return a.column < b.column;
+        });
+        std::map<double, int> breaks;
+        int nOdd = 0;
+        bool parity = false;
+        std::size_t k = 0;
+        for (int i = 0; i < m_nx; ++i) {
+            for (; k < lefts.size() && lefts[k].column <= i; ++k) {
+                parity ^= lefts[k].value;
+                for (int b = 0; b < lefts[k].nBreaks; ++b)
+                    nOdd += (++breaks[lefts[k].breaks[b]] % 2) ? 1 : -1;
+            }
+            m_states[j*m_nx + i] = (parity ? Parity : 0) | (nOdd > 0 ? Full : 0);
+        }
+    }
+
+    // lists per cell
+    m_begins.assign(m_nx*m_ny + 1, 0);
+    for (const std::pair<int, int>& entry : entries)
+        m_begins[entry.first + 1]++;
+    for (int c = 0; c < m_nx*m_ny; ++c)
+        m_begins[c + 1] += m_begins[c];
+    m_list.resize(entries.size());
+    std::vector<int> fill(m_begins.begin(), m_begins.end() - 1);
+    for (const std::pair<int, int>& entry : entries)
+        m_list[fill[entry.first]++] = entry.second;
+}
+
+bool PolygonGrid::isInside(const vec2d& p) const
+{
+    if (m_edges.empty()) return false;
+
+    // no edge spans the height, or all are to the right
+    if (!(p.y >= m_box.min().y && p.y < m_box.max().y)) return false;
+    if (p.x < m_box.min().x - m_eps) return false;
+    if (!(p.x <= m_box.max().x + m_eps)) return isInsideAll(p);
+
+    int i = std::min(int((p.x - m_origin.x)/m_step.x), m_nx - 1);
+    int j = std::min(int((p.y - m_origin.y)/m_step.y), m_ny - 1);
+    int c = j*m_nx + i;
+    const unsigned char state = m_states[c];
+    if (state & Full) return isInsideAll(p);
+
+    bool ans = state & Parity;
+    for (int k = m_begins[c]; k < m_begins[c + 1]; ++k)
+        ans ^= isCrossed(m_edges[m_list[k]], p);
+    return ans;
+}
+
+// same arithmetic as qt_polygon_isect_line
+bool PolygonGrid::isCrossed(const Edge& edge, const vec2d& p) const
+{
+    const double x1 = edge.a.x;
+    const double y1 = edge.a.y;
+    const double x2 = edge.b.x;
+    const double y2 = edge.b.y;
+    if (!(p.y >= y1 && p.y < y2)) return false;
+    double x = x1 + ((x2 - x1)/(y2 - y1))*(p.y - y1);
+    return x <= p.x;
+}
+
+bool PolygonGrid::isInsideAll(const vec2d& p) const
+{
+    bool ans = false;
+    for (const Edge& edge : m_edges)
+        ans ^= isCrossed(edge, p);
+    return ans;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "libraries/math/2D/Box2D.h"
+
+#include <vector>
+
+
+//! PolygonGrid answers point in polygon queries with a uniform grid of cells.
+/*!
+ * Answers are those of QPolygonF::containsPoint with Qt::OddEvenFill,
+ * including Qt's rule of skipping edges whose ends have fuzzy equal y.
+ * Every cell of the bounding box knows the parity of the edges lying
+ * entirely to its left and lists the edges passing through it, so a query
+ * tests only those. Cells where the parity from the left changes inside
+ * the cell, which needs an open chain of edges, test all edges.
+ */
+class TONATIUH_LIBRARIES PolygonGrid
+{
+public:
+    // closed adds the edge from the last point to the first
+    void build(const std::vector<vec2d>& points, bool closed);
+    void clear();
+
+    bool isInside(const vec2d& p) const;
+
+private:
+    struct Edge {
+        vec2d a; // lower end
+        vec2d b;
+    };
+
+    bool isCrossed(const Edge& edge, const vec2d& p) const;
+    bool isInsideAll(const vec2d& p) const;
+
+    std::vector<Edge> m_edges;
+    Box2D m_box;
+    double m_eps = 0.;
+
+    int m_nx = 0;
+    int m_ny = 0;
+    vec2d m_origin; // corner of the cells
+    vec2d m_step;
+    std::vector<unsigned char> m_states; // per cell, parity and Full
+    std::vector<int> m_begins; // per cell, into m_list, and one more
+    std::vector<int> m_list; // edges to test
+};
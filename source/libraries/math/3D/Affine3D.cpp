@@ -0,0 +1,48 @@
+#include "Affine3D.h"
+
+#include "Transform.h"
+
+
+Affine3D::Affine3D()
+{
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 4; ++j) {
+            mdir[i][j] = i == j ? 1. : 0.;
+            minv[i][j] = i == j ? 1. : 0.;
+        }
+}
+
+/*!
+ * Copies the upper 3x4 blocks of the direct and inverse matrices.
+ * A default constructed Transform has no matrices and maps to the identity.
+ */
+Affine3D::Affine3D(const Transform& transform):
+    Affine3D()
+{
+    std::shared_ptr<Matrix4x4> md = transform.getMatrix();
+    if (!md) return;
+    std::shared_ptr<Matrix4x4> mi = transform.inversed().getMatrix();
+
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 4; ++j) {
+            mdir[i][j] = md->m[i][j];
+            minv[i][j] = mi->m[i][j];
+        }
+}
+
+Transform Affine3D::toTransform() const
+{
+    auto md = std::make_shared<Matrix4x4>(
+        mdir[0][0], mdir[0][1], mdir[0][2], mdir[0][3],
+        mdir[1][0], mdir[1][1], mdir[1][2], mdir[1][3],
+        mdir[2][0], mdir[2][1], mdir[2][2], mdir[2][3],
+        0., 0., 0., 1.
+    );
+    auto mi = std::make_shared<Matrix4x4>(
+        minv[0][0], minv[0][1], minv[0][2], minv[0][3],
+        minv[1][0], minv[1][1], minv[1][2], minv[1][3],
+        minv[2][0], minv[2][1], minv[2][2], minv[2][3],
+        0., 0., 0., 1.
+    );
+    return Transform(md, mi);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "libraries/math/3D/Ray.h"
+
+class Transform;
+
+
+//! Affine3D is a 3x4 affine transform stored by value with its inverse.
+/*!
+ * It is the form of Transform used on the ray tracing hot path:
+ * no heap allocation, no reference counting and no projective row.
+ * The rows of \a mdir map object to world, the rows of \a minv world to object.
+ */
+struct TONATIUH_LIBRARIES Affine3D
+{
+    Affine3D();
+    explicit Affine3D(const Transform& transform);
+
+    Transform toTransform() const;
+
+    vec3d transformPoint(const vec3d& p) const {return apply(mdir, p, 1.);}
+    vec3d transformVector(const vec3d& v) const {return apply(mdir, v, 0.);}
+    vec3d transformInversePoint(const vec3d& p) const {return apply(minv, p, 1.);}
+    vec3d transformInverseVector(const vec3d& v) const {return apply(minv, v, 0.);}
+
+    // normals use the transposed inverse
+    vec3d transformNormal(const vec3d& n) const
+    {
+        return vec3d(
+            minv[0][0]*n.x + minv[1][0]*n.y + minv[2][0]*n.z,
+            minv[0][1]*n.x + minv[1][1]*n.y + minv[2][1]*n.z,
+            minv[0][2]*n.x + minv[1][2]*n.y + minv[2][2]*n.z
+        );
+    }
+
+    Ray transformDirect(const Ray& r) const
+    {
+        return Ray(apply(mdir, r.origin, 1.), apply(mdir, r.direction(), 0.), r.tMin, r.tMax);
+    }
+
+    Ray transformInverse(const Ray& r) const
+    {
+        return Ray(apply(minv, r.origin, 1.), apply(minv, r.direction(), 0.), r.tMin, r.tMax);
+    }
+
+    double mdir[3][4];
+    double minv[3][4];
+
+private:
+    static vec3d apply(const double m[3][4], const vec3d& v, double w)
+    {
+        return vec3d(
+            m[0][0]*v.x + m[0][1]*v.y + m[0][2]*v.z + m[0][3]*w,
+            m[1][0]*v.x + m[1][1]*v.y + m[1][2]*v.z + m[1][3]*w,
+            m[2][0]*v.x + m[2][1]*v.y + m[2][2]*v.z + m[2][3]*w
+        );
+    }
+};
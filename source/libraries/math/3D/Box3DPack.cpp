@@ -0,0 +1,225 @@
+#include "Box3DPack.h"
+
+#include "math/CpuDispatch.h"
+#include "math/gcf.h"
+#include "Ray.h"
+
+#if defined(__AVX__) || defined(TONATIUH_DISPATCH_AVX2)
+#include <immintrin.h>
+#endif
+#if defined(__AVX__)
+// 256-bit lanes only
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TONATIUH_BOX_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TONATIUH_BOX_NEON
+#endif
+
+
+Box3DPack::Box3DPack()
+{
+    for (int n = 0; n < Width; ++n)
+        clear(n);
+}
+
+void Box3DPack::set(int lane, const Box3D& box)
+{
+    xMin[lane] = box.min().x;
+    yMin[lane] = box.min().y;
+    zMin[lane] = box.min().z;
+    xMax[lane] = box.max().x;
+    yMax[lane] = box.max().y;
+    zMax[lane] = box.max().z;
+}
+
+void Box3DPack::clear(int lane)
+{
+    xMin[lane] = gcf::infinity;
+    yMin[lane] = gcf::infinity;
+    zMin[lane] = gcf::infinity;
+    xMax[lane] = -gcf::infinity;
+    yMax[lane] = -gcf::infinity;
+    zMax[lane] = -gcf::infinity;
+}
+
+Box3D Box3DPack::box(int lane) const
+{
+    Box3D ans;
+    if (xMin[lane] > xMax[lane]) return ans;
+    ans.setLimits(
+        vec3d(xMin[lane], yMin[lane], zMin[lane]),
+        vec3d(xMax[lane], yMax[lane], zMax[lane])
+    );
+    return ans;
+}
+
+namespace {
+
+// the planes a ray enters and leaves the boxes by, from the signs of its inverse direction
+struct Slabs
+{
+    Slabs(const Box3DPack& pack, const vec3d& rI):
+        nx(rI.x >= 0. ? pack.xMin : pack.xMax),
+        fx(rI.x >= 0. ? pack.xMax : pack.xMin),
+        ny(rI.y >= 0. ? pack.yMin : pack.yMax),
+        fy(rI.y >= 0. ? pack.yMax : pack.yMin),
+        nz(rI.z >= 0. ? pack.zMin : pack.zMax),
+        fz(rI.z >= 0. ? pack.zMax : pack.zMin)
+    {}
+
+    const double* nx;
+    const double* fx;
+    const double* ny;
+    const double* fy;
+    const double* nz;
+    const double* fz;
+};
+
+const int Width = Box3DPack::Width;
+
+#if defined(__AVX__) || defined(TONATIUH_DISPATCH_AVX2)
+#if !defined(__AVX__)
+TONATIUH_TARGET_AVX2
+#endif
+int intersectAVX(const Slabs& s, const Ray& ray, double* tNear)
+{
+    const vec3d& rO = ray.origin;
+    const vec3d& rI = ray.invDirection();
+    const __m256d ox = _mm256_set1_pd(rO.x), oy = _mm256_set1_pd(rO.y), oz = _mm256_set1_pd(rO.z);
+    const __m256d ix = _mm256_set1_pd(rI.x), iy = _mm256_set1_pd(rI.y), iz = _mm256_set1_pd(rI.z);
+
+    __m256d t0 = _mm256_set1_pd(ray.tMin);
+    __m256d t1 = _mm256_set1_pd(ray.tMax);
+    t0 = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(s.nx), ox), ix), t0);
+    t0 = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(s.ny), oy), iy), t0);
+    t0 = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(s.nz), oz), iz), t0);
+    t1 = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(s.fx), ox), ix), t1);
+    t1 = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(s.fy), oy), iy), t1);
+    t1 = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_load_pd(s.fz), oz), iz), t1);
+
+    _mm256_storeu_pd(tNear, t0);
+    return _mm256_movemask_pd(_mm256_cmp_pd(t0, t1, _CMP_LE_OQ));
+}
+#endif
+
+#if defined(TONATIUH_BOX_SSE2)
+int intersectSSE2(const Slabs& s, const Ray& ray, double* tNear)
+{
+    const vec3d& rO = ray.origin;
+    const vec3d& rI = ray.invDirection();
+    const __m128d ox = _mm_set1_pd(rO.x), oy = _mm_set1_pd(rO.y), oz = _mm_set1_pd(rO.z);
+    const __m128d ix = _mm_set1_pd(rI.x), iy = _mm_set1_pd(rI.y), iz = _mm_set1_pd(rI.z);
+    const __m128d trMin = _mm_set1_pd(ray.tMin);
+    const __m128d trMax = _mm_set1_pd(ray.tMax);
+
+    int mask = 0;
+    for (int n = 0; n < Width; n += 2)
+    {
+        __m128d t0 = trMin;
+        __m128d t1 = trMax;
+        t0 = _mm_max_pd(_mm_mul_pd(_mm_sub_pd(_mm_load_pd(s.nx + n), ox), ix), t0);
+        t0 = _mm_max_pd(_mm_mul_pd(_mm_sub_pd(_mm_load_pd(s.ny + n), oy), iy), t0);
+        t0 = _mm_max_pd(_mm_mul_pd(_mm_sub_pd(_mm_load_pd(s.nz + n), oz), iz), t0);
+        t1 = _mm_min_pd(_mm_mul_pd(_mm_sub_pd(_mm_load_pd(s.fx + n), ox), ix), t1);
+        t1 = _mm_min_pd(_mm_mul_pd(_mm_sub_pd(_mm_load_pd(s.fy + n), oy), iy), t1);
+        t1 = _mm_min_pd(_mm_mul_pd(_mm_sub_pd(_mm_load_pd(s.fz + n), oz), iz), t1);
+
+        _mm_storeu_pd(tNear + n, t0);
+        mask |= _mm_movemask_pd(_mm_cmple_pd(t0, t1)) << n;
+    }
+    return mask;
+}
+#endif
+
+#if defined(TONATIUH_BOX_NEON)
+int intersectNEON(const Slabs& s, const Ray& ray, double* tNear)
+{
+    const vec3d& rO = ray.origin;
+    const vec3d& rI = ray.invDirection();
+    const float64x2_t ox = vdupq_n_f64(rO.x), oy = vdupq_n_f64(rO.y), oz = vdupq_n_f64(rO.z);
+    const float64x2_t ix = vdupq_n_f64(rI.x), iy = vdupq_n_f64(rI.y), iz = vdupq_n_f64(rI.z);
+    const float64x2_t trMin = vdupq_n_f64(ray.tMin);
+    const float64x2_t trMax = vdupq_n_f64(ray.tMax);
+
+    int mask = 0;
+    for (int n = 0; n < Width; n += 2)
+    {
+        float64x2_t t0 = trMin;
+        float64x2_t t1 = trMax;
+        t0 = vmaxnmq_f64(t0, vmulq_f64(vsubq_f64(vld1q_f64(s.nx + n), ox), ix));
+        t0 = vmaxnmq_f64(t0, vmulq_f64(vsubq_f64(vld1q_f64(s.ny + n), oy), iy));
+        t0 = vmaxnmq_f64(t0, vmulq_f64(vsubq_f64(vld1q_f64(s.nz + n), oz), iz));
+        t1 = vminnmq_f64(t1, vmulq_f64(vsubq_f64(vld1q_f64(s.fx + n), ox), ix));
+        t1 = vminnmq_f64(t1, vmulq_f64(vsubq_f64(vld1q_f64(s.fy + n), oy), iy));
+        t1 = vminnmq_f64(t1, vmulq_f64(vsubq_f64(vld1q_f64(s.fz + n), oz), iz));
+
+        vst1q_f64(tNear + n, t0);
+        uint64x2_t m = vcleq_f64(t0, t1);
+        mask |= int(vgetq_lane_u64(m, 0) & 1) << n;
+        mask |= int(vgetq_lane_u64(m, 1) & 1) << (n + 1);
+    }
+    return mask;
+}
+#endif
+
+#if !defined(__AVX__) && !defined(TONATIUH_BOX_SSE2) && !defined(TONATIUH_BOX_NEON)
+int intersectGeneric(const Slabs& s, const Ray& ray, double* tNear)
+{
+    const vec3d& rO = ray.origin;
+    const vec3d& rI = ray.invDirection();
+    int mask = 0;
+    for (int n = 0; n < Width; ++n)
+    {
+        double t0 = ray.tMin;
+        double t1 = ray.tMax;
+        double t;
+        t = (s.nx[n] - rO.x)*rI.x; if (t > t0) t0 = t;
+        t = (s.ny[n] - rO.y)*rI.y; if (t > t0) t0 = t;
+        t = (s.nz[n] - rO.z)*rI.z; if (t > t0) t0 = t;
+        t = (s.fx[n] - rO.x)*rI.x; if (t < t1) t1 = t;
+        t = (s.fy[n] - rO.y)*rI.y; if (t < t1) t1 = t;
+        t = (s.fz[n] - rO.z)*rI.z; if (t < t1) t1 = t;
+
+        tNear[n] = t0;
+        if (t0 <= t1) mask |= 1 << n;
+    }
+    return mask;
+}
+#endif
+
+#if defined(TONATIUH_DISPATCH_AVX2)
+// chosen once, the branch is then always predicted
+const bool UseAVX2 = CpuDispatch::level() == CpuDispatch::AVX2;
+#endif
+
+} // namespace
+
+
+/*!
+ * Slab test as in Box3D::intersect. The near and far planes of every axis
+ * are chosen once from the sign of the inverse direction, so an empty lane
+ * (min = +inf, max = -inf) always yields tNear > tFar. A plane that
+ * evaluates to NaN (origin on the plane of a zero direction component)
+ * leaves the running interval unchanged, as in the scalar test.
+ *
+ * On x86-64 the 256-bit path runs when it is compiled in or CpuDispatch
+ * finds AVX2, the SSE2 one otherwise; both give the same results.
+ */
+int Box3DPack::intersect(const Ray& ray, double* tNear) const
+{
+    const Slabs slabs(*this, ray.invDirection());
+#if defined(__AVX__)
+    return intersectAVX(slabs, ray, tNear);
+#elif defined(TONATIUH_BOX_SSE2)
+#if defined(TONATIUH_DISPATCH_AVX2)
+    if (UseAVX2) return intersectAVX(slabs, ray, tNear);
+#endif
+    return intersectSSE2(slabs, ray, tNear);
+#elif defined(TONATIUH_BOX_NEON)
+    return intersectNEON(slabs, ray, tNear);
+#else
+    return intersectGeneric(slabs, ray, tNear);
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "libraries/math/3D/Box3D.h"
+class Ray;
+
+
+//! Box3DPack stores four boxes in structure-of-arrays form.
+/*!
+ * It is the node layout of the 4-wide bounding volume hierarchies:
+ * one ray is tested against all four slabs at once with SSE2, AVX or NEON,
+ * falling back to a branchless scalar loop on other targets.
+ * Unused lanes hold an empty box and never report a hit.
+ */
+struct TONATIUH_LIBRARIES Box3DPack
+{
+    static const int Width = 4;
+
+    Box3DPack();
+
+    void set(int lane, const Box3D& box);
+    void clear(int lane);
+    Box3D box(int lane) const;
+
+    // returns a bit mask of the lanes hit, tNear receives the clamped entry distances
+    int intersect(const Ray& ray, double* tNear) const;
+
+    alignas(32) double xMin[Width];
+    alignas(32) double yMin[Width];
+    alignas(32) double zMin[Width];
+    alignas(32) double xMax[Width];
+    alignas(32) double yMax[Width];
+    alignas(32) double zMax[Width];
+};
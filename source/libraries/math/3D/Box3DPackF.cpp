@@ -0,0 +1,182 @@
+#include "Box3DPackF.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "math/gcf.h"
+#include "Ray.h"
+
+#if defined(__SSE2__) || defined(__AVX__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TONATIUH_BOXF_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TONATIUH_BOXF_NEON
+#endif
+
+namespace {
+
+// relative and absolute widening of the distances, above the three roundings
+// of (plane - origin)*invDirection and the widening itself; scaling keeps
+// infinite distances infinite. Scaling toward zero is only wrong on the side
+// of zero that the clamp to tMin >= 0 removes anyway
+const float Slack = 4.f*FLT_EPSILON;
+const float SlackMin = FLT_MIN;
+
+float roundDown(double x)
+{
+    float ans = float(x);
+    if (double(ans) > x) ans = std::nextafter(ans, -HUGE_VALF);
+    return ans;
+}
+
+float roundUp(double x)
+{
+    float ans = float(x);
+    if (double(ans) < x) ans = std::nextafter(ans, HUGE_VALF);
+    return ans;
+}
+
+} // namespace
+
+
+Box3DPackF::Query::Query(const Ray& ray)
+{
+    const vec3d& rO = ray.origin;
+    const vec3d& rI = ray.invDirection();
+    for (int k = 0; k < 3; ++k) {
+        isNegative[k] = !(rI[k] >= 0.);
+        originNear[k] = isNegative[k] ? roundDown(rO[k]) : roundUp(rO[k]);
+        originFar[k] = isNegative[k] ? roundUp(rO[k]) : roundDown(rO[k]);
+        invDirection[k] = float(rI[k]);
+    }
+    tMin = std::max(0.f, roundDown(ray.tMin));
+}
+
+Box3DPackF::Box3DPackF()
+{
+    for (int n = 0; n < Width; ++n)
+        clear(n);
+}
+
+Box3DPackF::Box3DPackF(const Box3DPack& pack)
+{
+    for (int n = 0; n < Width; ++n) {
+        xMin[n] = roundDown(pack.xMin[n]);
+        yMin[n] = roundDown(pack.yMin[n]);
+        zMin[n] = roundDown(pack.zMin[n]);
+        xMax[n] = roundUp(pack.xMax[n]);
+        yMax[n] = roundUp(pack.yMax[n]);
+        zMax[n] = roundUp(pack.zMax[n]);
+    }
+}
+
+void Box3DPackF::set(int lane, const Box3D& box)
+{
+    xMin[lane] = roundDown(box.min().x);
+    yMin[lane] = roundDown(box.min().y);
+    zMin[lane] = roundDown(box.min().z);
+    xMax[lane] = roundUp(box.max().x);
+    yMax[lane] = roundUp(box.max().y);
+    zMax[lane] = roundUp(box.max().z);
+}
+
+void Box3DPackF::clear(int lane)
+{
+    xMin[lane] = HUGE_VALF;
+    yMin[lane] = HUGE_VALF;
+    zMin[lane] = HUGE_VALF;
+    xMax[lane] = -HUGE_VALF;
+    yMax[lane] = -HUGE_VALF;
+    zMax[lane] = -HUGE_VALF;
+}
+
+/*!
+ * Slab test as in Box3DPack::intersect, planes that evaluate to NaN leaving
+ * the interval unchanged. The entry distance over the axes is taken first and
+ * widened, then clamped to the ray interval, which is rounded outward.
+ */
+int Box3DPackF::intersect(const Query& query, double tMax, double* tNear) const
+{
+    const float* nx = query.isNegative[0] ? xMax : xMin;
+    const float* fx = query.isNegative[0] ? xMin : xMax;
+    const float* ny = query.isNegative[1] ? yMax : yMin;
+    const float* fy = query.isNegative[1] ? yMin : yMax;
+    const float* nz = query.isNegative[2] ? zMax : zMin;
+    const float* fz = query.isNegative[2] ? zMin : zMax;
+    const float* oN = query.originNear;
+    const float* oF = query.originFar;
+    const float* rI = query.invDirection;
+
+    float t0s[Width];
+    int mask = 0;
+#if defined(TONATIUH_BOXF_SSE)
+    const __m128 ix = _mm_set1_ps(rI[0]), iy = _mm_set1_ps(rI[1]), iz = _mm_set1_ps(rI[2]);
+    const __m128 down = _mm_set1_ps(1.f - Slack);
+    const __m128 up = _mm_set1_ps(1.f + Slack);
+    const __m128 slackMin = _mm_set1_ps(SlackMin);
+
+    __m128 t0 = _mm_set1_ps(-HUGE_VALF);
+    __m128 t1 = _mm_set1_ps(HUGE_VALF);
+    t0 = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nx), _mm_set1_ps(oN[0])), ix), t0);
+    t0 = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(ny), _mm_set1_ps(oN[1])), iy), t0);
+    t0 = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nz), _mm_set1_ps(oN[2])), iz), t0);
+    t1 = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(fx), _mm_set1_ps(oF[0])), ix), t1);
+    t1 = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(fy), _mm_set1_ps(oF[1])), iy), t1);
+    t1 = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(fz), _mm_set1_ps(oF[2])), iz), t1);
+
+    t0 = _mm_max_ps(_mm_sub_ps(_mm_mul_ps(t0, down), slackMin), _mm_set1_ps(query.tMin));
+    t1 = _mm_min_ps(_mm_add_ps(_mm_mul_ps(t1, up), slackMin), _mm_mul_ps(_mm_set1_ps(float(tMax)), up));
+
+    _mm_storeu_ps(t0s, t0);
+    mask = _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+#elif defined(TONATIUH_BOXF_NEON)
+    const float32x4_t ix = vdupq_n_f32(rI[0]), iy = vdupq_n_f32(rI[1]), iz = vdupq_n_f32(rI[2]);
+    const float32x4_t down = vdupq_n_f32(1.f - Slack);
+    const float32x4_t up = vdupq_n_f32(1.f + Slack);
+    const float32x4_t slackMin = vdupq_n_f32(SlackMin);
+
+    float32x4_t t0 = vdupq_n_f32(-HUGE_VALF);
+    float32x4_t t1 = vdupq_n_f32(HUGE_VALF);
+    t0 = vmaxnmq_f32(t0, vmulq_f32(vsubq_f32(vld1q_f32(nx), vdupq_n_f32(oN[0])), ix));
+    t0 = vmaxnmq_f32(t0, vmulq_f32(vsubq_f32(vld1q_f32(ny), vdupq_n_f32(oN[1])), iy));
+    t0 = vmaxnmq_f32(t0, vmulq_f32(vsubq_f32(vld1q_f32(nz), vdupq_n_f32(oN[2])), iz));
+    t1 = vminnmq_f32(t1, vmulq_f32(vsubq_f32(vld1q_f32(fx), vdupq_n_f32(oF[0])), ix));
+    t1 = vminnmq_f32(t1, vmulq_f32(vsubq_f32(vld1q_f32(fy), vdupq_n_f32(oF[1])), iy));
+    t1 = vminnmq_f32(t1, vmulq_f32(vsubq_f32(vld1q_f32(fz), vdupq_n_f32(oF[2])), iz));
+
+    t0 = vmaxq_f32(vsubq_f32(vmulq_f32(t0, down), slackMin), vdupq_n_f32(query.tMin));
+    t1 = vminq_f32(vaddq_f32(vmulq_f32(t1, up), slackMin), vmulq_f32(vdupq_n_f32(float(tMax)), up));
+
+    vst1q_f32(t0s, t0);
+    uint32x4_t m = vcleq_f32(t0, t1);
+    mask = int(vgetq_lane_u32(m, 0) & 1) | int(vgetq_lane_u32(m, 1) & 1) << 1 |
+           int(vgetq_lane_u32(m, 2) & 1) << 2 | int(vgetq_lane_u32(m, 3) & 1) << 3;
+#else
+    const float tMaxF = float(tMax)*(1.f + Slack);
+    for (int n = 0; n < Width; ++n)
+    {
+        float t0 = -HUGE_VALF;
+        float t1 = HUGE_VALF;
+        float t;
+        t = (nx[n] - oN[0])*rI[0]; if (t > t0) t0 = t;
+        t = (ny[n] - oN[1])*rI[1]; if (t > t0) t0 = t;
+        t = (nz[n] - oN[2])*rI[2]; if (t > t0) t0 = t;
+        t = (fx[n] - oF[0])*rI[0]; if (t < t1) t1 = t;
+        t = (fy[n] - oF[1])*rI[1]; if (t < t1) t1 = t;
+        t = (fz[n] - oF[2])*rI[2]; if (t < t1) t1 = t;
+
+        t0 = t0*(1.f - Slack) - SlackMin;
+        t1 = t1*(1.f + Slack) + SlackMin;
+        if (t0 < query.tMin) t0 = query.tMin;
+        if (t1 > tMaxF) t1 = tMaxF;
+
+        t0s[n] = t0;
+        if (t0 <= t1) mask |= 1 << n;
+    }
+#endif
+    for (int n = 0; n < Width; ++n)
+        tNear[n] = t0s[n];
+    return mask;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "libraries/math/3D/Box3DPack.h"
+class Ray;
+
+
+//! Box3DPackF is the single-precision twin of Box3DPack.
+/*!
+ * The four boxes are stored as floats rounded outward and a ray is tested
+ * against all of them in one SSE or NEON register, half the memory and
+ * twice the lanes per instruction of the double pack.
+ *
+ * The test is conservative: the ray origin is rounded toward each plane's
+ * far side, the entry and exit distances are widened by a few float epsilons
+ * and the ray interval is rounded outward, so a lane hit by Box3DPack::intersect
+ * is always hit here, with a tNear no larger. This needs ray.tMin >= 0, as
+ * for all traced rays; a negative tMin counts as 0. Direction components
+ * beyond the float range count as zero.
+ */
+struct TONATIUH_LIBRARIES Box3DPackF
+{
+    static const int Width = Box3DPack::Width;
+
+    //! the ray rounded once for the tests of a traversal
+    struct TONATIUH_LIBRARIES Query
+    {
+        explicit Query(const Ray& ray);
+
+        float originNear[3]; // rounded so near planes are not entered late
+        float originFar[3];  // and far planes not left early
+        float invDirection[3];
+        bool isNegative[3];
+        float tMin;
+    };
+
+    Box3DPackF();
+    explicit Box3DPackF(const Box3DPack& pack);
+
+    void set(int lane, const Box3D& box);
+    void clear(int lane);
+
+    // returns a bit mask of the lanes hit in [query.tMin, tMax], tNear receives
+    // lower bounds of the clamped entry distances
+    int intersect(const Query& query, double tMax, double* tNear) const;
+
+    alignas(16) float xMin[Width];
+    alignas(16) float yMin[Width];
+    alignas(16) float zMin[Width];
+    alignas(16) float xMax[Width];
+    alignas(16) float yMax[Width];
+    alignas(16) float zMax[Width];
+};
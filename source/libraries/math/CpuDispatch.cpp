@@ -0,0 +1,40 @@
+#include "CpuDispatch.h"
+
+
+namespace {
+
+CpuDispatch::Level detect()
+{
+#if defined(__AVX2__)
+    return CpuDispatch::AVX2;
+#elif defined(TONATIUH_DISPATCH_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return CpuDispatch::AVX2;
+    return CpuDispatch::SSE2;
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    return CpuDispatch::SSE2;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return CpuDispatch::NEON;
+#else
+    return CpuDispatch::Generic;
+#endif
+}
+
+} // namespace
+
+
+CpuDispatch::Level CpuDispatch::level()
+{
+    static const Level ans = detect();
+    return ans;
+}
+
+const char* CpuDispatch::name(Level level)
+{
+    switch (level) {
+    case SSE2: return "sse2";
+    case NEON: return "neon";
+    case AVX2: return "avx2";
+    default: return "generic";
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "libraries/TonatiuhLibraries.h"
+
+
+//! CpuDispatch picks the instruction set of the wide kernels once, from the CPU.
+/*!
+ * One binary is built for the baseline of its target, SSE2 on x86-64 and
+ * NEON on arm64. With GCC or Clang on x86-64 the box and triangle kernels
+ * are also compiled for AVX2 in the same library, in functions marked
+ * TONATIUH_TARGET_AVX2, and level() tells at startup which ones run.
+ * Built with TONATIUHPP_ENABLE_AVX2 the AVX2 code is the only one and
+ * nothing is dispatched.
+ *
+ * The AVX2 kernels do not use FMA, so every path gives the same bits.
+ * AVX-512 is not used: the kernels are four doubles wide.
+ */
+class TONATIUH_LIBRARIES CpuDispatch
+{
+public:
+    enum Level {
+        Generic,
+        SSE2,
+        NEON,
+        AVX2
+    };
+
+    // detected on the first call
+    static Level level();
+    static const char* name(Level level);
+    static const char* name() {return name(level());}
+};
+
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(__AVX2__) && (defined(__GNUC__) || defined(__clang__))
+#define TONATIUH_DISPATCH_AVX2
+#define TONATIUH_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
@@ -0,0 +1,510 @@
+#include "Expression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+
+namespace {
+
+enum Op {
+    OpConstant,
+    OpVariable,
+    OpNegate,
+    OpNot,
+    OpAdd,
+    OpSubtract,
+    OpMultiply,
+    OpDivide,
+    OpModulo,
+    OpLess,
+    OpLessEqual,
+    OpGreater,
+    OpGreaterEqual,
+    OpEqual,
+    OpNotEqual,
+    OpAnd,
+    OpOr,
+    OpSelect,
+    OpFunction1,
+    OpFunction2
+};
+
+const int MaxStack = 64;
+
+bool fail(std::string* errorMessage, const std::string& msg)
+{
+    if (errorMessage) *errorMessage = msg;
+    return false;
+}
+
+// truth value of a number in JavaScript
+bool isTrue(double x)
+{
+    return x != 0. && !std::isnan(x);
+}
+
+// Math functions with the JavaScript results where they differ from the C library
+
+double jsPow(double x, double y)
+{
+    if (std::isnan(y)) return y;
+    if (std::abs(x) == 1. && std::isinf(y)) return std::numeric_limits<double>::quiet_NaN();
+    return std::pow(x, y);
+}
+
+double jsMin(double x, double y)
+{
+    if (std::isnan(x) || std::isnan(y)) return std::numeric_limits<double>::quiet_NaN();
+    return x < y ? x : y;
+}
+
+double jsMax(double x, double y)
+{
+    if (std::isnan(x) || std::isnan(y)) return std::numeric_limits<double>::quiet_NaN();
+    return x > y ? x : y;
+}
+
+double jsRound(double x)
+{
+    double r = std::floor(x);
+    return x - r >= 0.5 ? r + 1. : r;
+}
+
+double jsSign(double x)
+{
+    if (x > 0.) return 1.;
+    if (x < 0.) return -1.;
+    return x;
+}
+
+double jsSin(double x) {return std::sin(x);}
+double jsCos(double x) {return std::cos(x);}
+double jsTan(double x) {return std::tan(x);}
+double jsAsin(double x) {return std::asin(x);}
+double jsAcos(double x) {return std::acos(x);}
+double jsAtan(double x) {return std::atan(x);}
+double jsSinh(double x) {return std::sinh(x);}
+double jsCosh(double x) {return std::cosh(x);}
+double jsTanh(double x) {return std::tanh(x);}
+double jsExp(double x) {return std::exp(x);}
+double jsLog(double x) {return std::log(x);}
+double jsLog10(double x) {return std::log10(x);}
+double jsLog2(double x) {return std::log2(x);}
+double jsSqrt(double x) {return std::sqrt(x);}
+double jsCbrt(double x) {return std::cbrt(x);}
+double jsAbs(double x) {return std::abs(x);}
+double jsFloor(double x) {return std::floor(x);}
+double jsCeil(double x) {return std::ceil(x);}
+double jsTrunc(double x) {return std::trunc(x);}
+double jsAtan2(double y, double x) {return std::atan2(y, x);}
+double jsHypot(double x, double y) {return std::hypot(x, y);}
+
+struct Constant {
+    const char* name;
+    double value;
+};
+
+const Constant constants[] = {
+    {"PI", 3.141592653589793},
+    {"E", 2.718281828459045},
+    {"LN2", 0.6931471805599453},
+    {"LN10", 2.302585092994046},
+    {"LOG2E", 1.4426950408889634},
+    {"LOG10E", 0.4342944819032518},
+    {"SQRT2", 1.4142135623730951},
+    {"SQRT1_2", 0.7071067811865476}
+};
+
+struct Function1 {
+    const char* name;
+    double (*f)(double);
+};
+
+const Function1 functions1[] = {
+    {"sin", jsSin}, {"cos", jsCos}, {"tan", jsTan},
+    {"asin", jsAsin}, {"acos", jsAcos}, {"atan", jsAtan},
+    {"sinh", jsSinh}, {"cosh", jsCosh}, {"tanh", jsTanh},
+    {"exp", jsExp}, {"log", jsLog}, {"log10", jsLog10}, {"log2", jsLog2},
+    {"sqrt", jsSqrt}, {"cbrt", jsCbrt}, {"abs", jsAbs},
+    {"floor", jsFloor}, {"ceil", jsCeil}, {"round", jsRound}, {"trunc", jsTrunc},
+    {"sign", jsSign}
+};
+
+struct Function2 {
+    const char* name;
+    double (*f)(double, double);
+    bool variadic; // any number of arguments, folded from the left
+    double empty; // value without arguments
+};
+
+const Function2 functions2[] = {
+    {"atan2", jsAtan2, false, 0.},
+    {"pow", jsPow, false, 0.},
+    {"min", jsMin, true, std::numeric_limits<double>::infinity()},
+    {"max", jsMax, true, -std::numeric_limits<double>::infinity()},
+    {"hypot", jsHypot, true, 0.}
+};
+
+} // namespace
+
+
+// recursive descent over the JavaScript precedence levels, emitting postfix code
+struct Expression::Parser
+{
+    const std::string& text;
+    const std::vector<std::string>& variables;
+    std::vector<Instruction>& program;
+    size_t pos = 0;
+    std::string error;
+
+    Parser(const std::string& text, const std::vector<std::string>& variables, std::vector<Instruction>& program):
+        text(text), variables(variables), program(program) {}
+
+    void emit(int op, double value = 0., int index = 0)
+    {
+        program.push_back({op, index, value, nullptr, nullptr});
+    }
+
+    bool setError(const std::string& msg)
+    {
+        if (error.empty()) error = msg;
+        return false;
+    }
+
+    void skipSpaces()
+    {
+        while (pos < text.size() && std::isspace((unsigned char) text[pos])) pos++;
+    }
+
+    // consumes the token when it is next, an operator is not taken as the prefix of a longer one
+    bool accept(const char* token)
+    {
+        skipSpaces();
+        size_t n = std::char_traits<char>::length(token);
+        if (text.compare(pos, n, token) != 0) return false;
+        if (pos + n < text.size()) {
+            char next = text[pos + n];
+            char last = token[n - 1];
+            if ((last == '=' || last == '<' || last == '>' || last == '!') && next == '=') return false;
+            if (last == '*' && next == '*' && n == 1) return false;
+            if (last == '&' && next == '&' && n == 1) return false;
+            if (last == '|' && next == '|' && n == 1) return false;
+        }
+        pos += n;
+        return true;
+    }
+
+    bool expect(const char* token)
+    {
+        if (accept(token)) return true;
+        return setError(std::string("Expected '") + token + "' at position " + std::to_string(pos) + ".");
+    }
+
+    std::string identifier()
+    {
+        skipSpaces();
+        size_t start = pos;
+        while (pos < text.size() && (std::isalnum((unsigned char) text[pos]) || text[pos] == '_' || text[pos] == '$')) pos++;
+        return text.substr(start, pos - start);
+    }
+
+    bool parseConditional()
+    {
+        if (!parseOr()) return false;
+        if (!accept("?")) return true;
+        if (!parseConditional()) return false;
+        if (!expect(":")) return false;
+        if (!parseConditional()) return false;
+        emit(OpSelect);
+        return true;
+    }
+
+    bool parseOr()
+    {
+        if (!parseAnd()) return false;
+        while (accept("||")) {
+            if (!parseAnd()) return false;
+            emit(OpOr);
+        }
+        return true;
+    }
+
+    bool parseAnd()
+    {
+        if (!parseEquality()) return false;
+        while (accept("&&")) {
+            if (!parseEquality()) return false;
+            emit(OpAnd);
+        }
+        return true;
+    }
+
+    bool parseEquality()
+    {
+        if (!parseRelational()) return false;
+        for (;;) {
+            int op;
+            if (accept("===") || accept("==")) op = OpEqual;
+            else if (accept("!==") || accept("!=")) op = OpNotEqual;
+            else return true;
+            if (!parseRelational()) return false;
+            emit(op);
+        }
+    }
+
+    bool parseRelational()
+    {
+        if (!parseAdditive()) return false;
+        for (;;) {
+            int op;
+            if (accept("<=")) op = OpLessEqual;
+            else if (accept(">=")) op = OpGreaterEqual;
+            else if (accept("<")) op = OpLess;
+            else if (accept(">")) op = OpGreater;
+            else return true;
+            if (!parseAdditive()) return false;
+            emit(op);
+        }
+    }
+
+    bool parseAdditive()
+    {
+        if (!parseMultiplicative()) return false;
+        for (;;) {
+            int op;
+            if (accept("+")) op = OpAdd;
+            else if (accept("-")) op = OpSubtract;
+            else return true;
+            if (!parseMultiplicative()) return false;
+            emit(op);
+        }
+    }
+
+    bool parseMultiplicative()
+    {
+        if (!parseUnary()) return false;
+        for (;;) {
+            int op;
+            if (accept("*")) op = OpMultiply;
+            else if (accept("/")) op = OpDivide;
+            else if (accept("%")) op = OpModulo;
+            else return true;
+            if (!parseUnary()) return false;
+            emit(op);
+        }
+    }
+
+    bool parseUnary()
+    {
+        if (accept("-")) {
+            if (!parseUnary()) return false;
+            emit(OpNegate);
+            return true;
+        }
+        if (accept("+")) return parseUnary();
+        if (accept("!")) {
+            if (!parseUnary()) return false;
+            emit(OpNot);
+            return true;
+        }
+        return parsePower();
+    }
+
+    // right associative, the exponent may carry a sign
+    bool parsePower()
+    {
+        if (!parsePrimary()) return false;
+        if (!accept("**")) return true;
+        if (!parseUnary()) return false;
+        program.push_back({OpFunction2, 0, 0., nullptr, jsPow});
+        return true;
+    }
+
+    bool parsePrimary()
+    {
+        skipSpaces();
+        if (pos >= text.size())
+            return setError("Unexpected end of expression.");
+
+        if (accept("(")) {
+            if (!parseConditional()) return false;
+            return expect(")");
+        }
+
+        char c = text[pos];
+        if (std::isdigit((unsigned char) c) || c == '.') {
+            const char* start = text.c_str() + pos;
+            char* end = nullptr;
+            double value = std::strtod(start, &end);
+            size_t n = end - start;
+            // hexadecimal numbers are left to the script engine
+            if (n == 0 || std::string(start, n).find_first_of("xXpP") != std::string::npos)
+                return setError("Invalid number at position " + std::to_string(pos) + ".");
+            pos += n;
+            emit(OpConstant, value);
+            return true;
+        }
+
+        size_t start = pos;
+        std::string name = identifier();
+        if (name.empty())
+            return setError("Unexpected character at position " + std::to_string(start) + ".");
+
+        if (name != "Math") {
+            auto it = std::find(variables.begin(), variables.end(), name);
+            if (it == variables.end())
+                return setError("Unknown identifier '" + name + "'.");
+            emit(OpVariable, 0., int(it - variables.begin()));
+            return true;
+        }
+
+        if (!expect(".")) return false;
+        std::string member = identifier();
+
+        for (const Constant& constant : constants)
+            if (member == constant.name) {
+                emit(OpConstant, constant.value);
+                return true;
+            }
+
+        for (const Function1& function : functions1)
+            if (member == function.name) {
+                if (!expect("(")) return false;
+                if (!parseConditional()) return false;
+                if (!expect(")")) return false;
+                program.push_back({OpFunction1, 0, 0., function.f, nullptr});
+                return true;
+            }
+
+        for (const Function2& function : functions2)
+            if (member == function.name) {
+                if (!expect("(")) return false;
+                int arguments = 0;
+                if (!accept(")")) {
+                    do {
+                        if (!parseConditional()) return false;
+                        if (++arguments > 1)
+                            program.push_back({OpFunction2, 0, 0., nullptr, function.f});
+                    } while (accept(","));
+                    if (!expect(")")) return false;
+                }
+                if (function.variadic) {
+                    if (arguments == 0)
+                        emit(OpConstant, function.empty);
+                    else if (arguments == 1 && function.f == jsHypot)
+                        program.push_back({OpFunction1, 0, 0., jsAbs, nullptr});
+                }
+                else if (arguments != 2)
+                    return setError("Math." + member + " expects two arguments.");
+                return true;
+            }
+
+        return setError("Unknown member 'Math." + member + "'.");
+    }
+};
+
+
+bool Expression::compile(const std::string& text, const std::vector<std::string>& variables, std::string* errorMessage)
+{
+    m_program.clear();
+    m_variables = int(variables.size());
+
+    std::vector<Instruction> program;
+    Parser parser(text, variables, program);
+    bool ok = parser.parseConditional();
+    if (ok) {
+        parser.skipSpaces();
+        if (parser.pos < text.size())
+            ok = parser.setError("Unexpected character at position " + std::to_string(parser.pos) + ".");
+    }
+    if (!ok)
+        return fail(errorMessage, parser.error);
+
+    // the evaluation stack is a fixed array
+    int depth = 0;
+    for (const Instruction& i : program) {
+        if (i.op == OpConstant || i.op == OpVariable)
+            depth++;
+        else if (i.op == OpSelect)
+            depth -= 2;
+        else if (i.op != OpNegate && i.op != OpNot && i.op != OpFunction1)
+            depth--;
+        if (depth > MaxStack)
+            return fail(errorMessage, "Expression is nested too deeply.");
+    }
+
+    m_program = program;
+    return true;
+}
+
+double Expression::evaluate(const double* values) const
+{
+    if (m_program.empty()) return std::numeric_limits<double>::quiet_NaN();
+
+    double stack[MaxStack];
+    int top = -1;
+    for (const Instruction& i : m_program)
+    {
+        switch (i.op)
+        {
+        case OpConstant: stack[++top] = i.value; break;
+        case OpVariable: stack[++top] = values[i.index]; break;
+        case OpNegate: stack[top] = -stack[top]; break;
+        case OpNot: stack[top] = isTrue(stack[top]) ? 0. : 1.; break;
+        case OpFunction1: stack[top] = i.f1(stack[top]); break;
+        case OpSelect:
+            top -= 2;
+            stack[top] = isTrue(stack[top]) ? stack[top + 1] : stack[top + 2];
+            break;
+        default:
+        {
+            double b = stack[top--];
+            double& a = stack[top];
+            switch (i.op)
+            {
+            case OpAdd: a = a + b; break;
+            case OpSubtract: a = a - b; break;
+            case OpMultiply: a = a*b; break;
+            case OpDivide: a = a/b; break;
+            case OpModulo: a = std::fmod(a, b); break;
+            case OpLess: a = a < b ? 1. : 0.; break;
+            case OpLessEqual: a = a <= b ? 1. : 0.; break;
+            case OpGreater: a = a > b ? 1. : 0.; break;
+            case OpGreaterEqual: a = a >= b ? 1. : 0.; break;
+            case OpEqual: a = a == b ? 1. : 0.; break;
+            case OpNotEqual: a = a != b ? 1. : 0.; break;
+            case OpAnd: a = isTrue(a) ? b : a; break;
+            case OpOr: a = isTrue(a) ? a : b; break;
+            case OpFunction2: a = i.f2(a, b); break;
+            }
+        }
+        }
+    }
+    return stack[0];
+}
+
+void Expression::evaluate(const double* values, double* results, int count) const
+{
+    const int chunk = 4096;
+    int threads = std::min<int>(std::max(1u, std::thread::hardware_concurrency()), (count + chunk - 1)/chunk);
+
+    auto range = [this, values, results](int a, int b) {
+        for (int n = a; n < b; ++n)
+            results[n] = evaluate(values + n*m_variables);
+    };
+
+    if (threads <= 1) {
+        range(0, count);
+        return;
+    }
+
+    std::vector<std::thread> pool;
+    int step = (count + threads - 1)/threads;
+    for (int a = 0; a < count; a += step)
+        pool.emplace_back(range, a, std::min(a + step, count));
+    for (std::thread& t : pool)
+        t.join();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "libraries/TonatiuhLibraries.h"
+
+#include <string>
+#include <vector>
+
+
+//! Compiled arithmetic expression
+/*!
+ Compiles a subset of JavaScript expressions to a small stack program:
+ numbers, the named variables, Math constants and functions
+ (Math.sin, Math.pow, Math.min, ...), the arithmetic, comparison, logical and
+ conditional operators and parentheses.
+ Evaluation needs no script engine and can run from several threads at once.
+ Text outside the subset does not compile, callers keep a script engine for it.
+*/
+class TONATIUH_LIBRARIES Expression
+{
+public:
+    bool compile(const std::string& text, const std::vector<std::string>& variables, std::string* errorMessage = nullptr);
+    bool isValid() const {return !m_program.empty();}
+
+    // values holds one value per variable, in the order given to compile
+    double evaluate(const double* values) const;
+    // values holds count rows of one value per variable, large counts are split over threads
+    void evaluate(const double* values, double* results, int count) const;
+
+private:
+    struct Instruction
+    {
+        int op;
+        int index;
+        double value;
+        double (*f1)(double);
+        double (*f2)(double, double);
+    };
+    struct Parser;
+
+    std::vector<Instruction> m_program;
+    int m_variables = 0;
+};
@@ -0,0 +1,27 @@
+#include "AirATMParameters.h"
+
+#include <algorithm>
+
+SO_NODE_SOURCE(AirATMParameters)
+
+
+void AirATMParameters::initClass()
+{
+    SO_NODE_INIT_CLASS(AirATMParameters, AirTransmission, "Air");
+}
+
+AirATMParameters::AirATMParameters()
+{
+    SO_NODE_CONSTRUCTOR(AirATMParameters);
+    SO_NODE_ADD_FIELD( atm1, (0.29544) );
+    SO_NODE_ADD_FIELD( atm2, (15.22128) );
+    SO_NODE_ADD_FIELD( atm3, (-1.8598) );
+    SO_NODE_ADD_FIELD( atm4, (0.15182) );
+}
+
+double AirATMParameters::transmission(double distance) const
+{
+    double d = distance/1000.;
+    double attenuation = atm1.getValue() + atm2.getValue()*d + atm3.getValue()*d*d + atm4.getValue()*d*d*d;
+    return std::clamp(1. - attenuation/100., 0., 1.);
+}
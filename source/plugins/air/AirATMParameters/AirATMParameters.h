@@ -0,0 +1,35 @@
+#pragma once
+
+#include "kernel/air/AirTransmission.h"
+
+
+//! AirATMParameters is the attenuation in percent as a cubic of the distance in km.
+/*!
+ * The coefficients are those of SolarPILOT; the defaults fit a clear day.
+ */
+class AirATMParameters: public AirTransmission
+{
+    SO_NODE_HEADER(AirATMParameters);
+
+public:
+    static void initClass();
+    AirATMParameters();
+
+    double transmission(double distance) const;
+
+    SoSFDouble atm1;
+    SoSFDouble atm2;
+    SoSFDouble atm3;
+    SoSFDouble atm4;
+
+    NAME_ICON_FUNCTIONS("ATMParameters", ":/AirATMParameters.png")
+};
+
+
+class AirATMParametersFactory:
+    public QObject, public AirFactoryT<AirATMParameters>
+{
+    Q_OBJECT
+    Q_INTERFACES(AirFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.AirFactory")
+};
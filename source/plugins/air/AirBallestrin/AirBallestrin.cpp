@@ -0,0 +1,36 @@
+#include "AirBallestrin.h"
+
+#include <algorithm>
+
+SO_NODE_SOURCE(AirBallestrin)
+
+
+void AirBallestrin::initClass()
+{
+    SO_NODE_INIT_CLASS(AirBallestrin, AirTransmission, "Air");
+}
+
+AirBallestrin::AirBallestrin()
+{
+    SO_NODE_CONSTRUCTOR(AirBallestrin);
+
+    SO_NODE_DEFINE_ENUM_VALUE(Visibility, ClearDay);
+    SO_NODE_DEFINE_ENUM_VALUE(Visibility, HazyDay);
+    SO_NODE_SET_SF_ENUM_TYPE(visibility, Visibility);
+    SO_NODE_ADD_FIELD( visibility, (ClearDay) );
+}
+
+double AirBallestrin::transmission(double distance) const
+{
+    double d = distance/1000.;
+    double t;
+    if (visibility.getValue() == ClearDay)
+        t = 0.9970456 - 0.1522128*d + 0.018598*d*d - 0.0015182*d*d*d;
+    else
+        t = 0.9922059 - 0.5549083*d + 0.147887*d*d - 0.0153718*d*d*d;
+    // the fits go negative past their range
+    return std::clamp(t, 0., 1.);
+}
+
+// Reference:
+// Ballestrin, J., Marzo, A., 2012. Solar radiation attenuation in solar tower plants. Solar Energy 86, 388-392.
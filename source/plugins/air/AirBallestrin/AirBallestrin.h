@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Inventor/fields/SoSFEnum.h>
+
+#include "kernel/air/AirTransmission.h"
+
+
+class AirBallestrin: public AirTransmission
+{
+    SO_NODE_HEADER(AirBallestrin);
+
+public:
+    static void initClass();
+    AirBallestrin();
+
+    double transmission(double distance) const;
+
+    enum Visibility {ClearDay, HazyDay};
+    SoSFEnum visibility;
+
+    NAME_ICON_FUNCTIONS("Ballestrin", ":/AirBallestrin.png")
+};
+
+
+class AirBallestrinFactory:
+    public QObject, public AirFactoryT<AirBallestrin>
+{
+    Q_OBJECT
+    Q_INTERFACES(AirFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.AirFactory")
+};
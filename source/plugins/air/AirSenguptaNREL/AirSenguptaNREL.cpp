@@ -0,0 +1,25 @@
+#include "AirSenguptaNREL.h"
+
+#include <cmath>
+
+SO_NODE_SOURCE(AirSenguptaNREL)
+
+
+void AirSenguptaNREL::initClass()
+{
+    SO_NODE_INIT_CLASS(AirSenguptaNREL, AirTransmission, "Air");
+}
+
+AirSenguptaNREL::AirSenguptaNREL()
+{
+    SO_NODE_CONSTRUCTOR(AirSenguptaNREL);
+    SO_NODE_ADD_FIELD( beta, (0.155996) );
+}
+
+double AirSenguptaNREL::transmission(double distance) const
+{
+    return exp(-(0.2299*beta.getValue() + 0.002674)*distance/250.);
+}
+
+// Reference:
+// Sengupta, M., Wagner, M., 2011. Impact of aerosols on atmospheric attenuation loss in central receiver systems. SolarPACES 2011, NREL/CP-5500-52754.
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "kernel/air/AirTransmission.h"
+
+
+class AirSenguptaNREL: public AirTransmission
+{
+    SO_NODE_HEADER(AirSenguptaNREL);
+
+public:
+    static void initClass();
+    AirSenguptaNREL();
+
+    double transmission(double distance) const;
+
+    SoSFDouble beta; // Angstrom turbidity
+
+    NAME_ICON_FUNCTIONS("SenguptaNREL", ":/AirSenguptaNREL.png")
+};
+
+
+class AirSenguptaNRELFactory:
+    public QObject, public AirFactoryT<AirSenguptaNREL>
+{
+    Q_OBJECT
+    Q_INTERFACES(AirFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.AirFactory")
+};
@@ -1,12 +1,14 @@
 #include "AirVittitoeBiggs.h"
 
+#include <algorithm>
+
 
 SO_NODE_SOURCE(AirVittitoeBiggs)
 
 
 void AirVittitoeBiggs::initClass()
 {
-    SO_NODE_INIT_CLASS(AirVittitoeBiggs, AirAbstract, "AirAbstract");
+    SO_NODE_INIT_CLASS(AirVittitoeBiggs, AirTransmission, "Air");
 }
 
 AirVittitoeBiggs::AirVittitoeBiggs()
@@ -28,7 +30,8 @@ double AirVittitoeBiggs::transmission(double distance) const
         t = 0.99326 - 0.1046*d + 0.017*d*d - 0.002845*d*d*d;
     else
         t = 0.98707 - 0.2748*d + 0.03394*d*d;
-    return t;
+    // the fits go negative past their range
+    return std::clamp(t, 0., 1.);
 }
 
 // Reference:
@@ -2,10 +2,10 @@
 
 #include <Inventor/fields/SoSFEnum.h>
 
-#include "kernel/air/AirAbstract.h"
+#include "kernel/air/AirTransmission.h"
 
 
-class AirVittitoeBiggs: public AirAbstract
+class AirVittitoeBiggs: public AirTransmission
 {
     SO_NODE_HEADER(AirVittitoeBiggs);
 
@@ -22,9 +22,6 @@ public:
 };
 
 
-
-#include "kernel/air/AirFactory.h"
-
 class AirVittitoeBiggsFactory:
     public QObject, public AirFactoryT<AirVittitoeBiggs>
 {
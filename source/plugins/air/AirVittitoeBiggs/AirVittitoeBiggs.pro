@@ -1,5 +0,0 @@
-include(../../plugins.pri)
-
-HEADERS = $$files(*.h)
-SOURCES = $$files(*.cpp)
-RESOURCES = resources.qrc
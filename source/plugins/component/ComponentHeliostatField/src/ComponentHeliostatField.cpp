@@ -300,7 +300,8 @@ TSeparatorKit* ComponentHeliostatField::CreateField()
 	heliostatsNodeSeparator->setName( "Heliostatos" );
 	heliostatsNodeSeparator->ref();
 
-	CreateHeliostatZones( hCenterList, heliostatsNodeSeparator, heliostatTrackerFactory, shapeFactory, heliostat, heliostatComponent, heliostatWidth, heliostatHeight, heliostatRadius,
+	TShapeKit* heliostatSurface = CreateSharedSurface( heliostat, shapeFactory, heliostatWidth, heliostatHeight, heliostatRadius, materialNode );
+	CreateHeliostatZones( hCenterList, heliostatsNodeSeparator, heliostatTrackerFactory, shapeFactory, heliostat, heliostatComponent, heliostatSurface, heliostatWidth, heliostatHeight, heliostatRadius,
 			materialNode, aimingPointList, 1 );
 
 	return heliostatsNodeSeparator;
@@ -580,7 +581,8 @@ TSeparatorKit* ComponentHeliostatField::CreateField(QVector< QVariant >  argumen
 	heliostatsNodeSeparator->setName( "Heliostats" );
 	heliostatsNodeSeparator->ref();
 
-	CreateHeliostatZones( hCenterList, heliostatsNodeSeparator, heliostatTrackerFactory, shapeFactory, heliostat, heliostatComponentNode, heliostatWidth, heliostatHeight, heliostatRadius,
+	TShapeKit* heliostatSurface = CreateSharedSurface( heliostat, shapeFactory, heliostatWidth, heliostatHeight, heliostatRadius, materialNode );
+	CreateHeliostatZones( hCenterList, heliostatsNodeSeparator, heliostatTrackerFactory, shapeFactory, heliostat, heliostatComponentNode, heliostatSurface, heliostatWidth, heliostatHeight, heliostatRadius,
 			materialNode, aimingPointList, 1 );
 
 	return heliostatsNodeSeparator;
@@ -592,6 +594,7 @@ void ComponentHeliostatField::CreateHeliostatZones( std::vector< Point3D >  heli
 		TShapeFactory* heliostatShapeFactory,
 		int heliostat,
 		TSeparatorKit* heliostatComponent,
+		TShapeKit* heliostatSurface,
 		double heliostatWidth,
 		double heliostatHeight,
 		double heliostatRadius,
@@ -600,7 +603,6 @@ void ComponentHeliostatField::CreateHeliostatZones( std::vector< Point3D >  heli
 		int eje )
 {
 	SoType separatorType = SoType::fromName( SbName ( "TSeparatorKit" ) );
-	SoType shapeKitType = SoType::fromName( SbName ( "TShapeKit" ) );
 
 	SoNodeKitListPart* heliostatsNodePartList = static_cast< SoNodeKitListPart* >( parentNode->getPart( "childList", true ) );
 	if( !heliostatsNodePartList ) return;
@@ -645,37 +647,11 @@ void ComponentHeliostatField::CreateHeliostatZones( std::vector< Point3D >  heli
 				heliostaTrackerNodetPartList->addChild( heliostatComponent );
 			else if( heliostat == 2 )
 			{
-				TShapeKit* heliostatSurface = static_cast< TShapeKit* > ( shapeKitType.createInstance() );
-				heliostaTrackerNodetPartList->addChild(heliostatSurface);
-
-				TShape* shape = heliostatShapeFactory->CreateTShape();
-
-				if( heliostatShapeFactory->TShapeName() == QString( "Spherical_rectangle" ) )
-				{
-					trt::TONATIUH_REAL* hRadiusField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "radius" ) );
-
-					if( heliostatRadius < 0.0 )
-						hRadiusField->setValue(  2* Distance( aimingPointList[nHeliostat], hCenter ) );
-					else
-						hRadiusField->setValue(  heliostatRadius );
-
-					trt::TONATIUH_REAL* widthXField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "widthX" ) );
-					widthXField->setValue(  heliostatWidth );
-
-					trt::TONATIUH_REAL* widthZField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "widthZ" ) );
-					widthZField->setValue(  heliostatHeight );
-				}
-				else if( heliostatShapeFactory->TShapeName() == QString( "Flat_Rectangle" ) )
-				{
-					trt::TONATIUH_REAL* widthXField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "width" ) );
-					widthXField->setValue(  heliostatWidth );
-
-					trt::TONATIUH_REAL* widthZField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "height" ) );
-					widthZField->setValue(  heliostatHeight );
-				}
-
-				heliostatSurface->setPart("shape", shape);
-				heliostatSurface->setPart("material", materialNode );
+				if( heliostatSurface )
+					heliostaTrackerNodetPartList->addChild( heliostatSurface );
+				else
+					heliostaTrackerNodetPartList->addChild( CreateHeliostatSurface( heliostatShapeFactory, heliostatWidth, heliostatHeight,
+							2* Distance( aimingPointList[nHeliostat], hCenter ), materialNode ) );
 			}
 		}
 	}
@@ -728,9 +704,9 @@ void ComponentHeliostatField::CreateHeliostatZones( std::vector< Point3D >  heli
 				aimingPointListPart2.push_back( coordsAndAimingPoint[position].second );
 				position++;
 			}
-			CreateHeliostatZones( hCenterListPart1, heliostatSeparator1, heliostatTrackerFactory, heliostatShapeFactory, heliostat, heliostatComponent, heliostatWidth, heliostatHeight, heliostatRadius,
+			CreateHeliostatZones( hCenterListPart1, heliostatSeparator1, heliostatTrackerFactory, heliostatShapeFactory, heliostat, heliostatComponent, heliostatSurface, heliostatWidth, heliostatHeight, heliostatRadius,
 					materialNode, aimingPointListPart1, 1 );
-			CreateHeliostatZones( hCenterListPart2, heliostatSeparator2, heliostatTrackerFactory, heliostatShapeFactory, heliostat, heliostatComponent, heliostatWidth, heliostatHeight, heliostatRadius,
+			CreateHeliostatZones( hCenterListPart2, heliostatSeparator2, heliostatTrackerFactory, heliostatShapeFactory, heliostat, heliostatComponent, heliostatSurface, heliostatWidth, heliostatHeight, heliostatRadius,
 					materialNode, aimingPointListPart2, 1 );
 		}
 		else
@@ -765,14 +741,72 @@ void ComponentHeliostatField::CreateHeliostatZones( std::vector< Point3D >  heli
 				aimingPointListPart2.push_back( coordsAndAimingPoint[position].second );
 				position++;
 			}
-			CreateHeliostatZones( hCenterListPart1, heliostatSeparator1, heliostatTrackerFactory, heliostatShapeFactory, heliostat, heliostatComponent, heliostatWidth, heliostatHeight, heliostatRadius,
+			CreateHeliostatZones( hCenterListPart1, heliostatSeparator1, heliostatTrackerFactory, heliostatShapeFactory, heliostat, heliostatComponent, heliostatSurface, heliostatWidth, heliostatHeight, heliostatRadius,
 					materialNode, aimingPointListPart1, 3 );
-			CreateHeliostatZones( hCenterListPart2, heliostatSeparator2, heliostatTrackerFactory, heliostatShapeFactory, heliostat, heliostatComponent, heliostatWidth, heliostatHeight, heliostatRadius,
+			CreateHeliostatZones( hCenterListPart2, heliostatSeparator2, heliostatTrackerFactory, heliostatShapeFactory, heliostat, heliostatComponent, heliostatSurface, heliostatWidth, heliostatHeight, heliostatRadius,
 					materialNode, aimingPointListPart2, 3 );
 		}
 	}
 }
 
+/*!
+ * Returns the heliostat surface shared by every heliostat of the field, or 0 when
+ * each heliostat needs its own: for a component, which is shared as it is, and for
+ * a spherical surface with the slant radius, which depends on the aiming point.
+ *
+ * A shared surface is written once to the scene file and compiled once by the ray tracer.
+ */
+TShapeKit* ComponentHeliostatField::CreateSharedSurface( int heliostat,
+		TShapeFactory* heliostatShapeFactory,
+		double heliostatWidth,
+		double heliostatHeight,
+		double heliostatRadius,
+		TMaterial* materialNode )
+{
+	if( heliostat != 2 ) return 0;
+	if( heliostatShapeFactory->TShapeName() == QString( "Spherical_rectangle" ) && heliostatRadius < 0.0 ) return 0;
+
+	TShapeKit* heliostatSurface = CreateHeliostatSurface( heliostatShapeFactory, heliostatWidth, heliostatHeight, heliostatRadius, materialNode );
+	heliostatSurface->setName( "HeliostatSurface" );
+	return heliostatSurface;
+}
+
+TShapeKit* ComponentHeliostatField::CreateHeliostatSurface( TShapeFactory* heliostatShapeFactory,
+		double heliostatWidth,
+		double heliostatHeight,
+		double heliostatRadius,
+		TMaterial* materialNode )
+{
+	SoType shapeKitType = SoType::fromName( SbName ( "TShapeKit" ) );
+	TShapeKit* heliostatSurface = static_cast< TShapeKit* > ( shapeKitType.createInstance() );
+
+	TShape* shape = heliostatShapeFactory->CreateTShape();
+
+	if( heliostatShapeFactory->TShapeName() == QString( "Spherical_rectangle" ) )
+	{
+		trt::TONATIUH_REAL* hRadiusField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "radius" ) );
+		hRadiusField->setValue(  heliostatRadius );
+
+		trt::TONATIUH_REAL* widthXField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "widthX" ) );
+		widthXField->setValue(  heliostatWidth );
+
+		trt::TONATIUH_REAL* widthZField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "widthZ" ) );
+		widthZField->setValue(  heliostatHeight );
+	}
+	else if( heliostatShapeFactory->TShapeName() == QString( "Flat_Rectangle" ) )
+	{
+		trt::TONATIUH_REAL* widthXField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "width" ) );
+		widthXField->setValue(  heliostatWidth );
+
+		trt::TONATIUH_REAL* widthZField = static_cast< trt::TONATIUH_REAL* > ( shape->getField( "height" ) );
+		widthZField->setValue(  heliostatHeight );
+	}
+
+	heliostatSurface->setPart("shape", shape);
+	heliostatSurface->setPart("material", materialNode );
+	return heliostatSurface;
+}
+
 TSeparatorKit* ComponentHeliostatField::OpenHeliostatComponent( QString fileName )
 {
 	if ( fileName.isEmpty() ) return 0;
@@ -48,6 +48,7 @@ class QString;
 class SoNode;
 class TSeparatorKit;
 class TShapeFactory;
+class TShapeKit;
 class TMaterial;
 class TTrackerFactory;
 
@@ -68,6 +69,7 @@ private:
 			TShapeFactory* heliostatShaperFactory,
 			int heliostat,
 			TSeparatorKit* heliostatComponent,
+			TShapeKit* heliostatSurface,
 			double heliostatWidth,
 			double heliostatHeight,
 			double heliostatRadius,
@@ -75,6 +77,18 @@ private:
 			std::vector< Point3D > aimingPointList,
 			int eje );
 
+	TShapeKit* CreateSharedSurface( int heliostat,
+			TShapeFactory* heliostatShapeFactory,
+			double heliostatWidth,
+			double heliostatHeight,
+			double heliostatRadius,
+			TMaterial* materialNode );
+	TShapeKit* CreateHeliostatSurface( TShapeFactory* heliostatShapeFactory,
+			double heliostatWidth,
+			double heliostatHeight,
+			double heliostatRadius,
+			TMaterial* materialNode );
+
 	TSeparatorKit* OpenHeliostatComponent( QString fileName );
 
 	PluginManager* m_pPluginManager;
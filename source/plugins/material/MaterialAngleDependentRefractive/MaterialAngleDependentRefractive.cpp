@@ -0,0 +1,150 @@
+#include "MaterialAngleDependentRefractive.h"
+
+#include <algorithm>
+
+#include <Inventor/sensors/SoNodeSensor.h>
+
+#include "libraries/math/gcf.h"
+#include "libraries/math/3D/Ray.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/random/Random.h"
+
+namespace {
+
+// samples of each table, fine enough for measured curves
+const int TableSize = 1024;
+
+void makeTables(const SoMFVec3f& rows, LookupTable& reflected, LookupTable& scattered)
+{
+    std::vector<vec2d> reflectivity;
+    std::vector<vec2d> transmissivity;
+    reflectivity.reserve(rows.getNum());
+    transmissivity.reserve(rows.getNum());
+    for (int n = 0; n < rows.getNum(); ++n) {
+        reflectivity.push_back(vec2d(rows[n][0], rows[n][1]));
+        transmissivity.push_back(vec2d(rows[n][0], rows[n][2]));
+    }
+    auto byAngle = [](const vec2d& a, const vec2d& b) {return a.x < b.x;};
+    std::stable_sort(reflectivity.begin(), reflectivity.end(), byAngle);
+    std::stable_sort(transmissivity.begin(), transmissivity.end(), byAngle);
+
+    auto r = [&reflectivity](double cosTheta) {
+        return std::clamp(LookupTable::interpolate(reflectivity, std::acos(cosTheta)), 0., 1.);
+    };
+    auto rt = [&](double cosTheta) {
+        double t = std::max(LookupTable::interpolate(transmissivity, std::acos(cosTheta)), 0.);
+        return std::min(r(cosTheta) + t, 1.);
+    };
+    reflected.build(r, 0., 1., TableSize);
+    scattered.build(rt, 0., 1., TableSize);
+}
+
+} // namespace
+
+
+SO_NODE_SOURCE(MaterialAngleDependentRefractive)
+
+void MaterialAngleDependentRefractive::initClass()
+{
+    SO_NODE_INIT_CLASS(MaterialAngleDependentRefractive, MaterialRT, "MaterialRT");
+}
+
+MaterialAngleDependentRefractive::MaterialAngleDependentRefractive()
+{
+    SO_NODE_CONSTRUCTOR(MaterialAngleDependentRefractive);
+    isBuiltIn = TRUE;
+
+    // uncoated glass near normal incidence
+    float rows[][3] = {
+        {0.f, 0.04f, 0.92f},
+        {float(gcf::pi/2.), 0.04f, 0.92f}
+    };
+    SO_NODE_ADD_FIELD(nFront, (1.) ); // air
+    opticsFront.setValues(0, 2, rows);
+    opticsFront.setContainer(this);
+    fieldData->addField(this, "opticsFront", &opticsFront);
+    SO_NODE_ADD_FIELD(nBack, (1.5) ); // glass
+    opticsBack.setValues(0, 2, rows);
+    opticsBack.setContainer(this);
+    fieldData->addField(this, "opticsBack", &opticsBack);
+
+    SO_NODE_DEFINE_ENUM_VALUE(Distribution, pillbox);
+    SO_NODE_DEFINE_ENUM_VALUE(Distribution, Gaussian);
+    SO_NODE_SET_SF_ENUM_TYPE(distribution, Distribution);
+    SO_NODE_ADD_FIELD(distribution, (Gaussian) );
+
+    SO_NODE_ADD_FIELD(slope, (0.002) ); // in radians
+
+    // the tables are ready before any trace
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+    onSensor(this, 0);
+}
+
+MaterialAngleDependentRefractive::~MaterialAngleDependentRefractive()
+{
+    delete m_sensor;
+}
+
+bool MaterialAngleDependentRefractive::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const
+{
+    return scatter(rayIn, dg, rand, rayOut, nullptr);
+}
+
+bool MaterialAngleDependentRefractive::OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& weight) const
+{
+    return scatter(rayIn, dg, rand, rayOut, &weight);
+}
+
+// weight, if given, is multiplied by the part not absorbed instead of a draw
+bool MaterialAngleDependentRefractive::scatter(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double* weight) const
+{
+    // the normal and indices on the side of the ray
+    const vec3d& d = rayIn.direction();
+    vec3d normal = dg.isFront ? dg.normal : -dg.normal;
+    double nI = nFront.getValue();
+    double nT = nBack.getValue();
+    if (!dg.isFront) std::swap(nI, nT);
+    double cosTheta = std::min(std::abs(dot(d, normal)), 1.);
+
+    // one draw splits reflection, transmission and absorption
+    double r = dg.isFront ? m_reflectedFront(cosTheta) : m_reflectedBack(cosTheta);
+    double rt = dg.isFront ? m_scatteredFront(cosTheta) : m_scatteredBack(cosTheta);
+    double u = rand.RandomDouble();
+    if (weight) {
+        if (!(rt > 0.)) return false;
+        *weight *= rt;
+        u *= rt;
+    } else if (u >= rt)
+        return false;
+
+    rayOut.origin = dg.point;
+    if (u >= r) {
+        double eta = nI/nT;
+        double sin2 = eta*eta*(1. - cosTheta*cosTheta);
+        if (sin2 < 1.) {
+            rayOut.setDirection(eta*d + (eta*cosTheta - std::sqrt(1. - sin2))*normal);
+            return true;
+        }
+        // total internal reflection
+    }
+
+    if (!m_slope.isZero()) {
+        double su = rand.RandomDouble();
+        double sv = rand.RandomDouble();
+        normal = SlopeSampler::toFrame(m_slope.sample(su, sv), normal, dg.dpdu);
+    }
+    rayOut.setDirection(d.reflected(normal));
+    return true;
+}
+
+void MaterialAngleDependentRefractive::onSensor(void* data, SoSensor*)
+{
+    MaterialAngleDependentRefractive* material = (MaterialAngleDependentRefractive*) data;
+    makeTables(material->opticsFront, material->m_reflectedFront, material->m_scatteredFront);
+    makeTables(material->opticsBack, material->m_reflectedBack, material->m_scatteredBack);
+
+    SlopeSampler::Distribution distribution = SlopeSampler::Distribution(material->distribution.getValue());
+    material->m_slope = SlopeSampler(distribution, material->slope.getValue());
+}
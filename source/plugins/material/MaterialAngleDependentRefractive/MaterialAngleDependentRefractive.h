@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Inventor/fields/SoMFVec3f.h>
+
+#include "kernel/material/MaterialRT.h"
+#include "kernel/material/SlopeSampler.h"
+#include "libraries/math/1D/LookupTable.h"
+
+
+//! MaterialAngleDependentRefractive is a refractive surface whose reflectivity and transmissivity depend on the incidence angle.
+/*!
+ * The optics of each side are given as rows of incidence angle in radians,
+ * reflectivity and transmissivity, linear between rows and constant beyond
+ * the first and last; the rest of the light is absorbed. The side is the one
+ * the ray comes from, and nFront and nBack are the refractive indices there.
+ *
+ * When the fields change the rows are resampled into tables uniform in the
+ * cosine of the incidence angle holding the probabilities of reflection and
+ * of reflection or transmission, so a hit costs one indexed interpolation of
+ * each and one draw to split it. Total internal reflection turns transmitted
+ * rays into reflected ones. The slope error tilts the normal of reflected
+ * rays only.
+ */
+class MaterialAngleDependentRefractive: public MaterialRT
+{
+    SO_NODE_HEADER(MaterialAngleDependentRefractive);
+
+public:
+    enum Distribution {
+        pillbox,
+        Gaussian
+    };
+
+    static void initClass();
+    MaterialAngleDependentRefractive();
+
+    bool OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const;
+    bool OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& weight) const;
+
+    SoSFDouble nFront;
+    SoMFVec3f opticsFront;
+    SoSFDouble nBack;
+    SoMFVec3f opticsBack;
+    SoSFEnum distribution;
+    SoSFDouble slope;
+
+    NAME_ICON_FUNCTIONS("AngleDependentRefractive", ":/MaterialAngleDependentRefractive.png")
+
+protected:
+    ~MaterialAngleDependentRefractive();
+
+    bool scatter(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double* weight) const;
+
+    // of cos(theta), reflectivity and reflectivity plus transmissivity
+    LookupTable m_reflectedFront;
+    LookupTable m_scatteredFront;
+    LookupTable m_reflectedBack;
+    LookupTable m_scatteredBack;
+    SlopeSampler m_slope;
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
+};
+
+
+class MaterialAngleDependentRefractiveFactory:
+    public QObject, public MaterialFactoryT<MaterialAngleDependentRefractive>
+{
+    Q_OBJECT
+    Q_INTERFACES(MaterialFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.MaterialFactory")
+};
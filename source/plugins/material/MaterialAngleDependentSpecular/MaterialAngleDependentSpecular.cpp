@@ -0,0 +1,148 @@
+#include "MaterialAngleDependentSpecular.h"
+
+#include <algorithm>
+
+#include <Inventor/sensors/SoNodeSensor.h>
+
+#include "libraries/math/gcf.h"
+#include "libraries/math/3D/Ray.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/random/Random.h"
+#include "kernel/node/TonatiuhFunctions.h"
+
+namespace {
+
+// samples of each table, fine enough for measured curves
+const int TableSize = 1024;
+
+void makeTable(const SoMFVec2f& rows, LookupTable& table)
+{
+    std::vector<vec2d> points;
+    points.reserve(rows.getNum());
+    for (int n = 0; n < rows.getNum(); ++n)
+        points.push_back(vec2d(rows[n][0], rows[n][1]));
+    std::stable_sort(points.begin(), points.end(), [](const vec2d& a, const vec2d& b) {
+        return a.x < b.x;
+    });
+
+    auto reflectivity = [&points](double cosTheta) {
+        double r = LookupTable::interpolate(points, std::acos(cosTheta));
+        return std::clamp(r, 0., 1.);
+    };
+    table.build(reflectivity, 0., 1., TableSize);
+}
+
+} // namespace
+
+
+SO_NODE_SOURCE(MaterialAngleDependentSpecular)
+
+void MaterialAngleDependentSpecular::initClass()
+{
+    SO_NODE_INIT_CLASS(MaterialAngleDependentSpecular, MaterialRT, "MaterialRT");
+}
+
+MaterialAngleDependentSpecular::MaterialAngleDependentSpecular()
+{
+    SO_NODE_CONSTRUCTOR(MaterialAngleDependentSpecular);
+    isBuiltIn = TRUE;
+
+    float rows[][2] = {
+        {0.f, 0.95f},
+        {float(gcf::pi/2.), 0.95f}
+    };
+    reflectivityFront.setValues(0, 2, rows);
+    reflectivityFront.setContainer(this);
+    fieldData->addField(this, "reflectivityFront", &reflectivityFront);
+    reflectivityBack.setValues(0, 2, rows);
+    reflectivityBack.setContainer(this);
+    fieldData->addField(this, "reflectivityBack", &reflectivityBack);
+
+    SO_NODE_DEFINE_ENUM_VALUE(Distribution, pillbox);
+    SO_NODE_DEFINE_ENUM_VALUE(Distribution, Gaussian);
+    SO_NODE_SET_SF_ENUM_TYPE(distribution, Distribution);
+    SO_NODE_ADD_FIELD(distribution, (Gaussian) );
+
+    SO_NODE_ADD_FIELD(slope, (0.002) ); // in radians
+
+    // the tables are ready before any trace
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+    onSensor(this, 0);
+}
+
+MaterialAngleDependentSpecular::~MaterialAngleDependentSpecular()
+{
+    delete m_sensor;
+}
+
+bool MaterialAngleDependentSpecular::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const
+{
+    return reflect(rayIn, dg, rand, rayOut, nullptr);
+}
+
+bool MaterialAngleDependentSpecular::OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& weight) const
+{
+    return reflect(rayIn, dg, rand, rayOut, &weight);
+}
+
+// weight, if given, is multiplied by the reflectivity instead of a draw
+bool MaterialAngleDependentSpecular::reflect(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double* weight) const
+{
+    // reflectivity
+    double cosTheta = std::abs(dot(rayIn.direction(), dg.normal));
+    const LookupTable& table = dg.isFront ? m_tableFront : m_tableBack;
+    if (weight)
+        *weight *= table(cosTheta);
+    else if (rand.RandomDouble() >= table(cosTheta))
+        return false;
+
+    rayOut.origin = dg.point;
+
+    vec3d normal;
+    double sigma = slope.getValue();
+    if (sigma > 0.) {
+        if (distribution.getValue() == Distribution::pillbox)
+        {
+            double phi = gcf::TwoPi*rand.RandomDouble();
+            double sinTheta = sin(sigma)*sqrt(rand.RandomDouble());
+            double cosTheta = sqrt(1. - sinTheta*sinTheta);
+            normal.x = sinTheta*cos(phi);
+            normal.y = sinTheta*sin(phi);
+            normal.z = cosTheta;
+        }
+        else //if (distribution.getValue() == Distribution::Gaussian)
+        {
+            // https://en.wikipedia.org/wiki/Marsaglia_polar_method
+            double u, v, s;
+            do {
+                u = 2.*rand.RandomDouble() - 1.;
+                v = 2.*rand.RandomDouble() - 1.;
+                s = u*u + v*v;
+            } while (s > 1. || s == 0.);
+            s = sigma*sqrt(-2.*log(s)/s);
+
+            normal.x = s*u;
+            normal.y = s*v;
+            normal.z = 1.;
+        }
+        vec3d vx = dg.dpdu.normalized();
+        vec3d vy = dg.dpdv.normalized();
+        vec3d vz = dg.normal;
+        normal = vx*normal.x + vy*normal.y + vz*normal.z;
+        normal.normalize();
+    } else
+        normal = dg.normal;
+
+    vec3d d = rayIn.direction().reflected(normal);
+    rayOut.setDirection(d);
+    return true;
+}
+
+void MaterialAngleDependentSpecular::onSensor(void* data, SoSensor*)
+{
+    MaterialAngleDependentSpecular* material = (MaterialAngleDependentSpecular*) data;
+    makeTable(material->reflectivityFront, material->m_tableFront);
+    makeTable(material->reflectivityBack, material->m_tableBack);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Inventor/fields/SoMFVec2f.h>
+
+#include "kernel/material/MaterialRT.h"
+#include "libraries/math/1D/LookupTable.h"
+
+
+//! MaterialAngleDependentSpecular is a mirror whose reflectivity depends on the incidence angle.
+/*!
+ * The reflectivity of each side is given as rows of incidence angle in radians
+ * and reflectivity, linear between rows and constant beyond the first and last.
+ * When the rows change they are resampled into a table uniform in the cosine
+ * of the incidence angle, so a hit costs one indexed interpolation.
+ */
+class MaterialAngleDependentSpecular: public MaterialRT
+{
+    SO_NODE_HEADER(MaterialAngleDependentSpecular);
+
+public:
+    enum Distribution {
+        pillbox,
+        Gaussian
+    };
+
+    static void initClass();
+    MaterialAngleDependentSpecular();
+
+    bool OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const;
+    bool OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& weight) const;
+
+    SoMFVec2f reflectivityFront;
+    SoMFVec2f reflectivityBack;
+    SoSFEnum distribution;
+    SoSFDouble slope;
+
+    NAME_ICON_FUNCTIONS("AngleDependentSpecular", ":/MaterialAngleDependentSpecular.png")
+
+protected:
+    ~MaterialAngleDependentSpecular();
+
+    bool reflect(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double* weight) const;
+
+    LookupTable m_tableFront; // of cos(theta)
+    LookupTable m_tableBack;
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
+};
+
+
+class MaterialAngleDependentSpecularFactory:
+    public QObject, public MaterialFactoryT<MaterialAngleDependentSpecular>
+{
+    Q_OBJECT
+    Q_INTERFACES(MaterialFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.MaterialFactory")
+};
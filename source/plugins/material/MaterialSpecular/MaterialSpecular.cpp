@@ -5,6 +5,7 @@
 #include "libraries/math/gcf.h"
 #include "libraries/math/3D/Ray.h"
 #include "libraries/math/3D/Transform.h"
+#include "kernel/material/SlopeSampler.h"
 #include "kernel/shape/DifferentialGeometry.h"
 #include "kernel/random/Random.h"
 #include "kernel/node/TonatiuhFunctions.h"
@@ -40,17 +41,37 @@ MaterialSpecular::~MaterialSpecular()
     delete m_sensor;
 }
 
-bool MaterialSpecular::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const
+namespace {
+
+// the fields, read once per call or batch
+struct Surface
+{
+    explicit Surface(const MaterialSpecular& m):
+        reflectivity(m.reflectivity.getValue()),
+        distribution(m.distribution.getValue()),
+        slope(m.slope.getValue())
+    {}
+
+    double reflectivity;
+    int distribution;
+    double slope;
+};
+
+// weight, if given, is multiplied by the reflectivity instead of a draw
+bool shade(const Surface& surface, const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double* weight = nullptr)
 {
     // reflectivity
-    if (rand.RandomDouble() >= reflectivity.getValue()) return false;
+    if (weight)
+        *weight *= surface.reflectivity;
+    else if (rand.RandomDouble() >= surface.reflectivity)
+        return false;
 
     rayOut.origin = dg.point;
 
     vec3d normal;
-    double sigma = slope.getValue();
+    double sigma = surface.slope;
     if (sigma > 0.) {
-        if (distribution.getValue() == Distribution::pillbox)
+        if (surface.distribution == MaterialSpecular::Distribution::pillbox)
         {
             double phi = gcf::TwoPi*rand.RandomDouble();
             double sinTheta = sin(sigma)*sqrt(rand.RandomDouble());
@@ -59,7 +80,7 @@ bool MaterialSpecular::OutputRay(const Ray& rayIn, const DifferentialGeometry& d
             normal.y = sinTheta*sin(phi);
             normal.z = cosTheta;
         }
-        else //if (distribution.getValue() == Distribution::Gaussian)
+        else //if (surface.distribution == Distribution::Gaussian)
         {
             // https://en.wikipedia.org/wiki/Marsaglia_polar_method
             double u, v, s;
@@ -87,6 +108,34 @@ bool MaterialSpecular::OutputRay(const Ray& rayIn, const DifferentialGeometry& d
     return true;
 }
 
+} // namespace
+
+
+bool MaterialSpecular::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const
+{
+    return shade(Surface(*this), rayIn, dg, rand, rayOut);
+}
+
+void MaterialSpecular::OutputRays(std::span<MaterialHit> hits, Random& rand) const
+{
+    const Surface surface(*this);
+    for (MaterialHit& hit : hits)
+        hit.isReflected = shade(surface, *hit.rayIn, *hit.dg, rand, hit.rayOut);
+}
+
+bool MaterialSpecular::OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& weight) const
+{
+    return shade(Surface(*this), rayIn, dg, rand, rayOut, &weight);
+}
+
+bool MaterialSpecular::getSpecularModel(double* reflectivity, SlopeSampler* slope) const
+{
+    const Surface surface(*this);
+    *reflectivity = surface.reflectivity;
+    *slope = SlopeSampler(surface.distribution == pillbox ? SlopeSampler::pillbox : SlopeSampler::Gaussian, surface.slope);
+    return true;
+}
+
 void MaterialSpecular::onSensor(void* data, SoSensor*)
 {
     MaterialSpecular* material = (MaterialSpecular*) data;
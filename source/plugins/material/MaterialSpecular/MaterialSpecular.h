@@ -17,6 +17,9 @@ public:
     MaterialSpecular();
 
     bool OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const;
+    void OutputRays(std::span<MaterialHit> hits, Random& rand) const;
+    bool OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& weight) const;
+    bool getSpecularModel(double* reflectivity, SlopeSampler* slope) const;
 
     SoSFDouble reflectivity;
     SoSFEnum distribution;
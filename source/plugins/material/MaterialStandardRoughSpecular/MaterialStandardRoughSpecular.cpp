@@ -0,0 +1,103 @@
+#include "MaterialStandardRoughSpecular.h"
+
+#include <Inventor/sensors/SoNodeSensor.h>
+
+#include "libraries/math/3D/Ray.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/random/Random.h"
+
+
+SO_NODE_SOURCE(MaterialStandardRoughSpecular)
+
+void MaterialStandardRoughSpecular::initClass()
+{
+    SO_NODE_INIT_CLASS(MaterialStandardRoughSpecular, MaterialRT, "MaterialRT");
+}
+
+MaterialStandardRoughSpecular::MaterialStandardRoughSpecular()
+{
+    SO_NODE_CONSTRUCTOR(MaterialStandardRoughSpecular);
+    isBuiltIn = TRUE;
+
+    SO_NODE_ADD_FIELD(reflectivity, (0.95) );
+
+    SO_NODE_DEFINE_ENUM_VALUE(Distribution, pillbox);
+    SO_NODE_DEFINE_ENUM_VALUE(Distribution, Gaussian);
+    SO_NODE_SET_SF_ENUM_TYPE(distribution, Distribution);
+    SO_NODE_ADD_FIELD(distribution, (Gaussian) );
+
+    SO_NODE_ADD_FIELD(slope, (0.002) ); // in radians
+    SO_NODE_ADD_FIELD(specularity, (0.) ); // in radians
+
+    // the samplers are ready before any trace
+    m_sensor = new SoNodeSensor(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+    onSensor(this, 0);
+}
+
+MaterialStandardRoughSpecular::~MaterialStandardRoughSpecular()
+{
+    delete m_sensor;
+}
+
+bool MaterialStandardRoughSpecular::OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const
+{
+    return reflect(rayIn, dg, rand, rayOut, nullptr);
+}
+
+bool MaterialStandardRoughSpecular::OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& weight) const
+{
+    return reflect(rayIn, dg, rand, rayOut, &weight);
+}
+
+// weight, if given, is multiplied by the reflectivity instead of a draw
+bool MaterialStandardRoughSpecular::reflect(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double* weight) const
+{
+    // reflectivity
+    if (weight)
+        *weight *= reflectivity.getValue();
+    else if (rand.RandomDouble() >= reflectivity.getValue())
+        return false;
+
+    rayOut.origin = dg.point;
+
+    // the uniforms are drawn in order, not as arguments
+    vec3d normal = dg.normal;
+    if (!m_slope.isZero()) {
+        double u = rand.RandomDouble();
+        double v = rand.RandomDouble();
+        normal = SlopeSampler::toFrame(m_slope.sample(u, v), dg.normal, dg.dpdu);
+    }
+
+    vec3d d = rayIn.direction().reflected(normal);
+    if (!m_specularity.isZero()) {
+        double u = rand.RandomDouble();
+        double v = rand.RandomDouble();
+        d = SlopeSampler::toFrame(m_specularity.sample(u, v), d.normalized(), dg.normal);
+    }
+    rayOut.setDirection(d); // double sided
+    return true;
+}
+
+bool MaterialStandardRoughSpecular::getSpecularModel(double* reflectivity, SlopeSampler* slope) const
+{
+    if (!m_specularity.isZero())
+        return false;
+    *reflectivity = this->reflectivity.getValue();
+    *slope = m_slope;
+    return true;
+}
+
+void MaterialStandardRoughSpecular::onSensor(void* data, SoSensor*)
+{
+    MaterialStandardRoughSpecular* material = (MaterialStandardRoughSpecular*) data;
+    if (material->reflectivity.getValue() < 0.)
+        material->reflectivity = 0.;
+    if (material->reflectivity.getValue() > 1.)
+        material->reflectivity = 1.;
+
+    SlopeSampler::Distribution distribution = SlopeSampler::Distribution(material->distribution.getValue());
+    material->m_slope = SlopeSampler(distribution, material->slope.getValue());
+    material->m_specularity = SlopeSampler(distribution, material->specularity.getValue());
+}
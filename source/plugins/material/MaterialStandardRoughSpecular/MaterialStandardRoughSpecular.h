@@ -0,0 +1,58 @@
+#pragma once
+
+#include "kernel/material/MaterialRT.h"
+#include "kernel/material/SlopeSampler.h"
+
+
+//! MaterialStandardRoughSpecular is a mirror with slope and specularity errors.
+/*!
+ * The slope error tilts the surface normal before the reflection and the
+ * specularity error tilts the reflected ray around its own direction.
+ * Both are drawn by SlopeSampler with two uniforms each, so every reflected
+ * ray takes the same number of random numbers.
+ */
+class MaterialStandardRoughSpecular: public MaterialRT
+{
+    SO_NODE_HEADER(MaterialStandardRoughSpecular);
+
+public:
+    enum Distribution {
+        pillbox,
+        Gaussian
+    };
+
+    static void initClass();
+    MaterialStandardRoughSpecular();
+
+    bool OutputRay(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut) const;
+    bool OutputRayWeighted(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double& weight) const;
+    // without specularity errors only
+    bool getSpecularModel(double* reflectivity, SlopeSampler* slope) const;
+
+    SoSFDouble reflectivity;
+    SoSFEnum distribution;
+    SoSFDouble slope;
+    SoSFDouble specularity;
+
+    NAME_ICON_FUNCTIONS("StandardRoughSpecular", ":/MaterialStandardRoughSpecular.png")
+
+protected:
+    ~MaterialStandardRoughSpecular();
+
+    bool reflect(const Ray& rayIn, const DifferentialGeometry& dg, Random& rand, Ray& rayOut, double* weight) const;
+
+    SlopeSampler m_slope;
+    SlopeSampler m_specularity;
+
+    SoNodeSensor* m_sensor;
+    static void onSensor(void* data, SoSensor*);
+};
+
+
+class MaterialStandardRoughSpecularFactory:
+    public QObject, public MaterialFactoryT<MaterialStandardRoughSpecular>
+{
+    Q_OBJECT
+    Q_INTERFACES(MaterialFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.MaterialFactory")
+};
@@ -1,46 +0,0 @@
-
-TEMPLATE      = lib
-CONFIG       += plugin debug_and_release
-
-include( ../../config.pri )
-
-                
-INCLUDEPATH += . \
-                src \
-                $$(TONATIUH_ROOT)/plugins \
-                $$(TONATIUH_ROOT)/src 
-
-# Input
-HEADERS = src/*.h \             
-            $$(TONATIUH_ROOT)/src/source/geometry/tgf.h \                                               
-            $$(TONATIUH_ROOT)/src/source/raytracing/DifferentialGeometry.h \
-            $$(TONATIUH_ROOT)/src/source/raytracing/TMaterial.h \
-            $$(TONATIUH_ROOT)/src/source/raytracing/trt.h \
-            $$(TONATIUH_ROOT)/src/source/raytracing/TShape.h  \
-            $$(TONATIUH_ROOT)/src/source/raytracing/TShapeKit.h  \
-            $$(TONATIUH_ROOT)/src/source/statistics/RandomDeviate.h
-            
-SOURCES = src/*.cpp \                                       
-            $$(TONATIUH_ROOT)/src/source/geometry/tgf.cpp \                     
-            $$(TONATIUH_ROOT)/src/source/raytracing/DifferentialGeometry.cpp \
-            $$(TONATIUH_ROOT)/src/source/raytracing/TMaterial.cpp \
-            $$(TONATIUH_ROOT)/src/source/raytracing/TShape.cpp  \
-            $$(TONATIUH_ROOT)/src/source/raytracing/TShapeKit.cpp
-
-RESOURCES += src/MaterialStandardRoughSpecular.qrc
-
-TARGET        = MaterialStandardRoughSpecular
- 
-CONFIG(debug, debug|release) {
-    DESTDIR       = $$(TONATIUH_ROOT)/bin/debug/plugins/MaterialStandardRoughSpecular    
-    unix {
-        TARGET = $$member(TARGET, 0)_debug
-    }
-    else {
-        TARGET = $$member(TARGET, 0)d
-    }
-}
-else { 
-    DESTDIR       = $$(TONATIUH_ROOT)/bin/release/plugins/MaterialStandardRoughSpecular
-}
-
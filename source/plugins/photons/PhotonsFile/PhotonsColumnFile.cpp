@@ -0,0 +1,315 @@
+#include "PhotonsColumnFile.h"
+
+#include <algorithm>
+#include <thread>
+
+#include <QDataStream>
+#include <QFile>
+#include <QtEndian>
+
+
+namespace {
+
+const char Magic[8] = {'T', 'N', 'P', 'H', 'O', 'T', 'O', 'N'};
+const quint32 Version = 2;
+
+// in place, raw arrays are written as stored on little-endian hosts
+void toLittleEndian(std::vector<char>& data, int size)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    for (size_t n = 0; n + size <= data.size(); n += size)
+        std::reverse(data.begin() + n, data.begin() + n + size);
+#else
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+#endif
+}
+
+}
+
+
+PhotonsColumnFile::PhotonsColumnFile(const QString& path, const std::vector<Column>& columns, quint32 blockSize, quint32 flags):
+    m_path(path),
+    m_columns(columns),
+    m_blockSize(std::max<quint32>(1, blockSize)),
+    m_flags(flags),
+    m_file(0),
+    m_rows(0),
+    m_blocks(0),
+    m_photons(0),
+    m_threads(std::max(2u, std::thread::hardware_concurrency())),
+    m_dataEnd(0)
+{
+    quint64 size = HeaderSize + ColumnSize*m_columns.size();
+    m_dataOffset = (size + 63)/64*64;
+
+    for (const Column& c : m_columns)
+        m_block.push_back(std::vector<char>(size_t(m_blockSize)*typeSize(c.type)));
+}
+
+PhotonsColumnFile::~PhotonsColumnFile()
+{
+    close();
+}
+
+int PhotonsColumnFile::typeSize(Type type)
+{
+    switch (type) {
+    case UInt8: return 1;
+    case UInt32: return 4;
+    case UInt64: return 8;
+    case Float64: return 8;
+    }
+    return 0;
+}
+
+/*!
+ * Creates the file and writes a provisional header.
+ */
+bool PhotonsColumnFile::open()
+{
+    close();
+    m_file = new QFile(m_path);
+    if (!m_file->open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return fail("Could not open photon output file");
+
+    m_rows = 0;
+    m_blocks = 0;
+    m_photons = 0;
+    m_index.clear();
+    m_dataEnd = m_dataOffset;
+    if (!writeHeader(0, 0, 0.)) return false;
+    if (!m_file->seek(m_dataOffset))
+        return fail("Could not seek photon output file");
+    return true;
+}
+
+/*!
+ * Reopens a finished file to append more photons.
+ * The staged rows of the last block are still in memory.
+ */
+bool PhotonsColumnFile::resume()
+{
+    if (!m_file) {
+        m_file = new QFile(m_path);
+        if (!m_file->open(QIODevice::ReadWrite))
+            return fail("Could not reopen photon output file");
+    }
+
+    if (!writePending(0)) return false;
+    if (!m_file->resize(m_dataEnd) || !m_file->seek(m_dataEnd))
+        return fail("Could not truncate photon output file");
+    return true;
+}
+
+bool PhotonsColumnFile::close()
+{
+    if (!m_file) return true;
+
+    bool ok = writePending(0);
+    if (m_file->isOpen() && !m_file->flush()) {
+        fail("Could not flush photon output file");
+        ok = false;
+    }
+    m_file->close();
+    if (m_file->error() != QFile::NoError) {
+        fail("Could not close photon output file");
+        ok = false;
+    }
+    delete m_file;
+    m_file = 0;
+    return ok;
+}
+
+bool PhotonsColumnFile::endRow()
+{
+    ++m_photons;
+    if (++m_rows < m_blockSize) return true;
+
+    if (!writeBlock()) return false;
+    ++m_blocks;
+    m_rows = 0;
+    return true;
+}
+
+bool PhotonsColumnFile::writeBlock()
+{
+    if (!m_file || !m_file->isOpen())
+        return fail("Photon output file is not open");
+
+    if (isCompressed()) {
+        // one block per worker in flight, written in order
+        std::vector<int> sizes;
+        for (const Column& c : m_columns)
+            sizes.push_back(typeSize(c.type));
+        m_pending.push_back(std::async(std::launch::async, &PhotonsColumnFile::compress, m_block, sizes, m_rows));
+        return writePending(m_threads);
+    }
+
+    for (size_t c = 0; c < m_columns.size(); ++c)
+    {
+        std::vector<char>& data = m_block[c];
+        int size = typeSize(m_columns[c].type);
+        // the last block is padded with zeros
+        std::fill(data.begin() + size_t(m_rows)*size, data.end(), 0);
+        toLittleEndian(data, size);
+        qint64 written = m_file->write(data.data(), qint64(data.size()));
+        toLittleEndian(data, size);
+        if (written != qint64(data.size()))
+            return fail("Could not write photon output file");
+    }
+    if (m_rows == m_blockSize)
+        m_dataEnd = m_file->pos();
+    return true;
+}
+
+/*!
+ * Returns the deflated columns of the first \a rows rows of \a block.
+ * The bytes of each column are shuffled first, all first bytes of the
+ * elements, then all second bytes, and so on, which groups the slowly
+ * varying sign and exponent bytes of coordinates.
+ */
+std::vector<QByteArray> PhotonsColumnFile::compress(std::vector<std::vector<char>> block, std::vector<int> sizes, quint32 rows)
+{
+    std::vector<QByteArray> chunks;
+    QByteArray shuffled;
+    for (size_t c = 0; c < block.size(); ++c)
+    {
+        std::vector<char>& data = block[c];
+        int size = sizes[c];
+        toLittleEndian(data, size);
+
+        shuffled.resize(int(rows)*size);
+        char* out = shuffled.data();
+        for (int b = 0; b < size; ++b)
+            for (quint32 n = 0; n < rows; ++n)
+                *out++ = data[size_t(n)*size + b];
+
+        // without the 4-byte length prefix of qCompress, a plain zlib stream
+        chunks.push_back(qCompress(shuffled, 6).mid(4));
+    }
+    return chunks;
+}
+
+bool PhotonsColumnFile::writeCompressed(const std::vector<QByteArray>& chunks)
+{
+    BlockEntry entry;
+    entry.offset = m_file->pos();
+    for (const QByteArray& chunk : chunks) {
+        if (m_file->write(chunk) != chunk.size())
+            return fail("Could not write photon output file");
+        entry.sizes.push_back(quint32(chunk.size()));
+    }
+    m_index.push_back(entry);
+    return true;
+}
+
+// writes compressed blocks until at most keep are pending
+bool PhotonsColumnFile::writePending(size_t keep)
+{
+    bool ok = true;
+    while (m_pending.size() > keep) {
+        std::vector<QByteArray> chunks = m_pending.front().get();
+        m_pending.pop_front();
+        if (ok && !writeCompressed(chunks))
+            ok = false;
+        if (ok) m_dataEnd = m_file->pos();
+    }
+    return ok;
+}
+
+/*!
+ * Writes the partial last block, the surface table and, if compressed,
+ * the block index, then patches the header.
+ * The file is closed; \a surfaces lists the URLs of surface IDs 1, 2, ...
+ */
+bool PhotonsColumnFile::finish(const QStringList& surfaces, double photonPower)
+{
+    if (!m_file && !resume()) return false;
+    if (!writePending(0)) return false;
+
+    quint64 blocks = m_blocks;
+    size_t indexSize = m_index.size();
+    if (m_rows > 0) {
+        if (isCompressed()) {
+            std::vector<int> sizes;
+            for (const Column& c : m_columns)
+                sizes.push_back(typeSize(c.type));
+            if (!writeCompressed(compress(m_block, sizes, m_rows))) return false;
+        } else if (!writeBlock())
+            return false;
+        ++blocks;
+    }
+
+    QByteArray table;
+    QDataStream out(&table, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << quint32(surfaces.size());
+    for (int n = 0; n < surfaces.size(); ++n) {
+        QByteArray url = surfaces[n].toUtf8();
+        out << quint32(n + 1) << quint32(url.size());
+        out.writeRawData(url.constData(), url.size());
+    }
+
+    quint64 surfacesOffset = m_file->pos();
+    if (m_file->write(table) != table.size())
+        return fail("Could not write photon surface table");
+
+    quint64 indexOffset = 0;
+    if (isCompressed()) {
+        QByteArray index;
+        QDataStream outIndex(&index, QIODevice::WriteOnly);
+        outIndex.setByteOrder(QDataStream::LittleEndian);
+        for (const BlockEntry& entry : m_index) {
+            outIndex << entry.offset;
+            for (quint32 size : entry.sizes)
+                outIndex << size;
+        }
+        indexOffset = m_file->pos();
+        if (m_file->write(index) != index.size())
+            return fail("Could not write photon block index");
+    }
+    m_index.resize(indexSize); // the partial block is rewritten on resume
+
+    quint64 blocksKept = m_blocks;
+    m_blocks = blocks;
+    bool ok = writeHeader(surfacesOffset, indexOffset, photonPower);
+    m_blocks = blocksKept;
+    return ok && close();
+}
+
+bool PhotonsColumnFile::writeHeader(quint64 surfacesOffset, quint64 indexOffset, double photonPower)
+{
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    out.writeRawData(Magic, sizeof(Magic));
+    out << Version << m_flags << m_blockSize << quint32(m_columns.size());
+    out << m_dataOffset << m_photons << m_blocks << surfacesOffset << photonPower;
+    out << indexOffset;
+
+    for (const Column& c : m_columns) {
+        char name[16] = {};
+        QByteArray bytes = c.name.toUtf8().left(15);
+        std::memcpy(name, bytes.constData(), bytes.size());
+        out.writeRawData(name, sizeof(name));
+        out << quint32(c.type) << quint32(typeSize(c.type));
+    }
+
+    header.append(QByteArray(int(m_dataOffset) - header.size(), '\0'));
+
+    qint64 pos = m_file->pos();
+    if (!m_file->seek(0) || m_file->write(header) != header.size())
+        return fail("Could not write photon file header");
+    if (pos > 0 && !m_file->seek(pos))
+        return fail("Could not seek photon output file");
+    return true;
+}
+
+bool PhotonsColumnFile::fail(const QString& message)
+{
+    m_error = QString("%1 %2: %3").arg(message, m_path, m_file ? m_file->errorString() : QString());
+    return false;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include <future>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+class QFile;
+
+
+//! PhotonsColumnFile writes one columnar photon file (.tnpc).
+/*!
+ * Photons are grouped into blocks of a fixed number of rows. Within a block
+ * each column is a contiguous little-endian array, so the offset of any
+ * column of any block follows from the header alone and readers can map
+ * just the columns they need. The header carries the column schema, the
+ * photon count and power, and the offset of the surface table that follows
+ * the last block. See docs/photon-column-format.md.
+ *
+ * With the Compressed flag every column of a block is byte-shuffled and
+ * deflated separately, on worker threads, and a block index after the
+ * surface table gives the position and size of each column chunk.
+ *
+ * The header is patched by finish(); a finished file can be resumed, which
+ * drops the last partial block and the tables before appending.
+ */
+class PhotonsColumnFile
+{
+public:
+    enum Type {
+        UInt8 = 1,
+        UInt32 = 2,
+        UInt64 = 3,
+        Float64 = 4
+    };
+
+    struct Column
+    {
+        QString name; // at most 15 bytes
+        Type type;
+    };
+
+    enum Flags {
+        CoordinatesGlobal = 1,
+        Compressed = 2
+    };
+
+    static const int HeaderSize = 72;
+    static const int ColumnSize = 24;
+
+    PhotonsColumnFile(const QString& path, const std::vector<Column>& columns, quint32 blockSize, quint32 flags);
+    ~PhotonsColumnFile();
+
+    const QString& getPath() const {return m_path;}
+    quint64 getPhotonCount() const {return m_photons;}
+    QString getError() const {return m_error;}
+    bool isOpen() const {return m_file != 0;}
+
+    bool open();
+    bool resume();
+    bool close();
+
+    template<class T>
+    void set(int column, const T& value)
+    {
+        std::memcpy(m_block[column].data() + m_rows*sizeof(T), &value, sizeof(T));
+    }
+    bool endRow();
+
+    bool finish(const QStringList& surfaces, double photonPower);
+
+private:
+    static int typeSize(Type type);
+    static std::vector<QByteArray> compress(std::vector<std::vector<char>> block, std::vector<int> sizes, quint32 rows);
+
+    bool isCompressed() const {return m_flags & Compressed;}
+    bool writeBlock();
+    bool writeCompressed(const std::vector<QByteArray>& chunks);
+    bool writePending(size_t keep);
+    bool writeHeader(quint64 surfacesOffset, quint64 indexOffset, double photonPower);
+    bool fail(const QString& message);
+
+    QString m_path;
+    std::vector<Column> m_columns;
+    quint32 m_blockSize;
+    quint32 m_flags;
+    quint64 m_dataOffset;
+
+    QFile* m_file;
+    std::vector<std::vector<char>> m_block; // staged rows per column
+    quint32 m_rows;      // rows in m_block
+    quint64 m_blocks;    // complete blocks on disk
+    quint64 m_photons;
+    QString m_error;
+
+    // compressed blocks
+    struct BlockEntry
+    {
+        quint64 offset;
+        std::vector<quint32> sizes; // per column
+    };
+    std::vector<BlockEntry> m_index;
+    std::deque<std::future<std::vector<QByteArray>>> m_pending;
+    size_t m_threads;
+    quint64 m_dataEnd; // after the last complete block
+};
@@ -10,9 +10,17 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
-#include <QMessageBox>
 
 #include "kernel/run/InstanceNode.h"
+#include "libraries/auxiliary/S3Upload.h"
+#include "PhotonsColumnFile.h"
+
+namespace {
+
+// rows per block of the columnar format
+const quint32 ColumnBlockSize = 65536;
+
+}
 
 
 PhotonsFile::PhotonsFile():
@@ -25,7 +33,9 @@ PhotonsFile::PhotonsFile():
     m_nPhotonsPerFile(-1),
     m_fileCurrent(1),
     m_exportedPhotons(0),
-    m_photonPower(0.)
+    m_photonPower(0.),
+    m_columns(false),
+    m_compressed(false)
 {
 
 }
@@ -33,6 +43,7 @@ PhotonsFile::PhotonsFile():
 PhotonsFile::~PhotonsFile()
 {
     closeCurrentFile();
+    m_columnFiles.clear();
 }
 
 void PhotonsFile::setParameter(QString name, QString value)
@@ -48,6 +59,11 @@ void PhotonsFile::setParameter(QString name, QString value)
         m_oneFile = value.toDouble() < 0;
         m_nPhotonsPerFile = value.toULong();
     }
+    else if (name == parameters[3])
+    {
+        m_columns = value == "Columns" || value == "CompressedColumns";
+        m_compressed = value == "CompressedColumns";
+    }
 }
 
 bool PhotonsFile::startExport()
@@ -55,6 +71,11 @@ bool PhotonsFile::startExport()
     if (m_exportedPhotons > 0) {
         if (m_exportFailed)
             return false;
+        if (isRemote()) {
+            showWarning(QString("Photons uploaded to %1 cannot be continued, the objects are complete.\nExport to another location.").arg(m_dirName));
+            m_exportFailed = true;
+            return false;
+        }
         if (!prepareDirectory()) {
             m_exportFailed = true;
             return false;
@@ -67,19 +88,24 @@ bool PhotonsFile::startExport()
     m_fileCurrent = 1;
     m_surfaces.clear();
     m_surfaceWorldToObject.clear();
+    m_surfaceIDs.clear();
+    m_columnFiles.clear();
 
     if (!prepareDirectory()) {
         m_exportFailed = true;
         return false;
     }
+    // objects are replaced when their upload completes
+    if (isRemote())
+        return true;
 
     QDir dir(m_dirName);
     QFileInfoList infoList;
     if (m_oneFile) {
-        QString fileName = dir.absoluteFilePath(m_fileName + ".dat");
+        QString fileName = dir.absoluteFilePath(m_fileName + fileExtension());
         infoList << QFileInfo(fileName);
     } else {
-        QStringList filters(m_fileName + "_*.dat");
+        QStringList filters(m_fileName + "_*" + fileExtension());
         infoList = dir.entryInfoList(filters, QDir::Files);
     }
 
@@ -88,8 +114,7 @@ bool PhotonsFile::startExport()
         if (file.exists() && !file.remove()) {
             QString message = QString("Error deleting %1.\nThe file is in use or the directory is not writable. Please close it before continuing.")
                 .arg(fileInfo.absoluteFilePath());
-            qWarning() << message;
-            QMessageBox::warning(0, "Tonatiuh", message);
+            showWarning(message);
             m_exportFailed = true;
             return false;
         }
@@ -100,11 +125,23 @@ bool PhotonsFile::startExport()
 
 bool PhotonsFile::prepareDirectory()
 {
+    if (isRemote()) {
+        if (m_columns) {
+            showWarning(QString("Columnar photon files cannot be uploaded to %1.\nExport binary records instead.").arg(m_dirName));
+            return false;
+        }
+        const S3Upload probe(outputPath(m_fileName));
+        if (!probe.getError().isEmpty()) {
+            showWarning(QString("Could not export photons to %1:\n%2").arg(m_dirName, probe.getError()));
+            return false;
+        }
+        return true;
+    }
+
     QDir dir(m_dirName);
     if (!dir.exists() && !dir.mkpath(".")) {
         QString message = QString("Could not create photon export directory:\n%1").arg(dir.absolutePath());
-        qWarning() << message;
-        QMessageBox::warning(0, "Tonatiuh", message);
+        showWarning(message);
         return false;
     }
 
@@ -113,15 +150,13 @@ bool PhotonsFile::prepareDirectory()
     QFile probe(probeName);
     if (!probe.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
         QString message = QString("Could not write to photon export directory:\n%1\n%2").arg(dir.absolutePath(), probe.errorString());
-        qWarning() << message;
-        QMessageBox::warning(0, "Tonatiuh", message);
+        showWarning(message);
         return false;
     }
 
     if (probe.write("1", 1) != 1 || !probe.flush()) {
         QString message = QString("Could not write to photon export directory:\n%1\n%2").arg(dir.absolutePath(), probe.errorString());
-        qWarning() << message;
-        QMessageBox::warning(0, "Tonatiuh", message);
+        showWarning(message);
         probe.close();
         QFile::remove(probeName);
         return false;
@@ -132,16 +167,36 @@ bool PhotonsFile::prepareDirectory()
     bool probeRemoved = QFile::remove(probeName);
     if (!probeClosed || !probeRemoved) {
         QString message = QString("Could not finalize photon export directory check:\n%1\n%2").arg(dir.absolutePath(), probe.errorString());
-        qWarning() << message;
-        QMessageBox::warning(0, "Tonatiuh", message);
+        showWarning(message);
         return false;
     }
 
     return true;
 }
 
+bool PhotonsFile::isRemote() const
+{
+    return S3Upload::isUrl(m_dirName);
+}
+
+QString PhotonsFile::outputPath(const QString& name) const
+{
+    return isRemote() ? S3Upload::join(m_dirName, name) : QDir(m_dirName).absoluteFilePath(name);
+}
+
 bool PhotonsFile::closeCurrentFile()
 {
+    if (m_upload) {
+        bool ok = m_upload->finish();
+        if (!ok) {
+            qWarning() << "Could not upload photon output" << m_filePath << m_upload->getError();
+            m_exportFailed = true;
+        }
+        m_upload.reset();
+        m_filePath.clear();
+        return ok;
+    }
+
     if (!m_file)
         return true;
 
@@ -170,12 +225,25 @@ bool PhotonsFile::closeCurrentFile()
 
 bool PhotonsFile::openOutputFile(QString fileName)
 {
-    if (m_file && m_file->isOpen() && m_filePath == fileName)
+    if (((m_file && m_file->isOpen()) || m_upload) && m_filePath == fileName)
         return true;
 
     if (!closeCurrentFile())
         return false;
 
+    if (isRemote()) {
+        m_upload.reset(new S3Upload(fileName));
+        m_filePath = fileName;
+        if (!m_upload->getError().isEmpty()) {
+            qWarning() << "Could not upload photon output" << fileName << m_upload->getError();
+            m_upload.reset();
+            m_filePath.clear();
+            m_exportFailed = true;
+            return false;
+        }
+        return true;
+    }
+
     m_file = new QFile(fileName);
     m_filePath = fileName;
     if (!m_file->open(QIODevice::WriteOnly | QIODevice::Append)) {
@@ -198,10 +266,12 @@ ulong PhotonsFile::savePhotons(const std::vector<Photon>& photons)
     if (photons.empty())
         return 0;
 
-    QDir dir(m_dirName);
+    if (m_columns)
+        return saveColumns(photons);
+
     if (m_oneFile || m_nPhotonsPerFile == 0)
 	{
-        QString fileName = dir.absoluteFilePath(m_fileName + ".dat");
+        QString fileName = outputPath(m_fileName + ".dat");
         if (!openOutputFile(fileName))
             return 0;
         return writePhotons(photons, 0, photons.size());
@@ -216,7 +286,7 @@ ulong PhotonsFile::savePhotons(const std::vector<Photon>& photons)
             ulong nFile = m_exportedPhotons % m_nPhotonsPerFile;
             ulong nEnd = rangeBegin + std::min<ulong>(m_nPhotonsPerFile - nFile, photons.size() - rangeBegin);
             QString fileName = QString("%1_%2.dat").arg(m_fileName, QString::number(m_fileCurrent));
-            fileName = dir.absoluteFilePath(fileName);
+            fileName = outputPath(fileName);
             if (!openOutputFile(fileName))
                 return writtenTotal;
             ulong written = writePhotons(photons, rangeBegin, nEnd);
@@ -233,6 +303,9 @@ ulong PhotonsFile::savePhotons(const std::vector<Photon>& photons)
 
 bool PhotonsFile::endExport()
 {
+    if (m_columns)
+        return endColumns();
+
     bool dataFileClosed = closeCurrentFile();
     if (m_exportFailed)
         return false;
@@ -240,14 +313,9 @@ bool PhotonsFile::endExport()
     if (!dataFileClosed)
         return false;
 
-    QDir dir(m_dirName);
-    QString fileName = dir.absoluteFilePath(m_fileName + "_parameters.txt");
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        qWarning() << "Could not open photon parameters file" << fileName << file.errorString();
-        return false;
-    }
-    QTextStream out(&file);
+    QString fileName = outputPath(m_fileName + "_parameters.txt");
+    QByteArray parameters;
+    QTextStream out(&parameters, QIODevice::WriteOnly);
 
     out << "START PARAMETERS\n";
     out << "id\n";
@@ -274,12 +342,27 @@ bool PhotonsFile::endExport()
 
     out << m_photonPower;
 
+    out.flush();
     if (out.status() != QTextStream::Ok) {
         qWarning() << "Error writing photon parameters file" << fileName;
         return false;
     }
 
-    if (!file.flush()) {
+    if (isRemote()) {
+        QString error;
+        if (!S3Upload::put(fileName, parameters, &error)) {
+            qWarning() << "Could not upload photon parameters file" << fileName << error;
+            return false;
+        }
+        return true;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "Could not open photon parameters file" << fileName << file.errorString();
+        return false;
+    }
+    if (file.write(parameters) != parameters.size() || !file.flush()) {
         qWarning() << "Could not flush photon parameters file" << fileName << file.errorString();
         return false;
     }
@@ -298,7 +381,7 @@ ulong PhotonsFile::writePhotons(const std::vector<Photon>& photons, ulong nBegin
     if (nBegin >= nEnd)
         return 0;
 
-    if (!m_file || !m_file->isOpen()) {
+    if (!m_upload && (!m_file || !m_file->isOpen())) {
         qWarning() << "Photon output file is not open";
         m_exportFailed = true;
         return 0;
@@ -312,21 +395,13 @@ ulong PhotonsFile::writePhotons(const std::vector<Photon>& photons, ulong nBegin
     ulong written = 0;
     ulong exportedPhotons = m_exportedPhotons;
     double previousPhotonID = 0;
-    QVector<InstanceNode*> surfaces = m_surfaces;
-    QVector<Transform> surfaceWorldToObject = m_surfaceWorldToObject;
+    // surfaces first seen in a block that fails to write are dropped again
+    const int surfacesKept = m_surfaces.size();
 
     for (ulong n = nBegin; n < nEnd; ++n)
     {
         const Photon& photon = photons[n];
-        ulong urlId = 0;
-        if (photon.surface) {
-            urlId = surfaces.indexOf(photon.surface) + 1;
-            if (urlId == 0) {
-                surfaces << photon.surface;
-                surfaceWorldToObject << photon.surface->getTransform().inversed();
-                urlId = surfaces.size();
-            }
-        }
+        const quint32 urlId = surfaceID(photon.surface);
 
         // id
         double photonID = double(exportedPhotons + written + 1);
@@ -335,7 +410,7 @@ ulong PhotonsFile::writePhotons(const std::vector<Photon>& photons, ulong nBegin
         if (m_saveCoordinates) {
             vec3d pos = photon.pos;
             if (!m_saveCoordinatesGlobal && urlId > 0)
-                pos = surfaceWorldToObject[urlId - 1].transformPoint(pos);
+                pos = m_surfaceWorldToObject[urlId - 1].transformPoint(pos);
             out << pos.x << pos.y << pos.z;
         }
 
@@ -358,6 +433,7 @@ ulong PhotonsFile::writePhotons(const std::vector<Photon>& photons, ulong nBegin
 
         if (out.status() != QDataStream::Ok) {
             qWarning() << "Error serializing photon output for" << m_filePath;
+            dropSurfacesAfter(surfacesKept);
             m_exportFailed = true;
             return 0;
         }
@@ -365,6 +441,17 @@ ulong PhotonsFile::writePhotons(const std::vector<Photon>& photons, ulong nBegin
         ++written;
     }
 
+    if (m_upload) {
+        if (!m_upload->write(bytes)) {
+            qWarning() << "Could not upload photon output" << m_filePath << m_upload->getError();
+            dropSurfacesAfter(surfacesKept);
+            m_exportFailed = true;
+            return 0;
+        }
+        m_exportedPhotons += written;
+        return written;
+    }
+
     qint64 fileStart = m_file->pos();
     qint64 bytesWritten = m_file->write(bytes);
     if (bytesWritten != bytes.size()) {
@@ -373,6 +460,7 @@ ulong PhotonsFile::writePhotons(const std::vector<Photon>& photons, ulong nBegin
             if (!m_file->resize(fileStart) || !m_file->seek(fileStart))
                 qWarning() << "Could not restore photon output file after a failed write" << m_filePath << m_file->errorString();
         }
+        dropSurfacesAfter(surfacesKept);
         m_exportFailed = true;
         return 0;
     }
@@ -383,12 +471,176 @@ ulong PhotonsFile::writePhotons(const std::vector<Photon>& photons, ulong nBegin
             if (!m_file->resize(fileStart) || !m_file->seek(fileStart))
                 qWarning() << "Could not restore photon output file after a failed flush" << m_filePath << m_file->errorString();
         }
+        dropSurfacesAfter(surfacesKept);
         m_exportFailed = true;
         return 0;
     }
 
-    m_surfaces = surfaces;
-    m_surfaceWorldToObject = surfaceWorldToObject;
     m_exportedPhotons += written;
     return written;
 }
+
+/*!
+ * Returns the ID of \a surface, adding it with its inverse transform
+ * to the surface table on first use.
+ */
+quint32 PhotonsFile::surfaceID(InstanceNode* surface)
+{
+    if (!surface) return 0;
+
+    auto it = m_surfaceIDs.constFind(surface);
+    if (it != m_surfaceIDs.constEnd())
+        return it.value();
+
+    m_surfaces << surface;
+    m_surfaceWorldToObject << surface->getTransform().inversed();
+    quint32 id = quint32(m_surfaces.size());
+    m_surfaceIDs.insert(surface, id);
+    return id;
+}
+
+void PhotonsFile::dropSurfacesAfter(int count)
+{
+    for (int n = count; n < m_surfaces.size(); ++n)
+        m_surfaceIDs.remove(m_surfaces[n]);
+    m_surfaces.resize(count);
+    m_surfaceWorldToObject.resize(count);
+}
+
+ulong PhotonsFile::saveColumns(const std::vector<Photon>& photons)
+{
+    std::vector<PhotonsColumnFile::Column> columns;
+    columns.push_back({"id", PhotonsColumnFile::UInt64});
+    if (m_saveCoordinates) {
+        columns.push_back({"x", PhotonsColumnFile::Float64});
+        columns.push_back({"y", PhotonsColumnFile::Float64});
+        columns.push_back({"z", PhotonsColumnFile::Float64});
+    }
+    if (m_saveSurfaceSide)
+        columns.push_back({"side", PhotonsColumnFile::UInt8});
+    if (m_savePhotonsID) {
+        columns.push_back({"previous_id", PhotonsColumnFile::UInt64});
+        columns.push_back({"next_id", PhotonsColumnFile::UInt64});
+    }
+    if (m_saveSurfaceID)
+        columns.push_back({"surface_id", PhotonsColumnFile::UInt32});
+    quint32 flags = m_saveCoordinatesGlobal ? PhotonsColumnFile::CoordinatesGlobal : 0;
+    if (m_compressed)
+        flags |= PhotonsColumnFile::Compressed;
+
+    bool split = !m_oneFile && m_nPhotonsPerFile > 0;
+    QDir dir(m_dirName);
+    ulong writtenTotal = 0;
+    while (writtenTotal < photons.size())
+    {
+        ulong nEnd = photons.size();
+        m_fileCurrent = 1;
+        if (split) {
+            m_fileCurrent = int(m_exportedPhotons/m_nPhotonsPerFile) + 1;
+            ulong nFile = m_exportedPhotons % m_nPhotonsPerFile;
+            nEnd = writtenTotal + std::min<ulong>(m_nPhotonsPerFile - nFile, photons.size() - writtenTotal);
+        }
+
+        PhotonsColumnFile* file = nullptr;
+        if (int(m_columnFiles.size()) >= m_fileCurrent) {
+            file = m_columnFiles[m_fileCurrent - 1].get();
+            if (!file->isOpen() && !file->resume()) {
+                qWarning() << file->getError();
+                m_exportFailed = true;
+                return writtenTotal;
+            }
+        } else {
+            QString fileName = split ? QString("%1_%2").arg(m_fileName, QString::number(m_fileCurrent)) : m_fileName;
+            fileName = dir.absoluteFilePath(fileName + fileExtension());
+            m_columnFiles.emplace_back(new PhotonsColumnFile(fileName, columns, ColumnBlockSize, flags));
+            file = m_columnFiles.back().get();
+            if (!file->open()) {
+                qWarning() << file->getError();
+                m_exportFailed = true;
+                return writtenTotal;
+            }
+        }
+
+        ulong count = nEnd - writtenTotal;
+        ulong written = writeColumns(file, photons, writtenTotal, nEnd);
+        writtenTotal += written;
+        if (written < count)
+            return writtenTotal;
+
+        // keep finished files closed, endColumns completes them
+        if (split && m_exportedPhotons % m_nPhotonsPerFile == 0 && !file->close()) {
+            qWarning() << file->getError();
+            m_exportFailed = true;
+            return writtenTotal;
+        }
+    }
+    return writtenTotal;
+}
+
+ulong PhotonsFile::writeColumns(PhotonsColumnFile* file, const std::vector<Photon>& photons, ulong nBegin, ulong nEnd)
+{
+    ulong nMax = photons.size();
+    quint64 previousPhotonID = 0;
+    for (ulong n = nBegin; n < nEnd; ++n)
+    {
+        const Photon& photon = photons[n];
+        const quint32 urlId = surfaceID(photon.surface);
+
+        int c = 0;
+        quint64 photonID = m_exportedPhotons + 1;
+        file->set(c++, photonID);
+
+        if (m_saveCoordinates) {
+            vec3d pos = photon.pos;
+            if (!m_saveCoordinatesGlobal && urlId > 0)
+                pos = m_surfaceWorldToObject[urlId - 1].transformPoint(pos);
+            file->set(c++, pos.x);
+            file->set(c++, pos.y);
+            file->set(c++, pos.z);
+        }
+
+        if (m_saveSurfaceSide)
+            file->set(c++, quint8(photon.isFront));
+
+        if (m_savePhotonsID) {
+            if (photon.id < 1) previousPhotonID = 0;
+            file->set(c++, previousPhotonID);
+            previousPhotonID = photonID;
+            quint64 nextPhotonID = n + 1 < nMax && photons[n + 1].id > 0 ? photonID + 1 : 0;
+            file->set(c++, nextPhotonID);
+        }
+
+        if (m_saveSurfaceID)
+            file->set(c++, urlId);
+
+        if (!file->endRow()) {
+            qWarning() << file->getError();
+            m_exportFailed = true;
+            // rows of the failed block are lost
+            return 0;
+        }
+        ++m_exportedPhotons;
+    }
+    return nEnd - nBegin;
+}
+
+bool PhotonsFile::endColumns()
+{
+    if (m_exportFailed)
+        return false;
+
+    QStringList urls;
+    for (InstanceNode* surface : m_surfaces)
+        urls << surface->getURL();
+
+    bool ok = true;
+    for (auto& file : m_columnFiles) {
+        if (!file->finish(urls, m_photonPower)) {
+            qWarning() << file->getError();
+            ok = false;
+        }
+    }
+    if (!ok)
+        m_exportFailed = true;
+    return ok;
+}
@@ -1,13 +1,28 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include <QHash>
 #include <QMap>
 #include <QString>
 
 #include "kernel/photons/PhotonsAbstract.h"
 
+class PhotonsColumnFile;
+class S3Upload;
+
 class QFile;
 class Photon;
 
+//! PhotonsFile exports photons to binary record files or columnar .tnpc files.
+/*!
+ * An ExportDirectory of the form s3://bucket/prefix streams the record
+ * files and the parameters file to object storage instead, see S3Upload.
+ * Uploaded objects are complete once written, so such an export cannot be
+ * continued, and the columnar format, which rewrites its files, is not
+ * uploaded.
+ */
 class PhotonsFile: public PhotonsAbstract
 {
 
@@ -15,7 +30,7 @@ public:
     PhotonsFile();
     ~PhotonsFile();
 
-    static QStringList getParameterNames() {return {"ExportDirectory", "ExportFile", "FileSize"};}
+    static QStringList getParameterNames() {return {"ExportDirectory", "ExportFile", "FileSize", "FileFormat"};}
     void setParameter(QString name, QString value);
 
     bool startExport();
@@ -28,13 +43,26 @@ public:
 
 private:
     bool prepareDirectory();
+    bool isRemote() const;
+    QString outputPath(const QString& name) const;
     bool closeCurrentFile();
     bool openOutputFile(QString fileName);
     ulong writePhotons(const std::vector<Photon>& photon, ulong nBegin, ulong nEnd);
 
+    // surface ID from 1 in order of first use, 0 for air
+    quint32 surfaceID(InstanceNode* surface);
+    void dropSurfacesAfter(int count);
+
+    // columnar format, see PhotonsColumnFile
+    QString fileExtension() const {return m_columns ? ".tnpc" : ".dat";}
+    ulong saveColumns(const std::vector<Photon>& photons);
+    ulong writeColumns(PhotonsColumnFile* file, const std::vector<Photon>& photons, ulong nBegin, ulong nEnd);
+    bool endColumns();
+
     QString m_dirName;
     QString m_fileName;
     QFile* m_file;
+    std::unique_ptr<S3Upload> m_upload; // in place of m_file for s3:// exports
     QString m_filePath;
     bool m_exportFailed;
     bool m_oneFile;
@@ -43,8 +71,13 @@ private:
     int m_fileCurrent;
     ulong m_exportedPhotons;
     double m_photonPower;
-    QVector<InstanceNode*> m_surfaces; //? map
-	QVector<Transform> m_surfaceWorldToObject;
+    QVector<InstanceNode*> m_surfaces; // surface ID - 1
+    QVector<Transform> m_surfaceWorldToObject;
+    QHash<InstanceNode*, quint32> m_surfaceIDs;
+
+    bool m_columns;
+    bool m_compressed;
+    std::vector<std::unique_ptr<PhotonsColumnFile>> m_columnFiles;
 };
 
 
@@ -41,6 +41,11 @@ QString PhotonsFileWidget::getParameterValue(QString name) const
         else
             return QString::number(ui->photonsSpin->value());
 	}
+    else if (name == names[3])
+    {
+        QStringList formats = {"Rows", "Columns", "CompressedColumns"};
+        return formats.value(ui->formatCombo->currentIndex(), formats[0]);
+    }
 	return QString();
 }
 
@@ -0,0 +1,221 @@
+#include "PhotonsHDF5.h"
+
+#include <QDebug>
+#include <QDir>
+
+#include "kernel/run/InstanceNode.h"
+
+
+PhotonsHDF5::PhotonsHDF5():
+    PhotonsAbstract(),
+    m_dirName(""),
+    m_fileName("photons"),
+    m_append(false),
+    m_exportFailed(false),
+    m_firstID(1),
+    m_exportedPhotons(0),
+    m_exportFirstID(1),
+    m_photonPower(0.)
+{
+
+}
+
+PhotonsHDF5::~PhotonsHDF5()
+{
+    m_file.close();
+}
+
+void PhotonsHDF5::setParameter(QString name, QString value)
+{
+    QStringList parameters = getParameterNames();
+
+    if (name == parameters[0])
+        m_dirName = value;
+    else if (name == parameters[1])
+        m_fileName = value;
+    else if (name == parameters[2])
+        m_append = value == "Append";
+}
+
+QString PhotonsHDF5::filePath() const
+{
+    return QDir(m_dirName).absoluteFilePath(m_fileName + ".h5");
+}
+
+bool PhotonsHDF5::startExport()
+{
+    if (m_exportedPhotons > 0) {
+        if (m_exportFailed)
+            return false;
+        m_exportFirstID = m_firstID + m_exportedPhotons;
+        return m_file.isOpen() || openFile(false);
+    }
+
+    m_file.close();
+    m_exportFailed = false;
+    m_surfaceIDs.clear();
+    m_urlIDs.clear();
+
+    QDir dir(m_dirName);
+    if (!dir.exists() && !dir.mkpath(".")) {
+        QString message = QString("Could not create photon export directory:\n%1").arg(dir.absolutePath());
+        showWarning(message);
+        m_exportFailed = true;
+        return false;
+    }
+
+    if (!openFile(!m_append)) {
+        QString message = QString("%1.\nThe file is in use or the directory is not writable. Please close it before continuing.")
+            .arg(m_file.getError());
+        showWarning(message);
+        return false;
+    }
+
+    // continue after the photons and surfaces of earlier runs
+    m_firstID = m_file.getRows("photons/id") + 1;
+    m_exportFirstID = m_firstID;
+    QStringList urls = m_file.readStrings("surfaces");
+    for (int n = 0; n < urls.size(); ++n)
+        m_urlIDs[urls[n]] = n + 1;
+    return true;
+}
+
+bool PhotonsHDF5::openFile(bool truncate)
+{
+    if (!m_file.open(filePath(), truncate))
+        return fail(m_file.getError());
+    return true;
+}
+
+bool PhotonsHDF5::fail(const QString& message)
+{
+    qWarning() << message;
+    m_exportFailed = true;
+    return false;
+}
+
+// assigns IDs to surfaces not seen before and stores their URLs
+bool PhotonsHDF5::addSurfaces(const std::vector<Photon>& photons)
+{
+    QStringList urls;
+    for (const Photon& photon : photons)
+    {
+        if (!photon.surface || m_surfaceIDs.contains(photon.surface)) continue;
+
+        QString url = photon.surface->getURL();
+        quint32 id = m_urlIDs.value(url, 0);
+        if (id == 0) {
+            id = m_urlIDs.size() + 1;
+            m_urlIDs[url] = id;
+            urls << url;
+        }
+        m_surfaceIDs[photon.surface] = {id, photon.surface->getTransform().inversed()};
+    }
+
+    if (!urls.isEmpty() && !m_file.append("surfaces", urls))
+        return fail(m_file.getError());
+    return true;
+}
+
+ulong PhotonsHDF5::savePhotons(const std::vector<Photon>& photons)
+{
+    if (m_exportFailed || photons.empty())
+        return 0;
+    if (!m_file.isOpen() && !openFile(false))
+        return 0;
+    if (!addSurfaces(photons))
+        return 0;
+
+    const size_t nMax = photons.size();
+    std::vector<quint64> ids, previousIDs, nextIDs;
+    std::vector<double> xs, ys, zs;
+    std::vector<quint8> sides;
+    std::vector<quint32> surfaceIDs;
+    ids.reserve(nMax);
+    if (m_saveCoordinates) {
+        xs.reserve(nMax);
+        ys.reserve(nMax);
+        zs.reserve(nMax);
+    }
+    if (m_saveSurfaceSide)
+        sides.reserve(nMax);
+    if (m_savePhotonsID) {
+        previousIDs.reserve(nMax);
+        nextIDs.reserve(nMax);
+    }
+    if (m_saveSurfaceID)
+        surfaceIDs.reserve(nMax);
+
+    quint64 previousPhotonID = 0;
+    for (size_t n = 0; n < nMax; ++n)
+    {
+        const Photon& photon = photons[n];
+        const Surface* surface = 0;
+        if (photon.surface) {
+            auto it = m_surfaceIDs.constFind(photon.surface);
+            surface = &it.value();
+        }
+
+        quint64 photonID = m_firstID + m_exportedPhotons + n;
+        ids.push_back(photonID);
+
+        if (m_saveCoordinates) {
+            vec3d pos = photon.pos;
+            if (!m_saveCoordinatesGlobal && surface)
+                pos = surface->worldToObject.transformPoint(pos);
+            xs.push_back(pos.x);
+            ys.push_back(pos.y);
+            zs.push_back(pos.z);
+        }
+
+        if (m_saveSurfaceSide)
+            sides.push_back(photon.isFront ? 1 : 0);
+
+        if (m_savePhotonsID) {
+            if (photon.id < 1) previousPhotonID = 0;
+            previousIDs.push_back(previousPhotonID);
+            previousPhotonID = photonID;
+            nextIDs.push_back(n + 1 < nMax && photons[n + 1].id > 0 ? photonID + 1 : 0);
+        }
+
+        if (m_saveSurfaceID)
+            surfaceIDs.push_back(surface ? surface->id : 0);
+    }
+
+    bool ok = m_file.append("photons/id", ids);
+    if (ok && m_saveCoordinates)
+        ok = m_file.append("photons/x", xs) && m_file.append("photons/y", ys) && m_file.append("photons/z", zs);
+    if (ok && m_saveSurfaceSide)
+        ok = m_file.append("photons/side", sides);
+    if (ok && m_savePhotonsID)
+        ok = m_file.append("photons/previous_id", previousIDs) && m_file.append("photons/next_id", nextIDs);
+    if (ok && m_saveSurfaceID)
+        ok = m_file.append("photons/surface_id", surfaceIDs);
+    if (!ok) {
+        fail(m_file.getError());
+        return 0;
+    }
+
+    m_exportedPhotons += nMax;
+    return nMax;
+}
+
+bool PhotonsHDF5::endExport()
+{
+    if (!m_file.isOpen())
+        return !m_exportFailed;
+
+    if (!m_exportFailed) {
+        quint64 photons = m_firstID + m_exportedPhotons - m_exportFirstID;
+        bool ok = m_file.append("runs/first_id", std::vector<quint64>{m_exportFirstID}) &&
+            m_file.append("runs/photons", std::vector<quint64>{photons}) &&
+            m_file.append("runs/photon_power", std::vector<double>{m_photonPower}) &&
+            m_file.setAttribute("photon_power", m_photonPower);
+        if (!ok)
+            fail(m_file.getError());
+    }
+
+    if (!m_file.close())
+        fail(m_file.getError());
+    return !m_exportFailed;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+
+#include "kernel/photons/PhotonsAbstract.h"
+#include "libraries/auxiliary/HDF5File.h"
+#include "libraries/math/3D/Transform.h"
+
+class InstanceNode;
+
+
+//! PhotonsHDF5 exports photons to an HDF5 file.
+/*!
+ * Every saved field is a chunked, extendable dataset in the photons group:
+ * id, x, y, z, side, previous_id, next_id and surface_id. The surfaces
+ * dataset holds the URL of surface ID n in row n - 1 (ID 0 is air).
+ *
+ * Each export appends a row to runs/first_id, runs/photons and
+ * runs/photon_power holding only the photons it wrote, so photons of
+ * several runs, or of a continued export, keep their own power. In Append
+ * mode photon IDs continue after the photons already in the file and
+ * known surfaces keep their IDs.
+ */
+class PhotonsHDF5: public PhotonsAbstract
+{
+
+public:
+    PhotonsHDF5();
+    ~PhotonsHDF5();
+
+    static QStringList getParameterNames() {return {"ExportDirectory", "ExportFile", "ExportMode"};}
+    void setParameter(QString name, QString value);
+
+    bool startExport();
+    ulong savePhotons(const std::vector<Photon>& photons);
+    void setPhotonPower(double p) {m_photonPower = p;}
+    bool endExport();
+    bool hasExportError() const {return m_exportFailed;}
+
+    NAME_ICON_FUNCTIONS("HDF5", ":/PhotonsHDF5.png")
+
+private:
+    QString filePath() const;
+    bool openFile(bool truncate);
+    bool fail(const QString& message);
+
+    struct Surface
+    {
+        quint32 id;
+        Transform worldToObject;
+    };
+    bool addSurfaces(const std::vector<Photon>& photons);
+
+    QString m_dirName;
+    QString m_fileName;
+    bool m_append;
+    bool m_exportFailed;
+    HDF5File m_file;
+    quint64 m_firstID;         // first photon ID of this run
+    ulong m_exportedPhotons;   // in this run
+    quint64 m_exportFirstID;   // first photon ID of this export
+    double m_photonPower;
+
+    QHash<InstanceNode*, Surface> m_surfaceIDs;
+    QHash<QString, quint32> m_urlIDs; // surfaces stored in the file
+};
+
+
+
+#include "PhotonsHDF5Widget.h"
+
+class PhotonsHDF5Factory:
+    public QObject,
+    public PhotonsFactoryT<PhotonsHDF5, PhotonsHDF5Widget>
+{
+    Q_OBJECT
+    Q_INTERFACES(PhotonsFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.PhotonsFactory")
+};
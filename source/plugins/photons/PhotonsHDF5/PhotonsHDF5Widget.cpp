@@ -0,0 +1,59 @@
+#include "PhotonsHDF5Widget.h"
+#include "ui_PhotonsHDF5Widget.h"
+
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QSettings>
+
+#include "PhotonsHDF5.h"
+
+
+PhotonsHDF5Widget::PhotonsHDF5Widget(QWidget* parent):
+    PhotonsWidget(parent),
+    ui(new Ui::PhotonsHDF5Widget)
+{
+    ui->setupUi(this);
+    connect(ui->directoryButton, SIGNAL(clicked()), this, SLOT(selectDirectory()));
+}
+
+PhotonsHDF5Widget::~PhotonsHDF5Widget()
+{
+    delete ui;
+}
+
+QStringList PhotonsHDF5Widget::getParameterNames() const
+{
+    return PhotonsHDF5::getParameterNames();
+}
+
+QString PhotonsHDF5Widget::getParameterValue(QString name) const
+{
+    QStringList names = getParameterNames();
+
+    if (name == names[0])
+        return ui->directoryEdit->text();
+    else if (name == names[1])
+        return ui->fileEdit->text();
+    else if (name == names[2])
+        return ui->modeCombo->currentText();
+    return QString();
+}
+
+void PhotonsHDF5Widget::selectDirectory()
+{
+    QSettings settings("Tonatiuh", "Cyprus");
+    QString dirName = settings.value("dirProjects", "").toString();
+
+    dirName = QFileDialog::getExistingDirectory(this, "Save Directory", dirName);
+    if (dirName.isEmpty()) return;
+
+    QDir dir(dirName);
+    if (!dir.exists())
+    {
+        QMessageBox::information(this, "Tonatiuh", "Selected directory is not valid");
+        return;
+    }
+
+    settings.setValue("dirProjects", dirName);
+    ui->directoryEdit->setText(dirName);
+}
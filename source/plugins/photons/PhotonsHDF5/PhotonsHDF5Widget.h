@@ -0,0 +1,27 @@
+#pragma once
+
+#include "kernel/photons/PhotonsWidget.h"
+
+
+namespace Ui {
+class PhotonsHDF5Widget;
+}
+
+class PhotonsHDF5Widget: public PhotonsWidget
+{
+    Q_OBJECT
+
+public:
+    PhotonsHDF5Widget(QWidget* parent = 0);
+    ~PhotonsHDF5Widget();
+
+    QStringList getParameterNames() const;
+    QString getParameterValue(QString name) const;
+    void setParameterValue(QString /*name*/, QString /*value*/) {}// add setters
+
+private slots:
+    void selectDirectory();
+
+private:
+    Ui::PhotonsHDF5Widget* ui;
+};
@@ -0,0 +1,325 @@
+// Arrow before Qt, whose keyword macros can clash with library headers
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/properties.h>
+
+#include "PhotonsParquet.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "kernel/run/InstanceNode.h"
+
+
+struct PhotonsParquet::Writer
+{
+    std::shared_ptr<arrow::Schema> schema;
+    std::shared_ptr<arrow::io::FileOutputStream> file;
+    std::unique_ptr<parquet::arrow::FileWriter> writer;
+    std::shared_ptr<arrow::Array> dictionary; // surface URLs
+    int dictionarySize = -1;
+};
+
+namespace {
+
+bool warn(const QString& message, const arrow::Status& status)
+{
+    qWarning() << message << QString::fromStdString(status.ToString());
+    return false;
+}
+
+parquet::Compression::type compressionType(const QString& name)
+{
+    if (name == "zstd") return parquet::Compression::ZSTD;
+    if (name == "gzip") return parquet::Compression::GZIP;
+    if (name == "none") return parquet::Compression::UNCOMPRESSED;
+    return parquet::Compression::SNAPPY;
+}
+
+}
+
+
+PhotonsParquet::PhotonsParquet():
+    PhotonsAbstract(),
+    m_dirName(""),
+    m_fileName("photons"),
+    m_compression("snappy"),
+    m_exportFailed(false),
+    m_part(1),
+    m_exportedPhotons(0),
+    m_partPhotons(0),
+    m_photonPower(0.)
+{
+
+}
+
+PhotonsParquet::~PhotonsParquet()
+{
+    closeWriter();
+}
+
+void PhotonsParquet::setParameter(QString name, QString value)
+{
+    QStringList parameters = getParameterNames();
+
+    if (name == parameters[0])
+        m_dirName = value;
+    else if (name == parameters[1])
+        m_fileName = value;
+    else if (name == parameters[2])
+        m_compression = value;
+}
+
+QString PhotonsParquet::filePath(int part) const
+{
+    QString name = part > 1 ? QString("%1_%2").arg(m_fileName, QString::number(part)) : m_fileName;
+    return QDir(m_dirName).absoluteFilePath(name + ".parquet");
+}
+
+bool PhotonsParquet::startExport()
+{
+    if (m_exportedPhotons > 0) {
+        if (m_exportFailed)
+            return false;
+        if (!m_writer) ++m_part;
+        return true;
+    }
+
+    closeWriter();
+    m_exportFailed = false;
+    m_part = 1;
+    m_surfaces.clear();
+    m_surfaceWorldToObject.clear();
+    m_surfaceIDs.clear();
+
+    QDir dir(m_dirName);
+    if (!dir.exists() && !dir.mkpath(".")) {
+        QString message = QString("Could not create photon export directory:\n%1").arg(dir.absolutePath());
+        showWarning(message);
+        m_exportFailed = true;
+        return false;
+    }
+
+    QStringList filters = {m_fileName + ".parquet", m_fileName + "_*.parquet"};
+    for (QFileInfo& fileInfo : dir.entryInfoList(filters, QDir::Files)) {
+        QFile file(fileInfo.absoluteFilePath());
+        if (!file.remove()) {
+            QString message = QString("Error deleting %1.\nThe file is in use or the directory is not writable. Please close it before continuing.")
+                .arg(fileInfo.absoluteFilePath());
+            showWarning(message);
+            m_exportFailed = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PhotonsParquet::openWriter()
+{
+    std::unique_ptr<Writer> w(new Writer);
+
+    arrow::FieldVector fields;
+    fields.push_back(arrow::field("id", arrow::uint64(), false));
+    if (m_saveCoordinates) {
+        fields.push_back(arrow::field("x", arrow::float64(), false));
+        fields.push_back(arrow::field("y", arrow::float64(), false));
+        fields.push_back(arrow::field("z", arrow::float64(), false));
+    }
+    if (m_saveSurfaceSide)
+        fields.push_back(arrow::field("side", arrow::boolean(), false));
+    if (m_savePhotonsID) {
+        fields.push_back(arrow::field("previous_id", arrow::uint64(), false));
+        fields.push_back(arrow::field("next_id", arrow::uint64(), false));
+    }
+    if (m_saveSurfaceID)
+        fields.push_back(arrow::field("surface", arrow::dictionary(arrow::int32(), arrow::utf8())));
+    w->schema = arrow::schema(fields);
+
+    QString path = filePath(m_part);
+    auto file = arrow::io::FileOutputStream::Open(path.toStdString());
+    if (!file.ok())
+        return warn("Could not open photon output file " + path, file.status());
+    w->file = *file;
+
+    auto properties = parquet::WriterProperties::Builder()
+        .compression(compressionType(m_compression))
+        ->build();
+    // keeps the dictionary type of the surface column when read back
+    auto arrowProperties = parquet::ArrowWriterProperties::Builder()
+        .store_schema()
+        ->build();
+
+    auto writer = parquet::arrow::FileWriter::Open(*w->schema, arrow::default_memory_pool(), w->file, properties, arrowProperties);
+    if (!writer.ok())
+        return warn("Could not start Parquet file " + path, writer.status());
+    w->writer = std::move(*writer);
+
+    m_writer = std::move(w);
+    m_partPhotons = 0;
+    return true;
+}
+
+bool PhotonsParquet::closeWriter()
+{
+    if (!m_writer) return true;
+
+    bool ok = true;
+    auto metadata = arrow::KeyValueMetadata::Make(
+        {"tonatiuh.photon_power", "tonatiuh.photons"},
+        {QString::number(m_photonPower, 'g', 17).toStdString(), std::to_string(m_partPhotons)}
+    );
+    arrow::Status status = m_writer->writer->AddKeyValueMetadata(metadata);
+    if (!status.ok())
+        ok = warn("Could not write Parquet metadata", status);
+
+    status = m_writer->writer->Close();
+    if (!status.ok())
+        ok = warn("Could not close Parquet writer", status);
+
+    status = m_writer->file->Close();
+    if (!status.ok())
+        ok = warn("Could not close photon output file", status);
+
+    m_writer.reset();
+    if (!ok)
+        m_exportFailed = true;
+    return ok;
+}
+
+ulong PhotonsParquet::savePhotons(const std::vector<Photon>& photons)
+{
+    if (m_exportFailed || photons.empty())
+        return 0;
+
+    if (!m_writer && !openWriter()) {
+        m_exportFailed = true;
+        return 0;
+    }
+
+    const int64_t nMax = int64_t(photons.size());
+    arrow::UInt64Builder ids, previousIDs, nextIDs;
+    arrow::DoubleBuilder xs, ys, zs;
+    arrow::BooleanBuilder sides;
+    arrow::Int32Builder surfaceIDs;
+    arrow::Status status = ids.Reserve(nMax);
+    if (m_saveCoordinates)
+        status &= xs.Reserve(nMax) & ys.Reserve(nMax) & zs.Reserve(nMax);
+    if (m_saveSurfaceSide)
+        status &= sides.Reserve(nMax);
+    if (m_savePhotonsID)
+        status &= previousIDs.Reserve(nMax) & nextIDs.Reserve(nMax);
+    if (m_saveSurfaceID)
+        status &= surfaceIDs.Reserve(nMax);
+    if (!status.ok()) {
+        warn("Could not allocate photon arrays", status);
+        m_exportFailed = true;
+        return 0;
+    }
+
+    // reserved, so the unsafe appends cannot fail
+    quint64 previousPhotonID = 0;
+    for (int64_t n = 0; n < nMax; ++n)
+    {
+        const Photon& photon = photons[n];
+        int urlId = 0;
+        if (photon.surface) {
+            urlId = m_surfaceIDs.value(photon.surface, 0);
+            if (urlId == 0) {
+                m_surfaces << photon.surface;
+                m_surfaceWorldToObject << photon.surface->getTransform().inversed();
+                urlId = m_surfaces.size();
+                m_surfaceIDs.insert(photon.surface, urlId);
+            }
+        }
+
+        quint64 photonID = m_exportedPhotons + n + 1;
+        ids.UnsafeAppend(photonID);
+
+        if (m_saveCoordinates) {
+            vec3d pos = photon.pos;
+            if (!m_saveCoordinatesGlobal && urlId > 0)
+                pos = m_surfaceWorldToObject[urlId - 1].transformPoint(pos);
+            xs.UnsafeAppend(pos.x);
+            ys.UnsafeAppend(pos.y);
+            zs.UnsafeAppend(pos.z);
+        }
+
+        if (m_saveSurfaceSide)
+            sides.UnsafeAppend(photon.isFront);
+
+        if (m_savePhotonsID) {
+            if (photon.id < 1) previousPhotonID = 0;
+            previousIDs.UnsafeAppend(previousPhotonID);
+            previousPhotonID = photonID;
+            nextIDs.UnsafeAppend(n + 1 < nMax && photons[n + 1].id > 0 ? photonID + 1 : 0);
+        }
+
+        if (m_saveSurfaceID) {
+            if (urlId > 0)
+                surfaceIDs.UnsafeAppend(urlId - 1);
+            else
+                surfaceIDs.UnsafeAppendNull();
+        }
+    }
+
+    arrow::ArrayVector columns;
+    auto finish = [&](arrow::ArrayBuilder& builder) {
+        std::shared_ptr<arrow::Array> array;
+        status &= builder.Finish(&array);
+        columns.push_back(array);
+    };
+    finish(ids);
+    if (m_saveCoordinates) {
+        finish(xs);
+        finish(ys);
+        finish(zs);
+    }
+    if (m_saveSurfaceSide)
+        finish(sides);
+    if (m_savePhotonsID) {
+        finish(previousIDs);
+        finish(nextIDs);
+    }
+    if (m_saveSurfaceID) {
+        // the dictionary grows with the surface table, earlier codes stay valid
+        if (m_writer->dictionarySize != m_surfaces.size()) {
+            arrow::StringBuilder urls;
+            for (InstanceNode* surface : m_surfaces)
+                status &= urls.Append(surface->getURL().toStdString());
+            status &= urls.Finish(&m_writer->dictionary);
+            m_writer->dictionarySize = m_surfaces.size();
+        }
+        std::shared_ptr<arrow::Array> indices;
+        status &= surfaceIDs.Finish(&indices);
+        if (status.ok()) {
+            auto surfaces = arrow::DictionaryArray::FromArrays(m_writer->schema->fields().back()->type(), indices, m_writer->dictionary);
+            status &= surfaces.status();
+            if (surfaces.ok())
+                columns.push_back(*surfaces);
+        }
+    }
+
+    if (status.ok()) {
+        std::shared_ptr<arrow::Table> table = arrow::Table::Make(m_writer->schema, columns, nMax);
+        status = m_writer->writer->WriteTable(*table, nMax); // one row group per block
+    }
+    if (!status.ok()) {
+        warn("Could not write photon row group to " + filePath(m_part), status);
+        m_exportFailed = true;
+        return 0;
+    }
+
+    m_exportedPhotons += nMax;
+    m_partPhotons += nMax;
+    return nMax;
+}
+
+bool PhotonsParquet::endExport()
+{
+    bool closed = closeWriter();
+    return closed && !m_exportFailed;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "kernel/photons/PhotonsAbstract.h"
+#include "libraries/math/3D/Transform.h"
+
+class InstanceNode;
+
+
+//! PhotonsParquet exports photons to Apache Parquet files.
+/*!
+ * Every block passed to savePhotons becomes one row group, written straight
+ * from Arrow arrays. The columns follow the export settings: id, x, y, z,
+ * side, previous_id, next_id and surface, where surface is a dictionary of
+ * surface URLs (null for air). The photon power and count are stored in the
+ * file key-value metadata as tonatiuh.photon_power and tonatiuh.photons.
+ *
+ * Parquet files cannot be reopened for appending, so each continued export
+ * (photon buffer in append mode) writes a new part, ExportFile_2.parquet and
+ * so on; the power of the last part applies to all of them.
+ */
+class PhotonsParquet: public PhotonsAbstract
+{
+
+public:
+    PhotonsParquet();
+    ~PhotonsParquet();
+
+    static QStringList getParameterNames() {return {"ExportDirectory", "ExportFile", "Compression"};}
+    void setParameter(QString name, QString value);
+
+    bool startExport();
+    ulong savePhotons(const std::vector<Photon>& photons);
+    void setPhotonPower(double p) {m_photonPower = p;}
+    bool endExport();
+    bool hasExportError() const {return m_exportFailed;}
+
+    NAME_ICON_FUNCTIONS("Parquet", ":/PhotonsParquet.png")
+
+private:
+    QString filePath(int part) const;
+    bool openWriter();
+    bool closeWriter();
+
+    QString m_dirName;
+    QString m_fileName;
+    QString m_compression;
+    bool m_exportFailed;
+    int m_part;
+    ulong m_exportedPhotons;
+    ulong m_partPhotons;
+    double m_photonPower;
+    QVector<InstanceNode*> m_surfaces;
+    QVector<Transform> m_surfaceWorldToObject;
+    QHash<InstanceNode*, int> m_surfaceIDs; // index in m_surfaces + 1
+
+    struct Writer;
+    std::unique_ptr<Writer> m_writer;
+};
+
+
+
+#include "PhotonsParquetWidget.h"
+
+class PhotonsParquetFactory:
+    public QObject,
+    public PhotonsFactoryT<PhotonsParquet, PhotonsParquetWidget>
+{
+    Q_OBJECT
+    Q_INTERFACES(PhotonsFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.PhotonsFactory")
+};
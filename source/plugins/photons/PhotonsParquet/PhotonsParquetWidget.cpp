@@ -0,0 +1,59 @@
+#include "PhotonsParquetWidget.h"
+#include "ui_PhotonsParquetWidget.h"
+
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QSettings>
+
+#include "PhotonsParquet.h"
+
+
+PhotonsParquetWidget::PhotonsParquetWidget(QWidget* parent):
+    PhotonsWidget(parent),
+    ui(new Ui::PhotonsParquetWidget)
+{
+    ui->setupUi(this);
+    connect(ui->directoryButton, SIGNAL(clicked()), this, SLOT(selectDirectory()));
+}
+
+PhotonsParquetWidget::~PhotonsParquetWidget()
+{
+    delete ui;
+}
+
+QStringList PhotonsParquetWidget::getParameterNames() const
+{
+    return PhotonsParquet::getParameterNames();
+}
+
+QString PhotonsParquetWidget::getParameterValue(QString name) const
+{
+    QStringList names = getParameterNames();
+
+    if (name == names[0])
+        return ui->directoryEdit->text();
+    else if (name == names[1])
+        return ui->fileEdit->text();
+    else if (name == names[2])
+        return ui->compressionCombo->currentText();
+    return QString();
+}
+
+void PhotonsParquetWidget::selectDirectory()
+{
+    QSettings settings("Tonatiuh", "Cyprus");
+    QString dirName = settings.value("dirProjects", "").toString();
+
+    dirName = QFileDialog::getExistingDirectory(this, "Save Directory", dirName);
+    if (dirName.isEmpty()) return;
+
+    QDir dir(dirName);
+    if (!dir.exists())
+    {
+        QMessageBox::information(this, "Tonatiuh", "Selected directory is not valid");
+        return;
+    }
+
+    settings.setValue("dirProjects", dirName);
+    ui->directoryEdit->setText(dirName);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "kernel/photons/PhotonsWidget.h"
+
+
+namespace Ui {
+class PhotonsParquetWidget;
+}
+
+class PhotonsParquetWidget: public PhotonsWidget
+{
+    Q_OBJECT
+
+public:
+    PhotonsParquetWidget(QWidget* parent = 0);
+    ~PhotonsParquetWidget();
+
+    QStringList getParameterNames() const;
+    QString getParameterValue(QString name) const;
+    void setParameterValue(QString /*name*/, QString /*value*/) {}// add setters
+
+private slots:
+    void selectDirectory();
+
+private:
+    Ui::PhotonsParquetWidget* ui;
+};
@@ -0,0 +1,171 @@
+#include "RandomRngStream.h"
+
+#include <cstring>
+
+namespace
+{
+const double m1 = 4294967087.;
+const double m2 = 4294944443.;
+const double norm = 1./(m1 + 1.);
+const double a12 = 1403580.;
+const double a13n = 810728.;
+const double a21 = 527612.;
+const double a23n = 1370589.;
+const double two17 = 131072.;
+const double two53 = 9007199254740992.;
+
+// the transition matrices of the two components raised to 2^76, one substream
+const double A1p76[3][3] = {
+    {  82758667., 1871391091., 4127413238.},
+    {3672831523.,   69195019., 1871391091.},
+    {3672091415., 3528743235.,   69195019.}
+};
+
+const double A2p76[3][3] = {
+    {1511326704., 3759209742., 1610795712.},
+    {4292754251., 1511326704., 3889917532.},
+    {3859662829., 4292754251., 3708466080.}
+};
+
+// (a*s + c) mod m, for a, s, c and m below 2^35
+double multModM(double a, double s, double c, double m)
+{
+    double v = a*s + c;
+    if (v >= two53 || v <= -two53) {
+        long long a1 = static_cast<long long>(a/two17);
+        a -= a1*two17;
+        v = a1*s;
+        a1 = static_cast<long long>(v/m);
+        v -= a1*m;
+        v = v*two17 + a*s + c;
+    }
+    long long a1 = static_cast<long long>(v/m);
+    v -= a1*m;
+    return v < 0. ? v + m : v;
+}
+
+// v = A*s mod m, v may be s
+void matVecModM(const double A[3][3], const double s[3], double v[3], double m)
+{
+    double x[3];
+    for (int i = 0; i < 3; ++i) {
+        x[i] = multModM(A[i][0], s[0], 0., m);
+        x[i] = multModM(A[i][1], s[1], x[i], m);
+        x[i] = multModM(A[i][2], s[2], x[i], m);
+    }
+    for (int i = 0; i < 3; ++i)
+        v[i] = x[i];
+}
+
+// C = A*B mod m, C may be A or B
+void matMatModM(const double A[3][3], const double B[3][3], double C[3][3], double m)
+{
+    double W[3][3];
+    for (int i = 0; i < 3; ++i) {
+        double v[3] = {B[0][i], B[1][i], B[2][i]};
+        matVecModM(A, v, v, m);
+        for (int j = 0; j < 3; ++j)
+            W[j][i] = v[j];
+    }
+    std::memcpy(C, W, sizeof(W));
+}
+
+// B = A^n mod m by the binary digits of n
+void matPowModM(const double A[3][3], double B[3][3], double m, qulonglong n)
+{
+    double W[3][3];
+    std::memcpy(W, A, sizeof(W));
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            B[i][j] = i == j ? 1. : 0.;
+    for (; n > 0; n /= 2) {
+        if (n % 2) matMatModM(W, B, B, m);
+        matMatModM(W, W, W, m);
+    }
+}
+}
+
+
+RandomRngStream::RandomRngStream(ulong seed, ulong size):
+    Random(size),
+    m_isSubstream(false),
+    m_substreamNext(0)
+{
+    seedState(seed, m_start);
+    std::memcpy(m_state, m_start, sizeof(m_state));
+}
+
+RandomRngStream::RandomRngStream(const double* state, ulong size):
+    Random(size),
+    m_isSubstream(true),
+    m_substreamNext(0)
+{
+    std::memcpy(m_start, state, sizeof(m_start));
+    std::memcpy(m_state, state, sizeof(m_state));
+}
+
+/*!
+ * Returns the next substream of this generator, numbered from 1; this one
+ * draws substream 0. Safe to call concurrently. Substreams do not create
+ * further streams.
+ */
+Random* RandomRngStream::createStream()
+{
+    if (m_isSubstream) return nullptr;
+    double state[6];
+    jump(m_start, 1 + m_substreamNext.fetch_add(1), state);
+    return new RandomRngStream(state, StreamSize);
+}
+
+/*!
+ * Returns substream \a index of the stream seeded with \a seed, whatever
+ * was drawn from this generator.
+ */
+Random* RandomRngStream::createSubstream(ulong seed, qulonglong index) const
+{
+    double start[6];
+    seedState(seed, start);
+    double state[6];
+    jump(start, index, state);
+    return new RandomRngStream(state, StreamSize);
+}
+
+void RandomRngStream::jump(const double* start, qulonglong index, double* state)
+{
+    double B1[3][3];
+    double B2[3][3];
+    matPowModM(A1p76, B1, m1, index);
+    matPowModM(A2p76, B2, m2, index);
+    matVecModM(B1, start, state, m1);
+    matVecModM(B2, start + 3, state + 3, m2);
+}
+
+// every component seeded alike, as the original package; the value is
+// kept in [1, m2) so no component is zero or out of range
+void RandomRngStream::seedState(ulong seed, double* state)
+{
+    double x = 1. + double(qulonglong(seed) % qulonglong(m2 - 1.));
+    for (int i = 0; i < 6; ++i)
+        state[i] = x;
+}
+
+double RandomRngStream::next()
+{
+    double p1 = a12*m_state[1] - a13n*m_state[0];
+    long long k = static_cast<long long>(p1/m1);
+    p1 -= k*m1;
+    if (p1 < 0.) p1 += m1;
+    m_state[0] = m_state[1];
+    m_state[1] = m_state[2];
+    m_state[2] = p1;
+
+    double p2 = a21*m_state[5] - a23n*m_state[3];
+    k = static_cast<long long>(p2/m2);
+    p2 -= k*m2;
+    if (p2 < 0.) p2 += m2;
+    m_state[3] = m_state[4];
+    m_state[4] = m_state[5];
+    m_state[5] = p2;
+
+    return p1 > p2 ? (p1 - p2)*norm : (p1 - p2 + m1)*norm;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "kernel/random/Random.h"
+
+#include <atomic>
+
+
+//! RandomRngStream is L'Ecuyer's MRG32k3a combined multiple recursive generator.
+/*!
+ * The period of about 2^191 is cut into substreams of 2^76 numbers, reached
+ * by multiplying the state with powers of the transition matrices instead
+ * of drawing the numbers in between.
+ *
+ * createStream() gives each worker the next substream of this generator, so
+ * it is drawn without RandomParallel's mutex. createSubstream() gives the
+ * substream \a index of the stream of a run seed, so chunked traces with
+ * this generator repeat for a seed whatever the number of workers.
+ */
+class RandomRngStream: public Random
+{
+public:
+    RandomRngStream(ulong seed = 12345UL, ulong size = 1'000'000);
+
+    void FillArray(std::vector<double>& array);
+    Random* createStream();
+    Random* createSubstream(ulong seed, qulonglong index) const;
+
+    NAME_ICON_FUNCTIONS("RngStream (MRG32k3a)", ":/RandomX.png")
+
+protected:
+    RandomRngStream(const double* state, ulong size);
+
+    // the state of substream \a index from the start of a stream
+    static void jump(const double* start, qulonglong index, double* state);
+    static void seedState(ulong seed, double* state);
+    double next();
+
+    double m_state[6];
+    double m_start[6]; // of the stream, substreams count from it
+    bool m_isSubstream;
+    std::atomic<qulonglong> m_substreamNext;
+};
+
+inline void RandomRngStream::FillArray(std::vector<double>& array)
+{
+    for (double& x : array)
+        x = next();
+}
+
+
+class RandomRngStreamFactory:
+    public QObject, public RandomFactoryT<RandomRngStream>
+{
+    Q_OBJECT
+    Q_INTERFACES(RandomFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.RandomFactory")
+};
@@ -22,6 +22,7 @@ public:
 
     NAME_ICON_FUNCTIONS("Elliptic", ":/ShapeElliptic.png")
     void updateShapeGL(TShapeKit* parent);
+    bool hasQuadMesh() const {return true;}
 };
 
 
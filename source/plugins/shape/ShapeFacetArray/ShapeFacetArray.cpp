@@ -0,0 +1,162 @@
+#include "ShapeFacetArray.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QVector>
+
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoNormal.h>
+#include <Inventor/nodes/SoNormalBinding.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+
+#include "kernel/profiles/ProfileBox.h"
+#include "kernel/scene/MaterialGL.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/ShapePlanar.h"
+#include "libraries/math/3D/Box3D.h"
+#include "libraries/math/3D/Ray.h"
+
+SO_NODE_SOURCE(ShapeFacetArray)
+
+
+void ShapeFacetArray::initClass()
+{
+    SO_NODE_INIT_CLASS(ShapeFacetArray, ShapeRT, "ShapeRT");
+}
+
+ShapeFacetArray::ShapeFacetArray()
+{
+    SO_NODE_CONSTRUCTOR(ShapeFacetArray);
+
+    SO_NODE_ADD_FIELD( positions, (0.f, 0.f, 0.f) );
+    SO_NODE_ADD_FIELD( rotations, (SbRotation::identity()) );
+    SO_NODE_ADD_FIELD( facetShape, (0) );
+    SO_NODE_ADD_FIELD( facetProfile, (0) );
+
+    facetShape = new ShapePlanar;
+    facetProfile = new ProfileBox;
+}
+
+ShapeFacetArray::~ShapeFacetArray()
+{
+}
+
+Box3D ShapeFacetArray::getBox(ProfileRT* profile) const
+{
+    Q_UNUSED(profile)
+    return m_facets.getBox();
+}
+
+bool ShapeFacetArray::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const
+{
+    if (tHit == 0 && dg == 0) return intersectP(ray, profile);
+    if (tHit == 0 || dg == 0) gcf::SevereError("ShapeFacetArray::intersect");
+
+    const ShapeRT* shape = m_shape;
+    ProfileRT* facetProfile = m_profile;
+    auto test = [shape, facetProfile](int, const Ray& rayFacet, double* t, DifferentialGeometry* dgFacet) {
+        return shape->intersect(rayFacet, t, dgFacet, facetProfile);
+    };
+    if (!m_facets.intersect(ray, tHit, dg, test)) return false;
+    dg->shape = this;
+    return true;
+}
+
+bool ShapeFacetArray::intersectP(const Ray& ray, ProfileRT* profile) const
+{
+    Q_UNUSED(profile)
+    const ShapeRT* shape = m_shape;
+    ProfileRT* facetProfile = m_profile;
+    return m_facets.intersectP(ray, [shape, facetProfile](int, const Ray& rayFacet) {
+        return shape->intersectP(rayFacet, facetProfile);
+    });
+}
+
+qulonglong ShapeFacetArray::getMemoryUsage() const
+{
+    return m_facets.getMemoryUsage();
+}
+
+void ShapeFacetArray::updateShapeRT(TShapeKit* parent)
+{
+    Q_UNUSED(parent)
+    m_facets.clear();
+    m_shape = dynamic_cast<ShapeRT*>(facetShape.getValue());
+    m_profile = dynamic_cast<ProfileRT*>(facetProfile.getValue());
+    if (!m_shape || !m_profile) return;
+
+    const int nFacets = positions.getNum();
+    m_facets.reserve(nFacets);
+    for (int n = 0; n < nFacets; ++n) {
+        SbRotation rotation = n < rotations.getNum() ? rotations[n] : SbRotation::identity();
+        SbVec3f x, z;
+        rotation.multVec(SbVec3f(1.f, 0.f, 0.f), x);
+        rotation.multVec(SbVec3f(0.f, 0.f, 1.f), z);
+        const SbVec3f& p = positions[n];
+        m_facets.addFacet(vec3d(p[0], p[1], p[2]), vec3d(x[0], x[1], x[2]), vec3d(z[0], z[1], z[2]));
+    }
+    m_facets.build(m_shape->getBox(m_profile));
+}
+
+// a grid of the facet profile per facet, its box for profiles without grids
+void ShapeFacetArray::updateShapeGL(TShapeKit* parent)
+{
+    SoShapeKit* shapeKit = parent->m_shapeKit;
+    MaterialGL* mGL = (MaterialGL*) parent->material.getValue();
+    bool reverseNormals = mGL->reverseNormals.getValue();
+
+    QVector<SbVec3f> vertices;
+    QVector<SbVec3f> normals;
+    QVector<int> faces;
+    if (m_shape && m_profile)
+    {
+        Box2D box = m_profile->getBox();
+        vec2d s = box.size();
+        double step = m_shape->getStepHint(box.center().x, box.center().y);
+        QSize dimensions(
+            std::clamp(1 + int(std::ceil(s.x/step)), 2, 48),
+            std::clamp(1 + int(std::ceil(s.y/step)), 2, 48)
+        );
+        QVector<vec2d> uvs = m_profile->makeMesh(dimensions);
+        if (uvs.isEmpty() || uvs.size() != dimensions.width()*dimensions.height()) {
+            dimensions = QSize(2, 2);
+            uvs = {box.min(), vec2d(box.min().x, box.max().y), vec2d(box.max().x, box.min().y), box.max()};
+        }
+
+        for (int f = 0; f < m_facets.size(); ++f) {
+            const FacetArray::Facet& facet = m_facets.getFacet(f);
+            int v0 = vertices.size();
+            for (const vec2d& uv : uvs) {
+                vec3d point = facet.toArrayPoint(m_shape->getPoint(uv.x, uv.y));
+                vec3d normal = facet.toArrayVector(m_shape->getNormal(uv.x, uv.y));
+                if (reverseNormals) normal = -normal;
+                vertices << SbVec3f(point.x, point.y, point.z);
+                normals << SbVec3f(normal.x, normal.y, normal.z);
+            }
+            for (int n = 0; n < dimensions.width() - 1; n++)
+                for (int m = 0; m < dimensions.height() - 1; ++m) {
+                    int iA = v0 + n*dimensions.height() + m;
+                    int iB = iA + dimensions.height();
+                    int iC = iB + 1;
+                    int iD = iA + 1;
+                    faces << iA << iD << iC << iB << -1;
+                }
+        }
+    }
+
+    shapeKit->setPart("normalBinding", new SoNormalBinding);
+
+    SoCoordinate3* sVertices = new SoCoordinate3;
+    sVertices->point.setValues(0, vertices.size(), vertices.data());
+    shapeKit->setPart("coordinate3", sVertices);
+
+    SoNormal* sNormals = new SoNormal;
+    sNormals->vector.setValues(0, normals.size(), normals.data());
+    shapeKit->setPart("normal", sNormals);
+
+    SoIndexedFaceSet* sMesh = new SoIndexedFaceSet;
+    sMesh->coordIndex.setValues(0, faces.size(), faces.data());
+    shapeKit->setPart("shape", sMesh);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Inventor/fields/SoMFRotation.h>
+#include <Inventor/fields/SoMFVec3f.h>
+#include <Inventor/fields/SoSFNode.h>
+
+#include "kernel/shape/ShapeRT.h"
+#include "libraries/math/3D/Box3D.h"
+#include "kernel/shape/FacetArray.h"
+
+
+//! ShapeFacetArray is a heliostat of canted facets in one shape.
+/*!
+ * Every facet is facetShape cut by facetProfile, placed at its position and
+ * turned by its rotation, the canting; a missing rotation leaves the facet
+ * facing z. Facets are found through the small hierarchy of a FacetArray
+ * instead of a subtree of shape kits each, and the profile of the kit is
+ * not used. The facet shape is traced with facetProfile only, so it should
+ * not build its surface from the kit, as meshes and functions do.
+ */
+class ShapeFacetArray: public ShapeRT
+{
+    SO_NODE_HEADER(ShapeFacetArray);
+
+public:
+    static void initClass();
+    ShapeFacetArray();
+
+    Box3D getBox(ProfileRT* profile) const;
+    bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const;
+    bool intersectP(const Ray& ray, ProfileRT* profile) const;
+    qulonglong getMemoryUsage() const;
+
+    SoMFVec3f positions;
+    SoMFRotation rotations;
+    SoSFNode facetShape;
+    SoSFNode facetProfile;
+
+    NAME_ICON_FUNCTIONS("FacetArray", ":/ShapeFacetArray.png")
+    void updateShapeRT(TShapeKit* parent);
+    void updateShapeGL(TShapeKit* parent);
+
+protected:
+    ~ShapeFacetArray();
+
+    // the fields, for tracing
+    ShapeRT* m_shape = nullptr;
+    ProfileRT* m_profile = nullptr;
+    FacetArray m_facets;
+};
+
+
+
+class ShapeFacetArrayFactory:
+    public QObject, public ShapeFactoryT<ShapeFacetArray>
+{
+    Q_OBJECT
+    Q_INTERFACES(ShapeFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.ShapeFactory")
+};
@@ -12,13 +12,41 @@
 #include "kernel/profiles/ProfileRT.h"
 #include "kernel/profiles/ProfilePolygon.h"
 #include "libraries/DistMesh/PolygonMesh.h"
+#include "kernel/scene/MeshLevelsNode.h"
 #include "kernel/scene/TShapeKit.h"
 #include "kernel/shape/DifferentialGeometry.h"
 #include "libraries/math/3D/Box3D.h"
 #include "libraries/math/3D/Ray.h"
+#include "libraries/math/Expression.h"
 #include "kernel/node/TonatiuhFunctions.h"
 using gcf::pow2;
 
+namespace {
+
+// values of f(u, v) at the points, compiled natively when the text allows it
+void evaluate(const QString& text, const std::vector<double>& points, std::vector<double>& values)
+{
+    values.resize(points.size()/2);
+
+    Expression expression;
+    if (expression.compile(text.toStdString(), {"u", "v"})) {
+        expression.evaluate(points.data(), values.data(), int(values.size()));
+        return;
+    }
+
+    QJSEngine engine;
+    QJSValue object = engine.evaluate(QString(
+        "({ unitName: 'Shape', "
+        "f: function(u, v) {return %1;}"
+        " })"
+    ).arg(text));
+    QJSValue function = object.property("f");
+    for (size_t n = 0; n < values.size(); ++n)
+        values[n] = function.call(QJSValueList() << points[2*n] << points[2*n + 1]).toNumber();
+}
+
+} // namespace
+
 SO_NODE_SOURCE(ShapeFunctionXYZ)
 
 
@@ -29,7 +57,6 @@ void ShapeFunctionXYZ::initClass()
 
 ShapeFunctionXYZ::ShapeFunctionXYZ()
 {  
-    m_bvh = 0;
     SO_NODE_CONSTRUCTOR(ShapeFunctionXYZ);
 
     SO_NODE_ADD_FIELD( functionX, ("u") );
@@ -41,17 +68,16 @@ ShapeFunctionXYZ::ShapeFunctionXYZ()
 Box3D ShapeFunctionXYZ::getBox(ProfileRT* profile) const
 {
     Q_UNUSED(profile)
-    if (m_bvh) return m_bvh->box();
-    return Box3D();
+    return m_mesh.getBox();
 }
 
 bool ShapeFunctionXYZ::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const
 {  
     Q_UNUSED(profile)
-    if (!m_bvh) return false;
+    if (m_mesh.isEmpty()) return false;
     double tHitT = ray.tMax;
     DifferentialGeometry dgT;
-    if (!m_bvh->intersect(ray, &tHitT, &dgT)) return false;
+    if (!m_mesh.intersect(ray, &tHitT, &dgT)) return false;
 
     if (tHit == 0 && dg == 0) return true;
     if (tHit == 0 || dg == 0) gcf::SevereError("ShapeMesh::intersect");
@@ -62,12 +88,31 @@ bool ShapeFunctionXYZ::intersect(const Ray& ray, double* tHit, DifferentialGeome
     return true;
 }
 
-void ShapeFunctionXYZ::updateShapeGL(TShapeKit* parent)
+bool ShapeFunctionXYZ::intersectP(const Ray& ray, ProfileRT* profile) const
+{
+    Q_UNUSED(profile)
+    return !m_mesh.isEmpty() && m_mesh.intersectP(ray);
+}
+
+qulonglong ShapeFunctionXYZ::getTriangleCount() const
+{
+    return qulonglong(m_mesh.size());
+}
+
+// with the arrays of the GL geometry
+qulonglong ShapeFunctionXYZ::getMemoryUsage() const
+{
+    return m_mesh.getMemoryUsage() +
+        qulonglong(vertices.capacity() + normals.capacity())*sizeof(SbVec3f) + qulonglong(faces.capacity())*sizeof(int);
+}
+
+void ShapeFunctionXYZ::updateShapeRT(TShapeKit* parent)
 {
-    // mesh
     buildMesh(parent);
+}
 
-    // visual
+void ShapeFunctionXYZ::updateShapeGL(TShapeKit* parent)
+{
     SoShapeKit* shapeKit = parent->m_shapeKit;
 
     SoCoordinate3* sVertices = new SoCoordinate3;
@@ -81,14 +126,11 @@ void ShapeFunctionXYZ::updateShapeGL(TShapeKit* parent)
     SoIndexedFaceSet* sMesh = new SoIndexedFaceSet;
     sMesh->coordIndex.setValues(0, faces.size(), faces.data());
 
-    shapeKit->setPart("shape", sMesh);
+    shapeKit->setPart("shape", MeshLevelsNode::makeShape(sMesh, vertices.data(), int(vertices.size()), normals.data()));
 }
 
 ShapeFunctionXYZ::~ShapeFunctionXYZ()
 {
-    delete m_bvh;
-    for (Triangle* t : m_triangles)
-        delete t;
 }
 
 #include "kernel/scene/MaterialGL.h"
@@ -152,82 +194,55 @@ void ShapeFunctionXYZ::buildMesh(TShapeKit* parent)
             }
     }
 
-    // fill z
-    QJSEngine engine;
-    QString textX = functionX.getValue().getString();
-    QString textY = functionY.getValue().getString();
-    QString textZ = functionZ.getValue().getString();
-    QJSValue object = engine.evaluate(QString(
-        "({ unitName: 'Shape', "
-        "fX: function(u, v) {return %1;}, "
-        "fY: function(u, v) {return %2;}, "
-        "fZ: function(u, v) {return %3;} "
-        " })"
-    ).arg(textX, textY, textZ));
-    QJSValue fX = object.property("fX");
-    QJSValue fY = object.property("fY");
-    QJSValue fZ = object.property("fZ");
+    // fill xyz, the vertices are followed by their neighbours for the normals
+    int nV = vertices.size();
+    double hu = resolutionU/100;
+    double hv = resolutionV/100;
+    std::vector<double> points(10*nV);
+    for (int n = 0; n < nV; ++n) {
+        double u0 = vertices[n][0];
+        double v0 = vertices[n][1];
+        double* p = &points[2*n];
+        p[0] = u0; p[1] = v0;
+        p = &points[2*nV + 8*n];
+        p[0] = u0 - hu; p[1] = v0;
+        p[2] = u0 + hu; p[3] = v0;
+        p[4] = u0; p[5] = v0 - hv;
+        p[6] = u0; p[7] = v0 + hv;
+    }
+    std::vector<double> valuesX, valuesY, valuesZ;
+    evaluate(functionX.getValue().getString(), points, valuesX);
+    evaluate(functionY.getValue().getString(), points, valuesY);
+    evaluate(functionZ.getValue().getString(), points, valuesZ);
 
     normals = vertices;
-    for (SbVec3f& p : vertices) {
-        QJSValue ansX = fX.call(QJSValueList() << p[0] << p[1]);
-        QJSValue ansY = fY.call(QJSValueList() << p[0] << p[1]);
-        QJSValue ansZ = fZ.call(QJSValueList() << p[0] << p[1]);
-        p.setValue(ansX.toNumber(), ansY.toNumber(), ansZ.toNumber());
-    }
+    for (int n = 0; n < nV; ++n) {
+        vertices[n].setValue(valuesX[n], valuesY[n], valuesZ[n]);
 
-    double hu = resolutionU/100;
-    double hv = resolutionV/100;
-    for (SbVec3f& p : normals) {
-        double u0 = p[0];
-        double v0 = p[1];
-        double pL, pR;
-
-        vec3d dfdu;
-        pL = fX.call(QJSValueList() << u0 - hu << v0).toNumber();
-        pR = fX.call(QJSValueList() << u0 + hu << v0).toNumber();
-        dfdu.x = (pR - pL)/(2*hu);
-        pL = fY.call(QJSValueList() << u0 - hu << v0).toNumber();
-        pR = fY.call(QJSValueList() << u0 + hu << v0).toNumber();
-        dfdu.y = (pR - pL)/(2*hu);
-        pL = fZ.call(QJSValueList() << u0 - hu << v0).toNumber();
-        pR = fZ.call(QJSValueList() << u0 + hu << v0).toNumber();
-        dfdu.z = (pR - pL)/(2*hu);
-
-        vec3d dfdv;
-        pL = fX.call(QJSValueList() << u0 << v0 - hv).toNumber();
-        pR = fX.call(QJSValueList() << u0 << v0 + hv).toNumber();
-        dfdv.x = (pR - pL)/(2*hv);
-        pL = fY.call(QJSValueList() << u0 << v0 - hv).toNumber();
-        pR = fY.call(QJSValueList() << u0 << v0 + hv).toNumber();
-        dfdv.y = (pR - pL)/(2*hv);
-        pL = fZ.call(QJSValueList() << u0 << v0 - hv).toNumber();
-        pR = fZ.call(QJSValueList() << u0 << v0 + hv).toNumber();
-        dfdv.z = (pR - pL)/(2*hv);
+        const double* x = &valuesX[nV + 4*n];
+        const double* y = &valuesY[nV + 4*n];
+        const double* z = &valuesZ[nV + 4*n];
+        vec3d dfdu((x[1] - x[0])/(2*hu), (y[1] - y[0])/(2*hu), (z[1] - z[0])/(2*hu));
+        vec3d dfdv((x[3] - x[2])/(2*hv), (y[3] - y[2])/(2*hv), (z[3] - z[2])/(2*hv));
 
         vec3d nv = cross(dfdu, dfdv);
         nv.normalize();
         if (reverseNormals) nv = -nv;
-        p.setValue(nv.x, nv.y, nv.z);
+        normals[n].setValue(nv.x, nv.y, nv.z);
     }
 
     // fill triangles
 
-    for (Triangle* t : m_triangles)
-        delete t;
-    m_triangles.clear();
+    m_mesh.clear();
 
     for (int n = 0; n < faces.size(); n += 4)
     {
         int iA = faces[n];
         int iB = faces[n + 1];
         int iC = faces[n + 2];
-        Triangle* triangle = new Triangle(
+        m_mesh.addTriangle(
             &vertices[iA][0], &vertices[iB][0], &vertices[iC][0],
             &normals[iA][0], &normals[iB][0], &normals[iC][0]);
-        m_triangles.push_back(triangle);
     }
-
-    if (m_bvh) delete m_bvh;
-    m_bvh = new BVH(&m_triangles);
+    m_mesh.build();
 }
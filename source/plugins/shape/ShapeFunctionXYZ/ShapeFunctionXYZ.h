@@ -6,7 +6,7 @@
 
 #include "kernel/shape/ShapeRT.h"
 #include "libraries/math/3D/Box3D.h"
-#include "BVH.h"
+#include "kernel/shape/TriangleMesh.h"
 
 
 class ShapeFunctionXYZ: public ShapeRT
@@ -19,6 +19,9 @@ public:
 
     Box3D getBox(ProfileRT* profile) const;
     bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const;
+    bool intersectP(const Ray& ray, ProfileRT* profile) const;
+    qulonglong getTriangleCount() const;
+    qulonglong getMemoryUsage() const;
 
     SoSFString functionX;
     SoSFString functionY;
@@ -30,13 +33,13 @@ public:
     QVector<int> faces;
 
     NAME_ICON_FUNCTIONS("FunctionXYZ", ":/ShapeFunctionXYZ.png")
+    void updateShapeRT(TShapeKit* parent);
     void updateShapeGL(TShapeKit* parent);
 
 protected:
     ~ShapeFunctionXYZ();
 
-    std::vector<Triangle*> m_triangles;
-    BVH* m_bvh;
+    TriangleMesh m_mesh;
 
     void buildMesh(TShapeKit* parent);
 };
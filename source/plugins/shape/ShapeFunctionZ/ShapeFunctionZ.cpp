@@ -12,13 +12,41 @@
 #include "kernel/profiles/ProfileRT.h"
 #include "kernel/profiles/ProfilePolygon.h"
 #include "libraries/DistMesh/PolygonMesh.h"
+#include "kernel/scene/MeshLevelsNode.h"
 #include "kernel/scene/TShapeKit.h"
 #include "kernel/shape/DifferentialGeometry.h"
 #include "libraries/math/3D/Box3D.h"
 #include "libraries/math/3D/Ray.h"
+#include "libraries/math/Expression.h"
 #include "kernel/node/TonatiuhFunctions.h"
 using gcf::pow2;
 
+namespace {
+
+// values of z(x, y) at the points, compiled natively when the text allows it
+void findZ(const QString& text, const std::vector<double>& points, std::vector<double>& values)
+{
+    values.resize(points.size()/2);
+
+    Expression expression;
+    if (expression.compile(text.toStdString(), {"x", "y"})) {
+        expression.evaluate(points.data(), values.data(), int(values.size()));
+        return;
+    }
+
+    QJSEngine engine;
+    QJSValue object = engine.evaluate(QString(
+        "({ unitName: 'Shape', "
+        "findZ: function(x, y) {return %1;}"
+        " })"
+    ).arg(text));
+    QJSValue function = object.property("findZ");
+    for (size_t n = 0; n < values.size(); ++n)
+        values[n] = function.call(QJSValueList() << points[2*n] << points[2*n + 1]).toNumber();
+}
+
+} // namespace
+
 SO_NODE_SOURCE(ShapeFunctionZ)
 
 
@@ -29,7 +57,6 @@ void ShapeFunctionZ::initClass()
 
 ShapeFunctionZ::ShapeFunctionZ()
 {  
-    m_bvh = 0;
     SO_NODE_CONSTRUCTOR(ShapeFunctionZ);
 
     SO_NODE_ADD_FIELD( functionZ, ("(x*x + y*y)/4") );
@@ -39,17 +66,21 @@ ShapeFunctionZ::ShapeFunctionZ()
 Box3D ShapeFunctionZ::getBox(ProfileRT* profile) const
 {
     Q_UNUSED(profile)
-    if (m_bvh) return m_bvh->box();
-    return Box3D();
+    if (!m_heightfield.isEmpty()) return m_heightfield.getBox();
+    return m_mesh.getBox();
 }
 
 bool ShapeFunctionZ::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const
 {  
     Q_UNUSED(profile)
-    if (!m_bvh) return false;
     double tHitT = ray.tMax;
     DifferentialGeometry dgT;
-    if (!m_bvh->intersect(ray, &tHitT, &dgT)) return false;
+    if (!m_heightfield.isEmpty()) {
+        if (!m_heightfield.intersect(ray, &tHitT, &dgT)) return false;
+    } else {
+        if (m_mesh.isEmpty()) return false;
+        if (!m_mesh.intersect(ray, &tHitT, &dgT)) return false;
+    }
 
     if (tHit == 0 && dg == 0) return true;
     if (tHit == 0 || dg == 0) gcf::SevereError("ShapeMesh::intersect");
@@ -60,12 +91,35 @@ bool ShapeFunctionZ::intersect(const Ray& ray, double* tHit, DifferentialGeometr
     return true;
 }
 
-void ShapeFunctionZ::updateShapeGL(TShapeKit* parent)
+bool ShapeFunctionZ::intersectP(const Ray& ray, ProfileRT* profile) const
+{
+    Q_UNUSED(profile)
+    if (!m_heightfield.isEmpty())
+        return m_heightfield.intersectP(ray);
+    return !m_mesh.isEmpty() && m_mesh.intersectP(ray);
+}
+
+qulonglong ShapeFunctionZ::getTriangleCount() const
+{
+    if (!m_heightfield.isEmpty())
+        return m_heightfield.getTriangleCount();
+    return qulonglong(m_mesh.size());
+}
+
+// with the arrays of the GL geometry
+qulonglong ShapeFunctionZ::getMemoryUsage() const
+{
+    return m_heightfield.getMemoryUsage() + m_mesh.getMemoryUsage() +
+        qulonglong(vertices.capacity() + normals.capacity())*sizeof(SbVec3f) + qulonglong(faces.capacity())*sizeof(int);
+}
+
+void ShapeFunctionZ::updateShapeRT(TShapeKit* parent)
 {
-    // mesh
     buildMesh(parent);
+}
 
-    // visual
+void ShapeFunctionZ::updateShapeGL(TShapeKit* parent)
+{
     SoShapeKit* shapeKit = parent->m_shapeKit;
 
     SoCoordinate3* sVertices = new SoCoordinate3;
@@ -79,14 +133,11 @@ void ShapeFunctionZ::updateShapeGL(TShapeKit* parent)
     SoIndexedFaceSet* sMesh = new SoIndexedFaceSet;
     sMesh->coordIndex.setValues(0, faces.size(), faces.data());
 
-    shapeKit->setPart("shape", sMesh);
+    shapeKit->setPart("shape", MeshLevelsNode::makeShape(sMesh, vertices.data(), int(vertices.size()), normals.data()));
 }
 
 ShapeFunctionZ::~ShapeFunctionZ()
 {
-    delete m_bvh;
-    for (Triangle* t : m_triangles)
-        delete t;
 }
 
 #include "kernel/scene/MaterialGL.h"
@@ -104,6 +155,7 @@ void ShapeFunctionZ::buildMesh(TShapeKit* parent)
     normals.clear();
     faces.clear();
 
+    bool isGrid = false;
     if (ProfilePolygon* profilePolygon = dynamic_cast<ProfilePolygon*>(profile))
     {
         const QPolygonF& qpolygon = profilePolygon->getPolygon();
@@ -132,6 +184,7 @@ void ShapeFunctionZ::buildMesh(TShapeKit* parent)
     else
     {
         QVector<vec2d> uvs = profile->makeMesh(dimensions);
+        isGrid = !uvs.isEmpty() && uvs.size() == dimensions.width()*dimensions.height();
 
         for (const vec2d& uv : uvs) {
             vertices << SbVec3f(uv.x, uv.y, 0.);
@@ -148,59 +201,53 @@ void ShapeFunctionZ::buildMesh(TShapeKit* parent)
             }
     }
 
-    // fill z
-    QJSEngine engine;
-    QString fZ = functionZ.getValue().getString();
-    QJSValue object = engine.evaluate(QString(
-        "({ unitName: 'Shape', "
-        "findZ: function(x, y) {return %1;}"
-        " })"
-    ).arg(fZ));
-    QJSValue findZ = object.property("findZ");
-
-
-    for (SbVec3f& v : vertices) {
-        QJSValue ansZ = findZ.call(QJSValueList() << v[0] << v[1]);
-        v[2] = ansZ.toNumber();
+    // fill z, the vertices are followed by their neighbours for the normals
+    int nV = vertices.size();
+    double h = resolution/100;
+    std::vector<double> points(10*nV);
+    for (int n = 0; n < nV; ++n) {
+        double x0 = vertices[n][0];
+        double y0 = vertices[n][1];
+        double* p = &points[2*n];
+        p[0] = x0; p[1] = y0;
+        p = &points[2*nV + 8*n];
+        p[0] = x0 - h; p[1] = y0;
+        p[2] = x0 + h; p[3] = y0;
+        p[4] = x0; p[5] = y0 - h;
+        p[6] = x0; p[7] = y0 + h;
     }
+    std::vector<double> values;
+    findZ(functionZ.getValue().getString(), points, values);
 
     normals = vertices;
-    double h = resolution/100;
-    for (SbVec3f& v : normals) {
-        double x0 = v[0];
-        double y0 = v[1];
+    for (int n = 0; n < nV; ++n) {
+        vertices[n][2] = values[n];
 
-        double zL = findZ.call(QJSValueList() << x0 - h << y0).toNumber();
-        double zR = findZ.call(QJSValueList() << x0 + h << y0).toNumber();
-        double dfx = (zR - zL)/(2*h);
-
-        zL = findZ.call(QJSValueList() << x0 << y0 - h).toNumber();
-        zR = findZ.call(QJSValueList() << x0 << y0 + h).toNumber();
-        double dfy = (zR - zL)/(2*h);
+        const double* z = &values[nV + 4*n];
+        double dfx = (z[1] - z[0])/(2*h);
+        double dfy = (z[3] - z[2])/(2*h);
 
         vec3d nv(-dfx, -dfy, 1);
         nv.normalize();
         if (reverseNormals) nv = -nv;
-        v.setValue(nv.x, nv.y, nv.z);
+        normals[n].setValue(nv.x, nv.y, nv.z);
     }
 
     // fill triangles
 
-    for (Triangle* t : m_triangles)
-        delete t;
-    m_triangles.clear();
+    m_mesh.clear();
+    m_heightfield.clear();
+    if (isGrid && m_heightfield.build(dimensions.width(), dimensions.height(), vertices[0].getValue(), normals[0].getValue()))
+        return;
 
     for (int n = 0; n < faces.size(); n += 4)
     {
         int iA = faces[n];
         int iB = faces[n + 1];
         int iC = faces[n + 2];
-        Triangle* triangle = new Triangle(
+        m_mesh.addTriangle(
             &vertices[iA][0], &vertices[iB][0], &vertices[iC][0],
             &normals[iA][0], &normals[iB][0], &normals[iC][0]);
-        m_triangles.push_back(triangle);
     }
-
-    if (m_bvh) delete m_bvh;
-    m_bvh = new BVH(&m_triangles);
+    m_mesh.build();
 }
@@ -6,7 +6,8 @@
 
 #include "kernel/shape/ShapeRT.h"
 #include "libraries/math/3D/Box3D.h"
-#include "BVH.h"
+#include "kernel/shape/Heightfield.h"
+#include "kernel/shape/TriangleMesh.h"
 
 
 class ShapeFunctionZ: public ShapeRT
@@ -19,6 +20,9 @@ public:
 
     Box3D getBox(ProfileRT* profile) const;
     bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const;
+    bool intersectP(const Ray& ray, ProfileRT* profile) const;
+    qulonglong getTriangleCount() const;
+    qulonglong getMemoryUsage() const;
 
     SoSFString functionZ;
     SoSFVec2i32 dims;
@@ -28,13 +32,14 @@ public:
     QVector<int> faces;
 
     NAME_ICON_FUNCTIONS("FunctionZ", ":/ShapeFunctionZ.png")
+    void updateShapeRT(TShapeKit* parent);
     void updateShapeGL(TShapeKit* parent);
 
 protected:
     ~ShapeFunctionZ();
 
-    std::vector<Triangle*> m_triangles;
-    BVH* m_bvh;
+    TriangleMesh m_mesh;
+    Heightfield m_heightfield; // replaces the mesh on grid profiles
 
     void buildMesh(TShapeKit* parent);
 };
@@ -2,6 +2,7 @@
 
 #include <Inventor/sensors/SoNodeSensor.h>
 
+#include "kernel/node/SensorBatch.h"
 #include "kernel/node/TonatiuhFunctions.h"
 #include "kernel/profiles/ProfileRT.h"
 #include "kernel/scene/TShapeKit.h"
@@ -41,6 +42,11 @@ ShapeMapN::ShapeMapN()
     onSensor(this, 0);
 }
 
+ShapeMapN::~ShapeMapN()
+{
+    SensorBatch::forget(this);
+}
+
 bool ShapeMapN::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const
 {
     // r0_z + d_z*t = 0
@@ -83,7 +89,10 @@ void ShapeMapN::updateShapeGL(TShapeKit* parent)
 
 void ShapeMapN::onSensor(void* data, SoSensor*)
 {
+    if (SensorBatch::defer(onSensor, data)) return;
     ShapeMapN* shape = (ShapeMapN*) data;
+    // the fields are read now, a pending notice would repeat it
+    shape->m_sensor->unschedule();
 
     shape->m_gridX = Grid(Interval(
         shape->xLimits.getValue()[0],
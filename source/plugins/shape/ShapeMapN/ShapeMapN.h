@@ -26,8 +26,11 @@ public:
 
     NAME_ICON_FUNCTIONS("MapN", ":/ShapeMapN.png")
     void updateShapeGL(TShapeKit* parent);
+    bool hasQuadMesh() const {return true;}
 
 protected:
+    ~ShapeMapN();
+
     Matrix2D<vec3d> m_matrixNormals;
     Grid m_gridX;
     Grid m_gridY;
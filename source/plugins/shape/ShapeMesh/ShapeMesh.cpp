@@ -1,5 +1,8 @@
 #include "ShapeMesh.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include <Inventor/sensors/SoFieldSensor.h>
 #include <Inventor/sensors/SoNodeSensor.h>
 #include <Inventor/nodes/SoCoordinate3.h>
@@ -7,20 +10,56 @@
 #include <Inventor/nodes/SoGroup.h>
 #include <Inventor/nodes/SoShapeHints.h>
 #include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
 #include <QFileInfo>
-#include <QMessageBox>
+#include <QSaveFile>
+#include <QStandardPaths>
 
 #include "kernel/profiles/ProfileRT.h"
+#include "kernel/scene/MeshLevelsNode.h"
 #include "kernel/scene/TShapeKit.h"
 #include "kernel/shape/DifferentialGeometry.h"
 #include "libraries/math/3D/Box3D.h"
 #include "libraries/math/3D/Ray.h"
+#include "libraries/auxiliary/ObjReader.h"
 #include "libraries/auxiliary/tiny_obj_loader.h"
 #include "kernel/node/TonatiuhFunctions.h"
 using gcf::pow2;
 
 SO_NODE_SOURCE(ShapeMesh)
 
+namespace {
+
+const char CacheMagic[4] = {'T', 'N', 'M', 'C'};
+const quint32 CacheVersion = 2;
+
+struct CacheHeader
+{
+    char magic[4];
+    quint32 version;
+    char key[20]; // Sha1 of the obj file path, time, bytes and the group
+};
+
+// sections are padded to 8 bytes so mapped arrays stay aligned
+void append(std::vector<char>& data, const void* p, size_t size)
+{
+    const char* bytes = static_cast<const char*>(p);
+    data.insert(data.end(), bytes, bytes + size);
+    data.resize((data.size() + 7) & ~size_t(7));
+}
+
+const char* take(const char*& p, const char* end, size_t size)
+{
+    if (size_t(end - p) < size) return nullptr;
+    const char* section = p;
+    p += std::min((size + 7) & ~size_t(7), size_t(end - p));
+    return section;
+}
+
+} // namespace
+
 
 void ShapeMesh::initClass()
 {
@@ -29,7 +68,6 @@ void ShapeMesh::initClass()
 
 ShapeMesh::ShapeMesh()
 {  
-    m_bvh = 0;
     SO_NODE_CONSTRUCTOR(ShapeMesh);
     isBuiltIn = TRUE;
 
@@ -63,17 +101,19 @@ ShapeMesh::ShapeMesh()
 Box3D ShapeMesh::getBox(ProfileRT* profile) const
 {
     Q_UNUSED(profile)
-    if (m_bvh) return m_bvh->box();
-    return Box3D();
+    return m_paged.isEmpty() ? m_mesh.getBox() : m_paged.getBox();
 }
 
 bool ShapeMesh::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const
 {  
     Q_UNUSED(profile)
-    if (!m_bvh) return false;
     double tHitT = ray.tMax;
     DifferentialGeometry dgT;
-    if (!m_bvh->intersect(ray, &tHitT, &dgT)) return false;
+    if (!m_paged.isEmpty()) {
+        if (!m_paged.intersect(ray, &tHitT, &dgT)) return false;
+    } else {
+        if (m_mesh.isEmpty() || !m_mesh.intersect(ray, &tHitT, &dgT)) return false;
+    }
 
     if (tHit == 0 && dg == 0) return true;
     if (tHit == 0 || dg == 0) gcf::SevereError( "ShapeMesh::intersect");
@@ -84,6 +124,23 @@ bool ShapeMesh::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg
     return true;
 }
 
+bool ShapeMesh::intersectP(const Ray& ray, ProfileRT* profile) const
+{
+    Q_UNUSED(profile)
+    if (!m_paged.isEmpty()) return m_paged.intersectP(ray);
+    return !m_mesh.isEmpty() && m_mesh.intersectP(ray);
+}
+
+qulonglong ShapeMesh::getTriangleCount() const
+{
+    return m_paged.isEmpty() ? qulonglong(m_mesh.size()) : m_paged.size();
+}
+
+qulonglong ShapeMesh::getMemoryUsage() const
+{
+    return m_mesh.getMemoryUsage() + m_paged.getMemoryUsage();
+}
+
 #include "kernel/scene/MaterialGL.h"
 void ShapeMesh::updateShapeGL(TShapeKit* parent)
 {
@@ -130,7 +187,8 @@ void ShapeMesh::updateShapeGL(TShapeKit* parent)
         shapePart->pickCulling = SoShapeKit::ON;
 //        qDebug() << "name = " << fs->getName().getString();
         shapePart->setName(fs->getName());
-        shapePart->setPart("shape", fs);
+        shapePart->setPart("shape", MeshLevelsNode::makeShape(fs, vertices.getValues(0), vertices.getNum(),
+                                                              normals.getValues(0), mGL->reverseNormals.getValue()));
         childList->addChild(shapePart);
     }
     shapeKit->setPart("shape", new SoIndexedFaceSet); // hide default cube
@@ -138,18 +196,116 @@ void ShapeMesh::updateShapeGL(TShapeKit* parent)
 
 ShapeMesh::~ShapeMesh()
 {
-    delete m_bvh;
-    for (Triangle* t : m_triangles)
-        delete t;
 }
 
-#include <QDir>
+// a missing, stale or unreadable cache is a miss
+bool ShapeMesh::readCache(const QString& cacheName, const QByteArray& key)
+{
+    QSharedPointer<QFile> file = QSharedPointer<QFile>::create(cacheName);
+    if (!file->open(QIODevice::ReadOnly)) return false;
+    const qint64 size = file->size();
+    if (size <= qint64(sizeof(CacheHeader))) return false;
+    const char* p = reinterpret_cast<const char*>(file->map(0, size));
+    if (!p) return false;
+    const char* begin = p;
+    const char* end = p + size;
+
+    CacheHeader header;
+    std::memcpy(&header, take(p, end, sizeof(header)), sizeof(header));
+    if (std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0) return false;
+    if (header.version != CacheVersion) return false;
+    if (key.size() != int(sizeof(header.key)) || std::memcmp(header.key, key.constData(), sizeof(header.key)) != 0) return false;
+
+    const quint64* counts = reinterpret_cast<const quint64*>(take(p, end, 3*sizeof(quint64)));
+    if (!counts) return false;
+    const char* vs = take(p, end, counts[0]*sizeof(SbVec3f));
+    const char* ns = take(p, end, counts[1]*sizeof(SbVec3f));
+    if (!vs || !ns) return false;
+
+    QVector<SoIndexedFaceSet*> faceSets;
+    auto failWithFaceSets = [&faceSets]() {
+        for (SoIndexedFaceSet* fs : faceSets) fs->unref();
+        return false;
+    };
+    for (quint64 g = 0; g < counts[2]; ++g) {
+        const quint64* sizes = reinterpret_cast<const quint64*>(take(p, end, 2*sizeof(quint64)));
+        if (!sizes) return failWithFaceSets();
+        const char* name = take(p, end, sizes[0]);
+        const int32_t* coordIndex = reinterpret_cast<const int32_t*>(take(p, end, sizes[1]*sizeof(int32_t)));
+        const int32_t* normalIndex = reinterpret_cast<const int32_t*>(take(p, end, sizes[1]*sizeof(int32_t)));
+        if (!name || !coordIndex || !normalIndex) return failWithFaceSets();
+
+        SoIndexedFaceSet* faceSet = new SoIndexedFaceSet;
+        faceSet->ref();
+        faceSet->setName(SbName(std::string(name, sizes[0]).c_str()));
+        faceSet->coordIndex.setValues(0, int(sizes[1]), coordIndex);
+        faceSet->normalIndex.setValues(0, int(sizes[1]), normalIndex);
+        faceSets << faceSet;
+    }
+
+    // the mesh starts aligned for mapping, and is viewed in the mapped file
+    // with shared caches, so processes reading it share its pages
+    p = begin + std::min(size_t(p - begin + TriangleMesh::Alignment - 1)/TriangleMesh::Alignment*TriangleMesh::Alignment, size_t(end - begin));
+    const bool isMapped = TriangleMesh::isMappedCaches();
+    TriangleMesh mesh;
+    if (!(isMapped ? mesh.map(p, end) : mesh.read(p, end))) return failWithFaceSets();
+
+    vertices.setValues(0, int(counts[0]), reinterpret_cast<const SbVec3f*>(vs));
+    normals.setValues(0, int(counts[1]), reinterpret_cast<const SbVec3f*>(ns));
+    for (SoIndexedFaceSet* fs : m_faceSets) fs->unref();
+    m_faceSets = faceSets;
+    m_mesh = std::move(mesh);
+    m_cacheFile = isMapped ? file : QSharedPointer<QFile>();
+    return true;
+}
+
+// a cache that cannot be written is left out
+void ShapeMesh::writeCache(const QString& cacheName, const QByteArray& key) const
+{
+    if (key.size() != int(sizeof(CacheHeader::key))) return;
+
+    CacheHeader header;
+    std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = CacheVersion;
+    std::memcpy(header.key, key.constData(), sizeof(header.key));
+
+    std::vector<char> data;
+    append(data, &header, sizeof(header));
+    const quint64 counts[] = {quint64(vertices.getNum()), quint64(normals.getNum()), quint64(m_faceSets.size())};
+    append(data, counts, sizeof(counts));
+    append(data, vertices.getValues(0), counts[0]*sizeof(SbVec3f));
+    append(data, normals.getValues(0), counts[1]*sizeof(SbVec3f));
+    for (SoIndexedFaceSet* fs : m_faceSets) {
+        const char* name = fs->getName().getString();
+        const quint64 sizes[] = {quint64(std::strlen(name)), quint64(fs->coordIndex.getNum())};
+        append(data, sizes, sizeof(sizes));
+        append(data, name, sizes[0]);
+        append(data, fs->coordIndex.getValues(0), sizes[1]*sizeof(int32_t));
+        append(data, fs->normalIndex.getValues(0), sizes[1]*sizeof(int32_t));
+    }
+    data.resize((data.size() + TriangleMesh::Alignment - 1)/TriangleMesh::Alignment*TriangleMesh::Alignment);
+    m_mesh.write(data);
+
+    if (!QDir().mkpath(QFileInfo(cacheName).absolutePath())) return;
+    QSaveFile file(cacheName);
+    if (file.open(QIODevice::WriteOnly) && file.write(data.data(), qint64(data.size())) == qint64(data.size()))
+        file.commit();
+}
+
+void ShapeMesh::clearMesh()
+{
+    vertices.deleteValues(0); // todo move
+    normals.deleteValues(0);
+    m_faceSets.clear();
+    m_mesh.clear();
+    m_paged.clear();
+    m_cacheFile.reset();
+}
+
 void ShapeMesh::onSensor(void* data, SoSensor*)
 {
     ShapeMesh* shape = (ShapeMesh*) data;
-    shape->vertices.deleteValues(0); // todo move
-    shape->normals.deleteValues(0);
-    shape->m_faceSets.clear();
+    shape->clearMesh();
 
     QString fileName = shape->file.getValue().getString();
     if (fileName.isEmpty()) return;
@@ -159,15 +315,39 @@ void ShapeMesh::onSensor(void* data, SoSensor*)
     QFileInfo info(fileName);
 
     if (info.suffix() != "obj") {
-        QMessageBox::warning(0, "Warning", "File is not in obj-format");
+        tgf::showWarning("File is not in obj-format");
         return;
     }
     if (!info.exists()) {
-        QMessageBox::warning(0, "Warning", QString("File not found:\n") + fileName);
+        tgf::showWarning(QString("File not found:\n") + fileName);
         return;
     }
     fileName = info.absoluteFilePath();
 
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return;
+    const qint64 size = file.size();
+    const char* text = size > 0 ? reinterpret_cast<const char*>(file.map(0, size)) : nullptr;
+
+    // the cache of the file and group, there is none without a cache directory
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(fileName.toUtf8());
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    hash.addData(groupName.toUtf8());
+    if (text) hash.addData(QByteArrayView(text, size));
+    // a paged mesh keeps the drawing in the cache, without the mesh
+    const bool isPaged = PagedMesh::isPagedMeshes();
+    if (isPaged) hash.addData(QByteArray("paged"));
+    const QByteArray key = hash.result();
+
+    QString cacheName = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cacheName.isEmpty()) cacheName += "/meshes/" + key.toHex() + ".bin";
+    const QString pagedName = cacheName.isEmpty() || !isPaged ? QString() : cacheName.left(cacheName.size() - 4) + ".pages";
+    if (!cacheName.isEmpty() && shape->readCache(cacheName, key)) {
+        if (pagedName.isEmpty() || shape->m_paged.open(pagedName)) return;
+        shape->clearMesh();
+    }
+
 
     // import
     tinyobj::attrib_t attrib;
@@ -177,88 +357,96 @@ void ShapeMesh::onSensor(void* data, SoSensor*)
     std::string warnings;
     std::string errors;
 
-    bool returnCode = tinyobj::LoadObj(&attrib, &shapes, &materials, &warnings, &errors, fileName.toLatin1().data());
+    bool returnCode = text && ObjReader::read(text, size_t(size), &attrib, &shapes);
+    if (!returnCode)
+        returnCode = tinyobj::LoadObj(&attrib, &shapes, &materials, &warnings, &errors, fileName.toLatin1().data());
     if (!returnCode) return;
+    file.close();
 
 
     // mesh for rendering
     shape->vertices.setValues(0, attrib.vertices.size()/3, (SbVec3f*) attrib.vertices.data());
     shape->normals.setValues(0, attrib.normals.size()/3, (SbVec3f*) attrib.normals.data());
 
-//    int nMax = attrib.normals.size()/3;
-//    shape->normals.setNum(nMax);
-//    for (int n = 0, m = 0; n < nMax; n++, m += 3) {
-//        SbVec3f nv(&attrib.normals[m]);
-//        nv.normalize();
-//        shape->normals.set1Value(n, nv);
-//    }
-
     for (auto& shapeGroup : shapes) {
         if (!groupName.isEmpty() && groupName != shapeGroup.name.c_str())
             continue;
         tinyobj::mesh_t& mesh = shapeGroup.mesh;
 
-        SoMFInt32 facesVertices;
-        SoMFInt32 facesNormals;
-        int nMax = mesh.num_face_vertices.size()*4; // approx
-        facesVertices.setNum(nMax);
-        facesNormals.setNum(nMax);
+        std::vector<int32_t> facesVertices;
+        std::vector<int32_t> facesNormals;
+        facesVertices.reserve(mesh.indices.size() + mesh.num_face_vertices.size());
+        facesNormals.reserve(mesh.indices.size() + mesh.num_face_vertices.size());
 
-        int n = 0;
         size_t v0 = 0;
         for (size_t f = 0; f < mesh.num_face_vertices.size(); f++) {
             uchar vMax = mesh.num_face_vertices[f]; // 3 or more
             for (size_t v = 0; v < vMax; v++) {
                 const tinyobj::index_t& index = mesh.indices[v0 + v];
-                facesVertices.set1Value(n, index.vertex_index);
-                facesNormals.set1Value(n, index.normal_index);
-                n++;
+                facesVertices.push_back(index.vertex_index);
+                facesNormals.push_back(index.normal_index);
             }
-            facesVertices.set1Value(n, -1);
-            facesNormals.set1Value(n, -1);
-            n++;
+            facesVertices.push_back(-1);
+            facesNormals.push_back(-1);
             v0 += vMax;
         }
 
         SoIndexedFaceSet* faceSet = new SoIndexedFaceSet;
         faceSet->ref();
         faceSet->setName(shapeGroup.name.c_str());
-        faceSet->coordIndex.setValues(0, facesVertices.getNum(), facesVertices.getValues(0));
-        faceSet->normalIndex.setValues(0, facesNormals.getNum(), facesNormals.getValues(0));
+        faceSet->coordIndex.setValues(0, int(facesVertices.size()), facesVertices.data());
+        faceSet->normalIndex.setValues(0, int(facesNormals.size()), facesNormals.data());
         shape->m_faceSets << faceSet;
     }
 
 
     // mesh for raytracing
     // quad facet are not triangulated!
-    for (Triangle* t : shape->m_triangles)
-        delete t;
-    shape->m_triangles.clear();
-
-    for (auto& shapeGroup : shapes) {
-        if (!groupName.isEmpty() && groupName != shapeGroup.name.c_str())
-            continue;
-         tinyobj::mesh_t& mesh = shapeGroup.mesh;
-
-         size_t v0 = 0;
-         for (size_t f = 0; f < mesh.num_face_vertices.size(); f++) {
-             int vMax = mesh.num_face_vertices[f];
-             const tinyobj::index_t& i0 = mesh.indices[v0];
-             const tinyobj::index_t& i1 = mesh.indices[v0 + 1];
-             const tinyobj::index_t& i2 = mesh.indices[v0 + 2];
-
-             vec3d vA(&attrib.vertices[3*i0.vertex_index]);
-             vec3d vB(&attrib.vertices[3*i1.vertex_index]);
-             vec3d vC(&attrib.vertices[3*i2.vertex_index]);
-             vec3d nA(&attrib.normals[3*i0.normal_index]);
-             vec3d nB(&attrib.normals[3*i1.normal_index]);
-             vec3d nC(&attrib.normals[3*i2.normal_index]);
-             Triangle* triangle = new Triangle(vA, vB, vC, nA, nB, nC);
-             shape->m_triangles.push_back(triangle);
-             v0 += vMax;
-         }
+    size_t nTriangles = 0;
+    for (auto& shapeGroup : shapes)
+        if (groupName.isEmpty() || groupName == shapeGroup.name.c_str())
+            nTriangles += shapeGroup.mesh.num_face_vertices.size();
+
+    auto addTriangles = [&](auto& target) {
+        target.reserve(int(nTriangles));
+        for (auto& shapeGroup : shapes) {
+            if (!groupName.isEmpty() && groupName != shapeGroup.name.c_str())
+                continue;
+             tinyobj::mesh_t& mesh = shapeGroup.mesh;
+
+             size_t v0 = 0;
+             for (size_t f = 0; f < mesh.num_face_vertices.size(); f++) {
+                 int vMax = mesh.num_face_vertices[f];
+                 const tinyobj::index_t& i0 = mesh.indices[v0];
+                 const tinyobj::index_t& i1 = mesh.indices[v0 + 1];
+                 const tinyobj::index_t& i2 = mesh.indices[v0 + 2];
+
+                 vec3d vA(&attrib.vertices[3*i0.vertex_index]);
+                 vec3d vB(&attrib.vertices[3*i1.vertex_index]);
+                 vec3d vC(&attrib.vertices[3*i2.vertex_index]);
+                 vec3d nA(&attrib.normals[3*i0.normal_index]);
+                 vec3d nB(&attrib.normals[3*i1.normal_index]);
+                 vec3d nC(&attrib.normals[3*i2.normal_index]);
+                 target.addTriangle(vA, vB, vC, nA, nB, nC);
+                 v0 += vMax;
+             }
+        }
+    };
+
+    // paged where its file is written, built otherwise
+    if (!pagedName.isEmpty()) {
+        addTriangles(shape->m_paged);
+        QString error;
+        if (!shape->m_paged.build(pagedName, &error))
+            tgf::showWarning(QString("Mesh is not paged:\n") + error);
+    }
+    if (shape->m_paged.isEmpty()) {
+        addTriangles(shape->m_mesh);
+        shape->m_mesh.build();
     }
 
-    if (shape->m_bvh) delete shape->m_bvh;
-    shape->m_bvh = new BVH(&shape->m_triangles, 1);
+    if (cacheName.isEmpty()) return;
+    shape->writeCache(cacheName, key);
+    // the mesh of the cache written, shared, in place of the one built
+    if (TriangleMesh::isMappedCaches()) shape->readCache(cacheName, key);
 }
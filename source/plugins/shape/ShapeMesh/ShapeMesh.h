@@ -1,11 +1,14 @@
 #pragma once
 
+#include <QByteArray>
+#include <QFile>
 #include <QSharedPointer>
 #include <Inventor/fields/SoMFInt32.h>
 
 #include "kernel/shape/ShapeRT.h"
 #include "libraries/math/3D/Box3D.h"
-#include "BVH.h"
+#include "kernel/shape/PagedMesh.h"
+#include "kernel/shape/TriangleMesh.h"
 
 class SoIndexedFaceSet;
 
@@ -19,6 +22,9 @@ public:
 
     Box3D getBox(ProfileRT* profile) const;
     bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const;
+    bool intersectP(const Ray& ray, ProfileRT* profile) const;
+    qulonglong getTriangleCount() const;
+    qulonglong getMemoryUsage() const;
 
     SoMFVec3f vertices;
     SoMFVec3f normals;
@@ -33,8 +39,16 @@ protected:
     ~ShapeMesh();
 
     QVector<SoIndexedFaceSet*> m_faceSets;
-    std::vector<Triangle*> m_triangles;
-    BVH* m_bvh;
+    TriangleMesh m_mesh;
+    // with PagedMesh::isPagedMeshes, in place of m_mesh, paged from a file next to the cache
+    PagedMesh m_paged;
+    void clearMesh();
+
+    // binary copy of the parsed file and the built mesh, memory mapped on load;
+    // with TriangleMesh::isMappedCaches the mesh views the file kept mapped
+    bool readCache(const QString& cacheName, const QByteArray& key);
+    void writeCache(const QString& cacheName, const QByteArray& key) const;
+    QSharedPointer<QFile> m_cacheFile;
 
     QSharedPointer<SoNodeSensor> m_sensor;
     static void onSensor(void* data, SoSensor*);
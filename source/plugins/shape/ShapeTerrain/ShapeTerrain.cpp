@@ -0,0 +1,228 @@
+#include "ShapeTerrain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <Inventor/sensors/SoNodeSensor.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoNormal.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+
+#include "kernel/node/TonatiuhFunctions.h"
+#include "kernel/scene/MaterialGL.h"
+#include "kernel/scene/MeshLevelsNode.h"
+#include "kernel/scene/TShapeKit.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "libraries/auxiliary/LayoutTable.h"
+#include "libraries/math/3D/Box3D.h"
+#include "libraries/math/3D/Ray.h"
+
+SO_NODE_SOURCE(ShapeTerrain)
+
+
+void ShapeTerrain::initClass()
+{
+    SO_NODE_INIT_CLASS(ShapeTerrain, ShapeRT, "ShapeRT");
+}
+
+ShapeTerrain::ShapeTerrain()
+{
+    SO_NODE_CONSTRUCTOR(ShapeTerrain);
+    isBuiltIn = TRUE;
+
+    SO_NODE_ADD_FIELD( file, ("") );
+
+    m_sensor = QSharedPointer<SoNodeSensor>::create(onSensor, this);
+    m_sensor->setPriority(0);
+    m_sensor->attach(this);
+    onSensor(this, 0);
+}
+
+Box3D ShapeTerrain::getBox(ProfileRT* profile) const
+{
+    Q_UNUSED(profile)
+    return m_heightfield.getBox();
+}
+
+bool ShapeTerrain::intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const
+{
+    Q_UNUSED(profile)
+    if (m_heightfield.isEmpty()) return false;
+    double tHitT = ray.tMax;
+    DifferentialGeometry dgT;
+    if (!m_heightfield.intersect(ray, &tHitT, &dgT)) return false;
+
+    if (tHit == 0 && dg == 0) return true;
+    if (tHit == 0 || dg == 0) gcf::SevereError("ShapeTerrain::intersect");
+
+    *tHit = tHitT;
+    *dg = dgT;
+    dg->shape = this;
+    return true;
+}
+
+bool ShapeTerrain::intersectP(const Ray& ray, ProfileRT* profile) const
+{
+    Q_UNUSED(profile)
+    return m_heightfield.intersectP(ray);
+}
+
+bool ShapeTerrain::findHeight(double x, double y, double* z, ProfileRT* profile) const
+{
+    Q_UNUSED(profile)
+    return m_heightfield.findHeight(x, y, z);
+}
+
+qulonglong ShapeTerrain::getTriangleCount() const
+{
+    return m_heightfield.getTriangleCount();
+}
+
+qulonglong ShapeTerrain::getMemoryUsage() const
+{
+    return m_heightfield.getMemoryUsage();
+}
+
+// the arrays of the view are made here and left to Coin
+void ShapeTerrain::updateShapeGL(TShapeKit* parent)
+{
+    SoShapeKit* shapeKit = parent->m_shapeKit;
+    MaterialGL* mGL = (MaterialGL*) parent->material.getValue();
+    const bool reverseNormals = mGL->reverseNormals.getValue();
+
+    const int nx = m_heightfield.getCountX();
+    const int ny = m_heightfield.getCountY();
+    std::vector<SbVec3f> vertices(nx*ny);
+    std::vector<SbVec3f> normals(nx*ny);
+    for (int i = 0; i < nx; ++i)
+        for (int j = 0; j < ny; ++j) {
+            int n = i*ny + j;
+            float point[3];
+            float normal[3];
+            m_heightfield.getVertex(i, j, point, normal);
+            vertices[n].setValue(point);
+            normals[n].setValue(normal);
+        }
+
+    std::vector<int> faces;
+    faces.reserve(nx > 1 && ny > 1 ? 8*(nx - 1)*(ny - 1) : 0);
+    for (int i = 0; i + 1 < nx; ++i)
+        for (int j = 0; j + 1 < ny; ++j) {
+            int iA = i*ny + j;
+            int iB = iA + ny;
+            int iC = iB + 1;
+            int iD = iA + 1;
+            faces.insert(faces.end(), {iA, iB, iC, -1, iA, iC, iD, -1});
+        }
+
+    SoCoordinate3* sVertices = new SoCoordinate3;
+    sVertices->point.setValues(0, int(vertices.size()), vertices.data());
+    shapeKit->setPart("coordinate3", sVertices);
+
+    SoNormal* sNormals = new SoNormal;
+    sNormals->vector.setValues(0, int(normals.size()), normals.data());
+    if (reverseNormals) {
+        for (int n = 0; n < sNormals->vector.getNum(); ++n) {
+            const SbVec3f& v = *sNormals->vector.getValues(n);
+            sNormals->vector.set1Value(n, -v[0], -v[1], -v[2]);
+        }
+    }
+    shapeKit->setPart("normal", sNormals);
+
+    SoIndexedFaceSet* sMesh = new SoIndexedFaceSet;
+    sMesh->coordIndex.setValues(0, int(faces.size()), faces.data());
+    shapeKit->setPart("shape", MeshLevelsNode::makeShape(sMesh, vertices.data(), int(vertices.size()),
+                                                         normals.data(), reverseNormals));
+}
+
+ShapeTerrain::~ShapeTerrain()
+{
+}
+
+void ShapeTerrain::onSensor(void* data, SoSensor*)
+{
+    ShapeTerrain* shape = (ShapeTerrain*) data;
+    shape->m_heightfield.clear();
+
+    QString fileName = shape->file.getValue().getString();
+    if (fileName.isEmpty()) return;
+
+    fileName = QString("project:") + fileName;
+    QFileInfo info(fileName);
+    if (!info.exists()) {
+        tgf::showWarning(QString("File not found:\n") + fileName);
+        return;
+    }
+
+    QFile file(info.absoluteFilePath());
+    if (!file.open(QIODevice::ReadOnly)) return;
+    const qint64 size = file.size();
+    const char* text = size > 0 ? reinterpret_cast<const char*>(file.map(0, size)) : nullptr;
+    if (!text) return;
+
+    // the first line, vertices along x and y
+    const char* lineEnd = text;
+    while (lineEnd < text + size && *lineEnd != '\n') ++lineEnd;
+    QStringList header = QString::fromUtf8(text, lineEnd - text).split(',');
+    bool okX = false;
+    bool okY = false;
+    const int nx = header.size() >= 2 ? header[0].trimmed().toInt(&okX) : 0;
+    const int ny = header.size() >= 2 ? header[1].trimmed().toInt(&okY) : 0;
+    if (!okX || !okY || nx < 2 || ny < 2) {
+        tgf::showWarning(QString("The first line of the terrain is not the grid size:\n") + fileName);
+        return;
+    }
+    const bool hasNormals = header.size() >= 3 && header[2].trimmed().toInt() >= 6;
+
+    std::vector<int> columns = {0, 1, 2};
+    if (hasNormals) columns.insert(columns.end(), {3, 4, 5});
+    std::vector<std::vector<double>> values;
+    std::string error;
+    if (!LayoutTable::read(text, size_t(size), 1, columns, &values, &error)) {
+        tgf::showWarning(fileName + ":\n" + QString::fromStdString(error));
+        return;
+    }
+    const int nv = nx*ny;
+    if (int(values[0].size()) != nv) {
+        tgf::showWarning(QString("The terrain has %1 rows for %2 x %3 vertices:\n").arg(values[0].size()).arg(nx).arg(ny) + fileName);
+        return;
+    }
+
+    std::vector<float> points(3*nv);
+    std::vector<float> normals(3*nv);
+    for (int n = 0; n < nv; ++n)
+        for (int k = 0; k < 3; ++k)
+            points[3*n + k] = float(values[k][n]);
+
+    for (int i = 0; i < nx; ++i)
+        for (int j = 0; j < ny; ++j) {
+            int n = i*ny + j;
+            vec3d normal;
+            if (hasNormals) {
+                normal = vec3d(values[3][n], values[4][n], values[5][n]);
+            } else {
+                // central differences, one-sided at the border
+                int iA = std::max(i - 1, 0), iB = std::min(i + 1, nx - 1);
+                int jA = std::max(j - 1, 0), jB = std::min(j + 1, ny - 1);
+                const float* pA = &points[3*(iA*ny + j)];
+                const float* pB = &points[3*(iB*ny + j)];
+                const float* qA = &points[3*(i*ny + jA)];
+                const float* qB = &points[3*(i*ny + jB)];
+                double dzdx = (pB[2] - pA[2])/(pB[0] - pA[0]);
+                double dzdy = (qB[2] - qA[2])/(qB[1] - qA[1]);
+                normal = vec3d(-dzdx, -dzdy, 1.);
+            }
+            normal.normalize();
+            normals[3*n] = float(normal.x);
+            normals[3*n + 1] = float(normal.y);
+            normals[3*n + 2] = float(normal.z);
+        }
+
+    if (!shape->m_heightfield.build(nx, ny, points.data(), normals.data()))
+        tgf::showWarning(QString("The terrain is not a grid with x changing slowest:\n") + fileName);
+}
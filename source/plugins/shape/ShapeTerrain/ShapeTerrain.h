@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QSharedPointer>
+
+#include "kernel/shape/ShapeRT.h"
+#include "kernel/shape/Heightfield.h"
+
+
+//! ShapeTerrain is ground elevation sampled on a regular grid.
+/*!
+ * The file is a CSV as terrain.csv of the Proteas example: a first line
+ * with the vertices along x and y, then a row x, y, z per vertex, x
+ * changing slowest, with the normal nx, ny, nz when the row has six
+ * columns. Missing normals are taken from central differences.
+ *
+ * The grid is traced as a Heightfield, whose min and max z over blocks of
+ * 2^k cells skip the ground the rays pass above, and findHeight reads the
+ * elevation at a point from its cell, for placing heliostat foundations.
+ * Only the elevations, the grid lines and the normals are kept, where a
+ * triangulated OBJ of the same grid keeps two triangles per cell.
+ */
+class ShapeTerrain: public ShapeRT
+{
+    SO_NODE_HEADER(ShapeTerrain);
+
+public:
+    static void initClass();
+    ShapeTerrain();
+
+    Box3D getBox(ProfileRT* profile) const;
+    bool intersect(const Ray& ray, double* tHit, DifferentialGeometry* dg, ProfileRT* profile) const;
+    bool intersectP(const Ray& ray, ProfileRT* profile) const;
+    bool findHeight(double x, double y, double* z, ProfileRT* profile) const;
+    qulonglong getTriangleCount() const;
+    qulonglong getMemoryUsage() const;
+
+    SoSFString file;
+
+    NAME_ICON_FUNCTIONS("Terrain", ":/ShapeTerrain.png")
+    void updateShapeGL(TShapeKit* parent);
+
+protected:
+    ~ShapeTerrain();
+
+    Heightfield m_heightfield;
+
+    QSharedPointer<SoNodeSensor> m_sensor;
+    static void onSensor(void* data, SoSensor*);
+};
+
+
+
+class ShapeTerrainFactory:
+    public QObject, public ShapeFactoryT<ShapeTerrain>
+{
+    Q_OBJECT
+    Q_INTERFACES(ShapeFactory)
+    Q_PLUGIN_METADATA(IID "tonatiuh.ShapeFactory")
+};
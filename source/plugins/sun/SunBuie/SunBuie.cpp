@@ -1,5 +1,7 @@
 #include "SunBuie.h"
 
+#include <cmath>
+
 #include <Inventor/sensors/SoNodeSensor.h>
 #include "libraries/math/gcf.h"
 
@@ -7,6 +9,15 @@
 const double SunBuie::s_csrMin = 0.000001;
 const double SunBuie::s_csrMax = 0.849;
 
+namespace
+{
+const int SegmentsSD = 512;
+const int SegmentsCS = 512;
+const int GuideSize = 1024;
+// rays whose uniforms are drawn before their directions are computed
+const int Block = 64;
+}
+
 
 SO_NODE_SOURCE(SunBuie)
 
@@ -45,12 +56,57 @@ void SunBuie::updateState(double csrValue)
     double m_integralB = (exp(m_k)*pow(1000, m_gamma)/gammaPlusTwo) * ( pow(m_thetaCS, gammaPlusTwo) - pow(m_thetaSD, gammaPlusTwo) );
     m_alpha = 1./(m_integralA + m_integralB);
 
-    m_heightSD = 1.001*pdfTheta(0.0038915695846209047);
-    m_heightCS = pdfTheta(m_thetaSD);
+    makeTable();
+}
 
-    double areaA = m_thetaSD*m_heightSD;
-    double areaB = m_deltaThetaCSSD*m_heightCS;
-    m_probabilitySD = areaA/(areaA + areaB);
+/*!
+ * Tabulates the pdf of theta at nodes uniform over the solar disk and in
+ * geometric progression over the circumsolar region, where it falls as a
+ * power. The two regions meet at a node, so the step of the pdf at the
+ * disk edge is kept. The cdf comes from the trapezoids, so the table is
+ * normalized by construction.
+ */
+void SunBuie::makeTable()
+{
+    m_segments.clear();
+    m_segments.reserve(SegmentsSD + SegmentsCS);
+
+    // the left limit at the disk edge
+    auto pdfSD = [this](double theta) {
+        return m_alpha*cos(326.*theta)/cos(308.*theta)*sin(theta);
+    };
+
+    double cdf = 0.;
+    for (int n = 0; n < SegmentsSD; ++n) {
+        double theta0 = m_thetaSD*n/SegmentsSD;
+        double theta1 = m_thetaSD*(n + 1)/SegmentsSD;
+        Segment segment = {theta0, theta1 - theta0, pdfSD(theta0), pdfSD(theta1), cdf};
+        cdf += 0.5*(segment.pdf0 + segment.pdf1)*segment.width;
+        m_segments.push_back(segment);
+    }
+    double ratio = m_thetaCS/m_thetaSD;
+    for (int n = 0; n < SegmentsCS; ++n) {
+        double theta0 = m_thetaSD*pow(ratio, double(n)/SegmentsCS);
+        double theta1 = n + 1 < SegmentsCS ? m_thetaSD*pow(ratio, double(n + 1)/SegmentsCS) : m_thetaCS;
+        Segment segment = {theta0, theta1 - theta0, pdfTheta(theta0), pdfTheta(theta1), cdf};
+        cdf += 0.5*(segment.pdf0 + segment.pdf1)*segment.width;
+        m_segments.push_back(segment);
+    }
+
+    for (Segment& segment : m_segments) {
+        segment.pdf0 /= cdf;
+        segment.pdf1 /= cdf;
+        segment.cdf /= cdf;
+    }
+
+    m_guide.resize(GuideSize);
+    int index = 0;
+    for (int g = 0; g < GuideSize; ++g) {
+        double u = double(g)/GuideSize;
+        while (index + 1 < int(m_segments.size()) && m_segments[index + 1].cdf <= u)
+            ++index;
+        m_guide[g] = index;
+    }
 }
 
 SunBuie::~SunBuie()
@@ -61,7 +117,7 @@ SunBuie::~SunBuie()
 vec3d SunBuie::generateRay(Random& rand) const
 {
     double phi = gcf::TwoPi*rand.RandomDouble();
-    double theta = zenithAngle(rand);
+    double theta = zenithAngle(rand.RandomDouble());
     double sinTheta = sin(theta);
     double cosTheta = cos(theta);
     double cosPhi = cos(phi);
@@ -74,6 +130,28 @@ vec3d SunBuie::generateRay(Random& rand) const
     );
 }
 
+// the uniforms of a block are drawn in the order of generateRay,
+// then the table lookups and directions run without the generator
+void SunBuie::generateRays(Random& rand, std::span<vec3d> directions) const
+{
+    double phis[Block];
+    double us[Block];
+    for (std::size_t a = 0; a < directions.size(); a += Block)
+    {
+        const int size = int(qMin<std::size_t>(Block, directions.size() - a));
+        for (int n = 0; n < size; ++n) {
+            phis[n] = rand.RandomDouble();
+            us[n] = rand.RandomDouble();
+        }
+        for (int n = 0; n < size; ++n) {
+            double phi = gcf::TwoPi*phis[n];
+            double theta = zenithAngle(us[n]);
+            double sinTheta = sin(theta);
+            directions[a + n] = vec3d(sinTheta*cos(phi), sinTheta*sin(phi), cos(theta));
+        }
+    }
+}
+
 double SunBuie::getThetaMax() const
 {
     return m_thetaCS;
@@ -100,29 +178,28 @@ SoNode* SunBuie::copy(SbBool copyConnections) const
     sun->m_thetaCS = m_thetaCS;
     sun->m_deltaThetaCSSD = m_deltaThetaCSSD;
     sun->m_alpha = m_alpha;
-    sun->m_heightSD = m_heightSD;
-    sun->m_heightCS = m_heightCS;
-    sun->m_probabilitySD = m_probabilitySD;
+    sun->m_segments = m_segments;
+    sun->m_guide = m_guide;
 
     return sun;
 }
 
-double SunBuie::zenithAngle(Random& rand) const
+// one uniform per ray: the guide finds the segment, the linear pdf is inverted in it
+double SunBuie::zenithAngle(double u) const
 {
-	double theta;
-	double value;
-
-    do {
-        if (rand.RandomDouble() < m_probabilitySD) {
-            theta = rand.RandomDouble()*m_thetaSD;
-            value = rand.RandomDouble()*m_heightSD;
-        } else {
-            theta = m_thetaSD + rand.RandomDouble()*m_deltaThetaCSSD;
-            value = rand.RandomDouble()*m_heightCS;
-		}
-    } while (value > pdfTheta(theta));
-
-	return theta;
+    int n = m_guide[qMin(int(u*GuideSize), GuideSize - 1)];
+    int nMax = int(m_segments.size()) - 1;
+    while (n < nMax && m_segments[n + 1].cdf <= u)
+        ++n;
+
+    const Segment& segment = m_segments[n];
+    double mass = qMax(u - segment.cdf, 0.);
+    // solves pdf0*t + (pdf1 - pdf0)*t^2/(2*width) = mass without cancellation
+    double slope = (segment.pdf1 - segment.pdf0)/segment.width;
+    double root = sqrt(qMax(segment.pdf0*segment.pdf0 + 2.*slope*mass, 0.));
+    double denominator = segment.pdf0 + root;
+    double t = denominator > 0. ? 2.*mass/denominator : 0.;
+    return segment.theta + qMin(t, segment.width);
 }
 
 double SunBuie::chiValue(double csr) const
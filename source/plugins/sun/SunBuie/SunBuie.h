@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "kernel/sun/SunShape.h"
 
 
@@ -13,6 +15,7 @@ public:
     SoNode* copy(SbBool copyConnections) const;
 
     vec3d generateRay(Random& rand) const;
+    void generateRays(Random& rand, std::span<vec3d> directions) const;
     double getThetaMax() const;
     double shape(double theta) const;
 
@@ -26,8 +29,9 @@ protected:
      double chiValue(double csr) const;
      double phi(double theta) const;
      double pdfTheta(double theta) const;
-     double zenithAngle(Random& rand) const;
+     double zenithAngle(double u) const;
      void updateState(double csrValue);
+     void makeTable();
 
 	 double m_chi;
 	 double m_k;
@@ -39,9 +43,20 @@ protected:
      double m_deltaThetaCSSD; // difference
 
 	 double m_alpha;
-     double m_heightSD;
-     double m_heightCS;
-     double m_probabilitySD;
+
+     // inverse cdf of theta: the pdf is taken linear over each segment,
+     // uniform on the solar disk and geometric on the circumsolar region
+     struct Segment
+     {
+         double theta;
+         double width;
+         double pdf0; // at theta
+         double pdf1; // at theta + width
+         double cdf; // at theta
+     };
+     std::vector<Segment> m_segments;
+     // first segment of every 1/n of the cdf
+     std::vector<int> m_guide;
 
      static const double s_csrMin;
      static const double s_csrMax;
@@ -6,6 +6,12 @@
 
 SO_NODE_SOURCE(SunGaussian)
 
+namespace
+{
+// rays whose angles are drawn before their directions are computed
+const int Block = 64;
+}
+
 void SunGaussian::initClass()
 {
     SO_NODE_INIT_CLASS(SunGaussian, SunShape, "SunShape");
@@ -52,6 +58,27 @@ vec3d SunGaussian::generateRay(Random& rand) const
     );
 }
 
+// the rejection loop draws a varying count of uniforms, so the angles of a
+// block are drawn in the order of generateRay and only the directions are
+// computed apart
+void SunGaussian::generateRays(Random& rand, std::span<vec3d> directions) const
+{
+    double phis[Block];
+    double thetas[Block];
+    for (std::size_t a = 0; a < directions.size(); a += Block)
+    {
+        const int size = int(qMin<std::size_t>(Block, directions.size() - a));
+        for (int n = 0; n < size; ++n) {
+            phis[n] = gcf::TwoPi*rand.RandomDouble();
+            thetas[n] = zenithAngle(rand);
+        }
+        for (int n = 0; n < size; ++n) {
+            double sinTheta = sin(thetas[n]);
+            directions[a + n] = vec3d(sinTheta*cos(phis[n]), sinTheta*sin(phis[n]), cos(thetas[n]));
+        }
+    }
+}
+
 double SunGaussian::getThetaMax() const
 {
     return m_thetaMax;
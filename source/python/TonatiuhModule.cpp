@@ -0,0 +1,375 @@
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QThread>
+
+#include <Inventor/fields/SoField.h>
+
+#include "core/CorePluginRegistry.h"
+#include "core/FirstBounceCache.h"
+#include "core/RayTraceRunner.h"
+#include "core/SceneEditor.h"
+#include "core/SceneLoader.h"
+#include "core/TonatiuhCore.h"
+#include "kernel/run/FluxAccumulator.h"
+#include "kernel/scene/TSceneKit.h"
+
+namespace py = pybind11;
+
+namespace
+{
+
+// Qt, Coin and the scene plugins, once per process
+struct Engine
+{
+    std::unique_ptr<QCoreApplication> application;
+    std::unique_ptr<CorePluginRegistry> plugins;
+};
+
+Engine& engine()
+{
+    static Engine s_engine;
+    if (!s_engine.application && !QCoreApplication::instance()) {
+        static int argc = 1;
+        static char name[] = "tonatiuhpp";
+        static char* argv[] = {name, nullptr};
+        s_engine.application.reset(new QCoreApplication(argc, argv));
+    }
+    return s_engine;
+}
+
+// the plugins next to the module, as next to the executable, and in directories
+void loadPlugins(const QStringList& directories = QStringList())
+{
+    Engine& e = engine();
+    TonatiuhCore::initializeCoin();
+    if (e.plugins && directories.isEmpty())
+        return;
+    if (!e.plugins) {
+        e.plugins.reset(new CorePluginRegistry);
+        const QString module = QString::fromStdString(py::module_::import("tonatiuhpp").attr("__file__").cast<std::string>());
+        e.plugins->loadScenePlugins(TonatiuhCore::pluginSearchPaths(QFileInfo(module).absolutePath()));
+    }
+    if (!directories.isEmpty())
+        e.plugins->loadScenePlugins(directories);
+}
+
+[[noreturn]] void fail(const QString& message)
+{
+    throw std::runtime_error(message.toStdString());
+}
+
+// numbers as exact decimals, sequences of them as the space-separated vectors of Inventor
+QString fieldText(const py::handle& value)
+{
+    if (py::isinstance<py::bool_>(value))
+        return value.cast<bool>() ? QStringLiteral("TRUE") : QStringLiteral("FALSE");
+    if (py::isinstance<py::int_>(value) || py::isinstance<py::float_>(value))
+        return QString::number(value.cast<double>(), 'g', 17);
+    if (py::isinstance<py::str>(value))
+        return QString::fromStdString(value.cast<std::string>());
+    if (py::isinstance<py::sequence>(value) || py::isinstance<py::array>(value)) {
+        QStringList items;
+        for (const py::handle& item : value)
+            items << fieldText(item);
+        return items.join(' ');
+    }
+    throw py::type_error("A field value must be a str, number, bool or a sequence of numbers.");
+}
+
+// flux targets as dictionaries {surface, side, rows, cols}
+void addFluxTargets(const py::list& targets, FluxAccumulator* flux)
+{
+    for (const py::handle& item : targets) {
+        if (!py::isinstance<py::dict>(item))
+            throw py::value_error("A flux target must be a dict with surface, side, rows and cols.");
+        const py::dict target = py::reinterpret_borrow<py::dict>(item);
+        if (!target.contains("surface") || !target.contains("rows") || !target.contains("cols"))
+            throw py::value_error("A flux target needs surface, rows and cols.");
+        const std::string side = target.contains("side") ? target["side"].cast<std::string>() : "front";
+        if (side != "front" && side != "back")
+            throw py::value_error("The side of a flux target must be \"front\" or \"back\".");
+        const int rows = target["rows"].cast<int>();
+        const int cols = target["cols"].cast<int>();
+        if (rows < 1 || cols < 1 || double(rows)*cols > 1.e7)
+            throw py::value_error("A flux grid needs 1 to 10000000 cells.");
+        flux->addTarget(QString::fromStdString(target["surface"].cast<std::string>()), side == "front", rows, cols);
+    }
+}
+
+// variants as lists of (url, field, value) edits of the materials of surfaces
+void addVariants(const py::list& variants, const FluxAccumulator& flux, std::vector<std::unique_ptr<FluxAccumulator>>* accumulators,
+                 RayTraceOptions* options)
+{
+    for (const py::handle& item : variants) {
+        RayTraceVariant variant;
+        for (const py::handle& entry : item.cast<py::sequence>()) {
+            const py::sequence edit = entry.cast<py::sequence>();
+            if (edit.size() != 3)
+                throw py::value_error("A variant edit must be (url, field, value).");
+            variant.edits.push_back(RayTraceMaterialEdit{
+                QString::fromStdString(edit[0].cast<std::string>()),
+                QString::fromStdString(edit[1].cast<std::string>()),
+                fieldText(edit[2])
+            });
+        }
+        accumulators->emplace_back(new FluxAccumulator);
+        for (int n = 0; n < flux.getTargetCount(); ++n) {
+            const FluxAccumulator::Target& target = flux.getTarget(n);
+            accumulators->back()->addTarget(target.url, target.isFront, target.rows, target.cols, target.window);
+        }
+        variant.fluxAccumulator = accumulators->back().get();
+        options->variants.push_back(variant);
+    }
+}
+
+py::list makeGrids(const RayTraceResult& result, const FluxAccumulator& flux, bool convolution)
+{
+    py::list grids;
+    for (int n = 0; n < flux.getTargetCount(); ++n) {
+        const FluxAccumulator::Target& target = flux.getTarget(n);
+        const Box2D& box = flux.getBox(n);
+        // the accumulator writes into the array Python gets, with rows along u
+        py::array_t<double> grid({py::ssize_t(target.rows), py::ssize_t(target.cols)});
+        flux.getFlux(n, result.powerPerRay, grid.mutable_data());
+
+        py::dict item;
+        item["surface"] = target.url.toStdString();
+        item["side"] = target.isFront ? "front" : "back";
+        item["u_min"] = box.min().x;
+        item["u_max"] = box.max().x;
+        item["v_min"] = box.min().y;
+        item["v_max"] = box.max().y;
+        item["hits"] = flux.getHits(n);
+        // a convolution places weights in W and no hits
+        item["power"] = convolution ? flux.getTotalWeight(n) : double(flux.getHits(n))*result.powerPerRay;
+        item["flux"] = grid;
+        grids.append(item);
+    }
+    return grids;
+}
+
+py::dict makeResult(const RayTraceResult& result, const FluxAccumulator& flux, bool powerBudget, bool convolution)
+{
+    py::dict ans;
+    ans["rays_traced"] = result.raysTraced;
+    ans["elapsed_seconds"] = result.elapsedSeconds;
+    ans["rays_per_second"] = result.raysPerSecond;
+    ans["worker_count"] = result.workerCount;
+    ans["sun_aperture_area"] = result.sunApertureArea;
+    ans["irradiance"] = result.irradiance;
+    ans["power_per_ray"] = result.powerPerRay;
+    ans["flux"] = makeGrids(result, flux, convolution);
+
+    if (powerBudget) {
+        const PowerBudget& budget = result.powerBudget;
+        const py::ssize_t count = budget.getSurfaceCount();
+        py::array_t<double> sides({count, py::ssize_t(2), py::ssize_t(3)});
+        auto values = sides.mutable_unchecked<3>();
+        py::list surfaces;
+        for (int n = 0; n < count; ++n) {
+            surfaces.append(result.powerBudgetSurfaces.value(n).toStdString());
+            for (int f = 0; f < 2; ++f) {
+                const PowerBudget::Side& side = budget.getSide(n, f == 0);
+                values(n, f, 0) = side.incident;
+                values(n, f, 1) = side.absorbed;
+                values(n, f, 2) = side.reflected;
+            }
+        }
+        py::dict item;
+        item["emitted"] = budget.getTotal();
+        item["absorbed"] = budget.getAbsorbed();
+        item["missed"] = budget.getMissed();
+        item["escaped"] = budget.getEscaped();
+        item["air"] = budget.getAir();
+        item["roulette"] = budget.getRoulette();
+        item["surfaces"] = surfaces;
+        item["sides"] = sides;
+        ans["power_budget"] = item;
+    }
+    return ans;
+}
+
+}
+
+//! PythonScene is a scene kept loaded in Python for repeated edited traces.
+class PythonScene
+{
+public:
+    explicit PythonScene(const std::string& fileName):
+        m_fileName(QFileInfo(QString::fromStdString(fileName)).absoluteFilePath()),
+        m_scene(new LoadedScene)
+    {
+        loadPlugins();
+        engine().plugins->loadScenePluginsFor(m_fileName);
+        TonatiuhCore::setProjectSearchPaths(m_fileName);
+        QString errorMessage;
+        if (!SceneLoader::readFile(m_fileName, m_scene.get(), &errorMessage))
+            fail(QString("Cannot load %1: %2").arg(m_fileName, errorMessage));
+    }
+
+    void setField(const std::string& url, const std::string& field, const py::object& value)
+    {
+        const QString text = fieldText(value);
+        QString errorMessage;
+        SoField* target = SceneEditor::findField(m_scene->get(), QString::fromStdString(url), QString::fromStdString(field), &errorMessage);
+        if (!target)
+            throw py::key_error(errorMessage.toStdString());
+        if (!SceneEditor::setField(target, text))
+            throw py::value_error(QString("\"%1\" is not a value of %2 of %3.").arg(text, QString::fromStdString(field), QString::fromStdString(url)).toStdString());
+        m_edited = true;
+    }
+
+    std::string getField(const std::string& url, const std::string& field) const
+    {
+        QString errorMessage;
+        SoField* target = SceneEditor::findField(m_scene->get(), QString::fromStdString(url), QString::fromStdString(field), &errorMessage);
+        if (!target)
+            throw py::key_error(errorMessage.toStdString());
+        SbString text;
+        target->get(text);
+        return text.getString();
+    }
+
+    void setSun(double azimuth, double elevation)
+    {
+        QString errorMessage;
+        if (!SceneEditor::setSun(m_scene->get(), azimuth, elevation, &errorMessage))
+            throw py::value_error(errorMessage.toStdString());
+        m_edited = true;
+    }
+
+    py::dict trace(ulong rays, ulong seed, int workers, const py::list& flux, bool powerBudget, const std::string& model,
+                   bool reuseFirstBounces, const py::object& symmetryPlane, const py::object& translationAxis,
+                   const py::list& variants)
+    {
+        if (model != "monte_carlo" && model != "convolution")
+            throw py::value_error("model must be \"monte_carlo\" or \"convolution\".");
+        const bool convolution = model == "convolution";
+        if (rays < 1 && !convolution)
+            throw py::value_error("rays must be greater than zero.");
+
+        FluxAccumulator accumulator;
+        addFluxTargets(flux, &accumulator);
+
+        RayTraceOptions options;
+        options.rays = rays;
+        options.seed = seed;
+        options.workerCount = workers > 0 ? workers : qMax(1, QThread::idealThreadCount());
+        options.chunkSize = 10000;
+        options.outputMode = RayTraceOutputMode::NoOutput;
+        if (accumulator.getTargetCount() > 0) {
+            options.outputMode = RayTraceOutputMode::FluxGrid;
+            options.fluxAccumulator = &accumulator;
+        }
+        options.powerBudget = powerBudget;
+        if (convolution)
+            options.fluxModel = RayTraceFluxModel::Convolution;
+        if (reuseFirstBounces && !convolution)
+            options.firstBounceCache = &m_firstBounces;
+        // (nx, ny, nz, offset) of the plane dot(n, p) = offset
+        if (!symmetryPlane.is_none()) {
+            const std::vector<double> plane = symmetryPlane.cast<std::vector<double>>();
+            if (plane.size() != 4)
+                throw py::value_error("symmetry_plane must be (nx, ny, nz, offset).");
+            options.symmetryNormal = vec3d(plane[0], plane[1], plane[2]);
+            options.symmetryOffset = plane[3];
+            if (options.symmetryNormal.norm2() == 0.)
+                throw py::value_error("symmetry_plane must have a nonzero normal.");
+        }
+        // "x", "y" or "z" of an extrusion traced as one period
+        if (!translationAxis.is_none()) {
+            const std::string axis = translationAxis.cast<std::string>();
+            if (axis != "x" && axis != "y" && axis != "z")
+                throw py::value_error("translation_axis must be \"x\", \"y\" or \"z\".");
+            options.translationAxis = axis[0] - 'x';
+        }
+
+        // the same rays for every variant, drawn again where they meet an edited material
+        std::vector<std::unique_ptr<FluxAccumulator>> variantFluxes;
+        if (!variants.empty()) {
+            if (convolution)
+                throw py::value_error("variants need model=\"monte_carlo\".");
+            if (accumulator.getTargetCount() == 0)
+                throw py::value_error("variants need flux targets.");
+            addVariants(variants, accumulator, &variantFluxes, &options);
+            options.randomGenerator = RayTraceRandomGenerator::RayIndexed;
+        }
+
+        // edits since the previous trace only
+        TSceneKit* scene = m_scene->get();
+        if (m_edited) {
+            SceneEditor::followEdits(scene);
+            m_edited = false;
+        }
+        TonatiuhCore::setProjectSearchPaths(m_fileName);
+
+        RayTraceResult result;
+        QString errorMessage;
+        bool traced = false;
+        {
+            py::gil_scoped_release release;
+            RayTraceRunner runner;
+            traced = runner.trace(scene, options, &result, &errorMessage);
+        }
+        if (!traced)
+            fail(QString("Cannot trace %1: %2").arg(m_fileName, errorMessage));
+        py::dict ans = makeResult(result, accumulator, powerBudget, convolution);
+        if (options.firstBounceCache) {
+            ans["first_bounce_cache_recorded"] = result.firstBounceCacheRecorded;
+            ans["first_bounces_reused"] = result.firstBouncesReused;
+        }
+        if (!variantFluxes.empty()) {
+            py::list grids;
+            for (const std::unique_ptr<FluxAccumulator>& variantFlux : variantFluxes)
+                grids.append(makeGrids(result, *variantFlux, false));
+            ans["variants"] = grids;
+        }
+        return ans;
+    }
+
+    std::string getFileName() const {return m_fileName.toStdString();}
+
+private:
+    QString m_fileName;
+    std::unique_ptr<LoadedScene> m_scene;
+    bool m_edited = false;
+    // of the last trace with reuse_first_bounces
+    FirstBounceCache m_firstBounces;
+};
+
+PYBIND11_MODULE(tonatiuhpp, m)
+{
+    m.doc() = "Tonatiuh++ scenes loaded once and traced in process.";
+
+    m.def("load_plugins", [](const std::vector<std::string>& directories) {
+        QStringList paths;
+        for (const std::string& directory : directories)
+            paths << QDir(QString::fromStdString(directory)).absolutePath();
+        loadPlugins(paths);
+    }, py::arg("directories"), "Loads the scene plugins of the directories besides those next to the module.");
+
+    py::class_<PythonScene>(m, "Scene")
+        .def(py::init<const std::string&>(), py::arg("file_name"))
+        .def_property_readonly("file_name", &PythonScene::getFileName)
+        .def("set_field", &PythonScene::setField, py::arg("url"), py::arg("field"), py::arg("value"),
+             "Sets a field of the layout node at url, as part.field for a part of a node kit.")
+        .def("get_field", &PythonScene::getField, py::arg("url"), py::arg("field"))
+        .def("set_sun", &PythonScene::setSun, py::arg("azimuth"), py::arg("elevation"),
+             "Sets the sun position in degrees.")
+        .def("trace", &PythonScene::trace, py::arg("rays"), py::arg("seed") = 0, py::arg("workers") = 0,
+             py::arg("flux") = py::list(), py::arg("power_budget") = false, py::arg("model") = "monte_carlo",
+             py::arg("reuse_first_bounces") = false, py::arg("symmetry_plane") = py::none(),
+             py::arg("translation_axis") = py::none(), py::arg("variants") = py::list(),
+             "Traces the scene as edited; flux grids come back as NumPy arrays of W/m2.");
+}
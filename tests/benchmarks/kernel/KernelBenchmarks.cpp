@@ -0,0 +1,409 @@
+// Micro-benchmarks of the ray tracing primitives on fixed synthetic inputs.
+// Prints one JSON document (schema tonatiuhpp.kernel_benchmarks.v1) with the
+// median and fastest time per operation of every benchmark.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <Inventor/SoDB.h>
+#include <Inventor/nodekits/SoNodeKit.h>
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include "kernel/material/MaterialRough.h"
+#include "kernel/node/TNode.h"
+#include "kernel/profiles/ProfileRectangular.h"
+#include "kernel/random/RandomSTL.h"
+#include "kernel/scene/TSceneKit.h"
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/ShapeParabolic.h"
+#include "kernel/shape/Triangle.h"
+#include "kernel/shape/TriangleMesh.h"
+#include "libraries/Coin3D/MFVec2.h"
+#include "libraries/Coin3D/UserMField.h"
+#include "libraries/Coin3D/UserSField.h"
+#include "libraries/math/2D/Box2D.h"
+#include "libraries/math/3D/Box3D.h"
+#include "libraries/math/3D/Ray.h"
+#include "libraries/math/3D/Transform.h"
+#include "libraries/math/CpuDispatch.h"
+#include "sun/SunBuie/SunBuie.h"
+
+namespace
+{
+const int InputCount = 4096;
+const quint64 InputSeed = 20240601;
+
+// splitmix64, so the inputs are the same on every standard library
+class Inputs
+{
+public:
+    explicit Inputs(quint64 seed): m_state(seed) {}
+
+    double uniform(double a = 0., double b = 1.)
+    {
+        quint64 z = (m_state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+        z ^= z >> 31;
+        return a + (b - a)*double(z >> 11)*0x1.0p-53;
+    }
+
+private:
+    quint64 m_state;
+};
+
+// rays from above z = height aimed at [-extent, extent]^2 on z = 0
+std::vector<Ray> makeRays(double height, double extent, double spread)
+{
+    Inputs inputs(InputSeed);
+    std::vector<Ray> rays;
+    rays.reserve(InputCount);
+    for (int n = 0; n < InputCount; ++n) {
+        const double x = inputs.uniform(-extent, extent);
+        const double y = inputs.uniform(-extent, extent);
+        const vec3d target(x, y, 0.);
+        const double dx = inputs.uniform(-spread, spread);
+        const double dy = inputs.uniform(-spread, spread);
+        const vec3d origin = target + vec3d(dx, dy, 1.)*height;
+        rays.push_back(Ray(origin, (target - origin).normalized()));
+    }
+    return rays;
+}
+
+struct Options
+{
+    double minTime = 0.5; // seconds per benchmark
+    int repetitions = 5;
+    QString filter;
+    QString output;
+};
+
+struct Result
+{
+    QString name;
+    int batch;
+    qint64 operations;
+    double nsMedian;
+    double nsMin;
+    double checksum;
+};
+
+// run(batch) does batch operations and returns a sum of their outputs; the
+// checksum is that of the first batch after setup, so it depends on the
+// inputs alone
+using Benchmark = std::function<double()>;
+
+Result measure(const QString& name, int batch, const std::function<Benchmark()>& setup, const Options& options)
+{
+    using Clock = std::chrono::steady_clock;
+
+    Benchmark run = setup();
+    Result result;
+    result.name = name;
+    result.batch = batch;
+    result.operations = 0;
+    result.checksum = run();
+
+    volatile double sink = 0.;
+    std::vector<double> samples;
+    const double sampleTime = options.minTime/options.repetitions;
+    for (int r = 0; r < options.repetitions; ++r) {
+        qint64 operations = 0;
+        double seconds = 0.;
+        const Clock::time_point start = Clock::now();
+        do {
+            sink = sink + run();
+            operations += batch;
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (seconds < sampleTime);
+        samples.push_back(1e9*seconds/double(operations));
+        result.operations += operations;
+    }
+    std::sort(samples.begin(), samples.end());
+    result.nsMedian = samples[samples.size()/2];
+    result.nsMin = samples.front();
+    return result;
+}
+
+void initializeTypes()
+{
+    SoDB::init();
+    SoNodeKit::init();
+    UserMField::initClass();
+    UserSField::initClass();
+    MFVec2::initClass();
+    TNode::initClass();
+    TSceneKit::initClass();
+    ShapeParabolic::initClass();
+    ProfileRectangular::initClass();
+    MaterialRough::initClass();
+    SunBuie::initClass();
+}
+
+Benchmark box3DIntersect()
+{
+    const Box3D box(vec3d(-1., -1., -1.), vec3d(1., 1., 1.));
+    std::vector<Ray> rays = makeRays(5., 1.5, 1.);
+    return [box, rays]() {
+        double sum = 0.;
+        for (const Ray& ray : rays) {
+            double t0, t1;
+            if (box.intersect(ray, &t0, &t1))
+                sum += t1 - t0;
+        }
+        return sum;
+    };
+}
+
+Benchmark transformInverse()
+{
+    const Transform transform = Transform::translate(3., -2., 5.)*Transform::rotateZ(0.7)*Transform::rotateX(-0.3);
+    std::vector<Ray> rays = makeRays(5., 1.5, 1.);
+    return [transform, rays]() {
+        double sum = 0.;
+        for (const Ray& ray : rays) {
+            const Ray local = transform.transformInverse(ray);
+            sum += local.origin.x + local.direction().z;
+        }
+        return sum;
+    };
+}
+
+Benchmark triangleIntersect()
+{
+    const vec3d nz(0., 0., 1.);
+    const Triangle triangle(vec3d(-1., -1., 0.), vec3d(1., -1., 0.), vec3d(0., 1., 0.), nz, nz, nz);
+    std::vector<Ray> rays = makeRays(5., 1., 0.5);
+    return [triangle, rays]() {
+        double sum = 0.;
+        for (const Ray& ray : rays) {
+            double t;
+            DifferentialGeometry dg;
+            if (triangle.intersect(ray, &t, &dg))
+                sum += t;
+        }
+        return sum;
+    };
+}
+
+// height field z = sin(x)cos(y)/4 over [-8, 8]^2 in 8192 triangles
+Benchmark meshIntersect()
+{
+    auto mesh = std::make_shared<TriangleMesh>();
+    auto point = [](int i, int j) {
+        const double x = 0.25*i;
+        const double y = 0.25*j;
+        return vec3d(x, y, 0.25*std::sin(x)*std::cos(y));
+    };
+    const vec3d nz(0., 0., 1.);
+    for (int i = -32; i < 32; ++i)
+        for (int j = -32; j < 32; ++j) {
+            mesh->addTriangle(point(i, j), point(i + 1, j), point(i + 1, j + 1), nz, nz, nz);
+            mesh->addTriangle(point(i, j), point(i + 1, j + 1), point(i, j + 1), nz, nz, nz);
+        }
+    mesh->build();
+
+    std::vector<Ray> rays = makeRays(10., 8., 0.5);
+    return [mesh, rays]() {
+        double sum = 0.;
+        for (const Ray& ray : rays) {
+            double t;
+            DifferentialGeometry dg;
+            if (mesh->intersect(ray, &t, &dg))
+                sum += t;
+        }
+        return sum;
+    };
+}
+
+template<class T>
+std::shared_ptr<T> makeNode()
+{
+    T* node = new T;
+    node->ref();
+    return std::shared_ptr<T>(node, [](T* n) {n->unref();});
+}
+
+Benchmark parabolicIntersect()
+{
+    auto shape = makeNode<ShapeParabolic>();
+    shape->fX = 4.;
+    shape->fY = 4.;
+    auto profile = makeNode<ProfileRectangular>();
+    profile->setBox(Box2D(vec2d(-2., -2.), vec2d(2., 2.)));
+
+    std::vector<Ray> rays = makeRays(10., 2.5, 0.2);
+    return [shape, profile, rays]() {
+        double sum = 0.;
+        for (const Ray& ray : rays) {
+            double t;
+            DifferentialGeometry dg;
+            if (shape->intersect(ray, &t, &dg, profile.get()))
+                sum += t;
+        }
+        return sum;
+    };
+}
+
+Benchmark sunBuieGenerateRay()
+{
+    auto sun = makeNode<SunBuie>(); // csr 0.02
+    auto rand = std::make_shared<RandomSTL>(InputSeed, InputCount);
+    return [sun, rand]() {
+        double sum = 0.;
+        for (int n = 0; n < InputCount; ++n)
+            sum += sun->generateRay(*rand).z;
+        return sum;
+    };
+}
+
+Benchmark randomFillArray()
+{
+    auto rand = std::make_shared<RandomSTL>(InputSeed, 1);
+    auto array = std::make_shared<std::vector<double>>(InputCount);
+    return [rand, array]() {
+        rand->FillArray(*array);
+        double sum = 0.;
+        for (double x : *array)
+            sum += x;
+        return sum;
+    };
+}
+
+Benchmark materialRoughOutputRay()
+{
+    auto material = makeNode<MaterialRough>();
+    material->diffuse = 0.1;
+    material->specular = 0.9;
+    material->roughness = 0.01;
+    auto rand = std::make_shared<RandomSTL>(InputSeed, InputCount);
+
+    DifferentialGeometry dg;
+    dg.point = vec3d(0., 0., 0.);
+    dg.dpdu = vec3d(1., 0., 0.);
+    dg.dpdv = vec3d(0., 1., 0.);
+    dg.normal = vec3d(0., 0., 1.);
+    dg.isFront = true;
+    std::vector<Ray> rays = makeRays(5., 0., 1.);
+    return [material, rand, dg, rays]() {
+        double sum = 0.;
+        Ray rayOut;
+        for (const Ray& ray : rays)
+            if (material->OutputRay(ray, dg, *rand, rayOut))
+                sum += rayOut.direction().z;
+        return sum;
+    };
+}
+
+bool parseArguments(const QStringList& arguments, Options* options)
+{
+    for (int n = 1; n < arguments.size(); ++n) {
+        const QString& argument = arguments[n];
+        const bool hasValue = n + 1 < arguments.size();
+        if (argument == "--quick") {
+            options->minTime = 0.02;
+            options->repetitions = 1;
+        } else if (argument == "--min-time" && hasValue) {
+            bool ok = false;
+            options->minTime = arguments[++n].toDouble(&ok);
+            if (!ok || !(options->minTime > 0.)) return false;
+        } else if (argument == "--repetitions" && hasValue) {
+            bool ok = false;
+            options->repetitions = arguments[++n].toInt(&ok);
+            if (!ok || options->repetitions < 1) return false;
+        } else if (argument == "--filter" && hasValue)
+            options->filter = arguments[++n];
+        else if (argument == "--output" && hasValue)
+            options->output = arguments[++n];
+        else
+            return false;
+    }
+    return true;
+}
+}
+
+int main(int argc, char** argv)
+{
+    QStringList arguments;
+    for (int n = 0; n < argc; ++n)
+        arguments << QString::fromLocal8Bit(argv[n]);
+
+    Options options;
+    if (!parseArguments(arguments, &options)) {
+        std::fprintf(stderr,
+            "Usage: tonatiuhpp_kernel_benchmarks [--quick] [--min-time SECONDS] [--repetitions N]\n"
+            "                                    [--filter TEXT] [--output FILE]\n");
+        return 2;
+    }
+
+    initializeTypes();
+
+    struct Entry {
+        const char* name;
+        int batch;
+        std::function<Benchmark()> setup;
+    };
+    const std::vector<Entry> entries = {
+        {"Box3D::intersect", InputCount, box3DIntersect},
+        {"Transform::transformInverse", InputCount, transformInverse},
+        {"Triangle::intersect", InputCount, triangleIntersect},
+        {"TriangleMesh::intersect", InputCount, meshIntersect},
+        {"ShapeParabolic::intersect", InputCount, parabolicIntersect},
+        {"SunBuie::generateRay", InputCount, sunBuieGenerateRay},
+        {"RandomSTL::FillArray", InputCount, randomFillArray},
+        {"MaterialRough::OutputRay", InputCount, materialRoughOutputRay},
+    };
+
+    QJsonArray results;
+    for (const Entry& entry : entries) {
+        const QString name = entry.name;
+        if (!options.filter.isEmpty() && !name.contains(options.filter, Qt::CaseInsensitive))
+            continue;
+
+        const Result result = measure(name, entry.batch, entry.setup, options);
+        QJsonObject object;
+        object["name"] = result.name;
+        object["batch"] = result.batch;
+        object["operations"] = double(result.operations);
+        object["ns_per_op"] = result.nsMedian;
+        object["ns_per_op_min"] = result.nsMin;
+        object["ops_per_second"] = 1e9/result.nsMedian;
+        object["checksum"] = result.checksum;
+        results.append(object);
+
+        if (!options.output.isEmpty())
+            std::printf("%-30s %10.2f ns/op (min %.2f)\n", qPrintable(result.name), result.nsMedian, result.nsMin);
+    }
+
+    QJsonObject root;
+    root["schema"] = "tonatiuhpp.kernel_benchmarks.v1";
+    root["input_count"] = InputCount;
+    root["input_seed"] = double(InputSeed);
+    root["min_time_seconds"] = options.minTime;
+    root["repetitions"] = options.repetitions;
+    root["simd_path"] = CpuDispatch::name();
+    root["results"] = results;
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    if (options.output.isEmpty()) {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+        return 0;
+    }
+    QFile file(options.output);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+        std::fprintf(stderr, "Cannot write %s: %s\n", qPrintable(options.output), qPrintable(file.errorString()));
+        return 1;
+    }
+    return 0;
+}
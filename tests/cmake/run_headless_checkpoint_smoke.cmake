@@ -0,0 +1,75 @@
+if(NOT DEFINED TEST_EXECUTABLE OR TEST_EXECUTABLE STREQUAL "")
+  message(FATAL_ERROR "TEST_EXECUTABLE is required.")
+endif()
+
+if(NOT DEFINED SCENE_FILE OR SCENE_FILE STREQUAL "")
+  message(FATAL_ERROR "SCENE_FILE is required.")
+endif()
+
+if(NOT DEFINED OUTPUT_DIR OR OUTPUT_DIR STREQUAL "")
+  message(FATAL_ERROR "OUTPUT_DIR is required.")
+endif()
+
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+file(TO_CMAKE_PATH "${OUTPUT_DIR}/trace.tnck" _checkpoint_file)
+file(REMOVE "${_checkpoint_file}")
+
+set(_working_directory)
+if(DEFINED TEST_WORKING_DIRECTORY AND NOT TEST_WORKING_DIRECTORY STREQUAL "")
+  set(_working_directory WORKING_DIRECTORY "${TEST_WORKING_DIRECTORY}")
+endif()
+
+# the first run saves every chunk, the second finds them all done
+foreach(_run 1 2)
+  execute_process(
+    COMMAND "${TEST_EXECUTABLE}" --headless trace-scene "${SCENE_FILE}" --rays 10 --seed 123456789 --no-export
+      --checkpoint "${_checkpoint_file}" --resume
+    ${_working_directory}
+    RESULT_VARIABLE _exit_code
+    OUTPUT_VARIABLE _stdout
+    ERROR_VARIABLE _stderr
+  )
+
+  if(NOT "${_exit_code}" STREQUAL "0")
+    message(STATUS "stdout:\n${_stdout}")
+    message(STATUS "stderr:\n${_stderr}")
+    message(FATAL_ERROR "Expected checkpointed trace ${_run} to exit 0, got ${_exit_code}.")
+  endif()
+
+  if(_run EQUAL 1)
+    set(_resumed "resumed_chunks: 0")
+  else()
+    set(_resumed "resumed_chunks: 1")
+  endif()
+  foreach(_pattern
+      "Trace completed\\."
+      "rays_traced: 10"
+      "${_resumed}"
+      "resumed_rays:"
+      "checkpoints_written: 1")
+    if(NOT _stdout MATCHES "${_pattern}")
+      message(STATUS "stdout:\n${_stdout}")
+      message(STATUS "stderr:\n${_stderr}")
+      message(FATAL_ERROR "Checkpointed trace ${_run} output did not match: ${_pattern}")
+    endif()
+  endforeach()
+
+  if(NOT EXISTS "${_checkpoint_file}")
+    message(FATAL_ERROR "Checkpointed trace ${_run} did not write ${_checkpoint_file}.")
+  endif()
+endforeach()
+
+# a checkpoint of other options is refused
+execute_process(
+  COMMAND "${TEST_EXECUTABLE}" --headless trace-scene "${SCENE_FILE}" --rays 10 --seed 1 --no-export
+    --checkpoint "${_checkpoint_file}" --resume
+  ${_working_directory}
+  RESULT_VARIABLE _exit_code
+  OUTPUT_VARIABLE _stdout
+  ERROR_VARIABLE _stderr
+)
+if(NOT "${_exit_code}" STREQUAL "1")
+  message(STATUS "stdout:\n${_stdout}")
+  message(STATUS "stderr:\n${_stderr}")
+  message(FATAL_ERROR "Expected a resume with another seed to exit 1, got ${_exit_code}.")
+endif()
@@ -0,0 +1,59 @@
+if(NOT DEFINED TEST_EXECUTABLE OR TEST_EXECUTABLE STREQUAL "")
+  message(FATAL_ERROR "TEST_EXECUTABLE is required.")
+endif()
+
+if(NOT DEFINED SCENE_FILE OR SCENE_FILE STREQUAL "")
+  message(FATAL_ERROR "SCENE_FILE is required.")
+endif()
+
+if(NOT DEFINED OUTPUT_DIR OR OUTPUT_DIR STREQUAL "")
+  message(FATAL_ERROR "OUTPUT_DIR is required.")
+endif()
+
+# the cache is written next to the scene, so trace a copy
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+file(TO_CMAKE_PATH "${OUTPUT_DIR}/scene.tnhpp" _scene_file)
+configure_file("${SCENE_FILE}" "${_scene_file}" COPYONLY)
+file(REMOVE "${_scene_file}.cache")
+
+set(_working_directory)
+if(DEFINED TEST_WORKING_DIRECTORY AND NOT TEST_WORKING_DIRECTORY STREQUAL "")
+  set(_working_directory WORKING_DIRECTORY "${TEST_WORKING_DIRECTORY}")
+endif()
+
+# the first run writes the cache, the second reads it and traces the same rays
+foreach(_run 1 2)
+  execute_process(
+    COMMAND "${TEST_EXECUTABLE}" --headless trace-scene "${_scene_file}" --rays 10 --seed 123456789 --no-export --scene-cache
+    ${_working_directory}
+    RESULT_VARIABLE _exit_code
+    OUTPUT_VARIABLE _stdout
+    ERROR_VARIABLE _stderr
+  )
+
+  if(NOT "${_exit_code}" STREQUAL "0")
+    message(STATUS "stdout:\n${_stdout}")
+    message(STATUS "stderr:\n${_stderr}")
+    message(FATAL_ERROR "Expected cached trace ${_run} to exit 0, got ${_exit_code}.")
+  endif()
+
+  if(_run EQUAL 1)
+    set(_cache "scene_cache: miss")
+  else()
+    set(_cache "scene_cache: hit")
+  endif()
+  foreach(_pattern
+      "Trace completed\\."
+      "rays_traced: 10"
+      "${_cache}")
+    if(NOT _stdout MATCHES "${_pattern}")
+      message(STATUS "stdout:\n${_stdout}")
+      message(STATUS "stderr:\n${_stderr}")
+      message(FATAL_ERROR "Cached trace ${_run} output did not match: ${_pattern}")
+    endif()
+  endforeach()
+
+  if(NOT EXISTS "${_scene_file}.cache")
+    message(FATAL_ERROR "Cached trace ${_run} did not write ${_scene_file}.cache.")
+  endif()
+endforeach()
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "SunPath/data/CsvScanner.h"
+
+using sp::CsvScanner;
+
+TEST(CsvScannerTest, SplitsLinesAndFields)
+{
+    const std::string text = "a,b,,c\r\n1,2\n\nlast";
+    CsvScanner scanner(text.data(), text.data() + text.size());
+    EXPECT_EQ(scanner.countLines(), 4);
+
+    ASSERT_TRUE(scanner.nextLine());
+    EXPECT_EQ(scanner.line(), "a,b,,c");
+    ASSERT_EQ(scanner.fieldCount(), 4);
+    EXPECT_EQ(scanner.field(2), "");
+    EXPECT_EQ(scanner.field(3), "c");
+    EXPECT_EQ(scanner.countLines(), 3);
+
+    ASSERT_TRUE(scanner.nextLine());
+    EXPECT_EQ(scanner.fieldCount(), 2);
+    ASSERT_TRUE(scanner.nextLine());
+    EXPECT_EQ(scanner.line(), "");
+    EXPECT_EQ(scanner.fieldCount(), 1);
+    ASSERT_TRUE(scanner.nextLine());
+    EXPECT_EQ(scanner.line(), "last");
+    EXPECT_FALSE(scanner.nextLine());
+}
+
+TEST(CsvScannerTest, ReadsNumbersAsQString)
+{
+    const std::string text = " 12 ,+7,-3,1.5e2, +0.25,x,1.5,,2010x";
+    CsvScanner scanner(text.data(), text.data() + text.size());
+    ASSERT_TRUE(scanner.nextLine());
+
+    int n = 0;
+    EXPECT_TRUE(scanner.toInt(0, &n));
+    EXPECT_EQ(n, 12);
+    EXPECT_TRUE(scanner.toInt(1, &n));
+    EXPECT_EQ(n, 7);
+    EXPECT_TRUE(scanner.toInt(2, &n));
+    EXPECT_EQ(n, -3);
+    EXPECT_FALSE(scanner.toInt(5, &n));
+    EXPECT_FALSE(scanner.toInt(6, &n));
+    EXPECT_FALSE(scanner.toInt(7, &n));
+    EXPECT_FALSE(scanner.toInt(8, &n));
+    EXPECT_FALSE(scanner.toInt(9, &n));
+    EXPECT_FALSE(scanner.toInt(-1, &n));
+
+    double x = 0.;
+    EXPECT_TRUE(scanner.toDouble(3, &x));
+    EXPECT_DOUBLE_EQ(x, 150.);
+    EXPECT_TRUE(scanner.toDouble(4, &x));
+    EXPECT_DOUBLE_EQ(x, 0.25);
+    EXPECT_FALSE(scanner.toDouble(5, &x));
+    EXPECT_FALSE(scanner.toDouble(7, &x));
+}
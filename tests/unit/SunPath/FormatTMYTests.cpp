@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include "SunPath/calculators/SunCalculatorMB.h"
+#include "SunPath/data/FormatTMY.h"
+
+using namespace sp;
+
+namespace {
+
+// a day of hourly records, with CRLF ends and a field around the ones read
+QString writeTMY(const QTemporaryDir& dir)
+{
+    const QString fileName = dir.filePath("day.csv");
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) return QString();
+    QTextStream out(&file);
+    out << "Source,Latitude,Longitude,Time Zone\r\n";
+    out << "TMY3,37.1,-2.35,1\r\n";
+    out << "Year,Month,Day,Hour,Minute,DNI[W/m2],GHI\r\n";
+    for (int h = 0; h < 24; ++h) {
+        double dni = h > 6 && h < 19 ? 900.*(1. - (h - 12.5)*(h - 12.5)/40.) : 0.;
+        out << "2010,6,21," << h << ",30, " << dni << ",0\r\n";
+    }
+    return fileName;
+}
+
+} // namespace
+
+TEST(FormatTMYTest, MappedReaderMatchesTextStream)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString fileName = writeTMY(dir);
+    ASSERT_FALSE(fileName.isEmpty());
+
+    ParamsTMY params;
+    params.cache = false;
+
+    SunCalculatorMB calculatorA;
+    SunTemporal temporalA(calculatorA);
+    params.mapped = false;
+    FormatTMY formatA(&temporalA);
+    ASSERT_TRUE(formatA.read(fileName, params)) << formatA.message().toStdString();
+
+    SunCalculatorMB calculatorB;
+    SunTemporal temporalB(calculatorB);
+    params.mapped = true;
+    FormatTMY formatB(&temporalB);
+    ASSERT_TRUE(formatB.read(fileName, params)) << formatB.message().toStdString();
+
+    EXPECT_EQ(temporalA.calculator()->location().offsetUTC(), temporalB.calculator()->location().offsetUTC());
+    EXPECT_DOUBLE_EQ(temporalA.calculator()->location().latitude(), temporalB.calculator()->location().latitude());
+    EXPECT_DOUBLE_EQ(temporalA.calculator()->location().longitude(), temporalB.calculator()->location().longitude());
+
+    const QVector<TimeStamp>& tsA = temporalA.timeStamps();
+    const QVector<TimeStamp>& tsB = temporalB.timeStamps();
+    ASSERT_EQ(tsA.size(), 25);
+    ASSERT_EQ(tsA.size(), tsB.size());
+    for (int n = 0; n < tsA.size(); ++n) {
+        EXPECT_EQ(tsA[n].t, tsB[n].t);
+        EXPECT_DOUBLE_EQ(tsA[n].s.x, tsB[n].s.x);
+        EXPECT_DOUBLE_EQ(tsA[n].s.y, tsB[n].s.y);
+        EXPECT_DOUBLE_EQ(tsA[n].s.z, tsB[n].s.z);
+        EXPECT_DOUBLE_EQ(tsA[n].tc, tsB[n].tc);
+    }
+    EXPECT_EQ(temporalA.data(), temporalB.data());
+}
+
+TEST(FormatTMYTest, MappedReaderReportsTheLine)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString fileName = dir.filePath("bad.csv");
+    QFile file(fileName);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write("Source,Latitude,Longitude,Time Zone\n"
+               "TMY3,37.1,-2.35,1\n"
+               "Year,Month,Day,Hour,Minute,DNI\n"
+               "2010,6,21,1,0,0\n"
+               "2010,6,x,2,0,0\n");
+    file.close();
+
+    ParamsTMY params;
+    params.cache = false;
+    SunCalculatorMB calculator;
+    SunTemporal temporal(calculator);
+    FormatTMY format(&temporal);
+    EXPECT_FALSE(format.read(fileName, params));
+    EXPECT_TRUE(format.message().contains("2010,6,x,2,0,0"));
+}
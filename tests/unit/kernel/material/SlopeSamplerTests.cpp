@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "kernel/material/SlopeSampler.h"
+
+namespace
+{
+// the deviations of reflected rays from the mirror reflection of the sun axis,
+// within the plane of incidence and across it, each sorted
+struct Deviations
+{
+    std::vector<double> inPlane;
+    std::vector<double> across;
+};
+
+// rays of a pillbox sun at incidence angle theta on the mirror z = 0, x in the
+// plane of incidence, reflected about the normal tilted by Gaussian errors of
+// sigma drawn by the polar method of MaterialSpecular, or by sampler
+Deviations reflect(double theta, double sigma, const SlopeSampler* sampler, int n)
+{
+    std::mt19937_64 engine(sampler ? 13 : 17);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const vec3d normal(0.0, 0.0, 1.0);
+    const vec3d tangent(1.0, 0.0, 0.0);
+    const vec3d axis(std::sin(theta), 0.0, -std::cos(theta));
+    const vec3d ideal = axis.reflected(normal);
+    const vec3d across(0.0, 1.0, 0.0);
+    const vec3d inPlane = cross(across, ideal);
+
+    Deviations ans;
+    for (int i = 0; i < n; ++i) {
+        const double phi = 2.0*M_PI*uniform(engine);
+        const double sinSun = std::sin(4.65e-3)*std::sqrt(uniform(engine));
+        const vec3d sun = SlopeSampler::toFrame(vec3d(sinSun*std::cos(phi), sinSun*std::sin(phi), std::sqrt(1.0 - sinSun*sinSun)), axis, across);
+
+        vec3d reflected;
+        if (sampler) {
+            const double u = uniform(engine);
+            reflected = sampler->reflect(sun, normal, tangent, u, uniform(engine));
+        } else {
+            double x, y, r2;
+            do {
+                x = 2.0*uniform(engine) - 1.0;
+                y = 2.0*uniform(engine) - 1.0;
+                r2 = x*x + y*y;
+            } while (r2 > 1.0 || r2 == 0.0);
+            const double k = sigma*std::sqrt(-2.0*std::log(r2)/r2);
+            reflected = sun.reflected(vec3d(k*x, k*y, 1.0).normalized());
+        }
+        ans.inPlane.push_back(std::asin(dot(reflected, inPlane)));
+        ans.across.push_back(std::asin(dot(reflected, across)));
+    }
+    std::sort(ans.inPlane.begin(), ans.inPlane.end());
+    std::sort(ans.across.begin(), ans.across.end());
+    return ans;
+}
+
+double deviation(const std::vector<double>& values)
+{
+    double sum = 0.0;
+    for (double v : values)
+        sum += v*v;
+    return std::sqrt(sum/values.size());
+}
+}
+
+TEST(SlopeSamplerTest, SamplesAreUnitVectors)
+{
+    const SlopeSampler gaussian(SlopeSampler::Gaussian, 0.01);
+    const SlopeSampler pillbox(SlopeSampler::pillbox, 0.01);
+
+    for (double u : {0.0, 0.25, 0.5, 0.98, 0.999999})
+        for (double v : {0.0, 0.3, 0.999}) {
+            EXPECT_NEAR(gaussian.sample(u, v).norm(), 1.0, 1e-12);
+            EXPECT_NEAR(pillbox.sample(u, v).norm(), 1.0, 1e-12);
+        }
+}
+
+TEST(SlopeSamplerTest, GaussianTangentsHaveTheDeviation)
+{
+    const double sigma = 0.003;
+    const SlopeSampler sampler(SlopeSampler::Gaussian, sigma);
+    std::mt19937_64 engine(7);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    const int n = 200000;
+    double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumYY = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double u = uniform(engine);
+        double v = uniform(engine);
+        const vec3d s = sampler.sample(u, v);
+        const double x = s.x/s.z;
+        const double y = s.y/s.z;
+        sumX += x;
+        sumY += y;
+        sumXX += x*x;
+        sumYY += y*y;
+    }
+
+    EXPECT_NEAR(sumX/n, 0.0, 0.02*sigma);
+    EXPECT_NEAR(sumY/n, 0.0, 0.02*sigma);
+    EXPECT_NEAR(std::sqrt(sumXX/n), sigma, 0.01*sigma);
+    EXPECT_NEAR(std::sqrt(sumYY/n), sigma, 0.01*sigma);
+}
+
+TEST(SlopeSamplerTest, GaussianTableMatchesTheInverseDistribution)
+{
+    const double sigma = 0.5;
+    const SlopeSampler sampler(SlopeSampler::Gaussian, sigma);
+
+    for (double u = 0.0; u < 1.0; u += 0.0173) {
+        const vec3d s = sampler.sample(u, 0.0);
+        const double r = sigma*std::sqrt(-2.0*std::log(1.0 - u));
+        EXPECT_NEAR(s.x/s.z, r, 2e-3*sigma) << "u = " << u;
+        EXPECT_NEAR(s.y/s.z, 0.0, 1e-12);
+    }
+}
+
+TEST(SlopeSamplerTest, PillboxStaysInsideTheCone)
+{
+    const double sigma = 0.02;
+    const SlopeSampler sampler(SlopeSampler::pillbox, sigma);
+
+    for (double u = 0.0; u < 1.0; u += 0.01)
+        for (double v = 0.0; v < 1.0; v += 0.07)
+            EXPECT_GE(sampler.sample(u, v).z, std::cos(sigma) - 1e-15);
+    EXPECT_NEAR(sampler.sample(0.25, 0.0).x, 0.5*std::sin(sigma), 1e-6);
+}
+
+TEST(SlopeSamplerTest, FrameMapsAxesOrthonormally)
+{
+    const vec3d n = vec3d(1.0, 2.0, 2.0).normalized();
+    const vec3d t(1.0, 0.0, 0.0);
+
+    const vec3d z = SlopeSampler::toFrame(vec3d(0.0, 0.0, 1.0), n, t);
+    const vec3d x = SlopeSampler::toFrame(vec3d(1.0, 0.0, 0.0), n, t);
+    const vec3d y = SlopeSampler::toFrame(vec3d(0.0, 1.0, 0.0), n, t);
+
+    EXPECT_NEAR((z - n).norm(), 0.0, 1e-15);
+    EXPECT_NEAR(x.norm(), 1.0, 1e-15);
+    EXPECT_NEAR(y.norm(), 1.0, 1e-15);
+    EXPECT_NEAR(dot(x, n), 0.0, 1e-15);
+    EXPECT_NEAR(dot(y, n), 0.0, 1e-15);
+    EXPECT_NEAR(dot(x, y), 0.0, 1e-15);
+    EXPECT_GT(dot(x, t), 0.0);
+
+    // a tangent along the axis falls back to any orthogonal one
+    const vec3d w = SlopeSampler::toFrame(vec3d(0.6, 0.0, 0.8), n, n);
+    EXPECT_NEAR(w.norm(), 1.0, 1e-15);
+    EXPECT_NEAR(dot(w, n), 0.8, 1e-15);
+}
+
+TEST(SlopeSamplerTest, ReflectsAsTheMaterialAtObliqueIncidence)
+{
+    const double sigma = 2e-3;
+    const SlopeSampler sampler(SlopeSampler::Gaussian, sigma);
+    const int n = 200000;
+
+    for (double degrees : {0.0, 30.0, 60.0}) {
+        const double theta = degrees*M_PI/180.0;
+        const Deviations traced = reflect(theta, sigma, nullptr, n);
+        const Deviations drawn = reflect(theta, sigma, &sampler, n);
+
+        // the slope errors spread the rays less across the plane of incidence
+        const double inPlane = deviation(traced.inPlane);
+        const double across = deviation(traced.across);
+        const double sun = 4.65e-3/2.0;
+        EXPECT_NEAR(inPlane, std::sqrt(sun*sun + 4.0*sigma*sigma), 0.02*inPlane) << degrees << " degrees";
+        EXPECT_NEAR(across, std::sqrt(sun*sun + 4.0*sigma*sigma*std::cos(theta)*std::cos(theta)), 0.02*across) << degrees << " degrees";
+
+        // the histograms of both deviations match, by their quantiles
+        for (double q : {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99}) {
+            const size_t k = size_t(q*n);
+            EXPECT_NEAR(drawn.inPlane[k], traced.inPlane[k], 0.02*inPlane) << degrees << " degrees, q = " << q;
+            EXPECT_NEAR(drawn.across[k], traced.across[k], 0.02*across) << degrees << " degrees, q = " << q;
+        }
+    }
+}
+
+TEST(SlopeSamplerTest, ReflectsAboutTheNormalWithoutErrors)
+{
+    const SlopeSampler none;
+    const vec3d d = vec3d(0.6, 0.0, -0.8);
+    const vec3d r = none.reflect(d, vec3d(0.0, 0.0, 1.0), vec3d(1.0, 0.0, 0.0), 0.3, 0.7);
+    EXPECT_NEAR((r - vec3d(0.6, 0.0, 0.8)).norm(), 0.0, 1e-15);
+}
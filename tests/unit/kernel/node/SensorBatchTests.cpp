@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "kernel/node/SensorBatch.h"
+
+namespace {
+
+// a node whose callback logs its name
+struct Node
+{
+    std::string name;
+    std::string* log;
+};
+
+void update(void* data, SoSensor*)
+{
+    if (SensorBatch::defer(update, data)) return;
+    Node* node = static_cast<Node*>(data);
+    *node->log += node->name;
+}
+
+void rebuild(void* data, SoSensor*)
+{
+    if (SensorBatch::defer(rebuild, data)) return;
+    Node* node = static_cast<Node*>(data);
+    *node->log += node->name + "!";
+}
+
+} // namespace
+
+TEST(SensorBatchTest, CallsOutsideABatchRunAtOnce)
+{
+    std::string log;
+    Node a{"a", &log};
+    EXPECT_FALSE(SensorBatch::isActive());
+    update(&a, nullptr);
+    update(&a, nullptr);
+    EXPECT_EQ(log, "aa");
+}
+
+TEST(SensorBatchTest, HoldsEachCallbackOnceInReverseOrder)
+{
+    std::string log;
+    Node a{"a", &log};
+    Node b{"b", &log};
+    {
+        SensorBatch batch;
+        EXPECT_TRUE(SensorBatch::isActive());
+        update(&a, nullptr);
+        update(&b, nullptr);
+        rebuild(&a, nullptr);
+        update(&a, nullptr);
+        {
+            // only the outermost batch calls them
+            SensorBatch inner;
+            update(&b, nullptr);
+        }
+        EXPECT_EQ(log, "");
+    }
+    EXPECT_FALSE(SensorBatch::isActive());
+    EXPECT_EQ(log, "a!ba");
+
+    // the batch is empty again
+    log.clear();
+    { SensorBatch batch; }
+    EXPECT_EQ(log, "");
+}
+
+TEST(SensorBatchTest, DropsTheCallbacksOfForgottenNodes)
+{
+    std::string log;
+    Node a{"a", &log};
+    Node b{"b", &log};
+    {
+        SensorBatch batch;
+        update(&a, nullptr);
+        update(&b, nullptr);
+        SensorBatch::forget(&a);
+    }
+    EXPECT_EQ(log, "b");
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <QDataStream>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include "kernel/photons/PhotonsFileMap.h"
+#include "PhotonsColumnFile.h"
+
+namespace {
+
+struct Row
+{
+    double x, y, z;
+    bool isFront;
+    quint32 surface;
+};
+
+const std::vector<Row> Rows = {
+    {0.5, 1., -2., true, 1},
+    {1.5, 2., -3., false, 2},
+    {2.5, 3., -4., true, 1},
+    {3.5, 4., -5., true, 0},
+    {4.5, 5., -6., false, 2}
+};
+
+void writeColumns(const QString& path, quint32 flags)
+{
+    PhotonsColumnFile file(path, {
+        {"id", PhotonsColumnFile::UInt64},
+        {"x", PhotonsColumnFile::Float64},
+        {"y", PhotonsColumnFile::Float64},
+        {"z", PhotonsColumnFile::Float64},
+        {"side", PhotonsColumnFile::UInt8},
+        {"surface_id", PhotonsColumnFile::UInt32}
+    }, 2, flags);
+    ASSERT_TRUE(file.open());
+    for (size_t n = 0; n < Rows.size(); ++n) {
+        const Row& row = Rows[n];
+        file.set(0, quint64(n + 1));
+        file.set(1, row.x);
+        file.set(2, row.y);
+        file.set(3, row.z);
+        file.set(4, quint8(row.isFront));
+        file.set(5, row.surface);
+        ASSERT_TRUE(file.endRow());
+    }
+    ASSERT_TRUE(file.finish({"//a", "//b"}, 0.25));
+}
+
+void expectRows(PhotonsFileMap& map)
+{
+    ASSERT_EQ(map.getPhotonCount(), Rows.size());
+    size_t n = 0;
+    for (quint64 b = 0; b < map.getBlockCount(); ++b)
+    {
+        PhotonsFileMap::Block block = map.getBlock(b);
+        ASSERT_GT(block.rows, 0u) << map.getError().toStdString();
+        for (quint64 r = 0; r < block.rows; ++r, ++n) {
+            const Row& row = Rows[n];
+            EXPECT_EQ(block.columns[PhotonsFileMap::X][r], row.x);
+            EXPECT_EQ(block.columns[PhotonsFileMap::Y][r], row.y);
+            EXPECT_EQ(block.columns[PhotonsFileMap::Z][r], row.z);
+            EXPECT_EQ(block.columns[PhotonsFileMap::Side][r], row.isFront ? 1. : 0.);
+            EXPECT_EQ(block.columns[PhotonsFileMap::SurfaceID][r], row.surface);
+        }
+    }
+    EXPECT_EQ(n, Rows.size());
+}
+
+}
+
+TEST(PhotonsFileMapTest, MapsColumnarFiles)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("photons.tnpc");
+    writeColumns(path, PhotonsColumnFile::CoordinatesGlobal);
+
+    PhotonsFileMap map;
+    ASSERT_TRUE(map.open(path)) << map.getError().toStdString();
+    EXPECT_TRUE(map.isCoordinatesGlobal());
+    EXPECT_DOUBLE_EQ(map.getPhotonPower(), 0.25);
+    EXPECT_EQ(map.getBlockCount(), 3u);
+    EXPECT_EQ(map.getSurfaces(), QStringList({"//a", "//b"}));
+    EXPECT_EQ(map.findSurface("//b"), 2u);
+    EXPECT_EQ(map.findSurface("//c"), 0u);
+    expectRows(map);
+}
+
+TEST(PhotonsFileMapTest, InflatesCompressedBlocks)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("photons.tnpc");
+    writeColumns(path, PhotonsColumnFile::Compressed);
+
+    PhotonsFileMap map;
+    ASSERT_TRUE(map.open(path)) << map.getError().toStdString();
+    EXPECT_FALSE(map.isCoordinatesGlobal());
+    EXPECT_EQ(map.getBlockCount(), 3u);
+    expectRows(map);
+}
+
+TEST(PhotonsFileMapTest, MapsVersion1Files)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("photons.tnpc");
+    writeColumns(path, PhotonsColumnFile::CoordinatesGlobal);
+
+    // version 1 headers end before the block index offset
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::ReadWrite));
+    QByteArray data = file.readAll();
+    const int columns = 6;
+    const int dataOffset = qFromLittleEndian<quint64>(data.constData() + 24);
+    QByteArray old = data.left(64);
+    qToLittleEndian<quint32>(1, old.data() + 8);
+    old += data.mid(PhotonsColumnFile::HeaderSize, columns*PhotonsColumnFile::ColumnSize);
+    old += QByteArray(dataOffset - old.size(), '\0');
+    old += data.mid(dataOffset);
+    ASSERT_TRUE(file.resize(0) && file.seek(0));
+    ASSERT_EQ(file.write(old), old.size());
+    file.close();
+
+    PhotonsFileMap map;
+    ASSERT_TRUE(map.open(path)) << map.getError().toStdString();
+    EXPECT_EQ(map.getBlockCount(), 3u);
+    EXPECT_EQ(map.getSurfaces(), QStringList({"//a", "//b"}));
+    expectRows(map);
+}
+
+TEST(PhotonsFileMapTest, MapsRowFilesOfSplitExports)
+{
+    QTemporaryDir dir;
+    {
+        QFile file(dir.filePath("photons_2.dat"));
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+        QDataStream out(&file);
+        for (size_t n = 0; n < Rows.size(); ++n) {
+            const Row& row = Rows[n];
+            out << double(n + 1) << row.x << row.y << row.z << double(row.isFront) << double(row.surface);
+        }
+    }
+    {
+        QFile file(dir.filePath("photons_parameters.txt"));
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly | QIODevice::Text));
+        QTextStream out(&file);
+        out << "START PARAMETERS\nid\nx\ny\nz\nside\nsurface ID\nEND PARAMETERS\n";
+        out << "START SURFACES\n1 //a\n2 //b b\nEND SURFACES\n";
+        out << 0.125;
+    }
+
+    PhotonsFileMap map;
+    ASSERT_TRUE(map.open(dir.filePath("photons_2.dat"), false)) << map.getError().toStdString();
+    EXPECT_FALSE(map.isCoordinatesGlobal());
+    EXPECT_DOUBLE_EQ(map.getPhotonPower(), 0.125);
+    EXPECT_EQ(map.getSurfaces(), QStringList({"//a", "//b b"}));
+    EXPECT_TRUE(map.hasField(PhotonsFileMap::Z));
+    expectRows(map);
+}
+
+TEST(PhotonsFileMapTest, RejectsIncompleteFiles)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("photons.tnpc");
+    writeColumns(path, 0);
+    {
+        QFile file(path);
+        ASSERT_TRUE(file.open(QIODevice::ReadWrite));
+        ASSERT_TRUE(file.resize(200));
+    }
+
+    PhotonsFileMap map;
+    EXPECT_FALSE(map.open(path));
+    EXPECT_FALSE(map.isOpen());
+    EXPECT_FALSE(map.getError().isEmpty());
+
+    QFile rows(dir.filePath("lonely.dat"));
+    ASSERT_TRUE(rows.open(QIODevice::WriteOnly));
+    rows.write(QByteArray(48, '\0'));
+    rows.close();
+    EXPECT_FALSE(map.open(dir.filePath("lonely.dat")));
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+#include "kernel/photons/PhotonsReservoir.h"
+
+namespace {
+
+struct Record
+{
+    int id;
+    const int* surface;
+    double x;
+};
+
+const int SurfaceA = 1;
+const int SurfaceB = 2;
+
+// paths of lengths 1 to 3, their x the number of the path; every fifth
+// path ends on surface B, the others on A
+std::vector<Record> makePaths(int first, int count)
+{
+    std::vector<Record> ans;
+    for (int n = first; n < first + count; ++n) {
+        const int length = 1 + n%3;
+        for (int id = 0; id < length; ++id)
+            ans.push_back(Record{id, (n%5 == 0 && id == length - 1) ? &SurfaceB : &SurfaceA, double(n)});
+    }
+    return ans;
+}
+
+// the path numbers of records, each path once
+std::vector<int> pathNumbers(const std::vector<Record>& records)
+{
+    std::vector<int> ans;
+    for (const Record& record : records)
+        if (record.id == 0)
+            ans.push_back(int(record.x));
+    return ans;
+}
+
+} // namespace
+
+TEST(PhotonsReservoirTests, KeepsEveryPathUnderItsSize)
+{
+    PhotonsReservoir<Record> reservoir(100);
+    reservoir.add(makePaths(0, 30), 0, 0);
+
+    EXPECT_EQ(reservoir.getPathsSeen(), 30u);
+    EXPECT_EQ(reservoir.getPathsKept(), 30u);
+    const std::vector<Record> records = reservoir.getRecords();
+    EXPECT_EQ(records.size(), makePaths(0, 30).size());
+    ASSERT_EQ(reservoir.getStrata().size(), 1u);
+    EXPECT_DOUBLE_EQ(reservoir.getStrata()[0]->getWeight(), 1.);
+}
+
+TEST(PhotonsReservoirTests, KeepsWholePathsWithTheirWeight)
+{
+    PhotonsReservoir<Record> reservoir(50, false, 3);
+    for (ulong chunk = 0; chunk < 20; ++chunk)
+        reservoir.add(makePaths(100*int(chunk), 100), chunk, 0);
+
+    EXPECT_EQ(reservoir.getPathsSeen(), 2000u);
+    EXPECT_EQ(reservoir.getPathsKept(), 50u);
+    EXPECT_DOUBLE_EQ(reservoir.getStrata()[0]->getWeight(), 40.);
+
+    const std::vector<Record> records = reservoir.getRecords();
+    std::map<int, int> lengths;
+    for (const Record& record : records) {
+        EXPECT_EQ(record.id, lengths[int(record.x)]);
+        ++lengths[int(record.x)];
+    }
+    EXPECT_EQ(lengths.size(), 50u);
+    for (const auto& item : lengths)
+        EXPECT_EQ(item.second, 1 + item.first%3);
+}
+
+TEST(PhotonsReservoirTests, MergedWorkersKeepTheSamePaths)
+{
+    PhotonsReservoir<Record> single(40, true, 7);
+    for (ulong chunk = 0; chunk < 12; ++chunk)
+        single.add(makePaths(100*int(chunk), 100), chunk, chunk%2);
+
+    // the chunks split among three workers, merged in another order
+    std::vector<PhotonsReservoir<Record>> workers(3, PhotonsReservoir<Record>(40, true, 7));
+    for (ulong chunk = 0; chunk < 12; ++chunk)
+        workers[(chunk*7)%3].add(makePaths(100*int(chunk), 100), chunk, chunk%2);
+    PhotonsReservoir<Record> merged(40, true, 7);
+    merged.merge(std::move(workers[2]));
+    merged.merge(std::move(workers[0]));
+    merged.merge(std::move(workers[1]));
+
+    EXPECT_EQ(merged.getPathsSeen(), single.getPathsSeen());
+    EXPECT_EQ(pathNumbers(merged.getRecords()), pathNumbers(single.getRecords()));
+}
+
+TEST(PhotonsReservoirTests, StrataKeepTheirOwnPaths)
+{
+    PhotonsReservoir<Record> reservoir(20, true, 5);
+    reservoir.add(makePaths(0, 1000), 0, 0);
+
+    const std::vector<const PhotonsReservoir<Record>::Stratum*> strata = reservoir.getStrata();
+    ASSERT_EQ(strata.size(), 2u);
+    qulonglong seen = 0;
+    for (const PhotonsReservoir<Record>::Stratum* stratum : strata) {
+        EXPECT_EQ(stratum->paths.size(), 20u);
+        EXPECT_DOUBLE_EQ(stratum->getWeight(), stratum->seen/20.);
+        for (const PhotonsReservoir<Record>::Path& path : stratum->paths)
+            EXPECT_EQ(path.records.back().surface, stratum->surface);
+        seen += stratum->seen;
+    }
+    EXPECT_EQ(seen, 1000u);
+    EXPECT_EQ(pathNumbers(reservoir.getRecords()).size(), 40u);
+}
+
+TEST(PhotonsReservoirTests, WeightedCountsAreUnbiased)
+{
+    // paths ending on B, estimated from many samples of different seeds
+    double sum = 0.;
+    const int samples = 200;
+    for (int seed = 1; seed <= samples; ++seed) {
+        PhotonsReservoir<Record> reservoir(50, false, quint64(seed));
+        reservoir.add(makePaths(0, 1000), 0, 0);
+        const double weight = reservoir.getStrata()[0]->getWeight();
+        for (const Record& record : reservoir.getRecords())
+            if (record.surface == &SurfaceB)
+                sum += weight;
+    }
+    EXPECT_NEAR(sum/samples, 200., 12.);
+}
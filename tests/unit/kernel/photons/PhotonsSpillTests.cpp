@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "kernel/photons/PhotonsSpill.h"
+
+namespace {
+
+struct Record
+{
+    double x;
+    quint32 id;
+};
+
+std::vector<Record> makeRecords(quint32 first, quint32 count)
+{
+    std::vector<Record> ans;
+    for (quint32 n = first; n < first + count; ++n)
+        ans.push_back(Record{0.5*n, n});
+    return ans;
+}
+
+} // namespace
+
+TEST(PhotonsSpillTests, AppendMovesRecordsToBlocks)
+{
+    PhotonsSpill<Record> spill;
+    EXPECT_TRUE(spill.isEmpty());
+
+    std::vector<Record> records = makeRecords(0, 3);
+    ASSERT_TRUE(spill.append(records));
+    EXPECT_TRUE(records.empty());
+
+    records = makeRecords(3, 5);
+    ASSERT_TRUE(spill.append(records));
+
+    ASSERT_EQ(spill.size(), 8u);
+    ASSERT_EQ(spill.getBlocks().size(), 2u);
+    EXPECT_EQ(spill.getBlocks()[0].size, 3u);
+    EXPECT_EQ(spill.getBlocks()[1].size, 5u);
+    for (quint32 n = 0; n < 8; ++n) {
+        EXPECT_EQ(spill.at(n).id, n);
+        EXPECT_DOUBLE_EQ(spill.at(n).x, 0.5*n);
+    }
+}
+
+TEST(PhotonsSpillTests, EmptyAppendAddsNoBlock)
+{
+    PhotonsSpill<Record> spill;
+    std::vector<Record> records;
+    EXPECT_TRUE(spill.append(records));
+    EXPECT_TRUE(spill.getBlocks().empty());
+}
+
+TEST(PhotonsSpillTests, ClearStartsAgain)
+{
+    PhotonsSpill<Record> spill;
+    std::vector<Record> records = makeRecords(0, 4);
+    ASSERT_TRUE(spill.append(records));
+    spill.clear();
+    EXPECT_TRUE(spill.isEmpty());
+    EXPECT_TRUE(spill.getBlocks().empty());
+
+    records = makeRecords(10, 2);
+    ASSERT_TRUE(spill.append(records));
+    ASSERT_EQ(spill.size(), 2u);
+    EXPECT_EQ(spill.at(0).id, 10u);
+    EXPECT_EQ(spill.at(1).id, 11u);
+}
+
+TEST(PhotonsSpillTests, FileGrowsByBlock)
+{
+    PhotonsSpillFile file;
+    const char a[] = "abc";
+    const char b[] = "defgh";
+    const uchar* pa = file.append(a, 3);
+    const uchar* pb = file.append(b, 5);
+    ASSERT_TRUE(pa);
+    ASSERT_TRUE(pb);
+    EXPECT_EQ(file.getBytes(), 8);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(pa), 3), "abc");
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(pb), 5), "defgh");
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+#include "kernel/random/SobolSequence.h"
+
+namespace {
+
+// index of the interval of width 2^-bits holding x
+int cell(double x, int bits)
+{
+    return int(x*(1 << bits));
+}
+
+} // namespace
+
+TEST(SobolSequenceTests, ValuesAreInsideTheOpenUnitInterval)
+{
+    SobolSequence sobol(7);
+    for (quint64 n = 0; n < 4096; ++n) {
+        for (int d = 0; d < SobolSequence::Dimensions; ++d) {
+            double x = sobol.sample(n, d);
+            EXPECT_GT(x, 0.);
+            EXPECT_LT(x, 1.);
+        }
+    }
+}
+
+TEST(SobolSequenceTests, AlignedBlocksAreStratifiedInEveryDimension)
+{
+    const int bits = 10;
+    const quint64 size = 1 << bits;
+    SobolSequence sobol(12345);
+    for (quint64 block = 0; block < 3; ++block) {
+        for (int d = 0; d < SobolSequence::Dimensions; ++d) {
+            std::set<int> cells;
+            for (quint64 n = block*size; n < (block + 1)*size; ++n)
+                cells.insert(cell(sobol.sample(n, d), bits));
+            EXPECT_EQ(cells.size(), size) << "dimension " << d << " block " << block;
+        }
+    }
+}
+
+TEST(SobolSequenceTests, FirstTwoDimensionsAreStratifiedInElementaryIntervals)
+{
+    const int bits = 8;
+    const quint64 size = 1 << bits;
+    SobolSequence sobol(99);
+    for (int a = 0; a <= bits; ++a) {
+        std::set<int> cells;
+        for (quint64 n = 0; n < size; ++n)
+            cells.insert(cell(sobol.sample(n, 0), a) << (bits - a) | cell(sobol.sample(n, 1), bits - a));
+        EXPECT_EQ(cells.size(), size) << "intervals of 2^-" << a << " by 2^-" << bits - a;
+    }
+}
+
+TEST(SobolSequenceTests, SeedsGiveDifferentRandomizations)
+{
+    SobolSequence a(1);
+    SobolSequence b(2);
+    SobolSequence c(1);
+    int same = 0;
+    for (quint64 n = 0; n < 256; ++n) {
+        EXPECT_EQ(a.sample(n, 3), c.sample(n, 3));
+        if (a.sample(n, 3) == b.sample(n, 3)) ++same;
+    }
+    EXPECT_LT(same, 4);
+
+    std::vector<double> values(SobolSequence::Dimensions);
+    a.point(17, values.data());
+    for (int d = 0; d < SobolSequence::Dimensions; ++d)
+        EXPECT_EQ(values[d], a.sample(17, d));
+}
+
+TEST(SobolSequenceTests, MeanConvergesFasterThanRandomSampling)
+{
+    // the integral of x*y*z over the unit cube is 1/8
+    SobolSequence sobol(5);
+    const quint64 size = 1 << 12;
+    double sum = 0.;
+    for (quint64 n = 0; n < size; ++n)
+        sum += sobol.sample(n, 2)*sobol.sample(n, 3)*sobol.sample(n, 4);
+    EXPECT_NEAR(sum/size, 0.125, 1e-3);
+}
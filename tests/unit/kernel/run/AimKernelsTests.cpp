@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "kernel/run/AimKernels.h"
+
+namespace {
+
+// an 8 by 10 grid over [0, 4] x [0, 5], cells of 0.5 by 0.5
+AimKernels makeKernels()
+{
+    AimKernels ans(Box2D(vec2d(0., 0.), vec2d(4., 5.)), 8, 10);
+    ans.setAreas(std::vector<double>(80, 0.25));
+
+    // a 2 by 3 image at rows 2-3, cols 4-6, aimed at its centre
+    std::vector<double> power(80, 0.);
+    const double image[6] = {1., 2., 3., 4., 5., 6.};
+    for (int r = 0; r < 2; ++r)
+        for (int c = 0; c < 3; ++c)
+            power[(2 + r)*10 + 4 + c] = image[r*3 + c];
+    ans.addKernel("//Node/H1", true, vec2d(1.5, 2.75), power);
+
+    // a single cell that is not aimed at the receiver
+    std::vector<double> single(80, 0.);
+    single[7*10 + 0] = 10.;
+    ans.addKernel("//Node/H2", false, vec2d(), single);
+    return ans;
+}
+
+double sum(const std::vector<double>& values)
+{
+    return std::accumulate(values.begin(), values.end(), 0.);
+}
+
+} // namespace
+
+TEST(AimKernelsTest, KeepsTheWindowOfEachImage)
+{
+    const AimKernels kernels = makeKernels();
+    ASSERT_EQ(kernels.getKernelCount(), 2);
+    const AimKernels::Kernel& kernel = kernels.getKernel(0);
+    EXPECT_EQ(kernel.row, 2);
+    EXPECT_EQ(kernel.col, 4);
+    EXPECT_EQ(kernel.rows, 2);
+    EXPECT_EQ(kernel.cols, 3);
+    EXPECT_EQ(kernel.power, std::vector<double>({1., 2., 3., 4., 5., 6.}));
+    EXPECT_EQ(kernels.findKernel("//Node/H2"), 1);
+    EXPECT_EQ(kernels.findKernel("//Node/H3"), -1);
+}
+
+TEST(AimKernelsTest, SumsThePowerAtTheTracedAims)
+{
+    const AimKernels kernels = makeKernels();
+    double spilled = -1.;
+    const std::vector<double> power = kernels.evaluate({}, &spilled);
+    ASSERT_EQ(power.size(), 80u);
+    EXPECT_EQ(power[2*10 + 4], 1.);
+    EXPECT_EQ(power[3*10 + 6], 6.);
+    EXPECT_EQ(power[7*10 + 0], 10.);
+    EXPECT_DOUBLE_EQ(sum(power), 31.);
+    EXPECT_EQ(spilled, 0.);
+
+    const std::vector<double> flux = kernels.findFlux(power);
+    EXPECT_DOUBLE_EQ(flux[3*10 + 6], 24.);
+}
+
+TEST(AimKernelsTest, MovesImagesByWholeAndPartCells)
+{
+    const AimKernels kernels = makeKernels();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // one cell along u and two back along v; the kernel not aimed stays
+    std::vector<double> power = kernels.evaluate({vec2d(2., 1.75), vec2d(nan, nan)});
+    EXPECT_EQ(power[3*10 + 2], 1.);
+    EXPECT_EQ(power[4*10 + 4], 6.);
+    EXPECT_EQ(power[2*10 + 4], 0.);
+    EXPECT_EQ(power[7*10 + 0], 10.);
+
+    // half a cell along v splits each cell over two
+    power = kernels.evaluate({vec2d(1.5, 3.)});
+    EXPECT_DOUBLE_EQ(power[2*10 + 4], 0.5);
+    EXPECT_DOUBLE_EQ(power[2*10 + 5], 1.5);
+    EXPECT_DOUBLE_EQ(power[3*10 + 7], 3.);
+    EXPECT_DOUBLE_EQ(sum(power), 31.);
+}
+
+TEST(AimKernelsTest, SpillsThePowerMovedOffTheGrid)
+{
+    const AimKernels kernels = makeKernels();
+    // half of the last column of the image moves past the grid
+    double spilled = 0.;
+    std::vector<double> power = kernels.evaluate({vec2d(1.5, 4.5)}, &spilled);
+    EXPECT_NEAR(sum(power) + spilled, 31., 1e-12);
+    EXPECT_NEAR(spilled, 0.5*(3. + 6.), 1e-12);
+
+    power = kernels.evaluate({vec2d(100., 2.75)}, &spilled);
+    EXPECT_DOUBLE_EQ(spilled, 21.);
+    EXPECT_DOUBLE_EQ(sum(power), 10.);
+}
+
+TEST(AimKernelsTest, ReadsBackWhatItWrites)
+{
+    AimKernels kernels = makeKernels();
+    kernels.setSun(180., 45.);
+    AimKernels copy;
+    QString error;
+    ASSERT_TRUE(copy.fromBytes(kernels.toBytes(), &error)) << error.toStdString();
+    EXPECT_EQ(copy.getRows(), 8);
+    EXPECT_EQ(copy.getCols(), 10);
+    EXPECT_EQ(copy.getSunElevation(), 45.);
+    EXPECT_EQ(copy.getAreas(), kernels.getAreas());
+    ASSERT_EQ(copy.getKernelCount(), 2);
+    EXPECT_EQ(copy.findKernel("//Node/H2"), 1);
+    EXPECT_FALSE(copy.getKernel(1).aimed);
+    EXPECT_EQ(copy.evaluate({vec2d(2.25, 3.)}), kernels.evaluate({vec2d(2.25, 3.)}));
+
+    QByteArray damaged = kernels.toBytes();
+    damaged.chop(8);
+    EXPECT_FALSE(copy.fromBytes(damaged, &error));
+    EXPECT_EQ(copy.getKernelCount(), 2);
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "kernel/run/BatchMeans.h"
+
+TEST(BatchMeansTest, TakesBatchesFromCumulativeTotals)
+{
+    BatchMeans means;
+    means.begin({10., 0.});
+    means.addRound({12., 1.});
+    means.addRound({16., 2.});
+    means.addRound({18., 3.});
+    ASSERT_EQ(means.getRounds(), 3);
+    EXPECT_DOUBLE_EQ(means.getMean(0), 8./3.);
+    EXPECT_DOUBLE_EQ(means.getMean(1), 1.);
+
+    // batches 2, 4, 2: variance 4/3, standard error of the mean 2/3
+    EXPECT_NEAR(means.getRelativeError(0), (2./3.)/(8./3.), 1e-12);
+    EXPECT_DOUBLE_EQ(means.getRelativeError(1), 0.);
+}
+
+TEST(BatchMeansTest, IsInfiniteWithoutEnoughData)
+{
+    BatchMeans means;
+    means.begin({0., 0.});
+    means.addRound({1., 0.});
+    EXPECT_TRUE(std::isinf(means.getRelativeError(0)));
+    means.addRound({2., 0.});
+    EXPECT_TRUE(std::isinf(means.getRelativeError(1)));
+
+    BatchMeans empty;
+    empty.begin({0.});
+    empty.addRound({0.});
+    empty.addRound({0.});
+    EXPECT_TRUE(std::isinf(empty.getMaxRelativeError(0.1)));
+}
+
+TEST(BatchMeansTest, SkipsCellsBelowTheFractionOfThePeak)
+{
+    BatchMeans means;
+    means.begin({0., 0.});
+    means.addRound({100., 1.});
+    means.addRound({200., 4.});
+    means.addRound({300., 4.});
+    EXPECT_DOUBLE_EQ(means.getMaxRelativeError(0.1), 0.);
+    EXPECT_GT(means.getMaxRelativeError(0.), 0.5);
+}
+
+// the error of Poisson counts falls as one over the root of the rounds
+TEST(BatchMeansTest, MatchesTheErrorOfPoissonCounts)
+{
+    std::mt19937 generator(7);
+    std::poisson_distribution<int> counts(400.);
+    BatchMeans means;
+    means.begin({0.});
+    double total = 0.;
+    for (int round = 0; round < 400; ++round) {
+        total += counts(generator);
+        means.addRound({total});
+    }
+    // a spread of 20 per batch over the root of 400 rounds, relative to 400
+    const double expected = 20./std::sqrt(400.)/400.;
+    EXPECT_NEAR(means.getRelativeError(0), expected, 0.1*expected);
+}
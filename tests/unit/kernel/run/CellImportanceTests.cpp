@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "kernel/run/CellImportance.h"
+
+TEST(CellImportanceTest, StartsUniform)
+{
+    const CellImportance importance(4);
+    ASSERT_EQ(importance.getCellCount(), 4);
+    for (int c = 0; c < 4; ++c) {
+        EXPECT_DOUBLE_EQ(importance.getProbability(c), 0.25);
+        EXPECT_DOUBLE_EQ(importance.getWeight(c), 1.);
+    }
+    double weight = 0.;
+    EXPECT_EQ(importance.sample(0.6, &weight), 2);
+    EXPECT_DOUBLE_EQ(weight, 1.);
+}
+
+TEST(CellImportanceTest, DrawsByRatesWithUniformFloor)
+{
+    CellImportance importance(4);
+    importance.setRates({3., 1., 0., 0.}, 0.2);
+    EXPECT_NEAR(importance.getProbability(0), 0.05 + 0.6, 1e-12);
+    EXPECT_NEAR(importance.getProbability(1), 0.05 + 0.2, 1e-12);
+    EXPECT_NEAR(importance.getProbability(2), 0.05, 1e-12);
+    EXPECT_NEAR(importance.getProbability(3), 0.05, 1e-12);
+
+    // the weighted draw has the mean of the uniform one
+    double mean = 0.;
+    for (int c = 0; c < 4; ++c)
+        mean += importance.getProbability(c)*importance.getWeight(c);
+    EXPECT_NEAR(mean, 1., 1e-12);
+
+    double weight = 0.;
+    EXPECT_EQ(importance.sample(0.64, &weight), 0);
+    EXPECT_NEAR(weight, 1./(4.*0.65), 1e-12);
+    EXPECT_EQ(importance.sample(0.999999, &weight), 3);
+    EXPECT_NEAR(weight, 5., 1e-9);
+}
+
+TEST(CellImportanceTest, StaysUniformWithoutRates)
+{
+    CellImportance importance(3);
+    importance.setRates({0., 0., 0.}, 0.1);
+    for (int c = 0; c < 3; ++c)
+        EXPECT_NEAR(importance.getProbability(c), 1./3., 1e-12);
+}
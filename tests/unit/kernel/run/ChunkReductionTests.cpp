@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "kernel/run/ChunkReduction.h"
+
+namespace {
+
+const std::size_t GridSize = 5;
+
+// values of very different magnitudes, whose sums depend on their order
+std::vector<std::vector<double>> makeGrids(int chunks)
+{
+    std::mt19937_64 generator(11);
+    std::uniform_real_distribution<double> mantissa(0., 1.);
+    std::uniform_int_distribution<int> exponent(-30, 30);
+    std::vector<std::vector<double>> ans(chunks, std::vector<double>(GridSize));
+    for (std::vector<double>& grid : ans)
+        for (double& value : grid)
+            value = std::ldexp(mantissa(generator), exponent(generator));
+    return ans;
+}
+
+// the pairwise tree over [first, first + 2^level), absent past count
+std::vector<double> treeSum(const std::vector<std::vector<double>>& grids, std::size_t first, int level)
+{
+    if (level == 0) return grids[first];
+    std::vector<double> ans = treeSum(grids, first, level - 1);
+    const std::size_t half = std::size_t(1) << (level - 1);
+    if (first + half < grids.size()) {
+        const std::vector<double> right = treeSum(grids, first + half, level - 1);
+        for (std::size_t n = 0; n < GridSize; ++n)
+            ans[n] += right[n];
+    }
+    return ans;
+}
+
+std::vector<double> reduce(const std::vector<std::vector<double>>& grids, const std::vector<int>& order, qulonglong first)
+{
+    ChunkReduction reduction;
+    reduction.begin(first, first + grids.size(), GridSize);
+    for (int chunk : order)
+        reduction.add(first + chunk, std::vector<double>(grids[chunk]));
+    return reduction.take();
+}
+
+} // namespace
+
+TEST(ChunkReductionTest, SumsInTreeOrderWhateverTheOrderGiven)
+{
+    for (int chunks : {1, 2, 7, 13, 64}) {
+        const std::vector<std::vector<double>> grids = makeGrids(chunks);
+        int level = 0;
+        while ((1 << level) < chunks) ++level;
+        const std::vector<double> expected = treeSum(grids, 0, level);
+
+        std::vector<int> order(chunks);
+        std::iota(order.begin(), order.end(), 0);
+        std::mt19937 generator(chunks);
+        for (int trial = 0; trial < 20; ++trial) {
+            const std::vector<double> sum = reduce(grids, order, 1000);
+            for (std::size_t n = 0; n < GridSize; ++n)
+                ASSERT_EQ(sum[n], expected[n]) << chunks << " chunks, trial " << trial;
+            std::shuffle(order.begin(), order.end(), generator);
+        }
+    }
+}
+
+TEST(ChunkReductionTest, GivesTheSameBitsFromSeveralThreads)
+{
+    const int chunks = 100;
+    const std::vector<std::vector<double>> grids = makeGrids(chunks);
+    const std::vector<double> expected = reduce(grids, [] {
+        std::vector<int> order(chunks);
+        std::iota(order.begin(), order.end(), 0);
+        return order;
+    }(), 0);
+
+    for (int workers : {2, 3, 8}) {
+        ChunkReduction reduction;
+        reduction.begin(0, chunks, GridSize);
+        std::atomic_int next(0);
+        std::vector<std::thread> threads;
+        for (int w = 0; w < workers; ++w)
+            threads.emplace_back([&]() {
+                for (int chunk = next++; chunk < chunks; chunk = next++) {
+                    std::vector<double> grid = reduction.acquire();
+                    std::copy(grids[chunk].begin(), grids[chunk].end(), grid.begin());
+                    reduction.add(chunk, std::move(grid));
+                }
+            });
+        for (std::thread& thread : threads)
+            thread.join();
+        EXPECT_EQ(reduction.take(), expected) << workers << " workers";
+    }
+}
+
+TEST(ChunkReductionTest, AddsTheChunksGivenWhenSomeAreMissing)
+{
+    const std::vector<std::vector<double>> grids = makeGrids(9);
+    const std::vector<int> given = {8, 0, 3, 5, 2};
+    std::vector<int> reversed(given.rbegin(), given.rend());
+
+    ChunkReduction a;
+    ChunkReduction b;
+    a.begin(0, 9, GridSize);
+    b.begin(0, 9, GridSize);
+    for (int chunk : given)
+        a.add(chunk, std::vector<double>(grids[chunk]));
+    for (int chunk : reversed)
+        b.add(chunk, std::vector<double>(grids[chunk]));
+    const std::vector<double> sum = a.take();
+    EXPECT_EQ(sum, b.take());
+    for (std::size_t n = 0; n < GridSize; ++n) {
+        double expected = 0.;
+        for (int chunk : given)
+            expected += grids[chunk][n];
+        EXPECT_NEAR(sum[n], expected, 1e-12*std::abs(expected));
+    }
+}
+
+TEST(ChunkReductionTest, AcquiresZeroedGrids)
+{
+    ChunkReduction reduction;
+    reduction.begin(0, 2, 3);
+    reduction.add(0, std::vector<double>{1., 2., 3.});
+    reduction.add(1, std::vector<double>{4., 5., 6.});
+    EXPECT_EQ(reduction.take(), std::vector<double>({5., 7., 9.}));
+    EXPECT_EQ(reduction.acquire(), std::vector<double>(3, 0.));
+
+    reduction.begin(0, 0, 3);
+    EXPECT_EQ(reduction.take(), std::vector<double>(3, 0.));
+}
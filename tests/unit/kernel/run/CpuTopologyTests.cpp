@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include "kernel/run/CpuTopology.h"
+
+TEST(CpuTopologyTest, ParsesSysfsCpuLists)
+{
+    EXPECT_EQ(CpuTopology::parseCpuList("0-3,8,10-11\n"), std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(CpuTopology::parseCpuList("5"), std::vector<int>({5}));
+    EXPECT_TRUE(CpuTopology::parseCpuList("").empty());
+    EXPECT_EQ(CpuTopology::parseCpuList("x,4-2,6"), std::vector<int>({6}));
+}
+
+TEST(CpuTopologyTest, SpreadsCpusAcrossNodes)
+{
+    CpuTopology topology({{0, 1, 2}, {}, {4, 5}});
+    ASSERT_EQ(topology.getNodeCount(), 2);
+    EXPECT_EQ(topology.spreadCpus(), std::vector<int>({0, 4, 1, 5, 2}));
+    EXPECT_EQ(topology.findNode(5), 1);
+    EXPECT_EQ(topology.findNode(3), -1);
+}
+
+TEST(CpuTopologyTest, DetectsAtLeastOneNode)
+{
+    CpuTopology topology = CpuTopology::detect();
+    ASSERT_GE(topology.getNodeCount(), 1);
+    for (int n = 0; n < topology.getNodeCount(); ++n)
+        EXPECT_FALSE(topology.getCpus(n).empty());
+}
+
+TEST(CpuTopologyTest, SpreadsWorkersAcrossGroups)
+{
+    CpuTopology single({{0, 1}, {3, 2}});
+    ASSERT_EQ(single.getGroupCount(), 1);
+    EXPECT_EQ(single.getGroupCpus(0), std::vector<int>({0, 1, 2, 3}));
+    EXPECT_EQ(single.spreadGroups(3), std::vector<int>({0, 0, 0}));
+
+    CpuTopology topology({{0, 1, 2, 3, 4}}, {{0, 1, 2}, {}, {3, 4}});
+    ASSERT_EQ(topology.getGroupCount(), 2);
+    EXPECT_EQ(topology.findGroup(4), 1);
+    EXPECT_EQ(topology.findGroup(7), -1);
+    EXPECT_EQ(topology.spreadGroups(4), std::vector<int>({0, 1, 0, 1}));
+    // a group without processors left takes no more, until all are taken
+    EXPECT_EQ(topology.spreadGroups(7), std::vector<int>({0, 1, 0, 1, 0, 0, 1}));
+    EXPECT_GE(CpuTopology::countProcessors(), 1);
+}
@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include <numeric>
+
+#include "kernel/run/HugePages.h"
+
+TEST(HugePagesTest, ReserveKeepsTheElements)
+{
+    for (bool on : {false, true}) {
+        HugePages::setEnabled(on);
+        std::vector<double> values = {1., 2., 3.};
+        size_t n = 2*HugePages::PageSize/sizeof(double);
+        HugePages::reserve(values, n);
+        EXPECT_GE(values.capacity(), n);
+        EXPECT_EQ(values, std::vector<double>({1., 2., 3.}));
+    }
+    HugePages::setEnabled(false);
+}
+
+TEST(HugePagesTest, AssignReplacesTheElements)
+{
+    HugePages::setEnabled(true);
+    std::vector<int> source(HugePages::PageSize/sizeof(int) + 5);
+    std::iota(source.begin(), source.end(), 0);
+    std::vector<int> values = {7, 8};
+    HugePages::assign(values, source.begin(), source.end());
+    EXPECT_EQ(values, source);
+
+    std::vector<float> small;
+    HugePages::assign(small, source.begin(), source.begin() + 3);
+    EXPECT_EQ(small, std::vector<float>({0.f, 1.f, 2.f}));
+    HugePages::setEnabled(false);
+}
+
+TEST(HugePagesTest, AdvisesOnlyWholePages)
+{
+    std::vector<char> bytes(16);
+    EXPECT_FALSE(HugePages::advise(bytes.data(), bytes.size()));
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include "kernel/run/MaterialVariants.h"
+
+namespace {
+
+// the variants keep pointers only
+MaterialRT* fakeMaterial(int& storage)
+{
+    return reinterpret_cast<MaterialRT*>(&storage);
+}
+
+} // namespace
+
+TEST(MaterialVariantsTest, StartsWithTheScene)
+{
+    MaterialVariants variants;
+    EXPECT_EQ(variants.getCount(), 1);
+    EXPECT_TRUE(variants.isEmpty());
+
+    int a = 0;
+    EXPECT_EQ(variants.find(0, fakeMaterial(a)), fakeMaterial(a));
+    EXPECT_FALSE(variants.isVaried(fakeMaterial(a)));
+}
+
+TEST(MaterialVariantsTest, ReplacesMaterialsOfOneVariant)
+{
+    int a = 0, b = 0, c = 0;
+    MaterialVariants variants;
+    EXPECT_EQ(variants.addVariant(), 1);
+    EXPECT_EQ(variants.addVariant(), 2);
+    EXPECT_FALSE(variants.isEmpty());
+
+    variants.replace(2, fakeMaterial(a), fakeMaterial(c));
+    EXPECT_TRUE(variants.isVaried(fakeMaterial(a)));
+    EXPECT_FALSE(variants.isVaried(fakeMaterial(b)));
+    EXPECT_EQ(variants.find(0, fakeMaterial(a)), fakeMaterial(a));
+    EXPECT_EQ(variants.find(1, fakeMaterial(a)), fakeMaterial(a));
+    EXPECT_EQ(variants.find(2, fakeMaterial(a)), fakeMaterial(c));
+    EXPECT_EQ(variants.find(2, fakeMaterial(b)), fakeMaterial(b));
+
+    // the scene itself is not replaced
+    variants.replace(0, fakeMaterial(b), fakeMaterial(c));
+    EXPECT_FALSE(variants.isVaried(fakeMaterial(b)));
+}
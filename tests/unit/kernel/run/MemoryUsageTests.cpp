@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "kernel/run/MemoryUsage.h"
+
+TEST(MemoryUsageTest, PeakResidentHoldsTheResidentSet)
+{
+    const qulonglong resident = MemoryUsage::getResidentBytes();
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS) || defined(Q_OS_WIN)
+    EXPECT_GT(resident, 0u);
+#endif
+    EXPECT_GE(MemoryUsage::getPeakResidentBytes(), resident);
+}
+
+TEST(MemoryUsageTest, PeakResidentGrowsWithTouchedPages)
+{
+    const qulonglong before = MemoryUsage::getPeakResidentBytes();
+    if (before == 0)
+        GTEST_SKIP() << "no resident sizes on this platform";
+
+    // twice the peak so far, written so the pages are resident
+    std::vector<char> pages(before*2, 1);
+    EXPECT_GE(MemoryUsage::getPeakResidentBytes(), before + pages.size()/2);
+}
+
+TEST(MemoryUsageTest, CountsAllocationsWhenBuiltTo)
+{
+    const qulonglong before = MemoryUsage::getAllocations();
+    {
+        std::unique_ptr<int> single(new int(1));
+        std::unique_ptr<double[]> array(new double[16]);
+        std::vector<int> values(100);
+    }
+    const qulonglong after = MemoryUsage::getAllocations();
+    if (MemoryUsage::isCounting())
+        EXPECT_GE(after - before, 3u);
+    else
+        EXPECT_EQ(after, 0u);
+}
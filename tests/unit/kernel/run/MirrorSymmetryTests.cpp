@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "kernel/run/MirrorSymmetry.h"
+
+TEST(MirrorSymmetryTest, ReflectsAboutThePlane)
+{
+    const MirrorSymmetry symmetry(vec3d(2., 0., 0.), 1.);
+    EXPECT_DOUBLE_EQ(symmetry.getNormal().x, 1.);
+    EXPECT_DOUBLE_EQ(symmetry.distance(vec3d(3., 5., 0.)), 2.);
+
+    const vec3d image = symmetry.reflect(vec3d(3., 5., -1.));
+    EXPECT_DOUBLE_EQ(image.x, -1.);
+    EXPECT_DOUBLE_EQ(image.y, 5.);
+    EXPECT_DOUBLE_EQ(image.z, -1.);
+}
+
+TEST(MirrorSymmetryTest, PairsASymmetricGrid)
+{
+    // a 4 x 3 grid of cell centres over x in [-2, 2]
+    std::vector<vec3d> points;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 3; ++j)
+            points.push_back(vec3d(-1.5 + i, 0.5*j, 1.));
+
+    const MirrorSymmetry symmetry(vec3d::UnitX);
+    const std::vector<int> mirrors = symmetry.findMirrors(points, 1e-3);
+    ASSERT_EQ(mirrors.size(), points.size());
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 3; ++j)
+            EXPECT_EQ(mirrors[i*3 + j], (3 - i)*3 + j);
+}
+
+TEST(MirrorSymmetryTest, RejectsPointsWithoutImages)
+{
+    std::vector<vec3d> points = {vec3d(-1., 0., 0.), vec3d(1., 0., 0.), vec3d(0.2, 1., 0.)};
+    const MirrorSymmetry symmetry(vec3d::UnitX);
+    EXPECT_TRUE(symmetry.findMirrors(points, 1e-3).empty());
+
+    // a point on the plane is its own image
+    points.back().x = 0.;
+    const std::vector<int> mirrors = symmetry.findMirrors(points, 1e-3);
+    ASSERT_EQ(mirrors.size(), 3u);
+    EXPECT_EQ(mirrors[0], 1);
+    EXPECT_EQ(mirrors[2], 2);
+}
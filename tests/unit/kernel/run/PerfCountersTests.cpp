@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "kernel/run/PerfCounters.h"
+
+TEST(PerfCountersTest, SumsTheCountersOfAllValues)
+{
+    PerfCounterValues a;
+    a.counts[PerfCounterValues::Cycles] = 100;
+    a.counted[PerfCounterValues::Cycles] = true;
+    a.counts[PerfCounterValues::CacheMisses] = 5;
+    a.counted[PerfCounterValues::CacheMisses] = true;
+
+    PerfCounterValues b;
+    b.counts[PerfCounterValues::Cycles] = 50;
+    b.counted[PerfCounterValues::Cycles] = true;
+
+    const PerfCounterValues total = PerfCounterValues::sum({a, b});
+    EXPECT_TRUE(total.counted[PerfCounterValues::Cycles]);
+    EXPECT_EQ(total.counts[PerfCounterValues::Cycles], 150u);
+    // not counted by b
+    EXPECT_FALSE(total.counted[PerfCounterValues::CacheMisses]);
+    EXPECT_EQ(total.counts[PerfCounterValues::CacheMisses], 0u);
+    EXPECT_FALSE(PerfCounterValues::sum({}).counted[PerfCounterValues::Cycles]);
+}
+
+TEST(PerfCountersTest, ReadsNothingBeforeStart)
+{
+    PerfCounters counters;
+    EXPECT_FALSE(counters.isStarted());
+    const PerfCounterValues values = counters.read();
+    for (bool counted : values.counted)
+        EXPECT_FALSE(counted);
+}
+
+TEST(PerfCountersTest, CountsAThreadAfterItEnds)
+{
+    PerfCounters counters;
+    bool started = false;
+    volatile double sink = 0.;
+    std::thread worker([&]() {
+        started = counters.start();
+        for (int n = 0; n < 1000000; ++n)
+            sink = sink + n*0.5;
+    });
+    worker.join();
+    if (!started)
+        GTEST_SKIP() << counters.getError().toStdString();
+
+    const PerfCounterValues values = counters.read();
+    if (!values.counted[PerfCounterValues::Instructions])
+        GTEST_SKIP() << "no instruction counter";
+    EXPECT_GT(values.counts[PerfCounterValues::Instructions], 1000000u);
+}
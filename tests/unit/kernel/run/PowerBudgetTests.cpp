@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include "kernel/run/PowerBudget.h"
+
+TEST(PowerBudgetTest, SplitsHitsIntoAbsorbedAndReflected)
+{
+    PowerBudget budget;
+    budget.resize(2);
+    ASSERT_EQ(budget.getSurfaceCount(), 2);
+    budget.addHit(0, true, 1., 0.75);
+    budget.addHit(0, true, 0.5, 0.);
+    budget.addHit(1, false, 0.25, 0.25);
+
+    const PowerBudget::Side& front = budget.getSide(0, true);
+    EXPECT_DOUBLE_EQ(front.incident, 1.5);
+    EXPECT_DOUBLE_EQ(front.absorbed, 0.75);
+    EXPECT_DOUBLE_EQ(front.reflected, 0.75);
+    EXPECT_DOUBLE_EQ(budget.getSide(0, false).incident, 0.);
+    EXPECT_DOUBLE_EQ(budget.getSide(1, false).reflected, 0.25);
+    EXPECT_DOUBLE_EQ(budget.getSide(1, false).absorbed, 0.);
+    EXPECT_DOUBLE_EQ(budget.getAbsorbed(), 0.75);
+}
+
+TEST(PowerBudgetTest, TotalsAddUpToTheWeightEmitted)
+{
+    // a ray of weight 1 reflected at 0.8, 0.1 lost to air, survives roulette
+    // at 0.5 from 0.35, then absorbed; a second ray misses
+    PowerBudget budget;
+    budget.resize(1);
+    budget.addHit(0, true, 1., 0.8);
+    budget.addAir(0.8 - 0.7);
+    budget.addHit(0, false, 0.7, 0.35);
+    budget.addRoulette(0.35 - 0.5);
+    budget.addHit(0, true, 0.5, 0.);
+    budget.addMissed(1.);
+
+    EXPECT_NEAR(budget.getTotal(), 2., 1e-12);
+    EXPECT_DOUBLE_EQ(budget.getMissed(), 1.);
+    EXPECT_DOUBLE_EQ(budget.getEscaped(), 0.);
+}
+
+TEST(PowerBudgetTest, AddsAndScalesBudgets)
+{
+    PowerBudget a;
+    a.resize(1);
+    a.addHit(0, true, 2., 1.);
+    a.addEscaped(1.);
+    PowerBudget b;
+    b.resize(1);
+    b.addHit(0, true, 1., 0.);
+    b.addMissed(3.);
+
+    a.add(b);
+    a.scale(10.);
+    EXPECT_DOUBLE_EQ(a.getSide(0, true).incident, 30.);
+    EXPECT_DOUBLE_EQ(a.getSide(0, true).absorbed, 20.);
+    EXPECT_DOUBLE_EQ(a.getSide(0, true).reflected, 10.);
+    EXPECT_DOUBLE_EQ(a.getEscaped(), 10.);
+    EXPECT_DOUBLE_EQ(a.getMissed(), 30.);
+    EXPECT_DOUBLE_EQ(a.getTotal(), 60.);
+
+    a.resize(1);
+    EXPECT_DOUBLE_EQ(a.getTotal(), 0.);
+}
@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "kernel/run/QuadtreeGrid.h"
+
+namespace {
+
+struct Sample
+{
+    vec2d uv;
+    double weight;
+};
+
+// a flat floor of weight 1 and a narrow peak of weight 20 near (0.3, 0.6)
+std::vector<Sample> makePeak(int count, unsigned seed)
+{
+    std::mt19937_64 generator(seed);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    std::normal_distribution<double> normal(0., 0.02);
+    std::vector<Sample> ans;
+    for (int n = 0; n < count; ++n) {
+        if (n % 2)
+            ans.push_back({vec2d(uniform(generator), uniform(generator)), 1.});
+        else
+            ans.push_back({vec2d(0.3 + normal(generator), 0.6 + normal(generator)), 20.});
+    }
+    return ans;
+}
+
+QuadtreeGrid::Settings makeSettings()
+{
+    QuadtreeGrid::Settings ans;
+    ans.rows = 4;
+    ans.cols = 4;
+    ans.maxDepth = 4;
+    ans.splitHits = 64;
+    ans.splitGradient = 0.5;
+    return ans;
+}
+
+double totalWeight(const QuadtreeGrid& grid)
+{
+    double ans = 0.;
+    for (const QuadtreeGrid::Cell& cell : grid.getCells())
+        ans += cell.weight;
+    return ans;
+}
+
+} // namespace
+
+TEST(QuadtreeGridTest, KeepsBaseCellsWhereWeightsAreFlat)
+{
+    QuadtreeGrid grid(Box2D(vec2d(0., 0.), vec2d(1., 1.)), makeSettings());
+    grid.beginWorkers(1);
+    // 16 evenly spaced points in every quadrant of every base cell
+    for (int i = 0; i < 32; ++i)
+        for (int j = 0; j < 32; ++j)
+            grid.addPoint(0, vec2d((i + 0.5)/32., (j + 0.5)/32.), 1.);
+    grid.endWorkers();
+
+    EXPECT_EQ(grid.getCellCount(), 16u);
+    EXPECT_EQ(grid.getDepth(), 0);
+    EXPECT_EQ(grid.getHits(), 1024u);
+    EXPECT_DOUBLE_EQ(totalWeight(grid), 1024.);
+}
+
+TEST(QuadtreeGridTest, SplitsDownToThePeakAndKeepsTheWeight)
+{
+    const std::vector<Sample> samples = makePeak(20000, 3);
+    QuadtreeGrid grid(Box2D(vec2d(0., 0.), vec2d(1., 1.)), makeSettings());
+    grid.beginWorkers(1);
+    double expected = 0.;
+    for (const Sample& sample : samples) {
+        grid.addPoint(0, sample.uv, sample.weight);
+        expected += sample.weight;
+    }
+    grid.addPoint(0, vec2d(1.5, 0.5), 1.); // outside
+    grid.endWorkers();
+
+    EXPECT_EQ(grid.getDepth(), 4);
+    EXPECT_EQ(grid.getHits(), samples.size());
+    EXPECT_NEAR(totalWeight(grid), expected, 1e-9*expected);
+
+    // the deepest cells lie around the peak, the corners stay coarse
+    for (const QuadtreeGrid::Cell& cell : grid.getCells()) {
+        if (cell.depth == 4) {
+            EXPECT_LT(std::abs(cell.box.center().x - 0.3), 0.15);
+            EXPECT_LT(std::abs(cell.box.center().y - 0.6), 0.15);
+        }
+        if (cell.box.isInside(vec2d(0.01, 0.01)) || cell.box.isInside(vec2d(0.99, 0.01))) {
+            EXPECT_LE(cell.depth, 1);
+        }
+    }
+    EXPECT_LT(grid.getCellCount(), 16u*256u/4u);
+}
+
+TEST(QuadtreeGridTest, LeavesNoMoreCellsThanAllowed)
+{
+    QuadtreeGrid::Settings settings = makeSettings();
+    settings.maxCells = 40;
+    QuadtreeGrid grid(Box2D(vec2d(0., 0.), vec2d(1., 1.)), settings);
+    grid.beginWorkers(1);
+    for (const Sample& sample : makePeak(20000, 5))
+        grid.addPoint(0, sample.uv, sample.weight);
+    grid.endWorkers();
+    EXPECT_LE(grid.getCellCount(), 40u);
+    EXPECT_GT(grid.getCellCount(), 16u);
+}
+
+TEST(QuadtreeGridTest, AddsChunksInIndexOrderWhateverTheWorkers)
+{
+    const std::vector<Sample> samples = makePeak(12000, 7);
+    const int chunks = 24;
+    const size_t perChunk = samples.size()/chunks;
+
+    QuadtreeGrid serial(Box2D(vec2d(0., 0.), vec2d(1., 1.)), makeSettings());
+    serial.beginWorkers(1);
+    for (const Sample& sample : samples)
+        serial.addPoint(0, sample.uv, sample.weight);
+    serial.endWorkers();
+
+    std::vector<int> order(chunks);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 generator(chunks);
+    for (int workers : {1, 3, 8}) {
+        std::shuffle(order.begin(), order.end(), generator);
+        QuadtreeGrid grid(Box2D(vec2d(0., 0.), vec2d(1., 1.)), makeSettings());
+        grid.beginWorkers(workers);
+        grid.beginChunks(100, 100 + chunks);
+        for (int k = 0; k < chunks; ++k) {
+            const int chunk = order[k];
+            const int worker = k % workers;
+            for (size_t n = 0; n < perChunk; ++n) {
+                const Sample& sample = samples[chunk*perChunk + n];
+                grid.addPoint(worker, sample.uv, sample.weight);
+            }
+            grid.endChunk(worker, 100 + chunk);
+        }
+        grid.endWorkers();
+
+        const std::vector<QuadtreeGrid::Cell> expected = serial.getCells();
+        const std::vector<QuadtreeGrid::Cell> cells = grid.getCells();
+        ASSERT_EQ(cells.size(), expected.size()) << workers << " workers";
+        for (size_t n = 0; n < cells.size(); ++n) {
+            EXPECT_EQ(cells[n].depth, expected[n].depth);
+            EXPECT_EQ(cells[n].hits, expected[n].hits);
+            EXPECT_EQ(cells[n].weight, expected[n].weight);
+        }
+    }
+}
+
+TEST(QuadtreeGridTest, ResamplesLeavesByTheAreaTheyCover)
+{
+    QuadtreeGrid grid(Box2D(vec2d(0., 0.), vec2d(2., 1.)), makeSettings());
+    grid.beginWorkers(1);
+    for (const Sample& sample : makePeak(20000, 9))
+        grid.addPoint(0, vec2d(2.*sample.uv.x, sample.uv.y), sample.weight);
+    grid.endWorkers();
+
+    const std::vector<QuadtreeGrid::Cell> cells = grid.getCells();
+    std::vector<double> densities;
+    for (const QuadtreeGrid::Cell& cell : cells)
+        densities.push_back(cell.weight/cell.box.area());
+
+    // the finest grid holds every leaf whole, a coarser one averages them
+    for (int scale : {64, 6}) {
+        const std::vector<double> resampled = grid.resample(densities, scale, scale);
+        ASSERT_EQ(resampled.size(), size_t(scale*scale));
+        const double cellArea = 2./(scale*scale);
+        const double sum = std::accumulate(resampled.begin(), resampled.end(), 0.)*cellArea;
+        EXPECT_NEAR(sum, totalWeight(grid), 1e-9*sum) << scale;
+    }
+    const std::vector<double> finest = grid.resample(densities, 64, 64);
+    EXPECT_DOUBLE_EQ(*std::max_element(finest.begin(), finest.end()), *std::max_element(densities.begin(), densities.end()));
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "kernel/run/ReflectorSampler.h"
+
+TEST(ReflectorSamplerTest, DisjointAperturesCarryUnitWeights)
+{
+    ReflectorSampler sampler;
+    sampler.setApertures({Box2D(vec2d(0., 0.), vec2d(1., 1.)), Box2D(vec2d(2., 0.), vec2d(5., 1.))});
+    ASSERT_EQ(sampler.getApertureCount(), 2);
+    EXPECT_DOUBLE_EQ(sampler.getArea(), 4.);
+    EXPECT_DOUBLE_EQ(sampler.getProbability(0), 0.25);
+    EXPECT_DOUBLE_EQ(sampler.getProbability(1), 0.75);
+
+    double weight = 0.;
+    vec2d p = sampler.sample(0.1, 0.5, 0.5, &weight);
+    EXPECT_DOUBLE_EQ(p.x, 0.5);
+    EXPECT_DOUBLE_EQ(p.y, 0.5);
+    EXPECT_DOUBLE_EQ(weight, 1.);
+    p = sampler.sample(0.6, 0.5, 0.25, &weight);
+    EXPECT_DOUBLE_EQ(p.x, 3.5);
+    EXPECT_DOUBLE_EQ(p.y, 0.25);
+    EXPECT_DOUBLE_EQ(weight, 1.);
+    EXPECT_DOUBLE_EQ(sampler.findWeight(vec2d(1.5, 0.5)), 0.);
+}
+
+TEST(ReflectorSamplerTest, OverlapsAndFactorsKeepTheMean)
+{
+    ReflectorSampler sampler;
+    sampler.setApertures({
+        Box2D(vec2d(0., 0.), vec2d(2., 1.)),
+        Box2D(vec2d(1., 0.), vec2d(3., 1.)),
+        Box2D(vec2d(5., 5.), vec2d(6., 6.))
+    }, {1., 3., 0.});
+    EXPECT_DOUBLE_EQ(sampler.getArea(), 4.);
+    EXPECT_DOUBLE_EQ(sampler.getProbability(2), 0.);
+
+    // the mean weight of the draws is the area covered over the area, 3/4
+    const int picks = 400;
+    const int points = 20;
+    double sum = 0.;
+    for (int k = 0; k < picks; ++k)
+        for (int i = 0; i < points; ++i)
+            for (int j = 0; j < points; ++j) {
+                double weight = 0.;
+                sampler.sample((k + 0.5)/picks, (i + 0.5)/points, (j + 0.5)/points, &weight);
+                sum += weight;
+            }
+    EXPECT_NEAR(sum/(picks*points*points), 0.75, 1e-3);
+
+    // a point in both rectangles: q = 0.25/2 + 0.75/2
+    EXPECT_NEAR(sampler.findWeight(vec2d(1.5, 0.5)), 1./(4.*0.5), 1e-12);
+    // in the first only: q = 0.25/2
+    EXPECT_NEAR(sampler.findWeight(vec2d(0.5, 0.5)), 1./(4.*0.125), 1e-12);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "kernel/run/TiledCounts.h"
+
+TEST(TiledCountsTest, MatchesDenseCounts)
+{
+    // not a multiple of the tile size, so the last tiles are partial
+    const int width = 3*TiledCounts::TileSize + 5;
+    const int height = 2*TiledCounts::TileSize + 17;
+    TiledCounts tiles(width, height);
+    std::vector<qulonglong> dense(std::size_t(width)*height, 0);
+
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int> column(0, width - 1);
+    std::uniform_int_distribution<int> row(0, height - 1);
+    for (int n = 0; n < 5000; ++n) {
+        const int c = column(generator);
+        const int r = row(generator);
+        tiles.add(c, r);
+        dense[std::size_t(r)*width + c]++;
+    }
+    tiles.add(width - 1, height - 1, 7);
+    dense.back() += 7;
+
+    std::vector<qulonglong> copy;
+    tiles.addTo(copy);
+    EXPECT_EQ(copy, dense);
+    EXPECT_EQ(tiles.get(width - 1, height - 1), dense.back());
+}
+
+TEST(TiledCountsTest, AllocatesTilesOnFirstHit)
+{
+    TiledCounts tiles(1000, 1000);
+    EXPECT_EQ(tiles.getTileCount(), 0);
+    tiles.add(0, 0);
+    tiles.add(TiledCounts::TileSize - 1, TiledCounts::TileSize - 1);
+    EXPECT_EQ(tiles.getTileCount(), 1);
+    tiles.add(999, 999);
+    EXPECT_EQ(tiles.getTileCount(), 2);
+    EXPECT_LT(tiles.getMemoryUsage(), 1000*1000*sizeof(qulonglong)/50);
+    EXPECT_EQ(tiles.get(500, 500), 0u);
+
+    tiles.clear();
+    EXPECT_EQ(tiles.getTileCount(), 0);
+    EXPECT_EQ(tiles.get(0, 0), 0u);
+}
+
+TEST(TiledCountsTest, MergesOnlyAllocatedTiles)
+{
+    TiledCounts a(300, 200);
+    TiledCounts b(300, 200);
+    a.add(10, 10, 2);
+    b.add(10, 10, 3);
+    b.add(250, 150);
+    a.merge(b);
+    EXPECT_EQ(a.get(10, 10), 5u);
+    EXPECT_EQ(a.get(250, 150), 1u);
+    EXPECT_EQ(a.getTileCount(), 2);
+
+    qulonglong total = 0;
+    a.forEach([&total](std::size_t, qulonglong count) {total += count;});
+    EXPECT_EQ(total, 6u);
+}
+
+TEST(TiledCountsTest, PrefersTilesAboveTheThreshold)
+{
+    EXPECT_FALSE(TiledCounts::isPreferred(100*100, 64, 256ull << 20));
+    EXPECT_TRUE(TiledCounts::isPreferred(4000*4000, 64, 256ull << 20));
+}
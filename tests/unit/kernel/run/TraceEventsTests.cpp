@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include "kernel/run/TraceEvents.h"
+
+namespace {
+
+std::string json(const TraceEvents& events)
+{
+    const QByteArray data = events.toJson();
+    return std::string(data.constData(), size_t(data.size()));
+}
+
+}
+
+TEST(TraceEventsTest, RecordsNothingWhenInactive)
+{
+    TraceEvents events;
+    {
+        TraceEventScope event("chunk", "trace");
+    }
+    EXPECT_EQ(events.getEventCount(), 0u);
+}
+
+TEST(TraceEventsTest, RecordsTheEventsOfEveryThread)
+{
+    TraceEvents events;
+    events.nameThread("main");
+    TraceEvents::setActive(&events);
+    {
+        TraceEventScope event("updateTree", "setup");
+    }
+    std::thread workers[2];
+    for (int w = 0; w < 2; ++w)
+        workers[w] = std::thread([w]() {
+            TraceEvents::active()->nameThread("worker", w);
+            TraceEventScope event("chunk", "trace", "chunk", 7 + w, "rays", 100);
+        });
+    for (std::thread& worker : workers)
+        worker.join();
+    TraceEvents::setActive(nullptr);
+
+    EXPECT_EQ(events.getEventCount(), 3u);
+    const std::string text = json(events);
+    EXPECT_NE(text.find("\"traceEvents\":["), std::string::npos);
+    EXPECT_NE(text.find("\"args\":{\"name\":\"main\"}"), std::string::npos);
+    EXPECT_NE(text.find("\"args\":{\"name\":\"worker 0\"}"), std::string::npos);
+    EXPECT_NE(text.find("\"args\":{\"name\":\"worker 1\"}"), std::string::npos);
+    EXPECT_NE(text.find("\"name\":\"updateTree\",\"cat\":\"setup\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(text.find("\"args\":{\"chunk\":7,\"rays\":100}"), std::string::npos);
+    EXPECT_NE(text.find("\"args\":{\"chunk\":8,\"rays\":100}"), std::string::npos);
+}
+
+TEST(TraceEventsTest, StartsEveryRecordingEmpty)
+{
+    for (int n = 0; n < 2; ++n) {
+        TraceEvents events;
+        TraceEvents::setActive(&events);
+        {
+            TraceEventScope event("findTexture", "setup");
+        }
+        TraceEvents::setActive(nullptr);
+        EXPECT_EQ(events.getEventCount(), 1u);
+    }
+}
+
+TEST(TraceEventsTest, IsInactiveOnceDestroyed)
+{
+    {
+        TraceEvents events;
+        TraceEvents::setActive(&events);
+        EXPECT_EQ(TraceEvents::active(), &events);
+    }
+    EXPECT_EQ(TraceEvents::active(), nullptr);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include "kernel/run/TraceMetrics.h"
+
+namespace {
+
+std::string text(const TraceMetrics& metrics)
+{
+    const QByteArray data = metrics.toPrometheus("tonatiuhpp_");
+    return std::string(data.constData(), size_t(data.size()));
+}
+
+}
+
+TEST(TraceMetricsTest, CountsChunksInTheirBuckets)
+{
+    TraceMetrics metrics;
+    metrics.addChunk(100, 500000);     // 0.5 ms
+    metrics.addChunk(100, 1000000);    // 1 ms, on the bound
+    metrics.addChunk(200, 20000000);   // 20 ms
+    metrics.addChunk(300, 60000000000); // 60 s, beyond the last bound
+
+    EXPECT_EQ(metrics.getChunks(), 4u);
+    EXPECT_EQ(metrics.getRays(), 700u);
+    EXPECT_EQ(metrics.getChunkNs(), 60021500000);
+    EXPECT_EQ(metrics.getChunksWithin(0), 2u);
+    EXPECT_EQ(metrics.getChunksWithin(3), 2u);
+    EXPECT_EQ(metrics.getChunksWithin(4), 3u);
+    EXPECT_EQ(metrics.getChunksWithin(TraceMetrics::BucketCount - 1), 3u);
+    EXPECT_EQ(metrics.getChunksWithin(TraceMetrics::BucketCount), 4u);
+}
+
+TEST(TraceMetricsTest, WritesCumulativeBuckets)
+{
+    TraceMetrics metrics;
+    metrics.addChunk(10, 2000000);
+    metrics.addChunk(10, 3000000);
+    metrics.addExport(5, 320);
+    metrics.addExportStall(250000000);
+
+    const std::string out = text(metrics);
+    EXPECT_NE(out.find("# TYPE tonatiuhpp_chunks_total counter\ntonatiuhpp_chunks_total 2\n"), std::string::npos);
+    EXPECT_NE(out.find("# TYPE tonatiuhpp_chunk_seconds histogram\n"), std::string::npos);
+    EXPECT_NE(out.find("tonatiuhpp_chunk_seconds_bucket{le=\"0.001\"} 0\n"), std::string::npos);
+    EXPECT_NE(out.find("tonatiuhpp_chunk_seconds_bucket{le=\"0.0025\"} 1\n"), std::string::npos);
+    EXPECT_NE(out.find("tonatiuhpp_chunk_seconds_bucket{le=\"0.005\"} 2\n"), std::string::npos);
+    EXPECT_NE(out.find("tonatiuhpp_chunk_seconds_bucket{le=\"+Inf\"} 2\n"), std::string::npos);
+    EXPECT_NE(out.find("tonatiuhpp_chunk_seconds_sum 0.005\n"), std::string::npos);
+    EXPECT_NE(out.find("tonatiuhpp_chunk_seconds_count 2\n"), std::string::npos);
+    EXPECT_NE(out.find("tonatiuhpp_photon_export_bytes_total 320\n"), std::string::npos);
+    EXPECT_NE(out.find("tonatiuhpp_photon_export_stalls_total 1\n"), std::string::npos);
+    EXPECT_NE(out.find("tonatiuhpp_photon_export_stall_seconds_total 0.25\n"), std::string::npos);
+}
+
+TEST(TraceMetricsTest, AddsFromEveryThread)
+{
+    TraceMetrics metrics;
+    TraceMetrics::setActive(&metrics);
+    std::thread workers[4];
+    for (std::thread& worker : workers)
+        worker = std::thread([]() {
+            for (int n = 0; n < 1000; ++n)
+                TraceMetrics::active()->addChunk(10, 1000);
+        });
+    for (std::thread& worker : workers)
+        worker.join();
+    TraceMetrics::setActive(nullptr);
+
+    EXPECT_EQ(metrics.getChunks(), 4000u);
+    EXPECT_EQ(metrics.getRays(), 40000u);
+    EXPECT_EQ(metrics.getChunksWithin(0), 4000u);
+}
+
+TEST(TraceMetricsTest, IsInactiveOnceDestroyed)
+{
+    {
+        TraceMetrics metrics;
+        TraceMetrics::setActive(&metrics);
+        EXPECT_EQ(TraceMetrics::active(), &metrics);
+    }
+    EXPECT_EQ(TraceMetrics::active(), nullptr);
+}
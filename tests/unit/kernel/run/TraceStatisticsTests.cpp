@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "kernel/run/TraceStatistics.h"
+
+TEST(TraceStatisticsTest, CountsShapeTestsByTypeName)
+{
+    // the same name from another module is the same class
+    const std::string other = "ShapePlanar";
+    TraceStatistics statistics;
+    statistics.addShapeTest("ShapePlanar");
+    statistics.addShapeTest("ShapeParabolic");
+    statistics.addShapeTest("ShapePlanar");
+    statistics.addShapeTest(other.c_str());
+
+    const std::vector<TraceStatistics::ShapeTests> tests = statistics.getShapeTests();
+    ASSERT_EQ(tests.size(), 2u);
+    EXPECT_EQ(tests[0].shape, QString("ShapeParabolic"));
+    EXPECT_EQ(tests[0].count, 1u);
+    EXPECT_EQ(tests[1].shape, QString("ShapePlanar"));
+    EXPECT_EQ(tests[1].count, 3u);
+}
+
+TEST(TraceStatisticsTest, AddsTheCountersOfWorkers)
+{
+    TraceStatistics a;
+    a.rays = 10;
+    a.bounces = 4;
+    a.hits = 6;
+    a.sunMisses = 4;
+    a.boxTests = 100;
+    a.addShapeTest("ShapeSphere");
+
+    TraceStatistics b;
+    b.rays = 5;
+    b.bounces = 1;
+    b.hits = 2;
+    b.sunMisses = 3;
+    b.boxTests = 40;
+    b.addShapeTest("ShapeSphere");
+    b.addShapeTest("ShapeCylinder");
+
+    TraceStatistics total;
+    total.add(a);
+    total.add(b);
+    EXPECT_EQ(total.rays, 15u);
+    EXPECT_EQ(total.bounces, 5u);
+    EXPECT_EQ(total.hits, 8u);
+    EXPECT_EQ(total.sunMisses, 7u);
+    EXPECT_EQ(total.boxTests, 140u);
+    const std::vector<TraceStatistics::ShapeTests> tests = total.getShapeTests();
+    ASSERT_EQ(tests.size(), 2u);
+    EXPECT_EQ(tests[0].shape, QString("ShapeCylinder"));
+    EXPECT_EQ(tests[1].count, 2u);
+
+    total.clear();
+    EXPECT_EQ(total.rays, 0u);
+    EXPECT_TRUE(total.getShapeTests().empty());
+}
+
+TEST(TraceStatisticsTest, ScopeMakesStatisticsCurrentForTheThread)
+{
+    ASSERT_TRUE(TraceStatistics::isEnabled());
+    TraceStatistics outer;
+    TraceStatistics inner;
+    EXPECT_EQ(TraceStatistics::current(), nullptr);
+    TRACE_STATS(boxTests++);
+    {
+        TraceStatisticsScope scopeOuter(&outer);
+        TRACE_STATS(boxTests++);
+        {
+            TraceStatisticsScope scopeInner(&inner);
+            TRACE_STATS(boxTests++);
+            TRACE_STATS(addShapeTest("ShapePlanar"));
+        }
+        EXPECT_EQ(TraceStatistics::current(), &outer);
+        TRACE_STATS(boxTests++);
+    }
+    EXPECT_EQ(TraceStatistics::current(), nullptr);
+    EXPECT_EQ(outer.boxTests, 2u);
+    EXPECT_EQ(inner.boxTests, 1u);
+    EXPECT_EQ(inner.getShapeTests().size(), 1u);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "kernel/run/TranslationalSymmetry.h"
+#include "libraries/math/3D/Ray.h"
+#include "libraries/math/3D/Transform.h"
+
+namespace {
+
+// a period of length 2 along x
+const Box3D Period(vec3d(0., -1., 0.), vec3d(2., 1., 1.));
+
+// the sun frame 10 m up, turned by angle about y
+Transform makeSun(double angle)
+{
+    const double c = std::cos(angle);
+    const double s = std::sin(angle);
+    return Transform(
+        c, 0., s, 0.,
+        0., 1., 0., 0.,
+        -s, 0., c, 10.,
+        0., 0., 0., 1.
+    );
+}
+
+} // namespace
+
+TEST(TranslationalSymmetryTest, WrapsIntoThePeriod)
+{
+    const TranslationalSymmetry symmetry(0, Period);
+    EXPECT_DOUBLE_EQ(symmetry.getPeriod(), 2.);
+
+    vec3d p(7.5, 3., -4.);
+    symmetry.wrap(p);
+    EXPECT_DOUBLE_EQ(p.x, 1.5);
+    EXPECT_DOUBLE_EQ(p.y, 3.);
+    p = vec3d(-0.5, 0., 0.);
+    symmetry.wrap(p);
+    EXPECT_DOUBLE_EQ(p.x, 1.5);
+}
+
+TEST(TranslationalSymmetryTest, FindsTheEndsAndTheSides)
+{
+    const TranslationalSymmetry symmetry(0, Period);
+    const Ray ray(vec3d(1.5, 0., 0.9), vec3d(1., 0., -1.).normalized());
+    EXPECT_NEAR(symmetry.findEnd(ray), 0.5*std::sqrt(2.), 1e-12);
+    EXPECT_NEAR(symmetry.findExit(ray), 0.9*std::sqrt(2.), 1e-12);
+
+    vec3d p = ray.point(symmetry.findEnd(ray));
+    symmetry.crossEnd(p, ray.direction());
+    EXPECT_DOUBLE_EQ(p.x, 0.);
+    EXPECT_NEAR(p.z, 0.4, 1e-12);
+
+    // parallel to the axis, the ray never leaves through a side
+    const Ray along(vec3d(1., 0., 0.5), vec3d(-1., 0., 0.));
+    EXPECT_TRUE(std::isinf(symmetry.findExit(along)));
+    EXPECT_DOUBLE_EQ(symmetry.findEnd(along), 1.);
+
+    const Ray away(vec3d(1., 0., 2.), vec3d(0., 0., 1.));
+    EXPECT_LT(symmetry.findExit(away), 0.);
+}
+
+TEST(TranslationalSymmetryTest, StripIsOnePeriodOfTheSunPlane)
+{
+    TranslationalSymmetry symmetry(0, Period);
+    // the axis seen from the sun is shortened by the cosine of the tilt
+    ASSERT_TRUE(symmetry.setSun(makeSun(M_PI/3.)));
+    EXPECT_NEAR(symmetry.getApertureArea(), 2.*0.5*2., 1e-12);
+
+    const vec3d a = symmetry.sampleAperture(0., 0.5);
+    const vec3d b = symmetry.sampleAperture(1., 0.5);
+    EXPECT_NEAR((b - a).norm(), 1., 1e-12);
+    EXPECT_DOUBLE_EQ(a.z, 0.);
+
+    // a ray from the sun starts before the box, in the period
+    const Transform sun = makeSun(M_PI/3.);
+    Ray ray = sun(Ray(symmetry.sampleAperture(0.3, 0.5), vec3d(0., 0., -1.)));
+    symmetry.enter(ray);
+    EXPECT_GE(ray.origin.x, 0.);
+    EXPECT_LT(ray.origin.x, 2.);
+    EXPECT_GT(symmetry.findExit(ray), 0.);
+}
+
+TEST(TranslationalSymmetryTest, RejectsTheSunAlongTheAxis)
+{
+    TranslationalSymmetry symmetry(0, Period);
+    EXPECT_FALSE(symmetry.setSun(makeSun(M_PI/2.)));
+    EXPECT_DOUBLE_EQ(symmetry.getApertureArea(), 0.);
+}
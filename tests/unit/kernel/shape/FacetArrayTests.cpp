@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/FacetArray.h"
+
+namespace
+{
+// a facet of 1 x 1 in the plane z = 0 of its frame
+bool intersectFacet(const Ray& ray, double* tHit, DifferentialGeometry* dg)
+{
+    double t = -ray.origin.z/ray.direction().z;
+    if (!(t > ray.tMin && t < ray.tMax)) return false;
+    vec3d p = ray.point(t);
+    if (std::abs(p.x) > 0.5 || std::abs(p.y) > 0.5) return false;
+    if (tHit) *tHit = t;
+    if (dg) {
+        dg->point = p;
+        dg->dpdu = vec3d(1., 0., 0.);
+        dg->dpdv = vec3d(0., 1., 0.);
+        dg->normal = vec3d(0., 0., 1.);
+        dg->isFront = ray.direction().z < 0.;
+    }
+    return true;
+}
+
+const Box3D FacetBox(vec3d(-0.5, -0.5, -0.01), vec3d(0.5, 0.5, 0.01));
+
+// facets on a 5 x 4 grid canted toward a point above the center
+void fill(FacetArray& facets)
+{
+    const vec3d aim(0., 0., 20.);
+    for (int i = 0; i < 5; ++i)
+        for (int j = 0; j < 4; ++j) {
+            vec3d center(1.1*(i - 2), 1.1*(j - 1.5), 0.);
+            facets.addFacet(center, vec3d(1., 0., 0.), aim - center);
+        }
+    facets.build(FacetBox);
+}
+}
+
+TEST(FacetArrayTest, FindsTheClosestFacet)
+{
+    FacetArray facets;
+    fill(facets);
+    ASSERT_EQ(facets.size(), 20);
+
+    std::mt19937 engine(3);
+    std::uniform_real_distribution<double> uniform(-1., 1.);
+    int hits = 0;
+    for (int r = 0; r < 2000; ++r) {
+        Ray ray(vec3d(3.*uniform(engine), 3.*uniform(engine), 5.), vec3d(0.3*uniform(engine), 0.3*uniform(engine), -1.));
+
+        // every facet in turn
+        int best = -1;
+        double tBest = ray.tMax;
+        for (int n = 0; n < facets.size(); ++n) {
+            double t;
+            Ray rayFacet = facets.toFacet(n, ray);
+            rayFacet.tMax = tBest;
+            if (intersectFacet(rayFacet, &t, nullptr)) {
+                tBest = t;
+                best = n;
+            }
+        }
+
+        double tHit = 0.;
+        DifferentialGeometry dg;
+        bool isHit = facets.intersect(ray, &tHit, &dg, [](int, const Ray& rayFacet, double* t, DifferentialGeometry* dgFacet) {
+            return intersectFacet(rayFacet, t, dgFacet);
+        });
+        bool isHitP = facets.intersectP(ray, [](int, const Ray& rayFacet) {
+            return intersectFacet(rayFacet, nullptr, nullptr);
+        });
+        ASSERT_EQ(isHit, best >= 0);
+        ASSERT_EQ(isHitP, best >= 0);
+        if (!isHit) continue;
+        ++hits;
+
+        EXPECT_NEAR(tHit, tBest, 1e-12);
+        const FacetArray::Facet& facet = facets.getFacet(best);
+        EXPECT_NEAR((dg.point - ray.point(tHit)).norm(), 0., 1e-9);
+        EXPECT_NEAR((dg.normal - facet.axes[2]).norm(), 0., 1e-12);
+        EXPECT_TRUE(dg.isFront);
+    }
+    EXPECT_GT(hits, 500);
+}
+
+TEST(FacetArrayTest, CantsFacetsAboutTheirCenters)
+{
+    FacetArray facets;
+    fill(facets);
+
+    for (int n = 0; n < facets.size(); ++n) {
+        const FacetArray::Facet& facet = facets.getFacet(n);
+        EXPECT_NEAR(dot(facet.axes[0], facet.axes[1]), 0., 1e-12);
+        EXPECT_NEAR(dot(facet.axes[1], facet.axes[2]), 0., 1e-12);
+        EXPECT_NEAR(cross(facet.axes[0], facet.axes[1]).norm(), 1., 1e-12);
+
+        // the normal at the center points to the aim
+        vec3d toAim = (vec3d(0., 0., 20.) - facet.center).normalized();
+        EXPECT_NEAR((facet.axes[2] - toAim).norm(), 0., 1e-12);
+        EXPECT_TRUE(facets.getBox().isInside(facet.center));
+
+        vec3d p(0.3, -0.2, 0.);
+        EXPECT_NEAR((facet.toFacetPoint(facet.toArrayPoint(p)) - p).norm(), 0., 1e-12);
+    }
+}
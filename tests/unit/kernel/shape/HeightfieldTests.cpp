@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/Heightfield.h"
+#include "kernel/shape/TriangleMesh.h"
+
+namespace
+{
+// z = sin(x)cos(y) on nx x ny vertices of spacing 0.5, indexed i*ny + j
+struct Grid
+{
+    int nx;
+    int ny;
+    std::vector<float> points;
+    std::vector<float> normals;
+
+    Grid(int nx, int ny): nx(nx), ny(ny)
+    {
+        for (int i = 0; i < nx; ++i)
+            for (int j = 0; j < ny; ++j) {
+                double x = 0.5*(i - nx/2);
+                double y = 0.5*(j - ny/2);
+                vec3d n(-std::cos(x)*std::cos(y), std::sin(x)*std::sin(y), 1.);
+                n.normalize();
+                points.insert(points.end(), {float(x), float(y), float(std::sin(x)*std::cos(y))});
+                normals.insert(normals.end(), {float(n.x), float(n.y), float(n.z)});
+            }
+    }
+
+    vec3d point(int n) const {return vec3d(points[3*n], points[3*n + 1], points[3*n + 2]);}
+    vec3d normal(int n) const {return vec3d(normals[3*n], normals[3*n + 1], normals[3*n + 2]);}
+
+    void fill(TriangleMesh& mesh) const
+    {
+        for (int i = 0; i < nx - 1; ++i)
+            for (int j = 0; j < ny - 1; ++j) {
+                int iA = i*ny + j;
+                int iB = iA + ny;
+                int iC = iB + 1;
+                int iD = iA + 1;
+                mesh.addTriangle(point(iA), point(iB), point(iC), normal(iA), normal(iB), normal(iC));
+                mesh.addTriangle(point(iA), point(iC), point(iD), normal(iA), normal(iC), normal(iD));
+            }
+        mesh.build();
+    }
+};
+}
+
+TEST(HeightfieldTest, RejectsPointsOffTheGrid)
+{
+    Grid grid(4, 3);
+    Heightfield field;
+    EXPECT_TRUE(field.build(grid.nx, grid.ny, grid.points.data(), grid.normals.data()));
+
+    grid.points[3*5] += 0.1f;
+    EXPECT_FALSE(field.build(grid.nx, grid.ny, grid.points.data(), grid.normals.data()));
+    EXPECT_TRUE(field.isEmpty());
+
+    Heightfield line;
+    EXPECT_FALSE(line.build(1, 3, grid.points.data(), grid.normals.data()));
+}
+
+TEST(HeightfieldTest, BoxMatchesMesh)
+{
+    const Grid grid(13, 9);
+    TriangleMesh mesh;
+    grid.fill(mesh);
+    Heightfield field;
+    ASSERT_TRUE(field.build(grid.nx, grid.ny, grid.points.data(), grid.normals.data()));
+
+    for (int k = 0; k < 3; ++k) {
+        EXPECT_DOUBLE_EQ(field.getBox().min()[k], mesh.getBox().min()[k]);
+        EXPECT_DOUBLE_EQ(field.getBox().max()[k], mesh.getBox().max()[k]);
+    }
+}
+
+TEST(HeightfieldTest, MatchesTriangleMesh)
+{
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    for (int nx : {2, 5, 17, 33}) {
+        const Grid grid(nx, 21);
+        TriangleMesh mesh;
+        grid.fill(mesh);
+        Heightfield field;
+        ASSERT_TRUE(field.build(grid.nx, grid.ny, grid.points.data(), grid.normals.data()));
+
+        for (int n = 0; n < 1000; ++n) {
+            const vec3d origin(0.3*nx*uniform(generator), 6.0*uniform(generator), 3.0*uniform(generator));
+            const vec3d direction(uniform(generator), uniform(generator), uniform(generator));
+            const Ray ray(origin, direction);
+
+            double tExpected = 0.;
+            DifferentialGeometry dgExpected;
+            const bool expected = mesh.intersect(ray, &tExpected, &dgExpected);
+
+            double t = 0.;
+            DifferentialGeometry dg;
+            ASSERT_EQ(field.intersect(ray, &t, &dg), expected);
+            if (expected) {
+                EXPECT_DOUBLE_EQ(t, tExpected);
+                EXPECT_NEAR(dot(dg.normal, dgExpected.normal), 1.0, 1e-9);
+                EXPECT_EQ(dg.isFront, dgExpected.isFront);
+            }
+        }
+    }
+}
+
+TEST(HeightfieldTest, AnyHitAgreesWithClosestHit)
+{
+    std::mt19937 generator(13);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    const Grid grid(33, 21);
+    Heightfield field;
+    ASSERT_TRUE(field.build(grid.nx, grid.ny, grid.points.data(), grid.normals.data()));
+    for (int n = 0; n < 1000; ++n) {
+        const vec3d origin(10.0*uniform(generator), 6.0*uniform(generator), 3.0*uniform(generator));
+        const vec3d direction(uniform(generator), uniform(generator), uniform(generator));
+        const Ray ray(origin, direction, gcf::Epsilon, 4.0 + 3.0*uniform(generator));
+
+        double t = 0.;
+        DifferentialGeometry dg;
+        EXPECT_EQ(field.intersectP(ray), field.intersect(ray, &t, &dg));
+    }
+    EXPECT_FALSE(Heightfield().intersectP(Ray(vec3d(0.0, 0.0, 5.0), vec3d(0.0, 0.0, -1.0))));
+}
+
+TEST(HeightfieldTest, RespectsRayInterval)
+{
+    const Grid grid(9, 9);
+    Heightfield field;
+    ASSERT_TRUE(field.build(grid.nx, grid.ny, grid.points.data(), grid.normals.data()));
+
+    double t = 0.;
+    DifferentialGeometry dg;
+    EXPECT_FALSE(field.intersect(Ray(vec3d(0.1, 0.2, 3.0), vec3d(0.0, 0.0, -1.0), gcf::Epsilon, 1.0), &t, &dg));
+    EXPECT_TRUE(field.intersect(Ray(vec3d(0.1, 0.2, 3.0), vec3d(0.0, 0.0, -1.0)), &t, &dg));
+}
+
+TEST(HeightfieldTest, HeightMatchesVerticalRays)
+{
+    std::mt19937 generator(17);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    const Grid grid(17, 9);
+    Heightfield field;
+    ASSERT_TRUE(field.build(grid.nx, grid.ny, grid.points.data(), grid.normals.data()));
+    for (int n = 0; n < 1000; ++n) {
+        const double x = 3.9*uniform(generator);
+        const double y = 1.9*uniform(generator);
+        const Ray ray(vec3d(x, y, 5.0), vec3d(0.0, 0.0, -1.0));
+
+        double t = 0.;
+        DifferentialGeometry dg;
+        ASSERT_TRUE(field.intersect(ray, &t, &dg));
+        double z = 0.;
+        ASSERT_TRUE(field.findHeight(x, y, &z));
+        EXPECT_NEAR(z, 5.0 - t, 1e-9);
+    }
+
+    double z = 0.;
+    EXPECT_TRUE(field.findHeight(-4.0, -2.0, &z));
+    EXPECT_DOUBLE_EQ(z, grid.points[2]);
+    EXPECT_FALSE(field.findHeight(4.1, 0.0, &z));
+    EXPECT_FALSE(Heightfield().findHeight(0.0, 0.0, &z));
+}
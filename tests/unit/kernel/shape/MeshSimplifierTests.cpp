@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "kernel/shape/MeshSimplifier.h"
+
+namespace
+{
+// a wavy sheet of n x n vertices over [0, 1]^2, quads as SoIndexedFaceSet faces
+struct Sheet
+{
+    int n;
+    std::vector<float> vertices;
+    std::vector<int> faces;
+
+    explicit Sheet(int n): n(n)
+    {
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j) {
+                float x = float(i)/(n - 1);
+                float y = float(j)/(n - 1);
+                vertices.insert(vertices.end(), {x, y, 0.05f*std::sin(6.f*x)});
+            }
+        for (int i = 0; i < n - 1; ++i)
+            for (int j = 0; j < n - 1; ++j) {
+                int a = i*n + j;
+                faces.insert(faces.end(), {a, a + n, a + n + 1, a + 1, -1});
+            }
+    }
+
+    MeshSimplifier::Input input() const
+    {
+        MeshSimplifier::Input ans;
+        ans.vertices = vertices.data();
+        ans.vertexCount = int(vertices.size()/3);
+        ans.faces = faces.data();
+        ans.faceCount = int(faces.size());
+        return ans;
+    }
+};
+}
+
+TEST(MeshSimplifier, FineCellsKeepTheFanTriangles)
+{
+    Sheet sheet(11);
+    MeshLevel level = MeshSimplifier::makeLevel(sheet.input(), 1e-4f);
+    EXPECT_EQ(level.getTriangleCount(), 2*10*10);
+    EXPECT_EQ(level.vertices.size(), sheet.vertices.size());
+    for (size_t n = 0; n < level.normals.size(); n += 3)
+        EXPECT_GT(level.normals[n + 2], 0.9f);
+}
+
+TEST(MeshSimplifier, VerticesMoveLessThanACell)
+{
+    Sheet sheet(41);
+    const float cell = 0.1f;
+    MeshLevel level = MeshSimplifier::makeLevel(sheet.input(), cell);
+    EXPECT_LT(level.getTriangleCount(), 2*40*40/4);
+    EXPECT_GT(level.getTriangleCount(), 0);
+
+    // every input vertex has a level vertex within the diagonal of a cell
+    for (size_t n = 0; n < sheet.vertices.size(); n += 3) {
+        double best = 1e9;
+        for (size_t m = 0; m < level.vertices.size(); m += 3) {
+            double d = 0.;
+            for (int k = 0; k < 3; ++k)
+                d += std::pow(double(sheet.vertices[n + k]) - level.vertices[m + k], 2);
+            best = std::min(best, d);
+        }
+        EXPECT_LE(std::sqrt(best), cell*std::sqrt(3.) + 1e-6);
+    }
+    for (int index : level.triangles) {
+        EXPECT_GE(index, 0);
+        EXPECT_LT(index, int(level.vertices.size()/3));
+    }
+}
+
+TEST(MeshSimplifier, LevelsHalveDownToTheMinimum)
+{
+    Sheet sheet(201);
+    std::vector<MeshLevel> levels = MeshSimplifier::makeLevels(sheet.input(), 100);
+    ASSERT_GE(levels.size(), 2u);
+    int previous = 2*200*200;
+    for (const MeshLevel& level : levels) {
+        EXPECT_LE(level.getTriangleCount(), previous/2);
+        previous = level.getTriangleCount();
+    }
+    EXPECT_LT(levels.back().error, 1.01f);
+    for (size_t n = 1; n < levels.size(); ++n)
+        EXPECT_GT(levels[n].error, levels[n - 1].error);
+}
+
+TEST(MeshSimplifier, CanceledMakesNoLevels)
+{
+    Sheet sheet(101);
+    std::vector<MeshLevel> levels = MeshSimplifier::makeLevels(sheet.input(), 100, []() {return true;});
+    EXPECT_TRUE(levels.empty());
+}
+
+TEST(MeshSimplifier, SmallMeshesNeedNoLevels)
+{
+    Sheet sheet(5);
+    EXPECT_TRUE(MeshSimplifier::makeLevels(sheet.input(), 1000).empty());
+}
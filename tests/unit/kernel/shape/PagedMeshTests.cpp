@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/PagedMesh.h"
+#include "kernel/shape/TriangleMesh.h"
+
+namespace
+{
+// height field z = sin(x)cos(y) over [-n, n]^2 split into 2*(2n)^2 triangles
+template<class Mesh>
+void AddTriangles(Mesh& mesh, int n)
+{
+    auto point = [](int i, int j) {
+        double x = 0.5*i;
+        double y = 0.5*j;
+        return vec3d(x, y, std::sin(x)*std::cos(y));
+    };
+    const vec3d nz(0.0, 0.6, 0.8);
+    for (int i = -n; i < n; ++i)
+        for (int j = -n; j < n; ++j) {
+            mesh.addTriangle(point(i, j), point(i + 1, j), point(i + 1, j + 1), nz, nz, nz);
+            mesh.addTriangle(point(i, j), point(i + 1, j + 1), point(i, j + 1), nz, nz, nz);
+        }
+}
+
+// the hits of the paged mesh are those of the mesh within the rounding of the vertices
+void ExpectSameHits(const TriangleMesh& mesh, const PagedMesh& paged, int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(-7.0, 7.0);
+    int hits = 0;
+    for (int n = 0; n < 300; ++n) {
+        const Ray ray(vec3d(uniform(generator), uniform(generator), 5.0), vec3d(0.1*uniform(generator), 0.1*uniform(generator), -1.0));
+        double t = 0.;
+        double tPaged = 0.;
+        DifferentialGeometry dg;
+        DifferentialGeometry dgPaged;
+        const bool isHit = mesh.intersect(ray, &t, &dg);
+        ASSERT_EQ(paged.intersect(ray, &tPaged, &dgPaged), isHit);
+        EXPECT_EQ(paged.intersectP(ray), isHit);
+        if (!isHit) continue;
+        hits++;
+        EXPECT_NEAR(tPaged, t, 1e-5);
+        EXPECT_NEAR(dgPaged.normal.y, dg.normal.y, 1e-4);
+        EXPECT_NEAR(dgPaged.normal.z, dg.normal.z, 1e-4);
+    }
+    EXPECT_GT(hits, 100);
+}
+}
+
+TEST(PagedMeshTest, HitsAsTheBuiltMesh)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    TriangleMesh mesh;
+    AddTriangles(mesh, 12);
+    mesh.build();
+    PagedMesh paged(64);
+    AddTriangles(paged, 12);
+    QString error;
+    ASSERT_TRUE(paged.build(dir.filePath("mesh.pages"), &error)) << error.toStdString();
+
+    EXPECT_EQ(paged.size(), qulonglong(mesh.size()));
+    EXPECT_GE(paged.getClusterCount(), mesh.size()/(4*64));
+    ExpectSameHits(mesh, paged, 7);
+
+    // opened again, in place of building
+    PagedMesh copy;
+    ASSERT_TRUE(copy.open(dir.filePath("mesh.pages"), &error)) << error.toStdString();
+    EXPECT_EQ(copy.getClusterCount(), paged.getClusterCount());
+    EXPECT_EQ(copy.getNodes().size(), paged.getNodes().size());
+    ExpectSameHits(mesh, copy, 8);
+}
+
+TEST(PagedMeshTest, KeepsTheClustersWithinTheCache)
+{
+    QTemporaryDir dir;
+    TriangleMesh mesh;
+    AddTriangles(mesh, 12);
+    mesh.build();
+    PagedMesh paged(64);
+    AddTriangles(paged, 12);
+    ASSERT_TRUE(paged.build(dir.filePath("mesh.pages")));
+
+    // one cluster at a time, rebuilt where reached again
+    const qulonglong bytes = PagedMesh::getCacheBytes();
+    PagedMesh::setCacheBytes(1);
+    const PagedMesh::CacheStatistics before = PagedMesh::getCacheStatistics();
+    ExpectSameHits(mesh, paged, 9);
+    const PagedMesh::CacheStatistics after = PagedMesh::getCacheStatistics();
+    PagedMesh::setCacheBytes(bytes);
+    EXPECT_EQ(after.clusters, 1u);
+    EXPECT_GT(after.misses - before.misses, qulonglong(paged.getClusterCount()));
+
+    // all of them once, with room
+    ExpectSameHits(mesh, paged, 9);
+    ExpectSameHits(mesh, paged, 9);
+    const PagedMesh::CacheStatistics warm = PagedMesh::getCacheStatistics();
+    EXPECT_LE(warm.misses - after.misses, qulonglong(paged.getClusterCount()));
+    EXPECT_GT(warm.hits, after.hits);
+}
+
+TEST(PagedMeshTest, RefusesDamagedFiles)
+{
+    QTemporaryDir dir;
+    PagedMesh paged(64);
+    AddTriangles(paged, 4);
+    const QString fileName = dir.filePath("mesh.pages");
+    ASSERT_TRUE(paged.build(fileName));
+    paged.clear();
+
+    QFile file(fileName);
+    ASSERT_TRUE(file.open(QIODevice::ReadWrite));
+    ASSERT_TRUE(file.resize(file.size() - 1));
+    file.close();
+
+    QString error;
+    PagedMesh copy;
+    EXPECT_FALSE(copy.open(fileName, &error));
+    EXPECT_FALSE(error.isEmpty());
+    EXPECT_TRUE(copy.isEmpty());
+    EXPECT_FALSE(copy.open(dir.filePath("missing.pages")));
+}
+
+TEST(PagedMeshTest, EmptyMeshHasNoHits)
+{
+    QTemporaryDir dir;
+    PagedMesh paged;
+    ASSERT_TRUE(paged.build(dir.filePath("empty.pages")));
+    double t = 0.;
+    DifferentialGeometry dg;
+    EXPECT_TRUE(paged.isEmpty());
+    EXPECT_EQ(paged.getClusterCount(), 0);
+    EXPECT_FALSE(paged.intersect(Ray(vec3d(0.0, 0.0, 5.0), vec3d(0.0, 0.0, -1.0)), &t, &dg));
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "kernel/shape/PolygonMeshCache.h"
+
+namespace
+{
+// a maker counting its calls; the meshes are null, as for failed triangulations
+PolygonMeshCache::Maker CountingMaker(std::atomic<int>& calls)
+{
+    return [&calls]() {
+        calls++;
+        return PolygonMeshCache::Mesh();
+    };
+}
+}
+
+TEST(PolygonMeshCacheTest, MakesEachKeyOnce)
+{
+    PolygonMeshCache::clear();
+    std::atomic<int> calls(0);
+    PolygonMeshCache::find("square", CountingMaker(calls));
+    PolygonMeshCache::find("square", CountingMaker(calls));
+    PolygonMeshCache::find("hexagon", CountingMaker(calls));
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(PolygonMeshCache::getCount(), 2);
+    PolygonMeshCache::clear();
+    EXPECT_EQ(PolygonMeshCache::getCount(), 0);
+}
+
+TEST(PolygonMeshCacheTest, PreparesTheDistinctKeysNotKept)
+{
+    PolygonMeshCache::clear();
+    std::atomic<int> calls(0);
+    PolygonMeshCache::find("kept", CountingMaker(calls));
+
+    std::vector<std::pair<QByteArray, PolygonMeshCache::Maker>> jobs;
+    for (int n = 0; n < 1000; ++n)
+        jobs.emplace_back(QByteArray(n % 3 == 0 ? "kept" : n % 3 == 1 ? "a" : "b"), CountingMaker(calls));
+    PolygonMeshCache::prepare(jobs);
+    EXPECT_EQ(calls, 3);
+    EXPECT_EQ(PolygonMeshCache::getCount(), 3);
+
+    // found without making them again
+    PolygonMeshCache::find("a", CountingMaker(calls));
+    PolygonMeshCache::find("b", CountingMaker(calls));
+    EXPECT_EQ(calls, 3);
+    PolygonMeshCache::clear();
+}
+
+TEST(PolygonMeshCacheTest, DropsTheOldestBeyondTheCapacity)
+{
+    PolygonMeshCache::clear();
+    const int capacity = PolygonMeshCache::getCapacity();
+    PolygonMeshCache::setCapacity(2);
+    std::atomic<int> calls(0);
+    PolygonMeshCache::find("first", CountingMaker(calls));
+    PolygonMeshCache::find("second", CountingMaker(calls));
+    PolygonMeshCache::find("third", CountingMaker(calls));
+    EXPECT_EQ(PolygonMeshCache::getCount(), 2);
+
+    PolygonMeshCache::find("third", CountingMaker(calls));
+    EXPECT_EQ(calls, 3);
+    PolygonMeshCache::find("first", CountingMaker(calls));
+    EXPECT_EQ(calls, 4);
+
+    PolygonMeshCache::setCapacity(capacity);
+    PolygonMeshCache::clear();
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "kernel/shape/QuadricBatch.h"
+#include "libraries/math/3D/Ray.h"
+#include "libraries/math/3D/Transform.h"
+
+namespace
+{
+enum Kind {Planar, Parabolic, Sphere};
+
+struct Leaf
+{
+    Kind kind;
+    double fX;
+    double fY;
+    double uSize;
+    double vSize;
+    Affine3D transform;
+    Box3D box;
+};
+
+// the scalar tests of ShapeRT, ShapeParabolic and ShapeSphere with a box profile
+bool Intersect(const Leaf& leaf, const Ray& ray)
+{
+    auto isInside = [&](const vec3d& p) {
+        return leaf.kind == Sphere || (2.*std::abs(p.x) <= leaf.uSize && 2.*std::abs(p.y) <= leaf.vSize);
+    };
+
+    if (leaf.kind == Planar) {
+        double t = -ray.origin.z*ray.invDirection().z;
+        if (t < ray.tMin + 1e-5 || t > ray.tMax) return false;
+        return isInside(ray.point(t));
+    }
+
+    const vec3d& o = ray.origin;
+    const vec3d& d = ray.direction();
+    double A, B, C;
+    if (leaf.kind == Parabolic) {
+        double gX = 1./leaf.fX;
+        double gY = 1./leaf.fY;
+        A = d.x*d.x*gX + d.y*d.y*gY;
+        B = 2.*(d.x*o.x*gX + d.y*o.y*gY) - 4.*d.z;
+        C = o.x*o.x*gX + o.y*o.y*gY - 4.*o.z;
+    } else {
+        A = d.norm2();
+        B = 2.*dot(d, o);
+        C = o.norm2() - 1.;
+    }
+    double ts[2];
+    if (!gcf::solveQuadratic(A, B, C, &ts[0], &ts[1])) return false;
+    for (double t : ts) {
+        if (t < ray.tMin + 1e-5 || t > ray.tMax) continue;
+        if (isInside(ray.point(t))) return true;
+    }
+    return false;
+}
+
+std::vector<Leaf> MakeLeaves(int n, QuadricBatch& batch)
+{
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    std::vector<Leaf> leaves;
+    for (int i = 0; i < n; ++i) {
+        Transform transform =
+            Transform::translate(vec3d(10.*uniform(generator), 10.*uniform(generator), uniform(generator))) *
+            Transform::rotateX(uniform(generator)) *
+            Transform::rotateZ(3.*uniform(generator));
+        Leaf leaf{Kind(i % 3), 2. + uniform(generator), 2. + uniform(generator),
+            1. + 0.5*uniform(generator), 1. + 0.5*uniform(generator),
+            Affine3D(transform), transform(Box3D(vec3d(-2., -2., -2.), vec3d(2., 2., 2.)))};
+
+        QuadricBatch::Quadric quadric;
+        if (leaf.kind == Sphere) {
+            quadric.a = vec3d(1., 1., 1.);
+            quadric.c = -1.;
+        } else {
+            if (leaf.kind == Parabolic) quadric.a = vec3d(1./leaf.fX, 1./leaf.fY, 0.);
+            quadric.b = leaf.kind == Parabolic ? -4. : 1.;
+            quadric.xMax = leaf.uSize/2.;
+            quadric.xMin = -quadric.xMax;
+            quadric.yMax = leaf.vSize/2.;
+            quadric.yMin = -quadric.yMax;
+        }
+        batch.add(leaf.box, leaf.transform, quadric);
+        leaves.push_back(leaf);
+    }
+    return leaves;
+}
+}
+
+TEST(QuadricBatchTest, NeverRejectsAHit)
+{
+    QuadricBatch batch;
+    const std::vector<Leaf> leaves = MakeLeaves(402, batch);
+    ASSERT_EQ(batch.size(), 402);
+
+    std::mt19937 generator(9);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    int hits = 0;
+    int passed = 0;
+    for (int r = 0; r < 2000; ++r) {
+        Ray ray(vec3d(12.*uniform(generator), 12.*uniform(generator), 6.), vec3d(0.5*uniform(generator), 0.5*uniform(generator), -1.));
+        if (r % 2) ray.tMax = 6. + 2.*uniform(generator);
+
+        for (int begin = 0; begin < batch.size(); begin += QuadricBatch::Width) {
+            int count = std::min(QuadricBatch::Width, batch.size() - begin);
+            int mask = batch.filter(ray, begin, count);
+            for (int k = 0; k < count; ++k) {
+                const Leaf& leaf = leaves[begin + k];
+                bool hit = leaf.box.intersect(ray) && Intersect(leaf, leaf.transform.transformInverse(ray));
+                bool kept = mask & (1 << k);
+                if (hit) {
+                    hits++;
+                    ASSERT_TRUE(kept);
+                }
+                if (kept) passed++;
+            }
+        }
+    }
+
+    EXPECT_GT(hits, 0);
+    // the widening keeps very few misses
+    EXPECT_LE(passed, hits + hits/100 + 10);
+}
+
+TEST(QuadricBatchTest, BoxOnlyLeavesPassInsideTheirBox)
+{
+    QuadricBatch batch;
+    batch.add(Box3D(vec3d(-1., -1., -1.), vec3d(1., 1., 1.)));
+    batch.add(Box3D(vec3d(4., 4., -1.), vec3d(5., 5., 1.)));
+
+    const vec3d direction = vec3d(0.01, 0.01, -1.).normalized();
+    EXPECT_EQ(batch.filter(Ray(vec3d(0., 0., 5.), direction), 0, 2), 1);
+    EXPECT_EQ(batch.filter(Ray(vec3d(0., 0., 5.), direction, gcf::Epsilon, 1.), 0, 2), 0);
+    EXPECT_EQ(batch.filter(Ray(vec3d(4.5, 4.5, 5.), vec3d(0., 0., -1.)), 0, 2), 2);
+}
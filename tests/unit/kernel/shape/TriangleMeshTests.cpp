@@ -0,0 +1,273 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <set>
+
+#include "kernel/shape/DifferentialGeometry.h"
+#include "kernel/shape/TriangleMesh.h"
+
+namespace
+{
+// height field z = sin(x)cos(y) over [-n, n]^2 split into 2*(2n)^2 triangles
+TriangleMesh MakeMesh(int n, int leafSize)
+{
+    TriangleMesh mesh(leafSize);
+    auto point = [](int i, int j) {
+        double x = 0.5*i;
+        double y = 0.5*j;
+        return vec3d(x, y, std::sin(x)*std::cos(y));
+    };
+    const vec3d nz(0.0, 0.0, 1.0);
+    for (int i = -n; i < n; ++i)
+        for (int j = -n; j < n; ++j) {
+            mesh.addTriangle(point(i, j), point(i + 1, j), point(i + 1, j + 1), nz, nz, nz);
+            mesh.addTriangle(point(i, j), point(i + 1, j + 1), point(i, j + 1), nz, nz, nz);
+        }
+    mesh.build();
+    return mesh;
+}
+
+bool BruteForce(const TriangleMesh& mesh, const Ray& ray, double* tHit, DifferentialGeometry* dg)
+{
+    bool isHit = false;
+    double tBest = ray.tMax;
+    for (int n = 0; n < mesh.size(); ++n) {
+        double t = 0.;
+        DifferentialGeometry dgT;
+        if (mesh.getTriangle(n).intersect(ray, &t, &dgT) && t < tBest) {
+            tBest = t;
+            *dg = dgT;
+            isHit = true;
+        }
+    }
+    *tHit = tBest;
+    return isHit;
+}
+}
+
+TEST(TriangleMeshTest, EmptyMeshHasNoHits)
+{
+    TriangleMesh mesh;
+    mesh.build();
+
+    double t = 0.;
+    DifferentialGeometry dg;
+    EXPECT_TRUE(mesh.isEmpty());
+    EXPECT_FALSE(mesh.intersect(Ray(vec3d(0.0, 0.0, 5.0), vec3d(0.0, 0.0, -1.0)), &t, &dg));
+}
+
+TEST(TriangleMeshTest, BoxCoversAllTriangles)
+{
+    const TriangleMesh mesh = MakeMesh(8, 4);
+    const Box3D& box = mesh.getBox();
+
+    EXPECT_EQ(mesh.size(), 2*16*16);
+    for (int n = 0; n < mesh.size(); ++n) {
+        const Box3D triangleBox = mesh.getTriangle(n).box();
+        for (int k = 0; k < 3; ++k) {
+            EXPECT_LE(box.min()[k], triangleBox.min()[k]);
+            EXPECT_GE(box.max()[k], triangleBox.max()[k]);
+        }
+    }
+    EXPECT_DOUBLE_EQ(box.min().x, -4.0);
+    EXPECT_DOUBLE_EQ(box.max().y, 4.0);
+}
+
+TEST(TriangleMeshTest, MatchesBruteForceClosestHit)
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    for (int leafSize : {1, 4, 16}) {
+        const TriangleMesh mesh = MakeMesh(8, leafSize);
+        for (int n = 0; n < 500; ++n) {
+            const vec3d origin(4.5*uniform(generator), 4.5*uniform(generator), 3.0);
+            const vec3d direction(0.5*uniform(generator), 0.5*uniform(generator), -1.0);
+            const Ray ray(origin, direction);
+
+            double tExpected = 0.;
+            DifferentialGeometry dgExpected;
+            const bool expected = BruteForce(mesh, ray, &tExpected, &dgExpected);
+
+            double t = 0.;
+            DifferentialGeometry dg;
+            ASSERT_EQ(mesh.intersect(ray, &t, &dg), expected);
+            if (expected) {
+                EXPECT_DOUBLE_EQ(t, tExpected);
+                EXPECT_DOUBLE_EQ(dg.uv.x, dgExpected.uv.x);
+                EXPECT_DOUBLE_EQ(dg.uv.y, dgExpected.uv.y);
+                EXPECT_NEAR(dot(dg.normal, dgExpected.normal), 1.0, 1e-12);
+                EXPECT_EQ(dg.isFront, dgExpected.isFront);
+                EXPECT_DOUBLE_EQ(ray.tMax, gcf::infinity);
+            }
+        }
+    }
+}
+
+TEST(TriangleMeshTest, RespectsRayInterval)
+{
+    const TriangleMesh mesh = MakeMesh(4, 4);
+    const Ray ray(vec3d(0.1, 0.2, 3.0), vec3d(0.0, 0.0, -1.0), gcf::Epsilon, 1.0);
+
+    double t = 0.;
+    DifferentialGeometry dg;
+    EXPECT_FALSE(mesh.intersect(ray, &t, &dg));
+}
+
+TEST(TriangleMeshTest, AnyHitAgreesWithClosestHit)
+{
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    for (int leafSize : {1, 4, 16}) {
+        const TriangleMesh mesh = MakeMesh(8, leafSize);
+        for (int n = 0; n < 500; ++n) {
+            const vec3d origin(4.5*uniform(generator), 4.5*uniform(generator), 3.0);
+            const vec3d direction(0.5*uniform(generator), 0.5*uniform(generator), -1.0);
+            const Ray ray(origin, direction, gcf::Epsilon, 2.5 + 1.5*uniform(generator));
+
+            double t = 0.;
+            DifferentialGeometry dg;
+            EXPECT_EQ(mesh.intersectP(ray), mesh.intersect(ray, &t, &dg));
+        }
+    }
+    EXPECT_FALSE(TriangleMesh().intersectP(Ray(vec3d(0.0, 0.0, 5.0), vec3d(0.0, 0.0, -1.0))));
+}
+
+TEST(TriangleMeshTest, SinglePrecisionNodesVisitEveryLeaf)
+{
+    std::mt19937 generator(9);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    const TriangleMesh mesh = MakeMesh(8, 4);
+    const std::vector<BVHNode4F> nodes(mesh.getNodes().begin(), mesh.getNodes().end());
+    for (int n = 0; n < 500; ++n) {
+        const vec3d origin(4.5*uniform(generator), 4.5*uniform(generator), 3.0);
+        const vec3d direction(0.5*uniform(generator), 0.5*uniform(generator), -1.0);
+        const Ray ray(origin, direction);
+
+        std::set<int> leaves;
+        traverseBVH(mesh.getNodes(), ray, [&](int begin, int) {leaves.insert(begin);});
+        std::set<int> leavesSingle;
+        traverseBVH(nodes, ray, [&](int begin, int) {leavesSingle.insert(begin);});
+        EXPECT_TRUE(std::includes(leavesSingle.begin(), leavesSingle.end(), leaves.begin(), leaves.end()));
+        EXPECT_LE(leavesSingle.size(), leaves.size() + 2);
+    }
+}
+
+TEST(TriangleMeshTest, ReadsWhatItWrites)
+{
+    const TriangleMesh mesh = MakeMesh(6, 4);
+    std::vector<char> data;
+    mesh.write(data);
+
+    TriangleMesh copy;
+    const char* p = data.data();
+    ASSERT_TRUE(copy.read(p, data.data() + data.size()));
+    EXPECT_EQ(p, data.data() + data.size());
+    EXPECT_EQ(copy.size(), mesh.size());
+    EXPECT_EQ(copy.getNodes().size(), mesh.getNodes().size());
+
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<double> uniform(-3.0, 3.0);
+    for (int n = 0; n < 200; ++n) {
+        const Ray ray(vec3d(uniform(generator), uniform(generator), 5.0), vec3d(0.1*uniform(generator), 0.1*uniform(generator), -1.0));
+        double t = 0.;
+        double tCopy = 0.;
+        DifferentialGeometry dg;
+        DifferentialGeometry dgCopy;
+        ASSERT_EQ(mesh.intersect(ray, &t, &dg), copy.intersect(ray, &tCopy, &dgCopy));
+        EXPECT_EQ(t, tCopy);
+        EXPECT_EQ(dg.normal.z, dgCopy.normal.z);
+    }
+
+    TriangleMesh truncated;
+    p = data.data();
+    EXPECT_FALSE(truncated.read(p, data.data() + data.size() - 1));
+    EXPECT_TRUE(truncated.isEmpty());
+}
+
+TEST(TriangleMeshTest, MapsWhatItWritesInPlace)
+{
+    const TriangleMesh mesh = MakeMesh(6, 4);
+    std::vector<char> data;
+    mesh.write(data);
+
+    // as a mapped file, aligned
+    std::vector<double> buffer((data.size() + 2*TriangleMesh::Alignment)/sizeof(double));
+    char* aligned = reinterpret_cast<char*>(buffer.data());
+    aligned += (TriangleMesh::Alignment - reinterpret_cast<std::uintptr_t>(aligned)%TriangleMesh::Alignment)%TriangleMesh::Alignment;
+    std::copy(data.begin(), data.end(), aligned);
+
+    TriangleMesh view;
+    const char* p = aligned;
+    ASSERT_TRUE(view.map(p, aligned + data.size()));
+    EXPECT_EQ(p, aligned + data.size());
+    EXPECT_TRUE(view.isMapped());
+    EXPECT_EQ(view.size(), mesh.size());
+    EXPECT_GE(view.getNodes().data(), static_cast<const void*>(aligned));
+    EXPECT_LT(view.getMemoryUsage(), mesh.getMemoryUsage()/100);
+
+    std::mt19937 generator(12);
+    std::uniform_real_distribution<double> uniform(-3.0, 3.0);
+    for (int n = 0; n < 200; ++n) {
+        const Ray ray(vec3d(uniform(generator), uniform(generator), 5.0), vec3d(0.1*uniform(generator), 0.1*uniform(generator), -1.0));
+        double t = 0.;
+        double tView = 0.;
+        DifferentialGeometry dg;
+        DifferentialGeometry dgView;
+        ASSERT_EQ(mesh.intersect(ray, &t, &dg), view.intersect(ray, &tView, &dgView));
+        EXPECT_EQ(t, tView);
+        EXPECT_EQ(dg.normal.z, dgView.normal.z);
+        EXPECT_EQ(mesh.intersectP(ray), view.intersectP(ray));
+    }
+
+    // arrays off their alignment are not viewed
+    TriangleMesh misaligned;
+    std::copy(data.begin(), data.end(), aligned + 4);
+    p = aligned + 4;
+    EXPECT_FALSE(misaligned.map(p, aligned + 4 + data.size()));
+    EXPECT_TRUE(misaligned.isEmpty());
+}
+
+TEST(BVHStatisticsTest, IsEmptyWithoutNodes)
+{
+    const BVHStatistics statistics = BVHStatistics::find({});
+    EXPECT_EQ(statistics.nodes, 0);
+    EXPECT_EQ(statistics.depth, 0);
+    EXPECT_EQ(statistics.sahCost, 0.);
+}
+
+TEST(BVHStatisticsTest, WeighsLanesByArea)
+{
+    BVHNode4 node;
+    node.boxes.set(0, Box3D(vec3d(0., 0., 0.), vec3d(1., 1., 1.)));
+    node.child[0] = 0;
+    node.count[0] = 2;
+    node.boxes.set(1, Box3D(vec3d(1., 0., 0.), vec3d(2., 1., 1.)));
+    node.child[1] = 2;
+    node.count[1] = 2;
+
+    const BVHStatistics statistics = BVHStatistics::find({node});
+    EXPECT_EQ(statistics.nodes, 1);
+    EXPECT_EQ(statistics.leaves, 2);
+    EXPECT_EQ(statistics.primitives, 4u);
+    EXPECT_EQ(statistics.depth, 1);
+    // the root box has area 10, each lane 6
+    EXPECT_NEAR(statistics.sahCost, 1. + 2.*0.6*2., 1e-12);
+    EXPECT_EQ(statistics.bytes, sizeof(BVHNode4));
+}
+
+TEST(BVHStatisticsTest, CountsEveryTriangleOfAMesh)
+{
+    const TriangleMesh mesh = MakeMesh(8, 4);
+    const BVHStatistics statistics = BVHStatistics::find(mesh.getNodes());
+    EXPECT_EQ(statistics.nodes, int(mesh.getNodes().size()));
+    EXPECT_EQ(statistics.primitives, qulonglong(mesh.size()));
+    EXPECT_GT(statistics.depth, 1);
+    EXPECT_GT(statistics.sahCost, 1.);
+    EXPECT_GT(mesh.getMemoryUsage(), statistics.bytes);
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include <QCryptographicHash>
+#include <QtEndian>
+
+#include "libraries/auxiliary/FluxGridFile.h"
+
+namespace {
+
+quint16 read16(const QByteArray& data, int offset)
+{
+    return qFromLittleEndian<quint16>(data.constData() + offset);
+}
+
+quint32 read32(const QByteArray& data, int offset)
+{
+    return qFromLittleEndian<quint32>(data.constData() + offset);
+}
+
+quint32 adler32(const QByteArray& data)
+{
+    quint32 a = 1;
+    quint32 b = 0;
+    for (char byte : data) {
+        a = (a + quint8(byte)) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+} // namespace
+
+TEST(FluxGridFileTest, FindsFormatsFromSuffixes)
+{
+    FluxGridFile::Format format = FluxGridFile::Float64;
+    ASSERT_TRUE(FluxGridFile::findFormat("grid.f32", &format));
+    EXPECT_EQ(format, FluxGridFile::Float32);
+    ASSERT_TRUE(FluxGridFile::findFormat("grid.BIN", &format));
+    EXPECT_EQ(format, FluxGridFile::Float64);
+    ASSERT_TRUE(FluxGridFile::findFormat("dir/grid.npz", &format));
+    EXPECT_EQ(format, FluxGridFile::Npz);
+    ASSERT_TRUE(FluxGridFile::findFormat("camera.pfm", &format));
+    EXPECT_EQ(format, FluxGridFile::Pfm);
+    EXPECT_FALSE(FluxGridFile::findFormat("grid.csv", &format));
+}
+
+TEST(FluxGridFileTest, WritesRawValuesLittleEndian)
+{
+    const std::vector<double> values{1., -2.5, 0.1};
+    const QByteArray doubles = FluxGridFile::toRaw(values, false);
+    const QByteArray floats = FluxGridFile::toRaw(values, true);
+    ASSERT_EQ(doubles.size(), 24);
+    ASSERT_EQ(floats.size(), 12);
+
+    const quint64 bits = qFromLittleEndian<quint64>(doubles.constData() + 8);
+    double value = 0.;
+    std::memcpy(&value, &bits, sizeof(value));
+    EXPECT_EQ(value, -2.5);
+    const quint32 singleBits = qFromLittleEndian<quint32>(floats.constData() + 8);
+    float single = 0.f;
+    std::memcpy(&single, &singleBits, sizeof(single));
+    EXPECT_EQ(single, 0.1f);
+
+    EXPECT_EQ(FluxGridFile::sha256(values),
+              QString::fromLatin1(QCryptographicHash::hash(doubles, QCryptographicHash::Sha256).toHex()));
+}
+
+TEST(FluxGridFileTest, WritesNpyHeaderAlignedToSixtyFourBytes)
+{
+    const std::vector<double> values(6, 3.);
+    const QByteArray npy = FluxGridFile::toNpy(2, 3, values);
+    ASSERT_TRUE(npy.startsWith(QByteArray("\x93NUMPY\x01\x00", 8)));
+    const int headerSize = read16(npy, 8);
+    EXPECT_EQ((10 + headerSize) % 64, 0);
+    EXPECT_EQ(npy.size(), 10 + headerSize + 48);
+    const QByteArray header = npy.mid(10, headerSize);
+    EXPECT_TRUE(header.contains("'descr': '<f8'"));
+    EXPECT_TRUE(header.contains("'shape': (2, 3)"));
+    EXPECT_TRUE(header.endsWith('\n'));
+    EXPECT_EQ(npy.mid(10 + headerSize), FluxGridFile::toRaw(values, false));
+}
+
+TEST(FluxGridFileTest, WritesPfmRowsFromTheBottomUp)
+{
+    const std::vector<double> values = {1., 2., 3., 4., 5., 6.};
+    const QByteArray pfm = FluxGridFile::toPfm(2, 3, values);
+    const QByteArray header("Pf\n3 2\n-1.0\n");
+    ASSERT_TRUE(pfm.startsWith(header));
+    ASSERT_EQ(pfm.size(), header.size() + 24);
+
+    const std::vector<double> bottom(values.begin() + 3, values.end());
+    const std::vector<double> top(values.begin(), values.begin() + 3);
+    EXPECT_EQ(pfm.mid(header.size(), 12), FluxGridFile::toRaw(bottom, true));
+    EXPECT_EQ(pfm.mid(header.size() + 12), FluxGridFile::toRaw(top, true));
+}
+
+TEST(FluxGridFileTest, WritesNpzMemberThatInflatesToTheNpy)
+{
+    std::vector<double> values;
+    for (int n = 0; n < 200; ++n)
+        values.push_back(n % 7);
+    const QByteArray npy = FluxGridFile::toNpy(10, 20, values);
+    const QByteArray npz = FluxGridFile::toNpz("flux", npy);
+
+    ASSERT_EQ(read32(npz, 0), 0x04034b50u);
+    EXPECT_EQ(read16(npz, 8), 8);
+    const quint32 compressedSize = read32(npz, 18);
+    EXPECT_EQ(read32(npz, 22), quint32(npy.size()));
+    const int nameSize = read16(npz, 26);
+    EXPECT_EQ(npz.mid(30, nameSize), QByteArray("flux.npy"));
+
+    // rebuilt as the zlib stream qUncompress reads
+    QByteArray stream(4, 0);
+    qToBigEndian<quint32>(quint32(npy.size()), stream.data());
+    stream.append("\x78\x9c", 2);
+    stream.append(npz.mid(30 + nameSize, int(compressedSize)));
+    QByteArray adler(4, 0);
+    qToBigEndian<quint32>(adler32(npy), adler.data());
+    stream.append(adler);
+    EXPECT_EQ(qUncompress(stream), npy);
+
+    // the end of the central directory points back at it
+    const int end = npz.size() - 22;
+    ASSERT_EQ(read32(npz, end), 0x06054b50u);
+    EXPECT_EQ(read16(npz, end + 10), 1);
+    EXPECT_EQ(read32(npz, int(read32(npz, end + 16))), 0x02014b50u);
+    EXPECT_EQ(read32(npz, int(read32(npz, end + 16)) + 16), read32(npz, 14));
+}
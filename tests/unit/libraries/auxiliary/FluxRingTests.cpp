@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "libraries/auxiliary/FluxRing.h"
+#include "libraries/auxiliary/FluxRingLayout.h"
+
+namespace {
+
+FluxRing::Record makeRecord(qulonglong job, int rows, int cols)
+{
+    FluxRing::Record ans;
+    ans.job = job;
+    ans.target = 1;
+    ans.isFront = false;
+    ans.rows = rows;
+    ans.cols = cols;
+    ans.raysTraced = 1000*job;
+    ans.hits = 10*job;
+    ans.powerPerRay = 0.25;
+    ans.sunAzimuth = 180.;
+    ans.sunElevation = 45.;
+    return ans;
+}
+
+std::vector<double> makeValues(size_t count, double scale)
+{
+    std::vector<double> ans(count);
+    for (size_t n = 0; n < count; ++n)
+        ans[n] = scale*(n + 1);
+    return ans;
+}
+
+}
+
+TEST(FluxRingTest, ReadsWhatTheWriterPublished)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString fileName = dir.filePath("flux.ring");
+
+    FluxRing writer;
+    QString error;
+    ASSERT_TRUE(writer.create(fileName, 4, 12, &error)) << error.toStdString();
+    FluxRing reader;
+    ASSERT_TRUE(reader.open(fileName, &error)) << error.toStdString();
+    EXPECT_EQ(reader.getSlotCount(), 4);
+    EXPECT_EQ(reader.getMaxCells(), 12u);
+    EXPECT_EQ(reader.getHead(), 0u);
+    EXPECT_FALSE(reader.read(1, nullptr, nullptr));
+
+    qulonglong number = 0;
+    ASSERT_TRUE(writer.publish(makeRecord(7, 3, 4), makeValues(12, 0.5), &number, &error)) << error.toStdString();
+    EXPECT_EQ(number, 1u);
+    EXPECT_EQ(reader.getHead(), 1u);
+
+    FluxRing::Record record;
+    std::vector<double> values;
+    ASSERT_TRUE(reader.read(1, &record, &values));
+    EXPECT_EQ(record.job, 7u);
+    EXPECT_EQ(record.target, 1);
+    EXPECT_FALSE(record.isFront);
+    EXPECT_EQ(record.rows, 3);
+    EXPECT_EQ(record.cols, 4);
+    EXPECT_EQ(record.raysTraced, 7000u);
+    EXPECT_EQ(record.hits, 70u);
+    EXPECT_EQ(record.powerPerRay, 0.25);
+    EXPECT_EQ(record.sunAzimuth, 180.);
+    EXPECT_EQ(record.sunElevation, 45.);
+    EXPECT_EQ(values, makeValues(12, 0.5));
+}
+
+TEST(FluxRingTest, KeepsTheLastRecordsOfEachSlot)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    FluxRing ring;
+    ASSERT_TRUE(ring.create(dir.filePath("flux.ring"), 3, 8));
+    for (qulonglong job = 1; job <= 5; ++job)
+        ASSERT_TRUE(ring.publish(makeRecord(job, 2, 2), makeValues(4, double(job))));
+    EXPECT_EQ(ring.getHead(), 5u);
+
+    // records 1 and 2 were overwritten by 4 and 5
+    EXPECT_FALSE(ring.read(1, nullptr, nullptr));
+    EXPECT_FALSE(ring.read(2, nullptr, nullptr));
+    EXPECT_FALSE(ring.read(6, nullptr, nullptr));
+    for (qulonglong n = 3; n <= 5; ++n) {
+        FluxRing::Record record;
+        std::vector<double> values;
+        ASSERT_TRUE(ring.read(n, &record, &values)) << n;
+        EXPECT_EQ(record.job, n);
+        EXPECT_EQ(values, makeValues(4, double(n)));
+    }
+}
+
+TEST(FluxRingTest, LaysTheFileOutAsTheCHeader)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString fileName = dir.filePath("flux.ring");
+    {
+        FluxRing ring;
+        ASSERT_TRUE(ring.create(fileName, 2, 5));
+        ASSERT_TRUE(ring.publish(makeRecord(1, 1, 5), makeValues(5, 1.)));
+        ASSERT_TRUE(ring.publish(makeRecord(2, 1, 3), makeValues(3, 2.)));
+    }
+
+    QFile file(fileName);
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    QByteArray data = file.readAll();
+    ASSERT_GE(data.size(), qsizetype(sizeof(TonatiuhFluxRingHeader)));
+    const TonatiuhFluxRingHeader* header = reinterpret_cast<const TonatiuhFluxRingHeader*>(data.constData());
+    EXPECT_EQ(header->magic, TONATIUH_FLUX_RING_MAGIC);
+    EXPECT_EQ(header->version, TONATIUH_FLUX_RING_VERSION);
+    EXPECT_EQ(header->slotCount, 2u);
+    EXPECT_EQ(header->maxCells, 5u);
+    EXPECT_EQ(header->slotBytes % 64, 0u);
+    EXPECT_EQ(header->head, 2u);
+    ASSERT_EQ(data.size(), qsizetype(sizeof(TonatiuhFluxRingHeader) + 2*header->slotBytes));
+
+    TonatiuhFluxRingSlot* slot = tonatiuhFluxRingSlot(data.data(), 2);
+    EXPECT_EQ(slot->sequence, 4u);
+    EXPECT_EQ(slot->record, 2u);
+    EXPECT_EQ(slot->job, 2u);
+    EXPECT_EQ(slot->rows, 1u);
+    EXPECT_EQ(slot->cols, 3u);
+    EXPECT_EQ(tonatiuhFluxRingValues(slot)[2], 6.);
+}
+
+TEST(FluxRingTest, RefusesGridsLargerThanASlotAndFilesThatAreNotRings)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    FluxRing ring;
+    ASSERT_TRUE(ring.create(dir.filePath("flux.ring"), 2, 4));
+    QString error;
+    EXPECT_FALSE(ring.publish(makeRecord(1, 3, 3), makeValues(9, 1.), nullptr, &error));
+    EXPECT_FALSE(error.isEmpty());
+    EXPECT_FALSE(ring.publish(makeRecord(1, 2, 2), makeValues(3, 1.)));
+    EXPECT_EQ(ring.getHead(), 0u);
+    EXPECT_FALSE(ring.create(dir.filePath("empty.ring"), 0, 4));
+
+    QFile other(dir.filePath("other.ring"));
+    ASSERT_TRUE(other.open(QIODevice::WriteOnly));
+    other.write(QByteArray(256, 'x'));
+    other.close();
+    FluxRing reader;
+    EXPECT_FALSE(reader.open(other.fileName(), &error));
+    EXPECT_FALSE(reader.isOpen());
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "libraries/auxiliary/HDF5File.h"
+
+TEST(HDF5FileTest, AppendsColumnsAcrossReopens)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("photons.h5");
+
+    {
+        HDF5File file;
+        ASSERT_TRUE(file.open(path, true));
+        EXPECT_EQ(file.getRows("photons/id"), 0u);
+        EXPECT_TRUE(file.append("photons/id", std::vector<quint64>{1, 2, 3}));
+        EXPECT_TRUE(file.append("photons/x", std::vector<double>{0.5, 1.5, 2.5}));
+        EXPECT_TRUE(file.append("surfaces", QStringList{"//a", "//b"}));
+        EXPECT_TRUE(file.close());
+    }
+
+    HDF5File file;
+    ASSERT_TRUE(file.open(path, false));
+    EXPECT_EQ(file.getRows("photons/id"), 3u);
+    EXPECT_TRUE(file.append("photons/id", std::vector<quint64>(100000, 4)));
+    EXPECT_EQ(file.getRows("photons/id"), 100003u);
+    EXPECT_TRUE(file.append("surfaces", QStringList{"//c"}));
+    EXPECT_EQ(file.readStrings("surfaces"), QStringList({"//a", "//b", "//c"}));
+}
+
+TEST(HDF5FileTest, AppendsGridsOfTheSameShape)
+{
+    QTemporaryDir dir;
+    HDF5File file;
+    ASSERT_TRUE(file.open(dir.filePath("flux.h5"), true));
+
+    EXPECT_TRUE(file.appendGrid("flux/grid", 2, 3, {1., 2., 3., 4., 5., 6.}));
+    EXPECT_TRUE(file.appendGrid("flux/grid", 2, 3, std::vector<double>(6, 0.)));
+    EXPECT_EQ(file.getRows("flux/grid"), 2u);
+
+    EXPECT_FALSE(file.appendGrid("flux/grid", 3, 3, std::vector<double>(9, 0.)));
+    EXPECT_FALSE(file.appendGrid("flux/other", 2, 2, std::vector<double>(3, 0.)));
+    EXPECT_EQ(file.getRows("flux/grid"), 2u);
+}
+
+TEST(HDF5FileTest, ReplacesRootAttributes)
+{
+    QTemporaryDir dir;
+    HDF5File file;
+    ASSERT_TRUE(file.open(dir.filePath("attributes.h5"), true));
+
+    EXPECT_TRUE(file.setAttribute("photon_power", 0.25));
+    EXPECT_TRUE(file.setAttribute("photon_power", 0.5));
+    EXPECT_TRUE(file.setAttribute("note", QString("flux study")));
+}
+
+TEST(HDF5FileTest, RefusesToAppendToOtherFiles)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("text.h5");
+    {
+        QFile text(path);
+        ASSERT_TRUE(text.open(QIODevice::WriteOnly));
+        text.write("not hdf5");
+    }
+
+    HDF5File file;
+    EXPECT_FALSE(file.open(path, false));
+    EXPECT_FALSE(file.isOpen());
+    EXPECT_FALSE(file.getError().isEmpty());
+}
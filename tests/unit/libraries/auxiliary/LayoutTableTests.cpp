@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "libraries/auxiliary/LayoutTable.h"
+
+TEST(LayoutTableTest, ReadsSolarPilotColumns)
+{
+    const std::string text =
+        "\xEF\xBB\xBFTemplate,Loc. X,Loc. Y,Loc. Z,X focus,Aim pt. X,Aim pt. Z\r\n"
+        ",[m],[m],[m],[m],[m],[m]\r\n"
+        "-28.5,-1516.25,0,NULL,-0.25,240\r\n"
+        "\r\n"
+        "1312.5, +1e1 ,0,NULL,9.75,240\r\n";
+
+    std::vector<std::vector<double>> values;
+    std::string error;
+    ASSERT_TRUE(LayoutTable::read(text.data(), text.size(), 2, {1, 0, 5}, &values, &error)) << error;
+    ASSERT_EQ(values.size(), 3u);
+    EXPECT_EQ(values[0], (std::vector<double>{-1516.25, 10.}));
+    EXPECT_EQ(values[1], (std::vector<double>{-28.5, 1312.5}));
+    EXPECT_EQ(values[2], (std::vector<double>{240., 240.}));
+}
+
+TEST(LayoutTableTest, ReportsTheBadRow)
+{
+    const std::string text = "x;y\n1;2\n3\t4\n5;NULL\n";
+    std::vector<std::vector<double>> values;
+    std::string error;
+    EXPECT_FALSE(LayoutTable::read(text.data(), text.size(), 1, {0, 1}, &values, &error));
+    EXPECT_NE(error.find("Row 4"), std::string::npos) << error;
+    EXPECT_TRUE(values[0].empty());
+
+    EXPECT_TRUE(LayoutTable::read(text.data(), text.size(), 1, {0}, &values, &error));
+    EXPECT_EQ(values[0], (std::vector<double>{1., 3., 5.}));
+}
+
+TEST(LayoutTableTest, ThreadsGiveTheSameColumns)
+{
+    std::string text = "x,y,z\n";
+    for (int n = 0; n < 200000; ++n)
+        text += std::to_string(n) + "," + std::to_string(0.5*n) + "," + std::to_string(-n) + "\n";
+
+    std::vector<std::vector<double>> one;
+    std::vector<std::vector<double>> many;
+    ASSERT_TRUE(LayoutTable::read(text.data(), text.size(), 1, {2, 0}, &one, nullptr, 1));
+    ASSERT_TRUE(LayoutTable::read(text.data(), text.size(), 1, {2, 0}, &many, nullptr, 8));
+    ASSERT_EQ(one[0].size(), 200000u);
+    EXPECT_EQ(one, many);
+    EXPECT_EQ(many[0][199999], -199999.);
+    EXPECT_EQ(many[1][123456], 123456.);
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "libraries/auxiliary/ObjReader.h"
+
+namespace
+{
+struct Obj
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+};
+
+bool LoadTinyObj(const std::string& text, Obj* obj)
+{
+    std::istringstream stream(text);
+    std::vector<tinyobj::material_t> materials;
+    std::string warnings;
+    std::string errors;
+    return tinyobj::LoadObj(&obj->attrib, &obj->shapes, &materials, &warnings, &errors, &stream);
+}
+
+bool LoadObjReader(const std::string& text, Obj* obj, int threads)
+{
+    return ObjReader::read(text.data(), text.size(), &obj->attrib, &obj->shapes, threads);
+}
+
+void ExpectEqual(const Obj& a, const Obj& b)
+{
+    EXPECT_EQ(a.attrib.vertices, b.attrib.vertices);
+    EXPECT_EQ(a.attrib.normals, b.attrib.normals);
+    ASSERT_EQ(a.shapes.size(), b.shapes.size());
+    for (size_t s = 0; s < a.shapes.size(); ++s) {
+        const tinyobj::mesh_t& ma = a.shapes[s].mesh;
+        const tinyobj::mesh_t& mb = b.shapes[s].mesh;
+        EXPECT_EQ(a.shapes[s].name, b.shapes[s].name);
+        EXPECT_EQ(ma.num_face_vertices, mb.num_face_vertices);
+        ASSERT_EQ(ma.indices.size(), mb.indices.size());
+        for (size_t n = 0; n < ma.indices.size(); ++n) {
+            EXPECT_EQ(ma.indices[n].vertex_index, mb.indices[n].vertex_index);
+            EXPECT_EQ(ma.indices[n].normal_index, mb.indices[n].normal_index);
+            EXPECT_EQ(ma.indices[n].texcoord_index, mb.indices[n].texcoord_index);
+        }
+    }
+}
+
+// a mesh of several megabytes, so it is split over threads
+std::string MakeMesh(int nVertices, int nTriangles)
+{
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> uniform(-1000., 1000.);
+    std::uniform_int_distribution<int> vertex(1, nVertices);
+    const char* formats[] = {"%.9g", "%.3f", "%.6e", "%.17g", "%.0f"};
+
+    std::string text = "# mesh\nmtllib mesh.mtl\n";
+    char buffer[64];
+    for (int n = 0; n < nVertices; ++n) {
+        text += n % 7 ? "v " : "v\t ";
+        for (int k = 0; k < 3; ++k) {
+            std::snprintf(buffer, sizeof(buffer), formats[(n + k) % 5], uniform(generator));
+            text += buffer;
+            text += ' ';
+        }
+        text += n % 5 ? "\n" : "\r\n";
+        text += "vn 0 0.6 -.8\nvt 0.5 0.5\n";
+    }
+
+    for (int n = 0; n < nTriangles; ++n) {
+        if (n % 20000 == 0) text += n % 40000 ? "o part " + std::to_string(n) + "\n" : "g group " + std::to_string(n) + "\n";
+        if (n % 30001 == 0) text += "usemtl steel\ns 1\n";
+        int a = vertex(generator);
+        int b = vertex(generator);
+        int c = vertex(generator);
+        switch (n % 4) {
+        case 0: std::snprintf(buffer, sizeof(buffer), "f %d %d %d\n", a, b, c); break;
+        case 1: std::snprintf(buffer, sizeof(buffer), "f %d//%d %d//%d %d//%d\n", a, a, b, b, c, c); break;
+        case 2: std::snprintf(buffer, sizeof(buffer), "f %d/%d/%d %d/%d/%d %d/%d/%d \n", a, a, a, b, b, b, c, c, c); break;
+        default: std::snprintf(buffer, sizeof(buffer), "  f %d/%d %d/%d %d/%d\r\n", a, a, b, b, c, c);
+        }
+        text += buffer;
+    }
+    return text;
+}
+}
+
+TEST(ObjReaderTest, MatchesTinyObjOnLargeMeshes)
+{
+    const std::string text = MakeMesh(40000, 100000);
+    ASSERT_GT(text.size(), 4u << 20);
+
+    Obj expected;
+    ASSERT_TRUE(LoadTinyObj(text, &expected));
+    ASSERT_GT(expected.shapes.size(), 2u);
+
+    for (int threads : {1, 3, 8}) {
+        Obj obj;
+        ASSERT_TRUE(LoadObjReader(text, &obj, threads));
+        ExpectEqual(expected, obj);
+    }
+}
+
+TEST(ObjReaderTest, MatchesTinyObjOnNames)
+{
+    const std::string text =
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+        "f 1 2 3\n"
+        "g\n"
+        "g first  second\t\n"
+        "f 1 2 3\n"
+        "o  spaced name \n"
+        "o empty\n"
+        "g  \n"
+        "f 3 2 1\n"
+        "g trailing\n";
+
+    Obj expected;
+    ASSERT_TRUE(LoadTinyObj(text, &expected));
+    Obj obj;
+    ASSERT_TRUE(LoadObjReader(text, &obj, 1));
+    ExpectEqual(expected, obj);
+}
+
+TEST(ObjReaderTest, LeavesOtherInputToTinyObj)
+{
+    Obj obj;
+    EXPECT_FALSE(LoadObjReader("v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3 4\n", &obj, 1));
+    EXPECT_FALSE(LoadObjReader("v 0 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1\n", &obj, 1));
+    EXPECT_FALSE(LoadObjReader("v 0 0 0\nv 1 0 0\nl 1 2\n", &obj, 1));
+    EXPECT_FALSE(LoadObjReader("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n", &obj, 1));
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include "libraries/math/3D/Affine3D.h"
+#include "libraries/math/3D/Transform.h"
+
+namespace
+{
+void ExpectVec3dNear(const vec3d& actual, const vec3d& expected)
+{
+    EXPECT_NEAR(actual.x, expected.x, 1e-12);
+    EXPECT_NEAR(actual.y, expected.y, 1e-12);
+    EXPECT_NEAR(actual.z, expected.z, 1e-12);
+}
+
+Transform MakeTransform()
+{
+    return Transform::translate(1.0, -2.0, 3.0)*
+           Transform::rotate(0.7, vec3d(1.0, 2.0, -0.5))*
+           Transform::scale(2.0, 0.5, 3.0);
+}
+}
+
+TEST(Affine3DTest, DefaultAndEmptyTransformAreIdentity)
+{
+    const vec3d p(1.5, -2.0, 4.0);
+
+    ExpectVec3dNear(Affine3D().transformPoint(p), p);
+    ExpectVec3dNear(Affine3D(Transform()).transformPoint(p), p);
+    ExpectVec3dNear(Affine3D(Transform()).transformNormal(p), p);
+}
+
+TEST(Affine3DTest, MatchesTransform)
+{
+    const Transform transform = MakeTransform();
+    const Affine3D affine(transform);
+    const vec3d p(0.3, -1.2, 2.5);
+
+    ExpectVec3dNear(affine.transformPoint(p), transform.transformPoint(p));
+    ExpectVec3dNear(affine.transformVector(p), transform.transformVector(p));
+    ExpectVec3dNear(affine.transformNormal(p), transform.transformNormal(p));
+
+    const Ray ray(vec3d(4.0, 1.0, -2.0), vec3d(-1.0, 0.2, 0.6), 0.1, 50.0);
+    const Ray local = affine.transformInverse(ray);
+    const Ray expected = transform.transformInverse(ray);
+    ExpectVec3dNear(local.origin, expected.origin);
+    ExpectVec3dNear(local.direction(), expected.direction());
+    EXPECT_DOUBLE_EQ(local.tMin, 0.1);
+    EXPECT_DOUBLE_EQ(local.tMax, 50.0);
+}
+
+TEST(Affine3DTest, InverseRoundTripsAndConvertsBack)
+{
+    const Affine3D affine(MakeTransform());
+    const vec3d p(-3.0, 0.25, 7.0);
+
+    ExpectVec3dNear(affine.transformInversePoint(affine.transformPoint(p)), p);
+    ExpectVec3dNear(affine.transformInverseVector(affine.transformVector(p)), p);
+
+    const Ray ray(p, vec3d(0.0, 0.0, 1.0));
+    const Ray back = affine.transformDirect(affine.transformInverse(ray));
+    ExpectVec3dNear(back.origin, ray.origin);
+    ExpectVec3dNear(back.direction(), ray.direction());
+
+    const Transform transform = affine.toTransform();
+    ExpectVec3dNear(transform.transformPoint(p), affine.transformPoint(p));
+    ExpectVec3dNear(transform.inversed().transformPoint(p), affine.transformInversePoint(p));
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "libraries/math/3D/Box3DPack.h"
+#include "libraries/math/3D/Box3DPackF.h"
+#include "libraries/math/3D/Ray.h"
+
+namespace
+{
+Box3DPack MakePack()
+{
+    Box3DPack pack;
+    pack.set(0, Box3D(vec3d(-1.0, -1.0, -1.0), vec3d(1.0, 1.0, 1.0)));
+    pack.set(1, Box3D(vec3d(4.0, -1.0, -1.0), vec3d(6.0, 1.0, 1.0)));
+    pack.set(2, Box3D(vec3d(-1.0, 5.0, -1.0), vec3d(1.0, 7.0, 1.0)));
+    return pack;
+}
+}
+
+TEST(Box3DPackTest, EmptyLanesNeverHit)
+{
+    const Box3DPack pack;
+    double tNear[Box3DPack::Width];
+
+    EXPECT_EQ(pack.intersect(Ray(vec3d(0.0, 0.0, -10.0), vec3d(0.0, 0.0, 1.0)), tNear), 0);
+    EXPECT_EQ(pack.intersect(Ray(vec3d(0.0, 0.0, 10.0), vec3d(0.3, -0.2, -1.0)), tNear), 0);
+    EXPECT_FALSE(pack.box(3).isValid());
+}
+
+TEST(Box3DPackTest, ReportsHitLanesAndEntryDistances)
+{
+    const Box3DPack pack = MakePack();
+    double tNear[Box3DPack::Width];
+
+    const Ray ray(vec3d(-10.0, 0.0, 0.0), vec3d(1.0, 0.0, 0.0));
+    EXPECT_EQ(pack.intersect(ray, tNear), 0b0011);
+    EXPECT_DOUBLE_EQ(tNear[0], 9.0);
+    EXPECT_DOUBLE_EQ(tNear[1], 14.0);
+
+    const Ray rayBack(vec3d(0.0, 20.0, 0.0), vec3d(0.0, -1.0, 0.0));
+    EXPECT_EQ(pack.intersect(rayBack, tNear), 0b0101);
+    EXPECT_DOUBLE_EQ(tNear[0], 19.0);
+    EXPECT_DOUBLE_EQ(tNear[2], 13.0);
+}
+
+TEST(Box3DPackTest, RespectsRayInterval)
+{
+    const Box3DPack pack = MakePack();
+    double tNear[Box3DPack::Width];
+
+    const Ray ray(vec3d(-10.0, 0.0, 0.0), vec3d(1.0, 0.0, 0.0), 0.0, 10.0);
+    EXPECT_EQ(pack.intersect(ray, tNear), 0b0001);
+
+    const Ray rayInside(vec3d(0.0, 0.0, 0.0), vec3d(1.0, 0.0, 0.0), 0.5);
+    EXPECT_EQ(pack.intersect(rayInside, tNear), 0b0011);
+    EXPECT_DOUBLE_EQ(tNear[0], 0.5);
+}
+
+TEST(Box3DPackTest, MatchesScalarSlabTest)
+{
+    const Box3DPack pack = MakePack();
+    const vec3d origins[] = {
+        vec3d(-10.0, 0.2, 0.3), vec3d(0.5, 20.0, -0.5), vec3d(5.0, 3.0, 10.0), vec3d(2.0, 2.0, 2.0)
+    };
+    const vec3d directions[] = {
+        vec3d(1.0, 0.01, 0.0), vec3d(0.0, -1.0, 0.02), vec3d(0.0, -0.3, -1.0), vec3d(-1.0, -1.0, -1.0),
+        vec3d(1.0, 1.0, 0.0)
+    };
+
+    for (const vec3d& origin : origins)
+        for (const vec3d& direction : directions)
+        {
+            const Ray ray(origin, direction);
+            double tNear[Box3DPack::Width];
+            const int mask = pack.intersect(ray, tNear);
+            for (int n = 0; n < Box3DPack::Width; ++n)
+            {
+                const Box3D box = pack.box(n);
+                double t0, t1;
+                const bool hit = box.isValid() && box.intersect(ray, &t0, &t1);
+                EXPECT_EQ(bool(mask & (1 << n)), hit);
+                if (hit) EXPECT_DOUBLE_EQ(tNear[n], t0);
+            }
+        }
+}
+
+TEST(Box3DPackTest, SinglePrecisionEmptyLanesNeverHit)
+{
+    const Box3DPackF pack;
+    double tNear[Box3DPackF::Width];
+
+    const Ray ray(vec3d(0.0, 0.0, -10.0), vec3d(0.0, 0.0, 1.0));
+    EXPECT_EQ(pack.intersect(Box3DPackF::Query(ray), ray.tMax, tNear), 0);
+    const Ray rayTilted(vec3d(0.0, 0.0, 10.0), vec3d(0.3, -0.2, -1.0));
+    EXPECT_EQ(pack.intersect(Box3DPackF::Query(rayTilted), rayTilted.tMax, tNear), 0);
+}
+
+TEST(Box3DPackTest, SinglePrecisionKeepsEveryDoubleHit)
+{
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::uniform_int_distribution<int> axis(0, 5);
+
+    long hits = 0;
+    long extra = 0;
+    for (int n = 0; n < 20000; ++n)
+    {
+        // at metre and kilometre scale, lane 3 flat in y
+        const double scale = n % 2 ? 1000.0 : 1.0;
+        Box3DPack pack;
+        for (int lane = 0; lane < Box3DPack::Width; ++lane) {
+            vec3d a(scale*uniform(generator), scale*uniform(generator), scale*uniform(generator));
+            vec3d size = 0.2*scale*vec3d(1.1 + uniform(generator), 1.1 + uniform(generator), 1.1 + uniform(generator));
+            if (lane == 3) size.y = 0.;
+            pack.set(lane, Box3D(a, a + size));
+        }
+
+        // aimed at the first box, from its corner at times, with zero or tiny direction components
+        vec3d origin(2.0*scale*uniform(generator), 2.0*scale*uniform(generator), 2.0*scale*uniform(generator));
+        if (n % 7 == 0) origin = vec3d(pack.xMin[0], pack.yMax[0], pack.zMin[0]);
+        vec3d direction = pack.box(0).center() - origin + 0.2*scale*vec3d(uniform(generator), uniform(generator), uniform(generator));
+        const int k = axis(generator);
+        if (k < 3) direction[k] = n % 3 ? 0.0 : 1e-12;
+        const double tMax = n % 5 ? gcf::infinity : 2.0*std::abs(uniform(generator));
+        const Ray ray(origin, direction, gcf::Epsilon, tMax);
+
+        double tNear[Box3DPack::Width];
+        double tNearF[Box3DPackF::Width];
+        const int mask = pack.intersect(ray, tNear);
+        const int maskF = Box3DPackF(pack).intersect(Box3DPackF::Query(ray), ray.tMax, tNearF);
+        ASSERT_EQ(mask & ~maskF, 0) << "ray " << n << " misses lanes of " << mask;
+        for (int lane = 0; lane < Box3DPack::Width; ++lane) {
+            if (!(mask & (1 << lane))) continue;
+            EXPECT_LE(tNearF[lane], tNear[lane]);
+            EXPECT_NEAR(tNearF[lane], tNear[lane], 1e-5*(1.0 + tNear[lane]));
+            hits++;
+        }
+        // rays leaving from a corner pass it within the rounding of their origin
+        for (int lane = 0; lane < Box3DPack::Width; ++lane)
+            if (n % 7 != 0 && ((maskF & ~mask) & (1 << lane))) extra++;
+    }
+    // a superset, but barely
+    EXPECT_GT(hits, 5000);
+    EXPECT_LT(extra, hits/100);
+}
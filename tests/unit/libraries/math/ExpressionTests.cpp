@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "libraries/math/Expression.h"
+
+TEST(ExpressionTest, EvaluatesShapeFormulas)
+{
+    Expression expression;
+    ASSERT_TRUE(expression.compile("Math.sin(x)*Math.exp(y*y)/3", {"x", "y"}));
+
+    const double values[] = {0.5, 2.0};
+    EXPECT_DOUBLE_EQ(expression.evaluate(values), std::sin(0.5)*std::exp(4.0)/3);
+
+    ASSERT_TRUE(expression.compile("1*( Math.cos(u) + (u + 0.)*Math.sin(u) )", {"u", "v"}));
+    EXPECT_DOUBLE_EQ(expression.evaluate(values), std::cos(0.5) + 0.5*std::sin(0.5));
+}
+
+TEST(ExpressionTest, FollowsJavaScriptPrecedence)
+{
+    Expression expression;
+    const double values[] = {3.0};
+
+    ASSERT_TRUE(expression.compile("1 + 2*x - 8/4", {"x"}));
+    EXPECT_DOUBLE_EQ(expression.evaluate(values), 5.0);
+
+    ASSERT_TRUE(expression.compile("2**3**2", {}));
+    EXPECT_DOUBLE_EQ(expression.evaluate(nullptr), 512.0);
+
+    ASSERT_TRUE(expression.compile("-7 % 3", {}));
+    EXPECT_DOUBLE_EQ(expression.evaluate(nullptr), -1.0);
+
+    ASSERT_TRUE(expression.compile("x > 2 && x < 4 ? Math.PI : 0", {"x"}));
+    EXPECT_DOUBLE_EQ(expression.evaluate(values), 3.141592653589793);
+
+    ASSERT_TRUE(expression.compile("0 || x", {"x"}));
+    EXPECT_DOUBLE_EQ(expression.evaluate(values), 3.0);
+}
+
+TEST(ExpressionTest, MatchesJavaScriptMath)
+{
+    Expression expression;
+
+    ASSERT_TRUE(expression.compile("Math.round(-2.5)", {}));
+    EXPECT_DOUBLE_EQ(expression.evaluate(nullptr), -2.0);
+
+    ASSERT_TRUE(expression.compile("Math.min(4, -1, 2) + Math.max(1, 5)", {}));
+    EXPECT_DOUBLE_EQ(expression.evaluate(nullptr), 4.0);
+
+    ASSERT_TRUE(expression.compile("Math.hypot(3, 4) + Math.abs(-1)", {}));
+    EXPECT_DOUBLE_EQ(expression.evaluate(nullptr), 6.0);
+
+    ASSERT_TRUE(expression.compile("Math.max()", {}));
+    EXPECT_TRUE(std::isinf(expression.evaluate(nullptr)));
+}
+
+TEST(ExpressionTest, RejectsTextOutsideTheSubset)
+{
+    Expression expression;
+    std::string error;
+
+    EXPECT_FALSE(expression.compile("z + 1", {"x", "y"}, &error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(expression.isValid());
+
+    EXPECT_FALSE(expression.compile("x +", {"x"}));
+    EXPECT_FALSE(expression.compile("Math.foo(x)", {"x"}));
+    EXPECT_FALSE(expression.compile("0x10", {}));
+    EXPECT_FALSE(expression.compile("Math.pow(x)", {"x"}));
+    EXPECT_FALSE(expression.compile("(x", {"x"}));
+}
+
+TEST(ExpressionTest, EvaluatesRowsLikeSingleCalls)
+{
+    Expression expression;
+    ASSERT_TRUE(expression.compile("(x*x + y*y)/4", {"x", "y"}));
+
+    const int count = 20000;
+    std::vector<double> points(2*count);
+    for (int n = 0; n < count; ++n) {
+        points[2*n] = 0.001*n;
+        points[2*n + 1] = -0.002*n;
+    }
+
+    std::vector<double> values(count);
+    expression.evaluate(points.data(), values.data(), count);
+    for (int n = 0; n < count; ++n)
+        ASSERT_EQ(values[n], expression.evaluate(&points[2*n]));
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "libraries/math/1D/LookupTable.h"
+
+TEST(LookupTableTest, EmptyTableReturnsZero)
+{
+    LookupTable table;
+
+    EXPECT_TRUE(table.isEmpty());
+    EXPECT_DOUBLE_EQ(table(0.5), 0.0);
+}
+
+TEST(LookupTableTest, ReproducesLinearFunctionsExactly)
+{
+    LookupTable table;
+    table.build([](double x) {return 3.0*x - 1.0;}, -2.0, 6.0, 33);
+
+    for (double x = -2.0; x <= 6.0; x += 0.1)
+        EXPECT_NEAR(table(x), 3.0*x - 1.0, 1e-12) << "x = " << x;
+}
+
+TEST(LookupTableTest, ClampsOutsideTheRange)
+{
+    LookupTable table;
+    table.build([](double x) {return x*x;}, 0.0, 1.0, 11);
+
+    EXPECT_DOUBLE_EQ(table(-5.0), 0.0);
+    EXPECT_DOUBLE_EQ(table(1.0), 1.0);
+    EXPECT_DOUBLE_EQ(table(7.0), 1.0);
+    EXPECT_DOUBLE_EQ(table(std::nan("")), 0.0);
+}
+
+TEST(LookupTableTest, ConvergesToSmoothFunctions)
+{
+    LookupTable table;
+    table.build([](double x) {return std::acos(x);}, 0.0, 0.9, 1024);
+
+    for (double x = 0.0; x <= 0.9; x += 0.0137)
+        EXPECT_NEAR(table(x), std::acos(x), 1e-5) << "x = " << x;
+}
+
+TEST(LookupTableTest, InterpolatesSortedPoints)
+{
+    const std::vector<vec2d> points = {
+        vec2d(0.0, 1.0),
+        vec2d(1.0, 3.0),
+        vec2d(1.0, 5.0),
+        vec2d(3.0, 1.0)
+    };
+
+    EXPECT_DOUBLE_EQ(LookupTable::interpolate(points, -1.0), 1.0);
+    EXPECT_DOUBLE_EQ(LookupTable::interpolate(points, 0.5), 2.0);
+    EXPECT_DOUBLE_EQ(LookupTable::interpolate(points, 1.0), 5.0);
+    EXPECT_DOUBLE_EQ(LookupTable::interpolate(points, 2.0), 3.0);
+    EXPECT_DOUBLE_EQ(LookupTable::interpolate(points, 4.0), 1.0);
+    EXPECT_DOUBLE_EQ(LookupTable::interpolate({}, 4.0), 0.0);
+}
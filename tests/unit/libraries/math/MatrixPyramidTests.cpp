@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "libraries/math/2D/MatrixPyramid.h"
+
+namespace
+{
+Matrix2D<double> MakeRamp(int rows, int cols)
+{
+    Matrix2D<double> m(rows, cols);
+    for (int r = 0; r < rows; ++r)
+        for (int c = 0; c < cols; ++c)
+            m(r, c) = r*cols + c;
+    return m;
+}
+}
+
+TEST(MatrixPyramidTest, HalvesEachLevelDownToOneCell)
+{
+    const MatrixPyramid<double> pyramid(MakeRamp(5, 3));
+
+    ASSERT_EQ(pyramid.levels(), 4);
+    EXPECT_EQ(pyramid.level(0).rows(), 5);
+    EXPECT_EQ(pyramid.level(0).cols(), 3);
+    EXPECT_EQ(pyramid.level(1).rows(), 3);
+    EXPECT_EQ(pyramid.level(1).cols(), 2);
+    EXPECT_EQ(pyramid.level(2).rows(), 2);
+    EXPECT_EQ(pyramid.level(2).cols(), 1);
+    EXPECT_EQ(pyramid.level(3).rows(), 1);
+    EXPECT_EQ(pyramid.level(3).cols(), 1);
+}
+
+TEST(MatrixPyramidTest, KeepsTheMaximumOfCoveredCells)
+{
+    const MatrixPyramid<double> pyramid(MakeRamp(5, 3));
+
+    const Matrix2D<double>& level = pyramid.level(1);
+    EXPECT_DOUBLE_EQ(level(0, 0), 4.);  // rows 0-1, cols 0-1
+    EXPECT_DOUBLE_EQ(level(0, 1), 5.);  // rows 0-1, col 2
+    EXPECT_DOUBLE_EQ(level(2, 0), 13.); // row 4, cols 0-1
+    EXPECT_DOUBLE_EQ(pyramid.level(3)(0, 0), 14.);
+}
+
+TEST(MatrixPyramidTest, KeepsSingleCellPeaks)
+{
+    Matrix2D<double> m(64, 64);
+    m.fill(1.);
+    m(37, 11) = 100.;
+    const MatrixPyramid<double> pyramid(m);
+
+    for (int n = 0; n < pyramid.levels(); ++n)
+        EXPECT_DOUBLE_EQ(pyramid.level(n)(37 >> n, 11 >> n), 100.);
+}
+
+TEST(MatrixPyramidTest, FindsFinestLevelWithinLimits)
+{
+    const MatrixPyramid<double> pyramid(MakeRamp(4000, 4000));
+
+    EXPECT_EQ(pyramid.findLevel(400, 300, 800, 600), 0);
+    EXPECT_EQ(pyramid.findLevel(4000, 4000, 800, 600), 3);
+    EXPECT_EQ(pyramid.findLevel(4000, 100, 1000, 1000), 2);
+    EXPECT_EQ(pyramid.findLevel(4000, 4000, 0, 0), pyramid.levels() - 1);
+}
+
+TEST(MatrixPyramidTest, EmptyMatrixHasNoLevelsToShow)
+{
+    const MatrixPyramid<double> pyramid((Matrix2D<double>()));
+
+    EXPECT_TRUE(pyramid.isEmpty());
+    EXPECT_EQ(pyramid.findLevel(10, 10, 1, 1), 0);
+}
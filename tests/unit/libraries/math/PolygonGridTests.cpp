@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "libraries/math/2D/PolygonGrid.h"
+#include "libraries/math/gcf.h"
+
+namespace
+{
+// QPolygonF::containsPoint with Qt::OddEvenFill
+bool ContainsPoint(const std::vector<vec2d>& points, bool closed, const vec2d& p)
+{
+    int winding = 0;
+    auto isect = [&](vec2d a, vec2d b) {
+        if (std::abs(a.y - b.y)*1000000000000. <= std::min(std::abs(a.y), std::abs(b.y))) return;
+        int dir = 1;
+        if (b.y < a.y) {
+            std::swap(a, b);
+            dir = -1;
+        }
+        if (p.y >= a.y && p.y < b.y) {
+            double x = a.x + ((b.x - a.x)/(b.y - a.y))*(p.y - a.y);
+            if (x <= p.x) winding += dir;
+        }
+    };
+    for (size_t n = 1; n < points.size(); ++n)
+        isect(points[n - 1], points[n]);
+    if (closed && points.size() > 1)
+        isect(points.back(), points.front());
+    return winding % 2 != 0;
+}
+
+void ExpectMatches(const std::vector<vec2d>& points, bool closed, std::mt19937& generator)
+{
+    PolygonGrid grid;
+    grid.build(points, closed);
+
+    Box2D box;
+    for (const vec2d& p : points) box << p;
+    std::uniform_real_distribution<double> uniform(-0.2, 1.2);
+    std::uniform_int_distribution<size_t> vertex(0, points.size() - 1);
+
+    for (int n = 0; n < 20000; ++n) {
+        vec2d p = box.fromNormalized(vec2d(uniform(generator), uniform(generator)));
+        if (n % 4 == 1) p.y = points[vertex(generator)].y; // on the height of a vertex
+        if (n % 4 == 2) p = points[vertex(generator)];
+        if (n % 4 == 3) { // on an edge
+            size_t k = vertex(generator);
+            const vec2d& a = points[k];
+            const vec2d& b = points[(k + 1) % points.size()];
+            double t = uniform(generator);
+            p = a + (b - a)*t;
+        }
+        ASSERT_EQ(grid.isInside(p), ContainsPoint(points, closed, p)) << p.x << " " << p.y;
+    }
+}
+}
+
+TEST(PolygonGridTest, MatchesQtOnStarPolygons)
+{
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<double> radius(0.3, 1.0);
+    for (int nVertices : {3, 6, 40, 500}) {
+        std::vector<vec2d> points;
+        for (int n = 0; n < nVertices; ++n) {
+            double phi = gcf::TwoPi*n/nVertices;
+            double r = radius(generator);
+            points.push_back(vec2d(5. + r*std::cos(phi), -2. + r*std::sin(phi)));
+        }
+        ExpectMatches(points, true, generator);
+    }
+}
+
+TEST(PolygonGridTest, MatchesQtOnSelfIntersectingAndOpenPolygons)
+{
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<double> uniform(-1., 1.);
+    for (int nVertices : {5, 30, 200}) {
+        std::vector<vec2d> points;
+        for (int n = 0; n < nVertices; ++n)
+            points.push_back(vec2d(uniform(generator), 3.*uniform(generator)));
+        ExpectMatches(points, true, generator);
+        ExpectMatches(points, false, generator);
+    }
+}
+
+TEST(PolygonGridTest, MatchesQtOnGridAlignedOutlines)
+{
+    // a comb with horizontal edges and an almost horizontal one
+    std::vector<vec2d> points = {{0., 0.}, {10., 0.}, {10., 1.}};
+    for (int n = 9; n >= 1; --n) {
+        points.push_back(vec2d(n + 0.5, 1.));
+        points.push_back(vec2d(n + 0.5, 3.));
+        points.push_back(vec2d(n, 3.));
+        points.push_back(vec2d(n, 1.));
+    }
+    points.push_back(vec2d(0., 1. + 1e-14));
+    std::mt19937 generator(3);
+    ExpectMatches(points, true, generator);
+}
+
+TEST(PolygonGridTest, EmptyAndDegenerate)
+{
+    PolygonGrid grid;
+    EXPECT_FALSE(grid.isInside(vec2d(0., 0.)));
+    grid.build({vec2d(0., 0.), vec2d(1., 0.), vec2d(2., 0.)}, true);
+    EXPECT_FALSE(grid.isInside(vec2d(1., 0.)));
+
+    grid.build({vec2d(0., 0.), vec2d(1., 0.), vec2d(1., 1.), vec2d(0., 1.)}, true);
+    EXPECT_TRUE(grid.isInside(vec2d(0.5, 0.5)));
+    EXPECT_TRUE(grid.isInside(vec2d(0., 0.)));
+    EXPECT_FALSE(grid.isInside(vec2d(1.5, 0.5)));
+    EXPECT_FALSE(grid.isInside(vec2d(0.5, 1.)));
+}